@@ -1,41 +1,27 @@
-#if defined(__APPLE__)
-#include <libkern/OSByteOrder.h>
-
-#define htobe16(x) OSSwapHostToBigInt16(x)
-#define htole16(x) OSSwapHostToLittleInt16(x)
-#define be16toh(x) OSSwapBigToHostInt16(x)
-#define le16toh(x) OSSwapLittleToHostInt16(x)
-
-#define htobe32(x) OSSwapHostToBigInt32(x)
-#define htole32(x) OSSwapHostToLittleInt32(x)
-#define be32toh(x) OSSwapBigToHostInt32(x)
-#define le32toh(x) OSSwapLittleToHostInt32(x)
-
-#define htobe64(x) OSSwapHostToBigInt64(x)
-#define htole64(x) OSSwapHostToLittleInt64(x)
-#define be64toh(x) OSSwapBigToHostInt64(x)
-#define le64toh(x) OSSwapLittleToHostInt64(x)
-#else
-#include <endian.h>
-#endif
-
 #include "Tensor/Tensor.h"
 #include <cstdio>
 #include <QDebug>
 #include "MNIST.h"
+#include "Operator/ConvolutionAlgorithmCache.h"
+#include <QFile>
 #include <QMap>
 #include <QString>
+#include <algorithm>
 
 MNIST::MNIST(MNIST::TestMode testMode, WebsocketServer *websocketServer, bool usingConvolution)
     :DemoBase(websocketServer),
-    datafp(NULL),
-    labelfp(NULL),
+    m_trainRecords(),
+    m_trainLoader(nullptr),
+    m_trainAugmentation(),
+    m_trainEpochCount(0),
+    m_trainUploader(nullptr),
+    m_isUploadingTrainBatch(false),
     numOfImage(0),
     numOfRow(0),
     numOfColumn(0),
     labelCount(0),
-    testDatafp(NULL),
-    testLabelfp(NULL),
+    m_testRecords(),
+    m_testLoader(nullptr),
     numOfTestImage(0),
     numOfTestRow(0),
     numOfTestColumn(0),
@@ -43,88 +29,154 @@ MNIST::MNIST(MNIST::TestMode testMode, WebsocketServer *websocketServer, bool us
     m_usingConvolution(usingConvolution),
     m_testMode(testMode)
 {
+    m_trainAugmentation.m_isShuffling = true;
 }
 
 MNIST::~MNIST()
 {
+    closeTrainData();
+    closeTestData();
 }
 
-void MNIST::openTrainData()
+// the shards written by an earlier run are opened as they are
+static bool openRecords(FreeWill::RecordDataset &records, const std::string &imageFilename, const std::string &labelFilename,
+                        const std::string &prefix)
 {
-    datafp = fopen("train-images-idx3-ubyte","rb");
-    labelfp = fopen("train-labels-idx1-ubyte","rb");
+    const unsigned int shardCount = 4;
+
+    std::vector<std::string> filenames;
+    bool isConverted = true;
+
+    for (unsigned int shard = 0; shard < shardCount; ++shard)
+    {
+        filenames.push_back(prefix + "-" + std::to_string(shard) + "-of-" + std::to_string(shardCount));
+        isConverted = isConverted && QFile::exists(QString::fromStdString(filenames.back()));
+    }
+
+    if (!isConverted)
+    {
+        FreeWill::IDXFile imageFile;
+        FreeWill::IDXFile labelFile;
+
+        if (!imageFile.open(imageFilename) || !labelFile.open(labelFilename))
+        {
+            return false;
+        }
 
-    unsigned int magicNum = 0;
+        filenames = FreeWill::writeRecordShards(imageFile, &labelFile, prefix, shardCount);
+
+        if (filenames.empty())
+        {
+            return false;
+        }
+    }
+
+    return records.open(filenames) && records.dimensions().size() == 3 && records.hasLabels();
+}
+
+void MNIST::openTrainData()
+{
     numOfImage = 0;
     numOfRow = 0;
     numOfColumn = 0;
-
-    unsigned int magicNumLabel = 0;
     labelCount = 0;
 
-    fread(&magicNumLabel, sizeof(unsigned int), 1, labelfp);
-    fread(&labelCount, sizeof(unsigned int ),1, labelfp);
-
-    magicNumLabel = be32toh(magicNumLabel);
-    labelCount = be32toh(labelCount);
+    if (!openRecords(m_trainRecords, "train-images-idx3-ubyte", "train-labels-idx1-ubyte", "train-records"))
+    {
+        m_trainRecords.close();
+        return;
+    }
 
-    fread(&magicNum, sizeof(unsigned int), 1, datafp);
-    fread(&numOfImage, sizeof(unsigned int), 1, datafp);
-    fread(&numOfRow, sizeof(unsigned int), 1, datafp);
-    fread(&numOfColumn, sizeof(unsigned int), 1, datafp);
+    numOfImage = m_trainRecords.dimensions()[0];
+    numOfRow = m_trainRecords.dimensions()[1];
+    numOfColumn = m_trainRecords.dimensions()[2];
+    labelCount = m_trainRecords.itemCount();
 
-    magicNum = be32toh(magicNum);
-    numOfImage = be32toh(numOfImage);
-    numOfRow = be32toh(numOfRow);
-    numOfColumn = be32toh(numOfColumn);
+    // the loader starts over every epoch, a new seed gives it a new order
+    m_trainAugmentation.m_seed = m_trainEpochCount++;
 }
 
 void MNIST::closeTrainData()
 {
-    fclose(datafp);
-    fclose(labelfp);
+    finishTrainUpload();
+
+    delete m_trainUploader;
+    m_trainUploader = nullptr;
+
+    delete m_trainLoader;
+    m_trainLoader = nullptr;
+
+    m_trainRecords.close();
 }
 
 void MNIST::openTestData()
 {
-    testDatafp = fopen("t10k-images-idx3-ubyte","rb");
-    testLabelfp = fopen("t10k-labels-idx1-ubyte","rb");
-
-    unsigned int magicNum = 0;
     numOfTestImage = 0;
     numOfTestRow = 0;
     numOfTestColumn = 0;
-
-    unsigned int magicNumLabel = 0;
     labelTestCount = 0;
 
-    fread(&magicNumLabel, sizeof(unsigned int), 1, testLabelfp);
-    fread(&labelTestCount, sizeof(unsigned int ),1, testLabelfp);
+    if (!openRecords(m_testRecords, "t10k-images-idx3-ubyte", "t10k-labels-idx1-ubyte", "t10k-records"))
+    {
+        m_testRecords.close();
+        return;
+    }
 
-    magicNumLabel = be32toh(magicNumLabel);
-    labelTestCount = be32toh(labelTestCount);
+    numOfTestImage = m_testRecords.dimensions()[0];
+    numOfTestRow = m_testRecords.dimensions()[1];
+    numOfTestColumn = m_testRecords.dimensions()[2];
+    labelTestCount = m_testRecords.itemCount();
+}
 
-    fread(&magicNum, sizeof(unsigned int), 1, testDatafp);
-    fread(&numOfTestImage, sizeof(unsigned int), 1, testDatafp);
-    fread(&numOfTestRow, sizeof(unsigned int), 1, testDatafp);
-    fread(&numOfTestColumn, sizeof(unsigned int), 1, testDatafp);
+void MNIST::closeTestData()
+{
+    delete m_testLoader;
+    m_testLoader = nullptr;
 
-    magicNum = be32toh(magicNum);
-    numOfTestImage = be32toh(numOfTestImage);
-    numOfTestRow = be32toh(numOfTestRow);
-    numOfTestColumn = be32toh(numOfTestColumn);
+    m_testRecords.close();
 }
 
-void MNIST::closeTestData()
+bool MNIST::loadBatch(FreeWill::BatchLoader *&loader, const FreeWill::RecordDataset &records, const FreeWill::AugmentationParameters &augmentation,
+                       float *image, unsigned int *label, unsigned int batchSize)
 {
-    fclose(testDatafp);
-    fclose(testLabelfp);
+    // the model demos load one device's share of the batch per call, the loader is sized
+    // by the first call of an epoch
+    if (!loader || loader->batchSize() != batchSize)
+    {
+        delete loader;
+        loader = new FreeWill::BatchLoader(&records, batchSize);
+        loader->setAugmentation(augmentation);
+
+        if (!loader->start())
+        {
+            delete loader;
+            loader = nullptr;
+            return false;
+        }
+    }
+
+    const FreeWill::BatchLoader::Batch *batch = loader->acquire();
+
+    if (!batch)
+    {
+        return false;
+    }
+
+    std::copy(batch->m_inputs, batch->m_inputs + (size_t) batchSize * records.itemSize(), image);
+    std::copy(batch->m_labels, batch->m_labels + batchSize, label);
+
+    loader->release();
+
+    return true;
 }
 
 void MNIST::run()
 {
     FreeWill::Context<FreeWill::DeviceType::GPU_CUDA>::getSingleton().open();
 
+    // the convolutions benchmarked by the last run are not searched again
+    FreeWill::ConvolutionAlgorithmCache::getSingleton().open("cudnn-algorithms");
+
     switch(m_testMode)
     {
     case TestMode::CPU_FULLYCONNECTED:
@@ -156,3 +208,56 @@ QMap<QString, MNIST::TestMode> MNIST::testModeLookup = {{"CPU_FULLYCONNECTED", M
                                                         {"CPU_CONVNET_MODEL", MNIST::TestMode::CPU_CONVNET_MODEL},
                                                         {"GPU_FULLYCONNECTED",MNIST::TestMode::GPU_FULLYCONNECTED},
                                                         {"GPU_CONVNET",MNIST::TestMode::GPU_CONVNET}};
+
+void MNIST::finishTrainUpload()
+{
+    if (m_isUploadingTrainBatch)
+    {
+        m_trainUploader->wait();
+        m_trainLoader->release();
+        m_isUploadingTrainBatch = false;
+    }
+}
+
+bool MNIST::loadTrainDataToDevice(float *image, unsigned int *label, unsigned int batchSize)
+{
+    finishTrainUpload();
+
+    if (!m_trainLoader || m_trainLoader->batchSize() != batchSize || !m_trainLoader->isRaw())
+    {
+        delete m_trainLoader;
+        m_trainLoader = new FreeWill::BatchLoader(&m_trainRecords, batchSize);
+        m_trainLoader->setAugmentation(m_trainAugmentation);
+        m_trainLoader->setPinned(true);
+        m_trainLoader->setRaw(true);
+
+        if (!m_trainLoader->start())
+        {
+            delete m_trainLoader;
+            m_trainLoader = nullptr;
+            return false;
+        }
+    }
+
+    if (!m_trainUploader)
+    {
+        m_trainUploader = new FreeWill::DeviceBatchUploader();
+    }
+
+    const FreeWill::BatchLoader::Batch *batch = m_trainLoader->acquire();
+
+    if (!batch)
+    {
+        return false;
+    }
+
+    if (!m_trainUploader->upload(batch, batchSize, m_trainRecords.itemSize(), m_trainLoader->scale(), image, label))
+    {
+        m_trainLoader->release();
+        return false;
+    }
+
+    m_isUploadingTrainBatch = true;
+
+    return true;
+}
@@ -3,23 +3,34 @@
 
 #include <QThread>
 #include <Tensor/Tensor.h>
+#include <Dataset/RecordDataset.h>
+#include <Dataset/BatchLoader.h>
+#include <Dataset/DeviceBatchUploader.h>
 #include "DemoBase.h"
 
 class MNIST : public DemoBase
 {
     Q_OBJECT
 
-    FILE *datafp;
-    FILE *labelfp;
+    // the IDX files are converted into shards of records by the first run, the loaders stream
+    // the shards
+    FreeWill::RecordDataset m_trainRecords;
+    FreeWill::BatchLoader *m_trainLoader;
+    FreeWill::AugmentationParameters m_trainAugmentation;
+    unsigned int m_trainEpochCount;
+    // the gpu demos upload the bytes of the train batches, the batch of the last upload stays
+    // acquired until the next load
+    FreeWill::DeviceBatchUploader *m_trainUploader;
+    bool m_isUploadingTrainBatch;
 
     unsigned int numOfImage;
     unsigned int numOfRow;
     unsigned int numOfColumn;
     unsigned int labelCount;
    
-    FILE *testDatafp;
-    FILE *testLabelfp;
-    
+    FreeWill::RecordDataset m_testRecords;
+    FreeWill::BatchLoader *m_testLoader;
+
     unsigned int numOfTestImage;
     unsigned int numOfTestRow;
     unsigned int numOfTestColumn;
@@ -50,72 +61,40 @@ public:
     void openTrainData();
     void closeTestData();
     void closeTrainData();
-        
+
+private:
+    // the loader decodes the next batches on its own thread, this only copies a decoded one
+    bool loadBatch(FreeWill::BatchLoader *&loader, const FreeWill::RecordDataset &records, const FreeWill::AugmentationParameters &augmentation,
+                    float *image, unsigned int *label, unsigned int batchSize);
+    // image and label are device memory
+    bool loadTrainDataToDevice(float *image, unsigned int *label, unsigned int batchSize);
+    void finishTrainUpload();
+
+public:
     template<FreeWill::DeviceType DeviceUsed = FreeWill::DeviceType::CPU_NAIVE>
     void loadOneTrainData(FreeWill::Tensor<DeviceUsed, float> &image, FreeWill::Tensor<DeviceUsed, unsigned int> &label, unsigned int batchSize)
     {
-        for(unsigned int i = 0;i<batchSize;++i)
+        if constexpr (DeviceUsed == FreeWill::DeviceType::GPU_CUDA)
         {
-            for(unsigned int y = 0 ; y < numOfRow; ++y)
-            {
-                for(unsigned int x = 0;x< numOfColumn; ++x)
-                {
-                    unsigned char pixel = 0;
-                    fread(&pixel, sizeof(unsigned char), 1, datafp);
-                    image[i*numOfRow*numOfColumn + numOfColumn * y + x] = (float) pixel / 255.0f;
-                }
-            }
-
-            unsigned char _label = 0;
-            fread(&_label, sizeof(unsigned char), 1, labelfp);
-            label[i] = _label;
+            // the kernels of this step wait for the upload on the device, the host only
+            // waits for the upload of the previous step
+            loadTrainDataToDevice(image.gpuDataHandle(), label.gpuDataHandle(), batchSize);
         }
-
-        if constexpr (DeviceUsed == FreeWill::DeviceType::GPU_CUDA)
+        else
         {
-            image.copyFromHostToDevice();
-            label.copyFromHostToDevice();
+            loadOneTrainData(&image[0], &label[0], batchSize);
         }
     }
 
     void loadOneTrainData(float *image, unsigned int *label, unsigned int batchSize)
     {
-        for(unsigned int i = 0;i<batchSize;++i)
-        {
-            for(unsigned int y = 0 ; y < numOfRow; ++y)
-            {
-                for(unsigned int x = 0;x< numOfColumn; ++x)
-                {
-                    unsigned char pixel = 0;
-                    fread(&pixel, sizeof(unsigned char), 1, datafp);
-                    image[i*numOfRow*numOfColumn + numOfColumn * y + x] = (float) pixel / 255.0f;
-                }
-            }
-
-            unsigned char _label = 0;
-            fread(&_label, sizeof(unsigned char), 1, labelfp);
-            label[i] = _label;
-        }
+        loadBatch(m_trainLoader, m_trainRecords, m_trainAugmentation, image, label, batchSize);
     }
 
     template<FreeWill::DeviceType DeviceUsed = FreeWill::DeviceType::CPU_NAIVE>
     void loadOneTestData(FreeWill::Tensor<DeviceUsed, float> &image, FreeWill::Tensor<DeviceUsed, unsigned int> &label,unsigned int batchSize)
     {
-        for (unsigned int i =0;i<batchSize;++i)
-        {
-            for(unsigned int y = 0 ; y < numOfTestRow; ++y)
-            {
-                for(unsigned int x = 0;x< numOfTestColumn; ++x)
-                {
-                    unsigned char pixel = 0;
-                    fread(&pixel, sizeof(unsigned char), 1, testDatafp);
-                    image[i * numOfTestRow*numOfTestColumn +  numOfTestColumn * y + x] = (float) pixel / 255.0f;
-                }
-            }
-            unsigned char _label = 0;
-            fread(&_label, sizeof(unsigned char), 1, testLabelfp);
-            label[i] = _label;
-        }
+        loadOneTestData(&image[0], &label[0], batchSize);
 
         if constexpr (DeviceUsed == FreeWill::DeviceType::GPU_CUDA)
         {
@@ -126,21 +105,7 @@ public:
 
     void loadOneTestData(float *image, unsigned int *label, unsigned int batchSize)
     {
-        for (unsigned int i =0;i<batchSize;++i)
-        {
-            for(unsigned int y = 0 ; y < numOfTestRow; ++y)
-            {
-                for(unsigned int x = 0;x< numOfTestColumn; ++x)
-                {
-                    unsigned char pixel = 0;
-                    fread(&pixel, sizeof(unsigned char), 1, testDatafp);
-                    image[i * numOfTestRow*numOfTestColumn +  numOfTestColumn * y + x] = (float) pixel / 255.0f;
-                }
-            }
-            unsigned char _label = 0;
-            fread(&_label, sizeof(unsigned char), 1, testLabelfp);
-            label[i] = _label;
-        }
+        loadBatch(m_testLoader, m_testRecords, FreeWill::AugmentationParameters(), image, label, batchSize);
     }
 
     void trainFullyConnectedModel();
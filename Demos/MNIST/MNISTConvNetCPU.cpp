@@ -42,11 +42,8 @@ void MNIST::trainConvolutionalModel()
     FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> poolingOutput({featureMapSize,12,12,batchSize});
     poolingOutput.init();
 
-    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, unsigned int> poolingSwitchX({featureMapSize,12,12,batchSize});
-    poolingSwitchX.init();
-
-    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, unsigned int> poolingSwitchY({featureMapSize,12,12,batchSize});
-    poolingSwitchY.init();
+    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, unsigned int> poolingSwitch(FreeWill::maxPoolingSwitchShape({featureMapSize,12,12,batchSize}));
+    poolingSwitch.init();
 
     FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> fullyConnected1Weight({100, featureMapSize*12*12});
     fullyConnected1Weight.init();
@@ -91,8 +88,7 @@ void MNIST::trainConvolutionalModel()
     FreeWill::MaxPooling<FreeWill::DeviceType::CPU_NAIVE, float> maxPooling;
     maxPooling.setInputParameter("Input", &convOutput);
     maxPooling.setOutputParameter("Output", &poolingOutput);
-    maxPooling.setOutputParameter("SwitchX", &poolingSwitchX);
-    maxPooling.setOutputParameter("SwitchY", &poolingSwitchY);
+    maxPooling.setOutputParameter("Switch", &poolingSwitch);
     VERIFY_INIT(maxPooling.init());
 
     poolingOutput.reshape({featureMapSize*12*12, batchSize});
@@ -183,8 +179,7 @@ void MNIST::trainConvolutionalModel()
 
     FreeWill::MaxPoolingDerivative<FreeWill::DeviceType::CPU_NAIVE, float> maxPoolingDerivative;
     maxPoolingDerivative.setInputParameter("OutputGrad", &poolingOutputGrad);
-    maxPoolingDerivative.setInputParameter("SwitchX", &poolingSwitchX);
-    maxPoolingDerivative.setInputParameter("SwitchY", &poolingSwitchY);
+    maxPoolingDerivative.setInputParameter("Switch", &poolingSwitch);
 
     FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> convOutputGrad({featureMapSize,24,24,batchSize});
     convOutputGrad.init();
@@ -337,8 +332,7 @@ void MNIST::trainConvolutionalModel()
                 {
                     convOutput.clear();
                     poolingOutput.clear();
-                    poolingSwitchX.clear();
-                    poolingSwitchY.clear();
+                    poolingSwitch.clear();
                     fullyConnected1Output.clear();
                     fullyConnected2Output.clear();
                     softmaxOutput.clear();
@@ -388,8 +382,7 @@ void MNIST::trainConvolutionalModel()
 
             convOutput.clear();
             poolingOutput.clear();
-            poolingSwitchX.clear();
-            poolingSwitchY.clear();
+            poolingSwitch.clear();
             fullyConnected1Output.clear();
             fullyConnected2Output.clear();
             softmaxOutput.clear();
@@ -31,9 +31,7 @@ void MNIST::trainConvolutionalModelWithModelClass()
 
     FreeWill::TensorDescriptorHandle poolingOutput = model->addTensor("poolingOutput", {featureMapSize, 12,12}).enableBatch();
 
-    FreeWill::TensorDescriptorHandle poolingSwitchX = model->addTensor("poolingSwitchX",{featureMapSize, 12,12}, FreeWill::DataType::UNSIGNED_INT).enableBatch();
-
-    FreeWill::TensorDescriptorHandle poolingSwitchY = model->addTensor("poolingSwitchY", {featureMapSize, 12,12}, FreeWill::DataType::UNSIGNED_INT).enableBatch();
+    FreeWill::TensorDescriptorHandle poolingSwitch = model->addTensor("poolingSwitch", FreeWill::maxPoolingSwitchShape({featureMapSize, 12,12}), FreeWill::DataType::UNSIGNED_INT).enableBatch();
 
     FreeWill::TensorDescriptorHandle fullyConnected1Weight = model->addTensor("fullyConnected1Weight", {100, featureMapSize*12*12}).randomize();
 
@@ -84,7 +82,7 @@ void MNIST::trainConvolutionalModelWithModelClass()
     {{"Tensor", poolingOutput}}, {}, {{"NewShape", Shape({featureMapSize*12*12})}});*/
 
     FreeWill::OperatorDescriptorHandle maxPooling = model->addOperator("maxPooling", FreeWill::OperatorName::MAX_POOLING,
-    {{"Input", convOutput}}, {{"Output", poolingOutput.reshape({featureMapSize, 12, 12})}, {"SwitchX", poolingSwitchX},{"SwitchY", poolingSwitchY}});
+    {{"Input", convOutput}}, {{"Output", poolingOutput.reshape({featureMapSize, 12, 12})}, {"Switch", poolingSwitch}});
 
     /*FreeWill::OperatorDescriptorHandle reshapeAfterMaxPooling = model->addOperator("reshapeAfterMaxPooling", FreeWill::OperatorName::RESHAPE,
     {{"Tensor", poolingOutput}}, {}, {{"NewShape", Shape({featureMapSize, 12,12})}});*/
@@ -119,7 +117,7 @@ void MNIST::trainConvolutionalModelWithModelClass()
     {{"InputDelta", poolingOutputGrad.reshape({featureMapSize*12*12})},{"BiasGrad", fullyConnected1BiasGrad},{"WeightGrad", fullyConnected1WeightGrad}});
 
     FreeWill::OperatorDescriptorHandle maxPoolingDerivative = model->addOperator("maxPoolingDerivative", FreeWill::OperatorName::MAX_POOLING_DERIVATIVE,
-    {{"OutputGrad", poolingOutputGrad.reshape({featureMapSize, 12, 12})}, {"SwitchX", poolingSwitchX}, {"SwitchY", poolingSwitchY}},{{"InputGrad", convOutputGrad}});
+    {{"OutputGrad", poolingOutputGrad.reshape({featureMapSize, 12, 12})}, {"Switch", poolingSwitch}},{{"InputGrad", convOutputGrad}});
 
     FreeWill::OperatorDescriptorHandle convSigmoidDerivative = model->addOperator("convSigmoidDerivative", FreeWill::OperatorName::ACTIVATION_DERIVATIVE,
     {{"Output", convOutput},{"OutputDelta", convOutputGrad}}, {{"InputDelta", convOutputGrad}},
@@ -156,6 +154,10 @@ void MNIST::trainConvolutionalModelWithModelClass()
     const int testInterval = 2000;
 
     const int deviceCount = FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().deviceCount();
+    const unsigned int metricsInterval = 100;
+
+    // only the busy time of the devices, for the utilization on the web ui
+    FreeWill::Profiler::getSingleton().enable(false);
 
     for(unsigned int e = 1; e<=60; ++e)
     {
@@ -165,16 +167,15 @@ void MNIST::trainConvolutionalModelWithModelClass()
         std::chrono::duration<double, std::nano> backwardTime = std::chrono::duration<double, std::nano>::zero();
         for(unsigned int i = 1; i<=numOfImage/(batchSize*deviceCount); ++i)
         {
-            for(int d = 0; d<deviceCount;++d)
-            {
-                float *inputData = model->beginMutateData(image, d);
-                unsigned int *labelData = model->beginMutateData<FreeWill::DeviceType::CPU_NAIVE, unsigned int>(label,d);
+            // one global batch, each device trains on its own slice of it
+            float *inputData = model->beginScatterData(image);
+            unsigned int *labelData = model->beginScatterData<FreeWill::DeviceType::CPU_NAIVE, unsigned int>(label);
 
-                loadOneTrainData(inputData, labelData, batchSize);
+            loadOneTrainData(inputData, labelData, batchSize*deviceCount);
+
+            model->endMutateData(image);
+            model->endMutateData(label);
 
-                model->endMutateData(image,d);
-                model->endMutateData(label,d);
-            }
             auto forwardStartTime = std::chrono::steady_clock::now();
             solver.forward(model);
             auto forwardEndTime = std::chrono::steady_clock::now();
@@ -217,6 +218,13 @@ void MNIST::trainConvolutionalModelWithModelClass()
 
             solver.update(-learningRate/(float)(deviceCount*batchSize));
 
+            FreeWill::Profiler::getSingleton().endStep(batchSize*deviceCount);
+
+            if (i % metricsInterval == 0)
+            {
+                reportMetrics(FreeWill::DeviceType::CPU_NAIVE);
+            }
+
             if (i%30000 == 0)
             {
                learningRate *= 0.9;
@@ -245,8 +253,7 @@ void MNIST::trainConvolutionalModelWithModelClass()
             {
                 model->clearTensor(convOutput);
                 model->clearTensor(poolingOutput);
-                model->clearTensor(poolingSwitchX);
-                model->clearTensor(poolingSwitchY);
+                model->clearTensor(poolingSwitch);
                 model->clearTensor(fullyConnected1Output);
                 model->clearTensor(fullyConnected2Output);
                 model->clearTensor(softmaxOutput);
@@ -305,8 +312,7 @@ void MNIST::trainConvolutionalModelWithModelClass()
 
             model->clearTensor(convOutput );
             model->clearTensor(poolingOutput );
-            model->clearTensor(poolingSwitchX );
-            model->clearTensor(poolingSwitchY );
+            model->clearTensor(poolingSwitch);
             model->clearTensor(fullyConnected1Output );
             model->clearTensor(fullyConnected2Output );
             model->clearTensor(softmaxOutput );
@@ -13,6 +13,7 @@
 #include "Operator/ElementwiseProduct.h"
 #include <QDebug>
 #include "Operator/ElementwiseAdd.h"
+#include "Operator/Metric.h"
 #include "MNIST.h"
 
 void MNIST::trainConvolutionalModelGPU()
@@ -180,8 +181,7 @@ void MNIST::trainConvolutionalModelGPU()
 
     FreeWill::MaxPoolingDerivative<FreeWill::DeviceType::GPU_CUDA, float> maxPoolingDerivative;
     maxPoolingDerivative.setInputParameter("OutputGrad", &poolingOutputGrad);
-    //maxPoolingDerivative.setInputParameter("SwitchX", &poolingSwitchX);
-    //maxPoolingDerivative.setInputParameter("SwitchY", &poolingSwitchY);
+    //maxPoolingDerivative.setInputParameter("Switch", &poolingSwitch);
     maxPoolingDerivative.setInputParameter("Input", &convOutput);
     maxPoolingDerivative.setInputParameter("Output", &poolingOutput);
 
@@ -260,6 +260,28 @@ void MNIST::trainConvolutionalModelGPU()
 
     VERIFY_INIT(updateFullyConnected2Bias.init());
 
+    // the cost and the accuracy add up on the device, the host reads them every costInterval
+    // steps and once per test, instead of waiting for every batch
+    FreeWill::Tensor<FreeWill::DeviceType::GPU_CUDA, double> trainingAccumulator({3});
+    trainingAccumulator.init();
+
+    FreeWill::Metric<FreeWill::DeviceType::GPU_CUDA, float> trainingMetric;
+    trainingMetric.setInputParameter("Cost", &cost);
+    trainingMetric.setOutputParameter("Accumulator", &trainingAccumulator);
+    VERIFY_INIT(trainingMetric.init());
+
+    FreeWill::Tensor<FreeWill::DeviceType::GPU_CUDA, double> testAccumulator({3});
+    testAccumulator.init();
+
+    FreeWill::Metric<FreeWill::DeviceType::GPU_CUDA, float> testMetric;
+    testMetric.setInputParameter("Output", &softmaxOutput);
+    testMetric.setInputParameter("Label", &label);
+    testMetric.setOutputParameter("Accumulator", &testAccumulator);
+    VERIFY_INIT(testMetric.init());
+
+    const unsigned int costInterval = 100;
+    bool isCostFetched = false;
+
     float learningRate = 0.01;
     float overallCost = 0.0;
     float accuracy = 0.0;
@@ -288,11 +310,7 @@ void MNIST::trainConvolutionalModelGPU()
 
             fullyConnected2.evaluate();
             softmaxLogLoss.evaluate();
-            cost.copyFromDeviceToHost();
-            for(unsigned int c =0;c<batchSize;++c)
-            {
-                overallCost += cost[c];
-            }
+            trainingMetric.evaluate();
             //backward
             softmaxLogLossDerivative.evaluate();
 
@@ -308,9 +326,20 @@ void MNIST::trainConvolutionalModelGPU()
             convSigmoidDerivative.evaluate();
             convDerivative.evaluate();
 
-            qDebug() << e << i<< "cost" << overallCost / (float) batchSize << learningRate << accuracy;
-            emit updateCost(overallCost / (float) batchSize);
-            overallCost = 0.0;
+            // the values fetched an interval ago are long on the host by now
+            if (i % costInterval == 0)
+            {
+                if (isCostFetched)
+                {
+                    overallCost = trainingMetric.fetched().meanCost();
+                    qDebug() << e << i<< "cost" << overallCost << learningRate << accuracy;
+                    emit updateCost(overallCost);
+                }
+
+                trainingMetric.fetch();
+                trainingMetric.reset();
+                isCostFetched = true;
+            }
 
             updateConvWeight.setRate(-learningRate);
             updateConvWeight.evaluate();
@@ -334,9 +363,8 @@ void MNIST::trainConvolutionalModelGPU()
             //test
             if (i % testInterval == 0)
             {
-                unsigned int correct = 0;
-
                 openTestData();
+                testMetric.reset();
 
                 for (unsigned int v = 0;v<numOfTestImage/batchSize; ++v)
                 {
@@ -363,33 +391,12 @@ void MNIST::trainConvolutionalModelGPU()
                     fullyConnected2.evaluate();
                     softmaxLogLoss.evaluate();
 
-                    cost.copyFromDeviceToHost();
-
-                    softmaxOutput.copyFromDeviceToHost();
-                    for(unsigned int b =0;b<batchSize;++b)
-                    {
-                        unsigned int maxIndex = 0;
-                        float maxValue = softmaxOutput[b*softmaxOutput.shape()[0]];
-                        for(unsigned int e = 1; e < softmaxOutput.shape()[0]; ++e)
-                        {
-                            if (maxValue < softmaxOutput[b*softmaxOutput.shape()[0] + e])
-                            {
-                                maxValue = softmaxOutput[b*softmaxOutput.shape()[0] + e];
-                                maxIndex = e;
-                            }
-                        }
-
-
-                        if ((float) maxIndex == label[b])
-                        {
-                            correct ++;
-                        }
-                    }
-
+                    testMetric.evaluate();
                  }
 
 
-                 qDebug() << "Accuracy" << (accuracy = (float) correct / (float) numOfTestImage);
+                 testMetric.fetch();
+                 qDebug() << "Accuracy" << (accuracy = (float) testMetric.fetched().accuracy());
 
                  closeTestData();
              }
@@ -101,16 +101,15 @@ void MNIST::trainFullyConnectedModelWithModelClass()
         std::chrono::duration<double, std::nano> backwardTime = std::chrono::duration<double, std::nano>::zero();
         for(unsigned int i = 1; i<=numOfImage/(batchSize*deviceCount); ++i)
         {
-            for(int d = 0; d<deviceCount;++d)
-            {
-                float *inputData = model->beginMutateData(image, d);
-                unsigned int *labelData = model->beginMutateData<FreeWill::DeviceType::CPU_NAIVE, unsigned int>(label,d);
+            // one global batch, each device trains on its own slice of it
+            float *inputData = model->beginScatterData(image);
+            unsigned int *labelData = model->beginScatterData<FreeWill::DeviceType::CPU_NAIVE, unsigned int>(label);
 
-                loadOneTrainData(inputData, labelData, batchSize);
+            loadOneTrainData(inputData, labelData, batchSize*deviceCount);
+
+            model->endMutateData(image);
+            model->endMutateData(label);
 
-                model->endMutateData(image,d);
-                model->endMutateData(label,d);
-            }
             auto forwardStartTime = std::chrono::steady_clock::now();
             solver.forward(model);
             auto forwardEndTime = std::chrono::steady_clock::now();
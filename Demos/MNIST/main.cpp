@@ -45,6 +45,9 @@ int main(int argc, char *argv[])
     mnist->moveToThread(mnist);
     QObject::connect(mnist, &MNIST::updateCost, &websocketServer, &WebsocketServer::onUpdateCost);
     QObject::connect(mnist, &MNIST::updateProgress, &websocketServer, &WebsocketServer::onUpdateProgress);
+    QObject::connect(mnist, &MNIST::updateThroughput, &websocketServer, &WebsocketServer::onUpdateThroughput);
+    QObject::connect(mnist, &MNIST::updateDevices, &websocketServer, &WebsocketServer::onUpdateDevices);
+    QObject::connect(mnist, &MNIST::updateMemory, &websocketServer, &WebsocketServer::onUpdateMemory);
     mnist->start();
     
     return a.exec();
@@ -0,0 +1,970 @@
+#include "Tensor/Tensor.h"
+#include "Context/Context.h"
+#include "Context/ThreadPool.h"
+#include "Operator/Operator.h"
+#include "Operator/Activation.h"
+#include "Operator/ActivationDerivative.h"
+#include "Operator/Convolution.h"
+#include "Operator/ConvolutionDerivative.h"
+#include "Operator/DotProductWithBias.h"
+#include "Operator/DotProductWithBiasDerivative.h"
+#include "Operator/ElementwiseAdd.h"
+#include "Operator/MaxPooling.h"
+#include "Operator/MaxPoolingDerivative.h"
+#include "Operator/SoftmaxLogLoss.h"
+#include "Operator/SoftmaxLogLossDerivative.h"
+#include "Operator/SoftmaxLogLossWithDerivative.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Times every operator over a set of shapes, for float and double, on the cpu and on the
+// first gpu, and reports how close each gets to the roofline of its device: the lower of
+// the peak arithmetic rate and the memory bandwidth times the operator's FLOP per byte.
+// The cost of an evaluation is what the profiler counts, see Operator::flops and
+// Operator::parameterSizeInByte.
+//
+// FreeWillBenchmark [--cpu-only] [--gpu-only] [--filter <text>] [--min-time <ms>]
+//                   [--threads <count>] [--json <file>]
+//                   [--cpu-peak <GFLOP/s>] [--cpu-bandwidth <GB/s>]
+//                   [--gpu-peak <GFLOP/s>] [--gpu-bandwidth <GB/s>]
+//
+// The results go to benchmark.json by default, one benchmark per line and in a fixed
+// order, so two runs diff line by line.
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    struct Options
+    {
+        bool m_isCPUEnabled = true;
+        bool m_isGPUEnabled = true;
+        std::string m_filter;
+        double m_minTime = 0.2;
+        // the cpu operators run on the calling thread alone without a thread pool
+        unsigned int m_threadCount = 0;
+        std::string m_jsonFileName = "benchmark.json";
+        // measured or read from the device when not given
+        double m_cpuPeak = 0.0;
+        double m_cpuBandwidth = 0.0;
+        double m_gpuPeak = 0.0;
+        double m_gpuBandwidth = 0.0;
+    };
+
+    struct Roofline
+    {
+        // GFLOP/s and GB/s
+        double m_peak = 0.0;
+        double m_bandwidth = 0.0;
+
+        double attainable(double intensity) const
+        {
+            return std::min(m_peak, intensity * m_bandwidth);
+        }
+    };
+
+    struct BenchmarkResult
+    {
+        std::string m_name;
+        std::string m_operator;
+        std::string m_device;
+        std::string m_dataType;
+        std::string m_shape;
+        unsigned int m_iterations = 0;
+        // microseconds per evaluation
+        double m_time = 0.0;
+        double m_flops = 0.0;
+        double m_bytes = 0.0;
+        Roofline m_roofline;
+
+        double gflops() const
+        {
+            return m_time > 0.0 ? m_flops / m_time * 1.0e-3 : 0.0;
+        }
+
+        double gbs() const
+        {
+            return m_time > 0.0 ? m_bytes / m_time * 1.0e-3 : 0.0;
+        }
+
+        double intensity() const
+        {
+            return m_bytes > 0.0 ? m_flops / m_bytes : 0.0;
+        }
+
+        // the share of the attainable rate reached, by FLOP/s or, for operators that do
+        // hardly any arithmetic, by bandwidth. The bandwidth is the main memory's, an operator
+        // whose tensors stay in the caches between evaluations can go past 100%.
+        double rooflineFraction() const
+        {
+            double attainable = m_roofline.attainable(intensity());
+
+            if (attainable > 0.0 && m_flops > 0.0)
+            {
+                return gflops() / attainable;
+            }
+
+            return m_roofline.m_bandwidth > 0.0 ? gbs() / m_roofline.m_bandwidth : 0.0;
+        }
+    };
+
+    template<typename DataType>
+    const char *dataTypeName()
+    {
+        if constexpr (std::is_same<DataType, float>::value)
+        {
+            return "float";
+        }
+        else
+        {
+            return "double";
+        }
+    }
+
+    template<FreeWill::DeviceType DeviceUsed>
+    const char *deviceName()
+    {
+        return DeviceUsed == FreeWill::DeviceType::GPU_CUDA ? "GPU_CUDA" : "CPU_NAIVE";
+    }
+
+    std::string shapeName(const std::vector<unsigned int> &sizes)
+    {
+        std::stringstream stream;
+
+        for (unsigned int i = 0; i < sizes.size(); ++i)
+        {
+            stream << (i ? "x" : "") << sizes[i];
+        }
+
+        return stream.str();
+    }
+
+    double elapsedSeconds(Clock::time_point begin)
+    {
+        return std::chrono::duration<double>(Clock::now() - begin).count();
+    }
+
+    // A multiply and an add per step on independent accumulators, spread over the thread
+    // pool like the cpu kernels are, so the peak matches the thread count they run with.
+    template<typename DataType>
+    double measureCPUPeak()
+    {
+        const unsigned int accumulatorCount = 64;
+        const unsigned int stepCount = 1 << 22;
+        FreeWill::ThreadPool &threadPool = FreeWill::ThreadPool::getSingleton();
+        unsigned int chunkCount = (threadPool.threadCount() + 1) * 4;
+        volatile DataType multiplier = 0.999999;
+        volatile DataType addend = 1.0e-6;
+        volatile DataType sink = 0;
+        double best = 0.0;
+
+        for (unsigned int repeat = 0; repeat < 3; ++repeat)
+        {
+            Clock::time_point begin = Clock::now();
+
+            threadPool.parallelFor(0, chunkCount, 1, [&](unsigned int chunkBegin, unsigned int chunkEnd)
+            {
+                DataType m = multiplier;
+                DataType a = addend;
+
+                for (unsigned int chunk = chunkBegin; chunk < chunkEnd; ++chunk)
+                {
+                    DataType accumulators[accumulatorCount];
+
+                    for (unsigned int i = 0; i < accumulatorCount; ++i)
+                    {
+                        accumulators[i] = (DataType) i;
+                    }
+
+                    for (unsigned int step = 0; step < stepCount / accumulatorCount; ++step)
+                    {
+                        for (unsigned int i = 0; i < accumulatorCount; ++i)
+                        {
+                            accumulators[i] = accumulators[i] * m + a;
+                        }
+                    }
+
+                    DataType sum = 0;
+
+                    for (unsigned int i = 0; i < accumulatorCount; ++i)
+                    {
+                        sum += accumulators[i];
+                    }
+
+                    sink = sink + sum;
+                }
+            });
+
+            double seconds = elapsedSeconds(begin);
+            best = std::max(best, 2.0 * chunkCount * (stepCount / accumulatorCount) * accumulatorCount / seconds * 1.0e-9);
+        }
+
+        return best;
+    }
+
+    // a copy much larger than the caches, read and write counted
+    double measureCPUBandwidth()
+    {
+        const size_t elementCount = 1 << 23;
+        const unsigned int blockSize = 1 << 14;
+        std::vector<double> source(elementCount, 1.0);
+        std::vector<double> destination(elementCount, 0.0);
+        FreeWill::ThreadPool &threadPool = FreeWill::ThreadPool::getSingleton();
+        double best = 0.0;
+
+        for (unsigned int repeat = 0; repeat < 5; ++repeat)
+        {
+            Clock::time_point begin = Clock::now();
+
+            threadPool.parallelFor(0, elementCount / blockSize, 1, [&](unsigned int blockBegin, unsigned int blockEnd)
+            {
+                std::memcpy(&destination[(size_t) blockBegin * blockSize], &source[(size_t) blockBegin * blockSize],
+                        (size_t) (blockEnd - blockBegin) * blockSize * sizeof(double));
+            });
+
+            double seconds = elapsedSeconds(begin);
+            best = std::max(best, 2.0 * elementCount * sizeof(double) / seconds * 1.0e-9);
+        }
+
+        return best;
+    }
+
+    unsigned int coresPerMultiprocessor(int major, int minor)
+    {
+        switch (major)
+        {
+        case 3:
+            return 192;
+        case 5:
+            return 128;
+        case 6:
+            return minor == 0 ? 64 : 128;
+        case 7:
+            return 64;
+        case 8:
+            return minor == 0 ? 64 : 128;
+        default:
+            return 128;
+        }
+    }
+
+    // the datasheet rates of the current gpu: a fused multiply-add per core and cycle and
+    // two transfers per memory clock
+    Roofline gpuRoofline(bool isDouble)
+    {
+        int device = 0;
+        cudaDeviceProp properties;
+        RUN_CUDA(cudaGetDevice(&device));
+        RUN_CUDA(cudaGetDeviceProperties(&properties, device));
+
+        Roofline roofline;
+        roofline.m_peak = 2.0 * properties.multiProcessorCount * coresPerMultiprocessor(properties.major, properties.minor)
+                * properties.clockRate * 1.0e-6;
+
+        if (isDouble && properties.singleToDoublePrecisionPerfRatio > 0)
+        {
+            roofline.m_peak /= properties.singleToDoublePrecisionPerfRatio;
+        }
+
+        roofline.m_bandwidth = 2.0 * properties.memoryClockRate * (properties.memoryBusWidth / 8) * 1.0e-6;
+
+        return roofline;
+    }
+
+    class BenchmarkSuite
+    {
+    private:
+        Options m_options;
+        std::map<std::string, Roofline> m_rooflines;
+        std::vector<BenchmarkResult> m_results;
+
+    public:
+        BenchmarkSuite(const Options &options)
+            :m_options(options),
+              m_rooflines(),
+              m_results()
+        {
+        }
+
+        const std::vector<BenchmarkResult> &results() const
+        {
+            return m_results;
+        }
+
+        const std::map<std::string, Roofline> &rooflines() const
+        {
+            return m_rooflines;
+        }
+
+        template<FreeWill::DeviceType DeviceUsed, typename DataType>
+        const Roofline &roofline()
+        {
+            std::string key = std::string(deviceName<DeviceUsed>()) + "/" + dataTypeName<DataType>();
+
+            if (m_rooflines.find(key) == m_rooflines.end())
+            {
+                Roofline roofline;
+
+                if constexpr (DeviceUsed == FreeWill::DeviceType::GPU_CUDA)
+                {
+                    roofline = gpuRoofline(std::is_same<DataType, double>::value);
+                    roofline.m_peak = m_options.m_gpuPeak > 0.0 ? m_options.m_gpuPeak : roofline.m_peak;
+                    roofline.m_bandwidth = m_options.m_gpuBandwidth > 0.0 ? m_options.m_gpuBandwidth : roofline.m_bandwidth;
+                }
+                else
+                {
+                    roofline.m_peak = m_options.m_cpuPeak > 0.0 ? m_options.m_cpuPeak : measureCPUPeak<DataType>();
+                    roofline.m_bandwidth = m_options.m_cpuBandwidth > 0.0 ? m_options.m_cpuBandwidth : measureCPUBandwidth();
+                }
+
+                m_rooflines[key] = roofline;
+            }
+
+            return m_rooflines[key];
+        }
+
+        template<FreeWill::DeviceType DeviceUsed, typename DataType>
+        std::string name(const std::string &operatorName, const std::string &shape) const
+        {
+            return operatorName + "/" + deviceName<DeviceUsed>() + "/" + dataTypeName<DataType>() + "/" + shape;
+        }
+
+        bool isSelected(const std::string &name) const
+        {
+            return m_options.m_filter.empty() || name.find(m_options.m_filter) != std::string::npos;
+        }
+
+        // Warms up with one evaluation, then doubles the iterations, or scales them by the
+        // time left, until one timed run takes at least the minimum time.
+        template<FreeWill::DeviceType DeviceUsed, typename DataType>
+        bool run(const std::string &operatorName, FreeWill::OperatorName type, const std::string &shape,
+                 FreeWill::Operator<DeviceUsed> &operatorBase)
+        {
+            std::string benchmarkName = name<DeviceUsed, DataType>(operatorName, shape);
+
+            if (!operatorBase.init())
+            {
+                std::cerr << "can't init " << benchmarkName << ", skipped" << std::endl;
+                return false;
+            }
+
+            auto synchronize = []()
+            {
+                if constexpr (DeviceUsed == FreeWill::DeviceType::GPU_CUDA)
+                {
+                    RUN_CUDA(cudaDeviceSynchronize());
+                }
+            };
+
+            operatorBase.evaluate();
+            synchronize();
+
+            unsigned int iterations = 1;
+            double seconds = 0.0;
+
+            while (true)
+            {
+                Clock::time_point begin = Clock::now();
+
+                for (unsigned int i = 0; i < iterations; ++i)
+                {
+                    operatorBase.evaluate();
+                }
+
+                synchronize();
+                seconds = elapsedSeconds(begin);
+
+                if (seconds >= m_options.m_minTime || iterations >= (1u << 24))
+                {
+                    break;
+                }
+
+                double scale = seconds > 0.0 ? 1.4 * m_options.m_minTime / seconds : 10.0;
+                iterations = (unsigned int) (iterations * std::min(10.0, std::max(2.0, scale)));
+            }
+
+            BenchmarkResult result;
+            result.m_name = benchmarkName;
+            result.m_operator = operatorName;
+            result.m_device = deviceName<DeviceUsed>();
+            result.m_dataType = dataTypeName<DataType>();
+            result.m_shape = shape;
+            result.m_iterations = iterations;
+            result.m_time = seconds / iterations * 1.0e6;
+            result.m_flops = operatorBase.flops(type);
+            result.m_bytes = operatorBase.parameterSizeInByte();
+            result.m_roofline = roofline<DeviceUsed, DataType>();
+            m_results.push_back(result);
+
+            print(result);
+
+            return true;
+        }
+
+        static void printHeader()
+        {
+            std::cout << std::left << std::setw(64) << "Benchmark" << std::right
+                      << std::setw(14) << "Time(us)" << std::setw(12) << "Iterations"
+                      << std::setw(11) << "GFLOP/s" << std::setw(9) << "GB/s"
+                      << std::setw(10) << "FLOP/B" << std::setw(10) << "Roofline" << std::endl;
+            std::cout << std::string(130, '-') << std::endl;
+        }
+
+        static void print(const BenchmarkResult &result)
+        {
+            std::cout << std::left << std::setw(64) << result.m_name << std::right << std::fixed
+                      << std::setw(14) << std::setprecision(2) << result.m_time
+                      << std::setw(12) << result.m_iterations
+                      << std::setw(11) << std::setprecision(2) << result.gflops()
+                      << std::setw(9) << std::setprecision(2) << result.gbs()
+                      << std::setw(10) << std::setprecision(2) << result.intensity()
+                      << std::setw(9) << std::setprecision(1) << result.rooflineFraction() * 100.0 << "%"
+                      << std::endl;
+        }
+
+        bool writeJSON() const
+        {
+            std::ofstream file(m_options.m_jsonFileName);
+
+            if (!file.is_open())
+            {
+                std::cerr << "can't open " << m_options.m_jsonFileName << std::endl;
+                return false;
+            }
+
+            file << std::setprecision(6);
+            file << "{\"context\":{\"threads\":" << m_options.m_threadCount << ",\"minTime\":" << m_options.m_minTime
+                 << ",\"rooflines\":{";
+
+            for (auto iter = m_rooflines.begin(); iter != m_rooflines.end(); ++iter)
+            {
+                file << (iter == m_rooflines.begin() ? "" : ",") << "\"" << iter->first << "\":{\"peakGFlops\":"
+                     << iter->second.m_peak << ",\"bandwidthGBs\":" << iter->second.m_bandwidth << "}";
+            }
+
+            file << "}},\n\"benchmarks\":[\n";
+
+            for (unsigned int i = 0; i < m_results.size(); ++i)
+            {
+                const BenchmarkResult &result = m_results[i];
+
+                file << "{\"name\":\"" << result.m_name << "\",\"operator\":\"" << result.m_operator
+                     << "\",\"device\":\"" << result.m_device << "\",\"dataType\":\"" << result.m_dataType
+                     << "\",\"shape\":\"" << result.m_shape << "\",\"iterations\":" << result.m_iterations
+                     << ",\"timeUs\":" << result.m_time << ",\"flops\":" << result.m_flops
+                     << ",\"bytes\":" << result.m_bytes << ",\"gflops\":" << result.gflops()
+                     << ",\"gbs\":" << result.gbs() << ",\"intensity\":" << result.intensity()
+                     << ",\"attainableGFlops\":" << result.m_roofline.attainable(result.intensity())
+                     << ",\"rooflineFraction\":" << result.rooflineFraction() << "}"
+                     << (i + 1 < m_results.size() ? "," : "") << "\n";
+            }
+
+            file << "]}\n";
+
+            return true;
+        }
+    };
+
+    template<FreeWill::DeviceType DeviceUsed, typename DataType>
+    void fill(FreeWill::Tensor<DeviceUsed, DataType> &tensor)
+    {
+        tensor.init();
+        tensor.randomize();
+    }
+
+    // one label per sample, below classCount
+    template<FreeWill::DeviceType DeviceUsed>
+    void fillLabel(FreeWill::Tensor<DeviceUsed, unsigned int> &label, unsigned int classCount)
+    {
+        label.init();
+
+        for (unsigned int i = 0; i < label.shape().size(); ++i)
+        {
+            label[i] = i % classCount;
+        }
+
+        if constexpr (DeviceUsed == FreeWill::DeviceType::GPU_CUDA)
+        {
+            label.copyFromHostToDevice();
+        }
+    }
+
+    struct ConvolutionShape
+    {
+        unsigned int m_channel;
+        unsigned int m_size;
+        unsigned int m_filterSize;
+        unsigned int m_filterCount;
+        unsigned int m_batchSize;
+        unsigned int m_padding;
+    };
+
+    // the first two of the MNIST convnet demo, then 3x3 layers of a small vgg-like net
+    const std::vector<ConvolutionShape> convolutionShapes = {{1, 28, 5, 20, 64, 0},
+                                                             {20, 12, 5, 50, 64, 0},
+                                                             {3, 32, 3, 32, 32, 1},
+                                                             {64, 16, 3, 64, 32, 1}};
+
+    template<FreeWill::DeviceType DeviceUsed, typename DataType>
+    void benchmarkConvolution(BenchmarkSuite &suite)
+    {
+        for (const ConvolutionShape &s : convolutionShapes)
+        {
+            unsigned int outputSize = s.m_size - s.m_filterSize + 1 + 2 * s.m_padding;
+            std::string shape = shapeName({s.m_channel, s.m_size, s.m_size, s.m_batchSize}) + "_"
+                    + shapeName({s.m_filterSize, s.m_filterSize, s.m_filterCount});
+
+            FreeWill::Tensor<DeviceUsed, DataType> input({s.m_channel, s.m_size, s.m_size, s.m_batchSize});
+            FreeWill::Tensor<DeviceUsed, DataType> featureMap({s.m_channel, s.m_filterSize, s.m_filterSize, s.m_filterCount});
+            FreeWill::Tensor<DeviceUsed, DataType> bias({s.m_filterCount});
+            FreeWill::Tensor<DeviceUsed, DataType> output({s.m_filterCount, outputSize, outputSize, s.m_batchSize});
+
+            if (suite.isSelected(suite.name<DeviceUsed, DataType>("Convolution", shape)))
+            {
+                fill(input);
+                fill(featureMap);
+                fill(bias);
+                output.init();
+
+                FreeWill::Convolution<DeviceUsed, DataType> convolution(1, 1, s.m_padding, s.m_padding);
+                convolution.setInputParameter("Input", &input);
+                convolution.setInputParameter("FeatureMap", &featureMap);
+                convolution.setInputParameter("Bias", &bias);
+                convolution.setOutputParameter("Output", &output);
+                suite.run<DeviceUsed, DataType>("Convolution", FreeWill::OperatorName::CONVOLUTION, shape, convolution);
+            }
+
+            if (suite.isSelected(suite.name<DeviceUsed, DataType>("ConvolutionDerivative", shape)))
+            {
+                FreeWill::Tensor<DeviceUsed, DataType> outputGrad({s.m_filterCount, outputSize, outputSize, s.m_batchSize});
+                FreeWill::Tensor<DeviceUsed, DataType> featureMapGrad({s.m_channel, s.m_filterSize, s.m_filterSize, s.m_filterCount});
+                FreeWill::Tensor<DeviceUsed, DataType> biasGrad({s.m_filterCount});
+                FreeWill::Tensor<DeviceUsed, DataType> inputGrad({s.m_channel, s.m_size, s.m_size, s.m_batchSize});
+                fill(input);
+                fill(featureMap);
+                fill(outputGrad);
+                featureMapGrad.init();
+                biasGrad.init();
+                inputGrad.init();
+
+                FreeWill::ConvolutionDerivative<DeviceUsed, DataType> convolutionDerivative(1, 1, s.m_padding, s.m_padding);
+                convolutionDerivative.setInputParameter("PrevActivation", &input);
+                convolutionDerivative.setInputParameter("OutputGrad", &outputGrad);
+                convolutionDerivative.setInputParameter("FeatureMap", &featureMap);
+                convolutionDerivative.setOutputParameter("FeatureMapGrad", &featureMapGrad);
+                convolutionDerivative.setOutputParameter("BiasGrad", &biasGrad);
+                convolutionDerivative.setOutputParameter("InputGrad", &inputGrad);
+                suite.run<DeviceUsed, DataType>("ConvolutionDerivative", FreeWill::OperatorName::CONVOLUTION_DERIVATIVE,
+                                                shape, convolutionDerivative);
+            }
+        }
+    }
+
+    // inputs, outputs and batch size: the layers of the MNIST demos, then a square one
+    const std::vector<std::vector<unsigned int>> dotProductShapes = {{784, 500, 64}, {800, 500, 64}, {500, 10, 64}, {1024, 1024, 64}};
+
+    template<FreeWill::DeviceType DeviceUsed, typename DataType>
+    void benchmarkDotProductWithBias(BenchmarkSuite &suite)
+    {
+        for (const std::vector<unsigned int> &s : dotProductShapes)
+        {
+            std::string shape = shapeName(s);
+            FreeWill::Tensor<DeviceUsed, DataType> input({s[0], s[2]});
+            FreeWill::Tensor<DeviceUsed, DataType> weight({s[1], s[0]});
+            FreeWill::Tensor<DeviceUsed, DataType> bias({s[1]});
+            FreeWill::Tensor<DeviceUsed, DataType> output({s[1], s[2]});
+
+            if (suite.isSelected(suite.name<DeviceUsed, DataType>("DotProductWithBias", shape)))
+            {
+                fill(input);
+                fill(weight);
+                fill(bias);
+                output.init();
+
+                FreeWill::DotProductWithBias<DeviceUsed, DataType> dotProductWithBias(true);
+                dotProductWithBias.setInputParameter("Input", &input);
+                dotProductWithBias.setInputParameter("Weight", &weight);
+                dotProductWithBias.setInputParameter("Bias", &bias);
+                dotProductWithBias.setOutputParameter("Output", &output);
+                suite.run<DeviceUsed, DataType>("DotProductWithBias", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                                                shape, dotProductWithBias);
+            }
+
+            if (suite.isSelected(suite.name<DeviceUsed, DataType>("DotProductWithBiasDerivative", shape)))
+            {
+                FreeWill::Tensor<DeviceUsed, DataType> outputDelta({s[1], s[2]});
+                FreeWill::Tensor<DeviceUsed, DataType> weightGrad({s[1], s[0]});
+                FreeWill::Tensor<DeviceUsed, DataType> biasGrad({s[1]});
+                FreeWill::Tensor<DeviceUsed, DataType> inputDelta({s[0], s[2]});
+                fill(input);
+                fill(weight);
+                fill(outputDelta);
+                weightGrad.init();
+                biasGrad.init();
+                inputDelta.init();
+
+                FreeWill::DotProductWithBiasDerivative<DeviceUsed, DataType> dotProductWithBiasDerivative(true);
+                dotProductWithBiasDerivative.setInputParameter("InputActivation", &input);
+                dotProductWithBiasDerivative.setInputParameter("OutputDelta", &outputDelta);
+                dotProductWithBiasDerivative.setInputParameter("Weight", &weight);
+                dotProductWithBiasDerivative.setOutputParameter("WeightGrad", &weightGrad);
+                dotProductWithBiasDerivative.setOutputParameter("BiasGrad", &biasGrad);
+                dotProductWithBiasDerivative.setOutputParameter("InputDelta", &inputDelta);
+                suite.run<DeviceUsed, DataType>("DotProductWithBiasDerivative", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS_DERIVATIVE,
+                                                shape, dotProductWithBiasDerivative);
+            }
+        }
+    }
+
+    // channels, pooled width and height, batch size
+    const std::vector<std::vector<unsigned int>> maxPoolingShapes = {{20, 12, 64}, {50, 4, 64}, {64, 16, 32}};
+
+    template<FreeWill::DeviceType DeviceUsed, typename DataType>
+    void benchmarkMaxPooling(BenchmarkSuite &suite)
+    {
+        for (const std::vector<unsigned int> &s : maxPoolingShapes)
+        {
+            std::string shape = shapeName({s[0], s[1] * 2, s[1] * 2, s[2]});
+            FreeWill::Tensor<DeviceUsed, DataType> input({s[0], s[1] * 2, s[1] * 2, s[2]});
+            FreeWill::Tensor<DeviceUsed, DataType> output({s[0], s[1], s[1], s[2]});
+            FreeWill::Tensor<DeviceUsed, unsigned int> switches(FreeWill::maxPoolingSwitchShape({s[0], s[1], s[1], s[2]}));
+            fill(input);
+            output.init();
+
+            // only the cpu keeps where the maxima were
+            if constexpr (DeviceUsed == FreeWill::DeviceType::CPU_NAIVE)
+            {
+                switches.init();
+            }
+
+            FreeWill::MaxPooling<DeviceUsed, DataType> maxPooling;
+            maxPooling.setInputParameter("Input", &input);
+            maxPooling.setOutputParameter("Output", &output);
+
+            if constexpr (DeviceUsed == FreeWill::DeviceType::CPU_NAIVE)
+            {
+                maxPooling.setOutputParameter("Switch", &switches);
+            }
+
+            if (suite.isSelected(suite.name<DeviceUsed, DataType>("MaxPooling", shape)))
+            {
+                suite.run<DeviceUsed, DataType>("MaxPooling", FreeWill::OperatorName::MAX_POOLING, shape, maxPooling);
+            }
+
+            if (suite.isSelected(suite.name<DeviceUsed, DataType>("MaxPoolingDerivative", shape)))
+            {
+                // the derivative routes the gradient through the maxima of a forward pass
+                if (!maxPooling.init())
+                {
+                    continue;
+                }
+
+                maxPooling.evaluate();
+
+                FreeWill::Tensor<DeviceUsed, DataType> outputGrad({s[0], s[1], s[1], s[2]});
+                FreeWill::Tensor<DeviceUsed, DataType> inputGrad({s[0], s[1] * 2, s[1] * 2, s[2]});
+                fill(outputGrad);
+                inputGrad.init();
+
+                FreeWill::MaxPoolingDerivative<DeviceUsed, DataType> maxPoolingDerivative;
+                maxPoolingDerivative.setInputParameter("OutputGrad", &outputGrad);
+                maxPoolingDerivative.setOutputParameter("InputGrad", &inputGrad);
+
+                if constexpr (DeviceUsed == FreeWill::DeviceType::CPU_NAIVE)
+                {
+                    maxPoolingDerivative.setInputParameter("Switch", &switches);
+                }
+                else
+                {
+                    maxPoolingDerivative.setInputParameter("Output", &output);
+                    maxPoolingDerivative.setInputParameter("Input", &input);
+                }
+
+                suite.run<DeviceUsed, DataType>("MaxPoolingDerivative", FreeWill::OperatorName::MAX_POOLING_DERIVATIVE,
+                                                shape, maxPoolingDerivative);
+            }
+        }
+    }
+
+    // neurons and batch size
+    const std::vector<std::vector<unsigned int>> elementwiseShapes = {{500, 64}, {4096, 256}};
+
+    template<FreeWill::ActivationMode ActivationModeUsed, FreeWill::DeviceType DeviceUsed, typename DataType>
+    void benchmarkActivation(BenchmarkSuite &suite, const std::string &modeName)
+    {
+        if (DeviceUsed == FreeWill::DeviceType::CPU_NAIVE && !FreeWill::isActivationImplementedCPU(ActivationModeUsed))
+        {
+            return;
+        }
+
+        for (const std::vector<unsigned int> &s : elementwiseShapes)
+        {
+            std::string shape = shapeName(s);
+            std::string activationName = "Activation" + modeName;
+            std::string derivativeName = "ActivationDerivative" + modeName;
+            FreeWill::Tensor<DeviceUsed, DataType> input({s[0], s[1]});
+            FreeWill::Tensor<DeviceUsed, DataType> output({s[0], s[1]});
+            fill(input);
+            output.init();
+
+            FreeWill::Activation<ActivationModeUsed, DeviceUsed, DataType> activation;
+            activation.setInputParameter("Input", &input);
+            activation.setOutputParameter("Output", &output);
+
+            if (suite.isSelected(suite.name<DeviceUsed, DataType>(activationName, shape)))
+            {
+                suite.run<DeviceUsed, DataType>(activationName, FreeWill::OperatorName::ACTIVATION, shape, activation);
+            }
+
+            if (suite.isSelected(suite.name<DeviceUsed, DataType>(derivativeName, shape)))
+            {
+                if (!activation.init())
+                {
+                    continue;
+                }
+
+                activation.evaluate();
+
+                FreeWill::Tensor<DeviceUsed, DataType> outputDelta({s[0], s[1]});
+                FreeWill::Tensor<DeviceUsed, DataType> inputDelta({s[0], s[1]});
+                fill(outputDelta);
+                inputDelta.init();
+
+                FreeWill::ActivationDerivative<ActivationModeUsed, DeviceUsed, DataType> activationDerivative;
+                activationDerivative.setInputParameter("Input", &input);
+                activationDerivative.setInputParameter("Output", &output);
+                activationDerivative.setInputParameter("OutputDelta", &outputDelta);
+                activationDerivative.setOutputParameter("InputDelta", &inputDelta);
+                suite.run<DeviceUsed, DataType>(derivativeName, FreeWill::OperatorName::ACTIVATION_DERIVATIVE,
+                                                shape, activationDerivative);
+            }
+        }
+    }
+
+    // classes and batch size
+    const std::vector<std::vector<unsigned int>> softmaxShapes = {{10, 64}, {1000, 64}};
+
+    template<FreeWill::DeviceType DeviceUsed, typename DataType>
+    void benchmarkSoftmaxLogLoss(BenchmarkSuite &suite)
+    {
+        for (const std::vector<unsigned int> &s : softmaxShapes)
+        {
+            std::string shape = shapeName(s);
+            FreeWill::Tensor<DeviceUsed, DataType> input({s[0], s[1]});
+            FreeWill::Tensor<DeviceUsed, unsigned int> label({1, s[1]});
+            FreeWill::Tensor<DeviceUsed, DataType> cost({1, s[1]});
+            FreeWill::Tensor<DeviceUsed, DataType> output({s[0], s[1]});
+            FreeWill::Tensor<DeviceUsed, DataType> inputGrad({s[0], s[1]});
+            fill(input);
+            fillLabel(label, s[0]);
+            cost.init();
+            output.init();
+            inputGrad.init();
+
+            FreeWill::SoftmaxLogLoss<DeviceUsed, DataType> softmaxLogLoss;
+            softmaxLogLoss.setInputParameter("Input", &input);
+            softmaxLogLoss.setInputParameter("Label", &label);
+            softmaxLogLoss.setOutputParameter("Cost", &cost);
+            softmaxLogLoss.setOutputParameter("Output", &output);
+
+            if (suite.isSelected(suite.name<DeviceUsed, DataType>("SoftmaxLogLoss", shape)))
+            {
+                suite.run<DeviceUsed, DataType>("SoftmaxLogLoss", FreeWill::OperatorName::SOFTMAX_LOG_LOSS, shape, softmaxLogLoss);
+            }
+
+            if (suite.isSelected(suite.name<DeviceUsed, DataType>("SoftmaxLogLossDerivative", shape)))
+            {
+                if (!softmaxLogLoss.init())
+                {
+                    continue;
+                }
+
+                softmaxLogLoss.evaluate();
+
+                FreeWill::SoftmaxLogLossDerivative<DeviceUsed, DataType> softmaxLogLossDerivative;
+                softmaxLogLossDerivative.setInputParameter("Output", &output);
+                softmaxLogLossDerivative.setInputParameter("Label", &label);
+                softmaxLogLossDerivative.setOutputParameter("InputGrad", &inputGrad);
+                suite.run<DeviceUsed, DataType>("SoftmaxLogLossDerivative", FreeWill::OperatorName::SOFTMAX_LOG_LOSS_DERIVATIVE,
+                                                shape, softmaxLogLossDerivative);
+            }
+
+            if (suite.isSelected(suite.name<DeviceUsed, DataType>("SoftmaxLogLossWithDerivative", shape)))
+            {
+                FreeWill::SoftmaxLogLossWithDerivative<DeviceUsed, DataType> softmaxLogLossWithDerivative;
+                softmaxLogLossWithDerivative.setInputParameter("Input", &input);
+                softmaxLogLossWithDerivative.setInputParameter("Label", &label);
+                softmaxLogLossWithDerivative.setOutputParameter("Cost", &cost);
+                softmaxLogLossWithDerivative.setOutputParameter("Output", &output);
+                softmaxLogLossWithDerivative.setOutputParameter("InputGrad", &inputGrad);
+                suite.run<DeviceUsed, DataType>("SoftmaxLogLossWithDerivative", FreeWill::OperatorName::SOFTMAX_LOG_LOSS_WITH_DERIVATIVE,
+                                                shape, softmaxLogLossWithDerivative);
+            }
+        }
+    }
+
+    template<FreeWill::DeviceType DeviceUsed, typename DataType>
+    void benchmarkElementwiseAdd(BenchmarkSuite &suite)
+    {
+        for (const std::vector<unsigned int> &s : elementwiseShapes)
+        {
+            std::string shape = shapeName(s);
+
+            if (!suite.isSelected(suite.name<DeviceUsed, DataType>("ElementwiseAdd", shape)))
+            {
+                continue;
+            }
+
+            FreeWill::Tensor<DeviceUsed, DataType> operandA({s[0], s[1]});
+            FreeWill::Tensor<DeviceUsed, DataType> operandB({s[0], s[1]});
+            FreeWill::Tensor<DeviceUsed, DataType> result({s[0], s[1]});
+            fill(operandA);
+            fill(operandB);
+            result.init();
+
+            FreeWill::ElementwiseAdd<DeviceUsed, DataType> elementwiseAdd;
+            elementwiseAdd.setInputParameter("OperandA", &operandA);
+            elementwiseAdd.setInputParameter("OperandB", &operandB);
+            elementwiseAdd.setOutputParameter("Result", &result);
+            suite.run<DeviceUsed, DataType>("ElementwiseAdd", FreeWill::OperatorName::ELEMENTWISE_ADD, shape, elementwiseAdd);
+        }
+    }
+
+    template<FreeWill::DeviceType DeviceUsed, typename DataType>
+    void benchmarkAll(BenchmarkSuite &suite)
+    {
+        benchmarkConvolution<DeviceUsed, DataType>(suite);
+        benchmarkDotProductWithBias<DeviceUsed, DataType>(suite);
+        benchmarkMaxPooling<DeviceUsed, DataType>(suite);
+        benchmarkActivation<FreeWill::ActivationMode::SIGMOID, DeviceUsed, DataType>(suite, "Sigmoid");
+        benchmarkActivation<FreeWill::ActivationMode::RELU, DeviceUsed, DataType>(suite, "ReLU");
+        benchmarkActivation<FreeWill::ActivationMode::TANH, DeviceUsed, DataType>(suite, "Tanh");
+        benchmarkActivation<FreeWill::ActivationMode::CLIPPED_RELU, DeviceUsed, DataType>(suite, "ClippedReLU");
+        benchmarkSoftmaxLogLoss<DeviceUsed, DataType>(suite);
+        benchmarkElementwiseAdd<DeviceUsed, DataType>(suite);
+    }
+
+    bool parseOptions(int argc, char *argv[], Options &options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string argument = argv[i];
+            bool hasValue = i + 1 < argc;
+
+            if (argument == "--cpu-only")
+            {
+                options.m_isGPUEnabled = false;
+            }
+            else if (argument == "--gpu-only")
+            {
+                options.m_isCPUEnabled = false;
+            }
+            else if (argument == "--filter" && hasValue)
+            {
+                options.m_filter = argv[++i];
+            }
+            else if (argument == "--min-time" && hasValue)
+            {
+                options.m_minTime = std::atof(argv[++i]) * 1.0e-3;
+            }
+            else if (argument == "--threads" && hasValue)
+            {
+                options.m_threadCount = std::atoi(argv[++i]);
+            }
+            else if (argument == "--json" && hasValue)
+            {
+                options.m_jsonFileName = argv[++i];
+            }
+            else if (argument == "--cpu-peak" && hasValue)
+            {
+                options.m_cpuPeak = std::atof(argv[++i]);
+            }
+            else if (argument == "--cpu-bandwidth" && hasValue)
+            {
+                options.m_cpuBandwidth = std::atof(argv[++i]);
+            }
+            else if (argument == "--gpu-peak" && hasValue)
+            {
+                options.m_gpuPeak = std::atof(argv[++i]);
+            }
+            else if (argument == "--gpu-bandwidth" && hasValue)
+            {
+                options.m_gpuBandwidth = std::atof(argv[++i]);
+            }
+            else
+            {
+                std::cerr << "unknown option " << argument << std::endl;
+                std::cerr << "usage: FreeWillBenchmark [--cpu-only] [--gpu-only] [--filter <text>] [--min-time <ms>] "
+                             "[--threads <count>] [--json <file>] [--cpu-peak <GFLOP/s>] [--cpu-bandwidth <GB/s>] "
+                             "[--gpu-peak <GFLOP/s>] [--gpu-bandwidth <GB/s>]" << std::endl;
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+
+    if (!parseOptions(argc, argv, options))
+    {
+        return 1;
+    }
+
+    if (options.m_threadCount)
+    {
+        FreeWill::ThreadPool::getSingleton().open(options.m_threadCount);
+    }
+
+    int gpuCount = 0;
+
+    if (options.m_isGPUEnabled && (cudaGetDeviceCount(&gpuCount) != cudaSuccess || gpuCount == 0))
+    {
+        std::cerr << "no gpu found, the gpu benchmarks are skipped" << std::endl;
+        options.m_isGPUEnabled = false;
+    }
+
+    BenchmarkSuite suite(options);
+    BenchmarkSuite::printHeader();
+
+    if (options.m_isCPUEnabled)
+    {
+        benchmarkAll<FreeWill::DeviceType::CPU_NAIVE, float>(suite);
+        benchmarkAll<FreeWill::DeviceType::CPU_NAIVE, double>(suite);
+    }
+
+    if (options.m_isGPUEnabled)
+    {
+        FreeWill::Context<FreeWill::DeviceType::GPU_CUDA>::getSingleton().open();
+        RUN_CUDA(cudaSetDevice(0));
+
+        benchmarkAll<FreeWill::DeviceType::GPU_CUDA, float>(suite);
+        benchmarkAll<FreeWill::DeviceType::GPU_CUDA, double>(suite);
+
+        FreeWill::Context<FreeWill::DeviceType::GPU_CUDA>::getSingleton().close();
+    }
+
+    std::cout << std::endl;
+
+    for (auto iter = suite.rooflines().begin(); iter != suite.rooflines().end(); ++iter)
+    {
+        std::cout << "roofline " << iter->first << ": " << std::fixed << std::setprecision(1)
+                  << iter->second.m_peak << " GFLOP/s, " << iter->second.m_bandwidth << " GB/s" << std::endl;
+    }
+
+    FreeWill::ThreadPool::getSingleton().close();
+
+    return suite.writeJSON() ? 0 : 1;
+}
@@ -0,0 +1,685 @@
+#include "Model/Model.h"
+#include "Model/Solver.h"
+#include "Context/Context.h"
+#include "Tensor/BlobAllocator.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Trains whole graphs on synthetic data and reports images per second, the distribution
+// of the step time and the peak memory, once per device count, for scaling curves. The
+// graphs are the fully connected net and the convnet of the MNIST demos, a small vgg-like
+// net on 32x32 color images and a sweep of multi-layer perceptrons of growing width.
+//
+// A step is what the demos do per batch: scatter the global batch over the devices,
+// forward, clear the gradients, backward and update. The first steps warm up the
+// allocator caches and the algorithm searches and are not timed.
+//
+// FreeWillTrainingBenchmark [--cpu-only] [--gpu-only] [--model <text>] [--batch <size>]
+//                           [--warmup <steps>] [--steps <steps>] [--devices <1,2,4...>]
+//                           [--json <file>]
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    struct Options
+    {
+        bool m_isCPUEnabled = true;
+        bool m_isGPUEnabled = true;
+        std::string m_modelFilter;
+        // per device
+        unsigned int m_batchSize = 32;
+        unsigned int m_warmupStepCount = 5;
+        unsigned int m_stepCount = 50;
+        // powers of two up to all cores or gpus, and all of them, when empty
+        std::vector<unsigned int> m_deviceCounts;
+        std::string m_jsonFileName = "training_benchmark.json";
+    };
+
+    struct RunResult
+    {
+        std::string m_model;
+        std::string m_device;
+        unsigned int m_deviceCount = 0;
+        unsigned int m_batchSize = 0;
+        unsigned int m_stepCount = 0;
+        double m_imagesPerSecond = 0.0;
+        // milliseconds
+        double m_stepMean = 0.0;
+        double m_stepMin = 0.0;
+        double m_stepP50 = 0.0;
+        double m_stepP90 = 0.0;
+        double m_stepP99 = 0.0;
+        double m_stepMax = 0.0;
+        size_t m_peakHostSizeInByte = 0;
+        size_t m_peakDeviceSizeInByte = 0;
+        // images per second over deviceCount times the single device's, 0 without that run
+        double m_scalingEfficiency = 0.0;
+    };
+
+    // Appends layers to a model and keeps their backward operators, gradients and weight
+    // update pairs, so a graph is written down once in forward order.
+    class GraphBuilder
+    {
+    private:
+        FreeWill::Model *m_model;
+        unsigned int m_layerCount;
+        FreeWill::TensorDescriptorHandle m_image;
+        FreeWill::TensorDescriptorHandle m_label;
+        FreeWill::TensorDescriptorHandle m_current;
+        FreeWill::TensorDescriptorHandle m_currentGrad;
+        std::vector<unsigned int> m_shape;
+        std::vector<FreeWill::OperatorDescriptorHandle> m_forwardPath;
+        // per layer, the layers are walked back to front
+        std::vector<std::vector<FreeWill::OperatorDescriptorHandle>> m_backwardLayers;
+        std::vector<std::pair<FreeWill::TensorDescriptorHandle, FreeWill::TensorDescriptorHandle>> m_weightUpdatePairs;
+        std::vector<FreeWill::TensorDescriptorHandle> m_gradients;
+
+        std::string layerName(const std::string &name) const
+        {
+            return "layer" + std::to_string(m_layerCount) + name;
+        }
+
+        static FreeWill::Shape toShape(const std::vector<unsigned int> &sizes)
+        {
+            return FreeWill::Shape(sizes.data(), sizes.size());
+        }
+
+        static unsigned int elementCount(const std::vector<unsigned int> &sizes)
+        {
+            unsigned int count = 1;
+
+            for (unsigned int size : sizes)
+            {
+                count *= size;
+            }
+
+            return count;
+        }
+
+        FreeWill::TensorDescriptorHandle addBatchTensor(const std::string &name, const std::vector<unsigned int> &sizes,
+                                                        FreeWill::DataType dataType = FreeWill::DataType::FLOAT)
+        {
+            return m_model->addTensor(name, toShape(sizes), dataType).enableBatch();
+        }
+
+        FreeWill::TensorDescriptorHandle addGradient(const std::string &name, const std::vector<unsigned int> &sizes, bool isBatchTensor)
+        {
+            FreeWill::TensorDescriptorHandle gradient = isBatchTensor ? addBatchTensor(name, sizes) : m_model->addTensor(name, toShape(sizes));
+            m_gradients.push_back(gradient);
+
+            return gradient;
+        }
+
+        void setCurrent(FreeWill::TensorDescriptorHandle current, FreeWill::TensorDescriptorHandle currentGrad,
+                        const std::vector<unsigned int> &shape)
+        {
+            m_current = current;
+            m_currentGrad = currentGrad;
+            m_shape = shape;
+            ++m_layerCount;
+        }
+
+    public:
+        GraphBuilder(FreeWill::Model *model, const std::vector<unsigned int> &imageShape)
+            :m_model(model),
+              m_layerCount(0),
+              m_image(model->addTensor("image", toShape(imageShape)).enableBatch()),
+              m_label(model->addTensor("label", {1}, FreeWill::DataType::UNSIGNED_INT).enableBatch()),
+              m_current(m_image),
+              m_currentGrad(),
+              m_shape(imageShape),
+              m_forwardPath(),
+              m_backwardLayers(),
+              m_weightUpdatePairs(),
+              m_gradients()
+        {
+            m_currentGrad = addGradient("imageGrad", imageShape, true);
+        }
+
+        const FreeWill::TensorDescriptorHandle &image() const
+        {
+            return m_image;
+        }
+
+        const FreeWill::TensorDescriptorHandle &label() const
+        {
+            return m_label;
+        }
+
+        const std::vector<FreeWill::TensorDescriptorHandle> &gradients() const
+        {
+            return m_gradients;
+        }
+
+        void convolution(unsigned int filterCount, unsigned int filterSize, unsigned int padding)
+        {
+            unsigned int channel = m_shape[0];
+            unsigned int width = m_shape[1] - filterSize + 1 + 2 * padding;
+            unsigned int height = m_shape[2] - filterSize + 1 + 2 * padding;
+            std::vector<unsigned int> outputShape = {filterCount, width, height};
+
+            FreeWill::TensorDescriptorHandle featureMap = m_model->addTensor(layerName("FeatureMap"), {channel, filterSize, filterSize, filterCount}).randomize();
+            FreeWill::TensorDescriptorHandle bias = m_model->addTensor(layerName("Bias"), {filterCount}).randomize();
+            FreeWill::TensorDescriptorHandle output = addBatchTensor(layerName("Output"), outputShape);
+            FreeWill::TensorDescriptorHandle featureMapGrad = addGradient(layerName("FeatureMapGrad"), {channel, filterSize, filterSize, filterCount}, false);
+            FreeWill::TensorDescriptorHandle biasGrad = addGradient(layerName("BiasGrad"), {filterCount}, false);
+            FreeWill::TensorDescriptorHandle outputGrad = addGradient(layerName("OutputGrad"), outputShape, true);
+
+            std::map<std::string, std::any> parameters = {{"ZeroPaddingX", padding}, {"ZeroPaddingY", padding}};
+
+            m_forwardPath.push_back(m_model->addOperator(layerName("Convolution"), FreeWill::OperatorName::CONVOLUTION,
+                                    {{"Input", m_current}, {"FeatureMap", featureMap}, {"Bias", bias}}, {{"Output", output}}, parameters));
+            m_backwardLayers.push_back({m_model->addOperator(layerName("ConvolutionDerivative"), FreeWill::OperatorName::CONVOLUTION_DERIVATIVE,
+                                        {{"PrevActivation", m_current}, {"FeatureMap", featureMap}, {"OutputGrad", outputGrad}},
+                                        {{"FeatureMapGrad", featureMapGrad}, {"BiasGrad", biasGrad}, {"InputGrad", m_currentGrad}}, parameters)});
+            m_weightUpdatePairs.push_back({featureMap, featureMapGrad});
+            m_weightUpdatePairs.push_back({bias, biasGrad});
+
+            setCurrent(output, outputGrad, outputShape);
+        }
+
+        // in place, like the demos
+        void activation(FreeWill::ActivationMode mode)
+        {
+            m_forwardPath.push_back(m_model->addOperator(layerName("Activation"), FreeWill::OperatorName::ACTIVATION,
+                                    {{"Input", m_current}}, {{"Output", m_current}}, {{"Mode", mode}}));
+            m_backwardLayers.push_back({m_model->addOperator(layerName("ActivationDerivative"), FreeWill::OperatorName::ACTIVATION_DERIVATIVE,
+                                        {{"Output", m_current}, {"OutputDelta", m_currentGrad}}, {{"InputDelta", m_currentGrad}}, {{"Mode", mode}})});
+
+            setCurrent(m_current, m_currentGrad, m_shape);
+        }
+
+        void maxPooling()
+        {
+            std::vector<unsigned int> outputShape = {m_shape[0], m_shape[1] / 2, m_shape[2] / 2};
+
+            FreeWill::TensorDescriptorHandle output = addBatchTensor(layerName("Output"), outputShape);
+            FreeWill::TensorDescriptorHandle switches = addBatchTensor(layerName("Switch"), {FreeWill::maxPoolingSwitchShape({outputShape[0], outputShape[1], outputShape[2]})[0]},
+                                                                       FreeWill::DataType::UNSIGNED_INT);
+            FreeWill::TensorDescriptorHandle outputGrad = addGradient(layerName("OutputGrad"), outputShape, true);
+
+            // the cpu routes the gradient by the switches, cudnn by the input and output
+            m_forwardPath.push_back(m_model->addOperator(layerName("MaxPooling"), FreeWill::OperatorName::MAX_POOLING,
+                                    {{"Input", m_current}}, {{"Output", output}, {"Switch", switches}}));
+            m_backwardLayers.push_back({m_model->addOperator(layerName("MaxPoolingDerivative"), FreeWill::OperatorName::MAX_POOLING_DERIVATIVE,
+                                        {{"OutputGrad", outputGrad}, {"Switch", switches}, {"Output", output}, {"Input", m_current}},
+                                        {{"InputGrad", m_currentGrad}})});
+
+            setCurrent(output, outputGrad, outputShape);
+        }
+
+        void fullyConnected(unsigned int outputSize)
+        {
+            unsigned int inputSize = elementCount(m_shape);
+            FreeWill::TensorDescriptorHandle input = m_current.reshape({inputSize});
+            FreeWill::TensorDescriptorHandle inputGrad = m_currentGrad.reshape({inputSize});
+
+            FreeWill::TensorDescriptorHandle weight = m_model->addTensor(layerName("Weight"), {outputSize, inputSize}).randomize();
+            FreeWill::TensorDescriptorHandle bias = m_model->addTensor(layerName("Bias"), {outputSize}).randomize();
+            FreeWill::TensorDescriptorHandle output = addBatchTensor(layerName("Output"), {outputSize});
+            FreeWill::TensorDescriptorHandle weightGrad = addGradient(layerName("WeightGrad"), {outputSize, inputSize}, false);
+            FreeWill::TensorDescriptorHandle biasGrad = addGradient(layerName("BiasGrad"), {outputSize}, false);
+            FreeWill::TensorDescriptorHandle outputGrad = addGradient(layerName("OutputGrad"), {outputSize}, true);
+
+            m_forwardPath.push_back(m_model->addOperator(layerName("FullyConnected"), FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                                    {{"Input", input}, {"Weight", weight}, {"Bias", bias}}, {{"Output", output}}));
+            m_backwardLayers.push_back({m_model->addOperator(layerName("FullyConnectedDerivative"), FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS_DERIVATIVE,
+                                        {{"InputActivation", input}, {"OutputDelta", outputGrad}, {"Weight", weight}},
+                                        {{"InputDelta", inputGrad}, {"BiasGrad", biasGrad}, {"WeightGrad", weightGrad}})});
+            m_weightUpdatePairs.push_back({weight, weightGrad});
+            m_weightUpdatePairs.push_back({bias, biasGrad});
+
+            setCurrent(output, outputGrad, {outputSize});
+        }
+
+        // the loss over the current layer's outputs as classes, ends the graph
+        void softmaxLogLoss()
+        {
+            FreeWill::TensorDescriptorHandle output = addBatchTensor(layerName("Output"), m_shape);
+            FreeWill::TensorDescriptorHandle cost = addBatchTensor(layerName("Cost"), {1});
+
+            m_forwardPath.push_back(m_model->addOperator(layerName("SoftmaxLogLoss"), FreeWill::OperatorName::SOFTMAX_LOG_LOSS,
+                                    {{"Input", m_current}, {"Label", m_label}}, {{"Output", output}, {"Cost", cost}}));
+            m_backwardLayers.push_back({m_model->addOperator(layerName("SoftmaxLogLossDerivative"), FreeWill::OperatorName::SOFTMAX_LOG_LOSS_DERIVATIVE,
+                                        {{"Output", output}, {"Label", m_label}}, {{"InputGrad", m_currentGrad}})});
+
+            std::vector<FreeWill::OperatorDescriptorHandle> backwardPath;
+
+            for (auto layer = m_backwardLayers.rbegin(); layer != m_backwardLayers.rend(); ++layer)
+            {
+                backwardPath.insert(backwardPath.end(), layer->begin(), layer->end());
+            }
+
+            m_model->defineForwardPath(m_forwardPath);
+            m_model->defineBackwardPath(backwardPath);
+            m_model->defineWeightUpdatePairs(m_weightUpdatePairs);
+        }
+    };
+
+    struct ModelDefinition
+    {
+        std::string m_name;
+        std::vector<unsigned int> m_imageShape;
+        unsigned int m_classCount;
+        std::function<void(GraphBuilder &)> m_build;
+    };
+
+    std::vector<ModelDefinition> modelDefinitions()
+    {
+        std::vector<ModelDefinition> definitions;
+
+        // MNISTFullyConnectedCPUModel.cpp
+        definitions.push_back({"MNISTFullyConnected", {28 * 28}, 10, [](GraphBuilder &builder)
+        {
+            builder.fullyConnected(100);
+            builder.activation(FreeWill::ActivationMode::SIGMOID);
+            builder.fullyConnected(10);
+            builder.softmaxLogLoss();
+        }});
+
+        // MNISTConvNetCPUModel.cpp
+        definitions.push_back({"MNISTConvNet", {1, 28, 28}, 10, [](GraphBuilder &builder)
+        {
+            builder.convolution(20, 5, 0);
+            builder.activation(FreeWill::ActivationMode::SIGMOID);
+            builder.maxPooling();
+            builder.fullyConnected(100);
+            builder.activation(FreeWill::ActivationMode::SIGMOID);
+            builder.fullyConnected(10);
+            builder.softmaxLogLoss();
+        }});
+
+        definitions.push_back({"VGG", {3, 32, 32}, 10, [](GraphBuilder &builder)
+        {
+            for (unsigned int filterCount : {32u, 64u})
+            {
+                builder.convolution(filterCount, 3, 1);
+                builder.activation(FreeWill::ActivationMode::RELU);
+                builder.convolution(filterCount, 3, 1);
+                builder.activation(FreeWill::ActivationMode::RELU);
+                builder.maxPooling();
+            }
+
+            builder.fullyConnected(256);
+            builder.activation(FreeWill::ActivationMode::RELU);
+            builder.fullyConnected(10);
+            builder.softmaxLogLoss();
+        }});
+
+        for (unsigned int width : {256u, 1024u, 4096u})
+        {
+            definitions.push_back({"MLP" + std::to_string(width), {28 * 28}, 10, [width](GraphBuilder &builder)
+            {
+                for (unsigned int layer = 0; layer < 3; ++layer)
+                {
+                    builder.fullyConnected(width);
+                    builder.activation(FreeWill::ActivationMode::RELU);
+                }
+
+                builder.fullyConnected(10);
+                builder.softmaxLogLoss();
+            }});
+        }
+
+        return definitions;
+    }
+
+    double percentile(const std::vector<double> &sorted, double fraction)
+    {
+        if (sorted.empty())
+        {
+            return 0.0;
+        }
+
+        return sorted[std::min(sorted.size() - 1, (size_t) (fraction * sorted.size()))];
+    }
+
+    template<FreeWill::DeviceType DeviceUsed>
+    void synchronizeDevices(unsigned int deviceCount)
+    {
+        if constexpr (DeviceUsed == FreeWill::DeviceType::GPU_CUDA)
+        {
+            for (unsigned int d = 0; d < deviceCount; ++d)
+            {
+                RUN_CUDA(cudaSetDevice(d));
+                RUN_CUDA(cudaDeviceSynchronize());
+            }
+
+            RUN_CUDA(cudaSetDevice(0));
+        }
+    }
+
+    template<FreeWill::DeviceType DeviceUsed>
+    bool runModel(const ModelDefinition &definition, unsigned int deviceCount, const Options &options, RunResult &result)
+    {
+        FreeWill::Context<DeviceUsed>::getSingleton().open(deviceCount);
+        // what is still held from before doesn't count for this run
+        FreeWill::BlobAllocator &allocator = FreeWill::BlobAllocator::getSingleton();
+        allocator.resetPeakSizes();
+        size_t hostBaseline = allocator.hostSizeInByte();
+        size_t deviceBaseline = allocator.deviceSizeInByte();
+
+        FreeWill::Model *model = FreeWill::Model::create();
+        GraphBuilder builder(model, definition.m_imageShape);
+        definition.m_build(builder);
+
+        FreeWill::Solver solver;
+        solver.m_deviceUsed = DeviceUsed;
+        solver.m_batchSize = options.m_batchSize;
+
+        if (!solver.init(model))
+        {
+            std::cerr << "can't init the solver for " << definition.m_name << std::endl;
+            delete model;
+            FreeWill::Context<DeviceUsed>::getSingleton().close();
+            return false;
+        }
+
+        // one global batch of noise, fed again every step
+        unsigned int globalBatchSize = options.m_batchSize * deviceCount;
+        unsigned int imageSize = 1;
+
+        for (unsigned int size : definition.m_imageShape)
+        {
+            imageSize *= size;
+        }
+
+        std::vector<float> images((size_t) imageSize * globalBatchSize);
+        std::vector<unsigned int> labels(globalBatchSize);
+        std::mt19937 generator(0);
+        std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+
+        for (float &value : images)
+        {
+            value = distribution(generator);
+        }
+
+        for (unsigned int i = 0; i < globalBatchSize; ++i)
+        {
+            labels[i] = generator() % definition.m_classCount;
+        }
+
+        const double learningRate = -0.01 / globalBatchSize;
+        std::vector<double> stepTimes;
+        double timedSeconds = 0.0;
+
+        for (unsigned int step = 0; step < options.m_warmupStepCount + options.m_stepCount; ++step)
+        {
+            Clock::time_point begin = Clock::now();
+
+            float *imageData = model->beginScatterData<DeviceUsed, float>(builder.image());
+            std::copy(images.begin(), images.end(), imageData);
+            model->endMutateData<DeviceUsed>(builder.image());
+
+            unsigned int *labelData = model->beginScatterData<DeviceUsed, unsigned int>(builder.label());
+            std::copy(labels.begin(), labels.end(), labelData);
+            model->endMutateData<DeviceUsed>(builder.label());
+
+            solver.forward(model);
+
+            for (const FreeWill::TensorDescriptorHandle &gradient : builder.gradients())
+            {
+                model->clearTensor<DeviceUsed>(gradient);
+            }
+
+            solver.backward(model);
+            solver.update(learningRate);
+            synchronizeDevices<DeviceUsed>(deviceCount);
+
+            double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+            if (step >= options.m_warmupStepCount)
+            {
+                stepTimes.push_back(seconds * 1.0e3);
+                timedSeconds += seconds;
+            }
+        }
+
+        std::sort(stepTimes.begin(), stepTimes.end());
+
+        result.m_model = definition.m_name;
+        result.m_device = DeviceUsed == FreeWill::DeviceType::GPU_CUDA ? "GPU_CUDA" : "CPU_NAIVE";
+        result.m_deviceCount = deviceCount;
+        result.m_batchSize = options.m_batchSize;
+        result.m_stepCount = options.m_stepCount;
+        result.m_imagesPerSecond = timedSeconds > 0.0 ? (double) globalBatchSize * options.m_stepCount / timedSeconds : 0.0;
+        result.m_stepMean = stepTimes.empty() ? 0.0 : timedSeconds * 1.0e3 / stepTimes.size();
+        result.m_stepMin = stepTimes.empty() ? 0.0 : stepTimes.front();
+        result.m_stepP50 = percentile(stepTimes, 0.5);
+        result.m_stepP90 = percentile(stepTimes, 0.9);
+        result.m_stepP99 = percentile(stepTimes, 0.99);
+        result.m_stepMax = stepTimes.empty() ? 0.0 : stepTimes.back();
+        result.m_peakHostSizeInByte = allocator.peakHostSizeInByte() - hostBaseline;
+        result.m_peakDeviceSizeInByte = allocator.peakDeviceSizeInByte() - deviceBaseline;
+
+        delete model;
+        FreeWill::Context<DeviceUsed>::getSingleton().close();
+
+        return true;
+    }
+
+    // counts given for the cpu may oversubscribe the cores, there are only so many gpus
+    std::vector<unsigned int> deviceCounts(const Options &options, unsigned int availableCount, bool isGPU)
+    {
+        std::vector<unsigned int> counts;
+
+        if (!options.m_deviceCounts.empty())
+        {
+            for (unsigned int count : options.m_deviceCounts)
+            {
+                if (!isGPU || count <= availableCount)
+                {
+                    counts.push_back(count);
+                }
+            }
+
+            return counts;
+        }
+
+        for (unsigned int count = 1; count < availableCount; count *= 2)
+        {
+            counts.push_back(count);
+        }
+
+        counts.push_back(availableCount);
+
+        return counts;
+    }
+
+    void printHeader()
+    {
+        std::cout << std::left << std::setw(22) << "Model" << std::setw(11) << "Device" << std::right
+                  << std::setw(8) << "Devices" << std::setw(7) << "Batch" << std::setw(13) << "Images/s"
+                  << std::setw(10) << "Scaling" << std::setw(10) << "Mean(ms)" << std::setw(10) << "P50(ms)"
+                  << std::setw(10) << "P90(ms)" << std::setw(10) << "P99(ms)" << std::setw(11) << "Host(MB)"
+                  << std::setw(12) << "Device(MB)" << std::endl;
+        std::cout << std::string(134, '-') << std::endl;
+    }
+
+    void print(const RunResult &result)
+    {
+        std::cout << std::left << std::setw(22) << result.m_model << std::setw(11) << result.m_device << std::right
+                  << std::fixed << std::setw(8) << result.m_deviceCount << std::setw(7) << result.m_batchSize
+                  << std::setw(13) << std::setprecision(1) << result.m_imagesPerSecond
+                  << std::setw(9) << std::setprecision(1) << result.m_scalingEfficiency * 100.0 << "%"
+                  << std::setw(10) << std::setprecision(3) << result.m_stepMean
+                  << std::setw(10) << result.m_stepP50 << std::setw(10) << result.m_stepP90 << std::setw(10) << result.m_stepP99
+                  << std::setw(11) << std::setprecision(1) << result.m_peakHostSizeInByte / (1024.0 * 1024.0)
+                  << std::setw(12) << result.m_peakDeviceSizeInByte / (1024.0 * 1024.0) << std::endl;
+    }
+
+    bool writeJSON(const Options &options, const std::vector<RunResult> &results)
+    {
+        std::ofstream file(options.m_jsonFileName);
+
+        if (!file.is_open())
+        {
+            std::cerr << "can't open " << options.m_jsonFileName << std::endl;
+            return false;
+        }
+
+        file << std::setprecision(6);
+        file << "{\"context\":{\"batchSize\":" << options.m_batchSize << ",\"warmupSteps\":" << options.m_warmupStepCount
+             << ",\"steps\":" << options.m_stepCount << ",\"hardwareConcurrency\":" << std::thread::hardware_concurrency()
+             << "},\n\"runs\":[\n";
+
+        for (unsigned int i = 0; i < results.size(); ++i)
+        {
+            const RunResult &result = results[i];
+
+            file << "{\"model\":\"" << result.m_model << "\",\"device\":\"" << result.m_device
+                 << "\",\"deviceCount\":" << result.m_deviceCount << ",\"batchSize\":" << result.m_batchSize
+                 << ",\"steps\":" << result.m_stepCount << ",\"imagesPerSecond\":" << result.m_imagesPerSecond
+                 << ",\"scalingEfficiency\":" << result.m_scalingEfficiency
+                 << ",\"stepMs\":{\"mean\":" << result.m_stepMean << ",\"min\":" << result.m_stepMin
+                 << ",\"p50\":" << result.m_stepP50 << ",\"p90\":" << result.m_stepP90 << ",\"p99\":" << result.m_stepP99
+                 << ",\"max\":" << result.m_stepMax << "},\"peakHostBytes\":" << result.m_peakHostSizeInByte
+                 << ",\"peakDeviceBytes\":" << result.m_peakDeviceSizeInByte << "}"
+                 << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+
+        file << "]}\n";
+
+        return true;
+    }
+
+    template<FreeWill::DeviceType DeviceUsed>
+    void runAll(const Options &options, unsigned int availableCount, std::vector<RunResult> &results)
+    {
+        for (const ModelDefinition &definition : modelDefinitions())
+        {
+            if (!options.m_modelFilter.empty() && definition.m_name.find(options.m_modelFilter) == std::string::npos)
+            {
+                continue;
+            }
+
+            double singleDeviceImagesPerSecond = 0.0;
+
+            for (unsigned int deviceCount : deviceCounts(options, availableCount, DeviceUsed == FreeWill::DeviceType::GPU_CUDA))
+            {
+                RunResult result;
+
+                if (!runModel<DeviceUsed>(definition, deviceCount, options, result))
+                {
+                    continue;
+                }
+
+                if (deviceCount == 1)
+                {
+                    singleDeviceImagesPerSecond = result.m_imagesPerSecond;
+                }
+
+                if (singleDeviceImagesPerSecond > 0.0)
+                {
+                    result.m_scalingEfficiency = result.m_imagesPerSecond / (singleDeviceImagesPerSecond * deviceCount);
+                }
+
+                print(result);
+                results.push_back(result);
+            }
+        }
+    }
+
+    bool parseOptions(int argc, char *argv[], Options &options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string argument = argv[i];
+            bool hasValue = i + 1 < argc;
+
+            if (argument == "--cpu-only")
+            {
+                options.m_isGPUEnabled = false;
+            }
+            else if (argument == "--gpu-only")
+            {
+                options.m_isCPUEnabled = false;
+            }
+            else if (argument == "--model" && hasValue)
+            {
+                options.m_modelFilter = argv[++i];
+            }
+            else if (argument == "--batch" && hasValue)
+            {
+                options.m_batchSize = std::max(1, std::atoi(argv[++i]));
+            }
+            else if (argument == "--warmup" && hasValue)
+            {
+                options.m_warmupStepCount = std::atoi(argv[++i]);
+            }
+            else if (argument == "--steps" && hasValue)
+            {
+                options.m_stepCount = std::max(1, std::atoi(argv[++i]));
+            }
+            else if (argument == "--devices" && hasValue)
+            {
+                std::stringstream stream(argv[++i]);
+                std::string count;
+
+                while (std::getline(stream, count, ','))
+                {
+                    if (std::atoi(count.c_str()) > 0)
+                    {
+                        options.m_deviceCounts.push_back(std::atoi(count.c_str()));
+                    }
+                }
+            }
+            else if (argument == "--json" && hasValue)
+            {
+                options.m_jsonFileName = argv[++i];
+            }
+            else
+            {
+                std::cerr << "unknown option " << argument << std::endl;
+                std::cerr << "usage: FreeWillTrainingBenchmark [--cpu-only] [--gpu-only] [--model <text>] [--batch <size>] "
+                             "[--warmup <steps>] [--steps <steps>] [--devices <1,2,4...>] [--json <file>]" << std::endl;
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+
+    if (!parseOptions(argc, argv, options))
+    {
+        return 1;
+    }
+
+    int gpuCount = 0;
+
+    if (options.m_isGPUEnabled && (cudaGetDeviceCount(&gpuCount) != cudaSuccess || gpuCount == 0))
+    {
+        std::cerr << "no gpu found, the gpu runs are skipped" << std::endl;
+        options.m_isGPUEnabled = false;
+    }
+
+    std::vector<RunResult> results;
+    printHeader();
+
+    if (options.m_isCPUEnabled)
+    {
+        runAll<FreeWill::DeviceType::CPU_NAIVE>(options, std::max(1u, std::thread::hardware_concurrency()), results);
+    }
+
+    if (options.m_isGPUEnabled)
+    {
+        runAll<FreeWill::DeviceType::GPU_CUDA>(options, gpuCount, results);
+    }
+
+    return writeJSON(options, results) ? 0 : 1;
+}
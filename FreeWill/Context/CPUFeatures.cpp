@@ -0,0 +1,97 @@
+#include "CPUFeatures.h"
+
+#if defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#ifndef HWCAP_SVE
+#define HWCAP_SVE (1 << 22)
+#endif
+#endif
+
+FreeWill::CPUFeatures::CPUFeatures()
+    :m_hasAVX2(false),
+      m_hasAVX512(false),
+      m_hasNEON(false),
+      m_hasSVE(false),
+      m_instructionSet(CPUInstructionSet::BASELINE)
+{
+    detect();
+    m_instructionSet = bestInstructionSet();
+}
+
+void FreeWill::CPUFeatures::detect()
+{
+#if defined(__x86_64__)
+    // libgcc also checks with xgetbv that the os saves the wider registers
+    __builtin_cpu_init();
+
+    m_hasAVX2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    m_hasAVX512 = m_hasAVX2 && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+            __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512vl");
+#elif defined(__aarch64__)
+    // Advanced SIMD is part of armv8-a
+    m_hasNEON = true;
+#if defined(__linux__)
+    m_hasSVE = (getauxval(AT_HWCAP) & HWCAP_SVE) != 0;
+#endif
+#endif
+}
+
+bool FreeWill::CPUFeatures::isSupported(CPUInstructionSet instructionSet) const
+{
+    switch (instructionSet)
+    {
+    case CPUInstructionSet::BASELINE:
+        return true;
+#if defined(__x86_64__)
+    case CPUInstructionSet::AVX2:
+        return m_hasAVX2;
+    case CPUInstructionSet::AVX512:
+        return m_hasAVX512;
+#endif
+    default:
+        return false;
+    }
+}
+
+FreeWill::CPUInstructionSet FreeWill::CPUFeatures::bestInstructionSet() const
+{
+    if (isSupported(CPUInstructionSet::AVX512))
+    {
+        return CPUInstructionSet::AVX512;
+    }
+
+    if (isSupported(CPUInstructionSet::AVX2))
+    {
+        return CPUInstructionSet::AVX2;
+    }
+
+    return CPUInstructionSet::BASELINE;
+}
+
+bool FreeWill::CPUFeatures::setInstructionSet(CPUInstructionSet instructionSet)
+{
+    if (!isSupported(instructionSet))
+    {
+        return false;
+    }
+
+    m_instructionSet = instructionSet;
+    return true;
+}
+
+const char *FreeWill::CPUFeatures::name(CPUInstructionSet instructionSet)
+{
+    switch (instructionSet)
+    {
+    case CPUInstructionSet::AVX2:
+        return "AVX2";
+    case CPUInstructionSet::AVX512:
+        return "AVX-512";
+    default:
+#if defined(__aarch64__)
+        return "NEON";
+#else
+        return "SSE2";
+#endif
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef CPUFEATURES_H
+#define CPUFEATURES_H
+
+#include <atomic>
+#include <cstdint>
+
+namespace FreeWill
+{
+    // The instruction sets the cpu kernels are built for (see Operator/CPUKernels.h). The tree
+    // is compiled for plain x86-64 (or armv8-a), the wider kernels are compiled in separate
+    // regions and picked when the cpu has them, so one binary runs on the whole fleet.
+    enum class CPUInstructionSet : uint32_t
+    {
+        BASELINE,   // what the compiler targets, SSE2 on x86-64 and NEON on aarch64
+        AVX2,       // AVX2 with FMA
+        AVX512      // AVX-512 F, BW, DQ and VL
+    };
+
+    // What the cpu supports, read with cpuid (x86) or the auxiliary vector (aarch64 linux),
+    // and the instruction set the cpu kernels run. That is the widest one the cpu supports
+    // unless setInstructionSet picked another, Context<CPU_NAIVE>::open reports it.
+    class CPUFeatures
+    {
+    private:
+        bool m_hasAVX2;
+        bool m_hasAVX512;
+        bool m_hasNEON;
+        bool m_hasSVE;
+        std::atomic<CPUInstructionSet> m_instructionSet;
+
+        CPUFeatures();
+
+        void detect();
+
+    public:
+        static CPUFeatures &getSingleton()
+        {
+            static CPUFeatures obj;
+            return obj;
+        }
+
+        CPUFeatures(const CPUFeatures &) = delete;
+        void operator=(const CPUFeatures &) = delete;
+
+        bool hasAVX2() const
+        {
+            return m_hasAVX2;
+        }
+
+        bool hasAVX512() const
+        {
+            return m_hasAVX512;
+        }
+
+        bool hasNEON() const
+        {
+            return m_hasNEON;
+        }
+
+        // reported only, the aarch64 kernels are the NEON ones
+        bool hasSVE() const
+        {
+            return m_hasSVE;
+        }
+
+        // whether the kernels of instructionSet are built into the tree and the cpu runs them
+        bool isSupported(CPUInstructionSet instructionSet) const;
+
+        // the widest supported one
+        CPUInstructionSet bestInstructionSet() const;
+
+        CPUInstructionSet instructionSet() const
+        {
+            return m_instructionSet.load(std::memory_order_relaxed);
+        }
+
+        // Runs the kernels of instructionSet from now on, false and nothing changes when it
+        // isn't supported. Meant for before Context::open, or to compare the kernels of
+        // different instruction sets on one machine.
+        bool setInstructionSet(CPUInstructionSet instructionSet);
+
+        static const char *name(CPUInstructionSet instructionSet);
+    };
+}
+
+#endif
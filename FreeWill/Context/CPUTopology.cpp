@@ -0,0 +1,211 @@
+#include "CPUTopology.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+// a sysfs cpu list, e.g. "0-3,8-11"
+static std::vector<unsigned int> parseCpuList(const std::string &cpuList)
+{
+    std::vector<unsigned int> cpus;
+    std::stringstream stream(cpuList);
+    std::string range;
+
+    while (std::getline(stream, range, ','))
+    {
+        size_t dash = range.find('-');
+
+        try
+        {
+            unsigned int first = std::stoul(range.substr(0, dash));
+            unsigned int last = dash == std::string::npos ? first : std::stoul(range.substr(dash + 1));
+
+            for (unsigned int cpu = first; cpu <= last; ++cpu)
+            {
+                cpus.push_back(cpu);
+            }
+        }
+        catch (...)
+        {
+        }
+    }
+
+    return cpus;
+}
+
+FreeWill::CPUTopology::CPUTopology()
+    :m_nodeCpus(),
+      m_nodeOfCpu(),
+      m_coreOfCpu(),
+      m_nodePinningOrder(),
+      m_nodeCoreCount()
+{
+    read();
+}
+
+void FreeWill::CPUTopology::read()
+{
+    std::vector<std::vector<unsigned int>> nodeCpus;
+
+    // the node numbers can have gaps, the nodes without cpus are left out
+    for (unsigned int node = 0; node < 256; ++node)
+    {
+        std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+
+        if (!file.is_open())
+        {
+            continue;
+        }
+
+        std::string cpuList;
+        std::getline(file, cpuList);
+        std::vector<unsigned int> cpus = parseCpuList(cpuList);
+
+        if (!cpus.empty())
+        {
+            nodeCpus.push_back(cpus);
+        }
+    }
+
+    if (nodeCpus.empty())
+    {
+        std::vector<unsigned int> cpus(std::max(1u, std::thread::hardware_concurrency()));
+
+        for (unsigned int cpu = 0; cpu < cpus.size(); ++cpu)
+        {
+            cpus[cpu] = cpu;
+        }
+
+        nodeCpus.push_back(cpus);
+    }
+
+    // the siblings of a cpu include itself, the smallest of them names the core
+    m_coreOfCpu.clear();
+
+    for (const std::vector<unsigned int> &cpus : nodeCpus)
+    {
+        for (unsigned int cpu : cpus)
+        {
+            std::ifstream file("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/thread_siblings_list");
+            std::string siblingList;
+            std::vector<unsigned int> siblings;
+
+            if (file.is_open() && std::getline(file, siblingList))
+            {
+                siblings = parseCpuList(siblingList);
+            }
+
+            if (cpu >= m_coreOfCpu.size())
+            {
+                m_coreOfCpu.resize(cpu + 1);
+            }
+
+            m_coreOfCpu[cpu] = siblings.empty() ? cpu : *std::min_element(siblings.begin(), siblings.end());
+        }
+    }
+
+    setNodes(nodeCpus);
+}
+
+unsigned int FreeWill::CPUTopology::coreOf(unsigned int cpu) const
+{
+    return cpu < m_coreOfCpu.size() ? m_coreOfCpu[cpu] : cpu;
+}
+
+unsigned int FreeWill::CPUTopology::coreCount() const
+{
+    unsigned int coreCount = 0;
+
+    for (unsigned int nodeCoreCount : m_nodeCoreCount)
+    {
+        coreCount += nodeCoreCount;
+    }
+
+    return coreCount;
+}
+
+unsigned int FreeWill::CPUTopology::cpuCount() const
+{
+    unsigned int cpuCount = 0;
+
+    for (const std::vector<unsigned int> &cpus : m_nodeCpus)
+    {
+        cpuCount += cpus.size();
+    }
+
+    return cpuCount;
+}
+
+unsigned int FreeWill::CPUTopology::currentNode() const
+{
+#ifdef __linux__
+    int cpu = sched_getcpu();
+
+    if (cpu >= 0 && (unsigned int) cpu < m_nodeOfCpu.size())
+    {
+        return m_nodeOfCpu[cpu];
+    }
+#endif
+
+    return 0;
+}
+
+void FreeWill::CPUTopology::setNodes(const std::vector<std::vector<unsigned int>> &nodeCpus)
+{
+    if (nodeCpus.empty())
+    {
+        read();
+        return;
+    }
+
+    m_nodeCpus = nodeCpus;
+    m_nodeOfCpu.clear();
+
+    for (unsigned int node = 0; node < m_nodeCpus.size(); ++node)
+    {
+        for (unsigned int cpu : m_nodeCpus[node])
+        {
+            if (cpu >= m_nodeOfCpu.size())
+            {
+                m_nodeOfCpu.resize(cpu + 1, 0);
+            }
+
+            m_nodeOfCpu[cpu] = node;
+        }
+    }
+
+    // one cpu of every core of a node comes before the siblings of any
+    m_nodePinningOrder.clear();
+    m_nodeCoreCount.clear();
+
+    for (const std::vector<unsigned int> &cpus : m_nodeCpus)
+    {
+        std::vector<unsigned int> firstSiblings;
+        std::vector<unsigned int> otherSiblings;
+        std::vector<unsigned int> cores;
+
+        for (unsigned int cpu : cpus)
+        {
+            unsigned int core = coreOf(cpu);
+
+            if (std::find(cores.begin(), cores.end(), core) == cores.end())
+            {
+                cores.push_back(core);
+                firstSiblings.push_back(cpu);
+            }
+            else
+            {
+                otherSiblings.push_back(cpu);
+            }
+        }
+
+        firstSiblings.insert(firstSiblings.end(), otherSiblings.begin(), otherSiblings.end());
+        m_nodePinningOrder.push_back(firstSiblings);
+        m_nodeCoreCount.push_back(cores.size());
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef CPUTOPOLOGY_H
+#define CPUTOPOLOGY_H
+
+#include <vector>
+
+namespace FreeWill
+{
+    // The NUMA nodes of the machine and the cpus of each, read from
+    // /sys/devices/system/node, and which cpus are SMT siblings of one physical core, from
+    // /sys/devices/system/cpu. Where there is no such information everything is one node with
+    // all cpus, each its own core. Context<CPU_NAIVE> spreads its devices over the nodes with
+    // it, BlobAllocator keeps the host blocks it caches apart per node and CPUTopologyTuner
+    // sizes its splits by the cores.
+    class CPUTopology
+    {
+    private:
+        std::vector<std::vector<unsigned int>> m_nodeCpus;
+        std::vector<unsigned int> m_nodeOfCpu;
+        // the smallest cpu of the core every cpu is on, read once
+        std::vector<unsigned int> m_coreOfCpu;
+        // per node its cpus with one of every core first, then the remaining siblings
+        std::vector<std::vector<unsigned int>> m_nodePinningOrder;
+        std::vector<unsigned int> m_nodeCoreCount;
+
+        unsigned int coreOf(unsigned int cpu) const;
+
+        CPUTopology();
+
+        void read();
+
+    public:
+        static CPUTopology &getSingleton()
+        {
+            static CPUTopology obj;
+            return obj;
+        }
+
+        CPUTopology(const CPUTopology &) = delete;
+        void operator=(const CPUTopology &) = delete;
+
+        unsigned int nodeCount() const
+        {
+            return m_nodeCpus.size();
+        }
+
+        const std::vector<unsigned int> &cpus(unsigned int node) const
+        {
+            return m_nodeCpus[node];
+        }
+
+        // the cpus of node in the order devices are pinned to them, so that two devices only
+        // share a core once every core of the node has one
+        const std::vector<unsigned int> &pinningOrder(unsigned int node) const
+        {
+            return m_nodePinningOrder[node];
+        }
+
+        // the physical cores of node, its cpus without the SMT siblings
+        unsigned int coreCount(unsigned int node) const
+        {
+            return m_nodeCoreCount[node];
+        }
+
+        unsigned int coreCount() const;
+        unsigned int cpuCount() const;
+
+        // the node of the cpu the calling thread runs on
+        unsigned int currentNode() const;
+
+        // Replaces the nodes read from the system, before Context::open, e.g. to lay the
+        // devices out over fewer nodes or to try a layout on another machine. None of the lists
+        // may be empty, without any the system's are read again.
+        void setNodes(const std::vector<std::vector<unsigned int>> &nodeCpus);
+    };
+}
+
+#endif
@@ -0,0 +1,160 @@
+#include "CPUTopologyTuner.h"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <sstream>
+#include "Context.h"
+#include "CPUTopology.h"
+#include "ThreadPool.h"
+#include "../Operator/CPUAutotuner.h"
+
+FreeWill::CPUTopologyTuner::CPUTopologyTuner()
+    :m_mutex(),
+      m_stepCount(3),
+      m_timings()
+{}
+
+FreeWill::CPUTopologyTuner &FreeWill::CPUTopologyTuner::getSingleton()
+{
+    static CPUTopologyTuner obj;
+    return obj;
+}
+
+std::vector<FreeWill::CPUSplit> FreeWill::CPUTopologyTuner::splits() const
+{
+    const CPUTopology &topology = CPUTopology::getSingleton();
+    unsigned int coreCount = std::max(1u, topology.coreCount());
+    unsigned int cpuCount = std::max(coreCount, topology.cpuCount());
+
+    std::vector<CPUSplit> splits;
+
+    for (unsigned int replicaCount = std::min(topology.nodeCount(), coreCount); replicaCount < coreCount; replicaCount *= 2)
+    {
+        splits.push_back({replicaCount, coreCount / replicaCount});
+    }
+
+    splits.push_back({coreCount, 1});
+
+    if (cpuCount > coreCount)
+    {
+        splits.push_back({cpuCount, 1});
+    }
+
+    return splits;
+}
+
+std::string FreeWill::CPUTopologyTuner::cacheKey(const std::string &key) const
+{
+    // the splits depend on the layout, an entry of another machine's doesn't apply
+    const CPUTopology &topology = CPUTopology::getSingleton();
+
+    std::ostringstream stream;
+    stream << "topology/" << topology.nodeCount() << "x" << topology.coreCount() << "x" << topology.cpuCount() << "/" << key;
+
+    return stream.str();
+}
+
+FreeWill::CPUSplit FreeWill::CPUTopologyTuner::open(const BuildFunction &build, const std::string &key)
+{
+    std::vector<CPUSplit> splits = this->splits();
+    CPUAutotuner &autotuner = CPUAutotuner::getSingleton();
+    int variant = -1;
+
+    if (!key.empty() && autotuner.find(cacheKey(key), variant) && variant >= 0 && (unsigned int) variant < splits.size())
+    {
+        open(splits[variant]);
+        return splits[variant];
+    }
+
+    unsigned int stepCount = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        stepCount = m_stepCount;
+        m_timings.clear();
+    }
+
+    double bestTime = std::numeric_limits<double>::max();
+    unsigned int bestSplit = 0;
+
+    for (unsigned int i = 0; i < splits.size(); ++i)
+    {
+        open(splits[i]);
+
+        std::function<void()> step = build(splits[i]);
+
+        if (!step)
+        {
+            continue;
+        }
+
+        // once untimed, for the page faults and what the operators allocate on their first run
+        step();
+
+        double time = std::numeric_limits<double>::max();
+
+        for (unsigned int e = 0; e < stepCount; ++e)
+        {
+            std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+            step();
+            time = std::min(time, std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+        }
+
+        // released while the devices the model was built for are still open
+        step = std::function<void()>();
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_timings.push_back(std::make_pair(splits[i], time));
+        }
+
+        if (time < bestTime)
+        {
+            bestTime = time;
+            bestSplit = i;
+        }
+    }
+
+    if (!key.empty() && bestTime < std::numeric_limits<double>::max())
+    {
+        autotuner.insert(cacheKey(key), bestSplit);
+    }
+
+    open(splits[bestSplit]);
+
+    return splits[bestSplit];
+}
+
+void FreeWill::CPUTopologyTuner::open(const CPUSplit &split)
+{
+    close();
+
+    Context<DeviceType::CPU_NAIVE>::getSingleton().open(std::max(1u, split.m_replicaCount));
+
+    // the worker of every replica takes part in the parallelFor()s it calls
+    unsigned int threadCount = std::max(1u, split.m_replicaCount) * (std::max(1u, split.m_threadCount) - 1);
+
+    if (threadCount > 0)
+    {
+        ThreadPool::getSingleton().open(threadCount);
+    }
+}
+
+void FreeWill::CPUTopologyTuner::close()
+{
+    Context<DeviceType::CPU_NAIVE>::getSingleton().close();
+    ThreadPool::getSingleton().close();
+}
+
+void FreeWill::CPUTopologyTuner::setStepCount(unsigned int stepCount)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_stepCount = std::max(1u, stepCount);
+}
+
+std::vector<std::pair<FreeWill::CPUSplit, double>> FreeWill::CPUTopologyTuner::timings()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return m_timings;
+}
@@ -0,0 +1,72 @@
+#ifndef CPUTOPOLOGYTUNER_H
+#define CPUTOPOLOGYTUNER_H
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace FreeWill
+{
+    // How the cores are shared out on the cpu: m_replicaCount devices of Context<CPU_NAIVE>,
+    // each a replica of the model training on its own part of the batch, and the ThreadPool
+    // sized so that every replica has m_threadCount threads for the operators it runs, its
+    // worker and m_threadCount - 1 of the pool.
+    struct CPUSplit
+    {
+        unsigned int m_replicaCount = 1;
+        unsigned int m_threadCount = 1;
+    };
+
+    // Picks the split of the cpu for a model by timing it. The candidates come from
+    // CPUTopology: a replica per NUMA node and twice as many and so on up to one per physical
+    // core, the cores of each shared out as its threads, and when there is SMT one replica per
+    // cpu as Context::open does by default. Each is opened, the model built on it and a few of
+    // its steps timed, the fastest is opened again and left open.
+    //
+    // With a key the choice is kept in CPUAutotuner, in its file if one is opened, so that
+    // the next process training the same model on the same machine opens it without timing.
+    class CPUTopologyTuner
+    {
+    public:
+        // Builds the model and its solver on the context as it is opened for split, and
+        // returns one step of them, e.g. the forward and backward pass and the update of a
+        // batch. The replicas should share the same global batch size between them, so that
+        // the steps of every split do the same work. Whatever the step holds is released with
+        // it before the next split is opened. An empty function skips the split.
+        typedef std::function<std::function<void()>(const CPUSplit &split)> BuildFunction;
+
+    private:
+        std::mutex m_mutex;
+        // how often a split runs its step after the untimed first one, the fastest counts
+        unsigned int m_stepCount;
+        // the seconds per step of every split timed by the last open()
+        std::vector<std::pair<CPUSplit, double>> m_timings;
+
+        CPUTopologyTuner();
+
+        std::string cacheKey(const std::string &key) const;
+
+    public:
+        static CPUTopologyTuner &getSingleton();
+
+        CPUTopologyTuner(const CPUTopologyTuner &) = delete;
+        void operator=(const CPUTopologyTuner &) = delete;
+
+        std::vector<CPUSplit> splits() const;
+
+        // times the splits with build, opens the fastest and returns it
+        CPUSplit open(const BuildFunction &build, const std::string &key = std::string());
+
+        // opens Context<CPU_NAIVE> and the ThreadPool for split, closing them first
+        static void open(const CPUSplit &split);
+        static void close();
+
+        void setStepCount(unsigned int stepCount);
+
+        std::vector<std::pair<CPUSplit, double>> timings();
+    };
+}
+
+#endif
@@ -0,0 +1,78 @@
+#include "CUDAGraph.h"
+#include "../DeviceSelection.h"
+#include <iostream>
+
+FreeWill::CUDAGraph::CUDAGraph()
+    :m_deviceId(0),
+      m_graphExec(nullptr)
+{}
+
+FreeWill::CUDAGraph::~CUDAGraph()
+{
+    clear();
+}
+
+bool FreeWill::CUDAGraph::capture(int deviceId, const std::function<void()> &work)
+{
+    clear();
+
+    RUN_CUDA(cudaSetDevice(deviceId));
+
+    // thread local, so the loader and checkpoint threads may keep copying meanwhile
+    if (cudaStreamBeginCapture(cudaStreamPerThread, cudaStreamCaptureModeThreadLocal) != cudaSuccess)
+    {
+        std::cerr << "can't capture on device " << deviceId << std::endl;
+        return false;
+    }
+
+    work();
+
+    cudaGraph_t graph = nullptr;
+    cudaError_t result = cudaStreamEndCapture(cudaStreamPerThread, &graph);
+
+    if (result == cudaSuccess)
+    {
+        result = cudaGraphInstantiate(&m_graphExec, graph, nullptr, nullptr, 0);
+    }
+
+    if (graph)
+    {
+        RUN_CUDA(cudaGraphDestroy(graph));
+    }
+
+    if (result != cudaSuccess)
+    {
+        std::cerr << "capture on device " << deviceId << " failed: " << cudaGetErrorString(result) << std::endl;
+        // an invalidated capture leaves its error behind
+        cudaGetLastError();
+        m_graphExec = nullptr;
+        return false;
+    }
+
+    m_deviceId = deviceId;
+
+    return true;
+}
+
+bool FreeWill::CUDAGraph::launch()
+{
+    if (!m_graphExec)
+    {
+        return false;
+    }
+
+    return cudaGraphLaunch(m_graphExec, cudaStreamPerThread) == cudaSuccess;
+}
+
+void FreeWill::CUDAGraph::clear()
+{
+    if (m_graphExec)
+    {
+        int currentDevice = 0;
+        RUN_CUDA(cudaGetDevice(&currentDevice));
+        RUN_CUDA(cudaSetDevice(m_deviceId));
+        RUN_CUDA(cudaGraphExecDestroy(m_graphExec));
+        RUN_CUDA(cudaSetDevice(currentDevice));
+        m_graphExec = nullptr;
+    }
+}
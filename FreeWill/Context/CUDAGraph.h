@@ -0,0 +1,45 @@
+#ifndef CUDAGRAPH_H
+#define CUDAGRAPH_H
+
+#include <cuda_runtime.h>
+#include <functional>
+
+namespace FreeWill
+{
+    // The work one device issues for a pass, recorded once and launched again as a whole.
+    // capture() runs work with the calling thread's default stream capturing instead of
+    // executing, which needs the per-thread default stream (CUDA_API_PER_THREAD_DEFAULT_STREAM,
+    // nvcc --default-stream per-thread) and the cudnn and cublas handles on it, as Device sets
+    // them up. Everything work touches is baked in: device pointers, kernel arguments and the
+    // scalars of the operators. What changes them, a reallocation, another batch size or loss
+    // scale, has to clear() and capture again.
+    class CUDAGraph
+    {
+    private:
+        int m_deviceId;
+        cudaGraphExec_t m_graphExec;
+
+    public:
+        CUDAGraph();
+        ~CUDAGraph();
+
+        CUDAGraph(const CUDAGraph &) = delete;
+        void operator=(const CUDAGraph &) = delete;
+
+        // false when work did something that can't be captured, e.g. a synchronous copy, the
+        // graph is left empty then
+        bool capture(int deviceId, const std::function<void()> &work);
+
+        // queues the whole graph on the default stream of deviceId, which has to be current
+        bool launch();
+
+        void clear();
+
+        bool isCaptured() const
+        {
+            return m_graphExec != nullptr;
+        }
+    };
+}
+
+#endif
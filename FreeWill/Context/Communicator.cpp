@@ -0,0 +1,497 @@
+#include "Communicator.h"
+#include "../Tensor/HalfPrecision.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+#include <thread>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static bool splitHost(const std::string &host, std::string &name, std::string &port)
+{
+    size_t colon = host.rfind(':');
+
+    if (colon == std::string::npos || colon == 0 || colon + 1 == host.size())
+    {
+        return false;
+    }
+
+    name = host.substr(0, colon);
+    port = host.substr(colon + 1);
+    return true;
+}
+
+static void setNoDelay(int socketHandle)
+{
+    int isEnabled = 1;
+    setsockopt(socketHandle, IPPROTO_TCP, TCP_NODELAY, &isEnabled, sizeof(isEnabled));
+}
+
+static void closeSocket(int &socketHandle)
+{
+    if (socketHandle >= 0)
+    {
+        ::close(socketHandle);
+        socketHandle = -1;
+    }
+}
+
+FreeWill::Communicator::Communicator()
+    :m_rank(0),
+      m_worldSize(1),
+      m_listenSocket(-1),
+      m_nextSocket(-1),
+      m_previousSocket(-1),
+      m_receiveBuffer(),
+      m_sendBuffer()
+{}
+
+FreeWill::Communicator::~Communicator()
+{
+    close();
+}
+
+bool FreeWill::Communicator::open(unsigned int rank, const std::vector<std::string> &hosts, unsigned int timeoutInSecond)
+{
+    close();
+
+    if (rank >= hosts.size())
+    {
+        return false;
+    }
+
+    if (hosts.size() == 1)
+    {
+        return true;
+    }
+
+    unsigned int worldSize = hosts.size();
+    std::string name;
+    std::string port;
+
+    if (!splitHost(hosts[rank], name, port))
+    {
+        std::cerr << "can't parse host " << hosts[rank] << std::endl;
+        return false;
+    }
+
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons((uint16_t) std::stoi(port));
+
+    int isEnabled = 1;
+    m_listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (m_listenSocket < 0 || setsockopt(m_listenSocket, SOL_SOCKET, SO_REUSEADDR, &isEnabled, sizeof(isEnabled)) != 0 ||
+            bind(m_listenSocket, (sockaddr *) &address, sizeof(address)) != 0 || listen(m_listenSocket, 1) != 0)
+    {
+        std::cerr << "can't listen on " << hosts[rank] << std::endl;
+        close();
+        return false;
+    }
+
+    // the next rank may not be listening yet
+    const std::string &nextHost = hosts[(rank + 1) % worldSize];
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(timeoutInSecond);
+
+    if (!splitHost(nextHost, name, port))
+    {
+        std::cerr << "can't parse host " << nextHost << std::endl;
+        close();
+        return false;
+    }
+
+    while (m_nextSocket < 0 && std::chrono::steady_clock::now() < deadline)
+    {
+        addrinfo hints;
+        std::memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo *addresses = nullptr;
+
+        if (getaddrinfo(name.c_str(), port.c_str(), &hints, &addresses) == 0)
+        {
+            for (addrinfo *candidate = addresses; candidate && m_nextSocket < 0; candidate = candidate->ai_next)
+            {
+                m_nextSocket = socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+
+                if (m_nextSocket >= 0 && connect(m_nextSocket, candidate->ai_addr, candidate->ai_addrlen) != 0)
+                {
+                    closeSocket(m_nextSocket);
+                }
+            }
+
+            freeaddrinfo(addresses);
+        }
+
+        if (m_nextSocket < 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+
+    pollfd listenPoll = {m_listenSocket, POLLIN, 0};
+    int remainingInMillisecond = std::max(0, (int) std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count());
+
+    if (m_nextSocket < 0 || poll(&listenPoll, 1, remainingInMillisecond) != 1 || (m_previousSocket = accept(m_listenSocket, nullptr, nullptr)) < 0)
+    {
+        std::cerr << "can't connect the ring of rank " << rank << std::endl;
+        close();
+        return false;
+    }
+
+    setNoDelay(m_nextSocket);
+    setNoDelay(m_previousSocket);
+    m_rank = rank;
+    m_worldSize = worldSize;
+
+    // every rank introduces itself to the next one, a misconfigured host list is caught here
+    uint32_t ranks[2] = {rank, worldSize};
+    uint32_t previousRanks[2] = {0, 0};
+
+    if (!exchange(ranks, sizeof(ranks), previousRanks, sizeof(previousRanks)) ||
+            previousRanks[0] != (rank + worldSize - 1) % worldSize || previousRanks[1] != worldSize)
+    {
+        std::cerr << "rank " << rank << " is connected to the wrong ring" << std::endl;
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void FreeWill::Communicator::close()
+{
+    closeSocket(m_nextSocket);
+    closeSocket(m_previousSocket);
+    closeSocket(m_listenSocket);
+
+    m_rank = 0;
+    m_worldSize = 1;
+    m_receiveBuffer.clear();
+    m_sendBuffer.clear();
+}
+
+bool FreeWill::Communicator::sendAll(const void *data, size_t sizeInByte)
+{
+    const unsigned char *bytes = (const unsigned char *) data;
+
+    while (sizeInByte > 0)
+    {
+        ssize_t sent = send(m_nextSocket, bytes, sizeInByte, MSG_NOSIGNAL);
+
+        if (sent <= 0)
+        {
+            return false;
+        }
+
+        bytes += sent;
+        sizeInByte -= sent;
+    }
+
+    return true;
+}
+
+bool FreeWill::Communicator::receiveAll(void *data, size_t sizeInByte)
+{
+    unsigned char *bytes = (unsigned char *) data;
+
+    while (sizeInByte > 0)
+    {
+        ssize_t received = recv(m_previousSocket, bytes, sizeInByte, 0);
+
+        if (received <= 0)
+        {
+            return false;
+        }
+
+        bytes += received;
+        sizeInByte -= received;
+    }
+
+    return true;
+}
+
+bool FreeWill::Communicator::exchange(const void *sendData, size_t sendSizeInByte, void *receiveData, size_t receiveSizeInByte)
+{
+    bool isSent = false;
+    std::thread sender([&]{isSent = sendAll(sendData, sendSizeInByte);});
+
+    bool isReceived = receiveAll(receiveData, receiveSizeInByte);
+    sender.join();
+
+    if (!isSent || !isReceived)
+    {
+        std::cerr << "rank " << m_rank << " lost its connection to the ring" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+template<typename DataType>
+bool FreeWill::Communicator::ringAllReduce(DataType *data, size_t count, bool isHalfOnWire)
+{
+    const unsigned int worldSize = m_worldSize;
+    const size_t wireSize = isHalfOnWire ? sizeof(uint16_t) : sizeof(DataType);
+
+    auto begin = [&](unsigned int segment)
+    {
+        return count * segment / worldSize;
+    };
+
+    auto pack = [&](unsigned int segment)
+    {
+        const DataType *source = data + begin(segment);
+        size_t size = begin(segment + 1) - begin(segment);
+
+        if (isHalfOnWire)
+        {
+            uint16_t *wire = (uint16_t *) m_sendBuffer.data();
+            for (size_t i = 0; i < size; ++i)
+            {
+                wire[i] = floatToHalfBits((float) source[i]);
+            }
+        }
+        else
+        {
+            std::memcpy(m_sendBuffer.data(), source, size * sizeof(DataType));
+        }
+
+        return size * wireSize;
+    };
+
+    auto received = [&](size_t i) -> DataType
+    {
+        if (isHalfOnWire)
+        {
+            return (DataType) halfBitsToFloat(((const uint16_t *) m_receiveBuffer.data())[i]);
+        }
+
+        return ((const DataType *) m_receiveBuffer.data())[i];
+    };
+
+    size_t largestSegmentSizeInByte = ((count + worldSize - 1) / worldSize) * wireSize;
+    m_sendBuffer.resize(largestSegmentSizeInByte);
+    m_receiveBuffer.resize(largestSegmentSizeInByte);
+
+    // reduce-scatter: after worldSize - 1 steps this rank holds the sum of segment rank + 1
+    for (unsigned int step = 0; step + 1 < worldSize; ++step)
+    {
+        unsigned int sendSegment = (m_rank + worldSize - step) % worldSize;
+        unsigned int receiveSegment = (m_rank + worldSize - step - 1) % worldSize;
+        size_t receiveSize = begin(receiveSegment + 1) - begin(receiveSegment);
+        size_t sendSizeInByte = pack(sendSegment);
+
+        if (!exchange(m_sendBuffer.data(), sendSizeInByte, m_receiveBuffer.data(), receiveSize * wireSize))
+        {
+            return false;
+        }
+
+        DataType *target = data + begin(receiveSegment);
+        for (size_t i = 0; i < receiveSize; ++i)
+        {
+            target[i] = target[i] + received(i);
+        }
+    }
+
+    // the other ranks get the owned sum as half, so the owner rounds its copy too
+    unsigned int ownedSegment = (m_rank + 1) % worldSize;
+    if (isHalfOnWire)
+    {
+        for (size_t i = begin(ownedSegment); i < begin(ownedSegment + 1); ++i)
+        {
+            data[i] = (DataType) halfBitsToFloat(floatToHalfBits((float) data[i]));
+        }
+    }
+
+    // all-gather: the summed segments go once around the ring
+    for (unsigned int step = 0; step + 1 < worldSize; ++step)
+    {
+        unsigned int sendSegment = (m_rank + 1 + worldSize - step) % worldSize;
+        unsigned int receiveSegment = (m_rank + worldSize - step) % worldSize;
+        size_t receiveSize = begin(receiveSegment + 1) - begin(receiveSegment);
+        size_t sendSizeInByte = pack(sendSegment);
+
+        if (!exchange(m_sendBuffer.data(), sendSizeInByte, m_receiveBuffer.data(), receiveSize * wireSize))
+        {
+            return false;
+        }
+
+        DataType *target = data + begin(receiveSegment);
+        for (size_t i = 0; i < receiveSize; ++i)
+        {
+            target[i] = received(i);
+        }
+    }
+
+    return true;
+}
+
+template<typename DataType>
+bool FreeWill::Communicator::sparseAllReduce(DataType *data, size_t count, double ratio, DataType *residual)
+{
+    const unsigned int worldSize = m_worldSize;
+    // the same on every rank, the sizes are the same
+    size_t selectedCount = std::min(count, std::max((size_t) 1, (size_t) std::ceil(count * ratio)));
+    // the values of a block after its indices, aligned for DataType
+    size_t indicesSizeInByte = (selectedCount * sizeof(uint32_t) + sizeof(DataType) - 1) / sizeof(DataType) * sizeof(DataType);
+    size_t blockSizeInByte = indicesSizeInByte + selectedCount * sizeof(DataType);
+
+    if (residual)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            data[i] = data[i] + residual[i];
+        }
+    }
+
+    std::vector<uint32_t> indices(count);
+    std::iota(indices.begin(), indices.end(), 0);
+    std::nth_element(indices.begin(), indices.begin() + (selectedCount - 1), indices.end(), [&](uint32_t a, uint32_t b)
+    {
+        return std::fabs(data[a]) > std::fabs(data[b]);
+    });
+    std::sort(indices.begin(), indices.begin() + selectedCount);
+
+    // every rank's block of indices and values, this rank's at rank
+    m_receiveBuffer.resize(blockSizeInByte * worldSize);
+
+    auto blockIndices = [&](unsigned int rank)
+    {
+        return (uint32_t *) (m_receiveBuffer.data() + blockSizeInByte * rank);
+    };
+
+    auto blockValues = [&](unsigned int rank)
+    {
+        return (DataType *) (m_receiveBuffer.data() + blockSizeInByte * rank + indicesSizeInByte);
+    };
+
+    for (size_t i = 0; i < selectedCount; ++i)
+    {
+        blockIndices(m_rank)[i] = indices[i];
+        blockValues(m_rank)[i] = data[indices[i]];
+    }
+
+    if (residual)
+    {
+        std::copy(data, data + count, residual);
+
+        for (size_t i = 0; i < selectedCount; ++i)
+        {
+            residual[indices[i]] = 0;
+        }
+    }
+
+    // all-gather of the blocks, each step passes on the block received the step before
+    for (unsigned int step = 0; step + 1 < worldSize; ++step)
+    {
+        unsigned int sendRank = (m_rank + worldSize - step) % worldSize;
+        unsigned int receiveRank = (m_rank + worldSize - step - 1) % worldSize;
+
+        if (!exchange(blockIndices(sendRank), blockSizeInByte, blockIndices(receiveRank), blockSizeInByte))
+        {
+            return false;
+        }
+    }
+
+    // in rank order on every rank, so the sums are the same everywhere
+    std::fill(data, data + count, (DataType) 0);
+
+    for (unsigned int rank = 0; rank < worldSize; ++rank)
+    {
+        for (size_t i = 0; i < selectedCount; ++i)
+        {
+            data[blockIndices(rank)[i]] += blockValues(rank)[i];
+        }
+    }
+
+    return true;
+}
+
+bool FreeWill::Communicator::allReduce(float *data, size_t count, const FreeWill::GradientCompression &compression, float *residual)
+{
+    if (!isOpen() || count == 0)
+    {
+        return true;
+    }
+
+    switch (compression.m_type)
+    {
+    case GradientCompressionType::FP16:
+        return ringAllReduce<float>(data, count, true);
+    case GradientCompressionType::TOP_K:
+        return sparseAllReduce<float>(data, count, compression.m_topKRatio, residual);
+    default:
+        return ringAllReduce<float>(data, count, false);
+    }
+}
+
+bool FreeWill::Communicator::allReduce(double *data, size_t count, const FreeWill::GradientCompression &compression, double *residual)
+{
+    if (!isOpen() || count == 0)
+    {
+        return true;
+    }
+
+    switch (compression.m_type)
+    {
+    case GradientCompressionType::FP16:
+        return ringAllReduce<double>(data, count, true);
+    case GradientCompressionType::TOP_K:
+        return sparseAllReduce<double>(data, count, compression.m_topKRatio, residual);
+    default:
+        return ringAllReduce<double>(data, count, false);
+    }
+}
+
+bool FreeWill::Communicator::broadcast(void *data, size_t sizeInByte, unsigned int root)
+{
+    if (!isOpen())
+    {
+        return true;
+    }
+
+    bool isDone = true;
+
+    if (m_rank == root)
+    {
+        isDone = sendAll(data, sizeInByte);
+    }
+    else
+    {
+        // passed on around the ring, the rank before root is the last to get it
+        isDone = receiveAll(data, sizeInByte) && ((m_rank + 1) % m_worldSize == root || sendAll(data, sizeInByte));
+    }
+
+    if (!isDone)
+    {
+        std::cerr << "rank " << m_rank << " lost its connection to the ring" << std::endl;
+    }
+
+    return isDone;
+}
+
+bool FreeWill::Communicator::barrier()
+{
+    if (!isOpen())
+    {
+        return true;
+    }
+
+    // a token goes around once to see that every rank has arrived, then once more to let them go
+    unsigned char token = 0;
+    bool isDone = m_rank == 0 ? sendAll(&token, 1) && receiveAll(&token, 1) :
+                                receiveAll(&token, 1) && sendAll(&token, 1);
+
+    return isDone && broadcast(&token, 1, 0);
+}
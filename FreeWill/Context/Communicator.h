@@ -0,0 +1,107 @@
+#ifndef COMMUNICATOR_H
+#define COMMUNICATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace FreeWill
+{
+    enum class GradientCompressionType : uint32_t
+    {
+        NONE,
+        // the values travel as half, the sums are taken in float
+        FP16,
+        // every rank sends only its m_topKRatio largest entries by magnitude, the others are
+        // kept in a residual that is added to the next gradient (error feedback)
+        TOP_K
+    };
+
+    struct GradientCompression
+    {
+        GradientCompressionType m_type = GradientCompressionType::NONE;
+        double m_topKRatio = 0.01;
+    };
+
+    // The processes of a distributed training run, one per host, connected in a ring over TCP.
+    // Rank r listens on hosts[r] ("host:port") and connects to the next rank, so every process
+    // has one socket to send to and one to receive from.
+    //
+    // allReduce() sums a buffer over all ranks, ring style: a reduce-scatter where every rank
+    // ends up with the sum of one segment, then an all-gather of the segments. Each segment is
+    // summed on one rank and sent on as it is, so all ranks get bit identical results. The
+    // calls have to be made in the same order with the same sizes on every rank.
+    //
+    // Without open() there is one rank and allReduce() and broadcast() do nothing.
+    class Communicator
+    {
+    private:
+        unsigned int m_rank;
+        unsigned int m_worldSize;
+        int m_listenSocket;
+        int m_nextSocket;
+        int m_previousSocket;
+
+        // the segment being received and, for TOP_K, the pairs of every rank
+        std::vector<unsigned char> m_receiveBuffer;
+        std::vector<unsigned char> m_sendBuffer;
+
+        Communicator();
+        ~Communicator();
+
+        bool sendAll(const void *data, size_t sizeInByte);
+        bool receiveAll(void *data, size_t sizeInByte);
+        // sends to the next rank while receiving from the previous one, so that neither side
+        // blocks on a full socket buffer
+        bool exchange(const void *sendData, size_t sendSizeInByte, void *receiveData, size_t receiveSizeInByte);
+
+        template<typename DataType>
+        bool ringAllReduce(DataType *data, size_t count, bool isHalfOnWire);
+
+        template<typename DataType>
+        bool sparseAllReduce(DataType *data, size_t count, double ratio, DataType *residual);
+
+    public:
+        static Communicator &getSingleton()
+        {
+            static Communicator obj;
+            return obj;
+        }
+
+        Communicator(const Communicator &) = delete;
+        void operator=(const Communicator &) = delete;
+
+        // blocks until the ring is connected, retries connecting to the next rank until
+        // timeoutInSecond has passed
+        bool open(unsigned int rank, const std::vector<std::string> &hosts, unsigned int timeoutInSecond = 60);
+
+        void close();
+
+        bool isOpen() const
+        {
+            return m_worldSize > 1;
+        }
+
+        unsigned int rank() const
+        {
+            return m_rank;
+        }
+
+        unsigned int worldSize() const
+        {
+            return m_worldSize;
+        }
+
+        // residual has count entries, zeroed before the first call, and is only used by TOP_K
+        bool allReduce(float *data, size_t count, const GradientCompression &compression = GradientCompression(), float *residual = nullptr);
+        bool allReduce(double *data, size_t count, const GradientCompression &compression = GradientCompression(), double *residual = nullptr);
+
+        // root's bytes to every rank
+        bool broadcast(void *data, size_t sizeInByte, unsigned int root = 0);
+
+        bool barrier();
+    };
+}
+
+#endif
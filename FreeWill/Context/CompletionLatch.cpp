@@ -0,0 +1,43 @@
+#include "CompletionLatch.h"
+#include "Ringbuffer.h"
+
+FreeWill::CompletionLatch::CompletionLatch(unsigned int count)
+    :m_count(count),
+      m_mutex(),
+      m_condition()
+{}
+
+void FreeWill::CompletionLatch::reset(unsigned int count)
+{
+    m_count.store(count, std::memory_order_relaxed);
+}
+
+void FreeWill::CompletionLatch::countDown()
+{
+    if (m_count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.notify_all();
+    }
+}
+
+bool FreeWill::CompletionLatch::isDone() const
+{
+    return m_count.load(std::memory_order_acquire) == 0;
+}
+
+void FreeWill::CompletionLatch::wait()
+{
+    // most operators are short, spin a little before going to sleep
+    for (unsigned int i = 0; i < 1000; ++i)
+    {
+        if (isDone())
+        {
+            return;
+        }
+        cpuRelax();
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_condition.wait(lock, [=]{return isDone();});
+}
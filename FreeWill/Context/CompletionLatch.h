@@ -0,0 +1,35 @@
+#ifndef COMPLETIONLATCH_H
+#define COMPLETIONLATCH_H
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+namespace FreeWill
+{
+    // Countdown for one wave of work messages. Workers only touch the atomic counter;
+    // the mutex is taken once per wave, by whoever brings the count to zero.
+    class CompletionLatch
+    {
+    private:
+        std::atomic<unsigned int> m_count;
+        std::mutex m_mutex;
+        std::condition_variable m_condition;
+
+    public:
+        CompletionLatch(unsigned int count = 0);
+
+        CompletionLatch(const CompletionLatch &) = delete;
+        void operator=(const CompletionLatch &) = delete;
+
+        void reset(unsigned int count);
+
+        void countDown();
+
+        void wait();
+
+        bool isDone() const;
+    };
+}
+
+#endif
@@ -0,0 +1,14 @@
+#include "ComputeStream.h"
+
+// part of the kernel library, the kernels and the operators calling them share one
+static thread_local cudaStream_t currentComputeStream = cudaStreamPerThread;
+
+cudaStream_t FreeWill::computeStream()
+{
+    return currentComputeStream;
+}
+
+void FreeWill::setComputeStream(cudaStream_t stream)
+{
+    currentComputeStream = stream;
+}
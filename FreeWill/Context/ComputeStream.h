@@ -0,0 +1,18 @@
+#ifndef COMPUTESTREAM_H
+#define COMPUTESTREAM_H
+
+#include <cuda_runtime.h>
+
+namespace FreeWill
+{
+    // The stream the calling thread issues operator work on: kernel launches, asynchronous
+    // memsets and the waits for uploads. It is the per-thread default stream until
+    // Device::setComputeLane moves the thread to another compute stream of the device, which
+    // is how GraphExecutor runs independent operators concurrently. Operator code passes it
+    // instead of stream 0.
+    cudaStream_t computeStream();
+
+    void setComputeStream(cudaStream_t stream);
+}
+
+#endif
@@ -10,8 +10,11 @@
 #include <type_traits>
 #include <cstdio>
 #include "../Tensor/ReferenceCountedBlob.h"
+#include "../Tensor/HalfPrecision.h"
 #include <thread>
 #include "Device.h"
+#include "CPUTopology.h"
+#include <functional>
 #include <iostream>
 #include <vector>
 
@@ -26,7 +29,13 @@ namespace FreeWill
             m_sharedOneVectorFloatSize(0),
             m_sharedOneVectorDouble(nullptr),
             m_sharedOneVectorDoubleSize(0),
-            m_deviceCount(0)
+            m_sharedOneVectorHalf(nullptr),
+            m_sharedOneVectorHalfSize(0),
+            m_sharedOneVectorBFloat16(nullptr),
+            m_sharedOneVectorBFloat16Size(0),
+            m_deviceCount(0),
+            m_hasPeerAccess(false),
+            m_isPinned(true)
         {}
 
 
@@ -34,17 +43,32 @@ namespace FreeWill
         unsigned int m_sharedOneVectorFloatSize;
         double *m_sharedOneVectorDouble;
         unsigned int m_sharedOneVectorDoubleSize;
+        Half *m_sharedOneVectorHalf;
+        unsigned int m_sharedOneVectorHalfSize;
+        BFloat16 *m_sharedOneVectorBFloat16;
+        unsigned int m_sharedOneVectorBFloat16Size;
         int m_deviceCount;
+        bool m_hasPeerAccess;
+        bool m_isPinned;
         std::vector<Device<DeviceUsed>*> m_deviceList;
 
 
     public:
 
+        // deviceCountOverride picks the device count, on gpu at most the gpus there are, 0
+        // takes all cores or gpus, on cpu a replica per cpu including the SMT siblings,
+        // CPUTopologyTuner picks the split of the cores for a model instead
         void open(unsigned int deviceCountOverride = 0)
         {
             if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
             {
                 cudaGetDeviceCount(&m_deviceCount);
+
+                if (deviceCountOverride != 0 && (int) deviceCountOverride < m_deviceCount)
+                {
+                    m_deviceCount = deviceCountOverride;
+                }
+
                 for (unsigned int i = 0; i < m_deviceCount; ++i)
                 {
                     cudaDeviceProp deviceProp;
@@ -60,6 +84,31 @@ namespace FreeWill
                     device->init();
                 }
 
+                // every gpu reads the others' gradients directly when merging them, without
+                // peer access the merge copies them over with cudaMemcpyPeerAsync first
+                m_hasPeerAccess = true;
+                for (int i = 0; i < m_deviceCount; ++i)
+                {
+                    for (int e = 0; e < m_deviceCount; ++e)
+                    {
+                        int canAccessPeer = 0;
+                        if (i != e)
+                        {
+                            cudaDeviceCanAccessPeer(&canAccessPeer, i, e);
+                            if (canAccessPeer)
+                            {
+                                cudaSetDevice(i);
+                                cudaDeviceEnablePeerAccess(e, 0);
+                            }
+                            else
+                            {
+                                m_hasPeerAccess = false;
+                            }
+                        }
+                    }
+                }
+                cudaSetDevice(0);
+
                 size_t freeMem = 0;
                 size_t totalMem = 0;
                 cudaMemGetInfo(&freeMem, &totalMem);
@@ -79,9 +128,18 @@ namespace FreeWill
 
                 std::cout << "CPU count:" << m_deviceCount << std::endl;
 
+                // consecutive devices share a node, the nodes get equal shares of the devices
+                // and each device its own physical core of its node as long as there are enough
+                const CPUTopology &topology = CPUTopology::getSingleton();
+                std::vector<unsigned int> nodeDeviceCounts(topology.nodeCount(), 0);
+
                 for(int i = 0; i<m_deviceCount; ++i)
                 {
-                    Device<DeviceUsed> *device = new Device<DeviceUsed>(i);
+                    unsigned int node = (unsigned int) i * topology.nodeCount() / m_deviceCount;
+                    const std::vector<unsigned int> &cpus = topology.pinningOrder(node);
+                    int cpu = m_isPinned ? (int) cpus[nodeDeviceCounts[node]++ % cpus.size()] : -1;
+
+                    Device<DeviceUsed> *device = new Device<DeviceUsed>(i, cpu, node);
                     m_deviceList.push_back(device);
                     device->init();
 
@@ -128,6 +186,105 @@ namespace FreeWill
             }
         }
 
+        // Runs function on the worker of a cpu device and waits for it, so that the memory it
+        // first touches is placed on the device's NUMA node. On gpu, without the device or on
+        // its worker, function runs right away on the calling thread.
+        void runOnDevice(unsigned int deviceId, const std::function<void()> &function)
+        {
+            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+            {
+                if (deviceId < m_deviceList.size() && !m_deviceList[deviceId]->isWorkerThread())
+                {
+                    WorkerMessage message(WorkerMessage::Type::TASK, (Operator<DeviceType::CPU_NAIVE>*) nullptr);
+                    message.resetTask(function);
+                    m_deviceList[deviceId]->pushWork(&message);
+                    message.join();
+                    return;
+                }
+            }
+
+            function();
+        }
+
+        // Runs function(deviceId) for every device at once, each on the device's worker, and waits
+        // for them all. On gpu the worker has its device current and its work is finished before
+        // this returns. Called from a worker, the devices run one after another on it.
+        void runOnEveryDevice(const std::function<void(unsigned int)> &function)
+        {
+            for (unsigned int i = 0; i < m_deviceList.size(); ++i)
+            {
+                if (m_deviceList[i]->isWorkerThread())
+                {
+                    for (unsigned int e = 0; e < m_deviceList.size(); ++e)
+                    {
+                        function(e);
+                    }
+
+                    return;
+                }
+            }
+
+            std::vector<WorkerMessage*> messages;
+
+            for (unsigned int i = 0; i < m_deviceList.size(); ++i)
+            {
+                WorkerMessage *message = new WorkerMessage(WorkerMessage::Type::TASK, (Operator<DeviceUsed>*) nullptr);
+                message->resetTask([&function, i]
+                {
+                    function(i);
+
+                    if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+                    {
+                        RUN_CUDA(cudaStreamSynchronize(cudaStreamPerThread));
+                    }
+                });
+
+                m_deviceList[i]->pushWork(message);
+                messages.push_back(message);
+            }
+
+            for (unsigned int i = 0; i < messages.size(); ++i)
+            {
+                messages[i]->join();
+                delete messages[i];
+            }
+        }
+
+        // cpu only, set before open(): whether the workers are pinned to cores (see CPUTopology)
+        void setPinning(bool isPinned)
+        {
+            m_isPinned = isPinned;
+        }
+
+        // the NUMA node of a cpu device, 0 on gpu
+        unsigned int numaNode(unsigned int deviceId) const
+        {
+            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+            {
+                if (deviceId < m_deviceList.size())
+                {
+                    return m_deviceList[deviceId]->numaNode();
+                }
+            }
+
+            return 0;
+        }
+
+        // the messages waiting on the command queue of a cpu device, 0 on gpu where the work
+        // is launched from the calling thread
+        unsigned int queueDepth(unsigned int deviceId) const
+        {
+            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+            {
+                if (deviceId < m_deviceList.size())
+                {
+                    return m_deviceList[deviceId]->queueDepth();
+                }
+            }
+
+            return 0;
+        }
+
         void close()
         {
             if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
@@ -158,6 +315,11 @@ namespace FreeWill
             return m_deviceCount;
         }
 
+        bool hasPeerAccess() const
+        {
+            return m_hasPeerAccess;
+        }
+
         const cudnnHandle_t & cudnnHandle(unsigned int deviceId) const
         {
             if constexpr (DeviceUsed == FreeWill::DeviceType::GPU_CUDA)
@@ -177,6 +339,205 @@ namespace FreeWill
             return (cublasHandle_t)0;
         }
 
+        // the handle bound to compute stream lane of deviceId, for work an operator spreads over
+        // two lanes
+        cublasHandle_t cublasHandle(unsigned int deviceId, unsigned int lane) const
+        {
+            if constexpr (DeviceUsed == FreeWill::DeviceType::GPU_CUDA)
+            {
+                return m_deviceList[deviceId]->cublasHandle(lane);
+            }
+            return (cublasHandle_t)0;
+        }
+
+        cudaStream_t copyStream(unsigned int deviceId) const
+        {
+            if constexpr (DeviceUsed == FreeWill::DeviceType::GPU_CUDA)
+            {
+                return m_deviceList[deviceId]->copyStream();
+            }
+            return (cudaStream_t)0;
+        }
+
+        // Kernels on the compute streams are not ordered against copyStream(). Make them wait
+        // with cudaStreamWaitEvent on the returned event, or synchronize on it from the host
+        // before reusing the host buffers.
+        cudaEvent_t recordCopies(unsigned int deviceId)
+        {
+            if constexpr (DeviceUsed == FreeWill::DeviceType::GPU_CUDA)
+            {
+                return m_deviceList[deviceId]->recordCopies();
+            }
+            return (cudaEvent_t)0;
+        }
+
+        cudaStream_t downloadStream(unsigned int deviceId) const
+        {
+            if constexpr (DeviceUsed == FreeWill::DeviceType::GPU_CUDA)
+            {
+                return m_deviceList[deviceId]->downloadStream();
+            }
+            return (cudaStream_t)0;
+        }
+
+        // the counterpart of recordCopies() for downloadStream()
+        cudaEvent_t recordDownloads(unsigned int deviceId)
+        {
+            if constexpr (DeviceUsed == FreeWill::DeviceType::GPU_CUDA)
+            {
+                return m_deviceList[deviceId]->recordDownloads();
+            }
+            return (cudaEvent_t)0;
+        }
+
+        cudaStream_t computeStream(unsigned int deviceId, unsigned int lane) const
+        {
+            if constexpr (DeviceUsed == FreeWill::DeviceType::GPU_CUDA)
+            {
+                return m_deviceList[deviceId]->computeStream(lane);
+            }
+            return (cudaStream_t)0;
+        }
+
+        unsigned int computeLane(unsigned int deviceId) const
+        {
+            if constexpr (DeviceUsed == FreeWill::DeviceType::GPU_CUDA)
+            {
+                return m_deviceList[deviceId]->computeLane();
+            }
+            return 0;
+        }
+
+        // Until the next call, the operators of deviceId issue their work on compute stream
+        // lane of it, see Device::setComputeLane. deviceId has to be the current device.
+        void setComputeLane(unsigned int deviceId, unsigned int lane)
+        {
+            if constexpr (DeviceUsed == FreeWill::DeviceType::GPU_CUDA)
+            {
+                m_deviceList[deviceId]->setComputeLane(lane);
+            }
+        }
+
+        // Makes lane 0 of every device wait for the work queued so far on lane 0 of all the
+        // others, without blocking the host. The replicas of a tensor are only read on other
+        // devices (merging gradients, broadcasting weights) between two of these.
+        void joinDevices()
+        {
+            if constexpr (DeviceUsed == FreeWill::DeviceType::GPU_CUDA)
+            {
+                if (m_deviceCount < 2)
+                {
+                    return;
+                }
+
+                int currentDevice = 0;
+                RUN_CUDA(cudaGetDevice(&currentDevice));
+
+                std::vector<cudaEvent_t> events;
+                for (int d = 0; d < m_deviceCount; ++d)
+                {
+                    RUN_CUDA(cudaSetDevice(d));
+                    events.push_back(m_deviceList[d]->recordCompute());
+                }
+
+                for (int d = 0; d < m_deviceCount; ++d)
+                {
+                    RUN_CUDA(cudaSetDevice(d));
+                    for (int e = 0; e < m_deviceCount; ++e)
+                    {
+                        if (e != d)
+                        {
+                            RUN_CUDA(cudaStreamWaitEvent(m_deviceList[d]->computeStream(0), events[e], 0));
+                        }
+                    }
+                }
+
+                RUN_CUDA(cudaSetDevice(currentDevice));
+            }
+        }
+
+        // Makes lane 0 of deviceId wait for the work queued so far on lane 0 of sourceDeviceId,
+        // the one-way joinDevices a pipeline orders a transfer between two stages with.
+        void waitForDevice(unsigned int deviceId, unsigned int sourceDeviceId)
+        {
+            if constexpr (DeviceUsed == FreeWill::DeviceType::GPU_CUDA)
+            {
+                if (deviceId == sourceDeviceId)
+                {
+                    return;
+                }
+
+                int currentDevice = 0;
+                RUN_CUDA(cudaGetDevice(&currentDevice));
+
+                RUN_CUDA(cudaSetDevice(sourceDeviceId));
+                cudaEvent_t event = m_deviceList[sourceDeviceId]->recordCompute();
+
+                RUN_CUDA(cudaSetDevice(deviceId));
+                RUN_CUDA(cudaStreamWaitEvent(m_deviceList[deviceId]->computeStream(0), event, 0));
+
+                RUN_CUDA(cudaSetDevice(currentDevice));
+            }
+        }
+
+        // Blocks until the work queued so far on every device is done: that of the calling thread
+        // on its per-thread default stream and on the other compute lanes, and that of the device
+        // workers on theirs.
+        void synchronizeDevices()
+        {
+            if constexpr (DeviceUsed == FreeWill::DeviceType::GPU_CUDA)
+            {
+                int currentDevice = 0;
+                RUN_CUDA(cudaGetDevice(&currentDevice));
+
+                for (int d = 0; d < m_deviceCount; ++d)
+                {
+                    RUN_CUDA(cudaSetDevice(d));
+                    RUN_CUDA(cudaStreamSynchronize(cudaStreamPerThread));
+
+                    for (unsigned int lane = 1; lane < Device<DeviceType::GPU_CUDA>::COMPUTE_LANE_COUNT; ++lane)
+                    {
+                        if (m_deviceList[d]->computeStream(lane))
+                        {
+                            RUN_CUDA(cudaStreamSynchronize(m_deviceList[d]->computeStream(lane)));
+                        }
+                    }
+                }
+
+                RUN_CUDA(cudaSetDevice(currentDevice));
+
+                runOnEveryDevice([](unsigned int){});
+            }
+        }
+
+        // The cuDNN workspace shared by the operators of deviceId, see Device::reserveWorkspace.
+        // ConvolutionAlgorithmCache::setWorkspaceLimit bounds what an operator reserves.
+        void reserveWorkspace(unsigned int deviceId, size_t sizeInByte)
+        {
+            if constexpr (DeviceUsed == FreeWill::DeviceType::GPU_CUDA)
+            {
+                m_deviceList[deviceId]->reserveWorkspace(sizeInByte);
+            }
+        }
+
+        void *workspace(unsigned int deviceId) const
+        {
+            if constexpr (DeviceUsed == FreeWill::DeviceType::GPU_CUDA)
+            {
+                return m_deviceList[deviceId]->workspace();
+            }
+            return nullptr;
+        }
+
+        size_t workspaceSize(unsigned int deviceId) const
+        {
+            if constexpr (DeviceUsed == FreeWill::DeviceType::GPU_CUDA)
+            {
+                return m_deviceList[deviceId]->workspaceSize();
+            }
+            return 0;
+        }
+
         template<typename DataType = float>
         DataType *getSharedOneVector(const unsigned int requestedVectorSize)
         {
@@ -193,6 +554,16 @@ namespace FreeWill
                 vectorSize = &m_sharedOneVectorDoubleSize;
                 vectorBuffer = &m_sharedOneVectorDouble;
            }
+           else if constexpr (std::is_same<DataType, Half>::value)
+           {
+                vectorSize = &m_sharedOneVectorHalfSize;
+                vectorBuffer = &m_sharedOneVectorHalf;
+           }
+           else if constexpr (std::is_same<DataType, BFloat16>::value)
+           {
+                vectorSize = &m_sharedOneVectorBFloat16Size;
+                vectorBuffer = &m_sharedOneVectorBFloat16;
+           }
 
            if ((*vectorSize) < requestedVectorSize)
            {
@@ -206,7 +577,7 @@ namespace FreeWill
 
                for (unsigned int i =0;i<*vectorSize;++i)
                {
-                    initializeBuffer[i] = 1.0;
+                    initializeBuffer[i] = 1.0f;
                }
 
                RUN_CUDA(cudaMemcpy(*vectorBuffer, initializeBuffer, sizeof(DataType) * (*vectorSize), cudaMemcpyHostToDevice));
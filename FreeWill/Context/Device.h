@@ -12,6 +12,7 @@
 #include <cuda.h>
 #include <cudnn.h>
 #include <cublas_v2.h>
+#include "ComputeStream.h"
 
 namespace FreeWill
 {
@@ -30,6 +31,11 @@ namespace FreeWill
     template<>
     class Device<DeviceType::GPU_CUDA>
     {
+    public:
+        // Compute streams per device. Lane 0 is the per-thread default stream everything runs on
+        // unless GraphExecutor places an operator that doesn't depend on it on another lane.
+        static const unsigned int COMPUTE_LANE_COUNT = 2;
+
     private:
         std::thread *m_workerThread;
         bool m_finished = false;
@@ -38,10 +44,37 @@ namespace FreeWill
         unsigned int m_deviceId;
         unsigned int m_cudaDeviceId;
 
-        cudnnHandle_t m_cudnnHandle;
-        cublasHandle_t m_cublasHandle;
+        // a cuDNN and a cuBLAS handle bound to each compute stream, cudnnHandle() and
+        // cublasHandle() hand out those of the current lane
+        cudaStream_t m_computeStreams[COMPUTE_LANE_COUNT];
+        cudnnHandle_t m_cudnnHandles[COMPUTE_LANE_COUNT];
+        cublasHandle_t m_cublasHandles[COMPUTE_LANE_COUNT];
+        unsigned int m_computeLane;
+
+        // host to device uploads run here so they can overlap kernels
+        cudaStream_t m_copyStream;
+        cudaEvent_t m_copyEvent;
+
+        // device to host downloads and copies to other devices, apart from the uploads so
+        // that writing a checkpoint out doesn't hold back the next batch
+        cudaStream_t m_downloadStream;
+        cudaEvent_t m_downloadEvent;
+
+        // marks the work queued on lane 0 for the other devices to wait on, see
+        // Context::joinDevices
+        cudaEvent_t m_computeEvent;
+
+        // the cuDNN workspace of the operators of a lane, they run one after another on its
+        // stream, so one of the largest size reserved is enough. The other lanes take theirs
+        // when they are first used.
+        void *m_workspaces[COMPUTE_LANE_COUNT];
+        size_t m_workspaceSizes[COMPUTE_LANE_COUNT];
+        size_t m_workspaceSize;
+
         void threadLoop();
 
+        void allocateWorkspace(unsigned int lane);
+
     public:
         Device(unsigned int deviceId = 0)
             : m_workerThread(nullptr),
@@ -49,18 +82,93 @@ namespace FreeWill
               m_commandQueue(100),
               m_deviceId(deviceId),
               m_cudaDeviceId(deviceId),
-              m_cudnnHandle(nullptr),
-              m_cublasHandle(nullptr)
+              m_computeStreams(),
+              m_cudnnHandles(),
+              m_cublasHandles(),
+              m_computeLane(0),
+              m_copyStream(nullptr),
+              m_copyEvent(nullptr),
+              m_downloadStream(nullptr),
+              m_downloadEvent(nullptr),
+              m_computeEvent(nullptr),
+              m_workspaces(),
+              m_workspaceSizes(),
+              m_workspaceSize(0)
         {}
 
         const cudnnHandle_t & cudnnHandle() const
         {
-            return m_cudnnHandle;
+            return m_cudnnHandles[m_computeLane];
         }
 
         const cublasHandle_t & cublasHandle() const
         {
-            return m_cublasHandle;
+            return m_cublasHandles[m_computeLane];
+        }
+
+        cublasHandle_t cublasHandle(unsigned int lane) const
+        {
+            return m_cublasHandles[lane];
+        }
+
+        cudaStream_t computeStream(unsigned int lane) const
+        {
+            return m_computeStreams[lane];
+        }
+
+        unsigned int computeLane() const
+        {
+            return m_computeLane;
+        }
+
+        // Makes the handles, the workspace and, for the calling thread, computeStream() those
+        // of lane. The device has to be current.
+        void setComputeLane(unsigned int lane);
+
+        cudaStream_t copyStream() const
+        {
+            return m_copyStream;
+        }
+
+        // the returned event completes once every copy queued so far on copyStream() has
+        cudaEvent_t recordCopies()
+        {
+            RUN_CUDA(cudaEventRecord(m_copyEvent, m_copyStream));
+            return m_copyEvent;
+        }
+
+        cudaStream_t downloadStream() const
+        {
+            return m_downloadStream;
+        }
+
+        // the same for downloadStream()
+        cudaEvent_t recordDownloads()
+        {
+            RUN_CUDA(cudaEventRecord(m_downloadEvent, m_downloadStream));
+            return m_downloadEvent;
+        }
+
+        // the same for lane 0 of the calling thread, the device has to be current
+        cudaEvent_t recordCompute()
+        {
+            RUN_CUDA(cudaEventRecord(m_computeEvent, m_computeStreams[0]));
+            return m_computeEvent;
+        }
+
+        // Grows the shared workspace to at least sizeInByte. Growing frees the old one, which
+        // waits for the kernels using it, so operators reserve at init and take workspace()
+        // when they run.
+        void reserveWorkspace(size_t sizeInByte);
+
+        void *workspace() const
+        {
+            return m_workspaces[m_computeLane];
+        }
+
+        size_t workspaceSize() const
+        {
+            return m_workspaceSize;
         }
 
 
@@ -71,17 +179,54 @@ namespace FreeWill
                 delete m_workerThread;
             }
             RUN_CUDA(cudaSetDevice(m_cudaDeviceId));
-            if (m_cudnnHandle)
+            for (unsigned int i = 0; i < COMPUTE_LANE_COUNT; ++i)
+            {
+                if (m_cudnnHandles[i])
+                {
+                    RUN_CUDNN( cudnnDestroy(m_cudnnHandles[i]));
+                }
+                if (m_cublasHandles[i])
+                {
+                    RUN_CUBLAS( cublasDestroy(m_cublasHandles[i]));
+                }
+                // lane 0 is the per-thread default stream, it isn't ours to destroy
+                if (i > 0 && m_computeStreams[i])
+                {
+                    RUN_CUDA(cudaStreamDestroy(m_computeStreams[i]));
+                }
+                if (m_workspaces[i])
+                {
+                    BlobAllocator::getSingleton().freeDevice(m_workspaces[i]);
+                }
+            }
+            if (m_copyEvent)
+            {
+                RUN_CUDA(cudaEventDestroy(m_copyEvent));
+            }
+            if (m_copyStream)
+            {
+                RUN_CUDA(cudaStreamDestroy(m_copyStream));
+            }
+            if (m_downloadEvent)
             {
-                RUN_CUDNN( cudnnDestroy(m_cudnnHandle));
+                RUN_CUDA(cudaEventDestroy(m_downloadEvent));
             }
-            if (m_cublasHandle)
+            if (m_downloadStream)
             {
-                RUN_CUBLAS( cublasDestroy(m_cublasHandle));
+                RUN_CUDA(cudaStreamDestroy(m_downloadStream));
+            }
+            if (m_computeEvent)
+            {
+                RUN_CUDA(cudaEventDestroy(m_computeEvent));
             }
             cudaDeviceReset();
         }
 
+        bool isWorkerThread() const
+        {
+            return m_workerThread && m_workerThread->get_id() == std::this_thread::get_id();
+        }
+
         void pushWork(WorkerMessage *message);
 
         void init();
@@ -99,16 +244,37 @@ namespace FreeWill
         bool m_finished = false;
         Ringbuffer<WorkerMessage> m_commandQueue;
         unsigned int m_deviceId;
+        // the core the worker is pinned to, -1 leaves it to the scheduler, and its NUMA node
+        int m_cpu;
+        unsigned int m_numaNode;
 
         void threadLoop();
 
     public:
-        Device(unsigned int deviceId = 0)
+        Device(unsigned int deviceId = 0, int cpu = -1, unsigned int numaNode = 0)
             : m_workerThread(nullptr),
               m_finished(false),
               m_commandQueue(100),
-              m_deviceId(deviceId)
+              m_deviceId(deviceId),
+              m_cpu(cpu),
+              m_numaNode(numaNode)
+        {
+        }
+
+        unsigned int numaNode() const
+        {
+            return m_numaNode;
+        }
+
+        bool isWorkerThread() const
+        {
+            return m_workerThread && m_workerThread->get_id() == std::this_thread::get_id();
+        }
+
+        // the messages pushed and not yet taken by the worker
+        unsigned int queueDepth() const
         {
+            return m_commandQueue.size();
         }
 
         ~Device()
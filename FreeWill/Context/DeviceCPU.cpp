@@ -1,12 +1,20 @@
 #include "Device.h"
 #include "../Model/Model.h"
+#include "Profiler.h"
+#include "PerformanceCounters.h"
+#include <iostream>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 void FreeWill::Device<FreeWill::DeviceType::CPU_NAIVE>::pushWork(FreeWill::WorkerMessage *message)
 {
-    m_commandQueue.push(message);
-
+    // the worker owns the message once it is queued
     message->thread_id = 1;
 
+    m_commandQueue.push(message);
 }
 
 void FreeWill::Device<FreeWill::DeviceType::CPU_NAIVE>::terminate()
@@ -34,13 +42,47 @@ void FreeWill::Device<FreeWill::DeviceType::CPU_NAIVE>::threadLoop()
             message->done();
             break;
         }
+
+        if (message->workType() == FreeWill::WorkerMessage::Type::TASK)
+        {
+            message->runTask();
+            message->done();
+            continue;
+        }
         /*{
             std::unique_lock<std::mutex> ol(outputLock);
             std::cout << "thread: " << this_id << " device "<< m_deviceId << " output." << message->debug_num << std::endl;
         }*/
         {
             Operator<FreeWill::DeviceType::CPU_NAIVE> *operatorBase = message->template operatorBase<FreeWill::DeviceType::CPU_NAIVE>();
+            FreeWill::ProfileRecord *profileRecord = message->profileRecord();
+
+            FreeWill::CounterValues beginCounters;
+            bool isCounting = profileRecord && FreeWill::Profiler::getSingleton().isCountingEvents() &&
+                    FreeWill::PerformanceCounters::forThisThread().read(beginCounters);
+
+            if (profileRecord)
+            {
+                profileRecord->m_beginTime = FreeWill::Profiler::getSingleton().now();
+            }
+
             operatorBase->evaluate();
+
+            if (profileRecord)
+            {
+                profileRecord->m_endTime = FreeWill::Profiler::getSingleton().now();
+            }
+
+            FreeWill::CounterValues endCounters;
+
+            if (isCounting && FreeWill::PerformanceCounters::forThisThread().read(endCounters))
+            {
+                profileRecord->m_hasCounters = true;
+                profileRecord->m_cycles = endCounters.m_cycles - beginCounters.m_cycles;
+                profileRecord->m_instructions = endCounters.m_instructions - beginCounters.m_instructions;
+                profileRecord->m_cacheMisses = endCounters.m_cacheMisses - beginCounters.m_cacheMisses;
+                profileRecord->m_fpInstructions = endCounters.m_fpInstructions - beginCounters.m_fpInstructions;
+            }
         }
 
         message->done();
@@ -53,11 +95,21 @@ void FreeWill::Device<FreeWill::DeviceType::CPU_NAIVE>::threadLoop()
 void FreeWill::Device<FreeWill::DeviceType::CPU_NAIVE>::init()
 {
     m_workerThread = new std::thread([=]{FreeWill::Device<FreeWill::DeviceType::CPU_NAIVE>::threadLoop();});
-    /*cpu_set_t cpuset;
-    CPU_ZERO(&cpuset);
-    CPU_SET(m_deviceId, &cpuset);
-    int rc = pthread_setaffinity_np(m_workerThread->native_handle(),
-                                    sizeof(cpu_set_t), &cpuset);*/
+
+#ifdef __linux__
+    // the worker stays on its core, so what it first touches stays in its node's memory
+    if (m_cpu >= 0)
+    {
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(m_cpu, &cpuset);
+
+        if (pthread_setaffinity_np(m_workerThread->native_handle(), sizeof(cpu_set_t), &cpuset) != 0)
+        {
+            std::cerr << "can't pin device " << m_deviceId << " to cpu " << m_cpu << std::endl;
+        }
+    }
+#endif
      //struct sched_param param = {0};
      //param.sched_priority = 99;
 
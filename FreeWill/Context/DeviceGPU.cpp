@@ -3,10 +3,10 @@
 
 void FreeWill::Device<FreeWill::DeviceType::GPU_CUDA>::pushWork(FreeWill::WorkerMessage *message)
 {
-    m_commandQueue.push(message);
-
+    // the worker owns the message once it is queued
     message->thread_id = 1;
 
+    m_commandQueue.push(message);
 }
 
 void FreeWill::Device<FreeWill::DeviceType::GPU_CUDA>::terminate()
@@ -36,6 +36,13 @@ void FreeWill::Device<FreeWill::DeviceType::GPU_CUDA>::threadLoop()
             message->done();
             break;
         }
+
+        if (message->workType() == FreeWill::WorkerMessage::Type::TASK)
+        {
+            message->runTask();
+            message->done();
+            continue;
+        }
         /*{
             std::unique_lock<std::mutex> ol(outputLock);
             std::cout << "thread: " << this_id << " device "<< m_deviceId << " output." << message->debug_num << std::endl;
@@ -66,6 +73,73 @@ void FreeWill::Device<FreeWill::DeviceType::GPU_CUDA>::init()
     //pthread_setschedparam(m_workerThread->native_handle(), SCHED_BATCH, &param);
 
     RUN_CUDA( cudaSetDevice(m_cudaDeviceId));
-    RUN_CUDNN( cudnnCreate(&m_cudnnHandle));
-    RUN_CUBLAS( cublasCreate(&m_cublasHandle));
+    // the kernels of the build go to the per-thread default stream, which unlike the legacy
+    // stream can be captured into a CUDA graph. The other lanes are non blocking so they don't
+    // serialize with it, GraphExecutor orders them with events.
+    m_computeStreams[0] = cudaStreamPerThread;
+    for (unsigned int i = 1; i < COMPUTE_LANE_COUNT; ++i)
+    {
+        RUN_CUDA( cudaStreamCreateWithFlags(&m_computeStreams[i], cudaStreamNonBlocking));
+    }
+    for (unsigned int i = 0; i < COMPUTE_LANE_COUNT; ++i)
+    {
+        RUN_CUDNN( cudnnCreate(&m_cudnnHandles[i]));
+        RUN_CUBLAS( cublasCreate(&m_cublasHandles[i]));
+        RUN_CUDNN( cudnnSetStream(m_cudnnHandles[i], m_computeStreams[i]));
+        RUN_CUBLAS( cublasSetStream(m_cublasHandles[i], m_computeStreams[i]));
+    }
+    // non blocking, so the copies do not serialize with kernels on the default stream
+    RUN_CUDA( cudaStreamCreateWithFlags(&m_copyStream, cudaStreamNonBlocking));
+    RUN_CUDA( cudaEventCreateWithFlags(&m_copyEvent, cudaEventDisableTiming));
+    RUN_CUDA( cudaStreamCreateWithFlags(&m_downloadStream, cudaStreamNonBlocking));
+    RUN_CUDA( cudaEventCreateWithFlags(&m_downloadEvent, cudaEventDisableTiming));
+    RUN_CUDA( cudaEventCreateWithFlags(&m_computeEvent, cudaEventDisableTiming));
+}
+
+void FreeWill::Device<FreeWill::DeviceType::GPU_CUDA>::setComputeLane(unsigned int lane)
+{
+    if (m_workspaceSizes[lane] < m_workspaceSize)
+    {
+        allocateWorkspace(lane);
+    }
+
+    m_computeLane = lane;
+    FreeWill::setComputeStream(m_computeStreams[lane]);
+}
+
+void FreeWill::Device<FreeWill::DeviceType::GPU_CUDA>::allocateWorkspace(unsigned int lane)
+{
+    if (m_workspaces[lane])
+    {
+        // the allocator hands the block out again right away, the kernels using it finish first
+        RUN_CUDA(cudaDeviceSynchronize());
+        BlobAllocator::getSingleton().freeDevice(m_workspaces[lane]);
+    }
+
+    BlobAllocator::Tag tag(MemoryCategory::WORKSPACE, "workspace");
+    m_workspaces[lane] = BlobAllocator::getSingleton().allocateDevice(m_workspaceSize);
+    m_workspaceSizes[lane] = m_workspaceSize;
+}
+
+void FreeWill::Device<FreeWill::DeviceType::GPU_CUDA>::reserveWorkspace(size_t sizeInByte)
+{
+    if (sizeInByte <= m_workspaceSize)
+    {
+        return;
+    }
+
+    int currentDevice = 0;
+    RUN_CUDA(cudaGetDevice(&currentDevice));
+    RUN_CUDA(cudaSetDevice(m_cudaDeviceId));
+
+    m_workspaceSize = sizeInByte;
+
+    // lane 0 is always used, the others grow when setComputeLane picks them again
+    allocateWorkspace(0);
+    if (m_computeLane != 0)
+    {
+        allocateWorkspace(m_computeLane);
+    }
+
+    RUN_CUDA(cudaSetDevice(currentDevice));
 }
@@ -0,0 +1,121 @@
+#include "PerformanceCounters.h"
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static int openEvent(uint32_t type, uint64_t config, int groupDescriptor)
+{
+    perf_event_attr attribute;
+    memset(&attribute, 0, sizeof(attribute));
+    attribute.size = sizeof(attribute);
+    attribute.type = type;
+    attribute.config = config;
+    attribute.read_format = PERF_FORMAT_GROUP;
+    attribute.exclude_kernel = 1;
+    attribute.exclude_hv = 1;
+    // the leader starts the group once all are in
+    attribute.disabled = groupDescriptor < 0 ? 1 : 0;
+
+    return (int) syscall(SYS_perf_event_open, &attribute, 0, -1, groupDescriptor, 0);
+}
+#endif
+
+FreeWill::PerformanceCounters::PerformanceCounters()
+    :m_descriptors(),
+      m_isOpen(false)
+{
+    for (unsigned int i = 0; i < EVENT_COUNT; ++i)
+    {
+        m_descriptors[i] = -1;
+    }
+
+    open();
+}
+
+FreeWill::PerformanceCounters::~PerformanceCounters()
+{
+#ifdef __linux__
+    for (unsigned int i = 0; i < EVENT_COUNT; ++i)
+    {
+        if (m_descriptors[i] >= 0)
+        {
+            close(m_descriptors[i]);
+        }
+    }
+#endif
+}
+
+FreeWill::PerformanceCounters &FreeWill::PerformanceCounters::forThisThread()
+{
+    static thread_local PerformanceCounters counters;
+    return counters;
+}
+
+bool FreeWill::PerformanceCounters::isAvailable()
+{
+    return forThisThread().m_isOpen;
+}
+
+void FreeWill::PerformanceCounters::open()
+{
+#ifdef __linux__
+    m_descriptors[CYCLES] = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1);
+
+    if (m_descriptors[CYCLES] < 0)
+    {
+        return;
+    }
+
+    m_descriptors[INSTRUCTIONS] = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, m_descriptors[CYCLES]);
+    m_descriptors[CACHE_MISSES] = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, m_descriptors[CYCLES]);
+
+#if defined(__x86_64__)
+    // FP_ARITH_INST_RETIRED with every umask bit, scalar and packed of all widths. Other
+    // vendors take the code for something else, the group would count garbage.
+    if (__builtin_cpu_is("intel"))
+    {
+        m_descriptors[FP_INSTRUCTIONS] = openEvent(PERF_TYPE_RAW, 0xffc7, m_descriptors[CYCLES]);
+    }
+#endif
+
+    if (m_descriptors[INSTRUCTIONS] < 0 || m_descriptors[CACHE_MISSES] < 0)
+    {
+        return;
+    }
+
+    m_isOpen = ioctl(m_descriptors[CYCLES], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP) == 0 &&
+            ioctl(m_descriptors[CYCLES], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP) == 0;
+#endif
+}
+
+bool FreeWill::PerformanceCounters::read(CounterValues &values) const
+{
+#ifdef __linux__
+    if (!m_isOpen)
+    {
+        return false;
+    }
+
+    // the number of events then their values in the order they joined the group
+    uint64_t buffer[1 + EVENT_COUNT] = {0};
+
+    if (::read(m_descriptors[CYCLES], buffer, sizeof(buffer)) <= 0 || buffer[0] < 3)
+    {
+        return false;
+    }
+
+    values.m_cycles = buffer[1 + CYCLES];
+    values.m_instructions = buffer[1 + INSTRUCTIONS];
+    values.m_cacheMisses = buffer[1 + CACHE_MISSES];
+    values.m_fpInstructions = buffer[0] > FP_INSTRUCTIONS ? buffer[1 + FP_INSTRUCTIONS] : 0;
+
+    return true;
+#else
+    (void) values;
+    return false;
+#endif
+}
@@ -0,0 +1,66 @@
+#ifndef PERFORMANCECOUNTERS_H
+#define PERFORMANCECOUNTERS_H
+
+#include <cstdint>
+
+namespace FreeWill
+{
+    struct CounterValues
+    {
+        uint64_t m_cycles = 0;
+        uint64_t m_instructions = 0;
+        // last level cache misses, each one a cache line read from memory
+        uint64_t m_cacheMisses = 0;
+        // retired floating point arithmetic instructions, scalar and packed alike, 0 where
+        // the cpu has no such event
+        uint64_t m_fpInstructions = 0;
+    };
+
+    // The hardware counters of the calling thread, read with perf_event_open on linux. The
+    // events are one group so they are scheduled together and read with one call, user space
+    // only so that the default perf_event_paranoid of 2 allows them. The floating point
+    // event is the raw FP_ARITH_INST_RETIRED of Intel cores and left out elsewhere.
+    //
+    // Every thread opens its own group the first time it reads (see forThisThread), when
+    // perf isn't there or not permitted read() returns false from then on.
+    class PerformanceCounters
+    {
+    private:
+        enum Event
+        {
+            CYCLES,
+            INSTRUCTIONS,
+            CACHE_MISSES,
+            FP_INSTRUCTIONS,
+            EVENT_COUNT
+        };
+
+        int m_descriptors[EVENT_COUNT];
+        bool m_isOpen;
+
+        PerformanceCounters();
+
+        void open();
+
+    public:
+        ~PerformanceCounters();
+
+        PerformanceCounters(const PerformanceCounters &) = delete;
+        void operator=(const PerformanceCounters &) = delete;
+
+        static PerformanceCounters &forThisThread();
+
+        // whether the counters can be read on this machine, opens those of the calling thread
+        static bool isAvailable();
+
+        bool hasFPInstructions() const
+        {
+            return m_descriptors[FP_INSTRUCTIONS] >= 0;
+        }
+
+        // the counts since the group was opened
+        bool read(CounterValues &values) const;
+    };
+}
+
+#endif
@@ -0,0 +1,556 @@
+#include "Profiler.h"
+#include "Context.h"
+#include "PerformanceCounters.h"
+#include "../DeviceSelection.h"
+#include "../Tensor/BlobAllocator.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static std::string escapeJSON(const std::string &text)
+{
+    std::string escaped;
+
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            escaped += '\\';
+        }
+
+        if ((unsigned char) c >= 0x20)
+        {
+            escaped += c;
+        }
+    }
+
+    return escaped;
+}
+
+FreeWill::Profiler::Profiler()
+    :m_isEnabled(false),
+      m_isCountingEvents(false),
+      m_rooflines(),
+      m_isTracing(true),
+      m_origin(std::chrono::steady_clock::now()),
+      m_mutex(),
+      m_records(),
+      m_busyTimes(),
+      m_stepCount(0),
+      m_lastStepTime(0.0),
+      m_lastMetricsTime(0.0),
+      m_sampleCount(0),
+      m_stepLatencies(),
+      m_evaluation(),
+      m_pendingGPURecords(),
+      m_deviceClocks(),
+      m_freeEvents()
+{}
+
+void FreeWill::Profiler::enable(bool isTracing)
+{
+    flush();
+    clear();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_isTracing = isTracing;
+    m_origin = std::chrono::steady_clock::now();
+    m_busyTimes.clear();
+    m_stepCount = 0;
+    m_lastStepTime = 0.0;
+    m_lastMetricsTime = 0.0;
+    m_sampleCount = 0;
+    m_stepLatencies.clear();
+    m_evaluation = EvaluationMetrics();
+    m_isEnabled.store(true);
+}
+
+void FreeWill::Profiler::disable()
+{
+    m_isEnabled.store(false);
+    flush();
+}
+
+bool FreeWill::Profiler::enableCounters(bool isCountingEvents)
+{
+    // the workers open their own counters on their first read, this only checks the
+    // calling thread can
+    isCountingEvents = isCountingEvents && PerformanceCounters::isAvailable();
+    m_isCountingEvents.store(isCountingEvents);
+
+    return isCountingEvents;
+}
+
+void FreeWill::Profiler::setRoofline(DeviceType deviceType, double peakGFlops, double bandwidthGBs)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    Roofline &roofline = m_rooflines[deviceType == DeviceType::GPU_CUDA ? 1 : 0];
+    roofline.m_peakGFlops = peakGFlops;
+    roofline.m_bandwidthGBs = bandwidthGBs;
+}
+
+bool FreeWill::Profiler::loadRooflines(const std::string &fileName, const std::string &dataType)
+{
+    std::ifstream file(fileName);
+
+    if (!file.is_open())
+    {
+        std::cerr << "can't read the rooflines from " << fileName << std::endl;
+        return false;
+    }
+
+    std::stringstream stream;
+    stream << file.rdbuf();
+    std::string text = stream.str();
+
+    // the entries of the "rooflines" object, e.g. "CPU_NAIVE/float":{"peakGFlops":..,"bandwidthGBs":..}
+    auto number = [&text](size_t begin, const std::string &key) -> double
+    {
+        size_t position = text.find("\"" + key + "\":", begin);
+        size_t end = text.find('}', begin);
+
+        if (position == std::string::npos || position > end)
+        {
+            return 0.0;
+        }
+
+        return strtod(text.c_str() + position + key.size() + 3, nullptr);
+    };
+
+    bool isLoaded = false;
+    const std::pair<DeviceType, const char*> devices[] = {{DeviceType::CPU_NAIVE, "CPU_NAIVE"}, {DeviceType::GPU_CUDA, "GPU_CUDA"}};
+
+    for (const std::pair<DeviceType, const char*> &device : devices)
+    {
+        size_t begin = text.find("\"" + std::string(device.second) + "/" + dataType + "\":");
+
+        if (begin != std::string::npos)
+        {
+            setRoofline(device.first, number(begin, "peakGFlops"), number(begin, "bandwidthGBs"));
+            isLoaded = true;
+        }
+    }
+
+    return isLoaded;
+}
+
+void FreeWill::Profiler::record(const ProfileRecord &record)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    addRecord(record);
+}
+
+void FreeWill::Profiler::addRecord(const ProfileRecord &record)
+{
+    m_busyTimes[std::make_pair(record.m_isGPU, record.m_deviceId)] += record.duration();
+
+    if (m_isTracing)
+    {
+        m_records.push_back(record);
+    }
+}
+
+cudaEvent_t FreeWill::Profiler::takeEvent(unsigned int deviceId)
+{
+    std::vector<cudaEvent_t> &freeEvents = m_freeEvents[deviceId];
+    cudaEvent_t event = nullptr;
+
+    if (freeEvents.empty())
+    {
+        RUN_CUDA(cudaEventCreate(&event));
+        return event;
+    }
+
+    event = freeEvents.back();
+    freeEvents.pop_back();
+
+    return event;
+}
+
+size_t FreeWill::Profiler::beginGPU(const ProfileRecord &record, cudaStream_t stream)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    // the device clock is read through a reference event, recorded once the stream has
+    // drained so the host time taken right after it matches
+    if (m_deviceClocks.find(record.m_deviceId) == m_deviceClocks.end())
+    {
+        DeviceClock clock;
+        clock.m_reference = takeEvent(record.m_deviceId);
+        RUN_CUDA(cudaEventRecord(clock.m_reference, stream));
+        RUN_CUDA(cudaEventSynchronize(clock.m_reference));
+        clock.m_hostTime = now();
+        m_deviceClocks[record.m_deviceId] = clock;
+    }
+
+    PendingGPURecord pending;
+    pending.m_record = record;
+    pending.m_record.m_isGPU = true;
+    pending.m_record.m_queueTime = now();
+    pending.m_begin = takeEvent(record.m_deviceId);
+    pending.m_end = takeEvent(record.m_deviceId);
+    RUN_CUDA(cudaEventRecord(pending.m_begin, stream));
+
+    m_pendingGPURecords.push_back(pending);
+
+    return m_pendingGPURecords.size() - 1;
+}
+
+void FreeWill::Profiler::endGPU(size_t handle, cudaStream_t stream)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    if (handle >= m_pendingGPURecords.size())
+    {
+        return;
+    }
+
+    PendingGPURecord &pending = m_pendingGPURecords[handle];
+    RUN_CUDA(cudaEventRecord(pending.m_end, stream));
+    pending.m_record.m_dispatchTime = now() - pending.m_record.m_queueTime;
+}
+
+void FreeWill::Profiler::flush()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    for (PendingGPURecord &pending : m_pendingGPURecords)
+    {
+        const DeviceClock &clock = m_deviceClocks[pending.m_record.m_deviceId];
+        float beginInMillisecond = 0.0f;
+        float endInMillisecond = 0.0f;
+
+        RUN_CUDA(cudaEventSynchronize(pending.m_end));
+        RUN_CUDA(cudaEventElapsedTime(&beginInMillisecond, clock.m_reference, pending.m_begin));
+        RUN_CUDA(cudaEventElapsedTime(&endInMillisecond, clock.m_reference, pending.m_end));
+
+        pending.m_record.m_beginTime = clock.m_hostTime + beginInMillisecond * 1000.0;
+        pending.m_record.m_endTime = clock.m_hostTime + endInMillisecond * 1000.0;
+        addRecord(pending.m_record);
+    }
+
+    releaseEvents();
+}
+
+void FreeWill::Profiler::releaseEvents()
+{
+    for (PendingGPURecord &pending : m_pendingGPURecords)
+    {
+        m_freeEvents[pending.m_record.m_deviceId].push_back(pending.m_begin);
+        m_freeEvents[pending.m_record.m_deviceId].push_back(pending.m_end);
+    }
+
+    m_pendingGPURecords.clear();
+}
+
+void FreeWill::Profiler::clear()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    releaseEvents();
+
+    // the clocks are pinned again against the next origin
+    for (auto iter = m_deviceClocks.begin(); iter != m_deviceClocks.end(); ++iter)
+    {
+        m_freeEvents[iter->first].push_back(iter->second.m_reference);
+    }
+
+    m_deviceClocks.clear();
+    m_records.clear();
+}
+
+std::vector<FreeWill::ProfileRecord> FreeWill::Profiler::records()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return m_records;
+}
+
+bool FreeWill::Profiler::writeTrace(const std::string &fileName)
+{
+    std::vector<ProfileRecord> records = this->records();
+    std::ofstream file(fileName);
+
+    if (!file.is_open())
+    {
+        std::cerr << "can't write the trace to " << fileName << std::endl;
+        return false;
+    }
+
+    file << "{\"traceEvents\":[" << std::endl;
+    file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"CPU\"}}," << std::endl;
+    file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"GPU\"}}";
+
+    char number[64];
+    auto format = [&number](double value) -> const char*
+    {
+        snprintf(number, sizeof(number), "%.3f", value);
+        return number;
+    };
+
+    for (const ProfileRecord &record : records)
+    {
+        file << "," << std::endl;
+        file << "{\"name\":\"" << escapeJSON(record.m_name) << "\",\"cat\":\"" << escapeJSON(record.m_type) << "\",\"ph\":\"X\"";
+        file << ",\"ts\":" << format(record.m_beginTime);
+        file << ",\"dur\":" << format(record.duration());
+        file << ",\"pid\":" << (record.m_isGPU ? 1 : 0) << ",\"tid\":" << record.m_deviceId;
+        file << ",\"args\":{\"queueWait\":" << format(record.queueWait());
+        file << ",\"dispatch\":" << format(record.m_dispatchTime);
+        file << ",\"flops\":" << format(record.m_flops);
+        file << ",\"bytes\":" << format(record.m_bytes);
+
+        if (record.m_hasCounters)
+        {
+            file << ",\"cycles\":" << format(record.m_cycles);
+            file << ",\"instructions\":" << format(record.m_instructions);
+            file << ",\"cacheMisses\":" << format(record.m_cacheMisses);
+            file << ",\"fpInstructions\":" << format(record.m_fpInstructions);
+        }
+
+        file << "}}";
+    }
+
+    file << std::endl << "],\"displayTimeUnit\":\"ms\"}" << std::endl;
+
+    return file.good();
+}
+
+std::string FreeWill::Profiler::summary()
+{
+    struct Total
+    {
+        unsigned int m_count = 0;
+        bool m_isGPU = false;
+        double m_time = 0.0;
+        double m_queueWait = 0.0;
+        double m_dispatchTime = 0.0;
+        double m_flops = 0.0;
+        double m_bytes = 0.0;
+        // the time of the records with counters, the rates are over it
+        double m_countedTime = 0.0;
+        double m_cycles = 0.0;
+        double m_instructions = 0.0;
+        double m_cacheMisses = 0.0;
+        double m_fpInstructions = 0.0;
+    };
+
+    // what a last level cache miss reads from memory
+    const double cacheLineSize = 64.0;
+
+    std::vector<ProfileRecord> records = this->records();
+    std::map<std::string, Total> totals;
+    Roofline rooflines[2];
+
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        rooflines[0] = m_rooflines[0];
+        rooflines[1] = m_rooflines[1];
+    }
+
+    for (const ProfileRecord &record : records)
+    {
+        Total &total = totals[record.m_type];
+        total.m_count += 1;
+        total.m_isGPU = record.m_isGPU;
+        total.m_time += record.duration();
+        total.m_queueWait += record.queueWait();
+        total.m_dispatchTime += record.m_dispatchTime;
+        total.m_flops += record.m_flops;
+        total.m_bytes += record.m_bytes;
+
+        if (record.m_hasCounters)
+        {
+            total.m_countedTime += record.duration();
+            total.m_cycles += record.m_cycles;
+            total.m_instructions += record.m_instructions;
+            total.m_cacheMisses += record.m_cacheMisses;
+            total.m_fpInstructions += record.m_fpInstructions;
+        }
+    }
+
+    std::vector<std::pair<std::string, Total>> sortedTotals(totals.begin(), totals.end());
+    std::stable_sort(sortedTotals.begin(), sortedTotals.end(), [](const std::pair<std::string, Total> &a, const std::pair<std::string, Total> &b)
+    {
+        return a.second.m_time > b.second.m_time;
+    });
+
+    std::ostringstream output;
+    char line[512];
+
+    // a dash where there is nothing to show
+    char cells[4][32];
+    auto cell = [&cells](unsigned int index, bool isSet, const char *format, double value) -> const char*
+    {
+        if (isSet)
+        {
+            snprintf(cells[index], sizeof(cells[index]), format, value);
+        }
+        else
+        {
+            snprintf(cells[index], sizeof(cells[index]), "-");
+        }
+
+        return cells[index];
+    };
+
+    snprintf(line, sizeof(line), "%-34s %8s %12s %10s %12s %12s %10s %10s %8s %12s %10s %8s\n", "operator", "count", "total(ms)",
+             "mean(us)", "queue(us)", "dispatch(us)", "GFLOP/s", "GB/s", "IPC", "FP Ginst/s", "LLC GB/s", "roof(%)");
+    output << line;
+
+    for (const std::pair<std::string, Total> &entry : sortedTotals)
+    {
+        const Total &total = entry.second;
+        // flops per microsecond are MFLOP/s
+        double gflops = total.m_time > 0.0 ? total.m_flops / total.m_time / 1000.0 : 0.0;
+        double gbytes = total.m_time > 0.0 ? total.m_bytes / total.m_time / 1000.0 : 0.0;
+
+        bool hasCounters = total.m_countedTime > 0.0 && total.m_cycles > 0.0;
+        double ipc = hasCounters ? total.m_instructions / total.m_cycles : 0.0;
+        double fpInstructions = hasCounters ? total.m_fpInstructions / total.m_countedTime / 1000.0 : 0.0;
+        double cacheBytes = hasCounters ? total.m_cacheMisses * cacheLineSize / total.m_countedTime / 1000.0 : 0.0;
+
+        // what the roofline allows at the operator's arithmetic intensity
+        const Roofline &roofline = rooflines[total.m_isGPU ? 1 : 0];
+        double attainable = 0.0;
+
+        if (roofline.m_peakGFlops > 0.0 && roofline.m_bandwidthGBs > 0.0 && total.m_flops > 0.0 && total.m_bytes > 0.0)
+        {
+            attainable = std::min(roofline.m_peakGFlops, roofline.m_bandwidthGBs * total.m_flops / total.m_bytes);
+        }
+
+        snprintf(line, sizeof(line), "%-34s %8u %12.3f %10.2f %12.2f %12.2f %10.3f %10.3f %8s %12s %10s %8s\n", entry.first.c_str(), total.m_count,
+                 total.m_time / 1000.0, total.m_time / total.m_count, total.m_queueWait / total.m_count,
+                 total.m_dispatchTime / total.m_count, gflops, gbytes,
+                 cell(0, hasCounters, "%.2f", ipc),
+                 cell(1, hasCounters && total.m_fpInstructions > 0.0, "%.3f", fpInstructions),
+                 cell(2, hasCounters, "%.3f", cacheBytes),
+                 cell(3, attainable > 0.0, "%.1f", 100.0 * gflops / attainable));
+        output << line;
+    }
+
+    return output.str();
+}
+
+void FreeWill::Profiler::endStep(unsigned int sampleCount)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    double time = now();
+
+    // the first step since enable() has nothing to be measured from
+    if (m_stepCount > 0)
+    {
+        m_stepLatencies.push_back((time - m_lastStepTime) / 1000.0);
+        m_sampleCount += sampleCount;
+    }
+
+    m_lastStepTime = time;
+    m_stepCount += 1;
+}
+
+void FreeWill::Profiler::endEvaluation(unsigned int step, double meanCost, double accuracy)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    m_evaluation.m_count += 1;
+    m_evaluation.m_step = step;
+    m_evaluation.m_meanCost = meanCost;
+    m_evaluation.m_accuracy = accuracy;
+}
+
+FreeWill::TrainingMetrics FreeWill::Profiler::metrics(DeviceType deviceType)
+{
+    TrainingMetrics metrics;
+    bool isGPU = deviceType == DeviceType::GPU_CUDA;
+    unsigned int deviceCount = isGPU ? Context<DeviceType::GPU_CUDA>::getSingleton().deviceCount() :
+                                       Context<DeviceType::CPU_NAIVE>::getSingleton().deviceCount();
+
+    metrics.m_devices.resize(deviceCount);
+
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        for (const PendingGPURecord &pending : m_pendingGPURecords)
+        {
+            if (isGPU && pending.m_record.m_deviceId < deviceCount && cudaEventQuery(pending.m_end) != cudaSuccess)
+            {
+                metrics.m_devices[pending.m_record.m_deviceId].m_queueDepth += 1;
+            }
+        }
+    }
+
+    // the gpu records only get their times once their work is done
+    flush();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    double time = now();
+    double elapsedTime = time - m_lastMetricsTime;
+
+    metrics.m_step = m_stepCount;
+    metrics.m_evaluation = m_evaluation;
+
+    if (!m_stepLatencies.empty())
+    {
+        std::vector<double> latencies = m_stepLatencies;
+        std::sort(latencies.begin(), latencies.end());
+
+        auto percentile = [&latencies](double p) -> double
+        {
+            return latencies[std::min(latencies.size() - 1, (size_t) (p * latencies.size()))];
+        };
+
+        double stepTime = 0.0;
+        for (double latency : latencies)
+        {
+            stepTime += latency;
+        }
+
+        metrics.m_samplesPerSecond = stepTime > 0.0 ? m_sampleCount * 1000.0 / stepTime : 0.0;
+        metrics.m_latencyP50 = percentile(0.5);
+        metrics.m_latencyP90 = percentile(0.9);
+        metrics.m_latencyP99 = percentile(0.99);
+    }
+
+    metrics.m_hostMemoryInByte = BlobAllocator::getSingleton().hostSizeInByte();
+
+    for (const MemoryUsage &usage : BlobAllocator::getSingleton().memoryUsage())
+    {
+        if (usage.m_isHost || isGPU)
+        {
+            metrics.m_memory.push_back(usage);
+        }
+    }
+
+    for (unsigned int d = 0; d < deviceCount; ++d)
+    {
+        DeviceMetrics &device = metrics.m_devices[d];
+        auto busyTime = m_busyTimes.find(std::make_pair(isGPU, d));
+
+        if (busyTime != m_busyTimes.end() && elapsedTime > 0.0)
+        {
+            device.m_utilization = std::min(1.0, busyTime->second / elapsedTime);
+        }
+
+        if (isGPU)
+        {
+            device.m_memoryInByte = BlobAllocator::getSingleton().deviceSizeInByte(d);
+        }
+        else
+        {
+            device.m_queueDepth = Context<DeviceType::CPU_NAIVE>::getSingleton().queueDepth(d);
+            device.m_memoryInByte = BlobAllocator::getSingleton().hostSizeInByte(Context<DeviceType::CPU_NAIVE>::getSingleton().numaNode(d));
+        }
+    }
+
+    m_busyTimes.clear();
+    m_stepLatencies.clear();
+    m_sampleCount = 0;
+    m_lastMetricsTime = time;
+
+    return metrics;
+}
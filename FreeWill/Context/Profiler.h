@@ -0,0 +1,240 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "../Tensor/ReferenceCountedBlob.h"
+#include <cuda_runtime.h>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace FreeWill
+{
+    // One evaluation of one operator replica. The times are host microseconds since
+    // Profiler::enable(), gpu times are mapped onto the host clock.
+    struct ProfileRecord
+    {
+        std::string m_name;
+        // the operator type, e.g. "Convolution", the summary groups by it
+        std::string m_type;
+        unsigned int m_deviceId = 0;
+        bool m_isGPU = false;
+        // when the work was handed to the device: pushed to the worker on cpu, the launch on gpu
+        double m_queueTime = 0.0;
+        double m_beginTime = 0.0;
+        double m_endTime = 0.0;
+        // host time spent handing it over, the launch calls on gpu
+        double m_dispatchTime = 0.0;
+        // estimates, see OperatorDescriptor::profileRecord
+        double m_flops = 0.0;
+        double m_bytes = 0.0;
+        // what the hardware counters of the cpu worker counted over the evaluation, see
+        // Profiler::enableCounters. Helper threads the operator hands work to aren't counted.
+        bool m_hasCounters = false;
+        double m_cycles = 0.0;
+        double m_instructions = 0.0;
+        double m_cacheMisses = 0.0;
+        double m_fpInstructions = 0.0;
+
+        double queueWait() const
+        {
+            return m_beginTime > m_queueTime ? m_beginTime - m_queueTime : 0.0;
+        }
+
+        double duration() const
+        {
+            return m_endTime > m_beginTime ? m_endTime - m_beginTime : 0.0;
+        }
+    };
+
+    struct DeviceMetrics
+    {
+        // the share of the time since the last Profiler::metrics() the device spent in
+        // profiled operators
+        double m_utilization = 0.0;
+        // the work handed to the device and not started: the messages on the command queue
+        // of a cpu device, the profiled launches not finished on a gpu
+        unsigned int m_queueDepth = 0;
+        // live device memory on gpu, the host memory of the device's NUMA node on cpu
+        size_t m_memoryInByte = 0;
+    };
+
+    // the last test set score handed to Profiler::endEvaluation, see AsyncEvaluator
+    struct EvaluationMetrics
+    {
+        // the evaluations ended since Profiler::enable(), 0 when the others aren't set
+        unsigned int m_count = 0;
+        // the training step the evaluated weights are from
+        unsigned int m_step = 0;
+        double m_meanCost = 0.0;
+        double m_accuracy = 0.0;
+    };
+
+    // The training throughput since the previous Profiler::metrics(), see Profiler::endStep.
+    struct TrainingMetrics
+    {
+        // the steps ended since Profiler::enable()
+        unsigned int m_step = 0;
+        double m_samplesPerSecond = 0.0;
+        // percentiles of the time between two steps ending, in milliseconds
+        double m_latencyP50 = 0.0;
+        double m_latencyP90 = 0.0;
+        double m_latencyP99 = 0.0;
+        size_t m_hostMemoryInByte = 0;
+        std::vector<DeviceMetrics> m_devices;
+        // the host memory and on gpu the device memory per category, see BlobAllocator::memoryUsage
+        std::vector<MemoryUsage> m_memory;
+        EvaluationMetrics m_evaluation;
+    };
+
+    // Records what the operators of the hot path cost while enabled, off by default so the
+    // paths only pay one relaxed load. The cpu workers stamp the records their messages carry
+    // (see WorkerMessage::setProfileRecord), the gpu work is bracketed by timing events that
+    // flush() waits for and converts. Nothing is synchronized on the hot path except the first
+    // gpu record of each device, which pins the device clock to the host clock.
+    //
+    // writeTrace() exports Chrome's trace_event format (chrome://tracing, Perfetto), one
+    // process per device type and one thread per device. summary() adds the records up per
+    // operator type.
+    //
+    // With enableCounters() the cpu workers also read their hardware counters around every
+    // evaluation (see PerformanceCounters). The summary then has the instructions per cycle,
+    // the floating point instructions retired and the memory traffic the last level cache
+    // misses make next to the estimates, and with the rooflines of the benchmark suite
+    // (setRoofline, loadRooflines) what share of the attainable GFLOP/s the operators reach.
+    // There are no counters on gpu, its records keep the event times and the estimates.
+    //
+    // For a job that runs for long, enable(false) keeps no records, only the time each device
+    // was busy. The training loop calls endStep() after every step and metrics() now and
+    // then for the throughput, e.g. to show it live on the web ui.
+    class Profiler
+    {
+    private:
+        struct PendingGPURecord
+        {
+            ProfileRecord m_record;
+            cudaEvent_t m_begin;
+            cudaEvent_t m_end;
+        };
+
+        struct DeviceClock
+        {
+            cudaEvent_t m_reference;
+            double m_hostTime;
+        };
+
+        struct Roofline
+        {
+            double m_peakGFlops = 0.0;
+            double m_bandwidthGBs = 0.0;
+        };
+
+        std::atomic<bool> m_isEnabled;
+        std::atomic<bool> m_isCountingEvents;
+        // by whether it is the gpu's, unset ones are 0
+        Roofline m_rooflines[2];
+        bool m_isTracing;
+        std::chrono::steady_clock::time_point m_origin;
+        std::mutex m_mutex;
+        std::vector<ProfileRecord> m_records;
+        // busy microseconds by device type and device since the last metrics()
+        std::map<std::pair<bool, unsigned int>, double> m_busyTimes;
+
+        // the steps since the last metrics()
+        unsigned int m_stepCount;
+        double m_lastStepTime;
+        double m_lastMetricsTime;
+        size_t m_sampleCount;
+        std::vector<double> m_stepLatencies;
+        EvaluationMetrics m_evaluation;
+        std::vector<PendingGPURecord> m_pendingGPURecords;
+        std::map<unsigned int, DeviceClock> m_deviceClocks;
+        // timing events by device, reused across flushes
+        std::map<unsigned int, std::vector<cudaEvent_t>> m_freeEvents;
+
+        Profiler();
+
+        cudaEvent_t takeEvent(unsigned int deviceId);
+        void releaseEvents();
+        void addRecord(const ProfileRecord &record);
+
+    public:
+        static Profiler &getSingleton()
+        {
+            static Profiler obj;
+            return obj;
+        }
+
+        Profiler(const Profiler &) = delete;
+        void operator=(const Profiler &) = delete;
+
+        // drops what was recorded before and restarts the clock. Without tracing only the
+        // busy time of the devices is kept.
+        void enable(bool isTracing = true);
+
+        // flushes, the records stay until the next enable() or clear()
+        void disable();
+
+        bool isEnabled() const
+        {
+            return m_isEnabled.load(std::memory_order_relaxed);
+        }
+
+        double now() const
+        {
+            return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - m_origin).count();
+        }
+
+        // whether the cpu workers read their hardware counters into the records. Returns
+        // false and stays off where the counters can't be read.
+        bool enableCounters(bool isCountingEvents = true);
+
+        bool isCountingEvents() const
+        {
+            return m_isCountingEvents.load(std::memory_order_relaxed);
+        }
+
+        // the peak GFLOP/s and memory bandwidth the summary compares the operators of
+        // deviceType against
+        void setRoofline(DeviceType deviceType, double peakGFlops, double bandwidthGBs);
+
+        // the rooflines of dataType from a benchmark.json the benchmark suite wrote
+        bool loadRooflines(const std::string &fileName, const std::string &dataType = "float");
+
+        void record(const ProfileRecord &record);
+
+        // brackets gpu work queued on stream, the device of record has to be current. begin
+        // returns the handle end takes.
+        size_t beginGPU(const ProfileRecord &record, cudaStream_t stream);
+        void endGPU(size_t handle, cudaStream_t stream);
+
+        // waits for the gpu work recorded so far and moves it to the records
+        void flush();
+
+        void clear();
+
+        std::vector<ProfileRecord> records();
+
+        bool writeTrace(const std::string &fileName);
+
+        // per operator type: evaluations, total, mean and queue wait time, dispatch overhead,
+        // the achieved GFLOP/s and GB/s, the instructions per cycle, floating point
+        // instructions and memory traffic counted, and the share of the roofline reached
+        std::string summary();
+
+        // marks the end of a training step of sampleCount samples, also while disabled
+        void endStep(unsigned int sampleCount);
+
+        // reports the score of an evaluation of the weights of step, from any thread, metrics()
+        // keeps returning it until the next one
+        void endEvaluation(unsigned int step, double meanCost, double accuracy);
+
+        // the throughput of the steps ended since the previous call and the state of the
+        // devices of deviceType now. Waits for the profiled gpu work.
+        TrainingMetrics metrics(DeviceType deviceType);
+    };
+}
+
+#endif
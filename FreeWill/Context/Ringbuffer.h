@@ -1,57 +1,229 @@
 #ifndef RINGBUFFER_H
 #define RINGBUFFER_H
 
-#include "Semaphore.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
 #include <vector>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
 namespace FreeWill
 {
+    static inline void cpuRelax()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        _mm_pause();
+#else
+        std::this_thread::yield();
+#endif
+    }
 
+    // Bounded lock-free MPMC queue (per-cell sequence numbers). push() and pop() spin for a
+    // short while on a full or empty queue and then block. The mutex is only taken on that slow
+    // path, or when the other side has announced that it is sleeping.
     template <typename ElementType>
     class Ringbuffer
     {
-        std::vector<ElementType*> m_buffer;
-        Semaphore m_emptySemaphore;
-        Semaphore m_fullSemaphore;
+        static const size_t CACHE_LINE_SIZE = 64;
+        static const unsigned int SPIN_COUNT = 1000;
+
+        struct Cell
+        {
+            std::atomic<size_t> m_sequence;
+            ElementType *m_element;
+        };
+
+        std::vector<Cell> m_buffer;
+        size_t m_mask;
+
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_head;
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_tail;
+
+        alignas(CACHE_LINE_SIZE) std::atomic<unsigned int> m_sleepingConsumers;
+        std::atomic<unsigned int> m_sleepingProducers;
+        std::mutex m_sleepMutex;
+        std::condition_variable m_notEmpty;
+        std::condition_variable m_notFull;
 
-        unsigned int m_head;
-        unsigned int m_tail;
+        static size_t roundUpToPowerOfTwo(size_t size)
+        {
+            size_t capacity = 2;
+            while (capacity < size)
+            {
+                capacity <<= 1;
+            }
+            return capacity;
+        }
 
     public:
         Ringbuffer(unsigned int defaultSize = 100)
-            :m_buffer(defaultSize, nullptr),
-              m_emptySemaphore(defaultSize),
-              m_fullSemaphore(),
-                m_head(0),
-                m_tail(0)
-        {}
+            :m_buffer(roundUpToPowerOfTwo(defaultSize)),
+              m_mask(m_buffer.size() - 1),
+              m_head(0),
+              m_tail(0),
+              m_sleepingConsumers(0),
+              m_sleepingProducers(0),
+              m_sleepMutex(),
+              m_notEmpty(),
+              m_notFull()
+        {
+            for (size_t i = 0; i < m_buffer.size(); ++i)
+            {
+                m_buffer[i].m_sequence.store(i, std::memory_order_relaxed);
+                m_buffer[i].m_element = nullptr;
+            }
+        }
 
         ~Ringbuffer()
         {
             m_buffer.clear();
         }
 
+        bool tryPush(ElementType *element)
+        {
+            size_t position = m_head.load(std::memory_order_relaxed);
+
+            while (true)
+            {
+                Cell &cell = m_buffer[position & m_mask];
+                size_t sequence = cell.m_sequence.load(std::memory_order_acquire);
+                std::ptrdiff_t difference = (std::ptrdiff_t) sequence - (std::ptrdiff_t) position;
+
+                if (difference == 0)
+                {
+                    if (m_head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    {
+                        cell.m_element = element;
+                        cell.m_sequence.store(position + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (difference < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    position = m_head.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        bool tryPop(ElementType *&element)
+        {
+            size_t position = m_tail.load(std::memory_order_relaxed);
+
+            while (true)
+            {
+                Cell &cell = m_buffer[position & m_mask];
+                size_t sequence = cell.m_sequence.load(std::memory_order_acquire);
+                std::ptrdiff_t difference = (std::ptrdiff_t) sequence - (std::ptrdiff_t) (position + 1);
+
+                if (difference == 0)
+                {
+                    if (m_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    {
+                        element = cell.m_element;
+                        cell.m_sequence.store(position + m_mask + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (difference < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    position = m_tail.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        // the elements queued, a snapshot that may be stale by the time it returns
+        size_t size() const
+        {
+            size_t head = m_head.load(std::memory_order_relaxed);
+            size_t tail = m_tail.load(std::memory_order_relaxed);
+
+            return head > tail ? head - tail : 0;
+        }
+
         ElementType *pop()
         {
-            m_fullSemaphore.wait();
+            ElementType *element = nullptr;
 
-            ElementType *element = m_buffer[m_tail];
-            m_tail = (m_tail + 1) % m_buffer.size();
+            for (unsigned int i = 0; i < SPIN_COUNT; ++i)
+            {
+                if (tryPop(element))
+                {
+                    wakeProducer();
+                    return element;
+                }
+                cpuRelax();
+            }
 
-            m_emptySemaphore.signal();
+            {
+                std::unique_lock<std::mutex> lock(m_sleepMutex);
+                m_sleepingConsumers.fetch_add(1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                m_notEmpty.wait(lock, [&]{return tryPop(element);});
+                m_sleepingConsumers.fetch_sub(1, std::memory_order_relaxed);
+            }
 
+            wakeProducer();
             return element;
-
         }
 
         void push(ElementType *element)
         {
-            m_emptySemaphore.wait();
+            bool pushed = false;
+
+            for (unsigned int i = 0; i < SPIN_COUNT; ++i)
+            {
+                if (tryPush(element))
+                {
+                    pushed = true;
+                    break;
+                }
+                cpuRelax();
+            }
+
+            if (!pushed)
+            {
+                std::unique_lock<std::mutex> lock(m_sleepMutex);
+                m_sleepingProducers.fetch_add(1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                m_notFull.wait(lock, [&]{return tryPush(element);});
+                m_sleepingProducers.fetch_sub(1, std::memory_order_relaxed);
+            }
+
+            wakeConsumer();
+        }
 
-            m_buffer[m_head] = element;
-            m_head = (m_head + 1) % m_buffer.size();
+    private:
+        void wakeConsumer()
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (m_sleepingConsumers.load(std::memory_order_relaxed) != 0)
+            {
+                std::lock_guard<std::mutex> lock(m_sleepMutex);
+                m_notEmpty.notify_all();
+            }
+        }
 
-            m_fullSemaphore.signal();
+        void wakeProducer()
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (m_sleepingProducers.load(std::memory_order_relaxed) != 0)
+            {
+                std::lock_guard<std::mutex> lock(m_sleepMutex);
+                m_notFull.notify_all();
+            }
         }
     };
 }
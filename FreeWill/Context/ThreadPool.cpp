@@ -0,0 +1,255 @@
+#include "ThreadPool.h"
+#include "Ringbuffer.h"
+#include <algorithm>
+
+static thread_local int workerIdOfThisThread = -1;
+
+FreeWill::ThreadPool::ThreadPool()
+    :m_workers(),
+      m_queues(),
+      m_finished(false),
+      m_nextQueue(0),
+      m_queuedTaskCount(0),
+      m_sleepingWorkerCount(0),
+      m_sleepMutex(),
+      m_workAvailable()
+{}
+
+FreeWill::ThreadPool::~ThreadPool()
+{
+    close();
+}
+
+void FreeWill::ThreadPool::open(unsigned int threadCount)
+{
+    if (!m_workers.empty())
+    {
+        return;
+    }
+
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    m_finished = false;
+
+    for (unsigned int i = 0; i < threadCount; ++i)
+    {
+        m_queues.push_back(new WorkerQueue());
+    }
+
+    for (unsigned int i = 0; i < threadCount; ++i)
+    {
+        m_workers.push_back(new std::thread([=]{workerLoop(i);}));
+    }
+}
+
+void FreeWill::ThreadPool::close()
+{
+    if (m_workers.empty())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_finished = true;
+        m_workAvailable.notify_all();
+    }
+
+    for (std::thread *worker : m_workers)
+    {
+        worker->join();
+        delete worker;
+    }
+    m_workers.clear();
+
+    for (WorkerQueue *queue : m_queues)
+    {
+        delete queue;
+    }
+    m_queues.clear();
+}
+
+void FreeWill::ThreadPool::pushTask(const Task &task)
+{
+    unsigned int queueIndex = 0;
+    if (workerIdOfThisThread >= 0)
+    {
+        queueIndex = workerIdOfThisThread;
+    }
+    else
+    {
+        queueIndex = m_nextQueue.fetch_add(1, std::memory_order_relaxed) % m_queues.size();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_queues[queueIndex]->m_mutex);
+        m_queues[queueIndex]->m_tasks.push_back(task);
+    }
+
+    m_queuedTaskCount.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (m_sleepingWorkerCount.load(std::memory_order_relaxed) != 0)
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_workAvailable.notify_one();
+    }
+}
+
+bool FreeWill::ThreadPool::popTask(Task &task)
+{
+    if (workerIdOfThisThread < 0)
+    {
+        return false;
+    }
+
+    WorkerQueue *queue = m_queues[workerIdOfThisThread];
+    std::lock_guard<std::mutex> lock(queue->m_mutex);
+
+    if (queue->m_tasks.empty())
+    {
+        return false;
+    }
+
+    task = queue->m_tasks.back();
+    queue->m_tasks.pop_back();
+    m_queuedTaskCount.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool FreeWill::ThreadPool::stealTask(Task &task, unsigned int startQueue)
+{
+    unsigned int queueCount = m_queues.size();
+
+    for (unsigned int i = 0; i < queueCount; ++i)
+    {
+        unsigned int queueIndex = (startQueue + i) % queueCount;
+
+        if ((int) queueIndex == workerIdOfThisThread)
+        {
+            continue;
+        }
+
+        WorkerQueue *queue = m_queues[queueIndex];
+        std::lock_guard<std::mutex> lock(queue->m_mutex);
+
+        if (!queue->m_tasks.empty())
+        {
+            task = queue->m_tasks.front();
+            queue->m_tasks.pop_front();
+            m_queuedTaskCount.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool FreeWill::ThreadPool::findTask(Task &task)
+{
+    if (m_queuedTaskCount.load(std::memory_order_relaxed) == 0)
+    {
+        return false;
+    }
+
+    if (popTask(task))
+    {
+        return true;
+    }
+
+    unsigned int startQueue = workerIdOfThisThread >= 0 ? workerIdOfThisThread + 1 : m_nextQueue.load(std::memory_order_relaxed);
+    return stealTask(task, startQueue);
+}
+
+void FreeWill::ThreadPool::runTask(const Task &task)
+{
+    Job *job = task.m_job;
+    unsigned int begin = task.m_begin;
+    unsigned int end = task.m_end;
+
+    while (end - begin > job->m_grain)
+    {
+        unsigned int middle = begin + (end - begin) / 2;
+        job->m_pendingTaskCount.fetch_add(1, std::memory_order_relaxed);
+        pushTask({job, middle, end});
+        end = middle;
+    }
+
+    (*job->m_function)(begin, end);
+
+    job->m_pendingTaskCount.fetch_sub(1, std::memory_order_release);
+}
+
+void FreeWill::ThreadPool::workerLoop(unsigned int workerId)
+{
+    workerIdOfThisThread = workerId;
+
+    while (!m_finished)
+    {
+        Task task;
+        bool found = false;
+
+        for (unsigned int i = 0; i < 1000 && !found && !m_finished; ++i)
+        {
+            found = findTask(task);
+            if (!found)
+            {
+                cpuRelax();
+            }
+        }
+
+        if (found)
+        {
+            runTask(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_sleepingWorkerCount.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        m_workAvailable.wait(lock, [=]{return m_finished || m_queuedTaskCount.load(std::memory_order_relaxed) != 0;});
+        m_sleepingWorkerCount.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    workerIdOfThisThread = -1;
+}
+
+void FreeWill::ThreadPool::parallelFor(unsigned int begin, unsigned int end, unsigned int grain, const RangeFunction &function)
+{
+    if (begin >= end)
+    {
+        return;
+    }
+
+    grain = std::max(1u, grain);
+
+    if (m_workers.empty() || end - begin <= grain)
+    {
+        function(begin, end);
+        return;
+    }
+
+    Job job;
+    job.m_function = &function;
+    job.m_grain = grain;
+    job.m_pendingTaskCount.store(1, std::memory_order_relaxed);
+
+    runTask({&job, begin, end});
+
+    // help with whatever is queued, including pieces of other jobs, until our pieces are all done
+    while (job.m_pendingTaskCount.load(std::memory_order_acquire) != 0)
+    {
+        Task task;
+        if (findTask(task))
+        {
+            runTask(task);
+        }
+        else
+        {
+            cpuRelax();
+        }
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace FreeWill
+{
+    // Work-stealing pool for intra-operator parallelism on the CPU. parallelFor() splits its range
+    // lazily: the running thread keeps halving its range and pushes the upper halves onto its own
+    // deque, idle workers steal the oldest (largest) pieces. The calling thread always takes part,
+    // so parallelFor() can be called from the Device worker threads and from inside other
+    // parallelFor() bodies. Without open() every parallelFor() runs serially on the caller.
+    class ThreadPool
+    {
+    public:
+        typedef std::function<void(unsigned int begin, unsigned int end)> RangeFunction;
+
+    private:
+        struct Job
+        {
+            const RangeFunction *m_function;
+            unsigned int m_grain;
+            std::atomic<unsigned int> m_pendingTaskCount;
+        };
+
+        struct Task
+        {
+            Job *m_job;
+            unsigned int m_begin;
+            unsigned int m_end;
+        };
+
+        struct alignas(64) WorkerQueue
+        {
+            std::mutex m_mutex;
+            std::deque<Task> m_tasks;
+        };
+
+        std::vector<std::thread*> m_workers;
+        std::vector<WorkerQueue*> m_queues;
+        std::atomic<bool> m_finished;
+        std::atomic<unsigned int> m_nextQueue;
+        std::atomic<unsigned int> m_queuedTaskCount;
+
+        std::atomic<unsigned int> m_sleepingWorkerCount;
+        std::mutex m_sleepMutex;
+        std::condition_variable m_workAvailable;
+
+        ThreadPool();
+        ~ThreadPool();
+
+        void workerLoop(unsigned int workerId);
+        void pushTask(const Task &task);
+        bool popTask(Task &task);
+        bool stealTask(Task &task, unsigned int startQueue);
+        bool findTask(Task &task);
+        void runTask(const Task &task);
+
+    public:
+        static ThreadPool &getSingleton()
+        {
+            static ThreadPool obj;
+            return obj;
+        }
+
+        ThreadPool(const ThreadPool &) = delete;
+        void operator=(const ThreadPool &) = delete;
+
+        void open(unsigned int threadCount = 0);
+
+        void close();
+
+        unsigned int threadCount() const
+        {
+            return m_workers.size();
+        }
+
+        void parallelFor(unsigned int begin, unsigned int end, unsigned int grain, const RangeFunction &function);
+    };
+}
+
+#endif
@@ -4,20 +4,26 @@ FreeWill::WorkerMessage::WorkerMessage(Type workType, Operator<DeviceType::CPU_N
     :m_workType(workType),
       m_model(model),
       m_operatorBase(operatorBase),
-      m_finished(false)
+      m_finished(false),
+      m_completionLatch(nullptr),
+      m_profileRecord(nullptr)
 {}
 
 FreeWill::WorkerMessage::WorkerMessage(Type workType, Operator<DeviceType::GPU_CUDA> *operatorBase, Model *model)
     :m_workType(workType),
       m_model(model),
       m_operatorBase(operatorBase),
-      m_finished(false)
+      m_finished(false),
+      m_completionLatch(nullptr),
+      m_profileRecord(nullptr)
 {}
 
 FreeWill::WorkerMessage::WorkerMessage(const WorkerMessage &in)
     :m_workType(in.m_workType),
       m_model(in.m_model),
-      m_finished(false)
+      m_finished(false),
+      m_completionLatch(nullptr),
+      m_profileRecord(nullptr)
 {
 
 }
@@ -31,6 +37,38 @@ void FreeWill::WorkerMessage::operator =(const WorkerMessage &in)
 
 FreeWill::WorkerMessage::~WorkerMessage(){}
 
+void FreeWill::WorkerMessage::reset(Type workType, Operator<DeviceType::CPU_NAIVE> *operatorBase, CompletionLatch *completionLatch)
+{
+    m_workType = workType;
+    m_operatorBase = operatorBase;
+    m_finished = false;
+    m_completionLatch = completionLatch;
+    m_profileRecord = nullptr;
+}
+
+void FreeWill::WorkerMessage::reset(Type workType, Operator<DeviceType::GPU_CUDA> *operatorBase, CompletionLatch *completionLatch)
+{
+    m_workType = workType;
+    m_operatorBase = operatorBase;
+    m_finished = false;
+    m_completionLatch = completionLatch;
+    m_profileRecord = nullptr;
+}
+
+void FreeWill::WorkerMessage::resetTask(const std::function<void()> &task)
+{
+    m_workType = Type::TASK;
+    m_task = task;
+    m_finished = false;
+    m_completionLatch = nullptr;
+    m_profileRecord = nullptr;
+}
+
+void FreeWill::WorkerMessage::runTask()
+{
+    m_task();
+}
+
 void FreeWill::WorkerMessage::join()
 {
     std::unique_lock<std::mutex> workLock(m_conditionFinishedMutex);
@@ -40,12 +78,29 @@ void FreeWill::WorkerMessage::join()
 
 void FreeWill::WorkerMessage::done()
 {
+    // the message may be reused as soon as the latch reaches zero, do not touch it afterwards
+    if (m_completionLatch)
+    {
+        m_completionLatch->countDown();
+        return;
+    }
+
     std::unique_lock<std::mutex> workLock(m_conditionFinishedMutex);
     m_finished = true;
     //notify must be inside the workLock, otherwise dead lock
     m_conditionFinished.notify_one();
 }
 
+void FreeWill::WorkerMessage::setProfileRecord(ProfileRecord *profileRecord)
+{
+    m_profileRecord = profileRecord;
+}
+
+FreeWill::ProfileRecord *FreeWill::WorkerMessage::profileRecord() const
+{
+    return m_profileRecord;
+}
+
 FreeWill::WorkerMessage::Type FreeWill::WorkerMessage::workType() const
 {
     return m_workType;
@@ -2,14 +2,17 @@
 #define WORKERMESSAGE_H
 
 #include <condition_variable>
+#include <functional>
 #include <thread>
 #include <mutex>
 #include <variant>
 #include "../Tensor/ReferenceCountedBlob.h"
+#include "CompletionLatch.h"
 
 namespace FreeWill
 {
     class Model;
+    struct ProfileRecord;
     template <DeviceType DeviceUsed>
     class Operator;
 
@@ -22,6 +25,8 @@ namespace FreeWill
             FORWARD,
             BACKWARD,
             UPDATE,
+            // runs m_task instead of an operator, see Context::runOnDevice
+            TASK,
             TERMINATE
         };
 
@@ -32,6 +37,9 @@ namespace FreeWill
         std::mutex m_conditionFinishedMutex;
         Type m_workType;
         bool m_finished;
+        CompletionLatch *m_completionLatch;
+        std::function<void()> m_task;
+        ProfileRecord *m_profileRecord;
 
     public:
         int debug_num = 0;
@@ -45,6 +53,21 @@ namespace FreeWill
 
         ~WorkerMessage();
 
+        // reuse a pooled message for another wave, done() then counts down completionLatch instead of waking join()
+        void reset(Type workType, Operator<DeviceType::CPU_NAIVE> *operatorBase, CompletionLatch *completionLatch = nullptr);
+        void reset(Type workType, Operator<DeviceType::GPU_CUDA> *operatorBase, CompletionLatch *completionLatch = nullptr);
+
+        // a TASK message that runs task on the worker it is pushed to
+        void resetTask(const std::function<void()> &task);
+
+        void runTask();
+
+        // while profiling, the worker stamps the begin and end of the operator into
+        // profileRecord, which the pusher owns. reset() clears it.
+        void setProfileRecord(ProfileRecord *profileRecord);
+
+        ProfileRecord *profileRecord() const;
+
         void done();
 
         void join();
@@ -0,0 +1,103 @@
+#include "Augmentation.h"
+#include "BatchLoader.h"
+#include <algorithm>
+#include <cmath>
+
+float FreeWill::AugmentationRandom::normal()
+{
+    // Box-Muller, the second value is dropped
+    float u1 = std::max(uniform(), 1e-7f);
+    float u2 = uniform();
+
+    return std::sqrt(-2.0f * std::log(u1)) * std::cos(6.28318530718f * u2);
+}
+
+void FreeWill::augmentItemCPU(const unsigned char *input, float *output, unsigned int rows, unsigned int columns, float scale,
+                              const FreeWill::AugmentationParameters &parameters, FreeWill::AugmentationRandom &random)
+{
+    int shiftX = 0;
+    int shiftY = 0;
+
+    if (parameters.m_maxShift > 0)
+    {
+        int range = 2 * parameters.m_maxShift + 1;
+        shiftX = (int) (random.next() % range) - (int) parameters.m_maxShift;
+        shiftY = (int) (random.next() % range) - (int) parameters.m_maxShift;
+    }
+
+    float angle = parameters.m_maxRotation > 0.0f ? random.symmetric(parameters.m_maxRotation) : 0.0f;
+    float zoom = parameters.m_maxScale > 0.0f ? 1.0f + random.symmetric(parameters.m_maxScale) : 1.0f;
+
+    if (angle == 0.0f && zoom == 1.0f)
+    {
+        // a whole pixel shift, the rows are copied as they are
+        for (int y = 0; y < (int) rows; ++y)
+        {
+            int sourceY = y - shiftY;
+            float *outputRow = output + (size_t) y * columns;
+
+            if (sourceY < 0 || sourceY >= (int) rows)
+            {
+                std::fill(outputRow, outputRow + columns, 0.0f);
+                continue;
+            }
+
+            int begin = std::max(0, shiftX);
+            int end = std::min((int) columns, (int) columns + shiftX);
+
+            std::fill(outputRow, outputRow + std::min(begin, (int) columns), 0.0f);
+            if (begin < end)
+            {
+                decodeUnsignedBytesCPU(input + (size_t) sourceY * columns + begin - shiftX, outputRow + begin, end - begin, scale);
+            }
+            std::fill(outputRow + std::max(begin, end), outputRow + columns, 0.0f);
+        }
+    }
+    else
+    {
+        // each output pixel samples the source at the inverse transform of its position
+        float centerX = (columns - 1) * 0.5f;
+        float centerY = (rows - 1) * 0.5f;
+        float cosine = std::cos(angle) / zoom;
+        float sine = std::sin(angle) / zoom;
+
+        for (unsigned int y = 0; y < rows; ++y)
+        {
+            float dy = (float) y - centerY - shiftY;
+
+            for (unsigned int x = 0; x < columns; ++x)
+            {
+                float dx = (float) x - centerX - shiftX;
+                float sourceX = cosine * dx + sine * dy + centerX;
+                float sourceY = -sine * dx + cosine * dy + centerY;
+
+                int x0 = (int) std::floor(sourceX);
+                int y0 = (int) std::floor(sourceY);
+                float fx = sourceX - x0;
+                float fy = sourceY - y0;
+
+                auto pixel = [&](int px, int py) -> float
+                {
+                    if (px < 0 || py < 0 || px >= (int) columns || py >= (int) rows)
+                    {
+                        return 0.0f;
+                    }
+                    return (float) input[(size_t) py * columns + px];
+                };
+
+                float top = pixel(x0, y0) * (1.0f - fx) + pixel(x0 + 1, y0) * fx;
+                float bottom = pixel(x0, y0 + 1) * (1.0f - fx) + pixel(x0 + 1, y0 + 1) * fx;
+
+                output[(size_t) y * columns + x] = (top * (1.0f - fy) + bottom * fy) * scale;
+            }
+        }
+    }
+
+    if (parameters.m_noiseStandardDeviation > 0.0f)
+    {
+        for (size_t i = 0; i < (size_t) rows * columns; ++i)
+        {
+            output[i] += random.normal() * parameters.m_noiseStandardDeviation;
+        }
+    }
+}
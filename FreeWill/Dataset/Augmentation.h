@@ -0,0 +1,71 @@
+#ifndef AUGMENTATION_H
+#define AUGMENTATION_H
+
+#include <cstdint>
+
+namespace FreeWill
+{
+    // Per item augmentation of single channel byte images, done while decoding them. Every item
+    // of every epoch draws its own transform from m_seed, the epoch and the item, so a run with
+    // the same seed sees the same batches.
+    struct AugmentationParameters
+    {
+        // a new order of the items every epoch
+        bool m_isShuffling = false;
+        // moves the image by up to this many pixels either way, what moves in is zero, i.e. a
+        // random crop of the image padded by m_maxShift
+        unsigned int m_maxShift = 0;
+        // rotates by up to m_maxRotation radians and scales by 1 +- m_maxScale about the center
+        float m_maxRotation = 0.0f;
+        float m_maxScale = 0.0f;
+        // gaussian, added to the normalized values
+        float m_noiseStandardDeviation = 0.0f;
+        uint64_t m_seed = 0;
+
+        bool isAugmenting() const
+        {
+            return m_maxShift > 0 || m_maxRotation > 0.0f || m_maxScale > 0.0f || m_noiseStandardDeviation > 0.0f;
+        }
+    };
+
+    // splitmix64, cheap enough to seed once per item
+    class AugmentationRandom
+    {
+        uint64_t m_state;
+
+    public:
+        explicit AugmentationRandom(uint64_t seed)
+            :m_state(seed)
+        {
+        }
+
+        uint64_t next()
+        {
+            uint64_t z = (m_state += 0x9e3779b97f4a7c15ull);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            return z ^ (z >> 31);
+        }
+
+        // in [0, 1)
+        float uniform()
+        {
+            return (float) (next() >> 40) * (1.0f / 16777216.0f);
+        }
+
+        // in [-range, range]
+        float symmetric(float range)
+        {
+            return (uniform() * 2.0f - 1.0f) * range;
+        }
+
+        float normal();
+    };
+
+    // Decodes one rows x columns image of input into output, times scale, through a random
+    // shift, rotation and scale, bilinearly sampled, then adds the noise.
+    void augmentItemCPU(const unsigned char *input, float *output, unsigned int rows, unsigned int columns, float scale,
+                        const AugmentationParameters &parameters, AugmentationRandom &random);
+}
+
+#endif
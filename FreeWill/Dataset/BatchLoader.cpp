@@ -0,0 +1,532 @@
+#include "BatchLoader.h"
+#include "../Context/ThreadPool.h"
+#include "../Tensor/BlobAllocator.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+
+FreeWill::BatchLoader::BatchLoader(const FreeWill::IDXFile *inputFile, const FreeWill::IDXFile *labelFile, unsigned int batchSize,
+                                   unsigned int bufferCount, float scale)
+    :m_inputFile(inputFile),
+      m_labelFile(labelFile),
+      m_dataset(nullptr),
+      m_batchSize(batchSize),
+      m_scale(scale),
+      m_augmentation(),
+      m_isPinned(false),
+      m_isRaw(false),
+      m_shard(0),
+      m_shardCount(1),
+      m_order(),
+      m_windowBlockCount(8),
+      m_spans(),
+      m_spanCursor(0),
+      m_windowIndex(0),
+      m_window(),
+      m_windowItems(),
+      m_windowCursor(0),
+      m_staging(),
+      m_items(),
+      m_itemLabels(),
+      m_itemIndices(),
+      m_buffers(std::max(1u, bufferCount)),
+      m_fillIndex(0),
+      m_readIndex(0),
+      m_readyCount(0),
+      m_isAcquired(false),
+      m_cursor(0),
+      m_epoch(0),
+      m_worker(nullptr),
+      m_mutex(),
+      m_batchReady(),
+      m_bufferFree(),
+      m_isRunning(false),
+      m_hasFailed(false)
+{
+    for (unsigned int i = 0; i < m_buffers.size(); ++i)
+    {
+        m_buffers[i].m_inputs = nullptr;
+        m_buffers[i].m_labels = nullptr;
+        m_buffers[i].m_rawInputs = nullptr;
+        m_buffers[i].m_rawLabels = nullptr;
+        m_buffers[i].m_size = 0;
+        m_buffers[i].m_epoch = 0;
+    }
+}
+
+FreeWill::BatchLoader::BatchLoader(const FreeWill::RecordDataset *dataset, unsigned int batchSize, unsigned int bufferCount, float scale)
+    :BatchLoader(nullptr, nullptr, batchSize, bufferCount, scale)
+{
+    m_dataset = dataset;
+}
+
+FreeWill::BatchLoader::~BatchLoader()
+{
+    stop();
+    freeBuffers();
+}
+
+void FreeWill::BatchLoader::freeBuffers()
+{
+    for (unsigned int i = 0; i < m_buffers.size(); ++i)
+    {
+        void *buffers[4] = {m_buffers[i].m_inputs, m_buffers[i].m_labels, m_buffers[i].m_rawInputs, m_buffers[i].m_rawLabels};
+
+        for (void *buffer : buffers)
+        {
+            if (buffer)
+            {
+                BlobAllocator::getSingleton().freeHost(buffer);
+            }
+        }
+
+        m_buffers[i].m_inputs = nullptr;
+        m_buffers[i].m_labels = nullptr;
+        m_buffers[i].m_rawInputs = nullptr;
+        m_buffers[i].m_rawLabels = nullptr;
+    }
+}
+
+bool FreeWill::BatchLoader::start()
+{
+    if (m_worker || (m_dataset ? !m_dataset->isOpen() : (!m_inputFile || !m_inputFile->isOpen())) ||
+            m_shard >= m_shardCount || itemCount() < m_shardCount || m_batchSize == 0)
+    {
+        return false;
+    }
+
+    if (m_labelFile && (!m_labelFile->isOpen() || m_labelFile->itemSize() != 1 ||
+                        m_labelFile->itemCount() != m_inputFile->itemCount()))
+    {
+        return false;
+    }
+
+    if (m_dataset)
+    {
+        m_window.resize((size_t) m_windowBlockCount * m_dataset->recordsPerBlock() * m_dataset->recordSize());
+        m_staging.resize((size_t) m_batchSize * m_dataset->recordSize());
+    }
+
+    freeBuffers();
+
+    for (unsigned int i = 0; i < m_buffers.size(); ++i)
+    {
+        BlobAllocator &allocator = BlobAllocator::getSingleton();
+        size_t inputSize = (size_t) m_batchSize * itemSize();
+
+        if (m_isRaw)
+        {
+            m_buffers[i].m_rawInputs = (unsigned char *) allocator.allocateHost(inputSize, m_isPinned);
+            m_buffers[i].m_rawLabels = (unsigned char *) allocator.allocateHost(m_batchSize, m_isPinned);
+        }
+        else
+        {
+            m_buffers[i].m_inputs = (float *) allocator.allocateHost(inputSize * sizeof(float), m_isPinned);
+            m_buffers[i].m_labels = (unsigned int *) allocator.allocateHost((size_t) m_batchSize * sizeof(unsigned int), m_isPinned);
+        }
+
+        m_buffers[i].m_size = 0;
+        m_buffers[i].m_epoch = 0;
+
+        if (m_isRaw ? (!m_buffers[i].m_rawInputs || !m_buffers[i].m_rawLabels) : (!m_buffers[i].m_inputs || !m_buffers[i].m_labels))
+        {
+            freeBuffers();
+            return false;
+        }
+    }
+
+    m_order.clear();
+    m_spans.clear();
+    m_windowItems.clear();
+    m_windowCursor = 0;
+
+    m_fillIndex = 0;
+    m_readIndex = 0;
+    m_readyCount = 0;
+    m_isAcquired = false;
+    m_cursor = 0;
+    m_epoch = 0;
+
+    m_isRunning = true;
+    m_hasFailed = false;
+    m_worker = new std::thread(&BatchLoader::workerLoop, this);
+
+    return true;
+}
+
+void FreeWill::BatchLoader::stop()
+{
+    if (!m_worker)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_isRunning = false;
+    }
+    m_bufferFree.notify_all();
+    m_batchReady.notify_all();
+
+    m_worker->join();
+    delete m_worker;
+    m_worker = nullptr;
+}
+
+void FreeWill::BatchLoader::shuffle()
+{
+    unsigned int itemCount = m_inputFile->itemCount();
+
+    m_order.resize(itemCount);
+    std::iota(m_order.begin(), m_order.end(), 0);
+
+    AugmentationRandom random(m_augmentation.m_seed ^ ((uint64_t) m_epoch << 32));
+    for (unsigned int i = itemCount - 1; i > 0; --i)
+    {
+        std::swap(m_order[i], m_order[random.next() % (i + 1)]);
+    }
+}
+
+void FreeWill::BatchLoader::planSpans()
+{
+    std::vector<unsigned int> blocks(m_dataset->blockCount());
+    std::iota(blocks.begin(), blocks.end(), 0);
+
+    if (m_augmentation.m_isShuffling)
+    {
+        AugmentationRandom random(m_augmentation.m_seed ^ ((uint64_t) m_epoch << 32));
+        for (unsigned int i = (unsigned int) blocks.size() - 1; i > 0; --i)
+        {
+            std::swap(blocks[i], blocks[random.next() % (i + 1)]);
+        }
+    }
+
+    // the slice of this rank of the items in block order
+    unsigned int begin = shardBegin();
+    unsigned int end = begin + shardItemCount();
+    unsigned int position = 0;
+
+    m_spans.clear();
+
+    for (unsigned int block : blocks)
+    {
+        unsigned int count = m_dataset->blockItemCount(block);
+        unsigned int first = std::max(begin, position);
+        unsigned int last = std::min(end, position + count);
+
+        if (first < last)
+        {
+            m_spans.push_back({block, first - position, last - first});
+        }
+
+        position += count;
+    }
+
+    m_spanCursor = 0;
+    m_windowIndex = 0;
+    m_windowItems.clear();
+    m_windowCursor = 0;
+}
+
+bool FreeWill::BatchLoader::readWindow()
+{
+    unsigned int spanCount = std::min(m_windowBlockCount, (unsigned int) m_spans.size() - m_spanCursor);
+    size_t recordSize = m_dataset->recordSize();
+    size_t blockSize = (size_t) m_dataset->recordsPerBlock() * recordSize;
+    const Span *spans = m_spans.data() + m_spanCursor;
+    std::atomic<bool> isRead(true);
+
+    // one pread per block, as many in flight as the pool has threads
+    ThreadPool::getSingleton().parallelFor(0, spanCount, 1, [&](unsigned int begin, unsigned int end)
+    {
+        for (unsigned int i = begin; i < end; ++i)
+        {
+            if (!m_dataset->readBlock(spans[i].m_block, m_window.data() + i * blockSize))
+            {
+                std::cerr << "can't read block " << spans[i].m_block << " of the records" << std::endl;
+                isRead = false;
+            }
+        }
+    });
+
+    if (!isRead)
+    {
+        return false;
+    }
+
+    m_windowItems.clear();
+
+    for (unsigned int i = 0; i < spanCount; ++i)
+    {
+        for (unsigned int k = spans[i].m_first; k < spans[i].m_first + spans[i].m_count; ++k)
+        {
+            m_windowItems.push_back({m_window.data() + i * blockSize + k * recordSize, m_dataset->blockFirstItem(spans[i].m_block) + k});
+        }
+    }
+
+    if (m_augmentation.m_isShuffling)
+    {
+        AugmentationRandom random(m_augmentation.m_seed ^ ((uint64_t) m_epoch << 32) ^ ((uint64_t) (m_windowIndex + 1) * 0x9e3779b97f4a7c15ull));
+        for (unsigned int i = (unsigned int) m_windowItems.size() - 1; i > 0; --i)
+        {
+            std::swap(m_windowItems[i], m_windowItems[random.next() % (i + 1)]);
+        }
+    }
+
+    m_spanCursor += spanCount;
+    ++m_windowIndex;
+    m_windowCursor = 0;
+
+    // the next window is on its way while this one is decoded
+    for (unsigned int i = m_spanCursor; i < std::min(m_spanCursor + m_windowBlockCount, (unsigned int) m_spans.size()); ++i)
+    {
+        m_dataset->prefetchBlock(m_spans[i].m_block);
+    }
+
+    return true;
+}
+
+bool FreeWill::BatchLoader::gather(unsigned int size)
+{
+    m_items.resize(size);
+    m_itemLabels.resize(size);
+    m_itemIndices.resize(size);
+
+    if (!m_dataset)
+    {
+        unsigned int cursor = shardBegin() + m_cursor;
+
+        for (unsigned int i = 0; i < size; ++i)
+        {
+            unsigned int index = m_augmentation.m_isShuffling ? m_order[cursor + i] : cursor + i;
+
+            m_items[i] = m_inputFile->item(index);
+            m_itemLabels[i] = m_labelFile ? m_labelFile->item(index) : nullptr;
+            m_itemIndices[i] = index;
+        }
+
+        return true;
+    }
+
+    size_t recordSize = m_dataset->recordSize();
+
+    for (unsigned int i = 0; i < size; ++i)
+    {
+        if (m_windowCursor == m_windowItems.size() && !readWindow())
+        {
+            return false;
+        }
+
+        // the record outlives the window it came from
+        unsigned char *record = m_staging.data() + i * recordSize;
+        std::memcpy(record, m_windowItems[m_windowCursor].first, recordSize);
+
+        m_items[i] = record;
+        m_itemLabels[i] = m_dataset->hasLabels() ? record + m_dataset->itemSize() : nullptr;
+        m_itemIndices[i] = m_windowItems[m_windowCursor].second;
+        ++m_windowCursor;
+    }
+
+    return true;
+}
+
+void FreeWill::BatchLoader::decodeRaw(FreeWill::BatchLoader::Batch &batch)
+{
+    unsigned int itemSize = this->itemSize();
+
+    for (unsigned int i = 0; i < batch.m_size; ++i)
+    {
+        std::memcpy(batch.m_rawInputs + (size_t) i * itemSize, m_items[i], itemSize);
+
+        if (m_itemLabels[i])
+        {
+            batch.m_rawLabels[i] = *m_itemLabels[i];
+        }
+    }
+
+    std::fill(batch.m_rawInputs + (size_t) batch.m_size * itemSize, batch.m_rawInputs + (size_t) m_batchSize * itemSize, 0);
+    std::fill(batch.m_rawLabels + (hasLabels() ? batch.m_size : 0), batch.m_rawLabels + m_batchSize, 0);
+}
+
+bool FreeWill::BatchLoader::decode(FreeWill::BatchLoader::Batch &batch)
+{
+    unsigned int itemCount = shardItemCount();
+    unsigned int itemSize = this->itemSize();
+    bool isAugmenting = m_augmentation.isAugmenting();
+
+    batch.m_size = std::min(m_batchSize, itemCount - m_cursor);
+    batch.m_epoch = m_epoch;
+
+    if (m_cursor == 0 && m_dataset)
+    {
+        planSpans();
+    }
+    else if (m_cursor == 0 && m_augmentation.m_isShuffling)
+    {
+        shuffle();
+    }
+
+    if (!gather(batch.m_size))
+    {
+        return false;
+    }
+
+    if (m_isRaw)
+    {
+        decodeRaw(batch);
+    }
+    else if (!m_dataset && !m_augmentation.m_isShuffling && !isAugmenting)
+    {
+        // the items of a batch are contiguous in the file
+        decodeUnsignedBytesCPU(m_inputFile->item(shardBegin() + m_cursor), batch.m_inputs, (size_t) batch.m_size * itemSize, m_scale);
+
+        if (m_labelFile)
+        {
+            const unsigned char *labels = m_labelFile->item(shardBegin() + m_cursor);
+            std::copy(labels, labels + batch.m_size, batch.m_labels);
+        }
+    }
+    else
+    {
+        const std::vector<unsigned int> &dimensions = this->dimensions();
+        bool isImage = dimensions.size() == 3;
+
+        ThreadPool::getSingleton().parallelFor(0, batch.m_size, 1, [&](unsigned int begin, unsigned int end)
+        {
+            for (unsigned int i = begin; i < end; ++i)
+            {
+                unsigned int index = m_itemIndices[i];
+                float *output = batch.m_inputs + (size_t) i * itemSize;
+
+                if (isAugmenting && isImage)
+                {
+                    AugmentationRandom random(m_augmentation.m_seed ^ ((uint64_t) m_epoch << 32) ^ ((uint64_t) index * 0x9e3779b97f4a7c15ull));
+                    augmentItemCPU(m_items[i], output, dimensions[1], dimensions[2], m_scale, m_augmentation, random);
+                }
+                else
+                {
+                    decodeUnsignedBytesCPU(m_items[i], output, itemSize, m_scale);
+                }
+
+                if (m_itemLabels[i])
+                {
+                    batch.m_labels[i] = *m_itemLabels[i];
+                }
+            }
+        });
+    }
+
+    if (!m_isRaw)
+    {
+        std::fill(batch.m_inputs + (size_t) batch.m_size * itemSize, batch.m_inputs + (size_t) m_batchSize * itemSize, 0.0f);
+        std::fill(batch.m_labels + (hasLabels() ? batch.m_size : 0), batch.m_labels + m_batchSize, 0);
+    }
+
+    m_cursor += batch.m_size;
+
+    if (m_cursor == itemCount)
+    {
+        m_cursor = 0;
+        ++m_epoch;
+    }
+
+    return true;
+}
+
+void FreeWill::BatchLoader::workerLoop()
+{
+    while (true)
+    {
+        Batch *batch = nullptr;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+
+            m_bufferFree.wait(lock, [this]{return !m_isRunning || m_readyCount + (m_isAcquired ? 1 : 0) < m_buffers.size();});
+
+            if (!m_isRunning)
+            {
+                return;
+            }
+
+            batch = &m_buffers[m_fillIndex];
+        }
+
+        // the buffer is neither ready nor acquired, nobody else touches it
+        if (!decode(*batch))
+        {
+            // stopped like stop() does, acquire() hands out null from here on
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_isRunning = false;
+                m_hasFailed = true;
+            }
+            m_batchReady.notify_all();
+            m_bufferFree.notify_all();
+
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_fillIndex = (m_fillIndex + 1) % m_buffers.size();
+            ++m_readyCount;
+        }
+        m_batchReady.notify_one();
+    }
+}
+
+const FreeWill::BatchLoader::Batch *FreeWill::BatchLoader::acquire()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    if (m_isAcquired)
+    {
+        return nullptr;
+    }
+
+    m_batchReady.wait(lock, [this]{return !m_isRunning || m_readyCount > 0;});
+
+    if (!m_isRunning || m_readyCount == 0)
+    {
+        return nullptr;
+    }
+
+    --m_readyCount;
+    m_isAcquired = true;
+
+    return &m_buffers[m_readIndex];
+}
+
+const FreeWill::BatchLoader::Batch *FreeWill::BatchLoader::tryAcquire()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!m_isRunning || m_isAcquired || m_readyCount == 0)
+    {
+        return nullptr;
+    }
+
+    --m_readyCount;
+    m_isAcquired = true;
+
+    return &m_buffers[m_readIndex];
+}
+
+void FreeWill::BatchLoader::release()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (!m_isAcquired)
+        {
+            return;
+        }
+
+        m_isAcquired = false;
+        m_readIndex = (m_readIndex + 1) % m_buffers.size();
+    }
+    m_bufferFree.notify_one();
+}
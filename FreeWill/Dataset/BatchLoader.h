@@ -0,0 +1,243 @@
+#ifndef BATCHLOADER_H
+#define BATCHLOADER_H
+
+#include "IDXFile.h"
+#include "RecordDataset.h"
+#include "Augmentation.h"
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace FreeWill
+{
+    // bytes to float times scale, the loop is plain so the compiler widens and converts a vector
+    // of bytes at a time
+    inline void decodeUnsignedBytesCPU(const unsigned char *input, float *output, size_t size, float scale)
+    {
+        for (size_t i = 0; i < size; ++i)
+        {
+            output[i] = (float) input[i] * scale;
+        }
+    }
+
+    // Decodes the batches of a pair of IDX files on a worker thread, bufferCount batches ahead of
+    // the training loop. The batches go through the dataset in order, or in a new random order
+    // every epoch when shuffling. The last one of an epoch has the items left (m_size), with
+    // the rest of its inputs zeroed, and the next epoch starts over.
+    //
+    // With augmentation (or shuffling) the items of a batch are decoded one by one, spread over
+    // the ThreadPool, each through its own random transform (see AugmentationParameters).
+    //
+    // acquire() hands out the oldest decoded batch, which stays valid until release(). Only
+    // one batch is out at a time, while it is out the worker fills the other buffers.
+    //
+    // In a distributed run every rank serves its own shard (setShard), a disjoint slice of
+    // itemCount / shardCount items of the dataset, or of the epoch's order when shuffling. The
+    // order is drawn from the same seed on every rank, so the shards of an epoch don't overlap.
+    // The items left over by the division are skipped, so all ranks take the same number of
+    // batches per epoch.
+    //
+    // A RecordDataset is streamed instead, setWindow blocks at a time read in parallel over the
+    // ThreadPool while the next ones are read ahead, so only the window is in memory. Shuffling
+    // then orders the blocks of all shard files anew every epoch and the items within each
+    // window, and the slice of a rank is taken from the items in that block order. A block that
+    // can't be read stops the loader (hasFailed).
+    class BatchLoader
+    {
+    public:
+        struct Batch
+        {
+            // batchSize items of itemSize values, in the order of a batch tensor, page-locked
+            // when the loader is pinned
+            float *m_inputs;
+            unsigned int *m_labels;
+            // the bytes of the files instead when the loader is raw, the inputs are not
+            // normalized and neither of the above is allocated
+            unsigned char *m_rawInputs;
+            unsigned char *m_rawLabels;
+            unsigned int m_size;
+            unsigned int m_epoch;
+        };
+
+    private:
+        // the blocks of the records being served, and which of their items
+        struct Span
+        {
+            unsigned int m_block;
+            unsigned int m_first;
+            unsigned int m_count;
+        };
+
+        const IDXFile *m_inputFile;
+        const IDXFile *m_labelFile;
+        const RecordDataset *m_dataset;
+        unsigned int m_batchSize;
+        float m_scale;
+
+        AugmentationParameters m_augmentation;
+        bool m_isPinned;
+        bool m_isRaw;
+        unsigned int m_shard;
+        unsigned int m_shardCount;
+        // the items of the current epoch in the order they are served
+        std::vector<unsigned int> m_order;
+
+        // records only: the spans of the epoch for this rank, in order, and the records of the
+        // last window read with their item index, served from m_windowCursor on
+        unsigned int m_windowBlockCount;
+        std::vector<Span> m_spans;
+        unsigned int m_spanCursor;
+        unsigned int m_windowIndex;
+        std::vector<unsigned char> m_window;
+        std::vector<std::pair<const unsigned char*, unsigned int>> m_windowItems;
+        unsigned int m_windowCursor;
+        // the records of the batch being decoded, copied out of the windows
+        std::vector<unsigned char> m_staging;
+
+        // the items of the batch being decoded, their labels (null without) and item indices
+        std::vector<const unsigned char*> m_items;
+        std::vector<const unsigned char*> m_itemLabels;
+        std::vector<unsigned int> m_itemIndices;
+
+        std::vector<Batch> m_buffers;
+        unsigned int m_fillIndex;
+        unsigned int m_readIndex;
+        unsigned int m_readyCount;
+        bool m_isAcquired;
+
+        unsigned int m_cursor;
+        unsigned int m_epoch;
+
+        std::thread *m_worker;
+        std::mutex m_mutex;
+        std::condition_variable m_batchReady;
+        std::condition_variable m_bufferFree;
+        bool m_isRunning;
+        bool m_hasFailed;
+
+        void workerLoop();
+        void shuffle();
+        void planSpans();
+        bool readWindow();
+        bool gather(unsigned int size);
+        bool decode(Batch &batch);
+        void decodeRaw(Batch &batch);
+        void freeBuffers();
+
+        const std::vector<unsigned int> &dimensions() const
+        {
+            return m_dataset ? m_dataset->dimensions() : m_inputFile->dimensions();
+        }
+
+        unsigned int itemCount() const
+        {
+            return m_dataset ? m_dataset->itemCount() : m_inputFile->itemCount();
+        }
+
+        unsigned int itemSize() const
+        {
+            return m_dataset ? m_dataset->itemSize() : m_inputFile->itemSize();
+        }
+
+        bool hasLabels() const
+        {
+            return m_dataset ? m_dataset->hasLabels() : m_labelFile != nullptr;
+        }
+
+        unsigned int shardItemCount() const
+        {
+            return itemCount() / m_shardCount;
+        }
+
+        // where the shard starts in the file, or in m_order when shuffling
+        unsigned int shardBegin() const
+        {
+            return m_shard * shardItemCount();
+        }
+
+    public:
+        // labelFile may be null, otherwise it has one byte per item of inputFile
+        BatchLoader(const IDXFile *inputFile, const IDXFile *labelFile, unsigned int batchSize,
+                    unsigned int bufferCount = 2, float scale = 1.0f / 255.0f);
+        // the labels are those of the records, if they have any
+        BatchLoader(const RecordDataset *dataset, unsigned int batchSize,
+                    unsigned int bufferCount = 2, float scale = 1.0f / 255.0f);
+        ~BatchLoader();
+
+        BatchLoader(const BatchLoader &) = delete;
+        void operator=(const BatchLoader &) = delete;
+
+        // set before start()
+        void setAugmentation(const AugmentationParameters &augmentation)
+        {
+            m_augmentation = augmentation;
+        }
+
+        // the batches are decoded straight into page-locked memory, for asynchronous uploads
+        void setPinned(bool isPinned)
+        {
+            m_isPinned = isPinned;
+        }
+
+        // the batches keep the bytes of the files, to be normalized where they are used, e.g.
+        // by DeviceBatchUploader on the gpu. Only shuffling applies, the other augmentations
+        // are skipped.
+        void setRaw(bool isRaw)
+        {
+            m_isRaw = isRaw;
+        }
+
+        // set before start(), records only: the blocks read at once, and the items shuffled
+        // together. Ahead of them as many are read ahead.
+        void setWindow(unsigned int blockCount)
+        {
+            m_windowBlockCount = std::max(1u, blockCount);
+        }
+
+        // set before start(), e.g. to Communicator::rank() and worldSize(). The augmentation seed
+        // has to be the same on every rank.
+        void setShard(unsigned int shard, unsigned int shardCount)
+        {
+            m_shard = shard;
+            m_shardCount = std::max(1u, shardCount);
+        }
+
+        bool start();
+        void stop();
+
+        // waits only when the worker is behind, null once stopped
+        const Batch *acquire();
+
+        // null when the next batch isn't decoded yet
+        const Batch *tryAcquire();
+
+        void release();
+
+        // a block of the records couldn't be read, the worker stopped there and acquire()
+        // returns null, as after stop()
+        bool hasFailed()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_hasFailed;
+        }
+
+        unsigned int batchSize() const
+        {
+            return m_batchSize;
+        }
+
+        float scale() const
+        {
+            return m_scale;
+        }
+
+        bool isRaw() const
+        {
+            return m_isRaw;
+        }
+    };
+}
+
+#endif
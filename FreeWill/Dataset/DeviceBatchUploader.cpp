@@ -0,0 +1,97 @@
+#include "DeviceBatchUploader.h"
+#include "Normalize_CUDA.h"
+#include "../Context/Context.h"
+#include "../Tensor/BlobAllocator.h"
+
+FreeWill::DeviceBatchUploader::DeviceBatchUploader(unsigned int deviceId)
+    :m_deviceId(deviceId),
+      m_deviceInputs(nullptr),
+      m_deviceLabels(nullptr),
+      m_inputCapacity(0),
+      m_labelCapacity(0)
+{
+}
+
+FreeWill::DeviceBatchUploader::~DeviceBatchUploader()
+{
+    freeBuffers();
+}
+
+void FreeWill::DeviceBatchUploader::freeBuffers()
+{
+    if (m_deviceInputs)
+    {
+        BlobAllocator::getSingleton().freeDevice(m_deviceInputs);
+        BlobAllocator::getSingleton().freeDevice(m_deviceLabels);
+    }
+
+    m_deviceInputs = nullptr;
+    m_deviceLabels = nullptr;
+    m_inputCapacity = 0;
+    m_labelCapacity = 0;
+}
+
+bool FreeWill::DeviceBatchUploader::upload(const FreeWill::BatchLoader::Batch *batch, unsigned int batchSize, unsigned int itemSize,
+                                           float scale, float *inputs, unsigned int *labels)
+{
+    if (!batch || !batch->m_rawInputs)
+    {
+        return false;
+    }
+
+    size_t inputSize = (size_t) batchSize * itemSize;
+
+    RUN_CUDA(cudaSetDevice(m_deviceId));
+
+    if (inputSize > m_inputCapacity || batchSize > m_labelCapacity)
+    {
+        // the previous upload may still be reading the old buffers
+        wait();
+        freeBuffers();
+
+        m_deviceInputs = (unsigned char *) BlobAllocator::getSingleton().allocateDevice(inputSize);
+        m_deviceLabels = (unsigned char *) BlobAllocator::getSingleton().allocateDevice(batchSize);
+
+        if (!m_deviceInputs || !m_deviceLabels)
+        {
+            if (m_deviceInputs)
+            {
+                BlobAllocator::getSingleton().freeDevice(m_deviceInputs);
+            }
+            if (m_deviceLabels)
+            {
+                BlobAllocator::getSingleton().freeDevice(m_deviceLabels);
+            }
+            m_deviceInputs = nullptr;
+            m_deviceLabels = nullptr;
+
+            return false;
+        }
+
+        m_inputCapacity = inputSize;
+        m_labelCapacity = batchSize;
+    }
+
+    Context<DeviceType::GPU_CUDA> &context = Context<DeviceType::GPU_CUDA>::getSingleton();
+    cudaStream_t copyStream = context.copyStream(m_deviceId);
+
+    RUN_CUDA(cudaMemcpyAsync(m_deviceInputs, batch->m_rawInputs, inputSize, cudaMemcpyHostToDevice, copyStream));
+    if (labels)
+    {
+        RUN_CUDA(cudaMemcpyAsync(m_deviceLabels, batch->m_rawLabels, batchSize, cudaMemcpyHostToDevice, copyStream));
+    }
+    RUN_CUDA(cudaStreamWaitEvent(0, context.recordCopies(m_deviceId), 0));
+
+    normalizeBytesCUDAKernel<float>(m_deviceInputs, inputs, inputSize, scale);
+    if (labels)
+    {
+        widenLabelsCUDAKernel(m_deviceLabels, labels, batchSize);
+    }
+
+    return true;
+}
+
+void FreeWill::DeviceBatchUploader::wait()
+{
+    RUN_CUDA(cudaStreamSynchronize(Context<DeviceType::GPU_CUDA>::getSingleton().copyStream(m_deviceId)));
+}
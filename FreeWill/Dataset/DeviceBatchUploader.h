@@ -0,0 +1,41 @@
+#ifndef DEVICEBATCHUPLOADER_H
+#define DEVICEBATCHUPLOADER_H
+
+#include "BatchLoader.h"
+#include <cuda_runtime.h>
+
+namespace FreeWill
+{
+    // Uploads the raw batches of a BatchLoader to one gpu as bytes, a quarter of the floats,
+    // on the device's copy stream, and converts them on the default stream into the batch
+    // tensors, which wait for the upload on the device only. The loader should be pinned for
+    // the upload to be asynchronous.
+    class DeviceBatchUploader
+    {
+    private:
+        unsigned int m_deviceId;
+        unsigned char *m_deviceInputs;
+        unsigned char *m_deviceLabels;
+        size_t m_inputCapacity;
+        size_t m_labelCapacity;
+
+        void freeBuffers();
+
+    public:
+        explicit DeviceBatchUploader(unsigned int deviceId = 0);
+        ~DeviceBatchUploader();
+
+        DeviceBatchUploader(const DeviceBatchUploader &) = delete;
+        void operator=(const DeviceBatchUploader &) = delete;
+
+        // inputs and labels are device memory for batchSize items of itemSize values, labels may
+        // be null. The batch has to stay acquired until wait() returns.
+        bool upload(const BatchLoader::Batch *batch, unsigned int batchSize, unsigned int itemSize, float scale,
+                    float *inputs, unsigned int *labels);
+
+        // the host memory of the last uploaded batch can be reused after this
+        void wait();
+    };
+}
+
+#endif
@@ -0,0 +1,119 @@
+#include "IDXFile.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <iostream>
+
+FreeWill::IDXFile::IDXFile()
+    :m_fileDescriptor(-1),
+      m_mapping(nullptr),
+      m_mappingSize(0),
+      m_data(nullptr),
+      m_dimensions(),
+      m_itemSize(0)
+{
+}
+
+FreeWill::IDXFile::~IDXFile()
+{
+    close();
+}
+
+static unsigned int readBigEndian32(const unsigned char *bytes)
+{
+    return ((unsigned int) bytes[0] << 24) | ((unsigned int) bytes[1] << 16) | ((unsigned int) bytes[2] << 8) | bytes[3];
+}
+
+bool FreeWill::IDXFile::open(const std::string &filename)
+{
+    close();
+
+    m_fileDescriptor = ::open(filename.c_str(), O_RDONLY);
+
+    if (m_fileDescriptor < 0)
+    {
+        std::cerr << "can't open " << filename << std::endl;
+        return false;
+    }
+
+    struct stat fileStatus;
+
+    if (fstat(m_fileDescriptor, &fileStatus) != 0 || fileStatus.st_size < 4)
+    {
+        close();
+        return false;
+    }
+
+    m_mappingSize = fileStatus.st_size;
+    void *mapping = mmap(nullptr, m_mappingSize, PROT_READ, MAP_PRIVATE, m_fileDescriptor, 0);
+
+    if (mapping == MAP_FAILED)
+    {
+        std::cerr << "can't map " << filename << std::endl;
+        m_mappingSize = 0;
+        close();
+        return false;
+    }
+
+    m_mapping = static_cast<const unsigned char*>(mapping);
+
+    // the whole file is read front to back, once per epoch
+    madvise(mapping, m_mappingSize, MADV_SEQUENTIAL);
+
+    // 0, 0, the data type and the number of dimensions
+    unsigned int dimensionCount = m_mapping[3];
+    size_t headerSize = 4 + 4 * (size_t) dimensionCount;
+
+    if (m_mapping[0] != 0 || m_mapping[1] != 0 || m_mapping[2] != 0x08 || dimensionCount == 0 || m_mappingSize < headerSize)
+    {
+        std::cerr << filename << " is not an unsigned byte IDX file" << std::endl;
+        close();
+        return false;
+    }
+
+    size_t dataSize = 1;
+    m_itemSize = 1;
+
+    for (unsigned int i = 0; i < dimensionCount; ++i)
+    {
+        m_dimensions.push_back(readBigEndian32(m_mapping + 4 + 4 * i));
+        dataSize *= m_dimensions.back();
+
+        if (i > 0)
+        {
+            m_itemSize *= m_dimensions.back();
+        }
+    }
+
+    if (m_mappingSize < headerSize + dataSize)
+    {
+        std::cerr << filename << " is truncated" << std::endl;
+        close();
+        return false;
+    }
+
+    m_data = m_mapping + headerSize;
+
+    return true;
+}
+
+void FreeWill::IDXFile::close()
+{
+    if (m_mapping)
+    {
+        munmap(const_cast<unsigned char*>(m_mapping), m_mappingSize);
+    }
+
+    if (m_fileDescriptor >= 0)
+    {
+        ::close(m_fileDescriptor);
+    }
+
+    m_fileDescriptor = -1;
+    m_mapping = nullptr;
+    m_mappingSize = 0;
+    m_data = nullptr;
+    m_dimensions.clear();
+    m_itemSize = 0;
+}
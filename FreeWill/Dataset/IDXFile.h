@@ -0,0 +1,59 @@
+#ifndef IDXFILE_H
+#define IDXFILE_H
+
+#include <string>
+#include <vector>
+
+namespace FreeWill
+{
+    // Read only, memory mapped IDX file (the MNIST format): a big endian header of a magic number
+    // and one count per dimension, followed by the items. Only unsigned byte data, type 0x08, is
+    // supported. The first dimension counts the items, the others make up one item.
+    class IDXFile
+    {
+        int m_fileDescriptor;
+        const unsigned char *m_mapping;
+        size_t m_mappingSize;
+        const unsigned char *m_data;
+        std::vector<unsigned int> m_dimensions;
+        unsigned int m_itemSize;
+
+    public:
+        IDXFile();
+        ~IDXFile();
+
+        IDXFile(const IDXFile &) = delete;
+        void operator=(const IDXFile &) = delete;
+
+        bool open(const std::string &filename);
+        void close();
+
+        bool isOpen() const
+        {
+            return m_mapping != nullptr;
+        }
+
+        const std::vector<unsigned int> &dimensions() const
+        {
+            return m_dimensions;
+        }
+
+        unsigned int itemCount() const
+        {
+            return m_dimensions.empty() ? 0 : m_dimensions[0];
+        }
+
+        // in bytes, the product of the dimensions after the first
+        unsigned int itemSize() const
+        {
+            return m_itemSize;
+        }
+
+        const unsigned char *item(unsigned int index) const
+        {
+            return m_data + (size_t) index * m_itemSize;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,72 @@
+#include "Normalize_CUDA.h"
+#include "../DeviceSelection.h"
+#include "../Tensor/HalfPrecision.h"
+#include <cuda_runtime.h>
+
+// four bytes per thread, one 32-bit load, the tail is done byte by byte
+template <typename DataType>
+__global__ void normalizeBytes(const unsigned char *input, DataType *output, unsigned int size, float scale)
+{
+    unsigned int id = blockIdx.x * blockDim.x + threadIdx.x;
+    unsigned int first = id * 4;
+
+    if (first + 3 < size)
+    {
+        uchar4 bytes = reinterpret_cast<const uchar4*>(input)[id];
+        output[first] = (DataType) (bytes.x * scale);
+        output[first + 1] = (DataType) (bytes.y * scale);
+        output[first + 2] = (DataType) (bytes.z * scale);
+        output[first + 3] = (DataType) (bytes.w * scale);
+    }
+    else
+    {
+        for (unsigned int i = first; i < size; ++i)
+        {
+            output[i] = (DataType) (input[i] * scale);
+        }
+    }
+}
+
+__global__ void widenLabels(const unsigned char *input, unsigned int *output, unsigned int size)
+{
+    unsigned int id = blockIdx.x * blockDim.x + threadIdx.x;
+    if (id < size)
+    {
+        output[id] = input[id];
+    }
+}
+
+template <typename DataType>
+__host__ void normalizeBytesCUDAKernel(const unsigned char *input, DataType *output, unsigned int size, float scale, cudaStream_t stream)
+{
+    int blockSize = 256;
+    unsigned int threadCount = (size + 3) / 4;
+    int gridSize = (threadCount + blockSize - 1) / blockSize;
+
+    if (gridSize == 0)
+    {
+        return;
+    }
+
+    normalizeBytes<DataType><<<gridSize, blockSize, 0, stream>>>(input, output, size, scale);
+    CHECK_CUDA_ERROR
+}
+
+__host__ void widenLabelsCUDAKernel(const unsigned char *input, unsigned int *output, unsigned int size, cudaStream_t stream)
+{
+    int blockSize = 256;
+    int gridSize = (size + blockSize - 1) / blockSize;
+
+    if (gridSize == 0)
+    {
+        return;
+    }
+
+    widenLabels<<<gridSize, blockSize, 0, stream>>>(input, output, size);
+    CHECK_CUDA_ERROR
+}
+
+template __host__ void normalizeBytesCUDAKernel(const unsigned char *input, float *output, unsigned int size, float scale, cudaStream_t stream);
+template __host__ void normalizeBytesCUDAKernel(const unsigned char *input, double *output, unsigned int size, float scale, cudaStream_t stream);
+template __host__ void normalizeBytesCUDAKernel(const unsigned char *input, FreeWill::Half *output, unsigned int size, float scale, cudaStream_t stream);
+template __host__ void normalizeBytesCUDAKernel(const unsigned char *input, FreeWill::BFloat16 *output, unsigned int size, float scale, cudaStream_t stream);
@@ -0,0 +1,15 @@
+#ifndef NORMALIZE_CUDA_H
+#define NORMALIZE_CUDA_H
+
+#include <cuda_runtime.h>
+
+// shared with the cuda kernels, keep it c++11
+
+// output[i] = input[i] * scale, for byte data uploaded as it is in the file
+template <typename DataType = float>
+__host__ void normalizeBytesCUDAKernel(const unsigned char *input, DataType *output, unsigned int size, float scale, cudaStream_t stream = 0);
+
+// byte labels to the unsigned int label tensors
+__host__ void widenLabelsCUDAKernel(const unsigned char *input, unsigned int *output, unsigned int size, cudaStream_t stream = 0);
+
+#endif
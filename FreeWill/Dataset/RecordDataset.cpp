@@ -0,0 +1,265 @@
+#include "RecordDataset.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+static const char RECORD_FILE_MAGIC[4] = {'F', 'W', 'R', 'C'};
+// the fields before the dimensions
+static const size_t RECORD_FILE_HEADER_SIZE = 32;
+
+static uint64_t readLittleEndian(const unsigned char *bytes, unsigned int size)
+{
+    uint64_t value = 0;
+
+    for (unsigned int i = size; i-- > 0;)
+    {
+        value = (value << 8) | bytes[i];
+    }
+
+    return value;
+}
+
+static void writeLittleEndian(unsigned char *bytes, uint64_t value, unsigned int size)
+{
+    for (unsigned int i = 0; i < size; ++i)
+    {
+        bytes[i] = (unsigned char) (value >> (8 * i));
+    }
+}
+
+// all of size bytes at offset, pread may return less
+static bool readFully(int fileDescriptor, unsigned char *buffer, size_t size, off_t offset)
+{
+    while (size > 0)
+    {
+        ssize_t count = pread(fileDescriptor, buffer, size, offset);
+
+        if (count < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (count <= 0)
+        {
+            return false;
+        }
+
+        buffer += count;
+        size -= count;
+        offset += count;
+    }
+
+    return true;
+}
+
+FreeWill::RecordDataset::RecordDataset()
+    :m_shards(),
+      m_blocks(),
+      m_dimensions(),
+      m_itemSize(0),
+      m_labelSize(0),
+      m_recordsPerBlock(0)
+{
+}
+
+FreeWill::RecordDataset::~RecordDataset()
+{
+    close();
+}
+
+bool FreeWill::RecordDataset::open(const std::vector<std::string> &filenames)
+{
+    close();
+
+    uint64_t itemCount = 0;
+
+    for (const std::string &filename : filenames)
+    {
+        int fileDescriptor = ::open(filename.c_str(), O_RDONLY);
+
+        if (fileDescriptor < 0)
+        {
+            std::cerr << "can't open " << filename << std::endl;
+            close();
+            return false;
+        }
+
+        m_shards.push_back({fileDescriptor, 0});
+
+        unsigned char header[RECORD_FILE_DATA_OFFSET];
+        struct stat fileStatus;
+
+        if (fstat(fileDescriptor, &fileStatus) != 0 || (size_t) fileStatus.st_size < RECORD_FILE_DATA_OFFSET ||
+                !readFully(fileDescriptor, header, RECORD_FILE_DATA_OFFSET, 0) ||
+                std::memcmp(header, RECORD_FILE_MAGIC, 4) != 0 || readLittleEndian(header + 4, 4) != RECORD_FILE_VERSION)
+        {
+            std::cerr << filename << " is not a record file" << std::endl;
+            close();
+            return false;
+        }
+
+        unsigned int itemSize = (unsigned int) readLittleEndian(header + 8, 4);
+        unsigned int labelSize = (unsigned int) readLittleEndian(header + 12, 4);
+        unsigned int recordsPerBlock = (unsigned int) readLittleEndian(header + 16, 4);
+        unsigned int dimensionCount = (unsigned int) readLittleEndian(header + 20, 4);
+        uint64_t recordCount = readLittleEndian(header + 24, 8);
+
+        if (itemSize == 0 || labelSize > 1 || recordsPerBlock == 0 ||
+                RECORD_FILE_HEADER_SIZE + 4 * (size_t) dimensionCount > RECORD_FILE_DATA_OFFSET)
+        {
+            std::cerr << filename << " has a broken header" << std::endl;
+            close();
+            return false;
+        }
+
+        std::vector<unsigned int> dimensions(1, 0);
+        for (unsigned int i = 0; i < dimensionCount; ++i)
+        {
+            dimensions.push_back((unsigned int) readLittleEndian(header + RECORD_FILE_HEADER_SIZE + 4 * i, 4));
+        }
+
+        if (m_shards.size() == 1)
+        {
+            m_itemSize = itemSize;
+            m_labelSize = labelSize;
+            m_recordsPerBlock = recordsPerBlock;
+            m_dimensions = dimensions;
+        }
+        else if (itemSize != m_itemSize || labelSize != m_labelSize || recordsPerBlock != m_recordsPerBlock ||
+                 !std::equal(dimensions.begin() + 1, dimensions.end(), m_dimensions.begin() + 1, m_dimensions.end()))
+        {
+            std::cerr << filename << " doesn't match the shards before it" << std::endl;
+            close();
+            return false;
+        }
+
+        if ((uint64_t) fileStatus.st_size < RECORD_FILE_DATA_OFFSET + recordCount * recordSize())
+        {
+            std::cerr << filename << " is truncated" << std::endl;
+            close();
+            return false;
+        }
+
+        m_shards.back().m_recordCount = recordCount;
+
+        for (uint64_t first = 0; first < recordCount; first += recordsPerBlock)
+        {
+            unsigned int count = (unsigned int) std::min<uint64_t>(recordsPerBlock, recordCount - first);
+            m_blocks.push_back({(unsigned int) m_shards.size() - 1, first, (unsigned int) (itemCount + first), count});
+        }
+
+        itemCount += recordCount;
+
+        if (itemCount > 0xffffffffull)
+        {
+            std::cerr << "more than 2^32 items in the shards up to " << filename << std::endl;
+            close();
+            return false;
+        }
+    }
+
+    if (m_shards.empty())
+    {
+        return false;
+    }
+
+    m_dimensions[0] = (unsigned int) itemCount;
+
+    return true;
+}
+
+void FreeWill::RecordDataset::close()
+{
+    for (const Shard &shard : m_shards)
+    {
+        ::close(shard.m_fileDescriptor);
+    }
+
+    m_shards.clear();
+    m_blocks.clear();
+    m_dimensions.clear();
+    m_itemSize = 0;
+    m_labelSize = 0;
+    m_recordsPerBlock = 0;
+}
+
+bool FreeWill::RecordDataset::readBlock(unsigned int block, unsigned char *buffer) const
+{
+    const Block &location = m_blocks[block];
+
+    return readFully(m_shards[location.m_shard].m_fileDescriptor, buffer, location.m_itemCount * recordSize(),
+                     (off_t) (RECORD_FILE_DATA_OFFSET + location.m_firstRecord * recordSize()));
+}
+
+void FreeWill::RecordDataset::prefetchBlock(unsigned int block) const
+{
+    const Block &location = m_blocks[block];
+
+    posix_fadvise(m_shards[location.m_shard].m_fileDescriptor, (off_t) (RECORD_FILE_DATA_OFFSET + location.m_firstRecord * recordSize()),
+                  (off_t) (location.m_itemCount * recordSize()), POSIX_FADV_WILLNEED);
+}
+
+std::vector<std::string> FreeWill::writeRecordShards(const FreeWill::IDXFile &inputFile, const FreeWill::IDXFile *labelFile, const std::string &prefix,
+                                                     unsigned int shardCount, unsigned int recordsPerBlock)
+{
+    unsigned int itemCount = inputFile.itemCount();
+    const std::vector<unsigned int> &dimensions = inputFile.dimensions();
+
+    if (!inputFile.isOpen() || shardCount == 0 || recordsPerBlock == 0 ||
+            (labelFile && (!labelFile->isOpen() || labelFile->itemSize() != 1 || labelFile->itemCount() != itemCount)))
+    {
+        return std::vector<std::string>();
+    }
+
+    std::vector<std::string> filenames;
+
+    for (unsigned int shard = 0; shard < shardCount; ++shard)
+    {
+        unsigned int first = (unsigned int) ((uint64_t) itemCount * shard / shardCount);
+        unsigned int last = (unsigned int) ((uint64_t) itemCount * (shard + 1) / shardCount);
+
+        filenames.push_back(prefix + "-" + std::to_string(shard) + "-of-" + std::to_string(shardCount));
+        FILE *file = fopen(filenames.back().c_str(), "wb");
+
+        if (!file)
+        {
+            std::cerr << "can't create " << filenames.back() << std::endl;
+            return std::vector<std::string>();
+        }
+
+        unsigned char header[RECORD_FILE_DATA_OFFSET] = {0};
+        std::memcpy(header, RECORD_FILE_MAGIC, 4);
+        writeLittleEndian(header + 4, RECORD_FILE_VERSION, 4);
+        writeLittleEndian(header + 8, inputFile.itemSize(), 4);
+        writeLittleEndian(header + 12, labelFile ? 1 : 0, 4);
+        writeLittleEndian(header + 16, recordsPerBlock, 4);
+        writeLittleEndian(header + 20, dimensions.size() - 1, 4);
+        writeLittleEndian(header + 24, last - first, 8);
+
+        for (unsigned int i = 1; i < dimensions.size(); ++i)
+        {
+            writeLittleEndian(header + RECORD_FILE_HEADER_SIZE + 4 * (i - 1), dimensions[i], 4);
+        }
+
+        bool isWritten = fwrite(header, 1, RECORD_FILE_DATA_OFFSET, file) == RECORD_FILE_DATA_OFFSET;
+
+        for (unsigned int i = first; isWritten && i < last; ++i)
+        {
+            isWritten = fwrite(inputFile.item(i), 1, inputFile.itemSize(), file) == inputFile.itemSize() &&
+                    (!labelFile || fwrite(labelFile->item(i), 1, 1, file) == 1);
+        }
+
+        if (fclose(file) != 0 || !isWritten)
+        {
+            std::cerr << "can't write " << filenames.back() << std::endl;
+            return std::vector<std::string>();
+        }
+    }
+
+    return filenames;
+}
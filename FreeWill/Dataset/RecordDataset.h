@@ -0,0 +1,129 @@
+#ifndef RECORDDATASET_H
+#define RECORDDATASET_H
+
+#include "IDXFile.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace FreeWill
+{
+    // A dataset split over shard files of fixed size records, read a block of records at a time
+    // with pread instead of mapped, so it never has to fit in memory (see BatchLoader).
+    //
+    // A shard starts with a little endian header, padded to RECORD_FILE_DATA_OFFSET:
+    //
+    //     "FWRC", version, item size, label size (0 or 1), records per block, dimension count,
+    //     record count (64 bit), the dimensions of one item
+    //
+    // then the records, each the item's bytes followed by its label. A block is recordsPerBlock
+    // consecutive records, the last one of a shard may be shorter, so the offset of every block
+    // follows from its index. The shards have to agree on everything but the record count.
+    // The items are numbered through the shards in the order they were opened.
+    static const unsigned int RECORD_FILE_VERSION = 1;
+    static const size_t RECORD_FILE_DATA_OFFSET = 4096;
+
+    class RecordDataset
+    {
+        struct Shard
+        {
+            int m_fileDescriptor;
+            uint64_t m_recordCount;
+        };
+
+        struct Block
+        {
+            unsigned int m_shard;
+            // of the shard
+            uint64_t m_firstRecord;
+            // of the dataset
+            unsigned int m_firstItem;
+            unsigned int m_itemCount;
+        };
+
+        std::vector<Shard> m_shards;
+        std::vector<Block> m_blocks;
+        // like IDXFile: the item count, then the dimensions of one item
+        std::vector<unsigned int> m_dimensions;
+        unsigned int m_itemSize;
+        unsigned int m_labelSize;
+        unsigned int m_recordsPerBlock;
+
+    public:
+        RecordDataset();
+        ~RecordDataset();
+
+        RecordDataset(const RecordDataset &) = delete;
+        void operator=(const RecordDataset &) = delete;
+
+        bool open(const std::vector<std::string> &filenames);
+        void close();
+
+        bool isOpen() const
+        {
+            return !m_shards.empty();
+        }
+
+        const std::vector<unsigned int> &dimensions() const
+        {
+            return m_dimensions;
+        }
+
+        unsigned int itemCount() const
+        {
+            return m_dimensions.empty() ? 0 : m_dimensions[0];
+        }
+
+        unsigned int itemSize() const
+        {
+            return m_itemSize;
+        }
+
+        bool hasLabels() const
+        {
+            return m_labelSize > 0;
+        }
+
+        // the item and its label
+        size_t recordSize() const
+        {
+            return (size_t) m_itemSize + m_labelSize;
+        }
+
+        unsigned int recordsPerBlock() const
+        {
+            return m_recordsPerBlock;
+        }
+
+        unsigned int blockCount() const
+        {
+            return (unsigned int) m_blocks.size();
+        }
+
+        unsigned int blockFirstItem(unsigned int block) const
+        {
+            return m_blocks[block].m_firstItem;
+        }
+
+        unsigned int blockItemCount(unsigned int block) const
+        {
+            return m_blocks[block].m_itemCount;
+        }
+
+        // the records of the block into buffer, blockItemCount(block) * recordSize() bytes.
+        // Thread safe, the reads of different blocks can be in flight at once.
+        bool readBlock(unsigned int block, unsigned char *buffer) const;
+
+        // lets the kernel start reading the block in the background, for a readBlock soon after
+        void prefetchBlock(unsigned int block) const;
+    };
+
+    // Writes the items of inputFile, and the labels of labelFile if not null, as shardCount
+    // record files <prefix>-<shard>-of-<shardCount>, item i into shard i * shardCount / itemCount
+    // so the shards are contiguous runs of about the same size. Returns the filenames, empty
+    // when it fails.
+    std::vector<std::string> writeRecordShards(const IDXFile &inputFile, const IDXFile *labelFile, const std::string &prefix,
+                                               unsigned int shardCount, unsigned int recordsPerBlock = 1024);
+}
+
+#endif
@@ -8,33 +8,118 @@ private slots:
     void cleanupTestCase();
     void blobTest();
     void blobTestGPU();
+    void managedMemoryTestGPU();
+    void blobAllocatorTest();
     void tensorTest();
+    void shapeTest();
+    void tensorViewTest();
     void tensorTestGPU();
+    void randomNumberGeneratorTest();
+    void randomNumberGeneratorTestGPU();
     void operatorTest();
     void operatorTestGPU();
+    void cudaGraphTestGPU();
+    void computeLaneTestGPU();
+    void peerCopyTestGPU();
     void operatorSigmoidTestCPUAndGPU();
     void operatorSigmoidDerivativeTest();
     void operatorSigmoidDerivativeTestGPU();
     void operatorReLUDerivativeTest();
     void operatorReLUDerivativeTestGPU();
+    void operatorActivationKernelTest();
+    void operatorElementwiseFusionTest();
     void operatorSigmoidCrossEntropyTestCPUAndGPU();
     void operatorSigmoidCrossEntropyDerivativeTest();
     void operatorSigmoidCrossEntropyDerivativeTestGPU();
     void operatorDotProductWithBiasTest();
     void operatorDotProductWithBiasTestGPU();
+    void operatorDotProductWithBiasLargeTest();
     void operatorDotProductWithBiasDerivativeTest();
     void operatorDotProductWithBiasDerivativeTestGPU();
+    void operatorDotProductWithBiasDerivativeBatchTest();
+    void operatorDotProductWithBiasDerivativeBatchTestGPU();
+    void operatorSparseDotProductWithBiasTest();
+    void operatorSparseDotProductWithBiasTestGPU();
+    void operatorStackedDotProductWithBiasTest();
+    void operatorStackedDotProductWithBiasTestGPU();
+    void operatorPrunedDotProductWithBiasTest();
+    void operatorPrunedDotProductWithBiasTestGPU();
     void SoftmaxTest();
     void SoftmaxTestGPU();
     void SoftmaxDerivativeTest();
     void SoftmaxDerivativeTestGPU();
+    void SoftmaxLogLossWithDerivativeTest();
     void convolutionTest();
     void convolutionTestGPU();
+    void convolutionAlgorithmCacheTestGPU();
+    void cpuAutotunerTest();
+    void convolutionWorkspaceTestGPU();
+    void convolutionAlgorithmTest();
+    void channelBlockedConvolutionTest();
+    void convolutionKernelSelectionTest();
     void convolutionDerivativeTest();
     void convolutionDerivativeTestGPU();
+    void convolutionDerivativeLoweringTest();
+    void groupedConvolutionTest();
+    void groupedConvolutionTestGPU();
     void maxPoolingTestCPUAndGPU();
+    void maxPoolingSwitchTest();
+    void dropoutTest();
+    void dropoutTestGPU();
+    void metricTest();
+    void metricTestGPU();
+    void lstmTest();
+    void lstmTestGPU();
+    void batchNormalizationTest();
+    void batchNormalizationTestGPU();
     void xorTest();
     void xorTestGPU();
     void modelXORTest();
+    void graphExecutorTest();
+    void memoryPlannerTest();
+    void gradientAllReduceTest();
+    void asynchronousUpdateTest();
+    void numaGradientReduceTest();
+    void profilerTest();
+    void profilerCountersTest();
+    void trainingMetricsTest();
+    void optimizerTest();
+    void modelRatesTest();
+    void overlapGradientReduceTest();
+    void pipelineTest();
+    void gradientAccumulationTest();
+    void operatorFusionTest();
+    void mixedPrecisionTest();
+    void lossScaledSigmoidLossTest();
+    void quantizedInferenceTest();
+    void structuredSparsityTest();
+    void inferenceInPlaceActivationTest();
+    void inlineInferenceTest();
+    void channelBlockedInferenceTest();
+    void inferenceServerTest();
+    void dynamicBatchSizeTest();
+    void feedFromMemoryTest();
+    void scatterBatchTest();
+    void checkpointTest();
+    void sharedWeightsTest();
+    void asyncEvaluationTest();
+    void graphSerializationTest();
+    void recomputationTest();
+    void activationCompressionTest();
+    void parallelInitTest();
+    void asyncSolverTest();
+    void asyncSolverTestGPU();
+    void sparseInputModelTest();
+    void memoryAccountingTest();
+    void topologyTunerTest();
+    void batchLoaderTest();
+    void batchLoaderAugmentationTest();
+    void batchLoaderShardTest();
+    void recordDatasetTest();
     void threadTestCPU();
+    void ringbufferTest();
+    void threadPoolTest();
+    void cpuKernelDispatchTest();
+    void completionLatchTest();
+    void communicatorTest();
 };
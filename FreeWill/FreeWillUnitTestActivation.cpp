@@ -330,4 +330,218 @@ void FreeWillUnitTest::operatorReLUDerivativeTestGPU()
     QVERIFY(relativeError(fakeDerivative, input[0]) < epsilon);
 }
 
+template<typename DataType>
+static void activationKernelTest(double tolerance)
+{
+    // covers the vector body, the padded tail and the saturated ranges of exp
+    const unsigned int size = 1037;
+    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, DataType> input({size});
+    input.init();
+    for (unsigned int i = 0; i < size; ++i)
+    {
+        input[i] = -60.0 + 120.0 * i / (size - 1);
+    }
+    input[0] = -1000.0;
+    input[1] = 1000.0;
+    input[2] = 0.0;
+    input[3] = 1.0e-5;
+
+    const FreeWill::ActivationMode modes[] = {FreeWill::ActivationMode::SIGMOID, FreeWill::ActivationMode::RELU,
+                                              FreeWill::ActivationMode::TANH, FreeWill::ActivationMode::CLIPPED_RELU};
+
+    for (FreeWill::ActivationMode mode : modes)
+    {
+        QVERIFY(FreeWill::isActivationImplementedCPU(mode));
+
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, DataType> output({size});
+        output.init();
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, DataType> inPlace({size});
+        inPlace.init();
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, DataType> delta({size});
+        delta.init();
+        delta.randomize();
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, DataType> inputDelta({size});
+        inputDelta.init();
+
+        for (unsigned int i = 0; i < size; ++i)
+        {
+            inPlace[i] = input[i];
+        }
+
+        FreeWill::activationForwardCPU<DataType>(mode, input.cpuDataHandle(), output.cpuDataHandle(), size);
+        FreeWill::activationForwardCPU<DataType>(mode, inPlace.cpuDataHandle(), inPlace.cpuDataHandle(), size);
+
+        for (unsigned int i = 0; i < size; ++i)
+        {
+            double x = input[i];
+            double expected = 0.0;
+
+            switch (mode)
+            {
+            case FreeWill::ActivationMode::SIGMOID:
+                expected = 1.0 / (1.0 + std::exp(-x));
+                break;
+            case FreeWill::ActivationMode::RELU:
+                expected = x > 0.0 ? x : 0.0;
+                break;
+            case FreeWill::ActivationMode::TANH:
+                expected = std::tanh(x);
+                break;
+            case FreeWill::ActivationMode::CLIPPED_RELU:
+                expected = std::min(std::max(x, 0.0), 20.0);
+                break;
+            }
+
+            QVERIFY(std::abs(output[i] - expected) <= tolerance * std::max(1.0, std::abs(expected)));
+            QVERIFY(output[i] == inPlace[i]);
+            QVERIFY(FreeWill::activationCPU<DataType>(mode, input[i]) == output[i]);
+
+            // the derivative below is written over a copy of the delta, in place
+            inputDelta[i] = delta[i];
+        }
+
+        switch (mode)
+        {
+        case FreeWill::ActivationMode::SIGMOID:
+            FreeWill::activationBackwardCPU<FreeWill::ActivationMode::SIGMOID>(output.cpuDataHandle(), inputDelta.cpuDataHandle(), inputDelta.cpuDataHandle(), size);
+            break;
+        case FreeWill::ActivationMode::RELU:
+            FreeWill::activationBackwardCPU<FreeWill::ActivationMode::RELU>(output.cpuDataHandle(), inputDelta.cpuDataHandle(), inputDelta.cpuDataHandle(), size);
+            break;
+        case FreeWill::ActivationMode::TANH:
+            FreeWill::activationBackwardCPU<FreeWill::ActivationMode::TANH>(output.cpuDataHandle(), inputDelta.cpuDataHandle(), inputDelta.cpuDataHandle(), size);
+            break;
+        case FreeWill::ActivationMode::CLIPPED_RELU:
+            FreeWill::activationBackwardCPU<FreeWill::ActivationMode::CLIPPED_RELU>(output.cpuDataHandle(), inputDelta.cpuDataHandle(), inputDelta.cpuDataHandle(), size);
+            break;
+        }
+
+        for (unsigned int i = 0; i < size; ++i)
+        {
+            double y = output[i];
+            double expected = 0.0;
+
+            switch (mode)
+            {
+            case FreeWill::ActivationMode::SIGMOID:
+                expected = y * (1.0 - y);
+                break;
+            case FreeWill::ActivationMode::RELU:
+                expected = y > 0.0 ? 1.0 : 0.0;
+                break;
+            case FreeWill::ActivationMode::TANH:
+                expected = 1.0 - y * y;
+                break;
+            case FreeWill::ActivationMode::CLIPPED_RELU:
+                expected = y > 0.0 && y < 20.0 ? 1.0 : 0.0;
+                break;
+            }
+
+            expected *= (double) delta[i];
+            QVERIFY(std::abs(inputDelta[i] - expected) <= tolerance * std::max(1.0, std::abs(expected)));
+        }
+    }
+}
+
+void FreeWillUnitTest::operatorActivationKernelTest()
+{
+    activationKernelTest<float>(1.0e-6);
+    activationKernelTest<double>(1.0e-14);
+
+    // the operators run the same kernels, tanh is no longer a stub on the cpu
+    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> input({64, 7});
+    input.init();
+    input.randomize();
+    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> output({64, 7});
+    output.init();
+
+    FreeWill::Activation<FreeWill::ActivationMode::TANH, FreeWill::DeviceType::CPU_NAIVE, float> tanhCPU;
+    tanhCPU.setInputParameter("Input", &input);
+    tanhCPU.setOutputParameter("Output", &output);
+    QVERIFY(tanhCPU.init());
+    tanhCPU.evaluate();
+
+    for (unsigned int i = 0; i < input.shape().size(); ++i)
+    {
+        QVERIFY(std::abs(output[i] - std::tanh(input[i])) < 1.0e-6);
+    }
+}
+
+// an ElementwiseAdd with the activation derivative fused in matches the two operators bit for bit
+template<FreeWill::ActivationMode ActivationModeUsed>
+static void elementwiseFusionTest(bool isDerivativeOperandA)
+{
+    // beyond the threading threshold and not a multiple of the blocks
+    const unsigned int size = 70003;
+    const float rate = -0.25f;
+
+    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> input({size});
+    input.init();
+    input.randomize();
+    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> output({size});
+    output.init();
+    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> outputDelta({size});
+    outputDelta.init();
+    outputDelta.randomize();
+    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> operand({size});
+    operand.init();
+    operand.randomize();
+    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> inputDelta({size});
+    inputDelta.init();
+    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> unfused({size});
+    unfused.init();
+    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> fused({size});
+    fused.init();
+
+    for (unsigned int i = 0; i < size; ++i)
+    {
+        input[i] = input[i] * 8.0f - 4.0f;
+    }
+
+    FreeWill::Activation<ActivationModeUsed, FreeWill::DeviceType::CPU_NAIVE, float> activation;
+    activation.setInputParameter("Input", &input);
+    activation.setOutputParameter("Output", &output);
+    QVERIFY(activation.init());
+    activation.evaluate();
+
+    FreeWill::ActivationDerivative<ActivationModeUsed, FreeWill::DeviceType::CPU_NAIVE, float> activationDerivative;
+    activationDerivative.setInputParameter("Output", &output);
+    activationDerivative.setInputParameter("OutputDelta", &outputDelta);
+    activationDerivative.setOutputParameter("InputDelta", &inputDelta);
+    QVERIFY(activationDerivative.init());
+    activationDerivative.evaluate();
+
+    FreeWill::ElementwiseAdd<FreeWill::DeviceType::CPU_NAIVE, float> add(rate);
+    add.setInputParameter("OperandA", isDerivativeOperandA ? &inputDelta : &operand);
+    add.setInputParameter("OperandB", isDerivativeOperandA ? &operand : &inputDelta);
+    add.setOutputParameter("Result", &unfused);
+    QVERIFY(add.init());
+    add.evaluate();
+
+    FreeWill::ElementwiseAdd<FreeWill::DeviceType::CPU_NAIVE, float> fusedAdd(rate);
+    fusedAdd.fuseActivationDerivative(ActivationModeUsed, isDerivativeOperandA);
+    fusedAdd.setInputParameter(isDerivativeOperandA ? "OperandB" : "OperandA", &operand);
+    fusedAdd.setInputParameter("Output", &output);
+    fusedAdd.setInputParameter("OutputDelta", &outputDelta);
+    fusedAdd.setOutputParameter("Result", &fused);
+    QVERIFY(fusedAdd.init());
+    fusedAdd.evaluate();
+
+    for (unsigned int i = 0; i < size; ++i)
+    {
+        float expected = isDerivativeOperandA ? inputDelta[i] + operand[i] * rate : operand[i] + inputDelta[i] * rate;
+        QVERIFY(std::abs(unfused[i] - expected) <= 1.0e-6f * std::max(1.0f, std::abs(expected)));
+        QVERIFY(fused[i] == unfused[i]);
+    }
+}
 
+void FreeWillUnitTest::operatorElementwiseFusionTest()
+{
+    for (bool isDerivativeOperandA : {true, false})
+    {
+        elementwiseFusionTest<FreeWill::ActivationMode::SIGMOID>(isDerivativeOperandA);
+        elementwiseFusionTest<FreeWill::ActivationMode::RELU>(isDerivativeOperandA);
+        elementwiseFusionTest<FreeWill::ActivationMode::TANH>(isDerivativeOperandA);
+        elementwiseFusionTest<FreeWill::ActivationMode::CLIPPED_RELU>(isDerivativeOperandA);
+    }
+}
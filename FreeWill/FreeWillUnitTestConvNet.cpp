@@ -1,10 +1,16 @@
 #include "FreeWillUnitTest.h"
 #include "Operator/Convolution.h"
 #include "Operator/ConvolutionDerivative.h"
+#include "Operator/ConvolutionAlgorithmCache.h"
+#include "Operator/CPUAutotuner.h"
 #include "Operator/Activation.h"
 #include "Operator/CrossEntropyLoss.h"
 #include "Operator/SigmoidCrossEntropyLossDerivative.h"
 #include "Operator/ActivationDerivative.h"
+#include "Operator/LayoutTransform.h"
+#include "Operator/MaxPooling.h"
+#include <cstdio>
+#include <cmath>
 
 
 void FreeWillUnitTest::convolutionTest()
@@ -201,6 +207,329 @@ void FreeWillUnitTest::convolutionTest()
 
 }
 
+void FreeWillUnitTest::convolutionAlgorithmTest()
+{
+    struct Case
+    {
+        unsigned int channelCount, filterCount, filterSize, width, height, stride, zeroPadding, batchSize;
+        FreeWill::ConvolutionAlgorithmCPU algorithm;
+    };
+
+    Case cases[] = {{8, 9, 3, 7, 9, 1, 1, 2, FreeWill::ConvolutionAlgorithmCPU::WINOGRAD_2X2_3X3},
+                    {8, 16, 3, 10, 8, 1, 0, 1, FreeWill::ConvolutionAlgorithmCPU::WINOGRAD_2X2_3X3},
+                    {3, 5, 3, 9, 7, 2, 1, 2, FreeWill::ConvolutionAlgorithmCPU::IM2COL_GEMM},
+                    {1, 4, 5, 12, 12, 1, 0, 3, FreeWill::ConvolutionAlgorithmCPU::IM2COL_GEMM},
+                    {6, 7, 1, 5, 4, 1, 0, 2, FreeWill::ConvolutionAlgorithmCPU::IM2COL_GEMM}};
+
+    for(const Case &c : cases)
+    {
+        unsigned int outputWidth = (c.width - c.filterSize + 2 * c.zeroPadding) / c.stride + 1;
+        unsigned int outputHeight = (c.height - c.filterSize + 2 * c.zeroPadding) / c.stride + 1;
+
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> input({c.channelCount, c.width, c.height, c.batchSize});
+        input.init();
+        input.randomize();
+
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> featureMaps({c.channelCount, c.filterSize, c.filterSize, c.filterCount});
+        featureMaps.init();
+        featureMaps.randomize();
+
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> bias({c.filterCount});
+        bias.init();
+        bias.randomize();
+
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> output({c.filterCount, outputWidth, outputHeight, c.batchSize});
+        output.init();
+        output.randomize();
+
+        std::vector<double> reference(output.shape().size());
+        for(unsigned int i = 0; i < output.shape().size(); ++i)
+        {
+            reference[i] = output[i];
+        }
+
+        FreeWill::Convolution<FreeWill::DeviceType::CPU_NAIVE, double> convolution(c.stride, c.stride, c.zeroPadding, c.zeroPadding);
+        convolution.setInputParameter("Input", &input);
+        convolution.setInputParameter("FeatureMap", &featureMaps);
+        convolution.setInputParameter("Bias", &bias);
+        convolution.setOutputParameter("Output", &output);
+
+        QVERIFY(convolution.init());
+        QVERIFY(convolution.cpuAlgorithm() == c.algorithm);
+
+        convolution.evaluate();
+
+        for(unsigned int b = 0; b < c.batchSize; ++b)
+        {
+            for(unsigned int y = 0; y < outputHeight; ++y)
+            {
+                for(unsigned int x = 0; x < outputWidth; ++x)
+                {
+                    for(unsigned int k = 0; k < c.filterCount; ++k)
+                    {
+                        double sum = bias[k];
+                        for(unsigned int fy = 0; fy < c.filterSize; ++fy)
+                        {
+                            for(unsigned int fx = 0; fx < c.filterSize; ++fx)
+                            {
+                                int realX = (int) (x * c.stride + fx) - (int) c.zeroPadding;
+                                int realY = (int) (y * c.stride + fy) - (int) c.zeroPadding;
+
+                                if (realX < 0 || realX >= (int) c.width || realY < 0 || realY >= (int) c.height)
+                                {
+                                    continue;
+                                }
+
+                                for(unsigned int channel = 0; channel < c.channelCount; ++channel)
+                                {
+                                    sum += featureMaps[((k * c.filterSize + fy) * c.filterSize + fx) * c.channelCount + channel]
+                                            * input[((b * c.height + realY) * c.width + realX) * c.channelCount + channel];
+                                }
+                            }
+                        }
+
+                        reference[((b * outputHeight + y) * outputWidth + x) * c.filterCount + k] += sum;
+                    }
+                }
+            }
+        }
+
+        for(unsigned int i = 0; i < output.shape().size(); ++i)
+        {
+            QVERIFY(relativeError(output[i], reference[i]) < epsilon);
+        }
+    }
+}
+
+void FreeWillUnitTest::channelBlockedConvolutionTest()
+{
+    struct Case
+    {
+        unsigned int channelCount, filterCount, filterSize, width, height, stride, zeroPadding, batchSize;
+    };
+
+    // interior tiles and borders, strided, pointwise and more than one block of channels
+    Case cases[] = {{16, 16, 3, 8, 8, 1, 1, 2},
+                    {32, 16, 3, 13, 7, 2, 1, 1},
+                    {16, 32, 1, 8, 4, 1, 0, 2},
+                    {16, 16, 5, 7, 7, 1, 2, 1}};
+
+    FreeWill::TensorLayout layouts[] = {FreeWill::TensorLayout::CHANNEL_BLOCKED_4, FreeWill::TensorLayout::CHANNEL_BLOCKED_8,
+                                        FreeWill::TensorLayout::CHANNEL_BLOCKED_16};
+
+    for (FreeWill::TensorLayout layout : layouts)
+    {
+        for (const Case &c : cases)
+        {
+            unsigned int outputWidth = (c.width - c.filterSize + 2 * c.zeroPadding) / c.stride + 1;
+            unsigned int outputHeight = (c.height - c.filterSize + 2 * c.zeroPadding) / c.stride + 1;
+
+            FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> input({c.channelCount, c.width, c.height, c.batchSize});
+            input.init();
+            input.randomize();
+
+            FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> featureMaps({c.channelCount, c.filterSize, c.filterSize, c.filterCount});
+            featureMaps.init();
+            featureMaps.randomize();
+
+            FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> bias({c.filterCount});
+            bias.init();
+            bias.randomize();
+
+            FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> output({c.filterCount, outputWidth, outputHeight, c.batchSize});
+            output.init();
+
+            FreeWill::Convolution<FreeWill::DeviceType::CPU_NAIVE, double> convolution(c.stride, c.stride, c.zeroPadding, c.zeroPadding);
+            convolution.setInputParameter("Input", &input);
+            convolution.setInputParameter("FeatureMap", &featureMaps);
+            convolution.setInputParameter("Bias", &bias);
+            convolution.setOutputParameter("Output", &output);
+            convolution.fuseActivation(FreeWill::ActivationMode::RELU);
+            QVERIFY(convolution.init());
+            convolution.evaluate();
+
+            // the same through blocked tensors, the output starts out as garbage it overwrites
+            FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> blockedInput(input.shape());
+            blockedInput.init();
+            blockedInput.setLayout(layout);
+
+            FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> blockedOutput(output.shape());
+            blockedOutput.init();
+            blockedOutput.randomize();
+            blockedOutput.setLayout(layout);
+
+            FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> result(output.shape());
+            result.init();
+
+            FreeWill::LayoutTransform<FreeWill::DeviceType::CPU_NAIVE, double> toBlocked;
+            toBlocked.setInputParameter("Input", &input);
+            toBlocked.setOutputParameter("Output", &blockedInput);
+            QVERIFY(toBlocked.init());
+            toBlocked.evaluate();
+
+            // one channel per block apart
+            unsigned int blockSize = FreeWill::channelBlockSize(layout);
+            QVERIFY(blockedInput[blockSize] == input[c.channelCount]);
+            QVERIFY(c.channelCount == blockSize || blockedInput[c.width * c.height * blockSize] == input[blockSize]);
+
+            FreeWill::Convolution<FreeWill::DeviceType::CPU_NAIVE, double> blockedConvolution(c.stride, c.stride, c.zeroPadding, c.zeroPadding);
+            blockedConvolution.setInputParameter("Input", &blockedInput);
+            blockedConvolution.setInputParameter("FeatureMap", &featureMaps);
+            blockedConvolution.setInputParameter("Bias", &bias);
+            blockedConvolution.setOutputParameter("Output", &blockedOutput);
+            blockedConvolution.fuseActivation(FreeWill::ActivationMode::RELU);
+            QVERIFY(blockedConvolution.init());
+            QVERIFY(blockedConvolution.cpuAlgorithm() == FreeWill::ConvolutionAlgorithmCPU::CHANNEL_BLOCKED_DIRECT);
+            blockedConvolution.evaluate();
+
+            FreeWill::LayoutTransform<FreeWill::DeviceType::CPU_NAIVE, double> fromBlocked;
+            fromBlocked.setInputParameter("Input", &blockedOutput);
+            fromBlocked.setOutputParameter("Output", &result);
+            QVERIFY(fromBlocked.init());
+            fromBlocked.evaluate();
+
+            for (unsigned int i = 0; i < output.shape().size(); ++i)
+            {
+                QVERIFY(std::abs(result[i] - output[i]) < epsilon);
+            }
+
+            // a blocked image pools as channel / block images of block channels
+            if (outputWidth % 2 || outputHeight % 2 || (blockSize * outputWidth / 2) % FreeWill::MAX_POOLING_SWITCHES_PER_WORD)
+            {
+                continue;
+            }
+
+            FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> pooled({c.filterCount, outputWidth / 2, outputHeight / 2, c.batchSize});
+            pooled.init();
+            FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> blockedPooled(pooled.shape());
+            blockedPooled.init();
+            blockedPooled.setLayout(layout);
+            FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, unsigned int> switches(FreeWill::maxPoolingSwitchShape(pooled.shape()));
+            switches.init();
+
+            FreeWill::MaxPooling<FreeWill::DeviceType::CPU_NAIVE, double> maxPooling;
+            maxPooling.setInputParameter("Input", &output);
+            maxPooling.setOutputParameter("Output", &pooled);
+            maxPooling.setOutputParameter("Switch", &switches);
+            QVERIFY(maxPooling.init());
+            maxPooling.evaluate();
+
+            FreeWill::MaxPooling<FreeWill::DeviceType::CPU_NAIVE, double> blockedMaxPooling;
+            blockedMaxPooling.setInputParameter("Input", &blockedOutput);
+            blockedMaxPooling.setOutputParameter("Output", &blockedPooled);
+            blockedMaxPooling.setOutputParameter("Switch", &switches);
+            QVERIFY(blockedMaxPooling.init());
+            blockedMaxPooling.evaluate();
+
+            FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> pooledResult(pooled.shape());
+            pooledResult.init();
+            FreeWill::convertLayoutCPU<double>(layout, FreeWill::TensorLayout::CHANNEL_LAST, blockedPooled.cpuDataHandle(), pooledResult.cpuDataHandle(),
+                                               c.filterCount, outputWidth / 2 * outputHeight / 2, c.batchSize);
+
+            for (unsigned int i = 0; i < pooled.shape().size(); ++i)
+            {
+                QVERIFY(std::abs(pooledResult[i] - pooled[i]) < epsilon);
+            }
+        }
+    }
+
+    // only between CHANNEL_LAST and a blocked layout whose block divides the channels
+    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> odd({6, 2, 2, 1});
+    odd.init();
+    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> oddBlocked({6, 2, 2, 1});
+    oddBlocked.init();
+    oddBlocked.setLayout(FreeWill::TensorLayout::CHANNEL_BLOCKED_4);
+
+    FreeWill::LayoutTransform<FreeWill::DeviceType::CPU_NAIVE, float> oddTransform;
+    oddTransform.setInputParameter("Input", &odd);
+    oddTransform.setOutputParameter("Output", &oddBlocked);
+    QVERIFY(!oddTransform.init());
+}
+
+void FreeWillUnitTest::convolutionKernelSelectionTest()
+{
+    struct Case
+    {
+        unsigned int filterSize, stride, zeroPadding;
+        bool isSpecialized;
+    };
+
+    // every specialization with and without borders, and a generic one
+    Case cases[] = {{1, 1, 0, true}, {1, 2, 0, true}, {3, 1, 1, true}, {3, 2, 1, true},
+                    {5, 1, 2, true}, {5, 2, 0, true}, {5, 1, 0, true}, {7, 1, 3, false}};
+
+    const unsigned int channelCount = 8;
+    const unsigned int filterCount = 8;
+    const unsigned int batchSize = 2;
+
+    // the blocked convolutions below are compared with the baseline ones by address
+    FreeWill::CPUFeatures &cpuFeatures = FreeWill::CPUFeatures::getSingleton();
+    FreeWill::CPUInstructionSet instructionSet = cpuFeatures.instructionSet();
+    cpuFeatures.setInstructionSet(FreeWill::CPUInstructionSet::BASELINE);
+
+    for (const Case &c : cases)
+    {
+        unsigned int size = 4 * c.stride + c.filterSize - 2 * c.zeroPadding;
+
+        FreeWill::ConvolutionGeometryCPU geometry;
+        geometry.channelCount = channelCount;
+        geometry.filterCount = filterCount;
+        geometry.filterSize = c.filterSize;
+        geometry.width = size;
+        geometry.height = size;
+        geometry.outputWidth = (size - c.filterSize + 2 * c.zeroPadding) / c.stride + 1;
+        geometry.outputHeight = geometry.outputWidth;
+        geometry.strideX = c.stride;
+        geometry.strideY = c.stride;
+        geometry.zeroPaddingX = c.zeroPadding;
+        geometry.zeroPaddingY = c.zeroPadding;
+
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> input({channelCount, size, size, batchSize});
+        input.init();
+        input.randomize();
+
+        FreeWill::Im2colFunctionCPU<double> im2col = FreeWill::selectIm2colCPU<double>(geometry);
+        QVERIFY((im2col != FreeWill::im2colCPU<double>) == c.isSpecialized);
+
+        std::vector<double> columns((size_t) geometry.patchSize() * geometry.outputPixelCount(), -1.0);
+        std::vector<double> reference(columns.size(), 1.0);
+        im2col(geometry, input.cpuDataHandle(), columns.data());
+        FreeWill::im2colCPU<double>(geometry, input.cpuDataHandle(), reference.data());
+        QVERIFY(columns == reference);
+
+        // the blocked convolution specialized for the same filter and stride
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> featureMaps({channelCount, c.filterSize, c.filterSize, filterCount});
+        featureMaps.init();
+        featureMaps.randomize();
+
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> bias({filterCount});
+        bias.init();
+        bias.randomize();
+
+        FreeWill::GEMMEpilogueCPU<double> epilogue;
+        epilogue.m_rowBias = bias.cpuDataHandle();
+
+        FreeWill::TensorLayout layout = FreeWill::TensorLayout::CHANNEL_BLOCKED_8;
+        FreeWill::ChannelBlockedConvolutionCPU<double> convolution = FreeWill::selectChannelBlockedConvolutionCPU<double>(layout, geometry);
+        QVERIFY((convolution != FreeWill::ChannelBlockedKernelCPU<double, 8>::convolution<>) == c.isSpecialized);
+
+        size_t outputSize = (size_t) filterCount * geometry.outputPixelCount() * batchSize;
+        std::vector<double> output(outputSize), blockedReference(outputSize), workspace;
+
+        FreeWill::convolutionChannelBlockedCPU<double>(layout, geometry, batchSize, input.cpuDataHandle(), featureMaps.cpuDataHandle(),
+                                                       output.data(), workspace, epilogue, convolution);
+        FreeWill::convolutionChannelBlockedCPU<double>(layout, geometry, batchSize, input.cpuDataHandle(), featureMaps.cpuDataHandle(),
+                                                       blockedReference.data(), workspace, epilogue, FreeWill::ChannelBlockedKernelCPU<double, 8>::convolution<>);
+
+        for (size_t i = 0; i < outputSize; ++i)
+        {
+            QVERIFY(std::abs(output[i] - blockedReference[i]) < epsilon);
+        }
+    }
+
+    cpuFeatures.setInstructionSet(instructionSet);
+}
+
 void FreeWillUnitTest::convolutionTestGPU()
 {
     FreeWill::Tensor<FreeWill::DeviceType::GPU_CUDA, float> input({3,5,5,1});
@@ -325,6 +654,206 @@ void FreeWillUnitTest::convolutionTestGPU()
 
 }
 
+void FreeWillUnitTest::convolutionAlgorithmCacheTestGPU()
+{
+    const std::string cacheFilename = "freewill-test-cudnn-algorithms";
+    std::remove(cacheFilename.c_str());
+
+    FreeWill::ConvolutionAlgorithmCache &algorithmCache = FreeWill::ConvolutionAlgorithmCache::getSingleton();
+    algorithmCache.clear();
+    QVERIFY(algorithmCache.open(cacheFilename));
+
+    FreeWill::Tensor<FreeWill::DeviceType::GPU_CUDA, float> input({3,5,5,1});
+    input.init();
+    FreeWill::Tensor<FreeWill::DeviceType::GPU_CUDA, float> featureMaps({3,3,3,2});
+    featureMaps.init();
+    FreeWill::Tensor<FreeWill::DeviceType::GPU_CUDA, float> output({2,3,3,1});
+    output.init();
+    FreeWill::Tensor<FreeWill::DeviceType::GPU_CUDA, float> bias({2});
+    bias.init();
+
+    // the second operator of the same shape takes the algorithm the first one searched
+    std::string plans[2];
+    for (unsigned int i = 0; i < 2; ++i)
+    {
+        FreeWill::Convolution<FreeWill::DeviceType::GPU_CUDA, float> convolution(2,2,1,1);
+        convolution.setInputParameter("Input", &input);
+        convolution.setInputParameter("FeatureMap", &featureMaps);
+        convolution.setInputParameter("Bias", &bias);
+        convolution.setOutputParameter("Output", &output);
+
+        QVERIFY(convolution.init());
+        QVERIFY(algorithmCache.size() == 1);
+
+        plans[i] = convolution.plan();
+    }
+
+    QVERIFY(plans[0] == plans[1]);
+
+    // another stride is another entry
+    FreeWill::Tensor<FreeWill::DeviceType::GPU_CUDA, float> unpaddedOutput({2,3,3,1});
+    unpaddedOutput.init();
+    FreeWill::Convolution<FreeWill::DeviceType::GPU_CUDA, float> unpaddedConvolution(1,1,0,0);
+    unpaddedConvolution.setInputParameter("Input", &input);
+    unpaddedConvolution.setInputParameter("FeatureMap", &featureMaps);
+    unpaddedConvolution.setInputParameter("Bias", &bias);
+    unpaddedConvolution.setOutputParameter("Output", &unpaddedOutput);
+    QVERIFY(unpaddedConvolution.init());
+    QVERIFY(algorithmCache.size() == 2);
+
+    // the next process reads them from the file
+    algorithmCache.close();
+    algorithmCache.clear();
+    QVERIFY(algorithmCache.open(cacheFilename));
+    QVERIFY(algorithmCache.size() == 2);
+
+    const unsigned int inputShape[4] = {1, 3, 5, 5};
+    const unsigned int filterShape[4] = {2, 3, 3, 3};
+    int algorithm = -1;
+    QVERIFY(algorithmCache.find(algorithmCache.key(FreeWill::ConvolutionAlgorithmCache::Direction::FORWARD, 0, (int) CUDNN_DATA_FLOAT,
+                                                   inputShape, filterShape, 1, 1, 2, 2), algorithm));
+    QVERIFY(std::to_string(algorithm) == plans[0]);
+    QVERIFY(!algorithmCache.find(algorithmCache.key(FreeWill::ConvolutionAlgorithmCache::Direction::BACKWARD_DATA, 0, (int) CUDNN_DATA_FLOAT,
+                                                    inputShape, filterShape, 1, 1, 2, 2), algorithm));
+
+    algorithmCache.close();
+    algorithmCache.clear();
+    std::remove(cacheFilename.c_str());
+}
+
+void FreeWillUnitTest::cpuAutotunerTest()
+{
+    const std::string cacheFilename = "freewill-test-cpu-tuning";
+    std::remove(cacheFilename.c_str());
+
+    FreeWill::CPUAutotuner &autotuner = FreeWill::CPUAutotuner::getSingleton();
+    autotuner.clear();
+    QVERIFY(autotuner.open(cacheFilename));
+
+    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> input({8,6,6,2});
+    input.init();
+    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> featureMaps({8,3,3,8});
+    featureMaps.init();
+    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> output({8,6,6,2});
+    output.init();
+    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> bias({8});
+    bias.init();
+
+    // untimed, the heuristic decides and nothing is cached
+    FreeWill::Convolution<FreeWill::DeviceType::CPU_NAIVE, float> untunedConvolution(1,1,1,1);
+    untunedConvolution.setInputParameter("Input", &input);
+    untunedConvolution.setInputParameter("FeatureMap", &featureMaps);
+    untunedConvolution.setInputParameter("Bias", &bias);
+    untunedConvolution.setOutputParameter("Output", &output);
+    QVERIFY(untunedConvolution.init());
+    QVERIFY(untunedConvolution.cpuAlgorithm() == FreeWill::ConvolutionAlgorithmCPU::WINOGRAD_2X2_3X3);
+    QVERIFY(autotuner.size() == 0);
+
+    // the second operator of the same shape takes the algorithm the first one timed
+    autotuner.setEnabled(true);
+
+    FreeWill::ConvolutionAlgorithmCPU algorithms[2];
+    for (unsigned int i = 0; i < 2; ++i)
+    {
+        FreeWill::Convolution<FreeWill::DeviceType::CPU_NAIVE, float> convolution(1,1,1,1);
+        convolution.setInputParameter("Input", &input);
+        convolution.setInputParameter("FeatureMap", &featureMaps);
+        convolution.setInputParameter("Bias", &bias);
+        convolution.setOutputParameter("Output", &output);
+
+        QVERIFY(convolution.init());
+        QVERIFY(autotuner.size() == 1);
+
+        algorithms[i] = convolution.cpuAlgorithm();
+    }
+
+    QVERIFY(algorithms[0] == algorithms[1]);
+    QVERIFY(algorithms[0] == FreeWill::ConvolutionAlgorithmCPU::IM2COL_GEMM || algorithms[0] == FreeWill::ConvolutionAlgorithmCPU::WINOGRAD_2X2_3X3);
+
+    // the next process reads it from the file, and uses it without timing
+    autotuner.setEnabled(false);
+    autotuner.close();
+    autotuner.clear();
+    QVERIFY(autotuner.open(cacheFilename));
+    QVERIFY(autotuner.size() == 1);
+
+    FreeWill::Convolution<FreeWill::DeviceType::CPU_NAIVE, float> cachedConvolution(1,1,1,1);
+    cachedConvolution.setInputParameter("Input", &input);
+    cachedConvolution.setInputParameter("FeatureMap", &featureMaps);
+    cachedConvolution.setInputParameter("Bias", &bias);
+    cachedConvolution.setOutputParameter("Output", &output);
+    QVERIFY(cachedConvolution.init());
+    QVERIFY(cachedConvolution.cpuAlgorithm() == algorithms[0]);
+
+    int variant = -1;
+    QVERIFY(autotuner.find(autotuner.key("convolution", "8x6x6x2_8_1x1"), variant));
+    QVERIFY(!autotuner.find(autotuner.key("convolution", "8x6x6x2_8_0x0"), variant));
+
+    autotuner.close();
+    autotuner.clear();
+    std::remove(cacheFilename.c_str());
+}
+
+void FreeWillUnitTest::convolutionWorkspaceTestGPU()
+{
+    FreeWill::Context<FreeWill::DeviceType::GPU_CUDA> &context = FreeWill::Context<FreeWill::DeviceType::GPU_CUDA>::getSingleton();
+
+    // the workspace only grows, a smaller reservation keeps it where it is
+    size_t workspaceSize = context.workspaceSize(0) + 1024;
+    context.reserveWorkspace(0, workspaceSize);
+    void *workspace = context.workspace(0);
+    QVERIFY(workspace);
+    QVERIFY(context.workspaceSize(0) == workspaceSize);
+
+    context.reserveWorkspace(0, 16);
+    QVERIFY(context.workspace(0) == workspace);
+    QVERIFY(context.workspaceSize(0) == workspaceSize);
+
+    // an algorithm searched under the limit fits the workspace already there
+    FreeWill::ConvolutionAlgorithmCache &algorithmCache = FreeWill::ConvolutionAlgorithmCache::getSingleton();
+    algorithmCache.setWorkspaceLimit(workspaceSize);
+
+    FreeWill::Tensor<FreeWill::DeviceType::GPU_CUDA, float> input({3,5,5,1});
+    input.init();
+    FreeWill::Tensor<FreeWill::DeviceType::GPU_CUDA, float> featureMaps({3,3,3,2});
+    featureMaps.init();
+    FreeWill::Tensor<FreeWill::DeviceType::GPU_CUDA, float> output({2,3,3,1});
+    output.init();
+    FreeWill::Tensor<FreeWill::DeviceType::GPU_CUDA, float> bias({2});
+    bias.init();
+    FreeWill::Tensor<FreeWill::DeviceType::GPU_CUDA, float> featureMapGrad({3,3,3,2});
+    featureMapGrad.init();
+    FreeWill::Tensor<FreeWill::DeviceType::GPU_CUDA, float> biasGrad({2});
+    biasGrad.init();
+    FreeWill::Tensor<FreeWill::DeviceType::GPU_CUDA, float> inputGrad({3,5,5,1});
+    inputGrad.init();
+
+    FreeWill::Convolution<FreeWill::DeviceType::GPU_CUDA, float> convolution(2,2,1,1);
+    convolution.setInputParameter("Input", &input);
+    convolution.setInputParameter("FeatureMap", &featureMaps);
+    convolution.setInputParameter("Bias", &bias);
+    convolution.setOutputParameter("Output", &output);
+    QVERIFY(convolution.init());
+
+    FreeWill::ConvolutionDerivative<FreeWill::DeviceType::GPU_CUDA, float> convolutionDerivative(2,2,1,1);
+    convolutionDerivative.setInputParameter("PrevActivation", &input);
+    convolutionDerivative.setInputParameter("FeatureMap", &featureMaps);
+    convolutionDerivative.setInputParameter("OutputGrad", &output);
+    convolutionDerivative.setOutputParameter("FeatureMapGrad", &featureMapGrad);
+    convolutionDerivative.setOutputParameter("BiasGrad", &biasGrad);
+    convolutionDerivative.setOutputParameter("InputGrad", &inputGrad);
+    QVERIFY(convolutionDerivative.init());
+
+    QVERIFY(context.workspace(0) == workspace);
+    QVERIFY(context.workspaceSize(0) == workspaceSize);
+
+    convolution.evaluate();
+    convolutionDerivative.evaluate();
+    QVERIFY(cudaDeviceSynchronize() == cudaSuccess);
+
+    algorithmCache.setWorkspaceLimit(0);
+}
+
 void FreeWillUnitTest::convolutionDerivativeTest()
 {
     FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> prevActivaion({3,5,5,1});
@@ -548,6 +1077,132 @@ void FreeWillUnitTest::convolutionDerivativeTest()
    } 
 }
 
+void FreeWillUnitTest::convolutionDerivativeLoweringTest()
+{
+    struct Case
+    {
+        unsigned int channelCount, filterCount, filterSize, width, height, stride, zeroPadding, batchSize;
+    };
+
+    Case cases[] = {{8, 9, 3, 7, 9, 1, 1, 2},
+                    {3, 5, 3, 9, 7, 2, 1, 2},
+                    {6, 7, 1, 5, 4, 1, 0, 2}};
+
+    for(const Case &c : cases)
+    {
+        unsigned int outputWidth = (c.width - c.filterSize + 2 * c.zeroPadding) / c.stride + 1;
+        unsigned int outputHeight = (c.height - c.filterSize + 2 * c.zeroPadding) / c.stride + 1;
+
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> prevActivation({c.channelCount, c.width, c.height, c.batchSize});
+        prevActivation.init();
+        prevActivation.randomize();
+
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> featureMaps({c.channelCount, c.filterSize, c.filterSize, c.filterCount});
+        featureMaps.init();
+        featureMaps.randomize();
+
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> outputGrad({c.filterCount, outputWidth, outputHeight, c.batchSize});
+        outputGrad.init();
+        outputGrad.randomize();
+
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> inputGrad({c.channelCount, c.width, c.height, c.batchSize});
+        inputGrad.init();
+        inputGrad.randomize();
+
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> featureMapGrad({c.channelCount, c.filterSize, c.filterSize, c.filterCount});
+        featureMapGrad.init();
+        featureMapGrad.randomize();
+
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> biasGrad({c.filterCount});
+        biasGrad.init();
+        biasGrad.randomize();
+
+        std::vector<double> inputGradReference(inputGrad.shape().size());
+        std::vector<double> featureMapGradReference(featureMapGrad.shape().size());
+        std::vector<double> biasGradReference(biasGrad.shape().size());
+
+        for(unsigned int i = 0; i < inputGrad.shape().size(); ++i)
+        {
+            inputGradReference[i] = inputGrad[i];
+        }
+
+        for(unsigned int i = 0; i < featureMapGrad.shape().size(); ++i)
+        {
+            featureMapGradReference[i] = featureMapGrad[i];
+        }
+
+        for(unsigned int i = 0; i < biasGrad.shape().size(); ++i)
+        {
+            biasGradReference[i] = biasGrad[i];
+        }
+
+        FreeWill::ConvolutionDerivative<FreeWill::DeviceType::CPU_NAIVE, double> convolutionDerivative(c.stride, c.stride, c.zeroPadding, c.zeroPadding);
+        convolutionDerivative.setInputParameter("PrevActivation", &prevActivation);
+        convolutionDerivative.setInputParameter("FeatureMap", &featureMaps);
+        convolutionDerivative.setInputParameter("OutputGrad", &outputGrad);
+        convolutionDerivative.setOutputParameter("InputGrad", &inputGrad);
+        convolutionDerivative.setOutputParameter("FeatureMapGrad", &featureMapGrad);
+        convolutionDerivative.setOutputParameter("BiasGrad", &biasGrad);
+
+        QVERIFY(convolutionDerivative.init());
+
+        convolutionDerivative.evaluate();
+
+        for(unsigned int b = 0; b < c.batchSize; ++b)
+        {
+            for(unsigned int y = 0; y < outputHeight; ++y)
+            {
+                for(unsigned int x = 0; x < outputWidth; ++x)
+                {
+                    for(unsigned int k = 0; k < c.filterCount; ++k)
+                    {
+                        double grad = outputGrad[((b * outputHeight + y) * outputWidth + x) * c.filterCount + k];
+                        biasGradReference[k] += grad;
+
+                        for(unsigned int fy = 0; fy < c.filterSize; ++fy)
+                        {
+                            for(unsigned int fx = 0; fx < c.filterSize; ++fx)
+                            {
+                                int realX = (int) (x * c.stride + fx) - (int) c.zeroPadding;
+                                int realY = (int) (y * c.stride + fy) - (int) c.zeroPadding;
+
+                                if (realX < 0 || realX >= (int) c.width || realY < 0 || realY >= (int) c.height)
+                                {
+                                    continue;
+                                }
+
+                                for(unsigned int channel = 0; channel < c.channelCount; ++channel)
+                                {
+                                    unsigned int filterIndex = ((k * c.filterSize + fy) * c.filterSize + fx) * c.channelCount + channel;
+                                    unsigned int imageIndex = ((b * c.height + realY) * c.width + realX) * c.channelCount + channel;
+
+                                    featureMapGradReference[filterIndex] += grad * prevActivation[imageIndex];
+                                    inputGradReference[imageIndex] += grad * featureMaps[filterIndex];
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        for(unsigned int i = 0; i < inputGrad.shape().size(); ++i)
+        {
+            QVERIFY(relativeError(inputGrad[i], inputGradReference[i]) < epsilon);
+        }
+
+        for(unsigned int i = 0; i < featureMapGrad.shape().size(); ++i)
+        {
+            QVERIFY(relativeError(featureMapGrad[i], featureMapGradReference[i]) < epsilon);
+        }
+
+        for(unsigned int i = 0; i < biasGrad.shape().size(); ++i)
+        {
+            QVERIFY(relativeError(biasGrad[i], biasGradReference[i]) < epsilon);
+        }
+    }
+}
+
 void FreeWillUnitTest::convolutionDerivativeTestGPU()
 {
     FreeWill::Tensor<FreeWill::DeviceType::GPU_CUDA, float> prevActivaion({3,5,5,1});
@@ -671,3 +1326,366 @@ void FreeWillUnitTest::convolutionDerivativeTestGPU()
         QVERIFY(std::abs(inputGrad[i] - inputGradCPU[i]) < epsilon);
     }
 }
+
+// the filters of a grouped convolution as those of a dense one, zero across groups
+static void expandGroupedFeatureMap(FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> &grouped,
+                                    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> &dense, unsigned int groupCount)
+{
+    unsigned int groupChannelCount = grouped.shape()[0];
+    unsigned int channelCount = dense.shape()[0];
+    unsigned int windowSize = grouped.shape()[1] * grouped.shape()[2];
+    unsigned int filterCount = grouped.shape()[3];
+    unsigned int groupFilterCount = filterCount / groupCount;
+
+    dense.clear();
+
+    for(unsigned int f = 0; f < filterCount; ++f)
+    {
+        unsigned int firstChannel = (f / groupFilterCount) * groupChannelCount;
+
+        for(unsigned int w = 0; w < windowSize; ++w)
+        {
+            for(unsigned int c = 0; c < groupChannelCount; ++c)
+            {
+                dense[((size_t) f * windowSize + w) * channelCount + firstChannel + c] = grouped[((size_t) f * windowSize + w) * groupChannelCount + c];
+            }
+        }
+    }
+}
+
+void FreeWillUnitTest::groupedConvolutionTest()
+{
+    struct Case
+    {
+        unsigned int channelCount, filterCount, groupCount, filterSize, width, height, stride, zeroPadding, batchSize;
+        bool hasActivation;
+        FreeWill::ConvolutionAlgorithmCPU algorithm;
+    };
+
+    Case cases[] = {{8, 12, 4, 3, 7, 6, 1, 1, 2, false, FreeWill::ConvolutionAlgorithmCPU::GROUPED_IM2COL_GEMM},
+                    {8, 8, 2, 1, 5, 4, 1, 0, 2, true, FreeWill::ConvolutionAlgorithmCPU::GROUPED_IM2COL_GEMM},
+                    {6, 12, 6, 3, 7, 7, 1, 1, 2, false, FreeWill::ConvolutionAlgorithmCPU::DEPTHWISE_DIRECT},
+                    {16, 16, 16, 3, 9, 9, 2, 1, 3, true, FreeWill::ConvolutionAlgorithmCPU::DEPTHWISE_DIRECT},
+                    {12, 12, 12, 5, 8, 6, 1, 2, 2, false, FreeWill::ConvolutionAlgorithmCPU::DEPTHWISE_DIRECT},
+                    {5, 5, 5, 4, 8, 8, 1, 0, 1, false, FreeWill::ConvolutionAlgorithmCPU::DEPTHWISE_DIRECT}};
+
+    for(const Case &c : cases)
+    {
+        unsigned int outputWidth = (c.width - c.filterSize + 2 * c.zeroPadding) / c.stride + 1;
+        unsigned int outputHeight = (c.height - c.filterSize + 2 * c.zeroPadding) / c.stride + 1;
+        unsigned int groupChannelCount = c.channelCount / c.groupCount;
+
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> input({c.channelCount, c.width, c.height, c.batchSize});
+        input.init();
+        input.randomize();
+
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> featureMap({groupChannelCount, c.filterSize, c.filterSize, c.filterCount});
+        featureMap.init();
+        featureMap.randomize();
+
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> denseFeatureMap({c.channelCount, c.filterSize, c.filterSize, c.filterCount});
+        denseFeatureMap.init();
+        expandGroupedFeatureMap(featureMap, denseFeatureMap, c.groupCount);
+
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> bias({c.filterCount});
+        bias.init();
+        bias.randomize();
+
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> output({c.filterCount, outputWidth, outputHeight, c.batchSize});
+        output.init();
+
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> denseOutput({c.filterCount, outputWidth, outputHeight, c.batchSize});
+        denseOutput.init();
+
+        FreeWill::Convolution<FreeWill::DeviceType::CPU_NAIVE, double> convolution(c.stride, c.stride, c.zeroPadding, c.zeroPadding);
+        convolution.setGroupCount(c.groupCount);
+        convolution.setInputParameter("Input", &input);
+        convolution.setInputParameter("FeatureMap", &featureMap);
+        convolution.setInputParameter("Bias", &bias);
+        convolution.setOutputParameter("Output", &output);
+
+        FreeWill::Convolution<FreeWill::DeviceType::CPU_NAIVE, double> denseConvolution(c.stride, c.stride, c.zeroPadding, c.zeroPadding);
+        denseConvolution.setInputParameter("Input", &input);
+        denseConvolution.setInputParameter("FeatureMap", &denseFeatureMap);
+        denseConvolution.setInputParameter("Bias", &bias);
+        denseConvolution.setOutputParameter("Output", &denseOutput);
+
+        if (c.hasActivation)
+        {
+            convolution.fuseActivation(FreeWill::ActivationMode::RELU);
+            denseConvolution.fuseActivation(FreeWill::ActivationMode::RELU);
+        }
+
+        QVERIFY(convolution.init());
+        QVERIFY(convolution.cpuAlgorithm() == c.algorithm);
+        QVERIFY(denseConvolution.init());
+
+        convolution.evaluate();
+        denseConvolution.evaluate();
+
+        for(unsigned int i = 0; i < output.shape().size(); ++i)
+        {
+            QVERIFY(relativeError(output[i], denseOutput[i]) < epsilon);
+        }
+
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> outputGrad({c.filterCount, outputWidth, outputHeight, c.batchSize});
+        outputGrad.init();
+        outputGrad.randomize();
+
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> inputGrad({c.channelCount, c.width, c.height, c.batchSize});
+        inputGrad.init();
+
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> denseInputGrad({c.channelCount, c.width, c.height, c.batchSize});
+        denseInputGrad.init();
+
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> featureMapGrad({groupChannelCount, c.filterSize, c.filterSize, c.filterCount});
+        featureMapGrad.init();
+
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> denseFeatureMapGrad({c.channelCount, c.filterSize, c.filterSize, c.filterCount});
+        denseFeatureMapGrad.init();
+
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> biasGrad({c.filterCount});
+        biasGrad.init();
+
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> denseBiasGrad({c.filterCount});
+        denseBiasGrad.init();
+
+        FreeWill::ConvolutionDerivative<FreeWill::DeviceType::CPU_NAIVE, double> convolutionDerivative(c.stride, c.stride, c.zeroPadding, c.zeroPadding);
+        convolutionDerivative.setGroupCount(c.groupCount);
+        convolutionDerivative.setInputParameter("PrevActivation", &input);
+        convolutionDerivative.setInputParameter("FeatureMap", &featureMap);
+        convolutionDerivative.setInputParameter("OutputGrad", &outputGrad);
+        convolutionDerivative.setOutputParameter("InputGrad", &inputGrad);
+        convolutionDerivative.setOutputParameter("FeatureMapGrad", &featureMapGrad);
+        convolutionDerivative.setOutputParameter("BiasGrad", &biasGrad);
+
+        FreeWill::ConvolutionDerivative<FreeWill::DeviceType::CPU_NAIVE, double> denseConvolutionDerivative(c.stride, c.stride, c.zeroPadding, c.zeroPadding);
+        denseConvolutionDerivative.setInputParameter("PrevActivation", &input);
+        denseConvolutionDerivative.setInputParameter("FeatureMap", &denseFeatureMap);
+        denseConvolutionDerivative.setInputParameter("OutputGrad", &outputGrad);
+        denseConvolutionDerivative.setOutputParameter("InputGrad", &denseInputGrad);
+        denseConvolutionDerivative.setOutputParameter("FeatureMapGrad", &denseFeatureMapGrad);
+        denseConvolutionDerivative.setOutputParameter("BiasGrad", &denseBiasGrad);
+
+        QVERIFY(convolutionDerivative.init());
+        QVERIFY(denseConvolutionDerivative.init());
+
+        convolutionDerivative.evaluate();
+        denseConvolutionDerivative.evaluate();
+
+        for(unsigned int i = 0; i < inputGrad.shape().size(); ++i)
+        {
+            QVERIFY(relativeError(inputGrad[i], denseInputGrad[i]) < epsilon);
+        }
+
+        for(unsigned int i = 0; i < biasGrad.shape().size(); ++i)
+        {
+            QVERIFY(relativeError(biasGrad[i], denseBiasGrad[i]) < epsilon);
+        }
+
+        // the dense gradient across groups is not the grouped convolution's
+        unsigned int windowSize = c.filterSize * c.filterSize;
+        unsigned int groupFilterCount = c.filterCount / c.groupCount;
+
+        for(unsigned int f = 0; f < c.filterCount; ++f)
+        {
+            unsigned int firstChannel = (f / groupFilterCount) * groupChannelCount;
+
+            for(unsigned int w = 0; w < windowSize; ++w)
+            {
+                for(unsigned int channel = 0; channel < groupChannelCount; ++channel)
+                {
+                    QVERIFY(relativeError(featureMapGrad[(f * windowSize + w) * groupChannelCount + channel],
+                                          denseFeatureMapGrad[(f * windowSize + w) * c.channelCount + firstChannel + channel]) < epsilon);
+                }
+            }
+        }
+    }
+
+    // the groups have to divide the channels and the filters
+    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> input({6, 5, 5, 1});
+    input.init();
+
+    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> featureMap({2, 3, 3, 4});
+    featureMap.init();
+
+    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> bias({4});
+    bias.init();
+
+    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> output({4, 3, 3, 1});
+    output.init();
+
+    FreeWill::Convolution<FreeWill::DeviceType::CPU_NAIVE, double> convolution;
+    convolution.setGroupCount(3);
+    convolution.setInputParameter("Input", &input);
+    convolution.setInputParameter("FeatureMap", &featureMap);
+    convolution.setInputParameter("Bias", &bias);
+    convolution.setOutputParameter("Output", &output);
+
+    QVERIFY(!convolution.init());
+}
+
+void FreeWillUnitTest::groupedConvolutionTestGPU()
+{
+    struct Case
+    {
+        unsigned int channelCount, filterCount, groupCount, filterSize, width, stride, zeroPadding, batchSize;
+    };
+
+    Case cases[] = {{8, 12, 4, 3, 7, 1, 1, 2},
+                    {16, 32, 16, 3, 9, 2, 1, 2}};
+
+    for(const Case &c : cases)
+    {
+        unsigned int outputWidth = (c.width - c.filterSize + 2 * c.zeroPadding) / c.stride + 1;
+        unsigned int groupChannelCount = c.channelCount / c.groupCount;
+
+        const FreeWill::Shape inputShape({c.channelCount, c.width, c.width, c.batchSize});
+        const FreeWill::Shape featureMapShape({groupChannelCount, c.filterSize, c.filterSize, c.filterCount});
+        const FreeWill::Shape outputShape({c.filterCount, outputWidth, outputWidth, c.batchSize});
+
+        FreeWill::Tensor<FreeWill::DeviceType::GPU_CUDA, float> input(inputShape);
+        input.init();
+        input.randomize();
+
+        FreeWill::Tensor<FreeWill::DeviceType::GPU_CUDA, float> featureMap(featureMapShape);
+        featureMap.init();
+        featureMap.randomize();
+
+        FreeWill::Tensor<FreeWill::DeviceType::GPU_CUDA, float> bias({c.filterCount});
+        bias.init();
+        bias.randomize();
+
+        FreeWill::Tensor<FreeWill::DeviceType::GPU_CUDA, float> output(outputShape);
+        output.init();
+
+        FreeWill::Tensor<FreeWill::DeviceType::GPU_CUDA, float> outputGrad(outputShape);
+        outputGrad.init();
+        outputGrad.randomize();
+
+        FreeWill::Tensor<FreeWill::DeviceType::GPU_CUDA, float> inputGrad(inputShape);
+        inputGrad.init();
+
+        FreeWill::Tensor<FreeWill::DeviceType::GPU_CUDA, float> featureMapGrad(featureMapShape);
+        featureMapGrad.init();
+
+        FreeWill::Tensor<FreeWill::DeviceType::GPU_CUDA, float> biasGrad({c.filterCount});
+        biasGrad.init();
+
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> inputCPU(inputShape);
+        inputCPU.init();
+
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> featureMapCPU(featureMapShape);
+        featureMapCPU.init();
+
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> biasCPU({c.filterCount});
+        biasCPU.init();
+
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> outputCPU(outputShape);
+        outputCPU.init();
+
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> outputGradCPU(outputShape);
+        outputGradCPU.init();
+
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> inputGradCPU(inputShape);
+        inputGradCPU.init();
+
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> featureMapGradCPU(featureMapShape);
+        featureMapGradCPU.init();
+
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> biasGradCPU({c.filterCount});
+        biasGradCPU.init();
+
+        for(unsigned int i = 0; i < inputShape.size(); ++i)
+        {
+            inputCPU[i] = input[i];
+        }
+
+        for(unsigned int i = 0; i < featureMapShape.size(); ++i)
+        {
+            featureMapCPU[i] = featureMap[i];
+        }
+
+        for(unsigned int i = 0; i < c.filterCount; ++i)
+        {
+            biasCPU[i] = bias[i];
+        }
+
+        for(unsigned int i = 0; i < outputShape.size(); ++i)
+        {
+            outputGradCPU[i] = outputGrad[i];
+        }
+
+        input.copyFromHostToDevice();
+        featureMap.copyFromHostToDevice();
+        bias.copyFromHostToDevice();
+        outputGrad.copyFromHostToDevice();
+
+        FreeWill::Convolution<FreeWill::DeviceType::GPU_CUDA, float> convolution(c.stride, c.stride, c.zeroPadding, c.zeroPadding);
+        convolution.setGroupCount(c.groupCount);
+        convolution.setInputParameter("Input", &input);
+        convolution.setInputParameter("FeatureMap", &featureMap);
+        convolution.setInputParameter("Bias", &bias);
+        convolution.setOutputParameter("Output", &output);
+
+        FreeWill::Convolution<FreeWill::DeviceType::CPU_NAIVE, float> convolutionCPU(c.stride, c.stride, c.zeroPadding, c.zeroPadding);
+        convolutionCPU.setGroupCount(c.groupCount);
+        convolutionCPU.setInputParameter("Input", &inputCPU);
+        convolutionCPU.setInputParameter("FeatureMap", &featureMapCPU);
+        convolutionCPU.setInputParameter("Bias", &biasCPU);
+        convolutionCPU.setOutputParameter("Output", &outputCPU);
+
+        FreeWill::ConvolutionDerivative<FreeWill::DeviceType::GPU_CUDA, float> convolutionDerivative(c.stride, c.stride, c.zeroPadding, c.zeroPadding);
+        convolutionDerivative.setGroupCount(c.groupCount);
+        convolutionDerivative.setInputParameter("PrevActivation", &input);
+        convolutionDerivative.setInputParameter("FeatureMap", &featureMap);
+        convolutionDerivative.setInputParameter("OutputGrad", &outputGrad);
+        convolutionDerivative.setOutputParameter("InputGrad", &inputGrad);
+        convolutionDerivative.setOutputParameter("FeatureMapGrad", &featureMapGrad);
+        convolutionDerivative.setOutputParameter("BiasGrad", &biasGrad);
+
+        FreeWill::ConvolutionDerivative<FreeWill::DeviceType::CPU_NAIVE, float> convolutionDerivativeCPU(c.stride, c.stride, c.zeroPadding, c.zeroPadding);
+        convolutionDerivativeCPU.setGroupCount(c.groupCount);
+        convolutionDerivativeCPU.setInputParameter("PrevActivation", &inputCPU);
+        convolutionDerivativeCPU.setInputParameter("FeatureMap", &featureMapCPU);
+        convolutionDerivativeCPU.setInputParameter("OutputGrad", &outputGradCPU);
+        convolutionDerivativeCPU.setOutputParameter("InputGrad", &inputGradCPU);
+        convolutionDerivativeCPU.setOutputParameter("FeatureMapGrad", &featureMapGradCPU);
+        convolutionDerivativeCPU.setOutputParameter("BiasGrad", &biasGradCPU);
+
+        QVERIFY(convolution.init());
+        QVERIFY(convolutionCPU.init());
+        QVERIFY(convolutionDerivative.init());
+        QVERIFY(convolutionDerivativeCPU.init());
+
+        convolution.evaluate();
+        convolutionCPU.evaluate();
+        convolutionDerivative.evaluate();
+        convolutionDerivativeCPU.evaluate();
+
+        output.copyFromDeviceToHost();
+        inputGrad.copyFromDeviceToHost();
+        featureMapGrad.copyFromDeviceToHost();
+        biasGrad.copyFromDeviceToHost();
+
+        for(unsigned int i = 0; i < outputShape.size(); ++i)
+        {
+            QVERIFY(std::abs(output[i] - outputCPU[i]) < 1e-3);
+        }
+
+        for(unsigned int i = 0; i < inputShape.size(); ++i)
+        {
+            QVERIFY(std::abs(inputGrad[i] - inputGradCPU[i]) < 1e-3);
+        }
+
+        for(unsigned int i = 0; i < featureMapShape.size(); ++i)
+        {
+            QVERIFY(std::abs(featureMapGrad[i] - featureMapGradCPU[i]) < 1e-3);
+        }
+
+        for(unsigned int i = 0; i < c.filterCount; ++i)
+        {
+            QVERIFY(std::abs(biasGrad[i] - biasGradCPU[i]) < 1e-3);
+        }
+    }
+}
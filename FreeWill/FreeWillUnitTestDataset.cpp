@@ -0,0 +1,492 @@
+#include "FreeWillUnitTest.h"
+#include "Dataset/IDXFile.h"
+#include "Dataset/BatchLoader.h"
+#include "Dataset/RecordDataset.h"
+#include "Context/ThreadPool.h"
+#include <algorithm>
+#include <cstdio>
+#include <unistd.h>
+
+static void writeIDXFile(const std::string &filename, const std::vector<unsigned int> &dimensions, const std::vector<unsigned char> &data)
+{
+    FILE *file = fopen(filename.c_str(), "wb");
+
+    unsigned char magic[4] = {0, 0, 0x08, (unsigned char) dimensions.size()};
+    fwrite(magic, 1, 4, file);
+
+    for (unsigned int dimension : dimensions)
+    {
+        unsigned char bytes[4] = {(unsigned char) (dimension >> 24), (unsigned char) (dimension >> 16),
+                                  (unsigned char) (dimension >> 8), (unsigned char) dimension};
+        fwrite(bytes, 1, 4, file);
+    }
+
+    fwrite(data.data(), 1, data.size(), file);
+    fclose(file);
+}
+
+void FreeWillUnitTest::batchLoaderTest()
+{
+    const unsigned int imageCount = 7;
+    const unsigned int batchSize = 3;
+
+    std::string imageFilename = "freewill-test-images-idx3-ubyte";
+    std::string labelFilename = "freewill-test-labels-idx1-ubyte";
+
+    std::vector<unsigned char> images(imageCount * 2 * 3);
+    for (unsigned int i = 0; i < images.size(); ++i)
+    {
+        images[i] = (i * 37) % 256;
+    }
+
+    std::vector<unsigned char> labels(imageCount);
+    for (unsigned int i = 0; i < imageCount; ++i)
+    {
+        labels[i] = i % 10;
+    }
+
+    writeIDXFile(imageFilename, {imageCount, 2, 3}, images);
+    writeIDXFile(labelFilename, {imageCount}, labels);
+
+    FreeWill::IDXFile imageFile;
+    FreeWill::IDXFile labelFile;
+
+    QVERIFY(!imageFile.open(imageFilename + ".missing"));
+    QVERIFY(imageFile.open(imageFilename));
+    QVERIFY(labelFile.open(labelFilename));
+
+    QVERIFY(imageFile.itemCount() == imageCount);
+    QVERIFY(imageFile.itemSize() == 6);
+    QVERIFY(imageFile.dimensions().size() == 3 && imageFile.dimensions()[2] == 3);
+    QVERIFY(labelFile.itemSize() == 1);
+    QVERIFY(imageFile.item(1)[0] == images[6]);
+
+    FreeWill::BatchLoader loader(&imageFile, &labelFile, batchSize, 2);
+    QVERIFY(loader.start());
+
+    // two epochs of 3 + 3 + 1 images
+    unsigned int item = 0;
+    for (unsigned int b = 0; b < 6; ++b)
+    {
+        const FreeWill::BatchLoader::Batch *batch = loader.acquire();
+        QVERIFY(batch);
+        QVERIFY(!loader.tryAcquire());
+
+        unsigned int expectedSize = (b % 3 == 2) ? 1 : batchSize;
+        QVERIFY(batch->m_size == expectedSize);
+        QVERIFY(batch->m_epoch == b / 3);
+
+        for (unsigned int i = 0; i < batchSize; ++i)
+        {
+            for (unsigned int p = 0; p < 6; ++p)
+            {
+                float expected = i < batch->m_size ? images[(item + i) * 6 + p] * (1.0f / 255.0f) : 0.0f;
+                QVERIFY(batch->m_inputs[i * 6 + p] == expected);
+            }
+
+            QVERIFY(batch->m_labels[i] == (i < batch->m_size ? labels[item + i] : 0u));
+        }
+
+        item = (item + batch->m_size) % imageCount;
+        loader.release();
+    }
+
+    loader.stop();
+    QVERIFY(!loader.acquire());
+
+    imageFile.close();
+    labelFile.close();
+
+    std::remove(imageFilename.c_str());
+    std::remove(labelFilename.c_str());
+}
+
+void FreeWillUnitTest::batchLoaderAugmentationTest()
+{
+    const unsigned int imageCount = 9;
+    const unsigned int rows = 4;
+    const unsigned int columns = 5;
+    const unsigned int batchSize = 4;
+
+    std::string imageFilename = "freewill-test-augmentation-images-idx3-ubyte";
+    std::string labelFilename = "freewill-test-augmentation-labels-idx1-ubyte";
+
+    std::vector<unsigned char> images(imageCount * rows * columns);
+    for (unsigned int i = 0; i < images.size(); ++i)
+    {
+        images[i] = 1 + (i * 29) % 250;
+    }
+
+    // the label of an image is its index
+    std::vector<unsigned char> labels(imageCount);
+    for (unsigned int i = 0; i < imageCount; ++i)
+    {
+        labels[i] = i;
+    }
+
+    writeIDXFile(imageFilename, {imageCount, rows, columns}, images);
+    writeIDXFile(labelFilename, {imageCount}, labels);
+
+    FreeWill::IDXFile imageFile;
+    FreeWill::IDXFile labelFile;
+    QVERIFY(imageFile.open(imageFilename));
+    QVERIFY(labelFile.open(labelFilename));
+
+    FreeWill::AugmentationParameters augmentation;
+    augmentation.m_isShuffling = true;
+    augmentation.m_maxShift = 1;
+    augmentation.m_seed = 7;
+
+    std::vector<unsigned int> orders[2];
+
+    FreeWill::ThreadPool::getSingleton().open(2);
+
+    for (unsigned int run = 0; run < 2; ++run)
+    {
+        FreeWill::BatchLoader loader(&imageFile, &labelFile, batchSize);
+        loader.setAugmentation(augmentation);
+        loader.setPinned(true);
+        QVERIFY(loader.start());
+
+        // two epochs of 4 + 4 + 1 images
+        for (unsigned int b = 0; b < 6; ++b)
+        {
+            const FreeWill::BatchLoader::Batch *batch = loader.acquire();
+            QVERIFY(batch);
+
+            for (unsigned int i = 0; i < batch->m_size; ++i)
+            {
+                unsigned int index = batch->m_labels[i];
+                orders[run].push_back(index);
+
+                // some whole pixel shift of the image, zero where it moved in
+                bool isShifted = false;
+                for (int shiftY = -1; shiftY <= 1 && !isShifted; ++shiftY)
+                {
+                    for (int shiftX = -1; shiftX <= 1 && !isShifted; ++shiftX)
+                    {
+                        isShifted = true;
+                        for (int y = 0; y < (int) rows && isShifted; ++y)
+                        {
+                            for (int x = 0; x < (int) columns && isShifted; ++x)
+                            {
+                                int sourceX = x - shiftX;
+                                int sourceY = y - shiftY;
+                                float expected = (sourceX < 0 || sourceY < 0 || sourceX >= (int) columns || sourceY >= (int) rows) ? 0.0f :
+                                                 images[index * rows * columns + sourceY * columns + sourceX] * (1.0f / 255.0f);
+                                isShifted = batch->m_inputs[i * rows * columns + y * columns + x] == expected;
+                            }
+                        }
+                    }
+                }
+
+                QVERIFY(isShifted);
+            }
+
+            loader.release();
+        }
+    }
+
+    FreeWill::ThreadPool::getSingleton().close();
+
+    // every image once per epoch, in a new order each epoch, the same order for the same seed
+    QVERIFY(orders[0].size() == 2 * imageCount);
+    QVERIFY(orders[0] == orders[1]);
+
+    std::vector<unsigned int> firstEpoch(orders[0].begin(), orders[0].begin() + imageCount);
+    std::vector<unsigned int> secondEpoch(orders[0].begin() + imageCount, orders[0].end());
+    QVERIFY(firstEpoch != secondEpoch);
+
+    std::sort(firstEpoch.begin(), firstEpoch.end());
+    std::sort(secondEpoch.begin(), secondEpoch.end());
+    for (unsigned int i = 0; i < imageCount; ++i)
+    {
+        QVERIFY(firstEpoch[i] == i && secondEpoch[i] == i);
+    }
+
+    // a raw loader serves the bytes of the same shuffled order, the shift is skipped
+    {
+        FreeWill::BatchLoader loader(&imageFile, &labelFile, batchSize);
+        loader.setAugmentation(augmentation);
+        loader.setRaw(true);
+        QVERIFY(loader.start());
+
+        for (unsigned int b = 0; b < 3; ++b)
+        {
+            const FreeWill::BatchLoader::Batch *batch = loader.acquire();
+            QVERIFY(batch && batch->m_rawInputs && !batch->m_inputs);
+
+            for (unsigned int i = 0; i < batchSize; ++i)
+            {
+                bool isPadding = i >= batch->m_size;
+                unsigned int index = isPadding ? 0 : orders[0][b * batchSize + i];
+
+                QVERIFY(batch->m_rawLabels[i] == (isPadding ? 0 : index));
+                for (unsigned int p = 0; p < rows * columns; ++p)
+                {
+                    QVERIFY(batch->m_rawInputs[i * rows * columns + p] == (isPadding ? 0 : images[index * rows * columns + p]));
+                }
+            }
+
+            loader.release();
+        }
+    }
+
+    // without a transform the augmented path decodes like the plain one
+    FreeWill::AugmentationParameters identity;
+    FreeWill::AugmentationRandom random(1);
+    std::vector<float> output(rows * columns);
+    FreeWill::augmentItemCPU(imageFile.item(3), output.data(), rows, columns, 0.5f, identity, random);
+    for (unsigned int p = 0; p < rows * columns; ++p)
+    {
+        QVERIFY(output[p] == images[3 * rows * columns + p] * 0.5f);
+    }
+
+    imageFile.close();
+    labelFile.close();
+
+    std::remove(imageFilename.c_str());
+    std::remove(labelFilename.c_str());
+}
+
+void FreeWillUnitTest::batchLoaderShardTest()
+{
+    const unsigned int imageCount = 11;
+    const unsigned int batchSize = 2;
+    const unsigned int shardCount = 2;
+
+    std::string imageFilename = "freewill-test-shard-images-idx3-ubyte";
+    std::string labelFilename = "freewill-test-shard-labels-idx1-ubyte";
+
+    // the label of an image is its index
+    std::vector<unsigned char> images(imageCount * 2 * 2);
+    std::vector<unsigned char> labels(imageCount);
+    for (unsigned int i = 0; i < imageCount; ++i)
+    {
+        labels[i] = i;
+        std::fill(images.begin() + i * 4, images.begin() + (i + 1) * 4, (unsigned char) i);
+    }
+
+    writeIDXFile(imageFilename, {imageCount, 2, 2}, images);
+    writeIDXFile(labelFilename, {imageCount}, labels);
+
+    FreeWill::IDXFile imageFile;
+    FreeWill::IDXFile labelFile;
+    QVERIFY(imageFile.open(imageFilename));
+    QVERIFY(labelFile.open(labelFilename));
+
+    {
+        FreeWill::BatchLoader loader(&imageFile, &labelFile, batchSize);
+        loader.setShard(shardCount, shardCount);
+        QVERIFY(!loader.start());
+    }
+
+    for (bool isShuffling : {false, true})
+    {
+        FreeWill::AugmentationParameters augmentation;
+        augmentation.m_isShuffling = isShuffling;
+        augmentation.m_seed = 3;
+
+        // one epoch of every shard, 5 items in batches of 2 + 2 + 1, the eleventh is left out
+        std::vector<unsigned int> shardItems[shardCount];
+
+        for (unsigned int shard = 0; shard < shardCount; ++shard)
+        {
+            FreeWill::BatchLoader loader(&imageFile, &labelFile, batchSize);
+            loader.setAugmentation(augmentation);
+            loader.setShard(shard, shardCount);
+            QVERIFY(loader.start());
+
+            for (unsigned int b = 0; b < 4; ++b)
+            {
+                const FreeWill::BatchLoader::Batch *batch = loader.acquire();
+                QVERIFY(batch);
+                QVERIFY(batch->m_size == (b == 2 ? 1u : batchSize));
+                QVERIFY(batch->m_epoch == b / 3);
+
+                for (unsigned int i = 0; i < batch->m_size; ++i)
+                {
+                    QVERIFY(batch->m_inputs[i * 4] == batch->m_labels[i] * (1.0f / 255.0f));
+
+                    if (b < 3)
+                    {
+                        shardItems[shard].push_back(batch->m_labels[i]);
+                    }
+                }
+
+                loader.release();
+            }
+        }
+
+        if (!isShuffling)
+        {
+            QVERIFY(shardItems[0] == std::vector<unsigned int>({0, 1, 2, 3, 4}));
+            QVERIFY(shardItems[1] == std::vector<unsigned int>({5, 6, 7, 8, 9}));
+        }
+
+        // the shards of an epoch don't overlap
+        std::vector<unsigned int> items(shardItems[0]);
+        items.insert(items.end(), shardItems[1].begin(), shardItems[1].end());
+        std::sort(items.begin(), items.end());
+        QVERIFY(std::unique(items.begin(), items.end()) == items.end() && items.size() == 10);
+    }
+
+    imageFile.close();
+    labelFile.close();
+
+    std::remove(imageFilename.c_str());
+    std::remove(labelFilename.c_str());
+}
+
+void FreeWillUnitTest::recordDatasetTest()
+{
+    const unsigned int imageCount = 23;
+    const unsigned int batchSize = 5;
+
+    std::string imageFilename = "freewill-test-record-images-idx3-ubyte";
+    std::string labelFilename = "freewill-test-record-labels-idx1-ubyte";
+
+    // the label of an image is its index, which is also its first pixel
+    std::vector<unsigned char> images(imageCount * 2 * 3);
+    std::vector<unsigned char> labels(imageCount);
+    for (unsigned int i = 0; i < imageCount; ++i)
+    {
+        labels[i] = i;
+
+        for (unsigned int p = 0; p < 6; ++p)
+        {
+            images[i * 6 + p] = (unsigned char) (p == 0 ? i : (i * 37 + p) % 256);
+        }
+    }
+
+    writeIDXFile(imageFilename, {imageCount, 2, 3}, images);
+    writeIDXFile(labelFilename, {imageCount}, labels);
+
+    FreeWill::IDXFile imageFile;
+    FreeWill::IDXFile labelFile;
+    QVERIFY(imageFile.open(imageFilename));
+    QVERIFY(labelFile.open(labelFilename));
+
+    // shards of 7, 8 and 8 records in blocks of 4
+    std::vector<std::string> filenames = FreeWill::writeRecordShards(imageFile, &labelFile, "freewill-test-records", 3, 4);
+    QVERIFY(filenames.size() == 3);
+
+    FreeWill::RecordDataset dataset;
+    QVERIFY(!dataset.open({filenames[0], imageFilename}));
+    QVERIFY(!dataset.isOpen());
+    QVERIFY(dataset.open(filenames));
+
+    QVERIFY(dataset.itemCount() == imageCount);
+    QVERIFY(dataset.itemSize() == 6 && dataset.hasLabels() && dataset.recordSize() == 7);
+    QVERIFY(dataset.dimensions() == std::vector<unsigned int>({imageCount, 2, 3}));
+    QVERIFY(dataset.blockCount() == 6);
+    QVERIFY(dataset.blockFirstItem(1) == 4 && dataset.blockItemCount(1) == 3 && dataset.blockFirstItem(2) == 7);
+
+    std::vector<unsigned char> block(4 * dataset.recordSize());
+    QVERIFY(dataset.readBlock(3, block.data()));
+    for (unsigned int k = 0; k < 4; ++k)
+    {
+        unsigned int item = dataset.blockFirstItem(3) + k;
+        QVERIFY(std::equal(block.begin() + k * 7, block.begin() + k * 7 + 6, images.begin() + item * 6));
+        QVERIFY(block[k * 7 + 6] == labels[item]);
+    }
+
+    {
+        // in order, the same batches as the IDX files give
+        FreeWill::BatchLoader loader(&dataset, batchSize);
+        loader.setWindow(2);
+        QVERIFY(loader.start());
+
+        unsigned int item = 0;
+        for (unsigned int b = 0; b < 7; ++b)
+        {
+            const FreeWill::BatchLoader::Batch *batch = loader.acquire();
+            QVERIFY(batch);
+            QVERIFY(batch->m_size == (b == 4 ? 3u : batchSize));
+            QVERIFY(batch->m_epoch == b / 5);
+
+            for (unsigned int i = 0; i < batchSize; ++i)
+            {
+                for (unsigned int p = 0; p < 6; ++p)
+                {
+                    float expected = i < batch->m_size ? images[(item + i) * 6 + p] * (1.0f / 255.0f) : 0.0f;
+                    QVERIFY(batch->m_inputs[i * 6 + p] == expected);
+                }
+
+                QVERIFY(batch->m_labels[i] == (i < batch->m_size ? labels[item + i] : 0u));
+            }
+
+            item = (item + batch->m_size) % imageCount;
+            loader.release();
+        }
+    }
+
+    // shuffled across the shard files, two ranks of 11 items each
+    FreeWill::AugmentationParameters augmentation;
+    augmentation.m_isShuffling = true;
+    augmentation.m_seed = 5;
+
+    std::vector<unsigned int> rankItems[2];
+
+    for (unsigned int rank = 0; rank < 2; ++rank)
+    {
+        FreeWill::BatchLoader loader(&dataset, batchSize);
+        loader.setAugmentation(augmentation);
+        loader.setShard(rank, 2);
+        loader.setWindow(2);
+        QVERIFY(loader.start());
+
+        for (unsigned int b = 0; b < 3; ++b)
+        {
+            const FreeWill::BatchLoader::Batch *batch = loader.acquire();
+            QVERIFY(batch);
+            QVERIFY(batch->m_size == (b == 2 ? 1u : batchSize));
+
+            for (unsigned int i = 0; i < batch->m_size; ++i)
+            {
+                QVERIFY(batch->m_inputs[i * 6] == batch->m_labels[i] * (1.0f / 255.0f));
+                rankItems[rank].push_back(batch->m_labels[i]);
+            }
+
+            loader.release();
+        }
+    }
+
+    std::vector<unsigned int> items(rankItems[0]);
+    items.insert(items.end(), rankItems[1].begin(), rankItems[1].end());
+    QVERIFY(!std::is_sorted(items.begin(), items.end()));
+    std::sort(items.begin(), items.end());
+    QVERIFY(std::unique(items.begin(), items.end()) == items.end() && items.size() == 22);
+
+    {
+        // the last shard cut short after open, the batches up to its blocks at most are served
+        QVERIFY(truncate(filenames[2].c_str(), 16) == 0);
+
+        FreeWill::BatchLoader loader(&dataset, batchSize);
+        loader.setWindow(2);
+        QVERIFY(loader.start());
+
+        unsigned int batchCount = 0;
+        const FreeWill::BatchLoader::Batch *batch = nullptr;
+        while ((batch = loader.acquire()) && batchCount < 10)
+        {
+            ++batchCount;
+            loader.release();
+        }
+
+        QVERIFY(!batch && loader.hasFailed());
+        QVERIFY(batchCount <= 3);
+    }
+
+    dataset.close();
+    imageFile.close();
+    labelFile.close();
+
+    for (const std::string &filename : filenames)
+    {
+        std::remove(filename.c_str());
+    }
+
+    std::remove(imageFilename.c_str());
+    std::remove(labelFilename.c_str());
+}
@@ -15,11 +15,28 @@
 #include "Operator/MaxPoolingDerivative.h"
 #include "Model/Model.h"
 #include "Model/Solver.h"
+#include "Model/InferenceServer.h"
+#include "Operator/FeedFromMemory.h"
+#include "Model/CheckpointWriter.h"
+#include "Model/SharedWeights.h"
+#include "Model/AsyncEvaluator.h"
+#include "Context/CPUTopology.h"
+#include "Context/CPUTopologyTuner.h"
+#include "Context/ThreadPool.h"
+#include "Operator/CPUAutotuner.h"
+#include "Context/Profiler.h"
+#include "Context/PerformanceCounters.h"
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <sched.h>
 
 void FreeWillUnitTest::modelXORTest()
 {
 
-    //FreeWill::RandomNumberGenerator::getSingleton().beginReplay("recordRandom.bin");
     FreeWill::Model *model = FreeWill::Model::create();
 
     FreeWill::TensorDescriptorHandle input = model->addTensor("input", {2}).enableBatch();
@@ -84,8 +101,6 @@ void FreeWillUnitTest::modelXORTest()
     solver.m_batchSize = 4;
     solver.init(model);
 
-    //FreeWill::RandomNumberGenerator::getSingleton().endReplay();
-
     float *inputData = model->beginMutateData(input);
     float *labelData = model->beginMutateData(label);
 
@@ -136,3 +151,4420 @@ void FreeWillUnitTest::modelXORTest()
         std::cout << "test " << i << ": a " << inputDataRO[i*2] << " b " << inputDataRO[i*2+1] << " c " << labelDataRO[i] << " nn result: " << resultDataRO[i] << std::endl;
     }
 }
+
+void FreeWillUnitTest::graphExecutorTest()
+{
+    const unsigned int deviceCount = 3;
+    const unsigned int batchSize = 4;
+    const unsigned int inputSize = 5;
+    const unsigned int outputSize = 3;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(deviceCount);
+
+    FreeWill::Model *model = FreeWill::Model::create();
+
+    FreeWill::TensorDescriptorHandle input = model->addTensor("input", {inputSize}).enableBatch();
+    FreeWill::TensorDescriptorHandle activation = model->addTensor("activation", {outputSize}).enableBatch();
+    FreeWill::TensorDescriptorHandle weight = model->addTensor("weight", {outputSize, inputSize}).randomize();
+    FreeWill::TensorDescriptorHandle bias = model->addTensor("bias", {outputSize}).randomize();
+    FreeWill::TensorDescriptorHandle weightGrad = model->addTensor("weightGrad", {outputSize, inputSize});
+
+    FreeWill::OperatorDescriptorHandle fullyConnected = model->addOperator("fullyConnected", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                        {{"Input", input}, {"Weight", weight}, {"Bias", bias}},
+                        {{"Output", activation}});
+    FreeWill::OperatorDescriptorHandle sigmoid = model->addOperator("sigmoid", FreeWill::OperatorName::ACTIVATION,
+                        {{"Input", activation}},
+                        {{"Output", activation}},
+                        {{"Mode", FreeWill::ActivationMode::SIGMOID}});
+
+    model->defineForwardPath({fullyConnected, sigmoid});
+    model->defineBackwardPath({});
+    model->defineWeightUpdatePairs({{weight, weightGrad}});
+
+    FreeWill::Solver solver;
+    solver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+    solver.m_batchSize = batchSize;
+    QVERIFY(solver.init(model));
+
+    for (unsigned int d = 0; d < deviceCount; ++d)
+    {
+        float *inputData = model->beginMutateData(input, d);
+        for (unsigned int i = 0; i < inputSize * batchSize; ++i)
+        {
+            inputData[i] = (float) (i + d) / (float) (inputSize * batchSize) - 0.5f;
+        }
+        model->endMutateData(input, d);
+    }
+
+    for (unsigned int step = 0; step < 10; ++step)
+    {
+        solver.forward(model);
+    }
+
+    for (unsigned int d = 0; d < deviceCount; ++d)
+    {
+        const float *inputData = model->readonlyAccess(input, d);
+        const float *weightData = model->readonlyAccess(weight, d);
+        const float *biasData = model->readonlyAccess(bias, d);
+        const float *activationData = model->readonlyAccess(activation, d);
+
+        for (unsigned int b = 0; b < batchSize; ++b)
+        {
+            for (unsigned int o = 0; o < outputSize; ++o)
+            {
+                float sum = biasData[o];
+                for (unsigned int i = 0; i < inputSize; ++i)
+                {
+                    sum += weightData[i * outputSize + o] * inputData[b * inputSize + i];
+                }
+
+                float expected = 1.0f / (1.0f + std::exp(-sum));
+                QVERIFY(std::abs(activationData[b * outputSize + o] - expected) < epsilon);
+            }
+        }
+    }
+
+    delete model;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+}
+
+void FreeWillUnitTest::memoryPlannerTest()
+{
+    const unsigned int deviceCount = 2;
+    const unsigned int batchSize = 3;
+    const unsigned int inputSize = 8;
+    const unsigned int hiddenSize = 16;
+    const unsigned int outputSize = 4;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(deviceCount);
+
+    std::vector<float> results[2];
+    bool isMemoryShared[2] = {false, false};
+
+    for (unsigned int run = 0; run < 2; ++run)
+    {
+        FreeWill::Model *model = FreeWill::Model::create();
+
+        FreeWill::TensorDescriptorHandle input = model->addTensor("input", {inputSize}).enableBatch();
+        FreeWill::TensorDescriptorHandle activation1 = model->addTensor("activation1", {hiddenSize}).enableBatch();
+        FreeWill::TensorDescriptorHandle activation2 = model->addTensor("activation2", {hiddenSize}).enableBatch();
+        FreeWill::TensorDescriptorHandle output = model->addTensor("output", {outputSize}).enableBatch();
+        FreeWill::TensorDescriptorHandle outputDelta = model->addTensor("outputDelta", {outputSize}).enableBatch();
+        FreeWill::TensorDescriptorHandle delta2 = model->addTensor("delta2", {hiddenSize}).enableBatch();
+        FreeWill::TensorDescriptorHandle delta1 = model->addTensor("delta1", {hiddenSize}).enableBatch();
+        FreeWill::TensorDescriptorHandle inputDelta = model->addTensor("inputDelta", {inputSize}).enableBatch();
+
+        FreeWill::TensorDescriptorHandle weights[3] = {model->addTensor("weight1", {hiddenSize, inputSize}),
+                                                       model->addTensor("weight2", {hiddenSize, hiddenSize}),
+                                                       model->addTensor("weight3", {outputSize, hiddenSize})};
+        FreeWill::TensorDescriptorHandle biases[3] = {model->addTensor("bias1", {hiddenSize}),
+                                                      model->addTensor("bias2", {hiddenSize}),
+                                                      model->addTensor("bias3", {outputSize})};
+        FreeWill::TensorDescriptorHandle weightGrads[3] = {model->addTensor("weightGrad1", {hiddenSize, inputSize}),
+                                                           model->addTensor("weightGrad2", {hiddenSize, hiddenSize}),
+                                                           model->addTensor("weightGrad3", {outputSize, hiddenSize})};
+        FreeWill::TensorDescriptorHandle biasGrads[3] = {model->addTensor("biasGrad1", {hiddenSize}),
+                                                         model->addTensor("biasGrad2", {hiddenSize}),
+                                                         model->addTensor("biasGrad3", {outputSize})};
+
+        FreeWill::OperatorDescriptorHandle fullyConnected1 = model->addOperator("fullyConnected1", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                            {{"Input", input}, {"Weight", weights[0]}, {"Bias", biases[0]}}, {{"Output", activation1}});
+        FreeWill::OperatorDescriptorHandle sigmoid1 = model->addOperator("sigmoid1", FreeWill::OperatorName::ACTIVATION,
+                            {{"Input", activation1}}, {{"Output", activation1}}, {{"Mode", FreeWill::ActivationMode::SIGMOID}});
+        FreeWill::OperatorDescriptorHandle fullyConnected2 = model->addOperator("fullyConnected2", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                            {{"Input", activation1}, {"Weight", weights[1]}, {"Bias", biases[1]}}, {{"Output", activation2}});
+        FreeWill::OperatorDescriptorHandle sigmoid2 = model->addOperator("sigmoid2", FreeWill::OperatorName::ACTIVATION,
+                            {{"Input", activation2}}, {{"Output", activation2}}, {{"Mode", FreeWill::ActivationMode::SIGMOID}});
+        FreeWill::OperatorDescriptorHandle fullyConnected3 = model->addOperator("fullyConnected3", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                            {{"Input", activation2}, {"Weight", weights[2]}, {"Bias", biases[2]}}, {{"Output", output}});
+
+        FreeWill::OperatorDescriptorHandle fullyConnected3Derivative = model->addOperator("fullyConnected3Derivative", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS_DERIVATIVE,
+                            {{"InputActivation", activation2}, {"OutputDelta", outputDelta}, {"Weight", weights[2]}},
+                            {{"WeightGrad", weightGrads[2]}, {"BiasGrad", biasGrads[2]}, {"InputDelta", delta2}});
+        FreeWill::OperatorDescriptorHandle sigmoid2Derivative = model->addOperator("sigmoid2Derivative", FreeWill::OperatorName::ACTIVATION_DERIVATIVE,
+                            {{"Output", activation2}, {"OutputDelta", delta2}}, {{"InputDelta", delta2}}, {{"Mode", FreeWill::ActivationMode::SIGMOID}});
+        FreeWill::OperatorDescriptorHandle fullyConnected2Derivative = model->addOperator("fullyConnected2Derivative", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS_DERIVATIVE,
+                            {{"InputActivation", activation1}, {"OutputDelta", delta2}, {"Weight", weights[1]}},
+                            {{"WeightGrad", weightGrads[1]}, {"BiasGrad", biasGrads[1]}, {"InputDelta", delta1}});
+        FreeWill::OperatorDescriptorHandle sigmoid1Derivative = model->addOperator("sigmoid1Derivative", FreeWill::OperatorName::ACTIVATION_DERIVATIVE,
+                            {{"Output", activation1}, {"OutputDelta", delta1}}, {{"InputDelta", delta1}}, {{"Mode", FreeWill::ActivationMode::SIGMOID}});
+        FreeWill::OperatorDescriptorHandle fullyConnected1Derivative = model->addOperator("fullyConnected1Derivative", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS_DERIVATIVE,
+                            {{"InputActivation", input}, {"OutputDelta", delta1}, {"Weight", weights[0]}},
+                            {{"WeightGrad", weightGrads[0]}, {"BiasGrad", biasGrads[0]}, {"InputDelta", inputDelta}});
+
+        model->defineForwardPath({fullyConnected1, sigmoid1, fullyConnected2, sigmoid2, fullyConnected3});
+        model->defineBackwardPath({fullyConnected3Derivative, sigmoid2Derivative, fullyConnected2Derivative, sigmoid1Derivative, fullyConnected1Derivative});
+        model->defineWeightUpdatePairs({{weights[0], weightGrads[0]}, {weights[1], weightGrads[1]}, {weights[2], weightGrads[2]},
+                                        {biases[0], biasGrads[0]}, {biases[1], biasGrads[1]}, {biases[2], biasGrads[2]}});
+
+        FreeWill::Solver solver;
+        solver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+        solver.m_batchSize = batchSize;
+        solver.m_planMemory = (run == 1);
+        QVERIFY(solver.init(model));
+
+        for (unsigned int l = 0; l < 3; ++l)
+        {
+            unsigned int weightSize = (l == 0 ? inputSize : hiddenSize) * (l == 2 ? outputSize : hiddenSize);
+            float *weightData = model->beginMutateData(weights[l]);
+            for (unsigned int i = 0; i < weightSize; ++i)
+            {
+                weightData[i] = (float) ((i * 7 + l) % 13) / 13.0f - 0.5f;
+            }
+            model->endMutateData(weights[l]);
+
+            unsigned int biasSize = (l == 2 ? outputSize : hiddenSize);
+            float *biasData = model->beginMutateData(biases[l]);
+            for (unsigned int i = 0; i < biasSize; ++i)
+            {
+                biasData[i] = (float) i / (float) biasSize - 0.5f;
+            }
+            model->endMutateData(biases[l]);
+        }
+
+        for (unsigned int step = 0; step < 2; ++step)
+        {
+            for (unsigned int d = 0; d < deviceCount; ++d)
+            {
+                float *inputData = model->beginMutateData(input, d);
+                for (unsigned int i = 0; i < inputSize * batchSize; ++i)
+                {
+                    inputData[i] = (float) ((i * 3 + d + step) % 11) / 11.0f - 0.5f;
+                }
+                model->endMutateData(input, d);
+
+                float *outputDeltaData = model->beginMutateData(outputDelta, d);
+                for (unsigned int i = 0; i < outputSize * batchSize; ++i)
+                {
+                    outputDeltaData[i] = (float) ((i * 5 + d) % 7) / 7.0f - 0.5f;
+                }
+                model->endMutateData(outputDelta, d);
+            }
+
+            solver.forward(model);
+
+            for (unsigned int l = 0; l < 3; ++l)
+            {
+                model->clearTensor(weightGrads[l]);
+                model->clearTensor(biasGrads[l]);
+            }
+
+            solver.backward(model);
+        }
+
+        for (unsigned int d = 0; d < deviceCount; ++d)
+        {
+            const float *outputData = model->readonlyAccess(output, d);
+            results[run].insert(results[run].end(), outputData, outputData + outputSize * batchSize);
+
+            const float *inputDeltaData = model->readonlyAccess(inputDelta, d);
+            results[run].insert(results[run].end(), inputDeltaData, inputDeltaData + inputSize * batchSize);
+
+            for (unsigned int l = 0; l < 3; ++l)
+            {
+                unsigned int weightSize = (l == 0 ? inputSize : hiddenSize) * (l == 2 ? outputSize : hiddenSize);
+                const float *weightGradData = model->readonlyAccess(weightGrads[l], d);
+                results[run].insert(results[run].end(), weightGradData, weightGradData + weightSize);
+            }
+        }
+
+        FreeWill::TensorDescriptorHandle batchTensors[] = {input, activation1, activation2, output, outputDelta, delta2, delta1, inputDelta};
+        unsigned int batchTensorSizes[] = {inputSize, hiddenSize, hiddenSize, outputSize, outputSize, hiddenSize, hiddenSize, inputSize};
+
+        for (unsigned int a = 0; a < 8; ++a)
+        {
+            for (unsigned int b = a + 1; b < 8; ++b)
+            {
+                const float *beginA = model->readonlyAccess(batchTensors[a]);
+                const float *beginB = model->readonlyAccess(batchTensors[b]);
+
+                if (beginA < beginB + batchTensorSizes[b] * batchSize && beginB < beginA + batchTensorSizes[a] * batchSize)
+                {
+                    isMemoryShared[run] = true;
+                }
+            }
+        }
+
+        delete model;
+    }
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+
+    QVERIFY(!isMemoryShared[0]);
+    QVERIFY(isMemoryShared[1]);
+    QVERIFY(results[0].size() == results[1].size());
+
+    for (unsigned int i = 0; i < results[0].size(); ++i)
+    {
+        QVERIFY(results[0][i] == results[1][i]);
+    }
+}
+
+void FreeWillUnitTest::gradientAllReduceTest()
+{
+    const unsigned int deviceCount = 3;
+    const unsigned int sizes[2] = {37 * 3, 5};
+    const float learningRate = -0.01f;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(deviceCount);
+
+    FreeWill::Model *model = FreeWill::Model::create();
+
+    FreeWill::TensorDescriptorHandle weights[2] = {model->addTensor("weight", {37, 3}), model->addTensor("bias", {5})};
+    FreeWill::TensorDescriptorHandle grads[2] = {model->addTensor("weightGrad", {37, 3}), model->addTensor("biasGrad", {5})};
+
+    model->defineWeightUpdatePairs({{weights[0], grads[0]}, {weights[1], grads[1]}});
+
+    FreeWill::Solver solver;
+    solver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+    solver.m_batchSize = 1;
+    QVERIFY(solver.init(model));
+
+    std::vector<float> expectedWeights[2];
+    std::vector<float> expectedGrads[2];
+
+    for (unsigned int t = 0; t < 2; ++t)
+    {
+        float *weightData = model->beginMutateData(weights[t]);
+        for (unsigned int i = 0; i < sizes[t]; ++i)
+        {
+            weightData[i] = (float) ((i * 7 + t) % 13) / 13.0f - 0.5f;
+        }
+        expectedWeights[t].assign(weightData, weightData + sizes[t]);
+        model->endMutateData(weights[t]);
+
+        expectedGrads[t].assign(sizes[t], 0.0f);
+
+        for (unsigned int d = 0; d < deviceCount; ++d)
+        {
+            float *gradData = model->beginMutateData(grads[t], d);
+            for (unsigned int i = 0; i < sizes[t]; ++i)
+            {
+                gradData[i] = (float) ((i * 5 + d * 3 + t) % 11) / 11.0f - 0.3f;
+                expectedGrads[t][i] = (d == 0) ? gradData[i] : expectedGrads[t][i] + gradData[i];
+            }
+            model->endMutateData(grads[t], d);
+        }
+
+        for (unsigned int i = 0; i < sizes[t]; ++i)
+        {
+            expectedWeights[t][i] = expectedWeights[t][i] + expectedGrads[t][i] * learningRate;
+        }
+    }
+
+    solver.update(learningRate);
+
+    for (unsigned int t = 0; t < 2; ++t)
+    {
+        const float *gradData = model->readonlyAccess(grads[t], 0);
+        for (unsigned int i = 0; i < sizes[t]; ++i)
+        {
+            QVERIFY(gradData[i] == expectedGrads[t][i]);
+        }
+
+        for (unsigned int d = 0; d < deviceCount; ++d)
+        {
+            const float *weightData = model->readonlyAccess(weights[t], d);
+            for (unsigned int i = 0; i < sizes[t]; ++i)
+            {
+                QVERIFY(weightData[i] == expectedWeights[t][i]);
+            }
+        }
+    }
+
+    delete model;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+}
+
+void FreeWillUnitTest::asynchronousUpdateTest()
+{
+    const unsigned int deviceCount = 3;
+    const unsigned int size = 37 * 3;
+    const float learningRate = -0.01f;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(deviceCount);
+
+    // staleness 0 is Hogwild, 2 reconciles the replicas every other step
+    for (unsigned int staleness : {0u, 2u})
+    {
+        FreeWill::Model *model = FreeWill::Model::create();
+
+        FreeWill::TensorDescriptorHandle weight = model->addTensor("weight", {37, 3});
+        FreeWill::TensorDescriptorHandle grad = model->addTensor("weightGrad", {37, 3});
+        model->defineWeightUpdatePairs({{weight, grad}});
+
+        FreeWill::Solver solver;
+        solver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+        solver.m_batchSize = 1;
+        solver.m_asynchronousUpdate.m_isEnabled = true;
+        solver.m_asynchronousUpdate.m_maxStaleness = staleness;
+        QVERIFY(solver.init(model));
+
+        QVERIFY((model->readonlyAccess(weight, 1) == model->readonlyAccess(weight, 0)) == (staleness == 0));
+
+        float *weightData = model->beginMutateData(weight);
+        for (unsigned int i = 0; i < size; ++i)
+        {
+            weightData[i] = (float) ((i * 7) % 13) / 13.0f - 0.5f;
+        }
+        model->endMutateData(weight);
+
+        std::vector<float> expected(weightData, weightData + size);
+        std::vector<std::vector<float>> replicas(deviceCount, expected);
+
+        for (unsigned int step = 1; step <= 2; ++step)
+        {
+            for (unsigned int d = 0; d < deviceCount; ++d)
+            {
+                float *gradData = model->beginMutateData(grad, d);
+                for (unsigned int i = 0; i < size; ++i)
+                {
+                    // Hogwild's premise, sparse updates: the replicas write disjoint elements
+                    gradData[i] = (staleness == 0 && i % deviceCount != d) ? 0.0f : (float) ((i * 5 + d * 3 + step) % 11) / 11.0f - 0.3f;
+                    expected[i] += learningRate * gradData[i];
+                    replicas[d][i] += learningRate * gradData[i];
+                }
+                model->endMutateData(grad, d);
+            }
+
+            solver.update(learningRate);
+
+            // before the replicas are reconciled each has only taken its own steps
+            for (unsigned int d = 0; d < deviceCount; ++d)
+            {
+                const float *replicaData = model->readonlyAccess(weight, d);
+                for (unsigned int i = 0; i < size; ++i)
+                {
+                    float value = (staleness == 0 || step % staleness == 0) ? expected[i] : replicas[d][i];
+                    QVERIFY(std::abs(replicaData[i] - value) < 1e-5f);
+                }
+            }
+        }
+
+        QVERIFY(solver.state().m_step == 2);
+
+        delete model;
+    }
+
+    // loss scaling needs the merged gradient
+    FreeWill::Model *model = FreeWill::Model::create();
+    FreeWill::TensorDescriptorHandle weight = model->addTensor("weight", {size});
+    model->defineWeightUpdatePairs({{weight, model->addTensor("weightGrad", {size})}});
+
+    FreeWill::Solver solver;
+    solver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+    solver.m_batchSize = 1;
+    solver.m_asynchronousUpdate.m_isEnabled = true;
+    solver.m_lossScaling.m_isEnabled = true;
+    QVERIFY(!solver.init(model));
+
+    delete model;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+}
+
+void FreeWillUnitTest::numaGradientReduceTest()
+{
+    const unsigned int deviceCount = 5;
+    const unsigned int sizes[2] = {37 * 3, 5};
+    const float learningRate = -0.01f;
+
+    // two nodes that both run on cpu 0, devices 0 to 2 on the first, 3 and 4 on the second
+    FreeWill::CPUTopology::getSingleton().setNodes({{0}, {0}});
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(deviceCount);
+
+    for (unsigned int d = 0; d < deviceCount; ++d)
+    {
+        QVERIFY(FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().numaNode(d) == (d < 3 ? 0u : 1u));
+    }
+
+    // the task runs on the pinned worker
+    std::thread::id workerId;
+    int workerCpu = -1;
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().runOnDevice(4, [&]
+    {
+        workerId = std::this_thread::get_id();
+        workerCpu = sched_getcpu();
+    });
+    QVERIFY(workerId != std::this_thread::get_id());
+    QVERIFY(workerCpu == 0);
+
+    FreeWill::Model *model = FreeWill::Model::create();
+
+    FreeWill::TensorDescriptorHandle weights[2] = {model->addTensor("weight", {37, 3}), model->addTensor("bias", {5})};
+    FreeWill::TensorDescriptorHandle grads[2] = {model->addTensor("weightGrad", {37, 3}), model->addTensor("biasGrad", {5})};
+
+    model->defineWeightUpdatePairs({{weights[0], grads[0]}, {weights[1], grads[1]}});
+
+    FreeWill::Solver solver;
+    solver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+    solver.m_batchSize = 1;
+    QVERIFY(solver.init(model));
+
+    std::vector<float> expectedWeights[2];
+    std::vector<float> expectedGrads[2];
+
+    // eighths, so the sum is exact however the nodes group it
+    for (unsigned int t = 0; t < 2; ++t)
+    {
+        float *weightData = model->beginMutateData(weights[t]);
+        for (unsigned int i = 0; i < sizes[t]; ++i)
+        {
+            weightData[i] = (float) ((i * 7 + t) % 13) / 13.0f - 0.5f;
+        }
+        expectedWeights[t].assign(weightData, weightData + sizes[t]);
+        model->endMutateData(weights[t]);
+
+        expectedGrads[t].assign(sizes[t], 0.0f);
+
+        for (unsigned int d = 0; d < deviceCount; ++d)
+        {
+            float *gradData = model->beginMutateData(grads[t], d);
+            for (unsigned int i = 0; i < sizes[t]; ++i)
+            {
+                gradData[i] = (float) ((i * 5 + d * 3 + t) % 11) / 8.0f - 0.5f;
+                expectedGrads[t][i] += gradData[i];
+            }
+            model->endMutateData(grads[t], d);
+        }
+
+        for (unsigned int i = 0; i < sizes[t]; ++i)
+        {
+            expectedWeights[t][i] = expectedWeights[t][i] + expectedGrads[t][i] * learningRate;
+        }
+    }
+
+    solver.update(learningRate);
+
+    // the merged gradient is in the first replica of each node, every replica is updated with it
+    for (unsigned int t = 0; t < 2; ++t)
+    {
+        for (unsigned int leader : {0, 3})
+        {
+            const float *gradData = model->readonlyAccess(grads[t], leader);
+            for (unsigned int i = 0; i < sizes[t]; ++i)
+            {
+                QVERIFY(gradData[i] == expectedGrads[t][i]);
+            }
+        }
+
+        for (unsigned int d = 0; d < deviceCount; ++d)
+        {
+            const float *weightData = model->readonlyAccess(weights[t], d);
+            for (unsigned int i = 0; i < sizes[t]; ++i)
+            {
+                QVERIFY(weightData[i] == expectedWeights[t][i]);
+            }
+        }
+    }
+
+    delete model;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+    FreeWill::CPUTopology::getSingleton().setNodes({});
+}
+
+void FreeWillUnitTest::profilerTest()
+{
+    const unsigned int deviceCount = 2;
+    const unsigned int batchSize = 4;
+    const unsigned int inputSize = 5;
+    const unsigned int outputSize = 3;
+    const unsigned int stepCount = 3;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(deviceCount);
+
+    FreeWill::Model *model = FreeWill::Model::create();
+
+    FreeWill::TensorDescriptorHandle input = model->addTensor("input", {inputSize}).enableBatch();
+    FreeWill::TensorDescriptorHandle activation = model->addTensor("activation", {outputSize}).enableBatch();
+    FreeWill::TensorDescriptorHandle weight = model->addTensor("weight", {outputSize, inputSize}).randomize();
+    FreeWill::TensorDescriptorHandle bias = model->addTensor("bias", {outputSize}).randomize();
+    FreeWill::TensorDescriptorHandle weightGrad = model->addTensor("weightGrad", {outputSize, inputSize});
+
+    FreeWill::OperatorDescriptorHandle fullyConnected = model->addOperator("fullyConnected", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                        {{"Input", input}, {"Weight", weight}, {"Bias", bias}},
+                        {{"Output", activation}});
+    FreeWill::OperatorDescriptorHandle sigmoid = model->addOperator("sigmoid", FreeWill::OperatorName::ACTIVATION,
+                        {{"Input", activation}},
+                        {{"Output", activation}},
+                        {{"Mode", FreeWill::ActivationMode::SIGMOID}});
+
+    model->defineForwardPath({fullyConnected, sigmoid});
+    model->defineBackwardPath({});
+    model->defineWeightUpdatePairs({{weight, weightGrad}});
+
+    FreeWill::Solver solver;
+    solver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+    solver.m_batchSize = batchSize;
+    // both operators are recorded apart
+    solver.m_fuseOperators = false;
+    QVERIFY(solver.init(model));
+
+    FreeWill::Profiler &profiler = FreeWill::Profiler::getSingleton();
+
+    // nothing is recorded while disabled
+    solver.forward(model);
+    QVERIFY(profiler.records().empty());
+
+    profiler.enable();
+    for (unsigned int step = 0; step < stepCount; ++step)
+    {
+        solver.forward(model);
+    }
+    profiler.disable();
+
+    std::vector<FreeWill::ProfileRecord> records = profiler.records();
+    QVERIFY(records.size() == 2 * deviceCount * stepCount);
+
+    std::vector<unsigned int> fullyConnectedCount(deviceCount, 0);
+
+    for (const FreeWill::ProfileRecord &record : records)
+    {
+        QVERIFY(!record.m_isGPU);
+        QVERIFY(record.m_deviceId < deviceCount);
+        QVERIFY(record.m_beginTime >= record.m_queueTime);
+        QVERIFY(record.m_endTime >= record.m_beginTime);
+        QVERIFY(record.m_dispatchTime >= 0.0);
+
+        if (record.m_name == "fullyConnected")
+        {
+            QVERIFY(record.m_type == "DotProductWithBias");
+            QVERIFY(record.m_flops == 2.0 * outputSize * inputSize * batchSize);
+            QVERIFY(record.m_bytes == sizeof(float) * (inputSize * batchSize + outputSize * inputSize + outputSize + outputSize * batchSize));
+            fullyConnectedCount[record.m_deviceId] += 1;
+        }
+        else
+        {
+            QVERIFY(record.m_name == "sigmoid");
+            QVERIFY(record.m_type == "Activation");
+            QVERIFY(record.m_flops == outputSize * batchSize);
+        }
+    }
+
+    for (unsigned int d = 0; d < deviceCount; ++d)
+    {
+        QVERIFY(fullyConnectedCount[d] == stepCount);
+    }
+
+    std::string summary = profiler.summary();
+    QVERIFY(summary.find("DotProductWithBias") != std::string::npos);
+    QVERIFY(summary.find("Activation") != std::string::npos);
+
+    const std::string traceFileName = "profilerTest.json";
+    QVERIFY(profiler.writeTrace(traceFileName));
+
+    std::ifstream traceFile(traceFileName);
+    std::stringstream trace;
+    trace << traceFile.rdbuf();
+    QVERIFY(trace.str().find("\"traceEvents\"") != std::string::npos);
+    QVERIFY(trace.str().find("\"name\":\"fullyConnected\",\"cat\":\"DotProductWithBias\",\"ph\":\"X\"") != std::string::npos);
+    std::remove(traceFileName.c_str());
+
+    profiler.clear();
+    QVERIFY(profiler.records().empty());
+
+    delete model;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+}
+
+void FreeWillUnitTest::profilerCountersTest()
+{
+    const unsigned int batchSize = 16;
+    const unsigned int inputSize = 64;
+    const unsigned int outputSize = 32;
+    const unsigned int stepCount = 3;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(1);
+
+    FreeWill::Model *model = FreeWill::Model::create();
+
+    FreeWill::TensorDescriptorHandle input = model->addTensor("input", {inputSize}).enableBatch().randomize();
+    FreeWill::TensorDescriptorHandle activation = model->addTensor("activation", {outputSize}).enableBatch();
+    FreeWill::TensorDescriptorHandle weight = model->addTensor("weight", {outputSize, inputSize}).randomize();
+    FreeWill::TensorDescriptorHandle bias = model->addTensor("bias", {outputSize}).randomize();
+    FreeWill::TensorDescriptorHandle weightGrad = model->addTensor("weightGrad", {outputSize, inputSize});
+
+    FreeWill::OperatorDescriptorHandle fullyConnected = model->addOperator("fullyConnected", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                        {{"Input", input}, {"Weight", weight}, {"Bias", bias}},
+                        {{"Output", activation}});
+
+    model->defineForwardPath({fullyConnected});
+    model->defineBackwardPath({});
+    model->defineWeightUpdatePairs({{weight, weightGrad}});
+
+    FreeWill::Solver solver;
+    solver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+    solver.m_batchSize = batchSize;
+    QVERIFY(solver.init(model));
+
+    FreeWill::Profiler &profiler = FreeWill::Profiler::getSingleton();
+
+    // the rooflines come from what the benchmark suite writes
+    const std::string benchmarkFileName = "profilerCountersTest.json";
+    {
+        std::ofstream benchmarkFile(benchmarkFileName);
+        benchmarkFile << "{\"context\":{\"threads\":1,\"minTime\":0.5,\"rooflines\":{\"CPU_NAIVE/float\":{\"peakGFlops\":100,\"bandwidthGBs\":10}}},\n"
+                      << "\"benchmarks\":[\n]}" << std::endl;
+    }
+    QVERIFY(profiler.loadRooflines(benchmarkFileName));
+    std::remove(benchmarkFileName.c_str());
+    QVERIFY(!profiler.loadRooflines(benchmarkFileName));
+
+    // where perf isn't permitted, e.g. in a container, the records only lack the counters
+    bool isCounting = profiler.enableCounters();
+    QVERIFY(isCounting == FreeWill::PerformanceCounters::isAvailable());
+    QVERIFY(profiler.isCountingEvents() == isCounting);
+
+    profiler.enable();
+    for (unsigned int step = 0; step < stepCount; ++step)
+    {
+        solver.forward(model);
+    }
+    profiler.disable();
+
+    std::vector<FreeWill::ProfileRecord> records = profiler.records();
+    QVERIFY(records.size() == stepCount);
+
+    for (const FreeWill::ProfileRecord &record : records)
+    {
+        QVERIFY(record.m_hasCounters == isCounting);
+
+        if (isCounting)
+        {
+            QVERIFY(record.m_cycles > 0.0);
+            QVERIFY(record.m_instructions > 0.0);
+            QVERIFY(record.m_cacheMisses >= 0.0);
+            QVERIFY(record.m_fpInstructions >= 0.0);
+        }
+    }
+
+    std::string summary = profiler.summary();
+    QVERIFY(summary.find("IPC") != std::string::npos);
+    QVERIFY(summary.find("roof(%)") != std::string::npos);
+
+    // the roofline column, the last one, is filled in once there is a roofline
+    size_t line = summary.find("DotProductWithBias");
+    QVERIFY(line != std::string::npos);
+    std::string row = summary.substr(line, summary.find('\n', line) - line);
+    QVERIFY(row.substr(row.find_last_of(' ') + 1) != "-");
+
+    const std::string traceFileName = "profilerCountersTest.trace.json";
+    QVERIFY(profiler.writeTrace(traceFileName));
+
+    std::ifstream traceFile(traceFileName);
+    std::stringstream trace;
+    trace << traceFile.rdbuf();
+    QVERIFY((trace.str().find("\"cycles\":") != std::string::npos) == isCounting);
+    std::remove(traceFileName.c_str());
+
+    profiler.enableCounters(false);
+    QVERIFY(!profiler.isCountingEvents());
+    profiler.setRoofline(FreeWill::DeviceType::CPU_NAIVE, 0.0, 0.0);
+    profiler.clear();
+
+    delete model;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+}
+
+void FreeWillUnitTest::trainingMetricsTest()
+{
+    const unsigned int deviceCount = 2;
+    const unsigned int batchSize = 4;
+    const unsigned int inputSize = 5;
+    const unsigned int outputSize = 3;
+    const unsigned int stepCount = 10;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(deviceCount);
+
+    FreeWill::Model *model = FreeWill::Model::create();
+
+    FreeWill::TensorDescriptorHandle input = model->addTensor("input", {inputSize}).enableBatch();
+    FreeWill::TensorDescriptorHandle activation = model->addTensor("activation", {outputSize}).enableBatch();
+    FreeWill::TensorDescriptorHandle weight = model->addTensor("weight", {outputSize, inputSize}).randomize();
+    FreeWill::TensorDescriptorHandle bias = model->addTensor("bias", {outputSize}).randomize();
+    FreeWill::TensorDescriptorHandle weightGrad = model->addTensor("weightGrad", {outputSize, inputSize});
+
+    FreeWill::OperatorDescriptorHandle fullyConnected = model->addOperator("fullyConnected", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                        {{"Input", input}, {"Weight", weight}, {"Bias", bias}},
+                        {{"Output", activation}});
+
+    model->defineForwardPath({fullyConnected});
+    model->defineBackwardPath({});
+    model->defineWeightUpdatePairs({{weight, weightGrad}});
+
+    FreeWill::Solver solver;
+    solver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+    solver.m_batchSize = batchSize;
+    QVERIFY(solver.init(model));
+
+    FreeWill::Profiler &profiler = FreeWill::Profiler::getSingleton();
+
+    // without tracing only the busy time is kept
+    profiler.enable(false);
+
+    for (unsigned int step = 0; step < stepCount; ++step)
+    {
+        solver.forward(model);
+        profiler.endStep(batchSize * deviceCount);
+    }
+
+    FreeWill::TrainingMetrics metrics = profiler.metrics(FreeWill::DeviceType::CPU_NAIVE);
+    profiler.disable();
+
+    QVERIFY(profiler.records().empty());
+    QVERIFY(metrics.m_step == stepCount);
+    QVERIFY(metrics.m_samplesPerSecond > 0.0);
+    QVERIFY(metrics.m_latencyP50 <= metrics.m_latencyP90);
+    QVERIFY(metrics.m_latencyP90 <= metrics.m_latencyP99);
+    QVERIFY(metrics.m_hostMemoryInByte > 0);
+    QVERIFY(metrics.m_devices.size() == deviceCount);
+
+    size_t deviceMemoryInByte = 0;
+
+    for (const FreeWill::DeviceMetrics &device : metrics.m_devices)
+    {
+        QVERIFY(device.m_utilization > 0.0);
+        QVERIFY(device.m_utilization <= 1.0);
+        QVERIFY(device.m_queueDepth == 0);
+        deviceMemoryInByte += device.m_memoryInByte;
+    }
+
+    QVERIFY(deviceMemoryInByte > 0);
+
+    // the throughput is of the steps since the previous call
+    metrics = profiler.metrics(FreeWill::DeviceType::CPU_NAIVE);
+    QVERIFY(metrics.m_step == stepCount);
+    QVERIFY(metrics.m_samplesPerSecond == 0.0);
+    QVERIFY(metrics.m_devices[0].m_utilization == 0.0);
+
+    delete model;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+}
+
+void FreeWillUnitTest::optimizerTest()
+{
+    const unsigned int deviceCount = 2;
+    const unsigned int size = 17;
+    const unsigned int stepCount = 3;
+    const float learningRate = -0.01f;
+    const FreeWill::OptimizerType types[4] = {FreeWill::OptimizerType::MOMENTUM, FreeWill::OptimizerType::NESTEROV,
+                                              FreeWill::OptimizerType::ADAM, FreeWill::OptimizerType::ADAMW};
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(deviceCount);
+
+    for (FreeWill::OptimizerType type : types)
+    {
+        FreeWill::Model *model = FreeWill::Model::create();
+
+        FreeWill::TensorDescriptorHandle weight = model->addTensor("weight", {size});
+        FreeWill::TensorDescriptorHandle grad = model->addTensor("weightGrad", {size});
+
+        model->defineWeightUpdatePairs({{weight, grad}});
+
+        FreeWill::Solver solver;
+        solver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+        solver.m_batchSize = 1;
+        solver.m_optimizer.m_type = type;
+        solver.m_optimizer.m_weightDecay = 0.1;
+        QVERIFY(solver.init(model));
+
+        std::vector<float> expectedWeight(size);
+        std::vector<float> firstState(size, 0.0f);
+        std::vector<float> secondState(size, 0.0f);
+
+        float *weightData = model->beginMutateData(weight);
+        for (unsigned int i = 0; i < size; ++i)
+        {
+            weightData[i] = (float) ((i * 7) % 13) / 13.0f - 0.5f;
+        }
+        expectedWeight.assign(weightData, weightData + size);
+        model->endMutateData(weight);
+
+        for (unsigned int step = 1; step <= stepCount; ++step)
+        {
+            std::vector<float> mergedGrad(size, 0.0f);
+
+            for (unsigned int d = 0; d < deviceCount; ++d)
+            {
+                float *gradData = model->beginMutateData(grad, d);
+                for (unsigned int i = 0; i < size; ++i)
+                {
+                    gradData[i] = (float) ((i * 5 + d * 3 + step) % 11) / 11.0f - 0.3f;
+                    mergedGrad[i] += gradData[i];
+                }
+                model->endMutateData(grad, d);
+            }
+
+            for (unsigned int i = 0; i < size; ++i)
+            {
+                float w = expectedWeight[i];
+                float g = mergedGrad[i];
+
+                if (type == FreeWill::OptimizerType::MOMENTUM || type == FreeWill::OptimizerType::NESTEROV)
+                {
+                    g += 0.1f * w;
+                    firstState[i] = 0.9f * firstState[i] + g;
+                    float update = (type == FreeWill::OptimizerType::NESTEROV) ? g + 0.9f * firstState[i] : firstState[i];
+                    expectedWeight[i] = w + update * learningRate;
+                }
+                else
+                {
+                    if (type == FreeWill::OptimizerType::ADAM)
+                    {
+                        g += 0.1f * w;
+                    }
+
+                    firstState[i] = 0.9f * firstState[i] + 0.1f * g;
+                    secondState[i] = 0.999f * secondState[i] + 0.001f * g * g;
+                    float mean = firstState[i] / (1.0f - std::pow(0.9f, (float) step));
+                    float variance = secondState[i] / (1.0f - std::pow(0.999f, (float) step));
+                    float update = mean / (std::sqrt(variance) + 1e-8f);
+
+                    if (type == FreeWill::OptimizerType::ADAMW)
+                    {
+                        update += 0.1f * w;
+                    }
+
+                    expectedWeight[i] = w + update * learningRate;
+                }
+            }
+
+            solver.update(learningRate);
+        }
+
+        const float *firstReplica = model->readonlyAccess(weight, 0);
+        for (unsigned int i = 0; i < size; ++i)
+        {
+            QVERIFY(std::abs(firstReplica[i] - expectedWeight[i]) < 1e-5f);
+        }
+
+        for (unsigned int d = 1; d < deviceCount; ++d)
+        {
+            const float *weightData = model->readonlyAccess(weight, d);
+            for (unsigned int i = 0; i < size; ++i)
+            {
+                QVERIFY(weightData[i] == firstReplica[i]);
+            }
+        }
+
+        delete model;
+    }
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+}
+
+void FreeWillUnitTest::modelRatesTest()
+{
+    const unsigned int modelCount = 2;
+    const unsigned int modelSize = 3;
+    const unsigned int stepCount = 2;
+    const float learningRate = -0.01f;
+    const std::vector<double> modelRates = {1.0, 0.5};
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(1);
+
+    FreeWill::Model *model = FreeWill::Model::create();
+
+    FreeWill::TensorDescriptorHandle weight = model->addTensor("weight", {modelSize, modelCount});
+    FreeWill::TensorDescriptorHandle grad = model->addTensor("weightGrad", {modelSize, modelCount});
+
+    model->defineWeightUpdatePairs({{weight, grad}});
+
+    // adam doesn't see a scaled gradient, only the rate tells the models apart
+    FreeWill::Solver solver;
+    solver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+    solver.m_batchSize = 1;
+    solver.m_optimizer.m_type = FreeWill::OptimizerType::ADAM;
+    solver.m_optimizer.m_modelRates = modelRates;
+    QVERIFY(solver.init(model));
+
+    std::vector<float> expectedWeight(modelSize * modelCount);
+    std::vector<float> firstState(modelSize * modelCount, 0.0f);
+    std::vector<float> secondState(modelSize * modelCount, 0.0f);
+
+    float *weightData = model->beginMutateData(weight);
+    for (unsigned int i = 0; i < modelSize * modelCount; ++i)
+    {
+        weightData[i] = (float) ((i * 7) % 13) / 13.0f - 0.5f;
+    }
+    expectedWeight.assign(weightData, weightData + modelSize * modelCount);
+    model->endMutateData(weight);
+
+    for (unsigned int step = 1; step <= stepCount; ++step)
+    {
+        float *gradData = model->beginMutateData(grad);
+        for (unsigned int i = 0; i < modelSize * modelCount; ++i)
+        {
+            // the same gradient for both models
+            float g = gradData[i] = (float) (((i % modelSize) * 5 + step) % 11) / 11.0f - 0.3f;
+
+            firstState[i] = 0.9f * firstState[i] + 0.1f * g;
+            secondState[i] = 0.999f * secondState[i] + 0.001f * g * g;
+            float mean = firstState[i] / (1.0f - std::pow(0.9f, (float) step));
+            float variance = secondState[i] / (1.0f - std::pow(0.999f, (float) step));
+
+            expectedWeight[i] += mean / (std::sqrt(variance) + 1e-8f) * learningRate * (float) modelRates[i / modelSize];
+        }
+        model->endMutateData(grad);
+
+        solver.update(learningRate);
+    }
+
+    const float *updatedWeight = model->readonlyAccess(weight);
+    for (unsigned int i = 0; i < modelSize * modelCount; ++i)
+    {
+        QVERIFY(std::abs(updatedWeight[i] - expectedWeight[i]) < 1e-5f);
+    }
+
+    delete model;
+
+    // the last dimension has to split between the models
+    model = FreeWill::Model::create();
+
+    weight = model->addTensor("weight", {modelSize, modelCount});
+    grad = model->addTensor("weightGrad", {modelSize, modelCount});
+
+    model->defineWeightUpdatePairs({{weight, grad}});
+
+    FreeWill::Solver mismatchedSolver;
+    mismatchedSolver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+    mismatchedSolver.m_batchSize = 1;
+    mismatchedSolver.m_optimizer.m_modelRates = {1.0, 0.5, 0.25};
+    QVERIFY(!mismatchedSolver.init(model));
+
+    delete model;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+}
+
+void FreeWillUnitTest::overlapGradientReduceTest()
+{
+    const unsigned int deviceCount = 3;
+    const unsigned int batchSize = 4;
+    const unsigned int inputSize = 6;
+    const unsigned int hiddenSize = 10;
+    const unsigned int outputSize = 3;
+    const unsigned int weightSizes[2] = {hiddenSize * inputSize, outputSize * hiddenSize};
+    const unsigned int biasSizes[2] = {hiddenSize, outputSize};
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(deviceCount);
+
+    std::vector<float> results[2];
+
+    for (unsigned int run = 0; run < 2; ++run)
+    {
+        FreeWill::Model *model = FreeWill::Model::create();
+
+        FreeWill::TensorDescriptorHandle input = model->addTensor("input", {inputSize}).enableBatch();
+        FreeWill::TensorDescriptorHandle activation = model->addTensor("activation", {hiddenSize}).enableBatch();
+        FreeWill::TensorDescriptorHandle output = model->addTensor("output", {outputSize}).enableBatch();
+        FreeWill::TensorDescriptorHandle outputDelta = model->addTensor("outputDelta", {outputSize}).enableBatch();
+        FreeWill::TensorDescriptorHandle delta = model->addTensor("delta", {hiddenSize}).enableBatch();
+        FreeWill::TensorDescriptorHandle inputDelta = model->addTensor("inputDelta", {inputSize}).enableBatch();
+
+        FreeWill::TensorDescriptorHandle weights[2] = {model->addTensor("weight1", {hiddenSize, inputSize}),
+                                                       model->addTensor("weight2", {outputSize, hiddenSize})};
+        FreeWill::TensorDescriptorHandle biases[2] = {model->addTensor("bias1", {hiddenSize}),
+                                                      model->addTensor("bias2", {outputSize})};
+        FreeWill::TensorDescriptorHandle weightGrads[2] = {model->addTensor("weightGrad1", {hiddenSize, inputSize}),
+                                                           model->addTensor("weightGrad2", {outputSize, hiddenSize})};
+        FreeWill::TensorDescriptorHandle biasGrads[2] = {model->addTensor("biasGrad1", {hiddenSize}),
+                                                         model->addTensor("biasGrad2", {outputSize})};
+
+        FreeWill::OperatorDescriptorHandle fullyConnected1 = model->addOperator("fullyConnected1", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                            {{"Input", input}, {"Weight", weights[0]}, {"Bias", biases[0]}}, {{"Output", activation}});
+        FreeWill::OperatorDescriptorHandle sigmoid = model->addOperator("sigmoid", FreeWill::OperatorName::ACTIVATION,
+                            {{"Input", activation}}, {{"Output", activation}}, {{"Mode", FreeWill::ActivationMode::SIGMOID}});
+        FreeWill::OperatorDescriptorHandle fullyConnected2 = model->addOperator("fullyConnected2", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                            {{"Input", activation}, {"Weight", weights[1]}, {"Bias", biases[1]}}, {{"Output", output}});
+
+        FreeWill::OperatorDescriptorHandle fullyConnected2Derivative = model->addOperator("fullyConnected2Derivative", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS_DERIVATIVE,
+                            {{"InputActivation", activation}, {"OutputDelta", outputDelta}, {"Weight", weights[1]}},
+                            {{"WeightGrad", weightGrads[1]}, {"BiasGrad", biasGrads[1]}, {"InputDelta", delta}});
+        FreeWill::OperatorDescriptorHandle sigmoidDerivative = model->addOperator("sigmoidDerivative", FreeWill::OperatorName::ACTIVATION_DERIVATIVE,
+                            {{"Output", activation}, {"OutputDelta", delta}}, {{"InputDelta", delta}}, {{"Mode", FreeWill::ActivationMode::SIGMOID}});
+        FreeWill::OperatorDescriptorHandle fullyConnected1Derivative = model->addOperator("fullyConnected1Derivative", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS_DERIVATIVE,
+                            {{"InputActivation", input}, {"OutputDelta", delta}, {"Weight", weights[0]}},
+                            {{"WeightGrad", weightGrads[0]}, {"BiasGrad", biasGrads[0]}, {"InputDelta", inputDelta}});
+
+        model->defineForwardPath({fullyConnected1, sigmoid, fullyConnected2});
+        model->defineBackwardPath({fullyConnected2Derivative, sigmoidDerivative, fullyConnected1Derivative});
+        model->defineWeightUpdatePairs({{weights[0], weightGrads[0]}, {weights[1], weightGrads[1]},
+                                        {biases[0], biasGrads[0]}, {biases[1], biasGrads[1]}});
+
+        FreeWill::Solver solver;
+        solver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+        solver.m_batchSize = batchSize;
+        solver.m_overlapGradientReduce = (run == 1);
+        solver.m_optimizer.m_type = FreeWill::OptimizerType::MOMENTUM;
+        QVERIFY(solver.init(model));
+
+        for (unsigned int l = 0; l < 2; ++l)
+        {
+            float *weightData = model->beginMutateData(weights[l]);
+            for (unsigned int i = 0; i < weightSizes[l]; ++i)
+            {
+                weightData[i] = (float) ((i * 7 + l) % 13) / 13.0f - 0.5f;
+            }
+            model->endMutateData(weights[l]);
+
+            float *biasData = model->beginMutateData(biases[l]);
+            for (unsigned int i = 0; i < biasSizes[l]; ++i)
+            {
+                biasData[i] = (float) i / (float) biasSizes[l] - 0.5f;
+            }
+            model->endMutateData(biases[l]);
+        }
+
+        for (unsigned int step = 0; step < 3; ++step)
+        {
+            for (unsigned int d = 0; d < deviceCount; ++d)
+            {
+                float *inputData = model->beginMutateData(input, d);
+                for (unsigned int i = 0; i < inputSize * batchSize; ++i)
+                {
+                    inputData[i] = (float) ((i * 3 + d + step) % 11) / 11.0f - 0.5f;
+                }
+                model->endMutateData(input, d);
+
+                float *outputDeltaData = model->beginMutateData(outputDelta, d);
+                for (unsigned int i = 0; i < outputSize * batchSize; ++i)
+                {
+                    outputDeltaData[i] = (float) ((i * 5 + d + step) % 7) / 7.0f - 0.5f;
+                }
+                model->endMutateData(outputDelta, d);
+            }
+
+            solver.forward(model);
+
+            for (unsigned int l = 0; l < 2; ++l)
+            {
+                model->clearTensor(weightGrads[l]);
+                model->clearTensor(biasGrads[l]);
+            }
+
+            solver.backward(model);
+            solver.update(-0.1);
+        }
+
+        for (unsigned int l = 0; l < 2; ++l)
+        {
+            for (unsigned int d = 0; d < deviceCount; ++d)
+            {
+                const float *weightData = model->readonlyAccess(weights[l], d);
+                const float *biasData = model->readonlyAccess(biases[l], d);
+
+                if (d == 0)
+                {
+                    results[run].insert(results[run].end(), weightData, weightData + weightSizes[l]);
+                    results[run].insert(results[run].end(), biasData, biasData + biasSizes[l]);
+                }
+                else
+                {
+                    const float *firstWeightData = model->readonlyAccess(weights[l], 0);
+                    const float *firstBiasData = model->readonlyAccess(biases[l], 0);
+                    QVERIFY(std::equal(weightData, weightData + weightSizes[l], firstWeightData));
+                    QVERIFY(std::equal(biasData, biasData + biasSizes[l], firstBiasData));
+                }
+            }
+        }
+
+        delete model;
+    }
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+
+    QVERIFY(results[0].size() == results[1].size());
+
+    for (unsigned int i = 0; i < results[0].size(); ++i)
+    {
+        QVERIFY(results[0][i] == results[1][i]);
+    }
+}
+
+void FreeWillUnitTest::pipelineTest()
+{
+    const unsigned int deviceCount = 2;
+    const unsigned int batchSize = 4;
+    const unsigned int inputSize = 6;
+    const unsigned int hiddenSize = 10;
+    const unsigned int outputSize = 3;
+    const unsigned int weightSizes[2] = {hiddenSize * inputSize, outputSize * hiddenSize};
+    const unsigned int biasSizes[2] = {hiddenSize, outputSize};
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(deviceCount);
+
+    // run 0 replicates the model on both devices, run 1 splits it into two stages and the
+    // batch into two micro-batches
+    std::vector<float> outputs[2];
+    std::vector<float> results[2];
+
+    for (unsigned int run = 0; run < 2; ++run)
+    {
+        FreeWill::Model *model = FreeWill::Model::create();
+
+        FreeWill::TensorDescriptorHandle input = model->addTensor("input", {inputSize}).enableBatch();
+        FreeWill::TensorDescriptorHandle activation = model->addTensor("activation", {hiddenSize}).enableBatch();
+        FreeWill::TensorDescriptorHandle output = model->addTensor("output", {outputSize}).enableBatch();
+        FreeWill::TensorDescriptorHandle outputDelta = model->addTensor("outputDelta", {outputSize}).enableBatch();
+        FreeWill::TensorDescriptorHandle delta = model->addTensor("delta", {hiddenSize}).enableBatch();
+        FreeWill::TensorDescriptorHandle inputDelta = model->addTensor("inputDelta", {inputSize}).enableBatch();
+
+        FreeWill::TensorDescriptorHandle weights[2] = {model->addTensor("weight1", {hiddenSize, inputSize}),
+                                                       model->addTensor("weight2", {outputSize, hiddenSize})};
+        FreeWill::TensorDescriptorHandle biases[2] = {model->addTensor("bias1", {hiddenSize}),
+                                                      model->addTensor("bias2", {outputSize})};
+        FreeWill::TensorDescriptorHandle weightGrads[2] = {model->addTensor("weightGrad1", {hiddenSize, inputSize}),
+                                                           model->addTensor("weightGrad2", {outputSize, hiddenSize})};
+        FreeWill::TensorDescriptorHandle biasGrads[2] = {model->addTensor("biasGrad1", {hiddenSize}),
+                                                         model->addTensor("biasGrad2", {outputSize})};
+
+        FreeWill::OperatorDescriptorHandle fullyConnected1 = model->addOperator("fullyConnected1", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                            {{"Input", input}, {"Weight", weights[0]}, {"Bias", biases[0]}}, {{"Output", activation}});
+        FreeWill::OperatorDescriptorHandle sigmoid = model->addOperator("sigmoid", FreeWill::OperatorName::ACTIVATION,
+                            {{"Input", activation}}, {{"Output", activation}}, {{"Mode", FreeWill::ActivationMode::SIGMOID}});
+        FreeWill::OperatorDescriptorHandle fullyConnected2 = model->addOperator("fullyConnected2", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                            {{"Input", activation}, {"Weight", weights[1]}, {"Bias", biases[1]}}, {{"Output", output}});
+
+        FreeWill::OperatorDescriptorHandle fullyConnected2Derivative = model->addOperator("fullyConnected2Derivative", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS_DERIVATIVE,
+                            {{"InputActivation", activation}, {"OutputDelta", outputDelta}, {"Weight", weights[1]}},
+                            {{"WeightGrad", weightGrads[1]}, {"BiasGrad", biasGrads[1]}, {"InputDelta", delta}});
+        FreeWill::OperatorDescriptorHandle sigmoidDerivative = model->addOperator("sigmoidDerivative", FreeWill::OperatorName::ACTIVATION_DERIVATIVE,
+                            {{"Output", activation}, {"OutputDelta", delta}}, {{"InputDelta", delta}}, {{"Mode", FreeWill::ActivationMode::SIGMOID}});
+        FreeWill::OperatorDescriptorHandle fullyConnected1Derivative = model->addOperator("fullyConnected1Derivative", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS_DERIVATIVE,
+                            {{"InputActivation", input}, {"OutputDelta", delta}, {"Weight", weights[0]}},
+                            {{"WeightGrad", weightGrads[0]}, {"BiasGrad", biasGrads[0]}, {"InputDelta", inputDelta}});
+
+        model->defineForwardPath({fullyConnected1, sigmoid, fullyConnected2});
+        model->defineBackwardPath({fullyConnected2Derivative, sigmoidDerivative, fullyConnected1Derivative});
+        model->defineWeightUpdatePairs({{weights[0], weightGrads[0]}, {weights[1], weightGrads[1]},
+                                        {biases[0], biasGrads[0]}, {biases[1], biasGrads[1]}});
+
+        FreeWill::Solver solver;
+        solver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+        solver.m_batchSize = batchSize;
+
+        if (run == 1)
+        {
+            QVERIFY(!model->placeOperators({"unknown"}, 0));
+            QVERIFY(model->placeOperators({fullyConnected1, sigmoid, fullyConnected1Derivative}, 0));
+            QVERIFY(model->placeOperators({fullyConnected2, fullyConnected2Derivative, sigmoidDerivative}, 1));
+            QVERIFY(model->isPipelined());
+            solver.m_microBatchCount = 2;
+        }
+
+        QVERIFY(solver.init(model));
+
+        for (unsigned int l = 0; l < 2; ++l)
+        {
+            float *weightData = model->beginMutateData(weights[l]);
+            for (unsigned int i = 0; i < weightSizes[l]; ++i)
+            {
+                weightData[i] = (float) ((i * 7 + l) % 13) / 13.0f - 0.5f;
+            }
+            model->endMutateData(weights[l]);
+
+            float *biasData = model->beginMutateData(biases[l]);
+            for (unsigned int i = 0; i < biasSizes[l]; ++i)
+            {
+                biasData[i] = (float) i / (float) biasSizes[l] - 0.5f;
+            }
+            model->endMutateData(biases[l]);
+        }
+
+        for (unsigned int step = 0; step < 3; ++step)
+        {
+            float *inputData = model->beginMutateData(input);
+            for (unsigned int i = 0; i < inputSize * batchSize; ++i)
+            {
+                inputData[i] = (float) ((i * 3 + step) % 11) / 11.0f - 0.5f;
+            }
+            model->endMutateData(input);
+
+            float *outputDeltaData = model->beginMutateData(outputDelta);
+            for (unsigned int i = 0; i < outputSize * batchSize; ++i)
+            {
+                outputDeltaData[i] = (float) ((i * 5 + step) % 7) / 7.0f - 0.5f;
+            }
+            model->endMutateData(outputDelta);
+
+            solver.forward(model);
+
+            // every micro-batch's window is written and the whole batch is viewed again
+            QVERIFY(model->batchSize() == batchSize);
+            const float *outputData = model->readonlyAccess(output);
+            outputs[run].insert(outputs[run].end(), outputData, outputData + outputSize * batchSize);
+
+            for (unsigned int l = 0; l < 2; ++l)
+            {
+                model->clearTensor(weightGrads[l]);
+                model->clearTensor(biasGrads[l]);
+            }
+
+            solver.backward(model);
+
+            // the replicas of run 0 merge two copies of the batch's gradient
+            solver.update(run == 0 ? -0.05 : -0.1);
+        }
+
+        for (unsigned int l = 0; l < 2; ++l)
+        {
+            const float *weightData = model->readonlyAccess(weights[l]);
+            const float *biasData = model->readonlyAccess(biases[l]);
+
+            results[run].insert(results[run].end(), weightData, weightData + weightSizes[l]);
+            results[run].insert(results[run].end(), biasData, biasData + biasSizes[l]);
+        }
+
+        delete model;
+    }
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+
+    QVERIFY(outputs[0].size() == outputs[1].size());
+    QVERIFY(results[0].size() == results[1].size());
+
+    for (unsigned int i = 0; i < outputs[0].size(); ++i)
+    {
+        QVERIFY(std::abs(outputs[0][i] - outputs[1][i]) < 1e-5f);
+    }
+
+    for (unsigned int i = 0; i < results[0].size(); ++i)
+    {
+        QVERIFY(std::abs(results[0][i] - results[1][i]) < 1e-5f);
+    }
+}
+
+void FreeWillUnitTest::gradientAccumulationTest()
+{
+    const unsigned int deviceCount = 2;
+    const unsigned int batchSize = 4;
+    const unsigned int microBatchCount = 2;
+    const unsigned int inputSize = 6;
+    const unsigned int hiddenSize = 10;
+    const unsigned int outputSize = 3;
+    const unsigned int weightSizes[2] = {hiddenSize * inputSize, outputSize * hiddenSize};
+    const unsigned int biasSizes[2] = {hiddenSize, outputSize};
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(deviceCount);
+
+    // run 0 takes the whole batch in one pass, run 1 accumulates it over two micro-batches
+    std::vector<float> results[2];
+
+    for (unsigned int run = 0; run < 2; ++run)
+    {
+        unsigned int passCount = run == 0 ? 1 : microBatchCount;
+        unsigned int passBatchSize = batchSize / passCount;
+
+        FreeWill::Model *model = FreeWill::Model::create();
+
+        FreeWill::TensorDescriptorHandle input = model->addTensor("input", {inputSize}).enableBatch();
+        FreeWill::TensorDescriptorHandle activation = model->addTensor("activation", {hiddenSize}).enableBatch();
+        FreeWill::TensorDescriptorHandle output = model->addTensor("output", {outputSize}).enableBatch();
+        FreeWill::TensorDescriptorHandle outputDelta = model->addTensor("outputDelta", {outputSize}).enableBatch();
+        FreeWill::TensorDescriptorHandle delta = model->addTensor("delta", {hiddenSize}).enableBatch();
+        FreeWill::TensorDescriptorHandle inputDelta = model->addTensor("inputDelta", {inputSize}).enableBatch();
+
+        FreeWill::TensorDescriptorHandle weights[2] = {model->addTensor("weight1", {hiddenSize, inputSize}),
+                                                       model->addTensor("weight2", {outputSize, hiddenSize})};
+        FreeWill::TensorDescriptorHandle biases[2] = {model->addTensor("bias1", {hiddenSize}),
+                                                      model->addTensor("bias2", {outputSize})};
+        FreeWill::TensorDescriptorHandle weightGrads[2] = {model->addTensor("weightGrad1", {hiddenSize, inputSize}),
+                                                           model->addTensor("weightGrad2", {outputSize, hiddenSize})};
+        FreeWill::TensorDescriptorHandle biasGrads[2] = {model->addTensor("biasGrad1", {hiddenSize}),
+                                                         model->addTensor("biasGrad2", {outputSize})};
+
+        FreeWill::OperatorDescriptorHandle fullyConnected1 = model->addOperator("fullyConnected1", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                            {{"Input", input}, {"Weight", weights[0]}, {"Bias", biases[0]}}, {{"Output", activation}});
+        FreeWill::OperatorDescriptorHandle sigmoid = model->addOperator("sigmoid", FreeWill::OperatorName::ACTIVATION,
+                            {{"Input", activation}}, {{"Output", activation}}, {{"Mode", FreeWill::ActivationMode::SIGMOID}});
+        FreeWill::OperatorDescriptorHandle fullyConnected2 = model->addOperator("fullyConnected2", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                            {{"Input", activation}, {"Weight", weights[1]}, {"Bias", biases[1]}}, {{"Output", output}});
+
+        FreeWill::OperatorDescriptorHandle fullyConnected2Derivative = model->addOperator("fullyConnected2Derivative", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS_DERIVATIVE,
+                            {{"InputActivation", activation}, {"OutputDelta", outputDelta}, {"Weight", weights[1]}},
+                            {{"WeightGrad", weightGrads[1]}, {"BiasGrad", biasGrads[1]}, {"InputDelta", delta}});
+        FreeWill::OperatorDescriptorHandle sigmoidDerivative = model->addOperator("sigmoidDerivative", FreeWill::OperatorName::ACTIVATION_DERIVATIVE,
+                            {{"Output", activation}, {"OutputDelta", delta}}, {{"InputDelta", delta}}, {{"Mode", FreeWill::ActivationMode::SIGMOID}});
+        FreeWill::OperatorDescriptorHandle fullyConnected1Derivative = model->addOperator("fullyConnected1Derivative", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS_DERIVATIVE,
+                            {{"InputActivation", input}, {"OutputDelta", delta}, {"Weight", weights[0]}},
+                            {{"WeightGrad", weightGrads[0]}, {"BiasGrad", biasGrads[0]}, {"InputDelta", inputDelta}});
+
+        model->defineForwardPath({fullyConnected1, sigmoid, fullyConnected2});
+        model->defineBackwardPath({fullyConnected2Derivative, sigmoidDerivative, fullyConnected1Derivative});
+        model->defineWeightUpdatePairs({{weights[0], weightGrads[0]}, {weights[1], weightGrads[1]},
+                                        {biases[0], biasGrads[0]}, {biases[1], biasGrads[1]}});
+
+        FreeWill::Solver solver;
+        solver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+        solver.m_batchSize = passBatchSize;
+
+        solver.m_gradientAccumulationCount = 0;
+        QVERIFY(!solver.init(model));
+
+        solver.m_gradientAccumulationCount = passCount;
+        QVERIFY(solver.init(model));
+        QVERIFY(model->batchSize() == passBatchSize);
+
+        for (unsigned int l = 0; l < 2; ++l)
+        {
+            float *weightData = model->beginMutateData(weights[l]);
+            for (unsigned int i = 0; i < weightSizes[l]; ++i)
+            {
+                weightData[i] = (float) ((i * 7 + l) % 13) / 13.0f - 0.5f;
+            }
+            model->endMutateData(weights[l]);
+
+            float *biasData = model->beginMutateData(biases[l]);
+            for (unsigned int i = 0; i < biasSizes[l]; ++i)
+            {
+                biasData[i] = (float) i / (float) biasSizes[l] - 0.5f;
+            }
+            model->endMutateData(biases[l]);
+        }
+
+        for (unsigned int step = 0; step < 3; ++step)
+        {
+            // cleared once, the passes of the step add up their gradients
+            for (unsigned int l = 0; l < 2; ++l)
+            {
+                model->clearTensor(weightGrads[l]);
+                model->clearTensor(biasGrads[l]);
+            }
+
+            for (unsigned int pass = 0; pass < passCount; ++pass)
+            {
+                unsigned int firstInput = pass * passBatchSize * inputSize;
+                unsigned int firstOutput = pass * passBatchSize * outputSize;
+
+                float *inputData = model->beginMutateData(input);
+                for (unsigned int i = 0; i < inputSize * passBatchSize; ++i)
+                {
+                    inputData[i] = (float) (((firstInput + i) * 3 + step) % 11) / 11.0f - 0.5f;
+                }
+                model->endMutateData(input);
+
+                float *outputDeltaData = model->beginMutateData(outputDelta);
+                for (unsigned int i = 0; i < outputSize * passBatchSize; ++i)
+                {
+                    outputDeltaData[i] = (float) (((firstOutput + i) * 5 + step) % 7) / 7.0f - 0.5f;
+                }
+                model->endMutateData(outputDelta);
+
+                solver.forward(model);
+                solver.backward(model);
+            }
+
+            solver.update(-0.05);
+        }
+
+        for (unsigned int l = 0; l < 2; ++l)
+        {
+            const float *weightData = model->readonlyAccess(weights[l]);
+            const float *biasData = model->readonlyAccess(biases[l]);
+
+            results[run].insert(results[run].end(), weightData, weightData + weightSizes[l]);
+            results[run].insert(results[run].end(), biasData, biasData + biasSizes[l]);
+        }
+
+        delete model;
+    }
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+
+    QVERIFY(results[0].size() == results[1].size());
+
+    for (unsigned int i = 0; i < results[0].size(); ++i)
+    {
+        QVERIFY(std::abs(results[0][i] - results[1][i]) < 1e-5f);
+    }
+}
+
+void FreeWillUnitTest::operatorFusionTest()
+{
+    const unsigned int batchSize = 3;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(1);
+
+    std::vector<float> results[2];
+
+    for (unsigned int run = 0; run < 2; ++run)
+    {
+        FreeWill::Model *model = FreeWill::Model::create();
+
+        FreeWill::TensorDescriptorHandle image = model->addTensor("image", {8, 6, 6}).enableBatch();
+        FreeWill::TensorDescriptorHandle convOutput1 = model->addTensor("convOutput1", {8, 4, 4}).enableBatch();
+        FreeWill::TensorDescriptorHandle convOutput2 = model->addTensor("convOutput2", {4, 4, 4}).enableBatch();
+        FreeWill::TensorDescriptorHandle features = model->addTensor("features", {12}).enableBatch();
+        FreeWill::TensorDescriptorHandle output = model->addTensor("output", {5}).enableBatch();
+
+        FreeWill::TensorDescriptorHandle parameters[6] = {model->addTensor("featureMap1", {8, 3, 3, 8}),
+                                                          model->addTensor("bias1", {8}),
+                                                          model->addTensor("featureMap2", {8, 1, 1, 4}),
+                                                          model->addTensor("bias2", {4}),
+                                                          model->addTensor("weight", {5, 12}),
+                                                          model->addTensor("bias3", {5})};
+        unsigned int parameterSizes[6] = {8 * 3 * 3 * 8, 8, 8 * 4, 4, 5 * 12, 5};
+
+        // winograd, pointwise gemm and fully connected epilogues
+        FreeWill::OperatorDescriptorHandle convolution1 = model->addOperator("convolution1", FreeWill::OperatorName::CONVOLUTION,
+                            {{"Input", image}, {"FeatureMap", parameters[0]}, {"Bias", parameters[1]}}, {{"Output", convOutput1}});
+        FreeWill::OperatorDescriptorHandle sigmoid1 = model->addOperator("sigmoid1", FreeWill::OperatorName::ACTIVATION,
+                            {{"Input", convOutput1}}, {{"Output", convOutput1}}, {{"Mode", FreeWill::ActivationMode::SIGMOID}});
+        FreeWill::OperatorDescriptorHandle convolution2 = model->addOperator("convolution2", FreeWill::OperatorName::CONVOLUTION,
+                            {{"Input", convOutput1}, {"FeatureMap", parameters[2]}, {"Bias", parameters[3]}}, {{"Output", convOutput2}});
+        FreeWill::OperatorDescriptorHandle relu = model->addOperator("relu", FreeWill::OperatorName::ACTIVATION,
+                            {{"Input", convOutput2}}, {{"Output", convOutput2}}, {{"Mode", FreeWill::ActivationMode::RELU}});
+        FreeWill::OperatorDescriptorHandle fullyConnected = model->addOperator("fullyConnected", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                            {{"Input", features}, {"Weight", parameters[4]}, {"Bias", parameters[5]}}, {{"Output", output}});
+        FreeWill::OperatorDescriptorHandle sigmoid2 = model->addOperator("sigmoid2", FreeWill::OperatorName::ACTIVATION,
+                            {{"Input", output}}, {{"Output", output}}, {{"Mode", FreeWill::ActivationMode::SIGMOID}});
+
+        model->defineForwardPath({convolution1, sigmoid1, convolution2, relu, fullyConnected, sigmoid2});
+        model->defineBackwardPath({});
+        model->defineWeightUpdatePairs({{parameters[4], model->addTensor("weightGrad", {5, 12})}});
+
+        FreeWill::Solver solver;
+        solver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+        solver.m_batchSize = batchSize;
+        solver.m_fuseOperators = (run == 1);
+        QVERIFY(solver.init(model));
+
+        for (unsigned int p = 0; p < 6; ++p)
+        {
+            float *data = model->beginMutateData(parameters[p]);
+            for (unsigned int i = 0; i < parameterSizes[p]; ++i)
+            {
+                data[i] = (float) ((i * 7 + p) % 13) / 13.0f - 0.5f;
+            }
+            model->endMutateData(parameters[p]);
+        }
+
+        float *imageData = model->beginMutateData(image);
+        for (unsigned int i = 0; i < 8 * 6 * 6 * batchSize; ++i)
+        {
+            imageData[i] = (float) ((i * 5) % 11) / 11.0f - 0.5f;
+        }
+        model->endMutateData(image);
+
+        float *featureData = model->beginMutateData(features);
+        for (unsigned int i = 0; i < 12 * batchSize; ++i)
+        {
+            featureData[i] = (float) ((i * 3) % 7) / 7.0f - 0.5f;
+        }
+        model->endMutateData(features);
+
+        model->clearTensor(convOutput1);
+        model->clearTensor(convOutput2);
+
+        solver.forward(model);
+
+        const float *outputData = model->readonlyAccess(output);
+        results[run].assign(outputData, outputData + 5 * batchSize);
+
+        const float *convOutputData = model->readonlyAccess(convOutput2);
+        results[run].insert(results[run].end(), convOutputData, convOutputData + 4 * 4 * 4 * batchSize);
+
+        delete model;
+    }
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+
+    QVERIFY(results[0].size() == results[1].size());
+
+    for (unsigned int i = 0; i < results[0].size(); ++i)
+    {
+        QVERIFY(results[0][i] == results[1][i]);
+    }
+}
+
+void FreeWillUnitTest::mixedPrecisionTest()
+{
+    QVERIFY((float) FreeWill::Half(1.0f) == 1.0f);
+    QVERIFY((float) FreeWill::Half(65504.0f) == 65504.0f);
+    QVERIFY(std::isinf((float) FreeWill::Half(65520.0f)));
+    QVERIFY(std::isnan((float) FreeWill::Half(std::nanf(""))));
+    QVERIFY((float) FreeWill::Half(std::ldexp(1.0f, -24)) == std::ldexp(1.0f, -24));
+    QVERIFY((float) FreeWill::Half(1.0f + std::ldexp(1.0f, -11)) == 1.0f);
+    QVERIFY((float) FreeWill::Half(1.0f + 3.0f * std::ldexp(1.0f, -11)) == 1.0f + std::ldexp(1.0f, -9));
+    QVERIFY((float) FreeWill::BFloat16(1.0f + std::ldexp(1.0f, -8)) == 1.0f);
+    QVERIFY((float) FreeWill::BFloat16(-3.0f) == -3.0f);
+    QVERIFY(std::isnan((float) FreeWill::BFloat16(std::nanf(""))));
+
+    const unsigned int deviceCount = 2;
+    const unsigned int size = 17;
+    const float learningRate = -0.01f;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(deviceCount);
+
+    for (unsigned int run = 0; run < 2; ++run)
+    {
+        bool isLossScaled = (run == 1);
+
+        FreeWill::Model *model = FreeWill::Model::create();
+
+        FreeWill::TensorDescriptorHandle weight = model->addTensor("weight", {size}, FreeWill::DataType::HALF);
+        FreeWill::TensorDescriptorHandle grad = model->addTensor("weightGrad", {size}, FreeWill::DataType::HALF);
+
+        model->defineWeightUpdatePairs({{weight, grad}});
+
+        FreeWill::Solver solver;
+        solver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+        solver.m_batchSize = 1;
+        solver.m_lossScaling.m_isEnabled = isLossScaled;
+        QVERIFY(solver.init(model));
+
+        FreeWill::TensorDescriptorHandle masterWeight(model, "weight_master", {size});
+
+        std::vector<float> expectedWeight(size);
+
+        FreeWill::Half *weightData = model->beginMutateData<FreeWill::DeviceType::CPU_NAIVE, FreeWill::Half>(weight);
+        for (unsigned int i = 0; i < size; ++i)
+        {
+            weightData[i] = (float) ((i * 7) % 13) / 13.0f - 0.5f;
+            expectedWeight[i] = weightData[i];
+        }
+        model->endMutateData(weight);
+
+        for (unsigned int step = 1; step <= 3; ++step)
+        {
+            // the first loss scaled step overflows and has to be skipped
+            bool isOverflowing = isLossScaled && step == 1;
+            double lossScale = solver.lossScale();
+            std::vector<float> mergedGrad(size, 0.0f);
+
+            for (unsigned int d = 0; d < deviceCount; ++d)
+            {
+                FreeWill::Half *gradData = model->beginMutateData<FreeWill::DeviceType::CPU_NAIVE, FreeWill::Half>(grad, d);
+                for (unsigned int i = 0; i < size; ++i)
+                {
+                    gradData[i] = (float) ((i * 5 + d * 3 + step) % 11) / 11.0f - 0.3f;
+                    mergedGrad[i] += gradData[i];
+                }
+
+                if (isOverflowing && d == 1)
+                {
+                    gradData[3] = std::numeric_limits<float>::infinity();
+                }
+                model->endMutateData(grad, d);
+            }
+
+            if (!isOverflowing)
+            {
+                // the replicas are merged into the 16-bit gradient before the step
+                for (unsigned int i = 0; i < size; ++i)
+                {
+                    expectedWeight[i] += (float) FreeWill::Half(mergedGrad[i]) * (float) (1.0 / lossScale) * learningRate;
+                }
+            }
+
+            solver.update(learningRate);
+
+            if (isOverflowing)
+            {
+                QVERIFY(solver.skippedStepCount() == 1);
+                QVERIFY(solver.lossScale() == lossScale * 0.5);
+            }
+        }
+
+        QVERIFY(solver.skippedStepCount() == (isLossScaled ? 1 : 0));
+
+        const float *masterData = model->readonlyAccess(masterWeight);
+        for (unsigned int i = 0; i < size; ++i)
+        {
+            QVERIFY(std::abs(masterData[i] - expectedWeight[i]) < 1e-6f);
+        }
+
+        for (unsigned int d = 0; d < deviceCount; ++d)
+        {
+            const FreeWill::Half *weightData = model->readonlyAccess<FreeWill::DeviceType::CPU_NAIVE, FreeWill::Half>(weight, d);
+            for (unsigned int i = 0; i < size; ++i)
+            {
+                QVERIFY(weightData[i].m_bits == FreeWill::Half(masterData[i]).m_bits);
+            }
+        }
+
+        delete model;
+    }
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+}
+
+void FreeWillUnitTest::lossScaledSigmoidLossTest()
+{
+    const unsigned int batchSize = 3;
+    const float learningRate = -0.1f;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(1);
+
+    std::vector<float> weights[2];
+
+    for (unsigned int run = 0; run < 2; ++run)
+    {
+        bool isLossScaled = (run == 1);
+
+        FreeWill::Model *model = FreeWill::Model::create();
+
+        FreeWill::TensorDescriptorHandle features = model->addTensor("features", {4}).enableBatch();
+        FreeWill::TensorDescriptorHandle featuresGrad = model->addTensor("featuresGrad", {4}).enableBatch();
+        FreeWill::TensorDescriptorHandle output = model->addTensor("output", {2}).enableBatch();
+        FreeWill::TensorDescriptorHandle outputGrad = model->addTensor("outputGrad", {2}).enableBatch();
+        FreeWill::TensorDescriptorHandle label = model->addTensor("label", {2}).enableBatch();
+        FreeWill::TensorDescriptorHandle weight = model->addTensor("weight", {2, 4});
+        FreeWill::TensorDescriptorHandle bias = model->addTensor("bias", {2});
+        FreeWill::TensorDescriptorHandle weightGrad = model->addTensor("weightGrad", {2, 4});
+        FreeWill::TensorDescriptorHandle biasGrad = model->addTensor("biasGrad", {2});
+
+        FreeWill::OperatorDescriptorHandle fullyConnected = model->addOperator("fullyConnected", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                            {{"Input", features}, {"Weight", weight}, {"Bias", bias}}, {{"Output", output}});
+        FreeWill::OperatorDescriptorHandle sigmoid = model->addOperator("sigmoid", FreeWill::OperatorName::ACTIVATION,
+                            {{"Input", output}}, {{"Output", output}}, {{"Mode", FreeWill::ActivationMode::SIGMOID}});
+        FreeWill::OperatorDescriptorHandle lossDerivative = model->addOperator("lossDerivative", FreeWill::OperatorName::SIGMOID_CROSS_ENTROPY_LOSS_DERIVATIVE,
+                            {{"Input", output}, {"Label", label}}, {{"Output", outputGrad}});
+        FreeWill::OperatorDescriptorHandle fullyConnectedDerivative = model->addOperator("fullyConnectedDerivative", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS_DERIVATIVE,
+                            {{"InputActivation", features}, {"OutputDelta", outputGrad}, {"Weight", weight}},
+                            {{"WeightGrad", weightGrad}, {"BiasGrad", biasGrad}, {"InputDelta", featuresGrad}});
+
+        model->defineForwardPath({fullyConnected, sigmoid});
+        model->defineBackwardPath({lossDerivative, fullyConnectedDerivative});
+        model->defineWeightUpdatePairs({{weight, weightGrad}, {bias, biasGrad}});
+
+        FreeWill::Solver solver;
+        solver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+        solver.m_batchSize = batchSize;
+        solver.m_lossScaling.m_isEnabled = isLossScaled;
+        QVERIFY(solver.init(model));
+
+        float *weightData = model->beginMutateData(weight);
+        for (unsigned int i = 0; i < 2 * 4; ++i)
+        {
+            weightData[i] = (float) ((i * 7) % 9) / 9.0f - 0.5f;
+        }
+        model->endMutateData(weight);
+        model->clearTensor(bias);
+
+        float *featureData = model->beginMutateData(features);
+        for (unsigned int i = 0; i < 4 * batchSize; ++i)
+        {
+            featureData[i] = (float) ((i * 5) % 11) / 11.0f - 0.5f;
+        }
+        model->endMutateData(features);
+
+        float *labelData = model->beginMutateData(label);
+        for (unsigned int i = 0; i < 2 * batchSize; ++i)
+        {
+            labelData[i] = (float) (i % 3 == 0);
+        }
+        model->endMutateData(label);
+
+        for (unsigned int step = 0; step < 3; ++step)
+        {
+            solver.forward(model);
+            solver.backward(model);
+            solver.update(learningRate);
+        }
+
+        QVERIFY(solver.skippedStepCount() == 0);
+
+        const float *trainedWeight = model->readonlyAccess(weight);
+        const float *trainedBias = model->readonlyAccess(bias);
+        weights[run].assign(trainedWeight, trainedWeight + 2 * 4);
+        weights[run].insert(weights[run].end(), trainedBias, trainedBias + 2);
+
+        delete model;
+    }
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+
+    // the loss derivative scales the gradient the optimizer divides, so the weights move the same
+    for (unsigned int i = 0; i < weights[0].size(); ++i)
+    {
+        QVERIFY(std::abs(weights[0][i] - weights[1][i]) < 1e-6f);
+    }
+
+    QVERIFY(std::abs(weights[0].back()) > 1e-3f);
+}
+
+void FreeWillUnitTest::quantizedInferenceTest()
+{
+    const unsigned int batchSize = 3;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(1);
+
+    std::vector<float> outputs[2];
+    std::vector<float> convolutionOutputs[2];
+    std::vector<float> weightData(5 * 12);
+    std::vector<float> biasData(5);
+    float featureRange = 0.0f;
+
+    for (unsigned int run = 0; run < 2; ++run)
+    {
+        bool isQuantized = (run == 1);
+
+        FreeWill::Model *model = FreeWill::Model::create();
+
+        FreeWill::TensorDescriptorHandle image = model->addTensor("image", {4, 6, 6}).enableBatch();
+        FreeWill::TensorDescriptorHandle convOutput = model->addTensor("convOutput", {6, 4, 4}).enableBatch();
+        FreeWill::TensorDescriptorHandle features = model->addTensor("features", {12}).enableBatch();
+        FreeWill::TensorDescriptorHandle output = model->addTensor("output", {5}).enableBatch();
+        FreeWill::TensorDescriptorHandle outputGrad = model->addTensor("outputGrad", {5}).enableBatch();
+        FreeWill::TensorDescriptorHandle featuresGrad = model->addTensor("featuresGrad", {12}).enableBatch();
+
+        FreeWill::TensorDescriptorHandle parameters[4] = {model->addTensor("featureMap", {4, 3, 3, 6}),
+                                                          model->addTensor("convBias", {6}),
+                                                          model->addTensor("weight", {5, 12}),
+                                                          model->addTensor("bias", {5})};
+        unsigned int parameterSizes[4] = {4 * 3 * 3 * 6, 6, 5 * 12, 5};
+
+        FreeWill::TensorDescriptorHandle weightGrad = model->addTensor("weightGrad", {5, 12});
+        FreeWill::TensorDescriptorHandle biasGrad = model->addTensor("biasGrad", {5});
+
+        FreeWill::OperatorDescriptorHandle convolution = model->addOperator("convolution", FreeWill::OperatorName::CONVOLUTION,
+                            {{"Input", image}, {"FeatureMap", parameters[0]}, {"Bias", parameters[1]}}, {{"Output", convOutput}});
+        FreeWill::OperatorDescriptorHandle relu = model->addOperator("relu", FreeWill::OperatorName::ACTIVATION,
+                            {{"Input", convOutput}}, {{"Output", convOutput}}, {{"Mode", FreeWill::ActivationMode::RELU}});
+        FreeWill::OperatorDescriptorHandle fullyConnected = model->addOperator("fullyConnected", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                            {{"Input", features}, {"Weight", parameters[2]}, {"Bias", parameters[3]}}, {{"Output", output}});
+        FreeWill::OperatorDescriptorHandle sigmoid = model->addOperator("sigmoid", FreeWill::OperatorName::ACTIVATION,
+                            {{"Input", output}}, {{"Output", output}}, {{"Mode", FreeWill::ActivationMode::SIGMOID}});
+        FreeWill::OperatorDescriptorHandle fullyConnectedDerivative = model->addOperator("fullyConnectedDerivative", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS_DERIVATIVE,
+                            {{"InputActivation", features}, {"OutputDelta", outputGrad}, {"Weight", parameters[2]}},
+                            {{"WeightGrad", weightGrad}, {"BiasGrad", biasGrad}, {"InputDelta", featuresGrad}});
+
+        // the backward path is neither created nor allocated by an inference solver
+        model->defineForwardPath({convolution, relu, fullyConnected, sigmoid});
+        model->defineBackwardPath({fullyConnectedDerivative});
+
+        FreeWill::Solver solver;
+        solver.m_mode = isQuantized ? FreeWill::SolverMode::QUANTIZED_INFERENCE : FreeWill::SolverMode::INFERENCE;
+        solver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+        solver.m_batchSize = batchSize;
+        QVERIFY(solver.init(model));
+
+        for (unsigned int p = 0; p < 4; ++p)
+        {
+            float *data = model->beginMutateData(parameters[p]);
+            for (unsigned int i = 0; i < parameterSizes[p]; ++i)
+            {
+                data[i] = (float) ((i * 7 + p) % 13) / 13.0f - 0.5f;
+            }
+            model->endMutateData(parameters[p]);
+        }
+
+        const float *weight = model->readonlyAccess(parameters[2]);
+        weightData.assign(weight, weight + 5 * 12);
+        const float *bias = model->readonlyAccess(parameters[3]);
+        biasData.assign(bias, bias + 5);
+
+        if (isQuantized)
+        {
+            // nothing is calibrated yet, the model stays in float
+            QVERIFY(!solver.quantize(model));
+            QVERIFY(model->readonlyAccess(parameters[0]) != nullptr);
+            QVERIFY(model->readonlyAccess(parameters[2]) != nullptr);
+        }
+
+        // the first two batches calibrate, the second one has the larger range, the last one is scored
+        for (unsigned int batch = 0; batch < 3; ++batch)
+        {
+            float magnitude = batch == 1 ? 2.0f : 1.0f;
+
+            float *imageData = model->beginMutateData(image);
+            for (unsigned int i = 0; i < 4 * 6 * 6 * batchSize; ++i)
+            {
+                imageData[i] = magnitude * ((float) ((i * 5 + batch) % 11) / 11.0f - 0.5f);
+            }
+            model->endMutateData(image);
+
+            float *featureData = model->beginMutateData(features);
+            for (unsigned int i = 0; i < 12 * batchSize; ++i)
+            {
+                featureData[i] = magnitude * ((float) ((i * 3 + batch) % 7) / 7.0f - 0.5f);
+                if (batch < 2)
+                {
+                    featureRange = std::max(featureRange, std::abs(featureData[i]));
+                }
+            }
+            model->endMutateData(features);
+
+            model->clearTensor(convOutput);
+
+            if (batch < 2)
+            {
+                QVERIFY(solver.calibrate(model) == isQuantized);
+            }
+        }
+
+        QVERIFY(solver.quantize(model) == isQuantized);
+
+        solver.forward(model);
+
+        const float *outputData = model->readonlyAccess(output);
+        outputs[run].assign(outputData, outputData + 5 * batchSize);
+
+        const float *convOutputData = model->readonlyAccess(convOutput);
+        convolutionOutputs[run].assign(convOutputData, convOutputData + 6 * 4 * 4 * batchSize);
+
+        if (isQuantized)
+        {
+            // the int8 operators hold their own weights, the float ones are gone
+            QVERIFY(model->readonlyAccess(parameters[0]) == nullptr);
+            QVERIFY(model->readonlyAccess(parameters[2]) == nullptr);
+            QVERIFY(!solver.calibrate(model));
+            QVERIFY(!solver.quantize(model));
+
+            const float *featureData = model->readonlyAccess(features);
+            float inputScale = FreeWill::quantizationScale(featureRange);
+
+            for (unsigned int o = 0; o < 5; ++o)
+            {
+                float range = 0.0f;
+                for (unsigned int i = 0; i < 12; ++i)
+                {
+                    range = std::max(range, std::abs(weightData[o + i * 5]));
+                }
+                float weightScale = FreeWill::quantizationScale(range);
+
+                for (unsigned int b = 0; b < batchSize; ++b)
+                {
+                    int accumulator = 0;
+                    for (unsigned int i = 0; i < 12; ++i)
+                    {
+                        accumulator += FreeWill::quantizeValueCPU(weightData[o + i * 5], 1.0f / weightScale) *
+                                FreeWill::quantizeValueCPU(featureData[b * 12 + i], 1.0f / inputScale);
+                    }
+
+                    float expected = accumulator * (weightScale * inputScale) + biasData[o];
+                    expected = FreeWill::activationCPU<float>(FreeWill::ActivationMode::SIGMOID, expected);
+                    QVERIFY(outputs[run][b * 5 + o] == expected);
+                }
+            }
+        }
+
+        delete model;
+    }
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+
+    for (unsigned int i = 0; i < outputs[0].size(); ++i)
+    {
+        QVERIFY(std::abs(outputs[0][i] - outputs[1][i]) < 0.01f);
+    }
+
+    for (unsigned int i = 0; i < convolutionOutputs[0].size(); ++i)
+    {
+        QVERIFY(std::abs(convolutionOutputs[0][i] - convolutionOutputs[1][i]) < 0.05f);
+    }
+}
+
+void FreeWillUnitTest::structuredSparsityTest()
+{
+    const unsigned int batchSize = 3;
+    const unsigned int deviceCount = 2;
+
+    FreeWill::SparsityParameters patterns[2];
+    patterns[0].m_pattern = FreeWill::SparsityPattern::TWO_FOUR;
+    patterns[1].m_pattern = FreeWill::SparsityPattern::BLOCK;
+    patterns[1].m_blockSize = 2;
+    patterns[1].m_blockDensity = 0.25;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(1);
+
+    // inference: the dot product runs on its packed weight, the convolution on its pruned one
+    for (const FreeWill::SparsityParameters &parameters : patterns)
+    {
+        FreeWill::Model *model = FreeWill::Model::create();
+
+        FreeWill::TensorDescriptorHandle image = model->addTensor("image", {4, 6, 6}).enableBatch();
+        FreeWill::TensorDescriptorHandle convOutput = model->addTensor("convOutput", {6, 4, 4}).enableBatch();
+        FreeWill::TensorDescriptorHandle features = model->addTensor("features", {12}).enableBatch();
+        FreeWill::TensorDescriptorHandle output = model->addTensor("output", {5}).enableBatch();
+
+        FreeWill::TensorDescriptorHandle featureMap = model->addTensor("featureMap", {4, 3, 3, 6});
+        FreeWill::TensorDescriptorHandle convBias = model->addTensor("convBias", {6});
+        FreeWill::TensorDescriptorHandle weight = model->addTensor("weight", {5, 12});
+        FreeWill::TensorDescriptorHandle bias = model->addTensor("bias", {5});
+
+        FreeWill::OperatorDescriptorHandle convolution = model->addOperator("convolution", FreeWill::OperatorName::CONVOLUTION,
+                            {{"Input", image}, {"FeatureMap", featureMap}, {"Bias", convBias}}, {{"Output", convOutput}});
+        FreeWill::OperatorDescriptorHandle fullyConnected = model->addOperator("fullyConnected", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                            {{"Input", features}, {"Weight", weight}, {"Bias", bias}}, {{"Output", output}});
+        FreeWill::OperatorDescriptorHandle sigmoid = model->addOperator("sigmoid", FreeWill::OperatorName::ACTIVATION,
+                            {{"Input", output}}, {{"Output", output}}, {{"Mode", FreeWill::ActivationMode::SIGMOID}});
+
+        model->defineForwardPath({convolution, fullyConnected, sigmoid});
+
+        FreeWill::Solver solver;
+        solver.m_mode = FreeWill::SolverMode::INFERENCE;
+        solver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+        solver.m_batchSize = batchSize;
+        QVERIFY(solver.init(model));
+
+        // dense does nothing
+        QVERIFY(!solver.prune(model));
+
+        // blocks of no weights can't be packed, the model stays dense and can be pruned later
+        solver.m_sparsity.m_pattern = FreeWill::SparsityPattern::BLOCK;
+        solver.m_sparsity.m_blockSize = 0;
+        QVERIFY(!solver.prune(model));
+        QVERIFY(model->readonlyAccess(weight) != nullptr);
+
+        FreeWill::TensorDescriptorHandle handles[3] = {featureMap, weight, bias};
+        unsigned int sizes[3] = {4 * 3 * 3 * 6, 5 * 12, 5};
+
+        for (unsigned int p = 0; p < 3; ++p)
+        {
+            float *data = model->beginMutateData(handles[p]);
+            for (unsigned int i = 0; i < sizes[p]; ++i)
+            {
+                data[i] = (float) ((i * 7 + p) % 13) / 13.0f - 0.5f;
+            }
+            model->endMutateData(handles[p]);
+        }
+
+        std::vector<float> prunedWeight(model->readonlyAccess(weight), model->readonlyAccess(weight) + 5 * 12);
+        std::vector<float> biasData(model->readonlyAccess(bias), model->readonlyAccess(bias) + 5);
+        std::vector<float> prunedFeatureMap(model->readonlyAccess(featureMap), model->readonlyAccess(featureMap) + sizes[0]);
+
+        FreeWill::pruneWeightCPU(parameters, prunedWeight.data(), (float *) nullptr, 5, 12, 1, 5);
+        FreeWill::pruneWeightCPU(parameters, prunedFeatureMap.data(), (float *) nullptr, 6, 4 * 3 * 3, 4 * 3 * 3, 1);
+
+        float *featureData = model->beginMutateData(features);
+        for (unsigned int i = 0; i < 12 * batchSize; ++i)
+        {
+            featureData[i] = (float) ((i * 3) % 7) / 7.0f - 0.5f;
+        }
+        model->endMutateData(features);
+
+        solver.m_sparsity = parameters;
+        QVERIFY(solver.prune(model));
+        QVERIFY(!solver.prune(model));
+
+        solver.forward(model);
+
+        // the dense weight of the dot product is gone, the feature map is pruned in place
+        QVERIFY(model->readonlyAccess(weight) == nullptr);
+
+        const float *featureMapData = model->readonlyAccess(featureMap);
+        for (unsigned int i = 0; i < sizes[0]; ++i)
+        {
+            QVERIFY(featureMapData[i] == prunedFeatureMap[i]);
+        }
+
+        const float *outputData = model->readonlyAccess(output);
+        featureData = model->beginMutateData(features);
+
+        for (unsigned int o = 0; o < 5; ++o)
+        {
+            for (unsigned int b = 0; b < batchSize; ++b)
+            {
+                float expected = biasData[o];
+                for (unsigned int i = 0; i < 12; ++i)
+                {
+                    expected += prunedWeight[i * 5 + o] * featureData[b * 12 + i];
+                }
+                expected = FreeWill::activationCPU<float>(FreeWill::ActivationMode::SIGMOID, expected);
+
+                QVERIFY(std::abs(outputData[b * 5 + o] - expected) < 1e-5f);
+            }
+        }
+
+        model->endMutateData(features);
+
+        delete model;
+    }
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+
+    // fine-tuning: the pruned weights of every replica stay zero through the updates
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(deviceCount);
+
+    FreeWill::Model *model = FreeWill::Model::create();
+
+    FreeWill::TensorDescriptorHandle features = model->addTensor("features", {8}).enableBatch();
+    FreeWill::TensorDescriptorHandle output = model->addTensor("output", {4}).enableBatch();
+    FreeWill::TensorDescriptorHandle outputGrad = model->addTensor("outputGrad", {4}).enableBatch();
+    FreeWill::TensorDescriptorHandle featuresGrad = model->addTensor("featuresGrad", {8}).enableBatch();
+    FreeWill::TensorDescriptorHandle weight = model->addTensor("weight", {4, 8});
+    FreeWill::TensorDescriptorHandle bias = model->addTensor("bias", {4});
+    FreeWill::TensorDescriptorHandle weightGrad = model->addTensor("weightGrad", {4, 8});
+    FreeWill::TensorDescriptorHandle biasGrad = model->addTensor("biasGrad", {4});
+
+    FreeWill::OperatorDescriptorHandle fullyConnected = model->addOperator("fullyConnected", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                        {{"Input", features}, {"Weight", weight}, {"Bias", bias}}, {{"Output", output}});
+    FreeWill::OperatorDescriptorHandle fullyConnectedDerivative = model->addOperator("fullyConnectedDerivative", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS_DERIVATIVE,
+                        {{"InputActivation", features}, {"OutputDelta", outputGrad}, {"Weight", weight}},
+                        {{"WeightGrad", weightGrad}, {"BiasGrad", biasGrad}, {"InputDelta", featuresGrad}});
+
+    model->defineForwardPath({fullyConnected});
+    model->defineBackwardPath({fullyConnectedDerivative});
+    model->defineWeightUpdatePairs({{weight, weightGrad}, {bias, biasGrad}});
+
+    FreeWill::Solver solver;
+    solver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+    solver.m_batchSize = batchSize;
+    solver.m_optimizer.m_type = FreeWill::OptimizerType::MOMENTUM;
+    solver.m_sparsity = patterns[0];
+    QVERIFY(solver.init(model));
+
+    for (unsigned int d = 0; d < deviceCount; ++d)
+    {
+        float *weightData = model->beginMutateData(weight, d);
+        for (unsigned int i = 0; i < 4 * 8; ++i)
+        {
+            weightData[i] = (float) ((i * 7) % 13) / 13.0f - 0.5f;
+        }
+        model->endMutateData(weight, d);
+    }
+
+    QVERIFY(solver.prune(model));
+
+    std::vector<float> prunedWeight(model->readonlyAccess(weight), model->readonlyAccess(weight) + 4 * 8);
+
+    for (unsigned int step = 0; step < 3; ++step)
+    {
+        for (unsigned int d = 0; d < deviceCount; ++d)
+        {
+            float *gradData = model->beginMutateData(weightGrad, d);
+            for (unsigned int i = 0; i < 4 * 8; ++i)
+            {
+                gradData[i] = (float) ((i * 5 + d + step) % 11) / 11.0f + 0.1f;
+            }
+            model->endMutateData(weightGrad, d);
+        }
+
+        solver.update(-0.1);
+    }
+
+    for (unsigned int d = 0; d < deviceCount; ++d)
+    {
+        const float *weightData = model->readonlyAccess(weight, d);
+        unsigned int keptCount = 0;
+
+        for (unsigned int i = 0; i < 4 * 8; ++i)
+        {
+            QVERIFY((weightData[i] == 0.0f) == (prunedWeight[i] == 0.0f));
+            QVERIFY(weightData[i] == 0.0f || weightData[i] != prunedWeight[i]);
+            keptCount += weightData[i] != 0.0f;
+        }
+
+        QVERIFY(keptCount == 4 * 4);
+    }
+
+    delete model;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+}
+
+void FreeWillUnitTest::inferenceInPlaceActivationTest()
+{
+    const unsigned int batchSize = 4;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(1);
+
+    std::vector<float> results[2];
+
+    for (unsigned int run = 0; run < 2; ++run)
+    {
+        bool isInference = (run == 1);
+
+        FreeWill::Model *model = FreeWill::Model::create();
+
+        FreeWill::TensorDescriptorHandle features = model->addTensor("features", {8}).enableBatch();
+        FreeWill::TensorDescriptorHandle hidden = model->addTensor("hidden", {6}).enableBatch();
+        FreeWill::TensorDescriptorHandle hiddenActivation = model->addTensor("hiddenActivation", {6}).enableBatch();
+        FreeWill::TensorDescriptorHandle output = model->addTensor("output", {3}).enableBatch();
+        FreeWill::TensorDescriptorHandle result = model->addTensor("result", {3}).enableBatch();
+
+        FreeWill::TensorDescriptorHandle parameters[4] = {model->addTensor("weight", {6, 8}),
+                                                          model->addTensor("bias", {6}),
+                                                          model->addTensor("weight2", {3, 6}),
+                                                          model->addTensor("bias2", {3})};
+        unsigned int parameterSizes[4] = {6 * 8, 6, 3 * 6, 3};
+
+        // out of place activations are not fused, in inference they reuse the memory of their input
+        FreeWill::OperatorDescriptorHandle fullyConnected = model->addOperator("fullyConnected", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                            {{"Input", features}, {"Weight", parameters[0]}, {"Bias", parameters[1]}}, {{"Output", hidden}});
+        FreeWill::OperatorDescriptorHandle sigmoid = model->addOperator("sigmoid", FreeWill::OperatorName::ACTIVATION,
+                            {{"Input", hidden}}, {{"Output", hiddenActivation}}, {{"Mode", FreeWill::ActivationMode::SIGMOID}});
+        FreeWill::OperatorDescriptorHandle fullyConnected2 = model->addOperator("fullyConnected2", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                            {{"Input", hiddenActivation}, {"Weight", parameters[2]}, {"Bias", parameters[3]}}, {{"Output", output}});
+        FreeWill::OperatorDescriptorHandle relu = model->addOperator("relu", FreeWill::OperatorName::ACTIVATION,
+                            {{"Input", output}}, {{"Output", result}}, {{"Mode", FreeWill::ActivationMode::RELU}});
+
+        FreeWill::TensorDescriptorHandle outputGrad = model->addTensor("outputGrad", {3}).enableBatch();
+        FreeWill::TensorDescriptorHandle hiddenGrad = model->addTensor("hiddenGrad", {6}).enableBatch();
+        FreeWill::TensorDescriptorHandle weightGrad = model->addTensor("weight2Grad", {3, 6});
+        FreeWill::TensorDescriptorHandle biasGrad = model->addTensor("bias2Grad", {3});
+
+        FreeWill::OperatorDescriptorHandle fullyConnected2Derivative = model->addOperator("fullyConnected2Derivative", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS_DERIVATIVE,
+                            {{"InputActivation", hiddenActivation}, {"OutputDelta", outputGrad}, {"Weight", parameters[2]}},
+                            {{"WeightGrad", weightGrad}, {"BiasGrad", biasGrad}, {"InputDelta", hiddenGrad}});
+
+        model->defineForwardPath({fullyConnected, sigmoid, fullyConnected2, relu});
+        model->defineBackwardPath({fullyConnected2Derivative});
+        model->defineWeightUpdatePairs({{parameters[2], weightGrad}, {parameters[3], biasGrad}});
+
+        FreeWill::Solver solver;
+        solver.m_mode = isInference ? FreeWill::SolverMode::INFERENCE : FreeWill::SolverMode::TRAINING;
+        solver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+        solver.m_batchSize = batchSize;
+        solver.m_planMemory = isInference;
+        QVERIFY(solver.init(model));
+
+        for (unsigned int p = 0; p < 4; ++p)
+        {
+            float *data = model->beginMutateData(parameters[p]);
+            for (unsigned int i = 0; i < parameterSizes[p]; ++i)
+            {
+                data[i] = (float) ((i * 5 + p) % 11) / 11.0f - 0.5f;
+            }
+            model->endMutateData(parameters[p]);
+        }
+
+        float *featureData = model->beginMutateData(features);
+        for (unsigned int i = 0; i < 8 * batchSize; ++i)
+        {
+            featureData[i] = (float) ((i * 3) % 7) / 7.0f - 0.5f;
+        }
+        model->endMutateData(features);
+
+        solver.forward(model);
+
+        const float *resultData = model->readonlyAccess(result);
+        results[run].assign(resultData, resultData + 3 * batchSize);
+
+        QVERIFY((model->readonlyAccess(hidden) == model->readonlyAccess(hiddenActivation)) == isInference);
+        QVERIFY((model->readonlyAccess(output) == model->readonlyAccess(result)) == isInference);
+
+        delete model;
+    }
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+
+    for (unsigned int i = 0; i < results[0].size(); ++i)
+    {
+        QVERIFY(results[0][i] == results[1][i]);
+    }
+}
+
+void FreeWillUnitTest::inlineInferenceTest()
+{
+    const unsigned int inputSize = 300;
+    const unsigned int hiddenSize = 45;
+    const unsigned int outputSize = 10;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(1);
+
+    // a batch of four through the workers, the first item alone through the workers and inline
+    const unsigned int batchSizes[3] = {4, 1, 1};
+    std::vector<float> results[3];
+
+    for (unsigned int run = 0; run < 3; ++run)
+    {
+        bool isInline = (run == 2);
+
+        FreeWill::Model *model = FreeWill::Model::create();
+
+        FreeWill::TensorDescriptorHandle features = model->addTensor("features", {inputSize}).enableBatch();
+        FreeWill::TensorDescriptorHandle hidden = model->addTensor("hidden", {hiddenSize}).enableBatch();
+        FreeWill::TensorDescriptorHandle output = model->addTensor("output", {outputSize}).enableBatch();
+
+        FreeWill::TensorDescriptorHandle parameters[4] = {model->addTensor("weight", {hiddenSize, inputSize}),
+                                                          model->addTensor("bias", {hiddenSize}),
+                                                          model->addTensor("weight2", {outputSize, hiddenSize}),
+                                                          model->addTensor("bias2", {outputSize})};
+        unsigned int parameterSizes[4] = {hiddenSize * inputSize, hiddenSize, outputSize * hiddenSize, outputSize};
+
+        // the input is longer than a depth block of the gemm and the rows don't fill the last tile
+        FreeWill::OperatorDescriptorHandle fullyConnected = model->addOperator("fullyConnected", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                            {{"Input", features}, {"Weight", parameters[0]}, {"Bias", parameters[1]}}, {{"Output", hidden}});
+        FreeWill::OperatorDescriptorHandle relu = model->addOperator("relu", FreeWill::OperatorName::ACTIVATION,
+                            {{"Input", hidden}}, {{"Output", hidden}}, {{"Mode", FreeWill::ActivationMode::RELU}});
+        FreeWill::OperatorDescriptorHandle fullyConnected2 = model->addOperator("fullyConnected2", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                            {{"Input", hidden}, {"Weight", parameters[2]}, {"Bias", parameters[3]}}, {{"Output", output}});
+        FreeWill::OperatorDescriptorHandle sigmoid = model->addOperator("sigmoid", FreeWill::OperatorName::ACTIVATION,
+                            {{"Input", output}}, {{"Output", output}}, {{"Mode", FreeWill::ActivationMode::SIGMOID}});
+
+        model->defineForwardPath({fullyConnected, relu, fullyConnected2, sigmoid});
+
+        FreeWill::Solver solver;
+        solver.m_mode = FreeWill::SolverMode::INFERENCE;
+        solver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+        solver.m_batchSize = batchSizes[run];
+        solver.m_planMemory = true;
+        solver.m_runInline = isInline;
+        QVERIFY(solver.init(model));
+
+        for (unsigned int p = 0; p < 4; ++p)
+        {
+            float *data = model->beginMutateData(parameters[p]);
+            for (unsigned int i = 0; i < parameterSizes[p]; ++i)
+            {
+                data[i] = (float) ((i * 5 + p) % 11) / 11.0f - 0.5f;
+            }
+            model->endMutateData(parameters[p]);
+        }
+
+        // a pass over other features first, the second one has to start from scratch
+        for (unsigned int pass = 0; pass < 2; ++pass)
+        {
+            float *featureData = model->beginMutateData(features);
+            for (unsigned int i = 0; i < inputSize * batchSizes[run]; ++i)
+            {
+                featureData[i] = (float) ((i * 3 + pass * 2) % 7) / 7.0f - 0.5f;
+            }
+            model->endMutateData(features);
+
+            solver.forward(model);
+        }
+
+        const float *outputData = model->readonlyAccess(output);
+        results[run].assign(outputData, outputData + outputSize * batchSizes[run]);
+
+        delete model;
+    }
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+
+    for (unsigned int i = 0; i < outputSize; ++i)
+    {
+        QVERIFY(results[1][i] == results[0][i]);
+        QVERIFY(results[2][i] == results[1][i]);
+    }
+}
+
+void FreeWillUnitTest::channelBlockedInferenceTest()
+{
+    const unsigned int batchSize = 2;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(1);
+
+    std::vector<float> results[2];
+
+    for (unsigned int run = 0; run < 2; ++run)
+    {
+        FreeWill::Model *model = FreeWill::Model::create();
+
+        FreeWill::TensorDescriptorHandle image = model->addTensor("image", {16, 8, 8}).enableBatch();
+        FreeWill::TensorDescriptorHandle convOutput1 = model->addTensor("convOutput1", {16, 8, 8}).enableBatch();
+        FreeWill::TensorDescriptorHandle activation1 = model->addTensor("activation1", {16, 8, 8}).enableBatch();
+        FreeWill::TensorDescriptorHandle pooled = model->addTensor("pooled", {16, 4, 4}).enableBatch();
+        FreeWill::TensorDescriptorHandle switches = model->addTensor("switches", FreeWill::maxPoolingSwitchShape({16, 4, 4}), FreeWill::DataType::UNSIGNED_INT).enableBatch();
+        FreeWill::TensorDescriptorHandle convOutput2 = model->addTensor("convOutput2", {16, 4, 4}).enableBatch();
+        FreeWill::TensorDescriptorHandle convOutput3 = model->addTensor("convOutput3", {16, 4, 4}).enableBatch();
+        FreeWill::TensorDescriptorHandle output = model->addTensor("output", {5}).enableBatch();
+
+        FreeWill::TensorDescriptorHandle parameters[8] = {model->addTensor("featureMap1", {16, 3, 3, 16}),
+                                                          model->addTensor("bias1", {16}),
+                                                          model->addTensor("featureMap2", {16, 1, 1, 16}),
+                                                          model->addTensor("bias2", {16}),
+                                                          model->addTensor("featureMap3", {16, 3, 3, 16}),
+                                                          model->addTensor("bias3", {16}),
+                                                          model->addTensor("weight", {5, 256}),
+                                                          model->addTensor("bias4", {5})};
+        unsigned int parameterSizes[8] = {16 * 9 * 16, 16, 16 * 16, 16, 16 * 9 * 16, 16, 5 * 256, 5};
+
+        // The caller's image and convOutput3 stay CHANNEL_LAST, convOutput2 is read reshaped:
+        // convolution1, relu, maxPooling and convolution3 run blocked between transforms.
+        FreeWill::OperatorDescriptorHandle convolution1 = model->addOperator("convolution1", FreeWill::OperatorName::CONVOLUTION,
+                            {{"Input", image}, {"FeatureMap", parameters[0]}, {"Bias", parameters[1]}}, {{"Output", convOutput1}},
+                            {{"ZeroPaddingX", 1u}, {"ZeroPaddingY", 1u}});
+        FreeWill::OperatorDescriptorHandle relu = model->addOperator("relu", FreeWill::OperatorName::ACTIVATION,
+                            {{"Input", convOutput1}}, {{"Output", activation1}}, {{"Mode", FreeWill::ActivationMode::RELU}});
+        FreeWill::OperatorDescriptorHandle maxPooling = model->addOperator("maxPooling", FreeWill::OperatorName::MAX_POOLING,
+                            {{"Input", activation1}}, {{"Output", pooled}, {"Switch", switches}});
+        FreeWill::OperatorDescriptorHandle convolution2 = model->addOperator("convolution2", FreeWill::OperatorName::CONVOLUTION,
+                            {{"Input", pooled}, {"FeatureMap", parameters[2]}, {"Bias", parameters[3]}}, {{"Output", convOutput2}});
+        FreeWill::OperatorDescriptorHandle convolution3 = model->addOperator("convolution3", FreeWill::OperatorName::CONVOLUTION,
+                            {{"Input", pooled}, {"FeatureMap", parameters[4]}, {"Bias", parameters[5]}}, {{"Output", convOutput3}},
+                            {{"ZeroPaddingX", 1u}, {"ZeroPaddingY", 1u}});
+        FreeWill::OperatorDescriptorHandle fullyConnected = model->addOperator("fullyConnected", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                            {{"Input", convOutput2.reshape({256})}, {"Weight", parameters[6]}, {"Bias", parameters[7]}}, {{"Output", output}});
+
+        model->defineForwardPath({convolution1, relu, maxPooling, convolution2, convolution3, fullyConnected});
+        model->defineBackwardPath({});
+
+        FreeWill::Solver solver;
+        solver.m_mode = FreeWill::SolverMode::INFERENCE;
+        solver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+        solver.m_batchSize = batchSize;
+        solver.m_blockChannels = (run == 1);
+        QVERIFY(solver.init(model));
+
+        for (unsigned int p = 0; p < 8; ++p)
+        {
+            float *data = model->beginMutateData(parameters[p]);
+            for (unsigned int i = 0; i < parameterSizes[p]; ++i)
+            {
+                data[i] = (float) ((i * 7 + p) % 13) / 13.0f - 0.5f;
+            }
+            model->endMutateData(parameters[p]);
+        }
+
+        float *imageData = model->beginMutateData(image);
+        for (unsigned int i = 0; i < 16 * 8 * 8 * batchSize; ++i)
+        {
+            imageData[i] = (float) ((i * 5) % 11) / 11.0f - 0.5f;
+        }
+        model->endMutateData(image);
+
+        model->clearTensor(convOutput1);
+        model->clearTensor(convOutput2);
+        model->clearTensor(convOutput3);
+
+        solver.forward(model);
+
+        const float *outputData = model->readonlyAccess(output);
+        results[run].assign(outputData, outputData + 5 * batchSize);
+
+        const float *convOutputData = model->readonlyAccess(convOutput3);
+        results[run].insert(results[run].end(), convOutputData, convOutputData + 16 * 4 * 4 * batchSize);
+
+        delete model;
+    }
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+
+    QVERIFY(results[0].size() == results[1].size());
+
+    for (unsigned int i = 0; i < results[0].size(); ++i)
+    {
+        QVERIFY(std::abs(results[0][i] - results[1][i]) < epsilon * std::max(1.0f, std::abs(results[0][i])));
+    }
+}
+
+void FreeWillUnitTest::inferenceServerTest()
+{
+    const unsigned int batchSize = 4;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(1);
+
+    FreeWill::Model *model = FreeWill::Model::create();
+
+    FreeWill::TensorDescriptorHandle features = model->addTensor("features", {4}).enableBatch();
+    FreeWill::TensorDescriptorHandle output = model->addTensor("output", {2}).enableBatch();
+    FreeWill::TensorDescriptorHandle weight = model->addTensor("weight", {2, 4});
+    FreeWill::TensorDescriptorHandle bias = model->addTensor("bias", {2});
+
+    FreeWill::OperatorDescriptorHandle fullyConnected = model->addOperator("fullyConnected", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                        {{"Input", features}, {"Weight", weight}, {"Bias", bias}}, {{"Output", output}});
+
+    model->defineForwardPath({fullyConnected});
+
+    FreeWill::Solver solver;
+    solver.m_mode = FreeWill::SolverMode::INFERENCE;
+    solver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+    solver.m_batchSize = batchSize;
+    QVERIFY(solver.init(model));
+
+    float *weightData = model->beginMutateData(weight);
+    for (unsigned int i = 0; i < 2 * 4; ++i)
+    {
+        weightData[i] = (float) i / 8.0f - 0.5f;
+    }
+    model->endMutateData(weight);
+
+    float *biasData = model->beginMutateData(bias);
+    biasData[0] = 0.25f;
+    biasData[1] = -0.75f;
+    model->endMutateData(bias);
+
+    FreeWill::InferenceServerParameters parameters;
+    parameters.m_maxDelay = std::chrono::microseconds(20000);
+
+    FreeWill::InferenceServer server(model, &solver, features, output, parameters);
+    QVERIFY(server.start());
+
+    // six requests make one full batch and one partial batch sent by the deadline
+    const unsigned int requestCount = 6;
+    std::vector<std::vector<float>> samples(requestCount, std::vector<float>(4));
+    std::vector<std::future<std::vector<float>>> results(requestCount);
+
+    for (unsigned int r = 0; r < requestCount; ++r)
+    {
+        for (unsigned int i = 0; i < 4; ++i)
+        {
+            samples[r][i] = (float) ((r * 4 + i) % 5) - 2.0f;
+        }
+        QVERIFY(server.submit(samples[r], results[r]));
+    }
+
+    std::future<std::vector<float>> rejected;
+    QVERIFY(!server.submit(std::vector<float>(3), rejected));
+
+    for (unsigned int r = 0; r < requestCount; ++r)
+    {
+        std::vector<float> result = results[r].get();
+        QVERIFY(result.size() == 2);
+
+        for (unsigned int o = 0; o < 2; ++o)
+        {
+            float expected = biasData[o];
+            for (unsigned int i = 0; i < 4; ++i)
+            {
+                expected += weightData[o + i * 2] * samples[r][i];
+            }
+            QVERIFY(std::abs(result[o] - expected) < 1e-5);
+        }
+    }
+
+    server.stop();
+
+    QVERIFY(server.requestCount() == requestCount);
+    QVERIFY(server.batchCount() >= 2);
+    QVERIFY(server.averageBatchSize() <= batchSize);
+    QVERIFY(!server.submit(samples[0], rejected));
+
+    // features fed from one sample can't be viewed at a batch of two, both requests fail
+    std::vector<float> fedFeatures(4);
+    QVERIFY(model->setBatchSize(1));
+    QVERIFY(model->feedFromMemory(features, fedFeatures.data()));
+
+    parameters.m_maxBatchSize = 2;
+    parameters.m_maxDelay = std::chrono::microseconds(1000000);
+    FreeWill::InferenceServer failingServer(model, &solver, features, output, parameters);
+    QVERIFY(failingServer.start());
+    QVERIFY(failingServer.submit(samples[0], results[0]));
+    QVERIFY(failingServer.submit(samples[1], results[1]));
+    QVERIFY(results[0].get().empty() && results[1].get().empty());
+    failingServer.stop();
+
+    delete model;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+}
+
+void FreeWillUnitTest::dynamicBatchSizeTest()
+{
+    const unsigned int batchSize = 3;
+    const unsigned int maxBatchSize = 5;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(1);
+
+    std::vector<float> outputs[2];
+    std::vector<float> weightGrads[2];
+    std::vector<float> inputGrads[2];
+
+    for (unsigned int run = 0; run < 2; ++run)
+    {
+        // the second model is allocated for a larger batch and viewed at the batch of the first
+        bool isViewed = (run == 1);
+
+        FreeWill::Model *model = FreeWill::Model::create();
+
+        FreeWill::TensorDescriptorHandle features = model->addTensor("features", {2, 3}).enableBatch();
+        FreeWill::TensorDescriptorHandle hidden = model->addTensor("hidden", {4}).enableBatch();
+        FreeWill::TensorDescriptorHandle hiddenGrad = model->addTensor("hiddenGrad", {4}).enableBatch();
+        FreeWill::TensorDescriptorHandle featuresGrad = model->addTensor("featuresGrad", {6}).enableBatch();
+        FreeWill::TensorDescriptorHandle weight = model->addTensor("weight", {4, 6});
+        FreeWill::TensorDescriptorHandle bias = model->addTensor("bias", {4});
+        FreeWill::TensorDescriptorHandle weightGrad = model->addTensor("weightGrad", {4, 6});
+        FreeWill::TensorDescriptorHandle biasGrad = model->addTensor("biasGrad", {4});
+
+        FreeWill::OperatorDescriptorHandle fullyConnected = model->addOperator("fullyConnected", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                            {{"Input", features.reshape({6})}, {"Weight", weight}, {"Bias", bias}}, {{"Output", hidden}});
+        FreeWill::OperatorDescriptorHandle sigmoid = model->addOperator("sigmoid", FreeWill::OperatorName::ACTIVATION,
+                            {{"Input", hidden}}, {{"Output", hidden}}, {{"Mode", FreeWill::ActivationMode::SIGMOID}});
+        FreeWill::OperatorDescriptorHandle fullyConnectedDerivative = model->addOperator("fullyConnectedDerivative", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS_DERIVATIVE,
+                            {{"InputActivation", features.reshape({6})}, {"OutputDelta", hiddenGrad}, {"Weight", weight}},
+                            {{"WeightGrad", weightGrad}, {"BiasGrad", biasGrad}, {"InputDelta", featuresGrad}});
+
+        model->defineForwardPath({fullyConnected, sigmoid});
+        model->defineBackwardPath({fullyConnectedDerivative});
+        model->defineWeightUpdatePairs({{weight, weightGrad}, {bias, biasGrad}});
+
+        FreeWill::Solver solver;
+        solver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+        solver.m_batchSize = isViewed ? maxBatchSize : batchSize;
+        solver.m_planMemory = true;
+        QVERIFY(solver.init(model));
+
+        // hiddenGrad, fed from here at batchSize items, can't be viewed at more
+        std::vector<float> fedHiddenGrad(4 * batchSize);
+
+        if (isViewed)
+        {
+            QVERIFY(!model->setBatchSize(0));
+            QVERIFY(!model->setBatchSize(maxBatchSize + 1));
+            QVERIFY(model->setBatchSize(maxBatchSize - 1));
+            QVERIFY(model->setBatchSize(batchSize));
+
+            // the tensors before it, hidden among them, are viewed at the previous batch again:
+            // the forward pass leaves the item past it alone
+            QVERIFY(model->feedFromMemory(hiddenGrad, fedHiddenGrad.data()));
+            QVERIFY(!model->setBatchSize(batchSize + 1));
+            QVERIFY(model->batchSize() == batchSize);
+
+            float *hiddenData = model->beginMutateData(hidden);
+            std::fill(hiddenData + 4 * batchSize, hiddenData + 4 * (batchSize + 1), 42.0f);
+            model->endMutateData(hidden);
+        }
+
+        QVERIFY(model->batchSize() == batchSize);
+
+        float *weightData = model->beginMutateData(weight);
+        for (unsigned int i = 0; i < 4 * 6; ++i)
+        {
+            weightData[i] = (float) ((i * 7) % 9) / 9.0f - 0.5f;
+        }
+        model->endMutateData(weight);
+
+        float *biasData = model->beginMutateData(bias);
+        for (unsigned int i = 0; i < 4; ++i)
+        {
+            biasData[i] = 0.1f * i;
+        }
+        model->endMutateData(bias);
+
+        float *featureData = model->beginMutateData(features);
+        for (unsigned int i = 0; i < 6 * batchSize; ++i)
+        {
+            featureData[i] = (float) ((i * 5) % 11) / 11.0f - 0.5f;
+        }
+        model->endMutateData(features);
+
+        float *hiddenGradData = model->beginMutateData(hiddenGrad);
+        for (unsigned int i = 0; i < 4 * batchSize; ++i)
+        {
+            hiddenGradData[i] = (float) ((i * 3) % 7) / 7.0f - 0.5f;
+        }
+        model->endMutateData(hiddenGrad);
+
+        model->clearTensor(weightGrad);
+        model->clearTensor(biasGrad);
+        model->clearTensor(featuresGrad);
+
+        solver.forward(model);
+
+        if (isViewed)
+        {
+            const float *hiddenData = model->readonlyAccess(hidden);
+            QVERIFY(std::all_of(hiddenData + 4 * batchSize, hiddenData + 4 * (batchSize + 1), [](float value){return value == 42.0f;}));
+        }
+
+        solver.backward(model);
+
+        const float *outputData = model->readonlyAccess(hidden);
+        outputs[run].assign(outputData, outputData + 4 * batchSize);
+        const float *weightGradData = model->readonlyAccess(weightGrad);
+        weightGrads[run].assign(weightGradData, weightGradData + 4 * 6);
+        const float *inputGradData = model->readonlyAccess(featuresGrad);
+        inputGrads[run].assign(inputGradData, inputGradData + 6 * batchSize);
+
+        delete model;
+    }
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+
+    QVERIFY(outputs[0] == outputs[1]);
+    QVERIFY(weightGrads[0] == weightGrads[1]);
+    QVERIFY(inputGrads[0] == inputGrads[1]);
+}
+
+void FreeWillUnitTest::feedFromMemoryTest()
+{
+    const unsigned int batchSize = 2;
+    const unsigned int deviceCount = 2;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(deviceCount);
+
+    FreeWill::Model *model = FreeWill::Model::create();
+
+    FreeWill::TensorDescriptorHandle features = model->addTensor("features", {3}).enableBatch();
+    FreeWill::TensorDescriptorHandle hidden = model->addTensor("hidden", {2}).enableBatch();
+    FreeWill::TensorDescriptorHandle weight = model->addTensor("weight", {2, 3});
+    FreeWill::TensorDescriptorHandle bias = model->addTensor("bias", {2});
+
+    FreeWill::OperatorDescriptorHandle fullyConnected = model->addOperator("fullyConnected", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                        {{"Input", features}, {"Weight", weight}, {"Bias", bias}}, {{"Output", hidden}});
+
+    model->defineForwardPath({fullyConnected});
+
+    FreeWill::Solver solver;
+    solver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+    solver.m_mode = FreeWill::SolverMode::INFERENCE;
+    solver.m_batchSize = batchSize;
+    QVERIFY(solver.init(model));
+
+    for (unsigned int d = 0; d < deviceCount; ++d)
+    {
+        float *weightData = model->beginMutateData(weight, d);
+        for (unsigned int i = 0; i < 2 * 3; ++i)
+        {
+            weightData[i] = 0.1f * (float) i - 0.2f;
+        }
+
+        float *biasData = model->beginMutateData(bias, d);
+        biasData[0] = 0.5f;
+        biasData[1] = -0.5f;
+    }
+
+    // the global batch, device d reads items d * batchSize to (d + 1) * batchSize
+    std::vector<float> globalBatch(3 * batchSize * deviceCount);
+    for (unsigned int i = 0; i < globalBatch.size(); ++i)
+    {
+        globalBatch[i] = (float) ((i * 5) % 7) / 7.0f;
+    }
+
+    QVERIFY(!model->feedFromMemory(weight, globalBatch.data()));
+    QVERIFY(model->feedFromMemory(features, globalBatch.data()));
+
+    for (unsigned int d = 0; d < deviceCount; ++d)
+    {
+        QVERIFY(model->readonlyAccess(features, d) == globalBatch.data() + d * 3 * batchSize);
+    }
+
+    solver.forward(model);
+
+    for (unsigned int d = 0; d < deviceCount; ++d)
+    {
+        const float *hiddenData = model->readonlyAccess(hidden, d);
+
+        for (unsigned int b = 0; b < batchSize; ++b)
+        {
+            for (unsigned int o = 0; o < 2; ++o)
+            {
+                float expected = o == 0 ? 0.5f : -0.5f;
+                for (unsigned int i = 0; i < 3; ++i)
+                {
+                    expected += (0.1f * (float) (i * 2 + o) - 0.2f) * globalBatch[(d * batchSize + b) * 3 + i];
+                }
+
+                QVERIFY(std::abs(hiddenData[b * 2 + o] - expected) < epsilon);
+            }
+        }
+    }
+
+    // feeding again only swaps the pointer
+    std::vector<float> nextBatch(globalBatch.rbegin(), globalBatch.rend());
+    QVERIFY(model->feedFromMemory(features, nextBatch.data()));
+    QVERIFY(model->readonlyAccess(features, 1) == nextBatch.data() + 3 * batchSize);
+
+    delete model;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+
+    // the operator binds its output on evaluate
+    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> output({3, batchSize});
+    QVERIFY(output.init());
+
+    FreeWill::FeedFromMemory<FreeWill::DeviceType::CPU_NAIVE, float> feedFromMemory;
+    QVERIFY(!feedFromMemory.init());
+    feedFromMemory.setOutputParameter("Output", &output);
+    QVERIFY(feedFromMemory.init());
+
+    feedFromMemory.setSource(globalBatch.data());
+    feedFromMemory.evaluate();
+
+    QVERIFY(output.cpuDataHandle() == globalBatch.data());
+    QVERIFY(output.blob().isHostBound());
+    QVERIFY(output[4] == globalBatch[4]);
+}
+
+void FreeWillUnitTest::scatterBatchTest()
+{
+    const unsigned int batchSize = 2;
+    const unsigned int deviceCount = 3;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(deviceCount);
+
+    FreeWill::Model *model = FreeWill::Model::create();
+
+    FreeWill::TensorDescriptorHandle features = model->addTensor("features", {3}).enableBatch();
+    FreeWill::TensorDescriptorHandle label = model->addTensor("label", {1}, FreeWill::DataType::UNSIGNED_INT).enableBatch();
+    FreeWill::TensorDescriptorHandle hidden = model->addTensor("hidden", {2}).enableBatch();
+    FreeWill::TensorDescriptorHandle weight = model->addTensor("weight", {2, 3});
+    FreeWill::TensorDescriptorHandle bias = model->addTensor("bias", {2});
+
+    FreeWill::OperatorDescriptorHandle fullyConnected = model->addOperator("fullyConnected", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                        {{"Input", features}, {"Weight", weight}, {"Bias", bias}}, {{"Output", hidden}});
+
+    model->defineForwardPath({fullyConnected});
+
+    FreeWill::Solver solver;
+    solver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+    solver.m_batchSize = batchSize;
+    QVERIFY(solver.init(model));
+
+    QVERIFY(model->beginScatterData(weight) == nullptr);
+
+    for (unsigned int step = 0; step < 2; ++step)
+    {
+        float *globalFeatures = model->beginScatterData(features);
+        unsigned int *globalLabels = model->beginScatterData<FreeWill::DeviceType::CPU_NAIVE, unsigned int>(label);
+        QVERIFY(globalFeatures && globalLabels);
+
+        for (unsigned int i = 0; i < 3 * batchSize * deviceCount; ++i)
+        {
+            globalFeatures[i] = (float) (i + step);
+        }
+
+        for (unsigned int i = 0; i < batchSize * deviceCount; ++i)
+        {
+            globalLabels[i] = i * 10 + step;
+        }
+
+        model->endMutateData(features);
+        model->endMutateData(label);
+
+        for (unsigned int d = 0; d < deviceCount; ++d)
+        {
+            // a copy of the slice in the replica's own memory
+            const float *featureData = model->readonlyAccess(features, d);
+            QVERIFY(featureData != globalFeatures + d * 3 * batchSize);
+
+            for (unsigned int i = 0; i < 3 * batchSize; ++i)
+            {
+                QVERIFY(featureData[i] == (float) (d * 3 * batchSize + i + step));
+            }
+
+            const unsigned int *labelData = model->readonlyAccess<FreeWill::DeviceType::CPU_NAIVE, unsigned int>(label, d);
+
+            for (unsigned int i = 0; i < batchSize; ++i)
+            {
+                QVERIFY(labelData[i] == (d * batchSize + i) * 10 + step);
+            }
+        }
+    }
+
+    // without a pending scatter the tensor is broadcast from device 0 as before
+    float *featureData = model->beginMutateData(features, 0);
+    featureData[0] = -1.0f;
+    model->endMutateData(features);
+    QVERIFY(model->readonlyAccess(features, deviceCount - 1)[0] == -1.0f);
+
+    // the model has no update pairs, a training step leaves its weight alone
+    float *weightData = model->beginMutateData(weight);
+    std::fill(weightData, weightData + 2 * 3, 0.5f);
+    model->endMutateData(weight);
+
+    solver.forward(model);
+    solver.backward(model);
+    solver.update();
+
+    const float *updatedWeight = model->readonlyAccess(weight);
+    QVERIFY(std::all_of(updatedWeight, updatedWeight + 2 * 3, [](float value){return value == 0.5f;}));
+
+    delete model;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+}
+
+void FreeWillUnitTest::checkpointTest()
+{
+    const unsigned int deviceCount = 2;
+    const unsigned int size = 17;
+    const float learningRate = -0.01f;
+    const std::string filename = "freewill-test-checkpoint";
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(deviceCount);
+
+    FreeWill::Model *models[2] = {FreeWill::Model::create(), FreeWill::Model::create()};
+    FreeWill::TensorDescriptorHandle weights[2];
+    FreeWill::TensorDescriptorHandle grads[2];
+    FreeWill::Solver solvers[2];
+
+    for (unsigned int m = 0; m < 2; ++m)
+    {
+        weights[m] = models[m]->addTensor("weight", {size});
+        grads[m] = models[m]->addTensor("weightGrad", {size});
+        models[m]->defineWeightUpdatePairs({{weights[m], grads[m]}});
+
+        solvers[m].m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+        solvers[m].m_batchSize = 1;
+        solvers[m].m_optimizer.m_type = FreeWill::OptimizerType::ADAM;
+        QVERIFY(solvers[m].init(models[m]));
+    }
+
+    auto step = [&](unsigned int m, unsigned int stepIndex)
+    {
+        for (unsigned int d = 0; d < deviceCount; ++d)
+        {
+            float *gradData = models[m]->beginMutateData(grads[m], d);
+            for (unsigned int i = 0; i < size; ++i)
+            {
+                gradData[i] = (float) ((i * 5 + d * 3 + stepIndex) % 11) / 11.0f - 0.3f;
+            }
+            models[m]->endMutateData(grads[m], d);
+        }
+
+        solvers[m].update(learningRate);
+    };
+
+    float *weightData = models[0]->beginMutateData(weights[0]);
+    for (unsigned int i = 0; i < size; ++i)
+    {
+        weightData[i] = (float) ((i * 7) % 13) / 13.0f - 0.5f;
+    }
+    models[0]->endMutateData(weights[0]);
+
+    step(0, 1);
+    step(0, 2);
+
+    QVERIFY(models[0]->saveCheckpoint(filename, &solvers[0]));
+    QVERIFY(!models[1]->loadCheckpoint(filename + ".missing", &solvers[1]));
+    QVERIFY(models[1]->loadCheckpoint(filename, &solvers[1]));
+    QVERIFY(solvers[1].state().m_step == 2);
+
+    // the third step of the restored model continues the adam moments and bias correction
+    step(0, 3);
+    step(1, 3);
+
+    for (unsigned int d = 0; d < deviceCount; ++d)
+    {
+        const float *expected = models[0]->readonlyAccess(weights[0], d);
+        const float *restored = models[1]->readonlyAccess(weights[1], d);
+
+        for (unsigned int i = 0; i < size; ++i)
+        {
+            QVERIFY(restored[i] == expected[i]);
+        }
+    }
+
+    // the writer snapshots the weights at save(), the steps taken while it writes don't show
+    std::vector<float> snapshot(models[0]->readonlyAccess(weights[0]), models[0]->readonlyAccess(weights[0]) + size);
+
+    FreeWill::CheckpointWriter writer;
+    QVERIFY(writer.save(models[0], filename, &solvers[0]));
+    step(0, 4);
+    QVERIFY(writer.wait());
+    QVERIFY(!writer.isWriting());
+
+    QVERIFY(models[1]->loadCheckpoint(filename, &solvers[1]));
+    QVERIFY(solvers[1].state().m_step == 3);
+    for (unsigned int i = 0; i < size; ++i)
+    {
+        QVERIFY(models[1]->readonlyAccess(weights[1], 1)[i] == snapshot[i]);
+    }
+
+    // a tensor of another shape refuses the checkpoint
+    FreeWill::Model *otherModel = FreeWill::Model::create();
+    FreeWill::TensorDescriptorHandle otherWeight = otherModel->addTensor("weight", {size + 1});
+    FreeWill::TensorDescriptorHandle otherGrad = otherModel->addTensor("weightGrad", {size + 1});
+    otherModel->defineWeightUpdatePairs({{otherWeight, otherGrad}});
+
+    FreeWill::Solver otherSolver;
+    otherSolver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+    otherSolver.m_batchSize = 1;
+    QVERIFY(otherSolver.init(otherModel));
+    QVERIFY(!otherModel->loadCheckpoint(filename));
+
+    // the second tensor refuses the checkpoint, the first one isn't written either
+    FreeWill::Model *pairModels[2] = {FreeWill::Model::create(), FreeWill::Model::create()};
+    FreeWill::TensorDescriptorHandle firsts[2];
+    FreeWill::Solver pairSolvers[2];
+
+    for (unsigned int m = 0; m < 2; ++m)
+    {
+        unsigned int secondSize = m == 0 ? size : size + 1;
+        firsts[m] = pairModels[m]->addTensor("first", {size});
+        FreeWill::TensorDescriptorHandle second = pairModels[m]->addTensor("second", {secondSize});
+        pairModels[m]->defineWeightUpdatePairs({{firsts[m], pairModels[m]->addTensor("firstGrad", {size})},
+                                                {second, pairModels[m]->addTensor("secondGrad", {secondSize})}});
+
+        pairSolvers[m].m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+        pairSolvers[m].m_batchSize = 1;
+        QVERIFY(pairSolvers[m].init(pairModels[m]));
+
+        float *firstData = pairModels[m]->beginMutateData(firsts[m]);
+        std::fill(firstData, firstData + size, (float) m + 1.0f);
+        pairModels[m]->endMutateData(firsts[m]);
+    }
+
+    QVERIFY(pairModels[0]->saveCheckpoint(filename + ".pair"));
+    QVERIFY(!pairModels[1]->loadCheckpoint(filename + ".pair"));
+    for (unsigned int i = 0; i < size; ++i)
+    {
+        QVERIFY(pairModels[1]->readonlyAccess(firsts[1])[i] == 2.0f);
+    }
+
+    delete pairModels[0];
+    delete pairModels[1];
+    std::remove((filename + ".pair").c_str());
+
+    delete otherModel;
+    delete models[0];
+    delete models[1];
+
+    std::remove(filename.c_str());
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+}
+
+void FreeWillUnitTest::sharedWeightsTest()
+{
+    const unsigned int batchSize = 3;
+    const unsigned int modelCount = 3;
+    const std::string filename = "freewill-test-shared-weights";
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(2);
+
+    FreeWill::Model *models[modelCount];
+    FreeWill::TensorDescriptorHandle features[modelCount];
+    FreeWill::TensorDescriptorHandle parameters[modelCount][2];
+    FreeWill::TensorDescriptorHandle outputs[modelCount];
+    FreeWill::Solver solvers[modelCount];
+
+    for (unsigned int m = 0; m < modelCount; ++m)
+    {
+        models[m] = FreeWill::Model::create();
+        features[m] = models[m]->addTensor("features", {5}).enableBatch();
+        outputs[m] = models[m]->addTensor("output", {4}).enableBatch();
+        // randomizing a shared weight would write the mapped checkpoint
+        parameters[m][0] = models[m]->addTensor("weight", {4, 5}).randomize();
+        parameters[m][1] = models[m]->addTensor("bias", {4});
+
+        FreeWill::OperatorDescriptorHandle fullyConnected = models[m]->addOperator("fullyConnected", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                            {{"Input", features[m]}, {"Weight", parameters[m][0]}, {"Bias", parameters[m][1]}}, {{"Output", outputs[m]}});
+        models[m]->defineForwardPath({fullyConnected});
+
+        solvers[m].m_mode = FreeWill::SolverMode::INFERENCE;
+        solvers[m].m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+        solvers[m].m_batchSize = batchSize;
+    }
+
+    // the first model owns its weights and writes the checkpoint the others share
+    QVERIFY(solvers[0].init(models[0]));
+
+    float *biasData = models[0]->beginMutateData(parameters[0][1]);
+    for (unsigned int i = 0; i < 4; ++i)
+    {
+        biasData[i] = (float) i * 0.25f - 0.5f;
+    }
+    models[0]->endMutateData(parameters[0][1]);
+
+    QVERIFY(models[0]->saveCheckpoint(filename));
+
+    QVERIFY(!FreeWill::SharedWeights::open(filename + ".missing"));
+    std::shared_ptr<FreeWill::SharedWeights> sharedWeights = FreeWill::SharedWeights::open(filename);
+    QVERIFY(sharedWeights);
+
+    for (unsigned int m = 1; m < modelCount; ++m)
+    {
+        QVERIFY(models[m]->shareWeights(sharedWeights));
+        QVERIFY(solvers[m].init(models[m]));
+        QVERIFY(!models[m]->shareWeights(sharedWeights));
+    }
+
+    // a restore leaves the shared weights alone
+    QVERIFY(models[1]->loadCheckpoint(filename));
+
+    std::vector<float> results[modelCount];
+
+    for (unsigned int m = 0; m < modelCount; ++m)
+    {
+        float *featureData = models[m]->beginMutateData(features[m]);
+        for (unsigned int i = 0; i < 5 * batchSize; ++i)
+        {
+            featureData[i] = (float) ((i * 3) % 7) / 7.0f - 0.5f;
+        }
+        models[m]->endMutateData(features[m]);
+
+        solvers[m].forward(models[m]);
+
+        const float *outputData = models[m]->readonlyAccess(outputs[m]);
+        results[m].assign(outputData, outputData + 4 * batchSize);
+    }
+
+    for (unsigned int m = 1; m < modelCount; ++m)
+    {
+        // one copy of the weights for the models and their replicas, activations of their own
+        QVERIFY(models[m]->readonlyAccess(parameters[m][0]) == models[1]->readonlyAccess(parameters[1][0]));
+        QVERIFY(models[m]->readonlyAccess(parameters[m][0], 1) == models[1]->readonlyAccess(parameters[1][0]));
+        QVERIFY(models[m]->readonlyAccess(parameters[m][0]) != models[0]->readonlyAccess(parameters[0][0]));
+
+        for (unsigned int i = 0; i < results[0].size(); ++i)
+        {
+            QVERIFY(results[m][i] == results[0][i]);
+        }
+    }
+
+    QVERIFY(models[2]->readonlyAccess(outputs[2]) != models[1]->readonlyAccess(outputs[1]));
+
+    // the weights outlive the handle, the models keep them
+    sharedWeights.reset();
+    solvers[2].forward(models[2]);
+    QVERIFY(models[2]->readonlyAccess(outputs[2])[0] == results[0][0]);
+
+    // read only weights can't be trained
+    FreeWill::Model *trainedModel = FreeWill::Model::create();
+    trainedModel->addTensor("weight", {4, 5});
+    FreeWill::Solver trainingSolver;
+    trainingSolver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+    trainingSolver.m_batchSize = batchSize;
+    QVERIFY(trainedModel->shareWeights(FreeWill::SharedWeights::open(filename)));
+    QVERIFY(!trainingSolver.init(trainedModel));
+
+    delete trainedModel;
+
+    for (unsigned int m = 0; m < modelCount; ++m)
+    {
+        delete models[m];
+    }
+
+    std::remove(filename.c_str());
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+}
+
+void FreeWillUnitTest::asyncEvaluationTest()
+{
+    const unsigned int deviceCount = 2;
+    const unsigned int batchSize = 4;
+    const unsigned int batchCount = 3;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(deviceCount);
+
+    // the training model only needs the weights, the evaluation model scores them on device 1
+    FreeWill::Model *trainingModel = FreeWill::Model::create();
+    FreeWill::TensorDescriptorHandle weight = trainingModel->addTensor("weight", {2, 4});
+    FreeWill::TensorDescriptorHandle bias = trainingModel->addTensor("bias", {2});
+    FreeWill::TensorDescriptorHandle weightGrad = trainingModel->addTensor("weightGrad", {2, 4});
+    FreeWill::TensorDescriptorHandle biasGrad = trainingModel->addTensor("biasGrad", {2});
+    trainingModel->defineWeightUpdatePairs({{weight, weightGrad}, {bias, biasGrad}});
+
+    FreeWill::Solver trainingSolver;
+    trainingSolver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+    trainingSolver.m_batchSize = batchSize;
+    QVERIFY(trainingSolver.init(trainingModel));
+
+    FreeWill::Model *model = FreeWill::Model::create();
+    FreeWill::TensorDescriptorHandle features = model->addTensor("features", {4}).enableBatch();
+    FreeWill::TensorDescriptorHandle output = model->addTensor("output", {2}).enableBatch();
+    FreeWill::TensorDescriptorHandle label = model->addTensor("label", {1}, FreeWill::DataType::UNSIGNED_INT).enableBatch();
+    FreeWill::TensorDescriptorHandle accumulator = model->addTensor("accumulator", {3}, FreeWill::DataType::DOUBLE);
+    FreeWill::TensorDescriptorHandle evaluationWeight = model->addTensor("weight", {2, 4});
+    FreeWill::TensorDescriptorHandle evaluationBias = model->addTensor("bias", {2});
+
+    FreeWill::OperatorDescriptorHandle fullyConnected = model->addOperator("fullyConnected", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                        {{"Input", features}, {"Weight", evaluationWeight}, {"Bias", evaluationBias}}, {{"Output", output}});
+    FreeWill::OperatorDescriptorHandle metric = model->addOperator("metric", FreeWill::OperatorName::METRIC,
+                        {{"Output", output}, {"Label", label}}, {{"Accumulator", accumulator}});
+
+    model->defineForwardPath({fullyConnected, metric});
+    QVERIFY(model->placeOperators({fullyConnected, metric}, 1));
+
+    FreeWill::Solver solver;
+    solver.m_mode = FreeWill::SolverMode::INFERENCE;
+    solver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+    solver.m_batchSize = batchSize;
+    QVERIFY(solver.init(model));
+
+    for (unsigned int d = 0; d < deviceCount; ++d)
+    {
+        float *weightData = trainingModel->beginMutateData(weight, d);
+        for (unsigned int i = 0; i < 2 * 4; ++i)
+        {
+            weightData[i] = (float) i / 8.0f - 0.5f;
+        }
+
+        float *biasData = trainingModel->beginMutateData(bias, d);
+        biasData[0] = 0.25f;
+        biasData[1] = -0.75f;
+    }
+
+    std::vector<float> snapshotWeight(trainingModel->readonlyAccess(weight), trainingModel->readonlyAccess(weight) + 2 * 4);
+    std::vector<float> snapshotBias(trainingModel->readonlyAccess(bias), trainingModel->readonlyAccess(bias) + 2);
+
+    auto sample = [](unsigned int b, unsigned int s, unsigned int i)
+    {
+        return (float) (((b * batchSize + s) * 4 + i) % 7) - 3.0f;
+    };
+
+    // the label is the first class for every sample, the hits are the samples the snapshot
+    // scores higher there
+    double expectedHits = 0.0;
+    for (unsigned int b = 0; b < batchCount; ++b)
+    {
+        for (unsigned int s = 0; s < batchSize; ++s)
+        {
+            float scores[2] = {snapshotBias[0], snapshotBias[1]};
+            for (unsigned int o = 0; o < 2; ++o)
+            {
+                for (unsigned int i = 0; i < 4; ++i)
+                {
+                    scores[o] += snapshotWeight[o + i * 2] * sample(b, s, i);
+                }
+            }
+            expectedHits += scores[1] > scores[0] ? 0.0 : 1.0;
+        }
+    }
+
+    FreeWill::AsyncEvaluator evaluator(model, &solver, accumulator, [&](FreeWill::Model *evaluationModel, unsigned int batchIndex)
+    {
+        if (batchIndex >= batchCount)
+        {
+            return false;
+        }
+
+        float *featureData = evaluationModel->beginMutateData(features);
+        unsigned int *labelData = evaluationModel->beginMutateData<FreeWill::DeviceType::CPU_NAIVE, unsigned int>(label);
+
+        for (unsigned int s = 0; s < batchSize; ++s)
+        {
+            for (unsigned int i = 0; i < 4; ++i)
+            {
+                featureData[s * 4 + i] = sample(batchIndex, s, i);
+            }
+            labelData[s] = 0;
+        }
+
+        return true;
+    });
+
+    FreeWill::Profiler &profiler = FreeWill::Profiler::getSingleton();
+    profiler.enable(false);
+
+    QVERIFY(evaluator.start(trainingModel, 7));
+
+    // training goes on while the replica scores the snapshot
+    for (unsigned int d = 0; d < deviceCount; ++d)
+    {
+        float *weightGradData = trainingModel->beginMutateData(weightGrad, d);
+        for (unsigned int i = 0; i < 2 * 4; ++i)
+        {
+            weightGradData[i] = (i % 2) ? 100.0f : -100.0f;
+        }
+    }
+    trainingSolver.update(-0.01);
+
+    QVERIFY(evaluator.wait());
+    QVERIFY(!evaluator.isEvaluating());
+    QVERIFY(trainingModel->readonlyAccess(weight)[0] != snapshotWeight[0]);
+
+    QVERIFY(evaluator.values().m_sampleCount == batchCount * batchSize);
+    QVERIFY(evaluator.values().m_hitCount == expectedHits);
+
+    FreeWill::TrainingMetrics metrics = profiler.metrics(FreeWill::DeviceType::CPU_NAIVE);
+    QVERIFY(metrics.m_evaluation.m_count == 1);
+    QVERIFY(metrics.m_evaluation.m_step == 7);
+    QVERIFY(metrics.m_evaluation.m_accuracy == expectedHits / (batchCount * batchSize));
+
+    profiler.disable();
+    profiler.clear();
+
+    // a replica whose weight has another shape refuses the snapshot
+    FreeWill::Model *otherModel = FreeWill::Model::create();
+    FreeWill::TensorDescriptorHandle otherWeight = otherModel->addTensor("weight", {3, 4});
+    FreeWill::TensorDescriptorHandle otherAccumulator = otherModel->addTensor("accumulator", {3}, FreeWill::DataType::DOUBLE);
+    otherModel->defineWeightUpdatePairs({{otherWeight, otherModel->addTensor("weightGrad", {3, 4})}});
+
+    FreeWill::Solver otherSolver;
+    otherSolver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+    otherSolver.m_batchSize = batchSize;
+    QVERIFY(otherSolver.init(otherModel));
+
+    FreeWill::AsyncEvaluator otherEvaluator(otherModel, &otherSolver, otherAccumulator, [](FreeWill::Model *, unsigned int){return false;});
+    QVERIFY(!otherEvaluator.start(trainingModel, 8));
+
+    delete otherModel;
+    delete model;
+    delete trainingModel;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+}
+
+void FreeWillUnitTest::graphSerializationTest()
+{
+    const unsigned int batchSize = 4;
+    const std::string graphFilenames[2] = {"freewill-test-graph", "freewill-test-graph-reloaded"};
+    const std::string checkpointFilename = "freewill-test-graph-checkpoint";
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(1);
+
+    std::vector<float> results[2];
+
+    for (unsigned int run = 0; run < 2; ++run)
+    {
+        FreeWill::Model *model = FreeWill::Model::create();
+        FreeWill::TensorDescriptorHandle features;
+        FreeWill::TensorDescriptorHandle result;
+
+        if (run == 0)
+        {
+            features = model->addTensor("features", {8}).enableBatch();
+            FreeWill::TensorDescriptorHandle hidden = model->addTensor("hidden", {6}).enableBatch();
+            FreeWill::TensorDescriptorHandle hiddenActivation = model->addTensor("hiddenActivation", {6}).enableBatch();
+            result = model->addTensor("result", {3}).enableBatch();
+            FreeWill::TensorDescriptorHandle weight = model->addTensor("weight", {6, 8}).randomize();
+            FreeWill::TensorDescriptorHandle bias = model->addTensor("bias", {6});
+            FreeWill::TensorDescriptorHandle weight2 = model->addTensor("weight2", {3, 2, 3}).randomize();
+            FreeWill::TensorDescriptorHandle bias2 = model->addTensor("bias2", {3});
+            FreeWill::TensorDescriptorHandle weight2Grad = model->addTensor("weight2Grad", {3, 2, 3});
+            FreeWill::TensorDescriptorHandle bias2Grad = model->addTensor("bias2Grad", {3});
+            FreeWill::TensorDescriptorHandle resultGrad = model->addTensor("resultGrad", {3}).enableBatch();
+            FreeWill::TensorDescriptorHandle hiddenGrad = model->addTensor("hiddenGrad", {6}).enableBatch();
+
+            // a reshaped weight and a parameter of each type the operators read
+            FreeWill::OperatorDescriptorHandle fullyConnected = model->addOperator("fullyConnected", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                                {{"Input", features}, {"Weight", weight}, {"Bias", bias}}, {{"Output", hidden}}, {{"HasBias", true}});
+            FreeWill::OperatorDescriptorHandle sigmoid = model->addOperator("sigmoid", FreeWill::OperatorName::ACTIVATION,
+                                {{"Input", hidden}}, {{"Output", hiddenActivation}}, {{"Mode", FreeWill::ActivationMode::SIGMOID}});
+            FreeWill::OperatorDescriptorHandle fullyConnected2 = model->addOperator("fullyConnected2", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                                {{"Input", hiddenActivation}, {"Weight", weight2.reshape({3, 6})}, {"Bias", bias2}}, {{"Output", result}});
+            FreeWill::OperatorDescriptorHandle fullyConnected2Derivative = model->addOperator("fullyConnected2Derivative",
+                                FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS_DERIVATIVE,
+                                {{"InputActivation", hiddenActivation}, {"OutputDelta", resultGrad}, {"Weight", weight2.reshape({3, 6})}},
+                                {{"WeightGrad", weight2Grad.reshape({3, 6})}, {"BiasGrad", bias2Grad}, {"InputDelta", hiddenGrad}});
+
+            model->defineForwardPath({fullyConnected, sigmoid, fullyConnected2});
+            model->defineBackwardPath({fullyConnected2Derivative});
+            model->defineWeightUpdatePairs({{weight2, weight2Grad}, {bias2, bias2Grad}});
+        }
+        else
+        {
+            QVERIFY(!model->loadGraph(graphFilenames[0] + ".missing"));
+
+            // fails on its last line, after every tensor and operator is read
+            {
+                std::ifstream file(graphFilenames[0]);
+                std::ofstream brokenFile(graphFilenames[0] + ".broken");
+                brokenFile << file.rdbuf() << "unknown record\n";
+            }
+            QVERIFY(!model->loadGraph(graphFilenames[0] + ".broken"));
+            std::remove((graphFilenames[0] + ".broken").c_str());
+
+            QVERIFY(model->loadGraph(graphFilenames[0]));
+            QVERIFY(!model->loadGraph(graphFilenames[0]));
+
+            features = FreeWill::TensorDescriptorHandle(model, "features");
+            result = FreeWill::TensorDescriptorHandle(model, "result");
+        }
+
+        FreeWill::Solver solver;
+        solver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+        solver.m_batchSize = batchSize;
+        solver.m_planMemory = true;
+        QVERIFY(solver.init(model));
+
+        QVERIFY(model->saveGraph(graphFilenames[run]));
+
+        if (run == 0)
+        {
+            QVERIFY(model->saveCheckpoint(checkpointFilename, &solver));
+        }
+        else
+        {
+            QVERIFY(model->loadCheckpoint(checkpointFilename, &solver));
+        }
+
+        float *featureData = model->beginMutateData(features);
+        for (unsigned int i = 0; i < 8 * batchSize; ++i)
+        {
+            featureData[i] = (float) ((i * 3) % 7) / 7.0f - 0.5f;
+        }
+        model->endMutateData(features);
+
+        solver.forward(model);
+
+        const float *resultData = model->readonlyAccess(result);
+        results[run].assign(resultData, resultData + 3 * batchSize);
+
+        delete model;
+    }
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+
+    for (unsigned int i = 0; i < results[0].size(); ++i)
+    {
+        QVERIFY(results[0][i] == results[1][i]);
+    }
+
+    // the reloaded model saves the same graph, with the memory plan it took from the file
+    std::string graphs[2];
+    for (unsigned int run = 0; run < 2; ++run)
+    {
+        std::ifstream file(graphFilenames[run]);
+        std::stringstream stream;
+        stream << file.rdbuf();
+        graphs[run] = stream.str();
+
+        std::remove(graphFilenames[run].c_str());
+    }
+
+    QVERIFY(graphs[0] == graphs[1]);
+    QVERIFY(graphs[0].find("\nmemory 4 0 ") != std::string::npos);
+
+    // a plan is reused only for the graph of its key: the arena of the file is kept with the
+    // key and planned again with another one, and a changed path drops it
+    size_t memoryBegin = graphs[0].find("\nmemory ") + 1;
+    size_t memoryEnd = graphs[0].find('\n', memoryBegin);
+    std::string record;
+    unsigned int planBatchSize = 0;
+    unsigned int isForwardOnly = 0;
+    size_t arenaSizeInByte = 0;
+    size_t unplannedSizeInByte = 0;
+    uint64_t key = 0;
+    QVERIFY(std::istringstream(graphs[0].substr(memoryBegin, memoryEnd - memoryBegin)) >> record >> planBatchSize >> isForwardOnly
+            >> arenaSizeInByte >> unplannedSizeInByte >> key);
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(1);
+
+    for (unsigned int run = 0; run < 3; ++run)
+    {
+        std::ostringstream memory;
+        memory << "memory " << planBatchSize << " " << isForwardOnly << " " << arenaSizeInByte + 64 << " " << unplannedSizeInByte << " "
+               << (run == 1 ? key + 1 : key);
+
+        {
+            std::ofstream file(graphFilenames[0]);
+            file << graphs[0].substr(0, memoryBegin) << memory.str() << graphs[0].substr(memoryEnd);
+        }
+
+        FreeWill::Model *model = FreeWill::Model::create();
+        QVERIFY(model->loadGraph(graphFilenames[0]));
+
+        if (run == 2)
+        {
+            QVERIFY(model->defineForwardPath({"fullyConnected", "sigmoid", "fullyConnected2"}));
+            QVERIFY(model->saveGraph(graphFilenames[1]));
+
+            std::ifstream file(graphFilenames[1]);
+            std::stringstream stream;
+            stream << file.rdbuf();
+            QVERIFY(stream.str().find("\nmemory ") == std::string::npos);
+        }
+
+        FreeWill::Solver solver;
+        solver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+        solver.m_batchSize = batchSize;
+        solver.m_planMemory = true;
+        QVERIFY(solver.init(model));
+        QVERIFY(model->saveGraph(graphFilenames[1]));
+
+        std::ifstream file(graphFilenames[1]);
+        std::stringstream stream;
+        stream << file.rdbuf();
+        QVERIFY((stream.str() == graphs[0]) == (run != 0));
+        QVERIFY((stream.str().find(memory.str()) != std::string::npos) == (run == 0));
+
+        delete model;
+    }
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+
+    std::remove(graphFilenames[0].c_str());
+    std::remove(graphFilenames[1].c_str());
+    std::remove(checkpointFilename.c_str());
+}
+
+void FreeWillUnitTest::recomputationTest()
+{
+    const unsigned int batchSize = 4;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(1);
+
+    std::vector<float> results[2];
+    std::vector<float> weightGrads[2];
+    std::vector<float> featuresGrads[2];
+
+    // both runs draw the dropout stream first, so they draw the same masks
+    FreeWill::RandomNumberGenerator &generator = FreeWill::RandomNumberGenerator::getSingleton();
+    uint64_t seed = generator.seed();
+
+    for (unsigned int run = 0; run < 2; ++run)
+    {
+        // the second run recomputes the first layer and its dropout in the backward pass
+        bool isCheckpointed = (run == 1);
+        generator.setSeed(42);
+
+        FreeWill::Model *model = FreeWill::Model::create();
+
+        FreeWill::TensorDescriptorHandle features = model->addTensor("features", {8}).enableBatch();
+        FreeWill::TensorDescriptorHandle hidden = model->addTensor("hidden", {6}).enableBatch();
+        FreeWill::TensorDescriptorHandle hiddenActivation = model->addTensor("hiddenActivation", {6}).enableBatch();
+        FreeWill::TensorDescriptorHandle hiddenDropped = model->addTensor("hiddenDropped", {6}).enableBatch();
+        FreeWill::TensorDescriptorHandle mask = model->addTensor("mask", {1}, FreeWill::DataType::UNSIGNED_INT).enableBatch();
+        FreeWill::TensorDescriptorHandle seed = model->addTensor("seed", {1}, FreeWill::DataType::UNSIGNED_INT);
+        FreeWill::TensorDescriptorHandle result = model->addTensor("result", {3}).enableBatch();
+        FreeWill::TensorDescriptorHandle weight = model->addTensor("weight", {6, 8});
+        FreeWill::TensorDescriptorHandle bias = model->addTensor("bias", {6});
+        FreeWill::TensorDescriptorHandle weight2 = model->addTensor("weight2", {3, 6});
+        FreeWill::TensorDescriptorHandle bias2 = model->addTensor("bias2", {3});
+        FreeWill::TensorDescriptorHandle weightGrad = model->addTensor("weightGrad", {6, 8});
+        FreeWill::TensorDescriptorHandle biasGrad = model->addTensor("biasGrad", {6});
+        FreeWill::TensorDescriptorHandle weight2Grad = model->addTensor("weight2Grad", {3, 6});
+        FreeWill::TensorDescriptorHandle bias2Grad = model->addTensor("bias2Grad", {3});
+        FreeWill::TensorDescriptorHandle resultGrad = model->addTensor("resultGrad", {3}).enableBatch();
+        FreeWill::TensorDescriptorHandle hiddenDroppedGrad = model->addTensor("hiddenDroppedGrad", {6}).enableBatch();
+        FreeWill::TensorDescriptorHandle hiddenActivationGrad = model->addTensor("hiddenActivationGrad", {6}).enableBatch();
+        FreeWill::TensorDescriptorHandle hiddenGrad = model->addTensor("hiddenGrad", {6}).enableBatch();
+        FreeWill::TensorDescriptorHandle featuresGrad = model->addTensor("featuresGrad", {8}).enableBatch();
+
+        FreeWill::OperatorDescriptorHandle fullyConnected = model->addOperator("fullyConnected", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                            {{"Input", features}, {"Weight", weight}, {"Bias", bias}}, {{"Output", hidden}});
+        FreeWill::OperatorDescriptorHandle sigmoid = model->addOperator("sigmoid", FreeWill::OperatorName::ACTIVATION,
+                            {{"Input", hidden}}, {{"Output", hiddenActivation}}, {{"Mode", FreeWill::ActivationMode::SIGMOID}});
+        FreeWill::OperatorDescriptorHandle dropout = model->addOperator("dropout", FreeWill::OperatorName::DROPOUT,
+                            {{"Input", hiddenActivation}}, {{"Output", hiddenDropped}, {"Mask", mask}, {"Seed", seed}}, {{"Rate", 0.5f}});
+        FreeWill::OperatorDescriptorHandle fullyConnected2 = model->addOperator("fullyConnected2", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                            {{"Input", hiddenDropped}, {"Weight", weight2}, {"Bias", bias2}}, {{"Output", result}});
+        FreeWill::OperatorDescriptorHandle fullyConnected2Derivative = model->addOperator("fullyConnected2Derivative",
+                            FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS_DERIVATIVE,
+                            {{"InputActivation", hiddenDropped}, {"OutputDelta", resultGrad}, {"Weight", weight2}},
+                            {{"WeightGrad", weight2Grad}, {"BiasGrad", bias2Grad}, {"InputDelta", hiddenDroppedGrad}});
+        FreeWill::OperatorDescriptorHandle dropoutDerivative = model->addOperator("dropoutDerivative", FreeWill::OperatorName::DROPOUT_DERIVATIVE,
+                            {{"OutputDelta", hiddenDroppedGrad}, {"Mask", mask}, {"Seed", seed}}, {{"InputDelta", hiddenActivationGrad}}, {{"Rate", 0.5f}});
+        FreeWill::OperatorDescriptorHandle sigmoidDerivative = model->addOperator("sigmoidDerivative", FreeWill::OperatorName::ACTIVATION_DERIVATIVE,
+                            {{"Input", hidden}, {"Output", hiddenActivation}, {"OutputDelta", hiddenActivationGrad}}, {{"InputDelta", hiddenGrad}},
+                            {{"Mode", FreeWill::ActivationMode::SIGMOID}});
+        FreeWill::OperatorDescriptorHandle fullyConnectedDerivative = model->addOperator("fullyConnectedDerivative",
+                            FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS_DERIVATIVE,
+                            {{"InputActivation", features}, {"OutputDelta", hiddenGrad}, {"Weight", weight}},
+                            {{"WeightGrad", weightGrad}, {"BiasGrad", biasGrad}, {"InputDelta", featuresGrad}});
+
+        model->defineForwardPath({fullyConnected, sigmoid, dropout, fullyConnected2});
+        model->defineBackwardPath({fullyConnected2Derivative, dropoutDerivative, sigmoidDerivative, fullyConnectedDerivative});
+        model->defineWeightUpdatePairs({{weight, weightGrad}, {bias, biasGrad}, {weight2, weight2Grad}, {bias2, bias2Grad}});
+
+        QVERIFY(!model->checkpointSegment({sigmoid, fullyConnected}));
+        QVERIFY(!model->checkpointSegment({fullyConnected, dropout}));
+
+        if (isCheckpointed)
+        {
+            QVERIFY(model->checkpointSegment({fullyConnected, sigmoid, dropout}));
+            QVERIFY(!model->checkpointSegment({dropout, fullyConnected2}));
+        }
+
+        FreeWill::Solver solver;
+        solver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+        solver.m_batchSize = batchSize;
+        solver.m_planMemory = true;
+        QVERIFY(solver.init(model));
+
+        float *weightData = model->beginMutateData(weight);
+        for (unsigned int i = 0; i < 6 * 8; ++i)
+        {
+            weightData[i] = (float) ((i * 7) % 9) / 9.0f - 0.5f;
+        }
+        model->endMutateData(weight);
+
+        float *weight2Data = model->beginMutateData(weight2);
+        for (unsigned int i = 0; i < 3 * 6; ++i)
+        {
+            weight2Data[i] = (float) ((i * 5) % 7) / 7.0f - 0.5f;
+        }
+        model->endMutateData(weight2);
+
+        model->clearTensor(bias);
+        model->clearTensor(bias2);
+        model->clearTensor(seed);
+
+        float *featureData = model->beginMutateData(features);
+        for (unsigned int i = 0; i < 8 * batchSize; ++i)
+        {
+            featureData[i] = (float) ((i * 3) % 11) / 11.0f - 0.5f;
+        }
+        model->endMutateData(features);
+
+        float *resultGradData = model->beginMutateData(resultGrad);
+        for (unsigned int i = 0; i < 3 * batchSize; ++i)
+        {
+            resultGradData[i] = (float) ((i * 2) % 5) / 5.0f - 0.5f;
+        }
+        model->endMutateData(resultGrad);
+
+        model->clearTensor(weightGrad);
+        model->clearTensor(biasGrad);
+        model->clearTensor(weight2Grad);
+        model->clearTensor(bias2Grad);
+
+        solver.forward(model);
+
+        const float *resultData = model->readonlyAccess(result);
+        results[run].assign(resultData, resultData + 3 * batchSize);
+
+        solver.backward(model);
+
+        const float *weightGradData = model->readonlyAccess(weightGrad);
+        weightGrads[run].assign(weightGradData, weightGradData + 6 * 8);
+        const float *featuresGradData = model->readonlyAccess(featuresGrad);
+        featuresGrads[run].assign(featuresGradData, featuresGradData + 8 * batchSize);
+
+        delete model;
+    }
+
+    generator.setSeed(seed);
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+
+    // the recomputation draws the same dropout mask and gives the same gradients
+    QVERIFY(results[0] == results[1]);
+    QVERIFY(weightGrads[0] == weightGrads[1]);
+    QVERIFY(featuresGrads[0] == featuresGrads[1]);
+}
+
+void FreeWillUnitTest::activationCompressionTest()
+{
+    const unsigned int batchSize = 4;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(1);
+
+    const FreeWill::ActivationCompression compressions[3] = {FreeWill::ActivationCompression::NONE,
+                                                             FreeWill::ActivationCompression::EXACT,
+                                                             FreeWill::ActivationCompression::HALF};
+    std::vector<float> results[3];
+    std::vector<float> weightGrads[3];
+    std::vector<float> weight2Grads[3];
+    std::vector<float> featuresGrads[3];
+    size_t arenaSizes[3] = {0};
+
+    for (unsigned int run = 0; run < 3; ++run)
+    {
+        FreeWill::Model *model = FreeWill::Model::create();
+
+        FreeWill::TensorDescriptorHandle features = model->addTensor("features", {4, 8, 8}).enableBatch();
+        FreeWill::TensorDescriptorHandle activation = model->addTensor("activation", {4, 8, 8}).enableBatch();
+        FreeWill::TensorDescriptorHandle pooled = model->addTensor("pooled", {4, 4, 4}).enableBatch();
+        FreeWill::TensorDescriptorHandle switches = model->addTensor("switches", FreeWill::maxPoolingSwitchShape({4, 4, 4}), FreeWill::DataType::UNSIGNED_INT).enableBatch();
+        FreeWill::TensorDescriptorHandle hidden = model->addTensor("hidden", {6}).enableBatch();
+        FreeWill::TensorDescriptorHandle hiddenActivation = model->addTensor("hiddenActivation", {6}).enableBatch();
+        FreeWill::TensorDescriptorHandle result = model->addTensor("result", {3}).enableBatch();
+        FreeWill::TensorDescriptorHandle weight = model->addTensor("weight", {6, 64});
+        FreeWill::TensorDescriptorHandle bias = model->addTensor("bias", {6});
+        FreeWill::TensorDescriptorHandle weight2 = model->addTensor("weight2", {3, 6});
+        FreeWill::TensorDescriptorHandle bias2 = model->addTensor("bias2", {3});
+        FreeWill::TensorDescriptorHandle weightGrad = model->addTensor("weightGrad", {6, 64});
+        FreeWill::TensorDescriptorHandle biasGrad = model->addTensor("biasGrad", {6});
+        FreeWill::TensorDescriptorHandle weight2Grad = model->addTensor("weight2Grad", {3, 6});
+        FreeWill::TensorDescriptorHandle bias2Grad = model->addTensor("bias2Grad", {3});
+        FreeWill::TensorDescriptorHandle resultGrad = model->addTensor("resultGrad", {3}).enableBatch();
+        FreeWill::TensorDescriptorHandle hiddenActivationGrad = model->addTensor("hiddenActivationGrad", {6}).enableBatch();
+        FreeWill::TensorDescriptorHandle hiddenGrad = model->addTensor("hiddenGrad", {6}).enableBatch();
+        FreeWill::TensorDescriptorHandle pooledGrad = model->addTensor("pooledGrad", {4, 4, 4}).enableBatch();
+        FreeWill::TensorDescriptorHandle activationGrad = model->addTensor("activationGrad", {4, 8, 8}).enableBatch();
+        FreeWill::TensorDescriptorHandle featuresGrad = model->addTensor("featuresGrad", {4, 8, 8}).enableBatch();
+
+        FreeWill::OperatorDescriptorHandle relu = model->addOperator("relu", FreeWill::OperatorName::ACTIVATION,
+                            {{"Input", features}}, {{"Output", activation}}, {{"Mode", FreeWill::ActivationMode::RELU}});
+        FreeWill::OperatorDescriptorHandle maxPooling = model->addOperator("maxPooling", FreeWill::OperatorName::MAX_POOLING,
+                            {{"Input", activation}}, {{"Output", pooled}, {"Switch", switches}});
+        FreeWill::OperatorDescriptorHandle fullyConnected = model->addOperator("fullyConnected", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                            {{"Input", pooled.reshape({64})}, {"Weight", weight}, {"Bias", bias}}, {{"Output", hidden}});
+        FreeWill::OperatorDescriptorHandle relu2 = model->addOperator("relu2", FreeWill::OperatorName::ACTIVATION,
+                            {{"Input", hidden}}, {{"Output", hiddenActivation}}, {{"Mode", FreeWill::ActivationMode::RELU}});
+        FreeWill::OperatorDescriptorHandle fullyConnected2 = model->addOperator("fullyConnected2", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                            {{"Input", hiddenActivation}, {"Weight", weight2}, {"Bias", bias2}}, {{"Output", result}});
+        FreeWill::OperatorDescriptorHandle fullyConnected2Derivative = model->addOperator("fullyConnected2Derivative",
+                            FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS_DERIVATIVE,
+                            {{"InputActivation", hiddenActivation}, {"OutputDelta", resultGrad}, {"Weight", weight2}},
+                            {{"WeightGrad", weight2Grad}, {"BiasGrad", bias2Grad}, {"InputDelta", hiddenActivationGrad}});
+        FreeWill::OperatorDescriptorHandle relu2Derivative = model->addOperator("relu2Derivative", FreeWill::OperatorName::ACTIVATION_DERIVATIVE,
+                            {{"Output", hiddenActivation}, {"OutputDelta", hiddenActivationGrad}}, {{"InputDelta", hiddenGrad}},
+                            {{"Mode", FreeWill::ActivationMode::RELU}});
+        FreeWill::OperatorDescriptorHandle fullyConnectedDerivative = model->addOperator("fullyConnectedDerivative",
+                            FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS_DERIVATIVE,
+                            {{"InputActivation", pooled.reshape({64})}, {"OutputDelta", hiddenGrad}, {"Weight", weight}},
+                            {{"WeightGrad", weightGrad}, {"BiasGrad", biasGrad}, {"InputDelta", pooledGrad.reshape({64})}});
+        FreeWill::OperatorDescriptorHandle maxPoolingDerivative = model->addOperator("maxPoolingDerivative", FreeWill::OperatorName::MAX_POOLING_DERIVATIVE,
+                            {{"Input", activation}, {"Output", pooled}, {"OutputGrad", pooledGrad}, {"Switch", switches}}, {{"InputGrad", activationGrad}});
+        FreeWill::OperatorDescriptorHandle reluDerivative = model->addOperator("reluDerivative", FreeWill::OperatorName::ACTIVATION_DERIVATIVE,
+                            {{"Input", features}, {"Output", activation}, {"OutputDelta", activationGrad}}, {{"InputDelta", featuresGrad}},
+                            {{"Mode", FreeWill::ActivationMode::RELU}});
+
+        model->defineForwardPath({relu, maxPooling, fullyConnected, relu2, fullyConnected2});
+        model->defineBackwardPath({fullyConnected2Derivative, relu2Derivative, fullyConnectedDerivative, maxPoolingDerivative, reluDerivative});
+        model->defineWeightUpdatePairs({{weight, weightGrad}, {bias, biasGrad}, {weight2, weight2Grad}, {bias2, bias2Grad}});
+
+        FreeWill::Solver solver;
+        solver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+        solver.m_batchSize = batchSize;
+        solver.m_planMemory = true;
+        solver.m_activationCompression = compressions[run];
+        QVERIFY(solver.init(model));
+
+        arenaSizes[run] = model->memoryUsage()["memory plan"];
+
+        float *weightData = model->beginMutateData(weight);
+        for (unsigned int i = 0; i < 6 * 64; ++i)
+        {
+            weightData[i] = (float) ((i * 7) % 9) / 9.0f - 0.5f;
+        }
+        model->endMutateData(weight);
+
+        float *weight2Data = model->beginMutateData(weight2);
+        for (unsigned int i = 0; i < 3 * 6; ++i)
+        {
+            weight2Data[i] = (float) ((i * 5) % 7) / 7.0f - 0.5f;
+        }
+        model->endMutateData(weight2);
+
+        model->clearTensor(bias);
+        model->clearTensor(bias2);
+
+        float *featureData = model->beginMutateData(features);
+        for (unsigned int i = 0; i < 4 * 8 * 8 * batchSize; ++i)
+        {
+            featureData[i] = (float) ((i * 13) % 29) / 29.0f - 0.5f;
+        }
+        model->endMutateData(features);
+
+        float *resultGradData = model->beginMutateData(resultGrad);
+        for (unsigned int i = 0; i < 3 * batchSize; ++i)
+        {
+            resultGradData[i] = (float) ((i * 2) % 5) / 5.0f - 0.5f;
+        }
+        model->endMutateData(resultGrad);
+
+        model->clearTensor(weightGrad);
+        model->clearTensor(biasGrad);
+        model->clearTensor(weight2Grad);
+        model->clearTensor(bias2Grad);
+
+        solver.forward(model);
+
+        const float *resultData = model->readonlyAccess(result);
+        results[run].assign(resultData, resultData + 3 * batchSize);
+
+        solver.backward(model);
+
+        const float *weightGradData = model->readonlyAccess(weightGrad);
+        weightGrads[run].assign(weightGradData, weightGradData + 6 * 64);
+        const float *weight2GradData = model->readonlyAccess(weight2Grad);
+        weight2Grads[run].assign(weight2GradData, weight2GradData + 3 * 6);
+        const float *featuresGradData = model->readonlyAccess(featuresGrad);
+        featuresGrads[run].assign(featuresGradData, featuresGradData + 4 * 8 * 8 * batchSize);
+
+        delete model;
+    }
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+
+    // the masks and switches give the same gradients for less memory
+    QVERIFY(results[1] == results[0]);
+    QVERIFY(weightGrads[1] == weightGrads[0]);
+    QVERIFY(weight2Grads[1] == weight2Grads[0]);
+    QVERIFY(featuresGrads[1] == featuresGrads[0]);
+    QVERIFY(arenaSizes[1] < arenaSizes[0]);
+
+    // the second fully connected layer reads its input as Half, the rest stays exact
+    QVERIFY(results[2] == results[0]);
+    QVERIFY(featuresGrads[2] == featuresGrads[0]);
+
+    for (unsigned int i = 0; i < 3 * 6; ++i)
+    {
+        QVERIFY(std::abs(weight2Grads[2][i] - weight2Grads[0][i]) <= 1e-2f * (1.0f + std::abs(weight2Grads[0][i])));
+    }
+}
+
+void FreeWillUnitTest::parallelInitTest()
+{
+    const unsigned int deviceCount = 4;
+    const unsigned int batchSize = 2;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(deviceCount);
+
+    for (unsigned int run = 0; run < 2; ++run)
+    {
+        // the weight of the second model doesn't fit, its operator fails on every device
+        bool isBroken = (run == 1);
+
+        FreeWill::Model *model = FreeWill::Model::create();
+
+        FreeWill::TensorDescriptorHandle features = model->addTensor("features", {2, 4}).enableBatch();
+        FreeWill::TensorDescriptorHandle hidden = model->addTensor("hidden", {6}).enableBatch();
+        FreeWill::TensorDescriptorHandle hiddenDropped = model->addTensor("hiddenDropped", {6}).enableBatch();
+        FreeWill::TensorDescriptorHandle seed = model->addTensor("seed", {1}, FreeWill::DataType::UNSIGNED_INT);
+        FreeWill::TensorDescriptorHandle hiddenDroppedGrad = model->addTensor("hiddenDroppedGrad", {6}).enableBatch();
+        FreeWill::TensorDescriptorHandle hiddenGrad = model->addTensor("hiddenGrad", {6}).enableBatch();
+        FreeWill::TensorDescriptorHandle weight = model->addTensor("weight", {6, isBroken ? 7u : 8u});
+        FreeWill::TensorDescriptorHandle bias = model->addTensor("bias", {6});
+        FreeWill::TensorDescriptorHandle weightGrad = model->addTensor("weightGrad", {6, isBroken ? 7u : 8u});
+        FreeWill::TensorDescriptorHandle biasGrad = model->addTensor("biasGrad", {6});
+        FreeWill::TensorDescriptorHandle featuresGrad = model->addTensor("featuresGrad", {8}).enableBatch();
+
+        FreeWill::OperatorDescriptorHandle fullyConnected = model->addOperator("fullyConnected", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                            {{"Input", features.reshape({8})}, {"Weight", weight}, {"Bias", bias}}, {{"Output", hidden}});
+        // without a Mask the derivative draws the mask again, from the stream it shares with the dropout
+        FreeWill::OperatorDescriptorHandle dropout = model->addOperator("dropout", FreeWill::OperatorName::DROPOUT,
+                            {{"Input", hidden}}, {{"Output", hiddenDropped}, {"Seed", seed}}, {{"Rate", 0.5f}});
+        FreeWill::OperatorDescriptorHandle dropoutDerivative = model->addOperator("dropoutDerivative", FreeWill::OperatorName::DROPOUT_DERIVATIVE,
+                            {{"OutputDelta", hiddenDroppedGrad}, {"Seed", seed}}, {{"InputDelta", hiddenGrad}}, {{"Rate", 0.5f}});
+        FreeWill::OperatorDescriptorHandle fullyConnectedDerivative = model->addOperator("fullyConnectedDerivative",
+                            FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS_DERIVATIVE,
+                            {{"InputActivation", features.reshape({8})}, {"OutputDelta", hiddenGrad}, {"Weight", weight}},
+                            {{"WeightGrad", weightGrad}, {"BiasGrad", biasGrad}, {"InputDelta", featuresGrad}});
+
+        model->defineForwardPath({fullyConnected, dropout});
+        model->defineBackwardPath({dropoutDerivative, fullyConnectedDerivative});
+        model->defineWeightUpdatePairs({{weight, weightGrad}, {bias, biasGrad}});
+
+        FreeWill::Solver solver;
+        solver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+        solver.m_batchSize = batchSize;
+
+        if (isBroken)
+        {
+            // the replicas the other devices created are released with the model
+            QVERIFY(!solver.init(model));
+            delete model;
+            continue;
+        }
+
+        QVERIFY(solver.init(model));
+
+        float *weightData = model->beginMutateData(weight);
+        for (unsigned int i = 0; i < 6 * 8; ++i)
+        {
+            weightData[i] = (float) ((i * 7) % 9) / 90.0f;
+        }
+        model->endMutateData(weight);
+
+        float *biasData = model->beginMutateData(bias);
+        for (unsigned int i = 0; i < 6; ++i)
+        {
+            biasData[i] = 0.5f;
+        }
+        model->endMutateData(bias);
+
+        model->clearTensor(seed);
+        model->clearTensor(weightGrad);
+        model->clearTensor(biasGrad);
+
+        float *featureData = model->beginMutateData(features);
+        for (unsigned int i = 0; i < 8 * batchSize; ++i)
+        {
+            featureData[i] = (float) ((i * 3) % 11) / 11.0f;
+        }
+        model->endMutateData(features);
+
+        float *gradData = model->beginMutateData(hiddenDroppedGrad);
+        for (unsigned int i = 0; i < 6 * batchSize; ++i)
+        {
+            gradData[i] = 1.0f;
+        }
+        model->endMutateData(hiddenDroppedGrad);
+
+        solver.forward(model);
+        solver.backward(model);
+
+        // each replica works on its own device's tensors, and drops in the backward pass what
+        // it dropped in the forward pass
+        const float *reference = model->readonlyAccess(hidden);
+
+        for (unsigned int deviceId = 0; deviceId < deviceCount; ++deviceId)
+        {
+            const float *hiddenData = model->readonlyAccess(hidden, deviceId);
+            const float *droppedData = model->readonlyAccess(hiddenDropped, deviceId);
+            const float *hiddenGradData = model->readonlyAccess(hiddenGrad, deviceId);
+
+            for (unsigned int i = 0; i < 6 * batchSize; ++i)
+            {
+                QVERIFY(hiddenData[i] == reference[i]);
+                QVERIFY(hiddenData[i] > 0.0f);
+
+                if (droppedData[i] == 0.0f)
+                {
+                    QVERIFY(hiddenGradData[i] == 0.0f);
+                }
+                else
+                {
+                    QVERIFY(std::abs(droppedData[i] - hiddenData[i] * 2.0f) < 1e-5);
+                    QVERIFY(hiddenGradData[i] == 2.0f);
+                }
+            }
+        }
+
+        delete model;
+    }
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+}
+
+void FreeWillUnitTest::asyncSolverTest()
+{
+    const unsigned int deviceCount = 2;
+    const unsigned int batchSize = 4;
+    const unsigned int inputSize = 6;
+    const unsigned int outputSize = 3;
+    const unsigned int stepCount = 4;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(deviceCount);
+
+    // run 0 blocks in every call, run 1 prepares the next batch while the solver takes a step
+    std::vector<float> results[2];
+    std::vector<float> outputs[2];
+
+    for (unsigned int run = 0; run < 2; ++run)
+    {
+        FreeWill::Model *model = FreeWill::Model::create();
+
+        FreeWill::TensorDescriptorHandle input = model->addTensor("input", {inputSize}).enableBatch();
+        FreeWill::TensorDescriptorHandle output = model->addTensor("output", {outputSize}).enableBatch();
+        FreeWill::TensorDescriptorHandle outputDelta = model->addTensor("outputDelta", {outputSize}).enableBatch();
+        FreeWill::TensorDescriptorHandle inputDelta = model->addTensor("inputDelta", {inputSize}).enableBatch();
+        FreeWill::TensorDescriptorHandle weight = model->addTensor("weight", {outputSize, inputSize});
+        FreeWill::TensorDescriptorHandle bias = model->addTensor("bias", {outputSize});
+        FreeWill::TensorDescriptorHandle weightGrad = model->addTensor("weightGrad", {outputSize, inputSize});
+        FreeWill::TensorDescriptorHandle biasGrad = model->addTensor("biasGrad", {outputSize});
+
+        FreeWill::OperatorDescriptorHandle fullyConnected = model->addOperator("fullyConnected", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                            {{"Input", input}, {"Weight", weight}, {"Bias", bias}}, {{"Output", output}});
+        FreeWill::OperatorDescriptorHandle fullyConnectedDerivative = model->addOperator("fullyConnectedDerivative", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS_DERIVATIVE,
+                            {{"InputActivation", input}, {"OutputDelta", outputDelta}, {"Weight", weight}},
+                            {{"WeightGrad", weightGrad}, {"BiasGrad", biasGrad}, {"InputDelta", inputDelta}});
+
+        model->defineForwardPath({fullyConnected});
+        model->defineBackwardPath({fullyConnectedDerivative});
+        model->defineWeightUpdatePairs({{weight, weightGrad}, {bias, biasGrad}});
+
+        FreeWill::Solver solver;
+        solver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+        solver.m_batchSize = batchSize;
+        QVERIFY(solver.init(model));
+
+        float *weightData = model->beginMutateData(weight);
+        for (unsigned int i = 0; i < outputSize * inputSize; ++i)
+        {
+            weightData[i] = (float) ((i * 7) % 13) / 13.0f - 0.5f;
+        }
+        model->endMutateData(weight);
+
+        const unsigned int sampleCount = batchSize * deviceCount;
+
+        auto prepareBatch = [&](unsigned int step, std::vector<float> &inputBatch, std::vector<float> &deltaBatch)
+        {
+            inputBatch.resize(inputSize * sampleCount);
+            deltaBatch.resize(outputSize * sampleCount);
+
+            for (unsigned int i = 0; i < inputBatch.size(); ++i)
+            {
+                inputBatch[i] = (float) ((i * 3 + step) % 11) / 11.0f - 0.5f;
+            }
+
+            for (unsigned int i = 0; i < deltaBatch.size(); ++i)
+            {
+                deltaBatch[i] = (float) ((i * 5 + step) % 7) / 7.0f - 0.5f;
+            }
+        };
+
+        auto loadBatch = [&](const std::vector<float> &inputBatch, const std::vector<float> &deltaBatch)
+        {
+            std::copy(inputBatch.begin(), inputBatch.end(), model->beginScatterData(input));
+            model->endMutateData(input);
+            std::copy(deltaBatch.begin(), deltaBatch.end(), model->beginScatterData(outputDelta));
+            model->endMutateData(outputDelta);
+        };
+
+        std::vector<float> inputBatch;
+        std::vector<float> deltaBatch;
+        prepareBatch(0, inputBatch, deltaBatch);
+
+        for (unsigned int step = 0; step < stepCount; ++step)
+        {
+            loadBatch(inputBatch, deltaBatch);
+            model->clearTensor(weightGrad);
+            model->clearTensor(biasGrad);
+
+            if (run == 0)
+            {
+                solver.forward(model);
+                solver.backward(model);
+                solver.update(-0.05);
+                prepareBatch(step + 1, inputBatch, deltaBatch);
+            }
+            else
+            {
+                std::future<void> stepDone = solver.stepAsync(model, -0.05);
+                prepareBatch(step + 1, inputBatch, deltaBatch);
+                stepDone.get();
+            }
+
+            const float *outputData = model->readonlyAccess(output);
+            outputs[run].insert(outputs[run].end(), outputData, outputData + outputSize * batchSize);
+        }
+
+        // the separate calls queue up behind each other, a blocking one waits for them
+        loadBatch(inputBatch, deltaBatch);
+        model->clearTensor(weightGrad);
+        model->clearTensor(biasGrad);
+
+        if (run == 0)
+        {
+            solver.forward(model);
+            solver.backward(model);
+            solver.update(-0.05);
+            solver.update(-0.01);
+        }
+        else
+        {
+            std::future<void> forwardDone = solver.forwardAsync(model);
+            std::future<void> backwardDone = solver.backwardAsync(model);
+            solver.update(-0.05);
+            QVERIFY(forwardDone.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+            QVERIFY(backwardDone.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+
+            solver.updateAsync(-0.01);
+            solver.waitAsync();
+        }
+
+        const float *trainedWeightData = model->readonlyAccess(weight);
+        results[run].assign(trainedWeightData, trainedWeightData + outputSize * inputSize);
+
+        delete model;
+    }
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+
+    QVERIFY(outputs[0] == outputs[1]);
+    QVERIFY(results[0].size() == results[1].size());
+
+    for (unsigned int i = 0; i < results[0].size(); ++i)
+    {
+        QVERIFY(std::abs(results[0][i] - results[1][i]) < 1e-5f);
+    }
+}
+
+void FreeWillUnitTest::asyncSolverTestGPU()
+{
+    const unsigned int batchSize = 64;
+    const unsigned int inputSize = 512;
+    const unsigned int outputSize = 256;
+    const unsigned int stepCount = 4;
+
+    unsigned int deviceCount = FreeWill::Context<FreeWill::DeviceType::GPU_CUDA>::getSingleton().deviceCount();
+    const std::string initialFilename = "freewill-test-async-initial";
+    std::string filenames[2] = {"freewill-test-async-0", "freewill-test-async-1"};
+
+    // run 0 blocks in every call, run 1 reads the weights back as soon as the future is ready,
+    // so the readback races with kernels still running unless the future waits for them
+    for (unsigned int run = 0; run < 2; ++run)
+    {
+        FreeWill::Model *model = FreeWill::Model::create();
+
+        FreeWill::TensorDescriptorHandle input = model->addTensor("input", {inputSize}).enableBatch();
+        FreeWill::TensorDescriptorHandle output = model->addTensor("output", {outputSize}).enableBatch();
+        FreeWill::TensorDescriptorHandle outputDelta = model->addTensor("outputDelta", {outputSize}).enableBatch();
+        FreeWill::TensorDescriptorHandle inputDelta = model->addTensor("inputDelta", {inputSize}).enableBatch();
+        FreeWill::TensorDescriptorHandle weight = model->addTensor("weight", {outputSize, inputSize});
+        FreeWill::TensorDescriptorHandle bias = model->addTensor("bias", {outputSize});
+        FreeWill::TensorDescriptorHandle weightGrad = model->addTensor("weightGrad", {outputSize, inputSize});
+        FreeWill::TensorDescriptorHandle biasGrad = model->addTensor("biasGrad", {outputSize});
+
+        FreeWill::OperatorDescriptorHandle fullyConnected = model->addOperator("fullyConnected", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                            {{"Input", input}, {"Weight", weight}, {"Bias", bias}}, {{"Output", output}});
+        FreeWill::OperatorDescriptorHandle fullyConnectedDerivative = model->addOperator("fullyConnectedDerivative", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS_DERIVATIVE,
+                            {{"InputActivation", input}, {"OutputDelta", outputDelta}, {"Weight", weight}},
+                            {{"WeightGrad", weightGrad}, {"BiasGrad", biasGrad}, {"InputDelta", inputDelta}});
+
+        model->defineForwardPath({fullyConnected});
+        model->defineBackwardPath({fullyConnectedDerivative});
+        model->defineWeightUpdatePairs({{weight, weightGrad}, {bias, biasGrad}});
+
+        FreeWill::Solver solver;
+        solver.m_deviceUsed = FreeWill::DeviceType::GPU_CUDA;
+        solver.m_batchSize = batchSize;
+        QVERIFY(solver.init(model));
+
+        // both runs start from the weights of run 0
+        if (run == 0)
+        {
+            QVERIFY(model->saveCheckpoint(initialFilename));
+        }
+        else
+        {
+            QVERIFY(model->loadCheckpoint(initialFilename));
+        }
+
+        for (unsigned int step = 0; step < stepCount; ++step)
+        {
+            float *inputData = model->beginScatterData<FreeWill::DeviceType::GPU_CUDA>(input);
+            for (unsigned int i = 0; i < inputSize * batchSize * deviceCount; ++i)
+            {
+                inputData[i] = (float) ((i * 3 + step) % 11) / 11.0f - 0.5f;
+            }
+            model->endMutateData<FreeWill::DeviceType::GPU_CUDA>(input);
+
+            float *deltaData = model->beginScatterData<FreeWill::DeviceType::GPU_CUDA>(outputDelta);
+            for (unsigned int i = 0; i < outputSize * batchSize * deviceCount; ++i)
+            {
+                deltaData[i] = (float) ((i * 5 + step) % 7) / 7.0f - 0.5f;
+            }
+            model->endMutateData<FreeWill::DeviceType::GPU_CUDA>(outputDelta);
+
+            model->clearTensor<FreeWill::DeviceType::GPU_CUDA>(weightGrad);
+            model->clearTensor<FreeWill::DeviceType::GPU_CUDA>(biasGrad);
+
+            if (run == 0)
+            {
+                solver.forward(model);
+                solver.backward(model);
+                solver.update(-0.05);
+            }
+            else
+            {
+                solver.stepAsync(model, -0.05).get();
+            }
+        }
+
+        QVERIFY(model->saveCheckpoint(filenames[run], &solver));
+
+        delete model;
+    }
+
+    FreeWill::CheckpointReader readers[2];
+    QVERIFY(readers[0].open(filenames[0]) && readers[1].open(filenames[1]));
+    QVERIFY(readers[0].header().m_tensorCount == readers[1].header().m_tensorCount);
+
+    for (unsigned int i = 0; i < readers[0].header().m_tensorCount; ++i)
+    {
+        const FreeWill::CheckpointEntry &entry = readers[0].entry(i);
+        const FreeWill::CheckpointEntry &otherEntry = readers[1].entry(i);
+        QVERIFY(std::string(entry.m_name) == otherEntry.m_name && entry.m_sizeInByte == otherEntry.m_sizeInByte);
+
+        const float *data = static_cast<const float*>(readers[0].data(entry));
+        const float *otherData = static_cast<const float*>(readers[1].data(otherEntry));
+
+        for (unsigned int j = 0; j < entry.m_sizeInByte / sizeof(float); ++j)
+        {
+            QVERIFY(std::abs(data[j] - otherData[j]) < 1e-5f);
+        }
+    }
+
+    readers[0].close();
+    readers[1].close();
+
+    std::remove(initialFilename.c_str());
+    std::remove(filenames[0].c_str());
+    std::remove(filenames[1].c_str());
+}
+
+void FreeWillUnitTest::sparseInputModelTest()
+{
+    const unsigned int batchSize = 3;
+    const unsigned int inputSize = 1000;
+    const unsigned int outputSize = 4;
+    const unsigned int hotIndices[batchSize] = {7, 512, 7};
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(1);
+
+    FreeWill::Model *model = FreeWill::Model::create();
+
+    // a one-hot batch in CSR, one non-zero per sample
+    FreeWill::TensorDescriptorHandle rowOffsets = model->addTensor("rowOffsets", {batchSize + 1}, FreeWill::DataType::UNSIGNED_INT);
+    FreeWill::TensorDescriptorHandle columns = model->addTensor("columns", {batchSize}, FreeWill::DataType::UNSIGNED_INT);
+    FreeWill::TensorDescriptorHandle values = model->addTensor("values", {batchSize});
+    FreeWill::TensorDescriptorHandle output = model->addTensor("output", {outputSize}).enableBatch();
+    FreeWill::TensorDescriptorHandle outputDelta = model->addTensor("outputDelta", {outputSize}).enableBatch();
+    FreeWill::TensorDescriptorHandle weight = model->addTensor("weight", {outputSize, inputSize});
+    FreeWill::TensorDescriptorHandle bias = model->addTensor("bias", {outputSize});
+    FreeWill::TensorDescriptorHandle weightGrad = model->addTensor("weightGrad", {outputSize, inputSize});
+    FreeWill::TensorDescriptorHandle biasGrad = model->addTensor("biasGrad", {outputSize});
+
+    FreeWill::OperatorDescriptorHandle embedding = model->addOperator("embedding", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                        {{"Input", values}, {"SparseRowOffsets", rowOffsets}, {"SparseColumns", columns}, {"Weight", weight}, {"Bias", bias}},
+                        {{"Output", output}});
+    FreeWill::OperatorDescriptorHandle embeddingDerivative = model->addOperator("embeddingDerivative", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS_DERIVATIVE,
+                        {{"InputActivation", values}, {"SparseRowOffsets", rowOffsets}, {"SparseColumns", columns}, {"OutputDelta", outputDelta}, {"Weight", weight}},
+                        {{"WeightGrad", weightGrad}, {"BiasGrad", biasGrad}});
+
+    model->defineForwardPath({embedding});
+    model->defineBackwardPath({embeddingDerivative});
+    model->defineWeightUpdatePairs({{weight, weightGrad}, {bias, biasGrad}});
+
+    FreeWill::Solver solver;
+    solver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+    solver.m_batchSize = batchSize;
+    QVERIFY(solver.init(model));
+
+    float *weightData = model->beginMutateData(weight);
+    for (unsigned int i = 0; i < outputSize * inputSize; ++i)
+    {
+        weightData[i] = (float) (i % 17) / 17.0f;
+    }
+    model->endMutateData(weight);
+
+    unsigned int *rowOffsetData = model->beginMutateData<FreeWill::DeviceType::CPU_NAIVE, unsigned int>(rowOffsets);
+    unsigned int *columnData = model->beginMutateData<FreeWill::DeviceType::CPU_NAIVE, unsigned int>(columns);
+    float *valueData = model->beginMutateData(values);
+    for (unsigned int b = 0; b < batchSize; ++b)
+    {
+        rowOffsetData[b] = b;
+        columnData[b] = hotIndices[b];
+        valueData[b] = 1.0f;
+    }
+    rowOffsetData[batchSize] = batchSize;
+    model->endMutateData<FreeWill::DeviceType::CPU_NAIVE>(rowOffsets);
+    model->endMutateData<FreeWill::DeviceType::CPU_NAIVE>(columns);
+    model->endMutateData(values);
+
+    float *outputDeltaData = model->beginMutateData(outputDelta);
+    for (unsigned int i = 0; i < outputSize * batchSize; ++i)
+    {
+        outputDeltaData[i] = 1.0f;
+    }
+    model->endMutateData(outputDelta);
+
+    solver.forward(model);
+
+    // the output of a one-hot sample is the weight column of its index
+    const float *outputData = model->readonlyAccess(output);
+    for (unsigned int b = 0; b < batchSize; ++b)
+    {
+        for (unsigned int i = 0; i < outputSize; ++i)
+        {
+            QVERIFY(std::abs(outputData[b * outputSize + i] - (float) ((hotIndices[b] * outputSize + i) % 17) / 17.0f) < 1e-6f);
+        }
+    }
+
+    model->clearTensor(weightGrad);
+    model->clearTensor(biasGrad);
+    solver.backward(model);
+    solver.update(-0.1);
+
+    // only the columns of the hot indices were trained, index 7 by two samples
+    const float *trainedWeightData = model->readonlyAccess(weight);
+    for (unsigned int e = 0; e < inputSize; ++e)
+    {
+        float step = e == 7 ? 0.2f : (e == 512 ? 0.1f : 0.0f);
+
+        for (unsigned int i = 0; i < outputSize; ++i)
+        {
+            QVERIFY(std::abs(trainedWeightData[e * outputSize + i] - ((float) ((e * outputSize + i) % 17) / 17.0f - step)) < 1e-5f);
+        }
+    }
+
+    delete model;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+}
+
+void FreeWillUnitTest::memoryAccountingTest()
+{
+    FreeWill::BlobAllocator &allocator = FreeWill::BlobAllocator::getSingleton();
+    const size_t blockSize = 1 << 20;
+
+    auto liveSizeInByte = [&allocator](FreeWill::MemoryCategory category, size_t &peakSizeInByte)
+    {
+        size_t sizeInByte = 0;
+        peakSizeInByte = 0;
+
+        for (const FreeWill::MemoryUsage &usage : allocator.memoryUsage())
+        {
+            if (usage.m_category == category && usage.m_isHost)
+            {
+                sizeInByte += usage.m_sizeInByte;
+                peakSizeInByte += usage.m_peakSizeInByte;
+            }
+        }
+
+        return sizeInByte;
+    };
+
+    size_t peakSizeInByte = 0;
+    size_t workspaceSizeInByte = liveSizeInByte(FreeWill::MemoryCategory::WORKSPACE, peakSizeInByte);
+    void *block = nullptr;
+    void *innerBlock = nullptr;
+
+    {
+        FreeWill::BlobAllocator::Tag tag(FreeWill::MemoryCategory::WORKSPACE, "accountingWorkspace");
+        block = allocator.allocateHost(blockSize);
+
+        {
+            FreeWill::BlobAllocator::Tag innerTag(FreeWill::MemoryCategory::ACTIVATION, "accountingActivation");
+            innerBlock = allocator.allocateHost(100);
+        }
+    }
+
+    void *untaggedBlock = allocator.allocateHost(100);
+
+    QVERIFY(allocator.owner(block) == "accountingWorkspace");
+    QVERIFY(allocator.owner(innerBlock) == "accountingActivation");
+    QVERIFY(allocator.owner(untaggedBlock).empty());
+    QVERIFY(allocator.blockSizeInByte(block) == FreeWill::BlobAllocator::sizeClass(blockSize));
+    QVERIFY(allocator.ownerSizesInByte()["accountingWorkspace"] == FreeWill::BlobAllocator::sizeClass(blockSize));
+    QVERIFY(liveSizeInByte(FreeWill::MemoryCategory::WORKSPACE, peakSizeInByte) == workspaceSizeInByte + FreeWill::BlobAllocator::sizeClass(blockSize));
+
+    // the peak stays until it is reset
+    allocator.freeHost(block);
+    QVERIFY(liveSizeInByte(FreeWill::MemoryCategory::WORKSPACE, peakSizeInByte) == workspaceSizeInByte);
+    QVERIFY(peakSizeInByte >= workspaceSizeInByte + FreeWill::BlobAllocator::sizeClass(blockSize));
+    QVERIFY(allocator.ownerSizesInByte().count("accountingWorkspace") == 0);
+    QVERIFY(allocator.blockSizeInByte(block) == 0);
+
+    allocator.resetPeakSizes();
+    QVERIFY(liveSizeInByte(FreeWill::MemoryCategory::WORKSPACE, peakSizeInByte) == workspaceSizeInByte);
+    QVERIFY(peakSizeInByte == workspaceSizeInByte);
+
+    allocator.freeHost(innerBlock);
+    allocator.freeHost(untaggedBlock);
+
+    // the tensors of a model are filed under their names and what they are for
+    const unsigned int batchSize = 2;
+    const unsigned int inputSize = 5;
+    const unsigned int outputSize = 3;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().open(2);
+
+    FreeWill::Model *model = FreeWill::Model::create();
+
+    FreeWill::TensorDescriptorHandle input = model->addTensor("accountedInput", {inputSize}).enableBatch();
+    FreeWill::TensorDescriptorHandle inputDelta = model->addTensor("accountedInputDelta", {inputSize}).enableBatch();
+    FreeWill::TensorDescriptorHandle output = model->addTensor("accountedOutput", {outputSize}).enableBatch();
+    FreeWill::TensorDescriptorHandle outputDelta = model->addTensor("accountedOutputDelta", {outputSize}).enableBatch();
+    FreeWill::TensorDescriptorHandle weight = model->addTensor("accountedWeight", {outputSize, inputSize});
+    FreeWill::TensorDescriptorHandle bias = model->addTensor("accountedBias", {outputSize});
+    FreeWill::TensorDescriptorHandle weightGrad = model->addTensor("accountedWeightGrad", {outputSize, inputSize});
+    FreeWill::TensorDescriptorHandle biasGrad = model->addTensor("accountedBiasGrad", {outputSize});
+
+    FreeWill::OperatorDescriptorHandle dotProduct = model->addOperator("dotProduct", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                        {{"Input", input}, {"Weight", weight}, {"Bias", bias}}, {{"Output", output}});
+    FreeWill::OperatorDescriptorHandle dotProductDerivative = model->addOperator("dotProductDerivative", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS_DERIVATIVE,
+                        {{"InputActivation", input}, {"OutputDelta", outputDelta}, {"Weight", weight}},
+                        {{"InputDelta", inputDelta}, {"WeightGrad", weightGrad}, {"BiasGrad", biasGrad}});
+
+    model->defineForwardPath({dotProduct});
+    model->defineBackwardPath({dotProductDerivative});
+    model->defineWeightUpdatePairs({{weight, weightGrad}, {bias, biasGrad}});
+
+    size_t weightSizeInByte = liveSizeInByte(FreeWill::MemoryCategory::WEIGHT, peakSizeInByte);
+    size_t gradientSizeInByte = liveSizeInByte(FreeWill::MemoryCategory::GRADIENT, peakSizeInByte);
+    size_t activationSizeInByte = liveSizeInByte(FreeWill::MemoryCategory::ACTIVATION, peakSizeInByte);
+
+    FreeWill::Solver solver;
+    solver.m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+    solver.m_batchSize = batchSize;
+    QVERIFY(solver.init(model));
+
+    unsigned int deviceCount = FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().deviceCount();
+    size_t replicaWeightSizeInByte = FreeWill::BlobAllocator::sizeClass(outputSize * inputSize * sizeof(float)) +
+                                     FreeWill::BlobAllocator::sizeClass(outputSize * sizeof(float));
+    std::map<std::string, size_t> usage = model->memoryUsage();
+
+    QVERIFY(usage["accountedWeight"] == FreeWill::BlobAllocator::sizeClass(outputSize * inputSize * sizeof(float)) * deviceCount);
+    QVERIFY(usage["accountedInput"] == FreeWill::BlobAllocator::sizeClass(inputSize * batchSize * sizeof(float)) * deviceCount);
+    QVERIFY(allocator.ownerSizesInByte()["accountedWeight"] >= usage["accountedWeight"]);
+
+    QVERIFY(liveSizeInByte(FreeWill::MemoryCategory::WEIGHT, peakSizeInByte) >= weightSizeInByte + replicaWeightSizeInByte * deviceCount);
+    QVERIFY(liveSizeInByte(FreeWill::MemoryCategory::GRADIENT, peakSizeInByte) >= gradientSizeInByte + replicaWeightSizeInByte * deviceCount);
+    QVERIFY(liveSizeInByte(FreeWill::MemoryCategory::ACTIVATION, peakSizeInByte) > activationSizeInByte);
+
+    delete model;
+
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().close();
+}
+
+void FreeWillUnitTest::topologyTunerTest()
+{
+    const FreeWill::CPUTopology &topology = FreeWill::CPUTopology::getSingleton();
+    FreeWill::CPUTopologyTuner &tuner = FreeWill::CPUTopologyTuner::getSingleton();
+
+    QVERIFY(topology.coreCount() >= 1);
+    QVERIFY(topology.coreCount() <= topology.cpuCount());
+
+    // every core is pinned to before any of them twice
+    for (unsigned int node = 0; node < topology.nodeCount(); ++node)
+    {
+        std::vector<unsigned int> cpus = topology.cpus(node);
+        std::vector<unsigned int> pinningOrder = topology.pinningOrder(node);
+
+        QVERIFY(topology.coreCount(node) >= 1);
+        QVERIFY(pinningOrder.size() == cpus.size());
+        std::sort(pinningOrder.begin(), pinningOrder.end());
+        QVERIFY(pinningOrder == cpus);
+    }
+
+    // two nodes of two cpus whatever the machine has, unpinned as the cpus may not exist
+    FreeWill::CPUTopology::getSingleton().setNodes({{0, 1}, {2, 3}});
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().setPinning(false);
+
+    std::vector<FreeWill::CPUSplit> splits = tuner.splits();
+    QVERIFY(!splits.empty());
+    QVERIFY(splits.front().m_replicaCount == std::min(2u, topology.coreCount()));
+
+    for (const FreeWill::CPUSplit &split : splits)
+    {
+        QVERIFY(split.m_replicaCount >= 1 && split.m_threadCount >= 1);
+        QVERIFY(split.m_replicaCount * split.m_threadCount <= topology.cpuCount());
+    }
+
+    // the replicas share a global batch of 8
+    const unsigned int globalBatchSize = 8;
+    const unsigned int inputSize = 64;
+    const unsigned int outputSize = 32;
+    std::vector<FreeWill::CPUSplit> builtSplits;
+
+    FreeWill::CPUTopologyTuner::BuildFunction build = [&](const FreeWill::CPUSplit &split) -> std::function<void()>
+    {
+        builtSplits.push_back(split);
+
+        std::shared_ptr<FreeWill::Model> model(FreeWill::Model::create());
+
+        FreeWill::TensorDescriptorHandle input = model->addTensor("input", {inputSize}).enableBatch();
+        FreeWill::TensorDescriptorHandle inputDelta = model->addTensor("inputDelta", {inputSize}).enableBatch();
+        FreeWill::TensorDescriptorHandle output = model->addTensor("output", {outputSize}).enableBatch();
+        FreeWill::TensorDescriptorHandle outputDelta = model->addTensor("outputDelta", {outputSize}).enableBatch();
+        FreeWill::TensorDescriptorHandle weight = model->addTensor("weight", {outputSize, inputSize});
+        FreeWill::TensorDescriptorHandle bias = model->addTensor("bias", {outputSize});
+        FreeWill::TensorDescriptorHandle weightGrad = model->addTensor("weightGrad", {outputSize, inputSize});
+        FreeWill::TensorDescriptorHandle biasGrad = model->addTensor("biasGrad", {outputSize});
+
+        FreeWill::OperatorDescriptorHandle dotProduct = model->addOperator("dotProduct", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS,
+                            {{"Input", input}, {"Weight", weight}, {"Bias", bias}}, {{"Output", output}});
+        FreeWill::OperatorDescriptorHandle dotProductDerivative = model->addOperator("dotProductDerivative", FreeWill::OperatorName::DOT_PRODUCT_WITH_BIAS_DERIVATIVE,
+                            {{"InputActivation", input}, {"OutputDelta", outputDelta}, {"Weight", weight}},
+                            {{"InputDelta", inputDelta}, {"WeightGrad", weightGrad}, {"BiasGrad", biasGrad}});
+
+        model->defineForwardPath({dotProduct});
+        model->defineBackwardPath({dotProductDerivative});
+        model->defineWeightUpdatePairs({{weight, weightGrad}, {bias, biasGrad}});
+
+        std::shared_ptr<FreeWill::Solver> solver(new FreeWill::Solver());
+        solver->m_deviceUsed = FreeWill::DeviceType::CPU_NAIVE;
+        solver->m_batchSize = std::max(1u, globalBatchSize / split.m_replicaCount);
+
+        if (!solver->init(model.get()))
+        {
+            return std::function<void()>();
+        }
+
+        return [model, solver]
+        {
+            solver->forward(model.get());
+            solver->backward(model.get());
+            solver->update(-0.01);
+        };
+    };
+
+    tuner.setStepCount(2);
+    FreeWill::CPUSplit split = tuner.open(build);
+
+    QVERIFY(builtSplits.size() == splits.size());
+    QVERIFY(tuner.timings().size() == splits.size());
+
+    bool isCandidate = false;
+    for (const std::pair<FreeWill::CPUSplit, double> &timing : tuner.timings())
+    {
+        isCandidate = isCandidate || (timing.first.m_replicaCount == split.m_replicaCount && timing.first.m_threadCount == split.m_threadCount);
+        QVERIFY(timing.second >= 0.0);
+    }
+    QVERIFY(isCandidate);
+
+    // the fastest split is left open
+    QVERIFY((unsigned int) FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().deviceCount() == split.m_replicaCount);
+    QVERIFY(FreeWill::ThreadPool::getSingleton().threadCount() == split.m_replicaCount * (split.m_threadCount - 1));
+
+    // with a key the choice is timed once and then taken from the cache
+    FreeWill::CPUAutotuner::getSingleton().clear();
+    builtSplits.clear();
+
+    FreeWill::CPUSplit cachedSplit = tuner.open(build, "topologyTunerTest");
+    QVERIFY(builtSplits.size() == splits.size());
+
+    builtSplits.clear();
+    QVERIFY(tuner.open(build, "topologyTunerTest").m_replicaCount == cachedSplit.m_replicaCount);
+    QVERIFY(builtSplits.empty());
+
+    FreeWill::CPUAutotuner::getSingleton().clear();
+    FreeWill::CPUTopologyTuner::close();
+    FreeWill::Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().setPinning(true);
+    FreeWill::CPUTopology::getSingleton().setNodes({});
+
+    QVERIFY(FreeWill::ThreadPool::getSingleton().threadCount() == 0);
+}
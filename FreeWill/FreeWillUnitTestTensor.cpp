@@ -1,11 +1,18 @@
 #include "FreeWillUnitTest.h"
 #include "Tensor/Tensor.h"
 #include "Tensor/ReferenceCountedBlob.h"
+#include "Tensor/BlobAllocator.h"
 #include "Operator/Operator.h"
 #include "Operator/ElementwiseAdd.h"
+#include "Operator/Duplicate.h"
+#include "Model/Model.h"
 #include <time.h>
+#include <type_traits>
 #include <cuda_runtime.h>
 #include "Context/Context.h"
+#include "Context/CUDAGraph.h"
+#include "Context/ThreadPool.h"
+#include "Tensor/Philox.h"
 
 void FreeWillUnitTest::initTestCase()
 {
@@ -55,12 +62,88 @@ void FreeWillUnitTest::blobTest()
     //QVERIFY(str.toUpper() == "HELLO");
 }
 
+void FreeWillUnitTest::blobAllocatorTest()
+{
+    FreeWill::BlobAllocator &allocator = FreeWill::BlobAllocator::getSingleton();
+
+    QVERIFY(FreeWill::BlobAllocator::sizeClass(1) == 64);
+    QVERIFY(FreeWill::BlobAllocator::sizeClass(100) == 128);
+    QVERIFY(FreeWill::BlobAllocator::sizeClass(1000) == 1024);
+    QVERIFY(FreeWill::BlobAllocator::sizeClass(1025) == 1536);
+
+    allocator.releaseCache();
+
+    unsigned char *firstHandle = nullptr;
+
+    {
+        FreeWill::ReferenceCountedBlob<FreeWill::DeviceType::CPU_NAIVE> blob;
+        QVERIFY(blob.alloc(1000));
+        QVERIFY(((uintptr_t) blob.dataHandle()) % FreeWill::BlobAllocator::ALIGNMENT == 0);
+
+        std::memset(blob.dataHandle(), 0xff, blob.sizeInByte());
+        firstHandle = blob.dataHandle();
+    }
+
+    QVERIFY(allocator.cachedSizeInByte() == 1024);
+
+    {
+        // same size class, so the cached block comes back, cleared
+        FreeWill::ReferenceCountedBlob<FreeWill::DeviceType::CPU_NAIVE> blob;
+        QVERIFY(blob.alloc(1010));
+        QVERIFY(blob.dataHandle() == firstHandle);
+        QVERIFY(allocator.cachedSizeInByte() == 0);
+
+        for (unsigned int i = 0; i < blob.sizeInByte(); ++i)
+        {
+            QVERIFY(blob[i] == 0);
+        }
+    }
+
+    allocator.releaseCache();
+    QVERIFY(allocator.cachedSizeInByte() == 0);
+
+    allocator.setCaching(false);
+    {
+        FreeWill::ReferenceCountedBlob<FreeWill::DeviceType::CPU_NAIVE> blob;
+        QVERIFY(blob.alloc(1000));
+    }
+    QVERIFY(allocator.cachedSizeInByte() == 0);
+    allocator.setCaching(true);
+
+    allocator.setHugePages(true);
+    {
+        FreeWill::ReferenceCountedBlob<FreeWill::DeviceType::CPU_NAIVE> blob;
+        QVERIFY(blob.alloc(FreeWill::BlobAllocator::HUGE_PAGE_SIZE + 1));
+        QVERIFY(((uintptr_t) blob.dataHandle()) % FreeWill::BlobAllocator::HUGE_PAGE_SIZE == 0);
+    }
+    QVERIFY(allocator.cachedSizeInByte() == 2 * FreeWill::BlobAllocator::HUGE_PAGE_SIZE);
+    allocator.setHugePages(false);
+    allocator.releaseCache();
+
+    // the peak is of the live blocks, from what was live at the reset on
+    allocator.resetPeakSizes();
+    size_t liveSizeInByte = allocator.hostSizeInByte();
+    QVERIFY(allocator.peakHostSizeInByte() == liveSizeInByte);
+    {
+        FreeWill::ReferenceCountedBlob<FreeWill::DeviceType::CPU_NAIVE> first;
+        FreeWill::ReferenceCountedBlob<FreeWill::DeviceType::CPU_NAIVE> second;
+        QVERIFY(first.alloc(1000));
+        QVERIFY(second.alloc(1000));
+    }
+    QVERIFY(allocator.hostSizeInByte() == liveSizeInByte);
+    QVERIFY(allocator.peakHostSizeInByte() == liveSizeInByte + 2048);
+    allocator.resetPeakSizes();
+    QVERIFY(allocator.peakHostSizeInByte() == liveSizeInByte);
+    allocator.releaseCache();
+}
+
 void FreeWillUnitTest::blobTestGPU()
 {
     FreeWill::ReferenceCountedBlob<FreeWill::DeviceType::GPU_CUDA> blob1;
     blob1.alloc(10);
 
     QVERIFY(blob1.sizeInByte() == 10);
+    QVERIFY(!blob1.hasHostMirror());
 
     FreeWill::ReferenceCountedBlob<FreeWill::DeviceType::GPU_CUDA> blob2;
 
@@ -93,6 +176,103 @@ void FreeWillUnitTest::blobTestGPU()
         QVERIFY(blob1[i] == blob2[i]);
     }
 
+    QVERIFY(blob1.isHostPinned());
+
+    // the blobs sharing an allocation share its host mirror, the one of an alias included
+    FreeWill::ReferenceCountedBlob<FreeWill::DeviceType::GPU_CUDA> window;
+    QVERIFY(window.alias(blob1, 4, 4));
+    QVERIFY(window.hasHostMirror());
+    QVERIFY(window.dataHandle() == blob2.dataHandle() + 4);
+
+    blob2.freeHostMirror();
+    QVERIFY(!blob1.hasHostMirror() && !window.hasHostMirror());
+    QVERIFY(!blob1.isHostPinned());
+    blob1.copyFromHostToDevice();
+    blob1.copyFromDeviceToHost();
+    QVERIFY(blob1.hasHostMirror());
+    for (unsigned int i = 0; i < blob1.sizeInByte(); ++i)
+    {
+        QVERIFY(blob1[i] == blob3[i]);
+    }
+
+    FreeWill::Context<FreeWill::DeviceType::GPU_CUDA> &context = FreeWill::Context<FreeWill::DeviceType::GPU_CUDA>::getSingleton();
+
+    for (unsigned int i = 0; i < blob3.sizeInByte(); ++i)
+    {
+        blob3.dataHandle()[i] = i + 1;
+    }
+    blob3.copyFromHostToDeviceAsync(context.copyStream(0));
+    RUN_CUDA(cudaEventSynchronize(context.recordCopies(0)));
+
+    std::memset(blob3.dataHandle(), 0, blob3.sizeInByte());
+    blob3.copyFromDeviceToHostAsync(context.copyStream(0));
+    RUN_CUDA(cudaEventSynchronize(context.recordCopies(0)));
+
+    for (unsigned int i = 0; i < blob3.sizeInByte(); ++i)
+    {
+        QVERIFY(blob3[i] == i + 1);
+    }
+}
+
+void FreeWillUnitTest::managedMemoryTestGPU()
+{
+    FreeWill::BlobAllocator &allocator = FreeWill::BlobAllocator::getSingleton();
+    const unsigned int sizeInByte = 1 << 16;
+
+    QVERIFY(!allocator.isManagedMemory());
+
+    FreeWill::ReferenceCountedBlob<FreeWill::DeviceType::GPU_CUDA> managedBlob;
+
+    {
+        FreeWill::BlobAllocator::ManagedMemoryScope managedMemoryScope(true);
+        QVERIFY(allocator.isManagedMemory());
+        QVERIFY(managedBlob.alloc(sizeInByte));
+    }
+
+    QVERIFY(!allocator.isManagedMemory());
+    QVERIFY(allocator.isManaged(managedBlob.allocationHandle()));
+
+    cudaPointerAttributes attributes;
+    QVERIFY(cudaPointerGetAttributes(&attributes, managedBlob.allocationHandle()) == cudaSuccess);
+    QVERIFY(attributes.type == cudaMemoryTypeManaged);
+
+    for (unsigned int i = 0; i < sizeInByte; ++i)
+    {
+        managedBlob.dataHandle()[i] = i % 251;
+    }
+    managedBlob.copyFromHostToDevice();
+
+    // moved out to the host and back, the host reads the pages in between
+    FreeWill::Context<FreeWill::DeviceType::GPU_CUDA> &context = FreeWill::Context<FreeWill::DeviceType::GPU_CUDA>::getSingleton();
+    unsigned char *managedData = (unsigned char *) managedBlob.allocationHandle();
+
+    RUN_CUDA(cudaMemAdvise(managedData, sizeInByte, cudaMemAdviseSetPreferredLocation, cudaCpuDeviceId));
+    RUN_CUDA(cudaMemPrefetchAsync(managedData, sizeInByte, cudaCpuDeviceId, context.copyStream(0)));
+    RUN_CUDA(cudaEventSynchronize(context.recordCopies(0)));
+
+    for (unsigned int i = 0; i < sizeInByte; ++i)
+    {
+        QVERIFY(managedData[i] == i % 251);
+    }
+
+    RUN_CUDA(cudaMemAdvise(managedData, sizeInByte, cudaMemAdviseSetPreferredLocation, 0));
+    RUN_CUDA(cudaMemPrefetchAsync(managedData, sizeInByte, 0, context.copyStream(0)));
+    RUN_CUDA(cudaEventSynchronize(context.recordCopies(0)));
+
+    std::memset(managedBlob.dataHandle(), 0, sizeInByte);
+    managedBlob.copyFromDeviceToHost();
+
+    for (unsigned int i = 0; i < sizeInByte; ++i)
+    {
+        QVERIFY(managedBlob[i] == i % 251);
+    }
+
+    // outside the scope the blocks are plain device memory again, a cached managed block of
+    // the same size isn't handed out for them
+    FreeWill::ReferenceCountedBlob<FreeWill::DeviceType::GPU_CUDA> deviceBlob;
+    managedBlob.release();
+    QVERIFY(deviceBlob.alloc(sizeInByte));
+    QVERIFY(!allocator.isManaged(deviceBlob.allocationHandle()));
 }
 
 void FreeWillUnitTest::tensorTest()
@@ -123,6 +303,128 @@ void FreeWillUnitTest::tensorTest()
     //QVERIFY(1 == 1);
 }
 
+void FreeWillUnitTest::shapeTest()
+{
+    constexpr FreeWill::Shape shape = {3, 4, 5};
+    static_assert(shape.size() == 60, "constexpr shape size");
+    static_assert(shape.stride(2) == 12, "constexpr shape stride");
+    static_assert((shape + 2).size() == 120, "constexpr batched shape");
+    static_assert(std::is_trivially_copyable<FreeWill::Shape>::value, "shape copies without allocating");
+
+    FreeWill::Shape batched = shape + 8;
+    QVERIFY(batched.dimension() == 4);
+    QVERIFY(batched[3] == 8);
+    QVERIFY(batched.stride(3) == 60);
+    QVERIFY(shape + 0 == shape);
+
+    batched.set(3, 2);
+    QVERIFY(batched.size() == 120);
+    batched.swap(0, 2);
+    QVERIFY(batched[0] == 5 && batched[2] == 3);
+    QVERIFY(batched.stride(1) == 5 && batched.stride(2) == 20);
+    QVERIFY(batched != (shape + 2));
+
+    QVERIFY(FreeWill::Shape(2).size() == 0);
+    QVERIFY(FreeWill::Shape().size() == 1);
+
+    // past MAX_DIMENSION a shape is invalid, no dimension is dropped
+    const unsigned int extents[10] = {1, 2, 1, 2, 1, 2, 1, 2, 1, 2};
+    FreeWill::Shape full(extents, FreeWill::Shape::MAX_DIMENSION);
+    QVERIFY(full.isValid() && full.size() == 16);
+
+    FreeWill::Shape tooLong(extents, 10);
+    QVERIFY(!tooLong.isValid());
+    QVERIFY(tooLong.dimension() == 0 && tooLong.size() == 0);
+    QVERIFY(!FreeWill::Shape(FreeWill::Shape::MAX_DIMENSION + 1).isValid());
+
+    FreeWill::Shape fullBatched = full + 3;
+    QVERIFY(!fullBatched.isValid());
+    QVERIFY(fullBatched != full);
+    QVERIFY(!(fullBatched + 2).isValid());
+
+    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> tensor(fullBatched);
+    QVERIFY(!tensor.init());
+
+    FreeWill::Model *model = FreeWill::Model::create();
+    QVERIFY(model->addTensor("tooLong", tooLong).name().empty());
+    QVERIFY(model->addTensor("fullBatched", full, FreeWill::DataType::FLOAT, true).name().empty());
+    QVERIFY(!model->addTensor("full", full).name().empty());
+    delete model;
+}
+
+void FreeWillUnitTest::tensorViewTest()
+{
+    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> tensor({4, 3, 5});
+    QVERIFY(tensor.init());
+
+    for (unsigned int i = 0; i < tensor.shape().size(); ++i)
+    {
+        tensor[i] = i;
+    }
+
+    // a flattening batch view shares the memory and follows the batch of the tensor
+    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> *flat = tensor.batchView({12});
+    QVERIFY(flat);
+    QVERIFY(flat->shape() == FreeWill::Shape({12, 5}));
+    QVERIFY(flat->cpuDataHandle() == tensor.cpuDataHandle());
+    QVERIFY(tensor.shape() == FreeWill::Shape({4, 3, 5}));
+    QVERIFY(!tensor.batchView({11}));
+
+    QVERIFY(tensor.setBatchWindow(2, 2));
+    QVERIFY(flat->shape() == FreeWill::Shape({12, 2}));
+    QVERIFY((*flat)[0] == 24.0f);
+
+    QVERIFY(tensor.setBatchSize(5));
+    QVERIFY(flat->shape() == FreeWill::Shape({12, 5}));
+    QVERIFY((*flat)[0] == 0.0f);
+
+    // a plain view of the second item
+    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> *item = tensor.view({3, 4}, 12);
+    QVERIFY(item);
+    QVERIFY((*item)[0] == 12.0f);
+    QVERIFY(!item->init());
+    QVERIFY(!tensor.view({3, 4}, 50));
+
+    // strided views: one column of every item, and the first two dimensions swapped
+    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> *column = tensor.slice(1, 2, 1);
+    QVERIFY(column);
+    QVERIFY(!column->isContiguous());
+    QVERIFY(column->shape() == FreeWill::Shape({4, 1, 5}));
+    QVERIFY((*column)[0] == 8.0f);
+    QVERIFY((*column)[5] == 21.0f);
+    QVERIFY(!column->view({20}));
+
+    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> *transposed = tensor.transpose(0, 1);
+    QVERIFY(transposed);
+    QVERIFY(transposed->shape() == FreeWill::Shape({3, 4, 5}));
+    QVERIFY(transposed->strides() == FreeWill::Shape({4, 1, 12}));
+    QVERIFY((*transposed)[1] == 4.0f);
+    QVERIFY((*transposed)[3] == 1.0f);
+
+    // clearing a view leaves the rest of the tensor alone
+    item->clear();
+    QVERIFY(tensor[11] == 11.0f);
+    QVERIFY(tensor[12] == 0.0f);
+    QVERIFY(tensor[23] == 0.0f);
+    QVERIFY(tensor[24] == 24.0f);
+
+    delete column;
+    delete transposed;
+    delete item;
+    delete flat;
+
+    {
+        FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> scratch({2, 2});
+        scratch.init();
+        flat = scratch.batchView({2});
+        QVERIFY(flat->isView());
+    }
+
+    // the tensor went first, the view no longer points into it
+    QVERIFY(!flat->isView());
+    delete flat;
+}
+
 void FreeWillUnitTest::tensorTestGPU()
 {
     FreeWill::Tensor<FreeWill::DeviceType::GPU_CUDA, float> tensor({64,32,32});
@@ -153,6 +455,111 @@ void FreeWillUnitTest::tensorTestGPU()
 
 }
 
+void FreeWillUnitTest::randomNumberGeneratorTest()
+{
+    // the known answers of Random123's philox4x32-10
+    FreeWill::PhiloxBlock zero = FreeWill::philox4x32(0, 0, 0);
+    QVERIFY(zero.m_words[0] == 0x6627e8d5 && zero.m_words[1] == 0xe169c58d && zero.m_words[2] == 0xbc57ac4c && zero.m_words[3] == 0x9b00dbd8);
+    FreeWill::PhiloxBlock ones = FreeWill::philox4x32(~0ull, ~0ull, ~0ull);
+    QVERIFY(ones.m_words[0] == 0x408f276d && ones.m_words[1] == 0x41c83b0e && ones.m_words[2] == 0xa20bc7c6 && ones.m_words[3] == 0x6d5451fd);
+
+    FreeWill::RandomNumberGenerator &generator = FreeWill::RandomNumberGenerator::getSingleton();
+    uint64_t seed = generator.seed();
+    generator.setSeed(42);
+
+    uint64_t stream = generator.newStream();
+    QVERIFY(stream != generator.newStream());
+    QVERIFY(FreeWill::RandomNumberGenerator::deviceStream(stream, 1) != stream);
+
+    // large enough to be split on the thread pool, the numbers don't depend on the split
+    const unsigned int size = 300001;
+    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> serial({size});
+    serial.init();
+    serial.randomize(stream);
+
+    FreeWill::ThreadPool &threadPool = FreeWill::ThreadPool::getSingleton();
+    threadPool.open(4);
+
+    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> parallel({size});
+    parallel.init();
+    parallel.randomize(stream);
+
+    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> other({size});
+    other.init();
+    other.randomize(FreeWill::RandomNumberGenerator::deviceStream(stream, 1));
+
+    threadPool.close();
+
+    double sum = 0;
+    double squareSum = 0;
+    unsigned int equalCount = 0;
+    for (unsigned int i = 0; i < size; ++i)
+    {
+        QVERIFY(serial[i] == parallel[i]);
+        equalCount += serial[i] == other[i];
+        sum += serial[i];
+        squareSum += serial[i] * serial[i];
+    }
+
+    QVERIFY(equalCount < 10);
+    QVERIFY(std::abs(sum / size) < 0.01);
+    QVERIFY(std::abs(squareSum / size - 1.0) < 0.01);
+
+    // a strided view draws the same numbers as a contiguous tensor of its shape
+    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> matrix({3, 4});
+    matrix.init();
+    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> *transposed = matrix.transpose(0, 1);
+    transposed->randomize(stream);
+
+    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> reference({4, 3});
+    reference.init();
+    reference.randomize(stream);
+
+    for (unsigned int i = 0; i < 12; ++i)
+    {
+        QVERIFY((*transposed)[i] == reference[i]);
+    }
+
+    delete transposed;
+
+    // the same seed restarts the same streams
+    generator.setSeed(42);
+    QVERIFY(generator.newStream() == stream);
+
+    generator.setSeed(seed);
+}
+
+void FreeWillUnitTest::randomNumberGeneratorTestGPU()
+{
+    FreeWill::RandomNumberGenerator &generator = FreeWill::RandomNumberGenerator::getSingleton();
+    uint64_t stream = generator.newStream();
+
+    const unsigned int size = 100003;
+
+    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> cpuTensor({size});
+    cpuTensor.init();
+    cpuTensor.randomize(stream);
+
+    FreeWill::Tensor<FreeWill::DeviceType::GPU_CUDA, float> gpuTensor({size});
+    gpuTensor.init();
+    gpuTensor.randomize(stream);
+
+    FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, double> cpuDoubleTensor({size});
+    cpuDoubleTensor.init();
+    cpuDoubleTensor.randomize(stream);
+
+    FreeWill::Tensor<FreeWill::DeviceType::GPU_CUDA, double> gpuDoubleTensor({size});
+    gpuDoubleTensor.init();
+    gpuDoubleTensor.randomize(stream);
+
+    // the same bits on both, only the math libraries round differently
+    for (unsigned int i = 0; i < size; ++i)
+    {
+        QVERIFY(std::abs(cpuTensor[i] - gpuTensor[i]) < 1e-4);
+        QVERIFY(std::abs(cpuDoubleTensor[i] - gpuDoubleTensor[i]) < 1e-10);
+    }
+}
+
 void FreeWillUnitTest::operatorTest()
 {
 //    FreeWill::Operator<FreeWill::CPU> o;
@@ -184,6 +591,18 @@ void FreeWillUnitTest::operatorTest()
     {
         QVERIFY(result[i] == (tensorA[i] + tensorB[i]));
     }
+
+    // the slots are the positions in the parameter lists, bound by name
+    typedef FreeWill::ElementwiseAdd< FreeWill::DeviceType::CPU_NAIVE, float> ElementwiseAddType;
+    FreeWill::Operator<FreeWill::DeviceType::CPU_NAIVE> &operatorBase = elementAdd;
+    QVERIFY(operatorBase.input(ElementwiseAddType::OPERAND_A) == &tensorA);
+    QVERIFY(operatorBase.input(ElementwiseAddType::OPERAND_B) == &tensorB);
+    QVERIFY(operatorBase.output(ElementwiseAddType::RESULT) == &result);
+    QVERIFY(operatorBase.input("Result") == nullptr);
+
+    QVERIFY(tensorA.toType<float>() == &tensorA);
+    QVERIFY(tensorA.toType<double>() == nullptr);
+    QVERIFY(tensorA.toType<unsigned int>() == nullptr);
 }
 
 void FreeWillUnitTest::operatorTestGPU()
@@ -220,3 +639,173 @@ void FreeWillUnitTest::operatorTestGPU()
         QVERIFY(result[i] == (tensorA[i] + tensorB[i]));
     }
 }
+
+void FreeWillUnitTest::cudaGraphTestGPU()
+{
+    FreeWill::Tensor<FreeWill::DeviceType::GPU_CUDA, float> accumulator({64,32});
+    accumulator.init();
+    accumulator.randomize();
+
+    FreeWill::Tensor<FreeWill::DeviceType::GPU_CUDA, float> increment({64,32});
+    increment.init();
+    increment.randomize();
+
+    std::vector<float> initialValues(accumulator.cpuDataHandle(), accumulator.cpuDataHandle() + accumulator.shape().size());
+
+    FreeWill::ElementwiseAdd<FreeWill::DeviceType::GPU_CUDA, float> elementAdd;
+    elementAdd.setInputParameter("OperandA", &accumulator);
+    elementAdd.setInputParameter("OperandB", &increment);
+    elementAdd.setOutputParameter("Result", &accumulator);
+    QVERIFY(elementAdd.init());
+
+    accumulator.copyFromHostToDevice();
+    increment.copyFromHostToDevice();
+
+    // capturing records the addition without running it
+    FreeWill::CUDAGraph graph;
+    QVERIFY(graph.capture(0, [&](){ elementAdd.evaluate(); }));
+    QVERIFY(graph.isCaptured());
+
+    accumulator.copyFromDeviceToHost();
+    for (unsigned int i = 0; i < accumulator.shape().size(); ++i)
+    {
+        QVERIFY(accumulator[i] == initialValues[i]);
+    }
+
+    const unsigned int launchCount = 3;
+    for (unsigned int i = 0; i < launchCount; ++i)
+    {
+        QVERIFY(graph.launch());
+    }
+
+    accumulator.copyFromDeviceToHost();
+    for (unsigned int i = 0; i < accumulator.shape().size(); ++i)
+    {
+        float expected = initialValues[i];
+        for (unsigned int e = 0; e < launchCount; ++e)
+        {
+            expected += increment[i];
+        }
+
+        QVERIFY(accumulator[i] == expected);
+    }
+
+    // a synchronization can't be recorded
+    FreeWill::CUDAGraph invalidGraph;
+    QVERIFY(!invalidGraph.capture(0, [&](){ elementAdd.evaluate(); cudaDeviceSynchronize(); }));
+    QVERIFY(!invalidGraph.isCaptured());
+    QVERIFY(!invalidGraph.launch());
+}
+
+void FreeWillUnitTest::computeLaneTestGPU()
+{
+    FreeWill::Context<FreeWill::DeviceType::GPU_CUDA> &context = FreeWill::Context<FreeWill::DeviceType::GPU_CUDA>::getSingleton();
+
+    FreeWill::Tensor<FreeWill::DeviceType::GPU_CUDA, float> operandA({64,32});
+    operandA.init();
+    operandA.randomize();
+
+    FreeWill::Tensor<FreeWill::DeviceType::GPU_CUDA, float> operandB({64,32});
+    operandB.init();
+    operandB.randomize();
+
+    FreeWill::Tensor<FreeWill::DeviceType::GPU_CUDA, float> intermediate({64,32});
+    intermediate.init();
+
+    FreeWill::Tensor<FreeWill::DeviceType::GPU_CUDA, float> result({64,32});
+    result.init();
+
+    // intermediate = a + b on lane 1, result = intermediate + b on lane 0
+    FreeWill::ElementwiseAdd<FreeWill::DeviceType::GPU_CUDA, float> firstAdd;
+    firstAdd.setInputParameter("OperandA", &operandA);
+    firstAdd.setInputParameter("OperandB", &operandB);
+    firstAdd.setOutputParameter("Result", &intermediate);
+    QVERIFY(firstAdd.init());
+
+    FreeWill::ElementwiseAdd<FreeWill::DeviceType::GPU_CUDA, float> secondAdd;
+    secondAdd.setInputParameter("OperandA", &intermediate);
+    secondAdd.setInputParameter("OperandB", &operandB);
+    secondAdd.setOutputParameter("Result", &result);
+    QVERIFY(secondAdd.init());
+
+    operandA.copyFromHostToDevice();
+    operandB.copyFromHostToDevice();
+
+    QVERIFY(FreeWill::Device<FreeWill::DeviceType::GPU_CUDA>::COMPUTE_LANE_COUNT > 1);
+    QVERIFY(FreeWill::computeStream() == cudaStreamPerThread);
+
+    cudnnHandle_t defaultHandle = context.cudnnHandle(0);
+    context.reserveWorkspace(0, 1024);
+    void *defaultWorkspace = context.workspace(0);
+
+    cudaEvent_t startEvent = nullptr;
+    cudaEvent_t firstAddDone = nullptr;
+    RUN_CUDA(cudaEventCreateWithFlags(&startEvent, cudaEventDisableTiming));
+    RUN_CUDA(cudaEventCreateWithFlags(&firstAddDone, cudaEventDisableTiming));
+
+    // lane 1 starts after the uploads, lane 0 continues after the first addition
+    RUN_CUDA(cudaEventRecord(startEvent, context.computeStream(0, 0)));
+    RUN_CUDA(cudaStreamWaitEvent(context.computeStream(0, 1), startEvent, 0));
+
+    context.setComputeLane(0, 1);
+    QVERIFY(FreeWill::computeStream() == context.computeStream(0, 1));
+    QVERIFY(context.cudnnHandle(0) != defaultHandle);
+    // the workspace of a lane is allocated when it is first used
+    QVERIFY(context.workspace(0) != nullptr && context.workspace(0) != defaultWorkspace);
+    firstAdd.evaluate();
+    RUN_CUDA(cudaEventRecord(firstAddDone, context.computeStream(0, 1)));
+
+    context.setComputeLane(0, 0);
+    QVERIFY(FreeWill::computeStream() == cudaStreamPerThread);
+    QVERIFY(context.cudnnHandle(0) == defaultHandle);
+    RUN_CUDA(cudaStreamWaitEvent(context.computeStream(0, 0), firstAddDone, 0));
+    secondAdd.evaluate();
+
+    result.copyFromDeviceToHost();
+
+    for (unsigned int i = 0; i < result.shape().size(); ++i)
+    {
+        QVERIFY(std::abs(result[i] - (operandA[i] + operandB[i] + operandB[i])) < epsilon);
+    }
+
+    RUN_CUDA(cudaEventDestroy(startEvent));
+    RUN_CUDA(cudaEventDestroy(firstAddDone));
+}
+
+void FreeWillUnitTest::peerCopyTestGPU()
+{
+    FreeWill::Context<FreeWill::DeviceType::GPU_CUDA> &context = FreeWill::Context<FreeWill::DeviceType::GPU_CUDA>::getSingleton();
+
+    // the last gpu pulls the first one's tensor, a plain copy on a single gpu
+    unsigned int destinationDevice = context.deviceCount() - 1;
+
+    FreeWill::Tensor<FreeWill::DeviceType::GPU_CUDA, float> source({64,32});
+    source.init();
+    source.randomize();
+
+    RUN_CUDA(cudaSetDevice(destinationDevice));
+
+    FreeWill::Tensor<FreeWill::DeviceType::GPU_CUDA, float> destination({64,32});
+    destination.init();
+
+    FreeWill::Duplicate<FreeWill::DeviceType::GPU_CUDA, float> duplicate(destinationDevice, 0);
+    duplicate.setInputParameter("From", &source);
+    duplicate.setOutputParameter("To", &destination);
+    QVERIFY(duplicate.init());
+
+    RUN_CUDA(cudaSetDevice(0));
+    source.copyFromHostToDevice();
+
+    // the copy on the destination waits for the upload on the first gpu
+    context.joinDevices();
+
+    RUN_CUDA(cudaSetDevice(destinationDevice));
+    duplicate.evaluate();
+    destination.copyFromDeviceToHost();
+    RUN_CUDA(cudaSetDevice(0));
+
+    for (unsigned int i = 0; i < destination.shape().size(); ++i)
+    {
+        QVERIFY(destination[i] == source[i]);
+    }
+}
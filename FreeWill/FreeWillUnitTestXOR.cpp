@@ -12,9 +12,6 @@
 
 void FreeWillUnitTest::xorTest()
 {
-    //FreeWill::RandomNumberGenerator::getSingleton().beginRecording("recordRandom.bin");
-    //FreeWill::RandomNumberGenerator::getSingleton().beginReplay("recordRandom.bin");
-
     FreeWill::Tensor<FreeWill::DeviceType::CPU_NAIVE, float> input({2,4});
     input.init();
 
@@ -163,8 +160,6 @@ void FreeWillUnitTest::xorTest()
     mergeWithSecondLayerBias.setOutputParameter("Result", &secondLayerBias);
     QVERIFY(mergeWithSecondLayerBias.init());
 
-    //FreeWill::RandomNumberGenerator::getSingleton().endRecording();
-    //FreeWill::RandomNumberGenerator::getSingleton().endReplay();
 
 
     for (int e = 0;e<4;++e)
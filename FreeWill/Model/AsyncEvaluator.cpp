@@ -0,0 +1,305 @@
+#include "AsyncEvaluator.h"
+#include "../Context/Context.h"
+#include "../Context/Profiler.h"
+#include "../Tensor/BlobAllocator.h"
+#include <cstring>
+#include <iostream>
+
+FreeWill::AsyncEvaluator::AsyncEvaluator(FreeWill::Model *model, FreeWill::Solver *solver, const FreeWill::TensorDescriptorHandle &accumulator,
+                                         const FreeWill::AsyncEvaluator::LoadBatch &loadBatch)
+    :m_model(model),
+      m_solver(solver),
+      m_accumulator(accumulator),
+      m_loadBatch(loadBatch),
+      m_tensors(),
+      m_sizes(),
+      m_snapshot(nullptr),
+      m_snapshotSize(0),
+      m_isSnapshotPinned(false),
+      m_weightsReady(0),
+      m_downloaded(0),
+      m_thread(nullptr),
+      m_isEvaluating(false),
+      m_isEvaluated(false),
+      m_step(0),
+      m_values()
+{
+}
+
+FreeWill::AsyncEvaluator::~AsyncEvaluator()
+{
+    wait();
+    freeSnapshot();
+
+    if (m_downloaded)
+    {
+        RUN_CUDA(cudaEventDestroy(m_weightsReady));
+        RUN_CUDA(cudaEventDestroy(m_downloaded));
+    }
+}
+
+void FreeWill::AsyncEvaluator::freeSnapshot()
+{
+    if (m_snapshot)
+    {
+        BlobAllocator::getSingleton().freeHost(m_snapshot);
+    }
+
+    m_snapshot = nullptr;
+    m_snapshotSize = 0;
+}
+
+bool FreeWill::AsyncEvaluator::start(FreeWill::Model *trainingModel, unsigned int step)
+{
+    wait();
+    m_isEvaluated = false;
+
+    auto accumulator = m_model->m_tensors.find(m_accumulator.name());
+
+    if (trainingModel->m_deviceUsed != m_model->m_deviceUsed || accumulator == m_model->m_tensors.end() ||
+            accumulator->second->m_dataType != DataType::DOUBLE || accumulator->second->m_tensors[m_model->m_deviceUsed].empty())
+    {
+        return false;
+    }
+
+    std::vector<CheckpointEntry> entries;
+    std::vector<TensorDescriptor*> sources;
+
+    if (!trainingModel->checkpointTensors(entries, sources))
+    {
+        return false;
+    }
+
+    // the weights the replica has allocated, an inference solver leaves out the optimizer state
+    std::vector<TensorDescriptor*> weights;
+    m_tensors.clear();
+    m_sizes.clear();
+
+    for (unsigned int i = 0; i < sources.size(); ++i)
+    {
+        auto tensor = m_model->m_tensors.find(entries[i].m_name);
+
+        if (tensor == m_model->m_tensors.end() || tensor->second->m_tensors[m_model->m_deviceUsed].empty())
+        {
+            continue;
+        }
+
+        if (tensor->second->m_dataType != sources[i]->m_dataType || !(tensor->second->m_shape == sources[i]->m_shape))
+        {
+            std::cerr << "tensor " << entries[i].m_name << " of the evaluation model doesn't match the training model" << std::endl;
+            return false;
+        }
+
+        weights.push_back(sources[i]);
+        m_tensors.push_back(tensor->second);
+        m_sizes.push_back(entries[i].m_sizeInByte);
+    }
+
+    bool isGPU = m_model->m_deviceUsed == DeviceType::GPU_CUDA;
+    size_t snapshotSize = 0;
+
+    for (size_t size : m_sizes)
+    {
+        snapshotSize += size;
+    }
+
+    if (snapshotSize > m_snapshotSize || isGPU != m_isSnapshotPinned)
+    {
+        freeSnapshot();
+
+        m_snapshot = (unsigned char *) BlobAllocator::getSingleton().allocateHost(snapshotSize, isGPU);
+
+        if (!m_snapshot && snapshotSize)
+        {
+            return false;
+        }
+
+        m_snapshotSize = snapshotSize;
+        m_isSnapshotPinned = isGPU;
+    }
+
+    unsigned char *snapshot = m_snapshot;
+
+    if (isGPU)
+    {
+        Context<DeviceType::GPU_CUDA> &context = Context<DeviceType::GPU_CUDA>::getSingleton();
+        cudaStream_t downloadStream = context.downloadStream(0);
+
+        if (!m_downloaded)
+        {
+            RUN_CUDA(cudaEventCreateWithFlags(&m_weightsReady, cudaEventDisableTiming));
+            RUN_CUDA(cudaEventCreateWithFlags(&m_downloaded, cudaEventDisableTiming));
+        }
+
+        RUN_CUDA(cudaEventRecord(m_weightsReady, 0));
+        RUN_CUDA(cudaStreamWaitEvent(downloadStream, m_weightsReady, 0));
+
+        for (unsigned int i = 0; i < weights.size(); ++i)
+        {
+            TensorBase<DeviceType::GPU_CUDA> *tensor = weights[i]->getTensorForDevice<DeviceType::GPU_CUDA>(0);
+
+            RUN_CUDA(cudaMemcpyAsync(snapshot, tensor->gpuDataHandle(), m_sizes[i], cudaMemcpyDeviceToHost, downloadStream));
+            snapshot += m_sizes[i];
+        }
+
+        // the next update waits on the device until the weights are read
+        RUN_CUDA(cudaEventRecord(m_downloaded, downloadStream));
+        RUN_CUDA(cudaStreamWaitEvent(0, m_downloaded, 0));
+    }
+    else
+    {
+        for (unsigned int i = 0; i < weights.size(); ++i)
+        {
+            std::memcpy(snapshot, weights[i]->getTensorForDevice<DeviceType::CPU_NAIVE>(0)->cpuDataHandle(), m_sizes[i]);
+            snapshot += m_sizes[i];
+        }
+    }
+
+    m_step = step;
+    m_isEvaluating = true;
+    m_thread = new std::thread(&AsyncEvaluator::evaluate, this);
+
+    return true;
+}
+
+template<FreeWill::DeviceType DeviceUsed>
+void FreeWill::AsyncEvaluator::restoreSnapshot()
+{
+    const unsigned char *snapshot = m_snapshot;
+
+    for (unsigned int i = 0; i < m_tensors.size(); ++i)
+    {
+        for (unsigned int r = 0; r < m_tensors[i]->m_tensors[DeviceUsed].size(); ++r)
+        {
+            TensorBase<DeviceUsed> *tensor = m_tensors[i]->getTensorForDevice<DeviceUsed>(r);
+
+            std::memcpy(tensor->cpuDataHandle(), snapshot, m_sizes[i]);
+
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                RUN_CUDA(cudaSetDevice(m_tensors[i]->deviceId(r)));
+                tensor->copyFromHostToDevice();
+            }
+        }
+
+        snapshot += m_sizes[i];
+    }
+
+    if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+    {
+        RUN_CUDA(cudaSetDevice(0));
+    }
+}
+
+template<FreeWill::DeviceType DeviceUsed>
+void FreeWill::AsyncEvaluator::resetAccumulator()
+{
+    TensorDescriptor *accumulator = m_model->m_tensors[m_accumulator.name()];
+
+    for (unsigned int r = 0; r < accumulator->m_tensors[DeviceUsed].size(); ++r)
+    {
+        if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+        {
+            RUN_CUDA(cudaSetDevice(accumulator->deviceId(r)));
+        }
+
+        accumulator->getTensorForDevice<DeviceUsed>(r)->clear();
+    }
+
+    if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+    {
+        RUN_CUDA(cudaSetDevice(0));
+    }
+}
+
+template<FreeWill::DeviceType DeviceUsed>
+FreeWill::MetricValues FreeWill::AsyncEvaluator::fetchAccumulator()
+{
+    TensorDescriptor *accumulator = m_model->m_tensors[m_accumulator.name()];
+    MetricValues values;
+
+    // every replica of an evaluation model that isn't placed scores its share of the batch
+    for (unsigned int r = 0; r < accumulator->m_tensors[DeviceUsed].size(); ++r)
+    {
+        TensorBase<DeviceUsed> *tensor = accumulator->getTensorForDevice<DeviceUsed>(r);
+
+        if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+        {
+            RUN_CUDA(cudaSetDevice(accumulator->deviceId(r)));
+            tensor->copyFromDeviceToHost();
+        }
+
+        const double *data = static_cast<const double*>(tensor->cpuDataHandle());
+        values.m_costSum += data[0];
+        values.m_hitCount += data[1];
+        values.m_sampleCount += data[2];
+    }
+
+    if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+    {
+        RUN_CUDA(cudaSetDevice(0));
+    }
+
+    return values;
+}
+
+void FreeWill::AsyncEvaluator::evaluate()
+{
+    if (m_isSnapshotPinned)
+    {
+        RUN_CUDA(cudaEventSynchronize(m_downloaded));
+    }
+
+    switch (m_model->m_deviceUsed)
+    {
+    case DeviceType::CPU_NAIVE:
+        restoreSnapshot<DeviceType::CPU_NAIVE>();
+        resetAccumulator<DeviceType::CPU_NAIVE>();
+        break;
+    case DeviceType::GPU_CUDA:
+        restoreSnapshot<DeviceType::GPU_CUDA>();
+        resetAccumulator<DeviceType::GPU_CUDA>();
+        break;
+    }
+
+    unsigned int batchIndex = 0;
+
+    while (m_loadBatch(m_model, batchIndex))
+    {
+        m_solver->forward(m_model);
+        ++batchIndex;
+    }
+
+    switch (m_model->m_deviceUsed)
+    {
+    case DeviceType::CPU_NAIVE:
+        m_values = fetchAccumulator<DeviceType::CPU_NAIVE>();
+        break;
+    case DeviceType::GPU_CUDA:
+        m_values = fetchAccumulator<DeviceType::GPU_CUDA>();
+        break;
+    }
+
+    m_isEvaluated = batchIndex > 0;
+
+    if (m_isEvaluated)
+    {
+        Profiler::getSingleton().endEvaluation(m_step, m_values.meanCost(), m_values.accuracy());
+    }
+
+    m_isEvaluating = false;
+}
+
+bool FreeWill::AsyncEvaluator::wait()
+{
+    if (!m_thread)
+    {
+        return m_isEvaluated;
+    }
+
+    m_thread->join();
+    delete m_thread;
+    m_thread = nullptr;
+
+    return m_isEvaluated;
+}
@@ -0,0 +1,94 @@
+#ifndef ASYNCEVALUATOR_H
+#define ASYNCEVALUATOR_H
+
+#include "Model.h"
+#include "Solver.h"
+#include "../Operator/Metric.h"
+#include <cuda_runtime.h>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace FreeWill
+{
+    // Scores the test set while training goes on. The evaluation replica is a second model built
+    // from the same graph with a METRIC in its forward path, initialized with an inference
+    // solver, best with its forward path placed on a device of its own (Model::placeOperators),
+    // a spare gpu or a cpu worker the training shares. start() snapshots the weights of the
+    // training model into a buffer of the evaluator like CheckpointWriter::save, on gpu on the
+    // download stream that the default stream waits for before it changes the weights again.
+    // The evaluator's thread copies the snapshot into the replica, zeroes the accumulator and
+    // runs forward() over the batches loadBatch puts into the replica until it returns false,
+    // then hands the accumulated metric to Profiler::endEvaluation. One evaluation runs at a
+    // time, start() first waits for the previous one.
+    class AsyncEvaluator
+    {
+    public:
+        // fills the input tensors of model with test batch batchIndex, false past the last one
+        typedef std::function<bool(Model *model, unsigned int batchIndex)> LoadBatch;
+
+    private:
+        Model *m_model;
+        Solver *m_solver;
+        TensorDescriptorHandle m_accumulator;
+        LoadBatch m_loadBatch;
+
+        // the tensors of the replica the snapshot goes into, with their size
+        std::vector<TensorDescriptor*> m_tensors;
+        std::vector<size_t> m_sizes;
+
+        // the snapshot, page-locked for gpu
+        unsigned char *m_snapshot;
+        size_t m_snapshotSize;
+        bool m_isSnapshotPinned;
+        cudaEvent_t m_weightsReady;
+        cudaEvent_t m_downloaded;
+
+        std::thread *m_thread;
+        std::atomic<bool> m_isEvaluating;
+        bool m_isEvaluated;
+        unsigned int m_step;
+        MetricValues m_values;
+
+        void evaluate();
+        void freeSnapshot();
+
+        template<DeviceType DeviceUsed>
+        void restoreSnapshot();
+
+        template<DeviceType DeviceUsed>
+        void resetAccumulator();
+
+        template<DeviceType DeviceUsed>
+        MetricValues fetchAccumulator();
+
+    public:
+        AsyncEvaluator(Model *model, Solver *solver, const TensorDescriptorHandle &accumulator, const LoadBatch &loadBatch);
+        ~AsyncEvaluator();
+
+        AsyncEvaluator(const AsyncEvaluator &) = delete;
+        void operator=(const AsyncEvaluator &) = delete;
+
+        // between two steps of trainingModel: false when its weights can't be snapshot into the
+        // replica, e.g. one of them has another data type or shape there. step is reported
+        // with the result.
+        bool start(Model *trainingModel, unsigned int step);
+
+        // until the last evaluation is done, whether it scored any batch
+        bool wait();
+
+        bool isEvaluating() const
+        {
+            return m_isEvaluating;
+        }
+
+        // the metric of the last evaluation, after wait()
+        const MetricValues &values() const
+        {
+            return m_values;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef BATCHSCATTER_H
+#define BATCHSCATTER_H
+
+#include "../DeviceSelection.h"
+#include "../Context/Context.h"
+#include "../Context/CompletionLatch.h"
+#include "../Context/WorkerMessage.h"
+#include "../Operator/FeedFromMemory.h"
+#include "../Tensor/BlobAllocator.h"
+#include "TensorDescriptor.h"
+#include <vector>
+
+namespace FreeWill
+{
+    // The global batch of one batch tensor, deviceCount times its batch, and the copying feeds
+    // that hand replica i its i-th slice. On cpu the slices are copied by the device workers in
+    // parallel, on gpu each device uploads its slice on its own copy stream. The buffer is
+    // pinned for gpu.
+    template<DeviceType DeviceUsed>
+    class BatchScatter
+    {
+    private:
+        unsigned char *m_globalBatch;
+        unsigned int m_sliceSizeInByte;
+        // between begin() and end()
+        bool m_isPending;
+
+        std::vector<FeedFromMemory<DeviceUsed, unsigned char>*> m_feeds;
+        std::vector<WorkerMessage*> m_workerMessages;
+        CompletionLatch m_completionLatch;
+
+        void freeGlobalBatch()
+        {
+            if (m_globalBatch)
+            {
+                BlobAllocator::getSingleton().freeHost(m_globalBatch);
+                m_globalBatch = nullptr;
+            }
+
+            m_sliceSizeInByte = 0;
+        }
+
+    public:
+        BatchScatter()
+            :m_globalBatch(nullptr),
+              m_sliceSizeInByte(0),
+              m_isPending(false),
+              m_feeds(),
+              m_workerMessages(),
+              m_completionLatch()
+        {
+        }
+
+        BatchScatter(const BatchScatter &) = delete;
+        void operator=(const BatchScatter &) = delete;
+
+        ~BatchScatter()
+        {
+            for (unsigned int i = 0; i < m_feeds.size(); ++i)
+            {
+                delete m_feeds[i];
+                delete m_workerMessages[i];
+            }
+
+            freeGlobalBatch();
+        }
+
+        // the buffer to write the global batch into, sized for the batch the replicas are
+        // viewed at now
+        unsigned char *begin(TensorDescriptor *tensorDescriptor)
+        {
+            unsigned int deviceCount = tensorDescriptor->m_tensors[DeviceUsed].size();
+            unsigned int sliceSizeInByte = tensorDescriptor->getTensorForDevice<DeviceUsed>(0)->viewSizeInByte();
+
+            if (sliceSizeInByte != m_sliceSizeInByte || m_feeds.size() != deviceCount)
+            {
+                freeGlobalBatch();
+
+                m_globalBatch = (unsigned char *) BlobAllocator::getSingleton().allocateHost((size_t) sliceSizeInByte * deviceCount,
+                                                                                              DeviceUsed == DeviceType::GPU_CUDA);
+                m_sliceSizeInByte = sliceSizeInByte;
+
+                for (unsigned int i = m_feeds.size(); i < deviceCount; ++i)
+                {
+                    m_feeds.push_back(new FeedFromMemory<DeviceUsed, unsigned char>(i, true));
+                    m_workerMessages.push_back(new WorkerMessage(WorkerMessage::Type::NO_WORK, (Operator<DeviceUsed>*) nullptr));
+                }
+            }
+
+            m_isPending = m_globalBatch != nullptr;
+
+            return m_globalBatch;
+        }
+
+        bool isPending() const
+        {
+            return m_isPending;
+        }
+
+        void end(TensorDescriptor *tensorDescriptor)
+        {
+            unsigned int deviceCount = tensorDescriptor->m_tensors[DeviceUsed].size();
+
+            if (!m_isPending || m_feeds.size() < deviceCount)
+            {
+                return;
+            }
+
+            m_isPending = false;
+
+            for (unsigned int i = 0; i < deviceCount; ++i)
+            {
+                m_feeds[i]->setOutputParameter("Output", tensorDescriptor->getTensorForDevice<DeviceUsed>(i));
+                m_feeds[i]->setSource(m_globalBatch + (size_t) i * m_sliceSizeInByte);
+            }
+
+            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+            {
+                m_completionLatch.reset(deviceCount);
+
+                for (unsigned int i = 0; i < deviceCount; ++i)
+                {
+                    m_workerMessages[i]->reset(WorkerMessage::Type::FORWARD, m_feeds[i], &m_completionLatch);
+                    Context<DeviceUsed>::getSingleton().pushWork(i, m_workerMessages[i]);
+                }
+
+                m_completionLatch.wait();
+            }
+            else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                // the uploads only queue, the copy engines of the devices run them side by side
+                for (unsigned int i = 0; i < deviceCount; ++i)
+                {
+                    RUN_CUDA(cudaSetDevice(i));
+                    m_feeds[i]->evaluate();
+                }
+
+                RUN_CUDA(cudaSetDevice(0));
+            }
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,182 @@
+#include "Checkpoint.h"
+#include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <iostream>
+
+static uint64_t alignCheckpointOffset(uint64_t offset)
+{
+    return (offset + FreeWill::CHECKPOINT_ALIGNMENT - 1) / FreeWill::CHECKPOINT_ALIGNMENT * FreeWill::CHECKPOINT_ALIGNMENT;
+}
+
+static bool writeAll(int fileDescriptor, const void *data, uint64_t size)
+{
+    const unsigned char *bytes = static_cast<const unsigned char*>(data);
+
+    while (size > 0)
+    {
+        ssize_t written = ::write(fileDescriptor, bytes, size);
+
+        if (written <= 0)
+        {
+            return false;
+        }
+
+        bytes += written;
+        size -= written;
+    }
+
+    return true;
+}
+
+bool FreeWill::writeCheckpoint(const std::string &filename, const FreeWill::SolverState &solverState,
+                               std::vector<FreeWill::CheckpointEntry> &entries, const std::vector<const void*> &data)
+{
+    CheckpointHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.m_magic = CHECKPOINT_MAGIC;
+    header.m_version = CHECKPOINT_VERSION;
+    header.m_tensorCount = entries.size();
+    header.m_headerSize = sizeof(CheckpointHeader) + entries.size() * sizeof(CheckpointEntry);
+    header.m_solverState = solverState;
+
+    uint64_t offset = alignCheckpointOffset(header.m_headerSize);
+    for (unsigned int i = 0; i < entries.size(); ++i)
+    {
+        entries[i].m_offset = offset;
+        offset = alignCheckpointOffset(offset + entries[i].m_sizeInByte);
+    }
+
+    // the header and the table go out in one write, padded to where the data starts
+    std::vector<unsigned char> table(alignCheckpointOffset(header.m_headerSize), 0);
+    std::memcpy(table.data(), &header, sizeof(header));
+    if (!entries.empty())
+    {
+        std::memcpy(table.data() + sizeof(header), entries.data(), entries.size() * sizeof(CheckpointEntry));
+    }
+
+    std::string temporaryFilename = filename + ".tmp";
+    int fileDescriptor = ::open(temporaryFilename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if (fileDescriptor < 0)
+    {
+        std::cerr << "can't open " << temporaryFilename << std::endl;
+        return false;
+    }
+
+    static const unsigned char padding[CHECKPOINT_ALIGNMENT] = {0};
+    bool isWritten = writeAll(fileDescriptor, table.data(), table.size());
+
+    for (unsigned int i = 0; i < entries.size() && isWritten; ++i)
+    {
+        uint64_t end = entries[i].m_offset + entries[i].m_sizeInByte;
+
+        isWritten = writeAll(fileDescriptor, data[i], entries[i].m_sizeInByte) &&
+                    writeAll(fileDescriptor, padding, alignCheckpointOffset(end) - end);
+    }
+
+    isWritten = isWritten && fdatasync(fileDescriptor) == 0;
+    isWritten = (::close(fileDescriptor) == 0) && isWritten;
+
+    if (!isWritten || std::rename(temporaryFilename.c_str(), filename.c_str()) != 0)
+    {
+        std::cerr << "can't write checkpoint " << filename << std::endl;
+        std::remove(temporaryFilename.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+FreeWill::CheckpointReader::CheckpointReader()
+    :m_fileDescriptor(-1),
+      m_mapping(nullptr),
+      m_mappingSize(0)
+{
+}
+
+FreeWill::CheckpointReader::~CheckpointReader()
+{
+    close();
+}
+
+bool FreeWill::CheckpointReader::open(const std::string &filename)
+{
+    close();
+
+    m_fileDescriptor = ::open(filename.c_str(), O_RDONLY);
+
+    if (m_fileDescriptor < 0)
+    {
+        std::cerr << "can't open " << filename << std::endl;
+        return false;
+    }
+
+    struct stat fileStatus;
+
+    if (fstat(m_fileDescriptor, &fileStatus) != 0 || (size_t) fileStatus.st_size < sizeof(CheckpointHeader))
+    {
+        close();
+        return false;
+    }
+
+    m_mappingSize = fileStatus.st_size;
+    void *mapping = mmap(nullptr, m_mappingSize, PROT_READ, MAP_PRIVATE, m_fileDescriptor, 0);
+
+    if (mapping == MAP_FAILED)
+    {
+        std::cerr << "can't map " << filename << std::endl;
+        m_mappingSize = 0;
+        close();
+        return false;
+    }
+
+    m_mapping = static_cast<const unsigned char*>(mapping);
+    madvise(mapping, m_mappingSize, MADV_SEQUENTIAL);
+
+    const CheckpointHeader &checkpointHeader = header();
+
+    if (checkpointHeader.m_magic != CHECKPOINT_MAGIC || checkpointHeader.m_version > CHECKPOINT_VERSION ||
+            checkpointHeader.m_headerSize != sizeof(CheckpointHeader) + (uint64_t) checkpointHeader.m_tensorCount * sizeof(CheckpointEntry) ||
+            checkpointHeader.m_headerSize > m_mappingSize)
+    {
+        std::cerr << filename << " is not a checkpoint of this version" << std::endl;
+        close();
+        return false;
+    }
+
+    for (unsigned int i = 0; i < checkpointHeader.m_tensorCount; ++i)
+    {
+        const CheckpointEntry &checkpointEntry = entry(i);
+
+        if (checkpointEntry.m_offset > m_mappingSize || checkpointEntry.m_sizeInByte > m_mappingSize - checkpointEntry.m_offset ||
+                checkpointEntry.m_dimension > CHECKPOINT_MAX_DIMENSION || checkpointEntry.m_name[CHECKPOINT_MAX_NAME - 1] != '\0')
+        {
+            std::cerr << filename << " is truncated" << std::endl;
+            close();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void FreeWill::CheckpointReader::close()
+{
+    if (m_mapping)
+    {
+        munmap(const_cast<unsigned char*>(m_mapping), m_mappingSize);
+    }
+
+    if (m_fileDescriptor >= 0)
+    {
+        ::close(m_fileDescriptor);
+    }
+
+    m_fileDescriptor = -1;
+    m_mapping = nullptr;
+    m_mappingSize = 0;
+}
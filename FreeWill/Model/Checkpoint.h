@@ -0,0 +1,81 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "Solver.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace FreeWill
+{
+    // The checkpoint file, native endian: a CheckpointHeader, m_tensorCount CheckpointEntry and
+    // then the data of every tensor, each starting on a CHECKPOINT_ALIGNMENT boundary so that
+    // the mapped file can be copied from page by page. A newer version is refused.
+    const uint32_t CHECKPOINT_MAGIC = 0x4b435746; // "FWCK"
+    const uint32_t CHECKPOINT_VERSION = 1;
+    const uint64_t CHECKPOINT_ALIGNMENT = 4096;
+    const unsigned int CHECKPOINT_MAX_NAME = 128;
+    const unsigned int CHECKPOINT_MAX_DIMENSION = 8;
+
+    struct CheckpointHeader
+    {
+        uint32_t m_magic;
+        uint32_t m_version;
+        uint32_t m_tensorCount;
+        uint32_t m_headerSize;
+        SolverState m_solverState;
+    };
+
+    // the shape table, one per tensor
+    struct CheckpointEntry
+    {
+        char m_name[CHECKPOINT_MAX_NAME];
+        uint32_t m_dataType;
+        uint32_t m_dimension;
+        uint32_t m_shape[CHECKPOINT_MAX_DIMENSION];
+        uint64_t m_offset;
+        uint64_t m_sizeInByte;
+    };
+
+    // Writes entries and data[i], entries[i].m_sizeInByte bytes each, to a temporary file that
+    // replaces filename once complete, so a crash never leaves half a checkpoint. The offsets
+    // of the entries are filled in.
+    bool writeCheckpoint(const std::string &filename, const SolverState &solverState,
+                         std::vector<CheckpointEntry> &entries, const std::vector<const void*> &data);
+
+    // A checkpoint mapped read only, the data of an entry points into the mapping
+    class CheckpointReader
+    {
+        int m_fileDescriptor;
+        const unsigned char *m_mapping;
+        size_t m_mappingSize;
+
+    public:
+        CheckpointReader();
+        ~CheckpointReader();
+
+        CheckpointReader(const CheckpointReader &) = delete;
+        void operator=(const CheckpointReader &) = delete;
+
+        // checks the header and that every entry lies inside the file
+        bool open(const std::string &filename);
+        void close();
+
+        const CheckpointHeader &header() const
+        {
+            return *reinterpret_cast<const CheckpointHeader*>(m_mapping);
+        }
+
+        const CheckpointEntry &entry(unsigned int index) const
+        {
+            return reinterpret_cast<const CheckpointEntry*>(m_mapping + sizeof(CheckpointHeader))[index];
+        }
+
+        const void *data(const CheckpointEntry &entry) const
+        {
+            return m_mapping + entry.m_offset;
+        }
+    };
+}
+
+#endif
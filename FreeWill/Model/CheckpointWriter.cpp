@@ -0,0 +1,151 @@
+#include "CheckpointWriter.h"
+#include "Model.h"
+#include "../Context/Context.h"
+#include "../Tensor/BlobAllocator.h"
+#include <cstring>
+
+FreeWill::CheckpointWriter::CheckpointWriter()
+    :m_entries(),
+      m_data(),
+      m_solverState(),
+      m_snapshot(nullptr),
+      m_snapshotSize(0),
+      m_isSnapshotPinned(false),
+      m_weightsReady(0),
+      m_downloaded(0),
+      m_thread(nullptr),
+      m_isWriting(false),
+      m_isWritten(false)
+{
+}
+
+FreeWill::CheckpointWriter::~CheckpointWriter()
+{
+    wait();
+    freeSnapshot();
+
+    if (m_downloaded)
+    {
+        RUN_CUDA(cudaEventDestroy(m_weightsReady));
+        RUN_CUDA(cudaEventDestroy(m_downloaded));
+    }
+}
+
+void FreeWill::CheckpointWriter::freeSnapshot()
+{
+    if (m_snapshot)
+    {
+        BlobAllocator::getSingleton().freeHost(m_snapshot);
+    }
+
+    m_snapshot = nullptr;
+    m_snapshotSize = 0;
+}
+
+bool FreeWill::CheckpointWriter::save(FreeWill::Model *model, const std::string &filename, const FreeWill::Solver *solver)
+{
+    wait();
+    m_isWritten = false;
+
+    std::vector<TensorDescriptor*> tensors;
+
+    if (!model->checkpointTensors(m_entries, tensors))
+    {
+        return false;
+    }
+
+    bool isGPU = model->m_deviceUsed == DeviceType::GPU_CUDA;
+    size_t snapshotSize = 0;
+
+    for (const CheckpointEntry &entry : m_entries)
+    {
+        snapshotSize += entry.m_sizeInByte;
+    }
+
+    if (snapshotSize > m_snapshotSize || isGPU != m_isSnapshotPinned)
+    {
+        freeSnapshot();
+
+        m_snapshot = (unsigned char *) BlobAllocator::getSingleton().allocateHost(snapshotSize, isGPU);
+
+        if (!m_snapshot)
+        {
+            return false;
+        }
+
+        m_snapshotSize = snapshotSize;
+        m_isSnapshotPinned = isGPU;
+    }
+
+    m_data.clear();
+    unsigned char *snapshot = m_snapshot;
+
+    if (isGPU)
+    {
+        Context<DeviceType::GPU_CUDA> &context = Context<DeviceType::GPU_CUDA>::getSingleton();
+        // the download stream, so the snapshot doesn't queue behind the next batch's upload
+        cudaStream_t downloadStream = context.downloadStream(0);
+
+        if (!m_downloaded)
+        {
+            RUN_CUDA(cudaEventCreateWithFlags(&m_weightsReady, cudaEventDisableTiming));
+            RUN_CUDA(cudaEventCreateWithFlags(&m_downloaded, cudaEventDisableTiming));
+        }
+
+        RUN_CUDA(cudaEventRecord(m_weightsReady, 0));
+        RUN_CUDA(cudaStreamWaitEvent(downloadStream, m_weightsReady, 0));
+
+        for (unsigned int i = 0; i < tensors.size(); ++i)
+        {
+            TensorBase<DeviceType::GPU_CUDA> *tensor = tensors[i]->getTensorForDevice<DeviceType::GPU_CUDA>(0);
+
+            RUN_CUDA(cudaMemcpyAsync(snapshot, tensor->gpuDataHandle(), m_entries[i].m_sizeInByte, cudaMemcpyDeviceToHost, downloadStream));
+            m_data.push_back(snapshot);
+            snapshot += m_entries[i].m_sizeInByte;
+        }
+
+        // the next update waits on the device until the weights are read
+        RUN_CUDA(cudaEventRecord(m_downloaded, downloadStream));
+        RUN_CUDA(cudaStreamWaitEvent(0, m_downloaded, 0));
+    }
+    else
+    {
+        for (unsigned int i = 0; i < tensors.size(); ++i)
+        {
+            std::memcpy(snapshot, tensors[i]->getTensorForDevice<DeviceType::CPU_NAIVE>(0)->cpuDataHandle(), m_entries[i].m_sizeInByte);
+            m_data.push_back(snapshot);
+            snapshot += m_entries[i].m_sizeInByte;
+        }
+    }
+
+    m_solverState = solver ? solver->state() : SolverState();
+    m_isWriting = true;
+    m_thread = new std::thread(&CheckpointWriter::write, this, filename);
+
+    return true;
+}
+
+void FreeWill::CheckpointWriter::write(std::string filename)
+{
+    if (m_isSnapshotPinned)
+    {
+        RUN_CUDA(cudaEventSynchronize(m_downloaded));
+    }
+
+    m_isWritten = writeCheckpoint(filename, m_solverState, m_entries, m_data);
+    m_isWriting = false;
+}
+
+bool FreeWill::CheckpointWriter::wait()
+{
+    if (!m_thread)
+    {
+        return m_isWritten;
+    }
+
+    m_thread->join();
+    delete m_thread;
+    m_thread = nullptr;
+
+    return m_isWritten;
+}
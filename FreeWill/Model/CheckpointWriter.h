@@ -0,0 +1,63 @@
+#ifndef CHECKPOINTWRITER_H
+#define CHECKPOINTWRITER_H
+
+#include "Checkpoint.h"
+#include <cuda_runtime.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace FreeWill
+{
+    class Model;
+
+    // Checkpoints while training goes on. save() only snapshots the tensors Model::saveCheckpoint
+    // keeps into a buffer of its own, a memcpy on cpu, on gpu an asynchronous download on the
+    // download stream that the default stream waits for before it changes the weights again. The
+    // file is written and synced on a thread of the writer while the solver takes its next
+    // steps. One checkpoint is in flight at a time, save() first waits for the previous one.
+    class CheckpointWriter
+    {
+    private:
+        std::vector<CheckpointEntry> m_entries;
+        std::vector<const void*> m_data;
+        SolverState m_solverState;
+
+        // the snapshot, page-locked for gpu
+        unsigned char *m_snapshot;
+        size_t m_snapshotSize;
+        bool m_isSnapshotPinned;
+        // the download waits for the kernels queued before save(), the thread waits for the
+        // download before it writes
+        cudaEvent_t m_weightsReady;
+        cudaEvent_t m_downloaded;
+
+        std::thread *m_thread;
+        std::atomic<bool> m_isWriting;
+        bool m_isWritten;
+
+        void write(std::string filename);
+        void freeSnapshot();
+
+    public:
+        CheckpointWriter();
+        ~CheckpointWriter();
+
+        CheckpointWriter(const CheckpointWriter &) = delete;
+        void operator=(const CheckpointWriter &) = delete;
+
+        // false when the snapshot can't be taken, the outcome of the write is wait()'s
+        bool save(Model *model, const std::string &filename, const Solver *solver = nullptr);
+
+        // until the last checkpoint is on disk, whether it was written
+        bool wait();
+
+        bool isWriting() const
+        {
+            return m_isWriting;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,1539 @@
+#ifndef GRADIENTALLREDUCE_H
+#define GRADIENTALLREDUCE_H
+
+#include "../DeviceSelection.h"
+#include "../Operator/Operator.h"
+#include "../Operator/ElementwiseAdd_CUDA.h"
+#include "../Operator/Optimizer.h"
+#include "../Operator/Optimizer_CUDA.h"
+#include "../Context/Context.h"
+#include "../Context/Communicator.h"
+#include "../Context/ComputeStream.h"
+#include "../Context/CompletionLatch.h"
+#include "../Context/WorkerMessage.h"
+#include "GraphExecutor.h"
+#include "TensorDescriptor.h"
+#include <algorithm>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace FreeWill
+{
+    // A weight, its gradient and the optimizer state kept for the weight (nullptr where the
+    // optimizer needs less state). 16-bit weights also have a float master copy that the
+    // optimizer updates, the state is float then too.
+    struct ParameterUpdate
+    {
+        TensorDescriptor *m_weight;
+        TensorDescriptor *m_gradient;
+        TensorDescriptor *m_optimizerState[2];
+        TensorDescriptor *m_masterWeight;
+    };
+
+    // Owns one chunk of every gradient and sums that chunk over all replicas into the first
+    // replica, in replica order. The chunks of different steps are disjoint.
+    //
+    // Staged, for gpus without peer access, the sum goes into this device's replica instead.
+    // The other replicas' chunks are copied into a scratch buffer one at a time with
+    // cudaMemcpyPeerAsync, which the driver routes through the host, before they are added.
+    template<DeviceType DeviceUsed, typename DataType>
+    class GradientReduceStep : public Operator<DeviceUsed>
+    {
+    private:
+        using Operator<DeviceUsed>::m_deviceId;
+
+        struct Chunk
+        {
+            std::vector<DataType*> m_gradients;
+            unsigned int m_begin;
+            unsigned int m_end;
+        };
+
+        std::vector<Chunk> m_chunks;
+        bool m_isStaged;
+        unsigned int m_largestChunkSize;
+        // this device's own addend, which the first replica's chunk overwrites, and the chunk
+        // of the replica being added
+        DataType *m_ownChunk;
+        DataType *m_peerChunk;
+
+    public:
+        GradientReduceStep(unsigned int deviceId, bool isStaged = false)
+            :Operator<DeviceUsed>({}, {}, deviceId),
+              m_chunks(),
+              m_isStaged(isStaged),
+              m_largestChunkSize(0),
+              m_ownChunk(nullptr),
+              m_peerChunk(nullptr)
+        {}
+
+        ~GradientReduceStep()
+        {
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                if (m_ownChunk)
+                {
+                    RUN_CUDA(cudaFree(m_ownChunk));
+                    RUN_CUDA(cudaFree(m_peerChunk));
+                }
+            }
+        }
+
+        void addChunk(const std::vector<DataType*> &gradients, unsigned int begin, unsigned int end)
+        {
+            m_chunks.push_back({gradients, begin, end});
+            m_largestChunkSize = std::max(m_largestChunkSize, end - begin);
+        }
+
+        // after the last addChunk, allocates the scratch buffers of a staged step
+        virtual bool init() override
+        {
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                if (m_isStaged && !m_ownChunk && m_largestChunkSize > 0)
+                {
+                    RUN_CUDA(cudaSetDevice(m_deviceId));
+                    RUN_CUDA(cudaMalloc(&m_ownChunk, m_largestChunkSize * sizeof(DataType)));
+                    RUN_CUDA(cudaMalloc(&m_peerChunk, m_largestChunkSize * sizeof(DataType)));
+                }
+            }
+
+            return true;
+        }
+
+        virtual void evaluate() override
+        {
+            for (const Chunk &chunk : m_chunks)
+            {
+                DataType *gradient = chunk.m_gradients[0] + chunk.m_begin;
+                unsigned int size = chunk.m_end - chunk.m_begin;
+
+                if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+                {
+                    if (m_isStaged)
+                    {
+                        evaluateStaged(chunk);
+                        continue;
+                    }
+                }
+
+                for (unsigned int i = 1; i < chunk.m_gradients.size(); ++i)
+                {
+                    if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+                    {
+                        const DataType *replicaGradient = chunk.m_gradients[i] + chunk.m_begin;
+                        for (unsigned int e = 0; e < size; ++e)
+                        {
+                            gradient[e] = gradient[e] + replicaGradient[e];
+                        }
+                    }
+                    else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+                    {
+                        // the replicas live on other gpus, read through peer access
+                        elementwiseAddCUDAKernel<DataType>(gradient, chunk.m_gradients[i] + chunk.m_begin, 1.0, gradient, size);
+                    }
+                }
+            }
+        }
+
+    private:
+        // the additions happen in the same order as above, only on this device's replica
+        void evaluateStaged(const Chunk &chunk)
+        {
+            DataType *gradient = chunk.m_gradients[m_deviceId] + chunk.m_begin;
+            unsigned int size = chunk.m_end - chunk.m_begin;
+            size_t sizeInByte = size * sizeof(DataType);
+
+            if (m_deviceId != 0)
+            {
+                RUN_CUDA(cudaMemcpyAsync(m_ownChunk, gradient, sizeInByte, cudaMemcpyDeviceToDevice, computeStream()));
+                RUN_CUDA(cudaMemcpyPeerAsync(gradient, m_deviceId, chunk.m_gradients[0] + chunk.m_begin, 0, sizeInByte, computeStream()));
+            }
+
+            for (unsigned int i = 1; i < chunk.m_gradients.size(); ++i)
+            {
+                DataType *addend = m_ownChunk;
+
+                if (i != m_deviceId)
+                {
+                    RUN_CUDA(cudaMemcpyPeerAsync(m_peerChunk, m_deviceId, chunk.m_gradients[i] + chunk.m_begin, i, sizeInByte, computeStream()));
+                    addend = m_peerChunk;
+                }
+
+                elementwiseAddCUDAKernel<DataType>(gradient, addend, 1.0, gradient, size);
+            }
+        }
+    };
+
+    // The second half of a staged merge: copies this device's merged chunks into every other
+    // replica, so that each device ends up with the whole merged gradient in its own memory.
+    // Merging per NUMA node it copies the merged chunks into the first replica of each node.
+    template<DeviceType DeviceUsed, typename DataType>
+    class GradientGatherStep : public Operator<DeviceUsed>
+    {
+    private:
+        using Operator<DeviceUsed>::m_deviceId;
+
+        struct Chunk
+        {
+            const DataType *m_mergedGradient;
+            // the chunks to copy it to and the devices they are on
+            std::vector<std::pair<DataType*, unsigned int>> m_targets;
+            unsigned int m_size;
+        };
+
+        std::vector<Chunk> m_chunks;
+
+    public:
+        GradientGatherStep(unsigned int deviceId)
+            :Operator<DeviceUsed>({}, {}, deviceId),
+              m_chunks()
+        {}
+
+        // mergedGradient is on this device
+        void addChunk(const DataType *mergedGradient, const std::vector<std::pair<DataType*, unsigned int>> &targets, unsigned int size)
+        {
+            m_chunks.push_back({mergedGradient, targets, size});
+        }
+
+        virtual bool init() override
+        {
+            return true;
+        }
+
+        virtual void evaluate() override
+        {
+            for (const Chunk &chunk : m_chunks)
+            {
+                for (const std::pair<DataType*, unsigned int> &target : chunk.m_targets)
+                {
+                    if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+                    {
+                        std::copy(chunk.m_mergedGradient, chunk.m_mergedGradient + chunk.m_size, target.first);
+                    }
+                    else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+                    {
+                        RUN_CUDA(cudaMemcpyPeerAsync(target.first, target.second, chunk.m_mergedGradient, m_deviceId,
+                                                     chunk.m_size * sizeof(DataType), computeStream()));
+                    }
+                }
+            }
+        }
+    };
+
+    // Queued on a replica's chain right after the last operator writing a gradient, tells the
+    // communication thread that this replica's part of the gradient is final.
+    template<DeviceType DeviceUsed>
+    class GradientReadySignal : public Operator<DeviceUsed>
+    {
+    private:
+        CompletionLatch *m_readyLatch;
+
+    public:
+        GradientReadySignal(CompletionLatch *readyLatch, unsigned int deviceId)
+            :Operator<DeviceUsed>({}, {}, deviceId),
+              m_readyLatch(readyLatch)
+        {}
+
+        virtual bool init() override
+        {
+            return true;
+        }
+
+        virtual void evaluate() override
+        {
+            m_readyLatch->countDown();
+        }
+    };
+
+    template<DeviceType DeviceUsed>
+    class GradientCheckStepBase : public Operator<DeviceUsed>
+    {
+    public:
+        GradientCheckStepBase(unsigned int deviceId)
+            :Operator<DeviceUsed>({}, {}, deviceId)
+        {}
+
+        virtual bool hasNonFinite() = 0;
+
+        virtual bool init() override
+        {
+            return true;
+        }
+    };
+
+    // Looks for an inf or a nan in this device's chunks of the merged gradient, for dynamic
+    // loss scaling.
+    template<DeviceType DeviceUsed, typename DataType>
+    class GradientCheckStep : public GradientCheckStepBase<DeviceUsed>
+    {
+    private:
+        using Operator<DeviceUsed>::m_deviceId;
+
+        struct Chunk
+        {
+            const DataType *m_gradient;
+            unsigned int m_size;
+        };
+
+        std::vector<Chunk> m_chunks;
+        bool m_hasNonFinite;
+        unsigned int *m_gpuHasNonFinite;
+
+    public:
+        GradientCheckStep(unsigned int deviceId)
+            :GradientCheckStepBase<DeviceUsed>(deviceId),
+              m_chunks(),
+              m_hasNonFinite(false),
+              m_gpuHasNonFinite(nullptr)
+        {
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                RUN_CUDA(cudaSetDevice(m_deviceId));
+                RUN_CUDA(cudaMalloc(&m_gpuHasNonFinite, sizeof(unsigned int)));
+            }
+        }
+
+        ~GradientCheckStep()
+        {
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                RUN_CUDA(cudaFree(m_gpuHasNonFinite));
+            }
+        }
+
+        void addChunk(const DataType *gradient, unsigned int size)
+        {
+            m_chunks.push_back({gradient, size});
+        }
+
+        virtual void evaluate() override
+        {
+            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+            {
+                m_hasNonFinite = false;
+
+                for (const Chunk &chunk : m_chunks)
+                {
+                    if (hasNonFiniteCPU<DataType>(chunk.m_gradient, chunk.m_size))
+                    {
+                        m_hasNonFinite = true;
+                        return;
+                    }
+                }
+            }
+            else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                RUN_CUDA(cudaMemset(m_gpuHasNonFinite, 0, sizeof(unsigned int)));
+
+                for (const Chunk &chunk : m_chunks)
+                {
+                    nonFiniteCheckCUDAKernel<DataType>(chunk.m_gradient, chunk.m_size, m_gpuHasNonFinite);
+                }
+            }
+        }
+
+        // after the wave has finished
+        virtual bool hasNonFinite() override
+        {
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                unsigned int hasNonFinite = 0;
+                RUN_CUDA(cudaSetDevice(m_deviceId));
+                RUN_CUDA(cudaMemcpy(&hasNonFinite, m_gpuHasNonFinite, sizeof(unsigned int), cudaMemcpyDeviceToHost));
+                m_hasNonFinite = hasNonFinite != 0;
+            }
+
+            return m_hasNonFinite;
+        }
+    };
+
+    template<DeviceType DeviceUsed>
+    class InterNodeReduceStepBase
+    {
+    public:
+        virtual ~InterNodeReduceStepBase()
+        {}
+
+        virtual bool run() = 0;
+    };
+
+    // Sums the merged gradient of this host over the hosts of a distributed run (Communicator),
+    // after the gradient has been merged over the local devices. The chunks are those of the
+    // check steps, on gpu they are downloaded, packed into one host buffer in compute precision
+    // for a single allReduce and uploaded again.
+    template<DeviceType DeviceUsed, typename DataType>
+    class InterNodeReduceStep : public InterNodeReduceStepBase<DeviceUsed>
+    {
+    private:
+        typedef typename ComputeType<DataType>::Type Compute;
+
+        struct Chunk
+        {
+            DataType *m_gradient;
+            unsigned int m_size;
+            unsigned int m_deviceId;
+        };
+
+        std::vector<Chunk> m_chunks;
+        GradientCompression m_compression;
+        std::vector<Compute> m_buffer;
+        // what top-k hasn't sent yet, see GradientCompression
+        std::vector<Compute> m_residual;
+        std::vector<DataType> m_staging;
+
+    public:
+        InterNodeReduceStep(const GradientCompression &compression)
+            :m_chunks(),
+              m_compression(compression),
+              m_buffer(),
+              m_residual(),
+              m_staging()
+        {}
+
+        void addChunk(DataType *gradient, unsigned int size, unsigned int deviceId)
+        {
+            m_chunks.push_back({gradient, size, deviceId});
+            m_buffer.resize(m_buffer.size() + size);
+            m_staging.resize(std::max((size_t) size, m_staging.size()));
+
+            if (m_compression.m_type == GradientCompressionType::TOP_K)
+            {
+                m_residual.resize(m_buffer.size(), (Compute) 0);
+            }
+        }
+
+        // on the calling thread, after the local merge has finished
+        virtual bool run() override
+        {
+            size_t offset = 0;
+
+            for (const Chunk &chunk : m_chunks)
+            {
+                const DataType *gradient = chunk.m_gradient;
+
+                if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+                {
+                    RUN_CUDA(cudaSetDevice(chunk.m_deviceId));
+                    RUN_CUDA(cudaMemcpy(m_staging.data(), chunk.m_gradient, chunk.m_size * sizeof(DataType), cudaMemcpyDeviceToHost));
+                    gradient = m_staging.data();
+                }
+
+                std::copy(gradient, gradient + chunk.m_size, m_buffer.begin() + offset);
+                offset += chunk.m_size;
+            }
+
+            if (!Communicator::getSingleton().allReduce(m_buffer.data(), m_buffer.size(), m_compression,
+                                                        m_residual.empty() ? nullptr : m_residual.data()))
+            {
+                return false;
+            }
+
+            offset = 0;
+
+            for (const Chunk &chunk : m_chunks)
+            {
+                DataType *gradient = chunk.m_gradient;
+
+                if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+                {
+                    gradient = m_staging.data();
+                }
+
+                std::copy(m_buffer.begin() + offset, m_buffer.begin() + offset + chunk.m_size, gradient);
+                offset += chunk.m_size;
+
+                if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+                {
+                    RUN_CUDA(cudaSetDevice(chunk.m_deviceId));
+                    RUN_CUDA(cudaMemcpy(chunk.m_gradient, m_staging.data(), chunk.m_size * sizeof(DataType), cudaMemcpyHostToDevice));
+                }
+            }
+
+            return true;
+        }
+    };
+
+    template<DeviceType DeviceUsed>
+    class OptimizerStepBase : public Operator<DeviceUsed>
+    {
+    protected:
+        OptimizerParameters m_parameters;
+        double m_rate;
+        unsigned int m_step;
+        double m_gradientScale;
+
+    public:
+        OptimizerStepBase(const OptimizerParameters &parameters, unsigned int deviceId)
+            :Operator<DeviceUsed>({}, {}, deviceId),
+              m_parameters(parameters),
+              m_rate(0.0),
+              m_step(0),
+              m_gradientScale(1.0)
+        {}
+
+        void setStep(double rate, unsigned int step, double gradientScale)
+        {
+            m_rate = rate;
+            m_step = step;
+            m_gradientScale = gradientScale;
+        }
+
+        virtual bool init() override
+        {
+            return true;
+        }
+    };
+
+    // Applies the merged gradient of the first replica to this device's replica of every
+    // weight with one fused pass per weight. 16-bit weights are updated through their master
+    // copy, m_weight, and m_storageWeight gets the rounded result.
+    template<DeviceType DeviceUsed, typename DataType>
+    class OptimizerStep : public OptimizerStepBase<DeviceUsed>
+    {
+    private:
+        using OptimizerStepBase<DeviceUsed>::m_parameters;
+        using OptimizerStepBase<DeviceUsed>::m_rate;
+        using OptimizerStepBase<DeviceUsed>::m_step;
+        using OptimizerStepBase<DeviceUsed>::m_gradientScale;
+
+        typedef typename ComputeType<DataType>::Type Compute;
+
+        struct Update
+        {
+            Compute *m_weight;
+            const DataType *m_gradient;
+            Compute *m_firstState;
+            Compute *m_secondState;
+            DataType *m_storageWeight;
+            unsigned int m_size;
+        };
+
+        std::vector<Update> m_updates;
+
+        void step(const OptimizerStepCoefficients<Compute> &coefficients, const Update &update, unsigned int offset, unsigned int size)
+        {
+            auto at = [offset](auto *pointer)
+            {
+                return pointer ? pointer + offset : pointer;
+            };
+
+            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+            {
+                optimizerStepCPU<Compute, DataType>(m_parameters.m_type, coefficients, at(update.m_weight), at(update.m_gradient),
+                                                    at(update.m_firstState), at(update.m_secondState), at(update.m_storageWeight), size);
+            }
+            else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                optimizerStepCUDAKernel<Compute, DataType>(m_parameters.m_type, coefficients, at(update.m_weight), at(update.m_gradient),
+                                                           at(update.m_firstState), at(update.m_secondState), at(update.m_storageWeight), size);
+            }
+        }
+
+        // every weight in m_modelRates.size() parts, a pass per part at its model's rate
+        void evaluateModels()
+        {
+            unsigned int modelCount = m_parameters.m_modelRates.size();
+
+            for (unsigned int k = 0; k < modelCount; ++k)
+            {
+                OptimizerStepCoefficients<Compute> coefficients = optimizerStepCoefficients<Compute>(m_parameters, m_rate * m_parameters.m_modelRates[k],
+                                                                                                     m_step, m_gradientScale);
+
+                for (const Update &update : m_updates)
+                {
+                    unsigned int size = update.m_size / modelCount;
+
+                    step(coefficients, update, k * size, size);
+                }
+            }
+        }
+
+    public:
+        OptimizerStep(const OptimizerParameters &parameters, unsigned int deviceId)
+            :OptimizerStepBase<DeviceUsed>(parameters, deviceId),
+              m_updates()
+        {}
+
+        void addUpdate(Compute *weight, const DataType *gradient, Compute *firstState, Compute *secondState, DataType *storageWeight, unsigned int size)
+        {
+            m_updates.push_back({weight, gradient, firstState, secondState, storageWeight, size});
+        }
+
+        virtual void evaluate() override
+        {
+            if (!m_parameters.m_modelRates.empty())
+            {
+                evaluateModels();
+                return;
+            }
+
+            OptimizerStepCoefficients<Compute> coefficients = optimizerStepCoefficients<Compute>(m_parameters, m_rate, m_step, m_gradientScale);
+
+            for (const Update &update : m_updates)
+            {
+                step(coefficients, update, 0, update.m_size);
+            }
+        }
+    };
+
+    // How the cpu replicas train without merging their gradients, see Solver::m_asynchronousUpdate.
+    //
+    // With m_maxStaleness 0 (Hogwild) the replicas share one copy of every weight and of its
+    // optimizer state, and every replica applies its own gradient to it, lock-free and racing
+    // the others. With m_maxStaleness n every replica applies its own gradient to its own copy,
+    // and every n steps the copies are reconciled: each element becomes its value at the last
+    // reconciliation plus what every replica has added since. A replica then misses at most n
+    // steps of the others. The optimizer state stays per replica.
+    struct AsynchronousUpdate
+    {
+        bool m_isEnabled = false;
+        unsigned int m_maxStaleness = 0;
+    };
+
+    template<DeviceType DeviceUsed>
+    class WeightSyncStepBase : public Operator<DeviceUsed>
+    {
+    protected:
+        // takes the copy of the first replica instead of reconciling
+        bool m_isAnchoring;
+
+    public:
+        WeightSyncStepBase(unsigned int deviceId)
+            :Operator<DeviceUsed>({}, {}, deviceId),
+              m_isAnchoring(false)
+        {}
+
+        void setAnchoring(bool isAnchoring)
+        {
+            m_isAnchoring = isAnchoring;
+        }
+
+        virtual bool init() override
+        {
+            return true;
+        }
+    };
+
+    // Reconciles this device's chunk of every weight over the replicas of a stale synchronous
+    // update: anchor + the sum of (replica - anchor) goes into the anchor and every replica.
+    template<DeviceType DeviceUsed, typename DataType>
+    class WeightSyncStep : public WeightSyncStepBase<DeviceUsed>
+    {
+    private:
+        using WeightSyncStepBase<DeviceUsed>::m_isAnchoring;
+
+        struct Chunk
+        {
+            std::vector<DataType*> m_replicas;
+            size_t m_anchorOffset;
+            unsigned int m_size;
+        };
+
+        std::vector<Chunk> m_chunks;
+        // the weights at the last reconciliation, the chunks one after the other
+        std::vector<DataType> m_anchors;
+
+    public:
+        WeightSyncStep(unsigned int deviceId)
+            :WeightSyncStepBase<DeviceUsed>(deviceId),
+              m_chunks(),
+              m_anchors()
+        {}
+
+        void addChunk(const std::vector<DataType*> &replicas, unsigned int size)
+        {
+            m_chunks.push_back({replicas, m_anchors.size(), size});
+            m_anchors.resize(m_anchors.size() + size);
+        }
+
+        virtual void evaluate() override
+        {
+            for (const Chunk &chunk : m_chunks)
+            {
+                DataType *anchor = m_anchors.data() + chunk.m_anchorOffset;
+
+                if (m_isAnchoring)
+                {
+                    std::copy(chunk.m_replicas[0], chunk.m_replicas[0] + chunk.m_size, anchor);
+                    continue;
+                }
+
+                for (unsigned int i = 0; i < chunk.m_size; ++i)
+                {
+                    DataType value = anchor[i];
+
+                    for (DataType *replica : chunk.m_replicas)
+                    {
+                        value += replica[i] - anchor[i];
+                    }
+
+                    anchor[i] = value;
+
+                    for (DataType *replica : chunk.m_replicas)
+                    {
+                        replica[i] = value;
+                    }
+                }
+            }
+        }
+    };
+
+    // Replaces the serial merge, update and broadcast of Solver::update. Every gradient is split
+    // into one chunk per device. In the first wave each device sums its chunks over all
+    // replicas, reading the other replicas directly (shared memory on CPU, peer access on GPU),
+    // so the work and memory traffic are spread over all devices. In the second wave every
+    // device runs the optimizer on its own replica with the merged gradient, so the replicas
+    // stay identical without broadcasting the weights.
+    //
+    // GPUs without peer access can't read each other's chunks. There the first wave merges
+    // staged copies into each device's own replica (a reduce-scatter) and an extra wave copies
+    // the merged chunks to all replicas (an all-gather) before every device updates its weights
+    // from its own memory. The waves on GPU are separated with Context::joinDevices, the host
+    // doesn't wait for any of them.
+    //
+    // On CPU the merge can instead overlap the backward pass (enableOverlap). Every gradient is
+    // then one bucket with a ready latch that the replicas count down from their chains once
+    // they have written the gradient for the last time. A communication thread sums each bucket
+    // as soon as it is ready, in the order the backward pass finishes them, so only the
+    // gradients written last are still left to merge when the backward chains are done.
+    //
+    // The per element order of additions is the same as the serial merge, so SGD results are
+    // bit identical to it.
+    //
+    // CPU devices on several NUMA nodes (see CPUTopology) merge hierarchically instead, so that
+    // little of the traffic crosses the sockets. A first wave sums the replicas of every node
+    // into the node's first replica, reading only the node's own memory. The second sums those
+    // over the nodes into the first replica and a gather wave copies the merged chunks back to
+    // the first replica of each node, which the devices of the node update from. The
+    // additions are grouped by node then, the sum differs from the serial one in rounding.
+    //
+    // With loss scaling an extra wave between the two checks the merged gradient for infs and
+    // nans, and the step is skipped when there are any.
+    //
+    // Built with buildAsynchronous there is no merge: the only wave is every cpu replica's
+    // optimizer step with its own gradient, followed every m_maxStaleness steps by a wave
+    // reconciling the replicas' weights (see AsynchronousUpdate).
+    //
+    // In a distributed run (Communicator::open) the reduction is hierarchical: the devices of
+    // each host merge first, then the merged gradient is summed over the hosts
+    // (InterNodeReduceStep) before the check and the optimizer, so every host takes the same step.
+    template<DeviceType DeviceUsed>
+    class GradientAllReduce
+    {
+    private:
+        // chunk boundaries on cache lines so neighbouring chunks do not share one
+        static const unsigned int CHUNK_ALIGNMENT = 64;
+
+        struct Bucket
+        {
+            std::string m_gradientName;
+            CompletionLatch *m_readyLatch;
+            Operator<DeviceUsed> *m_reduceStep;
+            std::vector<Operator<DeviceUsed>*> m_readySignals;
+        };
+
+        std::vector<Operator<DeviceUsed>*> m_nodeReduceSteps;
+        std::vector<Operator<DeviceUsed>*> m_reduceSteps;
+        std::vector<Operator<DeviceUsed>*> m_gatherSteps;
+        std::vector<OptimizerStepBase<DeviceUsed>*> m_optimizerSteps;
+        std::vector<GradientCheckStepBase<DeviceUsed>*> m_checkSteps;
+        std::vector<WeightSyncStepBase<DeviceUsed>*> m_syncSteps;
+        InterNodeReduceStepBase<DeviceUsed> *m_interNodeReduceStep;
+        GradientCompression m_compression;
+        std::vector<WorkerMessage*> m_messages;
+        CompletionLatch m_completionLatch;
+        unsigned int m_step;
+        AsynchronousUpdate m_asynchronousUpdate;
+        // whether the sync steps hold the weights the replicas started from
+        bool m_isAnchored;
+
+        std::vector<Bucket> m_buckets;
+        std::thread m_communicationThread;
+        std::mutex m_communicationMutex;
+        std::condition_variable m_communicationCondition;
+        bool m_isReducing;
+        bool m_isReduceStarted;
+        bool m_isTerminating;
+
+        template<typename DataType>
+        static DataType *dataHandle(TensorDescriptor *tensorDescriptor, unsigned int replica)
+        {
+            if (!tensorDescriptor)
+            {
+                return nullptr;
+            }
+
+            TensorBase<DeviceUsed> *tensor = tensorDescriptor->template getTensorForDevice<DeviceUsed>(replica);
+
+            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+            {
+                return (DataType*) tensor->cpuDataHandle();
+            }
+            else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                return (DataType*) tensor->gpuDataHandle();
+            }
+        }
+
+        template<typename DataType>
+        void addSteps(const std::vector<ParameterUpdate> &parameterUpdates, const OptimizerParameters &optimizerParameters, unsigned int deviceCount)
+        {
+            const unsigned int alignment = std::max(1u, CHUNK_ALIGNMENT / (unsigned int) sizeof(DataType));
+
+            std::vector<GradientReduceStep<DeviceUsed, DataType>*> nodeReduceSteps;
+            std::vector<GradientReduceStep<DeviceUsed, DataType>*> reduceSteps;
+            std::vector<GradientGatherStep<DeviceUsed, DataType>*> gatherSteps;
+            std::vector<OptimizerStep<DeviceUsed, DataType>*> optimizerSteps;
+            std::vector<GradientCheckStep<DeviceUsed, DataType>*> checkSteps;
+            InterNodeReduceStep<DeviceUsed, DataType> *interNodeReduceStep = nullptr;
+
+            typedef typename ComputeType<DataType>::Type Compute;
+
+            bool isStaged = false;
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                isStaged = deviceCount > 1 && !Context<DeviceUsed>::getSingleton().hasPeerAccess();
+            }
+
+            // the devices of each NUMA node, the first one leads it. Consecutive devices share
+            // a node, so node 0 is led by device 0.
+            std::vector<std::vector<unsigned int>> nodes;
+            std::vector<unsigned int> leaders(deviceCount, 0);
+            for (unsigned int d = 0; d < deviceCount; ++d)
+            {
+                if (d == 0 || Context<DeviceUsed>::getSingleton().numaNode(d) != Context<DeviceUsed>::getSingleton().numaNode(d - 1))
+                {
+                    nodes.push_back({});
+                }
+
+                nodes.back().push_back(d);
+                leaders[d] = nodes.back().front();
+            }
+
+            bool isHierarchical = nodes.size() > 1 && nodes.size() < deviceCount;
+
+            if (Communicator::getSingleton().isOpen())
+            {
+                interNodeReduceStep = new InterNodeReduceStep<DeviceUsed, DataType>(m_compression);
+                m_interNodeReduceStep = interNodeReduceStep;
+            }
+
+            for (unsigned int d = 0; d < deviceCount; ++d)
+            {
+                if (isHierarchical)
+                {
+                    nodeReduceSteps.push_back(new GradientReduceStep<DeviceUsed, DataType>(d));
+                    m_nodeReduceSteps.push_back(nodeReduceSteps.back());
+                }
+                reduceSteps.push_back(new GradientReduceStep<DeviceUsed, DataType>(d, isStaged));
+                if (isStaged || isHierarchical)
+                {
+                    gatherSteps.push_back(new GradientGatherStep<DeviceUsed, DataType>(d));
+                    m_gatherSteps.push_back(gatherSteps.back());
+                }
+                optimizerSteps.push_back(new OptimizerStep<DeviceUsed, DataType>(optimizerParameters, d));
+                checkSteps.push_back(new GradientCheckStep<DeviceUsed, DataType>(d));
+                m_reduceSteps.push_back(reduceSteps.back());
+                m_optimizerSteps.push_back(optimizerSteps.back());
+                m_checkSteps.push_back(checkSteps.back());
+            }
+
+            for (const ParameterUpdate &parameterUpdate : parameterUpdates)
+            {
+                unsigned int size = parameterUpdate.m_weight->template getTensorForDevice<DeviceUsed>(0)->shape().size();
+
+                // the replica's update on device d with the merged gradient
+                auto addUpdate = [&](unsigned int d, unsigned int replica, DataType *mergedGradient)
+                {
+                    Compute *firstState = dataHandle<Compute>(parameterUpdate.m_optimizerState[0], replica);
+                    Compute *secondState = dataHandle<Compute>(parameterUpdate.m_optimizerState[1], replica);
+
+                    if constexpr (IsReducedPrecision<DataType>::value)
+                    {
+                        optimizerSteps[d]->addUpdate(dataHandle<Compute>(parameterUpdate.m_masterWeight, replica), mergedGradient, firstState, secondState,
+                                                     dataHandle<DataType>(parameterUpdate.m_weight, replica), size);
+                    }
+                    else
+                    {
+                        optimizerSteps[d]->addUpdate(dataHandle<DataType>(parameterUpdate.m_weight, replica), mergedGradient, firstState, secondState,
+                                                     nullptr, size);
+                    }
+                };
+
+                // a weight of a pipelined model only lives on the device of its stage, there is
+                // nothing to merge
+                if (!parameterUpdate.m_weight->m_deviceIds.empty())
+                {
+                    unsigned int d = parameterUpdate.m_weight->deviceId(0);
+                    DataType *gradient = dataHandle<DataType>(parameterUpdate.m_gradient, 0);
+
+                    checkSteps[d]->addChunk(gradient, size);
+                    if (interNodeReduceStep)
+                    {
+                        interNodeReduceStep->addChunk(gradient, size, d);
+                    }
+                    addUpdate(d, 0, gradient);
+                    continue;
+                }
+
+                std::vector<DataType*> gradients;
+                for (unsigned int d = 0; d < deviceCount; ++d)
+                {
+                    gradients.push_back(dataHandle<DataType>(parameterUpdate.m_gradient, d));
+                }
+
+                if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+                {
+                    if (deviceCount > 1)
+                    {
+                        GradientReduceStep<DeviceUsed, DataType> *bucketReduceStep = new GradientReduceStep<DeviceUsed, DataType>(0);
+                        bucketReduceStep->addChunk(gradients, 0, size);
+
+                        Bucket bucket = {parameterUpdate.m_gradient->m_name, new CompletionLatch(), bucketReduceStep, {}};
+                        for (unsigned int d = 0; d < deviceCount; ++d)
+                        {
+                            bucket.m_readySignals.push_back(new GradientReadySignal<DeviceUsed>(bucket.m_readyLatch, d));
+                        }
+
+                        m_buckets.push_back(bucket);
+                    }
+                }
+
+                unsigned int chunkSize = ((size + deviceCount - 1) / deviceCount + alignment - 1) / alignment * alignment;
+
+                std::vector<DataType*> leaderGradients;
+                for (const std::vector<unsigned int> &node : nodes)
+                {
+                    leaderGradients.push_back(gradients[node.front()]);
+                }
+
+                for (unsigned int d = 0; d < deviceCount; ++d)
+                {
+                    unsigned int begin = std::min(size, d * chunkSize);
+                    unsigned int end = std::min(size, begin + chunkSize);
+
+                    // staged, the merged gradient is first complete in every replica
+                    DataType *mergedGradient = isStaged ? gradients[d] : gradients[0];
+
+                    if (begin < end)
+                    {
+                        if (isHierarchical)
+                        {
+                            // every node sums its replicas of the chunk on one of its devices
+                            for (const std::vector<unsigned int> &node : nodes)
+                            {
+                                std::vector<DataType*> nodeGradients;
+                                for (unsigned int replica : node)
+                                {
+                                    nodeGradients.push_back(gradients[replica]);
+                                }
+
+                                nodeReduceSteps[node[d % node.size()]]->addChunk(nodeGradients, begin, end);
+                            }
+
+                            reduceSteps[d]->addChunk(leaderGradients, begin, end);
+                        }
+                        else
+                        {
+                            reduceSteps[d]->addChunk(gradients, begin, end);
+                        }
+
+                        checkSteps[d]->addChunk(mergedGradient + begin, end - begin);
+                        if (interNodeReduceStep)
+                        {
+                            interNodeReduceStep->addChunk(mergedGradient + begin, end - begin, isStaged ? d : 0);
+                        }
+
+                        std::vector<std::pair<DataType*, unsigned int>> targets;
+                        for (unsigned int i = 0; i < deviceCount; ++i)
+                        {
+                            if ((isStaged && i != d) || (isHierarchical && i != 0 && leaders[i] == i))
+                            {
+                                targets.push_back({gradients[i] + begin, i});
+                            }
+                        }
+
+                        if (!targets.empty())
+                        {
+                            gatherSteps[d]->addChunk(mergedGradient + begin, targets, end - begin);
+                        }
+                    }
+
+                    // merged per node, each device updates from its node's copy
+                    addUpdate(d, d, isHierarchical ? gradients[leaders[d]] : mergedGradient);
+                }
+            }
+
+            for (GradientReduceStep<DeviceUsed, DataType> *reduceStep : reduceSteps)
+            {
+                reduceStep->init();
+            }
+        }
+
+        template<typename DataType>
+        void addAsynchronousSteps(const std::vector<ParameterUpdate> &parameterUpdates, const OptimizerParameters &optimizerParameters, unsigned int deviceCount)
+        {
+            const unsigned int alignment = std::max(1u, CHUNK_ALIGNMENT / (unsigned int) sizeof(DataType));
+
+            std::vector<OptimizerStep<DeviceUsed, DataType>*> optimizerSteps;
+            std::vector<WeightSyncStep<DeviceUsed, DataType>*> syncSteps;
+
+            for (unsigned int d = 0; d < deviceCount; ++d)
+            {
+                optimizerSteps.push_back(new OptimizerStep<DeviceUsed, DataType>(optimizerParameters, d));
+                m_optimizerSteps.push_back(optimizerSteps.back());
+
+                if (m_asynchronousUpdate.m_maxStaleness > 0)
+                {
+                    syncSteps.push_back(new WeightSyncStep<DeviceUsed, DataType>(d));
+                    m_syncSteps.push_back(syncSteps.back());
+                }
+            }
+
+            for (const ParameterUpdate &parameterUpdate : parameterUpdates)
+            {
+                unsigned int size = parameterUpdate.m_weight->template getTensorForDevice<DeviceUsed>(0)->shape().size();
+
+                // every replica with its own gradient, shared weights are the same memory on all
+                for (unsigned int d = 0; d < deviceCount; ++d)
+                {
+                    optimizerSteps[d]->addUpdate(dataHandle<DataType>(parameterUpdate.m_weight, d), dataHandle<DataType>(parameterUpdate.m_gradient, d),
+                                                 dataHandle<DataType>(parameterUpdate.m_optimizerState[0], d),
+                                                 dataHandle<DataType>(parameterUpdate.m_optimizerState[1], d), nullptr, size);
+                }
+
+                if (syncSteps.empty())
+                {
+                    continue;
+                }
+
+                unsigned int chunkSize = ((size + deviceCount - 1) / deviceCount + alignment - 1) / alignment * alignment;
+
+                for (unsigned int d = 0; d < deviceCount; ++d)
+                {
+                    unsigned int begin = std::min(size, d * chunkSize);
+                    unsigned int end = std::min(size, begin + chunkSize);
+
+                    if (begin == end)
+                    {
+                        continue;
+                    }
+
+                    std::vector<DataType*> replicas;
+                    for (unsigned int r = 0; r < deviceCount; ++r)
+                    {
+                        replicas.push_back(dataHandle<DataType>(parameterUpdate.m_weight, r) + begin);
+                    }
+
+                    syncSteps[d]->addChunk(replicas, end - begin);
+                }
+            }
+        }
+
+        template<typename StepType>
+        void runWave(const std::vector<StepType*> &steps)
+        {
+            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+            {
+                m_completionLatch.reset(steps.size());
+
+                for (unsigned int d = 0; d < steps.size(); ++d)
+                {
+                    m_messages[d]->reset(WorkerMessage::Type::UPDATE, steps[d], &m_completionLatch);
+                    Context<DeviceUsed>::getSingleton().pushWork(d, m_messages[d]);
+                }
+
+                m_completionLatch.wait();
+            }
+            else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                // launches are asynchronous, so the devices work through their steps concurrently
+                for (unsigned int d = 0; d < steps.size(); ++d)
+                {
+                    RUN_CUDA(cudaSetDevice(d));
+                    steps[d]->evaluate();
+                }
+
+                Context<DeviceUsed>::getSingleton().joinDevices();
+            }
+        }
+
+        void runSyncWave(bool isAnchoring)
+        {
+            for (WeightSyncStepBase<DeviceUsed> *syncStep : m_syncSteps)
+            {
+                syncStep->setAnchoring(isAnchoring);
+            }
+
+            runWave(m_syncSteps);
+        }
+
+        void communicationLoop()
+        {
+            std::unique_lock<std::mutex> lock(m_communicationMutex);
+
+            while (true)
+            {
+                m_communicationCondition.wait(lock, [this]{return m_isReducing || m_isTerminating;});
+
+                if (m_isTerminating)
+                {
+                    return;
+                }
+
+                lock.unlock();
+
+                for (Bucket &bucket : m_buckets)
+                {
+                    bucket.m_readyLatch->wait();
+                    bucket.m_reduceStep->evaluate();
+                }
+
+                lock.lock();
+                m_isReducing = false;
+                m_communicationCondition.notify_all();
+            }
+        }
+
+    public:
+        GradientAllReduce()
+            :m_nodeReduceSteps(),
+              m_reduceSteps(),
+              m_gatherSteps(),
+              m_optimizerSteps(),
+              m_checkSteps(),
+              m_syncSteps(),
+              m_interNodeReduceStep(nullptr),
+              m_compression(),
+              m_messages(),
+              m_completionLatch(),
+              m_step(0),
+              m_asynchronousUpdate(),
+              m_isAnchored(false),
+              m_buckets(),
+              m_communicationThread(),
+              m_communicationMutex(),
+              m_communicationCondition(),
+              m_isReducing(false),
+              m_isReduceStarted(false),
+              m_isTerminating(false)
+        {}
+
+        GradientAllReduce(const GradientAllReduce &) = delete;
+        void operator=(const GradientAllReduce &) = delete;
+
+        ~GradientAllReduce()
+        {
+            clear();
+        }
+
+        void clear()
+        {
+            if (m_communicationThread.joinable())
+            {
+                finishReduce();
+
+                {
+                    std::unique_lock<std::mutex> lock(m_communicationMutex);
+                    m_isTerminating = true;
+                    m_communicationCondition.notify_all();
+                }
+
+                m_communicationThread.join();
+                m_isTerminating = false;
+            }
+
+            for (Bucket &bucket : m_buckets)
+            {
+                delete bucket.m_reduceStep;
+                delete bucket.m_readyLatch;
+
+                for (Operator<DeviceUsed> *readySignal : bucket.m_readySignals)
+                {
+                    delete readySignal;
+                }
+            }
+
+            for (Operator<DeviceUsed> *nodeReduceStep : m_nodeReduceSteps)
+            {
+                delete nodeReduceStep;
+            }
+
+            for (Operator<DeviceUsed> *reduceStep : m_reduceSteps)
+            {
+                delete reduceStep;
+            }
+
+            for (OptimizerStepBase<DeviceUsed> *optimizerStep : m_optimizerSteps)
+            {
+                delete optimizerStep;
+            }
+
+            for (GradientCheckStepBase<DeviceUsed> *checkStep : m_checkSteps)
+            {
+                delete checkStep;
+            }
+
+            for (WeightSyncStepBase<DeviceUsed> *syncStep : m_syncSteps)
+            {
+                delete syncStep;
+            }
+
+            for (Operator<DeviceUsed> *gatherStep : m_gatherSteps)
+            {
+                delete gatherStep;
+            }
+
+            delete m_interNodeReduceStep;
+            m_interNodeReduceStep = nullptr;
+
+            for (unsigned int d = 0; d < m_messages.size(); ++d)
+            {
+                delete m_messages[d];
+            }
+
+            m_nodeReduceSteps.clear();
+            m_reduceSteps.clear();
+            m_gatherSteps.clear();
+            m_optimizerSteps.clear();
+            m_checkSteps.clear();
+            m_syncSteps.clear();
+            m_messages.clear();
+            m_buckets.clear();
+            m_isReduceStarted = false;
+            m_step = 0;
+            m_asynchronousUpdate = AsynchronousUpdate();
+            m_isAnchored = false;
+        }
+
+        bool isBuilt() const
+        {
+            return !m_optimizerSteps.empty();
+        }
+
+        // the updates applied so far, adam's bias correction depends on it
+        unsigned int step() const
+        {
+            return m_step;
+        }
+
+        // the replicas restored with a checkpoint are reconciled from there
+        void setStep(unsigned int step)
+        {
+            m_step = step;
+            m_isAnchored = false;
+        }
+
+        bool isOverlapping() const
+        {
+            return m_communicationThread.joinable();
+        }
+
+        // one step per device for every gradient, to be queued after its last write with
+        // GraphExecutor::build, empty when the merge can't overlap the backward pass
+        std::map<std::string, std::vector<Operator<DeviceUsed>*>> readySignals() const
+        {
+            std::map<std::string, std::vector<Operator<DeviceUsed>*>> signals;
+
+            for (const Bucket &bucket : m_buckets)
+            {
+                signals[bucket.m_gradientName] = bucket.m_readySignals;
+            }
+
+            return signals;
+        }
+
+        // the backward executor must have been built with readySignals()
+        bool enableOverlap(const GraphExecutor<DeviceUsed> &backwardExecutor)
+        {
+            if (m_buckets.empty() || isOverlapping())
+            {
+                return false;
+            }
+
+            std::stable_sort(m_buckets.begin(), m_buckets.end(), [&](const Bucket &a, const Bucket &b)
+            {
+                return backwardExecutor.lastWriter(a.m_gradientName) < backwardExecutor.lastWriter(b.m_gradientName);
+            });
+
+            m_communicationThread = std::thread(&GradientAllReduce::communicationLoop, this);
+
+            return true;
+        }
+
+        // call right before launching the backward pass, the buckets are merged as it runs
+        void startReduce()
+        {
+            if (!isOverlapping())
+            {
+                return;
+            }
+
+            finishReduce();
+
+            std::unique_lock<std::mutex> lock(m_communicationMutex);
+
+            for (Bucket &bucket : m_buckets)
+            {
+                bucket.m_readyLatch->reset(bucket.m_readySignals.size());
+            }
+
+            m_isReducing = true;
+            m_isReduceStarted = true;
+            m_communicationCondition.notify_all();
+        }
+
+        // waits for the buckets still being merged after the backward pass
+        void finishReduce()
+        {
+            std::unique_lock<std::mutex> lock(m_communicationMutex);
+            m_communicationCondition.wait(lock, [this]{return !m_isReducing;});
+        }
+
+        // the tensors must already be allocated, on every device or on the one their stage is placed on.
+        // compression applies to the sum over the hosts of a distributed run.
+        bool build(const std::vector<ParameterUpdate> &parameterUpdates, DataType dataType, const OptimizerParameters &optimizerParameters,
+                   const GradientCompression &compression = GradientCompression())
+        {
+            clear();
+
+            m_compression = compression;
+
+            unsigned int deviceCount = Context<DeviceUsed>::getSingleton().deviceCount();
+
+            if (deviceCount == 0 || parameterUpdates.empty())
+            {
+                return false;
+            }
+
+            for (const ParameterUpdate &parameterUpdate : parameterUpdates)
+            {
+                if ((dataType == DataType::HALF || dataType == DataType::BFLOAT16) && !parameterUpdate.m_masterWeight)
+                {
+                    return false;
+                }
+
+                // a placed weight (Model::placeOperators) has one replica, the rest stays with it
+                const std::vector<unsigned int> &deviceIds = parameterUpdate.m_weight->m_deviceIds;
+                unsigned int replicaCount = deviceIds.empty() ? deviceCount : 1;
+
+                for (TensorDescriptor *tensorDescriptor : {parameterUpdate.m_weight, parameterUpdate.m_gradient, parameterUpdate.m_optimizerState[0],
+                                                            parameterUpdate.m_optimizerState[1], parameterUpdate.m_masterWeight})
+                {
+                    if (tensorDescriptor && (tensorDescriptor->m_tensors[DeviceUsed].size() != replicaCount || tensorDescriptor->m_deviceIds != deviceIds))
+                    {
+                        return false;
+                    }
+                }
+
+                for (unsigned int i = 0; i < optimizerStateCount(optimizerParameters.m_type); ++i)
+                {
+                    if (!parameterUpdate.m_optimizerState[i])
+                    {
+                        return false;
+                    }
+                }
+            }
+
+            for (unsigned int d = 0; d < deviceCount; ++d)
+            {
+                m_messages.push_back(new WorkerMessage(WorkerMessage::Type::UPDATE, (Operator<DeviceUsed>*) nullptr));
+            }
+
+            switch (dataType)
+            {
+            case DataType::FLOAT:
+                addSteps<float>(parameterUpdates, optimizerParameters, deviceCount);
+                break;
+            case DataType::DOUBLE:
+                addSteps<double>(parameterUpdates, optimizerParameters, deviceCount);
+                break;
+            case DataType::HALF:
+                addSteps<Half>(parameterUpdates, optimizerParameters, deviceCount);
+                break;
+            case DataType::BFLOAT16:
+                addSteps<BFloat16>(parameterUpdates, optimizerParameters, deviceCount);
+                break;
+            default:
+                clear();
+                return false;
+            }
+
+            return true;
+        }
+
+        // Cpu only, instead of build(): every replica updates the weights with its own gradient,
+        // nothing is merged or broadcast, see AsynchronousUpdate. Float and double weights
+        // only, without master weights or a distributed run. For Hogwild every weight and its
+        // optimizer state must share one allocation over the replicas (see Model::allocateTensors).
+        bool buildAsynchronous(const std::vector<ParameterUpdate> &parameterUpdates, DataType dataType, const OptimizerParameters &optimizerParameters,
+                               const AsynchronousUpdate &asynchronousUpdate)
+        {
+            clear();
+
+            unsigned int deviceCount = Context<DeviceUsed>::getSingleton().deviceCount();
+
+            if (DeviceUsed != DeviceType::CPU_NAIVE || !asynchronousUpdate.m_isEnabled || deviceCount == 0 || parameterUpdates.empty() ||
+                    (dataType != DataType::FLOAT && dataType != DataType::DOUBLE) || Communicator::getSingleton().isOpen())
+            {
+                return false;
+            }
+
+            bool isShared = asynchronousUpdate.m_maxStaleness == 0;
+
+            for (const ParameterUpdate &parameterUpdate : parameterUpdates)
+            {
+                if (parameterUpdate.m_masterWeight || !parameterUpdate.m_weight->m_deviceIds.empty())
+                {
+                    return false;
+                }
+
+                for (TensorDescriptor *tensorDescriptor : {parameterUpdate.m_weight, parameterUpdate.m_gradient, parameterUpdate.m_optimizerState[0],
+                                                            parameterUpdate.m_optimizerState[1]})
+                {
+                    if (tensorDescriptor && tensorDescriptor->m_tensors[DeviceUsed].size() != deviceCount)
+                    {
+                        return false;
+                    }
+                }
+
+                for (unsigned int i = 0; i < optimizerStateCount(optimizerParameters.m_type); ++i)
+                {
+                    if (!parameterUpdate.m_optimizerState[i])
+                    {
+                        return false;
+                    }
+                }
+
+                for (unsigned int d = 1; d < deviceCount && isShared; ++d)
+                {
+                    for (TensorDescriptor *tensorDescriptor : {parameterUpdate.m_weight, parameterUpdate.m_optimizerState[0], parameterUpdate.m_optimizerState[1]})
+                    {
+                        if (tensorDescriptor && dataHandle<unsigned char>(tensorDescriptor, d) != dataHandle<unsigned char>(tensorDescriptor, 0))
+                        {
+                            return false;
+                        }
+                    }
+                }
+            }
+
+            m_asynchronousUpdate = asynchronousUpdate;
+
+            for (unsigned int d = 0; d < deviceCount; ++d)
+            {
+                m_messages.push_back(new WorkerMessage(WorkerMessage::Type::UPDATE, (Operator<DeviceUsed>*) nullptr));
+            }
+
+            if (dataType == DataType::FLOAT)
+            {
+                addAsynchronousSteps<float>(parameterUpdates, optimizerParameters, deviceCount);
+            }
+            else
+            {
+                addAsynchronousSteps<double>(parameterUpdates, optimizerParameters, deviceCount);
+            }
+
+            return true;
+        }
+
+        // the gradients are divided by lossScale. With skipOnOverflow a step whose merged
+        // gradient is not finite leaves the weights and the optimizer state alone, returns false
+        // and does not count.
+        bool run(double learningRate, double lossScale = 1.0, bool skipOnOverflow = false)
+        {
+            if (!isBuilt())
+            {
+                return false;
+            }
+
+            for (OptimizerStepBase<DeviceUsed> *optimizerStep : m_optimizerSteps)
+            {
+                optimizerStep->setStep(learningRate, m_step + 1, 1.0 / lossScale);
+            }
+
+            int currentDevice = 0;
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                RUN_CUDA(cudaGetDevice(&currentDevice));
+
+                // the backward pass of every replica has to be done before its gradient is read
+                Context<DeviceUsed>::getSingleton().joinDevices();
+            }
+
+            if (m_isReduceStarted)
+            {
+                finishReduce();
+                m_isReduceStarted = false;
+            }
+            else if (m_reduceSteps.size() > 1)
+            {
+                if (!m_nodeReduceSteps.empty())
+                {
+                    runWave(m_nodeReduceSteps);
+                }
+
+                runWave(m_reduceSteps);
+            }
+
+            // a host that lost the others can't take the step they take
+            if (m_interNodeReduceStep && !m_interNodeReduceStep->run())
+            {
+                if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+                {
+                    RUN_CUDA(cudaSetDevice(currentDevice));
+                }
+
+                return false;
+            }
+
+            bool hasNonFinite = false;
+
+            if (skipOnOverflow)
+            {
+                runWave(m_checkSteps);
+
+                for (GradientCheckStepBase<DeviceUsed> *checkStep : m_checkSteps)
+                {
+                    hasNonFinite = checkStep->hasNonFinite() || hasNonFinite;
+                }
+            }
+
+            if (!hasNonFinite)
+            {
+                ++m_step;
+
+                if (!m_gatherSteps.empty())
+                {
+                    runWave(m_gatherSteps);
+                }
+
+                if (!m_syncSteps.empty() && !m_isAnchored)
+                {
+                    runSyncWave(true);
+                    m_isAnchored = true;
+                }
+
+                runWave(m_optimizerSteps);
+
+                if (!m_syncSteps.empty() && m_step % m_asynchronousUpdate.m_maxStaleness == 0)
+                {
+                    runSyncWave(false);
+                }
+            }
+
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                RUN_CUDA(cudaSetDevice(currentDevice));
+            }
+
+            return !hasNonFinite;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,724 @@
+#ifndef GRAPHEXECUTOR_H
+#define GRAPHEXECUTOR_H
+
+#include "../DeviceSelection.h"
+#include "../Operator/Operator.h"
+#include "../Context/Context.h"
+#include "../Context/CompletionLatch.h"
+#include "../Context/WorkerMessage.h"
+#include "../Context/Profiler.h"
+#include "OperatorDescriptor.h"
+#include "TensorDescriptor.h"
+#include "MemoryPlanner.h"
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace FreeWill
+{
+    // Runs a forward or backward path without a barrier between operators. The dependency graph
+    // is built from the input and output handles of the path (read after write, write after read
+    // and write after write on the same tensor). Every device replica only touches its own
+    // tensors, so each replica gets the whole schedule as a chain on its own command queue and
+    // the device's FIFO order enforces the edges. The only synchronization is wait().
+    //
+    // On gpu the chains are issued from the calling thread instead, spread over the compute
+    // lanes of each device (Device::COMPUTE_LANE_COUNT). An operator continues the lane of a
+    // dependency when it can, otherwise it starts on the lane that has been idle the longest,
+    // so independent branches run concurrently. An edge between lanes becomes an event the
+    // later lane waits for. launch() returns once everything is queued, like an eager pass.
+    template<DeviceType DeviceUsed>
+    class GraphExecutor
+    {
+    private:
+        struct Node
+        {
+            OperatorDescriptor *m_operatorDescriptor;
+            std::vector<unsigned int> m_dependencies;
+            unsigned int m_level;
+        };
+
+        std::vector<Node> m_nodes;
+        std::vector<std::vector<Operator<DeviceUsed>*>> m_deviceChains;
+        std::vector<std::vector<WorkerMessage*>> m_messages;
+        std::map<std::string, unsigned int> m_lastWriters;
+        CompletionLatch m_completionLatch;
+        bool m_isRunning;
+        // per device and chain step while the Profiler is enabled, only the operator steps
+        // are recorded
+        std::vector<std::vector<ProfileRecord>> m_profileRecords;
+        bool m_isProfiling;
+
+        // the node every chain step belongs to, nodeCount() for the steps after the last node,
+        // and on gpu the lane of every node and the nodes on other lanes it waits for
+        std::vector<std::vector<unsigned int>> m_chainNodes;
+        std::vector<unsigned int> m_lanes;
+        std::vector<std::vector<unsigned int>> m_laneWaits;
+        std::vector<bool> m_isWaitedFor;
+        unsigned int m_laneCount;
+        // per device, recorded after each node another lane waits for, at the start of a pass
+        // for the lanes to wait for lane 0 and at the end of each lane for lane 0 to join
+        std::vector<std::vector<cudaEvent_t>> m_nodeEvents;
+        std::vector<cudaEvent_t> m_startEvents;
+        std::vector<std::vector<cudaEvent_t>> m_laneEndEvents;
+
+        static bool isSharingMemory(const OperatorDescriptor *a, const OperatorDescriptor *b, const MemoryPlanner &memoryPlan)
+        {
+            std::vector<const MemoryPlanner::TensorLifetime*> placements;
+
+            for (const std::map<std::string, TensorDescriptorHandle> *handles : {&a->m_inputs, &a->m_outputs})
+            {
+                for (auto iter = handles->begin(); iter != handles->end(); ++iter)
+                {
+                    if (memoryPlan.isPlanned(iter->second.name()))
+                    {
+                        placements.push_back(&memoryPlan.lifetime(iter->second.name()));
+                    }
+                }
+            }
+
+            for (const std::map<std::string, TensorDescriptorHandle> *handles : {&b->m_inputs, &b->m_outputs})
+            {
+                for (auto iter = handles->begin(); iter != handles->end(); ++iter)
+                {
+                    if (!memoryPlan.isPlanned(iter->second.name()))
+                    {
+                        continue;
+                    }
+
+                    const MemoryPlanner::TensorLifetime &lifetime = memoryPlan.lifetime(iter->second.name());
+
+                    for (const MemoryPlanner::TensorLifetime *placement : placements)
+                    {
+                        if (placement->m_name != lifetime.m_name && placement->m_offset < lifetime.m_offset + lifetime.m_sizeInByte &&
+                                lifetime.m_offset < placement->m_offset + placement->m_sizeInByte)
+                        {
+                            return true;
+                        }
+                    }
+                }
+            }
+
+            return false;
+        }
+
+        // With a memory plan, tensors of different names can share arena bytes, operators
+        // touching such tensors are ordered as if they shared the tensor.
+        void buildGraph(const std::vector<OperatorDescriptorHandle> &path, std::map<std::string, OperatorDescriptor*> &operators,
+                        const MemoryPlanner *memoryPlan)
+        {
+            std::map<std::string, unsigned int> lastWriter;
+            std::map<std::string, std::vector<unsigned int>> readersSinceWrite;
+
+            for (unsigned int i = 0; i < path.size(); ++i)
+            {
+                Node node;
+                node.m_operatorDescriptor = operators[path[i]];
+                node.m_level = 0;
+
+                auto addDependency = [&](unsigned int dependency)
+                {
+                    if (dependency != i && std::find(node.m_dependencies.begin(), node.m_dependencies.end(), dependency) == node.m_dependencies.end())
+                    {
+                        node.m_dependencies.push_back(dependency);
+                        node.m_level = std::max(node.m_level, m_nodes[dependency].m_level + 1);
+                    }
+                };
+
+                for (auto iter = node.m_operatorDescriptor->m_inputs.begin(); iter != node.m_operatorDescriptor->m_inputs.end(); ++iter)
+                {
+                    const std::string &tensorName = iter->second.name();
+                    if (lastWriter.find(tensorName) != lastWriter.end())
+                    {
+                        addDependency(lastWriter[tensorName]);
+                    }
+                    readersSinceWrite[tensorName].push_back(i);
+                }
+
+                for (auto iter = node.m_operatorDescriptor->m_outputs.begin(); iter != node.m_operatorDescriptor->m_outputs.end(); ++iter)
+                {
+                    const std::string &tensorName = iter->second.name();
+                    if (lastWriter.find(tensorName) != lastWriter.end())
+                    {
+                        addDependency(lastWriter[tensorName]);
+                    }
+                    for (unsigned int reader : readersSinceWrite[tensorName])
+                    {
+                        addDependency(reader);
+                    }
+                    lastWriter[tensorName] = i;
+                    readersSinceWrite[tensorName].clear();
+                }
+
+                for (unsigned int e = 0; memoryPlan && e < i; ++e)
+                {
+                    if (isSharingMemory(m_nodes[e].m_operatorDescriptor, node.m_operatorDescriptor, *memoryPlan))
+                    {
+                        addDependency(e);
+                    }
+                }
+
+                m_nodes.push_back(node);
+            }
+
+            // every edge points to an earlier node, so ordering by depth (then by path position)
+            // is a topological order that keeps independent operators next to each other
+            std::vector<unsigned int> order(m_nodes.size());
+            for (unsigned int i = 0; i < order.size(); ++i)
+            {
+                order[i] = i;
+            }
+            std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b){return m_nodes[a].m_level < m_nodes[b].m_level;});
+
+            std::vector<unsigned int> newIndex(m_nodes.size());
+            std::vector<Node> sortedNodes;
+            for (unsigned int i = 0; i < order.size(); ++i)
+            {
+                newIndex[order[i]] = i;
+                sortedNodes.push_back(m_nodes[order[i]]);
+            }
+            for (Node &node : sortedNodes)
+            {
+                for (unsigned int &dependency : node.m_dependencies)
+                {
+                    dependency = newIndex[dependency];
+                }
+            }
+            m_nodes.swap(sortedNodes);
+
+            for (unsigned int i = 0; i < m_nodes.size(); ++i)
+            {
+                for (auto iter = m_nodes[i].m_operatorDescriptor->m_outputs.begin(); iter != m_nodes[i].m_operatorDescriptor->m_outputs.end(); ++iter)
+                {
+                    m_lastWriters[iter->second.name()] = i;
+                }
+            }
+        }
+
+        void assignLanes()
+        {
+            const unsigned int laneCount = Device<DeviceType::GPU_CUDA>::COMPUTE_LANE_COUNT;
+            std::vector<int> lastNodeOfLane(laneCount, -1);
+
+            m_lanes.assign(m_nodes.size(), 0);
+            m_laneWaits.assign(m_nodes.size(), {});
+            m_isWaitedFor.assign(m_nodes.size(), false);
+            m_laneCount = 1;
+
+            for (unsigned int i = 0; i < m_nodes.size(); ++i)
+            {
+                const std::vector<unsigned int> &dependencies = m_nodes[i].m_dependencies;
+                int lane = -1;
+
+                for (unsigned int dependency : dependencies)
+                {
+                    if (lastNodeOfLane[m_lanes[dependency]] == (int) dependency)
+                    {
+                        lane = m_lanes[dependency];
+                        break;
+                    }
+                }
+
+                if (lane < 0)
+                {
+                    lane = std::min_element(lastNodeOfLane.begin(), lastNodeOfLane.end()) - lastNodeOfLane.begin();
+                }
+
+                // a lane runs in order, waiting for its latest dependency covers the others
+                std::vector<int> latestDependency(laneCount, -1);
+                for (unsigned int dependency : dependencies)
+                {
+                    if ((int) m_lanes[dependency] != lane)
+                    {
+                        latestDependency[m_lanes[dependency]] = std::max(latestDependency[m_lanes[dependency]], (int) dependency);
+                    }
+                }
+
+                for (unsigned int l = 0; l < laneCount; ++l)
+                {
+                    if (latestDependency[l] >= 0)
+                    {
+                        m_laneWaits[i].push_back(latestDependency[l]);
+                        m_isWaitedFor[latestDependency[l]] = true;
+                    }
+                }
+
+                m_lanes[i] = lane;
+                lastNodeOfLane[lane] = i;
+                m_laneCount = std::max(m_laneCount, (unsigned int) lane + 1);
+            }
+        }
+
+        void createEvents(unsigned int deviceCount)
+        {
+            m_nodeEvents.assign(deviceCount, std::vector<cudaEvent_t>(m_nodes.size(), nullptr));
+            m_startEvents.assign(deviceCount, nullptr);
+            m_laneEndEvents.assign(deviceCount, std::vector<cudaEvent_t>(m_laneCount, nullptr));
+
+            if (m_laneCount == 1)
+            {
+                return;
+            }
+
+            for (unsigned int d = 0; d < deviceCount; ++d)
+            {
+                RUN_CUDA(cudaSetDevice(d));
+
+                for (unsigned int i = 0; i < m_nodes.size(); ++i)
+                {
+                    if (m_isWaitedFor[i])
+                    {
+                        RUN_CUDA(cudaEventCreateWithFlags(&m_nodeEvents[d][i], cudaEventDisableTiming));
+                    }
+                }
+
+                RUN_CUDA(cudaEventCreateWithFlags(&m_startEvents[d], cudaEventDisableTiming));
+
+                for (unsigned int l = 1; l < m_laneCount; ++l)
+                {
+                    RUN_CUDA(cudaEventCreateWithFlags(&m_laneEndEvents[d][l], cudaEventDisableTiming));
+                }
+            }
+
+            RUN_CUDA(cudaSetDevice(0));
+        }
+
+        void destroyEvents()
+        {
+            for (unsigned int d = 0; d < m_startEvents.size(); ++d)
+            {
+                for (cudaEvent_t event : m_nodeEvents[d])
+                {
+                    if (event)
+                    {
+                        RUN_CUDA(cudaEventDestroy(event));
+                    }
+                }
+
+                for (cudaEvent_t event : m_laneEndEvents[d])
+                {
+                    if (event)
+                    {
+                        RUN_CUDA(cudaEventDestroy(event));
+                    }
+                }
+
+                if (m_startEvents[d])
+                {
+                    RUN_CUDA(cudaEventDestroy(m_startEvents[d]));
+                }
+            }
+
+            m_nodeEvents.clear();
+            m_startEvents.clear();
+            m_laneEndEvents.clear();
+        }
+
+        // whether chain step i of deviceId is the replica of its node's operator rather than a
+        // step queued after a write
+        bool isOperatorStep(unsigned int deviceId, unsigned int i) const
+        {
+            unsigned int node = m_chainNodes[deviceId][i];
+
+            return node < m_nodes.size() &&
+                    m_deviceChains[deviceId][i] == std::get<Operator<DeviceUsed>*>(m_nodes[node].m_operatorDescriptor->m_operators[DeviceUsed][deviceId]);
+        }
+
+        // issues node's work: its lane waits for the nodes it depends on elsewhere first
+        void enterNode(unsigned int deviceId, unsigned int node)
+        {
+            Context<DeviceType::GPU_CUDA> &context = Context<DeviceType::GPU_CUDA>::getSingleton();
+            cudaStream_t stream = context.computeStream(deviceId, m_lanes[node]);
+
+            for (unsigned int dependency : m_laneWaits[node])
+            {
+                RUN_CUDA(cudaStreamWaitEvent(stream, m_nodeEvents[deviceId][dependency], 0));
+            }
+
+            context.setComputeLane(deviceId, m_lanes[node]);
+        }
+
+        void leaveNode(unsigned int deviceId, unsigned int node)
+        {
+            if (m_isWaitedFor[node])
+            {
+                RUN_CUDA(cudaEventRecord(m_nodeEvents[deviceId][node],
+                                         Context<DeviceType::GPU_CUDA>::getSingleton().computeStream(deviceId, m_lanes[node])));
+            }
+        }
+
+        // lane 0 takes over what the other lanes did, so the work queued after the pass sees it
+        void joinLanes(unsigned int deviceId)
+        {
+            Context<DeviceType::GPU_CUDA> &context = Context<DeviceType::GPU_CUDA>::getSingleton();
+
+            for (unsigned int l = 1; l < m_laneCount; ++l)
+            {
+                RUN_CUDA(cudaEventRecord(m_laneEndEvents[deviceId][l], context.computeStream(deviceId, l)));
+                RUN_CUDA(cudaStreamWaitEvent(context.computeStream(deviceId, 0), m_laneEndEvents[deviceId][l], 0));
+            }
+
+            context.setComputeLane(deviceId, 0);
+        }
+
+        void launchGPU()
+        {
+            Context<DeviceType::GPU_CUDA> &context = Context<DeviceType::GPU_CUDA>::getSingleton();
+            Profiler &profiler = Profiler::getSingleton();
+            bool isProfiling = profiler.isEnabled();
+
+            for (unsigned int d = 0; d < m_deviceChains.size(); ++d)
+            {
+                RUN_CUDA(cudaSetDevice(d));
+
+                if (m_laneCount > 1)
+                {
+                    // the other lanes start after what lane 0 was given before, the uploads too
+                    RUN_CUDA(cudaEventRecord(m_startEvents[d], context.computeStream(d, 0)));
+
+                    for (unsigned int l = 1; l < m_laneCount; ++l)
+                    {
+                        RUN_CUDA(cudaStreamWaitEvent(context.computeStream(d, l), m_startEvents[d], 0));
+                    }
+                }
+
+                unsigned int currentNode = m_nodes.size();
+
+                for (unsigned int i = 0; i < m_deviceChains[d].size(); ++i)
+                {
+                    unsigned int node = m_chainNodes[d][i];
+
+                    if (node != currentNode)
+                    {
+                        if (currentNode < m_nodes.size())
+                        {
+                            leaveNode(d, currentNode);
+                        }
+
+                        if (node < m_nodes.size())
+                        {
+                            enterNode(d, node);
+                        }
+                        else
+                        {
+                            joinLanes(d);
+                        }
+
+                        currentNode = node;
+                    }
+
+                    if (isProfiling && isOperatorStep(d, i))
+                    {
+                        ProfileRecord record;
+                        cudaStream_t stream = context.computeStream(d, m_lanes[node]);
+                        m_nodes[node].m_operatorDescriptor->template profileRecord<DeviceUsed>(m_deviceChains[d][i], record);
+                        size_t handle = profiler.beginGPU(record, stream);
+                        m_deviceChains[d][i]->evaluate();
+                        profiler.endGPU(handle, stream);
+                        continue;
+                    }
+
+                    m_deviceChains[d][i]->evaluate();
+                }
+
+                if (currentNode < m_nodes.size())
+                {
+                    leaveNode(d, currentNode);
+                    joinLanes(d);
+                }
+            }
+
+            RUN_CUDA(cudaSetDevice(0));
+        }
+
+    public:
+        GraphExecutor()
+            :m_nodes(),
+              m_deviceChains(),
+              m_messages(),
+              m_lastWriters(),
+              m_completionLatch(),
+              m_isRunning(false),
+              m_profileRecords(),
+              m_isProfiling(false),
+              m_chainNodes(),
+              m_lanes(),
+              m_laneWaits(),
+              m_isWaitedFor(),
+              m_laneCount(1),
+              m_nodeEvents(),
+              m_startEvents(),
+              m_laneEndEvents()
+        {}
+
+        GraphExecutor(const GraphExecutor &) = delete;
+        void operator=(const GraphExecutor &) = delete;
+
+        ~GraphExecutor()
+        {
+            clear();
+        }
+
+        void clear()
+        {
+            wait();
+
+            for (unsigned int d = 0; d < m_messages.size(); ++d)
+            {
+                for (unsigned int i = 0; i < m_messages[d].size(); ++i)
+                {
+                    delete m_messages[d][i];
+                }
+            }
+            m_messages.clear();
+            m_deviceChains.clear();
+            m_lastWriters.clear();
+            m_nodes.clear();
+
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                destroyEvents();
+            }
+            m_chainNodes.clear();
+            m_lanes.clear();
+            m_laneWaits.clear();
+            m_isWaitedFor.clear();
+            m_laneCount = 1;
+        }
+
+        // The operator descriptors must already be initialized, their replicas are bound here.
+        // afterLastWrite holds one step per device for a tensor, queued on that device right
+        // after the last operator writing the tensor, or at the end if the path never writes it.
+        // memoryPlan is the plan the batch tensors were allocated with, if any.
+        bool build(const std::vector<OperatorDescriptorHandle> &path,
+                   std::map<std::string, OperatorDescriptor*> &operators,
+                   std::map<std::string, TensorDescriptor*> &tensors,
+                   const std::map<std::string, std::vector<Operator<DeviceUsed>*>> &afterLastWrite = {},
+                   const MemoryPlanner *memoryPlan = nullptr)
+        {
+            clear();
+
+            buildGraph(path, operators, memoryPlan);
+
+            unsigned int deviceCount = Context<DeviceUsed>::getSingleton().deviceCount();
+            m_deviceChains.resize(deviceCount);
+            m_messages.resize(deviceCount);
+            m_chainNodes.resize(deviceCount);
+
+            for (const Node &node : m_nodes)
+            {
+                if (node.m_operatorDescriptor->m_operators[DeviceUsed].size() != deviceCount)
+                {
+                    clear();
+                    return false;
+                }
+            }
+
+            std::vector<std::vector<std::string>> stepsAfterNode(m_nodes.size() + 1);
+            for (auto iter = afterLastWrite.begin(); iter != afterLastWrite.end(); ++iter)
+            {
+                if (iter->second.size() != deviceCount)
+                {
+                    clear();
+                    return false;
+                }
+
+                stepsAfterNode[lastWriter(iter->first)].push_back(iter->first);
+            }
+
+            for (unsigned int d = 0; d < deviceCount; ++d)
+            {
+                for (unsigned int i = 0; i <= m_nodes.size(); ++i)
+                {
+                    if (i < m_nodes.size())
+                    {
+                        OperatorDescriptor *operatorDescriptor = m_nodes[i].m_operatorDescriptor;
+
+                        m_deviceChains[d].push_back(std::get<Operator<DeviceUsed>*>(operatorDescriptor->m_operators[DeviceUsed][d]));
+                        m_chainNodes[d].push_back(i);
+                    }
+
+                    for (const std::string &tensorName : stepsAfterNode[i])
+                    {
+                        m_deviceChains[d].push_back(afterLastWrite.at(tensorName)[d]);
+                        m_chainNodes[d].push_back(i);
+                    }
+                }
+
+                // the gpu chains are issued by launch() itself
+                for (unsigned int i = 0; DeviceUsed == DeviceType::CPU_NAIVE && i < m_deviceChains[d].size(); ++i)
+                {
+                    m_messages[d].push_back(new WorkerMessage(WorkerMessage::Type::FORWARD, m_deviceChains[d][i]));
+                }
+            }
+
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                assignLanes();
+                createEvents(deviceCount);
+            }
+
+            return true;
+        }
+
+        // queues the whole schedule on every replica and returns without waiting
+        void launch()
+        {
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                launchGPU();
+                return;
+            }
+
+            wait();
+
+            unsigned int deviceCount = m_deviceChains.size();
+            unsigned int totalStepCount = 0;
+            unsigned int longestChain = 0;
+
+            for (unsigned int d = 0; d < deviceCount; ++d)
+            {
+                totalStepCount += m_deviceChains[d].size();
+                longestChain = std::max(longestChain, (unsigned int) m_deviceChains[d].size());
+            }
+
+            if (totalStepCount == 0)
+            {
+                return;
+            }
+
+            m_completionLatch.reset(totalStepCount);
+            m_isRunning = true;
+
+            Profiler &profiler = Profiler::getSingleton();
+            m_isProfiling = profiler.isEnabled();
+
+            if (m_isProfiling)
+            {
+                m_profileRecords.resize(deviceCount);
+
+                for (unsigned int d = 0; d < deviceCount; ++d)
+                {
+                    m_profileRecords[d].resize(m_deviceChains[d].size());
+                }
+            }
+
+            // interleave across devices so a full command queue on one device does not
+            // hold back queueing work for the others
+            for (unsigned int i = 0; i < longestChain; ++i)
+            {
+                for (unsigned int d = 0; d < deviceCount; ++d)
+                {
+                    if (i < m_deviceChains[d].size())
+                    {
+                        m_messages[d][i]->reset(WorkerMessage::Type::FORWARD, m_deviceChains[d][i], &m_completionLatch);
+
+                        if (m_isProfiling && isOperatorStep(d, i))
+                        {
+                            ProfileRecord &record = m_profileRecords[d][i];
+                            m_nodes[m_chainNodes[d][i]].m_operatorDescriptor->template profileRecord<DeviceUsed>(m_deviceChains[d][i], record);
+                            record.m_queueTime = profiler.now();
+                            m_messages[d][i]->setProfileRecord(&record);
+                            Context<DeviceUsed>::getSingleton().pushWork(d, m_messages[d][i]);
+                            record.m_dispatchTime = profiler.now() - record.m_queueTime;
+                            continue;
+                        }
+
+                        Context<DeviceUsed>::getSingleton().pushWork(d, m_messages[d][i]);
+                    }
+                }
+            }
+        }
+
+        void wait()
+        {
+            if (m_isRunning)
+            {
+                m_completionLatch.wait();
+                m_isRunning = false;
+            }
+
+            if (m_isProfiling)
+            {
+                for (unsigned int d = 0; d < m_profileRecords.size(); ++d)
+                {
+                    for (unsigned int i = 0; i < m_profileRecords[d].size(); ++i)
+                    {
+                        if (isOperatorStep(d, i))
+                        {
+                            Profiler::getSingleton().record(m_profileRecords[d][i]);
+                        }
+                    }
+                }
+
+                m_isProfiling = false;
+            }
+        }
+
+        void run()
+        {
+            launch();
+            wait();
+        }
+
+        // cpu: evaluates the chains on the calling thread, one device after the other, instead
+        // of queueing them on the device workers, so a pass of small operators doesn't pay a
+        // wake up and a handoff per step. The operators still share the thread pool. Profiled
+        // passes go through run() for their records.
+        void runInline()
+        {
+            if (DeviceUsed != DeviceType::CPU_NAIVE || Profiler::getSingleton().isEnabled())
+            {
+                run();
+                return;
+            }
+
+            wait();
+
+            for (const std::vector<Operator<DeviceUsed>*> &chain : m_deviceChains)
+            {
+                for (Operator<DeviceUsed> *operatorBase : chain)
+                {
+                    operatorBase->evaluate();
+                }
+            }
+        }
+
+        unsigned int nodeCount() const
+        {
+            return m_nodes.size();
+        }
+
+        // position of the last node writing the tensor in the schedule, nodeCount() if none does
+        unsigned int lastWriter(const std::string &tensorName) const
+        {
+            auto iter = m_lastWriters.find(tensorName);
+
+            return iter == m_lastWriters.end() ? m_nodes.size() : iter->second;
+        }
+
+        const std::vector<unsigned int> &dependencies(unsigned int node) const
+        {
+            return m_nodes[node].m_dependencies;
+        }
+
+        OperatorDescriptor *operatorDescriptor(unsigned int node) const
+        {
+            return m_nodes[node].m_operatorDescriptor;
+        }
+
+        // gpu only, after build
+        unsigned int lane(unsigned int node) const
+        {
+            return m_lanes[node];
+        }
+
+        unsigned int laneCount() const
+        {
+            return m_laneCount;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,487 @@
+#include "Model.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <cuda_runtime.h>
+#include <cudnn.h>
+
+// the graph file, one record per line:
+//
+// FreeWillGraph <version>
+// tensor <name> <data type> <is batch> <is randomly initialized> <dimension> <shape>... <layout>
+// operator <name> <operator name> <data type>
+// input|output <slot> <tensor> <is reshaped> <dimension> <shape>...    of the last operator
+// parameter <name> <type> <value>                                      of the last operator
+// plan <device type> <replica> <device> <plan>                         of the last operator
+// forward|backward <count> <operator>...
+// update <count> <weight> <gradient>...
+// memory <batch size> <is forward only> <arena size> <unplanned size> <key>
+// lifetime <tensor> <begin> <end> <size> <offset>                      of the memory plan
+//
+// version 1 has no layout, its tensors are all CHANNEL_LAST. Before version 3 the plans have no
+// device, they are dropped. Before version 4 the memory plan has no key (see
+// Model::memoryPlanKey), it is dropped.
+
+static const unsigned int graphVersion = 4;
+
+static void writeShape(std::ostream &stream, const FreeWill::Shape &shape)
+{
+    stream << shape.dimension();
+
+    for (unsigned int i = 0; i < shape.dimension(); ++i)
+    {
+        stream << " " << shape[i];
+    }
+}
+
+// the device a plan of replica is found on, one word. The cudnn algorithms are benchmarked, a
+// plan found on another gpu or with another cudnn is searched again.
+static std::string planDevice(FreeWill::DeviceType deviceType, unsigned int replica)
+{
+    if (deviceType != FreeWill::DeviceType::GPU_CUDA)
+    {
+        return "cpu";
+    }
+
+    cudaDeviceProp properties;
+
+    if (cudaGetDeviceProperties(&properties, (int) replica) != cudaSuccess)
+    {
+        return "unknown";
+    }
+
+    std::string name = properties.name;
+    std::replace(name.begin(), name.end(), ' ', '_');
+
+    std::ostringstream stream;
+    stream << name << "/sm" << properties.major << properties.minor << "/cudnn" << cudnnGetVersion();
+
+    return stream.str();
+}
+
+static bool readShape(std::istream &stream, FreeWill::Shape &shape)
+{
+    unsigned int dimension = 0;
+
+    if (!(stream >> dimension) || dimension > 16)
+    {
+        return false;
+    }
+
+    std::vector<unsigned int> dimensions(dimension);
+
+    for (unsigned int i = 0; i < dimension; ++i)
+    {
+        if (!(stream >> dimensions[i]))
+        {
+            return false;
+        }
+    }
+
+    shape = FreeWill::Shape(dimensions.data(), dimension);
+
+    return true;
+}
+
+// the property types the operators read
+static bool writeParameter(std::ostream &stream, const std::string &name, const std::any &value)
+{
+    stream << "parameter " << name << " ";
+
+    if (value.type() == typeid(unsigned int))
+    {
+        stream << "uint " << std::any_cast<unsigned int>(value);
+    }
+    else if (value.type() == typeid(int))
+    {
+        stream << "int " << std::any_cast<int>(value);
+    }
+    else if (value.type() == typeid(float))
+    {
+        stream << "float " << std::setprecision(9) << std::any_cast<float>(value);
+    }
+    else if (value.type() == typeid(double))
+    {
+        stream << "double " << std::setprecision(17) << std::any_cast<double>(value);
+    }
+    else if (value.type() == typeid(bool))
+    {
+        stream << "bool " << std::any_cast<bool>(value);
+    }
+    else if (value.type() == typeid(FreeWill::ActivationMode))
+    {
+        stream << "activation " << (uint32_t) std::any_cast<FreeWill::ActivationMode>(value);
+    }
+    else if (value.type() == typeid(std::string))
+    {
+        stream << "string " << std::any_cast<std::string>(value);
+    }
+    else
+    {
+        return false;
+    }
+
+    stream << "\n";
+
+    return true;
+}
+
+static bool readParameter(std::istream &stream, std::any &value)
+{
+    std::string type;
+    stream >> type;
+
+    if (type == "uint")
+    {
+        unsigned int parameter = 0;
+        stream >> parameter;
+        value = parameter;
+    }
+    else if (type == "int")
+    {
+        int parameter = 0;
+        stream >> parameter;
+        value = parameter;
+    }
+    else if (type == "float")
+    {
+        float parameter = 0.0f;
+        stream >> parameter;
+        value = parameter;
+    }
+    else if (type == "double")
+    {
+        double parameter = 0.0;
+        stream >> parameter;
+        value = parameter;
+    }
+    else if (type == "bool")
+    {
+        bool parameter = false;
+        stream >> parameter;
+        value = parameter;
+    }
+    else if (type == "activation")
+    {
+        uint32_t parameter = 0;
+        stream >> parameter;
+        value = (FreeWill::ActivationMode) parameter;
+    }
+    else if (type == "string")
+    {
+        std::string parameter;
+        stream >> parameter;
+        value = parameter;
+    }
+    else
+    {
+        return false;
+    }
+
+    return !stream.fail();
+}
+
+bool FreeWill::Model::saveGraph(const std::string &filename)
+{
+    std::ostringstream stream;
+
+    stream << "FreeWillGraph " << graphVersion << "\n";
+
+    for (auto iter = m_tensors.begin(); iter != m_tensors.end(); ++iter)
+    {
+        TensorDescriptor *tensorDescriptor = iter->second;
+
+        stream << "tensor " << iter->first << " " << (uint32_t) tensorDescriptor->m_dataType << " " << tensorDescriptor->m_isBatchTensor << " "
+               << tensorDescriptor->m_isRandomlyInitialized << " ";
+        writeShape(stream, tensorDescriptor->m_shape);
+        stream << " " << (uint32_t) tensorDescriptor->m_layout << "\n";
+    }
+
+    for (auto iter = m_operators.begin(); iter != m_operators.end(); ++iter)
+    {
+        OperatorDescriptor *operatorDescriptor = iter->second;
+
+        stream << "operator " << iter->first << " " << (uint32_t) operatorDescriptor->m_operatorName << " "
+               << (uint32_t) operatorDescriptor->m_dataType << "\n";
+
+        for (auto handles : {std::make_pair("input", &operatorDescriptor->m_inputs), std::make_pair("output", &operatorDescriptor->m_outputs)})
+        {
+            for (auto handle = handles.second->begin(); handle != handles.second->end(); ++handle)
+            {
+                stream << handles.first << " " << handle->first << " " << handle->second.name() << " " << handle->second.isReshaped() << " ";
+                writeShape(stream, handle->second.shape());
+                stream << "\n";
+            }
+        }
+
+        for (auto parameter = operatorDescriptor->m_parameters.begin(); parameter != operatorDescriptor->m_parameters.end(); ++parameter)
+        {
+            if (!writeParameter(stream, parameter->first, parameter->second))
+            {
+                std::cerr << "can't save parameter " << parameter->first << " of operator " << iter->first << std::endl;
+                return false;
+            }
+        }
+
+        std::vector<std::string> plans;
+
+        switch (m_deviceUsed)
+        {
+        case DeviceType::CPU_NAIVE:
+            plans = operatorDescriptor->plans<DeviceType::CPU_NAIVE>();
+            break;
+        case DeviceType::GPU_CUDA:
+            plans = operatorDescriptor->plans<DeviceType::GPU_CUDA>();
+            break;
+        }
+
+        for (unsigned int i = 0; i < plans.size(); ++i)
+        {
+            if (!plans[i].empty())
+            {
+                stream << "plan " << (uint32_t) m_deviceUsed << " " << i << " " << planDevice(m_deviceUsed, i) << " " << plans[i] << "\n";
+            }
+        }
+    }
+
+    for (auto path : {std::make_pair("forward", &m_forwardPath), std::make_pair("backward", &m_backwardPath)})
+    {
+        stream << path.first << " " << path.second->size();
+
+        for (const OperatorDescriptorHandle &operatorName : *path.second)
+        {
+            stream << " " << operatorName;
+        }
+
+        stream << "\n";
+    }
+
+    stream << "update " << m_updatePairs.size();
+    for (auto iter = m_updatePairs.begin(); iter != m_updatePairs.end(); ++iter)
+    {
+        stream << " " << iter->first.name() << " " << iter->second.name();
+    }
+    stream << "\n";
+
+    if (m_memoryPlanBatchSize)
+    {
+        stream << "memory " << m_memoryPlanBatchSize << " " << m_isMemoryPlanForwardOnly << " " << m_memoryPlan.arenaSizeInByte() << " "
+               << m_memoryPlan.unplannedSizeInByte() << " " << m_memoryPlanKey << "\n";
+
+        for (const MemoryPlanner::TensorLifetime &lifetime : m_memoryPlan.lifetimes())
+        {
+            stream << "lifetime " << lifetime.m_name << " " << lifetime.m_begin << " " << lifetime.m_end << " "
+                   << lifetime.m_sizeInByte << " " << lifetime.m_offset << "\n";
+        }
+    }
+
+    std::ofstream file(filename, std::ios_base::out | std::ios_base::trunc);
+    file << stream.str();
+
+    return file.good();
+}
+
+bool FreeWill::Model::loadGraph(const std::string &filename)
+{
+    if (!m_tensors.empty() || !m_operators.empty())
+    {
+        return false;
+    }
+
+    std::ifstream file(filename);
+
+    if (!file.is_open())
+    {
+        std::cerr << "can't open " << filename << std::endl;
+        return false;
+    }
+
+    std::string line;
+    std::string record;
+    unsigned int version = 0;
+
+    if (!std::getline(file, line) || !(std::istringstream(line) >> record >> version) || record != "FreeWillGraph" || version > graphVersion)
+    {
+        std::cerr << filename << " is not a graph of this version" << std::endl;
+        return false;
+    }
+
+    OperatorDescriptor *operatorDescriptor = nullptr;
+    std::vector<MemoryPlanner::TensorLifetime> lifetimes;
+    unsigned int arenaSizeInByte = 0;
+    unsigned int unplannedSizeInByte = 0;
+    unsigned int lineNumber = 1;
+
+    while (std::getline(file, line))
+    {
+        std::istringstream stream(line);
+        bool isRead = true;
+        ++lineNumber;
+
+        if (!(stream >> record))
+        {
+            continue;
+        }
+
+        if (record == "tensor")
+        {
+            std::string name;
+            uint32_t dataType = 0;
+            bool isBatchTensor = false;
+            bool isRandomlyInitialized = false;
+            Shape shape;
+            uint32_t layout = (uint32_t) TensorLayout::CHANNEL_LAST;
+
+            isRead = (stream >> name >> dataType >> isBatchTensor >> isRandomlyInitialized) && readShape(stream, shape) &&
+                     (version < 2 || stream >> layout) && layout <= (uint32_t) TensorLayout::CHANNEL_BLOCKED_16 &&
+                     !addTensor(name, shape, (DataType) dataType, isBatchTensor, isRandomlyInitialized).name().empty();
+
+            if (isRead)
+            {
+                m_tensors[name]->m_layout = (TensorLayout) layout;
+            }
+        }
+        else if (record == "operator")
+        {
+            std::string name;
+            uint32_t operatorName = 0;
+            uint32_t dataType = 0;
+
+            isRead = (stream >> name >> operatorName >> dataType) &&
+                     !addOperator(name, (OperatorName) operatorName, {}, {}, {}, (DataType) dataType).empty();
+            operatorDescriptor = isRead ? m_operators[name] : nullptr;
+        }
+        else if ((record == "input" || record == "output") && operatorDescriptor)
+        {
+            std::string slot;
+            std::string tensorName;
+            bool isReshaped = false;
+            Shape shape;
+
+            isRead = (stream >> slot >> tensorName >> isReshaped) && readShape(stream, shape) && m_tensors.find(tensorName) != m_tensors.end();
+
+            if (isRead)
+            {
+                TensorDescriptorHandle handle(this, tensorName, shape);
+                (record == "input" ? operatorDescriptor->m_inputs : operatorDescriptor->m_outputs)[slot] = isReshaped ? handle.reshape(shape) : handle;
+            }
+        }
+        else if (record == "parameter" && operatorDescriptor)
+        {
+            std::string name;
+            std::any value;
+
+            isRead = (stream >> name) && readParameter(stream, value);
+            operatorDescriptor->m_parameters[name] = value;
+        }
+        else if (record == "plan" && operatorDescriptor)
+        {
+            uint32_t deviceType = 0;
+            unsigned int replica = 0;
+            std::string device;
+            std::string plan;
+
+            isRead = (stream >> deviceType >> replica) && (version < 3 || stream >> device) && std::getline(stream >> std::ws, plan);
+
+            if (isRead && version >= 3 && device != "unknown" && device == planDevice((DeviceType) deviceType, replica))
+            {
+                std::vector<std::string> &plans = operatorDescriptor->m_plans[(DeviceType) deviceType];
+                plans.resize(std::max((unsigned int) plans.size(), replica + 1));
+                plans[replica] = plan;
+            }
+        }
+        else if (record == "forward" || record == "backward" || record == "update")
+        {
+            unsigned int count = 0;
+            isRead = (bool) (stream >> count);
+
+            std::vector<OperatorDescriptorHandle> path;
+            std::vector<std::pair<TensorDescriptorHandle, TensorDescriptorHandle>> updatePairs;
+
+            for (unsigned int i = 0; i < count && isRead; ++i)
+            {
+                std::string first;
+                std::string second;
+
+                if (record == "update")
+                {
+                    isRead = (stream >> first >> second) && m_tensors.find(first) != m_tensors.end() && m_tensors.find(second) != m_tensors.end();
+                    updatePairs.push_back({TensorDescriptorHandle(this, first, Shape()), TensorDescriptorHandle(this, second, Shape())});
+                }
+                else
+                {
+                    isRead = (stream >> first) && m_operators.find(first) != m_operators.end();
+                    path.push_back(first);
+                }
+            }
+
+            if (isRead)
+            {
+                if (record == "forward")
+                {
+                    m_forwardPath = path;
+                }
+                else if (record == "backward")
+                {
+                    m_backwardPath = path;
+                }
+                else
+                {
+                    m_updatePairs = updatePairs;
+                }
+            }
+        }
+        else if (record == "memory")
+        {
+            isRead = (bool) (stream >> m_memoryPlanBatchSize >> m_isMemoryPlanForwardOnly >> arenaSizeInByte >> unplannedSizeInByte) &&
+                     (version < 4 || stream >> m_memoryPlanKey);
+
+            if (version < 4)
+            {
+                m_memoryPlanBatchSize = 0;
+            }
+        }
+        else if (record == "lifetime")
+        {
+            MemoryPlanner::TensorLifetime lifetime;
+
+            isRead = (bool) (stream >> lifetime.m_name >> lifetime.m_begin >> lifetime.m_end >> lifetime.m_sizeInByte >> lifetime.m_offset);
+            lifetimes.push_back(lifetime);
+        }
+        else
+        {
+            isRead = false;
+        }
+
+        if (!isRead)
+        {
+            std::cerr << filename << ":" << lineNumber << ": can't read " << record << std::endl;
+
+            // the model is left empty, as it was
+            for (auto iter = m_operators.begin(); iter != m_operators.end(); ++iter)
+            {
+                delete iter->second;
+            }
+
+            for (auto iter = m_tensors.begin(); iter != m_tensors.end(); ++iter)
+            {
+                delete iter->second;
+            }
+
+            m_operators.clear();
+            m_tensors.clear();
+            m_forwardPath.clear();
+            m_backwardPath.clear();
+            m_updatePairs.clear();
+            m_memoryPlanBatchSize = 0;
+            m_isMemoryPlanForwardOnly = false;
+
+            return false;
+        }
+    }
+
+    m_memoryPlan.restore(lifetimes, arenaSizeInByte, unplannedSizeInByte);
+
+    return true;
+}
@@ -0,0 +1,286 @@
+#include "InferenceServer.h"
+#include <algorithm>
+#include <iostream>
+
+FreeWill::InferenceServer::InferenceServer(FreeWill::Model *model, FreeWill::Solver *solver,
+                                           const FreeWill::TensorDescriptorHandle &input, const FreeWill::TensorDescriptorHandle &output,
+                                           const FreeWill::InferenceServerParameters &parameters)
+    :m_model(model),
+      m_solver(solver),
+      m_input(input),
+      m_output(output),
+      m_parameters(parameters),
+      m_inputSize(0),
+      m_outputSize(0),
+      m_capacity(0),
+      m_worker(nullptr),
+      m_mutex(),
+      m_requestAvailable(),
+      m_queue(),
+      m_isRunning(false),
+      m_requestCount(0),
+      m_batchCount(0),
+      m_totalLatency(0.0)
+{
+}
+
+FreeWill::InferenceServer::~InferenceServer()
+{
+    stop();
+}
+
+bool FreeWill::InferenceServer::start()
+{
+    if (m_worker || m_model->m_tensors.find(m_input.name()) == m_model->m_tensors.end() ||
+            m_model->m_tensors.find(m_output.name()) == m_model->m_tensors.end())
+    {
+        return false;
+    }
+
+    TensorDescriptor *input = m_model->m_tensors[m_input.name()];
+    TensorDescriptor *output = m_model->m_tensors[m_output.name()];
+
+    if (!input->m_isBatchTensor || !output->m_isBatchTensor ||
+            input->m_dataType != DataType::FLOAT || output->m_dataType != DataType::FLOAT ||
+            !input->isInitialized() || !output->isInitialized())
+    {
+        return false;
+    }
+
+    unsigned int deviceCount = 0;
+    switch (m_solver->m_deviceUsed)
+    {
+    case DeviceType::CPU_NAIVE:
+        deviceCount = Context<DeviceType::CPU_NAIVE>::getSingleton().deviceCount();
+        break;
+    case DeviceType::GPU_CUDA:
+        deviceCount = Context<DeviceType::GPU_CUDA>::getSingleton().deviceCount();
+        break;
+    }
+
+    m_inputSize = input->m_shape.size();
+    m_outputSize = output->m_shape.size();
+    m_capacity = m_solver->m_batchSize * deviceCount;
+
+    if (m_parameters.m_maxBatchSize == 0 || m_parameters.m_maxBatchSize > m_capacity)
+    {
+        m_parameters.m_maxBatchSize = m_capacity;
+    }
+
+    if (m_capacity == 0)
+    {
+        return false;
+    }
+
+    m_isRunning = true;
+    m_worker = new std::thread(&InferenceServer::workerLoop, this);
+
+    return true;
+}
+
+void FreeWill::InferenceServer::stop()
+{
+    if (!m_worker)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_isRunning = false;
+    }
+    m_requestAvailable.notify_all();
+
+    m_worker->join();
+    delete m_worker;
+    m_worker = nullptr;
+}
+
+bool FreeWill::InferenceServer::submit(const std::vector<float> &sample, std::future<std::vector<float>> &result)
+{
+    if (sample.size() != m_inputSize)
+    {
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    if (!m_isRunning || (m_parameters.m_maxQueueLength && m_queue.size() >= m_parameters.m_maxQueueLength))
+    {
+        return false;
+    }
+
+    Request *request = new Request();
+    request->m_sample = sample;
+    request->m_submitTime = std::chrono::steady_clock::now();
+    result = request->m_result.get_future();
+
+    m_queue.push_back(request);
+
+    // the worker only needs waking for the first request of a batch and for a full one
+    bool isWakeUp = m_queue.size() == 1 || m_queue.size() >= m_parameters.m_maxBatchSize;
+
+    lock.unlock();
+
+    if (isWakeUp)
+    {
+        m_requestAvailable.notify_one();
+    }
+
+    return true;
+}
+
+void FreeWill::InferenceServer::workerLoop()
+{
+    std::vector<Request*> batch;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+
+            m_requestAvailable.wait(lock, [this]{return !m_queue.empty() || !m_isRunning;});
+
+            if (m_queue.empty())
+            {
+                return;
+            }
+
+            // the deadline belongs to the oldest request, a stop flushes without waiting
+            std::chrono::steady_clock::time_point deadline = m_queue.front()->m_submitTime + m_parameters.m_maxDelay;
+            m_requestAvailable.wait_until(lock, deadline, [this]{return m_queue.size() >= m_parameters.m_maxBatchSize || !m_isRunning;});
+
+            unsigned int batchSize = std::min((unsigned int) m_queue.size(), m_parameters.m_maxBatchSize);
+            batch.assign(m_queue.begin(), m_queue.begin() + batchSize);
+            m_queue.erase(m_queue.begin(), m_queue.begin() + batchSize);
+        }
+
+        switch (m_solver->m_deviceUsed)
+        {
+        case DeviceType::CPU_NAIVE:
+            runBatch<DeviceType::CPU_NAIVE>(batch);
+            break;
+        case DeviceType::GPU_CUDA:
+            runBatch<DeviceType::GPU_CUDA>(batch);
+            break;
+        }
+
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        double latency = 0.0;
+
+        for (unsigned int i = 0; i < batch.size(); ++i)
+        {
+            latency += std::chrono::duration<double>(now - batch[i]->m_submitTime).count();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_requestCount += batch.size();
+            ++m_batchCount;
+            m_totalLatency += latency;
+        }
+
+        for (unsigned int i = 0; i < batch.size(); ++i)
+        {
+            delete batch[i];
+        }
+    }
+}
+
+template<FreeWill::DeviceType DeviceUsed>
+void FreeWill::InferenceServer::runBatch(const std::vector<Request*> &batch)
+{
+    TensorDescriptor *input = m_model->m_tensors[m_input.name()];
+    TensorDescriptor *output = m_model->m_tensors[m_output.name()];
+    unsigned int deviceCount = m_capacity / m_solver->m_batchSize;
+
+    // a partial batch runs at a smaller view of the tensors, split evenly over the devices
+    unsigned int slotCount = (batch.size() + deviceCount - 1) / deviceCount;
+
+    if (!m_model->setBatchSize(slotCount))
+    {
+        std::cerr << "can't run a batch of " << batch.size() << " requests" << std::endl;
+
+        for (unsigned int i = 0; i < batch.size(); ++i)
+        {
+            batch[i]->m_result.set_value(std::vector<float>());
+        }
+
+        return;
+    }
+
+    for (unsigned int d = 0; d < deviceCount; ++d)
+    {
+        TensorBase<DeviceUsed> *tensor = input->getTensorForDevice<DeviceUsed>(d);
+        float *data = static_cast<float*>(tensor->cpuDataHandle());
+
+        for (unsigned int s = 0; s < slotCount; ++s)
+        {
+            unsigned int k = d * slotCount + s;
+
+            if (k < batch.size())
+            {
+                std::copy(batch[k]->m_sample.begin(), batch[k]->m_sample.end(), data + (size_t) s * m_inputSize);
+            }
+            else
+            {
+                std::fill(data + (size_t) s * m_inputSize, data + (size_t) (s + 1) * m_inputSize, 0.0f);
+            }
+        }
+
+        if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+        {
+            RUN_CUDA(cudaSetDevice(d));
+            tensor->copyFromHostToDevice();
+        }
+    }
+
+    if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+    {
+        RUN_CUDA(cudaSetDevice(0));
+    }
+
+    m_solver->forward(m_model);
+
+    for (unsigned int d = 0; d * slotCount < batch.size(); ++d)
+    {
+        TensorBase<DeviceUsed> *tensor = output->getTensorForDevice<DeviceUsed>(d);
+
+        if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+        {
+            RUN_CUDA(cudaSetDevice(d));
+            tensor->copyFromDeviceToHost();
+        }
+
+        const float *data = static_cast<const float*>(tensor->cpuDataHandle());
+
+        for (unsigned int s = 0; s < slotCount && d * slotCount + s < batch.size(); ++s)
+        {
+            batch[d * slotCount + s]->m_result.set_value(std::vector<float>(data + (size_t) s * m_outputSize,
+                                                                            data + (size_t) (s + 1) * m_outputSize));
+        }
+    }
+
+    if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+    {
+        RUN_CUDA(cudaSetDevice(0));
+    }
+}
+
+unsigned long long FreeWill::InferenceServer::requestCount()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_requestCount;
+}
+
+unsigned long long FreeWill::InferenceServer::batchCount()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_batchCount;
+}
+
+double FreeWill::InferenceServer::averageLatency()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_requestCount ? m_totalLatency / m_requestCount : 0.0;
+}
@@ -0,0 +1,99 @@
+#ifndef INFERENCESERVER_H
+#define INFERENCESERVER_H
+
+#include "Model.h"
+#include "Solver.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace FreeWill
+{
+    struct InferenceServerParameters
+    {
+        // 0 is the capacity of the model, m_batchSize samples on each device
+        unsigned int m_maxBatchSize = 0;
+        // how long the oldest request waits for others to fill its batch, the latency knob
+        std::chrono::microseconds m_maxDelay = std::chrono::microseconds(2000);
+        // submit() turns requests away beyond this many queued, 0 is unbounded
+        unsigned int m_maxQueueLength = 0;
+    };
+
+    // Serves single samples with an inference Solver: a worker thread gathers the queued requests
+    // into batches of up to m_maxBatchSize, or fewer once the oldest one has waited m_maxDelay,
+    // writes them into the batch slots of the input tensor, runs forward() and hands every
+    // request the slice of the output tensor for its slot. A partial batch is split evenly over
+    // the devices and runs at that batch size (Model::setBatchSize), the slots left over on the
+    // last device are zeroed. Every request of a batch the model can't be viewed at gets an empty
+    // result. The model and solver must be initialized and are only used by the worker while the
+    // server runs.
+    class InferenceServer
+    {
+        struct Request
+        {
+            std::vector<float> m_sample;
+            std::promise<std::vector<float>> m_result;
+            std::chrono::steady_clock::time_point m_submitTime;
+        };
+
+        Model *m_model;
+        Solver *m_solver;
+        TensorDescriptorHandle m_input;
+        TensorDescriptorHandle m_output;
+        InferenceServerParameters m_parameters;
+
+        unsigned int m_inputSize;
+        unsigned int m_outputSize;
+        unsigned int m_capacity;
+
+        std::thread *m_worker;
+        std::mutex m_mutex;
+        std::condition_variable m_requestAvailable;
+        std::deque<Request*> m_queue;
+        bool m_isRunning;
+
+        unsigned long long m_requestCount;
+        unsigned long long m_batchCount;
+        double m_totalLatency;
+
+        void workerLoop();
+
+        template<DeviceType DeviceUsed>
+        void runBatch(const std::vector<Request*> &batch);
+
+    public:
+        InferenceServer(Model *model, Solver *solver, const TensorDescriptorHandle &input, const TensorDescriptorHandle &output,
+                        const InferenceServerParameters &parameters = InferenceServerParameters());
+        ~InferenceServer();
+
+        InferenceServer(const InferenceServer &) = delete;
+        void operator=(const InferenceServer &) = delete;
+
+        bool start();
+
+        // answers the requests already queued, then joins the worker
+        void stop();
+
+        // false, and no future, when the server isn't running, the queue is full or the sample
+        // doesn't have the size of one input sample
+        bool submit(const std::vector<float> &sample, std::future<std::vector<float>> &result);
+
+        unsigned long long requestCount();
+        unsigned long long batchCount();
+
+        // in seconds, from submit() until the result is set
+        double averageLatency();
+
+        double averageBatchSize()
+        {
+            unsigned long long batches = batchCount();
+            return batches ? (double) requestCount() / batches : 0.0;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,236 @@
+#include "MemoryPlanner.h"
+#include <algorithm>
+
+FreeWill::MemoryPlanner::MemoryPlanner()
+    :m_lifetimes(),
+      m_arenaSizeInByte(0),
+      m_unplannedSizeInByte(0)
+{}
+
+unsigned int FreeWill::MemoryPlanner::sizeInByte(const TensorDescriptor *tensorDescriptor, unsigned int batchSize)
+{
+    unsigned int elementSize = 0;
+
+    switch (tensorDescriptor->m_dataType)
+    {
+    case DataType::FLOAT:
+        elementSize = sizeof(float);
+        break;
+    case DataType::DOUBLE:
+        elementSize = sizeof(double);
+        break;
+    case DataType::UNSIGNED_INT:
+        elementSize = sizeof(unsigned int);
+        break;
+    case DataType::HALF:
+        elementSize = sizeof(Half);
+        break;
+    case DataType::BFLOAT16:
+        elementSize = sizeof(BFloat16);
+        break;
+    }
+
+    Shape shape = tensorDescriptor->m_isBatchTensor ? (tensorDescriptor->m_shape + batchSize) : tensorDescriptor->m_shape;
+
+    return shape.size() * elementSize;
+}
+
+bool FreeWill::MemoryPlanner::plan(const std::vector<OperatorDescriptorHandle> &forwardPath,
+                                   const std::vector<OperatorDescriptorHandle> &backwardPath,
+                                   std::map<std::string, OperatorDescriptor*> &operators,
+                                   std::map<std::string, TensorDescriptor*> &tensors,
+                                   const std::set<std::string> &excludedTensors,
+                                   unsigned int batchSize,
+                                   const std::set<std::string> &discardedTensors)
+{
+    struct Usage
+    {
+        unsigned int m_passBegin = 0;
+        unsigned int m_lastUse = 0;
+        bool m_isFirstUseRead = false;
+        bool m_isWritten = false;
+        bool m_isReadAfterLastWrite = false;
+    };
+
+    m_lifetimes.clear();
+    m_arenaSizeInByte = 0;
+    m_unplannedSizeInByte = 0;
+
+    std::map<std::string, Usage> usages;
+    unsigned int time = 0;
+    const unsigned int timelineEnd = forwardPath.size() + backwardPath.size();
+
+    for (const std::vector<OperatorDescriptorHandle> *path : {&forwardPath, &backwardPath})
+    {
+        unsigned int passBegin = time;
+
+        for (const OperatorDescriptorHandle &operatorHandle : *path)
+        {
+            if (operators.find(operatorHandle) == operators.end())
+            {
+                return false;
+            }
+
+            OperatorDescriptor *operatorDescriptor = operators[operatorHandle];
+
+            for (auto iter = operatorDescriptor->m_inputs.begin(); iter != operatorDescriptor->m_inputs.end(); ++iter)
+            {
+                const std::string &tensorName = iter->second.name();
+                if (usages.find(tensorName) == usages.end())
+                {
+                    usages[tensorName].m_passBegin = passBegin;
+                    usages[tensorName].m_isFirstUseRead = true;
+                }
+                usages[tensorName].m_lastUse = time;
+                usages[tensorName].m_isReadAfterLastWrite = true;
+            }
+
+            for (auto iter = operatorDescriptor->m_outputs.begin(); iter != operatorDescriptor->m_outputs.end(); ++iter)
+            {
+                const std::string &tensorName = iter->second.name();
+                if (usages.find(tensorName) == usages.end())
+                {
+                    // a tensor that is overwritten needs no memory before this point, one that is
+                    // accumulated into has been cleared by the caller before the pass started
+                    usages[tensorName].m_passBegin = operatorDescriptor->overwritesOutput(iter->first) ? time : passBegin;
+                }
+                usages[tensorName].m_lastUse = time;
+                usages[tensorName].m_isWritten = true;
+                usages[tensorName].m_isReadAfterLastWrite = false;
+            }
+
+            ++time;
+        }
+    }
+
+    std::vector<TensorLifetime> candidates;
+
+    for (auto iter = usages.begin(); iter != usages.end(); ++iter)
+    {
+        if (tensors.find(iter->first) == tensors.end())
+        {
+            return false;
+        }
+
+        const TensorDescriptor *tensorDescriptor = tensors[iter->first];
+        const Usage &usage = iter->second;
+
+        if (!tensorDescriptor->m_isBatchTensor || tensorDescriptor->m_isRandomlyInitialized ||
+                excludedTensors.find(iter->first) != excludedTensors.end())
+        {
+            continue;
+        }
+
+        TensorLifetime lifetime;
+        lifetime.m_name = iter->first;
+        lifetime.m_begin = usage.m_isFirstUseRead ? 0 : usage.m_passBegin;
+        lifetime.m_end = (usage.m_isWritten && !usage.m_isReadAfterLastWrite && discardedTensors.find(iter->first) == discardedTensors.end()) ?
+                    timelineEnd : usage.m_lastUse;
+        lifetime.m_sizeInByte = sizeInByte(tensorDescriptor, batchSize);
+        lifetime.m_offset = 0;
+
+        if (lifetime.m_sizeInByte == 0)
+        {
+            continue;
+        }
+
+        candidates.push_back(lifetime);
+        m_unplannedSizeInByte += lifetime.m_sizeInByte;
+    }
+
+    // largest first, each one goes into the lowest gap that is free for its whole lifetime
+    std::sort(candidates.begin(), candidates.end(), [](const TensorLifetime &a, const TensorLifetime &b)
+    {
+        return a.m_sizeInByte != b.m_sizeInByte ? a.m_sizeInByte > b.m_sizeInByte : a.m_name < b.m_name;
+    });
+
+    std::vector<TensorLifetime> placed;
+
+    for (TensorLifetime &candidate : candidates)
+    {
+        std::vector<const TensorLifetime*> overlapping;
+        for (const TensorLifetime &other : placed)
+        {
+            if (other.m_begin <= candidate.m_end && candidate.m_begin <= other.m_end)
+            {
+                overlapping.push_back(&other);
+            }
+        }
+
+        std::sort(overlapping.begin(), overlapping.end(), [](const TensorLifetime *a, const TensorLifetime *b){return a->m_offset < b->m_offset;});
+
+        unsigned int offset = 0;
+        for (const TensorLifetime *other : overlapping)
+        {
+            if (offset + candidate.m_sizeInByte <= other->m_offset)
+            {
+                break;
+            }
+
+            unsigned int otherEnd = other->m_offset + other->m_sizeInByte;
+            offset = std::max(offset, (otherEnd + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT);
+        }
+
+        candidate.m_offset = offset;
+        placed.push_back(candidate);
+        m_arenaSizeInByte = std::max(m_arenaSizeInByte, offset + candidate.m_sizeInByte);
+    }
+
+    for (const TensorLifetime &lifetime : placed)
+    {
+        m_lifetimes[lifetime.m_name] = lifetime;
+    }
+
+    return true;
+}
+
+bool FreeWill::MemoryPlanner::isPlanned(const std::string &tensorName) const
+{
+    return m_lifetimes.find(tensorName) != m_lifetimes.end();
+}
+
+unsigned int FreeWill::MemoryPlanner::offset(const std::string &tensorName) const
+{
+    return m_lifetimes.at(tensorName).m_offset;
+}
+
+const FreeWill::MemoryPlanner::TensorLifetime &FreeWill::MemoryPlanner::lifetime(const std::string &tensorName) const
+{
+    return m_lifetimes.at(tensorName);
+}
+
+unsigned int FreeWill::MemoryPlanner::arenaSizeInByte() const
+{
+    return m_arenaSizeInByte;
+}
+
+unsigned int FreeWill::MemoryPlanner::unplannedSizeInByte() const
+{
+    return m_unplannedSizeInByte;
+}
+
+std::vector<FreeWill::MemoryPlanner::TensorLifetime> FreeWill::MemoryPlanner::lifetimes() const
+{
+    std::vector<TensorLifetime> placed;
+
+    for (auto iter = m_lifetimes.begin(); iter != m_lifetimes.end(); ++iter)
+    {
+        placed.push_back(iter->second);
+    }
+
+    return placed;
+}
+
+void FreeWill::MemoryPlanner::restore(const std::vector<FreeWill::MemoryPlanner::TensorLifetime> &lifetimes, unsigned int arenaSizeInByte,
+                                      unsigned int unplannedSizeInByte)
+{
+    m_lifetimes.clear();
+
+    for (const TensorLifetime &lifetime : lifetimes)
+    {
+        m_lifetimes[lifetime.m_name] = lifetime;
+    }
+
+    m_arenaSizeInByte = arenaSizeInByte;
+    m_unplannedSizeInByte = unplannedSizeInByte;
+}
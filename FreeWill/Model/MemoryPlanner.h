@@ -0,0 +1,71 @@
+#ifndef MEMORYPLANNER_H
+#define MEMORYPLANNER_H
+
+#include "TensorDescriptor.h"
+#include "OperatorDescriptor.h"
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace FreeWill
+{
+    // Packs batch tensors whose lifetimes do not overlap into one arena per device.
+    //
+    // The timeline is the forward path followed by the backward path. A tensor is live from its
+    // first write to its last use. If that first write accumulates, the caller clears the tensor
+    // before the pass, so it is live from the start of the pass. A tensor that is read before
+    // anything writes it is filled by the caller and is live from the start, one that is never
+    // read after its last write is consumed by the caller and stays live to the end. Tensors
+    // that are not batch tensors, are randomly initialized, are listed in excludedTensors or are
+    // not used by either path keep their own allocation. The caller never reads the
+    // discardedTensors, they end at their last use whatever it is.
+    class MemoryPlanner
+    {
+    public:
+        static const unsigned int ALIGNMENT = 64;
+
+        struct TensorLifetime
+        {
+            std::string m_name;
+            unsigned int m_begin;
+            unsigned int m_end;
+            unsigned int m_sizeInByte;
+            unsigned int m_offset;
+        };
+
+    private:
+        std::map<std::string, TensorLifetime> m_lifetimes;
+        unsigned int m_arenaSizeInByte;
+        unsigned int m_unplannedSizeInByte;
+
+    public:
+        MemoryPlanner();
+
+        bool plan(const std::vector<OperatorDescriptorHandle> &forwardPath,
+                  const std::vector<OperatorDescriptorHandle> &backwardPath,
+                  std::map<std::string, OperatorDescriptor*> &operators,
+                  std::map<std::string, TensorDescriptor*> &tensors,
+                  const std::set<std::string> &excludedTensors,
+                  unsigned int batchSize,
+                  const std::set<std::string> &discardedTensors = std::set<std::string>());
+
+        bool isPlanned(const std::string &tensorName) const;
+
+        unsigned int offset(const std::string &tensorName) const;
+
+        const TensorLifetime &lifetime(const std::string &tensorName) const;
+
+        // bytes needed by the arena, and what the same tensors take when allocated one by one
+        unsigned int arenaSizeInByte() const;
+        unsigned int unplannedSizeInByte() const;
+
+        static unsigned int sizeInByte(const TensorDescriptor *tensorDescriptor, unsigned int batchSize);
+
+        // the placed tensors, to take a plan again with restore() instead of planning
+        std::vector<TensorLifetime> lifetimes() const;
+        void restore(const std::vector<TensorLifetime> &lifetimes, unsigned int arenaSizeInByte, unsigned int unplannedSizeInByte);
+    };
+}
+
+#endif
@@ -1,6 +1,9 @@
 #include "Model.h"
+#include <algorithm>
 #include <cmath>
 #include "../Operator/Operator.h"
+#include "../Context/Communicator.h"
+#include <cstring>
 #include <fstream>
 #include <sstream>
 
@@ -16,6 +19,13 @@ FreeWill::TensorDescriptorHandle FreeWill::Model::addTensor(const std::string &n
     {
         return TensorDescriptorHandle(this, std::string(), Shape());
     }
+
+    // the batch is one more dimension
+    if (!shape.isValid() || (isBatchTensor && shape.dimension() == Shape::MAX_DIMENSION))
+    {
+        std::cerr << "tensor " << name << " has too many dimensions" << std::endl;
+        return TensorDescriptorHandle(this, std::string(), Shape());
+    }
    
     m_tensors[name] = new FreeWill::TensorDescriptor(name, shape, dataType, isBatchTensor, isRandomlyInitialized);
     
@@ -26,7 +36,19 @@ FreeWill::TensorDescriptorHandle FreeWill::Model::addTensor(const std::string &n
 
 FreeWill::Model::Model()
     :m_tensors(),
-      m_operators()
+      m_operators(),
+      m_deviceUsed(DeviceType::CPU_NAIVE),
+      m_maxBatchSize(0),
+      m_batchFirst(0),
+      m_batchSize(0),
+      m_memoryPlan(),
+      m_memoryPlanBatchSize(0),
+      m_isMemoryPlanForwardOnly(false),
+      m_memoryPlanKey(0),
+      m_companionTensors(),
+      m_checkpointSegments(),
+      m_recomputedTensors(),
+      m_sharedWeights()
 {
 }
 
@@ -36,100 +58,1554 @@ FreeWill::OperatorDescriptorHandle FreeWill::Model::addOperator(const std::strin
                                  const std::map<std::string, FreeWill::TensorDescriptorHandle> &outputs,
                                  const std::map<std::string, std::any> &properties, DataType dataType)
 {
-    if (FreeWill::operatorNameTable.find(operatorNameString) != FreeWill::operatorNameTable.end())
+    if (FreeWill::operatorNameTable.find(operatorNameString) != FreeWill::operatorNameTable.end())
+    {
+        FreeWill::OperatorName operatorName = operatorNameTable[operatorNameString];
+
+        return addOperator(name, operatorName, inputs, outputs, properties, dataType);
+
+        return name;
+    }
+
+    return std::string();
+}
+
+FreeWill::OperatorDescriptorHandle FreeWill::Model::addOperator(const std::string &name,
+                                 FreeWill::OperatorName operatorName,
+                                 const std::map<std::string, FreeWill::TensorDescriptorHandle> &inputs,
+                                 const std::map<std::string, FreeWill::TensorDescriptorHandle> &outputs,
+                                 const std::map<std::string, std::any> &properties, DataType dataType)
+{
+    if (m_operators.find(name) != m_operators.end())
+    {
+        return std::string();
+    }
+
+    OperatorDescriptor *opDescriptor = new OperatorDescriptor(name, operatorName, inputs, outputs, properties, dataType);
+
+    m_operators[name] = opDescriptor;
+    m_memoryPlanBatchSize = 0;
+
+    return name;
+}
+
+void FreeWill::Model::fuseOperators(DeviceType deviceUsed)
+{
+    // the last operator before the i-th of the forward path that touches tensorName
+    auto lastToTouch = [this](unsigned int i, const std::string &tensorName) -> OperatorDescriptor*
+    {
+        for (unsigned int j = i; j > 0; --j)
+        {
+            OperatorDescriptor *candidate = m_operators[m_forwardPath[j - 1]];
+
+            for (const std::map<std::string, TensorDescriptorHandle> *handles : {&candidate->m_inputs, &candidate->m_outputs})
+            {
+                for (auto iter = handles->begin(); iter != handles->end(); ++iter)
+                {
+                    if (iter->second.name() == tensorName)
+                    {
+                        return candidate;
+                    }
+                }
+            }
+        }
+
+        return nullptr;
+    };
+
+    // An in-place inference BATCH_NORMALIZATION of what a cpu CONVOLUTION wrote becomes a scale
+    // of its filters and a new bias, see Convolution::foldNormalization. First, so that an
+    // activation after the normalization still goes into the convolution below.
+    for (unsigned int i = 0; i < m_forwardPath.size() && deviceUsed == DeviceType::CPU_NAIVE;)
+    {
+        OperatorDescriptor *normalization = m_operators[m_forwardPath[i]];
+
+        if (normalization->m_operatorName != OperatorName::BATCH_NORMALIZATION || !normalization->m_isInference ||
+                normalization->m_inputs.find("Input") == normalization->m_inputs.end() ||
+                normalization->m_inputs.find("Scale") == normalization->m_inputs.end() ||
+                normalization->m_inputs.find("Shift") == normalization->m_inputs.end() ||
+                normalization->m_outputs.find("Output") == normalization->m_outputs.end() ||
+                normalization->m_outputs.find("Mean") == normalization->m_outputs.end() ||
+                normalization->m_outputs.find("Variance") == normalization->m_outputs.end() ||
+                normalization->m_inputs["Input"].name() != normalization->m_outputs["Output"].name() ||
+                normalization->m_inputs["Input"].isReshaped() || normalization->m_outputs["Output"].isReshaped())
+        {
+            ++i;
+            continue;
+        }
+
+        const std::string &tensorName = normalization->m_inputs["Input"].name();
+        OperatorDescriptor *producer = lastToTouch(i, tensorName);
+
+        bool isFusable = producer &&
+                producer->m_operatorName == OperatorName::CONVOLUTION &&
+                producer->m_outputs.find("Output") != producer->m_outputs.end() &&
+                producer->m_outputs["Output"].name() == tensorName &&
+                !producer->m_outputs["Output"].isReshaped() &&
+                producer->m_parameters.find("Activation") == producer->m_parameters.end() &&
+                producer->m_parameters.find("NormalizationEpsilon") == producer->m_parameters.end() &&
+                producer->m_dataType == normalization->m_dataType &&
+                producer->m_deviceId == normalization->m_deviceId;
+
+        if (!isFusable)
+        {
+            ++i;
+            continue;
+        }
+
+        float epsilon = 1e-5f;
+        if (normalization->m_parameters.find("Epsilon") != normalization->m_parameters.end())
+        {
+            epsilon = std::any_cast<float>(normalization->m_parameters["Epsilon"]);
+        }
+
+        producer->m_parameters["NormalizationEpsilon"] = epsilon;
+        producer->m_inputs["NormalizationScale"] = normalization->m_inputs["Scale"];
+        producer->m_inputs["NormalizationShift"] = normalization->m_inputs["Shift"];
+        producer->m_inputs["NormalizationMean"] = normalization->m_outputs["Mean"];
+        producer->m_inputs["NormalizationVariance"] = normalization->m_outputs["Variance"];
+        m_forwardPath.erase(m_forwardPath.begin() + i);
+    }
+
+    for (unsigned int i = 0; i < m_forwardPath.size();)
+    {
+        OperatorDescriptor *activation = m_operators[m_forwardPath[i]];
+
+        const TensorDescriptorHandle *activationInput = nullptr;
+        const TensorDescriptorHandle *activationOutput = nullptr;
+
+        if (activation->m_operatorName == OperatorName::ACTIVATION &&
+                activation->m_inputs.find("Input") != activation->m_inputs.end() &&
+                activation->m_outputs.find("Output") != activation->m_outputs.end() &&
+                activation->m_parameters.find("Mode") != activation->m_parameters.end() &&
+                activation->m_parameters.find("Dropout") == activation->m_parameters.end())
+        {
+            activationInput = &activation->m_inputs["Input"];
+            activationOutput = &activation->m_outputs["Output"];
+        }
+
+        // only in place activations, otherwise the pre-activation tensor may still be needed
+        if (!activationInput || activationInput->name() != activationOutput->name() ||
+                activationInput->isReshaped() || activationOutput->isReshaped())
+        {
+            ++i;
+            continue;
+        }
+
+        const std::string &tensorName = activationInput->name();
+        ActivationMode mode = std::any_cast<ActivationMode>(activation->m_parameters["Mode"]);
+
+        // the last operator before the activation that touches the tensor
+        OperatorDescriptor *producer = lastToTouch(i, tensorName);
+
+        bool isFusable = producer &&
+                (producer->m_operatorName == OperatorName::DOT_PRODUCT_WITH_BIAS || producer->m_operatorName == OperatorName::CONVOLUTION) &&
+                producer->m_outputs.find("Output") != producer->m_outputs.end() &&
+                producer->m_outputs["Output"].name() == tensorName &&
+                !producer->m_outputs["Output"].isReshaped() &&
+                producer->m_parameters.find("Activation") == producer->m_parameters.end() &&
+                producer->m_dataType == activation->m_dataType &&
+                producer->m_deviceId == activation->m_deviceId;
+
+        if (isFusable)
+        {
+            switch (deviceUsed)
+            {
+            case DeviceType::CPU_NAIVE:
+                isFusable = isActivationImplementedCPU(mode);
+                break;
+            case DeviceType::GPU_CUDA:
+                // cudnnConvolutionBiasActivationForward only takes relu, cublas has no epilogue
+                isFusable = producer->m_operatorName == OperatorName::CONVOLUTION && mode == ActivationMode::RELU;
+                break;
+            default:
+                isFusable = false;
+                break;
+            }
+        }
+
+        if (!isFusable)
+        {
+            ++i;
+            continue;
+        }
+
+        producer->m_parameters["Activation"] = mode;
+        m_forwardPath.erase(m_forwardPath.begin() + i);
+    }
+
+    // An in-place DROPOUT of what an ACTIVATION (one not fused above) wrote masks each item
+    // right after it is activated. The cpu only, a gpu activation is cudnn's.
+    for (unsigned int i = 0; i < m_forwardPath.size() && deviceUsed == DeviceType::CPU_NAIVE;)
+    {
+        OperatorDescriptor *dropout = m_operators[m_forwardPath[i]];
+
+        if (dropout->m_operatorName != OperatorName::DROPOUT ||
+                dropout->m_inputs.find("Input") == dropout->m_inputs.end() ||
+                dropout->m_outputs.find("Output") == dropout->m_outputs.end() ||
+                dropout->m_outputs.find("Seed") == dropout->m_outputs.end() ||
+                dropout->m_parameters.find("Rate") == dropout->m_parameters.end() ||
+                dropout->m_inputs["Input"].name() != dropout->m_outputs["Output"].name() ||
+                dropout->m_inputs["Input"].isReshaped() || dropout->m_outputs["Output"].isReshaped())
+        {
+            ++i;
+            continue;
+        }
+
+        const std::string &tensorName = dropout->m_inputs["Input"].name();
+        OperatorDescriptor *producer = lastToTouch(i, tensorName);
+
+        bool isFusable = producer &&
+                producer->m_operatorName == OperatorName::ACTIVATION &&
+                producer->m_outputs.find("Output") != producer->m_outputs.end() &&
+                producer->m_outputs["Output"].name() == tensorName &&
+                !producer->m_outputs["Output"].isReshaped() &&
+                producer->m_parameters.find("Dropout") == producer->m_parameters.end() &&
+                producer->m_dataType == dropout->m_dataType &&
+                producer->m_deviceId == dropout->m_deviceId;
+
+        if (!isFusable)
+        {
+            ++i;
+            continue;
+        }
+
+        producer->m_parameters["Dropout"] = std::any_cast<float>(dropout->m_parameters["Rate"]);
+        producer->m_outputs["Seed"] = dropout->m_outputs["Seed"];
+
+        if (dropout->m_outputs.find("Mask") != dropout->m_outputs.end())
+        {
+            producer->m_outputs["Mask"] = dropout->m_outputs["Mask"];
+        }
+
+        m_forwardPath.erase(m_forwardPath.begin() + i);
+    }
+
+    // whether an operator of either path other than the two given touches tensorName
+    auto isTouchedElsewhere = [this](const std::string &tensorName, const OperatorDescriptor *first, const OperatorDescriptor *second) -> bool
+    {
+        for (const std::vector<OperatorDescriptorHandle> *path : {&m_forwardPath, &m_backwardPath})
+        {
+            for (const OperatorDescriptorHandle &operatorName : *path)
+            {
+                OperatorDescriptor *candidate = m_operators[operatorName];
+
+                if (candidate == first || candidate == second)
+                {
+                    continue;
+                }
+
+                for (const std::map<std::string, TensorDescriptorHandle> *handles : {&candidate->m_inputs, &candidate->m_outputs})
+                {
+                    for (auto iter = handles->begin(); iter != handles->end(); ++iter)
+                    {
+                        if (iter->second.name() == tensorName)
+                        {
+                            return true;
+                        }
+                    }
+                }
+            }
+        }
+
+        for (auto iter = m_updatePairs.begin(); iter != m_updatePairs.end(); ++iter)
+        {
+            if (iter->first.name() == tensorName || iter->second.name() == tensorName)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    };
+
+    // An ACTIVATION_DERIVATIVE whose InputDelta only the ELEMENTWISE_ADD right after it reads is
+    // computed inside the add, in one pass, and the delta never goes to memory.
+    for (unsigned int i = 0; i + 1 < m_backwardPath.size();)
+    {
+        OperatorDescriptor *derivative = m_operators[m_backwardPath[i]];
+        OperatorDescriptor *add = m_operators[m_backwardPath[i + 1]];
+
+        if (derivative->m_operatorName != OperatorName::ACTIVATION_DERIVATIVE ||
+                add->m_operatorName != OperatorName::ELEMENTWISE_ADD ||
+                derivative->m_inputs.find("Output") == derivative->m_inputs.end() ||
+                derivative->m_inputs.find("OutputDelta") == derivative->m_inputs.end() ||
+                derivative->m_outputs.find("InputDelta") == derivative->m_outputs.end() ||
+                derivative->m_parameters.find("Mode") == derivative->m_parameters.end() ||
+                add->m_inputs.find("OperandA") == add->m_inputs.end() ||
+                add->m_inputs.find("OperandB") == add->m_inputs.end() ||
+                add->m_parameters.find("ActivationDerivative") != add->m_parameters.end() ||
+                derivative->m_dataType != add->m_dataType || derivative->m_deviceId != add->m_deviceId ||
+                (add->m_dataType != DataType::FLOAT && add->m_dataType != DataType::DOUBLE))
+        {
+            ++i;
+            continue;
+        }
+
+        const TensorDescriptorHandle &inputDelta = derivative->m_outputs["InputDelta"];
+        bool isOperandA = add->m_inputs["OperandA"].name() == inputDelta.name();
+        bool isOperandB = add->m_inputs["OperandB"].name() == inputDelta.name();
+        ActivationMode mode = std::any_cast<ActivationMode>(derivative->m_parameters["Mode"]);
+
+        bool isFusable = isOperandA != isOperandB && !inputDelta.isReshaped() &&
+                !add->m_inputs[isOperandA ? "OperandA" : "OperandB"].isReshaped() &&
+                !isTouchedElsewhere(inputDelta.name(), derivative, add) &&
+                (deviceUsed == DeviceType::GPU_CUDA || (deviceUsed == DeviceType::CPU_NAIVE && isActivationImplementedCPU(mode)));
+
+        if (!isFusable)
+        {
+            ++i;
+            continue;
+        }
+
+        add->m_inputs.erase(isOperandA ? "OperandA" : "OperandB");
+        add->m_inputs["Output"] = derivative->m_inputs["Output"];
+        add->m_inputs["OutputDelta"] = derivative->m_inputs["OutputDelta"];
+        add->m_parameters["ActivationDerivative"] = mode;
+        add->m_parameters["DerivativeOperand"] = std::string(isOperandA ? "OperandA" : "OperandB");
+
+        m_backwardPath.erase(m_backwardPath.begin() + i);
+    }
+}
+
+void FreeWill::Model::planLayouts()
+{
+    TensorLayout layout = preferredChannelBlockedLayoutCPU();
+    unsigned int blockSize = channelBlockSize(layout);
+
+    // planned by an earlier init or a loaded graph
+    for (auto iter = m_operators.begin(); iter != m_operators.end(); ++iter)
+    {
+        if (iter->second->m_operatorName == OperatorName::LAYOUT_TRANSFORM)
+        {
+            return;
+        }
+    }
+
+    for (auto iter = m_tensors.begin(); iter != m_tensors.end(); ++iter)
+    {
+        if (iter->second->m_layout != TensorLayout::CHANNEL_LAST)
+        {
+            return;
+        }
+    }
+
+    // a reshaped handle walks the elements in the CHANNEL_LAST order
+    std::set<std::string> reshapedTensors;
+
+    for (auto iter = m_operators.begin(); iter != m_operators.end(); ++iter)
+    {
+        for (const std::map<std::string, TensorDescriptorHandle> *handles : {&iter->second->m_inputs, &iter->second->m_outputs})
+        {
+            for (auto handle = handles->begin(); handle != handles->end(); ++handle)
+            {
+                if (handle->second.isReshaped())
+                {
+                    reshapedTensors.insert(handle->second.name());
+                }
+            }
+        }
+    }
+
+    auto isBlockableImage = [&](const std::map<std::string, TensorDescriptorHandle> &handles, const std::string &slot)
+    {
+        auto handle = handles.find(slot);
+
+        if (handle == handles.end() || m_tensors.find(handle->second.name()) == m_tensors.end() ||
+                reshapedTensors.find(handle->second.name()) != reshapedTensors.end())
+        {
+            return false;
+        }
+
+        TensorDescriptor *tensor = m_tensors[handle->second.name()];
+
+        return tensor->m_isBatchTensor && !tensor->m_isRandomlyInitialized &&
+                tensor->m_shape.dimension() == 3 && tensor->m_shape[0] % blockSize == 0;
+    };
+
+    auto isBlockable = [&](OperatorDescriptor *operatorDescriptor)
+    {
+        switch (operatorDescriptor->m_operatorName)
+        {
+        case OperatorName::CONVOLUTION:
+            // the grouped and depthwise kernels read channel last tensors
+            if (operatorDescriptor->m_parameters.find("Quantized") != operatorDescriptor->m_parameters.end() ||
+                    (operatorDescriptor->m_parameters.find("GroupCount") != operatorDescriptor->m_parameters.end() &&
+                     std::any_cast<unsigned int>(operatorDescriptor->m_parameters["GroupCount"]) != 1))
+            {
+                return false;
+            }
+            break;
+        case OperatorName::ACTIVATION:
+        case OperatorName::MAX_POOLING:
+            break;
+        default:
+            return false;
+        }
+
+        if ((operatorDescriptor->m_dataType != DataType::FLOAT && operatorDescriptor->m_dataType != DataType::DOUBLE) ||
+                !isBlockableImage(operatorDescriptor->m_inputs, "Input") || !isBlockableImage(operatorDescriptor->m_outputs, "Output"))
+        {
+            return false;
+        }
+
+        // the rows of switches, see MaxPooling::init
+        return operatorDescriptor->m_operatorName != OperatorName::MAX_POOLING ||
+                (blockSize * m_tensors[operatorDescriptor->m_outputs["Output"].name()]->m_shape[1]) % MAX_POOLING_SWITCHES_PER_WORD == 0;
+    };
+
+    // an activation only runs blocked after a blocked producer, not to block for itself
+    std::vector<bool> isBlocked(m_forwardPath.size(), false);
+    std::map<std::string, bool> isWrittenBlocked;
+
+    for (unsigned int i = 0; i < m_forwardPath.size(); ++i)
+    {
+        OperatorDescriptor *operatorDescriptor = m_operators[m_forwardPath[i]];
+
+        isBlocked[i] = isBlockable(operatorDescriptor);
+
+        if (isBlocked[i] && operatorDescriptor->m_operatorName == OperatorName::ACTIVATION)
+        {
+            auto writer = isWrittenBlocked.find(operatorDescriptor->m_inputs["Input"].name());
+            isBlocked[i] = writer != isWrittenBlocked.end() && writer->second;
+        }
+
+        for (auto iter = operatorDescriptor->m_outputs.begin(); iter != operatorDescriptor->m_outputs.end(); ++iter)
+        {
+            isWrittenBlocked[iter->second.name()] = isBlocked[i];
+        }
+    }
+
+    // what an operator of the path does to each of its tensors, an output it accumulates into
+    // is read too. The blocked operators all overwrite.
+    struct TensorAccess
+    {
+        bool isRead = false;
+        bool isWritten = false;
+        bool isBlocked = false;
+    };
+
+    auto tensorAccesses = [&](unsigned int i)
+    {
+        OperatorDescriptor *operatorDescriptor = m_operators[m_forwardPath[i]];
+        std::map<std::string, TensorAccess> accesses;
+
+        for (auto iter = operatorDescriptor->m_inputs.begin(); iter != operatorDescriptor->m_inputs.end(); ++iter)
+        {
+            TensorAccess &access = accesses[iter->second.name()];
+            access.isRead = true;
+            access.isBlocked |= isBlocked[i] && iter->first == "Input";
+        }
+
+        for (auto iter = operatorDescriptor->m_outputs.begin(); iter != operatorDescriptor->m_outputs.end(); ++iter)
+        {
+            TensorAccess &access = accesses[iter->second.name()];
+            access.isWritten = true;
+            access.isRead |= !isBlocked[i] && !operatorDescriptor->overwritesOutput(iter->first);
+            access.isBlocked |= isBlocked[i] && iter->first == "Output";
+        }
+
+        return accesses;
+    };
+
+    // A tensor can be blocked in place when only blocked operators use it, the path writes it
+    // before reading it and reads it last: neither the caller's input nor what it reads back.
+    struct TensorUse
+    {
+        bool isUsedBlocked = false;
+        bool isUsedLast = false;
+        bool isProduced = false;
+        bool isReadLast = false;
+    };
+
+    std::map<std::string, TensorUse> uses;
+
+    for (unsigned int i = 0; i < m_forwardPath.size(); ++i)
+    {
+        std::map<std::string, TensorAccess> accesses = tensorAccesses(i);
+
+        for (auto iter = accesses.begin(); iter != accesses.end(); ++iter)
+        {
+            bool isFirstUse = uses.find(iter->first) == uses.end();
+            TensorUse &use = uses[iter->first];
+
+            if (isFirstUse)
+            {
+                use.isProduced = iter->second.isWritten && !iter->second.isRead;
+            }
+
+            use.isReadLast = iter->second.isRead && !iter->second.isWritten;
+            (iter->second.isBlocked ? use.isUsedBlocked : use.isUsedLast) = true;
+        }
+    }
+
+    std::map<std::string, std::string> blockedCopies;
+
+    for (auto iter = uses.begin(); iter != uses.end(); ++iter)
+    {
+        if (!iter->second.isUsedBlocked)
+        {
+            continue;
+        }
+
+        TensorDescriptor *tensor = m_tensors[iter->first];
+
+        if (!iter->second.isUsedLast && iter->second.isProduced && iter->second.isReadLast)
+        {
+            tensor->m_layout = layout;
+            continue;
+        }
+
+        std::string copyName = iter->first + "_blocked";
+
+        while (m_tensors.find(copyName) != m_tensors.end())
+        {
+            copyName += "_";
+        }
+
+        addTensor(copyName, tensor->m_shape, tensor->m_dataType, tensor->m_isBatchTensor);
+        m_tensors[copyName]->m_deviceIds = tensor->m_deviceIds;
+        m_tensors[copyName]->m_layout = layout;
+        blockedCopies[iter->first] = copyName;
+    }
+
+    std::map<std::string, std::string> copiedTensors;
+
+    for (auto iter = blockedCopies.begin(); iter != blockedCopies.end(); ++iter)
+    {
+        copiedTensors[iter->second] = iter->first;
+    }
+
+    for (unsigned int i = 0; i < m_forwardPath.size(); ++i)
+    {
+        if (!isBlocked[i])
+        {
+            continue;
+        }
+
+        OperatorDescriptor *operatorDescriptor = m_operators[m_forwardPath[i]];
+
+        for (TensorDescriptorHandle *handle : {&operatorDescriptor->m_inputs["Input"], &operatorDescriptor->m_outputs["Output"]})
+        {
+            if (blockedCopies.find(handle->name()) != blockedCopies.end())
+            {
+                *handle = TensorDescriptorHandle(this, blockedCopies[handle->name()], Shape());
+            }
+        }
+    }
+
+    // Which of a copied tensor and its copy hold the current values. A read of the stale one
+    // transforms the other first.
+    enum class Freshness
+    {
+        LAST,
+        BLOCKED,
+        BOTH
+    };
+
+    std::map<std::string, Freshness> freshness;
+    std::vector<OperatorDescriptorHandle> forwardPath;
+    unsigned int transformCount = 0;
+
+    auto addTransform = [&](const std::string &tensorName, bool isToBlocked)
+    {
+        const std::string &copyName = blockedCopies[tensorName];
+        std::string name = (isToBlocked ? "LayoutTransformTo_" : "LayoutTransformFrom_") + copyName + "_" + std::to_string(transformCount++);
+
+        addOperator(name, OperatorName::LAYOUT_TRANSFORM,
+                    {{"Input", TensorDescriptorHandle(this, isToBlocked ? tensorName : copyName, Shape())}},
+                    {{"Output", TensorDescriptorHandle(this, isToBlocked ? copyName : tensorName, Shape())}},
+                    {}, m_tensors[tensorName]->m_dataType);
+        forwardPath.push_back(name);
+    };
+
+    for (auto iter = blockedCopies.begin(); iter != blockedCopies.end(); ++iter)
+    {
+        freshness[iter->first] = Freshness::LAST;
+    }
+
+    for (unsigned int i = 0; i < m_forwardPath.size(); ++i)
+    {
+        std::map<std::string, TensorAccess> accesses = tensorAccesses(i);
+
+        for (auto iter = accesses.begin(); iter != accesses.end(); ++iter)
+        {
+            bool isCopy = copiedTensors.find(iter->first) != copiedTensors.end();
+            const std::string &tensorName = isCopy ? copiedTensors[iter->first] : iter->first;
+
+            if (!iter->second.isRead || freshness.find(tensorName) == freshness.end())
+            {
+                continue;
+            }
+
+            if (freshness[tensorName] == (isCopy ? Freshness::LAST : Freshness::BLOCKED))
+            {
+                addTransform(tensorName, isCopy);
+                freshness[tensorName] = Freshness::BOTH;
+            }
+        }
+
+        forwardPath.push_back(m_forwardPath[i]);
+
+        for (auto iter = accesses.begin(); iter != accesses.end(); ++iter)
+        {
+            bool isCopy = copiedTensors.find(iter->first) != copiedTensors.end();
+            const std::string &tensorName = isCopy ? copiedTensors[iter->first] : iter->first;
+
+            if (iter->second.isWritten && freshness.find(tensorName) != freshness.end())
+            {
+                freshness[tensorName] = isCopy ? Freshness::BLOCKED : Freshness::LAST;
+            }
+        }
+    }
+
+    // the caller reads the CHANNEL_LAST one
+    for (auto iter = freshness.begin(); iter != freshness.end(); ++iter)
+    {
+        if (iter->second == Freshness::BLOCKED)
+        {
+            addTransform(iter->first, false);
+        }
+    }
+
+    m_forwardPath = forwardPath;
+}
+
+std::set<std::string> FreeWill::Model::forwardTensors()
+{
+    std::set<std::string> tensorNames;
+
+    for (auto iter = m_forwardPath.begin(); iter != m_forwardPath.end(); ++iter)
+    {
+        OperatorDescriptor *operatorDescriptor = m_operators[*iter];
+
+        for (const std::map<std::string, TensorDescriptorHandle> *handles : {&operatorDescriptor->m_inputs, &operatorDescriptor->m_outputs})
+        {
+            for (auto handle = handles->begin(); handle != handles->end(); ++handle)
+            {
+                tensorNames.insert(handle->second.name());
+            }
+        }
+    }
+
+    return tensorNames;
+}
+
+std::map<std::string, std::string> FreeWill::Model::inPlaceActivations()
+{
+    std::map<std::string, std::string> aliases;
+
+    for (unsigned int i = 0; i < m_forwardPath.size(); ++i)
+    {
+        OperatorDescriptor *activation = m_operators[m_forwardPath[i]];
+
+        if (activation->m_operatorName != OperatorName::ACTIVATION ||
+                activation->m_inputs.find("Input") == activation->m_inputs.end() ||
+                activation->m_outputs.find("Output") == activation->m_outputs.end())
+        {
+            continue;
+        }
+
+        const TensorDescriptorHandle &inputHandle = activation->m_inputs["Input"];
+        const TensorDescriptorHandle &outputHandle = activation->m_outputs["Output"];
+
+        if (inputHandle.name() == outputHandle.name() || inputHandle.isReshaped() || outputHandle.isReshaped())
+        {
+            continue;
+        }
+
+        TensorDescriptor *input = m_tensors[inputHandle.name()];
+        TensorDescriptor *output = m_tensors[outputHandle.name()];
+
+        if (input->m_shape != output->m_shape || input->m_dataType != output->m_dataType ||
+                input->m_isBatchTensor != output->m_isBatchTensor || input->m_deviceIds != output->m_deviceIds ||
+                input->m_layout != output->m_layout ||
+                input->m_isRandomlyInitialized || output->m_isRandomlyInitialized)
+        {
+            continue;
+        }
+
+        // the caller fills the tensors nobody writes before, those are not ours to overwrite
+        bool isProduced = false;
+        bool isUsedLater = false;
+
+        for (unsigned int j = 0; j < m_forwardPath.size(); ++j)
+        {
+            OperatorDescriptor *other = m_operators[m_forwardPath[j]];
+
+            for (const std::map<std::string, TensorDescriptorHandle> *handles : {&other->m_inputs, &other->m_outputs})
+            {
+                for (auto iter = handles->begin(); iter != handles->end(); ++iter)
+                {
+                    if (iter->second.name() != input->m_name)
+                    {
+                        continue;
+                    }
+
+                    isProduced |= j < i && handles == &other->m_outputs;
+                    isUsedLater |= j > i;
+                }
+            }
+        }
+
+        if (isProduced && !isUsedLater && aliases.find(output->m_name) == aliases.end())
+        {
+            aliases[output->m_name] = input->m_name;
+        }
+    }
+
+    return aliases;
+}
+
+FreeWill::MemoryCategory FreeWill::Model::memoryCategory(const std::string &tensorName)
+{
+    for (auto iter = m_updatePairs.begin(); iter != m_updatePairs.end(); ++iter)
+    {
+        if (iter->first.name() == tensorName)
+        {
+            return MemoryCategory::WEIGHT;
+        }
+
+        if (iter->second.name() == tensorName)
+        {
+            return MemoryCategory::GRADIENT;
+        }
+    }
+
+    // an accumulator is filed with its gradient, the rest the solver keeps for a weight
+    auto companion = m_companionTensors.find(tensorName);
+    if (companion != m_companionTensors.end())
+    {
+        return memoryCategory(companion->second) == MemoryCategory::GRADIENT ? MemoryCategory::GRADIENT : MemoryCategory::OPTIMIZER_STATE;
+    }
+
+    auto tensor = m_tensors.find(tensorName);
+    if (tensor != m_tensors.end() && tensor->second->m_isBatchTensor)
+    {
+        return MemoryCategory::ACTIVATION;
+    }
+
+    return MemoryCategory::OTHER;
+}
+
+void FreeWill::Model::skipDropouts()
+{
+    for (unsigned int i = 0; i < m_forwardPath.size();)
+    {
+        OperatorDescriptor *dropout = m_operators[m_forwardPath[i]];
+
+        if (dropout->m_operatorName == OperatorName::DROPOUT &&
+                dropout->m_inputs.find("Input") != dropout->m_inputs.end() &&
+                dropout->m_outputs.find("Output") != dropout->m_outputs.end() &&
+                dropout->m_inputs["Input"].name() == dropout->m_outputs["Output"].name())
+        {
+            m_forwardPath.erase(m_forwardPath.begin() + i);
+            continue;
+        }
+
+        ++i;
+    }
+}
+
+bool FreeWill::Model::planRecomputation()
+{
+    std::vector<std::vector<OperatorDescriptorHandle>> segments;
+    segments.swap(m_checkpointSegments);
+
+    std::set<std::string> updatedTensors;
+    for (auto iter = m_updatePairs.begin(); iter != m_updatePairs.end(); ++iter)
+    {
+        updatedTensors.insert(iter->first.name());
+        updatedTensors.insert(iter->second.name());
+    }
+
+    // the recomputations to run before each operator of the backward path
+    std::map<std::string, std::vector<OperatorDescriptorHandle>> recomputations;
+
+    auto copyHandle = [&](const TensorDescriptorHandle &handle, const std::string &copyName)
+    {
+        TensorDescriptorHandle copy(this, copyName, Shape());
+        return handle.isReshaped() ? copy.reshape(handle.shape()) : copy;
+    };
+
+    for (const std::vector<OperatorDescriptorHandle> &segment : segments)
+    {
+        // what fuseOperators left of the segment, still a run of the forward path
+        std::vector<unsigned int> positions;
+
+        for (const OperatorDescriptorHandle &operatorName : segment)
+        {
+            auto iter = std::find(m_forwardPath.begin(), m_forwardPath.end(), operatorName);
+
+            if (iter != m_forwardPath.end())
+            {
+                positions.push_back(iter - m_forwardPath.begin());
+            }
+        }
+
+        if (positions.empty())
+        {
+            continue;
+        }
+
+        unsigned int first = positions.front();
+        unsigned int last = positions.back();
+
+        if (last - first + 1 != positions.size())
+        {
+            std::cerr << "checkpointed segment at " << m_forwardPath[first] << " isn't a run of the forward path" << std::endl;
+            return false;
+        }
+
+        std::set<std::string> usedBefore;
+        std::set<std::string> usedAfter;
+
+        for (unsigned int i = 0; i < m_forwardPath.size(); ++i)
+        {
+            if (i >= first && i <= last)
+            {
+                continue;
+            }
+
+            OperatorDescriptor *operatorDescriptor = m_operators[m_forwardPath[i]];
+
+            for (const std::map<std::string, TensorDescriptorHandle> *handles : {&operatorDescriptor->m_inputs, &operatorDescriptor->m_outputs})
+            {
+                for (auto iter = handles->begin(); iter != handles->end(); ++iter)
+                {
+                    (i < first ? usedBefore : usedAfter).insert(iter->second.name());
+                }
+            }
+        }
+
+        // every batch tensor the segment writes gets a copy for its recomputation, the segment
+        // has to produce them all from its inputs. The seed of a dropout is replayed, not copied.
+        std::map<std::string, std::string> copies;
+        std::set<std::string> readFirst;
+
+        for (unsigned int i = first; i <= last; ++i)
+        {
+            OperatorDescriptor *operatorDescriptor = m_operators[m_forwardPath[i]];
+
+            for (auto iter = operatorDescriptor->m_inputs.begin(); iter != operatorDescriptor->m_inputs.end(); ++iter)
+            {
+                if (copies.find(iter->second.name()) == copies.end())
+                {
+                    readFirst.insert(iter->second.name());
+                }
+            }
+
+            for (auto iter = operatorDescriptor->m_outputs.begin(); iter != operatorDescriptor->m_outputs.end(); ++iter)
+            {
+                const std::string &tensorName = iter->second.name();
+                TensorDescriptor *tensor = m_tensors[tensorName];
+
+                if (!tensor->m_isBatchTensor && iter->first == "Seed")
+                {
+                    continue;
+                }
+
+                if (!tensor->m_isBatchTensor || tensor->m_isRandomlyInitialized || updatedTensors.find(tensorName) != updatedTensors.end() ||
+                        usedBefore.find(tensorName) != usedBefore.end() ||
+                        (copies.find(tensorName) == copies.end() && readFirst.find(tensorName) != readFirst.end()) ||
+                        (!operatorDescriptor->overwritesOutput(iter->first) && operatorDescriptor->m_operatorName != OperatorName::CONVOLUTION))
+                {
+                    std::cerr << "can't checkpoint " << m_forwardPath[i] << ", it can't write " << tensorName << " again" << std::endl;
+                    return false;
+                }
+
+                if (copies.find(tensorName) == copies.end())
+                {
+                    std::string copyName = tensorName + "_recomputed";
+
+                    while (m_tensors.find(copyName) != m_tensors.end())
+                    {
+                        copyName += "_";
+                    }
+
+                    copies[tensorName] = copyName;
+                }
+            }
+        }
+
+        std::set<std::string> internalTensors;
+
+        for (auto iter = copies.begin(); iter != copies.end(); ++iter)
+        {
+            if (usedAfter.find(iter->first) == usedAfter.end())
+            {
+                internalTensors.insert(iter->first);
+            }
+        }
+
+        // the backward operators read the copies, the recomputation runs before the first one
+        std::set<std::string> neededCopies;
+        int firstReader = -1;
+
+        for (unsigned int i = 0; i < m_backwardPath.size(); ++i)
+        {
+            OperatorDescriptor *operatorDescriptor = m_operators[m_backwardPath[i]];
+
+            for (std::map<std::string, TensorDescriptorHandle> *handles : {&operatorDescriptor->m_inputs, &operatorDescriptor->m_outputs})
+            {
+                for (auto iter = handles->begin(); iter != handles->end(); ++iter)
+                {
+                    if (internalTensors.find(iter->second.name()) == internalTensors.end())
+                    {
+                        continue;
+                    }
+
+                    const std::string &copyName = copies[iter->second.name()];
+                    iter->second = copyHandle(iter->second, copyName);
+                    neededCopies.insert(copyName);
+
+                    if (firstReader < 0)
+                    {
+                        firstReader = i;
+                    }
+                }
+            }
+        }
+
+        if (firstReader < 0)
+        {
+            continue;
+        }
+
+        // the segment operators writing what is needed, last to first
+        std::vector<bool> isRecomputed(last - first + 1, false);
+
+        for (unsigned int i = last + 1; i-- > first;)
+        {
+            OperatorDescriptor *operatorDescriptor = m_operators[m_forwardPath[i]];
+
+            for (auto iter = operatorDescriptor->m_outputs.begin(); iter != operatorDescriptor->m_outputs.end(); ++iter)
+            {
+                auto copy = copies.find(iter->second.name());
+
+                if (copy != copies.end() && neededCopies.find(copy->second) != neededCopies.end())
+                {
+                    isRecomputed[i - first] = true;
+                }
+            }
+
+            if (!isRecomputed[i - first])
+            {
+                continue;
+            }
+
+            for (auto iter = operatorDescriptor->m_inputs.begin(); iter != operatorDescriptor->m_inputs.end(); ++iter)
+            {
+                if (copies.find(iter->second.name()) != copies.end())
+                {
+                    neededCopies.insert(copies[iter->second.name()]);
+                }
+            }
+        }
+
+        std::vector<OperatorDescriptorHandle> &recomputation = recomputations[m_backwardPath[firstReader]];
+
+        for (unsigned int i = first; i <= last; ++i)
+        {
+            if (!isRecomputed[i - first])
+            {
+                continue;
+            }
+
+            OperatorDescriptor *operatorDescriptor = m_operators[m_forwardPath[i]];
+            std::map<std::string, TensorDescriptorHandle> inputs = operatorDescriptor->m_inputs;
+            std::map<std::string, TensorDescriptorHandle> outputs = operatorDescriptor->m_outputs;
+
+            for (std::map<std::string, TensorDescriptorHandle> *handles : {&inputs, &outputs})
+            {
+                for (auto iter = handles->begin(); iter != handles->end(); ++iter)
+                {
+                    if (copies.find(iter->second.name()) == copies.end())
+                    {
+                        continue;
+                    }
+
+                    const std::string &copyName = copies[iter->second.name()];
+
+                    if (m_tensors.find(copyName) == m_tensors.end())
+                    {
+                        TensorDescriptor *tensor = m_tensors[iter->second.name()];
+                        addTensor(copyName, tensor->m_shape, tensor->m_dataType, tensor->m_isBatchTensor);
+                        m_tensors[copyName]->m_layout = tensor->m_layout;
+                    }
+
+                    iter->second = copyHandle(iter->second, copyName);
+                    m_recomputedTensors.insert(copyName);
+                }
+            }
+
+            // the copy overwrites what it writes and draws the masks the forward pass drew
+            std::map<std::string, std::any> parameters = operatorDescriptor->m_parameters;
+
+            if (operatorDescriptor->m_operatorName == OperatorName::CONVOLUTION)
+            {
+                parameters["ClearOutput"] = true;
+            }
+            else if (operatorDescriptor->m_operatorName == OperatorName::DROPOUT ||
+                     operatorDescriptor->m_operatorName == OperatorName::ACTIVATION)
+            {
+                parameters["Replay"] = true;
+            }
+
+            std::string name = m_forwardPath[i] + "_recompute";
+
+            while (m_operators.find(name) != m_operators.end())
+            {
+                name += "_";
+            }
+
+            addOperator(name, operatorDescriptor->m_operatorName, inputs, outputs, parameters, operatorDescriptor->m_dataType);
+            m_operators[name]->m_plans = operatorDescriptor->m_plans;
+            m_operators[name]->m_deviceId = operatorDescriptor->m_deviceId;
+            m_operators[name]->m_isInference = operatorDescriptor->m_isInference;
+            recomputation.push_back(name);
+        }
+
+        m_recomputedTensors.insert(internalTensors.begin(), internalTensors.end());
+    }
+
+    std::vector<OperatorDescriptorHandle> backwardPath;
+
+    for (const OperatorDescriptorHandle &operatorName : m_backwardPath)
+    {
+        if (recomputations.find(operatorName) != recomputations.end())
+        {
+            backwardPath.insert(backwardPath.end(), recomputations[operatorName].begin(), recomputations[operatorName].end());
+        }
+
+        backwardPath.push_back(operatorName);
+    }
+
+    m_backwardPath = backwardPath;
+
+    return true;
+}
+
+bool FreeWill::Model::planActivationCompression(ActivationCompression compression)
+{
+    std::set<std::string> updatedTensors;
+    for (auto iter = m_updatePairs.begin(); iter != m_updatePairs.end(); ++iter)
+    {
+        updatedTensors.insert(iter->first.name());
+        updatedTensors.insert(iter->second.name());
+    }
+
+    auto copyHandle = [&](const TensorDescriptorHandle &handle, const std::string &copyName)
+    {
+        TensorDescriptorHandle copy(this, copyName, Shape());
+        return handle.isReshaped() ? copy.reshape(handle.shape()) : copy;
+    };
+
+    auto uniqueName = [](const std::string &name, const auto &names)
+    {
+        std::string uniqueName = name;
+
+        while (names.find(uniqueName) != names.end())
+        {
+            uniqueName += "_";
+        }
+
+        return uniqueName;
+    };
+
+    // a max pooling derivative finds the window of each output in the switches alone
+    for (const OperatorDescriptorHandle &operatorName : m_backwardPath)
+    {
+        OperatorDescriptor *derivative = m_operators[operatorName];
+
+        if (derivative->m_operatorName != OperatorName::MAX_POOLING_DERIVATIVE)
+        {
+            continue;
+        }
+
+        for (const OperatorDescriptorHandle &forwardName : m_forwardPath)
+        {
+            OperatorDescriptor *pooling = m_operators[forwardName];
+
+            if (pooling->m_operatorName != OperatorName::MAX_POOLING || pooling->m_outputs.find("Switch") == pooling->m_outputs.end())
+            {
+                continue;
+            }
+
+            auto isShared = [&](const std::string &inputName, const std::string &outputName)
+            {
+                return derivative->m_inputs.find(inputName) != derivative->m_inputs.end() &&
+                        pooling->m_outputs.find(outputName) != pooling->m_outputs.end() &&
+                        derivative->m_inputs[inputName].name() == pooling->m_outputs[outputName].name();
+            };
+
+            if (!isShared("Switch", "Switch") && !(derivative->m_inputs.find("Switch") == derivative->m_inputs.end() && isShared("Output", "Output")))
+            {
+                continue;
+            }
+
+            derivative->m_inputs["Switch"] = pooling->m_outputs["Switch"];
+            derivative->m_inputs.erase("Input");
+            derivative->m_inputs.erase("Output");
+            pooling->m_parameters["WriteSwitch"] = true;
+            break;
+        }
+    }
+
+    // the last forward operator writing each tensor, the tensors the backward path writes
+    std::map<std::string, unsigned int> lastWriters;
+    std::set<std::string> backwardWritten;
+
+    for (unsigned int i = 0; i < m_forwardPath.size(); ++i)
+    {
+        OperatorDescriptor *operatorDescriptor = m_operators[m_forwardPath[i]];
+
+        for (auto iter = operatorDescriptor->m_outputs.begin(); iter != operatorDescriptor->m_outputs.end(); ++iter)
+        {
+            lastWriters[iter->second.name()] = i;
+        }
+    }
+
+    for (const OperatorDescriptorHandle &operatorName : m_backwardPath)
+    {
+        OperatorDescriptor *operatorDescriptor = m_operators[operatorName];
+
+        for (auto iter = operatorDescriptor->m_outputs.begin(); iter != operatorDescriptor->m_outputs.end(); ++iter)
+        {
+            backwardWritten.insert(iter->second.name());
+        }
+    }
+
+    // the compressions to run after each position of the forward path, the decompressions
+    // before each operator of the backward path
+    std::map<unsigned int, std::vector<OperatorDescriptorHandle>> compressions;
+    std::map<std::string, std::vector<OperatorDescriptorHandle>> decompressions;
+
+    for (unsigned int i = 0; i < m_backwardPath.size(); ++i)
+    {
+        OperatorDescriptor *derivative = m_operators[m_backwardPath[i]];
+
+        if (derivative->m_operatorName != OperatorName::ACTIVATION_DERIVATIVE ||
+                derivative->m_parameters.find("Mode") == derivative->m_parameters.end() ||
+                std::any_cast<ActivationMode>(derivative->m_parameters["Mode"]) != ActivationMode::RELU ||
+                derivative->m_inputs.find("Output") == derivative->m_inputs.end())
+        {
+            continue;
+        }
+
+        std::string tensorName = derivative->m_inputs["Output"].name();
+        TensorDescriptor *tensor = m_tensors[tensorName];
+
+        if (!tensor->m_isBatchTensor || tensor->m_isRandomlyInitialized || tensor->m_dataType == DataType::UNSIGNED_INT ||
+                updatedTensors.find(tensorName) != updatedTensors.end() ||
+                lastWriters.find(tensorName) == lastWriters.end() || backwardWritten.find(tensorName) != backwardWritten.end())
+        {
+            continue;
+        }
+
+        // the other backward operators reading the output keep it unless they can read it as Half
+        std::vector<unsigned int> readers;
+
+        for (unsigned int j = 0; j < m_backwardPath.size(); ++j)
+        {
+            OperatorDescriptor *operatorDescriptor = m_operators[m_backwardPath[j]];
+
+            for (auto iter = operatorDescriptor->m_inputs.begin(); j != i && iter != operatorDescriptor->m_inputs.end(); ++iter)
+            {
+                if (iter->second.name() == tensorName)
+                {
+                    readers.push_back(j);
+                    break;
+                }
+            }
+        }
+
+        bool isHalf = !readers.empty();
+
+        if (isHalf && (compression != ActivationCompression::HALF || tensor->m_dataType != DataType::FLOAT))
+        {
+            continue;
+        }
+
+        OperatorDescriptor *writer = m_operators[m_forwardPath[lastWriters[tensorName]]];
+
+        std::string maskName = uniqueName(tensorName + "_mask", m_tensors);
+        TensorDescriptorHandle mask = addTensor(maskName, {dropoutWordsPerItem(tensor->m_shape.size())}, DataType::UNSIGNED_INT, true);
+        std::map<std::string, TensorDescriptorHandle> outputs = {{"Mask", mask}};
+
+        if (isHalf)
+        {
+            std::string halfName = uniqueName(tensorName + "_half", m_tensors);
+            outputs["Values"] = addTensor(halfName, tensor->m_shape, DataType::HALF, true);
+        }
+
+        std::string compressName = uniqueName(tensorName + "_compress", m_operators);
+        addOperator(compressName, OperatorName::COMPRESS_ACTIVATION, {{"Input", TensorDescriptorHandle(this, tensorName, Shape())}}, outputs,
+                    {}, tensor->m_dataType);
+        m_operators[compressName]->m_deviceId = writer->m_deviceId;
+        m_operators[compressName]->m_isInference = writer->m_isInference;
+        compressions[lastWriters[tensorName]].push_back(compressName);
+
+        // the masked derivative doesn't read the input either
+        derivative->m_inputs.erase("Input");
+        derivative->m_inputs.erase("Output");
+        derivative->m_inputs["OutputMask"] = mask;
+
+        if (!isHalf)
+        {
+            continue;
+        }
+
+        std::string decompressedName = uniqueName(tensorName + "_decompressed", m_tensors);
+        addTensor(decompressedName, tensor->m_shape, tensor->m_dataType, true);
+        m_tensors[decompressedName]->m_layout = tensor->m_layout;
+
+        for (unsigned int j : readers)
+        {
+            OperatorDescriptor *operatorDescriptor = m_operators[m_backwardPath[j]];
+
+            for (auto iter = operatorDescriptor->m_inputs.begin(); iter != operatorDescriptor->m_inputs.end(); ++iter)
+            {
+                if (iter->second.name() == tensorName)
+                {
+                    iter->second = copyHandle(iter->second, decompressedName);
+                }
+            }
+        }
+
+        std::string decompressName = uniqueName(tensorName + "_decompress", m_operators);
+        addOperator(decompressName, OperatorName::DECOMPRESS_ACTIVATION, {{"Values", outputs["Values"]}},
+                    {{"Output", TensorDescriptorHandle(this, decompressedName, Shape())}}, {}, tensor->m_dataType);
+        m_operators[decompressName]->m_deviceId = m_operators[m_backwardPath[readers.front()]]->m_deviceId;
+        m_operators[decompressName]->m_isInference = writer->m_isInference;
+        decompressions[m_backwardPath[readers.front()]].push_back(decompressName);
+    }
+
+    std::vector<OperatorDescriptorHandle> forwardPath;
+
+    for (unsigned int i = 0; i < m_forwardPath.size(); ++i)
+    {
+        forwardPath.push_back(m_forwardPath[i]);
+
+        if (compressions.find(i) != compressions.end())
+        {
+            forwardPath.insert(forwardPath.end(), compressions[i].begin(), compressions[i].end());
+        }
+    }
+
+    std::vector<OperatorDescriptorHandle> backwardPath;
+
+    for (const OperatorDescriptorHandle &operatorName : m_backwardPath)
+    {
+        if (decompressions.find(operatorName) != decompressions.end())
+        {
+            backwardPath.insert(backwardPath.end(), decompressions[operatorName].begin(), decompressions[operatorName].end());
+        }
+
+        backwardPath.push_back(operatorName);
+    }
+
+    m_forwardPath = forwardPath;
+    m_backwardPath = backwardPath;
+
+    return true;
+}
+
+bool FreeWill::Model::init(Solver const &solver)
+{
+    if (m_sharedWeights && solver.m_mode == SolverMode::TRAINING)
+    {
+        std::cerr << "shared weights are read only, a training solver can't use them" << std::endl;
+        return false;
+    }
+
+    for (auto iter = m_operators.begin(); iter != m_operators.end(); ++iter)
+    {
+        iter->second->m_isInference = solver.m_mode != SolverMode::TRAINING;
+    }
+
+    if (solver.m_mode != SolverMode::TRAINING)
+    {
+        skipDropouts();
+    }
+
+    if (solver.m_fuseOperators)
+    {
+        fuseOperators(solver.m_deviceUsed);
+    }
+
+    if (solver.m_blockChannels && solver.m_deviceUsed == DeviceType::CPU_NAIVE && solver.m_mode == SolverMode::INFERENCE && !isPipelined())
+    {
+        planLayouts();
+    }
+
+    if (solver.m_mode == SolverMode::TRAINING && solver.m_planMemory && !isPipelined() && !planRecomputation())
+    {
+        return false;
+    }
+
+    if (solver.m_mode == SolverMode::TRAINING && solver.m_planMemory && !isPipelined() &&
+            solver.m_activationCompression != ActivationCompression::NONE && !planActivationCompression(solver.m_activationCompression))
+    {
+        return false;
+    }
+
+    // an inference solver leaves the backward operators uncreated
+    bool isForwardOnly = solver.m_mode != SolverMode::TRAINING;
+
+    if (!placeTensors(solver))
+    {
+        return false;
+    }
+
+    switch (solver.m_deviceUsed)
+    {
+    case DeviceType::CPU_NAIVE:
+        allocateTensors<FreeWill::DeviceType::CPU_NAIVE>(solver);
+
+        if (!initOperators<FreeWill::DeviceType::CPU_NAIVE>(isForwardOnly))
+        {
+            return false;
+        }
+
+        break;
+    case DeviceType::GPU_CUDA:
+        allocateTensors<FreeWill::DeviceType::GPU_CUDA>(solver);
+
+        if (!initOperators<FreeWill::DeviceType::GPU_CUDA>(isForwardOnly))
+        {
+            return false;
+        }
+
+        break;
+    default:
+        return false;
+    }
+
+    m_deviceUsed = solver.m_deviceUsed;
+    m_maxBatchSize = m_batchSize = solver.m_batchSize;
+    m_batchFirst = 0;
+
+    return true;
+}
+
+void FreeWill::Model::freeHostMirrors()
+{
+    for (auto iter = m_tensors.begin(); iter != m_tensors.end(); ++iter)
+    {
+        auto tensors = iter->second->m_tensors.find(DeviceType::GPU_CUDA);
+
+        if (tensors == iter->second->m_tensors.end())
+        {
+            continue;
+        }
+
+        for (auto tensor = tensors->second.begin(); tensor != tensors->second.end(); ++tensor)
+        {
+            std::get<TensorBase<DeviceType::GPU_CUDA>*>(*tensor)->freeHostMirror();
+        }
+    }
+}
+
+bool FreeWill::Model::shareWeights(const std::shared_ptr<SharedWeights> &sharedWeights)
+{
+    for (auto iter = m_tensors.begin(); iter != m_tensors.end(); ++iter)
+    {
+        if (iter->second->isInitialized())
+        {
+            std::cerr << "can't share weights after init" << std::endl;
+            return false;
+        }
+    }
+
+    m_sharedWeights = sharedWeights;
+
+    return true;
+}
+
+bool FreeWill::Model::placeOperators(const std::vector<OperatorDescriptorHandle> &operators, unsigned int deviceId)
+{
+    for (const OperatorDescriptorHandle &operatorName : operators)
     {
-        FreeWill::OperatorName operatorName = operatorNameTable[operatorNameString];
-
-        return addOperator(name, operatorName, inputs, outputs, properties, dataType);
+        if (m_operators.find(operatorName) == m_operators.end())
+        {
+            std::cerr << "can't place unknown operator " << operatorName << std::endl;
+            return false;
+        }
+    }
 
-        return name;
+    for (const OperatorDescriptorHandle &operatorName : operators)
+    {
+        m_operators[operatorName]->m_deviceId = deviceId;
     }
 
-    return std::string();
+    return true;
 }
 
-FreeWill::OperatorDescriptorHandle FreeWill::Model::addOperator(const std::string &name,
-                                 FreeWill::OperatorName operatorName,
-                                 const std::map<std::string, FreeWill::TensorDescriptorHandle> &inputs,
-                                 const std::map<std::string, FreeWill::TensorDescriptorHandle> &outputs,
-                                 const std::map<std::string, std::any> &properties, DataType dataType)
+bool FreeWill::Model::isPipelined() const
 {
-    if (m_operators.find(name) != m_operators.end())
+    for (auto iter = m_operators.begin(); iter != m_operators.end(); ++iter)
     {
-        return std::string();
+        if (iter->second->m_deviceId >= 0)
+        {
+            return true;
+        }
     }
 
-    OperatorDescriptor *opDescriptor = new OperatorDescriptor(name, operatorName, inputs, outputs, properties, dataType);
-
-    m_operators[name] = opDescriptor;
-
-    return name;
+    return false;
 }
 
-bool FreeWill::Model::init(Solver const &solver)
+bool FreeWill::Model::placeTensors(Solver const &solver)
 {
-    //allocating tensors
-    std::map<std::string, TensorDescriptor*>::iterator iterTensor = m_tensors.begin();
+    for (auto iter = m_tensors.begin(); iter != m_tensors.end(); ++iter)
+    {
+        iter->second->m_deviceIds.clear();
+    }
 
-    //creating operators
+    if (!isPipelined())
+    {
+        return true;
+    }
 
-    std::map<std::string, OperatorDescriptor*>::iterator iterOperator = m_operators.begin();
+    int deviceCount = solver.m_deviceUsed == DeviceType::GPU_CUDA ? Context<DeviceType::GPU_CUDA>::getSingleton().deviceCount() :
+                                                                    Context<DeviceType::CPU_NAIVE>::getSingleton().deviceCount();
 
-    switch (solver.m_deviceUsed)
+    std::set<std::string> forwardOperators(m_forwardPath.begin(), m_forwardPath.end());
+    bool isForwardOnly = solver.m_mode != SolverMode::TRAINING;
+    std::map<std::string, std::set<unsigned int>> devices;
+
+    // every operator init creates
+    for (auto iter = m_operators.begin(); iter != m_operators.end(); ++iter)
     {
-    case DeviceType::CPU_NAIVE:
-        for(;iterTensor != m_tensors.end(); ++iterTensor)
+        OperatorDescriptor *operatorDescriptor = iter->second;
+
+        if (isForwardOnly && forwardOperators.find(iter->first) == forwardOperators.end())
         {
-            std::cout << iterTensor->first << std::endl;
-            TensorDescriptor *descriptor = iterTensor->second;
-            descriptor->allocateTensor<FreeWill::DeviceType::CPU_NAIVE>(solver.m_batchSize);
+            continue;
         }
 
-        for(;iterOperator != m_operators.end(); ++iterOperator)
+        if (operatorDescriptor->m_deviceId < 0 || operatorDescriptor->m_deviceId >= deviceCount)
         {
-            std::cout << iterOperator->first << m_operators.size()<< std::endl;
-            OperatorDescriptor *descriptor = iterOperator->second;
+            std::cerr << "operator " << iter->first << " of a pipelined model isn't placed on one of the " << deviceCount << " devices" << std::endl;
+            return false;
+        }
 
-            if (!descriptor->init<FreeWill::DeviceType::CPU_NAIVE>(m_tensors))
+        for (const std::map<std::string, TensorDescriptorHandle> *handles : {&operatorDescriptor->m_inputs, &operatorDescriptor->m_outputs})
+        {
+            for (auto handle = handles->begin(); handle != handles->end(); ++handle)
             {
-                std::cerr << "failed to init operator:" << iterOperator->first;
-                return false;
+                devices[handle->second.name()].insert(operatorDescriptor->m_deviceId);
             }
         }
+    }
 
-        break;
-    case DeviceType::GPU_CUDA:
+    for (auto iter = m_companionTensors.begin(); iter != m_companionTensors.end(); ++iter)
+    {
+        devices[iter->first] = devices[iter->second];
+    }
+
+    for (auto iter = m_updatePairs.begin(); iter != m_updatePairs.end(); ++iter)
+    {
+        if (devices[iter->first.name()] != devices[iter->second.name()])
+        {
+            std::cerr << "weight " << iter->first.name() << " and its gradient " << iter->second.name() << " are used on different devices" << std::endl;
+            return false;
+        }
+    }
+
+    for (auto iter = m_tensors.begin(); iter != m_tensors.end(); ++iter)
+    {
+        std::set<unsigned int> &tensorDevices = devices[iter->first];
+
+        // not used by any operator, filled and read by the caller only
+        if (tensorDevices.empty())
+        {
+            tensorDevices.insert(0);
+        }
 
-        for(;iterTensor != m_tensors.end(); ++iterTensor)
+        // only a batch tensor has a window per micro-batch the stages can hand over
+        if (tensorDevices.size() > 1 && !iter->second->m_isBatchTensor)
         {
-            std::cout << iterTensor->first << std::endl;
-            TensorDescriptor *descriptor = iterTensor->second;
-            descriptor->allocateTensor<FreeWill::DeviceType::GPU_CUDA>(solver.m_batchSize);
+            std::cerr << "tensor " << iter->first << " is used on " << tensorDevices.size() << " devices but isn't a batch tensor" << std::endl;
+            return false;
         }
 
-        for(;iterOperator != m_operators.end(); ++iterOperator)
+        iter->second->m_deviceIds.assign(tensorDevices.begin(), tensorDevices.end());
+    }
+
+    return true;
+}
+
+bool FreeWill::Model::setBatchSize(unsigned int batchSize)
+{
+    return setBatchWindow(0, batchSize);
+}
+
+bool FreeWill::Model::setBatchWindow(unsigned int first, unsigned int count)
+{
+    if (count == 0 || first + count > m_maxBatchSize)
+    {
+        return false;
+    }
+
+    // views every batch tensor at [windowFirst, windowFirst + windowCount), the name of the
+    // first one that can't be viewed is left in failedTensor
+    auto viewTensors = [this](unsigned int windowFirst, unsigned int windowCount, std::string &failedTensor)
+    {
+        for (auto iter = m_tensors.begin(); iter != m_tensors.end(); ++iter)
         {
-            std::cout << iterOperator->first << std::endl;
-            OperatorDescriptor *descriptor = iterOperator->second;
+            TensorDescriptor *tensorDescriptor = iter->second;
+
+            if (!tensorDescriptor->m_isBatchTensor)
+            {
+                continue;
+            }
+
+            bool isViewed = false;
+
+            switch (m_deviceUsed)
+            {
+            case DeviceType::CPU_NAIVE:
+                isViewed = tensorDescriptor->setBatchWindow<DeviceType::CPU_NAIVE>(windowFirst, windowCount);
+                break;
+            case DeviceType::GPU_CUDA:
+                isViewed = tensorDescriptor->setBatchWindow<DeviceType::GPU_CUDA>(windowFirst, windowCount);
+                break;
+            }
 
-            if (!descriptor->init<FreeWill::DeviceType::GPU_CUDA>(m_tensors))
+            if (!isViewed)
             {
-                std::cout << iterOperator->first << "sanity check failed!" << std::endl;
+                failedTensor = iter->first;
                 return false;
             }
         }
 
-        break;
-    default:
+        return true;
+    };
+
+    std::string failedTensor;
+
+    if (!viewTensors(first, count, failedTensor))
+    {
+        std::cerr << "can't view tensor " << failedTensor << " at items " << first << " to " << first + count << std::endl;
+
+        // every tensor was viewed at the previous window, they all can be again
+        std::string restoredTensor;
+        viewTensors(m_batchFirst, m_batchSize, restoredTensor);
+
         return false;
     }
 
+    m_batchFirst = first;
+    m_batchSize = count;
+
     return true;
 }
 
 bool FreeWill::Model::defineForwardPath(const std::vector<FreeWill::OperatorDescriptorHandle> &forwardOperators)
 {
     m_forwardPath.clear();
+    m_memoryPlanBatchSize = 0;
 
     for(unsigned int i = 0; i<forwardOperators.size();++i)
     {
@@ -147,9 +1623,39 @@ bool FreeWill::Model::defineForwardPath(const std::vector<FreeWill::OperatorDesc
     return true;
 }
 
+bool FreeWill::Model::checkpointSegment(const std::vector<FreeWill::OperatorDescriptorHandle> &operators)
+{
+    auto first = operators.empty() ? m_forwardPath.end() : std::find(m_forwardPath.begin(), m_forwardPath.end(), operators[0]);
+
+    if (first == m_forwardPath.end() || (size_t) (m_forwardPath.end() - first) < operators.size() ||
+            !std::equal(operators.begin(), operators.end(), first))
+    {
+        std::cerr << "a checkpointed segment has to be a run of the forward path" << std::endl;
+        return false;
+    }
+
+    for (const std::vector<OperatorDescriptorHandle> &segment : m_checkpointSegments)
+    {
+        for (const OperatorDescriptorHandle &operatorName : operators)
+        {
+            if (std::find(segment.begin(), segment.end(), operatorName) != segment.end())
+            {
+                std::cerr << "checkpointed segments can't overlap" << std::endl;
+                return false;
+            }
+        }
+    }
+
+    m_checkpointSegments.push_back(operators);
+    m_memoryPlanBatchSize = 0;
+
+    return true;
+}
+
 bool FreeWill::Model::defineBackwardPath(const std::vector<FreeWill::OperatorDescriptorHandle> &backwardOperators)
 {
     m_backwardPath.clear();
+    m_memoryPlanBatchSize = 0;
 
     for(unsigned int i = 0; i<backwardOperators.size();++i)
     {
@@ -170,6 +1676,7 @@ bool FreeWill::Model::defineBackwardPath(const std::vector<FreeWill::OperatorDes
 bool FreeWill::Model::defineWeightUpdatePairs(const std::vector<std::pair<FreeWill::TensorDescriptorHandle, FreeWill::TensorDescriptorHandle>> &updatePairs)
 {
     m_updatePairs = updatePairs;
+    m_memoryPlanBatchSize = 0;
     return false;
 }
 
@@ -234,4 +1741,296 @@ void FreeWill::Model::generateSVGDiagram(const std::string &filename)
     outputStream.close();
 }
 
-FreeWill::Model::~Model(){}
+FreeWill::Model::~Model()
+{
+    for (auto iter = m_batchScatters.begin(); iter != m_batchScatters.end(); ++iter)
+    {
+        if (std::holds_alternative<BatchScatter<DeviceType::CPU_NAIVE>*>(iter->second))
+        {
+            delete std::get<BatchScatter<DeviceType::CPU_NAIVE>*>(iter->second);
+        }
+        else
+        {
+            delete std::get<BatchScatter<DeviceType::GPU_CUDA>*>(iter->second);
+        }
+    }
+}
+
+template<FreeWill::DeviceType DeviceUsed>
+static const void *checkpointData(FreeWill::TensorDescriptor *tensorDescriptor)
+{
+    FreeWill::TensorBase<DeviceUsed> *tensor = tensorDescriptor->getTensorForDevice<DeviceUsed>(0);
+
+    if constexpr (DeviceUsed == FreeWill::DeviceType::GPU_CUDA)
+    {
+        tensor->copyFromDeviceToHost();
+    }
+
+    return tensor->cpuDataHandle();
+}
+
+template<FreeWill::DeviceType DeviceUsed>
+static void restoreCheckpointData(FreeWill::TensorDescriptor *tensorDescriptor, const void *data, size_t sizeInByte)
+{
+    // the weights of every model sharing them, they came from a checkpoint already
+    if (tensorDescriptor->m_isShared)
+    {
+        return;
+    }
+
+    for (unsigned int i = 0; i < tensorDescriptor->m_tensors[DeviceUsed].size(); ++i)
+    {
+        FreeWill::TensorBase<DeviceUsed> *tensor = tensorDescriptor->getTensorForDevice<DeviceUsed>(i);
+
+        std::memcpy(tensor->cpuDataHandle(), data, sizeInByte);
+
+        if constexpr (DeviceUsed == FreeWill::DeviceType::GPU_CUDA)
+        {
+            RUN_CUDA(cudaSetDevice(tensorDescriptor->deviceId(i)));
+            tensor->copyFromHostToDevice();
+        }
+    }
+
+    if constexpr (DeviceUsed == FreeWill::DeviceType::GPU_CUDA)
+    {
+        RUN_CUDA(cudaSetDevice(0));
+    }
+}
+
+uint64_t FreeWill::Model::memoryPlanKey(const std::vector<FreeWill::OperatorDescriptorHandle> &backwardPath,
+                                        const std::set<std::string> &excludedTensors) const
+{
+    // FNV-1a, the key is written with the graph and has to be the same in another process
+    uint64_t key = 14695981039346656037ull;
+
+    auto add = [&key](const std::string &name)
+    {
+        // the terminating zero too, "ab" "c" and "a" "bc" differ
+        for (size_t i = 0; i <= name.size(); ++i)
+        {
+            key = (key ^ (unsigned char) name.c_str()[i]) * 1099511628211ull;
+        }
+    };
+
+    for (const std::vector<OperatorDescriptorHandle> *path : {&m_forwardPath, &backwardPath})
+    {
+        for (const OperatorDescriptorHandle &operatorName : *path)
+        {
+            add(operatorName);
+        }
+
+        add("|");
+    }
+
+    for (const std::set<std::string> *tensors : {&excludedTensors, &m_recomputedTensors})
+    {
+        for (const std::string &tensorName : *tensors)
+        {
+            add(tensorName);
+        }
+
+        add("|");
+    }
+
+    return key;
+}
+
+bool FreeWill::Model::checkpointTensors(std::vector<FreeWill::CheckpointEntry> &entries, std::vector<FreeWill::TensorDescriptor*> &tensors)
+{
+    std::set<std::string> gradients;
+    for (auto iter = m_updatePairs.begin(); iter != m_updatePairs.end(); ++iter)
+    {
+        gradients.insert(iter->second.name());
+    }
+
+    entries.clear();
+    tensors.clear();
+
+    for (auto iter = m_tensors.begin(); iter != m_tensors.end(); ++iter)
+    {
+        TensorDescriptor *tensorDescriptor = iter->second;
+
+        if (tensorDescriptor->m_isBatchTensor || gradients.find(iter->first) != gradients.end() ||
+                tensorDescriptor->m_tensors[m_deviceUsed].empty())
+        {
+            continue;
+        }
+
+        if (iter->first.size() >= CHECKPOINT_MAX_NAME || tensorDescriptor->m_shape.dimension() > CHECKPOINT_MAX_DIMENSION)
+        {
+            std::cerr << "can't checkpoint tensor " << iter->first << std::endl;
+            return false;
+        }
+
+        CheckpointEntry entry;
+        std::memset(&entry, 0, sizeof(entry));
+        std::strncpy(entry.m_name, iter->first.c_str(), CHECKPOINT_MAX_NAME - 1);
+        entry.m_dataType = (uint32_t) tensorDescriptor->m_dataType;
+        entry.m_dimension = tensorDescriptor->m_shape.dimension();
+
+        for (unsigned int i = 0; i < entry.m_dimension; ++i)
+        {
+            entry.m_shape[i] = tensorDescriptor->m_shape[i];
+        }
+
+        switch (m_deviceUsed)
+        {
+        case DeviceType::CPU_NAIVE:
+            entry.m_sizeInByte = tensorDescriptor->getTensorForDevice<DeviceType::CPU_NAIVE>(0)->sizeInByte();
+            break;
+        case DeviceType::GPU_CUDA:
+            entry.m_sizeInByte = tensorDescriptor->getTensorForDevice<DeviceType::GPU_CUDA>(0)->sizeInByte();
+            break;
+        }
+
+        entries.push_back(entry);
+        tensors.push_back(tensorDescriptor);
+    }
+
+    return true;
+}
+
+bool FreeWill::Model::saveCheckpoint(const std::string &filename, const FreeWill::Solver *solver)
+{
+    std::vector<CheckpointEntry> entries;
+    std::vector<TensorDescriptor*> tensors;
+
+    if (!checkpointTensors(entries, tensors))
+    {
+        return false;
+    }
+
+    std::vector<const void*> data;
+
+    for (TensorDescriptor *tensorDescriptor : tensors)
+    {
+        switch (m_deviceUsed)
+        {
+        case DeviceType::CPU_NAIVE:
+            data.push_back(checkpointData<DeviceType::CPU_NAIVE>(tensorDescriptor));
+            break;
+        case DeviceType::GPU_CUDA:
+            data.push_back(checkpointData<DeviceType::GPU_CUDA>(tensorDescriptor));
+            break;
+        }
+    }
+
+    return writeCheckpoint(filename, solver ? solver->state() : SolverState(), entries, data);
+}
+
+bool FreeWill::Model::broadcastWeights()
+{
+    std::vector<CheckpointEntry> entries;
+    std::vector<TensorDescriptor*> tensors;
+
+    if (!checkpointTensors(entries, tensors))
+    {
+        return false;
+    }
+
+    if (!Communicator::getSingleton().isOpen())
+    {
+        return true;
+    }
+
+    std::vector<unsigned char> data;
+
+    for (unsigned int i = 0; i < tensors.size(); ++i)
+    {
+        data.resize(entries[i].m_sizeInByte);
+
+        switch (m_deviceUsed)
+        {
+        case DeviceType::CPU_NAIVE:
+            std::memcpy(data.data(), checkpointData<DeviceType::CPU_NAIVE>(tensors[i]), data.size());
+            break;
+        case DeviceType::GPU_CUDA:
+            std::memcpy(data.data(), checkpointData<DeviceType::GPU_CUDA>(tensors[i]), data.size());
+            break;
+        }
+
+        if (!Communicator::getSingleton().broadcast(data.data(), data.size(), 0))
+        {
+            return false;
+        }
+
+        switch (m_deviceUsed)
+        {
+        case DeviceType::CPU_NAIVE:
+            restoreCheckpointData<DeviceType::CPU_NAIVE>(tensors[i], data.data(), data.size());
+            break;
+        case DeviceType::GPU_CUDA:
+            restoreCheckpointData<DeviceType::GPU_CUDA>(tensors[i], data.data(), data.size());
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool FreeWill::Model::loadCheckpoint(const std::string &filename, FreeWill::Solver *solver)
+{
+    CheckpointReader reader;
+
+    if (!reader.open(filename))
+    {
+        return false;
+    }
+
+    // every entry is checked before any tensor is written, a checkpoint that doesn't match
+    // leaves the model as it was
+    std::vector<std::pair<TensorDescriptor*, const CheckpointEntry*>> restores;
+
+    for (unsigned int i = 0; i < reader.header().m_tensorCount; ++i)
+    {
+        const CheckpointEntry &entry = reader.entry(i);
+        auto tensor = m_tensors.find(entry.m_name);
+
+        if (tensor == m_tensors.end() || tensor->second->m_tensors[m_deviceUsed].empty())
+        {
+            continue;
+        }
+
+        TensorDescriptor *tensorDescriptor = tensor->second;
+        size_t sizeInByte = 0;
+
+        switch (m_deviceUsed)
+        {
+        case DeviceType::CPU_NAIVE:
+            sizeInByte = tensorDescriptor->getTensorForDevice<DeviceType::CPU_NAIVE>(0)->sizeInByte();
+            break;
+        case DeviceType::GPU_CUDA:
+            sizeInByte = tensorDescriptor->getTensorForDevice<DeviceType::GPU_CUDA>(0)->sizeInByte();
+            break;
+        }
+
+        if ((uint32_t) tensorDescriptor->m_dataType != entry.m_dataType ||
+                !(tensorDescriptor->m_shape == Shape(entry.m_shape, entry.m_dimension)) || sizeInByte != entry.m_sizeInByte)
+        {
+            std::cerr << "tensor " << entry.m_name << " of " << filename << " doesn't match the model" << std::endl;
+            return false;
+        }
+
+        restores.push_back({tensorDescriptor, &entry});
+    }
+
+    for (auto iter = restores.begin(); iter != restores.end(); ++iter)
+    {
+        switch (m_deviceUsed)
+        {
+        case DeviceType::CPU_NAIVE:
+            restoreCheckpointData<DeviceType::CPU_NAIVE>(iter->first, reader.data(*iter->second), iter->second->m_sizeInByte);
+            break;
+        case DeviceType::GPU_CUDA:
+            restoreCheckpointData<DeviceType::GPU_CUDA>(iter->first, reader.data(*iter->second), iter->second->m_sizeInByte);
+            break;
+        }
+    }
+
+    if (solver)
+    {
+        solver->setState(reader.header().m_solverState);
+    }
+
+    return true;
+}
@@ -5,12 +5,18 @@
 #include "../Context/Context.h"
 #include <string>
 #include <map>
+#include <set>
 #include <utility>
 #include <variant>
 #include <any>
 #include "TensorDescriptor.h"
 #include "OperatorDescriptor.h"
 #include "Solver.h"
+#include "MemoryPlanner.h"
+#include "BatchScatter.h"
+#include "Checkpoint.h"
+#include "SharedWeights.h"
+#include <memory>
 #include <sstream>
 
 
@@ -21,7 +27,12 @@ namespace FreeWill
     class Model
     {
         friend class Solver;
+        friend class InferenceServer;
+        friend class CheckpointWriter;
+        friend class AsyncEvaluator;
         friend class TensorDescriptorHandle;
+        friend class Pipeline;
+        friend class PrefetchSchedule;
 
     private:
         Model();
@@ -35,6 +46,310 @@ namespace FreeWill
         std::vector<OperatorDescriptorHandle> m_forwardPath;
         std::vector<OperatorDescriptorHandle> m_backwardPath;
 
+        // the global batches of the batch tensors fed by beginScatterData
+        std::map<std::string, std::variant<BatchScatter<DeviceType::CPU_NAIVE>*, BatchScatter<DeviceType::GPU_CUDA>*>> m_batchScatters;
+
+        DeviceType m_deviceUsed;
+        // the batch the tensors are allocated for and the window they are currently viewed at,
+        // m_batchSize items from m_batchFirst on
+        unsigned int m_maxBatchSize;
+        unsigned int m_batchFirst;
+        unsigned int m_batchSize;
+
+        // the memory plan of the last init or of a loaded graph, for m_memoryPlanBatchSize
+        // (0 when there is none), a forward only or a training solver and the graph of
+        // m_memoryPlanKey (see memoryPlanKey). Changing the graph drops it.
+        MemoryPlanner m_memoryPlan;
+        unsigned int m_memoryPlanBatchSize;
+        bool m_isMemoryPlanForwardOnly;
+        uint64_t m_memoryPlanKey;
+
+        // tensors the solver adds for another one, the optimizer state and master copy of a weight
+        // or the accumulator of a gradient, mapped to it. A pipelined model places them with it.
+        std::map<std::string, std::string> m_companionTensors;
+
+        // the runs of the forward path marked by checkpointSegment, until init plans them
+        std::vector<std::vector<OperatorDescriptorHandle>> m_checkpointSegments;
+
+        // the tensors planRecomputation left to the segments and the copies their recomputation
+        // writes, the caller never reads them (see MemoryPlanner::plan)
+        std::set<std::string> m_recomputedTensors;
+
+        // the read only weights this model views instead of allocating, see shareWeights
+        std::shared_ptr<SharedWeights> m_sharedWeights;
+
+        // Pipelined models only: places every tensor on the devices of the operators reading or
+        // writing it. A tensor used on more than one device is a cut between two stages, it has
+        // to be a batch tensor and gets a replica on each of them (see Pipeline).
+        bool placeTensors(Solver const &solver);
+
+        // views items [first, first + count) of every batch tensor, see Pipeline. On failure
+        // every tensor is left at the window it had.
+        bool setBatchWindow(unsigned int first, unsigned int count);
+
+        // Folds an in-place inference BATCH_NORMALIZATION into the CONVOLUTION before it on the
+        // cpu, an in-place ACTIVATION into the DOT_PRODUCT_WITH_BIAS or CONVOLUTION that
+        // produces its tensor when the device can fuse it, and an in-place DROPOUT into the
+        // ACTIVATION before it on the cpu, and drops them from the forward path. In the backward
+        // path an ACTIVATION_DERIVATIVE goes into the ELEMENTWISE_ADD right after it that alone
+        // reads its InputDelta, see ElementwiseAdd.
+        void fuseOperators(DeviceType deviceUsed);
+
+        // Drops the in-place DROPOUTs from the forward path of a model that doesn't train, they
+        // would leave the tensor as it is. The others copy (see OperatorDescriptor::m_isInference).
+        void skipDropouts();
+
+        // Cpu inference, see Solver::m_blockChannels: the CONVOLUTION and MAX_POOLING whose
+        // images can be channel blocked, and the ACTIVATION reading what one of them wrote, run
+        // blocked. A tensor only they use is blocked in place, one also used by the other
+        // operators or filled and read by the caller gets a blocked copy, <name>_blocked, and a
+        // LAYOUT_TRANSFORM goes into the forward path where the stale one is read. Once.
+        void planLayouts();
+
+        // Training with a memory plan: the batch tensors a checkpointed segment writes and the
+        // forward path doesn't touch after it are computed again for the backward path instead
+        // of being kept. A copy of each segment operator the backward path needs, <name>_recompute,
+        // runs from the segment's inputs into copies of those tensors, <name>_recomputed, just
+        // before the first backward operator reading one, and the backward operators read the
+        // copies. Segments that can't be run again (one overwriting its own input, writing a
+        // tensor that isn't a batch tensor or accumulating into one) fail. Once.
+        bool planRecomputation();
+
+        // Training with a memory plan, see Solver::m_activationCompression: the backward path
+        // reads less of the forward pass. Every MAX_POOLING_DERIVATIVE reads the Switch of its
+        // MAX_POOLING alone, which then writes it on the gpu too (MaxPooling::writeSwitch). A
+        // COMPRESS_ACTIVATION, <name>_compress, runs right after the last forward operator writing
+        // the output of a RELU ACTIVATION_DERIVATIVE and keeps its sign mask, <name>_mask, which
+        // the derivative reads instead. An output other backward operators read too is left as
+        // it is, or with HALF also kept as Half, <name>_half, and decoded into <name>_decompressed
+        // by a DECOMPRESS_ACTIVATION, <name>_decompress, before the first of them. The caller
+        // can't read a compressed output no forward operator reads after forward(). Once.
+        bool planActivationCompression(ActivationCompression compression);
+
+        // A hash of what a memory plan is made from: the forward path, backwardPath, the tensors
+        // it leaves out and the ones planRecomputation discards. The operators and copies of a
+        // compressed activation are in the paths.
+        uint64_t memoryPlanKey(const std::vector<OperatorDescriptorHandle> &backwardPath, const std::set<std::string> &excludedTensors) const;
+
+        // the tensors a checkpoint keeps, see saveCheckpoint, with their entries but no offsets
+        bool checkpointTensors(std::vector<CheckpointEntry> &entries, std::vector<TensorDescriptor*> &tensors);
+
+        // the tensors read or written by the forward path, all an inference solver allocates
+        std::set<std::string> forwardTensors();
+
+        // Inference only: an out of place ACTIVATION can overwrite its input when the forward path
+        // produces that input and never touches it again. Maps each such output to its input, the
+        // output is then allocated over the input's memory.
+        std::map<std::string, std::string> inPlaceActivations();
+
+        // what the allocator files a tensor under: the weights and gradients of the update pairs,
+        // their companions and the batch tensors
+        MemoryCategory memoryCategory(const std::string &tensorName);
+
+        template<DeviceType DeviceUsed>
+        void allocateTensors(Solver const &solver)
+        {
+            MemoryPlanner memoryPlanner;
+            std::vector<ReferenceCountedBlob<DeviceUsed>> arenas;
+
+            bool isForwardOnly = solver.m_mode != SolverMode::TRAINING;
+            std::set<std::string> usedTensors = isForwardOnly ? forwardTensors() : std::set<std::string>();
+            const std::vector<OperatorDescriptorHandle> noBackwardPath;
+            std::map<std::string, std::string> aliases = isForwardOnly ? inPlaceActivations() : std::map<std::string, std::string>();
+
+            // Hogwild: every replica of a weight and of its optimizer state views one allocation
+            std::set<std::string> sharedTensors;
+            if (DeviceUsed == DeviceType::CPU_NAIVE && !isForwardOnly && solver.m_asynchronousUpdate.m_isEnabled &&
+                    solver.m_asynchronousUpdate.m_maxStaleness == 0)
+            {
+                for (auto iter = m_updatePairs.begin(); iter != m_updatePairs.end(); ++iter)
+                {
+                    sharedTensors.insert(iter->first.name());
+                }
+
+                for (auto iter = m_companionTensors.begin(); iter != m_companionTensors.end(); ++iter)
+                {
+                    if (sharedTensors.find(iter->second) != sharedTensors.end() && !m_tensors[iter->first]->m_isBatchTensor)
+                    {
+                        sharedTensors.insert(iter->first);
+                    }
+                }
+            }
+
+            // the replicas of a pipelined model differ between tensors, there is no arena per device
+            if (solver.m_planMemory && !isPipelined())
+            {
+                std::set<std::string> excludedTensors;
+                for (auto iter = m_updatePairs.begin(); iter != m_updatePairs.end(); ++iter)
+                {
+                    excludedTensors.insert(iter->first.name());
+                    excludedTensors.insert(iter->second.name());
+                }
+
+                // a shared allocation lives as long as both of its tensors
+                for (auto iter = aliases.begin(); iter != aliases.end(); ++iter)
+                {
+                    excludedTensors.insert(iter->first);
+                    excludedTensors.insert(iter->second);
+                }
+
+                const std::vector<OperatorDescriptorHandle> &backwardPath = isForwardOnly ? noBackwardPath : m_backwardPath;
+
+                // a plan made for the same batch, mode and graph, by an earlier init or a loaded graph
+                uint64_t planKey = memoryPlanKey(backwardPath, excludedTensors);
+                bool isPlanCached = m_memoryPlanBatchSize == solver.m_batchSize && m_isMemoryPlanForwardOnly == isForwardOnly &&
+                                    m_memoryPlanKey == planKey;
+
+                if (isPlanCached)
+                {
+                    memoryPlanner = m_memoryPlan;
+                }
+
+                bool isPlanned = isPlanCached || memoryPlanner.plan(m_forwardPath, backwardPath, m_operators, m_tensors,
+                                                                     excludedTensors, solver.m_batchSize, m_recomputedTensors);
+
+                if (isPlanned && !isPlanCached)
+                {
+                    m_memoryPlan = memoryPlanner;
+                    m_memoryPlanBatchSize = solver.m_batchSize;
+                    m_isMemoryPlanForwardOnly = isForwardOnly;
+                    m_memoryPlanKey = planKey;
+                }
+
+                if (isPlanned && memoryPlanner.arenaSizeInByte() > 0)
+                {
+                    int deviceCount = Context<DeviceUsed>::getSingleton().deviceCount();
+                    arenas.resize(deviceCount);
+
+                    for (int i = 0; i < deviceCount; ++i)
+                    {
+                        if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+                        {
+                            RUN_CUDA(cudaSetDevice(i));
+                        }
+
+                        Context<DeviceUsed>::getSingleton().runOnDevice(i, [&]
+                        {
+                            BlobAllocator::Tag tag(MemoryCategory::ACTIVATION, "memory plan");
+                            arenas[i].alloc(memoryPlanner.arenaSizeInByte());
+                        });
+                    }
+
+                    if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+                    {
+                        RUN_CUDA(cudaSetDevice(0));
+                    }
+                }
+            }
+
+            for (auto iterTensor = m_tensors.begin(); iterTensor != m_tensors.end(); ++iterTensor)
+            {
+                if ((isForwardOnly && usedTensors.find(iterTensor->first) == usedTensors.end()) ||
+                        aliases.find(iterTensor->first) != aliases.end())
+                {
+                    continue;
+                }
+
+                TensorDescriptor *descriptor = iterTensor->second;
+                descriptor->m_memoryCategory = memoryCategory(iterTensor->first);
+
+                std::vector<ReferenceCountedBlob<DeviceUsed>> sharedWeights;
+
+                if (m_sharedWeights && m_sharedWeights->blobs<DeviceUsed>(descriptor, sharedWeights))
+                {
+                    descriptor->m_isShared = true;
+                    descriptor->allocateTensor<DeviceUsed>(solver.m_batchSize, &sharedWeights, 0);
+                }
+                else if (!arenas.empty() && memoryPlanner.isPlanned(iterTensor->first))
+                {
+                    descriptor->allocateTensor<DeviceUsed>(solver.m_batchSize, &arenas, memoryPlanner.offset(iterTensor->first));
+                }
+                else if (sharedTensors.find(iterTensor->first) != sharedTensors.end())
+                {
+                    ReferenceCountedBlob<DeviceUsed> blob;
+                    Context<DeviceUsed>::getSingleton().runOnDevice(0, [&]
+                    {
+                        BlobAllocator::Tag tag(descriptor->m_memoryCategory, descriptor->m_name);
+                        blob.alloc(MemoryPlanner::sizeInByte(descriptor, solver.m_batchSize));
+                    });
+                    std::vector<ReferenceCountedBlob<DeviceUsed>> shared(Context<DeviceUsed>::getSingleton().deviceCount(), blob);
+
+                    descriptor->allocateTensor<DeviceUsed>(solver.m_batchSize, &shared, 0);
+                }
+                else
+                {
+                    descriptor->allocateTensor<DeviceUsed>(solver.m_batchSize);
+                }
+            }
+
+            for (auto iter = aliases.begin(); iter != aliases.end(); ++iter)
+            {
+                // through a chain of activations to the tensor that owns the memory
+                std::string source = iter->second;
+                while (aliases.find(source) != aliases.end())
+                {
+                    source = aliases[source];
+                }
+
+                m_tensors[iter->first]->allocateTensorAlias<DeviceUsed>(solver.m_batchSize, m_tensors[source]);
+            }
+        }
+
+
+        // Creates the replicas of the operators, isForwardOnly those of the forward path. Every
+        // device creates its own on its worker (see Context::runOnEveryDevice), so the devices
+        // search their cudnn algorithms at the same time and a cpu replica's memory is first
+        // touched on its device's node.
+        template<DeviceType DeviceUsed>
+        bool initOperators(bool isForwardOnly)
+        {
+            std::set<std::string> forwardOperators(m_forwardPath.begin(), m_forwardPath.end());
+            std::vector<OperatorDescriptor*> descriptors;
+
+            for (auto iter = m_operators.begin(); iter != m_operators.end(); ++iter)
+            {
+                if (isForwardOnly && forwardOperators.find(iter->first) == forwardOperators.end())
+                {
+                    continue;
+                }
+
+                iter->second->beginInit<DeviceUsed>(m_tensors);
+                descriptors.push_back(iter->second);
+            }
+
+            // the operator each device stopped at
+            std::vector<OperatorDescriptor*> failures(Context<DeviceUsed>::getSingleton().deviceCount(), nullptr);
+
+            Context<DeviceUsed>::getSingleton().runOnEveryDevice([&](unsigned int deviceId)
+            {
+                for (OperatorDescriptor *descriptor : descriptors)
+                {
+                    if (!descriptor->initReplica<DeviceUsed>(m_tensors, deviceId))
+                    {
+                        failures[deviceId] = descriptor;
+                        return;
+                    }
+                }
+            });
+
+            bool isInitialized = true;
+
+            for (unsigned int i = 0; i < failures.size(); ++i)
+            {
+                if (failures[i])
+                {
+                    std::cerr << "failed to init operator: " << failures[i]->m_name << " on device " << i << std::endl;
+                    isInitialized = false;
+                }
+            }
+
+            for (OperatorDescriptor *descriptor : descriptors)
+            {
+                isInitialized = descriptor->endInit<DeviceUsed>() && isInitialized;
+            }
+
+            return isInitialized;
+        }
 
 
     public:
@@ -55,12 +370,70 @@ namespace FreeWill
 
         void generateSVGDiagram(const std::string &filename);
 
+        // Writes the graph, i.e. the tensors, the operators with their properties, the paths and
+        // the update pairs, as text. After init it also writes what init resolved: the plan of
+        // every operator replica (the cudnn algorithms) and the memory plan. A model loading
+        // the file before its init takes them instead of searching again, unless they were
+        // found on another gpu. The names must not contain whitespace.
+        bool saveGraph(const std::string &filename);
+
+        // into a model without tensors or operators yet, which it is again when this fails
+        bool loadGraph(const std::string &filename);
+
+        // After init: writes every tensor that is neither a batch tensor nor a gradient, i.e. the
+        // weights, the optimizer state and the master weights, with their shapes and the state
+        // of solver, see Checkpoint.h. The replicas are the same, device 0's are written.
+        bool saveCheckpoint(const std::string &filename, const Solver *solver = nullptr);
+
+        // After init: copies every tensor of the checkpoint the model has allocated from the
+        // mapped file into each replica and restores solver. A tensor of the checkpoint with
+        // another data type or shape fails the load before any tensor is written, the tensors
+        // not in it are left as they are.
+        bool loadCheckpoint(const std::string &filename, Solver *solver = nullptr);
+
+        // After init, in a distributed run (Communicator::open) on every rank: copies the
+        // tensors a checkpoint keeps from rank 0 into each replica of the other ranks, so that
+        // all ranks start from the same weights.
+        bool broadcastWeights();
+
         bool defineForwardPath(const std::vector<OperatorDescriptorHandle> &forwardOperators);
 
         bool defineBackwardPath(const std::vector<OperatorDescriptorHandle> &backwardOperators);
 
+        // Before init, after defineForwardPath: a run of the forward path whose intermediate
+        // tensors a training solver with m_planMemory doesn't keep for the backward path but
+        // computes again from the run's inputs, a second forward pass over it for their memory.
+        // See planRecomputation.
+        bool checkpointSegment(const std::vector<OperatorDescriptorHandle> &operators);
+
+        // Before init, for an inference solver: the tensors sharedWeights has, the weights, are
+        // viewed from there instead of allocated, so many models of the architecture hold them
+        // once (see SharedWeights). The batch tensors, the activations, stay the model's own.
+        // The shared tensors are neither randomized nor overwritten by loadCheckpoint, the caller
+        // must not mutate them. A training solver fails init.
+        bool shareWeights(const std::shared_ptr<SharedWeights> &sharedWeights);
+
         bool defineWeightUpdatePairs(const std::vector<std::pair<TensorDescriptorHandle, TensorDescriptorHandle>> &updatePairs);
 
+        // Before init: runs operators on deviceId only instead of a replica on every device. Once
+        // an operator is placed the model is pipelined, every operator of the paths has to be
+        // placed, each device runs a stage of the graph on the whole batch and the solver moves
+        // the tensors crossing a cut between stages, see Pipeline. A weight, its gradient and
+        // the optimizer state live on the device of the operators using the weight.
+        bool placeOperators(const std::vector<OperatorDescriptorHandle> &operators, unsigned int deviceId);
+
+        bool isPipelined() const;
+
+        // After init, views every batch tensor at batchSize, up to the m_batchSize of the solver,
+        // without allocating or initializing again, e.g. for the last partial batch of an epoch.
+        // The operators take the batch from their tensors in evaluate().
+        bool setBatchSize(unsigned int batchSize);
+
+        unsigned int batchSize() const
+        {
+            return m_batchSize;
+        }
+
         template<DeviceType DeviceUsed = DeviceType::CPU_NAIVE, typename DataType = float>
         const DataType *readonlyAccess(const TensorDescriptorHandle &tensorDescriptorHandle, int deviceId = 0)
         {
@@ -81,11 +454,42 @@ namespace FreeWill
            return static_cast<DataType*>(tensorBase->cpuDataHandle());
         }
 
+        // Scatter mode for a batch tensor: returns a buffer for the global batch of deviceCount
+        // times batchSize() items, the next endMutateData(tensor) gives replica i the i-th
+        // contiguous slice of it instead of broadcasting device 0's batch to all of them.
+        template<DeviceType DeviceUsed = DeviceType::CPU_NAIVE, typename DataType = float>
+        DataType *beginScatterData(const TensorDescriptorHandle &tensorDescriptorHandle)
+        {
+            TensorDescriptor* tensorDescriptor = m_tensors[tensorDescriptorHandle.name()];
+
+            if (!tensorDescriptor->m_isBatchTensor || tensorDescriptor->m_tensors[DeviceUsed].empty())
+            {
+                return nullptr;
+            }
+
+            auto scatter = m_batchScatters.find(tensorDescriptorHandle.name());
+
+            if (scatter == m_batchScatters.end())
+            {
+                scatter = m_batchScatters.insert(std::make_pair(tensorDescriptorHandle.name(), new BatchScatter<DeviceUsed>())).first;
+            }
+
+            return reinterpret_cast<DataType*>(std::get<BatchScatter<DeviceUsed>*>(scatter->second)->begin(tensorDescriptor));
+        }
+
         template<DeviceType DeviceUsed = DeviceType::CPU_NAIVE>
         void endMutateData(const TensorDescriptorHandle &tensorDescriptorHandle, int deviceId = -1)
         {
             TensorDescriptor* tensorDescriptor = m_tensors[tensorDescriptorHandle.name()];
 
+            auto scatter = m_batchScatters.find(tensorDescriptorHandle.name());
+
+            if (deviceId < 0 && scatter != m_batchScatters.end() && std::get<BatchScatter<DeviceUsed>*>(scatter->second)->isPending())
+            {
+                std::get<BatchScatter<DeviceUsed>*>(scatter->second)->end(tensorDescriptor);
+                return;
+            }
+
             if (deviceId < 0)
             {
                 unsigned char *sourcePtr = static_cast<unsigned char*>(std::get<TensorBase<DeviceUsed>*>(tensorDescriptor->m_tensors[DeviceUsed][0])->cpuDataHandle());
@@ -95,6 +499,12 @@ namespace FreeWill
                 {
                     unsigned char *destPtr = static_cast<unsigned char*>(std::get<TensorBase<DeviceUsed>*>(tensorDescriptor->m_tensors[DeviceUsed][i])->cpuDataHandle());
 
+                    // the replicas of a Hogwild weight are one allocation
+                    if (destPtr == sourcePtr)
+                    {
+                        continue;
+                    }
+
                     std::copy(sourcePtr, sourcePtr + sourceSize, destPtr);
 
                     if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
@@ -105,6 +515,91 @@ namespace FreeWill
             }
         }
 
+        // Points a batch tensor at caller owned memory holding the global batch instead of
+        // copying it in, device i views the i-th slice of batchSize() items. data stays alive
+        // and unchanged until the solver is done with the step; on gpu each slice is uploaded
+        // from there. Once fed, beginMutateData writes into data.
+        template<DeviceType DeviceUsed = DeviceType::CPU_NAIVE>
+        bool feedFromMemory(const TensorDescriptorHandle &tensorDescriptorHandle, void *data)
+        {
+            TensorDescriptor* tensorDescriptor = m_tensors[tensorDescriptorHandle.name()];
+
+            if (!tensorDescriptor->m_isBatchTensor)
+            {
+                return false;
+            }
+
+            unsigned char *slice = static_cast<unsigned char*>(data);
+
+            for (unsigned int i = 0; i < tensorDescriptor->m_tensors[DeviceUsed].size(); ++i)
+            {
+                TensorBase<DeviceUsed> *tensor = tensorDescriptor->getTensorForDevice<DeviceUsed>(i);
+
+                if (!tensor->bindHost(slice))
+                {
+                    return false;
+                }
+
+                if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+                {
+                    unsigned int deviceId = tensorDescriptor->deviceId(i);
+                    RUN_CUDA(cudaSetDevice(deviceId));
+                    Context<DeviceUsed> &context = Context<DeviceUsed>::getSingleton();
+                    tensor->copyFromHostToDeviceAsync(context.copyStream(deviceId));
+                    RUN_CUDA(cudaStreamWaitEvent(0, context.recordCopies(deviceId), 0));
+                }
+
+                slice += tensor->viewSizeInByte();
+            }
+
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                RUN_CUDA(cudaSetDevice(0));
+            }
+
+            return true;
+        }
+
+        // Gpu: frees the host mirrors of every tensor, the next readonlyAccess or beginMutateData
+        // of one allocates it again. Pointers to them taken before are dangling.
+        void freeHostMirrors();
+
+        // The bytes the tensors of the model hold now, over every replica and host mirror, per
+        // owner (see BlobAllocator::Tag): the tensor names, "memory plan" for the arenas the
+        // planned tensors share and the names of another model's tensors for shared weights.
+        // Against MemoryPlanner::arenaSizeInByte and unplannedSizeInByte it shows what the plan
+        // saved; the allocator's size classes round every allocation up.
+        template<DeviceType DeviceUsed = DeviceType::CPU_NAIVE>
+        std::map<std::string, size_t> memoryUsage()
+        {
+            BlobAllocator &allocator = BlobAllocator::getSingleton();
+            std::set<void*> counted;
+            std::map<std::string, size_t> sizes;
+
+            for (auto iter = m_tensors.begin(); iter != m_tensors.end(); ++iter)
+            {
+                for (unsigned int i = 0; i < iter->second->m_tensors[DeviceUsed].size(); ++i)
+                {
+                    const ReferenceCountedBlob<DeviceUsed> &blob = iter->second->getTensorForDevice<DeviceUsed>(i)->blob();
+
+                    // aliases, Hogwild replicas and arena views share blocks
+                    for (void *pointer : {blob.allocationHandle(), blob.hostMirrorHandle()})
+                    {
+                        if (pointer && counted.insert(pointer).second)
+                        {
+                            size_t sizeInByte = allocator.blockSizeInByte(pointer);
+                            if (sizeInByte > 0)
+                            {
+                                sizes[allocator.owner(pointer)] += sizeInByte;
+                            }
+                        }
+                    }
+                }
+            }
+
+            return sizes;
+        }
+
         template<DeviceType DeviceUsed = DeviceType::CPU_NAIVE>
         void clearTensor(const TensorDescriptorHandle &tensorDescriptorHandle)
         {
@@ -194,15 +689,25 @@ namespace FreeWill
             {
                 TensorBase<DeviceUsed> *operandATensorBaseDup = std::get<TensorBase<DeviceUsed>*>(operandATensorDescriptor->m_tensors[DeviceUsed][i]);
 
-                ElementwiseAdd<DeviceUsed, DataType> *elementwiseAdd = new ElementwiseAdd<DeviceUsed, DataType>(0.0f);
+                // bound to the sibling's device, it pulls the first replica over
+                Duplicate<DeviceUsed, DataType> *duplicate = new Duplicate<DeviceUsed, DataType>(i, 0);
 
-                elementwiseAdd->setInputParameter("OperandA", operandATensorBase);
-                elementwiseAdd->setInputParameter("OperandB", operandATensorBase);
-                elementwiseAdd->setOutputParameter("Result", operandATensorBaseDup);
+                duplicate->setInputParameter("From", operandATensorBase);
+                duplicate->setOutputParameter("To", operandATensorBaseDup);
 
-                operatorList.push_back(elementwiseAdd);
+                if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+                {
+                    RUN_CUDA(cudaSetDevice(i));
+                }
+
+                duplicate->init();
 
+                if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+                {
+                    RUN_CUDA(cudaSetDevice(0));
+                }
 
+                operatorList.push_back(duplicate);
             }
         }
 
@@ -12,9 +12,27 @@ FreeWill::OperatorDescriptor::OperatorDescriptor(const std::string &name,
       m_operatorName(operatorName),
       m_inputs(inputs),
       m_outputs(outputs),
-      m_parameters(parameters)
+      m_parameters(parameters),
+      m_workerMessages(),
+      m_completionLatch(),
+      m_profileRecords(),
+      m_plans(),
+      m_deviceId(-1),
+      m_isInference(false)
+{
+}
 
+std::string FreeWill::OperatorDescriptor::typeName() const
 {
+    for (auto iter = operatorNameTable.begin(); iter != operatorNameTable.end(); ++iter)
+    {
+        if (iter->second == m_operatorName)
+        {
+            return iter->first;
+        }
+    }
+
+    return "Operator" + std::to_string((uint32_t) m_operatorName);
 }
 
 FreeWill::OperatorDescriptor::~OperatorDescriptor()
@@ -38,6 +56,96 @@ FreeWill::OperatorDescriptor::~OperatorDescriptor()
     }
 
     m_operators[FreeWill::DeviceType::GPU_CUDA].clear();
+
+    for(unsigned int i = 0; i < m_workerMessages.size(); ++i)
+    {
+        delete m_workerMessages[i];
+    }
+
+    m_workerMessages.clear();
+
+    // after the operators, which hold them
+    for (auto &view : m_views)
+    {
+        std::visit([](auto *tensorBase) { delete tensorBase; }, view);
+    }
+
+    m_views.clear();
+}
+
+bool FreeWill::OperatorDescriptor::overwritesOutput(const std::string &outputName) const
+{
+    switch(m_operatorName)
+    {
+    case OperatorName::ACTIVATION:
+    case OperatorName::DROPOUT:
+        // Seed, of a dropout fused or not, is a counter the operator advances
+        return outputName != "Seed";
+    case OperatorName::ACTIVATION_DERIVATIVE:
+    case OperatorName::CROSS_ENTROPY_LOSS:
+    case OperatorName::DOT_PRODUCT_WITH_BIAS:
+    case OperatorName::ELEMENTWISE_ADD:
+    case OperatorName::MAX_POOLING:
+    case OperatorName::SIGMOID_CROSS_ENTROPY_LOSS_DERIVATIVE:
+    case OperatorName::SOFTMAX_LOG_LOSS:
+    case OperatorName::SOFTMAX_LOG_LOSS_DERIVATIVE:
+    case OperatorName::SOFTMAX_LOG_LOSS_WITH_DERIVATIVE:
+    case OperatorName::LAYOUT_TRANSFORM:
+    case OperatorName::DROPOUT_DERIVATIVE:
+    case OperatorName::COMPRESS_ACTIVATION:
+    case OperatorName::DECOMPRESS_ACTIVATION:
+        return true;
+    case OperatorName::LSTM:
+        return true;
+    case OperatorName::BATCH_NORMALIZATION:
+        // moves the running statistics
+        return outputName != "Mean" && outputName != "Variance";
+    case OperatorName::DOT_PRODUCT_WITH_BIAS_DERIVATIVE:
+    case OperatorName::LSTM_DERIVATIVE:
+    case OperatorName::BATCH_NORMALIZATION_DERIVATIVE:
+        return outputName == "InputDelta";
+    case OperatorName::CONVOLUTION:
+        // the cpu convolution adds to Output unless asked to clear it, see Model::planRecomputation
+        return m_parameters.find("ClearOutput") != m_parameters.end();
+    case OperatorName::CONVOLUTION_DERIVATIVE:
+    case OperatorName::MAX_POOLING_DERIVATIVE:
+    case OperatorName::RESHAPE:
+    case OperatorName::DUPLICATE:
+        return false;
+    case OperatorName::METRIC:
+        // adds to its Accumulator
+        return false;
+    }
+
+    return false;
+}
+
+bool FreeWill::OperatorDescriptor::isQuantizable() const
+{
+    // a folded normalization rescales the float weights on every pass, the 8-bit convolution
+    // has no groups and the 8-bit dot product no sparse input and no stacked models
+    return (m_operatorName == OperatorName::DOT_PRODUCT_WITH_BIAS || m_operatorName == OperatorName::CONVOLUTION) &&
+            m_dataType == DataType::FLOAT && m_parameters.find("Quantized") == m_parameters.end() &&
+            m_parameters.find("Pruned") == m_parameters.end() && m_inputs.find("SparseRowOffsets") == m_inputs.end() &&
+            (m_parameters.find("ModelCount") == m_parameters.end() || std::any_cast<unsigned int>(m_parameters.at("ModelCount")) == 1) &&
+            m_parameters.find("NormalizationEpsilon") == m_parameters.end() &&
+            (m_parameters.find("GroupCount") == m_parameters.end() || std::any_cast<unsigned int>(m_parameters.at("GroupCount")) == 1);
+}
+
+bool FreeWill::OperatorDescriptor::isPrunable() const
+{
+    // the masks follow the weight of one model, a folded normalization rescales it on every pass
+    return (m_operatorName == OperatorName::DOT_PRODUCT_WITH_BIAS || m_operatorName == OperatorName::CONVOLUTION) &&
+            (m_dataType == DataType::FLOAT || m_dataType == DataType::DOUBLE) &&
+            m_parameters.find("Quantized") == m_parameters.end() && m_parameters.find("Pruned") == m_parameters.end() &&
+            m_inputs.find("SparseRowOffsets") == m_inputs.end() &&
+            (m_parameters.find("ModelCount") == m_parameters.end() || std::any_cast<unsigned int>(m_parameters.at("ModelCount")) == 1) &&
+            m_parameters.find("NormalizationEpsilon") == m_parameters.end();
+}
+
+const std::string &FreeWill::OperatorDescriptor::weightName() const
+{
+    return m_inputs.at(m_operatorName == OperatorName::CONVOLUTION ? "FeatureMap" : "Weight").name();
 }
 
 void FreeWill::OperatorDescriptor::evaluateSVGDiagramSize(unsigned int &width, unsigned int &height)
@@ -12,16 +12,32 @@
 #include "../Operator/ElementwiseAdd.h"
 #include "../Operator/MaxPooling.h"
 #include "../Operator/MaxPoolingDerivative.h"
+#include "../Operator/Dropout.h"
+#include "../Operator/DropoutDerivative.h"
+#include "../Operator/Metric.h"
+#include "../Operator/LSTM.h"
+#include "../Operator/LSTMDerivative.h"
+#include "../Operator/BatchNormalizationDerivative.h"
 #include "../Operator/SigmoidCrossEntropyLossDerivative.h"
 #include "../Operator/SoftmaxLogLoss.h"
 #include "../Operator/SoftmaxLogLossDerivative.h"
+#include "../Operator/SoftmaxLogLossWithDerivative.h"
 #include "../Operator/Duplicate.h"
 #include "../Operator/Reshape.h"
+#include "../Operator/LayoutTransform.h"
+#include "../Operator/CompressActivation.h"
+#include "../Operator/DecompressActivation.h"
+#include "../Operator/QuantizedDotProductWithBias.h"
+#include "../Operator/QuantizedConvolution.h"
+#include "../Operator/PrunedDotProductWithBias.h"
 #include "TensorDescriptor.h"
 #include <any>
 #include <fstream>
 #include "../Context/WorkerMessage.h"
+#include "../Context/CompletionLatch.h"
+#include "../Context/Profiler.h"
 #include <chrono>
+#include <mutex>
 
 namespace FreeWill
 {
@@ -29,6 +45,10 @@ namespace FreeWill
 
     class Model;
     class Solver;
+    class Pipeline;
+    class PrefetchSchedule;
+    template<DeviceType DeviceUsed>
+    class GraphExecutor;
 
     typedef std::string OperatorDescriptorHandle;
 
@@ -36,6 +56,11 @@ namespace FreeWill
     {
         friend class Model;
         friend class Solver;
+        template<DeviceType DeviceUsed>
+        friend class GraphExecutor;
+        friend class MemoryPlanner;
+        friend class Pipeline;
+        friend class PrefetchSchedule;
 
         constexpr static const float topBottomMargin = 20;
         constexpr static const float centerSpace = 40;
@@ -56,8 +81,21 @@ namespace FreeWill
         std::map<std::string, FreeWill::TensorDescriptorHandle> m_outputs;
         std::map<std::string, std::any> m_parameters;
         std::map<DeviceType, std::vector<std::variant<Operator<DeviceType::GPU_CUDA>*, Operator<DeviceType::CPU_NAIVE>*>>> m_operators;
-        std::vector<FreeWill::TensorDescriptorHandle> m_inputsNeedReshape;
-        std::vector<FreeWill::TensorDescriptorHandle> m_outputsNeedReshape;
+        // the views reshaped handles bind, see bindTensor
+        std::vector<std::variant<TensorBase<DeviceType::GPU_CUDA>*, TensorBase<DeviceType::CPU_NAIVE>*>> m_views;
+        // the replicas bind their views from the threads of their devices, see initReplica
+        std::mutex m_viewMutex;
+        std::vector<WorkerMessage*> m_workerMessages;
+        CompletionLatch m_completionLatch;
+        // one per replica, filled by dispatch() while the Profiler is enabled
+        std::vector<ProfileRecord> m_profileRecords;
+        // the plans of the replicas from a saved graph, given to the operators before their
+        // init (see Operator::plan)
+        std::map<DeviceType, std::vector<std::string>> m_plans;
+        // the device of the only replica, -1 for one on every device (see Model::placeOperators)
+        int m_deviceId;
+        // set by Model::init for a solver that doesn't train, a dropout then passes its input on
+        bool m_isInference;
 
         OperatorDescriptor(const std::string &name, OperatorName operatorName,
                            const std::map<std::string, FreeWill::TensorDescriptorHandle> &inputs,
@@ -66,8 +104,64 @@ namespace FreeWill
         ~OperatorDescriptor();
 
         void generateSVGDiagram(std::ostream &outputStream, unsigned int &width, unsigned int &height);
+
+        // false when the operator accumulates into the output or only writes part of it,
+        // i.e. when the caller has to clear the tensor beforehand
+        bool overwritesOutput(const std::string &outputName) const;
         void evaluateSVGDiagramSize(unsigned int &width, unsigned int &height);
 
+        // the name the operator type is added by, e.g. "Convolution"
+        std::string typeName() const;
+
+        // The name, type and device of one replica's evaluation and what it costs, see
+        // Operator::parameterSizeInByte and Operator::flops.
+        template<DeviceType DeviceUsed>
+        void profileRecord(Operator<DeviceUsed> *operatorBase, ProfileRecord &record) const
+        {
+            record.m_name = m_name;
+            record.m_type = typeName();
+            record.m_deviceId = operatorBase->deviceId();
+            record.m_isGPU = DeviceUsed == DeviceType::GPU_CUDA;
+            record.m_bytes = operatorBase->parameterSizeInByte();
+            record.m_flops = operatorBase->flops(m_operatorName);
+        }
+
+        // The replica of handle's tensor on deviceId, or a view of it in the shape of a
+        // reshaped handle. The tensor itself keeps its shape, the view is made once and follows
+        // the batch size of the tensor, so nothing is reshaped while the operator runs.
+        template<DeviceType DeviceUsed>
+        TensorBase<DeviceUsed> *bindTensor(const TensorDescriptorHandle &handle, const std::string &slotName,
+                                           std::map<std::string, FreeWill::TensorDescriptor*> &tensors, int deviceId)
+        {
+            TensorDescriptor *tensorDescriptor = tensors.at(handle.name());
+            int replica = tensorDescriptor->replicaIndex(deviceId);
+
+            if (replica < 0)
+            {
+                std::cerr << slotName << " tensor: " << tensorDescriptor->m_name << " isn't placed on device " << deviceId << std::endl;
+                return nullptr;
+            }
+
+            TensorBase<DeviceUsed> *tensorBase = tensorDescriptor->getTensorForDevice<DeviceUsed>(replica);
+
+            if (!handle.isReshaped())
+            {
+                return tensorBase;
+            }
+
+            TensorBase<DeviceUsed> *view = tensorDescriptor->m_isBatchTensor ? tensorBase->batchView(handle.shape()) : tensorBase->view(handle.shape());
+
+            if (!view)
+            {
+                std::cerr << "Reshape failed for " << slotName << " tensor: " << tensorBase->name() << " from: " << tensorBase->shape() << " to: " << handle.shape() << std::endl;
+                return nullptr;
+            }
+
+            std::lock_guard<std::mutex> lock(m_viewMutex);
+            m_views.push_back(view);
+            return view;
+        }
+
         template<DeviceType DeviceUsed>
         bool setInput(Operator<DeviceUsed> *operatorBase, const std::string &inputName, std::map<std::string, FreeWill::TensorDescriptor*> &tensors, int deviceId)
         {
@@ -76,18 +170,11 @@ namespace FreeWill
                 return false;
             }
 
-            TensorDescriptor *tensorDescriptor = tensors[m_inputs[inputName].name()];
-            TensorBase<DeviceUsed> *tensorBase = tensorDescriptor->getTensorForDevice<DeviceUsed>(deviceId);
+            TensorBase<DeviceUsed> *tensorBase = bindTensor<DeviceUsed>(m_inputs[inputName], "Input " + inputName, tensors, deviceId);
 
-            if (m_inputs[inputName].isReshaped())
+            if (!tensorBase)
             {
-                Shape newShape = m_inputs[inputName].shape();
-                if (! tensorBase->reshape(tensorDescriptor->m_isBatchTensor?(newShape + tensorDescriptor->m_batchSize):newShape ))
-                {
-                    std::cerr << "Reshape failed for input: " << inputName << " tensor: " << tensorBase->name() << " from: " << tensorBase->shape() << " to: " << m_inputs[inputName].shape() << std::endl;
-                    return false;
-                }
-                m_inputsNeedReshape.push_back(m_inputs[inputName]);
+                return false;
             }
 
             operatorBase->setInputParameter(inputName, tensorBase);
@@ -103,19 +190,11 @@ namespace FreeWill
                 return false;
             }
 
-            TensorDescriptor *tensorDescriptor = tensors[m_outputs[outputName].name()];
-            TensorBase<DeviceUsed> *tensorBase = tensorDescriptor->getTensorForDevice<DeviceUsed>(deviceId);
+            TensorBase<DeviceUsed> *tensorBase = bindTensor<DeviceUsed>(m_outputs[outputName], "Output " + outputName, tensors, deviceId);
 
-            if (m_outputs[outputName].isReshaped())
+            if (!tensorBase)
             {
-                Shape newShape = m_outputs[outputName].shape();
-
-                if (! tensorBase->reshape(tensorDescriptor->m_isBatchTensor?(newShape + tensorDescriptor->m_batchSize):newShape))
-                {
-                    std::cerr << "Reshape failed for output: " << outputName << " tensor: " << tensorBase->name() << " from: " << tensorBase->shape() << " to: " << m_outputs[outputName].shape() << std::endl;
-                    return false;
-                }
-                m_outputsNeedReshape.push_back(m_outputs[outputName]);
+                return false;
             }
 
             operatorBase->setOutputParameter(outputName, tensorBase);
@@ -144,6 +223,12 @@ namespace FreeWill
                 case DataType::DOUBLE:
                     operatorBase = new Activation<ActivationMode::SIGMOID, DeviceUsed, double>(deviceId);
                     break;
+                case DataType::HALF:
+                    operatorBase = new Activation<ActivationMode::SIGMOID, DeviceUsed, Half>(deviceId);
+                    break;
+                case DataType::BFLOAT16:
+                    operatorBase = new Activation<ActivationMode::SIGMOID, DeviceUsed, BFloat16>(deviceId);
+                    break;
                 /*case UNSIGNED_INT:
                     operatorBase = new Activation<SIGMOID, DeviceUsed, unsigned int>();
                     break;*/
@@ -160,6 +245,12 @@ namespace FreeWill
                 case DataType::DOUBLE:
                     operatorBase = new Activation<ActivationMode::RELU, DeviceUsed, double>(deviceId);
                     break;
+                case DataType::HALF:
+                    operatorBase = new Activation<ActivationMode::RELU, DeviceUsed, Half>(deviceId);
+                    break;
+                case DataType::BFLOAT16:
+                    operatorBase = new Activation<ActivationMode::RELU, DeviceUsed, BFloat16>(deviceId);
+                    break;
                 /*case UNSIGNED_INT:
                     operatorBase = new Activation<RELU, DeviceUsed, unsigned int>();
                     break;*/
@@ -177,6 +268,12 @@ namespace FreeWill
                 case DataType::DOUBLE:
                     operatorBase = new Activation<ActivationMode::TANH, DeviceUsed, double>(deviceId);
                     break;
+                case DataType::HALF:
+                    operatorBase = new Activation<ActivationMode::TANH, DeviceUsed, Half>(deviceId);
+                    break;
+                case DataType::BFLOAT16:
+                    operatorBase = new Activation<ActivationMode::TANH, DeviceUsed, BFloat16>(deviceId);
+                    break;
                 /*case UNSIGNED_INT:
                     operatorBase = new Activation<TANH, DeviceUsed, unsigned int>();
                     break;*/
@@ -194,6 +291,12 @@ namespace FreeWill
                 case DataType::DOUBLE:
                     operatorBase = new Activation<ActivationMode::CLIPPED_RELU, DeviceUsed, double>(deviceId);
                     break;
+                case DataType::HALF:
+                    operatorBase = new Activation<ActivationMode::CLIPPED_RELU, DeviceUsed, Half>(deviceId);
+                    break;
+                case DataType::BFLOAT16:
+                    operatorBase = new Activation<ActivationMode::CLIPPED_RELU, DeviceUsed, BFloat16>(deviceId);
+                    break;
                 /*case UNSIGNED_INT:
                     operatorBase = new Activation<CLIPPED_RELU, DeviceUsed, unsigned int>();
                     break;*/
@@ -207,7 +310,26 @@ namespace FreeWill
             if (!setInput(operatorBase, "Input", tensors, deviceId) || !setOutput(operatorBase, "Output", tensors, deviceId))
             {
                 delete operatorBase;
-                operatorBase = nullptr;
+                return nullptr;
+            }
+
+            // a dropout fused by Model::fuseOperators, its Seed and Mask come along
+            if (m_parameters.find("Dropout") != m_parameters.end() && !m_isInference)
+            {
+                dynamic_cast<DropoutState*>(operatorBase)->fuseDropout(std::any_cast<float>(m_parameters["Dropout"]),
+                                                                       dropoutStream(tensors, m_outputs["Seed"], deviceId));
+
+                if (m_parameters.find("Replay") != m_parameters.end())
+                {
+                    dynamic_cast<DropoutState*>(operatorBase)->replayDropout();
+                }
+
+                if (!setOutput(operatorBase, "Seed", tensors, deviceId) ||
+                        (m_outputs.find("Mask") != m_outputs.end() && !setOutput(operatorBase, "Mask", tensors, deviceId)))
+                {
+                    delete operatorBase;
+                    return nullptr;
+                }
             }
 
             return operatorBase;
@@ -235,6 +357,12 @@ namespace FreeWill
                 case DataType::DOUBLE:
                     operatorBase = new ActivationDerivative<ActivationMode::SIGMOID, DeviceUsed, double>(deviceId);
                     break;
+                case DataType::HALF:
+                    operatorBase = new ActivationDerivative<ActivationMode::SIGMOID, DeviceUsed, Half>(deviceId);
+                    break;
+                case DataType::BFLOAT16:
+                    operatorBase = new ActivationDerivative<ActivationMode::SIGMOID, DeviceUsed, BFloat16>(deviceId);
+                    break;
                 /*case UNSIGNED_INT:
                     operatorBase = new ActivationDerivative<SIGMOID, DeviceUsed, unsigned int>();
                     break;*/
@@ -251,6 +379,12 @@ namespace FreeWill
                 case DataType::DOUBLE:
                     operatorBase = new ActivationDerivative<ActivationMode::RELU, DeviceUsed, double>(deviceId);
                     break;
+                case DataType::HALF:
+                    operatorBase = new ActivationDerivative<ActivationMode::RELU, DeviceUsed, Half>(deviceId);
+                    break;
+                case DataType::BFLOAT16:
+                    operatorBase = new ActivationDerivative<ActivationMode::RELU, DeviceUsed, BFloat16>(deviceId);
+                    break;
                 /*case UNSIGNED_INT:
                     operatorBase = new ActivationDerivative<RELU, DeviceUsed, unsigned int>();
                     break;*/
@@ -267,6 +401,12 @@ namespace FreeWill
                 case DataType::DOUBLE:
                     operatorBase = new ActivationDerivative<ActivationMode::TANH, DeviceUsed, double>(deviceId);
                     break;
+                case DataType::HALF:
+                    operatorBase = new ActivationDerivative<ActivationMode::TANH, DeviceUsed, Half>(deviceId);
+                    break;
+                case DataType::BFLOAT16:
+                    operatorBase = new ActivationDerivative<ActivationMode::TANH, DeviceUsed, BFloat16>(deviceId);
+                    break;
                 /*case UNSIGNED_INT:
                     operatorBase = new ActivationDerivative<TANH, DeviceUsed, unsigned int>();
                     break;*/
@@ -283,6 +423,12 @@ namespace FreeWill
                 case DataType::DOUBLE:
                     operatorBase = new ActivationDerivative<ActivationMode::CLIPPED_RELU, DeviceUsed, double>(deviceId);
                     break;
+                case DataType::HALF:
+                    operatorBase = new ActivationDerivative<ActivationMode::CLIPPED_RELU, DeviceUsed, Half>(deviceId);
+                    break;
+                case DataType::BFLOAT16:
+                    operatorBase = new ActivationDerivative<ActivationMode::CLIPPED_RELU, DeviceUsed, BFloat16>(deviceId);
+                    break;
                 /*case UNSIGNED_INT:
                     operatorBase = new ActivationDerivative<CLIPPED_RELU, DeviceUsed, unsigned int>();
                     break;*/
@@ -291,7 +437,10 @@ namespace FreeWill
                 }
                 break;
             }
-            if (!setInput(operatorBase, "Output", tensors, deviceId) ||
+            // a ReLU whose output was compressed reads the sign mask instead, see Model::planActivationCompression
+            bool isMasked = m_inputs.find("OutputMask") != m_inputs.end();
+
+            if (!setInput(operatorBase, isMasked ? "OutputMask" : "Output", tensors, deviceId) ||
                     !setInput(operatorBase, "OutputDelta", tensors, deviceId) ||
                     !setOutput(operatorBase, "InputDelta", tensors, deviceId))
             {
@@ -331,16 +480,82 @@ namespace FreeWill
                 zeroPaddingY = std::any_cast<unsigned int>(m_parameters["ZeroPaddingY"]);
             }
 
+            // grouped or, a group a channel, depthwise
+            unsigned int groupCount = 1;
+            if (m_parameters.find("GroupCount") != m_parameters.end())
+            {
+                groupCount = std::any_cast<unsigned int>(m_parameters["GroupCount"]);
+            }
+
+            bool hasActivation = m_parameters.find("Activation") != m_parameters.end();
+            ActivationMode activationMode = hasActivation ? std::any_cast<ActivationMode>(m_parameters["Activation"]) : ActivationMode::SIGMOID;
+
+            // only the cpu convolution, float or double, accumulates
+            bool clearsOutput = m_parameters.find("ClearOutput") != m_parameters.end();
+
+            // a batch normalization folded in by Model::fuseOperators, cpu float or double
+            bool hasNormalization = m_parameters.find("NormalizationEpsilon") != m_parameters.end();
+            float normalizationEpsilon = hasNormalization ? std::any_cast<float>(m_parameters["NormalizationEpsilon"]) : 0.0f;
+
             switch(m_dataType)
             {
             case DataType::FLOAT:
                 operatorBase = new Convolution<DeviceUsed, float>(strideX,strideY,zeroPaddingX,zeroPaddingY,deviceId);
-
+                dynamic_cast<Convolution<DeviceUsed, float>*>(operatorBase)->setGroupCount(groupCount);
+                if (hasActivation)
+                {
+                    dynamic_cast<Convolution<DeviceUsed, float>*>(operatorBase)->fuseActivation(activationMode);
+                }
+                if (clearsOutput)
+                {
+                    dynamic_cast<Convolution<DeviceUsed, float>*>(operatorBase)->clearOutputFirst();
+                }
+                if (hasNormalization)
+                {
+                    dynamic_cast<Convolution<DeviceUsed, float>*>(operatorBase)->foldNormalization(normalizationEpsilon);
+                }
                 break;
             case DataType::DOUBLE:
                 operatorBase = new Convolution<DeviceUsed, double>(strideX,strideY,zeroPaddingX,zeroPaddingY,deviceId);
-
+                dynamic_cast<Convolution<DeviceUsed, double>*>(operatorBase)->setGroupCount(groupCount);
+                if (hasActivation)
+                {
+                    dynamic_cast<Convolution<DeviceUsed, double>*>(operatorBase)->fuseActivation(activationMode);
+                }
+                if (clearsOutput)
+                {
+                    dynamic_cast<Convolution<DeviceUsed, double>*>(operatorBase)->clearOutputFirst();
+                }
+                if (hasNormalization)
+                {
+                    dynamic_cast<Convolution<DeviceUsed, double>*>(operatorBase)->foldNormalization(normalizationEpsilon);
+                }
                 break;
+            // the cpu convolution has no 16-bit kernels
+            case DataType::HALF:
+                if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+                {
+                    operatorBase = new Convolution<DeviceUsed, Half>(strideX,strideY,zeroPaddingX,zeroPaddingY,deviceId);
+                    dynamic_cast<Convolution<DeviceUsed, Half>*>(operatorBase)->setGroupCount(groupCount);
+                    if (hasActivation)
+                    {
+                        dynamic_cast<Convolution<DeviceUsed, Half>*>(operatorBase)->fuseActivation(activationMode);
+                    }
+                    break;
+                }
+                return nullptr;
+            case DataType::BFLOAT16:
+                if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+                {
+                    operatorBase = new Convolution<DeviceUsed, BFloat16>(strideX,strideY,zeroPaddingX,zeroPaddingY,deviceId);
+                    dynamic_cast<Convolution<DeviceUsed, BFloat16>*>(operatorBase)->setGroupCount(groupCount);
+                    if (hasActivation)
+                    {
+                        dynamic_cast<Convolution<DeviceUsed, BFloat16>*>(operatorBase)->fuseActivation(activationMode);
+                    }
+                    break;
+                }
+                return nullptr;
             /*case UNSIGNED_INT:
                 operatorBase = new Convolution<DeviceUsed, unsigned int>();
                 break;*/
@@ -352,7 +567,11 @@ namespace FreeWill
             if (!setInput(operatorBase, "Input", tensors, deviceId) ||
                     !setInput(operatorBase, "FeatureMap", tensors, deviceId) ||
                     !setInput(operatorBase, "Bias", tensors, deviceId) ||
-                    !setOutput(operatorBase, "Output", tensors, deviceId))
+                    !setOutput(operatorBase, "Output", tensors, deviceId) ||
+                    (hasNormalization && (!setInput(operatorBase, "NormalizationScale", tensors, deviceId) ||
+                                          !setInput(operatorBase, "NormalizationShift", tensors, deviceId) ||
+                                          !setInput(operatorBase, "NormalizationMean", tensors, deviceId) ||
+                                          !setInput(operatorBase, "NormalizationVariance", tensors, deviceId))))
             {
                 delete operatorBase;
                 return nullptr;
@@ -391,14 +610,40 @@ namespace FreeWill
                 zeroPaddingY = std::any_cast<unsigned int>(m_parameters["ZeroPaddingY"]);
             }
 
+            // grouped or, a group a channel, depthwise
+            unsigned int groupCount = 1;
+            if (m_parameters.find("GroupCount") != m_parameters.end())
+            {
+                groupCount = std::any_cast<unsigned int>(m_parameters["GroupCount"]);
+            }
+
             switch(m_dataType)
             {
             case DataType::FLOAT:
                 operatorBase = new ConvolutionDerivative<DeviceUsed, float>(strideX,strideY,zeroPaddingX,zeroPaddingY,deviceId);
+                dynamic_cast<ConvolutionDerivative<DeviceUsed, float>*>(operatorBase)->setGroupCount(groupCount);
                 break;
             case DataType::DOUBLE:
                 operatorBase = new ConvolutionDerivative<DeviceUsed, double>(strideX,strideY,zeroPaddingX,zeroPaddingY,deviceId);
+                dynamic_cast<ConvolutionDerivative<DeviceUsed, double>*>(operatorBase)->setGroupCount(groupCount);
                 break;
+            // the cpu convolution has no 16-bit kernels
+            case DataType::HALF:
+                if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+                {
+                    operatorBase = new ConvolutionDerivative<DeviceUsed, Half>(strideX,strideY,zeroPaddingX,zeroPaddingY,deviceId);
+                    dynamic_cast<ConvolutionDerivative<DeviceUsed, Half>*>(operatorBase)->setGroupCount(groupCount);
+                    break;
+                }
+                return nullptr;
+            case DataType::BFLOAT16:
+                if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+                {
+                    operatorBase = new ConvolutionDerivative<DeviceUsed, BFloat16>(strideX,strideY,zeroPaddingX,zeroPaddingY,deviceId);
+                    dynamic_cast<ConvolutionDerivative<DeviceUsed, BFloat16>*>(operatorBase)->setGroupCount(groupCount);
+                    break;
+                }
+                return nullptr;
             /*case UNSIGNED_INT:
                 operatorBase = new ConvolutionDerivative<DeviceUsed, unsigned int>();
                 break;*/
@@ -437,6 +682,8 @@ namespace FreeWill
             /*case UNSIGNED_INT:
                 operatorBase = new CrossEntropyLoss<DeviceUsed, unsigned int>();
                 break;*/
+            case DataType::HALF:
+            case DataType::BFLOAT16:
             case DataType::UNSIGNED_INT:
                 return nullptr;
             }
@@ -465,14 +712,49 @@ namespace FreeWill
                 hasBias = std::any_cast<bool>(m_parameters["HasBias"]);
             }
 
+            bool hasActivation = m_parameters.find("Activation") != m_parameters.end();
+            ActivationMode activationMode = hasActivation ? std::any_cast<ActivationMode>(m_parameters["Activation"]) : ActivationMode::SIGMOID;
+
+            // the models stacked along the last dimension of the weight, see DotProductWithBias
+            unsigned int modelCount = 1;
+            if (m_parameters.find("ModelCount") != m_parameters.end())
+            {
+                modelCount = std::any_cast<unsigned int>(m_parameters["ModelCount"]);
+            }
+
             switch(m_dataType)
             {
             case DataType::FLOAT:
                 operatorBase = new DotProductWithBias<DeviceUsed, float>(hasBias, deviceId);
-
+                dynamic_cast<DotProductWithBias<DeviceUsed, float>*>(operatorBase)->setModelCount(modelCount);
+                if (hasActivation)
+                {
+                    dynamic_cast<DotProductWithBias<DeviceUsed, float>*>(operatorBase)->fuseActivation(activationMode);
+                }
                 break;
             case DataType::DOUBLE:
                 operatorBase = new DotProductWithBias<DeviceUsed, double>(hasBias, deviceId);
+                dynamic_cast<DotProductWithBias<DeviceUsed, double>*>(operatorBase)->setModelCount(modelCount);
+                if (hasActivation)
+                {
+                    dynamic_cast<DotProductWithBias<DeviceUsed, double>*>(operatorBase)->fuseActivation(activationMode);
+                }
+                break;
+            case DataType::HALF:
+                operatorBase = new DotProductWithBias<DeviceUsed, Half>(hasBias, deviceId);
+                dynamic_cast<DotProductWithBias<DeviceUsed, Half>*>(operatorBase)->setModelCount(modelCount);
+                if (hasActivation)
+                {
+                    dynamic_cast<DotProductWithBias<DeviceUsed, Half>*>(operatorBase)->fuseActivation(activationMode);
+                }
+                break;
+            case DataType::BFLOAT16:
+                operatorBase = new DotProductWithBias<DeviceUsed, BFloat16>(hasBias, deviceId);
+                dynamic_cast<DotProductWithBias<DeviceUsed, BFloat16>*>(operatorBase)->setModelCount(modelCount);
+                if (hasActivation)
+                {
+                    dynamic_cast<DotProductWithBias<DeviceUsed, BFloat16>*>(operatorBase)->fuseActivation(activationMode);
+                }
                 break;
             /*case UNSIGNED_INT:
                 operatorBase = new DotProductWithBias<DeviceUsed, unsigned int>();
@@ -481,9 +763,14 @@ namespace FreeWill
                 return nullptr;
             }
 
+            // a sparse batch in CSR, Input holds the values
+            bool isSparse = m_inputs.find("SparseRowOffsets") != m_inputs.end();
+
             if (!setInput(operatorBase, "Input", tensors, deviceId) ||
                     !setInput(operatorBase, "Weight", tensors, deviceId) ||
                     !setInput(operatorBase, "Bias", tensors, deviceId) ||
+                    (isSparse && (!setInput(operatorBase, "SparseRowOffsets", tensors, deviceId) ||
+                                  !setInput(operatorBase, "SparseColumns", tensors, deviceId))) ||
                     !setOutput(operatorBase, "Output", tensors, deviceId))
             {
                 delete operatorBase;
@@ -505,13 +792,29 @@ namespace FreeWill
                 hasBias = std::any_cast<bool>(m_parameters["HasBias"]);
             }
 
+            unsigned int modelCount = 1;
+            if (m_parameters.find("ModelCount") != m_parameters.end())
+            {
+                modelCount = std::any_cast<unsigned int>(m_parameters["ModelCount"]);
+            }
+
             switch(m_dataType)
             {
             case DataType::FLOAT:
                 operatorBase = new DotProductWithBiasDerivative<DeviceUsed, float>(hasBias, deviceId);
+                dynamic_cast<DotProductWithBiasDerivative<DeviceUsed, float>*>(operatorBase)->setModelCount(modelCount);
                 break;
             case DataType::DOUBLE:
                 operatorBase = new DotProductWithBiasDerivative<DeviceUsed, double>(hasBias, deviceId);
+                dynamic_cast<DotProductWithBiasDerivative<DeviceUsed, double>*>(operatorBase)->setModelCount(modelCount);
+                break;
+            case DataType::HALF:
+                operatorBase = new DotProductWithBiasDerivative<DeviceUsed, Half>(hasBias, deviceId);
+                dynamic_cast<DotProductWithBiasDerivative<DeviceUsed, Half>*>(operatorBase)->setModelCount(modelCount);
+                break;
+            case DataType::BFLOAT16:
+                operatorBase = new DotProductWithBiasDerivative<DeviceUsed, BFloat16>(hasBias, deviceId);
+                dynamic_cast<DotProductWithBiasDerivative<DeviceUsed, BFloat16>*>(operatorBase)->setModelCount(modelCount);
                 break;
             /*case UNSIGNED_INT:
                 operatorBase = new DotProductWithBiasDerivative<DeviceUsed, unsigned int>();
@@ -521,12 +824,17 @@ namespace FreeWill
                 return nullptr;
             }
 
+            // the gradient of sparse values is only computed when asked for
+            bool isSparse = m_inputs.find("SparseRowOffsets") != m_inputs.end();
+
             if (!setInput(operatorBase, "InputActivation", tensors, deviceId) ||
                     !setInput(operatorBase, "OutputDelta", tensors, deviceId) ||
                     !setInput(operatorBase, "Weight", tensors, deviceId) ||
+                    (isSparse && (!setInput(operatorBase, "SparseRowOffsets", tensors, deviceId) ||
+                                  !setInput(operatorBase, "SparseColumns", tensors, deviceId))) ||
                     !setOutput(operatorBase, "WeightGrad", tensors, deviceId) ||
                     !setOutput(operatorBase, "BiasGrad", tensors, deviceId) ||
-                    !setOutput(operatorBase, "InputDelta", tensors, deviceId))
+                    ((!isSparse || m_outputs.find("InputDelta") != m_outputs.end()) && !setOutput(operatorBase, "InputDelta", tensors, deviceId)))
             {
                 delete operatorBase;
                 return nullptr;
@@ -558,10 +866,39 @@ namespace FreeWill
             /*case UNSIGNED_INT:
                 operatorBase = new ElementwiseAdd<DeviceUsed, unsigned int>();
                 break;*/
+            case DataType::HALF:
+            case DataType::BFLOAT16:
             case DataType::UNSIGNED_INT:
                 return nullptr;
             }
 
+            // an activation derivative fused in by Model::fuseOperators replaces DerivativeOperand
+            if (m_parameters.find("ActivationDerivative") != m_parameters.end())
+            {
+                ActivationMode mode = std::any_cast<ActivationMode>(m_parameters["ActivationDerivative"]);
+                bool isDerivativeOperandA = std::any_cast<std::string>(m_parameters["DerivativeOperand"]) == "OperandA";
+
+                if (m_dataType == DataType::FLOAT)
+                {
+                    dynamic_cast<ElementwiseAdd<DeviceUsed, float>*>(operatorBase)->fuseActivationDerivative(mode, isDerivativeOperandA);
+                }
+                else
+                {
+                    dynamic_cast<ElementwiseAdd<DeviceUsed, double>*>(operatorBase)->fuseActivationDerivative(mode, isDerivativeOperandA);
+                }
+
+                if (!setInput(operatorBase, isDerivativeOperandA ? "OperandB" : "OperandA", tensors, deviceId) ||
+                        !setInput(operatorBase, "Output", tensors, deviceId) ||
+                        !setInput(operatorBase, "OutputDelta", tensors, deviceId) ||
+                        !setOutput(operatorBase, "Result", tensors, deviceId))
+                {
+                    delete operatorBase;
+                    return nullptr;
+                }
+
+                return operatorBase;
+            }
+
             if (!setInput(operatorBase, "OperandA", tensors, deviceId) ||
                     !setInput(operatorBase, "OperandB", tensors, deviceId) ||
                     !setOutput(operatorBase, "Result", tensors, deviceId))
@@ -589,19 +926,37 @@ namespace FreeWill
             /*case UNSIGNED_INT:
                 operatorBase = new MaxPooling<DeviceUsed, unsigned int>();
                 break;*/
+            case DataType::HALF:
+            case DataType::BFLOAT16:
             case DataType::UNSIGNED_INT:
                 return nullptr;
             }
 
             if (!setInput(operatorBase, "Input", tensors, deviceId) ||
                     !setOutput(operatorBase, "Output", tensors, deviceId) ||
-                    !setOutput(operatorBase, "SwitchX", tensors, deviceId) ||
-                    !setOutput(operatorBase, "SwitchY", tensors, deviceId))
+                    !setOutput(operatorBase, "Switch", tensors, deviceId))
             {
                 delete operatorBase;
                 return nullptr;
             }
 
+            if (m_parameters.find("WriteSwitch") != m_parameters.end())
+            {
+                switch(m_dataType)
+                {
+                case DataType::FLOAT:
+                    dynamic_cast<MaxPooling<DeviceUsed, float>*>(operatorBase)->writeSwitch();
+                    break;
+                case DataType::DOUBLE:
+                    dynamic_cast<MaxPooling<DeviceUsed, double>*>(operatorBase)->writeSwitch();
+                    break;
+                case DataType::HALF:
+                case DataType::BFLOAT16:
+                case DataType::UNSIGNED_INT:
+                    break;
+                }
+            }
+
             return operatorBase;
 
         }
@@ -622,6 +977,8 @@ namespace FreeWill
             /*case UNSIGNED_INT:
                 operatorBase = new MaxPoolingDerivative<DeviceUsed, unsigned int>();
                 break;*/
+            case DataType::HALF:
+            case DataType::BFLOAT16:
             case DataType::UNSIGNED_INT:
                 return nullptr;
             }
@@ -629,8 +986,7 @@ namespace FreeWill
             if constexpr (DeviceUsed == FreeWill::DeviceType::CPU_NAIVE)
             {
                 if (!setInput(operatorBase, "OutputGrad", tensors, deviceId) ||
-                    !setInput(operatorBase, "SwitchX", tensors, deviceId) ||
-                    !setInput(operatorBase, "SwitchY", tensors, deviceId) ||
+                    !setInput(operatorBase, "Switch", tensors, deviceId) ||
                     !setOutput(operatorBase, "InputGrad", tensors, deviceId))
                 {
                     delete operatorBase;
@@ -639,6 +995,20 @@ namespace FreeWill
             }
             else if constexpr (DeviceUsed == FreeWill::DeviceType::GPU_CUDA)
             {
+                // the switches alone once Model::planActivationCompression dropped the tensors
+                if (m_inputs.find("Input") == m_inputs.end())
+                {
+                    if (!setInput(operatorBase, "OutputGrad", tensors, deviceId) ||
+                        !setInput(operatorBase, "Switch", tensors, deviceId) ||
+                        !setOutput(operatorBase, "InputGrad", tensors, deviceId))
+                    {
+                        delete operatorBase;
+                        return nullptr;
+                    }
+
+                    return operatorBase;
+                }
+
                 if (!setInput(operatorBase, "Output", tensors, deviceId) ||
                     !setInput(operatorBase, "OutputGrad", tensors, deviceId) ||
                     !setInput(operatorBase, "Input", tensors, deviceId) ||
@@ -652,63 +1022,105 @@ namespace FreeWill
             return operatorBase;
         }
 
+        // A dropout and its derivative draw from the stream of the Seed tensor they share, each
+        // replica from its own, so the stream is taken once by whichever begins its init first.
+        uint64_t dropoutStream(std::map<std::string, FreeWill::TensorDescriptor*> &tensors, const TensorDescriptorHandle &seed, int deviceId)
+        {
+            TensorDescriptor *tensorDescriptor = tensors.at(seed.name());
+
+            if (tensorDescriptor->m_randomStream == 0)
+            {
+                tensorDescriptor->m_randomStream = RandomNumberGenerator::getSingleton().newStream();
+            }
+
+            return RandomNumberGenerator::deviceStream(tensorDescriptor->m_randomStream, deviceId);
+        }
+
         template<DeviceType DeviceUsed>
-        Operator<DeviceUsed> *initSigmoidCrossEntropyLossDerivative(std::map<std::string, FreeWill::TensorDescriptor*> &tensors, int deviceId)
+        Operator<DeviceUsed> *initDropout(std::map<std::string, FreeWill::TensorDescriptor*> &tensors, int deviceId)
         {
             Operator<DeviceUsed> *operatorBase = nullptr;
 
+            if (m_parameters.find("Rate") == m_parameters.end() || m_outputs.find("Seed") == m_outputs.end())
+            {
+                return nullptr;
+            }
+
+            float rate = m_isInference ? 0.0f : std::any_cast<float>(m_parameters["Rate"]);
+            uint64_t stream = dropoutStream(tensors, m_outputs["Seed"], deviceId);
+
             switch(m_dataType)
             {
             case DataType::FLOAT:
-                operatorBase = new SigmoidCrossEntropyLossDerivative<DeviceUsed, float>(deviceId);
+                operatorBase = new Dropout<DeviceUsed, float>(rate, stream, deviceId);
                 break;
             case DataType::DOUBLE:
-                operatorBase = new SigmoidCrossEntropyLossDerivative<DeviceUsed, double>(deviceId);
+                operatorBase = new Dropout<DeviceUsed, double>(rate, stream, deviceId);
+                break;
+            case DataType::HALF:
+                operatorBase = new Dropout<DeviceUsed, Half>(rate, stream, deviceId);
+                break;
+            case DataType::BFLOAT16:
+                operatorBase = new Dropout<DeviceUsed, BFloat16>(rate, stream, deviceId);
                 break;
-            /*case UNSIGNED_INT:
-                operatorBase = new SigmoidCrossEntropyLossDerivative<DeviceUsed, unsigned int>();
-
-                break;*/
             case DataType::UNSIGNED_INT:
                 return nullptr;
             }
 
+            // a copy Model::planRecomputation runs again in the backward pass
+            if (m_parameters.find("Replay") != m_parameters.end())
+            {
+                dynamic_cast<DropoutState*>(operatorBase)->replayDropout();
+            }
+
+            // without a Mask the derivative draws the mask again
             if (!setInput(operatorBase, "Input", tensors, deviceId) ||
-                    !setInput(operatorBase, "Label", tensors, deviceId) ||
-                    !setOutput(operatorBase, "Output", tensors, deviceId))
+                    !setOutput(operatorBase, "Output", tensors, deviceId) ||
+                    !setOutput(operatorBase, "Seed", tensors, deviceId) ||
+                    (m_outputs.find("Mask") != m_outputs.end() && !setOutput(operatorBase, "Mask", tensors, deviceId)))
             {
                 delete operatorBase;
                 return nullptr;
             }
 
-
             return operatorBase;
         }
 
         template<DeviceType DeviceUsed>
-        Operator<DeviceUsed> *initSoftmaxLogLoss(std::map<std::string, FreeWill::TensorDescriptor*> &tensors, int deviceId)
+        Operator<DeviceUsed> *initDropoutDerivative(std::map<std::string, FreeWill::TensorDescriptor*> &tensors, int deviceId)
         {
             Operator<DeviceUsed> *operatorBase = nullptr;
 
-            switch (m_dataType)
+            if (m_parameters.find("Rate") == m_parameters.end() || m_inputs.find("Seed") == m_inputs.end())
+            {
+                return nullptr;
+            }
+
+            float rate = std::any_cast<float>(m_parameters["Rate"]);
+            uint64_t stream = dropoutStream(tensors, m_inputs["Seed"], deviceId);
+
+            switch(m_dataType)
             {
             case DataType::FLOAT:
-                operatorBase = new SoftmaxLogLoss<DeviceUsed, float>(deviceId);
+                operatorBase = new DropoutDerivative<DeviceUsed, float>(rate, stream, deviceId);
                 break;
             case DataType::DOUBLE:
-                operatorBase = new SoftmaxLogLoss<DeviceUsed, double>(deviceId);
+                operatorBase = new DropoutDerivative<DeviceUsed, double>(rate, stream, deviceId);
+                break;
+            case DataType::HALF:
+                operatorBase = new DropoutDerivative<DeviceUsed, Half>(rate, stream, deviceId);
+                break;
+            case DataType::BFLOAT16:
+                operatorBase = new DropoutDerivative<DeviceUsed, BFloat16>(rate, stream, deviceId);
                 break;
-            /*case UNSIGNED_INT:
-                operatorBase = new SoftmaxLogLoss<DeviceUsed, unsigned int>();
-                break;*/
             case DataType::UNSIGNED_INT:
                 return nullptr;
             }
 
-            if (!setInput(operatorBase, "Input", tensors, deviceId) ||
-                    !setInput(operatorBase, "Label", tensors, deviceId) ||
-                    !setOutput(operatorBase, "Cost", tensors, deviceId) ||
-                    !setOutput(operatorBase, "Output", tensors, deviceId))
+            if (!setInput(operatorBase, "OutputDelta", tensors, deviceId) ||
+                    !setInput(operatorBase, "Seed", tensors, deviceId) ||
+                    (m_inputs.find("Mask") != m_inputs.end() && !setInput(operatorBase, "Mask", tensors, deviceId)) ||
+                    !setOutput(operatorBase, "InputDelta", tensors, deviceId))
             {
                 delete operatorBase;
                 return nullptr;
@@ -718,28 +1130,33 @@ namespace FreeWill
         }
 
         template<DeviceType DeviceUsed>
-        Operator<DeviceUsed> *initSoftmaxLogLossDerivative(std::map<std::string, FreeWill::TensorDescriptor*> &tensors, int deviceId)
+        Operator<DeviceUsed> *initMetric(std::map<std::string, FreeWill::TensorDescriptor*> &tensors, int deviceId)
         {
             Operator<DeviceUsed> *operatorBase = nullptr;
 
             switch(m_dataType)
             {
             case DataType::FLOAT:
-                operatorBase = new SoftmaxLogLossDerivative<DeviceUsed, float>(deviceId);
+                operatorBase = new Metric<DeviceUsed, float>(deviceId);
                 break;
             case DataType::DOUBLE:
-                operatorBase = new SoftmaxLogLossDerivative<DeviceUsed, double>(deviceId);
+                operatorBase = new Metric<DeviceUsed, double>(deviceId);
+                break;
+            case DataType::HALF:
+                operatorBase = new Metric<DeviceUsed, Half>(deviceId);
+                break;
+            case DataType::BFLOAT16:
+                operatorBase = new Metric<DeviceUsed, BFloat16>(deviceId);
                 break;
-            /*case UNSIGNED_INT:
-                operatorBase = new SoftmaxLogLossDerivative<DeviceUsed, unsigned int>();
-                break;*/
             case DataType::UNSIGNED_INT:
                 return nullptr;
             }
 
-            if (!setInput(operatorBase, "Output", tensors, deviceId) ||
-                    !setInput(operatorBase, "Label", tensors, deviceId) ||
-                    !setOutput(operatorBase, "InputGrad", tensors, deviceId))
+            // Cost, or Output and Label, or all three
+            if ((m_inputs.find("Cost") != m_inputs.end() && !setInput(operatorBase, "Cost", tensors, deviceId)) ||
+                    (m_inputs.find("Output") != m_inputs.end() && !setInput(operatorBase, "Output", tensors, deviceId)) ||
+                    (m_inputs.find("Label") != m_inputs.end() && !setInput(operatorBase, "Label", tensors, deviceId)) ||
+                    !setOutput(operatorBase, "Accumulator", tensors, deviceId))
             {
                 delete operatorBase;
                 return nullptr;
@@ -749,26 +1166,32 @@ namespace FreeWill
         }
 
         template<DeviceType DeviceUsed>
-        Operator<DeviceUsed> *initDuplicate(std::map<std::string, FreeWill::TensorDescriptor*> &tensors, int deviceId)
+        Operator<DeviceUsed> *initLSTM(std::map<std::string, FreeWill::TensorDescriptor*> &tensors, int deviceId)
         {
             Operator<DeviceUsed> *operatorBase = nullptr;
 
             switch(m_dataType)
             {
             case DataType::FLOAT:
-                operatorBase = new Duplicate<DeviceUsed, float>(deviceId);
+                operatorBase = new LSTM<DeviceUsed, float>(deviceId);
                 break;
             case DataType::DOUBLE:
-                operatorBase = new Duplicate<DeviceUsed, double>(deviceId);
+                operatorBase = new LSTM<DeviceUsed, double>(deviceId);
                 break;
+            case DataType::HALF:
+            case DataType::BFLOAT16:
             case DataType::UNSIGNED_INT:
-                operatorBase = new Duplicate<DeviceUsed, unsigned int>(deviceId);
-                break;
-
+                return nullptr;
             }
 
-            if (!setInput(operatorBase, "From", tensors, deviceId) ||
-                    !setOutput(operatorBase, "To", tensors, deviceId))
+            // Cell and Gates keep the states the cpu derivative reads
+            if (!setInput(operatorBase, "Input", tensors, deviceId) ||
+                    !setInput(operatorBase, "InputWeight", tensors, deviceId) ||
+                    !setInput(operatorBase, "RecurrentWeight", tensors, deviceId) ||
+                    !setInput(operatorBase, "Bias", tensors, deviceId) ||
+                    !setOutput(operatorBase, "Output", tensors, deviceId) ||
+                    (m_outputs.find("Cell") != m_outputs.end() && !setOutput(operatorBase, "Cell", tensors, deviceId)) ||
+                    (m_outputs.find("Gates") != m_outputs.end() && !setOutput(operatorBase, "Gates", tensors, deviceId)))
             {
                 delete operatorBase;
                 return nullptr;
@@ -778,118 +1201,772 @@ namespace FreeWill
         }
 
         template<DeviceType DeviceUsed>
-        void reshape(std::map<std::string, FreeWill::TensorDescriptor*> &tensors, unsigned int deviceCount)
+        Operator<DeviceUsed> *initLSTMDerivative(std::map<std::string, FreeWill::TensorDescriptor*> &tensors, int deviceId)
         {
+            Operator<DeviceUsed> *operatorBase = nullptr;
 
-            if (m_inputsNeedReshape.size() > 0)
+            switch(m_dataType)
             {
-                for(unsigned int i = 0;i<m_inputsNeedReshape.size();++i)
-                {
-                    TensorDescriptor *tensorDescriptor = tensors[m_inputsNeedReshape[i].name()];
-                    Shape newShape = m_inputsNeedReshape[i].shape();
-
-                    for (unsigned int e = 0;e<deviceCount;++e)
-                    {
-                        TensorBase<DeviceUsed> *tensorBase = tensorDescriptor->getTensorForDevice<DeviceUsed>(e);
-
-                        if (! tensorBase->reshape(tensorDescriptor->m_isBatchTensor?(newShape + tensorDescriptor->m_batchSize):newShape ))
-                        {
-                            std::cerr << "Reshape failed for tensor: " << tensorBase->name() << " from: " << tensorBase->shape() << " to: " << newShape << std::endl;
-                            return;
-                        }
-                    }
-                }
+            case DataType::FLOAT:
+                operatorBase = new LSTMDerivative<DeviceUsed, float>(deviceId);
+                break;
+            case DataType::DOUBLE:
+                operatorBase = new LSTMDerivative<DeviceUsed, double>(deviceId);
+                break;
+            case DataType::HALF:
+            case DataType::BFLOAT16:
+            case DataType::UNSIGNED_INT:
+                return nullptr;
             }
 
-            if (m_outputsNeedReshape.size() > 0)
+            // the gpu runs the sequence again and needs neither Output, Cell nor Gates
+            if (!setInput(operatorBase, "Input", tensors, deviceId) ||
+                    !setInput(operatorBase, "InputWeight", tensors, deviceId) ||
+                    !setInput(operatorBase, "RecurrentWeight", tensors, deviceId) ||
+                    !setInput(operatorBase, "Bias", tensors, deviceId) ||
+                    (m_inputs.find("Output") != m_inputs.end() && !setInput(operatorBase, "Output", tensors, deviceId)) ||
+                    (m_inputs.find("Cell") != m_inputs.end() && !setInput(operatorBase, "Cell", tensors, deviceId)) ||
+                    (m_inputs.find("Gates") != m_inputs.end() && !setInput(operatorBase, "Gates", tensors, deviceId)) ||
+                    !setInput(operatorBase, "OutputDelta", tensors, deviceId) ||
+                    !setOutput(operatorBase, "InputWeightGrad", tensors, deviceId) ||
+                    !setOutput(operatorBase, "RecurrentWeightGrad", tensors, deviceId) ||
+                    !setOutput(operatorBase, "BiasGrad", tensors, deviceId) ||
+                    !setOutput(operatorBase, "InputDelta", tensors, deviceId))
             {
-                for(unsigned int i = 0;i<m_outputsNeedReshape.size();++i)
+                delete operatorBase;
+                return nullptr;
+            }
+
+            return operatorBase;
+        }
+
+        template<DeviceType DeviceUsed>
+        Operator<DeviceUsed> *initBatchNormalization(std::map<std::string, FreeWill::TensorDescriptor*> &tensors, int deviceId)
+        {
+            Operator<DeviceUsed> *operatorBase = nullptr;
+
+            float epsilon = 1e-5f;
+            if (m_parameters.find("Epsilon") != m_parameters.end())
+            {
+                epsilon = std::any_cast<float>(m_parameters["Epsilon"]);
+            }
+
+            float momentum = 0.1f;
+            if (m_parameters.find("Momentum") != m_parameters.end())
+            {
+                momentum = std::any_cast<float>(m_parameters["Momentum"]);
+            }
+
+            switch(m_dataType)
+            {
+            case DataType::FLOAT:
+                operatorBase = new BatchNormalization<DeviceUsed, float>(epsilon, momentum, !m_isInference, deviceId);
+                break;
+            case DataType::DOUBLE:
+                operatorBase = new BatchNormalization<DeviceUsed, double>(epsilon, momentum, !m_isInference, deviceId);
+                break;
+            case DataType::HALF:
+            case DataType::BFLOAT16:
+            case DataType::UNSIGNED_INT:
+                return nullptr;
+            }
+
+            // an inference pass neither saves the statistics of its batch nor needs to
+            if (!setInput(operatorBase, "Input", tensors, deviceId) ||
+                    !setInput(operatorBase, "Scale", tensors, deviceId) ||
+                    !setInput(operatorBase, "Shift", tensors, deviceId) ||
+                    !setOutput(operatorBase, "Output", tensors, deviceId) ||
+                    !setOutput(operatorBase, "Mean", tensors, deviceId) ||
+                    !setOutput(operatorBase, "Variance", tensors, deviceId) ||
+                    (m_outputs.find("SavedMean") != m_outputs.end() && !setOutput(operatorBase, "SavedMean", tensors, deviceId)) ||
+                    (m_outputs.find("SavedInverseDeviation") != m_outputs.end() && !setOutput(operatorBase, "SavedInverseDeviation", tensors, deviceId)))
+            {
+                delete operatorBase;
+                return nullptr;
+            }
+
+            return operatorBase;
+        }
+
+        template<DeviceType DeviceUsed>
+        Operator<DeviceUsed> *initBatchNormalizationDerivative(std::map<std::string, FreeWill::TensorDescriptor*> &tensors, int deviceId)
+        {
+            Operator<DeviceUsed> *operatorBase = nullptr;
+
+            float epsilon = 1e-5f;
+            if (m_parameters.find("Epsilon") != m_parameters.end())
+            {
+                epsilon = std::any_cast<float>(m_parameters["Epsilon"]);
+            }
+
+            switch(m_dataType)
+            {
+            case DataType::FLOAT:
+                operatorBase = new BatchNormalizationDerivative<DeviceUsed, float>(epsilon, deviceId);
+                break;
+            case DataType::DOUBLE:
+                operatorBase = new BatchNormalizationDerivative<DeviceUsed, double>(epsilon, deviceId);
+                break;
+            case DataType::HALF:
+            case DataType::BFLOAT16:
+            case DataType::UNSIGNED_INT:
+                return nullptr;
+            }
+
+            if (!setInput(operatorBase, "Input", tensors, deviceId) ||
+                    !setInput(operatorBase, "Scale", tensors, deviceId) ||
+                    !setInput(operatorBase, "SavedMean", tensors, deviceId) ||
+                    !setInput(operatorBase, "SavedInverseDeviation", tensors, deviceId) ||
+                    !setInput(operatorBase, "OutputDelta", tensors, deviceId) ||
+                    !setOutput(operatorBase, "ScaleGrad", tensors, deviceId) ||
+                    !setOutput(operatorBase, "ShiftGrad", tensors, deviceId) ||
+                    !setOutput(operatorBase, "InputDelta", tensors, deviceId))
+            {
+                delete operatorBase;
+                return nullptr;
+            }
+
+            return operatorBase;
+        }
+
+        template<DeviceType DeviceUsed>
+        Operator<DeviceUsed> *initSigmoidCrossEntropyLossDerivative(std::map<std::string, FreeWill::TensorDescriptor*> &tensors, int deviceId)
+        {
+            Operator<DeviceUsed> *operatorBase = nullptr;
+
+            switch(m_dataType)
+            {
+            case DataType::FLOAT:
+                operatorBase = new SigmoidCrossEntropyLossDerivative<DeviceUsed, float>(deviceId);
+                break;
+            case DataType::DOUBLE:
+                operatorBase = new SigmoidCrossEntropyLossDerivative<DeviceUsed, double>(deviceId);
+                break;
+            /*case UNSIGNED_INT:
+                operatorBase = new SigmoidCrossEntropyLossDerivative<DeviceUsed, unsigned int>();
+
+                break;*/
+            case DataType::HALF:
+            case DataType::BFLOAT16:
+            case DataType::UNSIGNED_INT:
+                return nullptr;
+            }
+
+            if (!setInput(operatorBase, "Input", tensors, deviceId) ||
+                    !setInput(operatorBase, "Label", tensors, deviceId) ||
+                    !setOutput(operatorBase, "Output", tensors, deviceId))
+            {
+                delete operatorBase;
+                return nullptr;
+            }
+
+
+            return operatorBase;
+        }
+
+        template<DeviceType DeviceUsed>
+        Operator<DeviceUsed> *initSoftmaxLogLoss(std::map<std::string, FreeWill::TensorDescriptor*> &tensors, int deviceId)
+        {
+            Operator<DeviceUsed> *operatorBase = nullptr;
+
+            switch (m_dataType)
+            {
+            case DataType::FLOAT:
+                operatorBase = new SoftmaxLogLoss<DeviceUsed, float>(deviceId);
+                break;
+            case DataType::DOUBLE:
+                operatorBase = new SoftmaxLogLoss<DeviceUsed, double>(deviceId);
+                break;
+            case DataType::HALF:
+                operatorBase = new SoftmaxLogLoss<DeviceUsed, Half>(deviceId);
+                break;
+            case DataType::BFLOAT16:
+                operatorBase = new SoftmaxLogLoss<DeviceUsed, BFloat16>(deviceId);
+                break;
+            /*case UNSIGNED_INT:
+                operatorBase = new SoftmaxLogLoss<DeviceUsed, unsigned int>();
+                break;*/
+            case DataType::UNSIGNED_INT:
+                return nullptr;
+            }
+
+            if (!setInput(operatorBase, "Input", tensors, deviceId) ||
+                    !setInput(operatorBase, "Label", tensors, deviceId) ||
+                    !setOutput(operatorBase, "Cost", tensors, deviceId) ||
+                    !setOutput(operatorBase, "Output", tensors, deviceId))
+            {
+                delete operatorBase;
+                return nullptr;
+            }
+
+            return operatorBase;
+        }
+
+        template<DeviceType DeviceUsed>
+        Operator<DeviceUsed> *initSoftmaxLogLossDerivative(std::map<std::string, FreeWill::TensorDescriptor*> &tensors, int deviceId)
+        {
+            Operator<DeviceUsed> *operatorBase = nullptr;
+
+            switch(m_dataType)
+            {
+            case DataType::FLOAT:
+                operatorBase = new SoftmaxLogLossDerivative<DeviceUsed, float>(deviceId);
+                break;
+            case DataType::DOUBLE:
+                operatorBase = new SoftmaxLogLossDerivative<DeviceUsed, double>(deviceId);
+                break;
+            case DataType::HALF:
+                operatorBase = new SoftmaxLogLossDerivative<DeviceUsed, Half>(deviceId);
+                break;
+            case DataType::BFLOAT16:
+                operatorBase = new SoftmaxLogLossDerivative<DeviceUsed, BFloat16>(deviceId);
+                break;
+            /*case UNSIGNED_INT:
+                operatorBase = new SoftmaxLogLossDerivative<DeviceUsed, unsigned int>();
+                break;*/
+            case DataType::UNSIGNED_INT:
+                return nullptr;
+            }
+
+            if (!setInput(operatorBase, "Output", tensors, deviceId) ||
+                    !setInput(operatorBase, "Label", tensors, deviceId) ||
+                    !setOutput(operatorBase, "InputGrad", tensors, deviceId))
+            {
+                delete operatorBase;
+                return nullptr;
+            }
+
+            return operatorBase;
+        }
+
+        template<DeviceType DeviceUsed>
+        Operator<DeviceUsed> *initSoftmaxLogLossWithDerivative(std::map<std::string, FreeWill::TensorDescriptor*> &tensors, int deviceId)
+        {
+            Operator<DeviceUsed> *operatorBase = nullptr;
+
+            switch(m_dataType)
+            {
+            case DataType::FLOAT:
+                operatorBase = new SoftmaxLogLossWithDerivative<DeviceUsed, float>(deviceId);
+                break;
+            case DataType::DOUBLE:
+                operatorBase = new SoftmaxLogLossWithDerivative<DeviceUsed, double>(deviceId);
+                break;
+            case DataType::HALF:
+                operatorBase = new SoftmaxLogLossWithDerivative<DeviceUsed, Half>(deviceId);
+                break;
+            case DataType::BFLOAT16:
+                operatorBase = new SoftmaxLogLossWithDerivative<DeviceUsed, BFloat16>(deviceId);
+                break;
+            case DataType::UNSIGNED_INT:
+                return nullptr;
+            }
+
+            if (!setInput(operatorBase, "Input", tensors, deviceId) ||
+                    !setInput(operatorBase, "Label", tensors, deviceId) ||
+                    !setOutput(operatorBase, "Cost", tensors, deviceId) ||
+                    !setOutput(operatorBase, "Output", tensors, deviceId) ||
+                    !setOutput(operatorBase, "InputGrad", tensors, deviceId))
+            {
+                delete operatorBase;
+                return nullptr;
+            }
+
+            return operatorBase;
+        }
+
+        template<DeviceType DeviceUsed>
+        Operator<DeviceUsed> *initDuplicate(std::map<std::string, FreeWill::TensorDescriptor*> &tensors, int deviceId)
+        {
+            Operator<DeviceUsed> *operatorBase = nullptr;
+
+            switch(m_dataType)
+            {
+            case DataType::FLOAT:
+                operatorBase = new Duplicate<DeviceUsed, float>(deviceId);
+                break;
+            case DataType::DOUBLE:
+                operatorBase = new Duplicate<DeviceUsed, double>(deviceId);
+                break;
+            case DataType::HALF:
+                operatorBase = new Duplicate<DeviceUsed, Half>(deviceId);
+                break;
+            case DataType::BFLOAT16:
+                operatorBase = new Duplicate<DeviceUsed, BFloat16>(deviceId);
+                break;
+            case DataType::UNSIGNED_INT:
+                operatorBase = new Duplicate<DeviceUsed, unsigned int>(deviceId);
+                break;
+
+            }
+
+            if (!setInput(operatorBase, "From", tensors, deviceId) ||
+                    !setOutput(operatorBase, "To", tensors, deviceId))
+            {
+                delete operatorBase;
+                return nullptr;
+            }
+
+            return operatorBase;
+        }
+
+        template<DeviceType DeviceUsed>
+        Operator<DeviceUsed> *initLayoutTransform(std::map<std::string, FreeWill::TensorDescriptor*> &tensors, int deviceId)
+        {
+            Operator<DeviceUsed> *operatorBase = nullptr;
+
+            switch(m_dataType)
+            {
+            case DataType::FLOAT:
+                operatorBase = new LayoutTransform<DeviceUsed, float>(deviceId);
+                break;
+            case DataType::DOUBLE:
+                operatorBase = new LayoutTransform<DeviceUsed, double>(deviceId);
+                break;
+            case DataType::HALF:
+            case DataType::BFLOAT16:
+            case DataType::UNSIGNED_INT:
+                return nullptr;
+            }
+
+            if (!setInput(operatorBase, "Input", tensors, deviceId) ||
+                    !setOutput(operatorBase, "Output", tensors, deviceId))
+            {
+                delete operatorBase;
+                return nullptr;
+            }
+
+            return operatorBase;
+        }
+
+        template<DeviceType DeviceUsed>
+        Operator<DeviceUsed> *initCompressActivation(std::map<std::string, FreeWill::TensorDescriptor*> &tensors, int deviceId)
+        {
+            Operator<DeviceUsed> *operatorBase = nullptr;
+
+            switch(m_dataType)
+            {
+            case DataType::FLOAT:
+                operatorBase = new CompressActivation<DeviceUsed, float>(deviceId);
+                break;
+            case DataType::DOUBLE:
+                operatorBase = new CompressActivation<DeviceUsed, double>(deviceId);
+                break;
+            case DataType::HALF:
+                operatorBase = new CompressActivation<DeviceUsed, Half>(deviceId);
+                break;
+            case DataType::BFLOAT16:
+                operatorBase = new CompressActivation<DeviceUsed, BFloat16>(deviceId);
+                break;
+            case DataType::UNSIGNED_INT:
+                return nullptr;
+            }
+
+            if (!setInput(operatorBase, "Input", tensors, deviceId) ||
+                    !setOutput(operatorBase, "Mask", tensors, deviceId) ||
+                    (m_outputs.find("Values") != m_outputs.end() && !setOutput(operatorBase, "Values", tensors, deviceId)))
+            {
+                delete operatorBase;
+                return nullptr;
+            }
+
+            return operatorBase;
+        }
+
+        template<DeviceType DeviceUsed>
+        Operator<DeviceUsed> *initDecompressActivation(std::map<std::string, FreeWill::TensorDescriptor*> &tensors, int deviceId)
+        {
+            Operator<DeviceUsed> *operatorBase = nullptr;
+
+            switch(m_dataType)
+            {
+            case DataType::FLOAT:
+                operatorBase = new DecompressActivation<DeviceUsed, float>(deviceId);
+                break;
+            case DataType::DOUBLE:
+                operatorBase = new DecompressActivation<DeviceUsed, double>(deviceId);
+                break;
+            case DataType::HALF:
+            case DataType::BFLOAT16:
+            case DataType::UNSIGNED_INT:
+                return nullptr;
+            }
+
+            if (!setInput(operatorBase, "Values", tensors, deviceId) ||
+                    !setOutput(operatorBase, "Output", tensors, deviceId))
+            {
+                delete operatorBase;
+                return nullptr;
+            }
+
+            return operatorBase;
+        }
+
+        template<DeviceType DeviceUsed>
+        Operator<DeviceUsed> *initReshape(std::map<std::string, FreeWill::TensorDescriptor*> &tensors, int deviceId)
+        {
+            Operator<DeviceUsed> *operatorBase = nullptr;
+            if (m_parameters.find("NewShape") == m_parameters.end())
+            {
+                qDebug() << "Reshape needs to specify newshape";
+                return nullptr;
+            }
+
+            switch(m_dataType)
+            {
+            case DataType::FLOAT:
+                operatorBase = new Reshape<DeviceUsed, float>(Shape(), deviceId);
+                break;
+            case DataType::DOUBLE:
+                operatorBase = new Reshape<DeviceUsed, double>(Shape(), deviceId);
+                break;
+            case DataType::HALF:
+                operatorBase = new Reshape<DeviceUsed, Half>(Shape(), deviceId);
+                break;
+            case DataType::BFLOAT16:
+                operatorBase = new Reshape<DeviceUsed, BFloat16>(Shape(), deviceId);
+                break;
+            case DataType::UNSIGNED_INT:
+                operatorBase = new Reshape<DeviceUsed, unsigned int>(Shape(), deviceId);
+                break;
+            }
+
+            if (!setInput(operatorBase, "Tensor", tensors, deviceId))
+            {
+                delete operatorBase;
+                return nullptr;
+            }
+            return operatorBase;
+        }
+
+        template<DeviceType DeviceUsed>
+        Operator<DeviceUsed> *initQuantizedDotProductWithBias(std::map<std::string, FreeWill::TensorDescriptor*> &tensors, int deviceId)
+        {
+            bool hasBias = true;
+            if (m_parameters.find("HasBias") != m_parameters.end())
+            {
+                hasBias = std::any_cast<bool>(m_parameters["HasBias"]);
+            }
+
+            QuantizedDotProductWithBias<DeviceUsed> *operatorBase = new QuantizedDotProductWithBias<DeviceUsed>(
+                        std::any_cast<float>(m_parameters["InputRange"]), hasBias, deviceId);
+
+            if (m_parameters.find("Activation") != m_parameters.end())
+            {
+                operatorBase->fuseActivation(std::any_cast<ActivationMode>(m_parameters["Activation"]));
+            }
+
+            if (!setInput(operatorBase, "Input", tensors, deviceId) ||
+                    !setInput(operatorBase, "Weight", tensors, deviceId) ||
+                    !setInput(operatorBase, "Bias", tensors, deviceId) ||
+                    !setOutput(operatorBase, "Output", tensors, deviceId))
+            {
+                delete operatorBase;
+                return nullptr;
+            }
+
+            return operatorBase;
+        }
+
+        template<DeviceType DeviceUsed>
+        Operator<DeviceUsed> *initQuantizedConvolution(std::map<std::string, FreeWill::TensorDescriptor*> &tensors, int deviceId)
+        {
+            unsigned int geometry[4] = {1, 1, 0, 0};
+            const char *geometryNames[4] = {"StrideX", "StrideY", "ZeroPaddingX", "ZeroPaddingY"};
+
+            for (unsigned int i = 0; i < 4; ++i)
+            {
+                if (m_parameters.find(geometryNames[i]) != m_parameters.end())
                 {
-                    TensorDescriptor *tensorDescriptor = tensors[m_outputsNeedReshape[i].name()];
-                    Shape newShape = m_outputsNeedReshape[i].shape();
+                    geometry[i] = std::any_cast<unsigned int>(m_parameters[geometryNames[i]]);
+                }
+            }
+
+            QuantizedConvolution<DeviceUsed> *operatorBase = new QuantizedConvolution<DeviceUsed>(
+                        std::any_cast<float>(m_parameters["InputRange"]), geometry[0], geometry[1], geometry[2], geometry[3], deviceId);
+
+            if (m_parameters.find("Activation") != m_parameters.end())
+            {
+                operatorBase->fuseActivation(std::any_cast<ActivationMode>(m_parameters["Activation"]));
+            }
+
+            if (!setInput(operatorBase, "Input", tensors, deviceId) ||
+                    !setInput(operatorBase, "FeatureMap", tensors, deviceId) ||
+                    !setInput(operatorBase, "Bias", tensors, deviceId) ||
+                    !setOutput(operatorBase, "Output", tensors, deviceId))
+            {
+                delete operatorBase;
+                return nullptr;
+            }
 
-                    for (unsigned int e = 0;e<deviceCount;++e)
+            return operatorBase;
+        }
+
+        // float DOT_PRODUCT_WITH_BIAS and CONVOLUTION, the operators quantize() handles
+        bool isQuantizable() const;
+
+        // The weight of a DOT_PRODUCT_WITH_BIAS or CONVOLUTION, the int8 and pruned replicas
+        // only read it in init.
+        const std::string &weightName() const;
+
+        // Initializes int8 replicas of the float ones into quantizedOperators, quantizing the
+        // weight with their init. Input is quantized with the "InputRange" parameter, its
+        // calibrated magnitude. The operator itself is left as it is, swapQuantized puts them in.
+        template<DeviceType DeviceUsed>
+        bool initQuantized(std::map<std::string, TensorDescriptor*> &tensors,
+                           std::vector<std::variant<Operator<DeviceType::GPU_CUDA>*, Operator<DeviceType::CPU_NAIVE>*>> &quantizedOperators)
+        {
+            if (!isQuantizable() || m_parameters.find("InputRange") == m_parameters.end())
+            {
+                return false;
+            }
+
+            int deviceCount = Context<DeviceUsed>::getSingleton().deviceCount();
+
+            for(int i = 0; i < deviceCount; ++i)
+            {
+                if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+                {
+                    RUN_CUDA(cudaSetDevice(i));
+                }
+
+                Operator<DeviceUsed> *operatorBase = m_operatorName == OperatorName::CONVOLUTION ?
+                            initQuantizedConvolution<DeviceUsed>(tensors, i) : initQuantizedDotProductWithBias<DeviceUsed>(tensors, i);
+
+                if (!operatorBase || !operatorBase->init())
+                {
+                    delete operatorBase;
+
+                    for (unsigned int j = 0; j < quantizedOperators.size(); ++j)
                     {
-                        TensorBase<DeviceUsed> *tensorBase = tensorDescriptor->getTensorForDevice<DeviceUsed>(e);
+                        delete std::get<Operator<DeviceUsed>*>(quantizedOperators[j]);
+                    }
 
-                        if (! tensorBase->reshape(tensorDescriptor->m_isBatchTensor?(newShape + tensorDescriptor->m_batchSize):newShape ))
-                        {
-                            std::cerr << "Reshape failed for tensor: " << tensorBase->name() << " from: " << tensorBase->shape() << " to: " << newShape << std::endl;
-                            return;
-                        }
+                    quantizedOperators.clear();
+
+                    if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+                    {
+                        RUN_CUDA(cudaSetDevice(0));
                     }
+
+                    return false;
                 }
+
+                quantizedOperators.push_back(operatorBase);
+            }
+
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                RUN_CUDA(cudaSetDevice(0));
             }
 
+            return true;
         }
 
+        // Swaps the replicas of initQuantized for the float ones, which are left in operators.
+        // Swapping them back undoes it.
         template<DeviceType DeviceUsed>
-        Operator<DeviceUsed> *initReshape(std::map<std::string, FreeWill::TensorDescriptor*> &tensors, int deviceId)
+        void swapQuantized(std::vector<std::variant<Operator<DeviceType::GPU_CUDA>*, Operator<DeviceType::CPU_NAIVE>*>> &operators)
         {
-            Operator<DeviceUsed> *operatorBase = nullptr;
-            if (m_parameters.find("NewShape") == m_parameters.end())
+            m_operators[DeviceUsed].swap(operators);
+
+            if (m_parameters.find("Quantized") == m_parameters.end())
             {
-                qDebug() << "Reshape needs to specify newshape";
-                return nullptr;
+                m_parameters["Quantized"] = true;
+            }
+            else
+            {
+                m_parameters.erase("Quantized");
             }
+        }
 
-            switch(m_dataType)
+        template<DeviceType DeviceUsed, typename DataType>
+        Operator<DeviceUsed> *initPrunedDotProductWithBias(std::map<std::string, FreeWill::TensorDescriptor*> &tensors, int deviceId,
+                                                           const SparsityParameters &parameters)
+        {
+            bool hasBias = true;
+            if (m_parameters.find("HasBias") != m_parameters.end())
             {
-            case DataType::FLOAT:
-                operatorBase = new Reshape<DeviceUsed, float>(Shape(), deviceId);
-                break;
-            case DataType::DOUBLE:
-                operatorBase = new Reshape<DeviceUsed, double>(Shape(), deviceId);
-                break;
-            case DataType::UNSIGNED_INT:
-                operatorBase = new Reshape<DeviceUsed, unsigned int>(Shape(), deviceId);
-                break;
+                hasBias = std::any_cast<bool>(m_parameters["HasBias"]);
             }
 
-            if (!setInput(operatorBase, "Tensor", tensors, deviceId))
+            PrunedDotProductWithBias<DeviceUsed, DataType> *operatorBase = new PrunedDotProductWithBias<DeviceUsed, DataType>(parameters, hasBias, deviceId);
+
+            if (m_parameters.find("Activation") != m_parameters.end())
+            {
+                operatorBase->fuseActivation(std::any_cast<ActivationMode>(m_parameters["Activation"]));
+            }
+
+            if (!setInput(operatorBase, "Input", tensors, deviceId) ||
+                    !setInput(operatorBase, "Weight", tensors, deviceId) ||
+                    !setInput(operatorBase, "Bias", tensors, deviceId) ||
+                    !setOutput(operatorBase, "Output", tensors, deviceId))
             {
                 delete operatorBase;
                 return nullptr;
             }
+
             return operatorBase;
         }
 
+        // float and double DOT_PRODUCT_WITH_BIAS and CONVOLUTION on a dense weight of their own
+        // model, the operators Solver::prune handles
+        bool isPrunable() const;
+
+        // Initializes replicas of a dot product running on its weight pruned to the pattern into
+        // prunedOperators, packed by their init. Neither the weight nor the operator is changed,
+        // swapPruned puts them in.
         template<DeviceType DeviceUsed>
-        void evaluate(std::vector<WorkerMessage*> &messageQueue, std::map<std::string, FreeWill::TensorDescriptor*> &tensors)
+        bool initPruned(std::map<std::string, TensorDescriptor*> &tensors, const SparsityParameters &parameters,
+                        std::vector<std::variant<Operator<DeviceType::GPU_CUDA>*, Operator<DeviceType::CPU_NAIVE>*>> &prunedOperators)
+        {
+            if (!isPrunable() || m_operatorName != OperatorName::DOT_PRODUCT_WITH_BIAS ||
+                    (DeviceUsed == DeviceType::GPU_CUDA && m_dataType != DataType::FLOAT))
+            {
+                return false;
+            }
+
+            int deviceCount = Context<DeviceUsed>::getSingleton().deviceCount();
+
+            for(int i = 0; i < deviceCount; ++i)
+            {
+                if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+                {
+                    RUN_CUDA(cudaSetDevice(i));
+                }
+
+                Operator<DeviceUsed> *operatorBase = m_dataType == DataType::FLOAT ?
+                            initPrunedDotProductWithBias<DeviceUsed, float>(tensors, i, parameters) :
+                            initPrunedDotProductWithBias<DeviceUsed, double>(tensors, i, parameters);
+
+                if (!operatorBase || !operatorBase->init())
+                {
+                    delete operatorBase;
+
+                    for (unsigned int j = 0; j < prunedOperators.size(); ++j)
+                    {
+                        delete std::get<Operator<DeviceUsed>*>(prunedOperators[j]);
+                    }
+
+                    prunedOperators.clear();
+
+                    if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+                    {
+                        RUN_CUDA(cudaSetDevice(0));
+                    }
+
+                    return false;
+                }
+
+                prunedOperators.push_back(operatorBase);
+            }
+
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                RUN_CUDA(cudaSetDevice(0));
+            }
+
+            return true;
+        }
+
+        // Swaps the replicas of initPruned for the dense ones, which are left in operators.
+        // Swapping them back undoes it.
+        template<DeviceType DeviceUsed>
+        void swapPruned(std::vector<std::variant<Operator<DeviceType::GPU_CUDA>*, Operator<DeviceType::CPU_NAIVE>*>> &operators)
+        {
+            m_operators[DeviceUsed].swap(operators);
+
+            if (m_parameters.find("Pruned") == m_parameters.end())
+            {
+                m_parameters["Pruned"] = true;
+            }
+            else
+            {
+                m_parameters.erase("Pruned");
+            }
+        }
+
+        // one wave: every device replica of this operator evaluates once. The messages are
+        // allocated on the first wave and reused afterwards, completion is a single countdown.
+        // On gpu the replicas are launched from this thread, the launches are asynchronous and
+        // the kernels stay on this thread's default stream with the copies it orders them after.
+        // While the Profiler is enabled every replica's evaluation is recorded.
+        template<DeviceType DeviceUsed>
+        void dispatch()
         {
-            int deviceId = 0;
             unsigned int deviceCount = m_operators[DeviceUsed].size();
 
-            std::vector<WorkerMessage*> messages(deviceCount, nullptr);
+            Profiler &profiler = Profiler::getSingleton();
+            bool isProfiling = profiler.isEnabled();
+
+            if (isProfiling)
+            {
+                m_profileRecords.resize(deviceCount);
+            }
 
-            reshape<DeviceUsed>(tensors, deviceCount);
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                for(unsigned int replica = 0; replica < deviceCount; ++replica)
+                {
+                    Operator<DeviceUsed> *operatorBase = std::get<Operator<DeviceUsed>*>(m_operators[DeviceUsed][replica]);
+                    RUN_CUDA(cudaSetDevice(operatorBase->deviceId()));
 
-            auto iter = m_operators[DeviceUsed].begin();
-            //auto startTime = std::chrono::steady_clock::now();
+                    if (isProfiling)
+                    {
+                        profileRecord<DeviceUsed>(operatorBase, m_profileRecords[replica]);
+                        size_t handle = profiler.beginGPU(m_profileRecords[replica], cudaStreamPerThread);
+                        operatorBase->evaluate();
+                        profiler.endGPU(handle, cudaStreamPerThread);
+                        continue;
+                    }
 
-            for(;iter != m_operators[DeviceUsed].end(); ++iter)
+                    operatorBase->evaluate();
+                }
+
+                RUN_CUDA(cudaSetDevice(0));
+                return;
+            }
+
+            while (m_workerMessages.size() < deviceCount)
             {
-                Operator<DeviceUsed> *operatorBase = std::get<Operator<DeviceUsed>*>(*iter);
-                messages[deviceId] = new WorkerMessage(WorkerMessage::Type::FORWARD, operatorBase);
-                messages[deviceId]->debug_num = deviceId;
-                Context<DeviceUsed>::getSingleton().pushWork(deviceId, messages[deviceId]);
-                deviceId++;
-                //messageQueue.push_back(message);
+                m_workerMessages.push_back(new WorkerMessage(WorkerMessage::Type::NO_WORK, (Operator<DeviceUsed>*) nullptr));
             }
 
-            //auto middle = std::chrono::steady_clock::now();
+            m_completionLatch.reset(deviceCount);
 
-            for(int i =0;i<deviceCount;++i)
+            for(unsigned int replica = 0; replica < deviceCount; ++replica)
             {
-                messages[i]->join();
-                delete messages[i];
+                Operator<DeviceUsed> *operatorBase = std::get<Operator<DeviceUsed>*>(m_operators[DeviceUsed][replica]);
+                m_workerMessages[replica]->reset(WorkerMessage::Type::FORWARD, operatorBase, &m_completionLatch);
+                m_workerMessages[replica]->debug_num = operatorBase->deviceId();
+
+                if (isProfiling)
+                {
+                    profileRecord<DeviceUsed>(operatorBase, m_profileRecords[replica]);
+                    m_profileRecords[replica].m_queueTime = profiler.now();
+                    m_workerMessages[replica]->setProfileRecord(&m_profileRecords[replica]);
+                }
+
+                Context<DeviceUsed>::getSingleton().pushWork(operatorBase->deviceId(), m_workerMessages[replica]);
+
+                if (isProfiling)
+                {
+                    m_profileRecords[replica].m_dispatchTime = profiler.now() - m_profileRecords[replica].m_queueTime;
+                }
             }
 
-            //auto endTime = std::chrono::steady_clock::now();
-            //auto diff = middle - startTime;
+            m_completionLatch.wait();
 
-            //std::cout << "time for wait: " << std::chrono::duration <double, std::milli> (diff).count() << " ms used for 1 epoch" << std::endl;
+            for(unsigned int replica = 0; isProfiling && replica < deviceCount; ++replica)
+            {
+                profiler.record(m_profileRecords[replica]);
+            }
+        }
 
+        template<DeviceType DeviceUsed>
+        void evaluate(std::vector<WorkerMessage*> &messageQueue, std::map<std::string, FreeWill::TensorDescriptor*> &tensors)
+        {
+            dispatch<DeviceUsed>();
         }
 
         template<DeviceType DeviceUsed>
@@ -897,14 +1974,6 @@ namespace FreeWill
         {
             auto iter = m_operators[DeviceUsed].begin();
 
-            int deviceId = 0;
-            unsigned int deviceCount = m_operators[DeviceUsed].size();
-
-            std::vector<WorkerMessage*> messages(deviceCount, nullptr);
-
-            reshape<DeviceUsed>(tensors, deviceCount);
-
-
             for(;iter != m_operators[DeviceUsed].end(); ++iter)
             {
                 Operator<DeviceUsed> *operatorBase = std::get<Operator<DeviceUsed>*>(*iter);
@@ -922,7 +1991,19 @@ namespace FreeWill
                 case FreeWill::OperatorName::SIGMOID_CROSS_ENTROPY_LOSS_DERIVATIVE:
                 case FreeWill::OperatorName::SOFTMAX_LOG_LOSS:
                 case FreeWill::OperatorName::SOFTMAX_LOG_LOSS_DERIVATIVE:
+                case FreeWill::OperatorName::SOFTMAX_LOG_LOSS_WITH_DERIVATIVE:
                 case FreeWill::OperatorName::RESHAPE:
+                case FreeWill::OperatorName::DUPLICATE:
+                case FreeWill::OperatorName::LAYOUT_TRANSFORM:
+                case FreeWill::OperatorName::DROPOUT:
+                case FreeWill::OperatorName::DROPOUT_DERIVATIVE:
+                case FreeWill::OperatorName::METRIC:
+                case FreeWill::OperatorName::LSTM:
+                case FreeWill::OperatorName::LSTM_DERIVATIVE:
+                case FreeWill::OperatorName::BATCH_NORMALIZATION:
+                case FreeWill::OperatorName::BATCH_NORMALIZATION_DERIVATIVE:
+                case FreeWill::OperatorName::COMPRESS_ACTIVATION:
+                case FreeWill::OperatorName::DECOMPRESS_ACTIVATION:
                     break;
                 case FreeWill::OperatorName::ELEMENTWISE_ADD:
                     if (newParameters.find("Rate") != newParameters.end())
@@ -937,25 +2018,146 @@ namespace FreeWill
                             dynamic_cast<ElementwiseAdd<DeviceUsed, double>*>(operatorBase)->setRate(rate);
                             break;
                         case DataType::UNSIGNED_INT:
+                        case DataType::HALF:
+                        case DataType::BFLOAT16:
                             break;
                         }
                     }
                     break;
                 }
 
-                //operatorBase->evaluate();
+            }
+
+            dispatch<DeviceUsed>();
+        }
+
+        template<DeviceType DeviceUsed, typename DataType>
+        void setOperatorLossScale(Operator<DeviceUsed> *operatorBase, double lossScale)
+        {
+            if (m_operatorName == OperatorName::SOFTMAX_LOG_LOSS_DERIVATIVE)
+            {
+                dynamic_cast<SoftmaxLogLossDerivative<DeviceUsed, DataType>*>(operatorBase)->setLossScale(lossScale);
+            }
+            else if (m_operatorName == OperatorName::SIGMOID_CROSS_ENTROPY_LOSS_DERIVATIVE)
+            {
+                dynamic_cast<SigmoidCrossEntropyLossDerivative<DeviceUsed, DataType>*>(operatorBase)->setLossScale(lossScale);
+            }
+            else
+            {
+                dynamic_cast<SoftmaxLogLossWithDerivative<DeviceUsed, DataType>*>(operatorBase)->setLossScale(lossScale);
+            }
+        }
+
+        // the loss gradients are multiplied by lossScale, other operators are left alone
+        template<DeviceType DeviceUsed>
+        void setLossScale(double lossScale)
+        {
+            if (m_operatorName != OperatorName::SOFTMAX_LOG_LOSS_DERIVATIVE && m_operatorName != OperatorName::SOFTMAX_LOG_LOSS_WITH_DERIVATIVE &&
+                    m_operatorName != OperatorName::SIGMOID_CROSS_ENTROPY_LOSS_DERIVATIVE)
+            {
+                return;
+            }
+
+            for (auto iter = m_operators[DeviceUsed].begin(); iter != m_operators[DeviceUsed].end(); ++iter)
+            {
+                Operator<DeviceUsed> *operatorBase = std::get<Operator<DeviceUsed>*>(*iter);
+
+                switch(m_dataType)
+                {
+                case DataType::FLOAT:
+                    setOperatorLossScale<DeviceUsed, float>(operatorBase, lossScale);
+                    break;
+                case DataType::DOUBLE:
+                    setOperatorLossScale<DeviceUsed, double>(operatorBase, lossScale);
+                    break;
+                case DataType::HALF:
+                    setOperatorLossScale<DeviceUsed, Half>(operatorBase, lossScale);
+                    break;
+                case DataType::BFLOAT16:
+                    setOperatorLossScale<DeviceUsed, BFloat16>(operatorBase, lossScale);
+                    break;
+                case DataType::UNSIGNED_INT:
+                    break;
+                }
+            }
+        }
+
+        template<DeviceType DeviceUsed, typename DataType>
+        void setOperatorAccumulating(Operator<DeviceUsed> *operatorBase, bool isAccumulating)
+        {
+            if (m_operatorName == OperatorName::DOT_PRODUCT_WITH_BIAS_DERIVATIVE)
+            {
+                dynamic_cast<DotProductWithBiasDerivative<DeviceUsed, DataType>*>(operatorBase)->setAccumulating(isAccumulating);
+            }
+            else if (m_operatorName == OperatorName::LSTM_DERIVATIVE)
+            {
+                // float and double only
+                if constexpr (std::is_same<DataType, float>::value || std::is_same<DataType, double>::value)
+                {
+                    dynamic_cast<LSTMDerivative<DeviceUsed, DataType>*>(operatorBase)->setAccumulating(isAccumulating);
+                }
+            }
+            else if (m_operatorName == OperatorName::BATCH_NORMALIZATION_DERIVATIVE)
+            {
+                if constexpr (std::is_same<DataType, float>::value || std::is_same<DataType, double>::value)
+                {
+                    dynamic_cast<BatchNormalizationDerivative<DeviceUsed, DataType>*>(operatorBase)->setAccumulating(isAccumulating);
+                }
+            }
+            else
+            {
+                dynamic_cast<ConvolutionDerivative<DeviceUsed, DataType>*>(operatorBase)->setAccumulating(isAccumulating);
+            }
+        }
+
+        // the gpu weight derivatives add their gradients to what their outputs hold instead of
+        // overwriting it, other operators are left alone. The cpu ones always add.
+        template<DeviceType DeviceUsed>
+        void setAccumulating(bool isAccumulating)
+        {
+            if (DeviceUsed != DeviceType::GPU_CUDA ||
+                    (m_operatorName != OperatorName::DOT_PRODUCT_WITH_BIAS_DERIVATIVE && m_operatorName != OperatorName::CONVOLUTION_DERIVATIVE &&
+                     m_operatorName != OperatorName::LSTM_DERIVATIVE && m_operatorName != OperatorName::BATCH_NORMALIZATION_DERIVATIVE))
+            {
+                return;
+            }
+
+            for (auto iter = m_operators[DeviceUsed].begin(); iter != m_operators[DeviceUsed].end(); ++iter)
+            {
+                Operator<DeviceUsed> *operatorBase = std::get<Operator<DeviceUsed>*>(*iter);
 
-                messages[deviceId] /*WorkerMessage *message*/ = new WorkerMessage(WorkerMessage::Type::FORWARD, operatorBase);
-                Context<DeviceUsed>::getSingleton().pushWork(deviceId, messages[deviceId] /* message*/);
-                deviceId++;
+                switch(m_dataType)
+                {
+                case DataType::FLOAT:
+                    setOperatorAccumulating<DeviceUsed, float>(operatorBase, isAccumulating);
+                    break;
+                case DataType::DOUBLE:
+                    setOperatorAccumulating<DeviceUsed, double>(operatorBase, isAccumulating);
+                    break;
+                case DataType::HALF:
+                    setOperatorAccumulating<DeviceUsed, Half>(operatorBase, isAccumulating);
+                    break;
+                case DataType::BFLOAT16:
+                    setOperatorAccumulating<DeviceUsed, BFloat16>(operatorBase, isAccumulating);
+                    break;
+                case DataType::UNSIGNED_INT:
+                    break;
+                }
             }
+        }
 
-            for(int i =0;i<deviceCount;++i)
+        // the plans of the initialized replicas
+        template<DeviceType DeviceUsed = DeviceType::CPU_NAIVE>
+        std::vector<std::string> plans()
+        {
+            std::vector<std::string> operatorPlans;
+
+            for (auto iter = m_operators[DeviceUsed].begin(); iter != m_operators[DeviceUsed].end(); ++iter)
             {
-                messages[i]->join();
-                delete messages[i];
+                operatorPlans.push_back(std::get<Operator<DeviceUsed>*>(*iter)->plan());
             }
 
+            return operatorPlans;
         }
 
         template<DeviceType DeviceUsed = DeviceType::CPU_NAIVE>
@@ -963,76 +2165,177 @@ namespace FreeWill
         {
             int deviceCount = Context<DeviceUsed>::getSingleton().deviceCount();
 
-            qDebug() << "init operator" << m_name.c_str();
+            beginInit<DeviceUsed>(tensors);
 
-            for(int i =0;i<deviceCount;++i)
+            for(int i = 0;i<deviceCount;++i)
             {
-                Operator<DeviceUsed> *operatorBase = nullptr;
-
-                switch(m_operatorName)
+                if (!initReplica<DeviceUsed>(tensors, i))
                 {
-                case OperatorName::ACTIVATION:
-                    operatorBase = initActivation<DeviceUsed>(tensors, i);
-                break;
-                case OperatorName::ACTIVATION_DERIVATIVE:
-                    operatorBase = initActivationDerivative<DeviceUsed>(tensors, i);
-                break;
-                case OperatorName::CONVOLUTION:
-                    operatorBase = initConvolution<DeviceUsed>(tensors, i);
-                break;
-                case OperatorName::CONVOLUTION_DERIVATIVE:
-                    operatorBase = initConvolutionDerivative<DeviceUsed>(tensors, i);
-                break;
-                case OperatorName::CROSS_ENTROPY_LOSS:
-                    operatorBase = initCrossEntropyLoss<DeviceUsed>(tensors, i);
-                break;
-                case OperatorName::DOT_PRODUCT_WITH_BIAS:
-                    operatorBase = initDotProductWithBias<DeviceUsed>(tensors, i);
-                break;
-                case OperatorName::DOT_PRODUCT_WITH_BIAS_DERIVATIVE:
-                    operatorBase = initDotProductWithBiasDerivative<DeviceUsed>(tensors, i);
-                break;
-                case OperatorName::ELEMENTWISE_ADD:
-                    operatorBase = initElementwiseAdd<DeviceUsed>(tensors, i);
-                break;
-                case OperatorName::MAX_POOLING:
-                    operatorBase = initMaxPooling<DeviceUsed>(tensors, i);
-                break;
-                case OperatorName::MAX_POOLING_DERIVATIVE:
-                    operatorBase = initMaxPoolingDerivative<DeviceUsed>(tensors, i);
-                break;
-                case OperatorName::SIGMOID_CROSS_ENTROPY_LOSS_DERIVATIVE:
-                    operatorBase = initSigmoidCrossEntropyLossDerivative<DeviceUsed>(tensors, i);
-                break;
-                case OperatorName::SOFTMAX_LOG_LOSS:
-                    operatorBase = initSoftmaxLogLoss<DeviceUsed>(tensors, i);
-                break;
-                case OperatorName::SOFTMAX_LOG_LOSS_DERIVATIVE:
-                    operatorBase = initSoftmaxLogLossDerivative<DeviceUsed>(tensors, i);
-                break;
-                case OperatorName::DUPLICATE:
-                    operatorBase = initDuplicate<DeviceUsed>(tensors, i);
-                break;
-                case OperatorName::RESHAPE:
-                    operatorBase = initReshape<DeviceUsed>(tensors, i);
-                break;
+                    endInit<DeviceUsed>();
+                    return false;
                 }
+            }
+
+            return endInit<DeviceUsed>();
+        }
+
+        // init() one replica at a time, so that each device can create its own at the same time
+        // (see Model::initOperators): beginInit, then initReplica for every device from any thread,
+        // one per device, then endInit. What the replicas share, the stream of a dropout, is taken
+        // in beginInit.
+        template<DeviceType DeviceUsed>
+        void beginInit(std::map<std::string, TensorDescriptor*> &tensors)
+        {
+            // a placed operator has its only replica on m_deviceId
+            unsigned int replicaCount = m_deviceId < 0 ? Context<DeviceUsed>::getSingleton().deviceCount() : 1;
+
+            m_operators[DeviceUsed].assign(replicaCount, (Operator<DeviceUsed>*) nullptr);
 
-                if (!operatorBase)
+            for (const std::map<std::string, TensorDescriptorHandle> *handles : {&m_inputs, &m_outputs})
+            {
+                auto seed = handles->find("Seed");
+
+                if (seed != handles->end())
                 {
-                    return false;
+                    dropoutStream(tensors, seed->second, 0);
                 }
+            }
+        }
+
+        template<DeviceType DeviceUsed>
+        bool initReplica(std::map<std::string, TensorDescriptor*> &tensors, int deviceId)
+        {
+            if (m_deviceId >= 0 && deviceId != m_deviceId)
+            {
+                return true;
+            }
+
+            unsigned int replica = m_deviceId < 0 ? deviceId : 0;
+            Operator<DeviceUsed> *operatorBase = nullptr;
+
+            switch(m_operatorName)
+            {
+            case OperatorName::ACTIVATION:
+                operatorBase = initActivation<DeviceUsed>(tensors, deviceId);
+            break;
+            case OperatorName::ACTIVATION_DERIVATIVE:
+                operatorBase = initActivationDerivative<DeviceUsed>(tensors, deviceId);
+            break;
+            case OperatorName::CONVOLUTION:
+                operatorBase = initConvolution<DeviceUsed>(tensors, deviceId);
+            break;
+            case OperatorName::CONVOLUTION_DERIVATIVE:
+                operatorBase = initConvolutionDerivative<DeviceUsed>(tensors, deviceId);
+            break;
+            case OperatorName::CROSS_ENTROPY_LOSS:
+                operatorBase = initCrossEntropyLoss<DeviceUsed>(tensors, deviceId);
+            break;
+            case OperatorName::DOT_PRODUCT_WITH_BIAS:
+                operatorBase = initDotProductWithBias<DeviceUsed>(tensors, deviceId);
+            break;
+            case OperatorName::DOT_PRODUCT_WITH_BIAS_DERIVATIVE:
+                operatorBase = initDotProductWithBiasDerivative<DeviceUsed>(tensors, deviceId);
+            break;
+            case OperatorName::ELEMENTWISE_ADD:
+                operatorBase = initElementwiseAdd<DeviceUsed>(tensors, deviceId);
+            break;
+            case OperatorName::MAX_POOLING:
+                operatorBase = initMaxPooling<DeviceUsed>(tensors, deviceId);
+            break;
+            case OperatorName::MAX_POOLING_DERIVATIVE:
+                operatorBase = initMaxPoolingDerivative<DeviceUsed>(tensors, deviceId);
+            break;
+            case OperatorName::SIGMOID_CROSS_ENTROPY_LOSS_DERIVATIVE:
+                operatorBase = initSigmoidCrossEntropyLossDerivative<DeviceUsed>(tensors, deviceId);
+            break;
+            case OperatorName::SOFTMAX_LOG_LOSS:
+                operatorBase = initSoftmaxLogLoss<DeviceUsed>(tensors, deviceId);
+            break;
+            case OperatorName::SOFTMAX_LOG_LOSS_DERIVATIVE:
+                operatorBase = initSoftmaxLogLossDerivative<DeviceUsed>(tensors, deviceId);
+            break;
+            case OperatorName::SOFTMAX_LOG_LOSS_WITH_DERIVATIVE:
+                operatorBase = initSoftmaxLogLossWithDerivative<DeviceUsed>(tensors, deviceId);
+            break;
+            case OperatorName::DUPLICATE:
+                operatorBase = initDuplicate<DeviceUsed>(tensors, deviceId);
+            break;
+            case OperatorName::RESHAPE:
+                operatorBase = initReshape<DeviceUsed>(tensors, deviceId);
+            break;
+            case OperatorName::LAYOUT_TRANSFORM:
+                operatorBase = initLayoutTransform<DeviceUsed>(tensors, deviceId);
+            break;
+            case OperatorName::DROPOUT:
+                operatorBase = initDropout<DeviceUsed>(tensors, deviceId);
+            break;
+            case OperatorName::DROPOUT_DERIVATIVE:
+                operatorBase = initDropoutDerivative<DeviceUsed>(tensors, deviceId);
+            break;
+            case OperatorName::METRIC:
+                operatorBase = initMetric<DeviceUsed>(tensors, deviceId);
+            break;
+            case OperatorName::LSTM:
+                operatorBase = initLSTM<DeviceUsed>(tensors, deviceId);
+            break;
+            case OperatorName::LSTM_DERIVATIVE:
+                operatorBase = initLSTMDerivative<DeviceUsed>(tensors, deviceId);
+            break;
+            case OperatorName::BATCH_NORMALIZATION:
+                operatorBase = initBatchNormalization<DeviceUsed>(tensors, deviceId);
+            break;
+            case OperatorName::BATCH_NORMALIZATION_DERIVATIVE:
+                operatorBase = initBatchNormalizationDerivative<DeviceUsed>(tensors, deviceId);
+            break;
+            case OperatorName::COMPRESS_ACTIVATION:
+                operatorBase = initCompressActivation<DeviceUsed>(tensors, deviceId);
+            break;
+            case OperatorName::DECOMPRESS_ACTIVATION:
+                operatorBase = initDecompressActivation<DeviceUsed>(tensors, deviceId);
+            break;
+            }
+
+            if (!operatorBase)
+            {
+                return false;
+            }
+
+            if (replica < m_plans[DeviceUsed].size() && !m_plans[DeviceUsed][replica].empty())
+            {
+                operatorBase->setPlan(m_plans[DeviceUsed][replica]);
+            }
+
+            if (!operatorBase->init())
+            {
+                delete operatorBase;
+                return false;
+            }
+
+            m_operators[DeviceUsed][replica] = operatorBase;
 
-                reshape<DeviceUsed>(tensors, deviceCount);
+            return true;
+        }
+
+        // false, with the replicas deleted, unless every replica was created
+        template<DeviceType DeviceUsed>
+        bool endInit()
+        {
+            std::vector<std::variant<Operator<DeviceType::GPU_CUDA>*, Operator<DeviceType::CPU_NAIVE>*>> &replicas = m_operators[DeviceUsed];
 
-                if (!operatorBase->init())
+            for (unsigned int i = 0; i < replicas.size(); ++i)
+            {
+                if (!std::get<Operator<DeviceUsed>*>(replicas[i]))
                 {
-                    delete operatorBase;
+                    for (unsigned int e = 0; e < replicas.size(); ++e)
+                    {
+                        delete std::get<Operator<DeviceUsed>*>(replicas[e]);
+                    }
+
+                    replicas.clear();
                     return false;
                 }
-
-                m_operators[DeviceUsed].push_back(operatorBase);
             }
+
             return true;
         }
     };
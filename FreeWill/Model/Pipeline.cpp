@@ -0,0 +1,431 @@
+#include "Pipeline.h"
+#include "Model.h"
+#include <algorithm>
+#include <iostream>
+
+FreeWill::Pipeline::Pipeline()
+    :m_model(nullptr),
+      m_deviceUsed(DeviceType::CPU_NAIVE),
+      m_microBatchCount(1),
+      m_forwardSteps(),
+      m_backwardSteps(),
+      m_accumulations()
+{
+}
+
+FreeWill::Pipeline::~Pipeline()
+{
+    clear();
+}
+
+template<FreeWill::DeviceType DeviceUsed>
+void FreeWill::Pipeline::deleteOperator(std::variant<Operator<DeviceType::CPU_NAIVE>*, Operator<DeviceType::GPU_CUDA>*> &operatorBase)
+{
+    delete std::get<Operator<DeviceUsed>*>(operatorBase);
+    operatorBase = (Operator<DeviceUsed>*) nullptr;
+}
+
+void FreeWill::Pipeline::clear()
+{
+    for (std::vector<Step> *steps : {&m_forwardSteps, &m_backwardSteps})
+    {
+        for (Step &step : *steps)
+        {
+            if (step.m_operatorDescriptor)
+            {
+                continue;
+            }
+
+            switch (m_deviceUsed)
+            {
+            case DeviceType::CPU_NAIVE:
+                deleteOperator<DeviceType::CPU_NAIVE>(step.m_transfer);
+                break;
+            case DeviceType::GPU_CUDA:
+                deleteOperator<DeviceType::GPU_CUDA>(step.m_transfer);
+                break;
+            }
+        }
+
+        steps->clear();
+    }
+
+    for (Accumulation &accumulation : m_accumulations)
+    {
+        switch (m_deviceUsed)
+        {
+        case DeviceType::CPU_NAIVE:
+            deleteOperator<DeviceType::CPU_NAIVE>(accumulation.m_copy);
+            deleteOperator<DeviceType::CPU_NAIVE>(accumulation.m_add);
+            break;
+        case DeviceType::GPU_CUDA:
+            deleteOperator<DeviceType::GPU_CUDA>(accumulation.m_copy);
+            deleteOperator<DeviceType::GPU_CUDA>(accumulation.m_add);
+            break;
+        }
+    }
+
+    m_accumulations.clear();
+    m_model = nullptr;
+    m_microBatchCount = 1;
+}
+
+template<FreeWill::DeviceType DeviceUsed, typename DataType>
+static FreeWill::Operator<DeviceUsed> *createTransfer(unsigned int deviceId, unsigned int sourceDeviceId)
+{
+    return new FreeWill::Duplicate<DeviceUsed, DataType>(deviceId, sourceDeviceId);
+}
+
+template<FreeWill::DeviceType DeviceUsed>
+static FreeWill::Operator<DeviceUsed> *createTransfer(FreeWill::DataType dataType, unsigned int deviceId, unsigned int sourceDeviceId)
+{
+    switch (dataType)
+    {
+    case FreeWill::DataType::FLOAT:
+        return createTransfer<DeviceUsed, float>(deviceId, sourceDeviceId);
+    case FreeWill::DataType::DOUBLE:
+        return createTransfer<DeviceUsed, double>(deviceId, sourceDeviceId);
+    case FreeWill::DataType::UNSIGNED_INT:
+        return createTransfer<DeviceUsed, unsigned int>(deviceId, sourceDeviceId);
+    case FreeWill::DataType::HALF:
+        return createTransfer<DeviceUsed, FreeWill::Half>(deviceId, sourceDeviceId);
+    case FreeWill::DataType::BFLOAT16:
+        return createTransfer<DeviceUsed, FreeWill::BFloat16>(deviceId, sourceDeviceId);
+    }
+
+    return nullptr;
+}
+
+// holders lists the devices whose replica of a tensor has its current value, the last writer
+// first
+template<FreeWill::DeviceType DeviceUsed>
+bool FreeWill::Pipeline::addSteps(const std::vector<std::string> &path, std::map<std::string, std::vector<unsigned int>> &holders, std::vector<Step> &steps)
+{
+    for (const std::string &operatorName : path)
+    {
+        OperatorDescriptor *operatorDescriptor = m_model->m_operators[operatorName];
+        unsigned int deviceId = operatorDescriptor->m_deviceId;
+
+        // what the operator reads, and what it only adds to or partly writes
+        std::vector<std::string> readTensors;
+        for (auto iter = operatorDescriptor->m_inputs.begin(); iter != operatorDescriptor->m_inputs.end(); ++iter)
+        {
+            readTensors.push_back(iter->second.name());
+        }
+
+        for (auto iter = operatorDescriptor->m_outputs.begin(); iter != operatorDescriptor->m_outputs.end(); ++iter)
+        {
+            if (!operatorDescriptor->overwritesOutput(iter->first))
+            {
+                readTensors.push_back(iter->second.name());
+            }
+        }
+
+        for (const std::string &tensorName : readTensors)
+        {
+            std::vector<unsigned int> &tensorHolders = holders[tensorName];
+
+            if (std::find(tensorHolders.begin(), tensorHolders.end(), deviceId) != tensorHolders.end())
+            {
+                continue;
+            }
+
+            TensorDescriptor *tensorDescriptor = m_model->m_tensors[tensorName];
+            unsigned int sourceDeviceId = tensorHolders.front();
+            int replica = tensorDescriptor->replicaIndex(deviceId);
+            int sourceReplica = tensorDescriptor->replicaIndex(sourceDeviceId);
+
+            if (replica < 0 || sourceReplica < 0)
+            {
+                std::cerr << "tensor " << tensorName << " can't be moved from device " << sourceDeviceId << " to device " << deviceId << std::endl;
+                return false;
+            }
+
+            Operator<DeviceUsed> *transfer = createTransfer<DeviceUsed>(tensorDescriptor->m_dataType, deviceId, sourceDeviceId);
+            transfer->setInputParameter("From", tensorDescriptor->getTensorForDevice<DeviceUsed>(sourceReplica));
+            transfer->setOutputParameter("To", tensorDescriptor->getTensorForDevice<DeviceUsed>(replica));
+
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                RUN_CUDA(cudaSetDevice(deviceId));
+            }
+
+            bool isInitialized = transfer->init();
+
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                RUN_CUDA(cudaSetDevice(0));
+            }
+
+            if (!isInitialized)
+            {
+                delete transfer;
+                std::cerr << "can't init the transfer of tensor " << tensorName << std::endl;
+                return false;
+            }
+
+            steps.push_back({nullptr, transfer, deviceId, sourceDeviceId});
+            tensorHolders.push_back(deviceId);
+        }
+
+        steps.push_back({operatorDescriptor, (Operator<DeviceUsed>*) nullptr, deviceId, deviceId});
+
+        for (auto iter = operatorDescriptor->m_outputs.begin(); iter != operatorDescriptor->m_outputs.end(); ++iter)
+        {
+            holders[iter->second.name()] = {deviceId};
+        }
+    }
+
+    return true;
+}
+
+template<FreeWill::DeviceType DeviceUsed, typename DataType>
+static bool createAccumulation(FreeWill::TensorBase<DeviceUsed> *gradient, FreeWill::TensorBase<DeviceUsed> *accumulator, unsigned int deviceId,
+                               FreeWill::Operator<DeviceUsed> *&copy, FreeWill::Operator<DeviceUsed> *&add)
+{
+    copy = new FreeWill::Duplicate<DeviceUsed, DataType>(deviceId);
+    copy->setInputParameter("From", gradient);
+    copy->setOutputParameter("To", accumulator);
+
+    add = new FreeWill::ElementwiseAdd<DeviceUsed, DataType>(1.0f, deviceId);
+    add->setInputParameter("OperandA", accumulator);
+    add->setInputParameter("OperandB", gradient);
+    add->setOutputParameter("Result", accumulator);
+
+    return copy->init() && add->init();
+}
+
+template<FreeWill::DeviceType DeviceUsed>
+bool FreeWill::Pipeline::addAccumulation(const std::string &gradientName, const std::string &accumulatorName)
+{
+    if (m_model->m_tensors.find(gradientName) == m_model->m_tensors.end() ||
+            m_model->m_tensors.find(accumulatorName) == m_model->m_tensors.end())
+    {
+        return false;
+    }
+
+    TensorDescriptor *gradient = m_model->m_tensors[gradientName];
+    TensorDescriptor *accumulator = m_model->m_tensors[accumulatorName];
+
+    if (gradient->m_deviceIds.size() != 1 || accumulator->m_deviceIds != gradient->m_deviceIds)
+    {
+        return false;
+    }
+
+    unsigned int deviceId = gradient->deviceId(0);
+    TensorBase<DeviceUsed> *gradientTensor = gradient->getTensorForDevice<DeviceUsed>(0);
+    TensorBase<DeviceUsed> *accumulatorTensor = accumulator->getTensorForDevice<DeviceUsed>(0);
+
+    if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+    {
+        RUN_CUDA(cudaSetDevice(deviceId));
+    }
+
+    Operator<DeviceUsed> *copy = nullptr;
+    Operator<DeviceUsed> *add = nullptr;
+    bool isCreated = false;
+
+    switch (gradient->m_dataType)
+    {
+    case DataType::FLOAT:
+        isCreated = createAccumulation<DeviceUsed, float>(gradientTensor, accumulatorTensor, deviceId, copy, add);
+        break;
+    case DataType::DOUBLE:
+        isCreated = createAccumulation<DeviceUsed, double>(gradientTensor, accumulatorTensor, deviceId, copy, add);
+        break;
+    case DataType::HALF:
+        isCreated = createAccumulation<DeviceUsed, Half>(gradientTensor, accumulatorTensor, deviceId, copy, add);
+        break;
+    case DataType::BFLOAT16:
+        isCreated = createAccumulation<DeviceUsed, BFloat16>(gradientTensor, accumulatorTensor, deviceId, copy, add);
+        break;
+    case DataType::UNSIGNED_INT:
+        break;
+    }
+
+    if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+    {
+        RUN_CUDA(cudaSetDevice(0));
+    }
+
+    m_accumulations.push_back({copy, add, deviceId});
+
+    return isCreated;
+}
+
+bool FreeWill::Pipeline::build(FreeWill::Model *model, DeviceType deviceUsed, unsigned int microBatchCount,
+                               const std::map<std::string, std::string> &accumulators, bool isForwardOnly)
+{
+    clear();
+
+    if (!model->isPipelined() || microBatchCount == 0)
+    {
+        return false;
+    }
+
+    m_model = model;
+    m_deviceUsed = deviceUsed;
+    m_microBatchCount = microBatchCount;
+
+    // the caller fills every replica of the tensors no operator writes
+    std::map<std::string, std::vector<unsigned int>> holders;
+    for (auto iter = model->m_tensors.begin(); iter != model->m_tensors.end(); ++iter)
+    {
+        holders[iter->first] = iter->second->m_deviceIds;
+    }
+
+    const std::vector<std::string> noBackwardPath;
+    const std::vector<std::string> &backwardPath = isForwardOnly ? noBackwardPath : model->m_backwardPath;
+    bool isBuilt = false;
+
+    // each micro-batch repeats the same moves in its own window, one walk over the paths finds them
+    switch (deviceUsed)
+    {
+    case DeviceType::CPU_NAIVE:
+        isBuilt = addSteps<DeviceType::CPU_NAIVE>(model->m_forwardPath, holders, m_forwardSteps) &&
+                addSteps<DeviceType::CPU_NAIVE>(backwardPath, holders, m_backwardSteps);
+        for (auto iter = accumulators.begin(); iter != accumulators.end() && isBuilt; ++iter)
+        {
+            isBuilt = addAccumulation<DeviceType::CPU_NAIVE>(iter->first, iter->second);
+        }
+        break;
+    case DeviceType::GPU_CUDA:
+        isBuilt = addSteps<DeviceType::GPU_CUDA>(model->m_forwardPath, holders, m_forwardSteps) &&
+                addSteps<DeviceType::GPU_CUDA>(backwardPath, holders, m_backwardSteps);
+        for (auto iter = accumulators.begin(); iter != accumulators.end() && isBuilt; ++iter)
+        {
+            isBuilt = addAccumulation<DeviceType::GPU_CUDA>(iter->first, iter->second);
+        }
+        break;
+    }
+
+    if (!isBuilt)
+    {
+        clear();
+        return false;
+    }
+
+    return true;
+}
+
+unsigned int FreeWill::Pipeline::microBatchCount() const
+{
+    unsigned int batchSize = m_model ? m_model->batchSize() : 0;
+
+    return (m_microBatchCount > 1 && batchSize % m_microBatchCount == 0) ? m_microBatchCount : 1;
+}
+
+template<FreeWill::DeviceType DeviceUsed>
+void FreeWill::Pipeline::runSteps(std::vector<Step> &steps)
+{
+    std::vector<WorkerMessage*> messageQueue;
+
+    for (Step &step : steps)
+    {
+        if (step.m_operatorDescriptor)
+        {
+            step.m_operatorDescriptor->evaluate<DeviceUsed>(messageQueue, m_model->m_tensors);
+            continue;
+        }
+
+        if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+        {
+            // the copy is queued on the destination, after the source has queued the write
+            Context<DeviceUsed>::getSingleton().waitForDevice(step.m_deviceId, step.m_sourceDeviceId);
+            RUN_CUDA(cudaSetDevice(step.m_deviceId));
+        }
+
+        std::get<Operator<DeviceUsed>*>(step.m_transfer)->evaluate();
+
+        if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+        {
+            RUN_CUDA(cudaSetDevice(0));
+        }
+    }
+}
+
+template<FreeWill::DeviceType DeviceUsed>
+void FreeWill::Pipeline::accumulate(bool isFirstMicroBatch)
+{
+    for (Accumulation &accumulation : m_accumulations)
+    {
+        if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+        {
+            RUN_CUDA(cudaSetDevice(accumulation.m_deviceId));
+        }
+
+        std::get<Operator<DeviceUsed>*>(isFirstMicroBatch ? accumulation.m_copy : accumulation.m_add)->evaluate();
+    }
+
+    if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+    {
+        RUN_CUDA(cudaSetDevice(0));
+    }
+}
+
+void FreeWill::Pipeline::run(std::vector<Step> &steps, bool isBackward)
+{
+    unsigned int batchSize = m_model->batchSize();
+    unsigned int microBatchCount = this->microBatchCount();
+    unsigned int microBatchSize = batchSize / microBatchCount;
+
+    for (unsigned int i = 0; i < microBatchCount; ++i)
+    {
+        // the last micro-batch of the forward pass is the first whose gradients are ready
+        unsigned int microBatch = isBackward ? microBatchCount - 1 - i : i;
+
+        if (microBatchCount > 1)
+        {
+            m_model->setBatchWindow(microBatch * microBatchSize, microBatchSize);
+        }
+
+        switch (m_deviceUsed)
+        {
+        case DeviceType::CPU_NAIVE:
+            runSteps<DeviceType::CPU_NAIVE>(steps);
+            if (isBackward)
+            {
+                accumulate<DeviceType::CPU_NAIVE>(i == 0);
+            }
+            break;
+        case DeviceType::GPU_CUDA:
+            runSteps<DeviceType::GPU_CUDA>(steps);
+            if (isBackward)
+            {
+                accumulate<DeviceType::GPU_CUDA>(i == 0);
+            }
+            break;
+        }
+    }
+
+    if (microBatchCount > 1)
+    {
+        m_model->setBatchWindow(0, batchSize);
+    }
+}
+
+void FreeWill::Pipeline::forward()
+{
+    if (!isBuilt())
+    {
+        return;
+    }
+
+    // the transfers of the last pass may still read what this one overwrites
+    if (m_deviceUsed == DeviceType::GPU_CUDA)
+    {
+        Context<DeviceType::GPU_CUDA>::getSingleton().joinDevices();
+    }
+
+    run(m_forwardSteps, false);
+}
+
+void FreeWill::Pipeline::backward()
+{
+    if (!isBuilt())
+    {
+        return;
+    }
+
+    run(m_backwardSteps, true);
+}
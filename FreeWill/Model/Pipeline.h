@@ -0,0 +1,101 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "../DeviceSelection.h"
+#include "../Operator/Operator.h"
+#include <map>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace FreeWill
+{
+    class Model;
+    class OperatorDescriptor;
+
+    // Runs a pipelined model (Model::placeOperators): every device holds a stage of the graph
+    // and the batch is split into micro-batches, each a window of the batch tensors (see
+    // TensorBase::setBatchWindow). forward() runs the forward path over one micro-batch after
+    // the other, backward() the backward path in reverse order, GPipe style. On gpu the
+    // launches are asynchronous, so a stage already works on the next micro-batch while the
+    // following stage takes the previous one.
+    //
+    // Where an operator reads a tensor last written on another device a transfer copies the
+    // micro-batch over first, on gpu peer to peer once the source device has queued the write.
+    // The weight gradients of the micro-batches are summed into accumulators where the
+    // operator writing them overwrites its output, so that the update sees the gradient of the
+    // whole batch.
+    class Pipeline
+    {
+    private:
+        // a path operator, or a transfer (m_operatorDescriptor is null) from m_sourceDeviceId
+        struct Step
+        {
+            OperatorDescriptor *m_operatorDescriptor;
+            std::variant<Operator<DeviceType::CPU_NAIVE>*, Operator<DeviceType::GPU_CUDA>*> m_transfer;
+            unsigned int m_deviceId;
+            unsigned int m_sourceDeviceId;
+        };
+
+        // after each micro-batch's backward pass: the first one copies its gradient into the
+        // accumulator, the others add theirs
+        struct Accumulation
+        {
+            std::variant<Operator<DeviceType::CPU_NAIVE>*, Operator<DeviceType::GPU_CUDA>*> m_copy;
+            std::variant<Operator<DeviceType::CPU_NAIVE>*, Operator<DeviceType::GPU_CUDA>*> m_add;
+            unsigned int m_deviceId;
+        };
+
+        Model *m_model;
+        DeviceType m_deviceUsed;
+        unsigned int m_microBatchCount;
+        std::vector<Step> m_forwardSteps;
+        std::vector<Step> m_backwardSteps;
+        std::vector<Accumulation> m_accumulations;
+
+        template<DeviceType DeviceUsed>
+        bool addSteps(const std::vector<std::string> &path, std::map<std::string, std::vector<unsigned int>> &holders, std::vector<Step> &steps);
+
+        template<DeviceType DeviceUsed>
+        bool addAccumulation(const std::string &gradientName, const std::string &accumulatorName);
+
+        template<DeviceType DeviceUsed>
+        void runSteps(std::vector<Step> &steps);
+
+        template<DeviceType DeviceUsed>
+        void accumulate(bool isFirstMicroBatch);
+
+        template<DeviceType DeviceUsed>
+        void deleteOperator(std::variant<Operator<DeviceType::CPU_NAIVE>*, Operator<DeviceType::GPU_CUDA>*> &operatorBase);
+
+        void run(std::vector<Step> &steps, bool isBackward);
+
+    public:
+        Pipeline();
+        ~Pipeline();
+
+        Pipeline(const Pipeline &) = delete;
+        void operator=(const Pipeline &) = delete;
+
+        // after Model::init. accumulators maps the gradients the solver sums over the
+        // micro-batches to the tensors they are summed into, with isForwardOnly the backward
+        // path isn't scheduled.
+        bool build(Model *model, DeviceType deviceUsed, unsigned int microBatchCount,
+                   const std::map<std::string, std::string> &accumulators, bool isForwardOnly);
+
+        void clear();
+
+        bool isBuilt() const
+        {
+            return m_model != nullptr;
+        }
+
+        // the micro-batches that split the current batch of the model, 1 when it doesn't divide
+        unsigned int microBatchCount() const;
+
+        void forward();
+        void backward();
+    };
+}
+
+#endif
@@ -0,0 +1,283 @@
+#include "PrefetchSchedule.h"
+#include "Model.h"
+#include "../Context/ComputeStream.h"
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+
+FreeWill::PrefetchSchedule::PrefetchSchedule()
+    :m_model(nullptr),
+      m_deviceCount(0),
+      m_parameters(),
+      m_forwardSteps(),
+      m_backwardSteps(),
+      m_evictedTensors(),
+      m_prefetchEvents(),
+      m_computeEvents()
+{
+}
+
+FreeWill::PrefetchSchedule::~PrefetchSchedule()
+{
+    clear();
+}
+
+void FreeWill::PrefetchSchedule::clear()
+{
+    for (unsigned int d = 0; d < m_prefetchEvents.size(); ++d)
+    {
+        RUN_CUDA(cudaSetDevice(d));
+
+        for (cudaEvent_t event : m_prefetchEvents[d])
+        {
+            RUN_CUDA(cudaEventDestroy(event));
+        }
+
+        RUN_CUDA(cudaEventDestroy(m_computeEvents[d]));
+    }
+
+    if (!m_prefetchEvents.empty())
+    {
+        RUN_CUDA(cudaSetDevice(0));
+    }
+
+    m_prefetchEvents.clear();
+    m_computeEvents.clear();
+    m_forwardSteps.clear();
+    m_backwardSteps.clear();
+    m_evictedTensors.clear();
+    m_deviceCount = 0;
+    m_model = nullptr;
+}
+
+bool FreeWill::PrefetchSchedule::build(FreeWill::Model *model, const std::vector<FreeWill::OperatorDescriptor*> &forwardPath,
+                                       const std::vector<FreeWill::OperatorDescriptor*> &backwardPath,
+                                       const FreeWill::ManagedMemoryParameters &parameters)
+{
+    clear();
+
+    m_deviceCount = Context<DeviceType::GPU_CUDA>::getSingleton().deviceCount();
+    m_parameters = parameters;
+
+    // the weights, their gradients and what the optimizer keeps for them are needed by the
+    // update between the passes, they stay on the devices
+    std::set<std::string> residentTensors;
+
+    for (auto iter = model->m_updatePairs.begin(); iter != model->m_updatePairs.end(); ++iter)
+    {
+        residentTensors.insert(iter->first.name());
+        residentTensors.insert(iter->second.name());
+    }
+
+    for (auto iter = model->m_companionTensors.begin(); iter != model->m_companionTensors.end(); ++iter)
+    {
+        residentTensors.insert(iter->first);
+    }
+
+    auto tensorNames = [](OperatorDescriptor *operatorDescriptor)
+    {
+        std::set<std::string> names;
+
+        for (auto iter = operatorDescriptor->m_inputs.begin(); iter != operatorDescriptor->m_inputs.end(); ++iter)
+        {
+            names.insert(iter->second.name());
+        }
+
+        for (auto iter = operatorDescriptor->m_outputs.begin(); iter != operatorDescriptor->m_outputs.end(); ++iter)
+        {
+            names.insert(iter->second.name());
+        }
+
+        return names;
+    };
+
+    std::map<std::string, unsigned int> lastForwardUses;
+    std::map<std::string, unsigned int> firstBackwardUses;
+
+    for (unsigned int i = 0; i < forwardPath.size(); ++i)
+    {
+        for (const std::string &name : tensorNames(forwardPath[i]))
+        {
+            lastForwardUses[name] = i;
+        }
+    }
+
+    for (unsigned int i = backwardPath.size(); i-- > 0;)
+    {
+        for (const std::string &name : tensorNames(backwardPath[i]))
+        {
+            firstBackwardUses[name] = i;
+        }
+    }
+
+    // the managed tensors of every device, the ones allocated before managed memory was on
+    // (e.g. shared weights) can't be prefetched
+    auto deviceTensors = [&](const std::string &name)
+    {
+        std::vector<TensorBase<DeviceType::GPU_CUDA>*> tensors(m_deviceCount, nullptr);
+        TensorDescriptor *descriptor = model->m_tensors[name];
+
+        for (unsigned int d = 0; descriptor && d < m_deviceCount && d < descriptor->m_tensors[DeviceType::GPU_CUDA].size(); ++d)
+        {
+            TensorBase<DeviceType::GPU_CUDA> *tensor = descriptor->getTensorForDevice<DeviceType::GPU_CUDA>(d);
+            cudaPointerAttributes attributes;
+
+            if (tensor && tensor->gpuDataHandle() &&
+                    cudaPointerGetAttributes(&attributes, tensor->gpuDataHandle()) == cudaSuccess &&
+                    attributes.type == cudaMemoryTypeManaged)
+            {
+                tensors[d] = tensor;
+            }
+        }
+
+        // a failed lookup leaves an error behind for the next launch check
+        cudaGetLastError();
+
+        return tensors;
+    };
+
+    for (const std::vector<OperatorDescriptor*> *path : {&forwardPath, &backwardPath})
+    {
+        bool isForward = path == &forwardPath;
+        std::vector<Step> &steps = isForward ? m_forwardSteps : m_backwardSteps;
+
+        for (unsigned int i = 0; i < path->size(); ++i)
+        {
+            Step step = {(*path)[i], std::vector<std::vector<TensorBase<DeviceType::GPU_CUDA>*>>(m_deviceCount),
+                         std::vector<std::vector<TensorBase<DeviceType::GPU_CUDA>*>>(m_deviceCount)};
+
+            for (const std::string &name : tensorNames((*path)[i]))
+            {
+                std::vector<TensorBase<DeviceType::GPU_CUDA>*> tensors = deviceTensors(name);
+
+                // operators left before the end of the forward pass plus those into the backward one
+                bool isEvicted = isForward && lastForwardUses[name] == i && residentTensors.count(name) == 0 &&
+                        firstBackwardUses.count(name) != 0 &&
+                        (path->size() - 1 - i) + firstBackwardUses[name] >= m_parameters.m_evictionDistance;
+
+                for (unsigned int d = 0; d < m_deviceCount; ++d)
+                {
+                    if (!tensors[d])
+                    {
+                        continue;
+                    }
+
+                    step.m_tensors[d].push_back(tensors[d]);
+
+                    if (isEvicted)
+                    {
+                        step.m_evictions[d].push_back(tensors[d]);
+                        m_evictedTensors.insert(tensors[d]);
+                    }
+                }
+            }
+
+            steps.push_back(step);
+        }
+    }
+
+    unsigned int stepCount = std::max(m_forwardSteps.size(), m_backwardSteps.size());
+
+    m_prefetchEvents.resize(m_deviceCount);
+    m_computeEvents.resize(m_deviceCount);
+
+    for (unsigned int d = 0; d < m_deviceCount; ++d)
+    {
+        RUN_CUDA(cudaSetDevice(d));
+
+        m_prefetchEvents[d].resize(stepCount);
+
+        for (unsigned int i = 0; i < stepCount; ++i)
+        {
+            RUN_CUDA(cudaEventCreateWithFlags(&m_prefetchEvents[d][i], cudaEventDisableTiming));
+        }
+
+        RUN_CUDA(cudaEventCreateWithFlags(&m_computeEvents[d], cudaEventDisableTiming));
+    }
+
+    RUN_CUDA(cudaSetDevice(0));
+
+    m_model = model;
+
+    return true;
+}
+
+void FreeWill::PrefetchSchedule::prefetch(Step &step, unsigned int device, unsigned int stepIndex)
+{
+    cudaStream_t copyStream = Context<DeviceType::GPU_CUDA>::getSingleton().copyStream(device);
+
+    for (TensorBase<DeviceType::GPU_CUDA> *tensor : step.m_tensors[device])
+    {
+        if (m_evictedTensors.count(tensor))
+        {
+            RUN_CUDA(cudaMemAdvise(tensor->gpuDataHandle(), tensor->sizeInByte(), cudaMemAdviseSetPreferredLocation, device));
+        }
+
+        RUN_CUDA(cudaMemPrefetchAsync(tensor->gpuDataHandle(), tensor->sizeInByte(), device, copyStream));
+    }
+
+    RUN_CUDA(cudaEventRecord(m_prefetchEvents[device][stepIndex], copyStream));
+}
+
+void FreeWill::PrefetchSchedule::evict(Step &step, unsigned int device)
+{
+    cudaStream_t copyStream = Context<DeviceType::GPU_CUDA>::getSingleton().copyStream(device);
+
+    // the page outs start once the operator is done with the tensors
+    RUN_CUDA(cudaEventRecord(m_computeEvents[device], computeStream()));
+    RUN_CUDA(cudaStreamWaitEvent(copyStream, m_computeEvents[device], 0));
+
+    for (TensorBase<DeviceType::GPU_CUDA> *tensor : step.m_evictions[device])
+    {
+        RUN_CUDA(cudaMemAdvise(tensor->gpuDataHandle(), tensor->sizeInByte(), cudaMemAdviseSetPreferredLocation, cudaCpuDeviceId));
+        RUN_CUDA(cudaMemPrefetchAsync(tensor->gpuDataHandle(), tensor->sizeInByte(), cudaCpuDeviceId, copyStream));
+    }
+}
+
+void FreeWill::PrefetchSchedule::run(std::vector<Step> &steps)
+{
+    std::vector<WorkerMessage*> messageQueue;
+    unsigned int prefetchedCount = 0;
+
+    for (unsigned int i = 0; i < steps.size(); ++i)
+    {
+        for (; prefetchedCount < steps.size() && prefetchedCount <= i + m_parameters.m_prefetchDistance; ++prefetchedCount)
+        {
+            for (unsigned int d = 0; d < m_deviceCount; ++d)
+            {
+                RUN_CUDA(cudaSetDevice(d));
+                prefetch(steps[prefetchedCount], d, prefetchedCount);
+            }
+        }
+
+        for (unsigned int d = 0; d < m_deviceCount; ++d)
+        {
+            RUN_CUDA(cudaSetDevice(d));
+            RUN_CUDA(cudaStreamWaitEvent(computeStream(), m_prefetchEvents[d][i], 0));
+        }
+
+        steps[i].m_operatorDescriptor->evaluate<DeviceType::GPU_CUDA>(messageQueue, m_model->m_tensors);
+
+        for (unsigned int d = 0; d < m_deviceCount; ++d)
+        {
+            if (!steps[i].m_evictions[d].empty())
+            {
+                RUN_CUDA(cudaSetDevice(d));
+                evict(steps[i], d);
+            }
+        }
+    }
+
+    RUN_CUDA(cudaSetDevice(0));
+}
+
+void FreeWill::PrefetchSchedule::forward()
+{
+    run(m_forwardSteps);
+}
+
+void FreeWill::PrefetchSchedule::backward()
+{
+    run(m_backwardSteps);
+}
@@ -0,0 +1,88 @@
+#ifndef PREFETCHSCHEDULE_H
+#define PREFETCHSCHEDULE_H
+
+#include "../DeviceSelection.h"
+#include "../Tensor/ReferenceCountedBlob.h"
+#include <cuda_runtime.h>
+#include <set>
+#include <vector>
+
+namespace FreeWill
+{
+    class Model;
+    class OperatorDescriptor;
+    template<DeviceType DeviceUsed>
+    class TensorBase;
+
+    // How a gpu solver trains a model larger than the devices, see Solver::m_managedMemory.
+    //
+    // The tensors come from cudaMallocManaged (BlobAllocator::setManagedMemory), so that they
+    // can outgrow the device. The operators then run one at a time with their tensors
+    // prefetched m_prefetchDistance operators ahead, and the activations whose next use is at
+    // least m_evictionDistance operators away, counting through the end of the forward path
+    // into the backward one, are moved to the host after their last forward use.
+    struct ManagedMemoryParameters
+    {
+        bool m_isEnabled = false;
+        unsigned int m_prefetchDistance = 1;
+        unsigned int m_evictionDistance = 4;
+    };
+
+    // Runs the forward and backward paths of a model with managed tensors an operator at a
+    // time. The tensors of the operators ahead are prefetched on the copy stream of every
+    // device (cudaMemPrefetchAsync), the operator's compute stream waits for its own. The
+    // tensors evicted after an operator are advised to prefer the host and prefetched there
+    // once the operator is done, on the copy stream too, so that the kernels don't wait for
+    // the page outs. An evicted tensor prefers its device again when it is next prefetched.
+    class PrefetchSchedule
+    {
+    private:
+        struct Step
+        {
+            OperatorDescriptor *m_operatorDescriptor;
+            // per device, the managed tensors the operator reads and writes
+            std::vector<std::vector<TensorBase<DeviceType::GPU_CUDA>*>> m_tensors;
+            // per device, the tensors moved to the host after the operator
+            std::vector<std::vector<TensorBase<DeviceType::GPU_CUDA>*>> m_evictions;
+        };
+
+        Model *m_model;
+        unsigned int m_deviceCount;
+        ManagedMemoryParameters m_parameters;
+        std::vector<Step> m_forwardSteps;
+        std::vector<Step> m_backwardSteps;
+        // the tensors evicted after any step, they are advised back to their device when
+        // prefetched
+        std::set<TensorBase<DeviceType::GPU_CUDA>*> m_evictedTensors;
+        // per device and step, recorded once the step's prefetches are queued
+        std::vector<std::vector<cudaEvent_t>> m_prefetchEvents;
+        // per device, what the copy stream waits on before it evicts
+        std::vector<cudaEvent_t> m_computeEvents;
+
+        void prefetch(Step &step, unsigned int device, unsigned int stepIndex);
+        void evict(Step &step, unsigned int device);
+        void run(std::vector<Step> &steps);
+
+    public:
+        PrefetchSchedule();
+        ~PrefetchSchedule();
+
+        PrefetchSchedule(const PrefetchSchedule &) = delete;
+        void operator=(const PrefetchSchedule &) = delete;
+
+        // after Model::init, with the operators of the paths in the order they run
+        bool build(Model *model, const std::vector<OperatorDescriptor*> &forwardPath,
+                   const std::vector<OperatorDescriptor*> &backwardPath, const ManagedMemoryParameters &parameters);
+        void clear();
+
+        bool isBuilt() const
+        {
+            return m_model != nullptr;
+        }
+
+        void forward();
+        void backward();
+    };
+}
+
+#endif
@@ -0,0 +1,71 @@
+#include "SharedWeights.h"
+
+FreeWill::SharedWeights::SharedWeights()
+    :m_reader(),
+      m_entries(),
+      m_mutex(),
+      m_deviceBlobs()
+{
+}
+
+std::shared_ptr<FreeWill::SharedWeights> FreeWill::SharedWeights::open(const std::string &filename)
+{
+    std::shared_ptr<SharedWeights> sharedWeights(new SharedWeights());
+
+    if (!sharedWeights->m_reader.open(filename))
+    {
+        return nullptr;
+    }
+
+    for (unsigned int i = 0; i < sharedWeights->m_reader.header().m_tensorCount; ++i)
+    {
+        const CheckpointEntry &entry = sharedWeights->m_reader.entry(i);
+        sharedWeights->m_entries[entry.m_name] = &entry;
+    }
+
+    return sharedWeights;
+}
+
+const FreeWill::CheckpointEntry *FreeWill::SharedWeights::find(const TensorDescriptor *descriptor) const
+{
+    auto entry = m_entries.find(descriptor->m_name);
+
+    if (entry == m_entries.end() || descriptor->m_isBatchTensor || entry->second->m_dataType != (uint32_t) descriptor->m_dataType ||
+            !(descriptor->m_shape == Shape(entry->second->m_shape, entry->second->m_dimension)))
+    {
+        return nullptr;
+    }
+
+    return entry->second;
+}
+
+bool FreeWill::SharedWeights::upload(const CheckpointEntry &entry, unsigned int deviceId, ReferenceCountedBlob<DeviceType::GPU_CUDA> &blob)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::vector<ReferenceCountedBlob<DeviceType::GPU_CUDA>> &deviceBlobs = m_deviceBlobs[entry.m_name];
+
+    if (deviceBlobs.size() <= deviceId)
+    {
+        deviceBlobs.resize(deviceId + 1);
+    }
+
+    if (!deviceBlobs[deviceId].gpuDataHandle())
+    {
+        RUN_CUDA(cudaSetDevice(deviceId));
+
+        BlobAllocator::Tag tag(MemoryCategory::WEIGHT, entry.m_name);
+        if (!deviceBlobs[deviceId].alloc(entry.m_sizeInByte))
+        {
+            RUN_CUDA(cudaSetDevice(0));
+            return false;
+        }
+
+        RUN_CUDA(cudaMemcpy(deviceBlobs[deviceId].gpuDataHandle(), m_reader.data(entry), entry.m_sizeInByte, cudaMemcpyHostToDevice));
+        RUN_CUDA(cudaSetDevice(0));
+    }
+
+    blob = deviceBlobs[deviceId];
+
+    return true;
+}
@@ -0,0 +1,85 @@
+#ifndef SHAREDWEIGHTS_H
+#define SHAREDWEIGHTS_H
+
+#include "Checkpoint.h"
+#include "TensorDescriptor.h"
+#include "../Context/Context.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace FreeWill
+{
+    // The weights of a checkpoint, once per process, for every inference model of its
+    // architecture: the tenants or the A/B variants of a server. A model given them
+    // (Model::shareWeights) views each of its tensors the checkpoint has, same name, data type
+    // and shape, instead of allocating it; its activations stay its own. On the cpu the tensors
+    // are the read only mapping of the file, on the gpu each device gets one upload the first
+    // time a model placed there asks for it. The models hold it by shared_ptr, it lives as long
+    // as the last of them. Nothing may write the shared tensors, on the cpu a write faults.
+    class SharedWeights
+    {
+        CheckpointReader m_reader;
+        std::map<std::string, const CheckpointEntry*> m_entries;
+
+        // the uploads, per tensor and device, made under m_mutex
+        std::mutex m_mutex;
+        std::map<std::string, std::vector<ReferenceCountedBlob<DeviceType::GPU_CUDA>>> m_deviceBlobs;
+
+        SharedWeights();
+
+        bool upload(const CheckpointEntry &entry, unsigned int deviceId, ReferenceCountedBlob<DeviceType::GPU_CUDA> &blob);
+
+    public:
+        SharedWeights(const SharedWeights &) = delete;
+        void operator=(const SharedWeights &) = delete;
+
+        // null when filename isn't a checkpoint of this version
+        static std::shared_ptr<SharedWeights> open(const std::string &filename);
+
+        // the entry of the tensor of descriptor, null when the checkpoint has none of its name,
+        // data type and shape
+        const CheckpointEntry *find(const TensorDescriptor *descriptor) const;
+
+        // A blob per replica of descriptor holding its shared tensor, for
+        // TensorDescriptor::allocateTensor. False when the tensor isn't shared.
+        template<DeviceType DeviceUsed>
+        bool blobs(const TensorDescriptor *descriptor, std::vector<ReferenceCountedBlob<DeviceUsed>> &blobs)
+        {
+            const CheckpointEntry *entry = find(descriptor);
+
+            if (!entry)
+            {
+                return false;
+            }
+
+            unsigned int replicaCount = descriptor->m_deviceIds.empty() ? Context<DeviceUsed>::getSingleton().deviceCount() : descriptor->m_deviceIds.size();
+            blobs.assign(replicaCount, ReferenceCountedBlob<DeviceUsed>());
+
+            for (unsigned int i = 0; i < replicaCount; ++i)
+            {
+                if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+                {
+                    // the replicas of a cpu are the one mapping
+                    if (!blobs[i].bindHost(const_cast<unsigned char*>(static_cast<const unsigned char*>(m_reader.data(*entry))), entry->m_sizeInByte))
+                    {
+                        return false;
+                    }
+                }
+                else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+                {
+                    if (!upload(*entry, descriptor->deviceId(i), blobs[i]))
+                    {
+                        return false;
+                    }
+                }
+            }
+
+            return true;
+        }
+    };
+}
+
+#endif
@@ -1,206 +1,1324 @@
 #include "Solver.h"
 #include "Model.h"
+#include "../Operator/SparsityMask.h"
+#include "../Context/ComputeStream.h"
 #include <sstream>
 #include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <set>
 
 bool FreeWill::Solver::init(FreeWill::Model *model)
 {
+    static const char *stateNames[2][2] = {{"_velocity", ""}, {"_firstMoment", "_secondMoment"}};
+
+    if (m_managedMemory.m_isEnabled && (m_deviceUsed != DeviceType::GPU_CUDA || m_useGraphs || m_useStreams || model->isPipelined()))
+    {
+        std::cerr << "can't use managed memory" << std::endl;
+        return false;
+    }
+
+    clearSparsityMasks();
+
+    // what the model and its operators allocate from here on is managed
+    BlobAllocator::ManagedMemoryScope managedMemoryScope(m_managedMemory.m_isEnabled || BlobAllocator::getSingleton().isManagedMemory());
+
+    // no optimizer state and no gradient merge, only the forward path is built
+    if (m_mode != SolverMode::TRAINING)
+    {
+        clearUpdateOperators();
+        m_isQuantized = false;
+
+        if (!model->init(*this))
+        {
+            std::cerr << "can't init model" << std::endl;
+            return false;
+        }
+
+        if (model->isPipelined())
+        {
+            if (!m_pipeline.build(model, m_deviceUsed, m_microBatchCount, {}, true))
+            {
+                std::cerr << "can't build the pipeline" << std::endl;
+                return false;
+            }
+
+            return true;
+        }
+
+        if ((m_deviceUsed == DeviceType::CPU_NAIVE && !m_forwardExecutor.build(model->m_forwardPath, model->m_operators, model->m_tensors)) ||
+                (m_deviceUsed == DeviceType::GPU_CUDA && !buildExecutorsGPU(model)))
+        {
+            std::cerr << "can't build the execution graph" << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    bool isPipelined = model->isPipelined();
+
+    if (m_asynchronousUpdate.m_isEnabled && (m_deviceUsed != DeviceType::CPU_NAIVE || isPipelined || m_lossScaling.m_isEnabled))
+    {
+        std::cerr << "can't update asynchronously" << std::endl;
+        return false;
+    }
+
+    if (m_gradientAccumulationCount == 0 || (m_gradientAccumulationCount > 1 && isPipelined))
+    {
+        std::cerr << "can't accumulate the gradients" << std::endl;
+        return false;
+    }
+
+    unsigned int stateCount = optimizerStateCount(m_optimizer.m_type);
+
+    // the optimizer state is shaped like the weight and allocated with the model, for 16-bit
+    // weights it is float and so is the master copy of the weight
+    for (auto iter = model->m_updatePairs.begin(); iter != model->m_updatePairs.end(); ++iter)
+    {
+        TensorDescriptor *weight = model->m_tensors[iter->first.name()];
+        bool isReducedPrecision = weight->m_dataType == DataType::HALF || weight->m_dataType == DataType::BFLOAT16;
+        DataType stateDataType = isReducedPrecision ? DataType::FLOAT : weight->m_dataType;
+
+        for (unsigned int i = 0; i < stateCount; ++i)
+        {
+            std::string stateName = weight->m_name + stateNames[stateCount - 1][i];
+
+            if (model->m_tensors.find(stateName) == model->m_tensors.end())
+            {
+                model->addTensor(stateName, weight->m_shape, stateDataType);
+            }
+
+            model->m_companionTensors[stateName] = weight->m_name;
+        }
+
+        if (isReducedPrecision && model->m_tensors.find(weight->m_name + "_master") == model->m_tensors.end())
+        {
+            model->addTensor(weight->m_name + "_master", weight->m_shape, DataType::FLOAT);
+        }
+
+        if (isReducedPrecision)
+        {
+            model->m_companionTensors[weight->m_name + "_master"] = weight->m_name;
+        }
+    }
+
+    // Pipelined, the gradients of the micro-batches are summed up for the update. The cpu
+    // derivatives add to their outputs, the caller clears the gradients before the backward
+    // pass anyway. The others overwrite them, their gradient is summed into an accumulator.
+    std::map<std::string, std::string> accumulators;
+
+    for (auto iter = model->m_updatePairs.begin(); iter != model->m_updatePairs.end() && isPipelined && m_microBatchCount > 1; ++iter)
+    {
+        TensorDescriptor *gradient = model->m_tensors[iter->second.name()];
+        bool isAccumulating = false;
+
+        for (auto operatorName = model->m_backwardPath.begin(); operatorName != model->m_backwardPath.end(); ++operatorName)
+        {
+            OperatorDescriptor *operatorDescriptor = model->m_operators[*operatorName];
+
+            for (auto output = operatorDescriptor->m_outputs.begin(); output != operatorDescriptor->m_outputs.end(); ++output)
+            {
+                if (output->second.name() == gradient->m_name)
+                {
+                    isAccumulating = m_deviceUsed == DeviceType::CPU_NAIVE && !operatorDescriptor->overwritesOutput(output->first);
+                }
+            }
+        }
+
+        if (isAccumulating)
+        {
+            continue;
+        }
+
+        std::string accumulatorName = gradient->m_name + "_accumulated";
+
+        if (model->m_tensors.find(accumulatorName) == model->m_tensors.end())
+        {
+            model->addTensor(accumulatorName, gradient->m_shape, gradient->m_dataType);
+        }
+
+        model->m_companionTensors[accumulatorName] = gradient->m_name;
+        accumulators[gradient->m_name] = accumulatorName;
+    }
+
     if (!model->init(*this))
     {
         return false;
         std::cerr << "can't init model" << std::endl;
     }
 
-    clearUpdateOperators();
+    clearUpdateOperators();
+
+    // a model without update pairs only computes its gradients, there is no optimizer to set up
+    m_dataType = model->m_updatePairs.empty() ? DataType::FLOAT : model->m_tensors[model->m_updatePairs.begin()->second.name()]->m_dataType;
+
+    m_masterWeights.clear();
+    m_isMasterWeightStale = true;
+    m_lossScale = m_lossScaling.m_isEnabled ? m_lossScaling.m_initialScale : 1.0;
+    m_appliedLossScale = 1.0;
+    m_goodStepCount = 0;
+    m_skippedStepCount = 0;
+    m_accumulatedPassCount = 0;
+    m_isAccumulating = false;
+
+    std::vector<ParameterUpdate> parameterUpdates;
+    for(auto iter = model->m_updatePairs.begin(); iter != model->m_updatePairs.end(); ++iter)
+    {
+        TensorDescriptor *weight = model->m_tensors[iter->first.name()];
+
+        // model k's part of a weight is its k-th along the last dimension
+        if (!m_optimizer.m_modelRates.empty() &&
+                (weight->m_shape.dimension() == 0 || weight->m_shape[weight->m_shape.dimension() - 1] % m_optimizer.m_modelRates.size() != 0))
+        {
+            std::cerr << "can't split " << weight->m_name << " between the models" << std::endl;
+            return false;
+        }
+
+        std::string gradientName = accumulators.find(iter->second.name()) != accumulators.end() ? accumulators[iter->second.name()] : iter->second.name();
+        ParameterUpdate parameterUpdate = {weight, model->m_tensors[gradientName], {nullptr, nullptr}, nullptr};
+
+        for (unsigned int i = 0; i < stateCount; ++i)
+        {
+            parameterUpdate.m_optimizerState[i] = model->m_tensors[weight->m_name + stateNames[stateCount - 1][i]];
+        }
+
+        if (model->m_tensors.find(weight->m_name + "_master") != model->m_tensors.end())
+        {
+            parameterUpdate.m_masterWeight = model->m_tensors[weight->m_name + "_master"];
+            m_masterWeights.push_back({weight, parameterUpdate.m_masterWeight});
+        }
+
+        parameterUpdates.push_back(parameterUpdate);
+    }
+
+    bool isAllReduceBuilt = false;
+
+    if (isPipelined)
+    {
+        isAllReduceBuilt = m_deviceUsed == DeviceType::CPU_NAIVE ? m_gradientAllReduceCPU.build(parameterUpdates, m_dataType, m_optimizer, m_gradientCompression) :
+                                                                   m_gradientAllReduceGPU.build(parameterUpdates, m_dataType, m_optimizer, m_gradientCompression);
+
+        // the operator chain below merges replicas, a placed weight has one
+        if (!isAllReduceBuilt || !m_pipeline.build(model, m_deviceUsed, m_microBatchCount, accumulators, false))
+        {
+            std::cerr << "can't build the pipeline" << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    switch(m_deviceUsed)
+    {
+    case FreeWill::DeviceType::CPU_NAIVE:
+        if (m_asynchronousUpdate.m_isEnabled)
+        {
+            // there is no merge to fall back to the operator chain for
+            if (!m_gradientAllReduceCPU.buildAsynchronous(parameterUpdates, m_dataType, m_optimizer, m_asynchronousUpdate))
+            {
+                std::cerr << "can't build the asynchronous update" << std::endl;
+                return false;
+            }
+
+            isAllReduceBuilt = true;
+        }
+        else
+        {
+            isAllReduceBuilt = m_gradientAllReduceCPU.build(parameterUpdates, m_dataType, m_optimizer, m_gradientCompression);
+        }
+
+        // the gradients are merged from the backward chains as soon as they are final
+        if (!m_forwardExecutor.build(model->m_forwardPath, model->m_operators, model->m_tensors) ||
+                !m_backwardExecutor.build(model->m_backwardPath, model->m_operators, model->m_tensors,
+                                          m_overlapGradientReduce ? m_gradientAllReduceCPU.readySignals() : std::map<std::string, std::vector<Operator<DeviceType::CPU_NAIVE>*>>()))
+        {
+            std::cerr << "can't build the execution graph" << std::endl;
+            return false;
+        }
+
+        if (m_overlapGradientReduce)
+        {
+            m_gradientAllReduceCPU.enableOverlap(m_backwardExecutor);
+        }
+        break;
+    case FreeWill::DeviceType::GPU_CUDA:
+        isAllReduceBuilt = m_gradientAllReduceGPU.build(parameterUpdates, m_dataType, m_optimizer, m_gradientCompression);
+
+        if (!buildExecutorsGPU(model))
+        {
+            std::cerr << "can't build the execution graph" << std::endl;
+            return false;
+        }
+        break;
+    }
+
+    if (isAllReduceBuilt)
+    {
+        return true;
+    }
+
+    // the operator chain below only knows how to do plain sgd on float and double weights at one rate
+    if (m_optimizer.m_type != OptimizerType::SGD || !m_masterWeights.empty() || m_lossScaling.m_isEnabled || !m_optimizer.m_modelRates.empty())
+    {
+        std::cerr << "can't build the fused optimizer step" << std::endl;
+        return false;
+    }
+
+    // the merge below reads the other gpus' gradients in place
+    if (m_deviceUsed == DeviceType::GPU_CUDA && Context<DeviceType::GPU_CUDA>::getSingleton().deviceCount() > 1 &&
+            !Context<DeviceType::GPU_CUDA>::getSingleton().hasPeerAccess())
+    {
+        std::cerr << "can't merge the gradients without peer access" << std::endl;
+        return false;
+    }
+
+    for(auto iter = model->m_updatePairs.begin(); iter != model->m_updatePairs.end(); ++iter)
+    {
+        FreeWill::TensorDescriptorHandle operandB = iter->second;
+
+        model->generateGradientMergeOperators(m_mergeGradientOperators, operandB);
+
+    }
+
+    for(auto iter = model->m_updatePairs.begin(); iter != model->m_updatePairs.end(); ++iter)
+    {
+        FreeWill::TensorDescriptorHandle operandA = iter->first;
+        FreeWill::TensorDescriptorHandle operandB = iter->second;
+
+        //std::stringstream operatorNameStream;
+
+        //DataType dataType = model->m_tensors[operandA.first]->m_dataType;
+
+        //operatorNameStream<<"Update_"<<operandA.first<<"_with_"<<operandB.first;
+
+        /*addUpdateOperator(operatorNameStream.str(), FreeWill::OperatorName::ELEMENTWISE_ADD,
+                            {{"OperandA", operandA}, {"OperandB", operandB}},
+                            {{"Result", operandA}},{}, dataType);*/
+
+        model->generateUpdateFirstDeviceTensorOperators(m_updateFirstDeviceTensorOperators, operandA, operandB);
+
+
+    }
+
+    for(auto iter = model->m_updatePairs.begin(); iter != model->m_updatePairs.end(); ++iter)
+    {
+        FreeWill::TensorDescriptorHandle operandA = iter->first;
+
+        model->generateBroadcastFirstDeviceTensorOperators(m_broadcastTensorToSiblingOperators, operandA);
+    }
+
+    /*for(auto iter = m_updateOperators.begin(); iter != m_updateOperators.end(); ++iter)
+    {
+        switch(m_deviceUsed)
+        {
+        case FreeWill::DeviceType::CPU_NAIVE:
+        (*iter)->init<FreeWill::DeviceType::CPU_NAIVE>(model->m_tensors);
+            break;
+        case FreeWill::DeviceType::GPU_CUDA:
+        (*iter)->init<FreeWill::DeviceType::GPU_CUDA>(model->m_tensors);
+            break;
+        }
+    }*/
+
+    return true;
+}
+/*
+FreeWill::OperatorDescriptorHandle FreeWill::Solver::addUpdateOperator(const std::string &name,
+                                 FreeWill::OperatorName operatorName,
+                                 const std::map<std::string, FreeWill::TensorDescriptorHandle> &inputs,
+                                 const std::map<std::string, FreeWill::TensorDescriptorHandle> &outputs,
+                                 const std::map<std::string, std::any> &properties, DataType dataType)
+{
+    FreeWill::OperatorDescriptor *opDescriptor = new FreeWill::OperatorDescriptor(name, operatorName, inputs, outputs, properties, dataType);
+
+    m_updateOperators.push_back(opDescriptor);
+
+    return name;
+}*/
+
+void FreeWill::Solver::clearUpdateOperators()
+{
+    /*for (unsigned int i = 0; i<m_updateOperators.size();++i)
+    {
+        delete m_updateOperators[i];
+    }
+    m_updateOperators.clear();*/
+
+    /*std::vector<std::variant<Operator<DeviceType::CPU_NAIVE>*, Operator<DeviceType::GPU_CUDA>*>> m_mergeGradientOperators;
+    std::vector<std::variant<Operator<DeviceType::CPU_NAIVE>*, Operator<DeviceType::GPU_CUDA>*>> m_updateFirstDeviceTensorOperators;
+    std::vector<std::variant<Operator<DeviceType::CPU_NAIVE>*, Operator<DeviceType::GPU_CUDA>*>> m_broadcastTensorToSiblingOperators;
+    */
+
+    for (unsigned int i = 0; i<m_mergeGradientOperators.size(); ++i)
+    {
+        switch(m_deviceUsed)
+        {
+        case FreeWill::DeviceType::CPU_NAIVE:
+            delete std::get<Operator<DeviceType::CPU_NAIVE>*>(m_mergeGradientOperators[i]);
+            break;
+        case FreeWill::DeviceType::GPU_CUDA:
+            delete std::get<Operator<DeviceType::GPU_CUDA>*>(m_mergeGradientOperators[i]);
+            break;
+        }
+    }
+
+    for (unsigned int i =0;i<m_updateFirstDeviceTensorOperators.size();++i)
+    {
+        switch(m_deviceUsed)
+        {
+        case FreeWill::DeviceType::CPU_NAIVE:
+            delete std::get<Operator<DeviceType::CPU_NAIVE>*>(m_updateFirstDeviceTensorOperators[i]);
+            break;
+        case FreeWill::DeviceType::GPU_CUDA:
+            delete std::get<Operator<DeviceType::GPU_CUDA>*>(m_updateFirstDeviceTensorOperators[i]);
+            break;
+        }
+    }
+
+    for (unsigned int i =0;i<m_broadcastTensorToSiblingOperators.size();++i)
+    {
+        switch (m_deviceUsed)
+        {
+        case FreeWill::DeviceType::CPU_NAIVE:
+            delete std::get<Operator<DeviceType::CPU_NAIVE>*>(m_broadcastTensorToSiblingOperators[i]);
+            break;
+        case FreeWill::DeviceType::GPU_CUDA:
+            delete std::get<Operator<DeviceType::GPU_CUDA>*>(m_broadcastTensorToSiblingOperators[i]);
+            break;
+        default:
+            break;
+        }
+
+    }
+
+    m_mergeGradientOperators.clear();
+    m_updateFirstDeviceTensorOperators.clear();
+    m_broadcastTensorToSiblingOperators.clear();
+
+    // the backward chains hold the ready signals of the allreduce
+    m_backwardExecutor.clear();
+    m_forwardExecutorGPU.clear();
+    m_backwardExecutorGPU.clear();
+    m_gradientAllReduceCPU.clear();
+    m_gradientAllReduceGPU.clear();
+    m_pipeline.clear();
+    m_prefetchSchedule.clear();
+
+    clearGraphs(m_forwardGraph);
+    clearGraphs(m_backwardGraph);
+    clearGraphs(m_accumulatingBackwardGraph);
+}
+
+bool FreeWill::Solver::buildExecutorsGPU(FreeWill::Model *model)
+{
+    m_forwardExecutorGPU.clear();
+    m_backwardExecutorGPU.clear();
+
+    m_forwardOperators.clear();
+    m_backwardOperators.clear();
+
+    for (const OperatorDescriptorHandle &operatorName : model->m_forwardPath)
+    {
+        m_forwardOperators.push_back(model->m_operators[operatorName]);
+    }
+
+    for (const OperatorDescriptorHandle &operatorName : model->m_backwardPath)
+    {
+        m_backwardOperators.push_back(model->m_operators[operatorName]);
+    }
+
+    if (m_managedMemory.m_isEnabled)
+    {
+        return m_prefetchSchedule.build(model, m_forwardOperators,
+                                        m_mode == SolverMode::TRAINING ? m_backwardOperators : std::vector<OperatorDescriptor*>(), m_managedMemory);
+    }
+
+    if (!m_useStreams)
+    {
+        return true;
+    }
+
+    // batch tensors sharing the arena are only ordered by the plan's timeline, the lanes have
+    // to see those edges too
+    const MemoryPlanner *memoryPlan = m_planMemory ? &model->m_memoryPlan : nullptr;
+
+    return m_forwardExecutorGPU.build(model->m_forwardPath, model->m_operators, model->m_tensors, {}, memoryPlan) &&
+            (m_mode != SolverMode::TRAINING ||
+             m_backwardExecutorGPU.build(model->m_backwardPath, model->m_operators, model->m_tensors, {}, memoryPlan));
+}
+
+void FreeWill::Solver::clearGraphs(CapturedPath &capturedPath)
+{
+    for (CapturedSegment &segment : capturedPath.m_segments)
+    {
+        for (CUDAGraph *graph : segment.m_graphs)
+        {
+            delete graph;
+        }
+    }
+
+    capturedPath.m_segments.clear();
+    capturedPath.m_batchSize = 0;
+    capturedPath.m_runCount = 0;
+}
+
+void FreeWill::Solver::runGraphs(FreeWill::Model *model, const std::vector<FreeWill::OperatorDescriptor*> &path, CapturedPath &capturedPath)
+{
+    // the pointers and shapes baked into the graphs are those of one batch size
+    if (capturedPath.m_batchSize != model->batchSize())
+    {
+        clearGraphs(capturedPath);
+        capturedPath.m_batchSize = model->batchSize();
+    }
+
+    std::vector<WorkerMessage*> messageQueue;
+
+    if (capturedPath.m_runCount++ == 0)
+    {
+        for (OperatorDescriptor *operatorDescriptor : path)
+        {
+            operatorDescriptor->evaluate<DeviceType::GPU_CUDA>(messageQueue, model->m_tensors);
+        }
+
+        return;
+    }
+
+    if (capturedPath.m_segments.empty())
+    {
+        for (OperatorDescriptor *operatorDescriptor : path)
+        {
+            bool isCapturable = true;
+
+            for (auto &operatorBase : operatorDescriptor->m_operators[DeviceType::GPU_CUDA])
+            {
+                isCapturable = isCapturable && std::get<Operator<DeviceType::GPU_CUDA>*>(operatorBase)->isCapturable();
+            }
+
+            bool isSegmentCapturable = !capturedPath.m_segments.empty() && !capturedPath.m_segments.back().m_graphs.empty();
+
+            if (capturedPath.m_segments.empty() || isCapturable != isSegmentCapturable)
+            {
+                CapturedSegment segment;
+
+                if (isCapturable)
+                {
+                    for (unsigned int d = 0; d < operatorDescriptor->m_operators[DeviceType::GPU_CUDA].size(); ++d)
+                    {
+                        segment.m_graphs.push_back(new CUDAGraph());
+                    }
+                }
+
+                capturedPath.m_segments.push_back(segment);
+            }
+
+            capturedPath.m_segments.back().m_operators.push_back(operatorDescriptor);
+        }
+    }
+
+    for (CapturedSegment &segment : capturedPath.m_segments)
+    {
+        bool isCaptured = !segment.m_graphs.empty();
+
+        for (unsigned int d = 0; d < segment.m_graphs.size() && isCaptured; ++d)
+        {
+            if (segment.m_graphs[d]->isCaptured())
+            {
+                continue;
+            }
+
+            // capturing records the pass without running it, the launch below runs it
+            isCaptured = segment.m_graphs[d]->capture(d, [&]()
+            {
+                for (OperatorDescriptor *operatorDescriptor : segment.m_operators)
+                {
+                    std::get<Operator<DeviceType::GPU_CUDA>*>(operatorDescriptor->m_operators[DeviceType::GPU_CUDA][d])->evaluate();
+                }
+            });
+        }
+
+        if (!isCaptured)
+        {
+            // an operator turned out not to be capturable, the segment runs as it is from now on
+            for (CUDAGraph *graph : segment.m_graphs)
+            {
+                delete graph;
+            }
+            segment.m_graphs.clear();
+
+            RUN_CUDA(cudaSetDevice(0));
+
+            for (OperatorDescriptor *operatorDescriptor : segment.m_operators)
+            {
+                operatorDescriptor->evaluate<DeviceType::GPU_CUDA>(messageQueue, model->m_tensors);
+            }
+
+            continue;
+        }
+
+        for (unsigned int d = 0; d < segment.m_graphs.size(); ++d)
+        {
+            RUN_CUDA(cudaSetDevice(d));
+            segment.m_graphs[d]->launch();
+        }
+
+        RUN_CUDA(cudaSetDevice(0));
+    }
+}
+
+
+void FreeWill::Solver::forward(FreeWill::Model *model)
+{
+    waitForAsyncCalls();
+
+    if (m_pipeline.isBuilt())
+    {
+        m_pipeline.forward();
+        return;
+    }
+
+    std::vector<WorkerMessage*> messageQueue;
+
+    switch(m_deviceUsed)
+    {
+    case FreeWill::DeviceType::CPU_NAIVE:
+        if (m_runInline)
+        {
+            m_forwardExecutor.runInline();
+            break;
+        }
+
+        m_forwardExecutor.run();
+        break;
+    case FreeWill::DeviceType::GPU_CUDA:
+        if (m_prefetchSchedule.isBuilt())
+        {
+            m_prefetchSchedule.forward();
+            break;
+        }
+
+        if (m_useGraphs)
+        {
+            runGraphs(model, m_forwardOperators, m_forwardGraph);
+            break;
+        }
+
+        if (m_useStreams)
+        {
+            m_forwardExecutorGPU.run();
+            break;
+        }
+
+        for (OperatorDescriptor *operatorDescriptor : m_forwardOperators)
+        {
+            operatorDescriptor->evaluate<FreeWill::DeviceType::GPU_CUDA>(messageQueue, model->m_tensors);
+        }
+        break;
+    }
+
+    for(int i=0;i<messageQueue.size();++i)
+    {
+        messageQueue[i]->join();
+        delete messageQueue[i];
+    }
+}
+
+void FreeWill::Solver::applyLossScale(FreeWill::Model *model)
+{
+    for (auto iter = model->m_operators.begin(); iter != model->m_operators.end(); ++iter)
+    {
+        switch(m_deviceUsed)
+        {
+        case FreeWill::DeviceType::CPU_NAIVE:
+            iter->second->setLossScale<FreeWill::DeviceType::CPU_NAIVE>(m_lossScale);
+            break;
+        case FreeWill::DeviceType::GPU_CUDA:
+            iter->second->setLossScale<FreeWill::DeviceType::GPU_CUDA>(m_lossScale);
+            break;
+        }
+    }
+
+    m_appliedLossScale = m_lossScale;
+}
+
+void FreeWill::Solver::backward(FreeWill::Model *model)
+{
+    waitForAsyncCalls();
+    if (m_mode != SolverMode::TRAINING)
+    {
+        return;
+    }
+
+    std::vector<WorkerMessage*> messageQueue;
+
+    if (m_appliedLossScale != m_lossScale)
+    {
+        applyLossScale(model);
+
+        // the scale is a kernel argument of the captured loss derivatives
+        clearGraphs(m_backwardGraph);
+        clearGraphs(m_accumulatingBackwardGraph);
+    }
+
+    if (m_pipeline.isBuilt())
+    {
+        m_pipeline.backward();
+        return;
+    }
+
+    // the passes of an accumulation add to the gradients of the first, the merge waits for the last
+    bool isLastPass = ++m_accumulatedPassCount >= m_gradientAccumulationCount;
+
+    switch(m_deviceUsed)
+    {
+    case FreeWill::DeviceType::CPU_NAIVE:
+        if (!isLastPass)
+        {
+            m_backwardExecutor.run();
+            break;
+        }
+
+        m_gradientAllReduceCPU.startReduce();
+        m_backwardExecutor.run();
+        m_gradientAllReduceCPU.finishReduce();
+        break;
+    case FreeWill::DeviceType::GPU_CUDA:
+        if (m_isAccumulating != (m_accumulatedPassCount > 1))
+        {
+            setAccumulating(model, m_accumulatedPassCount > 1);
+        }
+
+        if (m_prefetchSchedule.isBuilt())
+        {
+            m_prefetchSchedule.backward();
+            break;
+        }
+
+        if (m_useGraphs)
+        {
+            // beta is baked into the captured gemms, each setting has its graphs
+            runGraphs(model, m_backwardOperators, m_isAccumulating ? m_accumulatingBackwardGraph : m_backwardGraph);
+            break;
+        }
+
+        if (m_useStreams)
+        {
+            m_backwardExecutorGPU.run();
+            break;
+        }
+
+        for (OperatorDescriptor *operatorDescriptor : m_backwardOperators)
+        {
+            operatorDescriptor->evaluate<FreeWill::DeviceType::GPU_CUDA>(messageQueue, model->m_tensors);
+        }
+        break;
+    }
+
+    for(int i=0;i<messageQueue.size();++i)
+    {
+        messageQueue[i]->join();
+        delete messageQueue[i];
+    }
+}
+
+void FreeWill::Solver::setAccumulating(FreeWill::Model *model, bool isAccumulating)
+{
+    for (auto iter = model->m_operators.begin(); iter != model->m_operators.end(); ++iter)
+    {
+        iter->second->setAccumulating<FreeWill::DeviceType::GPU_CUDA>(isAccumulating);
+    }
+
+    m_isAccumulating = isAccumulating;
+}
+
+template<FreeWill::DeviceType DeviceUsed>
+void FreeWill::Solver::calibrate(FreeWill::Model *model)
+{
+    std::vector<WorkerMessage*> messageQueue;
+
+    // one operator at a time, the ranges are read before the memory plan can reuse an input
+    for (auto iter = model->m_forwardPath.begin(); iter != model->m_forwardPath.end(); ++iter)
+    {
+        OperatorDescriptor *operatorDescriptor = model->m_operators[*iter];
+
+        if (operatorDescriptor->isQuantizable())
+        {
+            TensorDescriptor *input = model->m_tensors[operatorDescriptor->m_inputs["Input"].name()];
+            std::map<std::string, std::any> &parameters = operatorDescriptor->m_parameters;
+
+            float range = 0.0f;
+            if (parameters.find("InputRange") != parameters.end())
+            {
+                range = std::any_cast<float>(parameters["InputRange"]);
+            }
+
+            for (unsigned int i = 0; i < input->m_tensors[DeviceUsed].size(); ++i)
+            {
+                TensorBase<DeviceUsed> *tensor = input->getTensorForDevice<DeviceUsed>(i);
+
+                if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+                {
+                    RUN_CUDA(cudaSetDevice(i));
+                    tensor->copyFromDeviceToHost();
+                }
+
+                range = std::max(range, absoluteMaximumCPU((const float *) tensor->cpuDataHandle(), tensor->sizeInByte() / sizeof(float)));
+            }
+
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                RUN_CUDA(cudaSetDevice(0));
+            }
+
+            parameters["InputRange"] = range;
+        }
+
+        operatorDescriptor->evaluate<DeviceUsed>(messageQueue, model->m_tensors);
+    }
+
+    for(unsigned int i = 0; i < messageQueue.size(); ++i)
+    {
+        messageQueue[i]->join();
+        delete messageQueue[i];
+    }
+}
+
+bool FreeWill::Solver::calibrate(FreeWill::Model *model)
+{
+    if (m_mode != SolverMode::QUANTIZED_INFERENCE || m_isQuantized || m_pipeline.isBuilt())
+    {
+        return false;
+    }
+
+    switch(m_deviceUsed)
+    {
+    case FreeWill::DeviceType::CPU_NAIVE:
+        calibrate<FreeWill::DeviceType::CPU_NAIVE>(model);
+        break;
+    case FreeWill::DeviceType::GPU_CUDA:
+        calibrate<FreeWill::DeviceType::GPU_CUDA>(model);
+        break;
+    }
+
+    return true;
+}
+
+template<FreeWill::DeviceType DeviceUsed>
+bool FreeWill::Solver::quantize(FreeWill::Model *model)
+{
+    std::set<std::string> floatInputs;
+    std::set<std::string> quantizedWeights;
+
+    // every operator is quantized before any of them is swapped, a failure leaves the model
+    // running in float
+    std::vector<std::pair<OperatorDescriptor*, std::vector<std::variant<Operator<DeviceType::GPU_CUDA>*, Operator<DeviceType::CPU_NAIVE>*>>>> replacements;
+
+    auto deleteReplacements = [&replacements]()
+    {
+        for (auto replacement = replacements.begin(); replacement != replacements.end(); ++replacement)
+        {
+            for (unsigned int i = 0; i < replacement->second.size(); ++i)
+            {
+                delete std::get<Operator<DeviceUsed>*>(replacement->second[i]);
+            }
+        }
+    };
+
+    for (auto iter = model->m_forwardPath.begin(); iter != model->m_forwardPath.end(); ++iter)
+    {
+        OperatorDescriptor *operatorDescriptor = model->m_operators[*iter];
+
+        if (!operatorDescriptor->isQuantizable())
+        {
+            for (auto input = operatorDescriptor->m_inputs.begin(); input != operatorDescriptor->m_inputs.end(); ++input)
+            {
+                floatInputs.insert(input->second.name());
+            }
+            continue;
+        }
+
+        replacements.push_back({operatorDescriptor, {}});
+
+        if (!operatorDescriptor->initQuantized<DeviceUsed>(model->m_tensors, replacements.back().second))
+        {
+            std::cerr << "can't quantize " << operatorDescriptor->m_name << ", is it calibrated?" << std::endl;
+            deleteReplacements();
+            return false;
+        }
+
+        quantizedWeights.insert(operatorDescriptor->weightName());
+    }
+
+    for (auto replacement = replacements.begin(); replacement != replacements.end(); ++replacement)
+    {
+        replacement->first->swapQuantized<DeviceUsed>(replacement->second);
+    }
+
+    // the graph holds the replaced float operators
+    if ((DeviceUsed == DeviceType::CPU_NAIVE && !m_forwardExecutor.build(model->m_forwardPath, model->m_operators, model->m_tensors)) ||
+            (DeviceUsed == DeviceType::GPU_CUDA && !buildExecutorsGPU(model)))
+    {
+        std::cerr << "can't build the execution graph" << std::endl;
+
+        // back to the float operators, and their graph
+        for (auto replacement = replacements.begin(); replacement != replacements.end(); ++replacement)
+        {
+            replacement->first->swapQuantized<DeviceUsed>(replacement->second);
+        }
+
+        deleteReplacements();
+
+        if (DeviceUsed == DeviceType::CPU_NAIVE)
+        {
+            m_forwardExecutor.build(model->m_forwardPath, model->m_operators, model->m_tensors);
+        }
+        else
+        {
+            buildExecutorsGPU(model);
+        }
+
+        return false;
+    }
+
+    // the float operators are replaced
+    deleteReplacements();
+
+    // the int8 operators keep their own weights
+    for (auto iter = quantizedWeights.begin(); iter != quantizedWeights.end(); ++iter)
+    {
+        if (floatInputs.find(*iter) == floatInputs.end())
+        {
+            TensorDescriptor *weight = model->m_tensors[*iter];
+
+            for (unsigned int i = 0; i < weight->m_tensors[DeviceUsed].size(); ++i)
+            {
+                weight->getTensorForDevice<DeviceUsed>(i)->release();
+            }
+        }
+    }
+
+    return true;
+}
+
+bool FreeWill::Solver::quantize(FreeWill::Model *model)
+{
+    if (m_mode != SolverMode::QUANTIZED_INFERENCE || m_isQuantized || m_pipeline.isBuilt())
+    {
+        return false;
+    }
+
+    switch(m_deviceUsed)
+    {
+    case FreeWill::DeviceType::CPU_NAIVE:
+        m_isQuantized = quantize<FreeWill::DeviceType::CPU_NAIVE>(model);
+        break;
+    case FreeWill::DeviceType::GPU_CUDA:
+        m_isQuantized = quantize<FreeWill::DeviceType::GPU_CUDA>(model);
+        break;
+    }
+
+    // the graphs launch the float operators
+    clearGraphs(m_forwardGraph);
+
+    return m_isQuantized;
+}
+
+template<FreeWill::DeviceType DeviceUsed>
+bool FreeWill::Solver::prune(FreeWill::Model *model)
+{
+    std::set<std::string> denseInputs;
+    std::set<std::string> packedWeights;
+    std::set<std::string> maskedWeights;
+
+    // every pruned operator and mask is built before any of them is swapped in, a failure
+    // leaves the model dense
+    std::vector<std::pair<OperatorDescriptor*, std::vector<std::variant<Operator<DeviceType::GPU_CUDA>*, Operator<DeviceType::CPU_NAIVE>*>>>> replacements;
+    std::vector<Operator<DeviceUsed>*> masks;
+
+    // a mask prunes its weight in init, the weights as they were before
+    struct WeightCopy
+    {
+        TensorBase<DeviceUsed> *m_tensor;
+        int m_deviceId;
+        std::vector<unsigned char> m_data;
+    };
+    std::vector<WeightCopy> weightCopies;
+
+    auto rollBack = [&]()
+    {
+        for (auto replacement = replacements.begin(); replacement != replacements.end(); ++replacement)
+        {
+            for (unsigned int i = 0; i < replacement->second.size(); ++i)
+            {
+                delete std::get<Operator<DeviceUsed>*>(replacement->second[i]);
+            }
+        }
+
+        for (unsigned int i = 0; i < masks.size(); ++i)
+        {
+            delete masks[i];
+        }
+
+        for (auto copy = weightCopies.begin(); copy != weightCopies.end(); ++copy)
+        {
+            std::memcpy(copy->m_tensor->cpuDataHandle(), copy->m_data.data(), copy->m_data.size());
+
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                RUN_CUDA(cudaSetDevice(copy->m_deviceId));
+                copy->m_tensor->copyFromHostToDevice();
+                RUN_CUDA(cudaSetDevice(0));
+            }
+        }
+    };
+
+    for (auto iter = model->m_forwardPath.begin(); iter != model->m_forwardPath.end(); ++iter)
+    {
+        OperatorDescriptor *operatorDescriptor = model->m_operators[*iter];
+
+        if (!operatorDescriptor->isPrunable())
+        {
+            for (auto input = operatorDescriptor->m_inputs.begin(); input != operatorDescriptor->m_inputs.end(); ++input)
+            {
+                denseInputs.insert(input->second.name());
+            }
+            continue;
+        }
+
+        // the gpu kernels of the packed weights are float
+        if (m_mode == SolverMode::INFERENCE && operatorDescriptor->m_operatorName == OperatorName::DOT_PRODUCT_WITH_BIAS &&
+                (DeviceUsed == DeviceType::CPU_NAIVE || operatorDescriptor->m_dataType == DataType::FLOAT))
+        {
+            replacements.push_back({operatorDescriptor, {}});
+
+            if (!operatorDescriptor->initPruned<DeviceUsed>(model->m_tensors, m_sparsity, replacements.back().second))
+            {
+                std::cerr << "can't prune " << operatorDescriptor->m_name << std::endl;
+                rollBack();
+                return false;
+            }
+
+            packedWeights.insert(operatorDescriptor->weightName());
+            continue;
+        }
+
+        denseInputs.insert(operatorDescriptor->weightName());
+        maskedWeights.insert(operatorDescriptor->weightName());
+    }
+
+    for (auto iter = maskedWeights.begin(); iter != maskedWeights.end(); ++iter)
+    {
+        TensorDescriptor *weight = model->m_tensors[*iter];
+
+        for (unsigned int i = 0; i < weight->m_tensors[DeviceUsed].size(); ++i)
+        {
+            Operator<DeviceUsed> *operatorBase = nullptr;
+
+            if (weight->m_dataType == DataType::FLOAT)
+            {
+                operatorBase = new SparsityMask<DeviceUsed, float>(m_sparsity, i);
+            }
+            else
+            {
+                operatorBase = new SparsityMask<DeviceUsed, double>(m_sparsity, i);
+            }
+
+            TensorBase<DeviceUsed> *tensor = weight->getTensorForDevice<DeviceUsed>(i);
+            operatorBase->setOutputParameter("Weight", tensor);
 
-    m_dataType = model->m_tensors[model->m_updatePairs.begin()->second.name()]->m_dataType;
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                RUN_CUDA(cudaSetDevice(i));
+                tensor->copyFromDeviceToHost();
+            }
 
-    for(auto iter = model->m_updatePairs.begin(); iter != model->m_updatePairs.end(); ++iter)
-    {
-        FreeWill::TensorDescriptorHandle operandB = iter->second;
+            const unsigned char *data = static_cast<const unsigned char*>(tensor->cpuDataHandle());
+            weightCopies.push_back({tensor, (int) i, std::vector<unsigned char>(data, data + tensor->sizeInByte())});
 
-        model->generateGradientMergeOperators(m_mergeGradientOperators, operandB);
+            bool isInitialized = operatorBase->init();
 
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                RUN_CUDA(cudaSetDevice(0));
+            }
+
+            if (!isInitialized)
+            {
+                delete operatorBase;
+                std::cerr << "can't prune " << weight->m_name << std::endl;
+                rollBack();
+                return false;
+            }
+
+            masks.push_back(operatorBase);
+        }
     }
 
-    for(auto iter = model->m_updatePairs.begin(); iter != model->m_updatePairs.end(); ++iter)
+    if (m_mode == SolverMode::TRAINING)
     {
-        FreeWill::TensorDescriptorHandle operandA = iter->first;
-        FreeWill::TensorDescriptorHandle operandB = iter->second;
+        m_sparsityMaskOperators.insert(m_sparsityMaskOperators.end(), masks.begin(), masks.end());
+        return true;
+    }
 
-        //std::stringstream operatorNameStream;
+    // inference only needs the weights pruned once
+    for (unsigned int i = 0; i < masks.size(); ++i)
+    {
+        delete masks[i];
+    }
+    masks.clear();
 
-        //DataType dataType = model->m_tensors[operandA.first]->m_dataType;
+    for (auto replacement = replacements.begin(); replacement != replacements.end(); ++replacement)
+    {
+        replacement->first->swapPruned<DeviceUsed>(replacement->second);
+    }
 
-        //operatorNameStream<<"Update_"<<operandA.first<<"_with_"<<operandB.first;
+    // the graph holds the replaced dense operators
+    if ((DeviceUsed == DeviceType::CPU_NAIVE && !m_forwardExecutor.build(model->m_forwardPath, model->m_operators, model->m_tensors)) ||
+            (DeviceUsed == DeviceType::GPU_CUDA && !buildExecutorsGPU(model)))
+    {
+        std::cerr << "can't build the execution graph" << std::endl;
 
-        /*addUpdateOperator(operatorNameStream.str(), FreeWill::OperatorName::ELEMENTWISE_ADD,
-                            {{"OperandA", operandA}, {"OperandB", operandB}},
-                            {{"Result", operandA}},{}, dataType);*/
+        // back to the dense operators and weights, and their graph
+        for (auto replacement = replacements.begin(); replacement != replacements.end(); ++replacement)
+        {
+            replacement->first->swapPruned<DeviceUsed>(replacement->second);
+        }
 
-        model->generateUpdateFirstDeviceTensorOperators(m_updateFirstDeviceTensorOperators, operandA, operandB);
+        rollBack();
 
+        if (DeviceUsed == DeviceType::CPU_NAIVE)
+        {
+            m_forwardExecutor.build(model->m_forwardPath, model->m_operators, model->m_tensors);
+        }
+        else
+        {
+            buildExecutorsGPU(model);
+        }
 
+        return false;
     }
 
-    for(auto iter = model->m_updatePairs.begin(); iter != model->m_updatePairs.end(); ++iter)
+    // the dense operators are replaced
+    for (auto replacement = replacements.begin(); replacement != replacements.end(); ++replacement)
     {
-        FreeWill::TensorDescriptorHandle operandA = iter->first;
-
-        model->generateBroadcastFirstDeviceTensorOperators(m_broadcastTensorToSiblingOperators, operandA);
+        for (unsigned int i = 0; i < replacement->second.size(); ++i)
+        {
+            delete std::get<Operator<DeviceUsed>*>(replacement->second[i]);
+        }
     }
 
-    /*for(auto iter = m_updateOperators.begin(); iter != m_updateOperators.end(); ++iter)
+    // the pruned dot products keep their own weights
+    for (auto iter = packedWeights.begin(); iter != packedWeights.end(); ++iter)
     {
-        switch(m_deviceUsed)
+        if (denseInputs.find(*iter) == denseInputs.end())
         {
-        case FreeWill::DeviceType::CPU_NAIVE:
-        (*iter)->init<FreeWill::DeviceType::CPU_NAIVE>(model->m_tensors);
-            break;
-        case FreeWill::DeviceType::GPU_CUDA:
-        (*iter)->init<FreeWill::DeviceType::GPU_CUDA>(model->m_tensors);
-            break;
+            TensorDescriptor *weight = model->m_tensors[*iter];
+
+            for (unsigned int i = 0; i < weight->m_tensors[DeviceUsed].size(); ++i)
+            {
+                weight->getTensorForDevice<DeviceUsed>(i)->release();
+            }
         }
-    }*/
+    }
 
     return true;
 }
-/*
-FreeWill::OperatorDescriptorHandle FreeWill::Solver::addUpdateOperator(const std::string &name,
-                                 FreeWill::OperatorName operatorName,
-                                 const std::map<std::string, FreeWill::TensorDescriptorHandle> &inputs,
-                                 const std::map<std::string, FreeWill::TensorDescriptorHandle> &outputs,
-                                 const std::map<std::string, std::any> &properties, DataType dataType)
+
+bool FreeWill::Solver::prune(FreeWill::Model *model)
 {
-    FreeWill::OperatorDescriptor *opDescriptor = new FreeWill::OperatorDescriptor(name, operatorName, inputs, outputs, properties, dataType);
+    waitForAsyncCalls();
 
-    m_updateOperators.push_back(opDescriptor);
+    if (m_mode == SolverMode::QUANTIZED_INFERENCE || m_isPruned || m_pipeline.isBuilt() ||
+            m_sparsity.m_pattern == SparsityPattern::DENSE)
+    {
+        return false;
+    }
 
-    return name;
-}*/
+    switch(m_deviceUsed)
+    {
+    case FreeWill::DeviceType::CPU_NAIVE:
+        m_isPruned = prune<FreeWill::DeviceType::CPU_NAIVE>(model);
+        break;
+    case FreeWill::DeviceType::GPU_CUDA:
+        m_isPruned = prune<FreeWill::DeviceType::GPU_CUDA>(model);
+        break;
+    }
 
-void FreeWill::Solver::clearUpdateOperators()
+    if (!m_isPruned)
+    {
+        clearSparsityMasks();
+    }
+
+    // the graphs launch the dense operators
+    clearGraphs(m_forwardGraph);
+
+    return m_isPruned;
+}
+
+void FreeWill::Solver::applySparsityMasks()
 {
-    /*for (unsigned int i = 0; i<m_updateOperators.size();++i)
+    if (m_sparsityMaskOperators.empty())
     {
-        delete m_updateOperators[i];
+        return;
     }
-    m_updateOperators.clear();*/
 
-    /*std::vector<std::variant<Operator<DeviceType::CPU_NAIVE>*, Operator<DeviceType::GPU_CUDA>*>> m_mergeGradientOperators;
-    std::vector<std::variant<Operator<DeviceType::CPU_NAIVE>*, Operator<DeviceType::GPU_CUDA>*>> m_updateFirstDeviceTensorOperators;
-    std::vector<std::variant<Operator<DeviceType::CPU_NAIVE>*, Operator<DeviceType::GPU_CUDA>*>> m_broadcastTensorToSiblingOperators;
-    */
+    // the masks run once every replica is done updating
+    if (m_deviceUsed == DeviceType::GPU_CUDA)
+    {
+        Context<DeviceType::GPU_CUDA>::getSingleton().joinDevices();
+    }
 
-    for (unsigned int i = 0; i<m_mergeGradientOperators.size(); ++i)
+    for (auto iter = m_sparsityMaskOperators.begin(); iter != m_sparsityMaskOperators.end(); ++iter)
     {
-        switch(m_deviceUsed)
+        switch (m_deviceUsed)
         {
-        case FreeWill::DeviceType::CPU_NAIVE:
-            delete std::get<Operator<DeviceType::CPU_NAIVE>*>(m_mergeGradientOperators[i]);
+        case DeviceType::CPU_NAIVE:
+            std::get<Operator<DeviceType::CPU_NAIVE>*>(*iter)->evaluate();
             break;
-        case FreeWill::DeviceType::GPU_CUDA:
-            delete std::get<Operator<DeviceType::GPU_CUDA>*>(m_mergeGradientOperators[i]);
+        case DeviceType::GPU_CUDA:
+        {
+            Operator<DeviceType::GPU_CUDA> *operatorBase = std::get<Operator<DeviceType::GPU_CUDA>*>(*iter);
+            RUN_CUDA(cudaSetDevice(operatorBase->deviceId()));
+            operatorBase->evaluate();
+
+            // the next pass runs on the devices' own streams
+            RUN_CUDA(cudaStreamSynchronize(computeStream()));
+        }
             break;
         }
     }
 
-    for (unsigned int i =0;i<m_updateFirstDeviceTensorOperators.size();++i)
+    if (m_deviceUsed == DeviceType::GPU_CUDA)
+    {
+        RUN_CUDA(cudaSetDevice(0));
+    }
+}
+
+void FreeWill::Solver::clearSparsityMasks()
+{
+    for (unsigned int i = 0; i < m_sparsityMaskOperators.size(); ++i)
     {
         switch(m_deviceUsed)
         {
         case FreeWill::DeviceType::CPU_NAIVE:
-            delete std::get<Operator<DeviceType::CPU_NAIVE>*>(m_updateFirstDeviceTensorOperators[i]);
+            delete std::get<Operator<DeviceType::CPU_NAIVE>*>(m_sparsityMaskOperators[i]);
             break;
         case FreeWill::DeviceType::GPU_CUDA:
-            delete std::get<Operator<DeviceType::GPU_CUDA>*>(m_updateFirstDeviceTensorOperators[i]);
+            delete std::get<Operator<DeviceType::GPU_CUDA>*>(m_sparsityMaskOperators[i]);
             break;
         }
     }
 
-    for (unsigned int i =0;i<m_broadcastTensorToSiblingOperators.size();++i)
+    m_sparsityMaskOperators.clear();
+    m_isPruned = false;
+}
+
+template<FreeWill::DeviceType DeviceUsed>
+void FreeWill::Solver::copyToMasterWeights()
+{
+    for (auto iter = m_masterWeights.begin(); iter != m_masterWeights.end(); ++iter)
     {
-        switch (m_deviceUsed)
+        TensorDescriptor *weight = iter->first;
+        TensorDescriptor *masterWeight = iter->second;
+
+        for (unsigned int d = 0; d < weight->m_tensors[DeviceUsed].size(); ++d)
         {
-        case FreeWill::DeviceType::CPU_NAIVE:
-            delete std::get<Operator<DeviceType::CPU_NAIVE>*>(m_broadcastTensorToSiblingOperators[i]);
-            break;
-        case FreeWill::DeviceType::GPU_CUDA:
-            delete std::get<Operator<DeviceType::GPU_CUDA>*>(m_broadcastTensorToSiblingOperators[i]);
-            break;
-        default:
-            break;
+            TensorBase<DeviceUsed> *weightTensor = weight->getTensorForDevice<DeviceUsed>(d);
+            Tensor<DeviceUsed, float> *masterTensor = masterWeight->getTensorForDevice<DeviceUsed>(d)->template toType<float>();
+            unsigned int size = weightTensor->shape().size();
+
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                RUN_CUDA(cudaSetDevice(weight->deviceId(d)));
+                weightTensor->copyFromDeviceToHost();
+            }
+
+            for (unsigned int e = 0; e < size; ++e)
+            {
+                if (weight->m_dataType == DataType::HALF)
+                {
+                    (*masterTensor)[e] = (*weightTensor->template toType<Half>())[e];
+                }
+                else
+                {
+                    (*masterTensor)[e] = (*weightTensor->template toType<BFloat16>())[e];
+                }
+            }
+
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                masterTensor->copyFromHostToDevice();
+            }
         }
+    }
 
+    if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+    {
+        RUN_CUDA(cudaSetDevice(0));
     }
-}
 
+    m_isMasterWeightStale = false;
+}
 
-void FreeWill::Solver::forward(FreeWill::Model *model)
+template<FreeWill::DeviceType DeviceUsed>
+void FreeWill::Solver::runGradientAllReduce(GradientAllReduce<DeviceUsed> &gradientAllReduce, double learningRate)
 {
+    if (m_isMasterWeightStale)
+    {
+        copyToMasterWeights<DeviceUsed>();
+    }
 
-    std::vector<WorkerMessage*> messageQueue;
-
-    auto iter = model->m_forwardPath.begin();
+    bool isApplied = gradientAllReduce.run(learningRate, m_lossScale, m_lossScaling.m_isEnabled);
 
-    switch(m_deviceUsed)
+    if (!m_lossScaling.m_isEnabled)
     {
-    case FreeWill::DeviceType::CPU_NAIVE:
-        messageQueue.reserve(model->m_forwardPath.size() * Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().deviceCount());
-        for(; iter != model->m_forwardPath.end();++iter)
-        {
-            model->m_operators[(*iter)]->evaluate<FreeWill::DeviceType::CPU_NAIVE>(messageQueue, model->m_tensors);
-            //break;
-        }
-        break;
-    case FreeWill::DeviceType::GPU_CUDA:
-        for(; iter != model->m_forwardPath.end();++iter)
-        {
-            model->m_operators[(*iter)]->evaluate<FreeWill::DeviceType::GPU_CUDA>(messageQueue, model->m_tensors);
-        }
-        break;
+        return;
     }
 
-    for(int i=0;i<messageQueue.size();++i)
+    if (!isApplied)
     {
-        messageQueue[i]->join();
-        delete messageQueue[i];
+        m_lossScale *= m_lossScaling.m_backoffFactor;
+        m_goodStepCount = 0;
+        ++m_skippedStepCount;
+    }
+    else if (++m_goodStepCount >= m_lossScaling.m_growthInterval)
+    {
+        m_lossScale *= m_lossScaling.m_growthFactor;
+        m_goodStepCount = 0;
     }
 }
 
-void FreeWill::Solver::backward(FreeWill::Model *model)
+void FreeWill::Solver::update(double learningRate)
 {
-    std::vector<WorkerMessage*> messageQueue;
+    waitForAsyncCalls();
+    if (m_mode != SolverMode::TRAINING)
+    {
+        return;
+    }
 
-    auto iter = model->m_backwardPath.begin();
+    m_accumulatedPassCount = 0;
 
-    switch(m_deviceUsed)
+    if (m_gradientAllReduceCPU.isBuilt())
     {
-    case FreeWill::DeviceType::CPU_NAIVE:
-        messageQueue.reserve(model->m_forwardPath.size() * Context<FreeWill::DeviceType::CPU_NAIVE>::getSingleton().deviceCount());
+        runGradientAllReduce(m_gradientAllReduceCPU, learningRate);
+        applySparsityMasks();
+        return;
+    }
 
-        for(; iter != model->m_backwardPath.end();++iter)
-        {
-            model->m_operators[(*iter)]->evaluate<FreeWill::DeviceType::CPU_NAIVE>(messageQueue, model->m_tensors);
-        }
-        break;
-    case FreeWill::DeviceType::GPU_CUDA:
-        for(; iter != model->m_backwardPath.end();++iter)
-        {
-            model->m_operators[(*iter)]->evaluate<FreeWill::DeviceType::GPU_CUDA>(messageQueue, model->m_tensors);
-        }
-        break;
+    if (m_gradientAllReduceGPU.isBuilt())
+    {
+        runGradientAllReduce(m_gradientAllReduceGPU, learningRate);
+        applySparsityMasks();
+        return;
     }
 
-    for(int i=0;i<messageQueue.size();++i)
+    // the merge and the update run on the first gpu once every replica's backward pass is done
+    if (m_deviceUsed == DeviceType::GPU_CUDA)
     {
-        messageQueue[i]->join();
-        delete messageQueue[i];
+        Context<DeviceType::GPU_CUDA>::getSingleton().joinDevices();
+        RUN_CUDA(cudaSetDevice(0));
     }
-}
 
-void FreeWill::Solver::update(double learningRate)
-{
     for(unsigned int i = 0;i<m_mergeGradientOperators.size();++i)
     {
         switch(m_deviceUsed)
@@ -289,6 +1407,12 @@ void FreeWill::Solver::update(double learningRate)
         }
     }
 
+    // the siblings pull the updated weights on their own streams
+    if (m_deviceUsed == DeviceType::GPU_CUDA)
+    {
+        Context<DeviceType::GPU_CUDA>::getSingleton().joinDevices();
+    }
+
     for(auto iter = m_broadcastTensorToSiblingOperators.begin(); iter != m_broadcastTensorToSiblingOperators.end(); ++iter)
     {
         switch (m_deviceUsed)
@@ -305,6 +1429,7 @@ void FreeWill::Solver::update(double learningRate)
         case DeviceType::GPU_CUDA:
         {
             Operator<DeviceType::GPU_CUDA> *operatorBase = std::get<Operator<DeviceType::GPU_CUDA>*>(*iter);
+            RUN_CUDA(cudaSetDevice(operatorBase->deviceId()));
             operatorBase->evaluate();
         }
             break;
@@ -314,13 +1439,206 @@ void FreeWill::Solver::update(double learningRate)
 
     }
 
+    if (m_deviceUsed == DeviceType::GPU_CUDA)
+    {
+        RUN_CUDA(cudaSetDevice(0));
+    }
+
+    applySparsityMasks();
+}
+
+FreeWill::SolverState FreeWill::Solver::state() const
+{
+    SolverState state;
+
+    state.m_step = m_gradientAllReduceCPU.isBuilt() ? m_gradientAllReduceCPU.step() : m_gradientAllReduceGPU.step();
+    state.m_goodStepCount = m_goodStepCount;
+    state.m_skippedStepCount = m_skippedStepCount;
+    state.m_isMasterWeightStale = m_isMasterWeightStale;
+    state.m_lossScale = m_lossScale;
+
+    return state;
+}
+
+void FreeWill::Solver::setState(const FreeWill::SolverState &state)
+{
+    m_gradientAllReduceCPU.setStep(state.m_step);
+    m_gradientAllReduceGPU.setStep(state.m_step);
+    m_goodStepCount = state.m_goodStepCount;
+    m_skippedStepCount = state.m_skippedStepCount;
+    // once taken, the master weights of the checkpoint are more precise than its weights
+    m_isMasterWeightStale = state.m_isMasterWeightStale != 0;
+    m_lossScale = state.m_lossScale;
 }
 
 FreeWill::Solver::Solver()
-    :m_previousLearningRate(0.0)
+    :m_forwardExecutor(),
+      m_backwardExecutor(),
+      m_forwardExecutorGPU(),
+      m_backwardExecutorGPU(),
+      m_gradientAllReduceCPU(),
+      m_gradientAllReduceGPU(),
+      m_pipeline(),
+      m_prefetchSchedule(),
+      m_previousLearningRate(0.0),
+      m_masterWeights(),
+      m_isMasterWeightStale(false),
+      m_lossScale(1.0),
+      m_appliedLossScale(1.0),
+      m_goodStepCount(0),
+      m_skippedStepCount(0),
+      m_isQuantized(false),
+      m_sparsityMaskOperators(),
+      m_isPruned(false),
+      m_forwardGraph(),
+      m_backwardGraph(),
+      m_accumulatingBackwardGraph(),
+      m_accumulatedPassCount(0),
+      m_isAccumulating(false),
+      m_mode(SolverMode::TRAINING),
+      m_planMemory(false),
+      m_overlapGradientReduce(true),
+      m_fuseOperators(true),
+      m_blockChannels(false),
+      m_runInline(false),
+      m_useGraphs(false),
+      m_useStreams(false),
+      m_optimizer(),
+      m_lossScaling(),
+      m_gradientCompression(),
+      m_asynchronousUpdate(),
+      m_microBatchCount(1),
+      m_gradientAccumulationCount(1),
+      m_managedMemory(),
+      m_sparsity(),
+      m_activationCompression(ActivationCompression::NONE),
+      m_asyncThread(nullptr),
+      m_asyncMutex(),
+      m_asyncTaskAvailable(),
+      m_asyncIdle(),
+      m_asyncQueue(),
+      m_asyncPendingCount(0),
+      m_isAsyncRunning(false)
 {}
 
 FreeWill::Solver::~Solver()
 {
+    if (m_asyncThread)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_asyncMutex);
+            m_isAsyncRunning = false;
+        }
+        m_asyncTaskAvailable.notify_all();
+
+        // the queued calls still run
+        m_asyncThread->join();
+        delete m_asyncThread;
+        m_asyncThread = nullptr;
+    }
+
     clearUpdateOperators();
+    clearSparsityMasks();
+}
+
+void FreeWill::Solver::asyncLoop()
+{
+    while (true)
+    {
+        std::packaged_task<void()> task;
+
+        {
+            std::unique_lock<std::mutex> lock(m_asyncMutex);
+            m_asyncTaskAvailable.wait(lock, [this]{ return !m_asyncQueue.empty() || !m_isAsyncRunning; });
+
+            if (m_asyncQueue.empty())
+            {
+                return;
+            }
+
+            task = std::move(m_asyncQueue.front());
+            m_asyncQueue.pop_front();
+        }
+
+        // the task only finishes, making its future ready, once the devices are done with it
+        task();
+
+        {
+            std::lock_guard<std::mutex> lock(m_asyncMutex);
+            --m_asyncPendingCount;
+        }
+        m_asyncIdle.notify_all();
+    }
+}
+
+std::future<void> FreeWill::Solver::enqueueAsync(std::function<void()> &&task)
+{
+    // forward() and the others return with the kernels they launched from this thread still
+    // queued on its own streams, the caller's copies aren't ordered after them
+    std::packaged_task<void()> packagedTask([this, task = std::move(task)]
+    {
+        task();
+
+        if (m_deviceUsed == DeviceType::GPU_CUDA)
+        {
+            Context<DeviceType::GPU_CUDA>::getSingleton().synchronizeDevices();
+        }
+    });
+    std::future<void> result = packagedTask.get_future();
+
+    {
+        std::lock_guard<std::mutex> lock(m_asyncMutex);
+
+        if (!m_asyncThread)
+        {
+            m_isAsyncRunning = true;
+            m_asyncThread = new std::thread(&Solver::asyncLoop, this);
+        }
+
+        m_asyncQueue.push_back(std::move(packagedTask));
+        ++m_asyncPendingCount;
+    }
+    m_asyncTaskAvailable.notify_one();
+
+    return result;
+}
+
+void FreeWill::Solver::waitForAsyncCalls()
+{
+    // the asynchronous calls themselves run forward() and the others on the solver's thread
+    if (m_asyncThread && m_asyncThread->get_id() != std::this_thread::get_id())
+    {
+        waitAsync();
+    }
+}
+
+void FreeWill::Solver::waitAsync()
+{
+    std::unique_lock<std::mutex> lock(m_asyncMutex);
+    m_asyncIdle.wait(lock, [this]{ return m_asyncPendingCount == 0; });
+}
+
+std::future<void> FreeWill::Solver::forwardAsync(FreeWill::Model *model)
+{
+    return enqueueAsync([this, model]{ forward(model); });
+}
+
+std::future<void> FreeWill::Solver::backwardAsync(FreeWill::Model *model)
+{
+    return enqueueAsync([this, model]{ backward(model); });
+}
+
+std::future<void> FreeWill::Solver::updateAsync(double learningRate)
+{
+    return enqueueAsync([this, learningRate]{ update(learningRate); });
+}
+
+std::future<void> FreeWill::Solver::stepAsync(FreeWill::Model *model, double learningRate)
+{
+    return enqueueAsync([this, model, learningRate]
+    {
+        forward(model);
+        backward(model);
+        update(learningRate);
+    });
 }
@@ -3,12 +3,47 @@
 
 #include "../DeviceSelection.h"
 #include "../Operator/Operator.h"
+#include "../Operator/CompressActivation.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include "OperatorDescriptor.h"
+#include "GraphExecutor.h"
+#include "GradientAllReduce.h"
+#include "Pipeline.h"
+#include "PrefetchSchedule.h"
+#include "../Context/CUDAGraph.h"
 
 namespace FreeWill
 {
     class Model;
+
+    // TRAINING builds both paths and the optimizer. The inference modes only create the operators
+    // and tensors of the forward path, backward() and update() do nothing. QUANTIZED_INFERENCE
+    // runs in float until calibrate() has seen the data and quantize() has moved the dot
+    // products and convolutions to int8.
+    enum class SolverMode : uint32_t
+    {
+        TRAINING,
+        INFERENCE,
+        QUANTIZED_INFERENCE
+    };
+
+    // What a checkpoint keeps of the solver besides the tensors, see Model::saveCheckpoint
+    struct SolverState
+    {
+        uint32_t m_step = 0;
+        uint32_t m_goodStepCount = 0;
+        uint32_t m_skippedStepCount = 0;
+        // the master weights are taken from the weights at the next update
+        uint32_t m_isMasterWeightStale = 1;
+        double m_lossScale = 1.0;
+    };
+
     class Solver
     {
         //std::vector<OperatorDescriptor*> m_updateOperators;
@@ -16,11 +51,179 @@ namespace FreeWill
         std::vector<std::variant<Operator<DeviceType::CPU_NAIVE>*, Operator<DeviceType::GPU_CUDA>*>> m_updateFirstDeviceTensorOperators;
         std::vector<std::variant<Operator<DeviceType::CPU_NAIVE>*, Operator<DeviceType::GPU_CUDA>*>> m_broadcastTensorToSiblingOperators;
 
+        GraphExecutor<DeviceType::CPU_NAIVE> m_forwardExecutor;
+        GraphExecutor<DeviceType::CPU_NAIVE> m_backwardExecutor;
+        // with m_useStreams, the paths spread over the compute streams of each gpu
+        GraphExecutor<DeviceType::GPU_CUDA> m_forwardExecutorGPU;
+        GraphExecutor<DeviceType::GPU_CUDA> m_backwardExecutorGPU;
+
+        // merges the gradients in parallel and runs the fused optimizer step on every replica,
+        // the operator lists above are only used for sgd when it can't be built
+        GradientAllReduce<DeviceType::CPU_NAIVE> m_gradientAllReduceCPU;
+        GradientAllReduce<DeviceType::GPU_CUDA> m_gradientAllReduceGPU;
+
+        // runs the paths of a pipelined model (Model::placeOperators) instead of the executors
+        Pipeline m_pipeline;
+        // runs the paths on gpu with m_managedMemory
+        PrefetchSchedule m_prefetchSchedule;
+
         double m_previousLearningRate;
+
+        // the weight and its float master copy, for 16-bit weights
+        std::vector<std::pair<TensorDescriptor*, TensorDescriptor*>> m_masterWeights;
+        // the master copies are taken at the first update, so weights written after init count
+        bool m_isMasterWeightStale;
+
+        double m_lossScale;
+        double m_appliedLossScale;
+        unsigned int m_goodStepCount;
+        unsigned int m_skippedStepCount;
+
+        template<DeviceType DeviceUsed>
+        void copyToMasterWeights();
+
+        void applyLossScale(Model *model);
+
+        template<DeviceType DeviceUsed>
+        void runGradientAllReduce(GradientAllReduce<DeviceUsed> &gradientAllReduce, double learningRate);
+
+        bool m_isQuantized;
+
+        // a run of path operators, on gpu with m_useGraphs replayed from one graph per device,
+        // or run as they are when one of them can't be captured
+        struct CapturedSegment
+        {
+            std::vector<OperatorDescriptor*> m_operators;
+            std::vector<CUDAGraph*> m_graphs;
+        };
+
+        struct CapturedPath
+        {
+            std::vector<CapturedSegment> m_segments;
+            unsigned int m_batchSize = 0;
+            // the first pass runs as it is, so that what the operators allocate lazily is in
+            // place before it is baked into the graphs
+            unsigned int m_runCount = 0;
+        };
+
+        CapturedPath m_forwardGraph;
+        CapturedPath m_backwardGraph;
+        // the backward passes after the first of an accumulation, their weight derivatives add
+        CapturedPath m_accumulatingBackwardGraph;
+
+        // the backward passes since the last update, and whether the gpu weight derivatives
+        // are set to add to the gradients
+        unsigned int m_accumulatedPassCount;
+        bool m_isAccumulating;
+
+        void setAccumulating(Model *model, bool isAccumulating);
+
+        // the paths with their names resolved, what the gpu steps walk without the streams
+        std::vector<OperatorDescriptor*> m_forwardOperators;
+        std::vector<OperatorDescriptor*> m_backwardOperators;
+
+        void runGraphs(Model *model, const std::vector<OperatorDescriptor*> &path, CapturedPath &capturedPath);
+
+        bool buildExecutorsGPU(Model *model);
+        void clearGraphs(CapturedPath &capturedPath);
+
+        template<DeviceType DeviceUsed>
+        void calibrate(Model *model);
+
+        template<DeviceType DeviceUsed>
+        bool quantize(Model *model);
+
+        // per pruned weight and device, zero the pruned weights again after an update
+        std::vector<std::variant<Operator<DeviceType::CPU_NAIVE>*, Operator<DeviceType::GPU_CUDA>*>> m_sparsityMaskOperators;
+        bool m_isPruned;
+
+        template<DeviceType DeviceUsed>
+        bool prune(Model *model);
+
+        void applySparsityMasks();
+        void clearSparsityMasks();
+
+        // the thread the asynchronous calls run on, in the order they were made. It is started
+        // by the first of them and stopped by the destructor.
+        std::thread *m_asyncThread;
+        std::mutex m_asyncMutex;
+        std::condition_variable m_asyncTaskAvailable;
+        std::condition_variable m_asyncIdle;
+        std::deque<std::packaged_task<void()>> m_asyncQueue;
+        // queued or running
+        unsigned int m_asyncPendingCount;
+        bool m_isAsyncRunning;
+
+        void asyncLoop();
+        std::future<void> enqueueAsync(std::function<void()> &&task);
+
+        // a blocking call made while asynchronous ones are pending runs after them
+        void waitForAsyncCalls();
+
     public:
+        SolverMode m_mode;
         DeviceType m_deviceUsed;
         unsigned int m_batchSize;
         DataType m_dataType;
+        // share one arena per device between batch tensors with disjoint lifetimes
+        bool m_planMemory;
+        // on cpu, merge each gradient while the rest of the backward pass is still running
+        bool m_overlapGradientReduce;
+        // fold activations into the operator producing their input (Model::fuseOperators)
+        bool m_fuseOperators;
+        // cpu inference: run the convolutions, the max poolings and the activations between
+        // them on channel blocked tensors (Model::planLayouts). The tensors only those
+        // operators touch then hold blocked data.
+        bool m_blockChannels;
+        // cpu, not pipelined: forward() runs the operators on the calling thread rather than
+        // handing them to the device workers (GraphExecutor::runInline), for the latency of
+        // small batches, a batch of one above all, where the handoffs outweigh the operators.
+        // Pin the calling thread to keep it on a warm core.
+        bool m_runInline;
+        // on gpu, from the second pass on forward() and backward() launch each device's part
+        // of the path as one CUDA graph instead of an operator at a time. Operators that can't
+        // be captured (Operator::isCapturable) run as they are between the graphs. A new batch
+        // size or loss scale captures again.
+        bool m_useGraphs;
+        // on gpu, run the operators of a path that don't depend on each other concurrently on
+        // the compute streams of each device, ordered by events where a tensor connects them
+        // (GraphExecutor). Set before init, m_useGraphs takes precedence.
+        bool m_useStreams;
+        // set before init, the optimizer state tensors are added to the model by init
+        OptimizerParameters m_optimizer;
+        // set before init, needs the fused optimizer step
+        LossScaleParameters m_lossScaling;
+        // set before init, how the gradients travel between the hosts of a distributed run
+        // (Communicator::open), needs the fused optimizer step
+        GradientCompression m_gradientCompression;
+        // set before init, cpu only: the replicas update the weights with their own gradients
+        // instead of merging them, sharing one copy (Hogwild) or reconciling their copies every
+        // few steps, see AsynchronousUpdate. Float and double weights, no loss scaling, not
+        // pipelined. A checkpoint keeps device 0's copy.
+        AsynchronousUpdate m_asynchronousUpdate;
+        // set before init, for pipelined models only: the micro-batches a batch is split into
+        // so that the stages work concurrently. The batch size has to be a multiple of it,
+        // other batches run as one. Graphs, streams and quantization don't apply.
+        unsigned int m_microBatchCount;
+        // set before init, not for pipelined models: the backward passes whose gradients add up
+        // in the gradient tensors before update() merges and applies them once. The caller
+        // loads a micro-batch, runs forward() and backward() that many times, then update(), for
+        // a batch of m_batchSize x devices x m_gradientAccumulationCount at the activation memory
+        // of one pass. The gradients are cleared before the first pass on cpu as usual, on gpu
+        // the first pass overwrites them and the others add to them.
+        unsigned int m_gradientAccumulationCount;
+        // set before init, gpu only: the tensors of the model come from managed memory, so
+        // that a model and batch larger than the devices still train, paged in and out by the
+        // driver. The paths run an operator at a time with their tensors prefetched and the
+        // activations moved to the host until the backward pass, see PrefetchSchedule. Graphs,
+        // streams and pipelined models don't apply.
+        ManagedMemoryParameters m_managedMemory;
+        // the pattern prune() cuts the dot product and convolution weights to
+        SparsityParameters m_sparsity;
+        // set before init, training with m_planMemory and not pipelined: what the forward pass
+        // keeps of the ReLU outputs and max pooling inputs the backward pass reads, see
+        // Model::planActivationCompression. EXACT gives the same gradients.
+        ActivationCompression m_activationCompression;
 
         bool init(Model *model);
 
@@ -29,6 +232,52 @@ namespace FreeWill
 
         void update(double learningRate = -0.01);
 
+        // forward(), backward(), update() and the three of them in a row, run on a thread of the
+        // solver instead of the caller's. The calls run in the order they were made, the future
+        // is ready when the devices are done with it. Until then the model's tensors belong to
+        // the solver: the caller can prepare the next batch in memory of its own or read back
+        // results it copied out earlier, then load the batch once the future is ready. A
+        // blocking call first waits for the pending asynchronous ones.
+        std::future<void> forwardAsync(Model *model);
+        std::future<void> backwardAsync(Model *model);
+        std::future<void> updateAsync(double learningRate = -0.01);
+        std::future<void> stepAsync(Model *model, double learningRate = -0.01);
+
+        // until every asynchronous call made so far is done
+        void waitAsync();
+
+        // QUANTIZED_INFERENCE only: a float forward pass over the current input that widens the
+        // recorded range ("InputRange") of every dot product and convolution input. Run it over
+        // a representative set of batches before quantize().
+        bool calibrate(Model *model);
+
+        // QUANTIZED_INFERENCE only: converts the calibrated operators to int8 with per channel
+        // weight scales and frees their float weights, forward() runs int8 afterwards.
+        bool quantize(Model *model);
+
+        // After init, TRAINING or INFERENCE, once: prunes the weights of the dot products and
+        // convolutions on the forward path to m_sparsity (StructuredSparsity_CPU.h). In TRAINING
+        // the pruned weights stay zero through every update, so fine-tuning keeps the mask it
+        // started with. In INFERENCE the dot products move to PrunedDotProductWithBias, which
+        // skips the pruned weights, and free their dense ones, the convolutions run dense on
+        // their pruned weights.
+        bool prune(Model *model);
+
+        double lossScale() const
+        {
+            return m_lossScale;
+        }
+
+        // the updates skipped by loss scaling because the gradient had an inf or a nan
+        unsigned int skippedStepCount() const
+        {
+            return m_skippedStepCount;
+        }
+
+        // after init, restoring the state of a checkpoint resumes the optimizer where it was
+        SolverState state() const;
+        void setState(const SolverState &state);
+
         Solver();
 
         ~Solver();
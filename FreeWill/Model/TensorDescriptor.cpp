@@ -7,7 +7,12 @@ FreeWill::TensorDescriptor::TensorDescriptor(const TensorDescriptor &in)
       m_isBatchTensor(in.m_isBatchTensor),
       m_batchSize(in.m_batchSize),
       m_isRandomlyInitialized(in.m_isRandomlyInitialized),
+      m_randomStream(in.m_randomStream),
       m_dataType(in.m_dataType),
+      m_deviceIds(in.m_deviceIds),
+      m_layout(in.m_layout),
+      m_isShared(in.m_isShared),
+      m_memoryCategory(in.m_memoryCategory),
       m_tensors(in.m_tensors)
 {
 }
@@ -19,7 +24,12 @@ void FreeWill::TensorDescriptor::operator =(const TensorDescriptor &in)
     m_isBatchTensor = in.m_isBatchTensor;
     m_batchSize = in.m_batchSize;
     m_isRandomlyInitialized = in.m_isRandomlyInitialized;
+    m_randomStream = in.m_randomStream;
     m_dataType = in.m_dataType;
+    m_deviceIds = in.m_deviceIds;
+    m_layout = in.m_layout;
+    m_isShared = in.m_isShared;
+    m_memoryCategory = in.m_memoryCategory;
     m_tensors = in.m_tensors;
 }
 
@@ -29,7 +39,12 @@ FreeWill::TensorDescriptor::TensorDescriptor(const std::string &name, const Shap
       m_isBatchTensor(isBatchTensor),
       m_batchSize(0),
       m_isRandomlyInitialized(isRandomlyInitialized),
+      m_randomStream(0),
       m_dataType(dataType),
+      m_deviceIds(),
+      m_layout(TensorLayout::CHANNEL_LAST),
+      m_isShared(false),
+      m_memoryCategory(MemoryCategory::OTHER),
       m_tensors()
 {
 
@@ -90,13 +105,17 @@ FreeWill::TensorDescriptorHandle &FreeWill::TensorDescriptorHandle::enableBatch(
 {
     TensorDescriptor* tensorDescriptor = m_model->m_tensors[m_name];
 
-    if (!tensorDescriptor->isInitialized())
+    if (tensorDescriptor->isInitialized())
     {
-        tensorDescriptor->m_isBatchTensor = true;
+        std::cerr << "Can't enable batch after tensor is initialized!"<<std::endl;
+    }
+    else if (tensorDescriptor->m_shape.dimension() == Shape::MAX_DIMENSION)
+    {
+        std::cerr << "Can't enable batch, tensor " << m_name << " has no dimension left for it" << std::endl;
     }
     else
     {
-        std::cerr << "Can't enable batch after tensor is initialized!"<<std::endl;
+        tensorDescriptor->m_isBatchTensor = true;
     }
 
     return *this;
@@ -3,6 +3,7 @@
 
 #include "../Tensor/Tensor.h"
 #include "../Tensor/Shape.h"
+#include "../Tensor/HalfPrecision.h"
 #include <map>
 #include <variant>
 #include <cstdint>
@@ -15,7 +16,10 @@ namespace FreeWill
     {
         FLOAT,
         DOUBLE,
-        UNSIGNED_INT
+        UNSIGNED_INT,
+        // 16-bit storage, computed in float, the weights keep a float master copy (see Solver)
+        HALF,
+        BFLOAT16
     };
 
     class Model;
@@ -73,7 +77,21 @@ namespace FreeWill
         bool m_isBatchTensor;
         int m_batchSize;
         bool m_isRandomlyInitialized;
+        // the stream every replica of a randomly initialized tensor is drawn from, 0 until the
+        // first one is allocated
+        uint64_t m_randomStream;
         DataType m_dataType;
+        // the devices holding a replica, replica i lives on m_deviceIds[i]. Empty for a replica on
+        // every device, only the tensors of a pipelined model are placed (see Model::placeOperators).
+        std::vector<unsigned int> m_deviceIds;
+        // CHANNEL_LAST unless Model::planLayouts blocked the channels
+        TensorLayout m_layout;
+        // the replicas view the weights of a SharedWeights (see Model::shareWeights), they are
+        // neither randomized nor restored
+        bool m_isShared;
+        // what the allocator files the replicas under (see BlobAllocator::Tag), set by
+        // Model::allocateTensors
+        MemoryCategory m_memoryCategory;
 
         std::map<DeviceType, std::vector<std::variant<TensorBase<DeviceType::GPU_CUDA>*, TensorBase<DeviceType::CPU_NAIVE>*>>> m_tensors;
 
@@ -88,66 +106,110 @@ namespace FreeWill
             return !((m_tensors[FreeWill::DeviceType::CPU_NAIVE].size() == 0) && (m_tensors[FreeWill::DeviceType::GPU_CUDA].size() == 0));
         }
 
+        unsigned int deviceId(unsigned int replica) const
+        {
+            return m_deviceIds.empty() ? replica : m_deviceIds[replica];
+        }
+
+        // the replica on deviceId, -1 when the tensor isn't placed there
+        int replicaIndex(unsigned int deviceId) const
+        {
+            if (m_deviceIds.empty())
+            {
+                return deviceId;
+            }
+
+            for (unsigned int i = 0; i < m_deviceIds.size(); ++i)
+            {
+                if (m_deviceIds[i] == deviceId)
+                {
+                    return i;
+                }
+            }
+
+            return -1;
+        }
+
+        template<DeviceType DeviceUsed, typename DataType>
+        static bool initTensor(TensorBase<DeviceUsed> *tensor, const std::vector<ReferenceCountedBlob<DeviceUsed>> *arenas, unsigned int deviceIndex, unsigned int offset)
+        {
+            if (arenas)
+            {
+                return tensor->template toType<DataType>()->init((*arenas)[deviceIndex], offset);
+            }
+
+            return tensor->template toType<DataType>()->init();
+        }
+
+        // every replica of a randomly initialized tensor draws the same stream, so they are equal
+        // without copying and each device fills its own
+        template<DeviceType DeviceUsed, typename DataType>
+        TensorBase<DeviceUsed> *createTensor(unsigned int batchSize, const std::vector<ReferenceCountedBlob<DeviceUsed>> *arenas, unsigned int deviceIndex, unsigned int offset)
+        {
+            TensorBase<DeviceUsed> *tensor = new FreeWill::Tensor<DeviceUsed, DataType>(m_isBatchTensor?(m_shape + (m_batchSize = batchSize)):m_shape, m_name);
+            tensor->setLayout(m_layout);
+            initTensor<DeviceUsed, DataType>(tensor, arenas, deviceIndex, offset);
+
+            if (m_isRandomlyInitialized && !m_isShared)
+            {
+                tensor->template toType<DataType>()->randomize(m_randomStream);
+            }
+
+            return tensor;
+        }
+
+        // with arenas, the tensor of device i is placed at offset inside arenas[i] (see MemoryPlanner)
         template<DeviceType DeviceUsed = DeviceType::CPU_NAIVE>
-        void allocateTensor(unsigned int batchSize)
+        void allocateTensor(unsigned int batchSize, const std::vector<ReferenceCountedBlob<DeviceUsed>> *arenas = nullptr, unsigned int offset = 0)
         {
-            int deviceCount = Context<DeviceUsed>::getSingleton().deviceCount();
+            int replicaCount = m_deviceIds.empty() ? Context<DeviceUsed>::getSingleton().deviceCount() : m_deviceIds.size();
 
-            for (int i =0;i<deviceCount;++i)
+            if (m_isRandomlyInitialized && m_randomStream == 0)
+            {
+                m_randomStream = RandomNumberGenerator::getSingleton().newStream();
+            }
+
+            for (int i =0;i<replicaCount;++i)
             {
                 if constexpr (DeviceUsed == FreeWill::DeviceType::GPU_CUDA)
                 {
-                    RUN_CUDA(cudaSetDevice(i));
+                    RUN_CUDA(cudaSetDevice(deviceId(i)));
                 }
 
                 FreeWill::TensorBase<DeviceUsed> *tensor = nullptr;
-                switch (m_dataType)
+
+                // on cpu the replica's worker allocates it, so that its pages are first touched
+                // on the device's NUMA node
+                Context<DeviceUsed>::getSingleton().runOnDevice(deviceId(i), [&]
                 {
-                case DataType::FLOAT:
-                    tensor = new FreeWill::Tensor<DeviceUsed, float>(m_isBatchTensor?(m_shape + (m_batchSize = batchSize)):m_shape, m_name);
-                    tensor->template toType<float>()->init();
-                    if (m_isRandomlyInitialized)
-                    {
-                        if (i == 0)
-                        {
-                            tensor->template toType<float>()->randomize();
-                        }
-                        else
-                        {
-                            TensorBase<DeviceUsed> *firstTensor = std::get<TensorBase<DeviceUsed>*>(m_tensors[DeviceUsed][0]);
-                            std::copy((unsigned char*)firstTensor->cpuDataHandle(),
-                                      ((unsigned char*)firstTensor->cpuDataHandle())+firstTensor->sizeInByte(), (unsigned char*) tensor->cpuDataHandle());
-                        }
-                    }
-                    break;
-                case DataType::DOUBLE:
-                    tensor = new FreeWill::Tensor<DeviceUsed, double>(m_isBatchTensor?(m_shape + (m_batchSize = batchSize)):m_shape, m_name);
-                    tensor->template toType<double>()->init();
-                    if (m_isRandomlyInitialized)
+                    BlobAllocator::Tag tag(m_memoryCategory, m_name);
+
+                    switch (m_dataType)
                     {
-                        if (i == 0)
-                        {
-                            tensor->template toType<double>()->randomize();
-                        }
-                        else
+                    case DataType::FLOAT:
+                        tensor = createTensor<DeviceUsed, float>(batchSize, arenas, i, offset);
+                        break;
+                    case DataType::DOUBLE:
+                        tensor = createTensor<DeviceUsed, double>(batchSize, arenas, i, offset);
+                        break;
+                    case DataType::HALF:
+                        tensor = createTensor<DeviceUsed, Half>(batchSize, arenas, i, offset);
+                        break;
+                    case DataType::BFLOAT16:
+                        tensor = createTensor<DeviceUsed, BFloat16>(batchSize, arenas, i, offset);
+                        break;
+                    case DataType::UNSIGNED_INT:
+                        tensor = new FreeWill::Tensor<DeviceUsed, unsigned int>(m_isBatchTensor?(m_shape + (m_batchSize = batchSize)):m_shape, m_name);
+                        initTensor<DeviceUsed, unsigned int>(tensor, arenas, i, offset);
+                        if (m_isRandomlyInitialized)
                         {
-                            TensorBase<DeviceUsed> *firstTensor = std::get<TensorBase<DeviceUsed>*>(m_tensors[DeviceUsed][0]);
-                            std::copy((unsigned char*)firstTensor->cpuDataHandle(),
-                                      ((unsigned char*)firstTensor->cpuDataHandle())+firstTensor->sizeInByte(), (unsigned char*) tensor->cpuDataHandle());
+                            //tensor->template toType<unsigned int>()->randomize();
                         }
+                        break;
+                    default:
+                        break;
                     }
-                    break;
-                case DataType::UNSIGNED_INT:
-                    tensor = new FreeWill::Tensor<DeviceUsed, unsigned int>(m_isBatchTensor?(m_shape + (m_batchSize = batchSize)):m_shape, m_name);
-                    tensor->template toType<unsigned int>()->init();
-                    if (m_isRandomlyInitialized)
-                    {
-                        //tensor->template toType<unsigned int>()->randomize();
-                    }
-                    break;
-                default:
-                    break;
-                }
+                });
 
                 m_tensors[DeviceUsed].push_back(tensor);
             }
@@ -155,6 +217,40 @@ namespace FreeWill
             cudaSetDevice(0);
         }
 
+        // views items [first, first + count) of the tensors of every device, see Model::setBatchSize
+        // and Pipeline
+        template<DeviceType DeviceUsed = DeviceType::CPU_NAIVE>
+        bool setBatchWindow(unsigned int first, unsigned int count)
+        {
+            for (unsigned int i = 0; i < m_tensors[DeviceUsed].size(); ++i)
+            {
+                if (!getTensorForDevice<DeviceUsed>(i)->setBatchWindow(first, count))
+                {
+                    return false;
+                }
+            }
+
+            m_batchSize = count;
+
+            return true;
+        }
+
+        // shares the memory of source, which is allocated already with the same size
+        template<DeviceType DeviceUsed = DeviceType::CPU_NAIVE>
+        void allocateTensorAlias(unsigned int batchSize, TensorDescriptor *source)
+        {
+            std::vector<ReferenceCountedBlob<DeviceUsed>> blobs;
+
+            for (unsigned int i = 0; i < source->m_tensors[DeviceUsed].size(); ++i)
+            {
+                blobs.push_back(source->getTensorForDevice<DeviceUsed>(i)->blob());
+            }
+
+            m_deviceIds = source->m_deviceIds;
+
+            allocateTensor<DeviceUsed>(batchSize, &blobs, 0);
+        }
+
         template<DeviceType DeviceUsed = DeviceType::CPU_NAIVE>
         TensorBase<DeviceUsed> *getTensorForDevice(unsigned int deviceIndex)
         {
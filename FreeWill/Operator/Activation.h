@@ -2,6 +2,8 @@
 #define ACTIVATION_H
 
 #include "Operator.h"
+#include "Activation_CPU.h"
+#include "Dropout.h"
 #include "../DeviceSelection.h"
 #include <cmath>
 
@@ -12,16 +14,8 @@
 
 namespace FreeWill
 {
-    enum class ActivationMode : uint32_t
-    {
-        SIGMOID,
-        RELU,
-        TANH,
-        CLIPPED_RELU
-    };
-
     template<ActivationMode ActivationModeUsed = ActivationMode::SIGMOID, DeviceType DeviceUsed = DeviceType::CPU_NAIVE, typename DataType = float>
-    class Activation : public Operator<DeviceUsed>
+    class Activation : public Operator<DeviceUsed>, public DropoutState
     {
 
     private:
@@ -33,8 +27,13 @@ namespace FreeWill
         using Operator<DeviceUsed>::m_deviceId;
 
     public:
+        enum InputSlot : unsigned int {INPUT};
+        // MASK and SEED are those of a fused dropout, see fuseDropout
+        enum OutputSlot : unsigned int {OUTPUT, MASK, SEED};
+
         Activation(unsigned int deviceId = 0)
-            :Operator<DeviceUsed>({"Input"}, {"Output"}, deviceId),
+            :Operator<DeviceUsed>({"Input"}, {"Output", "Mask", "Seed"}, deviceId),
+            DropoutState(0.0f, 0),
             m_cudnnActivationDescriptor(0)
         {}
 
@@ -46,6 +45,11 @@ namespace FreeWill
 
             FAIL_IF (input("Input")->shape() != output("Output")->shape());
 
+            // elementwise, any layout as long as both sides agree
+            FAIL_IF (input("Input")->layout() != output("Output")->layout());
+
+            FAIL_IF (m_dropoutRate != 0.0f && !initDropout(output("Output"), output("Mask"), output("Seed")));
+
             if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
             {
                 if (!m_cudnnActivationDescriptor)
@@ -78,43 +82,32 @@ namespace FreeWill
         {
             CHECK_GPU;
 
-            Tensor<DeviceUsed, DataType> *_input = input("Input")->template toType<DataType>();
-            Tensor<DeviceUsed, DataType> *_output = output("Output")->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_input = input(INPUT)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_output = output(OUTPUT)->template toType<DataType>();
 
 
             if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
             {
-                unsigned int size = _input->shape().size();
-
-                if constexpr (ActivationModeUsed == ActivationMode::SIGMOID)
+                if (m_dropoutRate != 0.0f)
                 {
-                    for(unsigned int i = 0; i < size; ++i)
+                    // an item at a time, masked while it is in the cache
+                    dropoutForward(_input, _output, output(MASK), output(SEED), [](const DataType *from, DataType *to, size_t size)
                     {
-                        (*_output)[i] = 1 / (1 + exp(-(*_input)[i]));
-                    }
-                }
-                else if constexpr (ActivationModeUsed == ActivationMode::RELU)
-                {
-                    for(unsigned int i =0;i<size; ++i)
-                    {
-                        (*_output)[i] = (*_input)[i] > 0.0 ? (*_input)[i] : 0.0;
-                    }
-                }
-                else if constexpr (ActivationModeUsed == ActivationMode::TANH)
-                {
-                    (void) _input;
-                    (void) _output;
-                }
-                else if constexpr (ActivationModeUsed == ActivationMode::CLIPPED_RELU)
-                {
-                    (void) _input;
-                    (void) _output;
+                        activationForwardCPU<ActivationModeUsed>(from, to, size);
+                    });
+
+                    return;
                 }
+
+                // vectorized, Input and Output may be the same tensor
+                activationForwardCPU<ActivationModeUsed>(_input->cpuDataHandle(), _output->cpuDataHandle(),
+                                                         _input->shape().size());
             }
             else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
             {
-               DataType alpha = 1.0;
-               DataType beta = 0.0;
+               // cudnn scales 16-bit data with float factors
+               typename ComputeType<DataType>::Type alpha = 1.0;
+               typename ComputeType<DataType>::Type beta = 0.0;
 
                RUN_CUDNN(cudnnActivationForward(Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId),
                                                 m_cudnnActivationDescriptor,
@@ -124,6 +117,11 @@ namespace FreeWill
                                                 &beta,
                                                 _output->gpuTensorDescriptor(),
                                                 _output->gpuDataHandle())); 
+
+               if (m_dropoutRate != 0.0f)
+               {
+                   dropoutForward(_output, _output, output(MASK), output(SEED), [](const DataType *, DataType *, size_t) {});
+               }
             }
         }
 
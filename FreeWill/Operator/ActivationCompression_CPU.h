@@ -0,0 +1,62 @@
+#ifndef ACTIVATIONCOMPRESSION_CPU_H
+#define ACTIVATIONCOMPRESSION_CPU_H
+
+#include "Dropout_CPU.h"
+
+namespace FreeWill
+{
+    // The compressed form of an activation the backward pass reads, see CompressActivation.
+    // The sign mask has the layout of a dropout mask (dropoutMaskShape), bit k of word w of an
+    // item is set if element w * 32 + k is positive, so a ReLU derivative is the dropout
+    // backward pass at rate 0 through it. values, when not null, gets every element as Half.
+    template<typename DataType>
+    void compressActivationCPU(const DataType *input, uint32_t *mask, Half *values, unsigned int itemSize, unsigned int batchSize)
+    {
+        unsigned int wordCount = dropoutWordsPerItem(itemSize);
+
+        forEachDropoutItemCPU(itemSize, batchSize, [&](unsigned int begin, unsigned int end)
+        {
+            for (unsigned int b = begin; b < end; ++b)
+            {
+                size_t first = (size_t) b * itemSize;
+
+                for (unsigned int w = 0; w < wordCount; ++w)
+                {
+                    unsigned int offset = w * DROPOUT_BITS_PER_WORD;
+                    unsigned int count = std::min(DROPOUT_BITS_PER_WORD, itemSize - offset);
+                    const DataType *source = input + first + offset;
+                    uint32_t word = 0;
+
+                    for (unsigned int k = 0; k < count; ++k)
+                    {
+                        word |= (uint32_t) ((float) source[k] > 0.0f) << k;
+                    }
+
+                    mask[(size_t) b * wordCount + w] = word;
+                }
+
+                if (values)
+                {
+                    for (unsigned int i = 0; i < itemSize; ++i)
+                    {
+                        values[first + i] = Half((float) input[first + i]);
+                    }
+                }
+            }
+        });
+    }
+
+    template<typename DataType>
+    void decompressActivationCPU(const Half *values, DataType *output, unsigned int itemSize, unsigned int batchSize)
+    {
+        forEachDropoutItemCPU(itemSize, batchSize, [&](unsigned int begin, unsigned int end)
+        {
+            for (size_t i = (size_t) begin * itemSize; i < (size_t) end * itemSize; ++i)
+            {
+                output[i] = (DataType) (float) values[i];
+            }
+        });
+    }
+}
+
+#endif
@@ -0,0 +1,91 @@
+#include "ActivationCompression_CUDA.h"
+#include "DropoutMask.h"
+#include "../DeviceSelection.h"
+#include "../Context/ComputeStream.h"
+#include <cuda_runtime.h>
+
+// as dropoutForward: the threads past an item pad it to its last word, every warp is a word
+template <typename DataType>
+__global__ void compressActivation(const DataType *input, uint32_t *mask, FreeWill::Half *values,
+                                   unsigned int itemSize, unsigned int batchSize)
+{
+    unsigned int slotsPerItem = FreeWill::dropoutWordsPerItem(itemSize) * FreeWill::DROPOUT_BITS_PER_WORD;
+    unsigned int slot = blockIdx.x * blockDim.x + threadIdx.x;
+
+    if (slot >= slotsPerItem * batchSize)
+    {
+        return;
+    }
+
+    unsigned int b = slot / slotsPerItem;
+    unsigned int j = slot % slotsPerItem;
+    uint64_t element = (uint64_t) b * itemSize + j;
+
+    bool isPositive = false;
+
+    if (j < itemSize)
+    {
+        float value = (float) input[element];
+        isPositive = value > 0.0f;
+
+        if (values)
+        {
+            values[element] = FreeWill::Half(value);
+        }
+    }
+
+    uint32_t word = __ballot_sync(0xffffffff, isPositive);
+
+    if ((threadIdx.x & 31) == 0)
+    {
+        mask[slot / FreeWill::DROPOUT_BITS_PER_WORD] = word;
+    }
+}
+
+template <typename DataType>
+__global__ void decompressActivation(const FreeWill::Half *values, DataType *output, unsigned int size)
+{
+    for (unsigned int i = blockIdx.x * blockDim.x + threadIdx.x; i < size; i += blockDim.x * gridDim.x)
+    {
+        output[i] = (DataType) (float) values[i];
+    }
+}
+
+template <typename DataType>
+__host__ void compressActivationCUDAKernel(const DataType *input, uint32_t *mask, FreeWill::Half *values,
+                                           unsigned int itemSize, unsigned int batchSize)
+{
+    int blockSize = 256;
+    unsigned int slotCount = FreeWill::dropoutWordsPerItem(itemSize) * FreeWill::DROPOUT_BITS_PER_WORD * batchSize;
+    int gridSize = (slotCount + blockSize - 1) / blockSize;
+
+    if (gridSize == 0)
+    {
+        return;
+    }
+
+    compressActivation<DataType><<<gridSize, blockSize, 0, FreeWill::computeStream()>>>(input, mask, values, itemSize, batchSize);
+    CHECK_CUDA_ERROR
+}
+
+template <typename DataType>
+__host__ void decompressActivationCUDAKernel(const FreeWill::Half *values, DataType *output, unsigned int size)
+{
+    int blockSize = 256;
+    int gridSize = (size + blockSize - 1) / blockSize;
+
+    if (gridSize == 0)
+    {
+        return;
+    }
+
+    decompressActivation<DataType><<<gridSize, blockSize, 0, FreeWill::computeStream()>>>(values, output, size);
+    CHECK_CUDA_ERROR
+}
+
+template __host__ void compressActivationCUDAKernel(const float *input, uint32_t *mask, FreeWill::Half *values, unsigned int itemSize, unsigned int batchSize);
+template __host__ void compressActivationCUDAKernel(const double *input, uint32_t *mask, FreeWill::Half *values, unsigned int itemSize, unsigned int batchSize);
+template __host__ void compressActivationCUDAKernel(const FreeWill::Half *input, uint32_t *mask, FreeWill::Half *values, unsigned int itemSize, unsigned int batchSize);
+template __host__ void compressActivationCUDAKernel(const FreeWill::BFloat16 *input, uint32_t *mask, FreeWill::Half *values, unsigned int itemSize, unsigned int batchSize);
+template __host__ void decompressActivationCUDAKernel(const FreeWill::Half *values, float *output, unsigned int size);
+template __host__ void decompressActivationCUDAKernel(const FreeWill::Half *values, double *output, unsigned int size);
@@ -0,0 +1,20 @@
+#ifndef ACTIVATIONCOMPRESSION_CUDA_H
+#define ACTIVATIONCOMPRESSION_CUDA_H
+
+#include <cuda_runtime.h>
+#include <stdint.h>
+
+#include "../Tensor/HalfPrecision.h"
+
+// shared with the cuda kernels, keep it c++11
+
+// the sign mask and Half values of compressActivationCPU, one thread per element and one warp
+// per mask word; values may be null
+template <typename DataType = float>
+__host__ void compressActivationCUDAKernel(const DataType *input, uint32_t *mask, FreeWill::Half *values,
+                                           unsigned int itemSize, unsigned int batchSize);
+
+template <typename DataType = float>
+__host__ void decompressActivationCUDAKernel(const FreeWill::Half *values, DataType *output, unsigned int size);
+
+#endif
@@ -6,9 +6,13 @@
 #include <cudnn.h>
 #include "../Context/Context.h"
 #include "Activation.h"
+#include "Dropout_CPU.h"
+#include "Dropout_CUDA.h"
 
 namespace FreeWill
 {
+    // InputDelta = OutputDelta through the derivative of the activation at Output. A ReLU can
+    // read the sign mask of its output a CompressActivation kept, OutputMask, instead of Output.
     template <ActivationMode ActivationModeUsed = ActivationMode::SIGMOID, DeviceType DeviceUsed = DeviceType::CPU_NAIVE, typename DataType = float>
     class ActivationDerivative : public Operator<DeviceUsed>
     {
@@ -22,8 +26,11 @@ namespace FreeWill
         using Operator<DeviceUsed>::m_deviceId;
 
     public:        
+        enum InputSlot : unsigned int {INPUT, OUTPUT, OUTPUT_DELTA, OUTPUT_MASK};
+        enum OutputSlot : unsigned int {INPUT_DELTA};
+
         ActivationDerivative(unsigned int deviceId = 0)
-            :Operator<DeviceUsed>({"Input","Output","OutputDelta"},{"InputDelta"},deviceId),
+            :Operator<DeviceUsed>({"Input","Output","OutputDelta","OutputMask"},{"InputDelta"},deviceId),
             m_cudnnActivationDescriptor(0)
         {}
 
@@ -36,12 +43,23 @@ namespace FreeWill
         {
             CHECK_GPU;
 
-            FAIL_IF (!input("Output") || !output("InputDelta") || !input("OutputDelta"));
+            FAIL_IF (!output("InputDelta") || !input("OutputDelta"));
+
+            FAIL_IF (input("OutputDelta")->shape() != output("InputDelta")->shape());
+
+            if (input("OutputMask"))
+            {
+                FAIL_IF (ActivationModeUsed != ActivationMode::RELU);
+
+                FAIL_IF (input("OutputMask")->shape() != dropoutMaskShape(input("OutputDelta")->shape()));
+
+                return true;
+            }
+
+            FAIL_IF (!input("Output"));
 
             FAIL_IF (input("Output")->shape() != output("InputDelta")->shape());
 
-            FAIL_IF (input("OutputDelta")->shape() != input("Output")->shape());
-            
 
             if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
             {
@@ -80,45 +98,48 @@ namespace FreeWill
         virtual void evaluate() override
         {
             CHECK_GPU;
-            unsigned int size = input("Output")->shape().size();
 
-            Tensor<DeviceUsed, DataType> *_output = input("Output")->template toType<DataType>();
-            Tensor<DeviceUsed, DataType> *_inputDelta = output("InputDelta")->template toType<DataType>();
-            Tensor<DeviceUsed, DataType> *_outputDelta = input("OutputDelta")->template toType<DataType>();
-
-            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+            if (input(OUTPUT_MASK))
             {
-                if constexpr (ActivationModeUsed == ActivationMode::SIGMOID)
-                {
-                    for (unsigned int i =0; i<size; ++i)
-                    {
-                        (*_inputDelta)[i] = (*_output)[i] * (1.0 - (*_output)[i]) * (*_outputDelta)[i];
-                    }
-                }
-                else if constexpr (ActivationModeUsed == ActivationMode::RELU)
-                {
-                    for(unsigned int i =0;i<size; ++i)
-                    {
-                        (*_inputDelta)[i] = ((*_output)[i] > 0.0 ? 1.0 : 0.0) * (*_outputDelta)[i];
-                    }
-                }
-                else if constexpr (ActivationModeUsed == ActivationMode::TANH)
+                // the dropout backward pass at rate 0 passes the deltas of the set bits
+                Tensor<DeviceUsed, DataType> *outputDelta = input(OUTPUT_DELTA)->template toType<DataType>();
+                Tensor<DeviceUsed, DataType> *inputDelta = output(INPUT_DELTA)->template toType<DataType>();
+                Tensor<DeviceUsed, unsigned int> *mask = input(OUTPUT_MASK)->template toType<unsigned int>();
+
+                unsigned int itemSize = 0;
+                unsigned int batchSize = 0;
+                dropoutItems(inputDelta->shape(), itemSize, batchSize);
+
+                if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
                 {
-                    (void) _output;
-                    (void) _inputDelta;
-                    (void) _outputDelta;
+                    dropoutBackwardCPU(outputDelta->cpuDataHandle(), inputDelta->cpuDataHandle(), mask->cpuDataHandle(),
+                                       itemSize, batchSize, 0, 0, 0, 0.0f);
                 }
-                else if constexpr (ActivationModeUsed == ActivationMode::CLIPPED_RELU)
+                else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
                 {
-                    (void) _output;
-                    (void) _inputDelta;
-                    (void) _outputDelta;
+                    dropoutBackwardCUDAKernel<DataType>(outputDelta->gpuDataHandle(), inputDelta->gpuDataHandle(), mask->gpuDataHandle(),
+                                                        nullptr, itemSize, batchSize, 0, 0, 0, 1.0f);
                 }
+
+                return;
+            }
+
+            unsigned int size = input(OUTPUT)->shape().size();
+
+            Tensor<DeviceUsed, DataType> *_output = input(OUTPUT)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_inputDelta = output(INPUT_DELTA)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_outputDelta = input(OUTPUT_DELTA)->template toType<DataType>();
+
+            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+            {
+                // vectorized, InputDelta may be OutputDelta
+                activationBackwardCPU<ActivationModeUsed>(_output->cpuDataHandle(), _outputDelta->cpuDataHandle(),
+                                                          _inputDelta->cpuDataHandle(), size);
             }
             else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
             {
-                DataType alpha = 1.0;
-                DataType beta = 0.0;
+                typename ComputeType<DataType>::Type alpha = 1.0;
+                typename ComputeType<DataType>::Type beta = 0.0;
                 RUN_CUDNN(cudnnActivationBackward(Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId),
                                                 m_cudnnActivationDescriptor,
                                                 &alpha,
@@ -0,0 +1,204 @@
+// No include guard: the body of ActivationKernelCPU, included inside namespace FreeWill by
+// Activation_CPU.h and once more inside the namespace of every wider instruction set (see
+// CPUKernels.h), with CPU_KERNEL_VECTOR_BYTES set to the vector width of the instruction set.
+
+    // Elementwise activations and their derivatives over whole vectors. exp is a Cephes style
+    // range reduction to [-ln2/2, ln2/2] followed by a polynomial (float, within 2 ulp) or a
+    // Pade approximant (double, within 1 ulp), tanh uses an odd polynomial (float) or rational
+    // (double) near zero and 1 - 2 / (exp(2|x|) + 1) beyond. The arguments of exp are clamped
+    // so sigmoid and tanh saturate instead of overflowing, NaN propagates.
+    //
+    // The tail of an array goes through the same vector code, zero padded, so every element is
+    // computed by the same instructions whatever its position or the thread count.
+    template<typename DataType>
+    class ActivationKernelCPU
+    {
+        static_assert(std::is_same<DataType, float>::value || std::is_same<DataType, double>::value,
+                      "the activation kernels are float or double, see activationForwardCPU");
+
+    public:
+        static const unsigned int VECTOR_BYTES = CPU_KERNEL_VECTOR_BYTES;
+        static const unsigned int LANES = VECTOR_BYTES / sizeof(DataType);
+
+        typedef typename std::conditional<sizeof(DataType) == 4, int32_t, int64_t>::type Integer;
+        typedef DataType Vector __attribute__((vector_size(VECTOR_BYTES)));
+        typedef DataType UnalignedVector __attribute__((vector_size(VECTOR_BYTES), aligned(sizeof(DataType))));
+        typedef Integer IntegerVector __attribute__((vector_size(VECTOR_BYTES)));
+
+    private:
+        static Vector broadcast(DataType value)
+        {
+            return Vector{} + value;
+        }
+
+        static Vector floor(Vector x)
+        {
+            Vector truncated = __builtin_convertvector(__builtin_convertvector(x, IntegerVector), Vector);
+            // the comparison is -1 in the lanes truncation rounded up
+            return truncated + __builtin_convertvector((IntegerVector) (truncated > x), Vector);
+        }
+
+        static Vector exp(Vector x)
+        {
+            const bool isFloat = sizeof(DataType) == 4;
+            const DataType high = isFloat ? 88.0 : 708.0;
+            const DataType low = -high;
+
+            x = x > high ? broadcast(high) : x;
+            x = x < low ? broadcast(low) : x;
+
+            Vector n = floor(x * (DataType) 1.44269504088896341 + (DataType) 0.5);
+            Vector y;
+
+            if constexpr (sizeof(DataType) == 4)
+            {
+                Vector r = x - n * 0.693359375f + n * 2.12194440e-4f;
+                Vector p = ((((1.9875691500e-4f * r + 1.3981999507e-3f) * r + 8.3334519073e-3f) * r
+                             + 4.1665795894e-2f) * r + 1.6666665459e-1f) * r + 5.0000001201e-1f;
+                y = p * r * r + r + 1.0f;
+            }
+            else
+            {
+                Vector r = x - n * 6.93145751953125e-1 - n * 1.42860682030941723212e-6;
+                Vector rr = r * r;
+                Vector p = ((1.26177193074810590878e-4 * rr + 3.02994407707441961300e-2) * rr
+                            + 9.99999999999999999910e-1) * r;
+                Vector q = ((3.00198505138664455042e-6 * rr + 2.52448340349684104192e-3) * rr
+                            + 2.27265548208155028766e-1) * rr + 2.00000000000000000009e0;
+                y = p / (q - p) * 2.0 + 1.0;
+            }
+
+            // 2^n straight into the exponent bits, n is within the normal range after the clamp
+            const Integer bias = isFloat ? 127 : 1023;
+            const unsigned int mantissaBits = isFloat ? 23 : 52;
+            IntegerVector exponent = (__builtin_convertvector(n, IntegerVector) + bias) << mantissaBits;
+
+            return y * (Vector) exponent;
+        }
+
+        static Vector tanh(Vector x)
+        {
+            Vector absolute = x < 0 ? -x : x;
+            Vector z = x * x;
+            Vector near;
+
+            if constexpr (sizeof(DataType) == 4)
+            {
+                near = ((((-5.70498872745e-3f * z + 2.06390887954e-2f) * z - 5.37397155531e-2f) * z
+                         + 1.33314422036e-1f) * z - 3.33332819422e-1f) * z * x + x;
+            }
+            else
+            {
+                Vector p = (-9.64399179425052238628e-1 * z - 9.92877231001918586564e1) * z
+                        - 1.61468768441708447952e3;
+                Vector q = ((z + 1.12811678491632931402e2) * z + 2.23548839060100448583e3) * z
+                        + 4.84406305325125486048e3;
+                near = p / q * z * x + x;
+            }
+
+            Vector far = 1 - 2 / (exp(absolute * 2) + 1);
+            far = x < 0 ? -far : far;
+
+            return absolute < (DataType) 0.625 ? near : far;
+        }
+
+    public:
+        template<ActivationMode ActivationModeUsed>
+        static Vector forward(Vector x)
+        {
+            if constexpr (ActivationModeUsed == ActivationMode::SIGMOID)
+            {
+                return 1 / (1 + exp(-x));
+            }
+            else if constexpr (ActivationModeUsed == ActivationMode::RELU)
+            {
+                return x > 0 ? x : Vector{};
+            }
+            else if constexpr (ActivationModeUsed == ActivationMode::TANH)
+            {
+                return tanh(x);
+            }
+            else
+            {
+                Vector clipped = x > 0 ? x : Vector{};
+                return clipped > (DataType) ACTIVATION_CLIP_CEILING ? broadcast(ACTIVATION_CLIP_CEILING) : clipped;
+            }
+        }
+
+        // the derivative from the forward output y, times the incoming delta
+        template<ActivationMode ActivationModeUsed>
+        static Vector backward(Vector y, Vector delta)
+        {
+            if constexpr (ActivationModeUsed == ActivationMode::SIGMOID)
+            {
+                return y * (1 - y) * delta;
+            }
+            else if constexpr (ActivationModeUsed == ActivationMode::RELU)
+            {
+                return y > 0 ? delta : Vector{};
+            }
+            else if constexpr (ActivationModeUsed == ActivationMode::TANH)
+            {
+                return (1 - y * y) * delta;
+            }
+            else
+            {
+                return (y > 0) & (y < (DataType) ACTIVATION_CLIP_CEILING) ? delta : Vector{};
+            }
+        }
+
+        // output may be input
+        template<ActivationMode ActivationModeUsed>
+        static void forward(const DataType *input, DataType *output, size_t size)
+        {
+            size_t i = 0;
+            for (; i + LANES <= size; i += LANES)
+            {
+                *(UnalignedVector *) (output + i) = forward<ActivationModeUsed>(*(const UnalignedVector *) (input + i));
+            }
+
+            if (i < size)
+            {
+                Vector x = {};
+                for (size_t l = 0; l < size - i; ++l)
+                {
+                    x[l] = input[i + l];
+                }
+
+                Vector y = forward<ActivationModeUsed>(x);
+                for (size_t l = 0; l < size - i; ++l)
+                {
+                    output[i + l] = y[l];
+                }
+            }
+        }
+
+        // inputDelta may be outputDelta
+        template<ActivationMode ActivationModeUsed>
+        static void backward(const DataType *output, const DataType *outputDelta, DataType *inputDelta, size_t size)
+        {
+            size_t i = 0;
+            for (; i + LANES <= size; i += LANES)
+            {
+                *(UnalignedVector *) (inputDelta + i) = backward<ActivationModeUsed>(*(const UnalignedVector *) (output + i),
+                                                                                       *(const UnalignedVector *) (outputDelta + i));
+            }
+
+            if (i < size)
+            {
+                Vector y = {};
+                Vector delta = {};
+                for (size_t l = 0; l < size - i; ++l)
+                {
+                    y[l] = output[i + l];
+                    delta[l] = outputDelta[i + l];
+                }
+
+                Vector result = backward<ActivationModeUsed>(y, delta);
+                for (size_t l = 0; l < size - i; ++l)
+                {
+                    inputDelta[i + l] = result[l];
+                }
+            }
+        }
+    };
@@ -0,0 +1,24 @@
+#ifndef ACTIVATIONMODE_H
+#define ACTIVATIONMODE_H
+
+#include <cstdint>
+
+namespace FreeWill
+{
+    enum class ActivationMode : uint32_t
+    {
+        SIGMOID,
+        RELU,
+        TANH,
+        CLIPPED_RELU
+    };
+
+    // the modes the cpu Activation operator computes, see Activation_CPU.h
+    static inline bool isActivationImplementedCPU(ActivationMode mode)
+    {
+        return mode == ActivationMode::SIGMOID || mode == ActivationMode::RELU ||
+                mode == ActivationMode::TANH || mode == ActivationMode::CLIPPED_RELU;
+    }
+}
+
+#endif
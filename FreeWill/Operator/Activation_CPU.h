@@ -0,0 +1,156 @@
+#ifndef ACTIVATION_CPU_H
+#define ACTIVATION_CPU_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "ActivationMode.h"
+#include "CPUKernels.h"
+#include "../Context/ThreadPool.h"
+#include "../Tensor/HalfPrecision.h"
+
+namespace FreeWill
+{
+    // the ceiling of CLIPPED_RELU, the coefficient the cuDNN descriptors are set up with
+    static const double ACTIVATION_CLIP_CEILING = 20.0;
+
+#define CPU_KERNEL_VECTOR_BYTES CPU_BASELINE_VECTOR_BYTES
+#include "ActivationKernel_CPU.h"
+#undef CPU_KERNEL_VECTOR_BYTES
+
+    // Runs function(begin, end) over [0, size) in chunks on the ThreadPool. Elementwise passes
+    // are memory bound, only arrays well beyond the L2 cache are worth the fork/join.
+    template<typename Function>
+    inline void forEachActivationChunkCPU(size_t size, const Function &function)
+    {
+        const size_t CHUNK = 16384;
+        ThreadPool &threadPool = ThreadPool::getSingleton();
+
+        if (threadPool.threadCount() == 0 || size < CHUNK * 4)
+        {
+            function(0, size);
+            return;
+        }
+
+        unsigned int chunkCount = (unsigned int) ((size + CHUNK - 1) / CHUNK);
+        threadPool.parallelFor(0, chunkCount, 1, [&](unsigned int begin, unsigned int end)
+        {
+            function(begin * CHUNK, std::min(size, end * CHUNK));
+        });
+    }
+
+    // Half and BFloat16 are widened to float a block at a time, so reduced precision activations
+    // round the float results
+    template<typename DataType, typename Function>
+    inline void widenActivationCPU(size_t size, const Function &function)
+    {
+        const size_t BLOCK = 256;
+        float buffers[3][BLOCK];
+
+        for (size_t begin = 0; begin < size; begin += BLOCK)
+        {
+            function(begin, std::min(BLOCK, size - begin), buffers);
+        }
+    }
+
+    template<ActivationMode ActivationModeUsed, typename DataType>
+    void activationForwardCPU(const DataType *input, DataType *output, size_t size)
+    {
+        if constexpr (std::is_same<DataType, float>::value || std::is_same<DataType, double>::value)
+        {
+            auto forward = cpuKernels<DataType>().m_activationForward[(unsigned int) ActivationModeUsed];
+
+            forEachActivationChunkCPU(size, [&](size_t begin, size_t end)
+            {
+                forward(input + begin, output + begin, end - begin);
+            });
+        }
+        else
+        {
+            auto forward = cpuKernels<float>().m_activationForward[(unsigned int) ActivationModeUsed];
+
+            widenActivationCPU<DataType>(size, [&](size_t begin, size_t count, float (*buffers)[256])
+            {
+                for (size_t i = 0; i < count; ++i)
+                {
+                    buffers[0][i] = input[begin + i];
+                }
+
+                forward(buffers[0], buffers[0], count);
+
+                for (size_t i = 0; i < count; ++i)
+                {
+                    output[begin + i] = buffers[0][i];
+                }
+            });
+        }
+    }
+
+    template<ActivationMode ActivationModeUsed, typename DataType>
+    void activationBackwardCPU(const DataType *output, const DataType *outputDelta, DataType *inputDelta, size_t size)
+    {
+        if constexpr (std::is_same<DataType, float>::value || std::is_same<DataType, double>::value)
+        {
+            auto backward = cpuKernels<DataType>().m_activationBackward[(unsigned int) ActivationModeUsed];
+
+            forEachActivationChunkCPU(size, [&](size_t begin, size_t end)
+            {
+                backward(output + begin, outputDelta + begin, inputDelta + begin, end - begin);
+            });
+        }
+        else
+        {
+            auto backward = cpuKernels<float>().m_activationBackward[(unsigned int) ActivationModeUsed];
+
+            widenActivationCPU<DataType>(size, [&](size_t begin, size_t count, float (*buffers)[256])
+            {
+                for (size_t i = 0; i < count; ++i)
+                {
+                    buffers[0][i] = output[begin + i];
+                    buffers[1][i] = outputDelta[begin + i];
+                }
+
+                backward(buffers[0], buffers[1], buffers[2], count);
+
+                for (size_t i = 0; i < count; ++i)
+                {
+                    inputDelta[begin + i] = buffers[2][i];
+                }
+            });
+        }
+    }
+
+    // the same with the mode picked at run time, for fused epilogues
+    template<typename DataType>
+    void activationForwardCPU(ActivationMode mode, const DataType *input, DataType *output, size_t size)
+    {
+        switch (mode)
+        {
+        case ActivationMode::SIGMOID:
+            activationForwardCPU<ActivationMode::SIGMOID>(input, output, size);
+            break;
+        case ActivationMode::RELU:
+            activationForwardCPU<ActivationMode::RELU>(input, output, size);
+            break;
+        case ActivationMode::TANH:
+            activationForwardCPU<ActivationMode::TANH>(input, output, size);
+            break;
+        case ActivationMode::CLIPPED_RELU:
+            activationForwardCPU<ActivationMode::CLIPPED_RELU>(input, output, size);
+            break;
+        }
+    }
+
+    // same kernels as the cpu Activation operator, so fused and unfused results match
+    template<typename DataType>
+    inline DataType activationCPU(ActivationMode mode, DataType value)
+    {
+        DataType result = value;
+        activationForwardCPU<DataType>(mode, &value, &result, 1);
+        return result;
+    }
+}
+
+#endif
@@ -0,0 +1,211 @@
+#ifndef BATCHNORMALIZATION_H
+#define BATCHNORMALIZATION_H
+
+#include "Operator.h"
+#include "BatchNormalization_CPU.h"
+#include "../Context/Context.h"
+
+namespace FreeWill
+{
+    // The descriptors of a batch normalization of shape for cuDNN: the data as an NHWC tensor
+    // of the channels, all the pixels of an image as its height and the batch, so the spatial
+    // mode normalizes every channel over the pixels and the batch; the parameters {1, C, 1, 1}.
+    static inline void setBatchNormalizationDescriptors(const Shape &shape, cudnnDataType_t dataType,
+                                                        cudnnTensorDescriptor_t dataDescriptor, cudnnTensorDescriptor_t parameterDescriptor)
+    {
+        unsigned int channelCount = shape[0];
+        unsigned int batchSize = shape[shape.dimension() - 1];
+        unsigned int pixelCount = shape.size() / channelCount / batchSize;
+
+        RUN_CUDNN(cudnnSetTensor4dDescriptor(dataDescriptor, CUDNN_TENSOR_NHWC, dataType, batchSize, channelCount, pixelCount, 1));
+        RUN_CUDNN(cudnnDeriveBNTensorDescriptor(parameterDescriptor, dataDescriptor, CUDNN_BATCHNORM_SPATIAL));
+    }
+
+    // Normalizes every channel of Input {channels, ..., batch} to zero mean and unit variance,
+    // then scales and shifts it by Scale and Shift ({channels}). Mean and Variance are the
+    // running statistics: a training pass normalizes with the statistics of its batch and moves
+    // them towards those by momentum, an inference pass normalizes with them. A training pass
+    // also writes the batch mean and 1 / sqrt(variance + epsilon) to SavedMean and
+    // SavedInverseDeviation for the derivative.
+    //
+    // The cpu reduces the statistics in one pass over Input (see batchNormalizationStatisticsCPU)
+    // and normalizes in a second; the gpu runs cudnnBatchNormalizationForwardTraining and
+    // cudnnBatchNormalizationForwardInference. An inference normalization of what a cpu
+    // convolution wrote is folded into that convolution instead (see Model::fuseOperators).
+    template<DeviceType DeviceUsed = DeviceType::CPU_NAIVE, typename DataType = float>
+    class BatchNormalization : public Operator<DeviceUsed>
+    {
+    protected:
+        using Operator<DeviceUsed>::input;
+        using Operator<DeviceUsed>::output;
+        using Operator<DeviceUsed>::m_deviceId;
+
+        float m_epsilon;
+        float m_momentum;
+        bool m_isTraining;
+
+        cudnnTensorDescriptor_t m_dataGPUTensorDescriptor;
+        cudnnTensorDescriptor_t m_parameterGPUTensorDescriptor;
+        unsigned int m_gpuBatchSize;
+
+    public:
+        enum InputSlot : unsigned int {INPUT, SCALE, SHIFT};
+        enum OutputSlot : unsigned int {OUTPUT, MEAN, VARIANCE, SAVED_MEAN, SAVED_INVERSE_DEVIATION};
+
+        BatchNormalization(float epsilon = 1e-5f, float momentum = 0.1f, bool isTraining = true, unsigned int deviceId = 0)
+            :Operator<DeviceUsed>({"Input", "Scale", "Shift"}, {"Output", "Mean", "Variance", "SavedMean", "SavedInverseDeviation"}, deviceId),
+            m_epsilon(epsilon),
+            m_momentum(momentum),
+            m_isTraining(isTraining),
+            m_dataGPUTensorDescriptor(0),
+            m_parameterGPUTensorDescriptor(0),
+            m_gpuBatchSize(0)
+        {
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                RUN_CUDNN(cudnnCreateTensorDescriptor(&m_dataGPUTensorDescriptor));
+                RUN_CUDNN(cudnnCreateTensorDescriptor(&m_parameterGPUTensorDescriptor));
+            }
+        }
+
+        virtual ~BatchNormalization() override
+        {
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                RUN_CUDNN(cudnnDestroyTensorDescriptor(m_dataGPUTensorDescriptor));
+                RUN_CUDNN(cudnnDestroyTensorDescriptor(m_parameterGPUTensorDescriptor));
+
+                m_dataGPUTensorDescriptor = 0;
+                m_parameterGPUTensorDescriptor = 0;
+            }
+        }
+
+        virtual bool init() override
+        {
+            CHECK_GPU;
+
+            FAIL_IF (!input("Input") || !input("Scale") || !input("Shift") || !output("Output"));
+
+            FAIL_IF (!output("Mean") || !output("Variance"));
+
+            FAIL_IF (m_isTraining && (!output("SavedMean") || !output("SavedInverseDeviation")));
+
+            FAIL_IF (input("Input")->shape().dimension() < 2 || input("Input")->shape() != output("Output")->shape());
+
+            FAIL_IF (input("Input")->layout() != TensorLayout::CHANNEL_LAST || output("Output")->layout() != TensorLayout::CHANNEL_LAST);
+
+            FAIL_IF (m_epsilon <= 0.0f || m_momentum < 0.0f || m_momentum > 1.0f);
+
+            const Shape parameterShape({input("Input")->shape()[0]});
+
+            FAIL_IF (input("Scale")->shape() != parameterShape || input("Shift")->shape() != parameterShape);
+
+            FAIL_IF (output("Mean")->shape() != parameterShape || output("Variance")->shape() != parameterShape);
+
+            FAIL_IF (output("SavedMean") && output("SavedMean")->shape() != parameterShape);
+
+            FAIL_IF (output("SavedInverseDeviation") && output("SavedInverseDeviation")->shape() != parameterShape);
+
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                FAIL_IF (m_epsilon < CUDNN_BN_MIN_EPSILON);
+
+                setBatchNormalizationDescriptors(input("Input")->shape(), std::is_same<DataType, double>::value ? CUDNN_DATA_DOUBLE : CUDNN_DATA_FLOAT,
+                                                 m_dataGPUTensorDescriptor, m_parameterGPUTensorDescriptor);
+                m_gpuBatchSize = input("Input")->shape()[input("Input")->shape().dimension() - 1];
+            }
+
+            return true;
+        }
+
+        virtual void evaluate() override
+        {
+            CHECK_GPU;
+
+            Tensor<DeviceUsed, DataType> *_input = input(INPUT)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_scale = input(SCALE)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_shift = input(SHIFT)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_output = output(OUTPUT)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_mean = output(MEAN)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_variance = output(VARIANCE)->template toType<DataType>();
+
+            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+            {
+                unsigned int channelCount = 0;
+                size_t itemCount = 0;
+                batchNormalizationItems(_input->shape(), channelCount, itemCount);
+
+                if (m_isTraining)
+                {
+                    batchNormalizationForwardTrainingCPU<DataType>(_input->cpuDataHandle(), _output->cpuDataHandle(),
+                                                                   _scale->cpuDataHandle(), _shift->cpuDataHandle(),
+                                                                   _mean->cpuDataHandle(), _variance->cpuDataHandle(),
+                                                                   output(SAVED_MEAN)->template toType<DataType>()->cpuDataHandle(),
+                                                                   output(SAVED_INVERSE_DEVIATION)->template toType<DataType>()->cpuDataHandle(),
+                                                                   channelCount, itemCount, m_epsilon, m_momentum);
+                }
+                else
+                {
+                    batchNormalizationForwardInferenceCPU<DataType>(_input->cpuDataHandle(), _output->cpuDataHandle(),
+                                                                    _scale->cpuDataHandle(), _shift->cpuDataHandle(),
+                                                                    _mean->cpuDataHandle(), _variance->cpuDataHandle(),
+                                                                    channelCount, itemCount, m_epsilon);
+                }
+            }
+            else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                unsigned int batchSize = _input->shape()[_input->shape().dimension() - 1];
+
+                if (batchSize != m_gpuBatchSize)
+                {
+                    setBatchNormalizationDescriptors(_input->shape(), std::is_same<DataType, double>::value ? CUDNN_DATA_DOUBLE : CUDNN_DATA_FLOAT,
+                                                     m_dataGPUTensorDescriptor, m_parameterGPUTensorDescriptor);
+                    m_gpuBatchSize = batchSize;
+                }
+
+                DataType alpha = 1.0;
+                DataType beta = 0.0;
+
+                if (m_isTraining)
+                {
+                    RUN_CUDNN(cudnnBatchNormalizationForwardTraining(Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId),
+                                                                     CUDNN_BATCHNORM_SPATIAL,
+                                                                     &alpha,
+                                                                     &beta,
+                                                                     m_dataGPUTensorDescriptor,
+                                                                     _input->gpuDataHandle(),
+                                                                     m_dataGPUTensorDescriptor,
+                                                                     _output->gpuDataHandle(),
+                                                                     m_parameterGPUTensorDescriptor,
+                                                                     _scale->gpuDataHandle(),
+                                                                     _shift->gpuDataHandle(),
+                                                                     (double) m_momentum,
+                                                                     _mean->gpuDataHandle(),
+                                                                     _variance->gpuDataHandle(),
+                                                                     (double) m_epsilon,
+                                                                     output(SAVED_MEAN)->template toType<DataType>()->gpuDataHandle(),
+                                                                     output(SAVED_INVERSE_DEVIATION)->template toType<DataType>()->gpuDataHandle()));
+                }
+                else
+                {
+                    RUN_CUDNN(cudnnBatchNormalizationForwardInference(Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId),
+                                                                      CUDNN_BATCHNORM_SPATIAL,
+                                                                      &alpha,
+                                                                      &beta,
+                                                                      m_dataGPUTensorDescriptor,
+                                                                      _input->gpuDataHandle(),
+                                                                      m_dataGPUTensorDescriptor,
+                                                                      _output->gpuDataHandle(),
+                                                                      m_parameterGPUTensorDescriptor,
+                                                                      _scale->gpuDataHandle(),
+                                                                      _shift->gpuDataHandle(),
+                                                                      _mean->gpuDataHandle(),
+                                                                      _variance->gpuDataHandle(),
+                                                                      (double) m_epsilon));
+                }
+            }
+        }
+    };
+}
+
+#endif
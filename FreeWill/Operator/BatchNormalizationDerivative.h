@@ -0,0 +1,162 @@
+#ifndef BATCHNORMALIZATIONDERIVATIVE_H
+#define BATCHNORMALIZATIONDERIVATIVE_H
+
+#include "BatchNormalization.h"
+
+namespace FreeWill
+{
+    // The gradients of a training batch normalization from OutputDelta: ScaleGrad and ShiftGrad
+    // ({channels}) and InputDelta, from the SavedMean and SavedInverseDeviation of its forward
+    // pass. The cpu reduces the scale and shift gradients in one pass and writes InputDelta in a
+    // second; the gpu runs cudnnBatchNormalizationBackward.
+    template<DeviceType DeviceUsed = DeviceType::CPU_NAIVE, typename DataType = float>
+    class BatchNormalizationDerivative : public Operator<DeviceUsed>
+    {
+    protected:
+        using Operator<DeviceUsed>::input;
+        using Operator<DeviceUsed>::output;
+        using Operator<DeviceUsed>::m_deviceId;
+
+        float m_epsilon;
+
+        // on gpu, add to the scale and shift gradients instead of overwriting them, the cpu always adds
+        bool m_isAccumulating;
+
+        cudnnTensorDescriptor_t m_dataGPUTensorDescriptor;
+        cudnnTensorDescriptor_t m_parameterGPUTensorDescriptor;
+        unsigned int m_gpuBatchSize;
+
+    public:
+        enum InputSlot : unsigned int {INPUT, SCALE, SAVED_MEAN, SAVED_INVERSE_DEVIATION, OUTPUT_DELTA};
+        enum OutputSlot : unsigned int {SCALE_GRAD, SHIFT_GRAD, INPUT_DELTA};
+
+        BatchNormalizationDerivative(float epsilon = 1e-5f, unsigned int deviceId = 0)
+            :Operator<DeviceUsed>({"Input", "Scale", "SavedMean", "SavedInverseDeviation", "OutputDelta"}, {"ScaleGrad", "ShiftGrad", "InputDelta"}, deviceId),
+            m_epsilon(epsilon),
+            m_isAccumulating(false),
+            m_dataGPUTensorDescriptor(0),
+            m_parameterGPUTensorDescriptor(0),
+            m_gpuBatchSize(0)
+        {
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                RUN_CUDNN(cudnnCreateTensorDescriptor(&m_dataGPUTensorDescriptor));
+                RUN_CUDNN(cudnnCreateTensorDescriptor(&m_parameterGPUTensorDescriptor));
+            }
+        }
+
+        virtual ~BatchNormalizationDerivative() override
+        {
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                RUN_CUDNN(cudnnDestroyTensorDescriptor(m_dataGPUTensorDescriptor));
+                RUN_CUDNN(cudnnDestroyTensorDescriptor(m_parameterGPUTensorDescriptor));
+
+                m_dataGPUTensorDescriptor = 0;
+                m_parameterGPUTensorDescriptor = 0;
+            }
+        }
+
+        void setAccumulating(bool isAccumulating)
+        {
+            m_isAccumulating = isAccumulating;
+        }
+
+        virtual bool init() override
+        {
+            CHECK_GPU;
+
+            FAIL_IF (!input("Input") || !input("Scale") || !input("SavedMean") || !input("SavedInverseDeviation") || !input("OutputDelta"));
+
+            FAIL_IF (!output("ScaleGrad") || !output("ShiftGrad") || !output("InputDelta"));
+
+            FAIL_IF (input("Input")->shape().dimension() < 2);
+
+            FAIL_IF (input("OutputDelta")->shape() != input("Input")->shape() || output("InputDelta")->shape() != input("Input")->shape());
+
+            FAIL_IF (input("Input")->layout() != TensorLayout::CHANNEL_LAST || input("OutputDelta")->layout() != TensorLayout::CHANNEL_LAST ||
+                     output("InputDelta")->layout() != TensorLayout::CHANNEL_LAST);
+
+            const Shape parameterShape({input("Input")->shape()[0]});
+
+            FAIL_IF (input("Scale")->shape() != parameterShape || input("SavedMean")->shape() != parameterShape ||
+                     input("SavedInverseDeviation")->shape() != parameterShape);
+
+            FAIL_IF (output("ScaleGrad")->shape() != parameterShape || output("ShiftGrad")->shape() != parameterShape);
+
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                FAIL_IF (m_epsilon < CUDNN_BN_MIN_EPSILON);
+
+                setBatchNormalizationDescriptors(input("Input")->shape(), std::is_same<DataType, double>::value ? CUDNN_DATA_DOUBLE : CUDNN_DATA_FLOAT,
+                                                 m_dataGPUTensorDescriptor, m_parameterGPUTensorDescriptor);
+                m_gpuBatchSize = input("Input")->shape()[input("Input")->shape().dimension() - 1];
+            }
+
+            return true;
+        }
+
+        virtual void evaluate() override
+        {
+            CHECK_GPU;
+
+            Tensor<DeviceUsed, DataType> *_input = input(INPUT)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_scale = input(SCALE)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_savedMean = input(SAVED_MEAN)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_savedInverseDeviation = input(SAVED_INVERSE_DEVIATION)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_outputDelta = input(OUTPUT_DELTA)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_scaleGrad = output(SCALE_GRAD)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_shiftGrad = output(SHIFT_GRAD)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_inputDelta = output(INPUT_DELTA)->template toType<DataType>();
+
+            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+            {
+                unsigned int channelCount = 0;
+                size_t itemCount = 0;
+                batchNormalizationItems(_input->shape(), channelCount, itemCount);
+
+                batchNormalizationBackwardCPU<DataType>(_input->cpuDataHandle(), _outputDelta->cpuDataHandle(), _scale->cpuDataHandle(),
+                                                        _savedMean->cpuDataHandle(), _savedInverseDeviation->cpuDataHandle(),
+                                                        _scaleGrad->cpuDataHandle(), _shiftGrad->cpuDataHandle(), _inputDelta->cpuDataHandle(),
+                                                        channelCount, itemCount);
+            }
+            else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                unsigned int batchSize = _input->shape()[_input->shape().dimension() - 1];
+
+                if (batchSize != m_gpuBatchSize)
+                {
+                    setBatchNormalizationDescriptors(_input->shape(), std::is_same<DataType, double>::value ? CUDNN_DATA_DOUBLE : CUDNN_DATA_FLOAT,
+                                                     m_dataGPUTensorDescriptor, m_parameterGPUTensorDescriptor);
+                    m_gpuBatchSize = batchSize;
+                }
+
+                DataType alpha = 1.0;
+                DataType beta = 0.0;
+                DataType parameterBeta = m_isAccumulating ? 1.0 : 0.0;
+
+                RUN_CUDNN(cudnnBatchNormalizationBackward(Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId),
+                                                          CUDNN_BATCHNORM_SPATIAL,
+                                                          &alpha,
+                                                          &beta,
+                                                          &alpha,
+                                                          &parameterBeta,
+                                                          m_dataGPUTensorDescriptor,
+                                                          _input->gpuDataHandle(),
+                                                          m_dataGPUTensorDescriptor,
+                                                          _outputDelta->gpuDataHandle(),
+                                                          m_dataGPUTensorDescriptor,
+                                                          _inputDelta->gpuDataHandle(),
+                                                          m_parameterGPUTensorDescriptor,
+                                                          _scale->gpuDataHandle(),
+                                                          _scaleGrad->gpuDataHandle(),
+                                                          _shiftGrad->gpuDataHandle(),
+                                                          (double) m_epsilon,
+                                                          _savedMean->gpuDataHandle(),
+                                                          _savedInverseDeviation->gpuDataHandle()));
+            }
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,280 @@
+#ifndef BATCHNORMALIZATION_CPU_H
+#define BATCHNORMALIZATION_CPU_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "../Tensor/Shape.h"
+#include "../Context/ThreadPool.h"
+
+namespace FreeWill
+{
+    // A batch normalization normalizes every channel of a {channels, ..., batch} tensor over its
+    // items: the pixels of all the images of the batch, channelCount values each, channel fastest.
+    inline void batchNormalizationItems(const Shape &shape, unsigned int &channelCount, size_t &itemCount)
+    {
+        channelCount = shape[0];
+        itemCount = channelCount ? shape.size() / channelCount : 0;
+    }
+
+    // the items of a run, about CHUNK elements
+    inline size_t batchNormalizationRunLength(unsigned int channelCount)
+    {
+        const size_t CHUNK = 16384;
+        return std::max((size_t) 1, CHUNK / std::max(channelCount, 1u));
+    }
+
+    // Calls function(run, first, last) for fixed runs of items, on the ThreadPool once there are
+    // a few. The runs don't depend on the thread count, so neither do the statistics merged
+    // from them.
+    template<typename Function>
+    inline unsigned int forEachBatchNormalizationRunCPU(unsigned int channelCount, size_t itemCount, const Function &function)
+    {
+        size_t runLength = batchNormalizationRunLength(channelCount);
+        unsigned int runCount = (unsigned int) ((itemCount + runLength - 1) / runLength);
+
+        auto runRange = [&](unsigned int begin, unsigned int end)
+        {
+            for (unsigned int r = begin; r < end; ++r)
+            {
+                function(r, (size_t) r * runLength, std::min(itemCount, (size_t) (r + 1) * runLength));
+            }
+        };
+
+        ThreadPool &threadPool = ThreadPool::getSingleton();
+
+        if (threadPool.threadCount() == 0 || runCount < 4)
+        {
+            runRange(0, runCount);
+        }
+        else
+        {
+            threadPool.parallelFor(0, runCount, 1, runRange);
+        }
+
+        return runCount;
+    }
+
+    // The mean and the (biased) variance of every channel in one pass over the input: each run
+    // keeps Welford's running mean and sum of squared deviations, the runs are then merged in
+    // order with Chan's pairwise update.
+    template<typename DataType>
+    void batchNormalizationStatisticsCPU(const DataType *input, unsigned int channelCount, size_t itemCount,
+                                         DataType *mean, DataType *variance)
+    {
+        size_t runLength = batchNormalizationRunLength(channelCount);
+        size_t maxRunCount = (itemCount + runLength - 1) / runLength;
+
+        std::vector<DataType> runMean(maxRunCount * channelCount, (DataType) 0);
+        std::vector<DataType> runSquares(maxRunCount * channelCount, (DataType) 0);
+
+        unsigned int runCount = forEachBatchNormalizationRunCPU(channelCount, itemCount, [&](unsigned int r, size_t first, size_t last)
+        {
+            DataType *m = runMean.data() + (size_t) r * channelCount;
+            DataType *s = runSquares.data() + (size_t) r * channelCount;
+
+            for (size_t i = first; i < last; ++i)
+            {
+                const DataType *item = input + i * channelCount;
+                DataType inverseCount = (DataType) 1 / (DataType) (i - first + 1);
+
+                for (unsigned int c = 0; c < channelCount; ++c)
+                {
+                    DataType delta = item[c] - m[c];
+                    m[c] += delta * inverseCount;
+                    s[c] += delta * (item[c] - m[c]);
+                }
+            }
+        });
+
+        for (unsigned int c = 0; c < channelCount; ++c)
+        {
+            DataType mergedMean = 0;
+            DataType mergedSquares = 0;
+            size_t mergedCount = 0;
+
+            for (unsigned int r = 0; r < runCount; ++r)
+            {
+                size_t count = std::min(itemCount - (size_t) r * runLength, runLength);
+                size_t total = mergedCount + count;
+                DataType delta = runMean[(size_t) r * channelCount + c] - mergedMean;
+
+                mergedMean += delta * (DataType) count / (DataType) total;
+                mergedSquares += runSquares[(size_t) r * channelCount + c] + delta * delta * (DataType) mergedCount * (DataType) count / (DataType) total;
+                mergedCount = total;
+            }
+
+            mean[c] = mergedMean;
+            variance[c] = itemCount ? mergedSquares / (DataType) itemCount : (DataType) 0;
+        }
+    }
+
+    // output = input * multiplier + addend per channel, the normalization, scale and shift in one
+    template<typename DataType>
+    void batchNormalizationApplyCPU(const DataType *input, DataType *output, const DataType *multiplier, const DataType *addend,
+                                    unsigned int channelCount, size_t itemCount)
+    {
+        forEachBatchNormalizationRunCPU(channelCount, itemCount, [&](unsigned int, size_t first, size_t last)
+        {
+            for (size_t i = first; i < last; ++i)
+            {
+                const DataType *item = input + i * channelCount;
+                DataType *result = output + i * channelCount;
+
+                for (unsigned int c = 0; c < channelCount; ++c)
+                {
+                    result[c] = item[c] * multiplier[c] + addend[c];
+                }
+            }
+        });
+    }
+
+    // Normalizes with the statistics of the batch and moves the running ones towards them by
+    // momentum, with the unbiased variance as cuDNN does. savedMean and savedInverseDeviation,
+    // 1 / sqrt(variance + epsilon), are what the derivative reads.
+    template<typename DataType>
+    void batchNormalizationForwardTrainingCPU(const DataType *input, DataType *output, const DataType *scale, const DataType *shift,
+                                              DataType *runningMean, DataType *runningVariance,
+                                              DataType *savedMean, DataType *savedInverseDeviation,
+                                              unsigned int channelCount, size_t itemCount, float epsilon, float momentum)
+    {
+        std::vector<DataType> variance(channelCount);
+        std::vector<DataType> multiplier(channelCount);
+        std::vector<DataType> addend(channelCount);
+
+        batchNormalizationStatisticsCPU<DataType>(input, channelCount, itemCount, savedMean, variance.data());
+
+        DataType unbiased = itemCount > 1 ? (DataType) itemCount / (DataType) (itemCount - 1) : (DataType) 1;
+
+        for (unsigned int c = 0; c < channelCount; ++c)
+        {
+            savedInverseDeviation[c] = (DataType) 1 / std::sqrt(variance[c] + (DataType) epsilon);
+            multiplier[c] = scale[c] * savedInverseDeviation[c];
+            addend[c] = shift[c] - savedMean[c] * multiplier[c];
+
+            runningMean[c] = ((DataType) 1 - (DataType) momentum) * runningMean[c] + (DataType) momentum * savedMean[c];
+            runningVariance[c] = ((DataType) 1 - (DataType) momentum) * runningVariance[c] + (DataType) momentum * variance[c] * unbiased;
+        }
+
+        batchNormalizationApplyCPU<DataType>(input, output, multiplier.data(), addend.data(), channelCount, itemCount);
+    }
+
+    // the normalization with the running statistics, one multiply-add per element
+    template<typename DataType>
+    void batchNormalizationForwardInferenceCPU(const DataType *input, DataType *output, const DataType *scale, const DataType *shift,
+                                               const DataType *runningMean, const DataType *runningVariance,
+                                               unsigned int channelCount, size_t itemCount, float epsilon)
+    {
+        std::vector<DataType> multiplier(channelCount);
+        std::vector<DataType> addend(channelCount);
+
+        for (unsigned int c = 0; c < channelCount; ++c)
+        {
+            multiplier[c] = scale[c] / std::sqrt(runningVariance[c] + (DataType) epsilon);
+            addend[c] = shift[c] - runningMean[c] * multiplier[c];
+        }
+
+        batchNormalizationApplyCPU<DataType>(input, output, multiplier.data(), addend.data(), channelCount, itemCount);
+    }
+
+    // One pass reduces the shift and scale gradients, a second one writes
+    // inputDelta = scale * inverseDeviation * (outputDelta - (shiftGrad + normalized * scaleGrad) / items).
+    // The gradients are added to.
+    template<typename DataType>
+    void batchNormalizationBackwardCPU(const DataType *input, const DataType *outputDelta, const DataType *scale,
+                                       const DataType *savedMean, const DataType *savedInverseDeviation,
+                                       DataType *scaleGrad, DataType *shiftGrad, DataType *inputDelta,
+                                       unsigned int channelCount, size_t itemCount)
+    {
+        size_t runLength = batchNormalizationRunLength(channelCount);
+        size_t maxRunCount = (itemCount + runLength - 1) / runLength;
+
+        std::vector<DataType> runShiftGrad(maxRunCount * channelCount, (DataType) 0);
+        std::vector<DataType> runScaleGrad(maxRunCount * channelCount, (DataType) 0);
+
+        unsigned int runCount = forEachBatchNormalizationRunCPU(channelCount, itemCount, [&](unsigned int r, size_t first, size_t last)
+        {
+            DataType *shiftSum = runShiftGrad.data() + (size_t) r * channelCount;
+            DataType *scaleSum = runScaleGrad.data() + (size_t) r * channelCount;
+
+            for (size_t i = first; i < last; ++i)
+            {
+                const DataType *item = input + i * channelCount;
+                const DataType *delta = outputDelta + i * channelCount;
+
+                for (unsigned int c = 0; c < channelCount; ++c)
+                {
+                    shiftSum[c] += delta[c];
+                    scaleSum[c] += delta[c] * (item[c] - savedMean[c]) * savedInverseDeviation[c];
+                }
+            }
+        });
+
+        std::vector<DataType> batchShiftGrad(channelCount, (DataType) 0);
+        std::vector<DataType> batchScaleGrad(channelCount, (DataType) 0);
+
+        for (unsigned int r = 0; r < runCount; ++r)
+        {
+            for (unsigned int c = 0; c < channelCount; ++c)
+            {
+                batchShiftGrad[c] += runShiftGrad[(size_t) r * channelCount + c];
+                batchScaleGrad[c] += runScaleGrad[(size_t) r * channelCount + c];
+            }
+        }
+
+        DataType inverseItemCount = itemCount ? (DataType) 1 / (DataType) itemCount : (DataType) 0;
+
+        for (unsigned int c = 0; c < channelCount; ++c)
+        {
+            shiftGrad[c] += batchShiftGrad[c];
+            scaleGrad[c] += batchScaleGrad[c];
+            batchShiftGrad[c] *= inverseItemCount;
+            batchScaleGrad[c] *= inverseItemCount;
+        }
+
+        forEachBatchNormalizationRunCPU(channelCount, itemCount, [&](unsigned int, size_t first, size_t last)
+        {
+            for (size_t i = first; i < last; ++i)
+            {
+                const DataType *item = input + i * channelCount;
+                const DataType *delta = outputDelta + i * channelCount;
+                DataType *result = inputDelta + i * channelCount;
+
+                for (unsigned int c = 0; c < channelCount; ++c)
+                {
+                    DataType normalized = (item[c] - savedMean[c]) * savedInverseDeviation[c];
+                    result[c] = scale[c] * savedInverseDeviation[c] * (delta[c] - batchShiftGrad[c] - normalized * batchScaleGrad[c]);
+                }
+            }
+        });
+    }
+
+    // Folds an inference normalization of a convolution's output into the convolution: filter f,
+    // filterSize contiguous values, is scaled by scale / sqrt(variance + epsilon) and its bias
+    // becomes (bias - mean) times that plus shift. Cheap next to the convolution, so it runs on
+    // every pass and follows the weights when they change.
+    template<typename DataType>
+    void foldBatchNormalizationCPU(const DataType *featureMap, const DataType *bias,
+                                   const DataType *scale, const DataType *shift, const DataType *mean, const DataType *variance,
+                                   float epsilon, unsigned int filterCount, size_t filterSize,
+                                   DataType *foldedFeatureMap, DataType *foldedBias)
+    {
+        for (unsigned int f = 0; f < filterCount; ++f)
+        {
+            DataType multiplier = scale[f] / std::sqrt(variance[f] + (DataType) epsilon);
+            const DataType *filter = featureMap + (size_t) f * filterSize;
+            DataType *foldedFilter = foldedFeatureMap + (size_t) f * filterSize;
+
+            for (size_t e = 0; e < filterSize; ++e)
+            {
+                foldedFilter[e] = filter[e] * multiplier;
+            }
+
+            foldedBias[f] = (bias[f] - mean[f]) * multiplier + shift[f];
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,71 @@
+#include "BiasGradient_CUDA.h"
+#include "../DeviceSelection.h"
+#include "../Context/ComputeStream.h"
+#include "../Tensor/HalfPrecision.h"
+#include <cuda_runtime.h>
+#include <type_traits>
+
+static const unsigned int BIAS_GRADIENT_TILE = 32;
+static const unsigned int BIAS_GRADIENT_ROWS = 16;
+
+// block x sums rows [x * TILE, (x + 1) * TILE), its ROWS threads of a row stride over the
+// samples and meet in shared memory
+template <typename DataType, typename AccumulateType>
+__global__ void biasGradient(const DataType *outputDelta, unsigned int outputSize, unsigned int batchSize,
+                             DataType *biasGrad, bool isAccumulating)
+{
+    __shared__ AccumulateType partialSums[BIAS_GRADIENT_ROWS][BIAS_GRADIENT_TILE + 1];
+
+    unsigned int i = blockIdx.x * BIAS_GRADIENT_TILE + threadIdx.x;
+    AccumulateType sum = 0;
+
+    if (i < outputSize)
+    {
+        for (unsigned int b = threadIdx.y; b < batchSize; b += BIAS_GRADIENT_ROWS)
+        {
+            sum += (AccumulateType) outputDelta[(size_t) b * outputSize + i];
+        }
+    }
+
+    partialSums[threadIdx.y][threadIdx.x] = sum;
+    __syncthreads();
+
+    if (threadIdx.y == 0 && i < outputSize)
+    {
+        for (unsigned int r = 1; r < BIAS_GRADIENT_ROWS; ++r)
+        {
+            sum += partialSums[r][threadIdx.x];
+        }
+
+        if (isAccumulating)
+        {
+            sum += (AccumulateType) biasGrad[i];
+        }
+
+        biasGrad[i] = (DataType) sum;
+    }
+}
+
+template <typename DataType>
+__host__ void biasGradientCUDAKernel(const DataType *outputDelta, unsigned int outputSize, unsigned int batchSize,
+                                     DataType *biasGrad, bool isAccumulating)
+{
+    typedef typename std::conditional<std::is_same<DataType, double>::value, double, float>::type AccumulateType;
+
+    dim3 blockSize(BIAS_GRADIENT_TILE, BIAS_GRADIENT_ROWS);
+    int gridSize = (outputSize + BIAS_GRADIENT_TILE - 1) / BIAS_GRADIENT_TILE;
+
+    if (outputSize == 0)
+    {
+        return;
+    }
+
+    biasGradient<DataType, AccumulateType><<<gridSize, blockSize, 0, FreeWill::computeStream()>>>(outputDelta, outputSize, batchSize,
+                                                                                                 biasGrad, isAccumulating);
+    CHECK_CUDA_ERROR
+}
+
+template __host__ void biasGradientCUDAKernel(const float *outputDelta, unsigned int outputSize, unsigned int batchSize, float *biasGrad, bool isAccumulating);
+template __host__ void biasGradientCUDAKernel(const double *outputDelta, unsigned int outputSize, unsigned int batchSize, double *biasGrad, bool isAccumulating);
+template __host__ void biasGradientCUDAKernel(const FreeWill::Half *outputDelta, unsigned int outputSize, unsigned int batchSize, FreeWill::Half *biasGrad, bool isAccumulating);
+template __host__ void biasGradientCUDAKernel(const FreeWill::BFloat16 *outputDelta, unsigned int outputSize, unsigned int batchSize, FreeWill::BFloat16 *biasGrad, bool isAccumulating);
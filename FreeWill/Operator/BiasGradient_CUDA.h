@@ -0,0 +1,15 @@
+#ifndef BIASGRADIENT_CUDA_H
+#define BIASGRADIENT_CUDA_H
+
+#include <cuda_runtime.h>
+
+// shared with the cuda kernels, keep it c++11
+
+// biasGrad[i] = sum over b of outputDelta[b * outputSize + i], added to biasGrad when
+// isAccumulating. One pass over outputDelta, the threads of a warp read consecutive rows of
+// a sample. 16-bit types are summed in float, the result is written once.
+template <typename DataType = float>
+__host__ void biasGradientCUDAKernel(const DataType *outputDelta, unsigned int outputSize, unsigned int batchSize,
+                                     DataType *biasGrad, bool isAccumulating);
+
+#endif
@@ -0,0 +1,265 @@
+#include "CPUAutotuner.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include "../Context/Context.h"
+#include "../Context/CPUFeatures.h"
+#include "../Context/ThreadPool.h"
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+FreeWill::CPUAutotuner::CPUAutotuner()
+    :m_mutex(),
+      m_tuningMutex(),
+      m_variants(),
+      m_filename(),
+      m_cpuName(),
+      m_isEnabled(false),
+      m_repeatCount(3)
+{}
+
+FreeWill::CPUAutotuner &FreeWill::CPUAutotuner::getSingleton()
+{
+    static CPUAutotuner obj;
+    return obj;
+}
+
+const std::string &FreeWill::CPUAutotuner::cpuName()
+{
+    if (m_cpuName.empty())
+    {
+        std::string name;
+
+#if defined(__x86_64__)
+        // the brand string, 48 bytes over three leaves
+        unsigned int registers[12] = {0};
+
+        if (__get_cpuid_max(0x80000000, nullptr) >= 0x80000004)
+        {
+            for (unsigned int i = 0; i < 3; ++i)
+            {
+                __get_cpuid(0x80000002 + i, &registers[i * 4], &registers[i * 4 + 1], &registers[i * 4 + 2], &registers[i * 4 + 3]);
+            }
+
+            char brand[sizeof(registers) + 1] = {0};
+            std::memcpy(brand, registers, sizeof(registers));
+            name = brand;
+        }
+#else
+        std::ifstream cpuinfo("/proc/cpuinfo");
+        std::string line;
+
+        while (std::getline(cpuinfo, line))
+        {
+            if (line.compare(0, 10, "model name") == 0 || line.compare(0, 8, "CPU part") == 0)
+            {
+                name = line.substr(line.find(':') + 1);
+                break;
+            }
+        }
+#endif
+
+        // the key is one word
+        name.erase(0, name.find_first_not_of(' '));
+        name.erase(name.find_last_not_of(' ') + 1);
+        std::replace(name.begin(), name.end(), ' ', '_');
+
+        m_cpuName = name.empty() ? "unknown" : name;
+    }
+
+    return m_cpuName;
+}
+
+std::string FreeWill::CPUAutotuner::key(const std::string &kernel, const std::string &shape)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::ostringstream stream;
+    stream << kernel << "/" << cpuName() << "/" << CPUFeatures::name(CPUFeatures::getSingleton().instructionSet())
+           << "/" << Context<DeviceType::CPU_NAIVE>::getSingleton().deviceCount() << "x" << ThreadPool::getSingleton().threadCount()
+           << "/" << shape;
+
+    return stream.str();
+}
+
+int FreeWill::CPUAutotuner::tune(const std::string &key, unsigned int variantCount, int defaultVariant,
+                                 const std::function<void(unsigned int)> &run)
+{
+    int variant = defaultVariant;
+
+    if (find(key, variant) && variant >= 0 && (unsigned int) variant < variantCount)
+    {
+        return variant;
+    }
+
+    if (!isEnabled() || variantCount < 2)
+    {
+        return defaultVariant;
+    }
+
+    // the replicas of an operator tune the same key, the later ones take the first one's result
+    std::lock_guard<std::mutex> tuningLock(m_tuningMutex);
+
+    if (find(key, variant) && variant >= 0 && (unsigned int) variant < variantCount)
+    {
+        return variant;
+    }
+
+    unsigned int repeatCount = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        repeatCount = m_repeatCount;
+    }
+
+    double bestTime = std::numeric_limits<double>::max();
+    int bestVariant = defaultVariant;
+
+    for (unsigned int i = 0; i < variantCount; ++i)
+    {
+        // once untimed, for the page faults and the buffers a variant sizes on its first run
+        run(i);
+
+        double time = std::numeric_limits<double>::max();
+
+        for (unsigned int e = 0; e < repeatCount; ++e)
+        {
+            std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+            run(i);
+            time = std::min(time, std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+        }
+
+        if (time < bestTime)
+        {
+            bestTime = time;
+            bestVariant = i;
+        }
+    }
+
+    insert(key, bestVariant);
+
+    return bestVariant;
+}
+
+bool FreeWill::CPUAutotuner::find(const std::string &key, int &variant)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::map<std::string, int>::const_iterator iter = m_variants.find(key);
+
+    if (iter == m_variants.end())
+    {
+        return false;
+    }
+
+    variant = iter->second;
+    return true;
+}
+
+void FreeWill::CPUAutotuner::insert(const std::string &key, int variant)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_variants[key] = variant;
+
+    if (!m_filename.empty())
+    {
+        // one line per write, processes sharing the file may only interleave whole entries
+        std::ostringstream line;
+        line << key << " " << variant << "\n";
+
+        std::ofstream file(m_filename, std::ios::app);
+        file << line.str() << std::flush;
+
+        if (!file)
+        {
+            std::cerr << "can't append to " << m_filename << std::endl;
+        }
+    }
+}
+
+bool FreeWill::CPUAutotuner::open(const std::string &filename)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_filename = filename;
+
+    std::ifstream file(filename);
+
+    if (!file)
+    {
+        // a missing file is created by the first insert
+        if (errno == ENOENT)
+        {
+            return true;
+        }
+
+        std::cerr << "can't read " << filename << std::endl;
+        m_filename.clear();
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::istringstream stream(line);
+        std::string key;
+        int variant = 0;
+
+        // a line cut short by a crashed writer is skipped
+        if (stream >> key >> variant)
+        {
+            m_variants[key] = variant;
+        }
+    }
+
+    return true;
+}
+
+void FreeWill::CPUAutotuner::close()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_filename.clear();
+}
+
+void FreeWill::CPUAutotuner::setEnabled(bool isEnabled)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_isEnabled = isEnabled;
+}
+
+bool FreeWill::CPUAutotuner::isEnabled()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return m_isEnabled;
+}
+
+void FreeWill::CPUAutotuner::setRepeatCount(unsigned int repeatCount)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_repeatCount = std::max(1u, repeatCount);
+}
+
+void FreeWill::CPUAutotuner::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_variants.clear();
+}
+
+size_t FreeWill::CPUAutotuner::size()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return m_variants.size();
+}
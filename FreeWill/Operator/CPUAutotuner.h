@@ -0,0 +1,68 @@
+#ifndef CPUAUTOTUNER_H
+#define CPUAUTOTUNER_H
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace FreeWill
+{
+    // The cpu counterpart of ConvolutionAlgorithmCache: the kernel variants operators timed on
+    // their shapes in init(), shared by every operator of the process. Keyed by what is tuned,
+    // the cpu model and the instruction set its kernels run, the device and thread counts and
+    // the shape. With a file opened, entries found in it are used without timing and every new
+    // result is appended to it, so the next process on the same machine doesn't tune again.
+    //
+    // Timing is off until setEnabled(true), the operators then keep the variant their
+    // heuristics pick unless the cache has one.
+    class CPUAutotuner
+    {
+    private:
+        // the cache and the file
+        std::mutex m_mutex;
+        // one tuning at a time, so that the timings don't compete for the cores
+        std::mutex m_tuningMutex;
+        std::map<std::string, int> m_variants;
+        std::string m_filename;
+        std::string m_cpuName;
+        bool m_isEnabled;
+        // how often a variant runs, the fastest run counts
+        unsigned int m_repeatCount;
+
+        CPUAutotuner();
+
+        const std::string &cpuName();
+
+    public:
+        static CPUAutotuner &getSingleton();
+
+        CPUAutotuner(const CPUAutotuner &) = delete;
+        void operator=(const CPUAutotuner &) = delete;
+
+        // kernel names what is tuned, e.g. "convolution", shape the sizes it depends on
+        std::string key(const std::string &kernel, const std::string &shape);
+
+        // The variant of key: the cached one, or when it isn't cached and timing is enabled,
+        // the fastest of the variantCount run(variant) times, which is then cached. Otherwise
+        // defaultVariant, uncached.
+        int tune(const std::string &key, unsigned int variantCount, int defaultVariant, const std::function<void(unsigned int)> &run);
+
+        bool find(const std::string &key, int &variant);
+        void insert(const std::string &key, int variant);
+
+        // reads the entries of filename, which doesn't have to exist yet, and appends new ones to it
+        bool open(const std::string &filename);
+        void close();
+
+        void setEnabled(bool isEnabled);
+        bool isEnabled();
+
+        void setRepeatCount(unsigned int repeatCount);
+
+        void clear();
+        size_t size();
+    };
+}
+
+#endif
@@ -0,0 +1,42 @@
+#include "CPUKernels.h"
+#include "ChannelBlocked_CPU.h"
+#include "GroupedConvolution_CPU.h"
+
+namespace FreeWill
+{
+#if defined(__x86_64__)
+    // CPUKernelsAVX2.cpp and CPUKernelsAVX512.cpp
+    namespace AVX2
+    {
+        template<typename DataType>
+        const CPUKernelTable<DataType> &kernelTable();
+    }
+
+    namespace AVX512
+    {
+        template<typename DataType>
+        const CPUKernelTable<DataType> &kernelTable();
+    }
+#endif
+
+    template<typename DataType>
+    const CPUKernelTable<DataType> &cpuKernelTable(CPUInstructionSet instructionSet)
+    {
+        static const CPUKernelTable<DataType> baseline = makeCPUKernelTable<DataType, GEMMKernelCPU, ActivationKernelCPU, ChannelBlockedKernelCPU, DepthwiseKernelCPU>();
+
+        switch (instructionSet)
+        {
+#if defined(__x86_64__)
+        case CPUInstructionSet::AVX2:
+            return AVX2::kernelTable<DataType>();
+        case CPUInstructionSet::AVX512:
+            return AVX512::kernelTable<DataType>();
+#endif
+        default:
+            return baseline;
+        }
+    }
+
+    template const CPUKernelTable<float> &cpuKernelTable<float>(CPUInstructionSet instructionSet);
+    template const CPUKernelTable<double> &cpuKernelTable<double>(CPUInstructionSet instructionSet);
+}
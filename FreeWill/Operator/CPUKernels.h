@@ -0,0 +1,103 @@
+#ifndef CPUKERNELS_H
+#define CPUKERNELS_H
+
+#include <cstddef>
+
+#include "ActivationMode.h"
+#include "../Context/CPUFeatures.h"
+
+// The vector width of the kernels compiled with the flags of the tree, 16 bytes unless it is
+// built with NATIVE_ARCH
+#if defined(__AVX512F__)
+#define CPU_BASELINE_VECTOR_BYTES 64
+#elif defined(__AVX__)
+#define CPU_BASELINE_VECTOR_BYTES 32
+#else
+#define CPU_BASELINE_VECTOR_BYTES 16
+#endif
+
+namespace FreeWill
+{
+    template<typename DataType>
+    struct GEMMEpilogueCPU;
+
+    struct ConvolutionGeometryCPU;
+
+    // a blocked convolution, ChannelBlockedKernelCPU::convolution of some block, filter and stride
+    template<typename DataType>
+    using ChannelBlockedConvolutionCPU = void (*)(const ConvolutionGeometryCPU &geometry, unsigned int batchSize, const DataType *input,
+                                                  const DataType *blockedFilters, DataType *output, const GEMMEpilogueCPU<DataType> &epilogue);
+
+    // a depthwise convolution, DepthwiseKernelCPU::convolution of some filter and stride
+    template<typename DataType>
+    using DepthwiseConvolutionCPU = void (*)(const ConvolutionGeometryCPU &geometry, unsigned int batchSize, const DataType *input,
+                                             const DataType *taps, DataType *output, const GEMMEpilogueCPU<DataType> &epilogue);
+
+    // The compute bound cpu kernels built for one instruction set. GEMMKernel_CPU.h,
+    // ActivationKernel_CPU.h, ChannelBlockedKernel_CPU.h and DepthwiseKernel_CPU.h are compiled
+    // once with the flags of the tree (CPUKernels.cpp) and again in a namespace per wider
+    // instruction set under #pragma GCC target (CPUKernelsAVX2.cpp, CPUKernelsAVX512.cpp).
+    // gemmCPU, activationForwardCPU/BackwardCPU, selectChannelBlockedConvolutionCPU and
+    // selectDepthwiseConvolutionCPU go through the table of the instruction set CPUFeatures picked. Float and double only, the 16-bit types
+    // are widened to float before they get here.
+    template<typename DataType>
+    struct CPUKernelTable
+    {
+        // GEMMKernelCPU::gemm and its register tile, MR x NR
+        void (*m_gemm)(bool transA, bool transB, unsigned int M, unsigned int N, unsigned int K,
+                       DataType alpha, const DataType *A, unsigned int lda,
+                       const DataType *B, unsigned int ldb,
+                       DataType beta, DataType *C, unsigned int ldc,
+                       const GEMMEpilogueCPU<DataType> *epilogue);
+        unsigned int m_gemmTileRows;
+        unsigned int m_gemmTileColumns;
+
+        // GEMMKernelCPU::gemv, the single column case of m_gemm
+        void (*m_gemv)(bool transA, unsigned int M, unsigned int K,
+                       DataType alpha, const DataType *A, unsigned int lda,
+                       const DataType *x, unsigned int incx,
+                       DataType beta, DataType *y,
+                       const GEMMEpilogueCPU<DataType> *epilogue);
+
+        // ActivationKernelCPU::forward and backward, indexed by ActivationMode
+        void (*m_activationForward[4])(const DataType *input, DataType *output, size_t size);
+        void (*m_activationBackward[4])(const DataType *output, const DataType *outputDelta, DataType *inputDelta, size_t size);
+
+        // ChannelBlockedKernelCPU::select of the blocks of 4, 8 and 16
+        ChannelBlockedConvolutionCPU<DataType> (*m_selectChannelBlockedConvolution[3])(const ConvolutionGeometryCPU &geometry);
+
+        // DepthwiseKernelCPU::select
+        DepthwiseConvolutionCPU<DataType> (*m_selectDepthwiseConvolution)(const ConvolutionGeometryCPU &geometry);
+    };
+
+    // the table of the kernels in the namespace of one instruction set
+    template<typename DataType, template<typename> class GEMMKernel, template<typename> class ActivationKernel,
+             template<typename, unsigned int> class ChannelBlockedKernel, template<typename> class DepthwiseKernel>
+    CPUKernelTable<DataType> makeCPUKernelTable()
+    {
+        typedef ActivationKernel<DataType> Activation;
+
+        return {GEMMKernel<DataType>::gemm, GEMMKernel<DataType>::MR, GEMMKernel<DataType>::NR,
+                GEMMKernel<DataType>::gemv,
+                {Activation::template forward<ActivationMode::SIGMOID>, Activation::template forward<ActivationMode::RELU>,
+                 Activation::template forward<ActivationMode::TANH>, Activation::template forward<ActivationMode::CLIPPED_RELU>},
+                {Activation::template backward<ActivationMode::SIGMOID>, Activation::template backward<ActivationMode::RELU>,
+                 Activation::template backward<ActivationMode::TANH>, Activation::template backward<ActivationMode::CLIPPED_RELU>},
+                {ChannelBlockedKernel<DataType, 4>::select, ChannelBlockedKernel<DataType, 8>::select,
+                 ChannelBlockedKernel<DataType, 16>::select},
+                DepthwiseKernel<DataType>::select};
+    }
+
+    // the table of instructionSet, the baseline one when the tree is built without it
+    template<typename DataType>
+    const CPUKernelTable<DataType> &cpuKernelTable(CPUInstructionSet instructionSet);
+
+    // the table of the instruction set the kernels run, see CPUFeatures::instructionSet
+    template<typename DataType>
+    inline const CPUKernelTable<DataType> &cpuKernels()
+    {
+        return cpuKernelTable<DataType>(CPUFeatures::getSingleton().instructionSet());
+    }
+}
+
+#endif
@@ -0,0 +1,44 @@
+#include "CPUKernels.h"
+#include "ChannelBlocked_CPU.h"
+#include "GroupedConvolution_CPU.h"
+
+// The cpu kernels again for AVX-512, 512-bit vectors, picked at run time when the cpu has them (see
+// CPUKernels.h). Everything they use from other headers is included above, outside the
+// target region, so only the kernel bodies are compiled for the wider instruction set.
+#if defined(__x86_64__)
+
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512bw,avx512dq,avx512vl,avx2,fma")
+
+namespace FreeWill
+{
+    namespace AVX512
+    {
+#define CPU_KERNEL_VECTOR_BYTES 64
+#include "ActivationKernel_CPU.h"
+#include "GEMMKernel_CPU.h"
+#include "ChannelBlockedKernel_CPU.h"
+#include "DepthwiseKernel_CPU.h"
+#undef CPU_KERNEL_VECTOR_BYTES
+    }
+}
+
+#pragma GCC pop_options
+
+namespace FreeWill
+{
+    namespace AVX512
+    {
+        template<typename DataType>
+        const CPUKernelTable<DataType> &kernelTable()
+        {
+            static const CPUKernelTable<DataType> table = makeCPUKernelTable<DataType, GEMMKernelCPU, ActivationKernelCPU, ChannelBlockedKernelCPU, DepthwiseKernelCPU>();
+            return table;
+        }
+
+        template const CPUKernelTable<float> &kernelTable<float>();
+        template const CPUKernelTable<double> &kernelTable<double>();
+    }
+}
+
+#endif
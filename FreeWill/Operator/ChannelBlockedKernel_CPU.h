@@ -0,0 +1,231 @@
+// No include guard: the body of ChannelBlockedKernelCPU, included inside namespace FreeWill by
+// ChannelBlocked_CPU.h and once more inside the namespace of every wider instruction set (see
+// CPUKernels.h). The blocks are vectors of their own width whatever the instruction set.
+
+    // The cpu kernels of the channel blocked layouts (see TensorLayout.h). An image of
+    // {channel, width, height} is stored as channel / BlockSize planes of {BlockSize, width,
+    // height}, so one Block vector holds the channels of a block at a pixel.
+    template<typename DataType, unsigned int BlockSize>
+    class ChannelBlockedKernelCPU
+    {
+    public:
+        typedef DataType Block __attribute__((vector_size(BlockSize * sizeof(DataType))));
+        typedef DataType UnalignedBlock __attribute__((vector_size(BlockSize * sizeof(DataType)), aligned(sizeof(DataType))));
+
+        // the output pixels of a row the convolution keeps in registers at once, each filter
+        // block loaded is used for all of them
+        static const unsigned int PIXEL_TILE = 4;
+
+        // images of pixelCount pixels, CHANNEL_LAST to blocked
+        static void toBlocked(const DataType *input, DataType *output, unsigned int channelCount, unsigned int pixelCount, unsigned int batchSize)
+        {
+            unsigned int blockCount = channelCount / BlockSize;
+
+            ThreadPool::getSingleton().parallelFor(0, batchSize * blockCount, 1, [&](unsigned int planeBegin, unsigned int planeEnd)
+            {
+                for (unsigned int plane = planeBegin; plane < planeEnd; ++plane)
+                {
+                    const DataType *image = input + (size_t) (plane / blockCount) * pixelCount * channelCount + (plane % blockCount) * BlockSize;
+                    DataType *blocks = output + (size_t) plane * pixelCount * BlockSize;
+
+                    for (unsigned int p = 0; p < pixelCount; ++p)
+                    {
+                        *(UnalignedBlock *) (blocks + (size_t) p * BlockSize) = *(const UnalignedBlock *) (image + (size_t) p * channelCount);
+                    }
+                }
+            });
+        }
+
+        static void fromBlocked(const DataType *input, DataType *output, unsigned int channelCount, unsigned int pixelCount, unsigned int batchSize)
+        {
+            unsigned int blockCount = channelCount / BlockSize;
+
+            ThreadPool::getSingleton().parallelFor(0, batchSize * blockCount, 1, [&](unsigned int planeBegin, unsigned int planeEnd)
+            {
+                for (unsigned int plane = planeBegin; plane < planeEnd; ++plane)
+                {
+                    const DataType *blocks = input + (size_t) plane * pixelCount * BlockSize;
+                    DataType *image = output + (size_t) (plane / blockCount) * pixelCount * channelCount + (plane % blockCount) * BlockSize;
+
+                    for (unsigned int p = 0; p < pixelCount; ++p)
+                    {
+                        *(UnalignedBlock *) (image + (size_t) p * channelCount) = *(const UnalignedBlock *) (blocks + (size_t) p * BlockSize);
+                    }
+                }
+            });
+        }
+
+        // The {channel, filterSize, filterSize} filters, one after the other, as
+        // [filter block][channel block][y][x][channel][filter]: the filters of a block for one
+        // input channel are a Block.
+        static void blockFilters(const ConvolutionGeometryCPU &geometry, const DataType *featureMap, DataType *blockedFilters)
+        {
+            unsigned int channelBlockCount = geometry.channelCount / BlockSize;
+            unsigned int filterBlockCount = geometry.filterCount / BlockSize;
+            unsigned int windowSize = geometry.filterSize * geometry.filterSize;
+            unsigned int patchSize = geometry.patchSize();
+
+            for (unsigned int fb = 0; fb < filterBlockCount; ++fb)
+            {
+                for (unsigned int cb = 0; cb < channelBlockCount; ++cb)
+                {
+                    for (unsigned int k = 0; k < windowSize; ++k)
+                    {
+                        DataType *blocks = blockedFilters + ((size_t) (fb * channelBlockCount + cb) * windowSize + k) * BlockSize * BlockSize;
+
+                        for (unsigned int c = 0; c < BlockSize; ++c)
+                        {
+                            for (unsigned int f = 0; f < BlockSize; ++f)
+                            {
+                                blocks[c * BlockSize + f] = featureMap[(size_t) (fb * BlockSize + f) * patchSize + k * geometry.channelCount + cb * BlockSize + c];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        // Direct convolution of blocked images into blocked outputs with filters from
+        // blockFilters(). Unlike the other cpu algorithms it overwrites the output:
+        // output = activation(convolution + bias), the epilogue says which. FilterSize and
+        // Stride other than 0 fix the filter and the stride at compile time, the window loops
+        // of a tile then unroll, see select().
+        template<unsigned int FilterSize = 0, unsigned int Stride = 0>
+        static void convolution(const ConvolutionGeometryCPU &geometry, unsigned int batchSize, const DataType *input,
+                                const DataType *blockedFilters, DataType *output, const GEMMEpilogueCPU<DataType> &epilogue)
+        {
+            const unsigned int channelBlockCount = geometry.channelCount / BlockSize;
+            const unsigned int filterBlockCount = geometry.filterCount / BlockSize;
+            const unsigned int filterSize = FilterSize ? FilterSize : geometry.filterSize;
+            const unsigned int strideX = Stride ? Stride : geometry.strideX;
+            const unsigned int strideY = Stride ? Stride : geometry.strideY;
+            const unsigned int windowSize = filterSize * filterSize;
+            size_t planeSize = (size_t) geometry.width * geometry.height * BlockSize;
+            unsigned int rowCount = batchSize * filterBlockCount * geometry.outputHeight;
+            unsigned int grain = std::max(1u, 16384 / std::max(1u, geometry.outputWidth * geometry.patchSize()));
+
+            ThreadPool::getSingleton().parallelFor(0, rowCount, grain, [&](unsigned int rowBegin, unsigned int rowEnd)
+            {
+                for (unsigned int row = rowBegin; row < rowEnd; ++row)
+                {
+                    unsigned int outputY = row % geometry.outputHeight;
+                    unsigned int fb = (row / geometry.outputHeight) % filterBlockCount;
+                    unsigned int b = row / (geometry.outputHeight * filterBlockCount);
+
+                    const DataType *image = input + (size_t) b * channelBlockCount * planeSize;
+                    const DataType *filters = blockedFilters + (size_t) fb * channelBlockCount * windowSize * BlockSize * BlockSize;
+                    DataType *outputRow = output + (size_t) row * geometry.outputWidth * BlockSize;
+
+                    Block bias = {};
+                    if (epilogue.m_rowBias)
+                    {
+                        bias = *(const UnalignedBlock *) (epilogue.m_rowBias + fb * BlockSize);
+                    }
+
+                    int startY = (int) (outputY * strideY) - (int) geometry.zeroPaddingY;
+                    unsigned int firstY = (unsigned int) std::max(0, -startY);
+                    unsigned int lastY = (unsigned int) std::max(0, std::min((int) filterSize, (int) geometry.height - startY));
+
+                    for (unsigned int outputX = 0; outputX < geometry.outputWidth;)
+                    {
+                        int startX = (int) (outputX * strideX) - (int) geometry.zeroPaddingX;
+                        bool isInside = startX >= 0 && outputX + PIXEL_TILE <= geometry.outputWidth &&
+                                startX + (int) ((PIXEL_TILE - 1) * strideX + filterSize) <= (int) geometry.width;
+
+                        if (isInside)
+                        {
+                            Block sum[PIXEL_TILE];
+                            for (unsigned int t = 0; t < PIXEL_TILE; ++t)
+                            {
+                                sum[t] = bias;
+                            }
+
+                            for (unsigned int cb = 0; cb < channelBlockCount; ++cb)
+                            {
+                                for (unsigned int y = firstY; y < lastY; ++y)
+                                {
+                                    const DataType *pixels = image + cb * planeSize + ((size_t) (startY + y) * geometry.width + startX) * BlockSize;
+                                    const DataType *weights = filters + ((size_t) cb * windowSize + y * filterSize) * BlockSize * BlockSize;
+
+                                    for (unsigned int x = 0; x < filterSize; ++x)
+                                    {
+                                        for (unsigned int c = 0; c < BlockSize; ++c)
+                                        {
+                                            Block weight = *(const UnalignedBlock *) (weights + (x * BlockSize + c) * BlockSize);
+
+                                            for (unsigned int t = 0; t < PIXEL_TILE; ++t)
+                                            {
+                                                sum[t] += pixels[(t * strideX + x) * BlockSize + c] * weight;
+                                            }
+                                        }
+                                    }
+                                }
+                            }
+
+                            for (unsigned int t = 0; t < PIXEL_TILE; ++t)
+                            {
+                                *(UnalignedBlock *) (outputRow + (size_t) (outputX + t) * BlockSize) = sum[t];
+                            }
+
+                            outputX += PIXEL_TILE;
+                            continue;
+                        }
+
+                        // the borders, one pixel at a time
+                        unsigned int firstX = (unsigned int) std::max(0, -startX);
+                        unsigned int lastX = (unsigned int) std::max(0, std::min((int) filterSize, (int) geometry.width - startX));
+                        Block sum = bias;
+
+                        for (unsigned int cb = 0; cb < channelBlockCount; ++cb)
+                        {
+                            for (unsigned int y = firstY; y < lastY; ++y)
+                            {
+                                const DataType *pixels = image + cb * planeSize + (size_t) (startY + y) * geometry.width * BlockSize;
+                                const DataType *weights = filters + ((size_t) cb * windowSize + y * filterSize) * BlockSize * BlockSize;
+
+                                for (unsigned int x = firstX; x < lastX; ++x)
+                                {
+                                    for (unsigned int c = 0; c < BlockSize; ++c)
+                                    {
+                                        sum += pixels[(startX + (int) x) * (int) BlockSize + c] * *(const UnalignedBlock *) (weights + (x * BlockSize + c) * BlockSize);
+                                    }
+                                }
+                            }
+                        }
+
+                        *(UnalignedBlock *) (outputRow + (size_t) outputX * BlockSize) = sum;
+                        ++outputX;
+                    }
+
+                    if (epilogue.m_hasActivation)
+                    {
+                        activationForwardCPU<DataType>(epilogue.m_activationMode, outputRow, outputRow, geometry.outputWidth * BlockSize);
+                    }
+                }
+            });
+        }
+
+        // the convolution specialized for the filter and stride of geometry, 1x1, 3x3 and 5x5
+        // at stride 1 or 2, the generic one for the others
+        static ChannelBlockedConvolutionCPU<DataType> select(const ConvolutionGeometryCPU &geometry)
+        {
+            static const struct
+            {
+                unsigned int filterSize;
+                unsigned int stride;
+                ChannelBlockedConvolutionCPU<DataType> function;
+            } kernels[] = {{1, 1, convolution<1, 1>}, {1, 2, convolution<1, 2>},
+                           {3, 1, convolution<3, 1>}, {3, 2, convolution<3, 2>},
+                           {5, 1, convolution<5, 1>}, {5, 2, convolution<5, 2>}};
+
+            for (const auto &kernel : kernels)
+            {
+                if (kernel.filterSize == geometry.filterSize && kernel.stride == geometry.strideX && kernel.stride == geometry.strideY)
+                {
+                    return kernel.function;
+                }
+            }
+
+            return convolution<>;
+        }
+    };
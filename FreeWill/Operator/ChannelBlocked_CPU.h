@@ -0,0 +1,119 @@
+#ifndef CHANNELBLOCKED_CPU_H
+#define CHANNELBLOCKED_CPU_H
+
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
+#include "CPUKernels.h"
+#include "Convolution_CPU.h"
+#include "GEMM_CPU.h"
+#include "../Context/ThreadPool.h"
+#include "../Tensor/TensorLayout.h"
+
+namespace FreeWill
+{
+#include "ChannelBlockedKernel_CPU.h"
+
+    // From CHANNEL_LAST to a blocked layout or back, false for any other pair or when the
+    // block doesn't divide channelCount.
+    template<typename DataType>
+    bool convertLayoutCPU(TensorLayout from, TensorLayout to, const DataType *input, DataType *output,
+                          unsigned int channelCount, unsigned int pixelCount, unsigned int batchSize)
+    {
+        bool isBlocking = from == TensorLayout::CHANNEL_LAST;
+        unsigned int blockSize = channelBlockSize(isBlocking ? to : from);
+
+        if ((from == TensorLayout::CHANNEL_LAST) == (to == TensorLayout::CHANNEL_LAST) || channelCount % blockSize)
+        {
+            return false;
+        }
+
+        switch (blockSize)
+        {
+        case 4:
+            (isBlocking ? ChannelBlockedKernelCPU<DataType, 4>::toBlocked : ChannelBlockedKernelCPU<DataType, 4>::fromBlocked)(input, output, channelCount, pixelCount, batchSize);
+            return true;
+        case 8:
+            (isBlocking ? ChannelBlockedKernelCPU<DataType, 8>::toBlocked : ChannelBlockedKernelCPU<DataType, 8>::fromBlocked)(input, output, channelCount, pixelCount, batchSize);
+            return true;
+        case 16:
+            (isBlocking ? ChannelBlockedKernelCPU<DataType, 16>::toBlocked : ChannelBlockedKernelCPU<DataType, 16>::fromBlocked)(input, output, channelCount, pixelCount, batchSize);
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // the convolution of layout specialized for geometry, see ChannelBlockedKernelCPU::select,
+    // float and double from the kernels of the instruction set the cpu runs
+    template<typename DataType>
+    ChannelBlockedConvolutionCPU<DataType> selectChannelBlockedConvolutionCPU(TensorLayout layout, const ConvolutionGeometryCPU &geometry)
+    {
+        if constexpr (std::is_same<DataType, float>::value || std::is_same<DataType, double>::value)
+        {
+            const CPUKernelTable<DataType> &kernels = cpuKernels<DataType>();
+
+            switch (channelBlockSize(layout))
+            {
+            case 4:
+                return kernels.m_selectChannelBlockedConvolution[0](geometry);
+            case 8:
+                return kernels.m_selectChannelBlockedConvolution[1](geometry);
+            case 16:
+                return kernels.m_selectChannelBlockedConvolution[2](geometry);
+            default:
+                return nullptr;
+            }
+        }
+        else
+        {
+            switch (channelBlockSize(layout))
+            {
+            case 4:
+                return ChannelBlockedKernelCPU<DataType, 4>::select(geometry);
+            case 8:
+                return ChannelBlockedKernelCPU<DataType, 8>::select(geometry);
+            case 16:
+                return ChannelBlockedKernelCPU<DataType, 16>::select(geometry);
+            default:
+                return nullptr;
+            }
+        }
+    }
+
+    // Blocks the filters into workspace and convolves, input and output in layout, with the
+    // convolution selectChannelBlockedConvolutionCPU picked, it selects one when null.
+    template<typename DataType>
+    void convolutionChannelBlockedCPU(TensorLayout layout, const ConvolutionGeometryCPU &geometry, unsigned int batchSize,
+                                      const DataType *input, const DataType *featureMap, DataType *output,
+                                      std::vector<DataType> &workspace, const GEMMEpilogueCPU<DataType> &epilogue,
+                                      ChannelBlockedConvolutionCPU<DataType> convolution = nullptr)
+    {
+        workspace.resize((size_t) geometry.patchSize() * geometry.filterCount);
+
+        switch (channelBlockSize(layout))
+        {
+        case 4:
+            ChannelBlockedKernelCPU<DataType, 4>::blockFilters(geometry, featureMap, workspace.data());
+            break;
+        case 8:
+            ChannelBlockedKernelCPU<DataType, 8>::blockFilters(geometry, featureMap, workspace.data());
+            break;
+        case 16:
+            ChannelBlockedKernelCPU<DataType, 16>::blockFilters(geometry, featureMap, workspace.data());
+            break;
+        default:
+            return;
+        }
+
+        if (!convolution)
+        {
+            convolution = selectChannelBlockedConvolutionCPU<DataType>(layout, geometry);
+        }
+
+        convolution(geometry, batchSize, input, workspace.data(), output, epilogue);
+    }
+}
+
+#endif
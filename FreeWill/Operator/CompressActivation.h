@@ -0,0 +1,82 @@
+#ifndef COMPRESSACTIVATION_H
+#define COMPRESSACTIVATION_H
+
+#include "Operator.h"
+#include "ActivationCompression_CPU.h"
+#include "ActivationCompression_CUDA.h"
+#include "../Tensor/Tensor.h"
+
+namespace FreeWill
+{
+    // What the forward pass of a training solver keeps of an activation the backward pass
+    // reads, set before init (see Model::planActivationCompression).
+    //
+    // EXACT keeps a sign mask instead of the output of a ReLU for its derivative, and only the
+    // switches of a max pooling for its derivative, so neither reads the full tensors. HALF also
+    // keeps the compressed ReLU outputs other backward operators read as Half, they read a float
+    // copy decoded right before the first of them. Float outputs only, it is lossy.
+    enum class ActivationCompression : uint32_t
+    {
+        NONE,
+        EXACT,
+        HALF
+    };
+
+    // Mask = the sign bits of Input (dropoutMaskShape), and when bound Values = Input as Half.
+    // A ReLU derivative reads the mask instead of the output, see ActivationDerivative.
+    template<DeviceType DeviceUsed = DeviceType::CPU_NAIVE, typename DataType = float>
+    class CompressActivation : public Operator<DeviceUsed>
+    {
+    protected:
+        using Operator<DeviceUsed>::input;
+        using Operator<DeviceUsed>::output;
+
+    public:
+        enum InputSlot : unsigned int {INPUT};
+        enum OutputSlot : unsigned int {MASK, VALUES};
+
+        CompressActivation(unsigned int deviceId = 0)
+            :Operator<DeviceUsed>({"Input"}, {"Mask", "Values"}, deviceId)
+        {
+        }
+
+        virtual bool init() override
+        {
+            CHECK_GPU;
+
+            FAIL_IF (!input("Input") || !output("Mask"));
+
+            FAIL_IF (output("Mask")->shape() != dropoutMaskShape(input("Input")->shape()));
+
+            FAIL_IF (output("Values") && output("Values")->shape() != input("Input")->shape());
+
+            return true;
+        }
+
+        virtual void evaluate() override
+        {
+            CHECK_GPU;
+
+            Tensor<DeviceUsed, DataType> *_input = input(INPUT)->template toType<DataType>();
+            Tensor<DeviceUsed, unsigned int> *_mask = output(MASK)->template toType<unsigned int>();
+            Tensor<DeviceUsed, Half> *_values = output(VALUES) ? output(VALUES)->template toType<Half>() : nullptr;
+
+            unsigned int itemSize = 0;
+            unsigned int batchSize = 0;
+            dropoutItems(_input->shape(), itemSize, batchSize);
+
+            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+            {
+                compressActivationCPU(_input->cpuDataHandle(), _mask->cpuDataHandle(), _values ? _values->cpuDataHandle() : nullptr,
+                                      itemSize, batchSize);
+            }
+            else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                compressActivationCUDAKernel<DataType>(_input->gpuDataHandle(), _mask->gpuDataHandle(),
+                                                       _values ? _values->gpuDataHandle() : nullptr, itemSize, batchSize);
+            }
+        }
+    };
+}
+
+#endif
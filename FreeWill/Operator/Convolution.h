@@ -4,6 +4,14 @@
 #include <QDebug>
 #include "Operator.h"
 #include "../Context/Context.h"
+#include "Convolution_CPU.h"
+#include "ChannelBlocked_CPU.h"
+#include "GroupedConvolution_CPU.h"
+#include "BatchNormalization_CPU.h"
+#include "ActivationMode.h"
+#include "ConvolutionAlgorithmCache.h"
+#include "CPUAutotuner.h"
+#include <sstream>
 
 namespace FreeWill
 {
@@ -21,6 +29,7 @@ namespace FreeWill
         unsigned int m_strideX;
         unsigned int m_zeroPaddingY;
         unsigned int m_strideY;
+        unsigned int m_groupCount;
 
         cudnnTensorDescriptor_t m_inputGPUTensorDescriptor;
         cudnnTensorDescriptor_t m_outputGPUTensorDescriptor;
@@ -28,25 +37,69 @@ namespace FreeWill
         cudnnFilterDescriptor_t m_filterDescriptor;
         cudnnConvolutionDescriptor_t m_convolutionDescriptor;
         cudnnConvolutionFwdAlgo_t m_convolutionForwardAlgorithm;
+        // the algorithm came with setPlan(), init() doesn't search
+        bool m_isPlanned;
+        // what the algorithm needs of the device's shared workspace
         size_t m_workspaceSize;
-        unsigned char *m_workspace;
+        unsigned int m_gpuBatchSize;
+
+        ConvolutionAlgorithmCPU m_cpuAlgorithm;
+        // the kernels specialized for the filter and stride, picked by init()
+        Im2colFunctionCPU<DataType> m_im2col;
+        ChannelBlockedConvolutionCPU<DataType> m_channelBlockedConvolution;
+        DepthwiseConvolutionCPU<DataType> m_depthwiseConvolution;
+        std::vector<DataType> m_cpuWorkspace;
+        // the packed channels of a group, GROUPED_IM2COL_GEMM
+        std::vector<DataType> m_cpuGroupWorkspace;
+
+        bool m_hasActivation;
+        ActivationMode m_activationMode;
+        cudnnActivationDescriptor_t m_activationDescriptor;
+
+        bool m_clearsOutput;
+
+        // an inference batch normalization of Output folded into the feature map and bias
+        bool m_hasNormalization;
+        float m_normalizationEpsilon;
+        std::vector<DataType> m_foldedFeatureMap;
+        std::vector<DataType> m_foldedBias;
 
     public:
+        enum InputSlot : unsigned int {INPUT, FEATURE_MAP, BIAS, NORMALIZATION_SCALE, NORMALIZATION_SHIFT, NORMALIZATION_MEAN, NORMALIZATION_VARIANCE};
+        enum OutputSlot : unsigned int {OUTPUT};
+
         Convolution(unsigned int strideX = 1, unsigned int strideY = 1, 
                 unsigned int zeroPaddingX = 0, unsigned int zeroPaddingY = 0, unsigned int deviceId = 0)
-            :Operator<DeviceUsed>({"Input", "FeatureMap", "Bias"}, {"Output"}, deviceId),
+            :Operator<DeviceUsed>({"Input", "FeatureMap", "Bias", "NormalizationScale", "NormalizationShift", "NormalizationMean", "NormalizationVariance"},
+                                  {"Output"}, deviceId),
             m_zeroPaddingX(zeroPaddingX),
             m_strideX(strideX),
             m_zeroPaddingY(zeroPaddingY),
             m_strideY(strideY),
+            m_groupCount(1),
             m_inputGPUTensorDescriptor(0),
             m_outputGPUTensorDescriptor(0),
             m_biasGPUTensorDescriptor(0),
             m_filterDescriptor(0),
             m_convolutionDescriptor(0),
             m_convolutionForwardAlgorithm(),
+            m_isPlanned(false),
             m_workspaceSize(0),
-            m_workspace(nullptr)
+            m_gpuBatchSize(0),
+            m_cpuAlgorithm(ConvolutionAlgorithmCPU::IM2COL_GEMM),
+            m_im2col(nullptr),
+            m_channelBlockedConvolution(nullptr),
+            m_depthwiseConvolution(nullptr),
+            m_cpuWorkspace(),
+            m_cpuGroupWorkspace(),
+            m_hasActivation(false),
+            m_activationMode(ActivationMode::SIGMOID),
+            m_activationDescriptor(0),
+            m_clearsOutput(false),
+            m_hasNormalization(false),
+            m_normalizationEpsilon(0.0f),
+            m_foldedFeatureMap(),
+            m_foldedBias()
         {
             CHECK_GPU;
             if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
@@ -69,18 +122,19 @@ namespace FreeWill
                 RUN_CUDNN(cudnnDestroyTensorDescriptor(m_biasGPUTensorDescriptor));
                 RUN_CUDNN(cudnnDestroyFilterDescriptor(m_filterDescriptor));
                 RUN_CUDNN(cudnnDestroyConvolutionDescriptor(m_convolutionDescriptor));
+
+                if (m_activationDescriptor)
+                {
+                    RUN_CUDNN(cudnnDestroyActivationDescriptor(m_activationDescriptor));
+                    m_activationDescriptor = 0;
+                }
+
                 m_inputGPUTensorDescriptor = 0;
                 m_outputGPUTensorDescriptor = 0;
                 m_biasGPUTensorDescriptor = 0;
                 m_filterDescriptor = 0;
                 m_convolutionDescriptor = 0;
                 m_biasGPUTensorDescriptor = 0;
-
-                if (m_workspace)
-                {
-                    RUN_CUDA(cudaFree(m_workspace));
-                    m_workspace = nullptr;
-                }
             }
         }
 
@@ -119,6 +173,87 @@ namespace FreeWill
             printf("Tensor descriptor: %d, dim: %d,%d,%d,%d | stride: %d,%d,%d,%d\n", dimnb, dimA[0], dimA[1], dimA[2], dimA[3],strideA[0],strideA[1],strideA[2],strideA[3]);
         }
 
+        ConvolutionGeometryCPU geometryCPU()
+        {
+            ConvolutionGeometryCPU geometry;
+            geometry.channelCount = input(INPUT)->shape()[0];
+            geometry.filterCount = input(FEATURE_MAP)->shape()[3];
+            geometry.filterSize = input(FEATURE_MAP)->shape()[1];
+            geometry.width = input(INPUT)->shape()[1];
+            geometry.height = input(INPUT)->shape()[2];
+            geometry.outputWidth = output(OUTPUT)->shape()[1];
+            geometry.outputHeight = output(OUTPUT)->shape()[2];
+            geometry.strideX = m_strideX;
+            geometry.strideY = m_strideY;
+            geometry.zeroPaddingX = m_zeroPaddingX;
+            geometry.zeroPaddingY = m_zeroPaddingY;
+            return geometry;
+        }
+
+        ConvolutionAlgorithmCPU cpuAlgorithm() const
+        {
+            return m_cpuAlgorithm;
+        }
+
+        // on gpu the forward algorithm, the cpu one is cheap to select again
+        virtual std::string plan() const override
+        {
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                return std::to_string((int) m_convolutionForwardAlgorithm);
+            }
+
+            return std::string();
+        }
+
+        virtual void setPlan(const std::string &plan) override
+        {
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                std::istringstream stream(plan);
+                int algorithm = 0;
+
+                if (stream >> algorithm)
+                {
+                    m_convolutionForwardAlgorithm = (cudnnConvolutionFwdAlgo_t) algorithm;
+                    m_isPlanned = true;
+                }
+            }
+        }
+
+        // Output = activation(convolution + bias) in one pass, set before init. On GPU only
+        // RELU can be fused by cudnnConvolutionBiasActivationForward.
+        void fuseActivation(ActivationMode activationMode)
+        {
+            m_hasActivation = true;
+            m_activationMode = activationMode;
+        }
+
+        // The cpu convolution adds to Output, which the caller clears; set before init, it
+        // clears Output itself first, so Output is overwritten on every device.
+        void clearOutputFirst()
+        {
+            m_clearsOutput = true;
+        }
+
+        // Output = scale * (convolution + bias - mean) / sqrt(variance + epsilon) + shift with the
+        // Normalization inputs, an inference batch normalization (see Model::fuseOperators); set
+        // before init, cpu only. The weights are folded again on every pass.
+        void foldNormalization(float epsilon)
+        {
+            m_hasNormalization = true;
+            m_normalizationEpsilon = epsilon;
+        }
+
+        // Splits the channels of Input and the filters into groupCount groups, each group
+        // convolving its own channels with its own filters, so FeatureMap is
+        // {channels / groupCount, filterSize, filterSize, filters}; set before init. A group a
+        // channel is a depthwise convolution. Channel last tensors only on cpu.
+        void setGroupCount(unsigned int groupCount)
+        {
+            m_groupCount = groupCount;
+        }
+
         static void reg()
         {
             OperatorRegistry<Convolution<DeviceUsed, DataType>>::m_operatorFactoryInitializer.getA();
@@ -136,7 +271,9 @@ namespace FreeWill
 
             FAIL_IF (output("Output")->shape().dimension() != 4);
 
-            FAIL_IF (input("Input")->shape()[0] != input("FeatureMap")->shape()[0]);
+            FAIL_IF (m_groupCount == 0 || input("Input")->shape()[0] != input("FeatureMap")->shape()[0] * m_groupCount);
+
+            FAIL_IF (input("FeatureMap")->shape()[3] % m_groupCount);
 
             FAIL_IF (input("FeatureMap")->shape()[1] != input("FeatureMap")->shape()[2]);
 
@@ -164,12 +301,120 @@ namespace FreeWill
 
             FAIL_IF (input("Input")->shape()[3] != output("Output")->shape()[3]);
 
-            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            if (m_hasNormalization)
+            {
+                const Shape filterShape({input("FeatureMap")->shape()[3]});
+
+                FAIL_IF (!input("NormalizationScale") || !input("NormalizationShift") || !input("NormalizationMean") || !input("NormalizationVariance"));
+
+                FAIL_IF (input("NormalizationScale")->shape() != filterShape || input("NormalizationShift")->shape() != filterShape);
+
+                FAIL_IF (input("NormalizationMean")->shape() != filterShape || input("NormalizationVariance")->shape() != filterShape);
+            }
+
+            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+            {
+                FAIL_IF (m_hasActivation && !isActivationImplementedCPU(m_activationMode));
+
+                if (m_hasNormalization)
+                {
+                    m_foldedFeatureMap.resize(input("FeatureMap")->shape().size());
+                    m_foldedBias.resize(input("Bias")->shape().size());
+                }
+
+                TensorLayout layout = input("Input")->layout();
+
+                FAIL_IF (output("Output")->layout() != layout);
+
+                FAIL_IF (m_groupCount > 1 && layout != TensorLayout::CHANNEL_LAST);
+
+                if (m_groupCount > 1 && m_groupCount == input("Input")->shape()[0])
+                {
+                    m_cpuAlgorithm = ConvolutionAlgorithmCPU::DEPTHWISE_DIRECT;
+                    m_depthwiseConvolution = selectDepthwiseConvolutionCPU<DataType>(geometryCPU());
+                }
+                else if (m_groupCount > 1)
+                {
+                    m_cpuAlgorithm = ConvolutionAlgorithmCPU::GROUPED_IM2COL_GEMM;
+                }
+                else if (layout != TensorLayout::CHANNEL_LAST)
+                {
+                    unsigned int blockSize = channelBlockSize(layout);
+
+                    FAIL_IF (input("Input")->shape()[0] % blockSize || output("Output")->shape()[0] % blockSize);
+
+                    m_cpuAlgorithm = ConvolutionAlgorithmCPU::CHANNEL_BLOCKED_DIRECT;
+                    m_channelBlockedConvolution = selectChannelBlockedConvolutionCPU<DataType>(layout, geometryCPU());
+                }
+                else
+                {
+                    ConvolutionGeometryCPU geometry = geometryCPU();
+
+                    m_cpuAlgorithm = selectConvolutionAlgorithmCPU(geometry);
+                    m_im2col = selectIm2colCPU<DataType>(geometry);
+
+                    if constexpr (!IsReducedPrecision<DataType>::value)
+                    {
+                        // the heuristic guesses where winograd starts to win, time both on scratch tensors of this shape
+                        if (geometry.filterSize == 3 && geometry.strideX == 1 && geometry.strideY == 1)
+                        {
+                            unsigned int batchSize = input("Input")->shape()[3];
+                            const ConvolutionAlgorithmCPU algorithms[] = {ConvolutionAlgorithmCPU::IM2COL_GEMM, ConvolutionAlgorithmCPU::WINOGRAD_2X2_3X3};
+                            CPUAutotuner &autotuner = CPUAutotuner::getSingleton();
+                            std::ostringstream shape;
+                            shape << geometry.channelCount << "x" << geometry.width << "x" << geometry.height << "x" << batchSize
+                                  << "_" << geometry.filterCount << "_" << geometry.zeroPaddingX << "x" << geometry.zeroPaddingY;
+                            std::vector<DataType> scratchInput;
+                            std::vector<DataType> scratchFeatureMap;
+                            std::vector<DataType> scratchOutput;
+
+                            int variant = autotuner.tune(autotuner.key("convolution", shape.str()), 2,
+                                                         m_cpuAlgorithm == ConvolutionAlgorithmCPU::WINOGRAD_2X2_3X3 ? 1 : 0,
+                                                         [&](unsigned int variant)
+                            {
+                                if (scratchInput.empty())
+                                {
+                                    scratchInput.assign(input("Input")->shape().size(), 0.5);
+                                    scratchFeatureMap.assign(input("FeatureMap")->shape().size(), 0.5);
+                                    scratchOutput.resize(output("Output")->shape().size());
+                                }
+
+                                if (algorithms[variant] == ConvolutionAlgorithmCPU::WINOGRAD_2X2_3X3)
+                                {
+                                    convolutionWinogradCPU<DataType>(geometry, batchSize, scratchInput.data(), scratchFeatureMap.data(),
+                                                                     scratchOutput.data(), m_cpuWorkspace);
+                                }
+                                else
+                                {
+                                    convolutionIm2colCPU<DataType>(geometry, batchSize, scratchInput.data(), scratchFeatureMap.data(),
+                                                                   scratchOutput.data(), m_cpuWorkspace, nullptr, m_im2col);
+                                }
+                            });
+
+                            m_cpuAlgorithm = algorithms[variant];
+                        }
+                    }
+                }
+            }
+            else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
             {
+                FAIL_IF (input("Input")->layout() != TensorLayout::CHANNEL_LAST || output("Output")->layout() != TensorLayout::CHANNEL_LAST);
+
+                FAIL_IF (m_hasNormalization);
+
                 unsigned int batchSize = input("Input")->shape()[3];
-                unsigned int channelCount = input("FeatureMap")->shape()[0];
+                unsigned int channelCount = input("Input")->shape()[0];
+                unsigned int filterChannelCount = input("FeatureMap")->shape()[0];
                 unsigned int filterCount = input("FeatureMap")->shape()[3];
 
+                FAIL_IF (m_hasActivation && m_activationMode != ActivationMode::RELU);
+
+                if (m_hasActivation && !m_activationDescriptor)
+                {
+                    RUN_CUDNN(cudnnCreateActivationDescriptor(&m_activationDescriptor));
+                    RUN_CUDNN(cudnnSetActivationDescriptor(m_activationDescriptor, CUDNN_ACTIVATION_RELU, CUDNN_PROPAGATE_NAN, 20.0));
+                }
+
                 cudnnDataType_t dataType = CUDNN_DATA_FLOAT;
                 if constexpr (std::is_same<DataType,float>::value)
                 {
@@ -179,6 +424,14 @@ namespace FreeWill
                 {
                     dataType = CUDNN_DATA_DOUBLE;
                 }
+                else if constexpr (std::is_same<DataType,Half>::value)
+                {
+                    dataType = CUDNN_DATA_HALF;
+                }
+                else if constexpr (std::is_same<DataType,BFloat16>::value)
+                {
+                    dataType = CUDNN_DATA_BFLOAT16;
+                }
 
                 RUN_CUDNN(cudnnSetTensor4dDescriptor( m_inputGPUTensorDescriptor,
                                                       CUDNN_TENSOR_NHWC,
@@ -211,10 +464,11 @@ namespace FreeWill
                                                       dataType,
                                                       CUDNN_TENSOR_NHWC,
                                                       filterCount,
-                                                      channelCount,
+                                                      filterChannelCount,
                                                       filterSize,
                                                       filterSize));
 
+                // the compute type, float accumulation for 16-bit data
                 cudnnDataType_t cudnnDataType = cudnnDataType_t::CUDNN_DATA_FLOAT;
 
                 if constexpr (std::is_same<DataType, float>::value)
@@ -236,75 +490,139 @@ namespace FreeWill
                                                            1,
                                                            CUDNN_CROSS_CORRELATION, cudnnDataType));
 
-                RUN_CUDNN(cudnnGetConvolutionForwardAlgorithm( Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId),
-                                                               m_inputGPUTensorDescriptor,
-                                                               m_filterDescriptor,
-                                                               m_convolutionDescriptor,
-                                                               m_outputGPUTensorDescriptor,
-                                                               CUDNN_CONVOLUTION_FWD_PREFER_FASTEST,
-                                                               0,
-                                                               &m_convolutionForwardAlgorithm));
-
-                qDebug() << "Convolution forward algorithm find based on huristic:";
-                displayConvolutionAlgorithm(m_convolutionForwardAlgorithm);
-
-                RUN_CUDNN(cudnnGetConvolutionForwardWorkspaceSize( Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId),
-                                                                          m_inputGPUTensorDescriptor,
-                                                                          m_filterDescriptor,
-                                                                          m_convolutionDescriptor,
-                                                                          m_outputGPUTensorDescriptor,
-                                                                          m_convolutionForwardAlgorithm,
-                                                                          &m_workspaceSize));
-                qDebug() << "Required workspace size:" << m_workspaceSize;
-
-
-                int returnedAlgoCount = 0;
-                const int requestedAlgoCount = 20;
-                cudnnConvolutionFwdAlgoPerf_t perfResults[requestedAlgoCount];
-
-                RUN_CUDNN(cudnnFindConvolutionForwardAlgorithm(  Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId),
-                                                                 m_inputGPUTensorDescriptor,
-                                                                 m_filterDescriptor,
-                                                                 m_convolutionDescriptor,
-                                                                 m_outputGPUTensorDescriptor,
-                                                                 requestedAlgoCount,
-                                                                 &returnedAlgoCount,
-                                                                 perfResults));
-
-                qDebug() << returnedAlgoCount << "convolution forward algorithm benchmarks:";
-
-                for(int i =0;i<returnedAlgoCount;++i)
-                {
-                    qDebug() << i << "Status:" << perfResults[i].status << "Time:" << perfResults[i].time << "milliseconds" << "Memory need:" << perfResults[i].memory;
+                RUN_CUDNN(cudnnSetConvolutionGroupCount(m_convolutionDescriptor, (int) m_groupCount));
 
-                    displayConvolutionAlgorithm(perfResults[i].algo);
+                if constexpr (IsReducedPrecision<DataType>::value)
+                {
+                    RUN_CUDNN(cudnnSetConvolutionMathType(m_convolutionDescriptor, CUDNN_TENSOR_OP_MATH));
                 }
 
-                qDebug() << "----------------------------------------------------------------------------";
-
-                if (m_convolutionForwardAlgorithm != perfResults[0].algo)
+                // a plan or another operator of the same shape spares the search
+                ConvolutionAlgorithmCache &algorithmCache = ConvolutionAlgorithmCache::getSingleton();
+                const unsigned int inputShape[4] = {batchSize, channelCount, originalHeight, originalWidth};
+                const unsigned int filterShape[4] = {filterCount, filterChannelCount, filterSize, filterSize};
+                std::string cacheKey = algorithmCache.key(ConvolutionAlgorithmCache::Direction::FORWARD, m_deviceId, (int) dataType,
+                                                          inputShape, filterShape, m_zeroPaddingX, m_zeroPaddingY, m_strideX, m_strideY);
+                size_t workspaceLimit = algorithmCache.workspaceLimit();
+                int cachedAlgorithm = 0;
+                bool isFound = m_isPlanned;
+
+                if (!isFound && algorithmCache.find(cacheKey, cachedAlgorithm))
                 {
-                    m_convolutionForwardAlgorithm = perfResults[0].algo;
-                    m_workspaceSize = perfResults[0].memory;
+                    m_convolutionForwardAlgorithm = (cudnnConvolutionFwdAlgo_t) cachedAlgorithm;
+                    isFound = true;
                 }
 
-                if (m_workspaceSize)
+                if (isFound)
+                {
+                    RUN_CUDNN(cudnnGetConvolutionForwardWorkspaceSize( Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId),
+                                                                       m_inputGPUTensorDescriptor,
+                                                                       m_filterDescriptor,
+                                                                       m_convolutionDescriptor,
+                                                                       m_outputGPUTensorDescriptor,
+                                                                       m_convolutionForwardAlgorithm,
+                                                                       &m_workspaceSize));
+                }
+                else
                 {
-                    RUN_CUDA(cudaMalloc(&m_workspace, m_workspaceSize));
+                    RUN_CUDNN(cudnnGetConvolutionForwardAlgorithm( Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId),
+                                                                   m_inputGPUTensorDescriptor,
+                                                                   m_filterDescriptor,
+                                                                   m_convolutionDescriptor,
+                                                                   m_outputGPUTensorDescriptor,
+                                                                   workspaceLimit ? CUDNN_CONVOLUTION_FWD_SPECIFY_WORKSPACE_LIMIT : CUDNN_CONVOLUTION_FWD_PREFER_FASTEST,
+                                                                   workspaceLimit,
+                                                                   &m_convolutionForwardAlgorithm));
+
+                    qDebug() << "Convolution forward algorithm find based on huristic:";
+                    displayConvolutionAlgorithm(m_convolutionForwardAlgorithm);
+
+                    RUN_CUDNN(cudnnGetConvolutionForwardWorkspaceSize( Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId),
+                                                                              m_inputGPUTensorDescriptor,
+                                                                              m_filterDescriptor,
+                                                                              m_convolutionDescriptor,
+                                                                              m_outputGPUTensorDescriptor,
+                                                                              m_convolutionForwardAlgorithm,
+                                                                              &m_workspaceSize));
+                    qDebug() << "Required workspace size:" << m_workspaceSize;
+
+
+                    int returnedAlgoCount = 0;
+                    const int requestedAlgoCount = 20;
+                    cudnnConvolutionFwdAlgoPerf_t perfResults[requestedAlgoCount];
+
+                    RUN_CUDNN(cudnnFindConvolutionForwardAlgorithm(  Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId),
+                                                                     m_inputGPUTensorDescriptor,
+                                                                     m_filterDescriptor,
+                                                                     m_convolutionDescriptor,
+                                                                     m_outputGPUTensorDescriptor,
+                                                                     requestedAlgoCount,
+                                                                     &returnedAlgoCount,
+                                                                     perfResults));
+
+                    qDebug() << returnedAlgoCount << "convolution forward algorithm benchmarks:";
+
+                    for(int i =0;i<returnedAlgoCount;++i)
+                    {
+                        qDebug() << i << "Status:" << perfResults[i].status << "Time:" << perfResults[i].time << "milliseconds" << "Memory need:" << perfResults[i].memory;
+
+                        displayConvolutionAlgorithm(perfResults[i].algo);
+                    }
+
+                    qDebug() << "----------------------------------------------------------------------------";
+
+                    // the fastest that fits the limit, the heuristic's choice otherwise
+                    for (int i = 0; i < returnedAlgoCount; ++i)
+                    {
+                        if (perfResults[i].status == CUDNN_STATUS_SUCCESS && (!workspaceLimit || perfResults[i].memory <= workspaceLimit))
+                        {
+                            m_convolutionForwardAlgorithm = perfResults[i].algo;
+                            m_workspaceSize = perfResults[i].memory;
+                            break;
+                        }
+                    }
+
+                    algorithmCache.insert(cacheKey, (int) m_convolutionForwardAlgorithm);
                 }
+
+                Context<DeviceUsed>::getSingleton().reserveWorkspace(m_deviceId, m_workspaceSize);
+
+                m_gpuBatchSize = batchSize;
             }
 
             return true;
         }
 
+        // Another batch than the one of init, see Model::setBatchSize. The algorithm found for the
+        // allocated batch is kept, only the descriptors and, when it needs more, the workspace change.
+        void setGPUBatchSize(unsigned int batchSize)
+        {
+            setDescriptorBatchSize(m_inputGPUTensorDescriptor, batchSize);
+            setDescriptorBatchSize(m_outputGPUTensorDescriptor, batchSize);
+
+            size_t workspaceSize = 0;
+            RUN_CUDNN(cudnnGetConvolutionForwardWorkspaceSize( Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId),
+                                                               m_inputGPUTensorDescriptor,
+                                                               m_filterDescriptor,
+                                                               m_convolutionDescriptor,
+                                                               m_outputGPUTensorDescriptor,
+                                                               m_convolutionForwardAlgorithm,
+                                                               &workspaceSize));
+
+            Context<DeviceUsed>::getSingleton().reserveWorkspace(m_deviceId, workspaceSize);
+            m_workspaceSize = workspaceSize;
+
+            m_gpuBatchSize = batchSize;
+        }
+
         virtual void evaluate() override
         {
             CHECK_GPU;
 
-            Tensor<DeviceUsed, DataType> *_input = input("Input")->template toType<DataType>();
-            Tensor<DeviceUsed, DataType> *_featureMap = input("FeatureMap")->template toType<DataType>();
-            Tensor<DeviceUsed, DataType> *_bias = input("Bias")->template toType<DataType>();
-            Tensor<DeviceUsed, DataType> *_output = output("Output")->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_input = input(INPUT)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_featureMap = input(FEATURE_MAP)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_bias = input(BIAS)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_output = output(OUTPUT)->template toType<DataType>();
 
             unsigned int featureMapCount = _featureMap->shape()[3];
             unsigned int featureMapLength = _featureMap->shape()[1];
@@ -312,9 +630,6 @@ namespace FreeWill
             unsigned int originalWidth = _input->shape()[1];
             unsigned int originalHeight = _input->shape()[2];
 
-            unsigned int channelCount = _featureMap->shape()[0];
-
-            
             unsigned int newWidth = (originalWidth - featureMapLength + 2 * m_zeroPaddingX ) / m_strideX + 1;
             unsigned int newHeight = (originalHeight - featureMapLength + 2 * m_zeroPaddingY) / m_strideY + 1;
 
@@ -322,62 +637,80 @@ namespace FreeWill
 
             if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
             {
-                for (unsigned int b = 0; b < batchSize; ++b)
-                {
+                ConvolutionGeometryCPU geometry = geometryCPU();
 
-                    for(unsigned int newIndexY = 0; newIndexY < newHeight;++newIndexY)
-                    {
-                        for (unsigned int newIndexX = 0; newIndexX < newWidth;++newIndexX)
-                        {
+                const DataType *featureMap = _featureMap->cpuDataHandle();
+                const DataType *bias = _bias->cpuDataHandle();
 
-                            int startX = -m_zeroPaddingX + newIndexX * m_strideX;
-                            int startY = -m_zeroPaddingY + newIndexY * m_strideY;
+                if (m_hasNormalization)
+                {
+                    foldBatchNormalizationCPU<DataType>(featureMap, bias,
+                                                        input(NORMALIZATION_SCALE)->template toType<DataType>()->cpuDataHandle(),
+                                                        input(NORMALIZATION_SHIFT)->template toType<DataType>()->cpuDataHandle(),
+                                                        input(NORMALIZATION_MEAN)->template toType<DataType>()->cpuDataHandle(),
+                                                        input(NORMALIZATION_VARIANCE)->template toType<DataType>()->cpuDataHandle(),
+                                                        m_normalizationEpsilon, featureMapCount, _featureMap->shape().size() / featureMapCount,
+                                                        m_foldedFeatureMap.data(), m_foldedBias.data());
+
+                    featureMap = m_foldedFeatureMap.data();
+                    bias = m_foldedBias.data();
+                }
 
-                            for (unsigned int k = 0; k < featureMapCount; ++k)
-                            {
-                                unsigned int resultBaseIndex = (b * newWidth*newHeight +newIndexY * newWidth + newIndexX) * featureMapCount;
+                GEMMEpilogueCPU<DataType> epilogue;
+                epilogue.m_rowBias = bias;
+                epilogue.m_hasActivation = m_hasActivation;
+                epilogue.m_activationMode = m_activationMode;
 
+                if (m_clearsOutput && m_cpuAlgorithm != ConvolutionAlgorithmCPU::CHANNEL_BLOCKED_DIRECT)
+                {
+                    _output->clear();
+                }
 
-                                for(int y = 0; y< (int)featureMapLength; ++y)
-                                {
-                                    for(int x = 0; x < (int)featureMapLength; ++x)
-                                    {
-                                        int realX = x + startX;
-                                        int realY = y + startY;
-
-                                        if ((realX >= 0 && realX < (int)originalWidth)
-                                            && (realY>=0 && realY< (int)originalHeight))
-                                        {
-                                            unsigned int originalBaseIndex = (b* originalHeight * originalWidth + realY*originalWidth + realX)
-                                                *channelCount;
-                                
-                                            for(unsigned int c = 0;c<channelCount;++c)
-                                            {
-                                                (*_output)[resultBaseIndex + k] +=
-                                                    (*_featureMap)[(k * (featureMapLength * featureMapLength) +
-                                                        y*featureMapLength +x) * channelCount + c]
-                                                    * (*_input)[originalBaseIndex + c];
-                                            }
-                                        
-                                            //qDebug() << "base index" << realX << ";" << realY << ";" <<originalWidth <<";"<< originalBaseIndex;
-                                            //qDebug() << "feature map" << (*_featureMap)[(k * (featureMapLength * featureMapLength) +
-                                            //            y*featureMapLength +x) * channelCount + 0];
-                                            //qDebug() << (*_input)[originalBaseIndex ];
-                                        }
-                                    }
-                                }
+                if (m_cpuAlgorithm == ConvolutionAlgorithmCPU::CHANNEL_BLOCKED_DIRECT)
+                {
+                    // overwrites the output, bias and activation included
+                    convolutionChannelBlockedCPU<DataType>(_input->layout(), geometry, batchSize, _input->cpuDataHandle(),
+                                                           featureMap, _output->cpuDataHandle(), m_cpuWorkspace, epilogue,
+                                                           m_channelBlockedConvolution);
+                }
+                else if (m_cpuAlgorithm == ConvolutionAlgorithmCPU::DEPTHWISE_DIRECT)
+                {
+                    convolutionDepthwiseCPU<DataType>(geometry, batchSize, _input->cpuDataHandle(),
+                                                      featureMap, _output->cpuDataHandle(), m_cpuWorkspace, epilogue,
+                                                      m_depthwiseConvolution);
+                }
+                else if (m_cpuAlgorithm == ConvolutionAlgorithmCPU::GROUPED_IM2COL_GEMM)
+                {
+                    convolutionGroupedCPU<DataType>(geometry, m_groupCount, batchSize, _input->cpuDataHandle(),
+                                                    featureMap, _output->cpuDataHandle(), m_cpuWorkspace, m_cpuGroupWorkspace, epilogue);
+                }
+                else if (m_cpuAlgorithm == ConvolutionAlgorithmCPU::WINOGRAD_2X2_3X3)
+                {
+                    convolutionWinogradCPU<DataType>(geometry, batchSize, _input->cpuDataHandle(),
+                                                     featureMap, _output->cpuDataHandle(), m_cpuWorkspace);
 
-                                //qDebug() << "result loc" << resultBaseIndex + k;
+                    DataType *outputData = _output->cpuDataHandle();
+                    size_t pixelCount = (size_t) batchSize * newWidth * newHeight;
 
-                                (*_output)[resultBaseIndex + k] += (*_bias)[k];
-                            }
-                        }
+                    for(size_t p = 0; p < pixelCount; ++p)
+                    {
+                        epilogue.apply(outputData + p * featureMapCount, featureMapCount);
                     }
                 }
-
+                else
+                {
+                    // bias and activation are applied in the gemm writeback
+                    convolutionIm2colCPU<DataType>(geometry, batchSize, _input->cpuDataHandle(),
+                                                   featureMap, _output->cpuDataHandle(), m_cpuWorkspace, &epilogue, m_im2col);
+                }
             }
             else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
             {
+                if (batchSize != m_gpuBatchSize)
+                {
+                    setGPUBatchSize(batchSize);
+                }
+
                 if (m_workspaceSize != 0)
                 {
                     qDebug() << "Convolution forward algorithm requires workspace!";
@@ -385,6 +718,31 @@ namespace FreeWill
 
                 float alpha = 1.0;
                 float beta = 0.0;
+
+                if (m_hasActivation)
+                {
+                    // the output doubles as z, alpha2 being zero it is not read
+                    RUN_CUDNN(cudnnConvolutionBiasActivationForward( Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId),
+                                                                     &alpha,
+                                                                     m_inputGPUTensorDescriptor,
+                                                                     _input->gpuDataHandle(),
+                                                                     m_filterDescriptor,
+                                                                     _featureMap->gpuDataHandle(),
+                                                                     m_convolutionDescriptor,
+                                                                     m_convolutionForwardAlgorithm,
+                                                                     Context<DeviceUsed>::getSingleton().workspace(m_deviceId),
+                                                                     m_workspaceSize,
+                                                                     &beta,
+                                                                     m_outputGPUTensorDescriptor,
+                                                                     _output->gpuDataHandle(),
+                                                                     m_biasGPUTensorDescriptor,
+                                                                     _bias->gpuDataHandle(),
+                                                                     m_activationDescriptor,
+                                                                     m_outputGPUTensorDescriptor,
+                                                                     _output->gpuDataHandle()));
+                    return;
+                }
+
                 RUN_CUDNN(cudnnConvolutionForward( Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId),
                                                    &alpha,
                                                    m_inputGPUTensorDescriptor,
@@ -393,7 +751,7 @@ namespace FreeWill
                                                    _featureMap->gpuDataHandle(),
                                                    m_convolutionDescriptor,
                                                    m_convolutionForwardAlgorithm,
-                                                   m_workspace,
+                                                   Context<DeviceUsed>::getSingleton().workspace(m_deviceId),
                                                    m_workspaceSize,
                                                    &beta,
                                                    m_outputGPUTensorDescriptor,
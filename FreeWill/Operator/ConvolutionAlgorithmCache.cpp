@@ -0,0 +1,173 @@
+#include "ConvolutionAlgorithmCache.h"
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <cuda_runtime.h>
+#include <cudnn.h>
+
+FreeWill::ConvolutionAlgorithmCache::ConvolutionAlgorithmCache()
+    :m_mutex(),
+      m_algorithms(),
+      m_deviceNames(),
+      m_filename(),
+      m_workspaceLimit(0)
+{}
+
+FreeWill::ConvolutionAlgorithmCache &FreeWill::ConvolutionAlgorithmCache::getSingleton()
+{
+    static ConvolutionAlgorithmCache obj;
+    return obj;
+}
+
+const std::string &FreeWill::ConvolutionAlgorithmCache::deviceName(int deviceId)
+{
+    std::map<int, std::string>::iterator iter = m_deviceNames.find(deviceId);
+
+    if (iter == m_deviceNames.end())
+    {
+        cudaDeviceProp properties;
+        std::string name = "unknown";
+
+        if (cudaGetDeviceProperties(&properties, deviceId) == cudaSuccess)
+        {
+            name = properties.name;
+        }
+
+        // the key is one word
+        std::replace(name.begin(), name.end(), ' ', '_');
+
+        iter = m_deviceNames.insert({deviceId, name}).first;
+    }
+
+    return iter->second;
+}
+
+std::string FreeWill::ConvolutionAlgorithmCache::key(Direction direction, int deviceId, int dataType,
+                                                     const unsigned int input[4], const unsigned int filter[4],
+                                                     unsigned int zeroPaddingX, unsigned int zeroPaddingY,
+                                                     unsigned int strideX, unsigned int strideY)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    static const char *directionNames[] = {"forward", "backwardFilter", "backwardData"};
+
+    std::ostringstream stream;
+    stream << directionNames[(int) direction] << "/" << deviceName(deviceId) << "/" << cudnnGetVersion() << "/" << dataType
+           << "/" << input[0] << "x" << input[1] << "x" << input[2] << "x" << input[3]
+           << "/" << filter[0] << "x" << filter[1] << "x" << filter[2] << "x" << filter[3]
+           << "/" << zeroPaddingY << "x" << zeroPaddingX << "/" << strideY << "x" << strideX << "/" << m_workspaceLimit;
+
+    return stream.str();
+}
+
+bool FreeWill::ConvolutionAlgorithmCache::find(const std::string &key, int &algorithm)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::map<std::string, int>::const_iterator iter = m_algorithms.find(key);
+
+    if (iter == m_algorithms.end())
+    {
+        return false;
+    }
+
+    algorithm = iter->second;
+    return true;
+}
+
+void FreeWill::ConvolutionAlgorithmCache::insert(const std::string &key, int algorithm)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_algorithms[key] = algorithm;
+
+    if (!m_filename.empty())
+    {
+        // one line per write, processes sharing the file may only interleave whole entries
+        std::ostringstream line;
+        line << key << " " << algorithm << "\n";
+
+        std::ofstream file(m_filename, std::ios::app);
+        file << line.str() << std::flush;
+
+        if (!file)
+        {
+            std::cerr << "can't append to " << m_filename << std::endl;
+        }
+    }
+}
+
+bool FreeWill::ConvolutionAlgorithmCache::open(const std::string &filename)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_filename = filename;
+
+    std::ifstream file(filename);
+
+    if (!file)
+    {
+        // a missing file is created by the first insert
+        if (errno == ENOENT)
+        {
+            return true;
+        }
+
+        std::cerr << "can't read " << filename << std::endl;
+        m_filename.clear();
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::istringstream stream(line);
+        std::string key;
+        int algorithm = 0;
+
+        // a line cut short by a crashed writer is skipped
+        if (stream >> key >> algorithm)
+        {
+            m_algorithms[key] = algorithm;
+        }
+    }
+
+    return true;
+}
+
+void FreeWill::ConvolutionAlgorithmCache::close()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_filename.clear();
+}
+
+void FreeWill::ConvolutionAlgorithmCache::setWorkspaceLimit(size_t workspaceLimit)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_workspaceLimit = workspaceLimit;
+}
+
+size_t FreeWill::ConvolutionAlgorithmCache::workspaceLimit()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return m_workspaceLimit;
+}
+
+void FreeWill::ConvolutionAlgorithmCache::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_algorithms.clear();
+}
+
+size_t FreeWill::ConvolutionAlgorithmCache::size()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return m_algorithms.size();
+}
@@ -0,0 +1,65 @@
+#ifndef CONVOLUTIONALGORITHMCACHE_H
+#define CONVOLUTIONALGORITHMCACHE_H
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace FreeWill
+{
+    // The cuDNN algorithms Convolution and ConvolutionDerivative benchmarked, shared by every
+    // operator of the process so that replicas and layers of the same shape search once. Keyed
+    // by the direction, the gpu model and cuDNN version, the data type, the input and filter
+    // shapes, padding, stride and the workspace limit. With a file opened, entries found in it
+    // are used without benchmarking and every new result is appended to it, so the next
+    // process starts with the algorithms of this one.
+    class ConvolutionAlgorithmCache
+    {
+    public:
+        enum class Direction
+        {
+            FORWARD,
+            BACKWARD_FILTER,
+            BACKWARD_DATA
+        };
+
+    private:
+        std::mutex m_mutex;
+        std::map<std::string, int> m_algorithms;
+        std::map<int, std::string> m_deviceNames;
+        std::string m_filename;
+        // the largest workspace a searched algorithm may need, 0 for no limit. It bounds the
+        // workspace every device shares between its operators (Context::reserveWorkspace).
+        size_t m_workspaceLimit;
+
+        ConvolutionAlgorithmCache();
+
+        const std::string &deviceName(int deviceId);
+
+    public:
+        static ConvolutionAlgorithmCache &getSingleton();
+
+        ConvolutionAlgorithmCache(const ConvolutionAlgorithmCache &) = delete;
+        void operator=(const ConvolutionAlgorithmCache &) = delete;
+
+        // input is n c h w, filter k c h w, both as cuDNN sees them
+        std::string key(Direction direction, int deviceId, int dataType, const unsigned int input[4], const unsigned int filter[4],
+                        unsigned int zeroPaddingX, unsigned int zeroPaddingY, unsigned int strideX, unsigned int strideY);
+
+        bool find(const std::string &key, int &algorithm);
+        void insert(const std::string &key, int algorithm);
+
+        // reads the entries of filename, which doesn't have to exist yet, and appends new ones to it
+        bool open(const std::string &filename);
+        void close();
+
+        void setWorkspaceLimit(size_t workspaceLimit);
+        size_t workspaceLimit();
+
+        void clear();
+        size_t size();
+    };
+}
+
+#endif
@@ -3,6 +3,10 @@
 
 #include "Operator.h"
 #include "../Context/Context.h"
+#include "Convolution_CPU.h"
+#include "GroupedConvolution_CPU.h"
+#include "ConvolutionAlgorithmCache.h"
+#include <sstream>
 
 namespace FreeWill
 {
@@ -19,6 +23,7 @@ namespace FreeWill
         unsigned int m_strideY;
         unsigned int m_zeroPaddingX;
         unsigned int m_zeroPaddingY;
+        unsigned int m_groupCount;
 
         cudnnTensorDescriptor_t m_prevActivationGPUTensorDescriptor;
         cudnnTensorDescriptor_t m_outputDeltaGPUTensorDescriptor;
@@ -28,13 +33,23 @@ namespace FreeWill
         cudnnConvolutionDescriptor_t m_convolutionDescriptor;
         cudnnConvolutionBwdFilterAlgo_t m_filterBackwardAlgorithm;
         cudnnConvolutionBwdDataAlgo_t m_prevActivationDeltaAlgorithm;
-        unsigned char *m_filterBackwardAlgorithmWorkspace;
+        // both algorithms came with setPlan(), init() doesn't search
+        bool m_isPlanned;
+        // what each algorithm needs of the device's shared workspace, they run one after another
         size_t m_filterBackwardAlgorithmWorkspaceSize;
-        unsigned char *m_prevActivationDeltaAlgorithmWorkspace;
         size_t m_prevActivationDeltaAlgorithmWorkspaceSize;
+        unsigned int m_gpuBatchSize;
+        // on gpu, add to FeatureMapGrad and BiasGrad instead of overwriting them, the cpu always adds
+        bool m_isAccumulating;
 
+        std::vector<DataType> m_cpuWorkspace;
+        // the packed channels of a group when there are several but not one a channel
+        std::vector<DataType> m_cpuGroupWorkspace;
 
     public:
+        enum InputSlot : unsigned int {PREV_ACTIVATION, OUTPUT_GRAD, FEATURE_MAP};
+        enum OutputSlot : unsigned int {FEATURE_MAP_GRAD, BIAS_GRAD, INPUT_GRAD};
+
         ConvolutionDerivative(unsigned int strideX = 1, unsigned int strideY = 1,
                 unsigned int zeroPaddingX = 0, unsigned int zeroPaddingY = 0, unsigned int deviceId = 0)
             :Operator<DeviceUsed>({"PrevActivation","OutputGrad","FeatureMap"},{"FeatureMapGrad","BiasGrad","InputGrad"}, deviceId),
@@ -42,6 +57,7 @@ namespace FreeWill
             m_strideY(strideY),
             m_zeroPaddingX(zeroPaddingX),
             m_zeroPaddingY(zeroPaddingY),
+            m_groupCount(1),
             m_prevActivationGPUTensorDescriptor(0),
             m_outputDeltaGPUTensorDescriptor(0),
             m_biasGradGPUTensorDescriptor(0),
@@ -50,10 +66,13 @@ namespace FreeWill
             m_convolutionDescriptor(0),
             m_filterBackwardAlgorithm(),
             m_prevActivationDeltaAlgorithm(),
-            m_filterBackwardAlgorithmWorkspace(nullptr),
+            m_isPlanned(false),
             m_filterBackwardAlgorithmWorkspaceSize(0),
-            m_prevActivationDeltaAlgorithmWorkspace(nullptr),
-            m_prevActivationDeltaAlgorithmWorkspaceSize(0)
+            m_prevActivationDeltaAlgorithmWorkspaceSize(0),
+            m_gpuBatchSize(0),
+            m_isAccumulating(false),
+            m_cpuWorkspace(),
+            m_cpuGroupWorkspace()
         {
             CHECK_GPU;
             if (DeviceUsed == DeviceType::GPU_CUDA)
@@ -85,19 +104,18 @@ namespace FreeWill
                 m_prevActivationDeltaGPUTensorDescriptor = 0;
                 m_featureMapFilterDescriptor = 0;
                 m_convolutionDescriptor = 0;
+            }
+        }
 
-                if (m_filterBackwardAlgorithmWorkspace)
-                {
-                    RUN_CUDA(cudaFree(m_filterBackwardAlgorithmWorkspace));
-                    m_filterBackwardAlgorithmWorkspace = nullptr;
-                }
+        void setAccumulating(bool isAccumulating)
+        {
+            m_isAccumulating = isAccumulating;
+        }
 
-                if (m_prevActivationDeltaAlgorithmWorkspace)
-                {
-                    RUN_CUDA(cudaFree(m_prevActivationDeltaAlgorithmWorkspace));
-                    m_prevActivationDeltaAlgorithmWorkspace = nullptr;
-                }
-            }
+        // the groups of its Convolution, see Convolution::setGroupCount; set before init
+        void setGroupCount(unsigned int groupCount)
+        {
+            m_groupCount = groupCount;
         }
 
         void displayFilterBackwardAlgorithm(cudnnConvolutionBwdFilterAlgo_t algorithm)
@@ -116,6 +134,34 @@ namespace FreeWill
             }
         }
 
+        // on gpu the filter and the data backward algorithms
+        virtual std::string plan() const override
+        {
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                return std::to_string((int) m_filterBackwardAlgorithm) + " " + std::to_string((int) m_prevActivationDeltaAlgorithm);
+            }
+
+            return std::string();
+        }
+
+        virtual void setPlan(const std::string &plan) override
+        {
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                std::istringstream stream(plan);
+                int filterAlgorithm = 0;
+                int dataAlgorithm = 0;
+
+                if (stream >> filterAlgorithm >> dataAlgorithm)
+                {
+                    m_filterBackwardAlgorithm = (cudnnConvolutionBwdFilterAlgo_t) filterAlgorithm;
+                    m_prevActivationDeltaAlgorithm = (cudnnConvolutionBwdDataAlgo_t) dataAlgorithm;
+                    m_isPlanned = true;
+                }
+            }
+        }
+
         void displayPrevActivationDeltaAlgorithm(cudnnConvolutionBwdDataAlgo_t algorithm)
         {
             QString message = "Convolution PrevActivation delta algorithm:";
@@ -140,7 +186,9 @@ namespace FreeWill
 
             FAIL_IF (!output("FeatureMapGrad") || !output("BiasGrad") || !output("InputGrad"));
 
-            FAIL_IF (input("PrevActivation")->shape()[0] != input("FeatureMap")->shape()[0]);
+            FAIL_IF (m_groupCount == 0 || input("PrevActivation")->shape()[0] != input("FeatureMap")->shape()[0] * m_groupCount);
+
+            FAIL_IF (input("FeatureMap")->shape()[3] % m_groupCount);
 
             FAIL_IF (input("PrevActivation")->shape().dimension() != 4);
 
@@ -182,6 +230,7 @@ namespace FreeWill
                 unsigned int channelCount = input("PrevActivation")->shape()[0];
                 unsigned int batchSize = input("PrevActivation")->shape()[3];
 
+                unsigned int filterChannelCount = input("FeatureMap")->shape()[0];
                 unsigned int filterCount = input("FeatureMap")->shape()[3];
 
                 cudnnDataType_t dataType = CUDNN_DATA_FLOAT;
@@ -193,6 +242,14 @@ namespace FreeWill
                 {
                     dataType = CUDNN_DATA_DOUBLE;
                 }
+                else if constexpr (std::is_same<DataType,Half>::value)
+                {
+                    dataType = CUDNN_DATA_HALF;
+                }
+                else if constexpr (std::is_same<DataType,BFloat16>::value)
+                {
+                    dataType = CUDNN_DATA_BFLOAT16;
+                }
 
                 RUN_CUDNN(cudnnSetTensor4dDescriptor( m_prevActivationGPUTensorDescriptor,
                                                       CUDNN_TENSOR_NHWC,
@@ -244,10 +301,11 @@ namespace FreeWill
                                                       dataType,
                                                       CUDNN_TENSOR_NHWC,
                                                       filterCount,
-                                                      channelCount,
+                                                      filterChannelCount,
                                                       filterSize,
                                                       filterSize));
 
+                // the compute type, float accumulation for 16-bit data
                 cudnnDataType_t cudnnDataType = cudnnDataType_t::CUDNN_DATA_FLOAT;
 
                 if constexpr (std::is_same<DataType, float>::value)
@@ -269,137 +327,238 @@ namespace FreeWill
                                                            1,
                                                            CUDNN_CROSS_CORRELATION, cudnnDataType));
 
+                RUN_CUDNN(cudnnSetConvolutionGroupCount(m_convolutionDescriptor, (int) m_groupCount));
 
-                RUN_CUDNN(cudnnGetConvolutionBackwardFilterAlgorithm( Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId),
-                                                                      m_prevActivationGPUTensorDescriptor,
-                                                                      m_outputDeltaGPUTensorDescriptor,
-                                                                      m_convolutionDescriptor,
-                                                                      m_featureMapFilterDescriptor,
-                                                                      CUDNN_CONVOLUTION_BWD_FILTER_PREFER_FASTEST,
-                                                                      0,
-                                                                      &m_filterBackwardAlgorithm ));
-
-                displayFilterBackwardAlgorithm(m_filterBackwardAlgorithm);
-
-                RUN_CUDNN(cudnnGetConvolutionBackwardFilterWorkspaceSize(Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId),
-                                                                         m_prevActivationGPUTensorDescriptor,
-                                                                         m_outputDeltaGPUTensorDescriptor,
-                                                                         m_convolutionDescriptor,
-                                                                         m_featureMapFilterDescriptor,
-                                                                         m_filterBackwardAlgorithm,
-                                                                         &m_filterBackwardAlgorithmWorkspaceSize));
-
-                qDebug() << "workspace size:" << m_filterBackwardAlgorithmWorkspaceSize;
-
-                const int requestedFilterAlgoCount = 6;
-                cudnnConvolutionBwdFilterAlgoPerf_t filterBackwardPerfResults[requestedFilterAlgoCount];
-                int returnedFilterAlgoCount = 0;
-
-                RUN_CUDNN(cudnnFindConvolutionBackwardFilterAlgorithm( Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId),
-                                                                       m_prevActivationGPUTensorDescriptor,
-                                                                       m_outputDeltaGPUTensorDescriptor,
-                                                                       m_convolutionDescriptor,
-                                                                       m_featureMapFilterDescriptor,
-                                                                       requestedFilterAlgoCount,
-                                                                       &returnedFilterAlgoCount,
-                                                                       filterBackwardPerfResults ));
-
-                qDebug() << returnedFilterAlgoCount << "convolution filter backward algorithm benchmarks:";
-
-                for(int i =0;i<returnedFilterAlgoCount;++i)
+                if constexpr (IsReducedPrecision<DataType>::value)
                 {
-                    qDebug() << i << "Status:" << filterBackwardPerfResults[i].status 
-                        << "Time:" << filterBackwardPerfResults[i].time << "milliseconds" 
-                        << "Memory need:" << filterBackwardPerfResults[i].memory;
+                    RUN_CUDNN(cudnnSetConvolutionMathType(m_convolutionDescriptor, CUDNN_TENSOR_OP_MATH));
+                }
 
-                    displayFilterBackwardAlgorithm(filterBackwardPerfResults[i].algo);
+                // a plan or another operator of the same shape spares the searches
+                ConvolutionAlgorithmCache &algorithmCache = ConvolutionAlgorithmCache::getSingleton();
+                const unsigned int inputShape[4] = {batchSize, channelCount, originalHeight, originalWidth};
+                const unsigned int filterShape[4] = {filterCount, filterChannelCount, filterSize, filterSize};
+                std::string filterCacheKey = algorithmCache.key(ConvolutionAlgorithmCache::Direction::BACKWARD_FILTER, m_deviceId, (int) dataType,
+                                                                inputShape, filterShape, m_zeroPaddingX, m_zeroPaddingY, m_strideX, m_strideY);
+                std::string dataCacheKey = algorithmCache.key(ConvolutionAlgorithmCache::Direction::BACKWARD_DATA, m_deviceId, (int) dataType,
+                                                              inputShape, filterShape, m_zeroPaddingX, m_zeroPaddingY, m_strideX, m_strideY);
+                size_t workspaceLimit = algorithmCache.workspaceLimit();
+                int cachedAlgorithm = 0;
+                bool isFilterAlgorithmFound = m_isPlanned;
+                bool isDataAlgorithmFound = m_isPlanned;
+
+                if (!isFilterAlgorithmFound && algorithmCache.find(filterCacheKey, cachedAlgorithm))
+                {
+                    m_filterBackwardAlgorithm = (cudnnConvolutionBwdFilterAlgo_t) cachedAlgorithm;
+                    isFilterAlgorithmFound = true;
                 }
 
-                if (filterBackwardPerfResults[0].algo != m_filterBackwardAlgorithm)
+                if (!isDataAlgorithmFound && algorithmCache.find(dataCacheKey, cachedAlgorithm))
                 {
-                    m_filterBackwardAlgorithm = filterBackwardPerfResults[0].algo;
-                    m_filterBackwardAlgorithmWorkspaceSize = filterBackwardPerfResults[0].memory;
+                    m_prevActivationDeltaAlgorithm = (cudnnConvolutionBwdDataAlgo_t) cachedAlgorithm;
+                    isDataAlgorithmFound = true;
                 }
 
-                if (m_filterBackwardAlgorithmWorkspaceSize > 0)
+                if (isFilterAlgorithmFound)
                 {
-                    RUN_CUDA(cudaMalloc(&m_filterBackwardAlgorithmWorkspace, m_filterBackwardAlgorithmWorkspaceSize));
+                    RUN_CUDNN(cudnnGetConvolutionBackwardFilterWorkspaceSize(Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId),
+                                                                             m_prevActivationGPUTensorDescriptor,
+                                                                             m_outputDeltaGPUTensorDescriptor,
+                                                                             m_convolutionDescriptor,
+                                                                             m_featureMapFilterDescriptor,
+                                                                             m_filterBackwardAlgorithm,
+                                                                             &m_filterBackwardAlgorithmWorkspaceSize));
                 }
+                else
+                {
+                    RUN_CUDNN(cudnnGetConvolutionBackwardFilterAlgorithm( Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId),
+                                                                          m_prevActivationGPUTensorDescriptor,
+                                                                          m_outputDeltaGPUTensorDescriptor,
+                                                                          m_convolutionDescriptor,
+                                                                          m_featureMapFilterDescriptor,
+                                                                          workspaceLimit ? CUDNN_CONVOLUTION_BWD_FILTER_SPECIFY_WORKSPACE_LIMIT : CUDNN_CONVOLUTION_BWD_FILTER_PREFER_FASTEST,
+                                                                          workspaceLimit,
+                                                                          &m_filterBackwardAlgorithm ));
+
+                    displayFilterBackwardAlgorithm(m_filterBackwardAlgorithm);
+
+                    RUN_CUDNN(cudnnGetConvolutionBackwardFilterWorkspaceSize(Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId),
+                                                                             m_prevActivationGPUTensorDescriptor,
+                                                                             m_outputDeltaGPUTensorDescriptor,
+                                                                             m_convolutionDescriptor,
+                                                                             m_featureMapFilterDescriptor,
+                                                                             m_filterBackwardAlgorithm,
+                                                                             &m_filterBackwardAlgorithmWorkspaceSize));
+
+                    qDebug() << "workspace size:" << m_filterBackwardAlgorithmWorkspaceSize;
+
+                    const int requestedFilterAlgoCount = 6;
+                    cudnnConvolutionBwdFilterAlgoPerf_t filterBackwardPerfResults[requestedFilterAlgoCount];
+                    int returnedFilterAlgoCount = 0;
+
+                    RUN_CUDNN(cudnnFindConvolutionBackwardFilterAlgorithm( Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId),
+                                                                           m_prevActivationGPUTensorDescriptor,
+                                                                           m_outputDeltaGPUTensorDescriptor,
+                                                                           m_convolutionDescriptor,
+                                                                           m_featureMapFilterDescriptor,
+                                                                           requestedFilterAlgoCount,
+                                                                           &returnedFilterAlgoCount,
+                                                                           filterBackwardPerfResults ));
+
+                    qDebug() << returnedFilterAlgoCount << "convolution filter backward algorithm benchmarks:";
+
+                    for(int i =0;i<returnedFilterAlgoCount;++i)
+                    {
+                        qDebug() << i << "Status:" << filterBackwardPerfResults[i].status 
+                            << "Time:" << filterBackwardPerfResults[i].time << "milliseconds" 
+                            << "Memory need:" << filterBackwardPerfResults[i].memory;
 
-                qDebug() << "----------------------------------------------------------------------------";
+                        displayFilterBackwardAlgorithm(filterBackwardPerfResults[i].algo);
+                    }
 
+                    // the fastest that fits the limit, the heuristic's choice otherwise
+                    for (int i = 0; i < returnedFilterAlgoCount; ++i)
+                    {
+                        if (filterBackwardPerfResults[i].status == CUDNN_STATUS_SUCCESS &&
+                                (!workspaceLimit || filterBackwardPerfResults[i].memory <= workspaceLimit))
+                        {
+                            m_filterBackwardAlgorithm = filterBackwardPerfResults[i].algo;
+                            m_filterBackwardAlgorithmWorkspaceSize = filterBackwardPerfResults[i].memory;
+                            break;
+                        }
+                    }
 
-                RUN_CUDNN(cudnnGetConvolutionBackwardDataAlgorithm( Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId),
-                                                                    m_featureMapFilterDescriptor,
-                                                                    m_outputDeltaGPUTensorDescriptor,
-                                                                    m_convolutionDescriptor,
-                                                                    m_prevActivationDeltaGPUTensorDescriptor,
-                                                                    CUDNN_CONVOLUTION_BWD_DATA_PREFER_FASTEST,
-                                                                    0,
-                                                                    &m_prevActivationDeltaAlgorithm));
+                    algorithmCache.insert(filterCacheKey, (int) m_filterBackwardAlgorithm);
+                }
+
+                Context<DeviceUsed>::getSingleton().reserveWorkspace(m_deviceId, m_filterBackwardAlgorithmWorkspaceSize);
+
+                qDebug() << "----------------------------------------------------------------------------";
 
-                displayPrevActivationDeltaAlgorithm(m_prevActivationDeltaAlgorithm);
 
-                RUN_CUDNN(cudnnGetConvolutionBackwardDataWorkspaceSize( Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId),
+                if (isDataAlgorithmFound)
+                {
+                    RUN_CUDNN(cudnnGetConvolutionBackwardDataWorkspaceSize( Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId),
+                                                                            m_featureMapFilterDescriptor,
+                                                                            m_outputDeltaGPUTensorDescriptor,
+                                                                            m_convolutionDescriptor,
+                                                                            m_prevActivationDeltaGPUTensorDescriptor,
+                                                                            m_prevActivationDeltaAlgorithm,
+                                                                            &m_prevActivationDeltaAlgorithmWorkspaceSize));
+                }
+                else
+                {
+                    RUN_CUDNN(cudnnGetConvolutionBackwardDataAlgorithm( Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId),
                                                                         m_featureMapFilterDescriptor,
                                                                         m_outputDeltaGPUTensorDescriptor,
                                                                         m_convolutionDescriptor,
                                                                         m_prevActivationDeltaGPUTensorDescriptor,
-                                                                        m_prevActivationDeltaAlgorithm,
-                                                                        &m_prevActivationDeltaAlgorithmWorkspaceSize));
+                                                                        workspaceLimit ? CUDNN_CONVOLUTION_BWD_DATA_SPECIFY_WORKSPACE_LIMIT : CUDNN_CONVOLUTION_BWD_DATA_PREFER_FASTEST,
+                                                                        workspaceLimit,
+                                                                        &m_prevActivationDeltaAlgorithm));
 
-                qDebug() << "workspace size:" << m_prevActivationDeltaAlgorithmWorkspaceSize;
+                    displayPrevActivationDeltaAlgorithm(m_prevActivationDeltaAlgorithm);
 
-                const int requestedPrevActivationAlgoCount = 6;
-                cudnnConvolutionBwdDataAlgoPerf_t prevActivationPerfResults[requestedPrevActivationAlgoCount];
-                int returnedPrevActivationAlgoCount = 0;
+                    RUN_CUDNN(cudnnGetConvolutionBackwardDataWorkspaceSize( Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId),
+                                                                            m_featureMapFilterDescriptor,
+                                                                            m_outputDeltaGPUTensorDescriptor,
+                                                                            m_convolutionDescriptor,
+                                                                            m_prevActivationDeltaGPUTensorDescriptor,
+                                                                            m_prevActivationDeltaAlgorithm,
+                                                                            &m_prevActivationDeltaAlgorithmWorkspaceSize));
 
-                RUN_CUDNN(cudnnFindConvolutionBackwardDataAlgorithm( Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId),
-                                                                     m_featureMapFilterDescriptor,
-                                                                     m_outputDeltaGPUTensorDescriptor,
-                                                                     m_convolutionDescriptor,
-                                                                     m_prevActivationDeltaGPUTensorDescriptor,
-                                                                     requestedPrevActivationAlgoCount,
-                                                                     &returnedPrevActivationAlgoCount,
-                                                                     prevActivationPerfResults));
+                    qDebug() << "workspace size:" << m_prevActivationDeltaAlgorithmWorkspaceSize;
 
-                for(int i =0;i<returnedPrevActivationAlgoCount;++i)
-                {
-                    qDebug() << i << "Status:" << prevActivationPerfResults[i].status
-                        << "Time:" << prevActivationPerfResults[i].time << "milliseconds"
-                        << "Memory need:" << prevActivationPerfResults[i].memory;
+                    const int requestedPrevActivationAlgoCount = 6;
+                    cudnnConvolutionBwdDataAlgoPerf_t prevActivationPerfResults[requestedPrevActivationAlgoCount];
+                    int returnedPrevActivationAlgoCount = 0;
 
-                    displayPrevActivationDeltaAlgorithm(prevActivationPerfResults[i].algo);
-                }
+                    RUN_CUDNN(cudnnFindConvolutionBackwardDataAlgorithm( Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId),
+                                                                         m_featureMapFilterDescriptor,
+                                                                         m_outputDeltaGPUTensorDescriptor,
+                                                                         m_convolutionDescriptor,
+                                                                         m_prevActivationDeltaGPUTensorDescriptor,
+                                                                         requestedPrevActivationAlgoCount,
+                                                                         &returnedPrevActivationAlgoCount,
+                                                                         prevActivationPerfResults));
 
-                if (prevActivationPerfResults[0].algo != m_prevActivationDeltaAlgorithm)
-                {
-                    m_prevActivationDeltaAlgorithm = prevActivationPerfResults[0].algo;
-                    m_prevActivationDeltaAlgorithmWorkspaceSize = prevActivationPerfResults[0].memory;
-                }
+                    for(int i =0;i<returnedPrevActivationAlgoCount;++i)
+                    {
+                        qDebug() << i << "Status:" << prevActivationPerfResults[i].status
+                            << "Time:" << prevActivationPerfResults[i].time << "milliseconds"
+                            << "Memory need:" << prevActivationPerfResults[i].memory;
 
-                if (m_prevActivationDeltaAlgorithmWorkspaceSize > 0)
-                {
-                    RUN_CUDA(cudaMalloc(&m_prevActivationDeltaAlgorithmWorkspace, m_prevActivationDeltaAlgorithmWorkspaceSize));
+                        displayPrevActivationDeltaAlgorithm(prevActivationPerfResults[i].algo);
+                    }
+
+                    for (int i = 0; i < returnedPrevActivationAlgoCount; ++i)
+                    {
+                        if (prevActivationPerfResults[i].status == CUDNN_STATUS_SUCCESS &&
+                                (!workspaceLimit || prevActivationPerfResults[i].memory <= workspaceLimit))
+                        {
+                            m_prevActivationDeltaAlgorithm = prevActivationPerfResults[i].algo;
+                            m_prevActivationDeltaAlgorithmWorkspaceSize = prevActivationPerfResults[i].memory;
+                            break;
+                        }
+                    }
+
+                    algorithmCache.insert(dataCacheKey, (int) m_prevActivationDeltaAlgorithm);
                 }
 
+                Context<DeviceUsed>::getSingleton().reserveWorkspace(m_deviceId, m_prevActivationDeltaAlgorithmWorkspaceSize);
+
                 qDebug() << "----------------------------------------------------------------------------";
-                
+
+                m_gpuBatchSize = batchSize;
             }
 
             return true;
         }
 
+        // like Convolution::setGPUBatchSize, the algorithms of init are kept
+        void setGPUBatchSize(unsigned int batchSize)
+        {
+            setDescriptorBatchSize(m_prevActivationGPUTensorDescriptor, batchSize);
+            setDescriptorBatchSize(m_outputDeltaGPUTensorDescriptor, batchSize);
+            setDescriptorBatchSize(m_prevActivationDeltaGPUTensorDescriptor, batchSize);
+
+            size_t filterWorkspaceSize = 0;
+            RUN_CUDNN(cudnnGetConvolutionBackwardFilterWorkspaceSize(Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId),
+                                                                     m_prevActivationGPUTensorDescriptor,
+                                                                     m_outputDeltaGPUTensorDescriptor,
+                                                                     m_convolutionDescriptor,
+                                                                     m_featureMapFilterDescriptor,
+                                                                     m_filterBackwardAlgorithm,
+                                                                     &filterWorkspaceSize));
+
+            Context<DeviceUsed>::getSingleton().reserveWorkspace(m_deviceId, filterWorkspaceSize);
+            m_filterBackwardAlgorithmWorkspaceSize = filterWorkspaceSize;
+
+            size_t dataWorkspaceSize = 0;
+            RUN_CUDNN(cudnnGetConvolutionBackwardDataWorkspaceSize( Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId),
+                                                                    m_featureMapFilterDescriptor,
+                                                                    m_outputDeltaGPUTensorDescriptor,
+                                                                    m_convolutionDescriptor,
+                                                                    m_prevActivationDeltaGPUTensorDescriptor,
+                                                                    m_prevActivationDeltaAlgorithm,
+                                                                    &dataWorkspaceSize));
+
+            Context<DeviceUsed>::getSingleton().reserveWorkspace(m_deviceId, dataWorkspaceSize);
+            m_prevActivationDeltaAlgorithmWorkspaceSize = dataWorkspaceSize;
+
+            m_gpuBatchSize = batchSize;
+        }
+
         virtual void evaluate() override
         {
             CHECK_GPU;
-            Tensor<DeviceUsed, DataType> *_prevActivation = input("PrevActivation")->template toType<DataType>();
-            Tensor<DeviceUsed, DataType> *_featureMap = input("FeatureMap")->template toType<DataType>();
-            Tensor<DeviceUsed, DataType> *_outputGrad = input("OutputGrad")->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_prevActivation = input(PREV_ACTIVATION)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_featureMap = input(FEATURE_MAP)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_outputGrad = input(OUTPUT_GRAD)->template toType<DataType>();
 
-            Tensor<DeviceUsed, DataType> *_featureMapGrad = output("FeatureMapGrad")->template toType<DataType>();
-            Tensor<DeviceUsed, DataType> *_biasGrad = output("BiasGrad")->template toType<DataType>();
-            Tensor<DeviceUsed, DataType> *_inputGrad = output("InputGrad")->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_featureMapGrad = output(FEATURE_MAP_GRAD)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_biasGrad = output(BIAS_GRAD)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_inputGrad = output(INPUT_GRAD)->template toType<DataType>();
 
             unsigned int featureMapCount = _featureMap->shape()[3];
             unsigned int featureMapLength = _featureMap->shape()[1];
@@ -407,7 +566,7 @@ namespace FreeWill
             unsigned int originalWidth = _prevActivation->shape()[1];
             unsigned int originalHeight = _prevActivation->shape()[2];
 
-            unsigned int channelCount = _featureMap->shape()[0];
+            unsigned int channelCount = _prevActivation->shape()[0];
 
             
             unsigned int newWidth = (originalWidth - featureMapLength + 2 * m_zeroPaddingX ) / m_strideX + 1;
@@ -416,90 +575,51 @@ namespace FreeWill
             unsigned int batchSize = _prevActivation->shape()[3];
             if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
             {
-                for (unsigned int b = 0; b < batchSize; ++b)
+                ConvolutionGeometryCPU geometry;
+                geometry.channelCount = channelCount;
+                geometry.filterCount = featureMapCount;
+                geometry.filterSize = featureMapLength;
+                geometry.width = originalWidth;
+                geometry.height = originalHeight;
+                geometry.outputWidth = newWidth;
+                geometry.outputHeight = newHeight;
+                geometry.strideX = m_strideX;
+                geometry.strideY = m_strideY;
+                geometry.zeroPaddingX = m_zeroPaddingX;
+                geometry.zeroPaddingY = m_zeroPaddingY;
+
+                if (m_groupCount > 1 && m_groupCount == channelCount)
                 {
-                    for(unsigned int newIndexY = 0; newIndexY < newHeight;++newIndexY)
-                    {
-                        for (unsigned int newIndexX = 0; newIndexX < newWidth;++newIndexX)
-                        {
-
-                            int startX = -m_zeroPaddingX + newIndexX * m_strideX;
-                            int startY = -m_zeroPaddingY + newIndexY * m_strideY;
-
-                            unsigned int resultBaseIndex = (b * newWidth*newHeight +newIndexY * newWidth + newIndexX) * featureMapCount; 
-
-                            for (unsigned int k = 0; k < featureMapCount; ++k)
-                            {
-
-                                for(int y = 0; y< (int)featureMapLength; ++y)
-                                {
-                                    for(int x = 0; x < (int)featureMapLength; ++x)
-                                    {
-                                        int realX = x + startX;
-                                        int realY = y + startY;
-
-                                        if ((realX >= 0 && realX < (int)originalWidth) 
-                                                && (realY>=0 && realY< (int)originalHeight))
-                                        {
-                                            unsigned int originalBaseIndex = (b* originalHeight * originalWidth + realY*originalWidth + realX)
-                                                *channelCount;
-                                            unsigned int featureMapBaseIndex = (k*(featureMapLength * featureMapLength) + y*featureMapLength + x) * channelCount; 
-                                
-                                            for(unsigned int c = 0;c<channelCount;++c)
-                                            {
-                                                /*(*_output)[resultBaseIndex + k] += 
-                                                    (*_featureMap)[(k * (featureMapLength * featureMapLength) + 
-                                                            y*featureMapLength +x) * channelCount + c]
-                                                    * (*_input)[originalBaseIndex + c];
-                                                */
-
-                                                (*_featureMapGrad)[featureMapBaseIndex + c]
-                                                    += (*_outputGrad)[resultBaseIndex + k] * (*_prevActivation)[originalBaseIndex + c];
-
-                                                (*_inputGrad)[originalBaseIndex + c] += (*_featureMap)[(k * (featureMapLength * featureMapLength) + 
-                                                    y*featureMapLength + x)*channelCount + c] * (*_outputGrad)[resultBaseIndex + k];
-                                             
-                                            }
-                                        
-                                            //qDebug() << "base index" << realX << ";" << realY << ";" <<originalWidth <<";"<< originalBaseIndex;
-                                            //qDebug() << "feature map" << (*_featureMap)[(k * (featureMapLength * featureMapLength) +
-                                            //            y*featureMapLength +x) * channelCount + 0];                                   
-                                            //qDebug() << (*_input)[originalBaseIndex ];
-                                        }
-                                    }
-                                }
-
-                                //qDebug() << "result loc" << resultBaseIndex + k;
-                                (*_biasGrad)[k] += (*_outputGrad)[resultBaseIndex + k];
-                                //(*_output)[resultBaseIndex + k] += (*_bias)[k]; 
-                            }
-                        }
-                    }                
+                    convolutionDepthwiseBackwardCPU<DataType>(geometry, batchSize,
+                                                              _prevActivation->cpuDataHandle(), _featureMap->cpuDataHandle(), _outputGrad->cpuDataHandle(),
+                                                              _featureMapGrad->cpuDataHandle(), _biasGrad->cpuDataHandle(), _inputGrad->cpuDataHandle(),
+                                                              m_cpuWorkspace);
                 }
-
-                //DataType scale = 1.0 / (newWidth * newHeight);
-
-
-               /* for(unsigned int k = 0;k<_biasGrad->shape().size();++k)
+                else if (m_groupCount > 1)
                 {
-                    (*_biasGrad)[k] *= scale;
-                }*/
-
-/*                for(unsigned int i = 0;i< _featureMapGrad->shape().size();++i)
-                {
-                    (*_featureMapGrad)[i] *= scale;
+                    convolutionGroupedBackwardCPU<DataType>(geometry, m_groupCount, batchSize,
+                                                            _prevActivation->cpuDataHandle(), _featureMap->cpuDataHandle(), _outputGrad->cpuDataHandle(),
+                                                            _featureMapGrad->cpuDataHandle(), _biasGrad->cpuDataHandle(), _inputGrad->cpuDataHandle(),
+                                                            m_cpuWorkspace, m_cpuGroupWorkspace);
                 }
-*/
-/*                for(unsigned int i =0;i<_inputGrad->shape().size(); ++i)
+                else
                 {
-                    (*_inputGrad)[i] *= scale;
+                    convolutionBackwardIm2colCPU<DataType>(geometry, batchSize,
+                                                           _prevActivation->cpuDataHandle(), _featureMap->cpuDataHandle(), _outputGrad->cpuDataHandle(),
+                                                           _featureMapGrad->cpuDataHandle(), _biasGrad->cpuDataHandle(), _inputGrad->cpuDataHandle(),
+                                                           m_cpuWorkspace);
                 }
-*/
             }
             else if constexpr (DeviceUsed == DeviceType::GPU_CUDA )
             {
-                DataType alpha = 1.0;
-                DataType beta = 0.0;
+                if (batchSize != m_gpuBatchSize)
+                {
+                    setGPUBatchSize(batchSize);
+                }
+
+                typename ComputeType<DataType>::Type alpha = 1.0;
+                typename ComputeType<DataType>::Type beta = 0.0;
+                typename ComputeType<DataType>::Type gradBeta = m_isAccumulating ? 1.0 : 0.0;
 
                 RUN_CUDNN(cudnnConvolutionBackwardFilter(Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId),
                                                         &alpha,
@@ -509,9 +629,9 @@ namespace FreeWill
                                                         _outputGrad->gpuDataHandle(),
                                                         m_convolutionDescriptor,
                                                         m_filterBackwardAlgorithm,
-                                                        m_filterBackwardAlgorithmWorkspace,
+                                                        Context<DeviceUsed>::getSingleton().workspace(m_deviceId),
                                                         m_filterBackwardAlgorithmWorkspaceSize,
-                                                        &beta,
+                                                        &gradBeta,
                                                         m_featureMapFilterDescriptor,
                                                         _featureMapGrad->gpuDataHandle()));
 
@@ -519,7 +639,7 @@ namespace FreeWill
                                                        &alpha,
                                                        m_outputDeltaGPUTensorDescriptor,
                                                        _outputGrad->gpuDataHandle(),
-                                                       &beta,
+                                                       &gradBeta,
                                                        m_biasGradGPUTensorDescriptor,
                                                        _biasGrad->gpuDataHandle()));
 
@@ -531,7 +651,7 @@ namespace FreeWill
                                                        _outputGrad->gpuDataHandle(),
                                                        m_convolutionDescriptor,
                                                        m_prevActivationDeltaAlgorithm,
-                                                       m_prevActivationDeltaAlgorithmWorkspace,
+                                                       Context<DeviceUsed>::getSingleton().workspace(m_deviceId),
                                                        m_prevActivationDeltaAlgorithmWorkspaceSize,
                                                        &beta,
                                                        m_prevActivationDeltaGPUTensorDescriptor,
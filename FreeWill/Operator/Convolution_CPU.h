@@ -0,0 +1,534 @@
+#ifndef CONVOLUTION_CPU_H
+#define CONVOLUTION_CPU_H
+
+#include "GEMM_CPU.h"
+#include <algorithm>
+#include <vector>
+
+namespace FreeWill
+{
+    enum class ConvolutionAlgorithmCPU
+    {
+        IM2COL_GEMM,
+        WINOGRAD_2X2_3X3,
+        // direct, on channel blocked tensors (ChannelBlocked_CPU.h)
+        CHANNEL_BLOCKED_DIRECT,
+        // direct, a group a channel (GroupedConvolution_CPU.h)
+        DEPTHWISE_DIRECT,
+        // im2col and gemm a group at a time (GroupedConvolution_CPU.h)
+        GROUPED_IM2COL_GEMM
+    };
+
+    // Shapes follow the operator tensors: images are {channel, width, height} per batch element
+    // and filters are {channel, filterSize, filterSize} per filter, channels fastest.
+    struct ConvolutionGeometryCPU
+    {
+        unsigned int channelCount;
+        unsigned int filterCount;
+        unsigned int filterSize;
+        unsigned int width;
+        unsigned int height;
+        unsigned int outputWidth;
+        unsigned int outputHeight;
+        unsigned int strideX;
+        unsigned int strideY;
+        unsigned int zeroPaddingX;
+        unsigned int zeroPaddingY;
+
+        unsigned int patchSize() const
+        {
+            return filterSize * filterSize * channelCount;
+        }
+
+        unsigned int outputPixelCount() const
+        {
+            return outputWidth * outputHeight;
+        }
+
+        bool isPointwise() const
+        {
+            return filterSize == 1 && strideX == 1 && strideY == 1 && zeroPaddingX == 0 && zeroPaddingY == 0;
+        }
+    };
+
+    static inline ConvolutionAlgorithmCPU selectConvolutionAlgorithmCPU(const ConvolutionGeometryCPU &geometry)
+    {
+        // the winograd transforms only pay off when there are enough channels and filters to amortize them
+        if (geometry.filterSize == 3 && geometry.strideX == 1 && geometry.strideY == 1
+                && geometry.channelCount >= 8 && geometry.filterCount >= 8
+                && geometry.outputWidth >= 4 && geometry.outputHeight >= 4)
+        {
+            return ConvolutionAlgorithmCPU::WINOGRAD_2X2_3X3;
+        }
+
+        return ConvolutionAlgorithmCPU::IM2COL_GEMM;
+    }
+
+    // Lowers one image into a column-major {patchSize, outputPixelCount} matrix. A window row
+    // inside the image is filterSize whole pixels, one contiguous run of the image. FilterSize
+    // and Stride other than 0 fix the filter and the stride (both directions) at compile time
+    // so the loops unroll, see selectIm2colCPU.
+    template<typename DataType, unsigned int FilterSize = 0, unsigned int Stride = 0>
+    void im2colCPU(const ConvolutionGeometryCPU &geometry, const DataType *image, DataType *columns)
+    {
+        const unsigned int channelCount = geometry.channelCount;
+        const unsigned int filterSize = FilterSize ? FilterSize : geometry.filterSize;
+        const unsigned int strideX = Stride ? Stride : geometry.strideX;
+        const unsigned int strideY = Stride ? Stride : geometry.strideY;
+        const unsigned int rowLength = filterSize * channelCount;
+
+        for(unsigned int outputY = 0; outputY < geometry.outputHeight; ++outputY)
+        {
+            int startY = (int) (outputY * strideY) - (int) geometry.zeroPaddingY;
+
+            for(unsigned int outputX = 0; outputX < geometry.outputWidth; ++outputX)
+            {
+                int startX = (int) (outputX * strideX) - (int) geometry.zeroPaddingX;
+                bool isRowInside = startX >= 0 && startX + (int) filterSize <= (int) geometry.width;
+
+                for(unsigned int y = 0; y < filterSize; ++y)
+                {
+                    int realY = startY + (int) y;
+
+                    if (realY < 0 || realY >= (int) geometry.height)
+                    {
+                        std::fill(columns, columns + rowLength, 0);
+                    }
+                    else if (isRowInside)
+                    {
+                        const DataType *source = image + ((size_t) realY * geometry.width + startX) * channelCount;
+                        std::copy(source, source + rowLength, columns);
+                    }
+                    else
+                    {
+                        for(unsigned int x = 0; x < filterSize; ++x)
+                        {
+                            int realX = startX + (int) x;
+
+                            if (realX >= 0 && realX < (int) geometry.width)
+                            {
+                                const DataType *source = image + ((size_t) realY * geometry.width + realX) * channelCount;
+                                std::copy(source, source + channelCount, columns + x * channelCount);
+                            }
+                            else
+                            {
+                                std::fill(columns + x * channelCount, columns + (x + 1) * channelCount, 0);
+                            }
+                        }
+                    }
+
+                    columns += rowLength;
+                }
+            }
+        }
+    }
+
+    template<typename DataType>
+    using Im2colFunctionCPU = void (*)(const ConvolutionGeometryCPU &, const DataType *, DataType *);
+
+    // The lowering specialized for the filter and stride of geometry, 1x1, 3x3 and 5x5 at
+    // stride 1 or 2, the generic one for the others.
+    template<typename DataType>
+    Im2colFunctionCPU<DataType> selectIm2colCPU(const ConvolutionGeometryCPU &geometry)
+    {
+        static const struct
+        {
+            unsigned int filterSize;
+            unsigned int stride;
+            Im2colFunctionCPU<DataType> function;
+        } kernels[] = {{1, 1, im2colCPU<DataType, 1, 1>}, {1, 2, im2colCPU<DataType, 1, 2>},
+                       {3, 1, im2colCPU<DataType, 3, 1>}, {3, 2, im2colCPU<DataType, 3, 2>},
+                       {5, 1, im2colCPU<DataType, 5, 1>}, {5, 2, im2colCPU<DataType, 5, 2>}};
+
+        for (const auto &kernel : kernels)
+        {
+            if (kernel.filterSize == geometry.filterSize && kernel.stride == geometry.strideX && kernel.stride == geometry.strideY)
+            {
+                return kernel.function;
+            }
+        }
+
+        return im2colCPU<DataType>;
+    }
+
+    // Scatters a column-major {patchSize, outputPixelCount} matrix back into one image, accumulating.
+    template<typename DataType>
+    void col2imCPU(const ConvolutionGeometryCPU &geometry, const DataType *columns, DataType *image)
+    {
+        unsigned int channelCount = geometry.channelCount;
+        unsigned int filterSize = geometry.filterSize;
+
+        for(unsigned int outputY = 0; outputY < geometry.outputHeight; ++outputY)
+        {
+            for(unsigned int outputX = 0; outputX < geometry.outputWidth; ++outputX)
+            {
+                int startX = (int) (outputX * geometry.strideX) - (int) geometry.zeroPaddingX;
+                int startY = (int) (outputY * geometry.strideY) - (int) geometry.zeroPaddingY;
+
+                for(unsigned int y = 0; y < filterSize; ++y)
+                {
+                    int realY = startY + (int) y;
+                    bool rowInside = realY >= 0 && realY < (int) geometry.height;
+
+                    for(unsigned int x = 0; x < filterSize; ++x)
+                    {
+                        int realX = startX + (int) x;
+
+                        if (rowInside && realX >= 0 && realX < (int) geometry.width)
+                        {
+                            DataType *destination = image + ((size_t) realY * geometry.width + realX) * channelCount;
+                            for(unsigned int c = 0; c < channelCount; ++c)
+                            {
+                                destination[c] += columns[c];
+                            }
+                        }
+
+                        columns += channelCount;
+                    }
+                }
+            }
+        }
+    }
+
+    // output += convolution(input, featureMap), one GEMM per image:
+    // output{filterCount, pixels} = featureMap^T{filterCount, patchSize} * columns{patchSize, pixels}
+    // The epilogue rows are filters, it is applied to every image. im2col is the lowering
+    // selectIm2colCPU picked, it selects one when null.
+    template<typename DataType>
+    void convolutionIm2colCPU(const ConvolutionGeometryCPU &geometry, unsigned int batchSize,
+                              const DataType *input, const DataType *featureMap, DataType *output,
+                              std::vector<DataType> &workspace, const GEMMEpilogueCPU<DataType> *epilogue = nullptr,
+                              Im2colFunctionCPU<DataType> im2col = nullptr)
+    {
+        if (!im2col)
+        {
+            im2col = selectIm2colCPU<DataType>(geometry);
+        }
+
+        unsigned int patchSize = geometry.patchSize();
+        unsigned int pixelCount = geometry.outputPixelCount();
+        size_t inputImageSize = (size_t) geometry.width * geometry.height * geometry.channelCount;
+        size_t outputImageSize = (size_t) pixelCount * geometry.filterCount;
+
+        ThreadPool &threadPool = ThreadPool::getSingleton();
+
+        if (threadPool.threadCount() != 0 && batchSize > 1)
+        {
+            // images are independent, each thread lowers into its own column buffer
+            threadPool.parallelFor(0, batchSize, 1, [&](unsigned int begin, unsigned int end)
+            {
+                thread_local std::vector<DataType> columnBuffer;
+                if (!geometry.isPointwise())
+                {
+                    columnBuffer.resize((size_t) patchSize * pixelCount);
+                }
+
+                for(unsigned int b = begin; b < end; ++b)
+                {
+                    const DataType *columns = input + b * inputImageSize;
+
+                    if (!geometry.isPointwise())
+                    {
+                        im2col(geometry, columns, columnBuffer.data());
+                        columns = columnBuffer.data();
+                    }
+
+                    gemmCPU<DataType>(true, false, geometry.filterCount, pixelCount, patchSize,
+                                      1, featureMap, patchSize,
+                                      columns, patchSize,
+                                      1, output + b * outputImageSize, geometry.filterCount, epilogue);
+                }
+            });
+            return;
+        }
+
+        if (!geometry.isPointwise())
+        {
+            workspace.resize((size_t) patchSize * pixelCount);
+        }
+
+        for(unsigned int b = 0; b < batchSize; ++b)
+        {
+            const DataType *columns = input + b * inputImageSize;
+
+            if (!geometry.isPointwise())
+            {
+                im2col(geometry, columns, workspace.data());
+                columns = workspace.data();
+            }
+
+            gemmCPU<DataType>(true, false, geometry.filterCount, pixelCount, patchSize,
+                              1, featureMap, patchSize,
+                              columns, patchSize,
+                              1, output + b * outputImageSize, geometry.filterCount, epilogue);
+        }
+    }
+
+    // Accumulates all three convolution gradients with the same lowering as the forward pass:
+    // featureMapGrad{patchSize, filterCount} += columns * outputGrad^T,
+    // inputGrad += col2im(featureMap{patchSize, filterCount} * outputGrad) and biasGrad += row sums of outputGrad.
+    template<typename DataType>
+    void convolutionBackwardIm2colCPU(const ConvolutionGeometryCPU &geometry, unsigned int batchSize,
+                                      const DataType *prevActivation, const DataType *featureMap, const DataType *outputGrad,
+                                      DataType *featureMapGrad, DataType *biasGrad, DataType *inputGrad,
+                                      std::vector<DataType> &workspace)
+    {
+        unsigned int patchSize = geometry.patchSize();
+        unsigned int pixelCount = geometry.outputPixelCount();
+        unsigned int filterCount = geometry.filterCount;
+        size_t inputImageSize = (size_t) geometry.width * geometry.height * geometry.channelCount;
+        size_t outputImageSize = (size_t) pixelCount * filterCount;
+        bool pointwise = geometry.isPointwise();
+
+        if (!pointwise)
+        {
+            workspace.resize(2 * (size_t) patchSize * pixelCount);
+        }
+
+        DataType *columns = workspace.data();
+        DataType *columnsGrad = columns + (size_t) patchSize * pixelCount;
+        Im2colFunctionCPU<DataType> im2col = selectIm2colCPU<DataType>(geometry);
+
+        for(unsigned int b = 0; b < batchSize; ++b)
+        {
+            const DataType *image = prevActivation + b * inputImageSize;
+            const DataType *imageOutputGrad = outputGrad + b * outputImageSize;
+            DataType *imageInputGrad = inputGrad + b * inputImageSize;
+
+            if (!pointwise)
+            {
+                im2col(geometry, image, columns);
+                image = columns;
+            }
+
+            gemmCPU<DataType>(false, true, patchSize, filterCount, pixelCount,
+                              1, image, patchSize,
+                              imageOutputGrad, filterCount,
+                              1, featureMapGrad, patchSize);
+
+            if (pointwise)
+            {
+                gemmCPU<DataType>(false, false, patchSize, pixelCount, filterCount,
+                                  1, featureMap, patchSize,
+                                  imageOutputGrad, filterCount,
+                                  1, imageInputGrad, patchSize);
+            }
+            else
+            {
+                gemmCPU<DataType>(false, false, patchSize, pixelCount, filterCount,
+                                  1, featureMap, patchSize,
+                                  imageOutputGrad, filterCount,
+                                  0, columnsGrad, patchSize);
+
+                col2imCPU(geometry, columnsGrad, imageInputGrad);
+            }
+
+            for(unsigned int p = 0; p < pixelCount; ++p)
+            {
+                const DataType *pixelGrad = imageOutputGrad + (size_t) p * filterCount;
+                for(unsigned int k = 0; k < filterCount; ++k)
+                {
+                    biasGrad[k] += pixelGrad[k];
+                }
+            }
+        }
+    }
+
+    // F(2x2, 3x3) Winograd convolution for stride 1 3x3 filters:
+    // each 4x4 input tile d and filter g give Y = A^T [(G g G^T) . (B^T d B)] A,
+    // and the 16 elementwise products are batched over channels into 16 GEMMs.
+    template<typename DataType>
+    void convolutionWinogradCPU(const ConvolutionGeometryCPU &geometry, unsigned int batchSize,
+                                const DataType *input, const DataType *featureMap, DataType *output,
+                                std::vector<DataType> &workspace)
+    {
+        unsigned int channelCount = geometry.channelCount;
+        unsigned int filterCount = geometry.filterCount;
+        unsigned int tileCountX = (geometry.outputWidth + 1) / 2;
+        unsigned int tileCountY = (geometry.outputHeight + 1) / 2;
+        unsigned int tileCount = tileCountX * tileCountY;
+
+        size_t filterTransformSize = (size_t) filterCount * channelCount;
+        size_t inputTransformSize = (size_t) channelCount * tileCount;
+        size_t productSize = (size_t) filterCount * tileCount;
+
+        workspace.resize(16 * (filterTransformSize + inputTransformSize + productSize));
+
+        // U[xi] is column-major {filterCount, channelCount}
+        DataType *filterTransform = workspace.data();
+        // V[xi] is column-major {channelCount, tileCount}
+        DataType *inputTransform = filterTransform + 16 * filterTransformSize;
+        // M[xi] is column-major {filterCount, tileCount}
+        DataType *product = inputTransform + 16 * inputTransformSize;
+
+        for(unsigned int k = 0; k < filterCount; ++k)
+        {
+            for(unsigned int c = 0; c < channelCount; ++c)
+            {
+                DataType g[3][3];
+                for(unsigned int y = 0; y < 3; ++y)
+                {
+                    for(unsigned int x = 0; x < 3; ++x)
+                    {
+                        g[y][x] = featureMap[((k * 3 + y) * 3 + x) * channelCount + c];
+                    }
+                }
+
+                // Gg
+                DataType t[4][3];
+                for(unsigned int x = 0; x < 3; ++x)
+                {
+                    t[0][x] = g[0][x];
+                    t[1][x] = (g[0][x] + g[1][x] + g[2][x]) * (DataType) 0.5;
+                    t[2][x] = (g[0][x] - g[1][x] + g[2][x]) * (DataType) 0.5;
+                    t[3][x] = g[2][x];
+                }
+
+                // (Gg)G^T
+                for(unsigned int y = 0; y < 4; ++y)
+                {
+                    DataType u[4];
+                    u[0] = t[y][0];
+                    u[1] = (t[y][0] + t[y][1] + t[y][2]) * (DataType) 0.5;
+                    u[2] = (t[y][0] - t[y][1] + t[y][2]) * (DataType) 0.5;
+                    u[3] = t[y][2];
+
+                    for(unsigned int x = 0; x < 4; ++x)
+                    {
+                        filterTransform[(y * 4 + x) * filterTransformSize + (size_t) c * filterCount + k] = u[x];
+                    }
+                }
+            }
+        }
+
+        size_t inputImageSize = (size_t) geometry.width * geometry.height * channelCount;
+        size_t outputImageSize = (size_t) geometry.outputPixelCount() * filterCount;
+
+        for(unsigned int b = 0; b < batchSize; ++b)
+        {
+            const DataType *image = input + b * inputImageSize;
+
+            for(unsigned int tileY = 0; tileY < tileCountY; ++tileY)
+            {
+                for(unsigned int tileX = 0; tileX < tileCountX; ++tileX)
+                {
+                    unsigned int tile = tileY * tileCountX + tileX;
+                    int startX = (int) (tileX * 2) - (int) geometry.zeroPaddingX;
+                    int startY = (int) (tileY * 2) - (int) geometry.zeroPaddingY;
+
+                    const DataType *rows[4][4];
+                    for(unsigned int y = 0; y < 4; ++y)
+                    {
+                        int realY = startY + (int) y;
+                        for(unsigned int x = 0; x < 4; ++x)
+                        {
+                            int realX = startX + (int) x;
+                            if (realY >= 0 && realY < (int) geometry.height && realX >= 0 && realX < (int) geometry.width)
+                            {
+                                rows[y][x] = image + ((size_t) realY * geometry.width + realX) * channelCount;
+                            }
+                            else
+                            {
+                                rows[y][x] = nullptr;
+                            }
+                        }
+                    }
+
+                    for(unsigned int c = 0; c < channelCount; ++c)
+                    {
+                        DataType d[4][4];
+                        for(unsigned int y = 0; y < 4; ++y)
+                        {
+                            for(unsigned int x = 0; x < 4; ++x)
+                            {
+                                d[y][x] = rows[y][x] ? rows[y][x][c] : 0;
+                            }
+                        }
+
+                        // B^T d
+                        DataType t[4][4];
+                        for(unsigned int x = 0; x < 4; ++x)
+                        {
+                            t[0][x] = d[0][x] - d[2][x];
+                            t[1][x] = d[1][x] + d[2][x];
+                            t[2][x] = d[2][x] - d[1][x];
+                            t[3][x] = d[1][x] - d[3][x];
+                        }
+
+                        // (B^T d) B
+                        for(unsigned int y = 0; y < 4; ++y)
+                        {
+                            DataType v[4];
+                            v[0] = t[y][0] - t[y][2];
+                            v[1] = t[y][1] + t[y][2];
+                            v[2] = t[y][2] - t[y][1];
+                            v[3] = t[y][1] - t[y][3];
+
+                            for(unsigned int x = 0; x < 4; ++x)
+                            {
+                                inputTransform[(y * 4 + x) * inputTransformSize + (size_t) tile * channelCount + c] = v[x];
+                            }
+                        }
+                    }
+                }
+            }
+
+            for(unsigned int xi = 0; xi < 16; ++xi)
+            {
+                gemmCPU<DataType>(false, false, filterCount, tileCount, channelCount,
+                                  1, filterTransform + xi * filterTransformSize, filterCount,
+                                  inputTransform + xi * inputTransformSize, channelCount,
+                                  0, product + xi * productSize, filterCount);
+            }
+
+            DataType *outputImage = output + b * outputImageSize;
+
+            for(unsigned int tileY = 0; tileY < tileCountY; ++tileY)
+            {
+                for(unsigned int tileX = 0; tileX < tileCountX; ++tileX)
+                {
+                    unsigned int tile = tileY * tileCountX + tileX;
+                    unsigned int outputX = tileX * 2;
+                    unsigned int outputY = tileY * 2;
+                    bool hasSecondColumn = outputX + 1 < geometry.outputWidth;
+                    bool hasSecondRow = outputY + 1 < geometry.outputHeight;
+
+                    for(unsigned int k = 0; k < filterCount; ++k)
+                    {
+                        DataType m[4][4];
+                        for(unsigned int xi = 0; xi < 16; ++xi)
+                        {
+                            m[xi / 4][xi % 4] = product[xi * productSize + (size_t) tile * filterCount + k];
+                        }
+
+                        // A^T m
+                        DataType t[2][4];
+                        for(unsigned int x = 0; x < 4; ++x)
+                        {
+                            t[0][x] = m[0][x] + m[1][x] + m[2][x];
+                            t[1][x] = m[1][x] - m[2][x] - m[3][x];
+                        }
+
+                        for(unsigned int y = 0; y < 2; ++y)
+                        {
+                            if (y == 1 && !hasSecondRow)
+                            {
+                                break;
+                            }
+
+                            size_t rowBase = (size_t) (outputY + y) * geometry.outputWidth + outputX;
+
+                            outputImage[rowBase * filterCount + k] += t[y][0] + t[y][1] + t[y][2];
+                            if (hasSecondColumn)
+                            {
+                                outputImage[(rowBase + 1) * filterCount + k] += t[y][1] - t[y][2] - t[y][3];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+#endif
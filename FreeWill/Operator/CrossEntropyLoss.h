@@ -17,6 +17,9 @@ namespace FreeWill
         using Operator<DeviceUsed>::m_deviceId;
 
     public:
+        enum InputSlot : unsigned int {INPUT, LABEL};
+        enum OutputSlot : unsigned int {COST};
+
         CrossEntropyLoss(unsigned int deviceId = 0)
             :Operator<DeviceUsed>({"Input", "Label"},{"Cost"}, deviceId)
         {}
@@ -42,10 +45,10 @@ namespace FreeWill
         {
             CHECK_GPU;
 
-            Tensor<DeviceUsed, DataType> *_input = input("Input")->template toType<DataType>();
-            Tensor<DeviceUsed, DataType> *_label = input("Label")->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_input = input(INPUT)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_label = input(LABEL)->template toType<DataType>();
 
-            Tensor<DeviceUsed, DataType> *_cost = output("Cost")->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_cost = output(COST)->template toType<DataType>();
 
             unsigned int batchSize = _cost->shape()[1];
             unsigned int vectorSize = _input->shape()[0];
@@ -1,5 +1,7 @@
 #include "CrossEntropyLoss_CUDA.h"
+#include "Elementwise_CUDA.h"
 #include "../DeviceSelection.h"
+#include "../Context/ComputeStream.h"
 #include <cuda_runtime.h>
 
 
@@ -77,11 +79,11 @@ __host__ void crossEntropyLossCUDAKernel(DataType *input, DataType *label, DataT
         gridSize += 1;
     }
 
-    cudaMemset(cost, 0, sizeof(DataType) * batchSize);
+    cudaMemsetAsync(cost, 0, sizeof(DataType) * batchSize, FreeWill::computeStream());
     //printf("%d, %d",cost, sizeof(DataType) * batchSize);
     CHECK_CUDA_ERROR
     //printf("gridsize:%d blocksize:%d labelsize %d batchsize %d\n",gridSize,blockSize,labelSize,batchSize);
-    crossEntropyLoss<DataType><<<gridSize, blockSize>>>(input, label, cost, labelSize, batchSize);
+    crossEntropyLoss<DataType><<<gridSize, blockSize, 0, FreeWill::computeStream()>>>(input, label, cost, labelSize, batchSize);
     CHECK_CUDA_ERROR
 }
 
@@ -92,31 +94,14 @@ template __host__ void crossEntropyLossCUDAKernel(double *input, double *label,
 //#endif
 
 template <typename DataType>
-__global__ void elementwiseSub(DataType *operandA, DataType *operandB, DataType *result, unsigned int size)
+__host__ void sigmoidCrossEntropyLossDerivativeCUDAKernel(DataType *input, DataType *label, DataType *output, unsigned int size, DataType lossScale)
 {
-    int id = blockIdx.x*blockDim.x+threadIdx.x;
-    if (id < size)
-    {
-        result[id] = operandA[id] - operandB[id];
-    }
-}
-        
-template <typename DataType>
-__host__ void sigmoidCrossEntropyLossDerivativeCUDAKernel(DataType *input, DataType *label, DataType *output, unsigned int size)
-{
-    int blockSize = 1024;
-    int gridSize =  size / blockSize ;
-
-    if (size % blockSize != 0)
-    {
-        gridSize += 1;
-    }
+    FreeWill::ElementwiseArguments<DataType> arguments = {{input, label}, {lossScale}};
 
-    elementwiseSub<DataType><<<gridSize, blockSize>>>(input, label, output, size);
-    CHECK_CUDA_ERROR
+    elementwiseCUDAKernel<FreeWill::ElementwiseScaledSubtractExpression, DataType>(output, arguments, size);
 }
 
-template __host__ void sigmoidCrossEntropyLossDerivativeCUDAKernel(float *input, float *label, float *output, unsigned int size);
-template __host__ void sigmoidCrossEntropyLossDerivativeCUDAKernel(double *input, double *label, double *output, unsigned int size);
+template __host__ void sigmoidCrossEntropyLossDerivativeCUDAKernel(float *input, float *label, float *output, unsigned int size, float lossScale);
+template __host__ void sigmoidCrossEntropyLossDerivativeCUDAKernel(double *input, double *label, double *output, unsigned int size, double lossScale);
 
 
@@ -8,7 +8,7 @@ template <typename DataType = float>
 __host__ void crossEntropyLossCUDAKernel(DataType *input, DataType *label, DataType *cost, unsigned int labelSize, unsigned int batchSize);
 
 template <typename DataType = float>
-__host__ void sigmoidCrossEntropyLossDerivativeCUDAKernel(DataType *input, DataType *label, DataType *output, unsigned int size);
+__host__ void sigmoidCrossEntropyLossDerivativeCUDAKernel(DataType *input, DataType *label, DataType *output, unsigned int size, DataType lossScale = 1);
 
 
 
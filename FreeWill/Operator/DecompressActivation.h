@@ -0,0 +1,63 @@
+#ifndef DECOMPRESSACTIVATION_H
+#define DECOMPRESSACTIVATION_H
+
+#include "Operator.h"
+#include "ActivationCompression_CPU.h"
+#include "ActivationCompression_CUDA.h"
+#include "../Tensor/Tensor.h"
+
+namespace FreeWill
+{
+    // Output = the Half Values a CompressActivation kept, for the backward operators that read
+    // the activation itself
+    template<DeviceType DeviceUsed = DeviceType::CPU_NAIVE, typename DataType = float>
+    class DecompressActivation : public Operator<DeviceUsed>
+    {
+    protected:
+        using Operator<DeviceUsed>::input;
+        using Operator<DeviceUsed>::output;
+
+    public:
+        enum InputSlot : unsigned int {VALUES};
+        enum OutputSlot : unsigned int {OUTPUT};
+
+        DecompressActivation(unsigned int deviceId = 0)
+            :Operator<DeviceUsed>({"Values"}, {"Output"}, deviceId)
+        {
+        }
+
+        virtual bool init() override
+        {
+            CHECK_GPU;
+
+            FAIL_IF (!input("Values") || !output("Output"));
+
+            FAIL_IF (input("Values")->shape() != output("Output")->shape());
+
+            return true;
+        }
+
+        virtual void evaluate() override
+        {
+            CHECK_GPU;
+
+            Tensor<DeviceUsed, Half> *_values = input(VALUES)->template toType<Half>();
+            Tensor<DeviceUsed, DataType> *_output = output(OUTPUT)->template toType<DataType>();
+
+            unsigned int itemSize = 0;
+            unsigned int batchSize = 0;
+            dropoutItems(_output->shape(), itemSize, batchSize);
+
+            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+            {
+                decompressActivationCPU(_values->cpuDataHandle(), _output->cpuDataHandle(), itemSize, batchSize);
+            }
+            else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                decompressActivationCUDAKernel<DataType>(_values->gpuDataHandle(), _output->gpuDataHandle(), _output->shape().size());
+            }
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,134 @@
+// No include guard: the body of DepthwiseKernelCPU, included inside namespace FreeWill by
+// GroupedConvolution_CPU.h and once more inside the namespace of every wider instruction set
+// (see CPUKernels.h), with CPU_KERNEL_VECTOR_BYTES set to the vector width of the instruction set.
+
+    // The depthwise convolution of CHANNEL_LAST images: filter f sees input channel
+    // f / multiplier only, multiplier = filterCount / channelCount. Its filters come from
+    // depthwiseTapsCPU, {filterSize * filterSize, filterCount}, so the weights of one window
+    // position are contiguous like the channels of a pixel. With one filter a channel a pixel's
+    // channels are multiplied by a tap's weights a vector at a time.
+    template<typename DataType>
+    class DepthwiseKernelCPU
+    {
+    public:
+        static const unsigned int VECTOR_BYTES = CPU_KERNEL_VECTOR_BYTES;
+        static const unsigned int LANES = VECTOR_BYTES / sizeof(DataType);
+
+        typedef DataType Vector __attribute__((vector_size(VECTOR_BYTES)));
+        typedef DataType UnalignedVector __attribute__((vector_size(VECTOR_BYTES), aligned(sizeof(DataType))));
+
+        // output = activation(output + convolution + bias) like the im2col convolution, the
+        // epilogue says which. FilterSize and Stride other than 0 fix the filter and the stride
+        // at compile time, the window loops then unroll, see select().
+        template<unsigned int FilterSize = 0, unsigned int Stride = 0>
+        static void convolution(const ConvolutionGeometryCPU &geometry, unsigned int batchSize, const DataType *input,
+                                const DataType *taps, DataType *output, const GEMMEpilogueCPU<DataType> &epilogue)
+        {
+            const unsigned int channelCount = geometry.channelCount;
+            const unsigned int filterCount = geometry.filterCount;
+            const unsigned int multiplier = filterCount / channelCount;
+            const unsigned int filterSize = FilterSize ? FilterSize : geometry.filterSize;
+            const unsigned int strideX = Stride ? Stride : geometry.strideX;
+            const unsigned int strideY = Stride ? Stride : geometry.strideY;
+            const unsigned int vectorEnd = multiplier == 1 ? channelCount - channelCount % LANES : 0;
+            size_t imageSize = (size_t) geometry.width * geometry.height * channelCount;
+            unsigned int rowCount = batchSize * geometry.outputHeight;
+            unsigned int grain = std::max(1u, 16384 / std::max(1u, geometry.outputWidth * filterSize * filterSize * filterCount));
+
+            ThreadPool::getSingleton().parallelFor(0, rowCount, grain, [&](unsigned int rowBegin, unsigned int rowEnd)
+            {
+                for (unsigned int row = rowBegin; row < rowEnd; ++row)
+                {
+                    unsigned int outputY = row % geometry.outputHeight;
+                    const DataType *image = input + (size_t) (row / geometry.outputHeight) * imageSize;
+                    DataType *outputRow = output + (size_t) row * geometry.outputWidth * filterCount;
+
+                    int startY = (int) (outputY * strideY) - (int) geometry.zeroPaddingY;
+                    unsigned int firstY = (unsigned int) std::max(0, -startY);
+                    unsigned int lastY = (unsigned int) std::max(0, std::min((int) filterSize, (int) geometry.height - startY));
+
+                    for (unsigned int outputX = 0; outputX < geometry.outputWidth; ++outputX)
+                    {
+                        int startX = (int) (outputX * strideX) - (int) geometry.zeroPaddingX;
+                        unsigned int firstX = (unsigned int) std::max(0, -startX);
+                        unsigned int lastX = (unsigned int) std::max(0, std::min((int) filterSize, (int) geometry.width - startX));
+                        DataType *result = outputRow + (size_t) outputX * filterCount;
+
+                        for (unsigned int c = 0; c < vectorEnd; c += LANES)
+                        {
+                            Vector sum = *(const UnalignedVector *) (result + c);
+
+                            for (unsigned int y = firstY; y < lastY; ++y)
+                            {
+                                const DataType *pixels = image + ((size_t) (startY + y) * geometry.width + startX) * channelCount + c;
+                                const DataType *weights = taps + (size_t) y * filterSize * filterCount + c;
+
+                                for (unsigned int x = firstX; x < lastX; ++x)
+                                {
+                                    sum += *(const UnalignedVector *) (pixels + (size_t) x * channelCount) *
+                                           *(const UnalignedVector *) (weights + (size_t) x * filterCount);
+                                }
+                            }
+
+                            *(UnalignedVector *) (result + c) = sum;
+                        }
+
+                        // the channels after the last whole vector, every filter when there are several a channel
+                        for (unsigned int f = vectorEnd; f < filterCount; ++f)
+                        {
+                            DataType sum = result[f];
+
+                            for (unsigned int y = firstY; y < lastY; ++y)
+                            {
+                                const DataType *pixels = image + ((size_t) (startY + y) * geometry.width + startX) * channelCount + f / multiplier;
+                                const DataType *weights = taps + (size_t) y * filterSize * filterCount + f;
+
+                                for (unsigned int x = firstX; x < lastX; ++x)
+                                {
+                                    sum += pixels[(size_t) x * channelCount] * weights[(size_t) x * filterCount];
+                                }
+                            }
+
+                            result[f] = sum;
+                        }
+
+                        if (epilogue.m_rowBias)
+                        {
+                            for (unsigned int f = 0; f < filterCount; ++f)
+                            {
+                                result[f] += epilogue.m_rowBias[f];
+                            }
+                        }
+                    }
+
+                    if (epilogue.m_hasActivation)
+                    {
+                        activationForwardCPU<DataType>(epilogue.m_activationMode, outputRow, outputRow, geometry.outputWidth * filterCount);
+                    }
+                }
+            });
+        }
+
+        // the convolution specialized for the filter and stride of geometry, 3x3 and 5x5 at
+        // stride 1 or 2, the generic one for the others
+        static DepthwiseConvolutionCPU<DataType> select(const ConvolutionGeometryCPU &geometry)
+        {
+            static const struct
+            {
+                unsigned int filterSize;
+                unsigned int stride;
+                DepthwiseConvolutionCPU<DataType> function;
+            } kernels[] = {{3, 1, convolution<3, 1>}, {3, 2, convolution<3, 2>},
+                           {5, 1, convolution<5, 1>}, {5, 2, convolution<5, 2>}};
+
+            for (const auto &kernel : kernels)
+            {
+                if (kernel.filterSize == geometry.filterSize && kernel.stride == geometry.strideX && kernel.stride == geometry.strideY)
+                {
+                    return kernel.function;
+                }
+            }
+
+            return convolution<>;
+        }
+    };
@@ -4,13 +4,32 @@
 #include "Operator.h"
 //#include <QDebug>
 
+#include <algorithm>
 #include <cublas_v2.h>
+#include <string>
 #include <type_traits>
+#include <vector>
 #include "../Context/Context.h"
+#include "CPUAutotuner.h"
+#include "GEMM_CPU.h"
+#include "GEMM_CUDA.h"
+#include "SparseDotProduct_CPU.h"
+#include "SparseDotProduct_CUDA.h"
+#include "ActivationMode.h"
 
 
 namespace FreeWill
 {
+    // With SparseRowOffsets and SparseColumns bound, Input is the CSR values of a sparse batch
+    // (SparseDotProduct_CPU.h): SparseRowOffsets has at least batch size + 1 entries,
+    // SparseColumns as many as Input, both UNSIGNED_INT. The product gathers the weight columns
+    // of the non-zeros instead of multiplying the dense input. Float and double, float on gpu.
+    //
+    // With setModelCount(K), K models of the same shape train side by side, e.g. for a sweep
+    // over the learning rate (OptimizerParameters::m_modelRates). Weight is {out, in, K}, Bias
+    // {out, K}, Output {out, K, batch} and Input {in, K, batch}, or {in, batch} when every model
+    // reads the same batch. Model k's matrices start k rows into the stacked ones, so that a
+    // single strided batched gemm runs the K products on gpu.
     template<DeviceType DeviceUsed = DeviceType::CPU_NAIVE, typename DataType = float>
     class DotProductWithBias : public Operator<DeviceUsed>
     {
@@ -19,20 +38,197 @@ namespace FreeWill
         using Operator<DeviceUsed>::output;
         using Operator<DeviceUsed>::m_deviceId;
         bool m_hasBias;
+        bool m_hasActivation;
+        ActivationMode m_activationMode;
+        GEMMPartitionCPU m_partition;
+        bool m_isSparse;
+        unsigned int m_modelCount;
+
+        bool initStacked()
+        {
+            FAIL_IF (!std::is_floating_point<DataType>::value && !IsReducedPrecision<DataType>::value);
+
+            FAIL_IF (input("Weight")->shape().dimension() != 3 || input("Weight")->shape()[2] != m_modelCount);
+
+            unsigned int outputSize = input("Weight")->shape()[0];
+            unsigned int inputSize = input("Weight")->shape()[1];
+
+            FAIL_IF (output("Output")->shape().dimension() != 3 || output("Output")->shape()[0] != outputSize ||
+                     output("Output")->shape()[1] != m_modelCount);
+
+            unsigned int batchSize = output("Output")->shape()[2];
+
+            FAIL_IF (batchSize == 0);
+
+            const Shape &inputShape = input("Input")->shape();
+
+            FAIL_IF (inputShape != Shape({inputSize, batchSize}) && inputShape != Shape({inputSize, m_modelCount, batchSize}));
+
+            FAIL_IF (m_hasBias && (!input("Bias") || input("Bias")->shape() != Shape({outputSize, m_modelCount})));
+
+            FAIL_IF (m_hasActivation && (DeviceUsed != DeviceType::CPU_NAIVE || !isActivationImplementedCPU(m_activationMode)));
+
+            m_partition = GEMMPartitionCPU::AUTOMATIC;
+
+            return true;
+        }
+
+        void evaluateStacked()
+        {
+            unsigned int outputSize = input(WEIGHT)->shape()[0];
+            unsigned int inputSize = input(WEIGHT)->shape()[1];
+            unsigned int batchSize = output(OUTPUT)->shape()[2];
+
+            // a shared batch is read by every model in place
+            bool isInputShared = input(INPUT)->shape().dimension() == 2;
+            unsigned int inputStride = isInputShared ? 0 : inputSize;
+            unsigned int inputLeadingDimension = isInputShared ? inputSize : inputSize * m_modelCount;
+            unsigned int weightStride = outputSize * inputSize;
+
+            Tensor<DeviceUsed, DataType> *_input = input(INPUT)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_weight = input(WEIGHT)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_output = output(OUTPUT)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_bias = m_hasBias ? input(BIAS)->template toType<DataType>() : nullptr;
+
+            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+            {
+                for (unsigned int k = 0; k < m_modelCount; ++k)
+                {
+                    GEMMEpilogueCPU<DataType> epilogue;
+                    epilogue.m_rowBias = m_hasBias ? _bias->cpuDataHandle() + (size_t) k * outputSize : nullptr;
+                    epilogue.m_hasActivation = m_hasActivation;
+                    epilogue.m_activationMode = m_activationMode;
+
+                    gemmCPU<DataType>(false, false, outputSize, batchSize, inputSize,
+                                      1, _weight->cpuDataHandle() + (size_t) k * weightStride, outputSize,
+                                      _input->cpuDataHandle() + (size_t) k * inputStride, inputLeadingDimension,
+                                      0, _output->cpuDataHandle() + (size_t) k * outputSize, outputSize * m_modelCount, &epilogue, m_partition);
+                }
+            }
+            else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                cublasHandle_t handle = Context<DeviceUsed>::getSingleton().cublasHandle(m_deviceId);
+
+                gemmStridedBatchedCUDA<DataType>(handle, CUBLAS_OP_N, CUBLAS_OP_N, outputSize, batchSize, inputSize,
+                                                 1.0f, _weight->gpuDataHandle(), outputSize, weightStride,
+                                                 _input->gpuDataHandle(), inputLeadingDimension, inputStride,
+                                                 0.0f, _output->gpuDataHandle(), outputSize * m_modelCount, outputSize, m_modelCount);
+
+                // the stacked biases are one column of the stacked rows
+                if (m_hasBias)
+                {
+                    gemmStridedBatchedCUDA<DataType>(handle, CUBLAS_OP_N, CUBLAS_OP_N, outputSize * m_modelCount, batchSize, 1,
+                                                     1.0f, _bias->gpuDataHandle(), outputSize * m_modelCount, 0,
+                                                     Context<DeviceUsed>::getSingleton().template getSharedOneVector<DataType>(batchSize), 1, 0,
+                                                     1.0f, _output->gpuDataHandle(), outputSize * m_modelCount, 0, 1);
+                }
+            }
+        }
+
+        bool initSparse()
+        {
+            FAIL_IF (!input("SparseColumns") || input("Weight")->shape().dimension() != 2 || output("Output")->shape().dimension() != 2);
+
+            FAIL_IF (!input("SparseRowOffsets")->template toType<unsigned int>() || !input("SparseColumns")->template toType<unsigned int>());
+
+            FAIL_IF (IsReducedPrecision<DataType>::value || (DeviceUsed == DeviceType::GPU_CUDA && !std::is_same<DataType, float>::value));
+
+            unsigned int batchSize = output("Output")->shape()[1];
+
+            FAIL_IF (input("Input")->shape().dimension() != 1 || input("SparseColumns")->shape() != input("Input")->shape());
+
+            FAIL_IF (input("SparseRowOffsets")->shape().dimension() != 1 || input("SparseRowOffsets")->shape()[0] < batchSize + 1);
+
+            FAIL_IF (input("Weight")->shape()[0] != output("Output")->shape()[0] || batchSize == 0);
+
+            FAIL_IF (m_hasBias && (!input("Bias") || input("Bias")->shape().dimension() != 1 || input("Bias")->shape()[0] != output("Output")->shape()[0]));
+
+            return true;
+        }
+
+        void evaluateSparse()
+        {
+            unsigned int batchSize = output(OUTPUT)->shape()[1];
+            unsigned int inputSize = input(WEIGHT)->shape()[1];
+            unsigned int outputSize = output(OUTPUT)->shape()[0];
+
+            Tensor<DeviceUsed, unsigned int> *rowOffsets = input(SPARSE_ROW_OFFSETS)->template toType<unsigned int>();
+            Tensor<DeviceUsed, unsigned int> *columns = input(SPARSE_COLUMNS)->template toType<unsigned int>();
+            Tensor<DeviceUsed, DataType> *values = input(INPUT)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *weight = input(WEIGHT)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_output = output(OUTPUT)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *bias = m_hasBias ? input(BIAS)->template toType<DataType>() : nullptr;
+
+            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+            {
+                GEMMEpilogueCPU<DataType> epilogue;
+                epilogue.m_rowBias = m_hasBias ? bias->cpuDataHandle() : nullptr;
+                epilogue.m_hasActivation = m_hasActivation;
+                epilogue.m_activationMode = m_activationMode;
+
+                sparseDotProductForwardCPU<DataType>(rowOffsets->cpuDataHandle(), columns->cpuDataHandle(), values->cpuDataHandle(),
+                                                     weight->cpuDataHandle(), inputSize, outputSize, batchSize, _output->cpuDataHandle(), epilogue);
+            }
+            else if constexpr (DeviceUsed == DeviceType::GPU_CUDA && std::is_same<DataType, float>::value)
+            {
+                sparseDotProductForwardCUDAKernel<DataType>(rowOffsets->gpuDataHandle(), columns->gpuDataHandle(), values->gpuDataHandle(),
+                                                            weight->gpuDataHandle(), m_hasBias ? bias->gpuDataHandle() : nullptr,
+                                                            inputSize, outputSize, batchSize, _output->gpuDataHandle());
+            }
+        }
+
     public:
+        enum InputSlot : unsigned int {INPUT, WEIGHT, BIAS, SPARSE_ROW_OFFSETS, SPARSE_COLUMNS};
+        enum OutputSlot : unsigned int {OUTPUT};
+
         DotProductWithBias(bool hasBias = true, unsigned int deviceId = 0)
-            :Operator<DeviceUsed>({"Input", "Weight","Bias"},{"Output"}, deviceId),
-            m_hasBias(hasBias)
+            :Operator<DeviceUsed>({"Input", "Weight","Bias", "SparseRowOffsets", "SparseColumns"},{"Output"}, deviceId),
+            m_hasBias(hasBias),
+            m_hasActivation(false),
+            m_activationMode(ActivationMode::SIGMOID),
+            m_partition(GEMMPartitionCPU::AUTOMATIC),
+            m_isSparse(false),
+            m_modelCount(1)
         {
                 
         }
 
+        // the models stacked along the last dimension of the weights, set before init
+        void setModelCount(unsigned int modelCount)
+        {
+            m_modelCount = std::max(1u, modelCount);
+        }
+
+        // Output = activation(Weight * Input + Bias) in the gemm writeback, set before init.
+        // cuBLAS has no epilogue, so it is cpu only.
+        void fuseActivation(ActivationMode activationMode)
+        {
+            m_hasActivation = true;
+            m_activationMode = activationMode;
+        }
+
         virtual bool init()
         {
             CHECK_GPU;
 
             FAIL_IF(input("Input")==0 || input("Weight")==0 || output("Output") == 0);
 
+            m_isSparse = input("SparseRowOffsets") != nullptr;
+
+            if (m_isSparse)
+            {
+                FAIL_IF (m_modelCount > 1);
+
+                FAIL_IF (m_hasActivation && (DeviceUsed != DeviceType::CPU_NAIVE || !isActivationImplementedCPU(m_activationMode)));
+
+                return initSparse();
+            }
+
+            if (m_modelCount > 1)
+            {
+                return initStacked();
+            }
+
             FAIL_IF ((input("Input")->shape().dimension() != 2) || 
                     (input("Weight")->shape().dimension() !=2) || 
                     (output("Output")->shape().dimension() != 2));
@@ -60,7 +256,44 @@ namespace FreeWill
                               
                 FAIL_IF (input("Bias")->shape()[0] != outputSize);
             }
-            
+
+            FAIL_IF (m_hasActivation && (DeviceUsed != DeviceType::CPU_NAIVE || !isActivationImplementedCPU(m_activationMode)));
+
+            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE && !IsReducedPrecision<DataType>::value)
+            {
+                m_partition = GEMMPartitionCPU::AUTOMATIC;
+
+                // how the thread pool shares the gemm, timed on scratch matrices of this shape
+                if (ThreadPool::getSingleton().threadCount() > 0)
+                {
+                    const GEMMPartitionCPU partitions[] = {GEMMPartitionCPU::SERIAL, GEMMPartitionCPU::ROWS, GEMMPartitionCPU::COLUMNS};
+                    CPUAutotuner &autotuner = CPUAutotuner::getSingleton();
+                    std::string key = autotuner.key("gemm", std::to_string(outputSize) + "x" + std::to_string(batchSize) + "x" + std::to_string(inputSize));
+                    std::vector<DataType> weight;
+                    std::vector<DataType> scratchInput;
+                    std::vector<DataType> scratchOutput;
+
+                    int variant = autotuner.tune(key, 3, -1, [&](unsigned int variant)
+                    {
+                        if (weight.empty())
+                        {
+                            weight.assign((size_t) outputSize * inputSize, 0.5);
+                            scratchInput.assign((size_t) inputSize * batchSize, 0.5);
+                            scratchOutput.resize((size_t) outputSize * batchSize);
+                        }
+
+                        gemmCPU<DataType>(false, false, outputSize, batchSize, inputSize,
+                                          1, weight.data(), outputSize, scratchInput.data(), inputSize,
+                                          0, scratchOutput.data(), outputSize, nullptr, partitions[variant]);
+                    });
+
+                    if (variant >= 0)
+                    {
+                        m_partition = partitions[variant];
+                    }
+                }
+            }
+
             return true;
         }
 
@@ -68,33 +301,54 @@ namespace FreeWill
         {
             CHECK_GPU;
 
-            unsigned int batchSize = input("Input")->shape()[1];
-            unsigned int inputSize = input("Input")->shape()[0];
-            unsigned int outputSize = output("Output")->shape()[0];
+            if (m_isSparse)
+            {
+                evaluateSparse();
+                return;
+            }
+
+            if (m_modelCount > 1)
+            {
+                evaluateStacked();
+                return;
+            }
 
-            Tensor<DeviceUsed, DataType> *_input = input("Input")->template toType<DataType>();
-            Tensor<DeviceUsed, DataType> *_weight = input("Weight")->template toType<DataType>();
-            Tensor<DeviceUsed, DataType> *_output = output("Output")->template toType<DataType>();
-            Tensor<DeviceUsed, DataType> *_bias = input("Bias")->template toType<DataType>();
+            unsigned int batchSize = input(INPUT)->shape()[1];
+            unsigned int inputSize = input(INPUT)->shape()[0];
+            unsigned int outputSize = output(OUTPUT)->shape()[0];
+
+            Tensor<DeviceUsed, DataType> *_input = input(INPUT)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_weight = input(WEIGHT)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_output = output(OUTPUT)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_bias = m_hasBias ? input(BIAS)->template toType<DataType>() : nullptr;
 
             if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
             {
-                for(unsigned int b = 0; b < batchSize; ++b)
-                {
-                    for(unsigned int o =0; o<outputSize;++o)
-                    {
-                        (*_output)[b * outputSize + o] = 0;
-                        for(unsigned int i = 0; i< inputSize; ++i)
-                        {
-                            (*_output)[b * outputSize + o] += (*_weight)[i * outputSize + o] * (*_input)[b* inputSize + i];
-                        }
+                GEMMEpilogueCPU<DataType> epilogue;
+                epilogue.m_rowBias = m_hasBias ? _bias->cpuDataHandle() : nullptr;
+                epilogue.m_hasActivation = m_hasActivation;
+                epilogue.m_activationMode = m_activationMode;
 
-                        if (m_hasBias)
-                        {
-                            (*_output)[b * outputSize + o] += (*_bias)[ o];
-                        }
-                    }
-                }        
+                gemmCPU<DataType>(false, false, outputSize, batchSize, inputSize,
+                                  1, _weight->cpuDataHandle(), outputSize,
+                                  _input->cpuDataHandle(), inputSize,
+                                  0, _output->cpuDataHandle(), outputSize, &epilogue, m_partition);
+            }
+            else if constexpr (DeviceUsed == DeviceType::GPU_CUDA && IsReducedPrecision<DataType>::value)
+            {
+                cublasHandle_t handle = Context<DeviceUsed>::getSingleton().cublasHandle(m_deviceId);
+
+                gemmReducedPrecisionCUDA<DataType>(handle, CUBLAS_OP_N, CUBLAS_OP_N, outputSize, batchSize, inputSize,
+                                                   1.0f, _weight->gpuDataHandle(), outputSize,
+                                                   _input->gpuDataHandle(), inputSize, 0.0f, _output->gpuDataHandle(), outputSize);
+
+                if (m_hasBias)
+                {
+                    gemmReducedPrecisionCUDA<DataType>(handle, CUBLAS_OP_N, CUBLAS_OP_N, outputSize, batchSize, 1,
+                                                       1.0f, _bias->gpuDataHandle(), outputSize,
+                                                       Context<DeviceUsed>::getSingleton().template getSharedOneVector<DataType>(batchSize), 1,
+                                                       1.0f, _output->gpuDataHandle(), outputSize);
+                }
             }
             else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
             {
@@ -2,10 +2,35 @@
 #define DOTPRODUCTWITHBIASDERIVATIVE_H
 
 #include "Operator.h"
+#include <algorithm>
+#include <type_traits>
+#include <vector>
 #include "../Context/Context.h"
+#include "GEMM_CPU.h"
+#include "GEMM_CUDA.h"
+#include "BiasGradient_CUDA.h"
+#include "SparseDotProduct_CPU.h"
+#include "SparseDotProduct_CUDA.h"
 
 namespace FreeWill
 {
+    // The cpu adds to WeightGrad and BiasGrad, the gpu overwrites them unless setAccumulating
+    // asks it to add (beta 1), see Solver::m_gradientAccumulationCount. InputDelta is always
+    // overwritten.
+    //
+    // Two gemms and one pass over OutputDelta summing it over the batch for BiasGrad. On gpu the
+    // InputDelta gemm, which the gradients of the weight and the bias don't wait for, runs on the
+    // other compute lane of the device, and the operator's lane waits for it before going on.
+    //
+    // With SparseRowOffsets and SparseColumns bound, InputActivation is the CSR values of a
+    // sparse batch like in DotProductWithBias. The weight gradient then only adds to the columns
+    // of the input indices present (on gpu the rest is zeroed first unless accumulating), and
+    // InputDelta is optional, the gradient of the values when bound.
+    //
+    // With setModelCount(K) the tensors stack K models like in DotProductWithBias, WeightGrad
+    // and BiasGrad like Weight and Bias, InputDelta like InputActivation. Each gemm is one
+    // strided batched gemm on gpu. With a shared InputActivation {in, batch}, InputDelta is the
+    // sum of the models' input gradients.
     template<DeviceType DeviceUsed = DeviceType::CPU_NAIVE, typename DataType = float>
     class DotProductWithBiasDerivative : public Operator<DeviceUsed>
     {
@@ -14,19 +39,318 @@ namespace FreeWill
         using Operator<DeviceUsed>::output;
         using Operator<DeviceUsed>::m_deviceId;
         bool m_hasBias;
+        bool m_isAccumulating;
+        bool m_isSparse;
+        unsigned int m_modelCount;
+        // the InputDelta gemm leaving the operator's lane and joining it again
+        cudaEvent_t m_forkEvent;
+        cudaEvent_t m_joinEvent;
+
+        // biasGrad += the sum of outputGrad over the batch, the samples read in order; 16-bit
+        // types are summed in float, a 16-bit sum over the batch would lose the small terms
+        static void biasGradientCPU(const DataType *outputGrad, unsigned int outputSize, unsigned int batchSize, DataType *biasGrad)
+        {
+            typedef typename std::conditional<IsReducedPrecision<DataType>::value, float, DataType>::type AccumulateType;
+
+            std::vector<AccumulateType> sums(biasGrad, biasGrad + outputSize);
+
+            for (unsigned int b = 0; b < batchSize; ++b)
+            {
+                const DataType *deltaColumn = outputGrad + (size_t) b * outputSize;
+
+                for (unsigned int i = 0; i < outputSize; ++i)
+                {
+                    sums[i] += (AccumulateType) deltaColumn[i];
+                }
+            }
+
+            for (unsigned int i = 0; i < outputSize; ++i)
+            {
+                biasGrad[i] = (DataType) sums[i];
+            }
+        }
+
+        // column-major C = A * B + beta * C on the stream of handle
+        static void gemmCUDA(cublasHandle_t handle, cublasOperation_t transA, cublasOperation_t transB,
+                             unsigned int M, unsigned int N, unsigned int K,
+                             const DataType *A, unsigned int lda, const DataType *B, unsigned int ldb,
+                             float beta, DataType *C, unsigned int ldc)
+        {
+            if constexpr (IsReducedPrecision<DataType>::value)
+            {
+                gemmReducedPrecisionCUDA<DataType>(handle, transA, transB, M, N, K, 1.0f, A, lda, B, ldb, beta, C, ldc);
+            }
+            else if constexpr (std::is_same<DataType, float>::value)
+            {
+                float alpha = 1.0f;
+                RUN_CUBLAS(cublasSgemm(handle, transA, transB, M, N, K, &alpha, A, lda, B, ldb, &beta, C, ldc));
+            }
+            else if constexpr (std::is_same<DataType, double>::value)
+            {
+                double alpha = 1.0;
+                double doubleBeta = beta;
+                RUN_CUBLAS(cublasDgemm(handle, transA, transB, M, N, K, &alpha, A, lda, B, ldb, &doubleBeta, C, ldc));
+            }
+        }
+
+        bool initStacked()
+        {
+            FAIL_IF (!std::is_floating_point<DataType>::value && !IsReducedPrecision<DataType>::value);
+
+            FAIL_IF (!output("WeightGrad") || !output("InputDelta"));
+
+            FAIL_IF (input("Weight")->shape().dimension() != 3 || input("Weight")->shape()[2] != m_modelCount ||
+                     output("WeightGrad")->shape() != input("Weight")->shape());
+
+            unsigned int outputSize = input("Weight")->shape()[0];
+            unsigned int inputSize = input("Weight")->shape()[1];
+
+            FAIL_IF (input("OutputDelta")->shape().dimension() != 3 || input("OutputDelta")->shape()[0] != outputSize ||
+                     input("OutputDelta")->shape()[1] != m_modelCount);
+
+            unsigned int batchSize = input("OutputDelta")->shape()[2];
+
+            const Shape &inputShape = input("InputActivation")->shape();
+
+            FAIL_IF (inputShape != Shape({inputSize, batchSize}) && inputShape != Shape({inputSize, m_modelCount, batchSize}));
+
+            FAIL_IF (output("InputDelta")->shape() != inputShape);
+
+            FAIL_IF (m_hasBias && (!output("BiasGrad") || output("BiasGrad")->shape() != Shape({outputSize, m_modelCount})));
+
+            return true;
+        }
+
+        void evaluateStacked()
+        {
+            unsigned int outputSize = input(WEIGHT)->shape()[0];
+            unsigned int inputSize = input(WEIGHT)->shape()[1];
+            unsigned int batchSize = input(OUTPUT_DELTA)->shape()[2];
+
+            bool isInputShared = input(INPUT_ACTIVATION)->shape().dimension() == 2;
+            unsigned int inputStride = isInputShared ? 0 : inputSize;
+            unsigned int inputLeadingDimension = isInputShared ? inputSize : inputSize * m_modelCount;
+            unsigned int outputLeadingDimension = outputSize * m_modelCount;
+            unsigned int weightStride = outputSize * inputSize;
+
+            Tensor<DeviceUsed, DataType> *preActivation = input(INPUT_ACTIVATION)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *outputGrad = input(OUTPUT_DELTA)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *weightGrad = output(WEIGHT_GRAD)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *inputGrad = output(INPUT_DELTA)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *weight = input(WEIGHT)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *biasGrad = m_hasBias ? output(BIAS_GRAD)->template toType<DataType>() : nullptr;
+
+            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+            {
+                for (unsigned int k = 0; k < m_modelCount; ++k)
+                {
+                    gemmCPU<DataType>(false, true, outputSize, inputSize, batchSize,
+                                      1.0f, outputGrad->cpuDataHandle() + (size_t) k * outputSize, outputLeadingDimension,
+                                      preActivation->cpuDataHandle() + (size_t) k * inputStride, inputLeadingDimension,
+                                      1.0f, weightGrad->cpuDataHandle() + (size_t) k * weightStride, outputSize);
+
+                    gemmCPU<DataType>(true, false, inputSize, batchSize, outputSize,
+                                      1.0f, weight->cpuDataHandle() + (size_t) k * weightStride, outputSize,
+                                      outputGrad->cpuDataHandle() + (size_t) k * outputSize, outputLeadingDimension,
+                                      isInputShared && k > 0 ? 1.0f : 0.0f, inputGrad->cpuDataHandle() + (size_t) k * inputStride, inputLeadingDimension);
+                }
+
+                // the stacked biases are the rows of all the models
+                if (m_hasBias)
+                {
+                    biasGradientCPU(outputGrad->cpuDataHandle(), outputLeadingDimension, batchSize, biasGrad->cpuDataHandle());
+                }
+            }
+            else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                Context<DeviceUsed> &context = Context<DeviceUsed>::getSingleton();
+                unsigned int lane = context.computeLane(m_deviceId);
+                unsigned int sideLane = (lane + 1) % Device<DeviceType::GPU_CUDA>::COMPUTE_LANE_COUNT;
+                cudaStream_t sideStream = context.computeStream(m_deviceId, sideLane);
+                cublasHandle_t sideHandle = context.cublasHandle(m_deviceId, sideLane);
+                float gradBeta = m_isAccumulating ? 1.0f : 0.0f;
+
+                RUN_CUDA(cudaEventRecord(m_forkEvent, computeStream()));
+                RUN_CUDA(cudaStreamWaitEvent(sideStream, m_forkEvent, 0));
+
+                if (isInputShared)
+                {
+                    // the models add to the same gradient one after the other
+                    for (unsigned int k = 0; k < m_modelCount; ++k)
+                    {
+                        gemmCUDA(sideHandle, CUBLAS_OP_T, CUBLAS_OP_N, inputSize, batchSize, outputSize,
+                                 weight->gpuDataHandle() + (size_t) k * weightStride, outputSize,
+                                 outputGrad->gpuDataHandle() + (size_t) k * outputSize, outputLeadingDimension,
+                                 k > 0 ? 1.0f : 0.0f, inputGrad->gpuDataHandle(), inputSize);
+                    }
+                }
+                else
+                {
+                    gemmStridedBatchedCUDA<DataType>(sideHandle, CUBLAS_OP_T, CUBLAS_OP_N, inputSize, batchSize, outputSize,
+                                                     1.0f, weight->gpuDataHandle(), outputSize, weightStride,
+                                                     outputGrad->gpuDataHandle(), outputLeadingDimension, outputSize,
+                                                     0.0f, inputGrad->gpuDataHandle(), inputLeadingDimension, inputSize, m_modelCount);
+                }
+
+                RUN_CUDA(cudaEventRecord(m_joinEvent, sideStream));
+
+                gemmStridedBatchedCUDA<DataType>(context.cublasHandle(m_deviceId), CUBLAS_OP_N, CUBLAS_OP_T, outputSize, inputSize, batchSize,
+                                                 1.0f, outputGrad->gpuDataHandle(), outputLeadingDimension, outputSize,
+                                                 preActivation->gpuDataHandle(), inputLeadingDimension, inputStride,
+                                                 gradBeta, weightGrad->gpuDataHandle(), outputSize, weightStride, m_modelCount);
+
+                if (m_hasBias)
+                {
+                    biasGradientCUDAKernel<DataType>(outputGrad->gpuDataHandle(), outputLeadingDimension, batchSize, biasGrad->gpuDataHandle(), m_isAccumulating);
+                }
+
+                RUN_CUDA(cudaStreamWaitEvent(computeStream(), m_joinEvent, 0));
+            }
+        }
+
+        bool initSparse()
+        {
+            FAIL_IF (!input("SparseColumns") || !output("WeightGrad"));
+
+            FAIL_IF (!input("SparseRowOffsets")->template toType<unsigned int>() || !input("SparseColumns")->template toType<unsigned int>());
+
+            FAIL_IF (IsReducedPrecision<DataType>::value || (DeviceUsed == DeviceType::GPU_CUDA && !std::is_same<DataType, float>::value));
+
+            FAIL_IF (input("Weight")->shape().dimension() != 2 || output("WeightGrad")->shape() != input("Weight")->shape());
+
+            FAIL_IF (input("OutputDelta")->shape().dimension() != 2 || input("OutputDelta")->shape()[0] != input("Weight")->shape()[0]);
+
+            unsigned int batchSize = input("OutputDelta")->shape()[1];
+
+            FAIL_IF (input("InputActivation")->shape().dimension() != 1 || input("SparseColumns")->shape() != input("InputActivation")->shape());
+
+            FAIL_IF (input("SparseRowOffsets")->shape().dimension() != 1 || input("SparseRowOffsets")->shape()[0] < batchSize + 1);
+
+            FAIL_IF (output("InputDelta") && output("InputDelta")->shape() != input("InputActivation")->shape());
+
+            if (m_hasBias)
+            {
+                FAIL_IF (!output("BiasGrad") || output("BiasGrad")->shape().dimension() != 1 || output("BiasGrad")->shape()[0] != input("Weight")->shape()[0]);
+            }
+
+            return true;
+        }
+
+        void evaluateSparse()
+        {
+            unsigned int outputSize = input(WEIGHT)->shape()[0];
+            unsigned int inputSize = input(WEIGHT)->shape()[1];
+            unsigned int batchSize = input(OUTPUT_DELTA)->shape()[1];
+
+            Tensor<DeviceUsed, unsigned int> *rowOffsets = input(SPARSE_ROW_OFFSETS)->template toType<unsigned int>();
+            Tensor<DeviceUsed, unsigned int> *columns = input(SPARSE_COLUMNS)->template toType<unsigned int>();
+            Tensor<DeviceUsed, DataType> *values = input(INPUT_ACTIVATION)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *outputGrad = input(OUTPUT_DELTA)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *weight = input(WEIGHT)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *weightGrad = output(WEIGHT_GRAD)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *biasGrad = m_hasBias ? output(BIAS_GRAD)->template toType<DataType>() : nullptr;
+            Tensor<DeviceUsed, DataType> *inputGrad = output(INPUT_DELTA) ? output(INPUT_DELTA)->template toType<DataType>() : nullptr;
+
+            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+            {
+                sparseDotProductWeightGradCPU<DataType>(rowOffsets->cpuDataHandle(), columns->cpuDataHandle(), values->cpuDataHandle(),
+                                                        outputGrad->cpuDataHandle(), inputSize, outputSize, batchSize, weightGrad->cpuDataHandle());
+
+                if (m_hasBias)
+                {
+                    biasGradientCPU(outputGrad->cpuDataHandle(), outputSize, batchSize, biasGrad->cpuDataHandle());
+                }
+
+                if (inputGrad)
+                {
+                    sparseDotProductInputDeltaCPU<DataType>(rowOffsets->cpuDataHandle(), columns->cpuDataHandle(), weight->cpuDataHandle(),
+                                                            outputGrad->cpuDataHandle(), inputSize, outputSize, batchSize, inputGrad->cpuDataHandle());
+                }
+            }
+            else if constexpr (DeviceUsed == DeviceType::GPU_CUDA && std::is_same<DataType, float>::value)
+            {
+                if (!m_isAccumulating)
+                {
+                    RUN_CUDA(cudaMemsetAsync(weightGrad->gpuDataHandle(), 0, weightGrad->shape().size() * sizeof(DataType), computeStream()));
+                }
+
+                sparseDotProductWeightGradCUDAKernel<DataType>(rowOffsets->gpuDataHandle(), columns->gpuDataHandle(), values->gpuDataHandle(),
+                                                               outputGrad->gpuDataHandle(), inputSize, outputSize, batchSize, weightGrad->gpuDataHandle());
+
+                if (m_hasBias)
+                {
+                    biasGradientCUDAKernel<DataType>(outputGrad->gpuDataHandle(), outputSize, batchSize, biasGrad->gpuDataHandle(), m_isAccumulating);
+                }
+
+                if (inputGrad)
+                {
+                    sparseDotProductInputDeltaCUDAKernel<DataType>(rowOffsets->gpuDataHandle(), columns->gpuDataHandle(), weight->gpuDataHandle(),
+                                                                   outputGrad->gpuDataHandle(), inputSize, outputSize, batchSize, inputGrad->gpuDataHandle());
+                }
+            }
+        }
 
     public:
+        enum InputSlot : unsigned int {INPUT_ACTIVATION, OUTPUT_DELTA, WEIGHT, SPARSE_ROW_OFFSETS, SPARSE_COLUMNS};
+        enum OutputSlot : unsigned int {WEIGHT_GRAD, BIAS_GRAD, INPUT_DELTA};
+
         DotProductWithBiasDerivative(bool hasBias = true, unsigned int deviceId = 0)
-            :Operator<DeviceUsed>({"InputActivation", "OutputDelta", "Weight"},{"WeightGrad", "BiasGrad", "InputDelta"}, deviceId),
-             m_hasBias(hasBias)
+            :Operator<DeviceUsed>({"InputActivation", "OutputDelta", "Weight", "SparseRowOffsets", "SparseColumns"},{"WeightGrad", "BiasGrad", "InputDelta"}, deviceId),
+             m_hasBias(hasBias),
+             m_isAccumulating(false),
+             m_isSparse(false),
+             m_modelCount(1),
+             m_forkEvent(0),
+             m_joinEvent(0)
+        {
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                RUN_CUDA(cudaEventCreateWithFlags(&m_forkEvent, cudaEventDisableTiming));
+                RUN_CUDA(cudaEventCreateWithFlags(&m_joinEvent, cudaEventDisableTiming));
+            }
+        }
+
+        ~DotProductWithBiasDerivative()
         {
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                RUN_CUDA(cudaEventDestroy(m_forkEvent));
+                RUN_CUDA(cudaEventDestroy(m_joinEvent));
+            }
+        }
+
+        void setAccumulating(bool isAccumulating)
+        {
+            m_isAccumulating = isAccumulating;
+        }
+
+        // see DotProductWithBias::setModelCount
+        void setModelCount(unsigned int modelCount)
+        {
+            m_modelCount = std::max(1u, modelCount);
         }
         
         virtual bool init()
         {
             CHECK_GPU;
 
-            FAIL_IF(!input("InputActivation") || !input("OutputDelta") || !input("Weight") || !output("WeightGrad") || !output("InputDelta"));
+            FAIL_IF(!input("InputActivation") || !input("OutputDelta") || !input("Weight"));
+
+            m_isSparse = input("SparseRowOffsets") != nullptr;
+
+            if (m_isSparse)
+            {
+                FAIL_IF (m_modelCount > 1);
+
+                return initSparse();
+            }
+
+            if (m_modelCount > 1)
+            {
+                return initStacked();
+            }
+
+            FAIL_IF(!output("WeightGrad") || !output("InputDelta"));
            
             if (m_hasBias)
             {
@@ -65,104 +389,106 @@ namespace FreeWill
         virtual void evaluate()
         {
            CHECK_GPU;
-           unsigned int outputSize = input("Weight")->shape()[0];
-           unsigned int inputSize = input("InputActivation")->shape()[0];
-           unsigned int batchSize = input("InputActivation")->shape()[1];
+
+           if (m_isSparse)
+           {
+               evaluateSparse();
+               return;
+           }
+
+           if (m_modelCount > 1)
+           {
+               evaluateStacked();
+               return;
+           }
+
+           unsigned int outputSize = input(WEIGHT)->shape()[0];
+           unsigned int inputSize = input(INPUT_ACTIVATION)->shape()[0];
+           unsigned int batchSize = input(INPUT_ACTIVATION)->shape()[1];
 
            //printf("inputsize:%d, batchsize:%d, outputsize:%d\n", inputSize, batchSize, outputSize);
            //unsigned int weightSize = outputSize * inputSize;
 
-           Tensor<DeviceUsed, DataType> *preActivation = input("InputActivation")->template toType<DataType>();
-           Tensor<DeviceUsed, DataType> *outputGrad = input("OutputDelta")->template toType<DataType>();
-           Tensor<DeviceUsed, DataType> *weightGrad = output("WeightGrad")->template toType<DataType>();
-           Tensor<DeviceUsed, DataType> *inputGrad = output("InputDelta")->template toType<DataType>();
-           Tensor<DeviceUsed, DataType> *weight = input("Weight")->template toType<DataType>();
-           Tensor<DeviceUsed, DataType> *biasGrad = output("BiasGrad")->template toType<DataType>();
+           Tensor<DeviceUsed, DataType> *preActivation = input(INPUT_ACTIVATION)->template toType<DataType>();
+           Tensor<DeviceUsed, DataType> *outputGrad = input(OUTPUT_DELTA)->template toType<DataType>();
+           Tensor<DeviceUsed, DataType> *weightGrad = output(WEIGHT_GRAD)->template toType<DataType>();
+           Tensor<DeviceUsed, DataType> *inputGrad = output(INPUT_DELTA)->template toType<DataType>();
+           Tensor<DeviceUsed, DataType> *weight = input(WEIGHT)->template toType<DataType>();
+           Tensor<DeviceUsed, DataType> *biasGrad = m_hasBias ? output(BIAS_GRAD)->template toType<DataType>() : nullptr;
 
-           if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+           if constexpr (!std::is_floating_point<DataType>::value && !IsReducedPrecision<DataType>::value)
            {
-                for(unsigned int b = 0;b<batchSize;++b)
+                // integer tensors have no gemm, the cpu computes them directly and the gpu leaves them
+                if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
                 {
-                    for(unsigned int e = 0; e<inputSize; ++e)
+                    for (unsigned int b = 0; b < batchSize; ++b)
                     {
-                        for(unsigned int i =0;i<outputSize;++i)
+                        for (unsigned int e = 0; e < inputSize; ++e)
                         {
-                            /*if (e*outputSize + i == 0)
+                            for (unsigned int i = 0; i < outputSize; ++i)
+                            {
+                                (*weightGrad)[e * outputSize + i] += (*preActivation)[b * inputSize + e] * (*outputGrad)[b * outputSize + i];
+                            }
+
+                            DataType sum = 0;
+                            for (unsigned int i = 0; i < outputSize; ++i)
                             {
-                                printf("adding %f %f\n", (*preActivation)[b*inputSize + e] , (*outputGrad)[b*outputSize + i]);
-                            }*/ 
-                            (*weightGrad)[ e * outputSize + i] += (*preActivation)[b*inputSize + e] * (*outputGrad)[b*outputSize + i];
+                                sum += (*weight)[e * outputSize + i] * (*outputGrad)[b * outputSize + i];
+                            }
+                            (*inputGrad)[b * inputSize + e] = sum;
                         }
-                    }     
+                    }
 
                     if (m_hasBias)
                     {
-                        for(unsigned int i =0;i<outputSize;++i)
-                        {
-                            (*biasGrad)[i] += (*outputGrad)[b*outputSize + i];
-                        }
+                        biasGradientCPU(outputGrad->cpuDataHandle(), outputSize, batchSize, biasGrad->cpuDataHandle());
                     }
                 }
+           }
+           else if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+           {
+                gemmCPU<DataType>(false, true, outputSize, inputSize, batchSize,
+                                  1.0f, outputGrad->cpuDataHandle(), outputSize,
+                                  preActivation->cpuDataHandle(), inputSize,
+                                  1.0f, weightGrad->cpuDataHandle(), outputSize);
 
-                for (unsigned int b = 0; b < batchSize; ++b)
+                if (m_hasBias)
                 {
-                    for(unsigned int i = 0;i<inputSize;++i)
-                    {
-                        (*inputGrad)[b *inputSize +  i] = 0;
-
-                        for (unsigned int e = 0;e<outputSize;++e)
-                        {
-                            (*inputGrad)[b*inputSize + i] += (*weight)[i * outputSize + e] * (*outputGrad)[b*outputSize + e];
-                        }
-                    }
+                    biasGradientCPU(outputGrad->cpuDataHandle(), outputSize, batchSize, biasGrad->cpuDataHandle());
                 }
+
+                gemmCPU<DataType>(true, false, inputSize, batchSize, outputSize,
+                                  1.0f, weight->cpuDataHandle(), outputSize,
+                                  outputGrad->cpuDataHandle(), outputSize,
+                                  0.0f, inputGrad->cpuDataHandle(), inputSize);
            }
            else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
            {
-               DataType alpha = 1.0;
-               DataType beta = 0.0;
+                Context<DeviceUsed> &context = Context<DeviceUsed>::getSingleton();
+                unsigned int lane = context.computeLane(m_deviceId);
+                unsigned int sideLane = (lane + 1) % Device<DeviceType::GPU_CUDA>::COMPUTE_LANE_COUNT;
+                cudaStream_t sideStream = context.computeStream(m_deviceId, sideLane);
+                float gradBeta = m_isAccumulating ? 1.0f : 0.0f;
 
-                if constexpr (std::is_same<DataType, float>::value)
-                {
-                    RUN_CUBLAS(cublasSgemm(Context<DeviceUsed>::getSingleton().cublasHandle(m_deviceId), CUBLAS_OP_N, CUBLAS_OP_T,
-                                           outputSize, inputSize, batchSize, &alpha, outputGrad->gpuDataHandle(), outputSize,
-                                           preActivation->gpuDataHandle(), inputSize, 
-                                           &beta, weightGrad->gpuDataHandle(), outputSize));
-                    if (m_hasBias)
-                    {
-                        RUN_CUBLAS(cublasSgemv(Context<DeviceUsed>::getSingleton().cublasHandle(m_deviceId),CUBLAS_OP_N,
-                                    outputSize, batchSize, &alpha, outputGrad->gpuDataHandle(),outputSize,
-                                    Context<DeviceUsed>::getSingleton().template getSharedOneVector<DataType>(batchSize), 1, 
-                                     &beta,biasGrad->gpuDataHandle(), 1));
-                    }
+                RUN_CUDA(cudaEventRecord(m_forkEvent, computeStream()));
+                RUN_CUDA(cudaStreamWaitEvent(sideStream, m_forkEvent, 0));
 
-                    RUN_CUBLAS(cublasSgemm(Context<DeviceUsed>::getSingleton().cublasHandle(m_deviceId), CUBLAS_OP_T, CUBLAS_OP_N,
-                                           inputSize, batchSize, outputSize, &alpha, weight->gpuDataHandle(), outputSize,
-                                           outputGrad->gpuDataHandle(), outputSize, 
-                                           &beta, inputGrad->gpuDataHandle(), inputSize));
+                gemmCUDA(context.cublasHandle(m_deviceId, sideLane), CUBLAS_OP_T, CUBLAS_OP_N, inputSize, batchSize, outputSize,
+                         weight->gpuDataHandle(), outputSize, outputGrad->gpuDataHandle(), outputSize,
+                         0.0f, inputGrad->gpuDataHandle(), inputSize);
 
-                }
-                else if constexpr (std::is_same<DataType, double>::value)
-                {
-                     RUN_CUBLAS(cublasDgemm(Context<DeviceUsed>::getSingleton().cublasHandle(m_deviceId), CUBLAS_OP_N, CUBLAS_OP_T,
-                                           outputSize, inputSize, batchSize, &alpha, outputGrad->gpuDataHandle(), outputSize,
-                                           preActivation->gpuDataHandle(), inputSize, 
-                                           &beta, weightGrad->gpuDataHandle(), outputSize));
-                    if (m_hasBias)
-                    {
-                        RUN_CUBLAS(cublasDgemv(Context<DeviceUsed>::getSingleton().cublasHandle(m_deviceId),CUBLAS_OP_N,
-                                    outputSize, batchSize, &alpha, outputGrad->gpuDataHandle(),outputSize,
-                                    Context<DeviceUsed>::getSingleton().template getSharedOneVector<DataType>(batchSize), 1,
-                                     &beta,biasGrad->gpuDataHandle(), 1));
-                    }
+                RUN_CUDA(cudaEventRecord(m_joinEvent, sideStream));
 
-                    RUN_CUBLAS(cublasDgemm(Context<DeviceUsed>::getSingleton().cublasHandle(m_deviceId), CUBLAS_OP_T, CUBLAS_OP_N,
-                                           inputSize, batchSize, outputSize, &alpha, weight->gpuDataHandle(), outputSize,
-                                           outputGrad->gpuDataHandle(), outputSize, 
-                                           &beta, inputGrad->gpuDataHandle(), inputSize));
+                gemmCUDA(context.cublasHandle(m_deviceId), CUBLAS_OP_N, CUBLAS_OP_T, outputSize, inputSize, batchSize,
+                         outputGrad->gpuDataHandle(), outputSize, preActivation->gpuDataHandle(), inputSize,
+                         gradBeta, weightGrad->gpuDataHandle(), outputSize);
 
-                }                
-           
+                if (m_hasBias)
+                {
+                    biasGradientCUDAKernel<DataType>(outputGrad->gpuDataHandle(), outputSize, batchSize, biasGrad->gpuDataHandle(), m_isAccumulating);
+                }
+
+                RUN_CUDA(cudaStreamWaitEvent(computeStream(), m_joinEvent, 0));
            }
         }        
     };
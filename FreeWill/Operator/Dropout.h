@@ -0,0 +1,159 @@
+#ifndef DROPOUT_H
+#define DROPOUT_H
+
+#include <algorithm>
+
+#include "Operator.h"
+#include "Dropout_CPU.h"
+#include "Dropout_CUDA.h"
+#include "../DeviceSelection.h"
+#include "../Tensor/Tensor.h"
+#include "../Tensor/RandomNumberGenerator.h"
+
+namespace FreeWill
+{
+    // What a dropout draws its masks from: the rate, the Philox stream and the seed, taken at
+    // init(). The Seed tensor holds the draw counter, one unsigned int, which the forward pass
+    // advances in the tensor's own memory (so a captured graph draws a new mask every replay)
+    // and the backward pass reads to find the mask again. The Mask tensor (dropoutMaskShape) is
+    // optional: bound, the forward pass stores the mask bits and the backward pass reads them;
+    // unbound, the backward pass draws them again and nothing is stored.
+    //
+    // Activation inherits it too, a dropout fused into the activation before it (see
+    // Model::fuseOperators) masks each item as soon as it is activated.
+    //
+    // A replaying dropout (the copy Model::planRecomputation runs in the backward pass) draws the
+    // mask of the last draw again instead of advancing the counter.
+    class DropoutState
+    {
+    protected:
+        float m_dropoutRate;
+        uint64_t m_dropoutStream;
+        uint64_t m_dropoutSeed;
+        bool m_isDropoutReplayed;
+
+        DropoutState(float rate, uint64_t stream)
+            :m_dropoutRate(rate),
+            m_dropoutStream(stream),
+            m_dropoutSeed(0),
+            m_isDropoutReplayed(false)
+        {}
+
+        // whether the rate and the tensors fit, and takes the seed
+        template<DeviceType DeviceUsed>
+        bool initDropout(TensorBase<DeviceUsed> *data, TensorBase<DeviceUsed> *mask, TensorBase<DeviceUsed> *seed)
+        {
+            if (m_dropoutRate < 0.0f || m_dropoutRate >= 1.0f || !seed || seed->shape().size() != 1 ||
+                    (mask && mask->shape() != dropoutMaskShape(data->shape())))
+            {
+                return false;
+            }
+
+            m_dropoutSeed = RandomNumberGenerator::getSingleton().seed();
+
+            return true;
+        }
+
+        // output = dropout(transform(input)), transform runs on the cpu only
+        template<DeviceType DeviceUsed, typename DataType, typename Transform>
+        void dropoutForward(Tensor<DeviceUsed, DataType> *input, Tensor<DeviceUsed, DataType> *output,
+                            TensorBase<DeviceUsed> *mask, TensorBase<DeviceUsed> *seed, const Transform &transform)
+        {
+            unsigned int itemSize = 0;
+            unsigned int batchSize = 0;
+            dropoutItems(output->shape(), itemSize, batchSize);
+
+            Tensor<DeviceUsed, unsigned int> *draw = seed->template toType<unsigned int>();
+            Tensor<DeviceUsed, unsigned int> *_mask = mask ? mask->template toType<unsigned int>() : nullptr;
+
+            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+            {
+                uint32_t drawIndex = m_isDropoutReplayed ? draw->cpuDataHandle()[0] : ++draw->cpuDataHandle()[0];
+
+                dropoutForwardCPU(input->cpuDataHandle(), output->cpuDataHandle(), _mask ? _mask->cpuDataHandle() : nullptr,
+                                  itemSize, batchSize, m_dropoutSeed, m_dropoutStream, drawIndex, m_dropoutRate, transform);
+            }
+            else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                if (!m_isDropoutReplayed)
+                {
+                    dropoutAdvanceCUDAKernel(draw->gpuDataHandle());
+                }
+
+                dropoutForwardCUDAKernel<DataType>(input->gpuDataHandle(), output->gpuDataHandle(), _mask ? _mask->gpuDataHandle() : nullptr,
+                                                   draw->gpuDataHandle(), itemSize, batchSize, m_dropoutSeed, m_dropoutStream,
+                                                   dropoutDropThreshold(m_dropoutRate), 1.0f / (1.0f - m_dropoutRate));
+            }
+        }
+
+    public:
+        float dropoutRate() const
+        {
+            return m_dropoutRate;
+        }
+
+        void fuseDropout(float rate, uint64_t stream)
+        {
+            m_dropoutRate = rate;
+            m_dropoutStream = stream;
+        }
+
+        void replayDropout()
+        {
+            m_isDropoutReplayed = true;
+        }
+    };
+
+    // Zeroes each element of Input with probability rate and scales the others by
+    // 1 / (1 - rate), see DropoutState for Mask and Seed. A rate of 0 copies.
+    template<DeviceType DeviceUsed = DeviceType::CPU_NAIVE, typename DataType = float>
+    class Dropout : public Operator<DeviceUsed>, public DropoutState
+    {
+    protected:
+        using Operator<DeviceUsed>::input;
+        using Operator<DeviceUsed>::output;
+        using Operator<DeviceUsed>::m_deviceId;
+
+    public:
+        enum InputSlot : unsigned int {INPUT};
+        enum OutputSlot : unsigned int {OUTPUT, MASK, SEED};
+
+        Dropout(float rate = 0.5f, uint64_t stream = 0, unsigned int deviceId = 0)
+            :Operator<DeviceUsed>({"Input"}, {"Output", "Mask", "Seed"}, deviceId),
+            DropoutState(rate, stream)
+        {}
+
+        virtual bool init() override
+        {
+            CHECK_GPU;
+
+            FAIL_IF (!input("Input") || !output("Output"));
+
+            FAIL_IF (input("Input")->shape() != output("Output")->shape());
+
+            FAIL_IF (input("Input")->layout() != output("Output")->layout());
+
+            FAIL_IF (!initDropout(output("Output"), output("Mask"), output("Seed")));
+
+            return true;
+        }
+
+        virtual void evaluate() override
+        {
+            CHECK_GPU;
+
+            Tensor<DeviceUsed, DataType> *_input = input(INPUT)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_output = output(OUTPUT)->template toType<DataType>();
+
+            dropoutForward(_input, _output, output(MASK), output(SEED), [](const DataType *from, DataType *to, size_t size)
+            {
+                if (from != to)
+                {
+                    std::copy(from, from + size, to);
+                }
+            });
+        }
+    };
+}
+
+#endif
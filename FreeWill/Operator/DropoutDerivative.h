@@ -0,0 +1,69 @@
+#ifndef DROPOUTDERIVATIVE_H
+#define DROPOUTDERIVATIVE_H
+
+#include "Dropout.h"
+
+namespace FreeWill
+{
+    // InputDelta = OutputDelta through the mask of the last Dropout forward pass, whose rate and
+    // stream it has to be given. Seed is that dropout's draw counter; Mask its stored bits, or
+    // unbound to draw them again.
+    template<DeviceType DeviceUsed = DeviceType::CPU_NAIVE, typename DataType = float>
+    class DropoutDerivative : public Operator<DeviceUsed>, public DropoutState
+    {
+    protected:
+        using Operator<DeviceUsed>::input;
+        using Operator<DeviceUsed>::output;
+        using Operator<DeviceUsed>::m_deviceId;
+
+    public:
+        enum InputSlot : unsigned int {OUTPUT_DELTA, MASK, SEED};
+        enum OutputSlot : unsigned int {INPUT_DELTA};
+
+        DropoutDerivative(float rate = 0.5f, uint64_t stream = 0, unsigned int deviceId = 0)
+            :Operator<DeviceUsed>({"OutputDelta", "Mask", "Seed"}, {"InputDelta"}, deviceId),
+            DropoutState(rate, stream)
+        {}
+
+        virtual bool init() override
+        {
+            CHECK_GPU;
+
+            FAIL_IF (!input("OutputDelta") || !output("InputDelta"));
+
+            FAIL_IF (input("OutputDelta")->shape() != output("InputDelta")->shape());
+
+            FAIL_IF (!initDropout(input("OutputDelta"), input("Mask"), input("Seed")));
+
+            return true;
+        }
+
+        virtual void evaluate() override
+        {
+            CHECK_GPU;
+
+            Tensor<DeviceUsed, DataType> *outputDelta = input(OUTPUT_DELTA)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *inputDelta = output(INPUT_DELTA)->template toType<DataType>();
+            Tensor<DeviceUsed, unsigned int> *draw = input(SEED)->template toType<unsigned int>();
+            Tensor<DeviceUsed, unsigned int> *mask = input(MASK) ? input(MASK)->template toType<unsigned int>() : nullptr;
+
+            unsigned int itemSize = 0;
+            unsigned int batchSize = 0;
+            dropoutItems(inputDelta->shape(), itemSize, batchSize);
+
+            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+            {
+                dropoutBackwardCPU(outputDelta->cpuDataHandle(), inputDelta->cpuDataHandle(), mask ? mask->cpuDataHandle() : nullptr,
+                                   itemSize, batchSize, m_dropoutSeed, m_dropoutStream, draw->cpuDataHandle()[0], m_dropoutRate);
+            }
+            else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                dropoutBackwardCUDAKernel<DataType>(outputDelta->gpuDataHandle(), inputDelta->gpuDataHandle(), mask ? mask->gpuDataHandle() : nullptr,
+                                                    draw->gpuDataHandle(), itemSize, batchSize, m_dropoutSeed, m_dropoutStream,
+                                                    dropoutDropThreshold(m_dropoutRate), 1.0f / (1.0f - m_dropoutRate));
+            }
+        }
+    };
+}
+
+#endif
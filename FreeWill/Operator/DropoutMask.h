@@ -0,0 +1,51 @@
+#ifndef DROPOUTMASK_H
+#define DROPOUTMASK_H
+
+#include <cuda_runtime.h>
+#include <stdint.h>
+
+#include "../Tensor/Philox.h"
+
+// shared with the cuda kernels, keep it c++11
+
+namespace FreeWill
+{
+    // The mask of a dropout keeps one bit per element, 32 to a word, and every item of the batch
+    // starts a new word. The bits come from Philox: element i of draw d of a stream keeps its
+    // value unless word i % 4 of block (d << 32) + i / 4 is below the drop threshold, so a mask
+    // can always be drawn again from its draw instead of being stored.
+    static const unsigned int DROPOUT_BITS_PER_WORD = 32;
+
+    __host__ __device__ inline unsigned int dropoutWordsPerItem(unsigned int itemSize)
+    {
+        return (itemSize + DROPOUT_BITS_PER_WORD - 1) / DROPOUT_BITS_PER_WORD;
+    }
+
+    // the elements whose 32 random bits are below it are dropped, rate in [0, 1)
+    inline uint32_t dropoutDropThreshold(float rate)
+    {
+        return (uint32_t) ((double) rate * 4294967296.0);
+    }
+
+    // bit k of the result is set if element firstElement + k is kept, count <= 32
+    __host__ __device__ inline uint32_t dropoutKeepWord(uint64_t seed, uint64_t stream, uint32_t draw,
+                                                        uint64_t firstElement, unsigned int count, uint32_t dropThreshold)
+    {
+        uint32_t word = 0;
+
+        for (unsigned int k = 0; k < count;)
+        {
+            uint64_t element = firstElement + k;
+            PhiloxBlock bits = philox4x32(seed, stream, ((uint64_t) draw << 32) + (element >> 2));
+
+            for (unsigned int lane = (unsigned int) (element & 3); lane < 4 && k < count; ++lane, ++k)
+            {
+                word |= (uint32_t) (bits.m_words[lane] >= dropThreshold) << k;
+            }
+        }
+
+        return word;
+    }
+}
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef DROPOUT_CPU_H
+#define DROPOUT_CPU_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "DropoutMask.h"
+#include "../Tensor/Shape.h"
+#include "../Tensor/HalfPrecision.h"
+#include "../Context/ThreadPool.h"
+
+namespace FreeWill
+{
+    // the last dimension of a tensor with more than one is its batch
+    inline void dropoutItems(const Shape &shape, unsigned int &itemSize, unsigned int &batchSize)
+    {
+        batchSize = shape.dimension() > 1 ? shape[shape.dimension() - 1] : 1;
+        itemSize = batchSize ? shape.size() / batchSize : 0;
+    }
+
+    // the shape of the Mask tensor of a dropout over shape: {words per item} and batch
+    inline Shape dropoutMaskShape(const Shape &shape)
+    {
+        unsigned int itemSize = 0;
+        unsigned int batchSize = 0;
+        dropoutItems(shape, itemSize, batchSize);
+
+        if (shape.dimension() > 1)
+        {
+            return Shape({dropoutWordsPerItem(itemSize), batchSize});
+        }
+
+        return Shape({dropoutWordsPerItem(itemSize)});
+    }
+
+    // Runs function(begin, end) over the items on the ThreadPool once there are enough elements
+    // to be worth the fork/join, as forEachActivationChunkCPU.
+    template<typename Function>
+    inline void forEachDropoutItemCPU(unsigned int itemSize, unsigned int batchSize, const Function &function)
+    {
+        const size_t CHUNK = 16384;
+        ThreadPool &threadPool = ThreadPool::getSingleton();
+
+        if (threadPool.threadCount() == 0 || batchSize < 2 || (size_t) itemSize * batchSize < CHUNK * 4)
+        {
+            function(0, batchSize);
+            return;
+        }
+
+        unsigned int grain = (unsigned int) std::max((size_t) 1, CHUNK / std::max(itemSize, 1u));
+        threadPool.parallelFor(0, batchSize, grain, function);
+    }
+
+    // Output = the kept elements of transform(Input) scaled by 1 / (1 - rate), the others 0.
+    // transform(input, output, size) runs on one item before it is masked, so whatever it
+    // computes (a copy, an activation) is still in the cache; Input and Output may be the same
+    // tensor. The words of the mask go to mask unless it is null.
+    template<typename DataType, typename Transform>
+    void dropoutForwardCPU(const DataType *input, DataType *output, uint32_t *mask, unsigned int itemSize, unsigned int batchSize,
+                           uint64_t seed, uint64_t stream, uint32_t draw, float rate, const Transform &transform)
+    {
+        typedef typename ComputeType<DataType>::Type ComputeDataType;
+
+        uint32_t dropThreshold = dropoutDropThreshold(rate);
+        ComputeDataType scale = (ComputeDataType) (1.0 / (1.0 - rate));
+        unsigned int wordCount = dropoutWordsPerItem(itemSize);
+
+        forEachDropoutItemCPU(itemSize, batchSize, [&](unsigned int begin, unsigned int end)
+        {
+            for (unsigned int b = begin; b < end; ++b)
+            {
+                size_t first = (size_t) b * itemSize;
+                transform(input + first, output + first, itemSize);
+
+                for (unsigned int w = 0; w < wordCount; ++w)
+                {
+                    unsigned int offset = w * DROPOUT_BITS_PER_WORD;
+                    unsigned int count = std::min(DROPOUT_BITS_PER_WORD, itemSize - offset);
+                    uint32_t keep = dropoutKeepWord(seed, stream, draw, first + offset, count, dropThreshold);
+                    DataType *values = output + first + offset;
+
+                    for (unsigned int k = 0; k < count; ++k)
+                    {
+                        values[k] = (keep >> k) & 1 ? (DataType) ((ComputeDataType) values[k] * scale) : (DataType) 0.0f;
+                    }
+
+                    if (mask)
+                    {
+                        mask[(size_t) b * wordCount + w] = keep;
+                    }
+                }
+            }
+        });
+    }
+
+    // InputDelta = OutputDelta through the mask of the draw, read from mask, or drawn again from
+    // the counter when it is null
+    template<typename DataType>
+    void dropoutBackwardCPU(const DataType *outputDelta, DataType *inputDelta, const uint32_t *mask, unsigned int itemSize, unsigned int batchSize,
+                            uint64_t seed, uint64_t stream, uint32_t draw, float rate)
+    {
+        typedef typename ComputeType<DataType>::Type ComputeDataType;
+
+        uint32_t dropThreshold = dropoutDropThreshold(rate);
+        ComputeDataType scale = (ComputeDataType) (1.0 / (1.0 - rate));
+        unsigned int wordCount = dropoutWordsPerItem(itemSize);
+
+        forEachDropoutItemCPU(itemSize, batchSize, [&](unsigned int begin, unsigned int end)
+        {
+            for (unsigned int b = begin; b < end; ++b)
+            {
+                size_t first = (size_t) b * itemSize;
+
+                for (unsigned int w = 0; w < wordCount; ++w)
+                {
+                    unsigned int offset = w * DROPOUT_BITS_PER_WORD;
+                    unsigned int count = std::min(DROPOUT_BITS_PER_WORD, itemSize - offset);
+                    uint32_t keep = mask ? mask[(size_t) b * wordCount + w] :
+                                           dropoutKeepWord(seed, stream, draw, first + offset, count, dropThreshold);
+
+                    for (unsigned int k = 0; k < count; ++k)
+                    {
+                        size_t i = first + offset + k;
+                        inputDelta[i] = (keep >> k) & 1 ? (DataType) ((ComputeDataType) outputDelta[i] * scale) : (DataType) 0.0f;
+                    }
+                }
+            }
+        });
+    }
+}
+
+#endif
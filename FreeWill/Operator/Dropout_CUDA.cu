@@ -0,0 +1,128 @@
+#include "Dropout_CUDA.h"
+#include "DropoutMask.h"
+#include "../DeviceSelection.h"
+#include "../Context/ComputeStream.h"
+#include "../Tensor/HalfPrecision.h"
+#include <cuda_runtime.h>
+
+__global__ void dropoutAdvance(uint32_t *draw)
+{
+    *draw += 1;
+}
+
+// Thread s of an item is element s, the threads past the item are padding up to its last word,
+// so every warp is one word of the mask and all of its lanes take part in the ballot.
+template <typename DataType>
+__global__ void dropoutForward(const DataType *input, DataType *output, uint32_t *mask, const uint32_t *draw,
+                               unsigned int itemSize, unsigned int batchSize, uint64_t seed, uint64_t stream,
+                               uint32_t dropThreshold, float scale)
+{
+    typedef typename FreeWill::ComputeType<DataType>::Type ComputeDataType;
+
+    unsigned int slotsPerItem = FreeWill::dropoutWordsPerItem(itemSize) * FreeWill::DROPOUT_BITS_PER_WORD;
+    unsigned int slot = blockIdx.x * blockDim.x + threadIdx.x;
+
+    if (slot >= slotsPerItem * batchSize)
+    {
+        return;
+    }
+
+    unsigned int b = slot / slotsPerItem;
+    unsigned int j = slot % slotsPerItem;
+    uint64_t element = (uint64_t) b * itemSize + j;
+
+    bool isKept = false;
+
+    if (j < itemSize)
+    {
+        isKept = FreeWill::dropoutKeepWord(seed, stream, *draw, element, 1, dropThreshold);
+        output[element] = isKept ? (DataType) ((ComputeDataType) input[element] * (ComputeDataType) scale) : (DataType) 0.0f;
+    }
+
+    uint32_t word = __ballot_sync(0xffffffff, isKept);
+
+    if (mask && (threadIdx.x & 31) == 0)
+    {
+        mask[slot / FreeWill::DROPOUT_BITS_PER_WORD] = word;
+    }
+}
+
+template <typename DataType>
+__global__ void dropoutBackward(const DataType *outputDelta, DataType *inputDelta, const uint32_t *mask, const uint32_t *draw,
+                                unsigned int itemSize, unsigned int batchSize, uint64_t seed, uint64_t stream,
+                                uint32_t dropThreshold, float scale)
+{
+    typedef typename FreeWill::ComputeType<DataType>::Type ComputeDataType;
+
+    unsigned int slotsPerItem = FreeWill::dropoutWordsPerItem(itemSize) * FreeWill::DROPOUT_BITS_PER_WORD;
+    unsigned int slot = blockIdx.x * blockDim.x + threadIdx.x;
+
+    if (slot >= slotsPerItem * batchSize)
+    {
+        return;
+    }
+
+    unsigned int b = slot / slotsPerItem;
+    unsigned int j = slot % slotsPerItem;
+    uint64_t element = (uint64_t) b * itemSize + j;
+
+    if (j < itemSize)
+    {
+        bool isKept = mask ? (mask[slot / FreeWill::DROPOUT_BITS_PER_WORD] >> (j % FreeWill::DROPOUT_BITS_PER_WORD)) & 1 :
+                             FreeWill::dropoutKeepWord(seed, stream, *draw, element, 1, dropThreshold);
+        inputDelta[element] = isKept ? (DataType) ((ComputeDataType) outputDelta[element] * (ComputeDataType) scale) : (DataType) 0.0f;
+    }
+}
+
+__host__ void dropoutAdvanceCUDAKernel(uint32_t *draw)
+{
+    dropoutAdvance<<<1, 1, 0, FreeWill::computeStream()>>>(draw);
+    CHECK_CUDA_ERROR
+}
+
+template <typename DataType>
+__host__ void dropoutForwardCUDAKernel(const DataType *input, DataType *output, uint32_t *mask, const uint32_t *draw,
+                                       unsigned int itemSize, unsigned int batchSize, uint64_t seed, uint64_t stream,
+                                       uint32_t dropThreshold, float scale)
+{
+    int blockSize = 256;
+    unsigned int slotCount = FreeWill::dropoutWordsPerItem(itemSize) * FreeWill::DROPOUT_BITS_PER_WORD * batchSize;
+    int gridSize = (slotCount + blockSize - 1) / blockSize;
+
+    if (gridSize == 0)
+    {
+        return;
+    }
+
+    dropoutForward<DataType><<<gridSize, blockSize, 0, FreeWill::computeStream()>>>(input, output, mask, draw, itemSize, batchSize,
+                                                                                   seed, stream, dropThreshold, scale);
+    CHECK_CUDA_ERROR
+}
+
+template <typename DataType>
+__host__ void dropoutBackwardCUDAKernel(const DataType *outputDelta, DataType *inputDelta, const uint32_t *mask, const uint32_t *draw,
+                                        unsigned int itemSize, unsigned int batchSize, uint64_t seed, uint64_t stream,
+                                        uint32_t dropThreshold, float scale)
+{
+    int blockSize = 256;
+    unsigned int slotCount = FreeWill::dropoutWordsPerItem(itemSize) * FreeWill::DROPOUT_BITS_PER_WORD * batchSize;
+    int gridSize = (slotCount + blockSize - 1) / blockSize;
+
+    if (gridSize == 0)
+    {
+        return;
+    }
+
+    dropoutBackward<DataType><<<gridSize, blockSize, 0, FreeWill::computeStream()>>>(outputDelta, inputDelta, mask, draw, itemSize, batchSize,
+                                                                                    seed, stream, dropThreshold, scale);
+    CHECK_CUDA_ERROR
+}
+
+template __host__ void dropoutForwardCUDAKernel(const float *input, float *output, uint32_t *mask, const uint32_t *draw, unsigned int itemSize, unsigned int batchSize, uint64_t seed, uint64_t stream, uint32_t dropThreshold, float scale);
+template __host__ void dropoutForwardCUDAKernel(const double *input, double *output, uint32_t *mask, const uint32_t *draw, unsigned int itemSize, unsigned int batchSize, uint64_t seed, uint64_t stream, uint32_t dropThreshold, float scale);
+template __host__ void dropoutForwardCUDAKernel(const FreeWill::Half *input, FreeWill::Half *output, uint32_t *mask, const uint32_t *draw, unsigned int itemSize, unsigned int batchSize, uint64_t seed, uint64_t stream, uint32_t dropThreshold, float scale);
+template __host__ void dropoutForwardCUDAKernel(const FreeWill::BFloat16 *input, FreeWill::BFloat16 *output, uint32_t *mask, const uint32_t *draw, unsigned int itemSize, unsigned int batchSize, uint64_t seed, uint64_t stream, uint32_t dropThreshold, float scale);
+template __host__ void dropoutBackwardCUDAKernel(const float *outputDelta, float *inputDelta, const uint32_t *mask, const uint32_t *draw, unsigned int itemSize, unsigned int batchSize, uint64_t seed, uint64_t stream, uint32_t dropThreshold, float scale);
+template __host__ void dropoutBackwardCUDAKernel(const double *outputDelta, double *inputDelta, const uint32_t *mask, const uint32_t *draw, unsigned int itemSize, unsigned int batchSize, uint64_t seed, uint64_t stream, uint32_t dropThreshold, float scale);
+template __host__ void dropoutBackwardCUDAKernel(const FreeWill::Half *outputDelta, FreeWill::Half *inputDelta, const uint32_t *mask, const uint32_t *draw, unsigned int itemSize, unsigned int batchSize, uint64_t seed, uint64_t stream, uint32_t dropThreshold, float scale);
+template __host__ void dropoutBackwardCUDAKernel(const FreeWill::BFloat16 *outputDelta, FreeWill::BFloat16 *inputDelta, const uint32_t *mask, const uint32_t *draw, unsigned int itemSize, unsigned int batchSize, uint64_t seed, uint64_t stream, uint32_t dropThreshold, float scale);
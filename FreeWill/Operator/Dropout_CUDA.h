@@ -0,0 +1,24 @@
+#ifndef DROPOUT_CUDA_H
+#define DROPOUT_CUDA_H
+
+#include <cuda_runtime.h>
+#include <stdint.h>
+
+// shared with the cuda kernels, keep it c++11
+
+// adds one to the draw counter in device memory, so a captured graph draws a new mask every launch
+__host__ void dropoutAdvanceCUDAKernel(uint32_t *draw);
+
+// the masks of dropoutForwardCPU, one thread per element and one warp per mask word; mask may be null
+template <typename DataType = float>
+__host__ void dropoutForwardCUDAKernel(const DataType *input, DataType *output, uint32_t *mask, const uint32_t *draw,
+                                       unsigned int itemSize, unsigned int batchSize, uint64_t seed, uint64_t stream,
+                                       uint32_t dropThreshold, float scale);
+
+// the mask is read from mask, or drawn again when it is null
+template <typename DataType = float>
+__host__ void dropoutBackwardCUDAKernel(const DataType *outputDelta, DataType *inputDelta, const uint32_t *mask, const uint32_t *draw,
+                                        unsigned int itemSize, unsigned int batchSize, uint64_t seed, uint64_t stream,
+                                        uint32_t dropThreshold, float scale);
+
+#endif
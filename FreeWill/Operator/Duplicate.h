@@ -2,9 +2,15 @@
 #define DUPLICATE_H
 
 #include "Operator.h"
+#include "../Context/ComputeStream.h"
+#include <cstring>
 
 namespace FreeWill
 {
+    // Copies From into To. From may live on another device than the operator (sourceDeviceId),
+    // on gpu the copy then goes peer to peer, staged through the host by the driver where the
+    // two devices have no peer access. It is queued on the destination's compute stream, which
+    // has to be ordered after the writes to From on the source, see Context::joinDevices.
     template<DeviceType DeviceUsed = DeviceType::CPU_NAIVE, typename DataType = float>
     class Duplicate : public Operator<DeviceUsed>
     {
@@ -13,9 +19,21 @@ namespace FreeWill
         using Operator<DeviceUsed>::output;
         using Operator<DeviceUsed>::m_deviceId;
 
+        unsigned int m_sourceDeviceId;
+
     public:
+        enum InputSlot : unsigned int {FROM};
+        enum OutputSlot : unsigned int {TO};
+
         Duplicate(unsigned int deviceId)
-            :Operator<DeviceUsed>({"From"}, {"To"}, deviceId)
+            :Operator<DeviceUsed>({"From"}, {"To"}, deviceId),
+              m_sourceDeviceId(deviceId)
+        {
+        }
+
+        Duplicate(unsigned int deviceId, unsigned int sourceDeviceId)
+            :Operator<DeviceUsed>({"From"}, {"To"}, deviceId),
+              m_sourceDeviceId(sourceDeviceId)
         {
         }
 
@@ -36,6 +54,26 @@ namespace FreeWill
         {
             CHECK_GPU;
 
+            Tensor<DeviceUsed, DataType> *from = input(FROM)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *to = output(TO)->template toType<DataType>();
+
+            size_t sizeInByte = from->shape().size() * sizeof(DataType);
+
+            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+            {
+                std::memcpy(to->cpuDataHandle(), from->cpuDataHandle(), sizeInByte);
+            }
+            else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                if (m_sourceDeviceId == m_deviceId)
+                {
+                    RUN_CUDA(cudaMemcpyAsync(to->gpuDataHandle(), from->gpuDataHandle(), sizeInByte, cudaMemcpyDeviceToDevice, computeStream()));
+                }
+                else
+                {
+                    RUN_CUDA(cudaMemcpyPeerAsync(to->gpuDataHandle(), m_deviceId, from->gpuDataHandle(), m_sourceDeviceId, sizeInByte, computeStream()));
+                }
+            }
         }
     };
 
@@ -5,23 +5,38 @@
 #include "Operator.h"
 #include "../Tensor/Tensor.h"
 
+#include "ActivationMode.h"
+#include "Elementwise_CPU.h"
 #include "ElementwiseAdd_CUDA.h"
+#include "Elementwise_CUDA.h"
 
 namespace FreeWill
 {
+    // Result = OperandA + rate * OperandB. With fuseActivationDerivative (see
+    // Model::fuseOperators) one of the operands is instead the derivative of an activation,
+    // computed from the Output and OutputDelta inputs in the same pass.
     template<DeviceType DeviceUsed = DeviceType::CPU_NAIVE, typename DataType = float>
     class ElementwiseAdd : public Operator<DeviceUsed>
     {
     protected:
         DataType m_rate;
+        bool m_hasActivationDerivative;
+        ActivationMode m_activationDerivativeMode;
+        bool m_isDerivativeOperandA;
         using Operator<DeviceUsed>::input;
         using Operator<DeviceUsed>::output;
         using Operator<DeviceUsed>::m_deviceId;
 
    public:
+        enum InputSlot : unsigned int {OPERAND_A, OPERAND_B, OUTPUT, OUTPUT_DELTA};
+        enum OutputSlot : unsigned int {RESULT};
+
         ElementwiseAdd(DataType rate = 1.0f, unsigned int deviceId = 0)
-            :Operator<DeviceUsed>({"OperandA", "OperandB"}, {"Result"}, deviceId),
-            m_rate(rate)
+            :Operator<DeviceUsed>({"OperandA", "OperandB", "Output", "OutputDelta"}, {"Result"}, deviceId),
+            m_rate(rate),
+            m_hasActivationDerivative(false),
+            m_activationDerivativeMode(ActivationMode::SIGMOID),
+            m_isDerivativeOperandA(false)
         {
         }
 
@@ -30,10 +45,36 @@ namespace FreeWill
             m_rate = rate;
         }
 
+        // the derivative of a mode activation replaces OperandA, or OperandB
+        void fuseActivationDerivative(ActivationMode mode, bool isDerivativeOperandA)
+        {
+            m_hasActivationDerivative = true;
+            m_activationDerivativeMode = mode;
+            m_isDerivativeOperandA = isDerivativeOperandA;
+        }
+
         virtual bool init() override
         {
             CHECK_GPU;
 
+            if (m_hasActivationDerivative)
+            {
+                FAIL_IF (!(std::is_same<DataType, float>::value || std::is_same<DataType, double>::value ||
+                           DeviceUsed == DeviceType::GPU_CUDA));
+
+                const char *operand = m_isDerivativeOperandA ? "OperandB" : "OperandA";
+
+                FAIL_IF (!input(operand) || !input("Output") || !input("OutputDelta") || !output("Result"));
+
+                FAIL_IF (input(operand)->shape().size() != output("Result")->shape().size());
+
+                FAIL_IF (input("Output")->shape().size() != output("Result")->shape().size());
+
+                FAIL_IF (input("OutputDelta")->shape().size() != output("Result")->shape().size());
+
+                return true;
+            }
+
             FAIL_IF (input("OperandA") == nullptr);
 
             FAIL_IF (input("OperandB") == nullptr);
@@ -51,24 +92,43 @@ namespace FreeWill
         {
             CHECK_GPU;
 
-            Tensor<DeviceUsed, DataType> *result = output("Result")->template toType<DataType>();
-            Tensor<DeviceUsed, DataType> *operandA = input("OperandA")->template toType<DataType>();
-            Tensor<DeviceUsed, DataType> *operandB = input("OperandB")->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *result = output(RESULT)->template toType<DataType>();
 
             unsigned int size = result->shape().size();
 
-            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+            if (m_hasActivationDerivative)
             {
-                for(unsigned int e = 0; e<size; ++e)
+                Tensor<DeviceUsed, DataType> *_output = input(OUTPUT)->template toType<DataType>();
+                Tensor<DeviceUsed, DataType> *outputDelta = input(OUTPUT_DELTA)->template toType<DataType>();
+                Tensor<DeviceUsed, DataType> *operand = input(m_isDerivativeOperandA ? OPERAND_B : OPERAND_A)->template toType<DataType>();
+
+                if constexpr (DeviceUsed == DeviceType::CPU_NAIVE && (std::is_same<DataType, float>::value || std::is_same<DataType, double>::value))
+                {
+                    elementwiseAddActivationDerivativeCPU<DataType>(m_activationDerivativeMode, m_isDerivativeOperandA, _output->cpuDataHandle(),
+                                                                    outputDelta->cpuDataHandle(), operand->cpuDataHandle(), m_rate, result->cpuDataHandle(), size);
+                }
+                else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
                 {
-                    (*result)[e] = (*operandA)[e] + (*operandB)[e]*m_rate;
+                    elementwiseAddActivationDerivativeCUDAKernel<DataType>(m_activationDerivativeMode, m_isDerivativeOperandA, _output->gpuDataHandle(),
+                                                                           outputDelta->gpuDataHandle(), operand->gpuDataHandle(), m_rate, result->gpuDataHandle(), size);
                 }
+
+                return;
+            }
+
+            Tensor<DeviceUsed, DataType> *operandA = input(OPERAND_A)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *operandB = input(OPERAND_B)->template toType<DataType>();
+
+            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+            {
+                ElementwiseArguments<DataType> arguments = {{operandA->cpuDataHandle(), operandB->cpuDataHandle()},
+                                                            {(typename ComputeType<DataType>::Type) m_rate}};
+
+                elementwiseCPU<ElementwiseAddExpression>(result->cpuDataHandle(), arguments, size);
             }
             else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
             {
                 elementwiseAddCUDAKernel<DataType>(operandA->gpuDataHandle(), operandB->gpuDataHandle(), m_rate, result->gpuDataHandle(), size);
-
-
             }
         }
     };
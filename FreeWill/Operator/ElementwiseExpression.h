@@ -0,0 +1,222 @@
+#ifndef ELEMENTWISEEXPRESSION_H
+#define ELEMENTWISEEXPRESSION_H
+
+#include <cuda_runtime.h>
+#include <type_traits>
+
+#include "ActivationMode.h"
+#include "../Tensor/HalfPrecision.h"
+
+// shared with the cuda kernels, keep it c++11
+
+namespace FreeWill
+{
+    // An elementwise expression is a type: the leaves load an operand or a scalar, the nodes
+    // combine them, and Expression::evaluate(values, scalars) computes one element from the
+    // operand values loaded at it. Building one with the operators below, e.g.
+    //
+    //     decltype(elementwiseOperand<0>() + elementwiseScalar<0>() * elementwiseOperand<1>())
+    //
+    // gives a chain that the cpu loop and the cuda kernel (Elementwise_CPU.h, Elementwise_CUDA.h)
+    // run in one pass over memory. OPERAND_COUNT is the number of operands it loads.
+    static const unsigned int ELEMENTWISE_MAX_OPERANDS = 4;
+    static const unsigned int ELEMENTWISE_MAX_SCALARS = 2;
+
+    template<typename Expression>
+    struct ElementwiseExpression
+    {
+    };
+
+    // what an expression over DataType operands reads, passed to the kernels by value
+    template<typename DataType>
+    struct ElementwiseArguments
+    {
+        const DataType *m_operands[ELEMENTWISE_MAX_OPERANDS];
+        typename ComputeType<DataType>::Type m_scalars[ELEMENTWISE_MAX_SCALARS];
+    };
+
+    template<unsigned int Index>
+    struct ElementwiseOperand : public ElementwiseExpression<ElementwiseOperand<Index> >
+    {
+        static const unsigned int OPERAND_COUNT = Index + 1;
+
+        template<typename ComputeDataType>
+        __host__ __device__ static ComputeDataType evaluate(const ComputeDataType *values, const ComputeDataType *)
+        {
+            return values[Index];
+        }
+    };
+
+    template<unsigned int Index>
+    struct ElementwiseScalar : public ElementwiseExpression<ElementwiseScalar<Index> >
+    {
+        static const unsigned int OPERAND_COUNT = 0;
+
+        template<typename ComputeDataType>
+        __host__ __device__ static ComputeDataType evaluate(const ComputeDataType *, const ComputeDataType *scalars)
+        {
+            return scalars[Index];
+        }
+    };
+
+    template<int Value>
+    struct ElementwiseConstant : public ElementwiseExpression<ElementwiseConstant<Value> >
+    {
+        static const unsigned int OPERAND_COUNT = 0;
+
+        template<typename ComputeDataType>
+        __host__ __device__ static ComputeDataType evaluate(const ComputeDataType *, const ComputeDataType *)
+        {
+            return (ComputeDataType) Value;
+        }
+    };
+
+    template<typename Left, typename Right>
+    struct ElementwiseOperandCount
+    {
+        static const unsigned int VALUE = Left::OPERAND_COUNT > Right::OPERAND_COUNT ? Left::OPERAND_COUNT : Right::OPERAND_COUNT;
+    };
+
+    template<typename Left, typename Right>
+    struct ElementwiseSum : public ElementwiseExpression<ElementwiseSum<Left, Right> >
+    {
+        static const unsigned int OPERAND_COUNT = ElementwiseOperandCount<Left, Right>::VALUE;
+
+        template<typename ComputeDataType>
+        __host__ __device__ static ComputeDataType evaluate(const ComputeDataType *values, const ComputeDataType *scalars)
+        {
+            return Left::evaluate(values, scalars) + Right::evaluate(values, scalars);
+        }
+    };
+
+    template<typename Left, typename Right>
+    struct ElementwiseDifference : public ElementwiseExpression<ElementwiseDifference<Left, Right> >
+    {
+        static const unsigned int OPERAND_COUNT = ElementwiseOperandCount<Left, Right>::VALUE;
+
+        template<typename ComputeDataType>
+        __host__ __device__ static ComputeDataType evaluate(const ComputeDataType *values, const ComputeDataType *scalars)
+        {
+            return Left::evaluate(values, scalars) - Right::evaluate(values, scalars);
+        }
+    };
+
+    template<typename Left, typename Right>
+    struct ElementwiseMultiplication : public ElementwiseExpression<ElementwiseMultiplication<Left, Right> >
+    {
+        static const unsigned int OPERAND_COUNT = ElementwiseOperandCount<Left, Right>::VALUE;
+
+        template<typename ComputeDataType>
+        __host__ __device__ static ComputeDataType evaluate(const ComputeDataType *values, const ComputeDataType *scalars)
+        {
+            return Left::evaluate(values, scalars) * Right::evaluate(values, scalars);
+        }
+    };
+
+    // Value where 0 < Condition and, unless Ceiling is 0, Condition < Ceiling, 0 elsewhere
+    template<typename Condition, typename Value, int Ceiling>
+    struct ElementwiseSelectPositive : public ElementwiseExpression<ElementwiseSelectPositive<Condition, Value, Ceiling> >
+    {
+        static const unsigned int OPERAND_COUNT = ElementwiseOperandCount<Condition, Value>::VALUE;
+
+        template<typename ComputeDataType>
+        __host__ __device__ static ComputeDataType evaluate(const ComputeDataType *values, const ComputeDataType *scalars)
+        {
+            ComputeDataType condition = Condition::evaluate(values, scalars);
+
+            return condition > (ComputeDataType) 0 && (Ceiling == 0 || condition < (ComputeDataType) Ceiling) ?
+                        Value::evaluate(values, scalars) : (ComputeDataType) 0;
+        }
+    };
+
+    template<unsigned int Index>
+    __host__ __device__ inline ElementwiseOperand<Index> elementwiseOperand()
+    {
+        return ElementwiseOperand<Index>();
+    }
+
+    template<unsigned int Index>
+    __host__ __device__ inline ElementwiseScalar<Index> elementwiseScalar()
+    {
+        return ElementwiseScalar<Index>();
+    }
+
+    template<int Value>
+    __host__ __device__ inline ElementwiseConstant<Value> elementwiseConstant()
+    {
+        return ElementwiseConstant<Value>();
+    }
+
+    template<typename Left, typename Right>
+    __host__ __device__ inline ElementwiseSum<Left, Right> operator+(const ElementwiseExpression<Left> &, const ElementwiseExpression<Right> &)
+    {
+        return ElementwiseSum<Left, Right>();
+    }
+
+    template<typename Left, typename Right>
+    __host__ __device__ inline ElementwiseDifference<Left, Right> operator-(const ElementwiseExpression<Left> &, const ElementwiseExpression<Right> &)
+    {
+        return ElementwiseDifference<Left, Right>();
+    }
+
+    template<typename Left, typename Right>
+    __host__ __device__ inline ElementwiseMultiplication<Left, Right> operator*(const ElementwiseExpression<Left> &, const ElementwiseExpression<Right> &)
+    {
+        return ElementwiseMultiplication<Left, Right>();
+    }
+
+    // Result = OperandA + rate * OperandB, the scalar is the rate
+    typedef decltype(elementwiseOperand<0>() + elementwiseScalar<0>() * elementwiseOperand<1>()) ElementwiseAddExpression;
+
+    // Result = lossScale * (Input - Label), the derivative of the sigmoid cross entropy loss, the
+    // scalar is the loss scale
+    typedef decltype(elementwiseScalar<0>() * (elementwiseOperand<0>() - elementwiseOperand<1>())) ElementwiseScaledSubtractExpression;
+
+    // Result = OperandA * OperandB, a pruned weight under its sparsity mask
+    typedef decltype(elementwiseOperand<0>() * elementwiseOperand<1>()) ElementwiseProductExpression;
+
+    // The derivative of an activation from its output (operand 0) and the delta of its output
+    // (operand 1), the same formulas as ActivationKernelCPU::backward. The ceiling of
+    // CLIPPED_RELU is ACTIVATION_CLIP_CEILING.
+    template<ActivationMode ActivationModeUsed>
+    struct ElementwiseActivationDerivative;
+
+    template<>
+    struct ElementwiseActivationDerivative<ActivationMode::SIGMOID>
+    {
+        typedef decltype(elementwiseOperand<0>() * (elementwiseConstant<1>() - elementwiseOperand<0>()) * elementwiseOperand<1>()) Type;
+    };
+
+    template<>
+    struct ElementwiseActivationDerivative<ActivationMode::RELU>
+    {
+        typedef ElementwiseSelectPositive<ElementwiseOperand<0>, ElementwiseOperand<1>, 0> Type;
+    };
+
+    template<>
+    struct ElementwiseActivationDerivative<ActivationMode::TANH>
+    {
+        typedef decltype((elementwiseConstant<1>() - elementwiseOperand<0>() * elementwiseOperand<0>()) * elementwiseOperand<1>()) Type;
+    };
+
+    template<>
+    struct ElementwiseActivationDerivative<ActivationMode::CLIPPED_RELU>
+    {
+        typedef ElementwiseSelectPositive<ElementwiseOperand<0>, ElementwiseOperand<1>, 20> Type;
+    };
+
+    // An ElementwiseAdd whose OperandA (or OperandB) is the derivative of an activation, see
+    // Model::fuseOperators: operands 0 and 1 are the output and its delta, 2 the other operand.
+    template<ActivationMode ActivationModeUsed, bool IsDerivativeOperandA>
+    struct ElementwiseAddActivationDerivative
+    {
+        typedef typename ElementwiseActivationDerivative<ActivationModeUsed>::Type Derivative;
+
+        typedef ElementwiseSum<Derivative, ElementwiseMultiplication<ElementwiseScalar<0>, ElementwiseOperand<2> > > OperandAType;
+        typedef ElementwiseSum<ElementwiseOperand<2>, ElementwiseMultiplication<ElementwiseScalar<0>, Derivative> > OperandBType;
+
+        typedef typename std::conditional<IsDerivativeOperandA, OperandAType, OperandBType>::type Type;
+    };
+}
+
+#endif
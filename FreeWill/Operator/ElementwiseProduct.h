@@ -14,6 +14,9 @@ namespace FreeWill
         using Operator<DeviceUsed>::output;
 
     public:
+        enum InputSlot : unsigned int {OPERAND_A, OPERAND_B};
+        enum OutputSlot : unsigned int {OUTPUT};
+
         ElementwiseProduct()
             :Operator<DeviceUsed>({"OperandA","OperandB"},{"Output"})
         {
@@ -45,9 +48,9 @@ namespace FreeWill
 
         virtual void evaluate() override
         {
-            Tensor<DeviceUsed, DataType> *operandA = (Tensor<DeviceUsed, DataType> *) input("OperandA");
-            Tensor<DeviceUsed, DataType> *operandB = (Tensor<DeviceUsed, DataType> *) input("OperandB");
-            Tensor<DeviceUsed, DataType> *_output = (Tensor<DeviceUsed, DataType> *) output("Output");
+            Tensor<DeviceUsed, DataType> *operandA = (Tensor<DeviceUsed, DataType> *) input(OPERAND_A);
+            Tensor<DeviceUsed, DataType> *operandB = (Tensor<DeviceUsed, DataType> *) input(OPERAND_B);
+            Tensor<DeviceUsed, DataType> *_output = (Tensor<DeviceUsed, DataType> *) output(OUTPUT);
 
             unsigned int size = operandA->shape().size();
 
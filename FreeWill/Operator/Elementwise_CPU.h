@@ -0,0 +1,82 @@
+#ifndef ELEMENTWISE_CPU_H
+#define ELEMENTWISE_CPU_H
+
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+
+#include "ElementwiseExpression.h"
+#include "Activation_CPU.h"
+
+namespace FreeWill
+{
+    // result[i] = Expression of the operands at i over [0, size), one loop the compiler can
+    // vectorize. result may be one of the operands.
+    template<typename Expression, typename DataType>
+    void elementwiseLoopCPU(DataType *result, const ElementwiseArguments<DataType> &arguments, size_t size)
+    {
+        typedef typename ComputeType<DataType>::Type ComputeDataType;
+
+        for (size_t i = 0; i < size; ++i)
+        {
+            ComputeDataType values[Expression::OPERAND_COUNT > 0 ? Expression::OPERAND_COUNT : 1];
+
+            for (unsigned int k = 0; k < Expression::OPERAND_COUNT; ++k)
+            {
+                values[k] = (ComputeDataType) arguments.m_operands[k][i];
+            }
+
+            result[i] = (DataType) Expression::evaluate(values, arguments.m_scalars);
+        }
+    }
+
+    // the same in chunks on the ThreadPool, see forEachActivationChunkCPU
+    template<typename Expression, typename DataType>
+    void elementwiseCPU(DataType *result, const ElementwiseArguments<DataType> &arguments, size_t size)
+    {
+        forEachActivationChunkCPU(size, [&](size_t begin, size_t end)
+        {
+            ElementwiseArguments<DataType> chunk = arguments;
+
+            for (unsigned int k = 0; k < Expression::OPERAND_COUNT; ++k)
+            {
+                chunk.m_operands[k] += begin;
+            }
+
+            elementwiseLoopCPU<Expression>(result + begin, chunk, end - begin);
+        });
+    }
+
+    // Result = OperandA + rate * OperandB where one operand is the derivative of an activation
+    // (see ElementwiseAddActivationDerivative). The derivative goes through the dispatched
+    // kernel of activationBackwardCPU a block at a time and is added while still in the cache,
+    // so the fused result is the unfused one bit for bit. Float and double only.
+    template<typename DataType>
+    void elementwiseAddActivationDerivativeCPU(ActivationMode mode, bool isDerivativeOperandA, const DataType *output, const DataType *outputDelta,
+                                               const DataType *operand, DataType rate, DataType *result, size_t size)
+    {
+        static_assert(std::is_same<DataType, float>::value || std::is_same<DataType, double>::value, "float and double only");
+
+        auto backward = cpuKernels<DataType>().m_activationBackward[(unsigned int) mode];
+
+        forEachActivationChunkCPU(size, [&](size_t begin, size_t end)
+        {
+            const size_t BLOCK = 256;
+            DataType derivative[BLOCK];
+
+            for (size_t first = begin; first < end; first += BLOCK)
+            {
+                size_t count = std::min(BLOCK, end - first);
+
+                backward(output + first, outputDelta + first, derivative, count);
+
+                ElementwiseArguments<DataType> arguments = {{isDerivativeOperandA ? derivative : operand + first,
+                                                             isDerivativeOperandA ? operand + first : derivative}, {rate}};
+
+                elementwiseLoopCPU<ElementwiseAddExpression>(result + first, arguments, count);
+            }
+        });
+    }
+}
+
+#endif
@@ -0,0 +1,186 @@
+#include "Elementwise_CUDA.h"
+#include "../DeviceSelection.h"
+#include "../Context/ComputeStream.h"
+#include <cuda_runtime.h>
+#include <stdint.h>
+
+// enough blocks to fill the device a few times over, the grid-stride loops cover the rest
+static const unsigned int ELEMENTWISE_BLOCK_SIZE = 256;
+static const unsigned int ELEMENTWISE_MAX_GRID_SIZE = 4096;
+
+static unsigned int elementwiseGridSize(unsigned int size)
+{
+    unsigned int gridSize = (size + ELEMENTWISE_BLOCK_SIZE - 1) / ELEMENTWISE_BLOCK_SIZE;
+
+    return gridSize < ELEMENTWISE_MAX_GRID_SIZE ? gridSize : ELEMENTWISE_MAX_GRID_SIZE;
+}
+
+template <typename Expression, typename DataType>
+__global__ void elementwise(DataType *result, FreeWill::ElementwiseArguments<DataType> arguments, unsigned int size)
+{
+    typedef typename FreeWill::ComputeType<DataType>::Type ComputeDataType;
+
+    for (unsigned int i = blockIdx.x * blockDim.x + threadIdx.x; i < size; i += blockDim.x * gridDim.x)
+    {
+        ComputeDataType values[Expression::OPERAND_COUNT > 0 ? Expression::OPERAND_COUNT : 1];
+
+        for (unsigned int k = 0; k < Expression::OPERAND_COUNT; ++k)
+        {
+            values[k] = (ComputeDataType) arguments.m_operands[k][i];
+        }
+
+        result[i] = (DataType) Expression::evaluate(values, arguments.m_scalars);
+    }
+}
+
+// four elements per load and store, vectorCount float4s
+template <typename Expression>
+__global__ void elementwiseFloat4(float *result, FreeWill::ElementwiseArguments<float> arguments, unsigned int vectorCount)
+{
+    for (unsigned int v = blockIdx.x * blockDim.x + threadIdx.x; v < vectorCount; v += blockDim.x * gridDim.x)
+    {
+        float4 loaded[Expression::OPERAND_COUNT > 0 ? Expression::OPERAND_COUNT : 1];
+
+        for (unsigned int k = 0; k < Expression::OPERAND_COUNT; ++k)
+        {
+            loaded[k] = reinterpret_cast<const float4 *>(arguments.m_operands[k])[v];
+        }
+
+        float4 stored;
+        float *lanes = reinterpret_cast<float *>(&stored);
+
+        for (unsigned int lane = 0; lane < 4; ++lane)
+        {
+            float values[Expression::OPERAND_COUNT > 0 ? Expression::OPERAND_COUNT : 1];
+
+            for (unsigned int k = 0; k < Expression::OPERAND_COUNT; ++k)
+            {
+                values[k] = reinterpret_cast<const float *>(&loaded[k])[lane];
+            }
+
+            lanes[lane] = Expression::evaluate(values, arguments.m_scalars);
+        }
+
+        reinterpret_cast<float4 *>(result)[v] = stored;
+    }
+}
+
+template <typename Expression, typename DataType>
+static void launchElementwise(DataType *result, const FreeWill::ElementwiseArguments<DataType> &arguments, unsigned int size)
+{
+    if (size == 0)
+    {
+        return;
+    }
+
+    elementwise<Expression, DataType><<<elementwiseGridSize(size), ELEMENTWISE_BLOCK_SIZE, 0, FreeWill::computeStream()>>>(result, arguments, size);
+    CHECK_CUDA_ERROR
+}
+
+template <typename Expression, typename DataType>
+struct ElementwiseLauncher
+{
+    static void launch(DataType *result, const FreeWill::ElementwiseArguments<DataType> &arguments, unsigned int size)
+    {
+        launchElementwise<Expression, DataType>(result, arguments, size);
+    }
+};
+
+// float takes the float4 kernel when every pointer is aligned, the scalar one for the tail
+template <typename Expression>
+struct ElementwiseLauncher<Expression, float>
+{
+    static void launch(float *result, const FreeWill::ElementwiseArguments<float> &arguments, unsigned int size)
+    {
+        bool isAligned = reinterpret_cast<uintptr_t>(result) % sizeof(float4) == 0;
+
+        for (unsigned int k = 0; k < Expression::OPERAND_COUNT; ++k)
+        {
+            isAligned = isAligned && reinterpret_cast<uintptr_t>(arguments.m_operands[k]) % sizeof(float4) == 0;
+        }
+
+        unsigned int vectorCount = isAligned ? size / 4 : 0;
+
+        if (vectorCount)
+        {
+            elementwiseFloat4<Expression><<<elementwiseGridSize(vectorCount), ELEMENTWISE_BLOCK_SIZE, 0, FreeWill::computeStream()>>>(result, arguments, vectorCount);
+            CHECK_CUDA_ERROR
+        }
+
+        unsigned int done = vectorCount * 4;
+
+        if (done < size)
+        {
+            FreeWill::ElementwiseArguments<float> tail = arguments;
+
+            for (unsigned int k = 0; k < Expression::OPERAND_COUNT; ++k)
+            {
+                tail.m_operands[k] += done;
+            }
+
+            launchElementwise<Expression, float>(result + done, tail, size - done);
+        }
+    }
+};
+
+template <typename Expression, typename DataType>
+__host__ void elementwiseCUDAKernel(DataType *result, const FreeWill::ElementwiseArguments<DataType> &arguments, unsigned int size)
+{
+    ElementwiseLauncher<Expression, DataType>::launch(result, arguments, size);
+}
+
+template <FreeWill::ActivationMode ActivationModeUsed, typename DataType>
+static void elementwiseAddActivationDerivative(bool isDerivativeOperandA, const DataType *output, const DataType *outputDelta,
+                                               const DataType *operand, DataType rate, DataType *result, unsigned int size)
+{
+    FreeWill::ElementwiseArguments<DataType> arguments = {{output, outputDelta, operand},
+                                                          {(typename FreeWill::ComputeType<DataType>::Type) rate}};
+
+    if (isDerivativeOperandA)
+    {
+        ElementwiseLauncher<typename FreeWill::ElementwiseAddActivationDerivative<ActivationModeUsed, true>::Type, DataType>::launch(result, arguments, size);
+    }
+    else
+    {
+        ElementwiseLauncher<typename FreeWill::ElementwiseAddActivationDerivative<ActivationModeUsed, false>::Type, DataType>::launch(result, arguments, size);
+    }
+}
+
+template <typename DataType>
+__host__ void elementwiseAddActivationDerivativeCUDAKernel(FreeWill::ActivationMode mode, bool isDerivativeOperandA, const DataType *output, const DataType *outputDelta,
+                                                            const DataType *operand, DataType rate, DataType *result, unsigned int size)
+{
+    switch (mode)
+    {
+    case FreeWill::ActivationMode::SIGMOID:
+        elementwiseAddActivationDerivative<FreeWill::ActivationMode::SIGMOID>(isDerivativeOperandA, output, outputDelta, operand, rate, result, size);
+        break;
+    case FreeWill::ActivationMode::RELU:
+        elementwiseAddActivationDerivative<FreeWill::ActivationMode::RELU>(isDerivativeOperandA, output, outputDelta, operand, rate, result, size);
+        break;
+    case FreeWill::ActivationMode::TANH:
+        elementwiseAddActivationDerivative<FreeWill::ActivationMode::TANH>(isDerivativeOperandA, output, outputDelta, operand, rate, result, size);
+        break;
+    case FreeWill::ActivationMode::CLIPPED_RELU:
+        elementwiseAddActivationDerivative<FreeWill::ActivationMode::CLIPPED_RELU>(isDerivativeOperandA, output, outputDelta, operand, rate, result, size);
+        break;
+    }
+}
+
+template __host__ void elementwiseCUDAKernel<FreeWill::ElementwiseAddExpression>(float *result, const FreeWill::ElementwiseArguments<float> &arguments, unsigned int size);
+template __host__ void elementwiseCUDAKernel<FreeWill::ElementwiseAddExpression>(double *result, const FreeWill::ElementwiseArguments<double> &arguments, unsigned int size);
+template __host__ void elementwiseCUDAKernel<FreeWill::ElementwiseAddExpression>(FreeWill::Half *result, const FreeWill::ElementwiseArguments<FreeWill::Half> &arguments, unsigned int size);
+template __host__ void elementwiseCUDAKernel<FreeWill::ElementwiseAddExpression>(FreeWill::BFloat16 *result, const FreeWill::ElementwiseArguments<FreeWill::BFloat16> &arguments, unsigned int size);
+template __host__ void elementwiseCUDAKernel<FreeWill::ElementwiseScaledSubtractExpression>(float *result, const FreeWill::ElementwiseArguments<float> &arguments, unsigned int size);
+template __host__ void elementwiseCUDAKernel<FreeWill::ElementwiseScaledSubtractExpression>(double *result, const FreeWill::ElementwiseArguments<double> &arguments, unsigned int size);
+template __host__ void elementwiseCUDAKernel<FreeWill::ElementwiseProductExpression>(float *result, const FreeWill::ElementwiseArguments<float> &arguments, unsigned int size);
+template __host__ void elementwiseCUDAKernel<FreeWill::ElementwiseProductExpression>(double *result, const FreeWill::ElementwiseArguments<double> &arguments, unsigned int size);
+
+template __host__ void elementwiseAddActivationDerivativeCUDAKernel(FreeWill::ActivationMode mode, bool isDerivativeOperandA, const float *output, const float *outputDelta,
+                                                                     const float *operand, float rate, float *result, unsigned int size);
+template __host__ void elementwiseAddActivationDerivativeCUDAKernel(FreeWill::ActivationMode mode, bool isDerivativeOperandA, const double *output, const double *outputDelta,
+                                                                     const double *operand, double rate, double *result, unsigned int size);
+template __host__ void elementwiseAddActivationDerivativeCUDAKernel(FreeWill::ActivationMode mode, bool isDerivativeOperandA, const FreeWill::Half *output, const FreeWill::Half *outputDelta,
+                                                                     const FreeWill::Half *operand, FreeWill::Half rate, FreeWill::Half *result, unsigned int size);
+template __host__ void elementwiseAddActivationDerivativeCUDAKernel(FreeWill::ActivationMode mode, bool isDerivativeOperandA, const FreeWill::BFloat16 *output, const FreeWill::BFloat16 *outputDelta,
+                                                                     const FreeWill::BFloat16 *operand, FreeWill::BFloat16 rate, FreeWill::BFloat16 *result, unsigned int size);
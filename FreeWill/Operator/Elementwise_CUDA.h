@@ -0,0 +1,21 @@
+#ifndef ELEMENTWISE_CUDA_H
+#define ELEMENTWISE_CUDA_H
+
+#include <cuda_runtime.h>
+
+#include "ElementwiseExpression.h"
+
+// shared with the cuda kernels, keep it c++11
+
+// result[i] = Expression of the operands at i, in one grid-stride pass. Float data aligned to
+// 16 bytes is loaded and stored as float4. Instantiated in Elementwise_CUDA.cu for the
+// expressions of ElementwiseExpression.h, add a line there for a new one.
+template <typename Expression, typename DataType>
+__host__ void elementwiseCUDAKernel(DataType *result, const FreeWill::ElementwiseArguments<DataType> &arguments, unsigned int size);
+
+// ElementwiseAddActivationDerivative with the mode picked at run time
+template <typename DataType>
+__host__ void elementwiseAddActivationDerivativeCUDAKernel(FreeWill::ActivationMode mode, bool isDerivativeOperandA, const DataType *output, const DataType *outputDelta,
+                                                            const DataType *operand, DataType rate, DataType *result, unsigned int size);
+
+#endif
@@ -1,6 +1,102 @@
 #ifndef FEEDFROMMEMORY_H
 #define FEEDFROMMEMORY_H
 
+#include "Operator.h"
+#include "../Context/Context.h"
 
+namespace FreeWill
+{
+    // Feeds Output from caller owned host memory without copying it into the tensor. On cpu,
+    // evaluate() binds Output to the memory given by setSource(), on gpu it also queues the
+    // upload from there on the copy stream and makes the compute stream wait for it. The
+    // memory has to stay alive and unchanged until the operators reading Output are done.
+    //
+    // A copying feed keeps Output's own memory and copies the source into it instead, on gpu
+    // straight into device memory, the host mirror is left as it is.
+    template<DeviceType DeviceUsed = DeviceType::CPU_NAIVE, typename DataType = float>
+    class FeedFromMemory : public Operator<DeviceUsed>
+    {
+    protected:
+        using Operator<DeviceUsed>::output;
+        using Operator<DeviceUsed>::m_deviceId;
+
+        DataType *m_source;
+        bool m_isCopying;
+
+    public:
+        enum OutputSlot : unsigned int {OUTPUT};
+
+        FeedFromMemory(unsigned int deviceId = 0, bool isCopying = false)
+            :Operator<DeviceUsed>({}, {"Output"}, deviceId),
+              m_source(nullptr),
+              m_isCopying(isCopying)
+        {
+        }
+
+        // Output's shape worth of values, for a replica its slice of the global batch
+        void setSource(DataType *source)
+        {
+            m_source = source;
+        }
+
+        virtual bool init() override
+        {
+            CHECK_GPU;
+
+            FAIL_IF (output("Output") == nullptr);
+
+            return true;
+        }
+
+        // the source moves with every batch and is read on the copy stream
+        virtual bool isCapturable() const override
+        {
+            return false;
+        }
+
+        virtual void evaluate() override
+        {
+            CHECK_GPU;
+
+            if (!m_source)
+            {
+                return;
+            }
+
+            TensorBase<DeviceUsed> *outputTensor = output(OUTPUT);
+
+            if (m_isCopying)
+            {
+                if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+                {
+                    std::memcpy(outputTensor->cpuDataHandle(), m_source, outputTensor->viewSizeInByte());
+                }
+                else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+                {
+                    Context<DeviceUsed> &context = Context<DeviceUsed>::getSingleton();
+
+                    RUN_CUDA(cudaMemcpyAsync(outputTensor->gpuDataHandle(), m_source, outputTensor->viewSizeInByte(),
+                                             cudaMemcpyHostToDevice, context.copyStream(m_deviceId)));
+                    RUN_CUDA(cudaStreamWaitEvent(computeStream(), context.recordCopies(m_deviceId), 0));
+                }
+
+                return;
+            }
+
+            if (!outputTensor->bindHost(m_source))
+            {
+                return;
+            }
+
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                Context<DeviceUsed> &context = Context<DeviceUsed>::getSingleton();
+
+                outputTensor->copyFromHostToDeviceAsync(context.copyStream(m_deviceId));
+                RUN_CUDA(cudaStreamWaitEvent(computeStream(), context.recordCopies(m_deviceId), 0));
+            }
+        }
+    };
+}
 
 #endif
@@ -0,0 +1,361 @@
+// No include guard: the body of GEMMKernelCPU, included inside namespace FreeWill by GEMM_CPU.h
+// and once more inside the namespace of every wider instruction set (see CPUKernels.h), with
+// CPU_KERNEL_VECTOR_BYTES set to the vector width of the instruction set.
+
+    // Column-major C = alpha * op(A) * op(B) + beta * C, following the cuBLAS gemm convention
+    // so the CPU and GPU paths of an operator can share the same leading dimensions.
+    // The register tile width follows CPU_KERNEL_VECTOR_BYTES, the vector width of the
+    // instruction set the class is compiled for, and the DataType.
+    template<typename DataType>
+    class GEMMKernelCPU
+    {
+    public:
+        static const unsigned int VECTOR_BYTES = CPU_KERNEL_VECTOR_BYTES;
+        static const unsigned int LANES = VECTOR_BYTES / sizeof(DataType);
+        static const unsigned int MR = LANES * 2;
+        static const unsigned int NR = 6;
+        static const unsigned int KC = 256;
+        static const unsigned int MC = MR * (sizeof(DataType) == 4 ? 8 : 12);
+        static const unsigned int NC = NR * 680;
+
+        typedef DataType Vector __attribute__((vector_size(VECTOR_BYTES)));
+        typedef DataType UnalignedVector __attribute__((vector_size(VECTOR_BYTES), aligned(sizeof(DataType))));
+
+    private:
+        static DataType *alignToVector(DataType *pointer)
+        {
+            std::uintptr_t address = reinterpret_cast<std::uintptr_t>(pointer);
+            return reinterpret_cast<DataType*>((address + VECTOR_BYTES - 1) & ~(std::uintptr_t)(VECTOR_BYTES - 1));
+        }
+
+        static void packA(bool transA, const DataType *A, unsigned int lda,
+                          unsigned int rowBegin, unsigned int mc, unsigned int depthBegin, unsigned int kc,
+                          DataType *packed)
+        {
+            for(unsigned int ir = 0; ir < mc; ir += MR)
+            {
+                unsigned int mr = std::min(MR, mc - ir);
+                for(unsigned int p = 0; p < kc; ++p)
+                {
+                    unsigned int i = 0;
+                    if (!transA)
+                    {
+                        const DataType *column = A + (size_t)(depthBegin + p) * lda + rowBegin + ir;
+                        for(; i < mr; ++i)
+                        {
+                            packed[i] = column[i];
+                        }
+                    }
+                    else
+                    {
+                        const DataType *row = A + (size_t)(rowBegin + ir) * lda + depthBegin + p;
+                        for(; i < mr; ++i)
+                        {
+                            packed[i] = row[(size_t)i * lda];
+                        }
+                    }
+
+                    for(; i < MR; ++i)
+                    {
+                        packed[i] = 0;
+                    }
+                    packed += MR;
+                }
+            }
+        }
+
+        static void packB(bool transB, const DataType *B, unsigned int ldb,
+                          unsigned int depthBegin, unsigned int kc, unsigned int columnBegin, unsigned int nc,
+                          DataType *packed)
+        {
+            for(unsigned int jr = 0; jr < nc; jr += NR)
+            {
+                unsigned int nr = std::min(NR, nc - jr);
+                for(unsigned int p = 0; p < kc; ++p)
+                {
+                    unsigned int j = 0;
+                    if (!transB)
+                    {
+                        const DataType *row = B + (size_t)(columnBegin + jr) * ldb + depthBegin + p;
+                        for(; j < nr; ++j)
+                        {
+                            packed[j] = row[(size_t)j * ldb];
+                        }
+                    }
+                    else
+                    {
+                        const DataType *column = B + (size_t)(depthBegin + p) * ldb + columnBegin + jr;
+                        for(; j < nr; ++j)
+                        {
+                            packed[j] = column[j];
+                        }
+                    }
+
+                    for(; j < NR; ++j)
+                    {
+                        packed[j] = 0;
+                    }
+                    packed += NR;
+                }
+            }
+        }
+
+        static void microKernel(unsigned int kc, const DataType *packedA, const DataType *packedB,
+                                DataType alpha, DataType beta, DataType *C, unsigned int ldc,
+                                unsigned int mr, unsigned int nr, const GEMMEpilogueCPU<DataType> *epilogue)
+        {
+            Vector accumulator[NR][2] = {};
+
+            for(unsigned int p = 0; p < kc; ++p)
+            {
+                Vector a0 = *reinterpret_cast<const Vector*>(packedA);
+                Vector a1 = *reinterpret_cast<const Vector*>(packedA + LANES);
+
+#pragma GCC unroll 8
+                for(unsigned int j = 0; j < NR; ++j)
+                {
+                    DataType b = packedB[j];
+                    accumulator[j][0] += a0 * b;
+                    accumulator[j][1] += a1 * b;
+                }
+
+                packedA += MR;
+                packedB += NR;
+            }
+
+            if (mr == MR && nr == NR)
+            {
+                for(unsigned int j = 0; j < NR; ++j)
+                {
+                    DataType *column = C + (size_t)j * ldc;
+                    Vector c0 = accumulator[j][0] * alpha;
+                    Vector c1 = accumulator[j][1] * alpha;
+
+                    if (beta != 0)
+                    {
+                        c0 += *reinterpret_cast<UnalignedVector*>(column) * beta;
+                        c1 += *reinterpret_cast<UnalignedVector*>(column + LANES) * beta;
+                    }
+
+                    *reinterpret_cast<UnalignedVector*>(column) = c0;
+                    *reinterpret_cast<UnalignedVector*>(column + LANES) = c1;
+
+                    if (epilogue)
+                    {
+                        epilogue->apply(column, MR);
+                    }
+                }
+            }
+            else
+            {
+                for(unsigned int j = 0; j < nr; ++j)
+                {
+                    DataType *column = C + (size_t)j * ldc;
+                    for(unsigned int i = 0; i < mr; ++i)
+                    {
+                        DataType value = alpha * accumulator[j][i / LANES][i % LANES];
+                        column[i] = value + (beta != 0 ? beta * column[i] : 0);
+                    }
+
+                    if (epilogue)
+                    {
+                        epilogue->apply(column, mr);
+                    }
+                }
+            }
+        }
+
+        // the columns of a register tile past the last row of y read as zero, like a packed panel
+        static Vector loadRows(const DataType *column, unsigned int rowCount)
+        {
+            Vector rows = {};
+            for(unsigned int i = 0; i < rowCount; ++i)
+            {
+                rows[i] = column[i];
+            }
+            return rows;
+        }
+
+        static void storeRows(DataType *y, unsigned int rowCount, Vector c0, Vector c1, DataType alpha, DataType beta)
+        {
+            for(unsigned int i = 0; i < rowCount; ++i)
+            {
+                DataType value = alpha * (i < LANES ? c0[i] : c1[i - LANES]);
+                y[i] = value + (beta != 0 ? beta * y[i] : 0);
+            }
+        }
+
+    public:
+        // gemm with N = 1, y = alpha * op(A) * x + beta * y, x read every incx elements. A is
+        // streamed once without packing, the register tile of MR rows keeping its two vector
+        // accumulators over a whole depth block. The depth blocks, the order of the
+        // multiply-adds and the epilogue tiles are those of gemm, so a single column comes out
+        // the same as from gemm.
+        static void gemv(bool transA, unsigned int M, unsigned int K,
+                         DataType alpha, const DataType *A, unsigned int lda,
+                         const DataType *x, unsigned int incx,
+                         DataType beta, DataType *y,
+                         const GEMMEpilogueCPU<DataType> *epilogue = nullptr)
+        {
+            if (M == 0)
+            {
+                return;
+            }
+
+            if (K == 0 || alpha == 0)
+            {
+                for(unsigned int i = 0; i < M; ++i)
+                {
+                    y[i] = (beta != 0 ? beta * y[i] : 0);
+                }
+            }
+
+            for(unsigned int pc = 0; pc < K && alpha != 0; pc += KC)
+            {
+                unsigned int kc = std::min(KC, K - pc);
+                DataType betaBlock = (pc == 0) ? beta : (DataType) 1;
+                const DataType *xBlock = x + (size_t)pc * incx;
+
+                for(unsigned int ir = 0; ir < M; ir += MR)
+                {
+                    unsigned int mr = std::min(MR, M - ir);
+                    Vector c0 = {};
+                    Vector c1 = {};
+
+                    if (transA)
+                    {
+                        // the rows of op(A) are the contiguous columns of A, one scalar chain each
+                        DataType accumulator[MR] = {};
+                        const DataType *rows = A + (size_t)ir * lda + pc;
+
+                        for(unsigned int p = 0; p < kc; ++p)
+                        {
+                            DataType b = xBlock[(size_t)p * incx];
+#pragma GCC unroll 16
+                            for(unsigned int i = 0; i < MR; ++i)
+                            {
+                                if (i < mr)
+                                {
+                                    accumulator[i] += rows[(size_t)i * lda + p] * b;
+                                }
+                            }
+                        }
+
+                        for(unsigned int i = 0; i < MR; ++i)
+                        {
+                            (i < LANES ? c0[i] : c1[i - LANES]) = accumulator[i];
+                        }
+                    }
+                    else if (mr == MR)
+                    {
+                        const DataType *column = A + (size_t)pc * lda + ir;
+
+                        for(unsigned int p = 0; p < kc; ++p)
+                        {
+                            DataType b = xBlock[(size_t)p * incx];
+                            c0 += *reinterpret_cast<const UnalignedVector*>(column) * b;
+                            c1 += *reinterpret_cast<const UnalignedVector*>(column + LANES) * b;
+                            column += lda;
+                        }
+                    }
+                    else
+                    {
+                        const DataType *column = A + (size_t)pc * lda + ir;
+
+                        for(unsigned int p = 0; p < kc; ++p)
+                        {
+                            DataType b = xBlock[(size_t)p * incx];
+                            c0 += loadRows(column, std::min(mr, LANES)) * b;
+                            c1 += loadRows(column + LANES, mr > LANES ? mr - LANES : 0) * b;
+                            column += lda;
+                        }
+                    }
+
+                    storeRows(y + ir, mr, c0, c1, alpha, betaBlock);
+                }
+            }
+
+            if (epilogue)
+            {
+                for(unsigned int ir = 0; ir < M; ir += MR)
+                {
+                    epilogue->shifted(ir).apply(y + ir, std::min(MR, M - ir));
+                }
+            }
+        }
+
+        static void gemm(bool transA, bool transB, unsigned int M, unsigned int N, unsigned int K,
+                         DataType alpha, const DataType *A, unsigned int lda,
+                         const DataType *B, unsigned int ldb,
+                         DataType beta, DataType *C, unsigned int ldc,
+                         const GEMMEpilogueCPU<DataType> *epilogue = nullptr)
+        {
+            if (M == 0 || N == 0)
+            {
+                return;
+            }
+
+            if (K == 0 || alpha == 0)
+            {
+                for(unsigned int j = 0; j < N; ++j)
+                {
+                    for(unsigned int i = 0; i < M; ++i)
+                    {
+                        C[(size_t)j * ldc + i] = (beta != 0 ? beta * C[(size_t)j * ldc + i] : 0);
+                    }
+
+                    if (epilogue)
+                    {
+                        epilogue->apply(C + (size_t)j * ldc, M);
+                    }
+                }
+                return;
+            }
+
+            // packed panels are kept vector aligned so the micro kernel can use aligned loads
+            thread_local std::vector<DataType> packedABuffer(MC * KC + LANES);
+            thread_local std::vector<DataType> packedBBuffer(NC * KC + LANES);
+            DataType *packedA = alignToVector(packedABuffer.data());
+            DataType *packedB = alignToVector(packedBBuffer.data());
+
+            for(unsigned int jc = 0; jc < N; jc += NC)
+            {
+                unsigned int nc = std::min(NC, N - jc);
+
+                for(unsigned int pc = 0; pc < K; pc += KC)
+                {
+                    unsigned int kc = std::min(KC, K - pc);
+                    DataType betaBlock = (pc == 0) ? beta : (DataType) 1;
+                    bool isLastBlock = (pc + kc == K);
+
+                    packB(transB, B, ldb, pc, kc, jc, nc, packedB);
+
+                    for(unsigned int ic = 0; ic < M; ic += MC)
+                    {
+                        unsigned int mc = std::min(MC, M - ic);
+
+                        packA(transA, A, lda, ic, mc, pc, kc, packedA);
+
+                        GEMMEpilogueCPU<DataType> blockEpilogue;
+                        if (epilogue && isLastBlock)
+                        {
+                            blockEpilogue = epilogue->shifted(ic);
+                        }
+
+                        for(unsigned int jr = 0; jr < nc; jr += NR)
+                        {
+                            unsigned int nr = std::min(NR, nc - jr);
+                            for(unsigned int ir = 0; ir < mc; ir += MR)
+                            {
+                                unsigned int mr = std::min(MR, mc - ir);
+                                GEMMEpilogueCPU<DataType> tileEpilogue = blockEpilogue.shifted(ir);
+                                microKernel(kc, packedA + (size_t)ir * kc, packedB + (size_t)jr * kc,
+                                            alpha, betaBlock, C + (size_t)(jc + jr) * ldc + ic + ir, ldc, mr, nr,
+                                            (epilogue && isLastBlock) ? &tileEpilogue : nullptr);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    };
@@ -0,0 +1,230 @@
+#ifndef GEMM_CPU_H
+#define GEMM_CPU_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "Activation_CPU.h"
+#include "CPUKernels.h"
+#include "../Context/ThreadPool.h"
+#include "../Tensor/HalfPrecision.h"
+
+namespace FreeWill
+{
+    // Finishes C while a tile is still in cache: C = activation(C + rowBias[row]). It is run
+    // once per element, after the last depth block, so operators can fold their bias and
+    // activation into the GEMM writeback instead of making more passes over the output.
+    template<typename DataType>
+    struct GEMMEpilogueCPU
+    {
+        const DataType *m_rowBias = nullptr;
+        bool m_hasActivation = false;
+        ActivationMode m_activationMode = ActivationMode::SIGMOID;
+
+        void apply(DataType *column, unsigned int rowCount) const
+        {
+            if (m_rowBias)
+            {
+                for(unsigned int i = 0; i < rowCount; ++i)
+                {
+                    column[i] += m_rowBias[i];
+                }
+            }
+
+            if (m_hasActivation)
+            {
+                activationForwardCPU<DataType>(m_activationMode, column, column, rowCount);
+            }
+        }
+
+        // the same epilogue for a block of C starting at row rowBegin
+        GEMMEpilogueCPU shifted(unsigned int rowBegin) const
+        {
+            GEMMEpilogueCPU epilogue = *this;
+            if (epilogue.m_rowBias)
+            {
+                epilogue.m_rowBias += rowBegin;
+            }
+            return epilogue;
+        }
+    };
+
+    // How gemmCPU shares C among the thread pool. AUTOMATIC goes serial below a million
+    // multiply-adds and otherwise splits the longer side, the others force one choice, for
+    // operators whose CPUAutotuner timings found a better one for their shape.
+    enum class GEMMPartitionCPU
+    {
+        AUTOMATIC,
+        SERIAL,
+        ROWS,
+        COLUMNS
+    };
+
+#define CPU_KERNEL_VECTOR_BYTES CPU_BASELINE_VECTOR_BYTES
+#include "GEMMKernel_CPU.h"
+#undef CPU_KERNEL_VECTOR_BYTES
+
+    // 16-bit matrices, converted to float and back around the float kernel
+    template<typename DataType>
+    void gemmCPUWidened(bool transA, bool transB, unsigned int M, unsigned int N, unsigned int K,
+                        DataType alpha, const DataType *A, unsigned int lda,
+                        const DataType *B, unsigned int ldb,
+                        DataType beta, DataType *C, unsigned int ldc,
+                        const GEMMEpilogueCPU<DataType> *epilogue);
+
+    template<typename DataType>
+    void gemmCPU(bool transA, bool transB, unsigned int M, unsigned int N, unsigned int K,
+                 DataType alpha, const DataType *A, unsigned int lda,
+                 const DataType *B, unsigned int ldb,
+                 DataType beta, DataType *C, unsigned int ldc,
+                 const GEMMEpilogueCPU<DataType> *epilogue = nullptr,
+                 GEMMPartitionCPU partition = GEMMPartitionCPU::AUTOMATIC)
+    {
+        if constexpr (IsReducedPrecision<DataType>::value)
+        {
+            gemmCPUWidened<DataType>(transA, transB, M, N, K, alpha, A, lda, B, ldb, beta, C, ldc, epilogue);
+        }
+        else
+        {
+            // the kernel of the instruction set the cpu runs, see CPUKernels.h
+            const CPUKernelTable<DataType> &kernels = cpuKernels<DataType>();
+            const unsigned int MR = kernels.m_gemmTileRows;
+            const unsigned int NR = kernels.m_gemmTileColumns;
+            ThreadPool &threadPool = ThreadPool::getSingleton();
+
+            // a single column, as in a batch of one through a dot product, skips the packing
+            if (N == 1)
+            {
+                partition = partition == GEMMPartitionCPU::AUTOMATIC && (double) M * K >= 1.0e6 ?
+                            GEMMPartitionCPU::ROWS : GEMMPartitionCPU::SERIAL;
+
+                if (threadPool.threadCount() == 0 || partition == GEMMPartitionCPU::SERIAL)
+                {
+                    kernels.m_gemv(transA, M, K, alpha, A, lda, B, transB ? ldb : 1, beta, C, epilogue);
+                    return;
+                }
+
+                unsigned int tileCount = (M + MR - 1) / MR;
+                unsigned int grain = std::max(1u, tileCount / (threadPool.threadCount() * 4));
+                threadPool.parallelFor(0, tileCount, grain, [&](unsigned int begin, unsigned int end)
+                {
+                    unsigned int rowBegin = begin * MR;
+                    unsigned int rowEnd = std::min(M, end * MR);
+                    const DataType *ABlock = A + (transA ? (size_t) rowBegin * lda : (size_t) rowBegin);
+                    GEMMEpilogueCPU<DataType> blockEpilogue;
+                    if (epilogue)
+                    {
+                        blockEpilogue = epilogue->shifted(rowBegin);
+                    }
+                    kernels.m_gemv(transA, rowEnd - rowBegin, K, alpha, ABlock, lda, B, transB ? ldb : 1,
+                                   beta, C + rowBegin, epilogue ? &blockEpilogue : nullptr);
+                });
+                return;
+            }
+
+            if (partition == GEMMPartitionCPU::AUTOMATIC)
+            {
+                // below roughly a million multiply-adds the fork/join costs more than it saves
+                if ((double) M * N * K < 1.0e6)
+                {
+                    partition = GEMMPartitionCPU::SERIAL;
+                }
+                else
+                {
+                    partition = N >= M ? GEMMPartitionCPU::COLUMNS : GEMMPartitionCPU::ROWS;
+                }
+            }
+
+            if (threadPool.threadCount() == 0 || partition == GEMMPartitionCPU::SERIAL)
+            {
+                kernels.m_gemm(transA, transB, M, N, K, alpha, A, lda, B, ldb, beta, C, ldc, epilogue);
+                return;
+            }
+
+            // every block of C is computed by exactly one serial gemm call, so the result does not
+            // depend on the thread count. Split in whole register tiles.
+            if (partition == GEMMPartitionCPU::COLUMNS)
+            {
+                unsigned int tileCount = (N + NR - 1) / NR;
+                unsigned int grain = std::max(1u, tileCount / (threadPool.threadCount() * 4));
+                threadPool.parallelFor(0, tileCount, grain, [&](unsigned int begin, unsigned int end)
+                {
+                    unsigned int columnBegin = begin * NR;
+                    unsigned int columnEnd = std::min(N, end * NR);
+                    const DataType *BBlock = B + (transB ? (size_t) columnBegin : (size_t) columnBegin * ldb);
+                    kernels.m_gemm(transA, transB, M, columnEnd - columnBegin, K, alpha, A, lda, BBlock, ldb,
+                                 beta, C + (size_t) columnBegin * ldc, ldc, epilogue);
+                });
+            }
+            else
+            {
+                unsigned int tileCount = (M + MR - 1) / MR;
+                unsigned int grain = std::max(1u, tileCount / (threadPool.threadCount() * 4));
+                threadPool.parallelFor(0, tileCount, grain, [&](unsigned int begin, unsigned int end)
+                {
+                    unsigned int rowBegin = begin * MR;
+                    unsigned int rowEnd = std::min(M, end * MR);
+                    const DataType *ABlock = A + (transA ? (size_t) rowBegin * lda : (size_t) rowBegin);
+                    GEMMEpilogueCPU<DataType> blockEpilogue;
+                    if (epilogue)
+                    {
+                        blockEpilogue = epilogue->shifted(rowBegin);
+                    }
+                    kernels.m_gemm(transA, transB, rowEnd - rowBegin, N, K, alpha, ABlock, lda, B, ldb,
+                                 beta, C + rowBegin, ldc, epilogue ? &blockEpilogue : nullptr);
+                });
+            }
+        }
+    }
+
+    template<typename DataType>
+    void gemmCPUWidened(bool transA, bool transB, unsigned int M, unsigned int N, unsigned int K,
+                        DataType alpha, const DataType *A, unsigned int lda,
+                        const DataType *B, unsigned int ldb,
+                        DataType beta, DataType *C, unsigned int ldc,
+                        const GEMMEpilogueCPU<DataType> *epilogue)
+    {
+        auto widen = [](const DataType *matrix, unsigned int rows, unsigned int columns, unsigned int leadingDimension)
+        {
+            std::vector<float> widened(columns == 0 ? 0 : (size_t) (columns - 1) * leadingDimension + rows);
+            for(size_t i = 0; i < widened.size(); ++i)
+            {
+                widened[i] = matrix[i];
+            }
+            return widened;
+        };
+
+        std::vector<float> widenedA = widen(A, transA ? K : M, transA ? M : K, lda);
+        std::vector<float> widenedB = widen(B, transB ? N : K, transB ? K : N, ldb);
+        std::vector<float> widenedC = widen(C, M, N, ldc);
+
+        if ((float) beta == 0)
+        {
+            std::fill(widenedC.begin(), widenedC.end(), 0.0f);
+        }
+
+        std::vector<float> widenedBias;
+        GEMMEpilogueCPU<float> widenedEpilogue;
+        if (epilogue)
+        {
+            if (epilogue->m_rowBias)
+            {
+                widenedBias = widen(epilogue->m_rowBias, M, 1, M);
+                widenedEpilogue.m_rowBias = widenedBias.data();
+            }
+            widenedEpilogue.m_hasActivation = epilogue->m_hasActivation;
+            widenedEpilogue.m_activationMode = epilogue->m_activationMode;
+        }
+
+        gemmCPU<float>(transA, transB, M, N, K, alpha, widenedA.data(), lda, widenedB.data(), ldb,
+                       beta, widenedC.data(), ldc, epilogue ? &widenedEpilogue : nullptr);
+
+        for(size_t i = 0; i < widenedC.size(); ++i)
+        {
+            C[i] = widenedC[i];
+        }
+    }
+}
+
+#endif
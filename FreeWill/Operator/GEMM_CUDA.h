@@ -0,0 +1,81 @@
+#ifndef GEMM_CUDA_H
+#define GEMM_CUDA_H
+
+#include <cublas_v2.h>
+#include <type_traits>
+#include "../DeviceSelection.h"
+#include "../Tensor/HalfPrecision.h"
+
+namespace FreeWill
+{
+    template<typename DataType>
+    constexpr cudaDataType_t cudaDataTypeOf()
+    {
+        if constexpr (std::is_same<DataType, Half>::value)
+        {
+            return CUDA_R_16F;
+        }
+        else if constexpr (std::is_same<DataType, BFloat16>::value)
+        {
+            return CUDA_R_16BF;
+        }
+        else if constexpr (std::is_same<DataType, double>::value)
+        {
+            return CUDA_R_64F;
+        }
+        else
+        {
+            return CUDA_R_32F;
+        }
+    }
+
+    // Column-major gemm for 16-bit matrices with float accumulation, eligible for Tensor
+    // Cores. The scale factors are float like the compute type.
+    template<typename DataType>
+    void gemmReducedPrecisionCUDA(cublasHandle_t handle, cublasOperation_t transA, cublasOperation_t transB,
+                                  unsigned int M, unsigned int N, unsigned int K,
+                                  float alpha, const DataType *A, unsigned int lda,
+                                  const DataType *B, unsigned int ldb,
+                                  float beta, DataType *C, unsigned int ldc)
+    {
+        RUN_CUBLAS(cublasGemmEx(handle, transA, transB, M, N, K,
+                                &alpha, A, cudaDataTypeOf<DataType>(), lda,
+                                B, cudaDataTypeOf<DataType>(), ldb,
+                                &beta, C, cudaDataTypeOf<DataType>(), ldc,
+                                CUDA_R_32F, CUBLAS_GEMM_DEFAULT_TENSOR_OP));
+    }
+
+    // batchCount column-major gemms in one launch, the i-th on A + i * strideA, B + i * strideB
+    // and C + i * strideC. A stride of 0 shares the matrix between all of them.
+    template<typename DataType>
+    void gemmStridedBatchedCUDA(cublasHandle_t handle, cublasOperation_t transA, cublasOperation_t transB,
+                                unsigned int M, unsigned int N, unsigned int K,
+                                float alpha, const DataType *A, unsigned int lda, long long int strideA,
+                                const DataType *B, unsigned int ldb, long long int strideB,
+                                float beta, DataType *C, unsigned int ldc, long long int strideC,
+                                unsigned int batchCount)
+    {
+        if constexpr (std::is_same<DataType, float>::value)
+        {
+            RUN_CUBLAS(cublasSgemmStridedBatched(handle, transA, transB, M, N, K, &alpha, A, lda, strideA,
+                                                 B, ldb, strideB, &beta, C, ldc, strideC, batchCount));
+        }
+        else if constexpr (std::is_same<DataType, double>::value)
+        {
+            double doubleAlpha = alpha;
+            double doubleBeta = beta;
+            RUN_CUBLAS(cublasDgemmStridedBatched(handle, transA, transB, M, N, K, &doubleAlpha, A, lda, strideA,
+                                                 B, ldb, strideB, &doubleBeta, C, ldc, strideC, batchCount));
+        }
+        else
+        {
+            RUN_CUBLAS(cublasGemmStridedBatchedEx(handle, transA, transB, M, N, K,
+                                                  &alpha, A, cudaDataTypeOf<DataType>(), lda, strideA,
+                                                  B, cudaDataTypeOf<DataType>(), ldb, strideB,
+                                                  &beta, C, cudaDataTypeOf<DataType>(), ldc, strideC,
+                                                  batchCount, CUDA_R_32F, CUBLAS_GEMM_DEFAULT_TENSOR_OP));
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,268 @@
+#ifndef GROUPEDCONVOLUTION_CPU_H
+#define GROUPEDCONVOLUTION_CPU_H
+
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
+#include "CPUKernels.h"
+#include "Convolution_CPU.h"
+#include "GEMM_CPU.h"
+#include "../Context/ThreadPool.h"
+
+namespace FreeWill
+{
+#define CPU_KERNEL_VECTOR_BYTES CPU_BASELINE_VECTOR_BYTES
+#include "DepthwiseKernel_CPU.h"
+#undef CPU_KERNEL_VECTOR_BYTES
+
+    // A grouped convolution splits the channelCount channels of geometry and its filterCount
+    // filters into groupCount groups, group g convolving its own channels with its own filters:
+    // the feature map is {channelCount / groupCount, filterSize, filterSize, filterCount}. When
+    // every group is one channel it is a depthwise convolution.
+    inline ConvolutionGeometryCPU groupGeometryCPU(const ConvolutionGeometryCPU &geometry, unsigned int groupCount)
+    {
+        ConvolutionGeometryCPU groupGeometry = geometry;
+        groupGeometry.channelCount = geometry.channelCount / groupCount;
+        groupGeometry.filterCount = geometry.filterCount / groupCount;
+        return groupGeometry;
+    }
+
+    // the depthwise convolution specialized for geometry, see DepthwiseKernelCPU::select,
+    // float and double from the kernels of the instruction set the cpu runs
+    template<typename DataType>
+    DepthwiseConvolutionCPU<DataType> selectDepthwiseConvolutionCPU(const ConvolutionGeometryCPU &geometry)
+    {
+        if constexpr (std::is_same<DataType, float>::value || std::is_same<DataType, double>::value)
+        {
+            return cpuKernels<DataType>().m_selectDepthwiseConvolution(geometry);
+        }
+        else
+        {
+            return DepthwiseKernelCPU<DataType>::select(geometry);
+        }
+    }
+
+    // the depthwise filters {1, filterSize, filterSize, filterCount} as
+    // taps {filterSize * filterSize, filterCount}, a window position's weights together
+    template<typename DataType>
+    void depthwiseTapsCPU(const ConvolutionGeometryCPU &geometry, const DataType *featureMap, DataType *taps)
+    {
+        unsigned int tapCount = geometry.filterSize * geometry.filterSize;
+
+        for (unsigned int f = 0; f < geometry.filterCount; ++f)
+        {
+            for (unsigned int t = 0; t < tapCount; ++t)
+            {
+                taps[(size_t) t * geometry.filterCount + f] = featureMap[(size_t) f * tapCount + t];
+            }
+        }
+    }
+
+    // output += depthwise convolution(input, featureMap), then the epilogue, with the convolution
+    // selectDepthwiseConvolutionCPU picked, it selects one when null.
+    template<typename DataType>
+    void convolutionDepthwiseCPU(const ConvolutionGeometryCPU &geometry, unsigned int batchSize,
+                                 const DataType *input, const DataType *featureMap, DataType *output,
+                                 std::vector<DataType> &workspace, const GEMMEpilogueCPU<DataType> &epilogue,
+                                 DepthwiseConvolutionCPU<DataType> convolution = nullptr)
+    {
+        workspace.resize((size_t) geometry.filterSize * geometry.filterSize * geometry.filterCount);
+        depthwiseTapsCPU(geometry, featureMap, workspace.data());
+
+        if (!convolution)
+        {
+            convolution = selectDepthwiseConvolutionCPU<DataType>(geometry);
+        }
+
+        convolution(geometry, batchSize, input, workspace.data(), output, epilogue);
+    }
+
+    // Accumulates the three depthwise gradients directly, the transposed taps and their
+    // gradient in workspace: featureMapGrad += input * outputGrad over the windows,
+    // inputGrad += taps * outputGrad and biasGrad += the sums of outputGrad.
+    template<typename DataType>
+    void convolutionDepthwiseBackwardCPU(const ConvolutionGeometryCPU &geometry, unsigned int batchSize,
+                                         const DataType *prevActivation, const DataType *featureMap, const DataType *outputGrad,
+                                         DataType *featureMapGrad, DataType *biasGrad, DataType *inputGrad,
+                                         std::vector<DataType> &workspace)
+    {
+        const unsigned int channelCount = geometry.channelCount;
+        const unsigned int filterCount = geometry.filterCount;
+        const unsigned int multiplier = filterCount / channelCount;
+        const unsigned int filterSize = geometry.filterSize;
+        size_t tapsSize = (size_t) filterSize * filterSize * filterCount;
+        size_t imageSize = (size_t) geometry.width * geometry.height * channelCount;
+
+        workspace.assign(2 * tapsSize, 0);
+
+        DataType *taps = workspace.data();
+        DataType *tapsGrad = taps + tapsSize;
+
+        depthwiseTapsCPU(geometry, featureMap, taps);
+
+        for (unsigned int b = 0; b < batchSize; ++b)
+        {
+            const DataType *image = prevActivation + b * imageSize;
+            DataType *imageGrad = inputGrad + b * imageSize;
+
+            for (unsigned int outputY = 0; outputY < geometry.outputHeight; ++outputY)
+            {
+                int startY = (int) (outputY * geometry.strideY) - (int) geometry.zeroPaddingY;
+
+                for (unsigned int outputX = 0; outputX < geometry.outputWidth; ++outputX)
+                {
+                    int startX = (int) (outputX * geometry.strideX) - (int) geometry.zeroPaddingX;
+                    const DataType *pixelGrad = outputGrad + (((size_t) b * geometry.outputHeight + outputY) * geometry.outputWidth + outputX) * filterCount;
+
+                    for (unsigned int f = 0; f < filterCount; ++f)
+                    {
+                        biasGrad[f] += pixelGrad[f];
+                    }
+
+                    for (unsigned int y = 0; y < filterSize; ++y)
+                    {
+                        int realY = startY + (int) y;
+
+                        if (realY < 0 || realY >= (int) geometry.height)
+                        {
+                            continue;
+                        }
+
+                        for (unsigned int x = 0; x < filterSize; ++x)
+                        {
+                            int realX = startX + (int) x;
+
+                            if (realX < 0 || realX >= (int) geometry.width)
+                            {
+                                continue;
+                            }
+
+                            size_t pixel = ((size_t) realY * geometry.width + realX) * channelCount;
+                            size_t tap = (size_t) (y * filterSize + x) * filterCount;
+
+                            for (unsigned int f = 0; f < filterCount; ++f)
+                            {
+                                tapsGrad[tap + f] += image[pixel + f / multiplier] * pixelGrad[f];
+                                imageGrad[pixel + f / multiplier] += taps[tap + f] * pixelGrad[f];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        unsigned int tapCount = filterSize * filterSize;
+
+        for (unsigned int f = 0; f < filterCount; ++f)
+        {
+            for (unsigned int t = 0; t < tapCount; ++t)
+            {
+                featureMapGrad[(size_t) f * tapCount + t] += tapsGrad[(size_t) t * filterCount + f];
+            }
+        }
+    }
+
+    // channels [first, first + count) of every one of pixelCount pixels of channelCount
+    // channels, packed into count channels
+    template<typename DataType>
+    void gatherChannelsCPU(const DataType *source, unsigned int channelCount, unsigned int first, unsigned int count,
+                           size_t pixelCount, DataType *destination)
+    {
+        for (size_t p = 0; p < pixelCount; ++p)
+        {
+            const DataType *pixel = source + p * channelCount + first;
+            std::copy(pixel, pixel + count, destination + p * count);
+        }
+    }
+
+    // the reverse of gatherChannelsCPU, adding to the channels when isAdding
+    template<typename DataType>
+    void scatterChannelsCPU(const DataType *source, unsigned int count, size_t pixelCount,
+                            DataType *destination, unsigned int channelCount, unsigned int first, bool isAdding)
+    {
+        for (size_t p = 0; p < pixelCount; ++p)
+        {
+            const DataType *pixel = source + p * count;
+            DataType *result = destination + p * channelCount + first;
+
+            for (unsigned int c = 0; c < count; ++c)
+            {
+                result[c] = isAdding ? result[c] + pixel[c] : pixel[c];
+            }
+        }
+    }
+
+    // output += grouped convolution(input, featureMap), then the epilogue: every group's
+    // channels of input and output are packed into groupWorkspace and convolved by
+    // convolutionIm2colCPU with its filters, which are contiguous in the feature map.
+    template<typename DataType>
+    void convolutionGroupedCPU(const ConvolutionGeometryCPU &geometry, unsigned int groupCount, unsigned int batchSize,
+                               const DataType *input, const DataType *featureMap, DataType *output,
+                               std::vector<DataType> &workspace, std::vector<DataType> &groupWorkspace,
+                               const GEMMEpilogueCPU<DataType> &epilogue)
+    {
+        ConvolutionGeometryCPU groupGeometry = groupGeometryCPU(geometry, groupCount);
+        Im2colFunctionCPU<DataType> im2col = selectIm2colCPU<DataType>(groupGeometry);
+        size_t inputPixelCount = (size_t) geometry.width * geometry.height * batchSize;
+        size_t outputPixelCount = (size_t) geometry.outputPixelCount() * batchSize;
+
+        groupWorkspace.resize(inputPixelCount * groupGeometry.channelCount + outputPixelCount * groupGeometry.filterCount);
+
+        DataType *groupInput = groupWorkspace.data();
+        DataType *groupOutput = groupInput + inputPixelCount * groupGeometry.channelCount;
+
+        for (unsigned int g = 0; g < groupCount; ++g)
+        {
+            unsigned int firstFilter = g * groupGeometry.filterCount;
+            GEMMEpilogueCPU<DataType> groupEpilogue = epilogue.shifted(firstFilter);
+
+            gatherChannelsCPU(input, geometry.channelCount, g * groupGeometry.channelCount, groupGeometry.channelCount, inputPixelCount, groupInput);
+            gatherChannelsCPU(output, geometry.filterCount, firstFilter, groupGeometry.filterCount, outputPixelCount, groupOutput);
+
+            convolutionIm2colCPU<DataType>(groupGeometry, batchSize, groupInput, featureMap + (size_t) firstFilter * groupGeometry.patchSize(),
+                                           groupOutput, workspace, &groupEpilogue, im2col);
+
+            scatterChannelsCPU(groupOutput, groupGeometry.filterCount, outputPixelCount, output, geometry.filterCount, firstFilter, false);
+        }
+    }
+
+    // The grouped convolutionBackwardIm2colCPU, one group at a time: the gradients of a group's
+    // filters and biases are contiguous and accumulated in place, its input gradient is
+    // computed packed and added to inputGrad.
+    template<typename DataType>
+    void convolutionGroupedBackwardCPU(const ConvolutionGeometryCPU &geometry, unsigned int groupCount, unsigned int batchSize,
+                                       const DataType *prevActivation, const DataType *featureMap, const DataType *outputGrad,
+                                       DataType *featureMapGrad, DataType *biasGrad, DataType *inputGrad,
+                                       std::vector<DataType> &workspace, std::vector<DataType> &groupWorkspace)
+    {
+        ConvolutionGeometryCPU groupGeometry = groupGeometryCPU(geometry, groupCount);
+        size_t inputPixelCount = (size_t) geometry.width * geometry.height * batchSize;
+        size_t outputPixelCount = (size_t) geometry.outputPixelCount() * batchSize;
+        size_t groupInputSize = inputPixelCount * groupGeometry.channelCount;
+
+        groupWorkspace.resize(2 * groupInputSize + outputPixelCount * groupGeometry.filterCount);
+
+        DataType *groupInput = groupWorkspace.data();
+        DataType *groupInputGrad = groupInput + groupInputSize;
+        DataType *groupOutputGrad = groupInputGrad + groupInputSize;
+
+        for (unsigned int g = 0; g < groupCount; ++g)
+        {
+            unsigned int firstChannel = g * groupGeometry.channelCount;
+            unsigned int firstFilter = g * groupGeometry.filterCount;
+            size_t filterOffset = (size_t) firstFilter * groupGeometry.patchSize();
+
+            gatherChannelsCPU(prevActivation, geometry.channelCount, firstChannel, groupGeometry.channelCount, inputPixelCount, groupInput);
+            gatherChannelsCPU(outputGrad, geometry.filterCount, firstFilter, groupGeometry.filterCount, outputPixelCount, groupOutputGrad);
+            std::fill(groupInputGrad, groupInputGrad + groupInputSize, 0);
+
+            convolutionBackwardIm2colCPU<DataType>(groupGeometry, batchSize, groupInput, featureMap + filterOffset, groupOutputGrad,
+                                                   featureMapGrad + filterOffset, biasGrad + firstFilter, groupInputGrad, workspace);
+
+            scatterChannelsCPU(groupInputGrad, groupGeometry.channelCount, inputPixelCount, inputGrad, geometry.channelCount, firstChannel, true);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,507 @@
+#ifndef LSTM_H
+#define LSTM_H
+
+#include "Operator.h"
+#include "LSTM_CPU.h"
+#include "LSTM_CUDA.h"
+#include "../Context/Context.h"
+#include "../Context/ComputeStream.h"
+#include <vector>
+
+namespace FreeWill
+{
+    // What LSTM and LSTMDerivative share: the shapes, and on gpu the cuDNN RNN they both run.
+    //
+    // The tensors are batch-last: Input {input, sequence, batch}, Output {hidden, sequence,
+    // batch}. InputWeight {input, 4 * hidden} and RecurrentWeight {hidden, 4 * hidden} hold the
+    // rows of the input, forget, cell and output gates one block after another, Bias {4 * hidden}
+    // likewise. A sequence starts from a zero hidden and cell state.
+    //
+    // cuDNN wants its weights packed in one buffer of its own layout and the sequences time-major,
+    // so the device workspace holds the packed weights, the transposed sequences and cuDNN's own
+    // workspace one after another. The persistent kernels, which keep the recurrent weights on
+    // chip for the whole sequence, are used where cuDNN has them (float, sm_60 and newer, shapes
+    // that fit), the standard algorithm otherwise.
+    template<DeviceType DeviceUsed = DeviceType::CPU_NAIVE, typename DataType = float>
+    class LSTMBase : public Operator<DeviceUsed>
+    {
+    protected:
+        using Operator<DeviceUsed>::input;
+        using Operator<DeviceUsed>::output;
+        using Operator<DeviceUsed>::m_deviceId;
+
+        unsigned int m_inputSize;
+        unsigned int m_hiddenSize;
+        unsigned int m_sequenceLength;
+
+        // the derivative runs the training calls, which need cuDNN's reserve and the weight gradients
+        bool m_isTraining;
+
+        cudnnDropoutDescriptor_t m_dropoutDescriptor;
+        cudnnRNNDescriptor_t m_rnnDescriptor;
+        cudnnTensorDescriptor_t m_inputStepDescriptor;
+        cudnnTensorDescriptor_t m_outputStepDescriptor;
+        cudnnTensorDescriptor_t m_stateDescriptor;
+        cudnnFilterDescriptor_t m_weightDescriptor;
+        std::vector<cudnnTensorDescriptor_t> m_inputDescriptors;
+        std::vector<cudnnTensorDescriptor_t> m_outputDescriptors;
+        cudnnRNNAlgo_t m_algorithm;
+        unsigned int m_gpuBatchSize;
+
+        // where cuDNN keeps the matrix and the bias of each gate in its packed weights
+        size_t m_inputWeightOffsets[LSTM_GATE_COUNT];
+        size_t m_recurrentWeightOffsets[LSTM_GATE_COUNT];
+        size_t m_inputBiasOffsets[LSTM_GATE_COUNT];
+        size_t m_recurrentBiasOffsets[LSTM_GATE_COUNT];
+
+        // the pieces of the device workspace
+        size_t m_weightSize;
+        size_t m_weightGradOffset;
+        size_t m_sequenceInputOffset;
+        size_t m_sequenceOutputOffset;
+        size_t m_sequenceOutputDeltaOffset;
+        size_t m_sequenceInputDeltaOffset;
+        size_t m_reserveOffset;
+        size_t m_reserveSize;
+        size_t m_cudnnWorkspaceOffset;
+        size_t m_cudnnWorkspaceSize;
+
+        LSTMBase(const std::initializer_list<std::string> &inputParameterList,
+                 const std::initializer_list<std::string> &outputParameterList,
+                 bool isTraining, unsigned int deviceId)
+            :Operator<DeviceUsed>(inputParameterList, outputParameterList, deviceId),
+            m_inputSize(0),
+            m_hiddenSize(0),
+            m_sequenceLength(0),
+            m_isTraining(isTraining),
+            m_dropoutDescriptor(0),
+            m_rnnDescriptor(0),
+            m_inputStepDescriptor(0),
+            m_outputStepDescriptor(0),
+            m_stateDescriptor(0),
+            m_weightDescriptor(0),
+            m_inputDescriptors(),
+            m_outputDescriptors(),
+            m_algorithm(CUDNN_RNN_ALGO_STANDARD),
+            m_gpuBatchSize(0),
+            m_inputWeightOffsets(),
+            m_recurrentWeightOffsets(),
+            m_inputBiasOffsets(),
+            m_recurrentBiasOffsets(),
+            m_weightSize(0),
+            m_weightGradOffset(0),
+            m_sequenceInputOffset(0),
+            m_sequenceOutputOffset(0),
+            m_sequenceOutputDeltaOffset(0),
+            m_sequenceInputDeltaOffset(0),
+            m_reserveOffset(0),
+            m_reserveSize(0),
+            m_cudnnWorkspaceOffset(0),
+            m_cudnnWorkspaceSize(0)
+        {
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                RUN_CUDNN(cudnnCreateDropoutDescriptor(&m_dropoutDescriptor));
+                RUN_CUDNN(cudnnCreateRNNDescriptor(&m_rnnDescriptor));
+                RUN_CUDNN(cudnnCreateTensorDescriptor(&m_inputStepDescriptor));
+                RUN_CUDNN(cudnnCreateTensorDescriptor(&m_outputStepDescriptor));
+                RUN_CUDNN(cudnnCreateTensorDescriptor(&m_stateDescriptor));
+                RUN_CUDNN(cudnnCreateFilterDescriptor(&m_weightDescriptor));
+            }
+        }
+
+        // the shapes of Input and the weights, false when they don't make a cell
+        bool initShapes()
+        {
+            FAIL_IF (!input("Input") || !input("InputWeight") || !input("RecurrentWeight") || !input("Bias"));
+
+            FAIL_IF (input("Input")->shape().dimension() != 3);
+
+            FAIL_IF (input("InputWeight")->shape().dimension() != 2 || input("RecurrentWeight")->shape().dimension() != 2);
+
+            FAIL_IF (input("InputWeight")->shape()[0] != input("Input")->shape()[0]);
+
+            FAIL_IF (input("InputWeight")->shape()[1] == 0 || input("InputWeight")->shape()[1] % LSTM_GATE_COUNT != 0);
+
+            m_inputSize = input("Input")->shape()[0];
+            m_sequenceLength = input("Input")->shape()[1];
+            m_hiddenSize = input("InputWeight")->shape()[1] / LSTM_GATE_COUNT;
+
+            FAIL_IF (m_sequenceLength == 0);
+
+            FAIL_IF (input("RecurrentWeight")->shape()[0] != m_hiddenSize || input("RecurrentWeight")->shape()[1] != LSTM_GATE_COUNT * m_hiddenSize);
+
+            FAIL_IF (input("Bias")->shape().dimension() != 1 || input("Bias")->shape()[0] != LSTM_GATE_COUNT * m_hiddenSize);
+
+            return true;
+        }
+
+        // whether tensor is a {vectorSize, sequence, batch} sequence of the batch of Input
+        bool isSequence(TensorBase<DeviceUsed> *tensor, unsigned int vectorSize)
+        {
+            return tensor->shape().dimension() == 3 && tensor->shape()[0] == vectorSize &&
+                    tensor->shape()[1] == m_sequenceLength && tensor->shape()[2] == input("Input")->shape()[2];
+        }
+
+        cudnnDataType_t cudnnDataType() const
+        {
+            return std::is_same<DataType, double>::value ? CUDNN_DATA_DOUBLE : CUDNN_DATA_FLOAT;
+        }
+
+        static size_t alignedSize(size_t sizeInByte)
+        {
+            return (sizeInByte + 255) / 256 * 256;
+        }
+
+        void setStepDescriptors(unsigned int batchSize)
+        {
+            int inputDimensions[3] = {(int) batchSize, (int) m_inputSize, 1};
+            int inputStrides[3] = {(int) m_inputSize, 1, 1};
+            int outputDimensions[3] = {(int) batchSize, (int) m_hiddenSize, 1};
+            int outputStrides[3] = {(int) m_hiddenSize, 1, 1};
+            int stateDimensions[3] = {1, (int) batchSize, (int) m_hiddenSize};
+            int stateStrides[3] = {(int) (batchSize * m_hiddenSize), (int) m_hiddenSize, 1};
+
+            RUN_CUDNN(cudnnSetTensorNdDescriptor(m_inputStepDescriptor, cudnnDataType(), 3, inputDimensions, inputStrides));
+            RUN_CUDNN(cudnnSetTensorNdDescriptor(m_outputStepDescriptor, cudnnDataType(), 3, outputDimensions, outputStrides));
+            RUN_CUDNN(cudnnSetTensorNdDescriptor(m_stateDescriptor, cudnnDataType(), 3, stateDimensions, stateStrides));
+
+            m_inputDescriptors.assign(m_sequenceLength, m_inputStepDescriptor);
+            m_outputDescriptors.assign(m_sequenceLength, m_outputStepDescriptor);
+        }
+
+        // sets up the RNN for algorithm and queries its workspace and reserve for the batch of the
+        // step descriptors, false when cuDNN doesn't run it for this shape
+        bool setAlgorithm(cudnnRNNAlgo_t algorithm)
+        {
+            cudnnHandle_t handle = Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId);
+
+            if (cudnnSetRNNDescriptor_v6(handle, m_rnnDescriptor, (int) m_hiddenSize, 1, m_dropoutDescriptor, CUDNN_LINEAR_INPUT,
+                                         CUDNN_UNIDIRECTIONAL, CUDNN_LSTM, algorithm, cudnnDataType()) != CUDNN_STATUS_SUCCESS)
+            {
+                return false;
+            }
+
+            m_reserveSize = 0;
+
+            if (cudnnGetRNNWorkspaceSize(handle, m_rnnDescriptor, (int) m_sequenceLength, m_inputDescriptors.data(),
+                                         &m_cudnnWorkspaceSize) != CUDNN_STATUS_SUCCESS)
+            {
+                return false;
+            }
+
+            if (m_isTraining && cudnnGetRNNTrainingReserveSize(handle, m_rnnDescriptor, (int) m_sequenceLength, m_inputDescriptors.data(),
+                                                               &m_reserveSize) != CUDNN_STATUS_SUCCESS)
+            {
+                return false;
+            }
+
+            m_algorithm = algorithm;
+            return true;
+        }
+
+        bool chooseAlgorithm()
+        {
+            cudaDeviceProp properties;
+
+            if (std::is_same<DataType, float>::value && cudaGetDeviceProperties(&properties, (int) m_deviceId) == cudaSuccess &&
+                    properties.major >= 6 && setAlgorithm(CUDNN_RNN_ALGO_PERSIST_STATIC))
+            {
+                return true;
+            }
+
+            return setAlgorithm(CUDNN_RNN_ALGO_STANDARD);
+        }
+
+        void reserveWorkspace(unsigned int batchSize)
+        {
+            size_t inputSequenceSize = alignedSize((size_t) m_sequenceLength * batchSize * m_inputSize * sizeof(DataType));
+            size_t outputSequenceSize = alignedSize((size_t) m_sequenceLength * batchSize * m_hiddenSize * sizeof(DataType));
+            size_t offset = alignedSize(m_weightSize);
+
+            m_weightGradOffset = offset;
+            offset += m_isTraining ? alignedSize(m_weightSize) : 0;
+            m_sequenceInputOffset = offset;
+            offset += inputSequenceSize;
+            m_sequenceOutputOffset = offset;
+            offset += outputSequenceSize;
+            m_sequenceOutputDeltaOffset = offset;
+            offset += m_isTraining ? outputSequenceSize : 0;
+            m_sequenceInputDeltaOffset = offset;
+            offset += m_isTraining ? inputSequenceSize : 0;
+            m_reserveOffset = offset;
+            offset += alignedSize(m_reserveSize);
+            m_cudnnWorkspaceOffset = offset;
+            offset += m_cudnnWorkspaceSize;
+
+            Context<DeviceUsed>::getSingleton().reserveWorkspace(m_deviceId, offset);
+        }
+
+        bool initGPU()
+        {
+            cudnnHandle_t handle = Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId);
+            unsigned int batchSize = input("Input")->shape()[2];
+
+            RUN_CUDNN(cudnnSetDropoutDescriptor(m_dropoutDescriptor, handle, 0.0f, nullptr, 0, 0));
+
+            setStepDescriptors(batchSize);
+
+            FAIL_IF (!chooseAlgorithm());
+
+            FAIL_IF (cudnnGetRNNParamsSize(handle, m_rnnDescriptor, m_inputStepDescriptor, &m_weightSize, cudnnDataType()) != CUDNN_STATUS_SUCCESS);
+
+            int weightDimensions[3] = {(int) (m_weightSize / sizeof(DataType)), 1, 1};
+            RUN_CUDNN(cudnnSetFilterNdDescriptor(m_weightDescriptor, cudnnDataType(), CUDNN_TENSOR_NCHW, 3, weightDimensions));
+
+            reserveWorkspace(batchSize);
+
+            // cuDNN hands out the pieces as pointers into a buffer, the offsets hold for any buffer
+            const unsigned char *base = (const unsigned char *) Context<DeviceUsed>::getSingleton().workspace(m_deviceId);
+            cudnnFilterDescriptor_t pieceDescriptor;
+            RUN_CUDNN(cudnnCreateFilterDescriptor(&pieceDescriptor));
+            bool isFound = true;
+
+            for (unsigned int g = 0; isFound && g < LSTM_GATE_COUNT; ++g)
+            {
+                void *inputWeight = nullptr;
+                void *recurrentWeight = nullptr;
+                void *inputBias = nullptr;
+                void *recurrentBias = nullptr;
+
+                isFound = cudnnGetRNNLinLayerMatrixParams(handle, m_rnnDescriptor, 0, m_inputStepDescriptor, m_weightDescriptor, base,
+                                                          g, pieceDescriptor, &inputWeight) == CUDNN_STATUS_SUCCESS &&
+                        cudnnGetRNNLinLayerMatrixParams(handle, m_rnnDescriptor, 0, m_inputStepDescriptor, m_weightDescriptor, base,
+                                                        g + LSTM_GATE_COUNT, pieceDescriptor, &recurrentWeight) == CUDNN_STATUS_SUCCESS &&
+                        cudnnGetRNNLinLayerBiasParams(handle, m_rnnDescriptor, 0, m_inputStepDescriptor, m_weightDescriptor, base,
+                                                      g, pieceDescriptor, &inputBias) == CUDNN_STATUS_SUCCESS &&
+                        cudnnGetRNNLinLayerBiasParams(handle, m_rnnDescriptor, 0, m_inputStepDescriptor, m_weightDescriptor, base,
+                                                      g + LSTM_GATE_COUNT, pieceDescriptor, &recurrentBias) == CUDNN_STATUS_SUCCESS;
+
+                m_inputWeightOffsets[g] = (const unsigned char *) inputWeight - base;
+                m_recurrentWeightOffsets[g] = (const unsigned char *) recurrentWeight - base;
+                m_inputBiasOffsets[g] = (const unsigned char *) inputBias - base;
+                m_recurrentBiasOffsets[g] = (const unsigned char *) recurrentBias - base;
+            }
+
+            RUN_CUDNN(cudnnDestroyFilterDescriptor(pieceDescriptor));
+
+            FAIL_IF (!isFound);
+
+            m_gpuBatchSize = batchSize;
+
+            return true;
+        }
+
+        // the persistent kernels may not take the new batch, the standard algorithm always does
+        void setGPUBatchSize(unsigned int batchSize)
+        {
+            setStepDescriptors(batchSize);
+
+            if (!setAlgorithm(m_algorithm))
+            {
+                setAlgorithm(CUDNN_RNN_ALGO_STANDARD);
+            }
+
+            reserveWorkspace(batchSize);
+            m_gpuBatchSize = batchSize;
+        }
+
+        // Copies the weights into cuDNN's packed layout. cuDNN has a bias for the input and one
+        // for the recurrent matrices where the operator has one, the recurrent one is zero.
+        void packWeights(const DataType *inputWeight, const DataType *recurrentWeight, const DataType *bias, unsigned char *packed)
+        {
+            size_t inputMatrixSize = (size_t) m_hiddenSize * m_inputSize * sizeof(DataType);
+            size_t recurrentMatrixSize = (size_t) m_hiddenSize * m_hiddenSize * sizeof(DataType);
+            size_t biasSize = m_hiddenSize * sizeof(DataType);
+
+            for (unsigned int g = 0; g < LSTM_GATE_COUNT; ++g)
+            {
+                RUN_CUDA(cudaMemcpyAsync(packed + m_inputWeightOffsets[g], inputWeight + (size_t) g * m_hiddenSize * m_inputSize,
+                                         inputMatrixSize, cudaMemcpyDeviceToDevice, computeStream()));
+                RUN_CUDA(cudaMemcpyAsync(packed + m_recurrentWeightOffsets[g], recurrentWeight + (size_t) g * m_hiddenSize * m_hiddenSize,
+                                         recurrentMatrixSize, cudaMemcpyDeviceToDevice, computeStream()));
+                RUN_CUDA(cudaMemcpyAsync(packed + m_inputBiasOffsets[g], bias + (size_t) g * m_hiddenSize,
+                                         biasSize, cudaMemcpyDeviceToDevice, computeStream()));
+                RUN_CUDA(cudaMemsetAsync(packed + m_recurrentBiasOffsets[g], 0, biasSize, computeStream()));
+            }
+        }
+
+        // the reverse of packWeights, the recurrent bias has nowhere to go
+        void unpackWeights(const unsigned char *packed, DataType *inputWeight, DataType *recurrentWeight, DataType *bias)
+        {
+            size_t inputMatrixSize = (size_t) m_hiddenSize * m_inputSize * sizeof(DataType);
+            size_t recurrentMatrixSize = (size_t) m_hiddenSize * m_hiddenSize * sizeof(DataType);
+            size_t biasSize = m_hiddenSize * sizeof(DataType);
+
+            for (unsigned int g = 0; g < LSTM_GATE_COUNT; ++g)
+            {
+                RUN_CUDA(cudaMemcpyAsync(inputWeight + (size_t) g * m_hiddenSize * m_inputSize, packed + m_inputWeightOffsets[g],
+                                         inputMatrixSize, cudaMemcpyDeviceToDevice, computeStream()));
+                RUN_CUDA(cudaMemcpyAsync(recurrentWeight + (size_t) g * m_hiddenSize * m_hiddenSize, packed + m_recurrentWeightOffsets[g],
+                                         recurrentMatrixSize, cudaMemcpyDeviceToDevice, computeStream()));
+                RUN_CUDA(cudaMemcpyAsync(bias + (size_t) g * m_hiddenSize, packed + m_inputBiasOffsets[g],
+                                         biasSize, cudaMemcpyDeviceToDevice, computeStream()));
+            }
+        }
+
+    public:
+        virtual ~LSTMBase() override
+        {
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                RUN_CUDNN(cudnnDestroyDropoutDescriptor(m_dropoutDescriptor));
+                RUN_CUDNN(cudnnDestroyRNNDescriptor(m_rnnDescriptor));
+                RUN_CUDNN(cudnnDestroyTensorDescriptor(m_inputStepDescriptor));
+                RUN_CUDNN(cudnnDestroyTensorDescriptor(m_outputStepDescriptor));
+                RUN_CUDNN(cudnnDestroyTensorDescriptor(m_stateDescriptor));
+                RUN_CUDNN(cudnnDestroyFilterDescriptor(m_weightDescriptor));
+
+                m_dropoutDescriptor = 0;
+                m_rnnDescriptor = 0;
+                m_inputStepDescriptor = 0;
+                m_outputStepDescriptor = 0;
+                m_stateDescriptor = 0;
+                m_weightDescriptor = 0;
+            }
+        }
+    };
+
+    // A fused LSTM layer over a whole sequence, see LSTMBase for the tensors. Output gets the
+    // hidden state of every step. On cpu the cell states and the activated gates of every step
+    // are what LSTMDerivative reads, they go to Cell {hidden, sequence, batch} and Gates
+    // {4 * hidden, sequence, batch} when those are bound; the gpu writes only Output, its
+    // derivative runs the sequence again.
+    template<DeviceType DeviceUsed = DeviceType::CPU_NAIVE, typename DataType = float>
+    class LSTM : public LSTMBase<DeviceUsed, DataType>
+    {
+    protected:
+        using LSTMBase<DeviceUsed, DataType>::input;
+        using LSTMBase<DeviceUsed, DataType>::output;
+        using LSTMBase<DeviceUsed, DataType>::m_deviceId;
+        using LSTMBase<DeviceUsed, DataType>::m_inputSize;
+        using LSTMBase<DeviceUsed, DataType>::m_hiddenSize;
+        using LSTMBase<DeviceUsed, DataType>::m_sequenceLength;
+        using LSTMBase<DeviceUsed, DataType>::m_rnnDescriptor;
+        using LSTMBase<DeviceUsed, DataType>::m_stateDescriptor;
+        using LSTMBase<DeviceUsed, DataType>::m_weightDescriptor;
+        using LSTMBase<DeviceUsed, DataType>::m_inputDescriptors;
+        using LSTMBase<DeviceUsed, DataType>::m_outputDescriptors;
+        using LSTMBase<DeviceUsed, DataType>::m_gpuBatchSize;
+        using LSTMBase<DeviceUsed, DataType>::m_sequenceInputOffset;
+        using LSTMBase<DeviceUsed, DataType>::m_sequenceOutputOffset;
+        using LSTMBase<DeviceUsed, DataType>::m_cudnnWorkspaceOffset;
+        using LSTMBase<DeviceUsed, DataType>::m_cudnnWorkspaceSize;
+
+        // the cell states and gates of the cpu when Cell and Gates aren't bound
+        std::vector<DataType> m_cell;
+        std::vector<DataType> m_gates;
+
+    public:
+        enum InputSlot : unsigned int {INPUT, INPUT_WEIGHT, RECURRENT_WEIGHT, BIAS};
+        enum OutputSlot : unsigned int {OUTPUT, CELL, GATES};
+
+        LSTM(unsigned int deviceId = 0)
+            :LSTMBase<DeviceUsed, DataType>({"Input", "InputWeight", "RecurrentWeight", "Bias"}, {"Output", "Cell", "Gates"}, false, deviceId),
+            m_cell(),
+            m_gates()
+        {
+        }
+
+        virtual bool init() override
+        {
+            CHECK_GPU;
+
+            if (!this->initShapes())
+            {
+                return false;
+            }
+
+            FAIL_IF (!output("Output") || !this->isSequence(output("Output"), m_hiddenSize));
+
+            FAIL_IF (output("Cell") && !this->isSequence(output("Cell"), m_hiddenSize));
+
+            FAIL_IF (output("Gates") && !this->isSequence(output("Gates"), LSTM_GATE_COUNT * m_hiddenSize));
+
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                return this->initGPU();
+            }
+
+            return true;
+        }
+
+        virtual void evaluate() override
+        {
+            CHECK_GPU;
+
+            Tensor<DeviceUsed, DataType> *_input = input(INPUT)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_inputWeight = input(INPUT_WEIGHT)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_recurrentWeight = input(RECURRENT_WEIGHT)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_bias = input(BIAS)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_output = output(OUTPUT)->template toType<DataType>();
+
+            unsigned int batchSize = _input->shape()[2];
+
+            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+            {
+                DataType *cell = nullptr;
+                DataType *gates = nullptr;
+
+                if (output(CELL))
+                {
+                    cell = output(CELL)->template toType<DataType>()->cpuDataHandle();
+                }
+                else
+                {
+                    m_cell.resize((size_t) m_hiddenSize * m_sequenceLength * batchSize);
+                    cell = m_cell.data();
+                }
+
+                if (output(GATES))
+                {
+                    gates = output(GATES)->template toType<DataType>()->cpuDataHandle();
+                }
+                else
+                {
+                    m_gates.resize((size_t) LSTM_GATE_COUNT * m_hiddenSize * m_sequenceLength * batchSize);
+                    gates = m_gates.data();
+                }
+
+                lstmForwardCPU<DataType>(_input->cpuDataHandle(), _inputWeight->cpuDataHandle(), _recurrentWeight->cpuDataHandle(),
+                                         _bias->cpuDataHandle(), _output->cpuDataHandle(), cell, gates,
+                                         m_inputSize, m_hiddenSize, m_sequenceLength, batchSize);
+            }
+            else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                if (batchSize != m_gpuBatchSize)
+                {
+                    this->setGPUBatchSize(batchSize);
+                }
+
+                unsigned char *workspace = (unsigned char *) Context<DeviceUsed>::getSingleton().workspace(m_deviceId);
+                DataType *sequenceInput = (DataType *) (workspace + m_sequenceInputOffset);
+                DataType *sequenceOutput = (DataType *) (workspace + m_sequenceOutputOffset);
+
+                this->packWeights(_inputWeight->gpuDataHandle(), _recurrentWeight->gpuDataHandle(), _bias->gpuDataHandle(), workspace);
+
+                lstmTransposeSequenceCUDAKernel<DataType>(_input->gpuDataHandle(), sequenceInput, m_inputSize, batchSize, m_sequenceLength);
+
+                RUN_CUDNN(cudnnRNNForwardInference(Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId),
+                                                   m_rnnDescriptor,
+                                                   (int) m_sequenceLength,
+                                                   m_inputDescriptors.data(), sequenceInput,
+                                                   m_stateDescriptor, nullptr,
+                                                   m_stateDescriptor, nullptr,
+                                                   m_weightDescriptor, workspace,
+                                                   m_outputDescriptors.data(), sequenceOutput,
+                                                   m_stateDescriptor, nullptr,
+                                                   m_stateDescriptor, nullptr,
+                                                   workspace + m_cudnnWorkspaceOffset, m_cudnnWorkspaceSize));
+
+                lstmTransposeSequenceCUDAKernel<DataType>(sequenceOutput, _output->gpuDataHandle(), m_hiddenSize, m_sequenceLength, batchSize);
+            }
+        }
+    };
+}
+
+#endif
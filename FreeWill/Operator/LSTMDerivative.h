@@ -0,0 +1,206 @@
+#ifndef LSTMDERIVATIVE_H
+#define LSTMDERIVATIVE_H
+
+#include "LSTM.h"
+
+namespace FreeWill
+{
+    // The gradients of an LSTM from OutputDelta {hidden, sequence, batch}: InputWeightGrad,
+    // RecurrentWeightGrad and BiasGrad have the shapes of their weights, InputDelta that of Input.
+    // The cpu goes back through the Output, Cell and Gates its LSTM kept. cuDNN's backward calls
+    // need the reserve of a training forward pass, which can't be handed from one operator to the
+    // next, so the gpu runs the sequence forward again first and leaves Output, Cell and Gates
+    // unbound if it likes.
+    template<DeviceType DeviceUsed = DeviceType::CPU_NAIVE, typename DataType = float>
+    class LSTMDerivative : public LSTMBase<DeviceUsed, DataType>
+    {
+    protected:
+        using LSTMBase<DeviceUsed, DataType>::input;
+        using LSTMBase<DeviceUsed, DataType>::output;
+        using LSTMBase<DeviceUsed, DataType>::m_deviceId;
+        using LSTMBase<DeviceUsed, DataType>::m_inputSize;
+        using LSTMBase<DeviceUsed, DataType>::m_hiddenSize;
+        using LSTMBase<DeviceUsed, DataType>::m_sequenceLength;
+        using LSTMBase<DeviceUsed, DataType>::m_rnnDescriptor;
+        using LSTMBase<DeviceUsed, DataType>::m_stateDescriptor;
+        using LSTMBase<DeviceUsed, DataType>::m_weightDescriptor;
+        using LSTMBase<DeviceUsed, DataType>::m_inputDescriptors;
+        using LSTMBase<DeviceUsed, DataType>::m_outputDescriptors;
+        using LSTMBase<DeviceUsed, DataType>::m_gpuBatchSize;
+        using LSTMBase<DeviceUsed, DataType>::m_weightSize;
+        using LSTMBase<DeviceUsed, DataType>::m_weightGradOffset;
+        using LSTMBase<DeviceUsed, DataType>::m_sequenceInputOffset;
+        using LSTMBase<DeviceUsed, DataType>::m_sequenceOutputOffset;
+        using LSTMBase<DeviceUsed, DataType>::m_sequenceOutputDeltaOffset;
+        using LSTMBase<DeviceUsed, DataType>::m_sequenceInputDeltaOffset;
+        using LSTMBase<DeviceUsed, DataType>::m_reserveOffset;
+        using LSTMBase<DeviceUsed, DataType>::m_reserveSize;
+        using LSTMBase<DeviceUsed, DataType>::m_cudnnWorkspaceOffset;
+        using LSTMBase<DeviceUsed, DataType>::m_cudnnWorkspaceSize;
+
+        // on gpu, add to the weight gradients instead of overwriting them, the cpu always adds
+        bool m_isAccumulating;
+
+        std::vector<DataType> m_cpuWorkspace;
+
+    public:
+        enum InputSlot : unsigned int {INPUT, INPUT_WEIGHT, RECURRENT_WEIGHT, BIAS, OUTPUT, CELL, GATES, OUTPUT_DELTA};
+        enum OutputSlot : unsigned int {INPUT_WEIGHT_GRAD, RECURRENT_WEIGHT_GRAD, BIAS_GRAD, INPUT_DELTA};
+
+        LSTMDerivative(unsigned int deviceId = 0)
+            :LSTMBase<DeviceUsed, DataType>({"Input", "InputWeight", "RecurrentWeight", "Bias", "Output", "Cell", "Gates", "OutputDelta"},
+                                            {"InputWeightGrad", "RecurrentWeightGrad", "BiasGrad", "InputDelta"}, true, deviceId),
+            m_isAccumulating(false),
+            m_cpuWorkspace()
+        {
+        }
+
+        void setAccumulating(bool isAccumulating)
+        {
+            m_isAccumulating = isAccumulating;
+        }
+
+        virtual bool init() override
+        {
+            CHECK_GPU;
+
+            if (!this->initShapes())
+            {
+                return false;
+            }
+
+            FAIL_IF (!input("OutputDelta") || !this->isSequence(input("OutputDelta"), m_hiddenSize));
+
+            FAIL_IF (!output("InputWeightGrad") || output("InputWeightGrad")->shape() != input("InputWeight")->shape());
+
+            FAIL_IF (!output("RecurrentWeightGrad") || output("RecurrentWeightGrad")->shape() != input("RecurrentWeight")->shape());
+
+            FAIL_IF (!output("BiasGrad") || output("BiasGrad")->shape() != input("Bias")->shape());
+
+            FAIL_IF (!output("InputDelta") || output("InputDelta")->shape() != input("Input")->shape());
+
+            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+            {
+                FAIL_IF (!input("Output") || !this->isSequence(input("Output"), m_hiddenSize));
+
+                FAIL_IF (!input("Cell") || !this->isSequence(input("Cell"), m_hiddenSize));
+
+                FAIL_IF (!input("Gates") || !this->isSequence(input("Gates"), LSTM_GATE_COUNT * m_hiddenSize));
+            }
+            else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                return this->initGPU();
+            }
+
+            return true;
+        }
+
+        virtual void evaluate() override
+        {
+            CHECK_GPU;
+
+            Tensor<DeviceUsed, DataType> *_input = input(INPUT)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_inputWeight = input(INPUT_WEIGHT)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_recurrentWeight = input(RECURRENT_WEIGHT)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_outputDelta = input(OUTPUT_DELTA)->template toType<DataType>();
+
+            Tensor<DeviceUsed, DataType> *_inputWeightGrad = output(INPUT_WEIGHT_GRAD)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_recurrentWeightGrad = output(RECURRENT_WEIGHT_GRAD)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_biasGrad = output(BIAS_GRAD)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_inputDelta = output(INPUT_DELTA)->template toType<DataType>();
+
+            unsigned int batchSize = _input->shape()[2];
+
+            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+            {
+                Tensor<DeviceUsed, DataType> *_output = input(OUTPUT)->template toType<DataType>();
+                Tensor<DeviceUsed, DataType> *_cell = input(CELL)->template toType<DataType>();
+                Tensor<DeviceUsed, DataType> *_gates = input(GATES)->template toType<DataType>();
+
+                lstmBackwardCPU<DataType>(_input->cpuDataHandle(), _inputWeight->cpuDataHandle(), _recurrentWeight->cpuDataHandle(),
+                                          _output->cpuDataHandle(), _cell->cpuDataHandle(), _gates->cpuDataHandle(), _outputDelta->cpuDataHandle(),
+                                          _inputWeightGrad->cpuDataHandle(), _recurrentWeightGrad->cpuDataHandle(), _biasGrad->cpuDataHandle(),
+                                          _inputDelta->cpuDataHandle(), m_inputSize, m_hiddenSize, m_sequenceLength, batchSize, m_cpuWorkspace);
+            }
+            else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                Tensor<DeviceUsed, DataType> *_bias = input(BIAS)->template toType<DataType>();
+
+                if (batchSize != m_gpuBatchSize)
+                {
+                    this->setGPUBatchSize(batchSize);
+                }
+
+                cudnnHandle_t handle = Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId);
+                unsigned char *workspace = (unsigned char *) Context<DeviceUsed>::getSingleton().workspace(m_deviceId);
+                unsigned char *weightGrad = workspace + m_weightGradOffset;
+                DataType *sequenceInput = (DataType *) (workspace + m_sequenceInputOffset);
+                DataType *sequenceOutput = (DataType *) (workspace + m_sequenceOutputOffset);
+                DataType *sequenceOutputDelta = (DataType *) (workspace + m_sequenceOutputDeltaOffset);
+                DataType *sequenceInputDelta = (DataType *) (workspace + m_sequenceInputDeltaOffset);
+                unsigned char *reserve = workspace + m_reserveOffset;
+                unsigned char *cudnnWorkspace = workspace + m_cudnnWorkspaceOffset;
+
+                this->packWeights(_inputWeight->gpuDataHandle(), _recurrentWeight->gpuDataHandle(), _bias->gpuDataHandle(), workspace);
+
+                // cudnnRNNBackwardWeights adds to the packed gradients
+                if (m_isAccumulating)
+                {
+                    this->packWeights(_inputWeightGrad->gpuDataHandle(), _recurrentWeightGrad->gpuDataHandle(), _biasGrad->gpuDataHandle(), weightGrad);
+                }
+                else
+                {
+                    RUN_CUDA(cudaMemsetAsync(weightGrad, 0, m_weightSize, computeStream()));
+                }
+
+                lstmTransposeSequenceCUDAKernel<DataType>(_input->gpuDataHandle(), sequenceInput, m_inputSize, batchSize, m_sequenceLength);
+                lstmTransposeSequenceCUDAKernel<DataType>(_outputDelta->gpuDataHandle(), sequenceOutputDelta, m_hiddenSize, batchSize, m_sequenceLength);
+
+                RUN_CUDNN(cudnnRNNForwardTraining(handle,
+                                                  m_rnnDescriptor,
+                                                  (int) m_sequenceLength,
+                                                  m_inputDescriptors.data(), sequenceInput,
+                                                  m_stateDescriptor, nullptr,
+                                                  m_stateDescriptor, nullptr,
+                                                  m_weightDescriptor, workspace,
+                                                  m_outputDescriptors.data(), sequenceOutput,
+                                                  m_stateDescriptor, nullptr,
+                                                  m_stateDescriptor, nullptr,
+                                                  cudnnWorkspace, m_cudnnWorkspaceSize,
+                                                  reserve, m_reserveSize));
+
+                RUN_CUDNN(cudnnRNNBackwardData(handle,
+                                               m_rnnDescriptor,
+                                               (int) m_sequenceLength,
+                                               m_outputDescriptors.data(), sequenceOutput,
+                                               m_outputDescriptors.data(), sequenceOutputDelta,
+                                               m_stateDescriptor, nullptr,
+                                               m_stateDescriptor, nullptr,
+                                               m_weightDescriptor, workspace,
+                                               m_stateDescriptor, nullptr,
+                                               m_stateDescriptor, nullptr,
+                                               m_inputDescriptors.data(), sequenceInputDelta,
+                                               m_stateDescriptor, nullptr,
+                                               m_stateDescriptor, nullptr,
+                                               cudnnWorkspace, m_cudnnWorkspaceSize,
+                                               reserve, m_reserveSize));
+
+                RUN_CUDNN(cudnnRNNBackwardWeights(handle,
+                                                  m_rnnDescriptor,
+                                                  (int) m_sequenceLength,
+                                                  m_inputDescriptors.data(), sequenceInput,
+                                                  m_stateDescriptor, nullptr,
+                                                  m_outputDescriptors.data(), sequenceOutput,
+                                                  cudnnWorkspace, m_cudnnWorkspaceSize,
+                                                  m_weightDescriptor, weightGrad,
+                                                  reserve, m_reserveSize));
+
+                lstmTransposeSequenceCUDAKernel<DataType>(sequenceInputDelta, _inputDelta->gpuDataHandle(), m_inputSize, m_sequenceLength, batchSize);
+
+                this->unpackWeights(weightGrad, _inputWeightGrad->gpuDataHandle(), _recurrentWeightGrad->gpuDataHandle(), _biasGrad->gpuDataHandle());
+            }
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,186 @@
+#ifndef LSTM_CPU_H
+#define LSTM_CPU_H
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "Activation_CPU.h"
+#include "GEMM_CPU.h"
+
+namespace FreeWill
+{
+    // the gates of a cell in the order their blocks sit in the weights: input, forget, cell, output
+    static const unsigned int LSTM_GATE_COUNT = 4;
+
+    template<typename DataType>
+    inline DataType lstmSigmoidCPU(DataType x)
+    {
+        return (DataType) 1 / ((DataType) 1 + std::exp(-x));
+    }
+
+    // One step over a batch once gates holds the pre-activations W x + R h + bias: activates them
+    // in place, then c = f * previousCell + i * g and h = o * tanh(c). previousCell is null on
+    // the first step. The items of a batch are gateStride and stateStride elements apart, so a
+    // step of a batch-last sequence is worked on where it is.
+    template<typename DataType>
+    void lstmGatesForwardCPU(DataType *gates, const DataType *previousCell, DataType *cell, DataType *hidden,
+                             unsigned int hiddenSize, unsigned int batchSize, size_t gateStride, size_t stateStride)
+    {
+        forEachActivationChunkCPU((size_t) hiddenSize * batchSize, [&](size_t begin, size_t end)
+        {
+            for (size_t j = begin; j < end; ++j)
+            {
+                size_t b = j / hiddenSize;
+                size_t k = j % hiddenSize;
+                DataType *gate = gates + b * gateStride + k;
+                size_t state = b * stateStride + k;
+
+                DataType i = lstmSigmoidCPU(gate[0]);
+                DataType f = lstmSigmoidCPU(gate[hiddenSize]);
+                DataType g = std::tanh(gate[2 * hiddenSize]);
+                DataType o = lstmSigmoidCPU(gate[3 * hiddenSize]);
+                DataType c = i * g + (previousCell ? f * previousCell[state] : (DataType) 0);
+
+                gate[0] = i;
+                gate[hiddenSize] = f;
+                gate[2 * hiddenSize] = g;
+                gate[3 * hiddenSize] = o;
+                cell[state] = c;
+                hidden[state] = o * std::tanh(c);
+            }
+        });
+    }
+
+    // The deltas of one step from the activated gates the forward pass kept. hiddenDelta is what
+    // the next step sent back to this hidden state (null on the last step) and is added to
+    // outputDelta; cellDelta carries dL/dc from the next step in and to the previous step out.
+    // Both are compact {hidden, batch}, gates, cell and gateDelta are strided as in the forward.
+    template<typename DataType>
+    void lstmGatesBackwardCPU(const DataType *gates, const DataType *previousCell, const DataType *cell,
+                              const DataType *outputDelta, const DataType *hiddenDelta, DataType *cellDelta, DataType *gateDelta,
+                              unsigned int hiddenSize, unsigned int batchSize, size_t gateStride, size_t stateStride)
+    {
+        forEachActivationChunkCPU((size_t) hiddenSize * batchSize, [&](size_t begin, size_t end)
+        {
+            for (size_t j = begin; j < end; ++j)
+            {
+                size_t b = j / hiddenSize;
+                size_t k = j % hiddenSize;
+                const DataType *gate = gates + b * gateStride + k;
+                DataType *delta = gateDelta + b * gateStride + k;
+                size_t state = b * stateStride + k;
+
+                DataType i = gate[0];
+                DataType f = gate[hiddenSize];
+                DataType g = gate[2 * hiddenSize];
+                DataType o = gate[3 * hiddenSize];
+                DataType previous = previousCell ? previousCell[state] : (DataType) 0;
+                DataType cellTanh = std::tanh(cell[state]);
+
+                DataType dh = outputDelta[state] + (hiddenDelta ? hiddenDelta[j] : (DataType) 0);
+                DataType dc = dh * o * ((DataType) 1 - cellTanh * cellTanh) + cellDelta[j];
+
+                delta[0] = dc * g * i * ((DataType) 1 - i);
+                delta[hiddenSize] = dc * previous * f * ((DataType) 1 - f);
+                delta[2 * hiddenSize] = dc * i * ((DataType) 1 - g * g);
+                delta[3 * hiddenSize] = dh * cellTanh * o * ((DataType) 1 - o);
+                cellDelta[j] = dc * f;
+            }
+        });
+    }
+
+    // The cell over a whole sequence, every tensor batch-last: input {inputSize, sequence, batch},
+    // output and cell {hidden, sequence, batch}, gates {4 * hidden, sequence, batch}. The input
+    // projection of all the steps is one gemm with the bias folded into its writeback, each step
+    // then adds its recurrent part with one gemm for the four gates and activates them in one pass.
+    template<typename DataType>
+    void lstmForwardCPU(const DataType *input, const DataType *inputWeight, const DataType *recurrentWeight, const DataType *bias,
+                        DataType *output, DataType *cell, DataType *gates,
+                        unsigned int inputSize, unsigned int hiddenSize, unsigned int sequenceLength, unsigned int batchSize)
+    {
+        const unsigned int gateSize = LSTM_GATE_COUNT * hiddenSize;
+        const size_t gateStride = (size_t) sequenceLength * gateSize;
+        const size_t stateStride = (size_t) sequenceLength * hiddenSize;
+
+        GEMMEpilogueCPU<DataType> epilogue;
+        epilogue.m_rowBias = bias;
+
+        gemmCPU<DataType>(true, false, gateSize, sequenceLength * batchSize, inputSize, 1, inputWeight, inputSize,
+                          input, inputSize, 0, gates, gateSize, &epilogue);
+
+        for (unsigned int t = 0; t < sequenceLength; ++t)
+        {
+            if (t > 0)
+            {
+                gemmCPU<DataType>(true, false, gateSize, batchSize, hiddenSize, 1, recurrentWeight, hiddenSize,
+                                  output + (size_t) (t - 1) * hiddenSize, stateStride,
+                                  1, gates + (size_t) t * gateSize, gateStride);
+            }
+
+            lstmGatesForwardCPU<DataType>(gates + (size_t) t * gateSize, t ? cell + (size_t) (t - 1) * hiddenSize : nullptr,
+                                          cell + (size_t) t * hiddenSize, output + (size_t) t * hiddenSize,
+                                          hiddenSize, batchSize, gateStride, stateStride);
+        }
+    }
+
+    // Back through the sequence lstmForwardCPU ran. The gate deltas of every step are kept in
+    // workspace, so the weight gradients and InputDelta are gemms over the whole sequence once the
+    // recurrence is done. The gradients are added to, inputDelta is overwritten.
+    template<typename DataType>
+    void lstmBackwardCPU(const DataType *input, const DataType *inputWeight, const DataType *recurrentWeight,
+                         const DataType *output, const DataType *cell, const DataType *gates, const DataType *outputDelta,
+                         DataType *inputWeightGrad, DataType *recurrentWeightGrad, DataType *biasGrad, DataType *inputDelta,
+                         unsigned int inputSize, unsigned int hiddenSize, unsigned int sequenceLength, unsigned int batchSize,
+                         std::vector<DataType> &workspace)
+    {
+        const unsigned int gateSize = LSTM_GATE_COUNT * hiddenSize;
+        const unsigned int stepCount = sequenceLength * batchSize;
+        const size_t gateStride = (size_t) sequenceLength * gateSize;
+        const size_t stateStride = (size_t) sequenceLength * hiddenSize;
+
+        workspace.assign((size_t) gateSize * stepCount + 2 * (size_t) hiddenSize * batchSize, (DataType) 0);
+        DataType *gateDelta = workspace.data();
+        DataType *hiddenDelta = gateDelta + (size_t) gateSize * stepCount;
+        DataType *cellDelta = hiddenDelta + (size_t) hiddenSize * batchSize;
+
+        for (unsigned int t = sequenceLength; t-- > 0;)
+        {
+            lstmGatesBackwardCPU<DataType>(gates + (size_t) t * gateSize, t ? cell + (size_t) (t - 1) * hiddenSize : nullptr,
+                                           cell + (size_t) t * hiddenSize, outputDelta + (size_t) t * hiddenSize,
+                                           t + 1 < sequenceLength ? hiddenDelta : nullptr, cellDelta, gateDelta + (size_t) t * gateSize,
+                                           hiddenSize, batchSize, gateStride, stateStride);
+
+            if (t > 0)
+            {
+                gemmCPU<DataType>(false, false, hiddenSize, batchSize, gateSize, 1, recurrentWeight, hiddenSize,
+                                  gateDelta + (size_t) t * gateSize, gateStride, 0, hiddenDelta, hiddenSize);
+            }
+        }
+
+        gemmCPU<DataType>(false, true, inputSize, gateSize, stepCount, 1, input, inputSize,
+                          gateDelta, gateSize, 1, inputWeightGrad, inputSize);
+
+        // a step pairs with the hidden state before it, which the first step of an item hasn't
+        for (unsigned int b = 0; sequenceLength > 1 && b < batchSize; ++b)
+        {
+            gemmCPU<DataType>(false, true, hiddenSize, gateSize, sequenceLength - 1, 1, output + (size_t) b * stateStride, hiddenSize,
+                              gateDelta + (size_t) b * gateStride + gateSize, gateSize, 1, recurrentWeightGrad, hiddenSize);
+        }
+
+        for (unsigned int s = 0; s < stepCount; ++s)
+        {
+            const DataType *delta = gateDelta + (size_t) s * gateSize;
+
+            for (unsigned int r = 0; r < gateSize; ++r)
+            {
+                biasGrad[r] += delta[r];
+            }
+        }
+
+        gemmCPU<DataType>(false, false, inputSize, stepCount, gateSize, 1, inputWeight, inputSize,
+                          gateDelta, gateSize, 0, inputDelta, inputSize);
+    }
+}
+
+#endif
@@ -0,0 +1,43 @@
+#include "LSTM_CUDA.h"
+#include "../DeviceSelection.h"
+#include "../Context/ComputeStream.h"
+#include <cuda_runtime.h>
+
+// one thread per element, consecutive threads write consecutive elements of the output
+template <typename DataType>
+__global__ void lstmTransposeSequence(const DataType *input, DataType *output, unsigned int vectorSize,
+                                      unsigned int outerCount, unsigned int innerCount)
+{
+    unsigned int id = blockIdx.x * blockDim.x + threadIdx.x;
+
+    if (id >= vectorSize * outerCount * innerCount)
+    {
+        return;
+    }
+
+    unsigned int e = id % vectorSize;
+    unsigned int vector = id / vectorSize;
+    unsigned int outer = vector % outerCount;
+    unsigned int inner = vector / outerCount;
+
+    output[id] = input[((size_t) outer * innerCount + inner) * vectorSize + e];
+}
+
+template <typename DataType>
+__host__ void lstmTransposeSequenceCUDAKernel(const DataType *input, DataType *output, unsigned int vectorSize,
+                                              unsigned int outerCount, unsigned int innerCount)
+{
+    int blockSize = 256;
+    int gridSize = (vectorSize * outerCount * innerCount + blockSize - 1) / blockSize;
+
+    if (gridSize == 0)
+    {
+        return;
+    }
+
+    lstmTransposeSequence<DataType><<<gridSize, blockSize, 0, FreeWill::computeStream()>>>(input, output, vectorSize, outerCount, innerCount);
+    CHECK_CUDA_ERROR
+}
+
+template __host__ void lstmTransposeSequenceCUDAKernel(const float *input, float *output, unsigned int vectorSize, unsigned int outerCount, unsigned int innerCount);
+template __host__ void lstmTransposeSequenceCUDAKernel(const double *input, double *output, unsigned int vectorSize, unsigned int outerCount, unsigned int innerCount);
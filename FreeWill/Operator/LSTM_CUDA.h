@@ -0,0 +1,15 @@
+#ifndef LSTM_CUDA_H
+#define LSTM_CUDA_H
+
+#include <cuda_runtime.h>
+
+// shared with the cuda kernels, keep it c++11
+
+// Swaps the two outer dimensions of a sequence of vectors: input[outer][inner][vector] goes to
+// output[inner][outer][vector]. It turns the batch-last tensors into the time-major sequences
+// cuDNN's RNN calls take and back.
+template <typename DataType = float>
+__host__ void lstmTransposeSequenceCUDAKernel(const DataType *input, DataType *output, unsigned int vectorSize,
+                                              unsigned int outerCount, unsigned int innerCount);
+
+#endif
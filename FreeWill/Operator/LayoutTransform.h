@@ -0,0 +1,69 @@
+#ifndef LAYOUTTRANSFORM_H
+#define LAYOUTTRANSFORM_H
+
+#include "Operator.h"
+#include "ChannelBlocked_CPU.h"
+
+namespace FreeWill
+{
+    // Copies a {channel, width, height, batch} Input into an Output of the same shape in
+    // another layout, CHANNEL_LAST to a channel blocked one or back. Model::planLayouts puts
+    // them where blocked and CHANNEL_LAST operators meet. Cpu only, the gpu operators all take
+    // CHANNEL_LAST.
+    template<DeviceType DeviceUsed = DeviceType::CPU_NAIVE, typename DataType = float>
+    class LayoutTransform : public Operator<DeviceUsed>
+    {
+    protected:
+        using Operator<DeviceUsed>::input;
+        using Operator<DeviceUsed>::output;
+
+    public:
+        enum InputSlot : unsigned int {INPUT};
+        enum OutputSlot : unsigned int {OUTPUT};
+
+        LayoutTransform(unsigned int deviceId = 0)
+            :Operator<DeviceUsed>({"Input"}, {"Output"}, deviceId)
+        {
+        }
+
+        virtual bool init() override
+        {
+            CHECK_GPU;
+
+            FAIL_IF (DeviceUsed != DeviceType::CPU_NAIVE);
+
+            FAIL_IF (!input("Input") || !output("Output"));
+
+            FAIL_IF (input("Input")->shape().dimension() != 4);
+
+            FAIL_IF (input("Input")->shape() != output("Output")->shape());
+
+            TensorLayout from = input("Input")->layout();
+            TensorLayout to = output("Output")->layout();
+
+            FAIL_IF ((from == TensorLayout::CHANNEL_LAST) == (to == TensorLayout::CHANNEL_LAST));
+
+            FAIL_IF (input("Input")->shape()[0] % channelBlockSize(from == TensorLayout::CHANNEL_LAST ? to : from));
+
+            return true;
+        }
+
+        virtual void evaluate() override
+        {
+            CHECK_GPU;
+
+            Tensor<DeviceUsed, DataType> *_input = input(INPUT)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_output = output(OUTPUT)->template toType<DataType>();
+
+            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+            {
+                const Shape &shape = _input->shape();
+
+                convertLayoutCPU<DataType>(_input->layout(), _output->layout(), _input->cpuDataHandle(), _output->cpuDataHandle(),
+                                           shape[0], shape[1] * shape[2], shape[3]);
+            }
+        }
+    };
+}
+
+#endif
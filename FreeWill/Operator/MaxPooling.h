@@ -2,6 +2,9 @@
 #define MAXPOOLING_H
 
 #include "Operator.h"
+#include "MaxPooling_CPU.h"
+#include "MaxPooling_CUDA.h"
+#include "../Context/ThreadPool.h"
 #include <cudnn.h>
 
 namespace FreeWill
@@ -17,14 +20,21 @@ namespace FreeWill
         cudnnPoolingDescriptor_t m_poolingDescriptor;
         cudnnTensorDescriptor_t m_inputTensorDescriptor;
         cudnnTensorDescriptor_t m_outputTensorDescriptor;
-
+        unsigned int m_gpuBatchSize;
+        // on gpu, pool with the switch kernel instead of cudnn, see writeSwitch
+        bool m_isSwitchWritten;
 
     public:
+        enum InputSlot : unsigned int {INPUT};
+        enum OutputSlot : unsigned int {OUTPUT, SWITCH};
+
         MaxPooling(unsigned int deviceId = 0)
-            :Operator<DeviceUsed>({"Input"},{"Output", "SwitchX", "SwitchY"}, deviceId),
+            :Operator<DeviceUsed>({"Input"},{"Output", "Switch"}, deviceId),
             m_poolingDescriptor(0),
             m_inputTensorDescriptor(0),
-            m_outputTensorDescriptor(0)
+            m_outputTensorDescriptor(0),
+            m_gpuBatchSize(0),
+            m_isSwitchWritten(false)
         {
             CHECK_GPU;
 
@@ -52,6 +62,14 @@ namespace FreeWill
             }
         }
 
+        // The cpu always writes the switches. On gpu the derivative reads the input and the
+        // output through cudnn, unless the switches are written for it to read instead, see
+        // Model::planActivationCompression.
+        void writeSwitch()
+        {
+            m_isSwitchWritten = true;
+        }
+
         virtual bool init() override
         {
             CHECK_GPU;
@@ -64,11 +82,28 @@ namespace FreeWill
 
             if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
             {
-                FAIL_IF(!output("SwitchX") || !output("SwitchY"));
+                // see MaxPooling_CPU.h for the encoding
+                FAIL_IF (!output("Switch"));
+
+                FAIL_IF (output("Switch")->shape() != maxPoolingSwitchShape(output("Output")->shape()));
+
+                // A blocked image pools as channel / block images of block channels, the rows
+                // of switches have to come out as many words as with the channels together.
+                // Their order isn't the one MaxPoolingDerivative reads, blocked layouts are
+                // only planned for inference.
+                TensorLayout layout = input("Input")->layout();
+                unsigned int blockSize = channelBlockSize(layout);
 
-                FAIL_IF (output("SwitchX")->shape() != output("Output")->shape());
+                FAIL_IF (output("Output")->layout() != layout);
 
-                FAIL_IF (output("SwitchY")->shape() != output("Output")->shape());
+                FAIL_IF (layout != TensorLayout::CHANNEL_LAST &&
+                         (input("Input")->shape()[0] % blockSize || (blockSize * output("Output")->shape()[1]) % MAX_POOLING_SWITCHES_PER_WORD));
+            }
+            else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                FAIL_IF (input("Input")->layout() != TensorLayout::CHANNEL_LAST);
+
+                FAIL_IF (m_isSwitchWritten && (!output("Switch") || output("Switch")->shape() != maxPoolingSwitchShape(output("Output")->shape())));
             }
 
             FAIL_IF (input("Input")->shape()[0] != output("Output")->shape()[0]);
@@ -119,6 +154,8 @@ namespace FreeWill
                                                      batchSize,
                                                      channelSize,
                                                      height/2, width/2));
+
+                m_gpuBatchSize = batchSize;
             }
 
             return true;
@@ -128,8 +165,8 @@ namespace FreeWill
         {
             CHECK_GPU;
 
-            Tensor<DeviceUsed, DataType> *_input = input("Input")->template toType<DataType>();
-            Tensor<DeviceUsed, DataType> *_output = output("Output")->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_input = input(INPUT)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_output = output(OUTPUT)->template toType<DataType>();
 
             unsigned int newWidth = _output->shape()[1];
             unsigned int newHeight = _output->shape()[2];
@@ -141,57 +178,55 @@ namespace FreeWill
 
             if constexpr (DeviceUsed == DeviceType::CPU_NAIVE )
             {
-                Tensor<DeviceUsed, unsigned int> *_switchX = output("SwitchX")->template toType<unsigned int>();
-                Tensor<DeviceUsed, unsigned int> *_switchY = output("SwitchY")->template toType<unsigned int>();
+                Tensor<DeviceUsed, unsigned int> *_switch = output(SWITCH)->template toType<unsigned int>();
 
-                for (unsigned int b = 0; b < batchSize; ++b)
+                // a blocked image is channel / block images of block channels
+                if (_input->layout() != TensorLayout::CHANNEL_LAST)
                 {
-                    for(unsigned int y = 0;y< newHeight; ++y)
+                    unsigned int blockSize = channelBlockSize(_input->layout());
+
+                    batchSize *= depthSize / blockSize;
+                    depthSize = blockSize;
+                }
+
+                unsigned int wordsPerRow = maxPoolingSwitchWordsPerRow(depthSize, newWidth);
+                unsigned int grain = std::max(1u, 4096 / std::max(1u, newWidth * depthSize));
+
+                ThreadPool::getSingleton().parallelFor(0, batchSize * newHeight, grain, [&](unsigned int rowBegin, unsigned int rowEnd)
+                {
+                    for (unsigned int row = rowBegin; row < rowEnd; ++row)
                     {
-                        for(unsigned int x =0;x<newWidth; ++x)
-                        {
-                            for(unsigned int depth = 0;depth<depthSize;++depth)
-                            {
-
-                                DataType a = (*_input)[(b * oldWidth * oldHeight + y*2*oldWidth + x*2)*depthSize + depth];
-                                DataType _b = (*_input)[(b * oldWidth * oldHeight + y*2*oldWidth + x*2 + 1)*depthSize + depth];
-                                DataType c = (*_input)[(b * oldWidth * oldHeight + (y*2+1)*oldWidth + x*2)*depthSize + depth];
-                                DataType d = (*_input)[(b * oldWidth * oldHeight + (y*2+1)*oldWidth + x*2 + 1)*depthSize +depth];
-                        
-                                DataType max = a;
-                                unsigned int locationX = x*2;
-                                unsigned int locationY = y*2;
-                                if (_b > max)
-                                {
-                                    locationX = x*2+1;
-                                    locationY = y*2;
-                                    max = _b;
-                                }
-
-                                if (c > max)
-                                {
-                                    locationX =x* 2;
-                                    locationY = y*2+1;
-                                    max = c;
-                                }
-
-                                if (d > max)
-                                {
-                                    locationX = x*2+1;
-                                    locationY = y*2+1;
-                                    max = d;
-                                }
-
-                                (*_output)[(b * newWidth*newHeight + newWidth * y + x)*depthSize + depth] = max;
-                                (*_switchX)[(b* newWidth*newHeight + newWidth *y +x)*depthSize + depth] = locationX;
-                                (*_switchY)[(b* newWidth*newHeight + newWidth *y +x)*depthSize + depth] = locationY;
-                            }
-                        }
+                        unsigned int b = row / newHeight;
+                        unsigned int y = row % newHeight;
+                        const DataType *top = _input->cpuDataHandle() + (size_t) (b * oldHeight + y * 2) * oldWidth * depthSize;
+
+                        MaxPoolingKernelCPU<DataType>::pool(top, top + oldWidth * depthSize,
+                                                            _output->cpuDataHandle() + (size_t) row * newWidth * depthSize,
+                                                            _switch->cpuDataHandle() + (size_t) row * wordsPerRow,
+                                                            newWidth, depthSize);
                     }
-                }
+                });
             }
             else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
             {
+                // a smaller batch than init() saw, see Model::setBatchSize
+                if (batchSize != m_gpuBatchSize)
+                {
+                    setDescriptorBatchSize(m_inputTensorDescriptor, batchSize);
+                    setDescriptorBatchSize(m_outputTensorDescriptor, batchSize);
+                    m_gpuBatchSize = batchSize;
+                }
+
+                if (m_isSwitchWritten)
+                {
+                    Tensor<DeviceUsed, unsigned int> *_switch = output(SWITCH)->template toType<unsigned int>();
+
+                    maxPoolingSwitchCUDAKernel<DataType>(_input->gpuDataHandle(), _output->gpuDataHandle(), _switch->gpuDataHandle(),
+                                                         depthSize, newWidth, batchSize * newHeight,
+                                                         maxPoolingSwitchWordsPerRow(depthSize, newWidth));
+                    return;
+                }
+
                 DataType alpha = 1.0;
                 DataType beta = 0.0;
 
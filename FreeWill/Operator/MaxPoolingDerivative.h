@@ -2,11 +2,16 @@
 #define MAXPOOLINGDERIVATIVE_H
 
 #include "Operator.h"
+#include "MaxPooling_CPU.h"
+#include "MaxPooling_CUDA.h"
+#include "../Context/ThreadPool.h"
 #include <cudnn.h>
 
 namespace FreeWill
 {
-
+    // Routes OutputGrad to the argmax of each window. The cpu reads the window of each from the
+    // Switch the forward pass wrote; the gpu reads Input and Output through cudnn, or with
+    // neither bound the Switch of a MaxPooling told to write it (MaxPooling::writeSwitch).
     template<DeviceType DeviceUsed = DeviceType::CPU_NAIVE, typename DataType = float>
     class MaxPoolingDerivative : public Operator<DeviceUsed>
     {
@@ -20,16 +25,20 @@ namespace FreeWill
         cudnnTensorDescriptor_t m_outputDeltaGPUTensorDescriptor;
         cudnnTensorDescriptor_t m_inputGPUTensorDescriptor;
         cudnnTensorDescriptor_t m_inputDeltaGPUTensorDescriptor;
-
+        unsigned int m_gpuBatchSize;
 
     public:
+        enum InputSlot : unsigned int {OUTPUT, OUTPUT_GRAD, INPUT, SWITCH};
+        enum OutputSlot : unsigned int {INPUT_GRAD};
+
         MaxPoolingDerivative(unsigned int deviceId = 0)
-            :Operator<DeviceUsed>({"Output","OutputGrad","Input", "SwitchX", "SwitchY"},{"InputGrad"}, deviceId),
+            :Operator<DeviceUsed>({"Output","OutputGrad","Input", "Switch"},{"InputGrad"}, deviceId),
             m_poolingDescriptor(0),
             m_outputGPUTensorDescriptor(0),
             m_outputDeltaGPUTensorDescriptor(0),
             m_inputGPUTensorDescriptor(0),
-            m_inputDeltaGPUTensorDescriptor(0)
+            m_inputDeltaGPUTensorDescriptor(0),
+            m_gpuBatchSize(0)
         {
             CHECK_GPU;
 
@@ -69,15 +78,14 @@ namespace FreeWill
 
             FAIL_IF (!input("OutputGrad") || !output("InputGrad"));
 
-            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+            if (DeviceUsed == DeviceType::CPU_NAIVE || !input("Input"))
             {
-                FAIL_IF(!input("SwitchX") || !input("SwitchY"));
-                FAIL_IF (input("OutputGrad")->shape() != input("SwitchX")->shape());
-                FAIL_IF (input("OutputGrad")->shape() != input("SwitchY")->shape());
+                FAIL_IF (!input("Switch"));
+                FAIL_IF (input("Switch")->shape() != maxPoolingSwitchShape(input("OutputGrad")->shape()));
             }
-            else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            else
             {
-                FAIL_IF(!input("Output") || !input("Input"));
+                FAIL_IF(!input("Output"));
             }
 
             FAIL_IF (output("InputGrad")->shape()[0] != input("OutputGrad")->shape()[0]);
@@ -90,6 +98,11 @@ namespace FreeWill
             
             if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
             {
+                if (!input("Input"))
+                {
+                    return true;
+                }
+
                 cudnnDataType_t dataType = CUDNN_DATA_FLOAT;
                 if constexpr (std::is_same<DataType,float>::value)
                 {
@@ -142,7 +155,8 @@ namespace FreeWill
                                                      batchSize,
                                                      channelSize,
                                                      height/2, width/2));
-                         
+
+                m_gpuBatchSize = batchSize;
             }
 
             return true;
@@ -152,8 +166,8 @@ namespace FreeWill
         {
             CHECK_GPU;
 
-            Tensor<DeviceUsed, DataType> *_inputGrad = output("InputGrad")->template toType<DataType>();
-            Tensor<DeviceUsed, DataType> *_outputGrad = input("OutputGrad")->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_inputGrad = output(INPUT_GRAD)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_outputGrad = input(OUTPUT_GRAD)->template toType<DataType>();
 
 
             unsigned int outputWidth = _outputGrad->shape()[1];
@@ -163,33 +177,49 @@ namespace FreeWill
 
             if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
             {
-                Tensor<DeviceUsed, unsigned int> *_switchX = input("SwitchX")->template toType<unsigned int>();
-                Tensor<DeviceUsed, unsigned int> *_switchY = input("SwitchY")->template toType<unsigned int>();
+                Tensor<DeviceUsed, unsigned int> *_switch = input(SWITCH)->template toType<unsigned int>();
 
+                unsigned int wordsPerRow = maxPoolingSwitchWordsPerRow(depthSize, outputWidth);
+                unsigned int grain = std::max(1u, 4096 / std::max(1u, outputWidth * depthSize));
 
-                for(unsigned int b = 0;b<batchSize;++b)
+                // every input gradient is written, the windows don't overlap
+                ThreadPool::getSingleton().parallelFor(0, batchSize * outputHeight, grain, [&](unsigned int rowBegin, unsigned int rowEnd)
                 {
-                    for(unsigned int y = 0; y<outputHeight;++y)
+                    for (unsigned int row = rowBegin; row < rowEnd; ++row)
                     {
-                        for(unsigned int x = 0;x<outputWidth;++x)
-                        {
-                            for(unsigned int depth = 0;depth<depthSize;++depth)
-                            {
-                                unsigned int index = (b*outputWidth*outputHeight + y*outputWidth +x)*depthSize + depth;
-                                unsigned int inputX = (*_switchX)[index];
-                                unsigned int inputY = (*_switchY)[index];
-
-                                (*_inputGrad)[(b*outputWidth*outputHeight*4 + inputY*outputWidth*2 + inputX)*depthSize + depth] = 
-                                    (*_outputGrad)[index];
-                            }
-                        }
+                        DataType *top = _inputGrad->cpuDataHandle() + (size_t) row * 4 * outputWidth * depthSize;
+
+                        MaxPoolingKernelCPU<DataType>::unpool(_outputGrad->cpuDataHandle() + (size_t) row * outputWidth * depthSize,
+                                                              _switch->cpuDataHandle() + (size_t) row * wordsPerRow,
+                                                              top, top + 2 * outputWidth * depthSize,
+                                                              outputWidth, depthSize);
                     }
-                }
+                });
             }
             else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
             {
-                Tensor<DeviceUsed, DataType> *_input = input("Input")->template toType<DataType>();
-                Tensor<DeviceUsed, DataType> *_output = input("Output")->template toType<DataType>();
+                if (!input(INPUT))
+                {
+                    Tensor<DeviceUsed, unsigned int> *_switch = input(SWITCH)->template toType<unsigned int>();
+
+                    maxPoolingUnpoolCUDAKernel<DataType>(_outputGrad->gpuDataHandle(), _switch->gpuDataHandle(), _inputGrad->gpuDataHandle(),
+                                                         depthSize, outputWidth, batchSize * outputHeight,
+                                                         maxPoolingSwitchWordsPerRow(depthSize, outputWidth));
+                    return;
+                }
+
+                // a smaller batch than init() saw, see Model::setBatchSize
+                if (batchSize != m_gpuBatchSize)
+                {
+                    setDescriptorBatchSize(m_inputGPUTensorDescriptor, batchSize);
+                    setDescriptorBatchSize(m_outputGPUTensorDescriptor, batchSize);
+                    setDescriptorBatchSize(m_inputDeltaGPUTensorDescriptor, batchSize);
+                    setDescriptorBatchSize(m_outputDeltaGPUTensorDescriptor, batchSize);
+                    m_gpuBatchSize = batchSize;
+                }
+
+                Tensor<DeviceUsed, DataType> *_input = input(INPUT)->template toType<DataType>();
+                Tensor<DeviceUsed, DataType> *_output = input(OUTPUT)->template toType<DataType>();
 
                 DataType alpha = 1.0;
                 DataType beta = 0.0;
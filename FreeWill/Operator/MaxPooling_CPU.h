@@ -0,0 +1,164 @@
+#ifndef MAXPOOLING_CPU_H
+#define MAXPOOLING_CPU_H
+
+#include <cstdint>
+#include <cstring>
+
+#include "../Tensor/Shape.h"
+
+namespace FreeWill
+{
+    // The argmax of a 2x2 window is kept as its window-local index, dy * 2 + dx, in 2 bits.
+    // Sixteen of them share a uint32 switch word, every output row (all the channels of one
+    // y) starts a new word so rows can be pooled and unpooled independently.
+    static const unsigned int MAX_POOLING_SWITCHES_PER_WORD = 16;
+
+    inline unsigned int maxPoolingSwitchWordsPerRow(unsigned int channelCount, unsigned int width)
+    {
+        return (channelCount * width + MAX_POOLING_SWITCHES_PER_WORD - 1) / MAX_POOLING_SWITCHES_PER_WORD;
+    }
+
+    // the shape of the Switch tensor for a pooled output of {channels, width, height} and
+    // optionally batch: {words per row * height} and batch
+    inline Shape maxPoolingSwitchShape(const Shape &outputShape)
+    {
+        unsigned int wordCount = maxPoolingSwitchWordsPerRow(outputShape[0], outputShape[1]) * outputShape[2];
+
+        if (outputShape.dimension() > 3)
+        {
+            return Shape({wordCount, outputShape[3]});
+        }
+
+        return Shape({wordCount});
+    }
+
+    // The pool/unpool pair over one output row, vectorized across the channels: the four
+    // inputs of a window are contiguous runs of channelCount values in the channel-innermost
+    // layout. Ties go to the first input in window order, as the scalar code did.
+    template<typename DataType>
+    class MaxPoolingKernelCPU
+    {
+    public:
+#if defined(__AVX512F__)
+        static const unsigned int VECTOR_BYTES = 64;
+#elif defined(__AVX__)
+        static const unsigned int VECTOR_BYTES = 32;
+#else
+        static const unsigned int VECTOR_BYTES = 16;
+#endif
+        static const unsigned int LANES = VECTOR_BYTES / sizeof(DataType);
+
+        typedef DataType Vector __attribute__((vector_size(VECTOR_BYTES)));
+        typedef DataType UnalignedVector __attribute__((vector_size(VECTOR_BYTES), aligned(sizeof(DataType))));
+        typedef decltype(Vector{} > Vector{}) MaskVector;
+
+    private:
+        static void setSwitch(uint32_t *switches, unsigned int index, uint32_t windowIndex)
+        {
+            switches[index / MAX_POOLING_SWITCHES_PER_WORD] |= windowIndex << ((index % MAX_POOLING_SWITCHES_PER_WORD) * 2);
+        }
+
+        static uint32_t getSwitch(const uint32_t *switches, unsigned int index)
+        {
+            return (switches[index / MAX_POOLING_SWITCHES_PER_WORD] >> ((index % MAX_POOLING_SWITCHES_PER_WORD) * 2)) & 3;
+        }
+
+    public:
+        // top and bottom are the two input rows of oldWidth * channelCount values
+        static void pool(const DataType *top, const DataType *bottom, DataType *output, uint32_t *switches,
+                         unsigned int newWidth, unsigned int channelCount)
+        {
+            std::memset(switches, 0, maxPoolingSwitchWordsPerRow(channelCount, newWidth) * sizeof(uint32_t));
+
+            for (unsigned int x = 0; x < newWidth; ++x)
+            {
+                const DataType *window[4] = {top + x * 2 * channelCount, top + (x * 2 + 1) * channelCount,
+                                             bottom + x * 2 * channelCount, bottom + (x * 2 + 1) * channelCount};
+                DataType *out = output + x * channelCount;
+                unsigned int switchBase = x * channelCount;
+                unsigned int c = 0;
+
+                for (; c + LANES <= channelCount; c += LANES)
+                {
+                    Vector max = *(const UnalignedVector *) (window[0] + c);
+                    MaskVector windowIndex = {};
+
+                    for (unsigned int w = 1; w < 4; ++w)
+                    {
+                        Vector value = *(const UnalignedVector *) (window[w] + c);
+                        MaskVector isGreater = value > max;
+                        max = isGreater ? value : max;
+                        windowIndex = isGreater ? (MaskVector{} + w) : windowIndex;
+                    }
+
+                    *(UnalignedVector *) (out + c) = max;
+
+                    for (unsigned int l = 0; l < LANES; ++l)
+                    {
+                        setSwitch(switches, switchBase + c + l, (uint32_t) windowIndex[l]);
+                    }
+                }
+
+                for (; c < channelCount; ++c)
+                {
+                    DataType max = window[0][c];
+                    uint32_t windowIndex = 0;
+
+                    for (unsigned int w = 1; w < 4; ++w)
+                    {
+                        if (window[w][c] > max)
+                        {
+                            max = window[w][c];
+                            windowIndex = w;
+                        }
+                    }
+
+                    out[c] = max;
+                    setSwitch(switches, switchBase + c, windowIndex);
+                }
+            }
+        }
+
+        // writes the whole two input rows, zero except at the argmax of each window
+        static void unpool(const DataType *outputGrad, const uint32_t *switches, DataType *top, DataType *bottom,
+                           unsigned int newWidth, unsigned int channelCount)
+        {
+            for (unsigned int x = 0; x < newWidth; ++x)
+            {
+                DataType *window[4] = {top + x * 2 * channelCount, top + (x * 2 + 1) * channelCount,
+                                       bottom + x * 2 * channelCount, bottom + (x * 2 + 1) * channelCount};
+                const DataType *grad = outputGrad + x * channelCount;
+                unsigned int switchBase = x * channelCount;
+                unsigned int c = 0;
+
+                for (; c + LANES <= channelCount; c += LANES)
+                {
+                    Vector value = *(const UnalignedVector *) (grad + c);
+                    MaskVector windowIndex;
+
+                    for (unsigned int l = 0; l < LANES; ++l)
+                    {
+                        windowIndex[l] = getSwitch(switches, switchBase + c + l);
+                    }
+
+                    for (unsigned int w = 0; w < 4; ++w)
+                    {
+                        *(UnalignedVector *) (window[w] + c) = windowIndex == (MaskVector{} + w) ? value : Vector{};
+                    }
+                }
+
+                for (; c < channelCount; ++c)
+                {
+                    uint32_t windowIndex = getSwitch(switches, switchBase + c);
+
+                    for (unsigned int w = 0; w < 4; ++w)
+                    {
+                        window[w][c] = windowIndex == w ? grad[c] : (DataType) 0;
+                    }
+                }
+            }
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,128 @@
+#include "MaxPooling_CUDA.h"
+#include "../DeviceSelection.h"
+#include "../Context/ComputeStream.h"
+#include <cuda_runtime.h>
+
+static const unsigned int SWITCHES_PER_WORD = 16;
+
+// Row r of the output is y = r % height of item r / height, its two input rows are the rows
+// 2r and 2r + 1 of the input. Element i of a row is x = i / channelCount, c = i % channelCount.
+template <typename DataType>
+__global__ void maxPoolingSwitch(const DataType *input, DataType *output, uint32_t *switches,
+                                 unsigned int channelCount, unsigned int newWidth, unsigned int rowCount,
+                                 unsigned int wordsPerRow)
+{
+    unsigned int word = blockIdx.x * blockDim.x + threadIdx.x;
+
+    if (word >= wordsPerRow * rowCount)
+    {
+        return;
+    }
+
+    unsigned int row = word / wordsPerRow;
+    unsigned int rowSize = newWidth * channelCount;
+    unsigned int first = (word % wordsPerRow) * SWITCHES_PER_WORD;
+    unsigned int last = min(first + SWITCHES_PER_WORD, rowSize);
+
+    const DataType *top = input + (size_t) row * 4 * rowSize;
+    const DataType *bottom = top + 2 * rowSize;
+    uint32_t bits = 0;
+
+    for (unsigned int i = first; i < last; ++i)
+    {
+        unsigned int x = i / channelCount;
+        unsigned int c = i % channelCount;
+        size_t left = (size_t) x * 2 * channelCount + c;
+        DataType window[4] = {top[left], top[left + channelCount], bottom[left], bottom[left + channelCount]};
+
+        // ties go to the first in window order, as on the cpu
+        DataType max = window[0];
+        uint32_t windowIndex = 0;
+
+        for (unsigned int w = 1; w < 4; ++w)
+        {
+            if (window[w] > max)
+            {
+                max = window[w];
+                windowIndex = w;
+            }
+        }
+
+        output[(size_t) row * rowSize + i] = max;
+        bits |= windowIndex << ((i - first) * 2);
+    }
+
+    switches[word] = bits;
+}
+
+template <typename DataType>
+__global__ void maxPoolingUnpool(const DataType *outputGrad, const uint32_t *switches, DataType *inputGrad,
+                                 unsigned int channelCount, unsigned int newWidth, unsigned int rowCount,
+                                 unsigned int wordsPerRow)
+{
+    unsigned int rowSize = newWidth * channelCount;
+    unsigned int element = blockIdx.x * blockDim.x + threadIdx.x;
+
+    if (element >= rowSize * rowCount)
+    {
+        return;
+    }
+
+    unsigned int row = element / rowSize;
+    unsigned int i = element % rowSize;
+    unsigned int x = i / channelCount;
+    unsigned int c = i % channelCount;
+
+    uint32_t windowIndex = (switches[(size_t) row * wordsPerRow + i / SWITCHES_PER_WORD] >> ((i % SWITCHES_PER_WORD) * 2)) & 3;
+    DataType grad = outputGrad[element];
+
+    DataType *top = inputGrad + (size_t) row * 4 * rowSize;
+    DataType *bottom = top + 2 * rowSize;
+    size_t left = (size_t) x * 2 * channelCount + c;
+
+    top[left] = windowIndex == 0 ? grad : (DataType) 0;
+    top[left + channelCount] = windowIndex == 1 ? grad : (DataType) 0;
+    bottom[left] = windowIndex == 2 ? grad : (DataType) 0;
+    bottom[left + channelCount] = windowIndex == 3 ? grad : (DataType) 0;
+}
+
+template <typename DataType>
+__host__ void maxPoolingSwitchCUDAKernel(const DataType *input, DataType *output, uint32_t *switches,
+                                         unsigned int channelCount, unsigned int newWidth, unsigned int rowCount,
+                                         unsigned int wordsPerRow)
+{
+    int blockSize = 256;
+    int gridSize = (wordsPerRow * rowCount + blockSize - 1) / blockSize;
+
+    if (gridSize == 0)
+    {
+        return;
+    }
+
+    maxPoolingSwitch<DataType><<<gridSize, blockSize, 0, FreeWill::computeStream()>>>(input, output, switches, channelCount, newWidth,
+                                                                                     rowCount, wordsPerRow);
+    CHECK_CUDA_ERROR
+}
+
+template <typename DataType>
+__host__ void maxPoolingUnpoolCUDAKernel(const DataType *outputGrad, const uint32_t *switches, DataType *inputGrad,
+                                         unsigned int channelCount, unsigned int newWidth, unsigned int rowCount,
+                                         unsigned int wordsPerRow)
+{
+    int blockSize = 256;
+    int gridSize = (newWidth * channelCount * rowCount + blockSize - 1) / blockSize;
+
+    if (gridSize == 0)
+    {
+        return;
+    }
+
+    maxPoolingUnpool<DataType><<<gridSize, blockSize, 0, FreeWill::computeStream()>>>(outputGrad, switches, inputGrad, channelCount, newWidth,
+                                                                                     rowCount, wordsPerRow);
+    CHECK_CUDA_ERROR
+}
+
+template __host__ void maxPoolingSwitchCUDAKernel(const float *input, float *output, uint32_t *switches, unsigned int channelCount, unsigned int newWidth, unsigned int rowCount, unsigned int wordsPerRow);
+template __host__ void maxPoolingSwitchCUDAKernel(const double *input, double *output, uint32_t *switches, unsigned int channelCount, unsigned int newWidth, unsigned int rowCount, unsigned int wordsPerRow);
+template __host__ void maxPoolingUnpoolCUDAKernel(const float *outputGrad, const uint32_t *switches, float *inputGrad, unsigned int channelCount, unsigned int newWidth, unsigned int rowCount, unsigned int wordsPerRow);
+template __host__ void maxPoolingUnpoolCUDAKernel(const double *outputGrad, const uint32_t *switches, double *inputGrad, unsigned int channelCount, unsigned int newWidth, unsigned int rowCount, unsigned int wordsPerRow);
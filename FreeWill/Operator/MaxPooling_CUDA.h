@@ -0,0 +1,24 @@
+#ifndef MAXPOOLING_CUDA_H
+#define MAXPOOLING_CUDA_H
+
+#include <cuda_runtime.h>
+#include <stdint.h>
+
+// shared with the cuda kernels, keep it c++11
+
+// The 2x2 max pooling of channel last images with the switches of MaxPooling_CPU.h, for a
+// derivative that reads only the switches. One thread per switch word, wordsPerRow of them
+// per output row (maxPoolingSwitchWordsPerRow).
+template <typename DataType = float>
+__host__ void maxPoolingSwitchCUDAKernel(const DataType *input, DataType *output, uint32_t *switches,
+                                         unsigned int channelCount, unsigned int newWidth, unsigned int rowCount,
+                                         unsigned int wordsPerRow);
+
+// writes the whole input gradient, zero except at the argmax of each window. One thread per
+// output element.
+template <typename DataType = float>
+__host__ void maxPoolingUnpoolCUDAKernel(const DataType *outputGrad, const uint32_t *switches, DataType *inputGrad,
+                                         unsigned int channelCount, unsigned int newWidth, unsigned int rowCount,
+                                         unsigned int wordsPerRow);
+
+#endif
@@ -0,0 +1,211 @@
+#ifndef METRIC_H
+#define METRIC_H
+
+#include "Operator.h"
+#include "Metric_CUDA.h"
+#include "../Context/ComputeStream.h"
+
+namespace FreeWill
+{
+    // what a Metric accumulated since its last reset
+    struct MetricValues
+    {
+        double m_costSum = 0.0;
+        double m_hitCount = 0.0;
+        double m_sampleCount = 0.0;
+
+        double meanCost() const
+        {
+            return m_sampleCount > 0.0 ? m_costSum / m_sampleCount : 0.0;
+        }
+
+        // the top-1 accuracy, when Output and Label were bound
+        double accuracy() const
+        {
+            return m_sampleCount > 0.0 ? m_hitCount / m_sampleCount : 0.0;
+        }
+    };
+
+    // Adds the Cost of a batch ({1, batch}) and the top-1 hits of its Output ({classes, batch})
+    // against Label ({1, batch}) to the Accumulator, a double tensor of {3}: the summed cost,
+    // the hits and the samples. Either Cost or Output and Label may be left unbound.
+    //
+    // On the gpu the accumulator stays on the device, so evaluate() never waits for it.
+    // fetch() queues a copy to the host mirror behind the compute stream, isFetched() polls it
+    // and fetched() waits for it only if it is still running: a training loop reads its metrics
+    // every few steps without stalling the ones in between.
+    template<DeviceType DeviceUsed = DeviceType::CPU_NAIVE, typename DataType = float>
+    class Metric : public Operator<DeviceUsed>
+    {
+    protected:
+        using Operator<DeviceUsed>::input;
+        using Operator<DeviceUsed>::output;
+        using Operator<DeviceUsed>::m_deviceId;
+        cudaEvent_t m_fetchEvent;
+
+    public:
+        enum InputSlot : unsigned int {COST, OUTPUT, LABEL};
+        enum OutputSlot : unsigned int {ACCUMULATOR};
+
+        Metric(unsigned int deviceId = 0)
+            :Operator<DeviceUsed>({"Cost", "Output", "Label"}, {"Accumulator"}, deviceId),
+            m_fetchEvent(0)
+        {
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                RUN_CUDA(cudaEventCreateWithFlags(&m_fetchEvent, cudaEventDisableTiming));
+            }
+        }
+
+        virtual ~Metric() override
+        {
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                RUN_CUDA(cudaEventDestroy(m_fetchEvent));
+                m_fetchEvent = 0;
+            }
+        }
+
+        virtual bool init() override
+        {
+            CHECK_GPU;
+
+            FAIL_IF (!output("Accumulator") || output("Accumulator")->shape().size() != 3);
+
+            FAIL_IF (!input("Cost") && !input("Output"));
+
+            FAIL_IF ((input("Output") == nullptr) != (input("Label") == nullptr));
+
+            unsigned int batchSize = 0;
+
+            if (input("Cost"))
+            {
+                FAIL_IF (input("Cost")->shape().dimension() != 2 || input("Cost")->shape()[0] != 1);
+
+                batchSize = input("Cost")->shape()[1];
+            }
+
+            if (input("Output"))
+            {
+                FAIL_IF (input("Output")->shape().dimension() != 2 || input("Label")->shape().dimension() != 2);
+
+                FAIL_IF (input("Label")->shape()[0] != 1 || input("Output")->shape()[1] != input("Label")->shape()[1]);
+
+                FAIL_IF (input("Cost") && input("Output")->shape()[1] != batchSize);
+            }
+
+            return true;
+        }
+
+        virtual void evaluate() override
+        {
+            CHECK_GPU;
+
+            Tensor<DeviceUsed, DataType> *_cost = input(COST) ? input(COST)->template toType<DataType>() : nullptr;
+            Tensor<DeviceUsed, DataType> *_output = input(OUTPUT) ? input(OUTPUT)->template toType<DataType>() : nullptr;
+            Tensor<DeviceUsed, unsigned int> *_label = input(LABEL) ? input(LABEL)->template toType<unsigned int>() : nullptr;
+            Tensor<DeviceUsed, double> *_accumulator = output(ACCUMULATOR)->template toType<double>();
+
+            unsigned int batchSize = _cost ? _cost->shape()[1] : _output->shape()[1];
+            unsigned int vectorSize = _output ? _output->shape()[0] : 0;
+
+            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+            {
+                typedef typename ComputeType<DataType>::Type ComputeDataType;
+
+                double costSum = 0.0;
+                double hitCount = 0.0;
+
+                for (unsigned int b = 0; b < batchSize; ++b)
+                {
+                    if (_cost)
+                    {
+                        costSum += (double) (ComputeDataType) (*_cost)[b];
+                    }
+
+                    if (_output)
+                    {
+                        unsigned int maxIndex = 0;
+                        ComputeDataType maxValue = (*_output)[b * vectorSize];
+
+                        for (unsigned int e = 1; e < vectorSize; ++e)
+                        {
+                            if (maxValue < (ComputeDataType) (*_output)[b * vectorSize + e])
+                            {
+                                maxValue = (*_output)[b * vectorSize + e];
+                                maxIndex = e;
+                            }
+                        }
+
+                        hitCount += maxIndex == (*_label)[b] ? 1.0 : 0.0;
+                    }
+                }
+
+                (*_accumulator)[0] += costSum;
+                (*_accumulator)[1] += hitCount;
+                (*_accumulator)[2] += (double) batchSize;
+            }
+            else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                metricCUDAKernel<DataType>(_cost ? _cost->gpuDataHandle() : nullptr, _output ? _output->gpuDataHandle() : nullptr,
+                                           _label ? _label->gpuDataHandle() : nullptr, _accumulator->gpuDataHandle(), vectorSize, batchSize);
+            }
+        }
+
+        // zeroes the accumulator, behind the batches already queued on the gpu
+        void reset()
+        {
+            Tensor<DeviceUsed, double> *_accumulator = output(ACCUMULATOR)->template toType<double>();
+
+            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+            {
+                _accumulator->clear();
+            }
+            else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                metricResetCUDAKernel(_accumulator->gpuDataHandle());
+            }
+        }
+
+        // queues the copy of the accumulator to the host, a reset() right after it is fine
+        void fetch()
+        {
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                output(ACCUMULATOR)->copyFromDeviceToHostAsync(computeStream());
+                RUN_CUDA(cudaEventRecord(m_fetchEvent, computeStream()));
+            }
+        }
+
+        // whether the last fetch() has landed, fetched() won't wait
+        bool isFetched() const
+        {
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                return cudaEventQuery(m_fetchEvent) == cudaSuccess;
+            }
+
+            return true;
+        }
+
+        // the values of the last fetch(), the cpu has them as they are
+        MetricValues fetched()
+        {
+            Tensor<DeviceUsed, double> *_accumulator = output(ACCUMULATOR)->template toType<double>();
+
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                RUN_CUDA(cudaEventSynchronize(m_fetchEvent));
+            }
+
+            MetricValues values;
+            values.m_costSum = (*_accumulator)[0];
+            values.m_hitCount = (*_accumulator)[1];
+            values.m_sampleCount = (*_accumulator)[2];
+
+            return values;
+        }
+    };
+}
+
+#endif
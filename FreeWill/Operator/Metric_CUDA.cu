@@ -0,0 +1,91 @@
+#include "Metric_CUDA.h"
+#include "../DeviceSelection.h"
+#include "../Context/ComputeStream.h"
+#include <cuda_runtime.h>
+
+static const unsigned int METRIC_BLOCK_SIZE = 256;
+
+// One block: a batch is small, and a single block sums it without atomics (no double
+// atomicAdd below cc 6.0). The first largest element is the prediction.
+template <typename DataType>
+__global__ void metric(const DataType *cost, const DataType *output, const unsigned int *label, double *accumulator,
+                       unsigned int vectorSize, unsigned int batchSize)
+{
+    typedef typename FreeWill::ComputeType<DataType>::Type ComputeDataType;
+
+    __shared__ double costSums[METRIC_BLOCK_SIZE];
+    __shared__ double hitSums[METRIC_BLOCK_SIZE];
+
+    double costSum = 0.0;
+    double hitSum = 0.0;
+
+    for (unsigned int b = threadIdx.x; b < batchSize; b += blockDim.x)
+    {
+        if (cost)
+        {
+            costSum += (double) (ComputeDataType) cost[b];
+        }
+
+        if (output)
+        {
+            const DataType *item = output + b * vectorSize;
+            unsigned int maxIndex = 0;
+            ComputeDataType maxValue = item[0];
+
+            for (unsigned int e = 1; e < vectorSize; ++e)
+            {
+                if (maxValue < (ComputeDataType) item[e])
+                {
+                    maxValue = item[e];
+                    maxIndex = e;
+                }
+            }
+
+            hitSum += maxIndex == label[b] ? 1.0 : 0.0;
+        }
+    }
+
+    costSums[threadIdx.x] = costSum;
+    hitSums[threadIdx.x] = hitSum;
+    __syncthreads();
+
+    for (unsigned int stride = blockDim.x / 2; stride > 0; stride /= 2)
+    {
+        if (threadIdx.x < stride)
+        {
+            costSums[threadIdx.x] += costSums[threadIdx.x + stride];
+            hitSums[threadIdx.x] += hitSums[threadIdx.x + stride];
+        }
+
+        __syncthreads();
+    }
+
+    if (threadIdx.x == 0)
+    {
+        accumulator[0] += costSums[0];
+        accumulator[1] += hitSums[0];
+        accumulator[2] += (double) batchSize;
+    }
+}
+
+template <typename DataType>
+__host__ void metricCUDAKernel(const DataType *cost, const DataType *output, const unsigned int *label, double *accumulator,
+                               unsigned int vectorSize, unsigned int batchSize)
+{
+    metric<DataType><<<1, METRIC_BLOCK_SIZE, 0, FreeWill::computeStream()>>>(cost, output, label, accumulator, vectorSize, batchSize);
+    CHECK_CUDA_ERROR
+}
+
+__host__ void metricResetCUDAKernel(double *accumulator)
+{
+    RUN_CUDA(cudaMemsetAsync(accumulator, 0, 3 * sizeof(double), FreeWill::computeStream()));
+}
+
+template __host__ void metricCUDAKernel(const float *cost, const float *output, const unsigned int *label, double *accumulator,
+                                        unsigned int vectorSize, unsigned int batchSize);
+template __host__ void metricCUDAKernel(const double *cost, const double *output, const unsigned int *label, double *accumulator,
+                                        unsigned int vectorSize, unsigned int batchSize);
+template __host__ void metricCUDAKernel(const FreeWill::Half *cost, const FreeWill::Half *output, const unsigned int *label, double *accumulator,
+                                        unsigned int vectorSize, unsigned int batchSize);
+template __host__ void metricCUDAKernel(const FreeWill::BFloat16 *cost, const FreeWill::BFloat16 *output, const unsigned int *label, double *accumulator,
+                                        unsigned int vectorSize, unsigned int batchSize);
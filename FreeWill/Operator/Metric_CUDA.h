@@ -0,0 +1,19 @@
+#ifndef METRIC_CUDA_H
+#define METRIC_CUDA_H
+
+#include <cuda_runtime.h>
+
+#include "../Tensor/HalfPrecision.h"
+
+// shared with the cuda kernels, keep it c++11
+
+// Adds the costs of a batch to accumulator[0], its top-1 hits to accumulator[1] and its size to
+// accumulator[2], on the compute stream. cost or output and label may be null.
+template <typename DataType = float>
+__host__ void metricCUDAKernel(const DataType *cost, const DataType *output, const unsigned int *label, double *accumulator,
+                               unsigned int vectorSize, unsigned int batchSize);
+
+// zeroes the three accumulators on the compute stream
+__host__ void metricResetCUDAKernel(double *accumulator);
+
+#endif
@@ -34,6 +34,18 @@
 #endif
 namespace FreeWill
 {
+    // The operators set their own descriptors in init() for the batch the tensors were allocated
+    // with. This resizes the batch count, n, of such a 4d descriptor and keeps its layout.
+    static inline void setDescriptorBatchSize(cudnnTensorDescriptor_t descriptor, unsigned int batchSize)
+    {
+        cudnnDataType_t dataType;
+        int n = 0, c = 0, h = 0, w = 0;
+        int nStride = 0, cStride = 0, hStride = 0, wStride = 0;
+
+        RUN_CUDNN(cudnnGetTensor4dDescriptor(descriptor, &dataType, &n, &c, &h, &w, &nStride, &cStride, &hStride, &wStride));
+        RUN_CUDNN(cudnnSetTensor4dDescriptorEx(descriptor, dataType, batchSize, c, h, w, nStride, cStride, hStride, wStride));
+    }
+
     template <DeviceType DeviceUsed>
     class OperatorFactory;
 
@@ -52,8 +64,19 @@ namespace FreeWill
         SIGMOID_CROSS_ENTROPY_LOSS_DERIVATIVE,
         SOFTMAX_LOG_LOSS,
         SOFTMAX_LOG_LOSS_DERIVATIVE,
+        SOFTMAX_LOG_LOSS_WITH_DERIVATIVE,
         RESHAPE,
-        DUPLICATE
+        DUPLICATE,
+        LAYOUT_TRANSFORM,
+        DROPOUT,
+        DROPOUT_DERIVATIVE,
+        METRIC,
+        LSTM,
+        LSTM_DERIVATIVE,
+        BATCH_NORMALIZATION,
+        BATCH_NORMALIZATION_DERIVATIVE,
+        COMPRESS_ACTIVATION,
+        DECOMPRESS_ACTIVATION
     };
 
     static std::map<std::string, OperatorName> operatorNameTable {{"Activation", OperatorName::ACTIVATION},
@@ -62,14 +85,26 @@ namespace FreeWill
                 {"ConvolutionDerivative", OperatorName::CONVOLUTION_DERIVATIVE},
                 {"CrossEntropyLoss", OperatorName::CROSS_ENTROPY_LOSS},
                 {"DotProductWithBias", OperatorName::DOT_PRODUCT_WITH_BIAS},
+                {"DotProductWithBiasDerivative", OperatorName::DOT_PRODUCT_WITH_BIAS_DERIVATIVE},
                 {"ElementAdd", OperatorName::ELEMENTWISE_ADD},
                 {"MaxPooling", OperatorName::MAX_POOLING},
                 {"MaxPoolingDerivative", OperatorName::MAX_POOLING_DERIVATIVE},
                 {"SigmoidCrossEntropyLossDerivative", OperatorName::SIGMOID_CROSS_ENTROPY_LOSS_DERIVATIVE},
                 {"SoftmaxLogLoss", OperatorName::SOFTMAX_LOG_LOSS},
                 {"SoftmaxLogLossDerivative", OperatorName::SOFTMAX_LOG_LOSS_DERIVATIVE},
+                {"SoftmaxLogLossWithDerivative", OperatorName::SOFTMAX_LOG_LOSS_WITH_DERIVATIVE},
                 {"Duplicate", OperatorName::DUPLICATE},
-                {"Reshape", OperatorName::RESHAPE}};
+                {"LayoutTransform", OperatorName::LAYOUT_TRANSFORM},
+                {"Dropout", OperatorName::DROPOUT},
+                {"DropoutDerivative", OperatorName::DROPOUT_DERIVATIVE},
+                {"Reshape", OperatorName::RESHAPE},
+                {"Metric", OperatorName::METRIC},
+                {"LSTM", OperatorName::LSTM},
+                {"LSTMDerivative", OperatorName::LSTM_DERIVATIVE},
+                {"BatchNormalization", OperatorName::BATCH_NORMALIZATION},
+                {"BatchNormalizationDerivative", OperatorName::BATCH_NORMALIZATION_DERIVATIVE},
+                {"CompressActivation", OperatorName::COMPRESS_ACTIVATION},
+                {"DecompressActivation", OperatorName::DECOMPRESS_ACTIVATION}};
 
     template <DeviceType DeviceUsed = DeviceType::CPU_NAIVE>
     class Operator
@@ -81,13 +116,33 @@ namespace FreeWill
             TensorBase<DeviceUsed>* m_tensor;
         };
         
-        std::map<std::string, struct ParameterDescriptor > m_inputParameters;
-        std::map<std::string, struct ParameterDescriptor > m_outputParameters;
+        // The parameters in the order the operator lists them, the position is the slot an
+        // operator's evaluate() reads them from. Names are only looked up while binding.
+        std::vector<struct ParameterDescriptor> m_inputParameters;
+        std::vector<struct ParameterDescriptor> m_outputParameters;
 
         unsigned int m_deviceId;
 
+        static int findParameter(const std::vector<struct ParameterDescriptor> &parameters, const std::string &name)
+        {
+            for (unsigned int i = 0; i < parameters.size(); ++i)
+            {
+                if (parameters[i].m_name == name)
+                {
+                    return i;
+                }
+            }
+
+            return -1;
+        }
+
     public:
 
+        unsigned int deviceId() const
+        {
+            return m_deviceId;
+        }
+
         bool isUsingTheRightDevice()
         {
             if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
@@ -104,6 +159,9 @@ namespace FreeWill
 
         Operator(const std::initializer_list<std::string > &inputParameterList, 
                  const std::initializer_list<std::string > &outputParameterList, unsigned int deviceId = 0)
+            :m_inputParameters(),
+              m_outputParameters(),
+              m_deviceId(deviceId)
         {
             typename std::initializer_list<std::string>::iterator iterInput = inputParameterList.begin();
 
@@ -112,7 +170,7 @@ namespace FreeWill
                 struct ParameterDescriptor d;
                 d.m_name = (*iterInput);
                 d.m_tensor = nullptr;
-                m_inputParameters[(*iterInput)] = d;
+                m_inputParameters.push_back(d);
             }
 
            typename std::initializer_list<std::string>::iterator iterOutput = outputParameterList.begin(); 
@@ -122,7 +180,7 @@ namespace FreeWill
                 struct ParameterDescriptor d;
                 d.m_name = (*iterOutput);
                 d.m_tensor = nullptr;
-                m_outputParameters[(*iterOutput)] = d;
+                m_outputParameters.push_back(d);
            }
         }
         
@@ -131,30 +189,49 @@ namespace FreeWill
        
         virtual ~Operator(){};
 
+        // What init() settled on that is slow to find again, e.g. benchmarked cudnn algorithms,
+        // as one line of text, empty when there is nothing. An operator given its plan before
+        // init() takes it instead of searching (see Model::saveGraph).
+        virtual std::string plan() const
+        {
+            return std::string();
+        }
+
+        virtual void setPlan(const std::string &)
+        {
+        }
+
+        // whether evaluate() only queues device work a CUDA graph can record and replay, see
+        // Solver::m_useGraphs. An operator whose arguments change from step to step says no.
+        virtual bool isCapturable() const
+        {
+            return true;
+        }
+
         void debugOutput()
         {
             std::cerr << "================= operator debug output =========================" << std::endl;
-            typename std::map<std::string, struct ParameterDescriptor>::iterator iterInput = m_inputParameters.begin();
+            auto iterInput = m_inputParameters.begin();
 
             for (; iterInput != m_inputParameters.end(); ++iterInput)
             {
-                if (iterInput->second.m_tensor)
+                if (iterInput->m_tensor)
                 {
-                    std::cerr << "Input: " << iterInput->first;
-                    std::cerr << " Tensor: " << iterInput->second.m_tensor->name();
-                    std::cerr << " Shape: " << (iterInput->second.m_tensor->shape()) << std::endl;
+                    std::cerr << "Input: " << iterInput->m_name;
+                    std::cerr << " Tensor: " << iterInput->m_tensor->name();
+                    std::cerr << " Shape: " << (iterInput->m_tensor->shape()) << std::endl;
                 }
             }
 
-            typename std::map<std::string, struct ParameterDescriptor>::iterator iterOutput = m_outputParameters.begin();
+            auto iterOutput = m_outputParameters.begin();
 
             for (; iterOutput != m_outputParameters.end(); ++iterOutput)
             {
-                if (iterOutput->second.m_tensor)
+                if (iterOutput->m_tensor)
                 {
-                    std::cerr << "Output: " << iterOutput->first;
-                    std::cerr << " Tensor: " << iterOutput->second.m_tensor->name();
-                    std::cerr << " Shape: " << (iterOutput->second.m_tensor->shape()) << std::endl;
+                    std::cerr << "Output: " << iterOutput->m_name;
+                    std::cerr << " Tensor: " << iterOutput->m_tensor->name();
+                    std::cerr << " Shape: " << (iterOutput->m_tensor->shape()) << std::endl;
                 }
             }
 
@@ -174,9 +251,11 @@ namespace FreeWill
 
         virtual void setInputParameter(const std::string &name, TensorBase<DeviceUsed> *tensor)
         {
-           if (m_inputParameters.find(name) != m_inputParameters.end())
+           int slot = findParameter(m_inputParameters, name);
+
+           if (slot >= 0)
            {
-               m_inputParameters[name].m_tensor = tensor;
+               m_inputParameters[slot].m_tensor = tensor;
            }
            else 
            {
@@ -186,9 +265,11 @@ namespace FreeWill
 
         virtual void setOutputParameter(const std::string &name, TensorBase<DeviceUsed> *tensor)
         {
-            if (m_outputParameters.find(name) != m_outputParameters.end())
+            int slot = findParameter(m_outputParameters, name);
+
+            if (slot >= 0)
             {
-                m_outputParameters[name].m_tensor = tensor;
+                m_outputParameters[slot].m_tensor = tensor;
             }
             else
             {
@@ -198,38 +279,112 @@ namespace FreeWill
 
         virtual TensorBase<DeviceUsed> * input(const std::string &name)
         {
-            if (m_inputParameters.find(name) != m_inputParameters.end())
+            int slot = findParameter(m_inputParameters, name);
+
+            return slot >= 0 ? m_inputParameters[slot].m_tensor : nullptr;
+        }
+
+        virtual TensorBase<DeviceUsed> * output(const std::string &name)
+        {
+            int slot = findParameter(m_outputParameters, name);
+
+            return slot >= 0 ? m_outputParameters[slot].m_tensor : nullptr;
+        }
+
+        // what evaluate() uses, slot is the position of the parameter in the operator's list
+        TensorBase<DeviceUsed> *input(unsigned int slot) const
+        {
+            return m_inputParameters[slot].m_tensor;
+        }
+
+        TensorBase<DeviceUsed> *output(unsigned int slot) const
+        {
+            return m_outputParameters[slot].m_tensor;
+        }
+
+        // the bytes of all inputs and outputs given at their current shapes, each read or
+        // written once
+        double parameterSizeInByte()
+        {
+            double sizeInByte = 0.0;
+
+            for (auto iter = m_inputParameters.begin(); iter != m_inputParameters.end(); ++iter)
+            {
+                sizeInByte += iter->m_tensor ? iter->m_tensor->viewSizeInByte() : 0;
+            }
+
+            for (auto iter = m_outputParameters.begin(); iter != m_outputParameters.end(); ++iter)
             {
-                return m_inputParameters[name].m_tensor;
+                sizeInByte += iter->m_tensor ? iter->m_tensor->viewSizeInByte() : 0;
             }
 
-            return 0;
+            return sizeInByte;
         }
 
-        virtual TensorBase<DeviceUsed> * output(const std::string &name)
+        // The floating point operations of one evaluate() of an operator of type
+        // operatorName: two per multiply-add for the convolutions and the fully connected
+        // layers, one per element written for the rest.
+        double flops(OperatorName operatorName)
         {
-            if (m_outputParameters.find(name) != m_outputParameters.end())
+            auto elementCount = [](TensorBase<DeviceUsed> *tensor) -> double
+            {
+                return tensor ? (double) tensor->shape().size() : 0.0;
+            };
+
+            // the first dimension is the channels or the neurons, the multiply-adds per
+            // element of tensor are the weights over it
+            auto multiplyAdds = [&elementCount](TensorBase<DeviceUsed> *tensor, TensorBase<DeviceUsed> *weight) -> double
+            {
+                if (!tensor || !weight || tensor->shape()[0] == 0)
+                {
+                    return 0.0;
+                }
+
+                return elementCount(tensor) * elementCount(weight) / tensor->shape()[0];
+            };
+
+            switch(operatorName)
+            {
+            case OperatorName::CONVOLUTION:
+                return 2.0 * multiplyAdds(output("Output"), input("FeatureMap"));
+            case OperatorName::CONVOLUTION_DERIVATIVE:
+                // the gradients of the input and of the feature map are a convolution each
+                return 4.0 * multiplyAdds(input("OutputGrad"), input("FeatureMap"));
+            case OperatorName::DOT_PRODUCT_WITH_BIAS:
+                return 2.0 * multiplyAdds(output("Output"), input("Weight"));
+            case OperatorName::DOT_PRODUCT_WITH_BIAS_DERIVATIVE:
+                return 4.0 * multiplyAdds(input("OutputDelta"), input("Weight"));
+            case OperatorName::RESHAPE:
+            case OperatorName::DUPLICATE:
+                return 0.0;
+            default:
+                break;
+            }
+
+            double writtenCount = 0.0;
+
+            for (auto iter = m_outputParameters.begin(); iter != m_outputParameters.end(); ++iter)
             {
-                return m_outputParameters[name].m_tensor;
+                writtenCount += elementCount(iter->m_tensor);
             }
 
-            return 0;
+            return writtenCount;
         }
 
         virtual void clear()
         {
-            typename std::map<std::string, struct ParameterDescriptor>::iterator iterInput = m_inputParameters.begin();
+            auto iterInput = m_inputParameters.begin();
 
             for (; iterInput != m_inputParameters.end(); ++iterInput)
             {
-                (*iterInput).second.m_tensor = nullptr;
+                iterInput->m_tensor = nullptr;
             }
 
-            typename std::map<std::string, struct ParameterDescriptor>::iterator iterOutput = m_outputParameters.begin();
+            auto iterOutput = m_outputParameters.begin();
 
             for (; iterOutput != m_outputParameters.end(); ++iterOutput)
             {
-                (*iterOutput).second.m_tensor = nullptr;
+                iterOutput->m_tensor = nullptr;
             } 
 
         }
@@ -0,0 +1,212 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include <cuda_runtime.h>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "../Tensor/HalfPrecision.h"
+
+// shared with the cuda kernels, keep it c++11
+
+namespace FreeWill
+{
+    enum class OptimizerType : uint32_t
+    {
+        SGD,
+        MOMENTUM,
+        NESTEROV,
+        ADAM,
+        ADAMW
+    };
+
+    // The learning rate is added to the weights like the ElementwiseAdd update does, so it is
+    // negative for descent. Weight decay is added to the gradient, except for ADAMW, which
+    // applies it to the weights directly.
+    struct OptimizerParameters
+    {
+        OptimizerType m_type = OptimizerType::SGD;
+        double m_momentum = 0.9;
+        double m_beta1 = 0.9;
+        double m_beta2 = 0.999;
+        double m_epsilon = 1e-8;
+        double m_weightDecay = 0.0;
+        // with K entries the weights stack K models along their last dimension (the
+        // "ModelCount" of a dot product, the groups of a convolution), model k's equal part of
+        // every weight is updated with the learning rate times entry k
+        std::vector<double> m_modelRates;
+    };
+
+    // For 16-bit gradients: the loss gradient is multiplied by the scale so that small
+    // gradients do not flush to zero, and the optimizer divides it out again. A step with a
+    // non-finite gradient is skipped and the scale backs off; after m_growthInterval good
+    // steps in a row it grows again. The loss derivative operators (softmax log loss and
+    // sigmoid cross entropy) apply the scale, a gradient the caller writes itself has to be
+    // multiplied by Solver::lossScale().
+    struct LossScaleParameters
+    {
+        bool m_isEnabled = false;
+        double m_initialScale = 65536.0;
+        double m_growthFactor = 2.0;
+        double m_backoffFactor = 0.5;
+        unsigned int m_growthInterval = 2000;
+    };
+
+    static inline unsigned int optimizerStateCount(OptimizerType type)
+    {
+        switch (type)
+        {
+        case OptimizerType::MOMENTUM:
+        case OptimizerType::NESTEROV:
+            return 1;
+        case OptimizerType::ADAM:
+        case OptimizerType::ADAMW:
+            return 2;
+        default:
+            return 0;
+        }
+    }
+
+    // everything one step needs, with the bias corrections of the step already worked out
+    template<typename DataType>
+    struct OptimizerStepCoefficients
+    {
+        DataType m_rate;
+        DataType m_momentum;
+        DataType m_beta1;
+        DataType m_beta2;
+        DataType m_epsilon;
+        DataType m_weightDecay;
+        DataType m_biasCorrection1;
+        DataType m_biasCorrection2;
+        DataType m_gradientScale;
+    };
+
+    // step counts from 1, the gradients are multiplied by gradientScale first
+    template<typename DataType>
+    OptimizerStepCoefficients<DataType> optimizerStepCoefficients(const OptimizerParameters &parameters, double rate, unsigned int step,
+                                                                  double gradientScale = 1.0)
+    {
+        OptimizerStepCoefficients<DataType> coefficients;
+        coefficients.m_rate = rate;
+        coefficients.m_momentum = parameters.m_momentum;
+        coefficients.m_beta1 = parameters.m_beta1;
+        coefficients.m_beta2 = parameters.m_beta2;
+        coefficients.m_epsilon = parameters.m_epsilon;
+        coefficients.m_weightDecay = parameters.m_weightDecay;
+        coefficients.m_biasCorrection1 = 1.0 / (1.0 - std::pow(parameters.m_beta1, (double) step));
+        coefficients.m_biasCorrection2 = 1.0 / (1.0 - std::pow(parameters.m_beta2, (double) step));
+        coefficients.m_gradientScale = gradientScale;
+        return coefficients;
+    }
+
+    // One element of a fused step: the gradient is read once, the weight and the optimizer
+    // state are written once. For 16-bit weights, weight is the float master copy and the
+    // rounded result is also stored to storageWeight.
+    template<OptimizerType Type, typename DataType, typename StorageType>
+    __host__ __device__ inline void optimizerStepElement(const OptimizerStepCoefficients<DataType> &coefficients,
+                                                         DataType *weight, const StorageType *gradient,
+                                                         DataType *firstState, DataType *secondState,
+                                                         StorageType *storageWeight, unsigned int e)
+    {
+        DataType w = weight[e];
+        DataType g = (DataType) gradient[e];
+
+        if (coefficients.m_gradientScale != 1)
+        {
+            g = g * coefficients.m_gradientScale;
+        }
+
+        if (Type != OptimizerType::ADAMW && coefficients.m_weightDecay != 0)
+        {
+            g = g + coefficients.m_weightDecay * w;
+        }
+
+        if (Type == OptimizerType::SGD)
+        {
+            w = w + g * coefficients.m_rate;
+        }
+        else if (Type == OptimizerType::MOMENTUM || Type == OptimizerType::NESTEROV)
+        {
+            DataType velocity = coefficients.m_momentum * firstState[e] + g;
+            firstState[e] = velocity;
+
+            DataType step = (Type == OptimizerType::NESTEROV) ? (g + coefficients.m_momentum * velocity) : velocity;
+            w = w + step * coefficients.m_rate;
+        }
+        else
+        {
+            DataType mean = coefficients.m_beta1 * firstState[e] + (1 - coefficients.m_beta1) * g;
+            DataType variance = coefficients.m_beta2 * secondState[e] + (1 - coefficients.m_beta2) * g * g;
+            firstState[e] = mean;
+            secondState[e] = variance;
+
+            DataType step = (mean * coefficients.m_biasCorrection1) / (sqrt(variance * coefficients.m_biasCorrection2) + coefficients.m_epsilon);
+
+            if (Type == OptimizerType::ADAMW)
+            {
+                step = step + coefficients.m_weightDecay * w;
+            }
+
+            w = w + step * coefficients.m_rate;
+        }
+
+        weight[e] = w;
+
+        if (storageWeight)
+        {
+            storageWeight[e] = StorageType(w);
+        }
+    }
+
+    template<OptimizerType Type, typename DataType, typename StorageType>
+    void optimizerStepCPU(const OptimizerStepCoefficients<DataType> &coefficients, DataType *weight, const StorageType *gradient,
+                          DataType *firstState, DataType *secondState, StorageType *storageWeight, unsigned int size)
+    {
+        for (unsigned int e = 0; e < size; ++e)
+        {
+            optimizerStepElement<Type, DataType, StorageType>(coefficients, weight, gradient, firstState, secondState, storageWeight, e);
+        }
+    }
+
+    template<typename DataType, typename StorageType>
+    void optimizerStepCPU(OptimizerType type, const OptimizerStepCoefficients<DataType> &coefficients, DataType *weight, const StorageType *gradient,
+                          DataType *firstState, DataType *secondState, StorageType *storageWeight, unsigned int size)
+    {
+        switch (type)
+        {
+        case OptimizerType::SGD:
+            optimizerStepCPU<OptimizerType::SGD, DataType, StorageType>(coefficients, weight, gradient, firstState, secondState, storageWeight, size);
+            break;
+        case OptimizerType::MOMENTUM:
+            optimizerStepCPU<OptimizerType::MOMENTUM, DataType, StorageType>(coefficients, weight, gradient, firstState, secondState, storageWeight, size);
+            break;
+        case OptimizerType::NESTEROV:
+            optimizerStepCPU<OptimizerType::NESTEROV, DataType, StorageType>(coefficients, weight, gradient, firstState, secondState, storageWeight, size);
+            break;
+        case OptimizerType::ADAM:
+            optimizerStepCPU<OptimizerType::ADAM, DataType, StorageType>(coefficients, weight, gradient, firstState, secondState, storageWeight, size);
+            break;
+        case OptimizerType::ADAMW:
+            optimizerStepCPU<OptimizerType::ADAMW, DataType, StorageType>(coefficients, weight, gradient, firstState, secondState, storageWeight, size);
+            break;
+        }
+    }
+
+    // true when a gradient has an inf or a nan, the step is then skipped under loss scaling
+    template<typename DataType>
+    bool hasNonFiniteCPU(const DataType *gradient, unsigned int size)
+    {
+        bool hasNonFinite = false;
+
+        for (unsigned int e = 0; e < size; ++e)
+        {
+            typename ComputeType<DataType>::Type value = gradient[e];
+            hasNonFinite |= !(value - value == 0);
+        }
+
+        return hasNonFinite;
+    }
+}
+
+#endif
@@ -0,0 +1,78 @@
+#include "Optimizer_CUDA.h"
+#include "../DeviceSelection.h"
+#include "../Context/ComputeStream.h"
+#include <cuda_runtime.h>
+
+template <FreeWill::OptimizerType Type, typename DataType, typename StorageType>
+__global__ void optimizerStep(FreeWill::OptimizerStepCoefficients<DataType> coefficients, DataType *weight, const StorageType *gradient,
+                              DataType *firstState, DataType *secondState, StorageType *storageWeight, unsigned int size)
+{
+    unsigned int id = blockIdx.x*blockDim.x+threadIdx.x;
+    if (id < size)
+    {
+        FreeWill::optimizerStepElement<Type, DataType, StorageType>(coefficients, weight, gradient, firstState, secondState, storageWeight, id);
+    }
+}
+
+template <typename DataType, typename StorageType>
+__host__ void optimizerStepCUDAKernel(FreeWill::OptimizerType type, const FreeWill::OptimizerStepCoefficients<DataType> &coefficients, DataType *weight, const StorageType *gradient,
+                                      DataType *firstState, DataType *secondState, StorageType *storageWeight, unsigned int size)
+{
+    int blockSize = 256;
+    int gridSize = (size + blockSize - 1) / blockSize;
+
+    switch (type)
+    {
+    case FreeWill::OptimizerType::SGD:
+        optimizerStep<FreeWill::OptimizerType::SGD, DataType, StorageType><<<gridSize, blockSize, 0, FreeWill::computeStream()>>>(coefficients, weight, gradient, firstState, secondState, storageWeight, size);
+        break;
+    case FreeWill::OptimizerType::MOMENTUM:
+        optimizerStep<FreeWill::OptimizerType::MOMENTUM, DataType, StorageType><<<gridSize, blockSize, 0, FreeWill::computeStream()>>>(coefficients, weight, gradient, firstState, secondState, storageWeight, size);
+        break;
+    case FreeWill::OptimizerType::NESTEROV:
+        optimizerStep<FreeWill::OptimizerType::NESTEROV, DataType, StorageType><<<gridSize, blockSize, 0, FreeWill::computeStream()>>>(coefficients, weight, gradient, firstState, secondState, storageWeight, size);
+        break;
+    case FreeWill::OptimizerType::ADAM:
+        optimizerStep<FreeWill::OptimizerType::ADAM, DataType, StorageType><<<gridSize, blockSize, 0, FreeWill::computeStream()>>>(coefficients, weight, gradient, firstState, secondState, storageWeight, size);
+        break;
+    case FreeWill::OptimizerType::ADAMW:
+        optimizerStep<FreeWill::OptimizerType::ADAMW, DataType, StorageType><<<gridSize, blockSize, 0, FreeWill::computeStream()>>>(coefficients, weight, gradient, firstState, secondState, storageWeight, size);
+        break;
+    }
+    CHECK_CUDA_ERROR
+}
+
+template __host__ void optimizerStepCUDAKernel(FreeWill::OptimizerType type, const FreeWill::OptimizerStepCoefficients<float> &coefficients, float *weight, const float *gradient,
+                                               float *firstState, float *secondState, float *storageWeight, unsigned int size);
+template __host__ void optimizerStepCUDAKernel(FreeWill::OptimizerType type, const FreeWill::OptimizerStepCoefficients<double> &coefficients, double *weight, const double *gradient,
+                                               double *firstState, double *secondState, double *storageWeight, unsigned int size);
+template __host__ void optimizerStepCUDAKernel(FreeWill::OptimizerType type, const FreeWill::OptimizerStepCoefficients<float> &coefficients, float *weight, const FreeWill::Half *gradient,
+                                               float *firstState, float *secondState, FreeWill::Half *storageWeight, unsigned int size);
+template __host__ void optimizerStepCUDAKernel(FreeWill::OptimizerType type, const FreeWill::OptimizerStepCoefficients<float> &coefficients, float *weight, const FreeWill::BFloat16 *gradient,
+                                               float *firstState, float *secondState, FreeWill::BFloat16 *storageWeight, unsigned int size);
+
+
+template <typename DataType>
+__global__ void nonFiniteCheck(const DataType *gradient, unsigned int size, unsigned int *hasNonFinite)
+{
+    unsigned int id = blockIdx.x*blockDim.x+threadIdx.x;
+    if (id < size && !isfinite((typename FreeWill::ComputeType<DataType>::Type) gradient[id]))
+    {
+        *hasNonFinite = 1;
+    }
+}
+
+template <typename DataType>
+__host__ void nonFiniteCheckCUDAKernel(const DataType *gradient, unsigned int size, unsigned int *hasNonFinite)
+{
+    int blockSize = 256;
+    int gridSize = (size + blockSize - 1) / blockSize;
+
+    nonFiniteCheck<DataType><<<gridSize, blockSize, 0, FreeWill::computeStream()>>>(gradient, size, hasNonFinite);
+    CHECK_CUDA_ERROR
+}
+
+template __host__ void nonFiniteCheckCUDAKernel(const float *gradient, unsigned int size, unsigned int *hasNonFinite);
+template __host__ void nonFiniteCheckCUDAKernel(const double *gradient, unsigned int size, unsigned int *hasNonFinite);
+template __host__ void nonFiniteCheckCUDAKernel(const FreeWill::Half *gradient, unsigned int size, unsigned int *hasNonFinite);
+template __host__ void nonFiniteCheckCUDAKernel(const FreeWill::BFloat16 *gradient, unsigned int size, unsigned int *hasNonFinite);
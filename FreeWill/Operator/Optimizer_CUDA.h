@@ -0,0 +1,14 @@
+#ifndef OPTIMIZER_CUDA_H
+#define OPTIMIZER_CUDA_H
+
+#include "Optimizer.h"
+
+template <typename DataType = float, typename StorageType = DataType>
+__host__ void optimizerStepCUDAKernel(FreeWill::OptimizerType type, const FreeWill::OptimizerStepCoefficients<DataType> &coefficients, DataType *weight, const StorageType *gradient,
+                                      DataType *firstState, DataType *secondState, StorageType *storageWeight, unsigned int size);
+
+// sets *hasNonFinite to 1 when the gradient has an inf or a nan, leaves it alone otherwise
+template <typename DataType = float>
+__host__ void nonFiniteCheckCUDAKernel(const DataType *gradient, unsigned int size, unsigned int *hasNonFinite);
+
+#endif
@@ -0,0 +1,217 @@
+#ifndef PRUNEDDOTPRODUCTWITHBIAS_H
+#define PRUNEDDOTPRODUCTWITHBIAS_H
+
+#include "Operator.h"
+#include <type_traits>
+#include <vector>
+#include "../Context/Context.h"
+#include "StructuredSparsity_CPU.h"
+#include "StructuredSparsity_CUDA.h"
+#include "ActivationMode.h"
+
+namespace FreeWill
+{
+    // Forward only DotProductWithBias over a structured sparse weight: init prunes a copy of
+    // Weight to the pattern and packs what is left, 2:4 as two values and their offsets per
+    // group of four inputs, BLOCK as block rows (StructuredSparsity_CPU.h). The products then
+    // skip the pruned weights. Weight is only read by init. Float and double, float on gpu.
+    template<DeviceType DeviceUsed = DeviceType::CPU_NAIVE, typename DataType = float>
+    class PrunedDotProductWithBias : public Operator<DeviceUsed>
+    {
+    protected:
+        using Operator<DeviceUsed>::input;
+        using Operator<DeviceUsed>::output;
+        using Operator<DeviceUsed>::m_deviceId;
+
+        SparsityParameters m_parameters;
+        bool m_hasBias;
+        bool m_hasActivation;
+        ActivationMode m_activationMode;
+
+        // TWO_FOUR: {2, groupCount, outputSize}
+        Tensor<DeviceUsed, DataType> *m_values;
+        Tensor<DeviceUsed, int8_t> *m_offsets;
+        // BLOCK: the block rows, at least one block is allocated
+        Tensor<DeviceUsed, unsigned int> *m_blockRowOffsets;
+        Tensor<DeviceUsed, unsigned int> *m_blockColumns;
+
+    public:
+        enum InputSlot : unsigned int {INPUT, WEIGHT, BIAS};
+        enum OutputSlot : unsigned int {OUTPUT};
+
+        PrunedDotProductWithBias(const SparsityParameters &parameters, bool hasBias = true, unsigned int deviceId = 0)
+            :Operator<DeviceUsed>({"Input", "Weight", "Bias"}, {"Output"}, deviceId),
+            m_parameters(parameters),
+            m_hasBias(hasBias),
+            m_hasActivation(false),
+            m_activationMode(ActivationMode::SIGMOID),
+            m_values(nullptr),
+            m_offsets(nullptr),
+            m_blockRowOffsets(nullptr),
+            m_blockColumns(nullptr)
+        {
+        }
+
+        ~PrunedDotProductWithBias()
+        {
+            delete m_values;
+            delete m_offsets;
+            delete m_blockRowOffsets;
+            delete m_blockColumns;
+        }
+
+        void fuseActivation(ActivationMode activationMode)
+        {
+            m_hasActivation = true;
+            m_activationMode = activationMode;
+        }
+
+        virtual bool init() override
+        {
+            CHECK_GPU;
+
+            FAIL_IF (!input("Input") || !input("Weight") || !output("Output") || m_values);
+
+            FAIL_IF (m_parameters.m_pattern == SparsityPattern::DENSE || m_parameters.m_blockSize == 0);
+
+            constexpr bool isImplemented = std::is_same<DataType, float>::value ||
+                    (DeviceUsed == DeviceType::CPU_NAIVE && std::is_same<DataType, double>::value);
+
+            FAIL_IF (!isImplemented);
+
+            FAIL_IF (input("Input")->shape().dimension() != 2 || input("Weight")->shape().dimension() != 2 ||
+                    output("Output")->shape().dimension() != 2);
+
+            unsigned int batchSize = input("Input")->shape()[1];
+            unsigned int inputSize = input("Input")->shape()[0];
+            unsigned int outputSize = output("Output")->shape()[0];
+
+            FAIL_IF (batchSize != output("Output")->shape()[1] || batchSize == 0);
+
+            FAIL_IF (input("Weight")->shape()[0] != outputSize || input("Weight")->shape()[1] != inputSize);
+
+            FAIL_IF (m_hasBias && (!input("Bias") || input("Bias")->shape().dimension() != 1 || input("Bias")->shape()[0] != outputSize));
+
+            FAIL_IF (m_hasActivation && !isActivationImplementedCPU(m_activationMode));
+
+            Tensor<DeviceUsed, DataType> *_weight = input("Weight")->template toType<DataType>();
+
+            FAIL_IF (!_weight);
+
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                _weight->copyFromDeviceToHost();
+            }
+
+            // the weight itself stays as it is, it may be shared
+            std::vector<DataType> weight(_weight->cpuDataHandle(), _weight->cpuDataHandle() + (size_t) outputSize * inputSize);
+
+            pruneWeightCPU<DataType>(m_parameters, weight.data(), nullptr, outputSize, inputSize, 1, outputSize);
+
+            if (m_parameters.m_pattern == SparsityPattern::TWO_FOUR)
+            {
+                unsigned int groupCount = (inputSize + 3) / 4;
+
+                m_values = new Tensor<DeviceUsed, DataType>({2, groupCount, outputSize});
+                m_offsets = new Tensor<DeviceUsed, int8_t>({2, groupCount, outputSize});
+
+                FAIL_IF (!m_values->init() || !m_offsets->init());
+
+                compressTwoFourCPU(weight.data(), outputSize, inputSize, 1, outputSize, m_values->cpuDataHandle(), m_offsets->cpuDataHandle());
+            }
+            else
+            {
+                unsigned int blockSize = m_parameters.m_blockSize;
+                std::vector<unsigned int> blockRowOffsets;
+                std::vector<unsigned int> blockColumns;
+                std::vector<DataType> blockValues;
+
+                compressBlockSparseCPU(weight.data(), outputSize, inputSize, 1, outputSize, blockSize, blockRowOffsets, blockColumns, blockValues);
+
+                unsigned int blockCount = std::max((unsigned int) blockColumns.size(), 1u);
+
+                blockColumns.resize(blockCount, 0);
+                blockValues.resize((size_t) blockCount * blockSize * blockSize, (DataType) 0);
+
+                m_values = new Tensor<DeviceUsed, DataType>({blockSize * blockSize, blockCount});
+                m_blockRowOffsets = new Tensor<DeviceUsed, unsigned int>({(unsigned int) blockRowOffsets.size()});
+                m_blockColumns = new Tensor<DeviceUsed, unsigned int>({blockCount});
+
+                FAIL_IF (!m_values->init() || !m_blockRowOffsets->init() || !m_blockColumns->init());
+
+                std::copy(blockValues.begin(), blockValues.end(), m_values->cpuDataHandle());
+                std::copy(blockRowOffsets.begin(), blockRowOffsets.end(), m_blockRowOffsets->cpuDataHandle());
+                std::copy(blockColumns.begin(), blockColumns.end(), m_blockColumns->cpuDataHandle());
+            }
+
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                m_values->copyFromHostToDevice();
+
+                if (m_offsets)
+                {
+                    m_offsets->copyFromHostToDevice();
+                }
+                else
+                {
+                    m_blockRowOffsets->copyFromHostToDevice();
+                    m_blockColumns->copyFromHostToDevice();
+                }
+            }
+
+            return true;
+        }
+
+        virtual void evaluate() override
+        {
+            CHECK_GPU;
+
+            unsigned int batchSize = input(INPUT)->shape()[1];
+            unsigned int inputSize = input(INPUT)->shape()[0];
+            unsigned int outputSize = output(OUTPUT)->shape()[0];
+            unsigned int blockSize = m_parameters.m_blockSize;
+
+            Tensor<DeviceUsed, DataType> *_input = input(INPUT)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_output = output(OUTPUT)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_bias = m_hasBias ? input(BIAS)->template toType<DataType>() : nullptr;
+
+            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+            {
+                GEMMEpilogueCPU<DataType> epilogue;
+                epilogue.m_rowBias = _bias ? _bias->cpuDataHandle() : nullptr;
+                epilogue.m_hasActivation = m_hasActivation;
+                epilogue.m_activationMode = m_activationMode;
+
+                if (m_parameters.m_pattern == SparsityPattern::TWO_FOUR)
+                {
+                    twoFourDotProductCPU(m_values->cpuDataHandle(), m_offsets->cpuDataHandle(), _input->cpuDataHandle(), inputSize,
+                                         outputSize, batchSize, _output->cpuDataHandle(), epilogue);
+                }
+                else
+                {
+                    blockSparseDotProductCPU(m_blockRowOffsets->cpuDataHandle(), m_blockColumns->cpuDataHandle(), m_values->cpuDataHandle(),
+                                             blockSize, _input->cpuDataHandle(), inputSize, outputSize, batchSize,
+                                             _output->cpuDataHandle(), epilogue);
+                }
+            }
+            else if constexpr (DeviceUsed == DeviceType::GPU_CUDA && std::is_same<DataType, float>::value)
+            {
+                if (m_parameters.m_pattern == SparsityPattern::TWO_FOUR)
+                {
+                    twoFourDotProductCUDAKernel<DataType>(m_values->gpuDataHandle(), m_offsets->gpuDataHandle(), _input->gpuDataHandle(),
+                                                          inputSize, outputSize, batchSize, _bias ? _bias->gpuDataHandle() : nullptr,
+                                                          m_hasActivation, m_activationMode, _output->gpuDataHandle());
+                }
+                else
+                {
+                    blockSparseDotProductCUDAKernel<DataType>(m_blockRowOffsets->gpuDataHandle(), m_blockColumns->gpuDataHandle(),
+                                                              m_values->gpuDataHandle(), blockSize, _input->gpuDataHandle(), inputSize,
+                                                              outputSize, batchSize, _bias ? _bias->gpuDataHandle() : nullptr,
+                                                              m_hasActivation, m_activationMode, _output->gpuDataHandle());
+                }
+            }
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef QUANTIZATION_CPU_H
+#define QUANTIZATION_CPU_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "GEMM_CPU.h"
+#include "../Context/ThreadPool.h"
+
+namespace FreeWill
+{
+    // Symmetric int8: q = clamp(round(x / scale), -127, 127) with scale = range / 127. -128 is
+    // never produced, so every product of two quantized values fits in 16 bits.
+    inline float quantizationScale(float range)
+    {
+        return range > 0.0f ? range / 127.0f : 1.0f;
+    }
+
+    inline int8_t quantizeValueCPU(float value, float inverseScale)
+    {
+        float quantized = std::nearbyint(value * inverseScale);
+        return (int8_t) std::min(127.0f, std::max(-127.0f, quantized));
+    }
+
+    inline void quantizeCPU(const float *input, int8_t *output, size_t size, float inverseScale)
+    {
+        for(size_t i = 0; i < size; ++i)
+        {
+            output[i] = quantizeValueCPU(input[i], inverseScale);
+        }
+    }
+
+    // the range calibration records for a tensor
+    inline float absoluteMaximumCPU(const float *data, size_t size)
+    {
+        float maximum = 0.0f;
+        for(size_t i = 0; i < size; ++i)
+        {
+            maximum = std::max(maximum, std::abs(data[i]));
+        }
+        return maximum;
+    }
+
+    // Per output channel weights: element i of row r is weight[r * rowStride + i * elementStride].
+    // Each row gets its own scale and is written contiguously to quantized[r * paddedRowSize],
+    // zero padded.
+    inline void quantizeRowsCPU(const float *weight, unsigned int rowCount, unsigned int rowSize,
+                                size_t rowStride, size_t elementStride, unsigned int paddedRowSize,
+                                int8_t *quantized, float *rowScale)
+    {
+        for(unsigned int r = 0; r < rowCount; ++r)
+        {
+            float range = 0.0f;
+            for(unsigned int i = 0; i < rowSize; ++i)
+            {
+                range = std::max(range, std::abs(weight[r * rowStride + i * elementStride]));
+            }
+
+            rowScale[r] = quantizationScale(range);
+
+            int8_t *row = quantized + (size_t) r * paddedRowSize;
+            for(unsigned int i = 0; i < paddedRowSize; ++i)
+            {
+                row[i] = i < rowSize ? quantizeValueCPU(weight[r * rowStride + i * elementStride], 1.0f / rowScale[r]) : 0;
+            }
+        }
+    }
+
+    // Column-major C{M, N} = epilogue(rowScale[m] * A * B), A is M rows of K int8 (row m at A + m * lda),
+    // B is N columns of K int8 and the products accumulate in int32. Both operands are contiguous
+    // along k, so the inner loop vectorizes into widening multiply-adds (pmaddwd, vpdpwssd with VNNI).
+    inline void gemmInt8CPU(unsigned int M, unsigned int N, unsigned int K, const int8_t *A, unsigned int lda,
+                            const int8_t *B, unsigned int ldb, const float *rowScale, float *C, unsigned int ldc,
+                            const GEMMEpilogueCPU<float> *epilogue = nullptr)
+    {
+        auto columns = [&](unsigned int begin, unsigned int end)
+        {
+            for(unsigned int n = begin; n < end; ++n)
+            {
+                const int8_t *column = B + (size_t) n * ldb;
+                float *output = C + (size_t) n * ldc;
+
+                for(unsigned int m = 0; m < M; ++m)
+                {
+                    const int8_t *row = A + (size_t) m * lda;
+
+                    int32_t accumulator = 0;
+                    for(unsigned int k = 0; k < K; ++k)
+                    {
+                        accumulator += (int16_t) row[k] * (int16_t) column[k];
+                    }
+
+                    output[m] = accumulator * rowScale[m];
+                }
+
+                if (epilogue)
+                {
+                    epilogue->apply(output, M);
+                }
+            }
+        };
+
+        ThreadPool &threadPool = ThreadPool::getSingleton();
+
+        if (threadPool.threadCount() == 0 || (double) M * N * K < 1.0e6)
+        {
+            columns(0, N);
+            return;
+        }
+
+        threadPool.parallelFor(0, N, std::max(1u, N / (threadPool.threadCount() * 4)), columns);
+    }
+}
+
+#endif
@@ -0,0 +1,175 @@
+#include "Quantization_CUDA.h"
+#include "../DeviceSelection.h"
+#include "../Context/ComputeStream.h"
+#include <cuda_runtime.h>
+
+template <typename DataType>
+__device__ int8_t quantizeValue(DataType value, DataType inverseScale)
+{
+    DataType quantized = rint(value * inverseScale);
+    return (int8_t) (quantized > 127 ? 127 : (quantized < -127 ? -127 : quantized));
+}
+
+template <typename DataType>
+__global__ void quantizeRows(const DataType *input, int8_t *output, unsigned int rowSize, unsigned int paddedRowSize,
+                             unsigned int rowCount, DataType inverseScale)
+{
+    unsigned int id = blockIdx.x*blockDim.x+threadIdx.x;
+
+    if (id < paddedRowSize * rowCount)
+    {
+        unsigned int row = id / paddedRowSize;
+        unsigned int i = id % paddedRowSize;
+
+        output[id] = i < rowSize ? quantizeValue(input[row * rowSize + i], inverseScale) : 0;
+    }
+}
+
+template <typename DataType>
+__host__ void quantizeRowsCUDAKernel(const DataType *input, int8_t *output, unsigned int rowSize, unsigned int paddedRowSize,
+                                     unsigned int rowCount, DataType inverseScale)
+{
+    int blockSize = 256;
+    int gridSize = (paddedRowSize * rowCount + blockSize - 1) / blockSize;
+
+    quantizeRows<DataType><<<gridSize, blockSize, 0, FreeWill::computeStream()>>>(input, output, rowSize, paddedRowSize, rowCount, inverseScale);
+    CHECK_CUDA_ERROR
+}
+
+template __host__ void quantizeRowsCUDAKernel(const float *input, int8_t *output, unsigned int rowSize, unsigned int paddedRowSize,
+                                              unsigned int rowCount, float inverseScale);
+
+template <typename DataType>
+__global__ void quantizeIm2col(const DataType *input, int8_t *columns, unsigned int channelCount, unsigned int width, unsigned int height,
+                               unsigned int filterSize, unsigned int outputWidth, unsigned int outputHeight,
+                               unsigned int strideX, unsigned int strideY, unsigned int zeroPaddingX, unsigned int zeroPaddingY,
+                               unsigned int paddedPatchSize, unsigned int batchSize, DataType inverseScale)
+{
+    unsigned int id = blockIdx.x*blockDim.x+threadIdx.x;
+    unsigned int pixelCount = outputWidth * outputHeight;
+
+    if (id >= paddedPatchSize * pixelCount * batchSize)
+    {
+        return;
+    }
+
+    unsigned int i = id % paddedPatchSize;
+    unsigned int column = id / paddedPatchSize;
+
+    if (i >= filterSize * filterSize * channelCount)
+    {
+        columns[id] = 0;
+        return;
+    }
+
+    unsigned int b = column / pixelCount;
+    unsigned int pixel = column % pixelCount;
+    unsigned int c = i % channelCount;
+    unsigned int x = (i / channelCount) % filterSize;
+    unsigned int y = i / (channelCount * filterSize);
+
+    int realX = (int) ((pixel % outputWidth) * strideX) - (int) zeroPaddingX + (int) x;
+    int realY = (int) ((pixel / outputWidth) * strideY) - (int) zeroPaddingY + (int) y;
+
+    if (realX < 0 || realX >= (int) width || realY < 0 || realY >= (int) height)
+    {
+        columns[id] = 0;
+        return;
+    }
+
+    columns[id] = quantizeValue(input[(((size_t) b * height + realY) * width + realX) * channelCount + c], inverseScale);
+}
+
+template <typename DataType>
+__host__ void quantizeIm2colCUDAKernel(const DataType *input, int8_t *columns, unsigned int channelCount, unsigned int width, unsigned int height,
+                                       unsigned int filterSize, unsigned int outputWidth, unsigned int outputHeight,
+                                       unsigned int strideX, unsigned int strideY, unsigned int zeroPaddingX, unsigned int zeroPaddingY,
+                                       unsigned int paddedPatchSize, unsigned int batchSize, DataType inverseScale)
+{
+    int blockSize = 256;
+    int gridSize = (paddedPatchSize * outputWidth * outputHeight * batchSize + blockSize - 1) / blockSize;
+
+    quantizeIm2col<DataType><<<gridSize, blockSize, 0, FreeWill::computeStream()>>>(input, columns, channelCount, width, height, filterSize, outputWidth, outputHeight,
+                                                      strideX, strideY, zeroPaddingX, zeroPaddingY, paddedPatchSize, batchSize, inverseScale);
+    CHECK_CUDA_ERROR
+}
+
+template __host__ void quantizeIm2colCUDAKernel(const float *input, int8_t *columns, unsigned int channelCount, unsigned int width, unsigned int height,
+                                                unsigned int filterSize, unsigned int outputWidth, unsigned int outputHeight,
+                                                unsigned int strideX, unsigned int strideY, unsigned int zeroPaddingX, unsigned int zeroPaddingY,
+                                                unsigned int paddedPatchSize, unsigned int batchSize, float inverseScale);
+
+// four int8 products accumulated into an int32, in one instruction from sm_61 on
+__device__ int dotProduct4(int a, int b, int accumulator)
+{
+#if __CUDA_ARCH__ >= 610
+    return __dp4a(a, b, accumulator);
+#else
+    const char4 x = *((const char4 *) &a);
+    const char4 y = *((const char4 *) &b);
+    return accumulator + x.x * y.x + x.y * y.y + x.z * y.z + x.w * y.w;
+#endif
+}
+
+template <typename DataType>
+__global__ void gemmInt8(unsigned int M, unsigned int N, unsigned int K, const int8_t *A, const int8_t *B,
+                         const DataType *rowScale, const DataType *bias, bool hasActivation,
+                         FreeWill::ActivationMode activationMode, DataType *C)
+{
+    // threads along m share the column of B, the writes to C are coalesced
+    unsigned int m = blockIdx.x*blockDim.x+threadIdx.x;
+    unsigned int n = blockIdx.y*blockDim.y+threadIdx.y;
+
+    if (m >= M || n >= N)
+    {
+        return;
+    }
+
+    const int *row = (const int *) (A + (size_t) m * K);
+    const int *column = (const int *) (B + (size_t) n * K);
+
+    int accumulator = 0;
+    for (unsigned int k = 0; k < K / 4; ++k)
+    {
+        accumulator = dotProduct4(row[k], column[k], accumulator);
+    }
+
+    DataType value = accumulator * rowScale[m];
+    if (bias)
+    {
+        value += bias[m];
+    }
+
+    if (hasActivation)
+    {
+        switch (activationMode)
+        {
+        case FreeWill::ActivationMode::SIGMOID:
+            value = 1 / (1 + exp(-value));
+            break;
+        case FreeWill::ActivationMode::RELU:
+            value = value > 0 ? value : 0;
+            break;
+        default:
+            break;
+        }
+    }
+
+    C[(size_t) n * M + m] = value;
+}
+
+template <typename DataType>
+__host__ void gemmInt8CUDAKernel(unsigned int M, unsigned int N, unsigned int K, const int8_t *A, const int8_t *B,
+                                 const DataType *rowScale, const DataType *bias, bool hasActivation,
+                                 FreeWill::ActivationMode activationMode, DataType *C)
+{
+    dim3 blockSize(32, 8);
+    dim3 gridSize((M + blockSize.x - 1) / blockSize.x, (N + blockSize.y - 1) / blockSize.y);
+
+    gemmInt8<DataType><<<gridSize, blockSize, 0, FreeWill::computeStream()>>>(M, N, K, A, B, rowScale, bias, hasActivation, activationMode, C);
+    CHECK_CUDA_ERROR
+}
+
+template __host__ void gemmInt8CUDAKernel(unsigned int M, unsigned int N, unsigned int K, const int8_t *A, const int8_t *B,
+                                          const float *rowScale, const float *bias, bool hasActivation,
+                                          FreeWill::ActivationMode activationMode, float *C);
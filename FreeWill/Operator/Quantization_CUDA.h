@@ -0,0 +1,30 @@
+#ifndef QUANTIZATION_CUDA_H
+#define QUANTIZATION_CUDA_H
+
+#include <cuda_runtime.h>
+#include <stdint.h>
+#include "ActivationMode.h"
+
+// shared with the cuda kernels, keep it c++11
+
+// rowCount rows of rowSize values become rows of paddedRowSize int8, the padding is zero
+template <typename DataType = float>
+__host__ void quantizeRowsCUDAKernel(const DataType *input, int8_t *output, unsigned int rowSize, unsigned int paddedRowSize,
+                                     unsigned int rowCount, DataType inverseScale);
+
+// lowers a batch of {channel, width, height} images into one quantized patch of paddedPatchSize
+// per output pixel, like im2colCPU
+template <typename DataType = float>
+__host__ void quantizeIm2colCUDAKernel(const DataType *input, int8_t *columns, unsigned int channelCount, unsigned int width, unsigned int height,
+                                       unsigned int filterSize, unsigned int outputWidth, unsigned int outputHeight,
+                                       unsigned int strideX, unsigned int strideY, unsigned int zeroPaddingX, unsigned int zeroPaddingY,
+                                       unsigned int paddedPatchSize, unsigned int batchSize, DataType inverseScale);
+
+// column-major C{M, N} = activation(rowScale * (A * B) + bias), A is M rows and B is N columns of K int8,
+// K a multiple of 4. bias may be null.
+template <typename DataType = float>
+__host__ void gemmInt8CUDAKernel(unsigned int M, unsigned int N, unsigned int K, const int8_t *A, const int8_t *B,
+                                 const DataType *rowScale, const DataType *bias, bool hasActivation,
+                                 FreeWill::ActivationMode activationMode, DataType *C);
+
+#endif
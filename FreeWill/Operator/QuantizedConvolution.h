@@ -0,0 +1,250 @@
+#ifndef QUANTIZEDCONVOLUTION_H
+#define QUANTIZEDCONVOLUTION_H
+
+#include "Operator.h"
+#include "../Context/Context.h"
+#include "Convolution_CPU.h"
+#include "Quantization_CPU.h"
+#include "Quantization_CUDA.h"
+#include "ActivationMode.h"
+
+namespace FreeWill
+{
+    // Forward only Convolution on int8, lowered like the cpu im2col path: each filter of the float
+    // FeatureMap is quantized once in init with its own scale, the patches of Input are quantized
+    // with the scale of its calibrated range and the int32 sums are scaled back to float, with the
+    // bias and activation, in the writeback. FeatureMap is only read by init.
+    template<DeviceType DeviceUsed = DeviceType::CPU_NAIVE>
+    class QuantizedConvolution : public Operator<DeviceUsed>
+    {
+    protected:
+        using Operator<DeviceUsed>::input;
+        using Operator<DeviceUsed>::output;
+        using Operator<DeviceUsed>::m_deviceId;
+
+        float m_inputScale;
+        unsigned int m_zeroPaddingX;
+        unsigned int m_strideX;
+        unsigned int m_zeroPaddingY;
+        unsigned int m_strideY;
+        bool m_hasActivation;
+        ActivationMode m_activationMode;
+
+        // patches are padded to whole int32 words on the gpu, for the dp4a loads
+        unsigned int m_paddedPatchSize;
+        // {paddedPatchSize, filterCount}, one row per filter
+        Tensor<DeviceUsed, int8_t> *m_featureMap;
+        // the scale of each filter times the input scale
+        Tensor<DeviceUsed, float> *m_outputScale;
+        // the quantized images on the cpu, the quantized patches of the whole batch on the gpu
+        Tensor<DeviceUsed, int8_t> *m_quantizedInput;
+        std::vector<int8_t> m_cpuWorkspace;
+
+    public:
+        // inputRange is the largest magnitude of Input seen during calibration
+        enum InputSlot : unsigned int {INPUT, FEATURE_MAP, BIAS};
+        enum OutputSlot : unsigned int {OUTPUT};
+
+        QuantizedConvolution(float inputRange, unsigned int strideX = 1, unsigned int strideY = 1,
+                             unsigned int zeroPaddingX = 0, unsigned int zeroPaddingY = 0, unsigned int deviceId = 0)
+            :Operator<DeviceUsed>({"Input", "FeatureMap", "Bias"}, {"Output"}, deviceId),
+            m_inputScale(quantizationScale(inputRange)),
+            m_zeroPaddingX(zeroPaddingX),
+            m_strideX(strideX),
+            m_zeroPaddingY(zeroPaddingY),
+            m_strideY(strideY),
+            m_hasActivation(false),
+            m_activationMode(ActivationMode::SIGMOID),
+            m_paddedPatchSize(0),
+            m_featureMap(nullptr),
+            m_outputScale(nullptr),
+            m_quantizedInput(nullptr),
+            m_cpuWorkspace()
+        {
+        }
+
+        ~QuantizedConvolution()
+        {
+            delete m_featureMap;
+            delete m_outputScale;
+            delete m_quantizedInput;
+        }
+
+        void fuseActivation(ActivationMode activationMode)
+        {
+            m_hasActivation = true;
+            m_activationMode = activationMode;
+        }
+
+        ConvolutionGeometryCPU geometryCPU()
+        {
+            ConvolutionGeometryCPU geometry;
+            geometry.channelCount = input(FEATURE_MAP)->shape()[0];
+            geometry.filterCount = input(FEATURE_MAP)->shape()[3];
+            geometry.filterSize = input(FEATURE_MAP)->shape()[1];
+            geometry.width = input(INPUT)->shape()[1];
+            geometry.height = input(INPUT)->shape()[2];
+            geometry.outputWidth = output(OUTPUT)->shape()[1];
+            geometry.outputHeight = output(OUTPUT)->shape()[2];
+            geometry.strideX = m_strideX;
+            geometry.strideY = m_strideY;
+            geometry.zeroPaddingX = m_zeroPaddingX;
+            geometry.zeroPaddingY = m_zeroPaddingY;
+            return geometry;
+        }
+
+        virtual bool init() override
+        {
+            CHECK_GPU;
+
+            FAIL_IF (!input("Input") || !input("FeatureMap") || !input("Bias") || !output("Output") || m_featureMap);
+
+            FAIL_IF (input("Input")->shape().dimension() != 4 || input("FeatureMap")->shape().dimension() != 4 ||
+                    output("Output")->shape().dimension() != 4);
+
+            FAIL_IF (input("Input")->shape()[0] != input("FeatureMap")->shape()[0]);
+
+            FAIL_IF (input("FeatureMap")->shape()[1] != input("FeatureMap")->shape()[2]);
+
+            unsigned int originalWidth = input("Input")->shape()[1];
+            unsigned int originalHeight = input("Input")->shape()[2];
+            unsigned int filterSize = input("FeatureMap")->shape()[1];
+
+            FAIL_IF ((originalWidth - filterSize + 2*m_zeroPaddingX) % m_strideX != 0);
+            FAIL_IF ((originalHeight - filterSize + 2*m_zeroPaddingY) % m_strideY != 0);
+
+            FAIL_IF (output("Output")->shape()[1] != (originalWidth - filterSize + 2*m_zeroPaddingX) / m_strideX + 1 ||
+                    output("Output")->shape()[2] != (originalHeight - filterSize + 2*m_zeroPaddingY) / m_strideY + 1);
+
+            FAIL_IF (input("Bias")->shape().dimension() != 1 || input("Bias")->shape()[0] != input("FeatureMap")->shape()[3]);
+
+            FAIL_IF (input("FeatureMap")->shape()[3] != output("Output")->shape()[0]);
+
+            FAIL_IF (input("Input")->shape()[3] != output("Output")->shape()[3]);
+
+            FAIL_IF (m_hasActivation && !isActivationImplementedCPU(m_activationMode));
+
+            Tensor<DeviceUsed, float> *_featureMap = input("FeatureMap")->template toType<float>();
+
+            FAIL_IF (!_featureMap);
+
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                _featureMap->copyFromDeviceToHost();
+            }
+
+            ConvolutionGeometryCPU geometry = geometryCPU();
+            unsigned int batchSize = input("Input")->shape()[3];
+            unsigned int patchSize = geometry.patchSize();
+
+            m_paddedPatchSize = DeviceUsed == DeviceType::GPU_CUDA ? (patchSize + 3) & ~3u : patchSize;
+
+            m_featureMap = new Tensor<DeviceUsed, int8_t>({m_paddedPatchSize, geometry.filterCount});
+            m_outputScale = new Tensor<DeviceUsed, float>({geometry.filterCount});
+
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                m_quantizedInput = new Tensor<DeviceUsed, int8_t>({m_paddedPatchSize, geometry.outputPixelCount() * batchSize});
+            }
+            else
+            {
+                m_quantizedInput = new Tensor<DeviceUsed, int8_t>(input("Input")->shape());
+            }
+
+            FAIL_IF (!m_featureMap->init() || !m_outputScale->init() || !m_quantizedInput->init());
+
+            // the patch of a filter is contiguous in the feature map
+            quantizeRowsCPU(_featureMap->cpuDataHandle(), geometry.filterCount, patchSize, patchSize, 1, m_paddedPatchSize,
+                            m_featureMap->cpuDataHandle(), m_outputScale->cpuDataHandle());
+
+            for(unsigned int i = 0; i < geometry.filterCount; ++i)
+            {
+                (*m_outputScale)[i] *= m_inputScale;
+            }
+
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                m_featureMap->copyFromHostToDevice();
+                m_outputScale->copyFromHostToDevice();
+            }
+
+            return true;
+        }
+
+        virtual void evaluate() override
+        {
+            CHECK_GPU;
+
+            ConvolutionGeometryCPU geometry = geometryCPU();
+            unsigned int batchSize = input(INPUT)->shape()[3];
+            unsigned int patchSize = geometry.patchSize();
+            unsigned int pixelCount = geometry.outputPixelCount();
+
+            Tensor<DeviceUsed, float> *_input = input(INPUT)->template toType<float>();
+            Tensor<DeviceUsed, float> *_bias = input(BIAS)->template toType<float>();
+            Tensor<DeviceUsed, float> *_output = output(OUTPUT)->template toType<float>();
+
+            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+            {
+                size_t inputImageSize = (size_t) geometry.width * geometry.height * geometry.channelCount;
+                size_t outputImageSize = (size_t) pixelCount * geometry.filterCount;
+
+                quantizeCPU(_input->cpuDataHandle(), m_quantizedInput->cpuDataHandle(), inputImageSize * batchSize, 1.0f / m_inputScale);
+
+                GEMMEpilogueCPU<float> epilogue;
+                epilogue.m_rowBias = _bias->cpuDataHandle();
+                epilogue.m_hasActivation = m_hasActivation;
+                epilogue.m_activationMode = m_activationMode;
+
+                Im2colFunctionCPU<int8_t> im2col = selectIm2colCPU<int8_t>(geometry);
+
+                auto images = [&](unsigned int begin, unsigned int end, std::vector<int8_t> &columnBuffer)
+                {
+                    for(unsigned int b = begin; b < end; ++b)
+                    {
+                        const int8_t *columns = m_quantizedInput->cpuDataHandle() + b * inputImageSize;
+
+                        if (!geometry.isPointwise())
+                        {
+                            columnBuffer.resize((size_t) patchSize * pixelCount);
+                            im2col(geometry, columns, columnBuffer.data());
+                            columns = columnBuffer.data();
+                        }
+
+                        gemmInt8CPU(geometry.filterCount, pixelCount, patchSize, m_featureMap->cpuDataHandle(), patchSize,
+                                    columns, patchSize, m_outputScale->cpuDataHandle(),
+                                    _output->cpuDataHandle() + b * outputImageSize, geometry.filterCount, &epilogue);
+                    }
+                };
+
+                ThreadPool &threadPool = ThreadPool::getSingleton();
+
+                if (threadPool.threadCount() != 0 && batchSize > 1)
+                {
+                    // images are independent, each thread lowers into its own column buffer
+                    threadPool.parallelFor(0, batchSize, 1, [&](unsigned int begin, unsigned int end)
+                    {
+                        thread_local std::vector<int8_t> columnBuffer;
+                        images(begin, end, columnBuffer);
+                    });
+                    return;
+                }
+
+                images(0, batchSize, m_cpuWorkspace);
+            }
+            else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                quantizeIm2colCUDAKernel<float>(_input->gpuDataHandle(), m_quantizedInput->gpuDataHandle(), geometry.channelCount,
+                                                geometry.width, geometry.height, geometry.filterSize, geometry.outputWidth, geometry.outputHeight,
+                                                m_strideX, m_strideY, m_zeroPaddingX, m_zeroPaddingY, m_paddedPatchSize, batchSize,
+                                                1.0f / m_inputScale);
+
+                gemmInt8CUDAKernel<float>(geometry.filterCount, pixelCount * batchSize, m_paddedPatchSize, m_featureMap->gpuDataHandle(),
+                                          m_quantizedInput->gpuDataHandle(), m_outputScale->gpuDataHandle(), _bias->gpuDataHandle(),
+                                          m_hasActivation, m_activationMode, _output->gpuDataHandle());
+            }
+        }
+    };
+}
+
+#endif
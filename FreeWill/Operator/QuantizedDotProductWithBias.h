@@ -0,0 +1,162 @@
+#ifndef QUANTIZEDDOTPRODUCTWITHBIAS_H
+#define QUANTIZEDDOTPRODUCTWITHBIAS_H
+
+#include "Operator.h"
+#include "../Context/Context.h"
+#include "Quantization_CPU.h"
+#include "Quantization_CUDA.h"
+#include "ActivationMode.h"
+
+namespace FreeWill
+{
+    // Forward only DotProductWithBias on int8: the float Weight is quantized once in init with a
+    // scale per output, Input is quantized on the fly with the scale of its calibrated range and
+    // the int32 sums are scaled back to float, with the bias and activation, in the writeback.
+    // Weight is only read by init, Bias, Input and Output stay float.
+    template<DeviceType DeviceUsed = DeviceType::CPU_NAIVE>
+    class QuantizedDotProductWithBias : public Operator<DeviceUsed>
+    {
+    protected:
+        using Operator<DeviceUsed>::input;
+        using Operator<DeviceUsed>::output;
+        using Operator<DeviceUsed>::m_deviceId;
+
+        float m_inputScale;
+        bool m_hasBias;
+        bool m_hasActivation;
+        ActivationMode m_activationMode;
+
+        // rows are padded to whole int32 words on the gpu, for the dp4a loads
+        unsigned int m_paddedInputSize;
+        // {paddedInputSize, outputSize}, one row per output
+        Tensor<DeviceUsed, int8_t> *m_weight;
+        // the weight scale of each output times the input scale
+        Tensor<DeviceUsed, float> *m_outputScale;
+        Tensor<DeviceUsed, int8_t> *m_quantizedInput;
+
+    public:
+        // inputRange is the largest magnitude of Input seen during calibration
+        enum InputSlot : unsigned int {INPUT, WEIGHT, BIAS};
+        enum OutputSlot : unsigned int {OUTPUT};
+
+        QuantizedDotProductWithBias(float inputRange, bool hasBias = true, unsigned int deviceId = 0)
+            :Operator<DeviceUsed>({"Input", "Weight", "Bias"}, {"Output"}, deviceId),
+            m_inputScale(quantizationScale(inputRange)),
+            m_hasBias(hasBias),
+            m_hasActivation(false),
+            m_activationMode(ActivationMode::SIGMOID),
+            m_paddedInputSize(0),
+            m_weight(nullptr),
+            m_outputScale(nullptr),
+            m_quantizedInput(nullptr)
+        {
+        }
+
+        ~QuantizedDotProductWithBias()
+        {
+            delete m_weight;
+            delete m_outputScale;
+            delete m_quantizedInput;
+        }
+
+        void fuseActivation(ActivationMode activationMode)
+        {
+            m_hasActivation = true;
+            m_activationMode = activationMode;
+        }
+
+        virtual bool init() override
+        {
+            CHECK_GPU;
+
+            FAIL_IF (!input("Input") || !input("Weight") || !output("Output") || m_weight);
+
+            FAIL_IF (input("Input")->shape().dimension() != 2 || input("Weight")->shape().dimension() != 2 ||
+                    output("Output")->shape().dimension() != 2);
+
+            unsigned int batchSize = input("Input")->shape()[1];
+            unsigned int inputSize = input("Input")->shape()[0];
+            unsigned int outputSize = output("Output")->shape()[0];
+
+            FAIL_IF (batchSize != output("Output")->shape()[1] || batchSize == 0);
+
+            FAIL_IF (input("Weight")->shape()[0] != outputSize || input("Weight")->shape()[1] != inputSize);
+
+            FAIL_IF (m_hasBias && (!input("Bias") || input("Bias")->shape().dimension() != 1 || input("Bias")->shape()[0] != outputSize));
+
+            FAIL_IF (m_hasActivation && !isActivationImplementedCPU(m_activationMode));
+
+            Tensor<DeviceUsed, float> *_weight = input("Weight")->template toType<float>();
+
+            FAIL_IF (!_weight);
+
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                _weight->copyFromDeviceToHost();
+            }
+
+            m_paddedInputSize = DeviceUsed == DeviceType::GPU_CUDA ? (inputSize + 3) & ~3u : inputSize;
+
+            m_weight = new Tensor<DeviceUsed, int8_t>({m_paddedInputSize, outputSize});
+            m_outputScale = new Tensor<DeviceUsed, float>({outputSize});
+            m_quantizedInput = new Tensor<DeviceUsed, int8_t>({m_paddedInputSize, batchSize});
+
+            FAIL_IF (!m_weight->init() || !m_outputScale->init() || !m_quantizedInput->init());
+
+            // the column-major weight has the inputs of one output outputSize apart
+            quantizeRowsCPU(_weight->cpuDataHandle(), outputSize, inputSize, 1, outputSize, m_paddedInputSize,
+                            m_weight->cpuDataHandle(), m_outputScale->cpuDataHandle());
+
+            for(unsigned int i = 0; i < outputSize; ++i)
+            {
+                (*m_outputScale)[i] *= m_inputScale;
+            }
+
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                m_weight->copyFromHostToDevice();
+                m_outputScale->copyFromHostToDevice();
+            }
+
+            return true;
+        }
+
+        virtual void evaluate() override
+        {
+            CHECK_GPU;
+
+            unsigned int batchSize = input(INPUT)->shape()[1];
+            unsigned int inputSize = input(INPUT)->shape()[0];
+            unsigned int outputSize = output(OUTPUT)->shape()[0];
+
+            Tensor<DeviceUsed, float> *_input = input(INPUT)->template toType<float>();
+            Tensor<DeviceUsed, float> *_output = output(OUTPUT)->template toType<float>();
+            Tensor<DeviceUsed, float> *_bias = m_hasBias ? input(BIAS)->template toType<float>() : nullptr;
+
+            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+            {
+                quantizeCPU(_input->cpuDataHandle(), m_quantizedInput->cpuDataHandle(), (size_t) inputSize * batchSize, 1.0f / m_inputScale);
+
+                GEMMEpilogueCPU<float> epilogue;
+                epilogue.m_rowBias = _bias ? _bias->cpuDataHandle() : nullptr;
+                epilogue.m_hasActivation = m_hasActivation;
+                epilogue.m_activationMode = m_activationMode;
+
+                gemmInt8CPU(outputSize, batchSize, inputSize, m_weight->cpuDataHandle(), m_paddedInputSize,
+                            m_quantizedInput->cpuDataHandle(), m_paddedInputSize, m_outputScale->cpuDataHandle(),
+                            _output->cpuDataHandle(), outputSize, &epilogue);
+            }
+            else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                quantizeRowsCUDAKernel<float>(_input->gpuDataHandle(), m_quantizedInput->gpuDataHandle(), inputSize, m_paddedInputSize,
+                                              batchSize, 1.0f / m_inputScale);
+
+                gemmInt8CUDAKernel<float>(outputSize, batchSize, m_paddedInputSize, m_weight->gpuDataHandle(), m_quantizedInput->gpuDataHandle(),
+                                          m_outputScale->gpuDataHandle(), _bias ? _bias->gpuDataHandle() : nullptr,
+                                          m_hasActivation, m_activationMode, _output->gpuDataHandle());
+            }
+        }
+    };
+}
+
+#endif
@@ -18,6 +18,8 @@ namespace FreeWill
         using Operator<DeviceUsed>::m_deviceId;
         Shape m_newShape;
     public:
+        enum InputSlot : unsigned int {TENSOR};
+
         Reshape(const Shape &newShape, unsigned int deviceId = 0)
             :Operator<DeviceUsed>({"Tensor"}, {}, deviceId),
               m_newShape(newShape)
@@ -39,7 +41,7 @@ namespace FreeWill
         {
             CHECK_GPU;
 
-            Tensor<DeviceUsed, DataType> *tensor = input("Tensor")->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *tensor = input(TENSOR)->template toType<DataType>();
 
             tensor->reshape(m_newShape);
         }
@@ -2,6 +2,7 @@
 #define SIGMOIDCROSSENTROPYLOSSDERIVATIVE_H
 
 #include "Operator.h"
+#include "Elementwise_CPU.h"
 #include "CrossEntropyLoss_CUDA.h"
 
 namespace FreeWill
@@ -14,13 +15,25 @@ namespace FreeWill
         using Operator<DeviceUsed>::output;
         using Operator<DeviceUsed>::m_deviceId;
 
+        typename ComputeType<DataType>::Type m_lossScale;
+
     public:
+        enum InputSlot : unsigned int {INPUT, LABEL};
+        enum OutputSlot : unsigned int {OUTPUT};
+
         SigmoidCrossEntropyLossDerivative(unsigned int deviceId = 0)
-        :Operator<DeviceUsed>({"Input", "Label"},{"Output"}, deviceId)
+        :Operator<DeviceUsed>({"Input", "Label"},{"Output"}, deviceId),
+          m_lossScale(1)
         {
         
         }
 
+        // the gradient is multiplied by lossScale, see LossScaleParameters
+        void setLossScale(double lossScale)
+        {
+            m_lossScale = lossScale;
+        }
+
         virtual bool init() override
         {
             CHECK_GPU;
@@ -49,9 +62,9 @@ namespace FreeWill
         {
             CHECK_GPU;
 
-            Tensor<DeviceUsed, DataType> *_input = input("Input")->template toType<DataType>();
-            Tensor<DeviceUsed, DataType> *_output = output("Output")->template toType<DataType>();
-            Tensor<DeviceUsed, DataType> *_label = input("Label")->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_input = input(INPUT)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_output = output(OUTPUT)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_label = input(LABEL)->template toType<DataType>();
 
             unsigned int batchSize = _input->shape()[1];
             unsigned int vectorSize = _input->shape()[0];
@@ -61,19 +74,13 @@ namespace FreeWill
             
             if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
             {
-                for(unsigned int e = 0;e<batchSize;++e)
-                {
-                    for(unsigned int i = 0; i < vectorSize; ++i)
-                    {
-                        // DataType _inputSigmoid = 1.0 / (1.0 + exp(-(*_input)[e*vectorSize + i]));
-                   
-                        (*_output)[e * vectorSize + i] = (*_input)[e*vectorSize + i] - (*_label)[e * vectorSize + i];
-                    }
-                }
+                ElementwiseArguments<DataType> arguments = {{_input->cpuDataHandle(), _label->cpuDataHandle()}, {m_lossScale}};
+
+                elementwiseCPU<ElementwiseScaledSubtractExpression>(_output->cpuDataHandle(), arguments, vectorSize * batchSize);
             }
             else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
             {
-                sigmoidCrossEntropyLossDerivativeCUDAKernel<DataType>(_input->gpuDataHandle(), _label->gpuDataHandle(), _output->gpuDataHandle(), vectorSize * batchSize);            
+                sigmoidCrossEntropyLossDerivativeCUDAKernel<DataType>(_input->gpuDataHandle(), _label->gpuDataHandle(), _output->gpuDataHandle(), vectorSize * batchSize, m_lossScale);            
             }
         }
 
@@ -18,10 +18,17 @@ namespace FreeWill
         using Operator<DeviceUsed>::m_deviceId;
         cudnnTensorDescriptor_t m_inputGPUTensorDescriptor;
         cudnnTensorDescriptor_t m_outputGPUTensorDescriptor;
+        unsigned int m_gpuBatchSize;
 
     public:
+        enum InputSlot : unsigned int {INPUT, LABEL};
+        enum OutputSlot : unsigned int {COST, OUTPUT};
+
         SoftmaxLogLoss(unsigned int deviceId = 0)
-            : Operator<DeviceUsed>({"Input", "Label"},{"Cost","Output"}, deviceId)
+            : Operator<DeviceUsed>({"Input", "Label"},{"Cost","Output"}, deviceId),
+            m_inputGPUTensorDescriptor(0),
+            m_outputGPUTensorDescriptor(0),
+            m_gpuBatchSize(0)
         {
             CHECK_GPU;
 
@@ -76,6 +83,14 @@ namespace FreeWill
                 {
                     dataType = CUDNN_DATA_DOUBLE;
                 }
+                else if constexpr (std::is_same<DataType,Half>::value)
+                {
+                    dataType = CUDNN_DATA_HALF;
+                }
+                else if constexpr (std::is_same<DataType,BFloat16>::value)
+                {
+                    dataType = CUDNN_DATA_BFLOAT16;
+                }
 
                 unsigned int vectorSize = input("Input")->shape()[0];
                 //printf("vector size: %d, batchSize:%d\n", vectorSize, batchSize);
@@ -95,6 +110,8 @@ namespace FreeWill
                                            strideA));
                 //printf("done\n");
 
+                m_gpuBatchSize = batchSize;
+
                 /* looks like the dimA is in reverse order...
                 RUN_CUDNN(cudnnSetTensor4dDescriptorEx(m_inputGPUTensorDescriptor,dataType,
                                              4,3,2,1, 6,2,1,1));
@@ -119,21 +136,24 @@ namespace FreeWill
         {
             CHECK_GPU;
 
-            Tensor<DeviceUsed, DataType> *_input = input("Input")->template toType<DataType>();
-            Tensor<DeviceUsed, unsigned int> *_label = input("Label")->template toType<unsigned int>();
-            Tensor<DeviceUsed, DataType> *_cost = output("Cost")->template toType<DataType>();
-            Tensor<DeviceUsed, DataType> *_output = output("Output")->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_input = input(INPUT)->template toType<DataType>();
+            Tensor<DeviceUsed, unsigned int> *_label = input(LABEL)->template toType<unsigned int>();
+            Tensor<DeviceUsed, DataType> *_cost = output(COST)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_output = output(OUTPUT)->template toType<DataType>();
 
             unsigned int batchSize = _input->shape()[1];
             unsigned int vectorSize = _input->shape()[0];
 
             if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
             {
+                // 16-bit rows are reduced in float
+                typedef typename ComputeType<DataType>::Type Compute;
+
                 for(unsigned int b = 0; b < batchSize; ++b)
                 {
 
 
-                    DataType maximum = (*_input)[b * vectorSize];
+                    Compute maximum = (*_input)[b * vectorSize];
 
                     for(unsigned int i = 1;i<vectorSize;++i)
                     {
@@ -143,12 +163,13 @@ namespace FreeWill
                         }
                     }
 
-                    DataType expSum = 0;
+                    Compute expSum = 0;
+                    Compute labelValue = 0;
                     unsigned int label = (*_label)[b];
 
                     for(unsigned int i=0;i<vectorSize;++i)
                     {
-                        DataType v = (*_input)[b*vectorSize + i] - maximum;
+                        Compute v = (*_input)[b*vectorSize + i] - maximum;
 
                         v = std::exp(v);
 
@@ -156,7 +177,7 @@ namespace FreeWill
 
                         if (i == label)
                         {
-                            (*_cost)[b] = v;
+                            labelValue = v;
                         }
 
                         expSum += v;
@@ -168,17 +189,23 @@ namespace FreeWill
                         (*_output)[b*vectorSize+i] = (*_output)[b*vectorSize+i] / expSum;
                     }
 
-                    (*_cost)[b] /= expSum;
-
-                    (*_cost)[b] = -log((*_cost)[b]);
+                    (*_cost)[b] = -log(labelValue / expSum);
             
                 }
 
             }
             else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
             {
-                DataType alpha = 1;
-                DataType beta = 0;
+                // a smaller batch than init() saw, see Model::setBatchSize
+                if (batchSize != m_gpuBatchSize)
+                {
+                    setDescriptorBatchSize(m_inputGPUTensorDescriptor, batchSize);
+                    setDescriptorBatchSize(m_outputGPUTensorDescriptor, batchSize);
+                    m_gpuBatchSize = batchSize;
+                }
+
+                typename ComputeType<DataType>::Type alpha = 1;
+                typename ComputeType<DataType>::Type beta = 0;
                 RUN_CUDNN(cudnnSoftmaxForward(Context<DeviceUsed>::getSingleton().cudnnHandle(m_deviceId), CUDNN_SOFTMAX_ACCURATE,
                             CUDNN_SOFTMAX_MODE_CHANNEL, &alpha,
                             m_inputGPUTensorDescriptor,
@@ -15,9 +15,21 @@ namespace FreeWill
         using Operator<DeviceUsed>::output;
         using Operator<DeviceUsed>::m_deviceId;
 
+        typename ComputeType<DataType>::Type m_lossScale;
+
     public:
-        SoftmaxLogLossDerivative(unsigned int deviceId = 0) : Operator<DeviceUsed>({"Output", "Label"},{"InputGrad"},deviceId)
+        enum InputSlot : unsigned int {OUTPUT, LABEL};
+        enum OutputSlot : unsigned int {INPUT_GRAD};
+
+        SoftmaxLogLossDerivative(unsigned int deviceId = 0) : Operator<DeviceUsed>({"Output", "Label"},{"InputGrad"},deviceId),
+            m_lossScale(1)
+        {
+        }
+
+        // the gradient is multiplied by lossScale, see LossScaleParameters
+        void setLossScale(double lossScale)
         {
+            m_lossScale = lossScale;
         }
 
         virtual bool init() override
@@ -43,9 +55,9 @@ namespace FreeWill
         {
             CHECK_GPU;
 
-            Tensor<DeviceUsed, DataType> *_output = input("Output")->template toType<DataType>();
-            Tensor<DeviceUsed, unsigned int> *_label = input("Label")->template toType<unsigned int>();
-            Tensor<DeviceUsed, DataType> *_inputGrad = output("InputGrad")->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_output = input(OUTPUT)->template toType<DataType>();
+            Tensor<DeviceUsed, unsigned int> *_label = input(LABEL)->template toType<unsigned int>();
+            Tensor<DeviceUsed, DataType> *_inputGrad = output(INPUT_GRAD)->template toType<DataType>();
 
             unsigned int batchSize = _output->shape()[1];
             unsigned int vectorSize = _output->shape()[0];
@@ -57,15 +69,15 @@ namespace FreeWill
 
                     for(unsigned int i = 0;i<vectorSize;++i)
                     {
-                        (*_inputGrad)[b*vectorSize+ i] = (*_output)[b*vectorSize +i];
+                        (*_inputGrad)[b*vectorSize+ i] = (*_output)[b*vectorSize +i] * m_lossScale;
                     }
 
-                    (*_inputGrad)[b*vectorSize + (*_label)[b]] -= 1.0;
+                    (*_inputGrad)[b*vectorSize + (*_label)[b]] -= m_lossScale;
                 }
             }
             else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
             {
-                softmaxLogLossDerivativeCUDAKernel<DataType>(_inputGrad->gpuDataHandle(), _output->gpuDataHandle(), _label->gpuDataHandle(), vectorSize, batchSize);
+                softmaxLogLossDerivativeCUDAKernel<DataType>(_inputGrad->gpuDataHandle(), _output->gpuDataHandle(), _label->gpuDataHandle(), vectorSize, batchSize, m_lossScale);
             }
         }
     };
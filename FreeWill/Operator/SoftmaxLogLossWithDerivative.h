@@ -0,0 +1,129 @@
+#ifndef SOFTMAXLOGLOSSWITHDERIVATIVE_H
+#define SOFTMAXLOGLOSSWITHDERIVATIVE_H
+
+#include "Operator.h"
+#include "SoftmaxLogLoss_CUDA.h"
+#include <cmath>
+
+namespace FreeWill
+{
+    // SoftmaxLogLoss and SoftmaxLogLossDerivative in one pass per sample: the softmax, the cost
+    // and the input gradient are written while the row is still in cache (in registers on the gpu,
+    // one warp per sample), so the output is never read back for the gradient.
+    template<DeviceType DeviceUsed = DeviceType::CPU_NAIVE, typename DataType = float>
+    class SoftmaxLogLossWithDerivative : public Operator<DeviceUsed>
+    {
+    protected:
+        using Operator<DeviceUsed>::input;
+        using Operator<DeviceUsed>::output;
+        using Operator<DeviceUsed>::m_deviceId;
+
+        typename ComputeType<DataType>::Type m_lossScale;
+
+    public:
+        enum InputSlot : unsigned int {INPUT, LABEL};
+        enum OutputSlot : unsigned int {COST, OUTPUT, INPUT_GRAD};
+
+        SoftmaxLogLossWithDerivative(unsigned int deviceId = 0)
+            : Operator<DeviceUsed>({"Input", "Label"},{"Cost", "Output", "InputGrad"}, deviceId),
+              m_lossScale(1)
+        {
+        }
+
+        // only the gradient is multiplied by lossScale, the cost is not
+        void setLossScale(double lossScale)
+        {
+            m_lossScale = lossScale;
+        }
+
+        virtual bool init() override
+        {
+            CHECK_GPU;
+
+            FAIL_IF (!input("Input") || !input("Label") || !output("Cost") || !output("Output") || !output("InputGrad"));
+
+            FAIL_IF (input("Input")->shape() != output("Output")->shape());
+
+            FAIL_IF (input("Input")->shape() != output("InputGrad")->shape());
+
+            FAIL_IF (input("Input")->shape().dimension() != 2);
+
+            FAIL_IF (input("Label")->shape().dimension() != 2 || output("Cost")->shape().dimension() != 2);
+
+            FAIL_IF (1 != input("Label")->shape()[0] || 1 != output("Cost")->shape()[0]);
+
+            unsigned int batchSize = input("Input")->shape()[1];
+
+            FAIL_IF (batchSize != input("Label")->shape()[1] || batchSize != output("Cost")->shape()[1]);
+
+            return true;
+        }
+
+        virtual void evaluate() override
+        {
+            CHECK_GPU;
+
+            Tensor<DeviceUsed, DataType> *_input = input(INPUT)->template toType<DataType>();
+            Tensor<DeviceUsed, unsigned int> *_label = input(LABEL)->template toType<unsigned int>();
+            Tensor<DeviceUsed, DataType> *_cost = output(COST)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_output = output(OUTPUT)->template toType<DataType>();
+            Tensor<DeviceUsed, DataType> *_inputGrad = output(INPUT_GRAD)->template toType<DataType>();
+
+            unsigned int batchSize = _input->shape()[1];
+            unsigned int vectorSize = _input->shape()[0];
+
+            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+            {
+                typedef typename ComputeType<DataType>::Type Compute;
+
+                const DataType *inputData = _input->cpuDataHandle();
+                const unsigned int *labelData = _label->cpuDataHandle();
+                DataType *costData = _cost->cpuDataHandle();
+                DataType *outputData = _output->cpuDataHandle();
+                DataType *inputGradData = _inputGrad->cpuDataHandle();
+
+                for(unsigned int b = 0; b < batchSize; ++b)
+                {
+                    const DataType *inputRow = inputData + b * vectorSize;
+                    DataType *outputRow = outputData + b * vectorSize;
+                    DataType *inputGradRow = inputGradData + b * vectorSize;
+
+                    Compute maximum = inputRow[0];
+                    for(unsigned int i = 1; i < vectorSize; ++i)
+                    {
+                        Compute value = inputRow[i];
+                        maximum = value > maximum ? value : maximum;
+                    }
+
+                    Compute expSum = 0;
+                    for(unsigned int i = 0; i < vectorSize; ++i)
+                    {
+                        Compute v = std::exp(inputRow[i] - maximum);
+                        outputRow[i] = v;
+                        expSum += v;
+                    }
+
+                    // same operations as the separate operators, so the results match them exactly
+                    for(unsigned int i = 0; i < vectorSize; ++i)
+                    {
+                        DataType v = outputRow[i] / expSum;
+                        outputRow[i] = v;
+                        inputGradRow[i] = v * m_lossScale;
+                    }
+
+                    unsigned int label = labelData[b];
+
+                    costData[b] = -log((Compute) outputRow[label]);
+                    inputGradRow[label] -= m_lossScale;
+                }
+            }
+            else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                softmaxLogLossWithDerivativeCUDAKernel<DataType>(_input->gpuDataHandle(), _label->gpuDataHandle(), _cost->gpuDataHandle(),
+                                                                 _output->gpuDataHandle(), _inputGrad->gpuDataHandle(), vectorSize, batchSize, m_lossScale);
+            }
+        }
+    };
+}
+
+#endif
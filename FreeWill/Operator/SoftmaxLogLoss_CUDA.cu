@@ -1,21 +1,17 @@
 #include "SoftmaxLogLoss_CUDA.h"
 #include "../DeviceSelection.h"
+#include "../Context/ComputeStream.h"
 #include <cuda_runtime.h>
 
 template <typename DataType>
 __global__ void softmaxLogLoss(DataType *output, unsigned int *label, DataType *cost, unsigned int vectorSize, unsigned int batchSize)
 {
-    int id = blockIdx.x*blockDim.x+threadIdx.x;
-    int size = vectorSize * batchSize;
-    if (id < size)
+    // only the label's element contributes, one thread per sample
+    unsigned int batchId = blockIdx.x*blockDim.x+threadIdx.x;
+    if (batchId < batchSize)
     {
-        int vectorId = id % vectorSize;
-        int batchId = id / vectorSize;
-
-        if (label[batchId] == vectorId)
-        {
-            cost[batchId] = -log(output[id]);
-        }
+        typename FreeWill::ComputeType<DataType>::Type v = output[batchId * vectorSize + label[batchId]];
+        cost[batchId] = -log(v);
     }
 }
 
@@ -23,26 +19,22 @@ __global__ void softmaxLogLoss(DataType *output, unsigned int *label, DataType *
 template <typename DataType>
 __host__ void softmaxLogLossCUDAKernel(DataType *output, unsigned int *label, DataType *cost, unsigned int vectorSize, unsigned int batchSize)
 {
-    int blockSize = 1024;
-    int size = vectorSize * batchSize;
-    int gridSize =  size / blockSize ;
-
-    if (size % blockSize != 0)
-    {
-        gridSize += 1;
-    }
+    int blockSize = 256;
+    int gridSize = (batchSize + blockSize - 1) / blockSize;
 
-//    printf("gridsize:%d,%d",gridSize, blockSize);
-    softmaxLogLoss<DataType><<<gridSize, blockSize>>>(output, label, cost, vectorSize, batchSize);
+    softmaxLogLoss<DataType><<<gridSize, blockSize, 0, FreeWill::computeStream()>>>(output, label, cost, vectorSize, batchSize);
     CHECK_CUDA_ERROR
 }
 
 template __host__ void softmaxLogLossCUDAKernel(float *output, unsigned int *label, float *cost, unsigned int vectorSize, unsigned int batchSize);
 template __host__ void softmaxLogLossCUDAKernel(double *output, unsigned int *label, double *cost, unsigned int vectorSize, unsigned int batchSize);
+template __host__ void softmaxLogLossCUDAKernel(FreeWill::Half *output, unsigned int *label, FreeWill::Half *cost, unsigned int vectorSize, unsigned int batchSize);
+template __host__ void softmaxLogLossCUDAKernel(FreeWill::BFloat16 *output, unsigned int *label, FreeWill::BFloat16 *cost, unsigned int vectorSize, unsigned int batchSize);
 
 
 template <typename DataType>
-__global__ void softmaxLogLossDerivative(DataType *inputDelta, DataType *output, unsigned int *label, unsigned int vectorSize, unsigned int batchSize)
+__global__ void softmaxLogLossDerivative(DataType *inputDelta, DataType *output, unsigned int *label, unsigned int vectorSize, unsigned int batchSize,
+                                         typename FreeWill::ComputeType<DataType>::Type lossScale)
 {
     int id = blockIdx.x*blockDim.x+threadIdx.x;
     int size = vectorSize * batchSize;
@@ -51,12 +43,14 @@ __global__ void softmaxLogLossDerivative(DataType *inputDelta, DataType *output,
         int vectorId = id % vectorSize;
         int batchId = id / vectorSize;
 
-        inputDelta[id] = output[id] + ((label[batchId] == vectorId)?-1.0:0.0);
+        typename FreeWill::ComputeType<DataType>::Type v = output[id];
+        inputDelta[id] = (v + ((label[batchId] == vectorId)?-1.0:0.0)) * lossScale;
     }
 }
 
 template <typename DataType>
-__host__ void softmaxLogLossDerivativeCUDAKernel(DataType *inputDelta, DataType *output, unsigned int *label, unsigned int vectorSize, unsigned int batchSize)
+__host__ void softmaxLogLossDerivativeCUDAKernel(DataType *inputDelta, DataType *output, unsigned int *label, unsigned int vectorSize, unsigned int batchSize,
+                                                 typename FreeWill::ComputeType<DataType>::Type lossScale)
 {
     int blockSize = 1024;
     int size = vectorSize * batchSize;
@@ -67,9 +61,114 @@ __host__ void softmaxLogLossDerivativeCUDAKernel(DataType *inputDelta, DataType
         gridSize += 1;
     }
 
-    softmaxLogLossDerivative<DataType><<<gridSize, blockSize>>>(inputDelta, output, label, vectorSize, batchSize);
+    softmaxLogLossDerivative<DataType><<<gridSize, blockSize, 0, FreeWill::computeStream()>>>(inputDelta, output, label, vectorSize, batchSize, lossScale);
+    CHECK_CUDA_ERROR
+}
+
+template __host__ void softmaxLogLossDerivativeCUDAKernel(float *inputDelta, float *output, unsigned int *label, unsigned int vectorSize, unsigned int batchSize,
+                                                          float lossScale);
+template __host__ void softmaxLogLossDerivativeCUDAKernel(double *inputDelta, double *output, unsigned int *label, unsigned int vectorSize, unsigned int batchSize,
+                                                          double lossScale);
+template __host__ void softmaxLogLossDerivativeCUDAKernel(FreeWill::Half *inputDelta, FreeWill::Half *output, unsigned int *label, unsigned int vectorSize, unsigned int batchSize,
+                                                          float lossScale);
+template __host__ void softmaxLogLossDerivativeCUDAKernel(FreeWill::BFloat16 *inputDelta, FreeWill::BFloat16 *output, unsigned int *label, unsigned int vectorSize, unsigned int batchSize,
+                                                          float lossScale);
+
+
+static const unsigned int WARP_SIZE = 32;
+static const unsigned int ROWS_PER_BLOCK = 8;
+
+template <typename DataType>
+__device__ DataType warpMaximum(DataType value)
+{
+    for (unsigned int offset = WARP_SIZE / 2; offset > 0; offset /= 2)
+    {
+        DataType other = __shfl_xor_sync(0xffffffff, value, offset);
+        value = other > value ? other : value;
+    }
+    return value;
+}
+
+template <typename DataType>
+__device__ DataType warpSum(DataType value)
+{
+    for (unsigned int offset = WARP_SIZE / 2; offset > 0; offset /= 2)
+    {
+        value += __shfl_xor_sync(0xffffffff, value, offset);
+    }
+    return value;
+}
+
+// one warp per sample, the lanes stride over the row and the reductions stay in registers,
+// in float for 16-bit data
+template <typename DataType>
+__global__ void softmaxLogLossWithDerivative(DataType *input, unsigned int *label, DataType *cost, DataType *output, DataType *inputGrad,
+                                             unsigned int vectorSize, unsigned int batchSize,
+                                             typename FreeWill::ComputeType<DataType>::Type lossScale)
+{
+    typedef typename FreeWill::ComputeType<DataType>::Type Compute;
+
+    unsigned int batchId = blockIdx.x * ROWS_PER_BLOCK + threadIdx.x / WARP_SIZE;
+    unsigned int lane = threadIdx.x % WARP_SIZE;
+
+    if (batchId >= batchSize)
+    {
+        return;
+    }
+
+    DataType *inputRow = input + batchId * vectorSize;
+    DataType *outputRow = output + batchId * vectorSize;
+    DataType *inputGradRow = inputGrad + batchId * vectorSize;
+
+    Compute maximum = inputRow[0];
+    for (unsigned int i = lane; i < vectorSize; i += WARP_SIZE)
+    {
+        Compute value = inputRow[i];
+        maximum = value > maximum ? value : maximum;
+    }
+    maximum = warpMaximum(maximum);
+
+    Compute expSum = 0;
+    for (unsigned int i = lane; i < vectorSize; i += WARP_SIZE)
+    {
+        Compute v = exp((Compute) inputRow[i] - maximum);
+        outputRow[i] = v;
+        expSum += v;
+    }
+    expSum = warpSum(expSum);
+
+    unsigned int labelId = label[batchId];
+
+    for (unsigned int i = lane; i < vectorSize; i += WARP_SIZE)
+    {
+        Compute v = (Compute) outputRow[i] / expSum;
+        outputRow[i] = v;
+        inputGradRow[i] = (v - ((i == labelId) ? 1.0 : 0.0)) * lossScale;
+
+        if (i == labelId)
+        {
+            cost[batchId] = -log(v);
+        }
+    }
+}
+
+template <typename DataType>
+__host__ void softmaxLogLossWithDerivativeCUDAKernel(DataType *input, unsigned int *label, DataType *cost, DataType *output, DataType *inputGrad,
+                                                     unsigned int vectorSize, unsigned int batchSize,
+                                                     typename FreeWill::ComputeType<DataType>::Type lossScale)
+{
+    int blockSize = WARP_SIZE * ROWS_PER_BLOCK;
+    int gridSize = (batchSize + ROWS_PER_BLOCK - 1) / ROWS_PER_BLOCK;
+
+    softmaxLogLossWithDerivative<DataType><<<gridSize, blockSize, 0, FreeWill::computeStream()>>>(input, label, cost, output, inputGrad, vectorSize, batchSize, lossScale);
     CHECK_CUDA_ERROR
 }
 
-template __host__ void softmaxLogLossDerivativeCUDAKernel(float *inputDelta, float *output, unsigned int *label, unsigned int vectorSize, unsigned int batchSize);
-template __host__ void softmaxLogLossDerivativeCUDAKernel(double *inputDelta, double *output, unsigned int *label, unsigned int vectorSize, unsigned int batchSize);
+template __host__ void softmaxLogLossWithDerivativeCUDAKernel(float *input, unsigned int *label, float *cost, float *output, float *inputGrad,
+                                                              unsigned int vectorSize, unsigned int batchSize, float lossScale);
+template __host__ void softmaxLogLossWithDerivativeCUDAKernel(double *input, unsigned int *label, double *cost, double *output, double *inputGrad,
+                                                              unsigned int vectorSize, unsigned int batchSize, double lossScale);
+template __host__ void softmaxLogLossWithDerivativeCUDAKernel(FreeWill::Half *input, unsigned int *label, FreeWill::Half *cost, FreeWill::Half *output, FreeWill::Half *inputGrad,
+                                                              unsigned int vectorSize, unsigned int batchSize, float lossScale);
+template __host__ void softmaxLogLossWithDerivativeCUDAKernel(FreeWill::BFloat16 *input, unsigned int *label, FreeWill::BFloat16 *cost, FreeWill::BFloat16 *output, FreeWill::BFloat16 *inputGrad,
+                                                              unsigned int vectorSize, unsigned int batchSize, float lossScale);
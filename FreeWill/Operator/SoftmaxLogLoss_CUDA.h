@@ -1,14 +1,21 @@
 #ifndef SOFTMAXLOGLOSS_CUDA_H
 #define SOFTMAXLOGLOSS_CUDA_H
 
+#include "../Tensor/HalfPrecision.h"
+
 //#ifdef __cplusplus
 
 template <typename DataType = float>
 __host__ void softmaxLogLossCUDAKernel(DataType *output, unsigned int *label, DataType *cost, unsigned int vectorSize, unsigned int batchSize);
 
 template <typename DataType = float>
-__host__ void softmaxLogLossDerivativeCUDAKernel(DataType *inputDelta, DataType *output, unsigned int *label, unsigned int vectorSize, unsigned int batchSize);
+__host__ void softmaxLogLossDerivativeCUDAKernel(DataType *inputDelta, DataType *output, unsigned int *label, unsigned int vectorSize, unsigned int batchSize,
+                                                 typename FreeWill::ComputeType<DataType>::Type lossScale = 1);
 
+template <typename DataType = float>
+__host__ void softmaxLogLossWithDerivativeCUDAKernel(DataType *input, unsigned int *label, DataType *cost, DataType *output, DataType *inputGrad,
+                                                     unsigned int vectorSize, unsigned int batchSize,
+                                                     typename FreeWill::ComputeType<DataType>::Type lossScale = 1);
 
 //#endif
 
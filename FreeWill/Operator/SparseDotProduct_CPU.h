@@ -0,0 +1,128 @@
+#ifndef SPARSEDOTPRODUCT_CPU_H
+#define SPARSEDOTPRODUCT_CPU_H
+
+#include <algorithm>
+
+#include "GEMM_CPU.h"
+#include "../Context/ThreadPool.h"
+
+namespace FreeWill
+{
+    // A batch of sparse input vectors in CSR: sample b has the non-zeros k in
+    // [rowOffsets[b], rowOffsets[b + 1]), with value values[k] at input index columns[k].
+    // The weight is {outputSize, inputSize} column-major, so an input index selects a
+    // contiguous column of outputSize weights and the products are gathers of whole columns.
+    // Columns past inputSize are skipped.
+
+    // below this many multiply-adds the samples run on the caller's thread
+    static const double SPARSE_DOT_PRODUCT_PARALLEL_WORK = 1.0e5;
+
+    inline void sparseDotProductForEachSampleCPU(unsigned int batchSize, unsigned int nonZeroCount, unsigned int outputSize,
+                                                 const ThreadPool::RangeFunction &function)
+    {
+        if ((double) nonZeroCount * outputSize < SPARSE_DOT_PRODUCT_PARALLEL_WORK)
+        {
+            function(0, batchSize);
+            return;
+        }
+
+        ThreadPool::getSingleton().parallelFor(0, batchSize, 1, function);
+    }
+
+    // output = weight * input, the epilogue adds the bias and the activation
+    template<typename DataType>
+    void sparseDotProductForwardCPU(const unsigned int *rowOffsets, const unsigned int *columns, const DataType *values,
+                                    const DataType *weight, unsigned int inputSize, unsigned int outputSize, unsigned int batchSize,
+                                    DataType *output, const GEMMEpilogueCPU<DataType> &epilogue)
+    {
+        sparseDotProductForEachSampleCPU(batchSize, rowOffsets[batchSize], outputSize, [&](unsigned int begin, unsigned int end)
+        {
+            for (unsigned int b = begin; b < end; ++b)
+            {
+                DataType *outputColumn = output + (size_t) b * outputSize;
+                std::fill(outputColumn, outputColumn + outputSize, (DataType) 0);
+
+                for (unsigned int k = rowOffsets[b]; k < rowOffsets[b + 1]; ++k)
+                {
+                    if (columns[k] >= inputSize)
+                    {
+                        continue;
+                    }
+
+                    const DataType *weightColumn = weight + (size_t) columns[k] * outputSize;
+                    DataType value = values[k];
+
+                    for (unsigned int i = 0; i < outputSize; ++i)
+                    {
+                        outputColumn[i] += value * weightColumn[i];
+                    }
+                }
+
+                epilogue.apply(outputColumn, outputSize);
+            }
+        });
+    }
+
+    // weightGrad += outputDelta * input^T, only the columns of the input indices present are touched
+    template<typename DataType>
+    void sparseDotProductWeightGradCPU(const unsigned int *rowOffsets, const unsigned int *columns, const DataType *values,
+                                       const DataType *outputDelta, unsigned int inputSize, unsigned int outputSize, unsigned int batchSize,
+                                       DataType *weightGrad)
+    {
+        // serial, two samples may share an input index
+        for (unsigned int b = 0; b < batchSize; ++b)
+        {
+            const DataType *deltaColumn = outputDelta + (size_t) b * outputSize;
+
+            for (unsigned int k = rowOffsets[b]; k < rowOffsets[b + 1]; ++k)
+            {
+                if (columns[k] >= inputSize)
+                {
+                    continue;
+                }
+
+                DataType *gradColumn = weightGrad + (size_t) columns[k] * outputSize;
+                DataType value = values[k];
+
+                for (unsigned int i = 0; i < outputSize; ++i)
+                {
+                    gradColumn[i] += value * deltaColumn[i];
+                }
+            }
+        }
+    }
+
+    // the gradient of the values, inputDelta[k] = weight column columns[k] . outputDelta of its sample
+    template<typename DataType>
+    void sparseDotProductInputDeltaCPU(const unsigned int *rowOffsets, const unsigned int *columns,
+                                       const DataType *weight, const DataType *outputDelta,
+                                       unsigned int inputSize, unsigned int outputSize, unsigned int batchSize, DataType *inputDelta)
+    {
+        sparseDotProductForEachSampleCPU(batchSize, rowOffsets[batchSize], outputSize, [&](unsigned int begin, unsigned int end)
+        {
+            for (unsigned int b = begin; b < end; ++b)
+            {
+                const DataType *deltaColumn = outputDelta + (size_t) b * outputSize;
+
+                for (unsigned int k = rowOffsets[b]; k < rowOffsets[b + 1]; ++k)
+                {
+                    DataType sum = 0;
+
+                    if (columns[k] < inputSize)
+                    {
+                        const DataType *weightColumn = weight + (size_t) columns[k] * outputSize;
+
+                        for (unsigned int i = 0; i < outputSize; ++i)
+                        {
+                            sum += weightColumn[i] * deltaColumn[i];
+                        }
+                    }
+
+                    inputDelta[k] = sum;
+                }
+            }
+        });
+    }
+}
+
+#endif
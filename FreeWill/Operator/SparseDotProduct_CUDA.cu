@@ -0,0 +1,153 @@
+#include "SparseDotProduct_CUDA.h"
+#include "../DeviceSelection.h"
+#include "../Context/ComputeStream.h"
+#include <cuda_runtime.h>
+
+// block (b, tile) computes rows tile * blockDim.x + threadIdx.x of sample b
+template <typename DataType>
+__global__ void sparseDotProductForward(const unsigned int *rowOffsets, const unsigned int *columns, const DataType *values,
+                                        const DataType *weight, const DataType *bias, unsigned int inputSize,
+                                        unsigned int outputSize, DataType *output)
+{
+    unsigned int b = blockIdx.x;
+    unsigned int i = blockIdx.y * blockDim.x + threadIdx.x;
+
+    if (i >= outputSize)
+    {
+        return;
+    }
+
+    DataType sum = bias ? bias[i] : (DataType) 0;
+
+    for (unsigned int k = rowOffsets[b]; k < rowOffsets[b + 1]; ++k)
+    {
+        unsigned int column = columns[k];
+
+        if (column < inputSize)
+        {
+            sum += values[k] * weight[(size_t) column * outputSize + i];
+        }
+    }
+
+    output[(size_t) b * outputSize + i] = sum;
+}
+
+template <typename DataType>
+__global__ void sparseDotProductWeightGrad(const unsigned int *rowOffsets, const unsigned int *columns, const DataType *values,
+                                           const DataType *outputDelta, unsigned int inputSize, unsigned int outputSize,
+                                           DataType *weightGrad)
+{
+    unsigned int b = blockIdx.x;
+    unsigned int i = blockIdx.y * blockDim.x + threadIdx.x;
+
+    if (i >= outputSize)
+    {
+        return;
+    }
+
+    DataType delta = outputDelta[(size_t) b * outputSize + i];
+
+    for (unsigned int k = rowOffsets[b]; k < rowOffsets[b + 1]; ++k)
+    {
+        unsigned int column = columns[k];
+
+        if (column < inputSize)
+        {
+            // two samples may share a column
+            atomicAdd(&weightGrad[(size_t) column * outputSize + i], values[k] * delta);
+        }
+    }
+}
+
+// a warp per non-zero of sample b, its lanes split the dot product over the output rows
+template <typename DataType>
+__global__ void sparseDotProductInputDelta(const unsigned int *rowOffsets, const unsigned int *columns,
+                                           const DataType *weight, const DataType *outputDelta, unsigned int inputSize,
+                                           unsigned int outputSize, DataType *inputDelta)
+{
+    unsigned int b = blockIdx.x;
+    unsigned int lane = threadIdx.x & 31;
+    unsigned int warpCount = blockDim.x / 32;
+    const DataType *deltaColumn = outputDelta + (size_t) b * outputSize;
+
+    for (unsigned int k = rowOffsets[b] + threadIdx.x / 32; k < rowOffsets[b + 1]; k += warpCount)
+    {
+        unsigned int column = columns[k];
+        DataType sum = 0;
+
+        if (column < inputSize)
+        {
+            for (unsigned int i = lane; i < outputSize; i += 32)
+            {
+                sum += weight[(size_t) column * outputSize + i] * deltaColumn[i];
+            }
+        }
+
+        for (int offset = 16; offset > 0; offset /= 2)
+        {
+            sum += __shfl_down_sync(0xffffffff, sum, offset);
+        }
+
+        if (lane == 0)
+        {
+            inputDelta[k] = sum;
+        }
+    }
+}
+
+template <typename DataType>
+__host__ void sparseDotProductForwardCUDAKernel(const unsigned int *rowOffsets, const unsigned int *columns, const DataType *values,
+                                                const DataType *weight, const DataType *bias, unsigned int inputSize,
+                                                unsigned int outputSize, unsigned int batchSize, DataType *output)
+{
+    int blockSize = 128;
+    dim3 gridSize(batchSize, (outputSize + blockSize - 1) / blockSize);
+
+    if (batchSize == 0 || outputSize == 0)
+    {
+        return;
+    }
+
+    sparseDotProductForward<DataType><<<gridSize, blockSize, 0, FreeWill::computeStream()>>>(rowOffsets, columns, values, weight, bias,
+                                                                                            inputSize, outputSize, output);
+    CHECK_CUDA_ERROR
+}
+
+template <typename DataType>
+__host__ void sparseDotProductWeightGradCUDAKernel(const unsigned int *rowOffsets, const unsigned int *columns, const DataType *values,
+                                                   const DataType *outputDelta, unsigned int inputSize, unsigned int outputSize,
+                                                   unsigned int batchSize, DataType *weightGrad)
+{
+    int blockSize = 128;
+    dim3 gridSize(batchSize, (outputSize + blockSize - 1) / blockSize);
+
+    if (batchSize == 0 || outputSize == 0)
+    {
+        return;
+    }
+
+    sparseDotProductWeightGrad<DataType><<<gridSize, blockSize, 0, FreeWill::computeStream()>>>(rowOffsets, columns, values, outputDelta,
+                                                                                               inputSize, outputSize, weightGrad);
+    CHECK_CUDA_ERROR
+}
+
+template <typename DataType>
+__host__ void sparseDotProductInputDeltaCUDAKernel(const unsigned int *rowOffsets, const unsigned int *columns,
+                                                   const DataType *weight, const DataType *outputDelta, unsigned int inputSize,
+                                                   unsigned int outputSize, unsigned int batchSize, DataType *inputDelta)
+{
+    int blockSize = 128;
+
+    if (batchSize == 0)
+    {
+        return;
+    }
+
+    sparseDotProductInputDelta<DataType><<<batchSize, blockSize, 0, FreeWill::computeStream()>>>(rowOffsets, columns, weight, outputDelta,
+                                                                                                inputSize, outputSize, inputDelta);
+    CHECK_CUDA_ERROR
+}
+
+template __host__ void sparseDotProductForwardCUDAKernel(const unsigned int *rowOffsets, const unsigned int *columns, const float *values, const float *weight, const float *bias, unsigned int inputSize, unsigned int outputSize, unsigned int batchSize, float *output);
+template __host__ void sparseDotProductWeightGradCUDAKernel(const unsigned int *rowOffsets, const unsigned int *columns, const float *values, const float *outputDelta, unsigned int inputSize, unsigned int outputSize, unsigned int batchSize, float *weightGrad);
+template __host__ void sparseDotProductInputDeltaCUDAKernel(const unsigned int *rowOffsets, const unsigned int *columns, const float *weight, const float *outputDelta, unsigned int inputSize, unsigned int outputSize, unsigned int batchSize, float *inputDelta);
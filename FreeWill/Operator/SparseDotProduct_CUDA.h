@@ -0,0 +1,26 @@
+#ifndef SPARSEDOTPRODUCT_CUDA_H
+#define SPARSEDOTPRODUCT_CUDA_H
+
+#include <cuda_runtime.h>
+
+// shared with the cuda kernels, keep it c++11
+
+// The CSR batch of SparseDotProduct_CPU.h, float only. Samples go to blocks and output rows to
+// threads, so the gathered weight columns are read coalesced. bias may be null.
+template <typename DataType = float>
+__host__ void sparseDotProductForwardCUDAKernel(const unsigned int *rowOffsets, const unsigned int *columns, const DataType *values,
+                                                const DataType *weight, const DataType *bias, unsigned int inputSize,
+                                                unsigned int outputSize, unsigned int batchSize, DataType *output);
+
+// adds to weightGrad with atomics, the columns no sample uses aren't written
+template <typename DataType = float>
+__host__ void sparseDotProductWeightGradCUDAKernel(const unsigned int *rowOffsets, const unsigned int *columns, const DataType *values,
+                                                   const DataType *outputDelta, unsigned int inputSize, unsigned int outputSize,
+                                                   unsigned int batchSize, DataType *weightGrad);
+
+template <typename DataType = float>
+__host__ void sparseDotProductInputDeltaCUDAKernel(const unsigned int *rowOffsets, const unsigned int *columns,
+                                                   const DataType *weight, const DataType *outputDelta, unsigned int inputSize,
+                                                   unsigned int outputSize, unsigned int batchSize, DataType *inputDelta);
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef SPARSITYMASK_H
+#define SPARSITYMASK_H
+
+#include "Operator.h"
+#include <type_traits>
+#include "Elementwise_CPU.h"
+#include "Elementwise_CUDA.h"
+#include "StructuredSparsity_CPU.h"
+
+namespace FreeWill
+{
+    // Keeps a weight pruned while it is fine-tuned: init prunes Weight in place to the pattern
+    // and records which weights survived, evaluate zeroes the pruned ones again after an
+    // update moved them. Weight is a dot product's {out, in} or a convolution's FeatureMap
+    // {channels, width, height, filters}, pruned along the inputs of each output, the patch of
+    // each filter. Float and double.
+    template<DeviceType DeviceUsed = DeviceType::CPU_NAIVE, typename DataType = float>
+    class SparsityMask : public Operator<DeviceUsed>
+    {
+    protected:
+        using Operator<DeviceUsed>::output;
+
+        SparsityParameters m_parameters;
+        // 1 where the weight is kept, 0 where it was pruned
+        Tensor<DeviceUsed, DataType> *m_mask;
+
+    public:
+        enum OutputSlot : unsigned int {WEIGHT};
+
+        SparsityMask(const SparsityParameters &parameters, unsigned int deviceId = 0)
+            :Operator<DeviceUsed>({}, {"Weight"}, deviceId),
+            m_parameters(parameters),
+            m_mask(nullptr)
+        {
+        }
+
+        ~SparsityMask()
+        {
+            delete m_mask;
+        }
+
+        // outputs by inputs of a weight and the strides between them, false for other shapes
+        static bool weightLayout(const Shape &shape, unsigned int &outputSize, unsigned int &inputSize, size_t &outputStride, size_t &inputStride)
+        {
+            if (shape.dimension() == 2)
+            {
+                outputSize = shape[0];
+                inputSize = shape[1];
+                outputStride = 1;
+                inputStride = outputSize;
+                return true;
+            }
+            else if (shape.dimension() == 4)
+            {
+                outputSize = shape[3];
+                inputSize = shape[0] * shape[1] * shape[2];
+                outputStride = inputSize;
+                inputStride = 1;
+                return true;
+            }
+
+            return false;
+        }
+
+        virtual bool init() override
+        {
+            CHECK_GPU;
+
+            FAIL_IF (!output("Weight") || m_mask || m_parameters.m_pattern == SparsityPattern::DENSE);
+
+            FAIL_IF ((!std::is_same<DataType, float>::value && !std::is_same<DataType, double>::value));
+
+            Tensor<DeviceUsed, DataType> *_weight = output("Weight")->template toType<DataType>();
+
+            unsigned int outputSize = 0;
+            unsigned int inputSize = 0;
+            size_t outputStride = 0;
+            size_t inputStride = 0;
+
+            FAIL_IF (!_weight || !weightLayout(_weight->shape(), outputSize, inputSize, outputStride, inputStride));
+
+            m_mask = new Tensor<DeviceUsed, DataType>(_weight->shape());
+
+            FAIL_IF (!m_mask->init());
+
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                _weight->copyFromDeviceToHost();
+            }
+
+            pruneWeightCPU(m_parameters, _weight->cpuDataHandle(), m_mask->cpuDataHandle(), outputSize, inputSize, outputStride, inputStride);
+
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                _weight->copyFromHostToDevice();
+                m_mask->copyFromHostToDevice();
+            }
+
+            return true;
+        }
+
+        virtual void evaluate() override
+        {
+            CHECK_GPU;
+
+            Tensor<DeviceUsed, DataType> *_weight = output(WEIGHT)->template toType<DataType>();
+            unsigned int size = _weight->shape().size();
+
+            if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+            {
+                ElementwiseArguments<DataType> arguments = {{_weight->cpuDataHandle(), m_mask->cpuDataHandle()}, {}};
+
+                elementwiseCPU<ElementwiseProductExpression>(_weight->cpuDataHandle(), arguments, size);
+            }
+            else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                ElementwiseArguments<DataType> arguments = {{_weight->gpuDataHandle(), m_mask->gpuDataHandle()}, {}};
+
+                elementwiseCUDAKernel<ElementwiseProductExpression>(_weight->gpuDataHandle(), arguments, size);
+            }
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,323 @@
+#ifndef STRUCTUREDSPARSITY_CPU_H
+#define STRUCTUREDSPARSITY_CPU_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include "GEMM_CPU.h"
+#include "../Context/ThreadPool.h"
+
+namespace FreeWill
+{
+    // TWO_FOUR keeps the two largest magnitudes of every four consecutive inputs of an output.
+    // BLOCK cuts the weight into m_blockSize x m_blockSize blocks of outputs by inputs and
+    // keeps the m_blockDensity share of them with the largest sums of magnitudes.
+    enum class SparsityPattern : uint32_t
+    {
+        DENSE,
+        TWO_FOUR,
+        BLOCK
+    };
+
+    struct SparsityParameters
+    {
+        SparsityPattern m_pattern = SparsityPattern::DENSE;
+        unsigned int m_blockSize = 4;
+        double m_blockDensity = 0.5;
+    };
+
+    // The weights are addressed as W[o, i] = weight[o * outputStride + i * inputStride], for the
+    // column-major {outputSize, inputSize} of a dot product outputStride is 1 and inputStride
+    // outputSize, for the {channels, width, height, filters} of a convolution the patch of a
+    // filter is its inputs.
+
+    // below this many multiply-adds the samples run on the caller's thread
+    static const double STRUCTURED_SPARSITY_PARALLEL_WORK = 1.0e5;
+
+    // zeroes the pruned weights, mask, when given, gets 1 where a weight is kept and 0 elsewhere
+    template<typename DataType>
+    void pruneWeightCPU(const SparsityParameters &parameters, DataType *weight, DataType *mask, unsigned int outputSize, unsigned int inputSize,
+                        size_t outputStride, size_t inputStride)
+    {
+        auto at = [&](unsigned int o, unsigned int i)
+        {
+            return (size_t) o * outputStride + (size_t) i * inputStride;
+        };
+
+        std::vector<char> isKept((size_t) outputSize * inputSize, 1);
+
+        if (parameters.m_pattern == SparsityPattern::TWO_FOUR)
+        {
+            for (unsigned int o = 0; o < outputSize; ++o)
+            {
+                for (unsigned int group = 0; group < inputSize; group += 4)
+                {
+                    unsigned int count = std::min(4u, inputSize - group);
+                    unsigned int order[4] = {0, 1, 2, 3};
+
+                    // the larger magnitudes first, the lower input on a tie
+                    std::stable_sort(order, order + count, [&](unsigned int a, unsigned int b)
+                    {
+                        return std::abs(weight[at(o, group + a)]) > std::abs(weight[at(o, group + b)]);
+                    });
+
+                    for (unsigned int k = 2; k < count; ++k)
+                    {
+                        isKept[(size_t) o * inputSize + group + order[k]] = 0;
+                    }
+                }
+            }
+        }
+        else if (parameters.m_pattern == SparsityPattern::BLOCK)
+        {
+            unsigned int blockSize = std::max(1u, parameters.m_blockSize);
+            unsigned int rowBlockCount = (outputSize + blockSize - 1) / blockSize;
+            unsigned int columnBlockCount = (inputSize + blockSize - 1) / blockSize;
+            unsigned int blockCount = rowBlockCount * columnBlockCount;
+
+            std::vector<double> norms(blockCount, 0.0);
+
+            for (unsigned int o = 0; o < outputSize; ++o)
+            {
+                for (unsigned int i = 0; i < inputSize; ++i)
+                {
+                    norms[(o / blockSize) * columnBlockCount + i / blockSize] += std::abs((double) weight[at(o, i)]);
+                }
+            }
+
+            std::vector<unsigned int> order(blockCount);
+            std::iota(order.begin(), order.end(), 0);
+            std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b)
+            {
+                return norms[a] > norms[b];
+            });
+
+            unsigned int keptCount = std::min(blockCount, (unsigned int) std::ceil(std::max(0.0, parameters.m_blockDensity) * blockCount));
+            std::vector<char> isBlockKept(blockCount, 0);
+
+            for (unsigned int k = 0; k < keptCount; ++k)
+            {
+                isBlockKept[order[k]] = 1;
+            }
+
+            for (unsigned int o = 0; o < outputSize; ++o)
+            {
+                for (unsigned int i = 0; i < inputSize; ++i)
+                {
+                    isKept[(size_t) o * inputSize + i] = isBlockKept[(o / blockSize) * columnBlockCount + i / blockSize];
+                }
+            }
+        }
+
+        for (unsigned int o = 0; o < outputSize; ++o)
+        {
+            for (unsigned int i = 0; i < inputSize; ++i)
+            {
+                bool kept = isKept[(size_t) o * inputSize + i];
+
+                if (!kept)
+                {
+                    weight[at(o, i)] = 0;
+                }
+
+                if (mask)
+                {
+                    mask[at(o, i)] = kept ? 1 : 0;
+                }
+            }
+        }
+    }
+
+    // The 2:4 weight packed per output: for every group of four inputs the two values kept,
+    // values[(o * groupCount + g) * 2 + k] at input 4 * g + offsets[(o * groupCount + g) * 2 + k].
+    // Of a group with more non-zeros the two largest are kept, an unused slot is a zero at
+    // offset 0. groupCount is inputSize / 4 rounded up.
+    template<typename DataType>
+    void compressTwoFourCPU(const DataType *weight, unsigned int outputSize, unsigned int inputSize, size_t outputStride, size_t inputStride,
+                            DataType *values, int8_t *offsets)
+    {
+        unsigned int groupCount = (inputSize + 3) / 4;
+
+        for (unsigned int o = 0; o < outputSize; ++o)
+        {
+            for (unsigned int g = 0; g < groupCount; ++g)
+            {
+                unsigned int count = std::min(4u, inputSize - g * 4);
+                unsigned int order[4] = {0, 1, 2, 3};
+                const DataType *groupWeight = weight + (size_t) o * outputStride + (size_t) g * 4 * inputStride;
+
+                std::stable_sort(order, order + count, [&](unsigned int a, unsigned int b)
+                {
+                    return std::abs(groupWeight[a * inputStride]) > std::abs(groupWeight[b * inputStride]);
+                });
+
+                // in input order, so that the loads of a group go forward
+                std::sort(order, order + std::min(2u, count));
+
+                for (unsigned int k = 0; k < 2; ++k)
+                {
+                    size_t slot = ((size_t) o * groupCount + g) * 2 + k;
+
+                    values[slot] = k < count ? groupWeight[order[k] * inputStride] : (DataType) 0;
+                    offsets[slot] = k < count ? (int8_t) order[k] : 0;
+                }
+            }
+        }
+    }
+
+    // The block sparse weight in block rows (BSR): the blocks of outputs blockRow * blockSize
+    // and on are [blockRowOffsets[blockRow], blockRowOffsets[blockRow + 1]), block k at inputs
+    // blockColumns[k] * blockSize and on with its values row by row from
+    // blockValues + k * blockSize * blockSize. Blocks of zeros are left out, the blocks at the
+    // edges are padded with zeros.
+    template<typename DataType>
+    void compressBlockSparseCPU(const DataType *weight, unsigned int outputSize, unsigned int inputSize, size_t outputStride, size_t inputStride,
+                                unsigned int blockSize, std::vector<unsigned int> &blockRowOffsets, std::vector<unsigned int> &blockColumns,
+                                std::vector<DataType> &blockValues)
+    {
+        unsigned int rowBlockCount = (outputSize + blockSize - 1) / blockSize;
+        unsigned int columnBlockCount = (inputSize + blockSize - 1) / blockSize;
+
+        blockRowOffsets.assign(1, 0);
+        blockColumns.clear();
+        blockValues.clear();
+
+        for (unsigned int blockRow = 0; blockRow < rowBlockCount; ++blockRow)
+        {
+            for (unsigned int blockColumn = 0; blockColumn < columnBlockCount; ++blockColumn)
+            {
+                std::vector<DataType> block((size_t) blockSize * blockSize, (DataType) 0);
+                bool isZero = true;
+
+                for (unsigned int r = 0; r < blockSize && blockRow * blockSize + r < outputSize; ++r)
+                {
+                    for (unsigned int c = 0; c < blockSize && blockColumn * blockSize + c < inputSize; ++c)
+                    {
+                        DataType value = weight[(size_t) (blockRow * blockSize + r) * outputStride + (size_t) (blockColumn * blockSize + c) * inputStride];
+
+                        block[r * blockSize + c] = value;
+                        isZero = isZero && value == (DataType) 0;
+                    }
+                }
+
+                if (!isZero)
+                {
+                    blockColumns.push_back(blockColumn);
+                    blockValues.insert(blockValues.end(), block.begin(), block.end());
+                }
+            }
+
+            blockRowOffsets.push_back((unsigned int) blockColumns.size());
+        }
+    }
+
+    // output{outputSize, batchSize} = W * input{inputSize, batchSize} of the packed 2:4 weight,
+    // the epilogue adds the bias and the activation
+    template<typename DataType>
+    void twoFourDotProductCPU(const DataType *values, const int8_t *offsets, const DataType *input, unsigned int inputSize,
+                              unsigned int outputSize, unsigned int batchSize, DataType *output, const GEMMEpilogueCPU<DataType> &epilogue)
+    {
+        unsigned int groupCount = (inputSize + 3) / 4;
+
+        auto run = [&](unsigned int begin, unsigned int end)
+        {
+            for (unsigned int b = begin; b < end; ++b)
+            {
+                const DataType *inputColumn = input + (size_t) b * inputSize;
+                DataType *outputColumn = output + (size_t) b * outputSize;
+
+                for (unsigned int o = 0; o < outputSize; ++o)
+                {
+                    const DataType *rowValues = values + (size_t) o * groupCount * 2;
+                    const int8_t *rowOffsets = offsets + (size_t) o * groupCount * 2;
+                    DataType sum = 0;
+
+                    for (unsigned int g = 0; g < groupCount; ++g)
+                    {
+                        // a padding slot is a zero at offset 0, inside the input
+                        sum += rowValues[2 * g] * inputColumn[4 * g + rowOffsets[2 * g]];
+
+                        if (4 * g + rowOffsets[2 * g + 1] < inputSize)
+                        {
+                            sum += rowValues[2 * g + 1] * inputColumn[4 * g + rowOffsets[2 * g + 1]];
+                        }
+                    }
+
+                    outputColumn[o] = sum;
+                }
+
+                epilogue.apply(outputColumn, outputSize);
+            }
+        };
+
+        if ((double) outputSize * groupCount * 2 * batchSize < STRUCTURED_SPARSITY_PARALLEL_WORK)
+        {
+            run(0, batchSize);
+        }
+        else
+        {
+            ThreadPool::getSingleton().parallelFor(0, batchSize, 1, run);
+        }
+    }
+
+    // output{outputSize, batchSize} = W * input{inputSize, batchSize} of the block sparse weight,
+    // the epilogue adds the bias and the activation
+    template<typename DataType>
+    void blockSparseDotProductCPU(const unsigned int *blockRowOffsets, const unsigned int *blockColumns, const DataType *blockValues,
+                                  unsigned int blockSize, const DataType *input, unsigned int inputSize, unsigned int outputSize,
+                                  unsigned int batchSize, DataType *output, const GEMMEpilogueCPU<DataType> &epilogue)
+    {
+        unsigned int rowBlockCount = (outputSize + blockSize - 1) / blockSize;
+
+        auto run = [&](unsigned int begin, unsigned int end)
+        {
+            for (unsigned int b = begin; b < end; ++b)
+            {
+                const DataType *inputColumn = input + (size_t) b * inputSize;
+                DataType *outputColumn = output + (size_t) b * outputSize;
+
+                std::fill(outputColumn, outputColumn + outputSize, (DataType) 0);
+
+                for (unsigned int blockRow = 0; blockRow < rowBlockCount; ++blockRow)
+                {
+                    unsigned int rowCount = std::min(blockSize, outputSize - blockRow * blockSize);
+
+                    for (unsigned int k = blockRowOffsets[blockRow]; k < blockRowOffsets[blockRow + 1]; ++k)
+                    {
+                        unsigned int firstInput = blockColumns[k] * blockSize;
+                        unsigned int columnCount = std::min(blockSize, inputSize - firstInput);
+                        const DataType *block = blockValues + (size_t) k * blockSize * blockSize;
+
+                        for (unsigned int r = 0; r < rowCount; ++r)
+                        {
+                            DataType sum = 0;
+
+                            for (unsigned int c = 0; c < columnCount; ++c)
+                            {
+                                sum += block[r * blockSize + c] * inputColumn[firstInput + c];
+                            }
+
+                            outputColumn[blockRow * blockSize + r] += sum;
+                        }
+                    }
+                }
+
+                epilogue.apply(outputColumn, outputSize);
+            }
+        };
+
+        if ((double) blockRowOffsets[rowBlockCount] * blockSize * blockSize * batchSize < STRUCTURED_SPARSITY_PARALLEL_WORK)
+        {
+            run(0, batchSize);
+        }
+        else
+        {
+            ThreadPool::getSingleton().parallelFor(0, batchSize, 1, run);
+        }
+    }
+}
+
+#endif
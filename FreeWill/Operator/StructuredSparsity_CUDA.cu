@@ -0,0 +1,138 @@
+#include "StructuredSparsity_CUDA.h"
+#include "../DeviceSelection.h"
+#include "../Context/ComputeStream.h"
+#include <cuda_runtime.h>
+
+template <typename DataType>
+__device__ DataType structuredSparsityWriteback(DataType value, const DataType *bias, unsigned int o, bool hasActivation,
+                                                FreeWill::ActivationMode activationMode)
+{
+    if (bias)
+    {
+        value += bias[o];
+    }
+
+    if (hasActivation)
+    {
+        switch (activationMode)
+        {
+        case FreeWill::ActivationMode::SIGMOID:
+            value = 1 / (1 + exp(-value));
+            break;
+        case FreeWill::ActivationMode::RELU:
+            value = value > 0 ? value : 0;
+            break;
+        case FreeWill::ActivationMode::TANH:
+            value = tanh(value);
+            break;
+        case FreeWill::ActivationMode::CLIPPED_RELU:
+            value = value > 0 ? (value < 20 ? value : 20) : 0;
+            break;
+        default:
+            break;
+        }
+    }
+
+    return value;
+}
+
+// block (tile, b) computes outputs tile * blockDim.x + threadIdx.x of sample b
+template <typename DataType>
+__global__ void twoFourDotProduct(const DataType *values, const int8_t *offsets, const DataType *input, unsigned int inputSize,
+                                  unsigned int outputSize, const DataType *bias, bool hasActivation,
+                                  FreeWill::ActivationMode activationMode, DataType *output)
+{
+    unsigned int o = blockIdx.x * blockDim.x + threadIdx.x;
+    unsigned int b = blockIdx.y;
+
+    if (o >= outputSize)
+    {
+        return;
+    }
+
+    unsigned int groupCount = (inputSize + 3) / 4;
+    const DataType *rowValues = values + (size_t) o * groupCount * 2;
+    const int8_t *rowOffsets = offsets + (size_t) o * groupCount * 2;
+    const DataType *inputColumn = input + (size_t) b * inputSize;
+    DataType sum = 0;
+
+    for (unsigned int k = 0; k < groupCount * 2; ++k)
+    {
+        unsigned int i = 4 * (k / 2) + rowOffsets[k];
+
+        if (i < inputSize)
+        {
+            sum += rowValues[k] * inputColumn[i];
+        }
+    }
+
+    output[(size_t) b * outputSize + o] = structuredSparsityWriteback(sum, bias, o, hasActivation, activationMode);
+}
+
+template <typename DataType>
+__global__ void blockSparseDotProduct(const unsigned int *blockRowOffsets, const unsigned int *blockColumns, const DataType *blockValues,
+                                      unsigned int blockSize, const DataType *input, unsigned int inputSize, unsigned int outputSize,
+                                      const DataType *bias, bool hasActivation, FreeWill::ActivationMode activationMode, DataType *output)
+{
+    unsigned int o = blockIdx.x * blockDim.x + threadIdx.x;
+    unsigned int b = blockIdx.y;
+
+    if (o >= outputSize)
+    {
+        return;
+    }
+
+    unsigned int blockRow = o / blockSize;
+    unsigned int r = o % blockSize;
+    const DataType *inputColumn = input + (size_t) b * inputSize;
+    DataType sum = 0;
+
+    for (unsigned int k = blockRowOffsets[blockRow]; k < blockRowOffsets[blockRow + 1]; ++k)
+    {
+        unsigned int firstInput = blockColumns[k] * blockSize;
+        const DataType *blockRowValues = blockValues + ((size_t) k * blockSize + r) * blockSize;
+
+        for (unsigned int c = 0; c < blockSize && firstInput + c < inputSize; ++c)
+        {
+            sum += blockRowValues[c] * inputColumn[firstInput + c];
+        }
+    }
+
+    output[(size_t) b * outputSize + o] = structuredSparsityWriteback(sum, bias, o, hasActivation, activationMode);
+}
+
+template <typename DataType>
+__host__ void twoFourDotProductCUDAKernel(const DataType *values, const int8_t *offsets, const DataType *input, unsigned int inputSize,
+                                          unsigned int outputSize, unsigned int batchSize, const DataType *bias, bool hasActivation,
+                                          FreeWill::ActivationMode activationMode, DataType *output)
+{
+    unsigned int blockSize = 128;
+    dim3 gridSize((outputSize + blockSize - 1) / blockSize, batchSize);
+
+    twoFourDotProduct<DataType><<<gridSize, blockSize, 0, FreeWill::computeStream()>>>(values, offsets, input, inputSize, outputSize,
+                                                                                        bias, hasActivation, activationMode, output);
+    CHECK_CUDA_ERROR
+}
+
+template <typename DataType>
+__host__ void blockSparseDotProductCUDAKernel(const unsigned int *blockRowOffsets, const unsigned int *blockColumns, const DataType *blockValues,
+                                              unsigned int blockSize, const DataType *input, unsigned int inputSize, unsigned int outputSize,
+                                              unsigned int batchSize, const DataType *bias, bool hasActivation,
+                                              FreeWill::ActivationMode activationMode, DataType *output)
+{
+    unsigned int threadCount = 128;
+    dim3 gridSize((outputSize + threadCount - 1) / threadCount, batchSize);
+
+    blockSparseDotProduct<DataType><<<gridSize, threadCount, 0, FreeWill::computeStream()>>>(blockRowOffsets, blockColumns, blockValues, blockSize,
+                                                                                             input, inputSize, outputSize, bias, hasActivation,
+                                                                                             activationMode, output);
+    CHECK_CUDA_ERROR
+}
+
+template __host__ void twoFourDotProductCUDAKernel(const float *values, const int8_t *offsets, const float *input, unsigned int inputSize,
+                                                   unsigned int outputSize, unsigned int batchSize, const float *bias, bool hasActivation,
+                                                   FreeWill::ActivationMode activationMode, float *output);
+template __host__ void blockSparseDotProductCUDAKernel(const unsigned int *blockRowOffsets, const unsigned int *blockColumns, const float *blockValues,
+                                                       unsigned int blockSize, const float *input, unsigned int inputSize, unsigned int outputSize,
+                                                       unsigned int batchSize, const float *bias, bool hasActivation,
+                                                       FreeWill::ActivationMode activationMode, float *output);
@@ -0,0 +1,23 @@
+#ifndef STRUCTUREDSPARSITY_CUDA_H
+#define STRUCTUREDSPARSITY_CUDA_H
+
+#include <cuda_runtime.h>
+#include <stdint.h>
+#include "ActivationMode.h"
+
+// shared with the cuda kernels, keep it c++11
+
+// The packed weights of StructuredSparsity_CPU.h, float only. A thread per output and sample,
+// the threads of a block along the outputs read the same input column. bias may be null.
+template <typename DataType = float>
+__host__ void twoFourDotProductCUDAKernel(const DataType *values, const int8_t *offsets, const DataType *input, unsigned int inputSize,
+                                          unsigned int outputSize, unsigned int batchSize, const DataType *bias, bool hasActivation,
+                                          FreeWill::ActivationMode activationMode, DataType *output);
+
+template <typename DataType = float>
+__host__ void blockSparseDotProductCUDAKernel(const unsigned int *blockRowOffsets, const unsigned int *blockColumns, const DataType *blockValues,
+                                              unsigned int blockSize, const DataType *input, unsigned int inputSize, unsigned int outputSize,
+                                              unsigned int batchSize, const DataType *bias, bool hasActivation,
+                                              FreeWill::ActivationMode activationMode, DataType *output);
+
+#endif
@@ -0,0 +1,565 @@
+#include "BlobAllocator.h"
+#include "../DeviceSelection.h"
+#include "../Context/CPUTopology.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <cuda_runtime.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+// what the blocks the thread allocates now are filed under, see BlobAllocator::Tag
+static thread_local FreeWill::MemoryCategory currentCategory = FreeWill::MemoryCategory::OTHER;
+static thread_local std::string currentOwner;
+
+FreeWill::BlobAllocator::Tag::Tag(MemoryCategory category, const std::string &owner)
+    :m_previousCategory(currentCategory),
+      m_previousOwner(currentOwner)
+{
+    currentCategory = category;
+    currentOwner = owner;
+}
+
+FreeWill::BlobAllocator::Tag::~Tag()
+{
+    currentCategory = m_previousCategory;
+    currentOwner = m_previousOwner;
+}
+
+FreeWill::BlobAllocator::ManagedMemoryScope::ManagedMemoryScope(bool isManaged)
+    :m_wasManaged(BlobAllocator::getSingleton().isManagedMemory())
+{
+    BlobAllocator::getSingleton().setManagedMemory(isManaged);
+}
+
+FreeWill::BlobAllocator::ManagedMemoryScope::~ManagedMemoryScope()
+{
+    BlobAllocator::getSingleton().setManagedMemory(m_wasManaged);
+}
+
+FreeWill::BlobAllocator::BlobAllocator()
+    :m_mutex(),
+      m_hostBlocks(),
+      m_deviceBlocks(),
+      m_cachedHostBlocks(),
+      m_cachedDeviceBlocks(),
+      m_cachedSizeInByte(0),
+      m_hostSizeInByte(0),
+      m_deviceSizeInByte(0),
+      m_peakHostSizeInByte(0),
+      m_peakDeviceSizeInByte(0),
+      m_usages(),
+      m_isCaching(true),
+      m_useHugePages(false),
+      m_useManagedMemory(false)
+{}
+
+FreeWill::BlobAllocator::~BlobAllocator()
+{}
+
+FreeWill::BlobAllocator &FreeWill::BlobAllocator::getSingleton()
+{
+    // never destroyed, blobs held by other statics may be freed after this one would be
+    static BlobAllocator *obj = new BlobAllocator();
+    return *obj;
+}
+
+size_t FreeWill::BlobAllocator::sizeClass(size_t sizeInByte)
+{
+    if (sizeInByte <= ALIGNMENT)
+    {
+        return ALIGNMENT;
+    }
+
+    size_t powerOfTwo = ALIGNMENT;
+    while (powerOfTwo < sizeInByte)
+    {
+        powerOfTwo <<= 1;
+    }
+
+    size_t step = std::max((size_t) ALIGNMENT, powerOfTwo / 4);
+
+    return (sizeInByte + step - 1) / step * step;
+}
+
+size_t FreeWill::BlobAllocator::hostBlockSize(size_t sizeInByte) const
+{
+    if (m_useHugePages && sizeInByte >= HUGE_PAGE_SIZE)
+    {
+        return (sizeInByte + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    }
+
+    return sizeClass(sizeInByte);
+}
+
+void *FreeWill::BlobAllocator::allocateHost(size_t sizeInByte, bool isPinned)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    size_t blockSize = isPinned ? sizeClass(sizeInByte) : hostBlockSize(sizeInByte);
+    unsigned int node = CPUTopology::getSingleton().currentNode();
+    void *pointer = nullptr;
+
+    auto cached = m_cachedHostBlocks.find(std::make_tuple(isPinned, node, blockSize));
+    if (cached != m_cachedHostBlocks.end() && !cached->second.empty())
+    {
+        pointer = cached->second.back();
+        cached->second.pop_back();
+        m_cachedSizeInByte -= blockSize;
+    }
+    else
+    {
+        if (isPinned && (cudaHostAlloc(&pointer, blockSize, cudaHostAllocPortable) != cudaSuccess || !pointer))
+        {
+            // out of page-locked memory, a pageable block still works but copies will not overlap
+            isPinned = false;
+            pointer = nullptr;
+        }
+
+        if (!isPinned)
+        {
+            bool isHuge = m_useHugePages && blockSize >= HUGE_PAGE_SIZE;
+
+            pointer = std::aligned_alloc(isHuge ? HUGE_PAGE_SIZE : ALIGNMENT, blockSize);
+
+            if (!pointer)
+            {
+                return nullptr;
+            }
+
+#ifdef __linux__
+            if (isHuge)
+            {
+                madvise(pointer, blockSize, MADV_HUGEPAGE);
+            }
+#endif
+        }
+    }
+
+    Block block = {blockSize, (int) node, isPinned, currentCategory, currentOwner};
+    m_hostBlocks[pointer] = block;
+    addUsage(block, true);
+    m_hostSizeInByte += blockSize;
+    m_peakHostSizeInByte = std::max(m_peakHostSizeInByte, m_hostSizeInByte);
+
+    return pointer;
+}
+
+void FreeWill::BlobAllocator::freeHost(void *pointer)
+{
+    if (!pointer)
+    {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    auto block = m_hostBlocks.find(pointer);
+    if (block == m_hostBlocks.end())
+    {
+        std::cerr << "BlobAllocator: freeing unknown host block " << pointer << std::endl;
+        // a double free or a pointer of another allocator
+        assert(false);
+        return;
+    }
+
+    Block freedBlock = block->second;
+    m_hostBlocks.erase(block);
+    removeUsage(freedBlock, true);
+    m_hostSizeInByte -= freedBlock.m_sizeInByte;
+
+    if (m_isCaching)
+    {
+        m_cachedHostBlocks[std::make_tuple(freedBlock.m_isPinned, (unsigned int) freedBlock.m_device, freedBlock.m_sizeInByte)].push_back(pointer);
+        m_cachedSizeInByte += freedBlock.m_sizeInByte;
+    }
+    else if (freedBlock.m_isPinned)
+    {
+        RUN_CUDA(cudaFreeHost(pointer));
+    }
+    else
+    {
+        std::free(pointer);
+    }
+}
+
+bool FreeWill::BlobAllocator::isPinned(void *pointer)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    auto block = m_hostBlocks.find(pointer);
+
+    return block != m_hostBlocks.end() && block->second.m_isPinned;
+}
+
+void *FreeWill::BlobAllocator::allocateDevice(size_t sizeInByte)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    int device = 0;
+    RUN_CUDA(cudaGetDevice(&device));
+
+    size_t blockSize = sizeClass(sizeInByte);
+    bool isManaged = m_useManagedMemory;
+    void *pointer = nullptr;
+
+    // the pages of a managed block stay on the device unless it runs out or they are advised
+    // elsewhere, the host reaches them through the page faults
+    auto allocate = [&]()
+    {
+        if (!isManaged)
+        {
+            return cudaMalloc(&pointer, blockSize);
+        }
+
+        cudaError_t result = cudaMallocManaged(&pointer, blockSize, cudaMemAttachGlobal);
+
+        if (result == cudaSuccess && pointer)
+        {
+            RUN_CUDA(cudaMemAdvise(pointer, blockSize, cudaMemAdviseSetPreferredLocation, device));
+        }
+
+        return result;
+    };
+
+    auto cached = m_cachedDeviceBlocks.find(std::make_tuple(isManaged, device, blockSize));
+    if (cached != m_cachedDeviceBlocks.end() && !cached->second.empty())
+    {
+        pointer = cached->second.back();
+        cached->second.pop_back();
+        m_cachedSizeInByte -= blockSize;
+
+        // a block evicted to the host before it was freed comes back to the device
+        if (isManaged)
+        {
+            RUN_CUDA(cudaMemAdvise(pointer, blockSize, cudaMemAdviseSetPreferredLocation, device));
+        }
+    }
+    else
+    {
+        if (allocate() != cudaSuccess || !pointer)
+        {
+            // cached blocks of other sizes may be what is holding the memory
+            releaseCacheLocked();
+            RUN_CUDA(cudaSetDevice(device));
+            pointer = nullptr;
+            RUN_CUDA(allocate());
+
+            if (!pointer)
+            {
+                return nullptr;
+            }
+        }
+    }
+
+    Block block = {blockSize, device, isManaged, currentCategory, currentOwner};
+    m_deviceBlocks[pointer] = block;
+    addUsage(block, false);
+    m_deviceSizeInByte += blockSize;
+    m_peakDeviceSizeInByte = std::max(m_peakDeviceSizeInByte, m_deviceSizeInByte);
+
+    return pointer;
+}
+
+void FreeWill::BlobAllocator::freeDevice(void *pointer)
+{
+    if (!pointer)
+    {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    auto block = m_deviceBlocks.find(pointer);
+    if (block == m_deviceBlocks.end())
+    {
+        std::cerr << "BlobAllocator: freeing unknown device block " << pointer << std::endl;
+        // a double free or a pointer of another allocator
+        assert(false);
+        return;
+    }
+
+    Block freedBlock = block->second;
+    m_deviceBlocks.erase(block);
+    removeUsage(freedBlock, false);
+    m_deviceSizeInByte -= freedBlock.m_sizeInByte;
+
+    if (m_isCaching)
+    {
+        m_cachedDeviceBlocks[std::make_tuple(freedBlock.m_isPinned, freedBlock.m_device, freedBlock.m_sizeInByte)].push_back(pointer);
+        m_cachedSizeInByte += freedBlock.m_sizeInByte;
+    }
+    else
+    {
+        RUN_CUDA(cudaFree(pointer));
+    }
+}
+
+bool FreeWill::BlobAllocator::isManaged(void *pointer)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    auto block = m_deviceBlocks.find(pointer);
+    return block != m_deviceBlocks.end() && block->second.m_isPinned;
+}
+
+void FreeWill::BlobAllocator::setCaching(bool isCaching)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    m_isCaching = isCaching;
+
+    if (!m_isCaching)
+    {
+        releaseCacheLocked();
+    }
+}
+
+bool FreeWill::BlobAllocator::isCaching() const
+{
+    return m_isCaching;
+}
+
+void FreeWill::BlobAllocator::setHugePages(bool useHugePages)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    m_useHugePages = useHugePages;
+}
+
+void FreeWill::BlobAllocator::setManagedMemory(bool useManagedMemory)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    m_useManagedMemory = useManagedMemory;
+}
+
+bool FreeWill::BlobAllocator::isManagedMemory() const
+{
+    return m_useManagedMemory;
+}
+
+void FreeWill::BlobAllocator::releaseCacheLocked()
+{
+    for (auto iter = m_cachedHostBlocks.begin(); iter != m_cachedHostBlocks.end(); ++iter)
+    {
+        for (void *pointer : iter->second)
+        {
+            if (std::get<0>(iter->first))
+            {
+                RUN_CUDA(cudaFreeHost(pointer));
+            }
+            else
+            {
+                std::free(pointer);
+            }
+        }
+    }
+    m_cachedHostBlocks.clear();
+
+    if (!m_cachedDeviceBlocks.empty())
+    {
+        int currentDevice = 0;
+        RUN_CUDA(cudaGetDevice(&currentDevice));
+
+        for (auto iter = m_cachedDeviceBlocks.begin(); iter != m_cachedDeviceBlocks.end(); ++iter)
+        {
+            RUN_CUDA(cudaSetDevice(std::get<1>(iter->first)));
+            for (void *pointer : iter->second)
+            {
+                RUN_CUDA(cudaFree(pointer));
+            }
+        }
+        m_cachedDeviceBlocks.clear();
+
+        RUN_CUDA(cudaSetDevice(currentDevice));
+    }
+
+    m_cachedSizeInByte = 0;
+}
+
+void FreeWill::BlobAllocator::releaseCache()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    releaseCacheLocked();
+}
+
+size_t FreeWill::BlobAllocator::cachedSizeInByte()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    return m_cachedSizeInByte;
+}
+
+size_t FreeWill::BlobAllocator::hostSizeInByte(int node)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    size_t sizeInByte = 0;
+
+    for (auto iter = m_hostBlocks.begin(); iter != m_hostBlocks.end(); ++iter)
+    {
+        if (node < 0 || iter->second.m_device == node)
+        {
+            sizeInByte += iter->second.m_sizeInByte;
+        }
+    }
+
+    return sizeInByte;
+}
+
+size_t FreeWill::BlobAllocator::deviceSizeInByte(int device)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    size_t sizeInByte = 0;
+
+    for (auto iter = m_deviceBlocks.begin(); iter != m_deviceBlocks.end(); ++iter)
+    {
+        if (device < 0 || iter->second.m_device == device)
+        {
+            sizeInByte += iter->second.m_sizeInByte;
+        }
+    }
+
+    return sizeInByte;
+}
+
+size_t FreeWill::BlobAllocator::peakHostSizeInByte()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    return m_peakHostSizeInByte;
+}
+
+size_t FreeWill::BlobAllocator::peakDeviceSizeInByte()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    return m_peakDeviceSizeInByte;
+}
+
+void FreeWill::BlobAllocator::resetPeakSizes()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    m_peakHostSizeInByte = m_hostSizeInByte;
+    m_peakDeviceSizeInByte = m_deviceSizeInByte;
+
+    for (auto iter = m_usages.begin(); iter != m_usages.end(); ++iter)
+    {
+        iter->second.m_peakSizeInByte = iter->second.m_sizeInByte;
+    }
+}
+
+void FreeWill::BlobAllocator::addUsage(const Block &block, bool isHost)
+{
+    auto inserted = m_usages.insert(std::make_pair(std::make_tuple(isHost, block.m_device, block.m_category), Usage{0, 0}));
+    Usage &usage = inserted.first->second;
+
+    usage.m_sizeInByte += block.m_sizeInByte;
+    usage.m_peakSizeInByte = std::max(usage.m_peakSizeInByte, usage.m_sizeInByte);
+}
+
+void FreeWill::BlobAllocator::removeUsage(const Block &block, bool isHost)
+{
+    m_usages[std::make_tuple(isHost, block.m_device, block.m_category)].m_sizeInByte -= block.m_sizeInByte;
+}
+
+const FreeWill::BlobAllocator::Block *FreeWill::BlobAllocator::findBlock(void *pointer) const
+{
+    auto hostBlock = m_hostBlocks.find(pointer);
+    if (hostBlock != m_hostBlocks.end())
+    {
+        return &hostBlock->second;
+    }
+
+    auto deviceBlock = m_deviceBlocks.find(pointer);
+    if (deviceBlock != m_deviceBlocks.end())
+    {
+        return &deviceBlock->second;
+    }
+
+    return nullptr;
+}
+
+std::vector<FreeWill::MemoryUsage> FreeWill::BlobAllocator::memoryUsage()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    std::vector<MemoryUsage> usages;
+
+    for (auto iter = m_usages.begin(); iter != m_usages.end(); ++iter)
+    {
+        if (iter->second.m_peakSizeInByte > 0)
+        {
+            usages.push_back({std::get<2>(iter->first), std::get<0>(iter->first), std::get<1>(iter->first),
+                              iter->second.m_sizeInByte, iter->second.m_peakSizeInByte});
+        }
+    }
+
+    return usages;
+}
+
+std::map<std::string, size_t> FreeWill::BlobAllocator::ownerSizesInByte()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    std::map<std::string, size_t> sizes;
+
+    for (const std::unordered_map<void*, Block> *blocks : {&m_hostBlocks, &m_deviceBlocks})
+    {
+        for (auto iter = blocks->begin(); iter != blocks->end(); ++iter)
+        {
+            if (!iter->second.m_owner.empty())
+            {
+                sizes[iter->second.m_owner] += iter->second.m_sizeInByte;
+            }
+        }
+    }
+
+    return sizes;
+}
+
+std::string FreeWill::BlobAllocator::owner(void *pointer)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    const Block *block = findBlock(pointer);
+
+    return block ? block->m_owner : std::string();
+}
+
+size_t FreeWill::BlobAllocator::blockSizeInByte(void *pointer)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    const Block *block = findBlock(pointer);
+
+    return block ? block->m_sizeInByte : 0;
+}
+
+const char *FreeWill::BlobAllocator::categoryName(MemoryCategory category)
+{
+    switch (category)
+    {
+    case MemoryCategory::WEIGHT:
+        return "weight";
+    case MemoryCategory::GRADIENT:
+        return "gradient";
+    case MemoryCategory::OPTIMIZER_STATE:
+        return "optimizer state";
+    case MemoryCategory::ACTIVATION:
+        return "activation";
+    case MemoryCategory::WORKSPACE:
+        return "workspace";
+    case MemoryCategory::HOST_MIRROR:
+        return "host mirror";
+    default:
+        return "other";
+    }
+}
@@ -0,0 +1,200 @@
+#ifndef BLOBALLOCATOR_H
+#define BLOBALLOCATOR_H
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace FreeWill
+{
+    // what the bytes of a block are for, see BlobAllocator::Tag
+    enum class MemoryCategory : unsigned int
+    {
+        OTHER,
+        WEIGHT,
+        GRADIENT,
+        // the optimizer state and master copies kept for a weight (see Model::m_companionTensors)
+        OPTIMIZER_STATE,
+        ACTIVATION,
+        WORKSPACE,
+        // the host copies of gpu tensors (see ReferenceCountedBlob::dataHandle)
+        HOST_MIRROR,
+        COUNT
+    };
+
+    // the bytes of one category on one device or NUMA node, see BlobAllocator::memoryUsage
+    struct MemoryUsage
+    {
+        MemoryCategory m_category;
+        bool m_isHost;
+        // the cuda device, or the NUMA node of host memory
+        int m_device;
+        size_t m_sizeInByte;
+        // the most there were since BlobAllocator::resetPeakSizes()
+        size_t m_peakSizeInByte;
+    };
+
+    // Host and device memory behind ReferenceCountedBlob. Host blocks are ALIGNMENT aligned.
+    // With caching on, freed blocks are kept per size class (four classes per power of two)
+    // and handed out again, so rebuilding tensors does not go back to malloc or to cudaMalloc
+    // and cudaFree, which synchronize the device. With huge pages on, host blocks of at least
+    // HUGE_PAGE_SIZE are huge page aligned and advised as such. Pinned host blocks come from
+    // cudaHostAlloc so asynchronous copies from and to them can overlap kernels; when pinning
+    // fails they fall back to pageable memory. Host blocks are first touched by the thread
+    // allocating them, so the cache keeps them apart per NUMA node of that thread (see
+    // CPUTopology) and hands a block out again only on the node it lives on. With managed
+    // memory on, device blocks come from cudaMallocManaged and may outgrow the device, the
+    // driver pages them in and out (see PrefetchSchedule for keeping that off the kernels).
+    //
+    // Every block handed out is filed under a category and an owner, a tensor name for the
+    // tensors of a Model, and the bytes live and at their peak are kept per category and per
+    // device or node.
+    class BlobAllocator
+    {
+    public:
+        static const unsigned int ALIGNMENT = 64;
+        static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+        // While one lives, the device blocks allocated by any thread are managed or not as
+        // given, the setting before it is restored after it (see setManagedMemory)
+        class ManagedMemoryScope
+        {
+        private:
+            bool m_wasManaged;
+
+        public:
+            explicit ManagedMemoryScope(bool isManaged);
+            ~ManagedMemoryScope();
+
+            ManagedMemoryScope(const ManagedMemoryScope &) = delete;
+            void operator=(const ManagedMemoryScope &) = delete;
+        };
+
+        // The blocks the calling thread allocates while a Tag lives are filed under its category
+        // and owner, the others under OTHER without an owner. Tags nest, the innermost counts.
+        class Tag
+        {
+        private:
+            MemoryCategory m_previousCategory;
+            std::string m_previousOwner;
+
+        public:
+            Tag(MemoryCategory category, const std::string &owner);
+            ~Tag();
+
+            Tag(const Tag &) = delete;
+            void operator=(const Tag &) = delete;
+        };
+
+    private:
+        struct Block
+        {
+            size_t m_sizeInByte;
+            // the cuda device, or the NUMA node of a host block
+            int m_device;
+            // a host block page-locked, a device block managed
+            bool m_isPinned;
+            MemoryCategory m_category;
+            std::string m_owner;
+        };
+
+        struct Usage
+        {
+            size_t m_sizeInByte;
+            size_t m_peakSizeInByte;
+        };
+
+        std::mutex m_mutex;
+        std::unordered_map<void*, Block> m_hostBlocks;
+        std::unordered_map<void*, Block> m_deviceBlocks;
+        // pinned, node, size
+        std::map<std::tuple<bool, unsigned int, size_t>, std::vector<void*>> m_cachedHostBlocks;
+        // managed, device, size
+        std::map<std::tuple<bool, int, size_t>, std::vector<void*>> m_cachedDeviceBlocks;
+        size_t m_cachedSizeInByte;
+        // the blocks handed out now and the most there were since resetPeakSizes()
+        size_t m_hostSizeInByte;
+        size_t m_deviceSizeInByte;
+        size_t m_peakHostSizeInByte;
+        size_t m_peakDeviceSizeInByte;
+        // host, node or device, category
+        std::map<std::tuple<bool, int, MemoryCategory>, Usage> m_usages;
+        bool m_isCaching;
+        bool m_useHugePages;
+        bool m_useManagedMemory;
+
+        BlobAllocator();
+        ~BlobAllocator();
+
+        size_t hostBlockSize(size_t sizeInByte) const;
+        void releaseCacheLocked();
+        // files a block handed out or taken back in m_usages
+        void addUsage(const Block &block, bool isHost);
+        void removeUsage(const Block &block, bool isHost);
+        const Block *findBlock(void *pointer) const;
+
+    public:
+        static BlobAllocator &getSingleton();
+
+        BlobAllocator(const BlobAllocator &) = delete;
+        void operator=(const BlobAllocator &) = delete;
+
+        void *allocateHost(size_t sizeInByte, bool isPinned = false);
+        void freeHost(void *pointer);
+        bool isPinned(void *pointer);
+
+        // allocates on the current cuda device
+        void *allocateDevice(size_t sizeInByte);
+        void freeDevice(void *pointer);
+        bool isManaged(void *pointer);
+
+        void setCaching(bool isCaching);
+        bool isCaching() const;
+
+        void setHugePages(bool useHugePages);
+
+        // whether device blocks allocated from now on come from cudaMallocManaged, preferring
+        // the device they are allocated on. The cached blocks of the other kind stay cached.
+        void setManagedMemory(bool useManagedMemory);
+        bool isManagedMemory() const;
+
+        // returns every cached block to the system
+        void releaseCache();
+        size_t cachedSizeInByte();
+
+        // the bytes of the blocks handed out and not freed, the cached ones aren't counted.
+        // node and device pick the host blocks of one NUMA node and the blocks of one cuda
+        // device, -1 counts them all.
+        size_t hostSizeInByte(int node = -1);
+        size_t deviceSizeInByte(int device = -1);
+
+        // the most hostSizeInByte() and deviceSizeInByte() of all nodes and devices reached
+        // since the last resetPeakSizes(), which starts over from what is live
+        size_t peakHostSizeInByte();
+        size_t peakDeviceSizeInByte();
+        void resetPeakSizes();
+
+        // the bytes of every category on every device and node that had any since the last
+        // resetPeakSizes(), live and at their peak
+        std::vector<MemoryUsage> memoryUsage();
+
+        // the live bytes per owner, the blocks without one are left out
+        std::map<std::string, size_t> ownerSizesInByte();
+
+        // the owner and the size of the block at pointer, a host or a device one. Empty and 0 for
+        // a pointer that isn't the start of a block handed out.
+        std::string owner(void *pointer);
+        size_t blockSizeInByte(void *pointer);
+
+        static const char *categoryName(MemoryCategory category);
+
+        static size_t sizeClass(size_t sizeInByte);
+    };
+}
+
+#endif
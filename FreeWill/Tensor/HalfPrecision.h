@@ -0,0 +1,250 @@
+#ifndef HALFPRECISION_H
+#define HALFPRECISION_H
+
+#include <cuda_runtime.h>
+#include <cstdint>
+#include <cstring>
+
+// shared with the cuda kernels, keep it c++11
+
+namespace FreeWill
+{
+    // 16-bit storage types. They convert to and from float with round to nearest even, the
+    // arithmetic is done in float (see ComputeType), so they only ever hold stored values.
+    // The layouts match cuda's __half and __nv_bfloat16.
+
+    __host__ __device__ inline uint32_t floatBits(float value)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    __host__ __device__ inline float floatFromBits(uint32_t bits)
+    {
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    __host__ __device__ inline uint16_t floatToHalfBits(float value)
+    {
+        uint32_t bits = floatBits(value);
+        uint32_t sign = (bits >> 16) & 0x8000;
+        uint32_t exponent = (bits >> 23) & 0xff;
+        uint32_t mantissa = bits & 0x7fffff;
+
+        if (exponent == 0xff)
+        {
+            return (uint16_t) (sign | 0x7c00 | (mantissa ? 0x200 : 0));
+        }
+
+        int halfExponent = (int) exponent - 127 + 15;
+
+        if (halfExponent >= 0x1f)
+        {
+            return (uint16_t) (sign | 0x7c00);
+        }
+
+        if (halfExponent <= 0)
+        {
+            // subnormal half, or zero once the value is below half the smallest one
+            if (halfExponent < -10)
+            {
+                return (uint16_t) sign;
+            }
+
+            mantissa |= 0x800000;
+            uint32_t shift = 14 - halfExponent;
+            uint32_t result = mantissa >> shift;
+            uint32_t remainder = mantissa & ((1u << shift) - 1);
+            uint32_t halfway = 1u << (shift - 1);
+
+            if (remainder > halfway || (remainder == halfway && (result & 1)))
+            {
+                ++result;
+            }
+
+            return (uint16_t) (sign | result);
+        }
+
+        uint32_t result = ((uint32_t) halfExponent << 10) | (mantissa >> 13);
+        uint32_t remainder = mantissa & 0x1fff;
+
+        // a carry out of the mantissa correctly rounds up into the exponent, up to infinity
+        if (remainder > 0x1000 || (remainder == 0x1000 && (result & 1)))
+        {
+            ++result;
+        }
+
+        return (uint16_t) (sign | result);
+    }
+
+    __host__ __device__ inline float halfBitsToFloat(uint16_t halfBits)
+    {
+        uint32_t sign = ((uint32_t) halfBits & 0x8000) << 16;
+        int exponent = (halfBits >> 10) & 0x1f;
+        uint32_t mantissa = halfBits & 0x3ff;
+
+        if (exponent == 0x1f)
+        {
+            return floatFromBits(sign | 0x7f800000 | (mantissa << 13));
+        }
+
+        if (exponent == 0)
+        {
+            if (mantissa == 0)
+            {
+                return floatFromBits(sign);
+            }
+
+            exponent = 1;
+            while (!(mantissa & 0x400))
+            {
+                mantissa <<= 1;
+                --exponent;
+            }
+            mantissa &= 0x3ff;
+        }
+
+        return floatFromBits(sign | ((uint32_t) (exponent + 127 - 15) << 23) | (mantissa << 13));
+    }
+
+    __host__ __device__ inline uint16_t floatToBFloat16Bits(float value)
+    {
+        uint32_t bits = floatBits(value);
+
+        if ((bits & 0x7fffffff) > 0x7f800000)
+        {
+            return (uint16_t) ((bits >> 16) | 0x40);
+        }
+
+        return (uint16_t) ((bits + 0x7fff + ((bits >> 16) & 1)) >> 16);
+    }
+
+    __host__ __device__ inline float bfloat16BitsToFloat(uint16_t bfloat16Bits)
+    {
+        return floatFromBits((uint32_t) bfloat16Bits << 16);
+    }
+
+    struct Half
+    {
+        uint16_t m_bits;
+
+        Half() = default;
+
+        __host__ __device__ Half(float value)
+            :m_bits(floatToHalfBits(value))
+        {}
+
+        __host__ __device__ operator float() const
+        {
+            return halfBitsToFloat(m_bits);
+        }
+
+        __host__ __device__ Half &operator+=(float value)
+        {
+            m_bits = floatToHalfBits(halfBitsToFloat(m_bits) + value);
+            return *this;
+        }
+
+        __host__ __device__ Half &operator-=(float value)
+        {
+            m_bits = floatToHalfBits(halfBitsToFloat(m_bits) - value);
+            return *this;
+        }
+
+        __host__ __device__ Half &operator*=(float value)
+        {
+            m_bits = floatToHalfBits(halfBitsToFloat(m_bits) * value);
+            return *this;
+        }
+
+        __host__ __device__ Half &operator/=(float value)
+        {
+            m_bits = floatToHalfBits(halfBitsToFloat(m_bits) / value);
+            return *this;
+        }
+    };
+
+    struct BFloat16
+    {
+        uint16_t m_bits;
+
+        BFloat16() = default;
+
+        __host__ __device__ BFloat16(float value)
+            :m_bits(floatToBFloat16Bits(value))
+        {}
+
+        __host__ __device__ operator float() const
+        {
+            return bfloat16BitsToFloat(m_bits);
+        }
+
+        __host__ __device__ BFloat16 &operator+=(float value)
+        {
+            m_bits = floatToBFloat16Bits(bfloat16BitsToFloat(m_bits) + value);
+            return *this;
+        }
+
+        __host__ __device__ BFloat16 &operator-=(float value)
+        {
+            m_bits = floatToBFloat16Bits(bfloat16BitsToFloat(m_bits) - value);
+            return *this;
+        }
+
+        __host__ __device__ BFloat16 &operator*=(float value)
+        {
+            m_bits = floatToBFloat16Bits(bfloat16BitsToFloat(m_bits) * value);
+            return *this;
+        }
+
+        __host__ __device__ BFloat16 &operator/=(float value)
+        {
+            m_bits = floatToBFloat16Bits(bfloat16BitsToFloat(m_bits) / value);
+            return *this;
+        }
+    };
+
+    static_assert(sizeof(Half) == 2 && sizeof(BFloat16) == 2, "16-bit storage types must stay 16 bits");
+
+    // the type sums, products and optimizer state of a storage type are kept in
+    template<typename DataType>
+    struct ComputeType
+    {
+        typedef DataType Type;
+    };
+
+    template<>
+    struct ComputeType<Half>
+    {
+        typedef float Type;
+    };
+
+    template<>
+    struct ComputeType<BFloat16>
+    {
+        typedef float Type;
+    };
+
+    template<typename DataType>
+    struct IsReducedPrecision
+    {
+        static const bool value = false;
+    };
+
+    template<>
+    struct IsReducedPrecision<Half>
+    {
+        static const bool value = true;
+    };
+
+    template<>
+    struct IsReducedPrecision<BFloat16>
+    {
+        static const bool value = true;
+    };
+}
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#include <cuda_runtime.h>
+#include <stdint.h>
+#include <math.h>
+
+// shared with the cuda kernels, keep it c++11
+
+namespace FreeWill
+{
+    // Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3"), a counter
+    // based generator: the 128 random bits of a block are a pure function of the seed (the key),
+    // the stream and the block index (the counter), so any element can be drawn on its own, on
+    // any thread or device, and the result never depends on how the work was split.
+    struct PhiloxBlock
+    {
+        uint32_t m_words[4];
+    };
+
+    __host__ __device__ inline uint32_t philoxMultiplyHigh(uint32_t a, uint32_t b, uint32_t &low)
+    {
+        uint64_t product = (uint64_t) a * b;
+        low = (uint32_t) product;
+        return (uint32_t) (product >> 32);
+    }
+
+    // counter {block low, block high, stream low, stream high}, key {seed low, seed high}
+    __host__ __device__ inline PhiloxBlock philox4x32(uint64_t seed, uint64_t stream, uint64_t block)
+    {
+        uint32_t x0 = (uint32_t) block;
+        uint32_t x1 = (uint32_t) (block >> 32);
+        uint32_t x2 = (uint32_t) stream;
+        uint32_t x3 = (uint32_t) (stream >> 32);
+        uint32_t k0 = (uint32_t) seed;
+        uint32_t k1 = (uint32_t) (seed >> 32);
+
+        for (unsigned int round = 0; round < 10; ++round)
+        {
+            uint32_t low0, low1;
+            uint32_t high0 = philoxMultiplyHigh(0xD2511F53u, x0, low0);
+            uint32_t high1 = philoxMultiplyHigh(0xCD9E8D57u, x2, low1);
+
+            x0 = high1 ^ x1 ^ k0;
+            x1 = low1;
+            x2 = high0 ^ x3 ^ k1;
+            x3 = low0;
+
+            k0 += 0x9E3779B9u;
+            k1 += 0xBB67AE85u;
+        }
+
+        PhiloxBlock result = {{x0, x1, x2, x3}};
+        return result;
+    }
+
+    // uniform in (0, 1], never 0 so its log is finite
+    __host__ __device__ inline float philoxUniformFloat(uint32_t bits)
+    {
+        return (float) ((bits >> 8) + 1) * (1.0f / 16777216.0f);
+    }
+
+    __host__ __device__ inline double philoxUniformDouble(uint32_t high, uint32_t low)
+    {
+        uint64_t bits = ((uint64_t) high << 21) ^ (low >> 11);
+        return (double) (bits + 1) * (1.0 / 9007199254740992.0);
+    }
+
+    // The standard normals of one block through Box-Muller, 4 float or 2 double. transform()
+    // is apart from the generator so a cpu loop can draw the bits of many blocks at once.
+    template<typename DataType>
+    struct PhiloxNormal
+    {
+        static const unsigned int PER_BLOCK = 4;
+
+        __host__ __device__ static void transform(const PhiloxBlock &bits, float *normals)
+        {
+            for (unsigned int i = 0; i < 4; i += 2)
+            {
+                float radius = sqrtf(-2.0f * logf(philoxUniformFloat(bits.m_words[i])));
+                float angle = 6.28318530717958647692f * philoxUniformFloat(bits.m_words[i + 1]);
+
+                normals[i] = radius * cosf(angle);
+                normals[i + 1] = radius * sinf(angle);
+            }
+        }
+
+        __host__ __device__ static void generate(uint64_t seed, uint64_t stream, uint64_t block, float *normals)
+        {
+            transform(philox4x32(seed, stream, block), normals);
+        }
+    };
+
+    template<>
+    struct PhiloxNormal<double>
+    {
+        static const unsigned int PER_BLOCK = 2;
+
+        __host__ __device__ static void transform(const PhiloxBlock &bits, double *normals)
+        {
+            double radius = sqrt(-2.0 * log(philoxUniformDouble(bits.m_words[0], bits.m_words[1])));
+            double angle = 6.28318530717958647692 * philoxUniformDouble(bits.m_words[2], bits.m_words[3]);
+
+            normals[0] = radius * cos(angle);
+            normals[1] = radius * sin(angle);
+        }
+
+        __host__ __device__ static void generate(uint64_t seed, uint64_t stream, uint64_t block, double *normals)
+        {
+            transform(philox4x32(seed, stream, block), normals);
+        }
+    };
+}
+
+#endif
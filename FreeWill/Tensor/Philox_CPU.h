@@ -0,0 +1,69 @@
+#ifndef PHILOX_CPU_H
+#define PHILOX_CPU_H
+
+#include <algorithm>
+#include <cstddef>
+
+#include "Philox.h"
+#include "HalfPrecision.h"
+#include "../Context/ThreadPool.h"
+
+namespace FreeWill
+{
+    // size standard normals of stream into output, element i from block i / PER_BLOCK, in chunks
+    // on the ThreadPool. Every element is the same whatever the thread count.
+    template<typename DataType>
+    void randomNormalCPU(DataType *output, size_t size, uint64_t seed, uint64_t stream)
+    {
+        typedef typename ComputeType<DataType>::Type ComputeDataType;
+        typedef PhiloxNormal<ComputeDataType> Normal;
+
+        // the bits of BATCH blocks are drawn in one loop the compiler vectorizes, then transformed
+        const unsigned int BATCH = 64;
+        const size_t CHUNK = 16384;
+        static_assert(CHUNK % (BATCH * Normal::PER_BLOCK) == 0, "chunks start at a batch");
+
+        auto generate = [&](size_t begin, size_t end)
+        {
+            PhiloxBlock bits[BATCH];
+            ComputeDataType normals[BATCH * Normal::PER_BLOCK];
+
+            for (size_t i = begin; i < end; i += BATCH * Normal::PER_BLOCK)
+            {
+                uint64_t firstBlock = i / Normal::PER_BLOCK;
+
+                for (unsigned int b = 0; b < BATCH; ++b)
+                {
+                    bits[b] = philox4x32(seed, stream, firstBlock + b);
+                }
+
+                for (unsigned int b = 0; b < BATCH; ++b)
+                {
+                    Normal::transform(bits[b], normals + b * Normal::PER_BLOCK);
+                }
+
+                size_t count = std::min((size_t) BATCH * Normal::PER_BLOCK, end - i);
+                for (size_t j = 0; j < count; ++j)
+                {
+                    output[i + j] = normals[j];
+                }
+            }
+        };
+
+        ThreadPool &threadPool = ThreadPool::getSingleton();
+
+        if (threadPool.threadCount() == 0 || size < CHUNK * 4)
+        {
+            generate(0, size);
+            return;
+        }
+
+        unsigned int chunkCount = (unsigned int) ((size + CHUNK - 1) / CHUNK);
+        threadPool.parallelFor(0, chunkCount, 1, [&](unsigned int begin, unsigned int end)
+        {
+            generate(begin * CHUNK, std::min(size, end * CHUNK));
+        });
+    }
+}
+
+#endif
@@ -0,0 +1,50 @@
+#include "Philox_CUDA.h"
+#include "Philox.h"
+#include "HalfPrecision.h"
+#include "../DeviceSelection.h"
+#include "../Context/ComputeStream.h"
+#include <cuda_runtime.h>
+
+template <typename DataType>
+__global__ void randomNormal(DataType *output, unsigned int size, uint64_t seed, uint64_t stream)
+{
+    typedef typename FreeWill::ComputeType<DataType>::Type ComputeDataType;
+    typedef FreeWill::PhiloxNormal<ComputeDataType> Normal;
+
+    unsigned int block = blockIdx.x * blockDim.x + threadIdx.x;
+    unsigned int first = block * Normal::PER_BLOCK;
+
+    if (first < size)
+    {
+        ComputeDataType normals[Normal::PER_BLOCK];
+        Normal::generate(seed, stream, block, normals);
+
+        for (unsigned int i = 0; i < Normal::PER_BLOCK && first + i < size; ++i)
+        {
+            output[first + i] = (DataType) normals[i];
+        }
+    }
+}
+
+template <typename DataType>
+__host__ void randomNormalCUDAKernel(DataType *output, unsigned int size, uint64_t seed, uint64_t stream)
+{
+    typedef typename FreeWill::ComputeType<DataType>::Type ComputeDataType;
+
+    int blockSize = 256;
+    unsigned int threadCount = (size + FreeWill::PhiloxNormal<ComputeDataType>::PER_BLOCK - 1) / FreeWill::PhiloxNormal<ComputeDataType>::PER_BLOCK;
+    int gridSize = (threadCount + blockSize - 1) / blockSize;
+
+    if (gridSize == 0)
+    {
+        return;
+    }
+
+    randomNormal<DataType><<<gridSize, blockSize, 0, FreeWill::computeStream()>>>(output, size, seed, stream);
+    CHECK_CUDA_ERROR
+}
+
+template __host__ void randomNormalCUDAKernel(float *output, unsigned int size, uint64_t seed, uint64_t stream);
+template __host__ void randomNormalCUDAKernel(double *output, unsigned int size, uint64_t seed, uint64_t stream);
+template __host__ void randomNormalCUDAKernel(FreeWill::Half *output, unsigned int size, uint64_t seed, uint64_t stream);
+template __host__ void randomNormalCUDAKernel(FreeWill::BFloat16 *output, unsigned int size, uint64_t seed, uint64_t stream);
@@ -0,0 +1,13 @@
+#ifndef PHILOX_CUDA_H
+#define PHILOX_CUDA_H
+
+#include <cuda_runtime.h>
+#include <stdint.h>
+
+// shared with the cuda kernels, keep it c++11
+
+// size standard normals of stream into output, the same blocks as randomNormalCPU, one per thread
+template <typename DataType = float>
+__host__ void randomNormalCUDAKernel(DataType *output, unsigned int size, uint64_t seed, uint64_t stream);
+
+#endif
@@ -1,76 +1,57 @@
 #ifndef RANDOMNUMBERGENERATOR_H
 #define RANDOMNUMBERGENERATOR_H
 
-#include <iostream>
-#include <string>
-#include <fstream>
-#include <ctime>
-#include <random>
+#include <atomic>
+#include <cstdint>
 
 namespace FreeWill
 {
+    // Hands out the seed and the streams of the counter based generator (see Philox.h). A stream
+    // is an independent sequence: every randomly initialized tensor and every stochastic
+    // operator takes one from newStream(), and a number drawn depends only on the seed, the
+    // stream and its index. The same seed and the same order of newStream() calls give the same
+    // numbers whatever the thread count or the device.
     class RandomNumberGenerator
     {
-        std::fstream m_fileStream;
-        unsigned int m_bytesProcessed;
+        std::atomic<uint64_t> m_seed;
+        std::atomic<uint64_t> m_streamCount;
 
-        RandomNumberGenerator()
-            :m_fileStream(),
-              m_bytesProcessed(0),
-              m_isRecording(false),
-              m_isReplaying(false)
-        {}
+        RandomNumberGenerator();
         ~RandomNumberGenerator(){}
 
-        bool m_isRecording;
-        bool m_isReplaying;
-
-        int m_debug;
-
     public:
+        // the low bits of a stream are left to the devices, see deviceStream
+        static const unsigned int DEVICE_STREAM_BITS = 16;
+
         static RandomNumberGenerator &getSingleton()
         {
             static RandomNumberGenerator obj;
             return obj;
         }
 
-        template<typename DataType = float>
-        DataType getRandom()
-        {
-            DataType value = 0;
-
-            if (m_isReplaying)
-            {
-                m_fileStream.read((char*)&value, sizeof(value));
-
-                m_bytesProcessed += sizeof(value);
-
-                return value;
-            }
-
-            static std::mt19937 gen(std::time(NULL));
-            std::normal_distribution<DataType> normDis(0, 1);
-
-            value = normDis(gen);
+        RandomNumberGenerator(const RandomNumberGenerator &) = delete;
+        void operator=(const RandomNumberGenerator &) = delete;
 
-            //std::cerr << "rand:" << m_debug++ << std::endl;
+        uint64_t seed() const
+        {
+            return m_seed.load(std::memory_order_relaxed);
+        }
 
-            if (m_isRecording)
-            {
-                m_fileStream.write((char*)&value, sizeof(value));
-            }
+        // seeded from the clock until this is called, it also restarts the streams so a run
+        // seeded the same draws the same numbers
+        void setSeed(uint64_t seed);
 
-            return value;
+        uint64_t newStream()
+        {
+            return (m_streamCount.fetch_add(1, std::memory_order_relaxed) + 1) << DEVICE_STREAM_BITS;
         }
 
-        void beginRecording(const std::string &filename);
-        void endRecording();
-
-        void beginReplay(const std::string &filename);
-        void endReplay();
+        // the stream of stream that deviceIndex draws from when the devices need different numbers
+        static uint64_t deviceStream(uint64_t stream, unsigned int deviceIndex)
+        {
+            return stream + deviceIndex;
+        }
     };
-
-
 }
 
 #endif
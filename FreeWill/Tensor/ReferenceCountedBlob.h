@@ -2,6 +2,7 @@
 #define REFERENCECOUNTEDBLOB_H
 
 #include "DeviceSelection.h"
+#include "BlobAllocator.h"
 #include <cstring>
 #include <algorithm>
 #include <random>
@@ -9,6 +10,7 @@
 
 #include <cuda_runtime.h>
 #include <cstdint>
+#include <atomic>
 
 
 
@@ -23,12 +25,18 @@ namespace FreeWill
     template <DeviceType DeviceUsed>
     class TensorBase;
 
+    // Shared by the blobs of one allocation. On gpu it also keeps the host mirror of the whole
+    // allocation, which the first blob needing one allocates (see ReferenceCountedBlob::dataHandle).
+    // The count is atomic, the models sharing weights (see SharedWeights) drop theirs on any thread.
     class ReferenceCounter
     {
     private:
-        unsigned int counter;
+        std::atomic<unsigned int> counter{0};
 
     public:
+        unsigned char *m_hostMirror = nullptr;
+        unsigned int m_allocationSizeInByte = 0;
+
         unsigned int increase()
         {
             return ++ counter;
@@ -51,16 +59,47 @@ namespace FreeWill
 
         void *m_gpuDataHandle;
 
+        // non zero when the blob is a window into a larger allocation (see alias())
+        unsigned int m_offset;
+
+        // the host memory belongs to the caller (see bindHost()) and is never freed here
+        bool m_isHostBound;
+
+        // The host memory of the blob: the caller's when bound, on cpu its own allocation, on gpu
+        // the mirror of the allocation or null while there is none.
+        unsigned char *hostData() const
+        {
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                if (!m_isHostBound)
+                {
+                    return m_referenceCounter->m_hostMirror ? m_referenceCounter->m_hostMirror + m_offset : nullptr;
+                }
+            }
+
+            return m_dataHandle;
+        }
+
         void cleanup()
         {
             if (m_referenceCounter->decrease() == 0)
             {
-                free(m_dataHandle);
-                if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+                if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
+                {
+                    if (m_dataHandle && !m_isHostBound)
+                    {
+                        BlobAllocator::getSingleton().freeHost(m_dataHandle - m_offset);
+                    }
+                }
+                else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
                 {
+                    if (m_referenceCounter->m_hostMirror)
+                    {
+                        BlobAllocator::getSingleton().freeHost(m_referenceCounter->m_hostMirror);
+                    }
                     if (m_gpuDataHandle)
                     {
-                        RUN_CUDA(cudaFree(m_gpuDataHandle))
+                        BlobAllocator::getSingleton().freeDevice((unsigned char *) m_gpuDataHandle - m_offset);
                     }
                 }
                 delete m_referenceCounter;
@@ -68,6 +107,9 @@ namespace FreeWill
            
             m_referenceCounter = nullptr;
             m_dataHandle = nullptr;
+            m_gpuDataHandle = nullptr;
+            m_offset = 0;
+            m_isHostBound = false;
             m_sizeInByte = 0;
         }
 
@@ -76,7 +118,9 @@ namespace FreeWill
             :m_sizeInByte(0),
             m_referenceCounter(nullptr),
             m_dataHandle(nullptr),
-            m_gpuDataHandle(nullptr)
+            m_gpuDataHandle(nullptr),
+            m_offset(0),
+            m_isHostBound(false)
         {
             m_referenceCounter = new ReferenceCounter();
             m_referenceCounter->increase();
@@ -86,14 +130,18 @@ namespace FreeWill
             :m_sizeInByte(0),
             m_referenceCounter(nullptr),
             m_dataHandle(nullptr),
-            m_gpuDataHandle(nullptr)
+            m_gpuDataHandle(nullptr),
+            m_offset(0),
+            m_isHostBound(false)
         {
-            if (blob.m_dataHandle) 
+            if (blob.m_dataHandle || blob.m_gpuDataHandle)
             {
                 m_referenceCounter = blob.m_referenceCounter;
                 m_sizeInByte = blob.m_sizeInByte;
                 m_dataHandle = blob.m_dataHandle;
                 m_gpuDataHandle = blob.m_gpuDataHandle;
+                m_offset = blob.m_offset;
+                m_isHostBound = blob.m_isHostBound;
                 m_referenceCounter->increase();
             }
             else
@@ -105,7 +153,10 @@ namespace FreeWill
 
         void clear()
         {
-            std::memset(m_dataHandle, 0, m_sizeInByte);
+            if (unsigned char *host = hostData())
+            {
+                std::memset(host, 0, m_sizeInByte);
+            }
 
             if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
             {
@@ -113,21 +164,91 @@ namespace FreeWill
             }
         }
 
-        unsigned char * dataHandle() 
+        // drops this reference, the memory goes with the last one
+        void release()
         {
-            return m_dataHandle;
+            cleanup();
+            m_referenceCounter = new ReferenceCounter();
+            m_referenceCounter->increase();
+        }
+
+        // on gpu the host mirror is allocated here the first time, page-locked so the async
+        // copies really are async
+        unsigned char * dataHandle()
+        {
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                if (!m_isHostBound && !m_referenceCounter->m_hostMirror && m_gpuDataHandle)
+                {
+                    unsigned int sizeInByte = m_referenceCounter->m_allocationSizeInByte;
+                    // filed under the owner of the device memory it mirrors
+                    BlobAllocator::Tag tag(MemoryCategory::HOST_MIRROR, BlobAllocator::getSingleton().owner(allocationHandle()));
+                    m_referenceCounter->m_hostMirror = (unsigned char *) BlobAllocator::getSingleton().allocateHost(sizeInByte, true);
+
+                    if (m_referenceCounter->m_hostMirror)
+                    {
+                        std::memset(m_referenceCounter->m_hostMirror, 0, sizeInByte);
+                    }
+                }
+            }
+
+            return hostData();
+        }
+
+        bool hasHostMirror() const
+        {
+            return hostData() != nullptr;
+        }
+
+        // Gpu only: frees the host mirror of the allocation, for every blob sharing it. The host
+        // pointers taken before are dangling, the next dataHandle() allocates a new, zeroed one.
+        void freeHostMirror()
+        {
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                if (!m_isHostBound && m_referenceCounter->m_hostMirror)
+                {
+                    BlobAllocator::getSingleton().freeHost(m_referenceCounter->m_hostMirror);
+                    m_referenceCounter->m_hostMirror = nullptr;
+                }
+            }
+        }
+
+        // The start of the allocation the blob is part of, host memory on cpu and device memory on
+        // gpu, and on gpu its host mirror. Null when there is none or it belongs to the caller.
+        void *allocationHandle() const
+        {
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                return m_gpuDataHandle ? (unsigned char *) m_gpuDataHandle - m_offset : nullptr;
+            }
+
+            return m_dataHandle && !m_isHostBound ? m_dataHandle - m_offset : nullptr;
+        }
+
+        void *hostMirrorHandle() const
+        {
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                if (!m_isHostBound && m_referenceCounter)
+                {
+                    return m_referenceCounter->m_hostMirror;
+                }
+            }
+
+            return nullptr;
         }
 
         unsigned char * gpuDataHandle()
         {
-            return m_gpuDataHandle;
+            return (unsigned char *) m_gpuDataHandle;
         }
 
         bool alloc(unsigned int sizeInByte)
         {
             if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
             {
-                m_dataHandle = (unsigned char *) malloc(sizeInByte);
+                m_dataHandle = (unsigned char *) BlobAllocator::getSingleton().allocateHost(sizeInByte);
                 if (m_dataHandle) 
                 {
                     m_sizeInByte = sizeInByte;
@@ -145,28 +266,18 @@ namespace FreeWill
             } 
             else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
             {
-                RUN_CUDA(cudaMalloc(&m_gpuDataHandle, sizeInByte));
-                m_dataHandle = (unsigned char *) malloc(sizeInByte);
-                if (m_gpuDataHandle && m_dataHandle)
+                // the host mirror waits for the first dataHandle()
+                m_gpuDataHandle = BlobAllocator::getSingleton().allocateDevice(sizeInByte);
+                if (m_gpuDataHandle)
                 {
                     m_sizeInByte = sizeInByte;
-                    
+                    m_referenceCounter->m_allocationSizeInByte = sizeInByte;
+
                     RUN_CUDA(cudaMemset(m_gpuDataHandle, 0, sizeInByte));
-                    std::memset(m_dataHandle, 0, sizeInByte);
                     return true;
                 }
                 else
                 {
-                    if (m_gpuDataHandle)
-                    {
-                        RUN_CUDA(cudaFree(m_gpuDataHandle));
-                        m_gpuDataHandle = nullptr;
-                    }
-                    if (m_dataHandle)
-                    {
-                        std::free(m_dataHandle);
-                        m_dataHandle = nullptr;
-                    }
                     return false;
                 }
             }
@@ -197,7 +308,10 @@ namespace FreeWill
             }
             else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
             {
-                std::copy(m_dataHandle, m_dataHandle + m_sizeInByte, copy.m_dataHandle);
+                if (unsigned char *host = hostData())
+                {
+                    std::copy(host, host + m_sizeInByte, copy.dataHandle());
+                }
                 RUN_CUDA(cudaMemcpy(copy.m_gpuDataHandle, m_gpuDataHandle, m_sizeInByte, cudaMemcpyDeviceToDevice));
             }
 
@@ -215,6 +329,8 @@ namespace FreeWill
                     m_referenceCounter->increase();
                     m_sizeInByte = blob.m_sizeInByte;
                     m_dataHandle = blob.m_dataHandle;
+                    m_offset = blob.m_offset;
+                    m_isHostBound = blob.m_isHostBound;
                 }
             }
             else if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
@@ -227,10 +343,81 @@ namespace FreeWill
                     m_sizeInByte = blob.m_sizeInByte;
                     m_dataHandle = blob.m_dataHandle;
                     m_gpuDataHandle = blob.m_gpuDataHandle;
+                    m_offset = blob.m_offset;
+                    m_isHostBound = blob.m_isHostBound;
                 }
             }
         }
 
+        // Share sizeInByte bytes of arena starting at offset. The arena stays allocated as
+        // long as any blob aliasing it is alive.
+        bool alias(const ReferenceCountedBlob<DeviceUsed> &arena, unsigned int offset, unsigned int sizeInByte)
+        {
+            if (!(DeviceUsed == DeviceType::GPU_CUDA ? arena.m_gpuDataHandle : arena.m_dataHandle) || offset + sizeInByte > arena.m_sizeInByte)
+            {
+                return false;
+            }
+
+            cleanup();
+            m_referenceCounter = arena.m_referenceCounter;
+            m_referenceCounter->increase();
+            m_sizeInByte = sizeInByte;
+            m_offset = arena.m_offset + offset;
+            m_isHostBound = arena.m_isHostBound;
+            m_dataHandle = arena.m_dataHandle ? arena.m_dataHandle + offset : nullptr;
+
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                m_gpuDataHandle = (unsigned char *) arena.m_gpuDataHandle + offset;
+            }
+
+            return true;
+        }
+
+        // Views sizeInByte bytes of caller owned host memory instead of a copy of them, the
+        // memory held so far is dropped. The caller keeps data alive for as long as the blob
+        // uses it. On gpu the blob keeps device memory of its own, the host side is bound and
+        // copyFromHostToDevice() uploads straight from data. Binding a blob that is bound
+        // already only swaps the pointer.
+        bool bindHost(unsigned char *data, unsigned int sizeInByte)
+        {
+            if (!data || sizeInByte == 0)
+            {
+                return false;
+            }
+
+            if (m_isHostBound && sizeInByte == m_sizeInByte)
+            {
+                m_dataHandle = data;
+                return true;
+            }
+
+            cleanup();
+            m_referenceCounter = new ReferenceCounter();
+            m_referenceCounter->increase();
+
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                m_gpuDataHandle = BlobAllocator::getSingleton().allocateDevice(sizeInByte);
+
+                if (!m_gpuDataHandle)
+                {
+                    return false;
+                }
+            }
+
+            m_dataHandle = data;
+            m_sizeInByte = sizeInByte;
+            m_isHostBound = true;
+
+            return true;
+        }
+
+        bool isHostBound() const
+        {
+            return m_isHostBound;
+        }
+
         bool operator==(const ReferenceCountedBlob<DeviceUsed> &blob) const 
         {
             if constexpr (DeviceUsed == DeviceType::CPU_NAIVE)
@@ -247,7 +434,11 @@ namespace FreeWill
         {
             if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
             {
-                RUN_CUDA(cudaMemcpy(m_gpuDataHandle, m_dataHandle, m_sizeInByte, cudaMemcpyHostToDevice));
+                // nothing was written on the host without a mirror
+                if (unsigned char *host = hostData())
+                {
+                    RUN_CUDA(cudaMemcpy(m_gpuDataHandle, host, m_sizeInByte, cudaMemcpyHostToDevice));
+                }
             }
         }
 
@@ -255,15 +446,41 @@ namespace FreeWill
         {
             if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
             {
-                RUN_CUDA(cudaMemcpy(m_dataHandle, m_gpuDataHandle, m_sizeInByte, cudaMemcpyDeviceToHost));
+                RUN_CUDA(cudaMemcpy(dataHandle(), m_gpuDataHandle, m_sizeInByte, cudaMemcpyDeviceToHost));
+            }
+        }
+
+        // Queue the copy on stream and return right away. The host mirror must not be touched
+        // until the copy has completed, e.g. by synchronizing on an event recorded after it.
+        void copyFromHostToDeviceAsync(cudaStream_t stream)
+        {
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                if (unsigned char *host = hostData())
+                {
+                    RUN_CUDA(cudaMemcpyAsync(m_gpuDataHandle, host, m_sizeInByte, cudaMemcpyHostToDevice, stream));
+                }
+            }
+        }
+
+        void copyFromDeviceToHostAsync(cudaStream_t stream)
+        {
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                RUN_CUDA(cudaMemcpyAsync(dataHandle(), m_gpuDataHandle, m_sizeInByte, cudaMemcpyDeviceToHost, stream));
             }
         }
 
+        bool isHostPinned() const
+        {
+            return hostData() && !m_isHostBound && BlobAllocator::getSingleton().isPinned(hostData() - m_offset);
+        }
+
         unsigned char operator[](unsigned int index) const
         {
-            if (m_dataHandle && index < m_sizeInByte)
+            if (hostData() && index < m_sizeInByte)
             {
-                return *(m_dataHandle + index);
+                return *(hostData() + index);
             }
             return 0;
         }
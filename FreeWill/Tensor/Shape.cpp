@@ -1,23 +1,16 @@
 #include "Shape.h"
 #include <cstdio>
+#include <iostream>
 
 namespace FreeWill
 {
-	Shape operator+(const Shape &in, unsigned int batchSize)
+    void Shape::invalidate(unsigned int dimension)
     {
-        if (batchSize > 0)
-        {
-            Shape shape;
-
-            shape.m_dim = new unsigned int[in.dimension() + 1];
-            std::copy(in.m_dim, in.m_dim + in.dimension(), shape.m_dim);
-            shape.m_dim[in.dimension()] = batchSize;
-            shape.m_count = in.dimension() + 1;
-
-            return shape;
-        }
+        std::cerr << "a shape of " << dimension << " dimensions is past the " << MAX_DIMENSION << " a shape keeps" << std::endl;
 
-        return in;
+        m_count = 0;
+        m_size = 0;
+        m_isValid = false;
     }
 
     std::ostream& operator<< (std::ostream& stream, Shape const &shape)
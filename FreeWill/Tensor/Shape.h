@@ -8,90 +8,117 @@
 
 namespace FreeWill
 {
+    // The extents of a tensor, first dimension innermost, stored inline for up to
+    // MAX_DIMENSION dimensions so building and copying one never allocates. The element count
+    // and the contiguous strides are kept up to date by every change, which is why extents are
+    // written through set() rather than a reference. Everything is constexpr, so a constexpr
+    // Shape can feed kernels specialized at compile time, e.g. Kernel<shape[0], shape[1]>.
+    //
+    // A shape of more than MAX_DIMENSION dimensions doesn't compile when it is constexpr. At
+    // run time the error is reported and the shape is invalid, no dimension and no element,
+    // and a tensor of it fails to init.
     class Shape
     {
+    public:
+        static constexpr unsigned int MAX_DIMENSION = 8;
+
     private:
-        unsigned int *m_dim;
+        unsigned int m_dim[MAX_DIMENSION];
+        unsigned int m_stride[MAX_DIMENSION];
         unsigned int m_count;
+        unsigned int m_size;
+        bool m_isValid;
 
-    public:
-        Shape(unsigned int dimension = 0)
-            :m_dim(nullptr),
-            m_count(dimension)
+        // reports a shape of dimension dimensions and leaves this one invalid. Not constexpr, a
+        // constant evaluation reaching it fails.
+        void invalidate(unsigned int dimension);
+
+        constexpr void update()
         {
-            if (m_count)
+            unsigned int size = 1;
+
+            for(unsigned int i = 0; i < m_count; ++i)
             {
-                m_dim = new unsigned int[m_count];
+                m_stride[i] = size;
+                size *= m_dim[i];
             }
+
+            m_size = size;
         }
 
-        Shape(const Shape &shape)
-            :m_dim(nullptr),
-            m_count(0)
+    public:
+        constexpr Shape(unsigned int dimension = 0)
+            :m_dim(),
+            m_stride(),
+            m_count(dimension),
+            m_size(0),
+            m_isValid(true)
         {
-            *this = shape;
+            if (dimension > MAX_DIMENSION)
+            {
+                invalidate(dimension);
+                return;
+            }
+
+            update();
         }
 
-        Shape(const unsigned int *in, unsigned int count)
-            :m_dim(nullptr),
-            m_count(0)
+        constexpr Shape(const unsigned int *in, unsigned int count)
+            :m_dim(),
+            m_stride(),
+            m_count(count),
+            m_size(0),
+            m_isValid(true)
         {
-            delete [] m_dim;
-            m_dim = new unsigned int [count];
-            m_count = count;
+            if (count > MAX_DIMENSION)
+            {
+                invalidate(count);
+                return;
+            }
 
-            for(unsigned int i = 0; i < count; ++i)
+            for(unsigned int i = 0; i < m_count; ++i)
             {
                 m_dim[i] = in[i];
             }
+
+            update();
         }
 
-        Shape(const std::initializer_list<unsigned int> &li)
-            :m_dim(nullptr),
-             m_count(0)
+        constexpr Shape(const std::initializer_list<unsigned int> &li)
+            :Shape(li.begin(), (unsigned int) li.size())
         {
-            *this = li;
         }
 
-        unsigned int size() const 
+        constexpr unsigned int size() const 
         {
-            unsigned int size = 1;
-
-            for(unsigned int i = 0; i < m_count; ++i)
-            {
-                size *= m_dim[i];
-            }
-            return size;
+            return m_size;
         }
 
-        unsigned int dimension() const
+        constexpr unsigned int dimension() const
         {
             return m_count;
         }
 
-        void operator=(const Shape &shape)
+        // false for a shape that had more than MAX_DIMENSION dimensions
+        constexpr bool isValid() const
         {
-            delete [] m_dim;
-            m_dim = new unsigned int[shape.m_count];
-            m_count = shape.m_count;
+            return m_isValid;
+        }
 
-            for(unsigned int i = 0; i < m_count; ++i)
-            {
-                m_dim[i] = shape.m_dim[i];
-            }
+        // the elements between two neighbours along dimension i, packed
+        constexpr unsigned int stride(unsigned int i) const
+        {
+            return m_stride[i];
         }
 
-        void operator=(const std::initializer_list<unsigned int> &li)
+        constexpr void operator=(const std::initializer_list<unsigned int> &li)
         {
-            delete [] m_dim;
-            m_dim = new unsigned int[li.size()];
-            m_count = li.size();
-            std::copy(li.begin(), li.begin() + m_count, m_dim);
+            *this = Shape(li);
         }
 
-        bool operator==(const Shape &shape) const 
+        constexpr bool operator==(const Shape &shape) const 
         {
-            if (m_count != shape.m_count)
+            if (m_count != shape.m_count || m_isValid != shape.m_isValid)
             {
                 return false;
             }
@@ -105,31 +132,54 @@ namespace FreeWill
             return true;
         }
 
-        bool operator!=(const Shape &shape) const
+        constexpr bool operator!=(const Shape &shape) const
         {
             return !operator==(shape);
         }
 
-        unsigned int &operator[](unsigned int i)
+        constexpr unsigned int operator[](unsigned int i) const
         {
             return m_dim[i];
         }
 
-        unsigned int operator[](unsigned int i) const
+        constexpr void set(unsigned int i, unsigned int extent)
         {
-            return m_dim[i];
+            m_dim[i] = extent;
+            update();
         }
 
-        ~Shape()
+        constexpr void swap(unsigned int a, unsigned int b)
         {
-            delete [] m_dim;
-            m_count = 0;
+            unsigned int extent = m_dim[a];
+            m_dim[a] = m_dim[b];
+            m_dim[b] = extent;
+            update();
         }
 
-        friend
-        Shape operator+(const Shape &in, unsigned int batchSize);
+        // the shape with one more, outermost, dimension, e.g. the batch. Invalid past
+        // MAX_DIMENSION.
+        constexpr friend Shape operator+(const Shape &in, unsigned int batchSize)
+        {
+            if (batchSize == 0 || !in.m_isValid)
+            {
+                return in;
+            }
+
+            Shape shape = in;
+
+            if (in.m_count == MAX_DIMENSION)
+            {
+                shape.invalidate(MAX_DIMENSION + 1);
+                return shape;
+            }
+
+            shape.m_dim[shape.m_count++] = batchSize;
+            shape.update();
+
+            return shape;
+        }
 
-        std::string toString()
+        std::string toString() const
         {
             std::stringstream stream;
             stream << dimension();
@@ -146,7 +196,6 @@ namespace FreeWill
         friend std::ostream& operator<< (std::ostream& stream, Shape const &shape);
     };
 
-    Shape operator+(const Shape &in, unsigned int batchSize);
     std::ostream& operator<< (std::ostream& stream, Shape const &shape);
 }
 
@@ -4,14 +4,21 @@
 #include <type_traits>
 #include <string>
 #include <memory>
+#include <map>
+#include <vector>
+#include <cstring>
 #include "DeviceSelection.h"
 #include "Shape.h"
+#include "TensorLayout.h"
 #include "ReferenceCountedBlob.h"
 #include <ctime>
 #include <cuda.h>
 #include <cudnn.h>
 #include "../Context/Context.h"
 #include "RandomNumberGenerator.h"
+#include "Philox_CPU.h"
+#include "Philox_CUDA.h"
+#include "HalfPrecision.h"
 
 namespace FreeWill 
 {
@@ -19,6 +26,10 @@ namespace FreeWill
     template<DeviceType DeviceUsed, typename DataType>
     class Tensor;
 
+    // one address per element type, toType() compares it instead of asking for the dynamic type
+    template<typename DataType>
+    inline const char tensorElementTag = 0;
+
     template<DeviceType DeviceUsed>
     class TensorBase
     {
@@ -27,32 +38,149 @@ namespace FreeWill
        Shape m_shape;
        cudnnTensorDescriptor_t m_gpuTensorDescriptor;
        ReferenceCountedBlob<DeviceUsed> m_data;
+       // the descriptors of the other batch sizes setBatchSize() has viewed the current shape at
+       std::map<unsigned int, cudnnTensorDescriptor_t> m_batchTensorDescriptors;
+       // where the items viewed by setBatchWindow() start, in bytes
+       unsigned int m_windowOffset;
+       // the tensor a view looks into (see Tensor::view), the view has no data of its own and
+       // sees whatever memory and batch window the viewed tensor has when it is used
+       TensorBase<DeviceUsed> *m_viewed;
+       // where the view starts in the current batch window of m_viewed, in bytes
+       size_t m_viewOffset;
+       // the last dimension of the view follows the batch size of m_viewed
+       bool m_isBatchView;
+       // the element strides of a sliced or transposed view, empty when contiguous
+       Shape m_strides;
+       // the views of this tensor, told about its batch size changes
+       std::vector<TensorBase<DeviceUsed>*> m_views;
+       // &tensorElementTag<DataType> of the Tensor this is
+       const char *m_elementTag;
+       TensorLayout m_layout;
 
        TensorBase(const Shape &shape = Shape()) 
            :m_shape(shape),
             m_gpuTensorDescriptor(0),
-            m_data()
+            m_data(),
+            m_batchTensorDescriptors(),
+            m_windowOffset(0),
+            m_viewed(nullptr),
+            m_viewOffset(0),
+            m_isBatchView(false),
+            m_strides(),
+            m_views(),
+            m_elementTag(nullptr),
+            m_layout(TensorLayout::CHANNEL_LAST)
        {
            RUN_CUDNN(cudnnCreateTensorDescriptor(&m_gpuTensorDescriptor));
        }
 
        TensorBase(const ReferenceCountedBlob<DeviceUsed> &data, const Shape &shape = Shape())
            :m_shape(shape),
+               m_gpuTensorDescriptor(0),
                m_data(data),
-               m_gpuTensorDescriptor(0)
+               m_batchTensorDescriptors(),
+               m_windowOffset(0),
+               m_viewed(nullptr),
+               m_viewOffset(0),
+               m_isBatchView(false),
+               m_strides(),
+               m_views(),
+               m_elementTag(nullptr),
+               m_layout(TensorLayout::CHANNEL_LAST)
        {
            RUN_CUDNN(cudnnCreateTensorDescriptor(&m_gpuTensorDescriptor));
        }
 
+       void attachView(TensorBase<DeviceUsed> *view, size_t offsetInByte, bool isBatchView)
+       {
+           view->m_viewed = this;
+           view->m_viewOffset = offsetInByte;
+           view->m_isBatchView = isBatchView;
+           view->m_layout = m_layout;
+           m_views.push_back(view);
+       }
+
+       // the batch size of this tensor changed, the batch views follow it
+       void updateViews()
+       {
+           unsigned int batchSize = m_shape[m_shape.dimension() - 1];
+
+           for (TensorBase<DeviceUsed> *view : m_views)
+           {
+               if (view->m_isBatchView)
+               {
+                   view->setBatchSize(batchSize);
+               }
+           }
+       }
+
     public:
        void *gpuDataHandle()
        {
-            return m_data.m_gpuDataHandle;
+            if (m_viewed)
+            {
+                return (unsigned char *) m_viewed->gpuDataHandle() + m_viewOffset;
+            }
+
+            return (unsigned char *) m_data.m_gpuDataHandle + m_windowOffset;
        }
 
+       // on gpu the host mirror is allocated the first time
        void *cpuDataHandle()
        {
-            return m_data.m_dataHandle;
+            if (m_viewed)
+            {
+                return (unsigned char *) m_viewed->cpuDataHandle() + m_viewOffset;
+            }
+
+            return m_data.dataHandle() + m_windowOffset;
+       }
+
+       // gpu only, the host mirror of all of the tensor a view views, see ReferenceCountedBlob
+       void freeHostMirror()
+       {
+            m_viewed ? m_viewed->freeHostMirror() : m_data.freeHostMirror();
+       }
+
+       bool isView() const
+       {
+           return m_viewed != nullptr;
+       }
+
+       // the order of the elements, the shape is the same in every layout
+       TensorLayout layout() const
+       {
+           return m_layout;
+       }
+
+       void setLayout(TensorLayout layout)
+       {
+           m_layout = layout;
+       }
+
+       // false for a sliced or transposed view, whose elements operator[] and the cpu kernels
+       // can't walk linearly
+       bool isContiguous() const
+       {
+           return m_strides.dimension() == 0;
+       }
+
+       // in elements, the first dimension is the innermost
+       Shape strides() const
+       {
+           if (!isContiguous())
+           {
+               return m_strides;
+           }
+
+           Shape strides(m_shape.dimension());
+
+           for (unsigned int i = 0; i < m_shape.dimension(); ++i)
+           {
+               strides.set(i, m_shape.stride(i));
+           }
+
+           return strides;
        }
 
        const cudnnTensorDescriptor_t &gpuTensorDescriptor() const
@@ -65,38 +193,130 @@ namespace FreeWill
             return m_shape;
        }
 
+       // a view clears only the elements it covers, when it is contiguous
        void clear()
        {
-            m_data.clear();
+            if (!m_viewed)
+            {
+                m_data.clear();
+                return;
+            }
+
+            if (!isContiguous())
+            {
+                return;
+            }
+
+            std::memset(cpuDataHandle(), 0, viewSizeInByte());
+
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                RUN_CUDA(cudaMemset(gpuDataHandle(), 0, viewSizeInByte()));
+            }
+       }
+
+       const ReferenceCountedBlob<DeviceUsed> &blob() const
+       {
+            return m_viewed ? m_viewed->blob() : m_data;
+       }
+
+       // frees the data, the shape is kept. Not for views.
+       void release()
+       {
+            m_data.release();
+       }
+
+       void clearBatchTensorDescriptors()
+       {
+           for (auto iter = m_batchTensorDescriptors.begin(); iter != m_batchTensorDescriptors.end(); ++iter)
+           {
+               RUN_CUDNN(cudnnDestroyTensorDescriptor(iter->second));
+           }
+           m_batchTensorDescriptors.clear();
        }
 
        virtual ~TensorBase() 
        {
+           for (TensorBase<DeviceUsed> *view : m_views)
+           {
+               view->m_viewed = nullptr;
+           }
+
+           if (m_viewed)
+           {
+               std::vector<TensorBase<DeviceUsed>*> &views = m_viewed->m_views;
+               views.erase(std::remove(views.begin(), views.end(), this), views.end());
+           }
+
+           clearBatchTensorDescriptors();
            RUN_CUDNN(cudnnDestroyTensorDescriptor(m_gpuTensorDescriptor));
        }
 
+       // nullptr unless the elements are DataType, Tensor is the only TensorBase
        template<typename DataType = float>
        Tensor<DeviceUsed, DataType> *toType()
        {
-            return dynamic_cast< Tensor<DeviceUsed, DataType> *>(this);
+            return m_elementTag == &tensorElementTag<DataType> ? static_cast<Tensor<DeviceUsed, DataType> *>(this) : nullptr;
        }
 
        virtual const std::string &name() const = 0;
        virtual bool reshape(const Shape &newShape) = 0;
 
+       // A view of the same memory in another shape that copies nothing, owned by the caller
+       // and valid while this tensor lives. A batch view gives each item of this tensor the
+       // shape itemShape and keeps following its batch size and batch window, a plain view
+       // covers shape.size() elements from element offset on. nullptr if it doesn't fit.
+       virtual TensorBase<DeviceUsed> *view(const Shape &shape, unsigned int offset = 0) = 0;
+       virtual TensorBase<DeviceUsed> *batchView(const Shape &itemShape) = 0;
+
+       // views the tensor at another size of its last, batch, dimension, inside the memory it was
+       // allocated with
+       virtual bool setBatchSize(unsigned int batchSize) = 0;
+
+       // views the count items from first on, e.g. one micro-batch of the batch the tensor was
+       // allocated for (see Pipeline). The data handles point at item first until the next call,
+       // setBatchWindow(0, n) is the same as setBatchSize(n).
+       virtual bool setBatchWindow(unsigned int first, unsigned int count) = 0;
+
+       // the bytes the current shape covers, less than sizeInByte() when viewed at a smaller batch
+       virtual unsigned int viewSizeInByte() const = 0;
+
+       // views caller owned host memory of viewSizeInByte() bytes, see ReferenceCountedBlob::bindHost
+       bool bindHost(void *data)
+       {
+           return m_data.bindHost(static_cast<unsigned char*>(data), viewSizeInByte());
+       }
+
+       // of a view: the bytes it may address from its start on
        unsigned int sizeInByte()
        {
+           if (m_viewed)
+           {
+               return m_viewed->sizeInByte() - (m_viewed->m_windowOffset + m_viewOffset);
+           }
+
            return m_data.sizeInByte();
        }
 
+       // the copies of a view copy all of the tensor it views
        void copyFromDeviceToHost()
        {
-           m_data.copyFromDeviceToHost();
+           m_viewed ? m_viewed->copyFromDeviceToHost() : m_data.copyFromDeviceToHost();
        }
 
        void copyFromHostToDevice()
        {
-           m_data.copyFromHostToDevice();
+           m_viewed ? m_viewed->copyFromHostToDevice() : m_data.copyFromHostToDevice();
+       }
+
+       void copyFromDeviceToHostAsync(cudaStream_t stream)
+       {
+           m_viewed ? m_viewed->copyFromDeviceToHostAsync(stream) : m_data.copyFromDeviceToHostAsync(stream);
+       }
+
+       void copyFromHostToDeviceAsync(cudaStream_t stream)
+       {
+           m_viewed ? m_viewed->copyFromHostToDeviceAsync(stream) : m_data.copyFromHostToDeviceAsync(stream);
        }
     };
     
@@ -107,6 +327,7 @@ namespace FreeWill
         using TensorBase<DeviceUsed>::m_shape;
         std::string m_name;
         using TensorBase<DeviceUsed>::m_data;
+        using TensorBase<DeviceUsed>::m_strides;
         
     public:
         using TensorBase<DeviceUsed>::shape;
@@ -116,7 +337,7 @@ namespace FreeWill
             :TensorBase<DeviceUsed>(shape),
             m_name(name)
         {
-
+            TensorBase<DeviceUsed>::m_elementTag = &tensorElementTag<DataType>;
         }
         
         explicit Tensor(const Shape &shape = Shape(),
@@ -124,16 +345,23 @@ namespace FreeWill
             :TensorBase<DeviceUsed>(shape),
             m_name(name)
 	    {
+            TensorBase<DeviceUsed>::m_elementTag = &tensorElementTag<DataType>;
 	    }
 
         explicit Tensor(const Tensor &in)
             :TensorBase<DeviceUsed>(in.m_data, in.shape()),
             m_name(in.m_name)
         {
+            TensorBase<DeviceUsed>::m_elementTag = &tensorElementTag<DataType>;
         }
 
         bool init()
 	    {
+            if (TensorBase<DeviceUsed>::isView() || !m_shape.isValid())
+            {
+                return false;
+            }
+
             unsigned int size = m_shape.size();
             bool result = false;
             if (size) 
@@ -149,6 +377,24 @@ namespace FreeWill
             return result;
 	    }
 
+        // place the tensor at offset inside a preallocated arena instead of allocating it
+        bool init(const ReferenceCountedBlob<DeviceUsed> &arena, unsigned int offset)
+        {
+            if (!m_shape.isValid())
+            {
+                return false;
+            }
+
+            bool result = m_data.alias(arena, offset, m_shape.size() * sizeof(DataType));
+
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                updateGPUTensorDescriptor();
+            }
+
+            return result;
+        }
+
         bool init(const std::initializer_list<DataType> &initList)
         {
             if (!init())
@@ -168,20 +414,46 @@ namespace FreeWill
             return true;
         }
 
+        // standard normals from a new stream of the generator, see RandomNumberGenerator
         void randomize()
         {
+            randomize(RandomNumberGenerator::getSingleton().newStream());
+        }
+
+        // Element i is the i-th normal of stream, on either device, so the replicas of a tensor
+        // randomized from one stream are equal. A gpu tensor is filled on the gpu and then
+        // downloaded, its host copy stays in step as it did when it was drawn on the cpu.
+        void randomize(uint64_t stream)
+        {
+            unsigned int size = m_shape.size();
+            uint64_t seed = RandomNumberGenerator::getSingleton().seed();
+
+            if (!TensorBase<DeviceUsed>::isContiguous())
+            {
+                std::vector<DataType> normals(size);
+                randomNormalCPU<DataType>(normals.data(), size, seed, stream);
+
+                for (unsigned int n = 0; n < size; ++n)
+                {
+                    (*this)[n] = normals[n];
+                }
+
+                if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+                {
+                    TensorBase<DeviceUsed>::copyFromHostToDevice();
+                }
+                return;
+            }
 
-           DataType *bits = (DataType *) m_data.dataHandle();
-           unsigned int size = m_shape.size();
-                 
-           for (unsigned int n = 0; n < size; ++n) 
-           {
-                bits[n] = RandomNumberGenerator::getSingleton().getRandom<DataType>();
-           }
- 
             if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
             {
-                m_data.copyFromHostToDevice();
+                randomNormalCUDAKernel<DataType>(gpuDataHandle(), size, seed, stream);
+                TensorBase<DeviceUsed>::copyFromDeviceToHostAsync(computeStream());
+                RUN_CUDA(cudaStreamSynchronize(computeStream()));
+            }
+            else
+            {
+                randomNormalCPU<DataType>(cpuDataHandle(), size, seed, stream);
             }
         }
 
@@ -193,15 +465,89 @@ namespace FreeWill
             updateGPUTensorDescriptor();
         }
 
+        // i counts the elements first dimension innermost, also in a strided view
         DataType &operator[](unsigned int i)
         {
-            DataType *bits = (DataType *) m_data.dataHandle();
-            return *(bits + i);
+            DataType *bits = (DataType *) TensorBase<DeviceUsed>::cpuDataHandle();
+
+            if (TensorBase<DeviceUsed>::isContiguous())
+            {
+                return *(bits + i);
+            }
+
+            size_t offset = 0;
+
+            for (unsigned int d = 0; d < m_shape.dimension(); ++d)
+            {
+                offset += (size_t) (i % m_shape[d]) * m_strides[d];
+                i /= m_shape[d];
+            }
+
+            return *(bits + offset);
+        }
+
+        Tensor<DeviceUsed, DataType> *view(const Shape &shape, unsigned int offset = 0) override
+        {
+            if (!TensorBase<DeviceUsed>::isContiguous() ||
+                    (size_t) (offset + shape.size()) * sizeof(DataType) > TensorBase<DeviceUsed>::sizeInByte())
+            {
+                return nullptr;
+            }
+
+            return makeView(shape, (size_t) offset * sizeof(DataType), false);
+        }
+
+        Tensor<DeviceUsed, DataType> *batchView(const Shape &itemShape) override
+        {
+            unsigned int dimension = m_shape.dimension();
+
+            if (dimension == 0 || !TensorBase<DeviceUsed>::isContiguous() ||
+                    itemShape.size() * m_shape[dimension - 1] != m_shape.size())
+            {
+                return nullptr;
+            }
+
+            return makeView(itemShape + m_shape[dimension - 1], 0, true);
+        }
+
+        // count entries of dimension from first on, strided unless every outer dimension is 1
+        Tensor<DeviceUsed, DataType> *slice(unsigned int dimension, unsigned int first, unsigned int count)
+        {
+            if (dimension >= m_shape.dimension() || count == 0 || first + count > m_shape[dimension])
+            {
+                return nullptr;
+            }
+
+            Shape strides = TensorBase<DeviceUsed>::strides();
+            Shape shape = m_shape;
+            shape.set(dimension, count);
+
+            Tensor<DeviceUsed, DataType> *tensor = makeView(shape, (size_t) first * strides[dimension] * sizeof(DataType), false);
+            tensor->setStrides(strides);
+            return tensor;
+        }
+
+        // the same elements with dimensions a and b swapped
+        Tensor<DeviceUsed, DataType> *transpose(unsigned int a, unsigned int b)
+        {
+            if (a >= m_shape.dimension() || b >= m_shape.dimension())
+            {
+                return nullptr;
+            }
+
+            Shape strides = TensorBase<DeviceUsed>::strides();
+            Shape shape = m_shape;
+            shape.swap(a, b);
+            strides.swap(a, b);
+
+            Tensor<DeviceUsed, DataType> *tensor = makeView(shape, 0, false);
+            tensor->setStrides(strides);
+            return tensor;
         }
 
         bool reshape(const Shape &newShape)
         {
-            if (newShape.size() == m_shape.size())
+            if (newShape.size() == m_shape.size() && TensorBase<DeviceUsed>::isContiguous())
             {
                 m_shape = newShape;
                 updateGPUTensorDescriptor();
@@ -213,6 +559,87 @@ namespace FreeWill
             }
         }
 
+        bool setBatchSize(unsigned int batchSize) override
+        {
+            unsigned int dimension = m_shape.dimension();
+
+            if (dimension == 0 || batchSize == 0)
+            {
+                return false;
+            }
+
+            unsigned int currentBatchSize = m_shape[dimension - 1];
+
+            if (batchSize == currentBatchSize)
+            {
+                TensorBase<DeviceUsed>::m_windowOffset = 0;
+                return true;
+            }
+
+            if ((size_t) m_shape.size() / currentBatchSize * batchSize * sizeof(DataType) >
+                    (TensorBase<DeviceUsed>::isView() ? TensorBase<DeviceUsed>::sizeInByte() : m_data.sizeInByte()))
+            {
+                return false;
+            }
+
+            TensorBase<DeviceUsed>::m_windowOffset = 0;
+
+            m_shape.set(dimension - 1, batchSize);
+
+            if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
+            {
+                // swapped rather than rewritten, the batch sizes of a model come back every epoch
+                std::map<unsigned int, cudnnTensorDescriptor_t> &descriptors = TensorBase<DeviceUsed>::m_batchTensorDescriptors;
+                cudnnTensorDescriptor_t &current = TensorBase<DeviceUsed>::m_gpuTensorDescriptor;
+                auto cached = descriptors.find(batchSize);
+
+                cudnnTensorDescriptor_t previous = current;
+
+                if (cached != descriptors.end())
+                {
+                    current = cached->second;
+                    descriptors.erase(cached);
+                }
+                else
+                {
+                    RUN_CUDNN(cudnnCreateTensorDescriptor(&current));
+                    setGPUTensorDescriptor();
+                }
+
+                descriptors[currentBatchSize] = previous;
+            }
+
+            TensorBase<DeviceUsed>::updateViews();
+
+            return true;
+        }
+
+        bool setBatchWindow(unsigned int first, unsigned int count) override
+        {
+            unsigned int dimension = m_shape.dimension();
+
+            if (dimension == 0 || count == 0)
+            {
+                return false;
+            }
+
+            size_t itemSizeInByte = (size_t) m_shape.size() / m_shape[dimension - 1] * sizeof(DataType);
+
+            if (TensorBase<DeviceUsed>::isView() || (first + count) * itemSizeInByte > m_data.sizeInByte() || !setBatchSize(count))
+            {
+                return false;
+            }
+
+            TensorBase<DeviceUsed>::m_windowOffset = first * itemSizeInByte;
+
+            return true;
+        }
+
+        unsigned int viewSizeInByte() const override
+        {
+            return m_shape.size() * sizeof(DataType);
+        }
+
         DataType *gpuDataHandle()
         {
             return (DataType*) TensorBase<DeviceUsed>::gpuDataHandle();
@@ -229,7 +656,28 @@ namespace FreeWill
         }
 
     private:
+        Tensor<DeviceUsed, DataType> *makeView(const Shape &shape, size_t offsetInByte, bool isBatchView)
+        {
+            Tensor<DeviceUsed, DataType> *tensor = new Tensor<DeviceUsed, DataType>(shape, m_name);
+            TensorBase<DeviceUsed>::attachView(tensor, offsetInByte, isBatchView);
+            tensor->updateGPUTensorDescriptor();
+            return tensor;
+        }
+
+        void setStrides(const Shape &strides)
+        {
+            m_strides = strides;
+            updateGPUTensorDescriptor();
+        }
+
+        // a new shape, the descriptors of the other batch sizes no longer match it
         void updateGPUTensorDescriptor()
+        {
+            TensorBase<DeviceUsed>::clearBatchTensorDescriptors();
+            setGPUTensorDescriptor();
+        }
+
+        void setGPUTensorDescriptor()
         {
             if constexpr (DeviceUsed == DeviceType::GPU_CUDA)
             {
@@ -242,30 +690,37 @@ namespace FreeWill
                 {
                     dataType = CUDNN_DATA_DOUBLE;
                 }
+                else if constexpr (std::is_same<DataType,Half>::value)
+                {
+                    dataType = CUDNN_DATA_HALF;
+                }
+                else if constexpr (std::is_same<DataType,BFloat16>::value)
+                {
+                    dataType = CUDNN_DATA_BFLOAT16;
+                }
+                else if constexpr (std::is_same<DataType,int8_t>::value)
+                {
+                    dataType = CUDNN_DATA_INT8;
+                }
 
                 int nbDims = m_shape.dimension();
                 int atLeastDims = nbDims < 4 ? 4 : nbDims;
                 int *dimA = new int[atLeastDims];
                 int *strideA = new int[atLeastDims];
+                // the strides of views too, cudnn takes them as they are
+                Shape strides = TensorBase<DeviceUsed>::strides();
                 
                 for(int i = 0;i<atLeastDims;++i)
                 {
                     if (i < nbDims)
                     {
                         dimA[atLeastDims - i - 1] = m_shape[i];
-                        if (i == 0)
-                        {
-                            strideA[atLeastDims-1] = 1;
-                        }
-                        else
-                        {
-                            strideA[atLeastDims - 1 - i] = m_shape[i-1] * strideA[atLeastDims - i];
-                        }
+                        strideA[atLeastDims - 1 - i] = strides[i];
                     }
                     else
                     {
                         dimA[atLeastDims - i - 1] = 1;
-                        strideA[atLeastDims - 1 - i] = strideA[atLeastDims - i];
+                        strideA[atLeastDims - 1 - i] = i == 0 ? 1 : strideA[atLeastDims - i];
                     }
                 }
                
@@ -288,7 +743,6 @@ namespace FreeWill
     template<DeviceType DeviceUsed = DeviceType::CPU_NAIVE, typename DataType = float>
     std::ostream& operator<< (std::ostream& stream, Tensor<DeviceUsed, DataType> &tensor)
     {
-        const DataType *bits = (const DataType *) tensor.m_data.dataHandle();
         unsigned int size = tensor.m_shape.size();
 
         stream << size;
@@ -296,7 +750,7 @@ namespace FreeWill
 
         for (unsigned int n = 0; n < size; ++n)
         {
-            stream << bits[n] << ((n == size-1) ? "}":", ");
+            stream << tensor[n] << ((n == size-1) ? "}":", ");
         }
         return stream;
     }
@@ -0,0 +1,58 @@
+#ifndef TENSORLAYOUT_H
+#define TENSORLAYOUT_H
+
+#include <cstdint>
+
+#include "../Context/CPUFeatures.h"
+
+namespace FreeWill
+{
+    // How the elements of a {channel, width, height, batch} tensor are ordered in memory. The
+    // shape stays the logical one whatever the layout.
+    //
+    // CHANNEL_LAST is the order of the shape, channels innermost (NHWC), what every operator
+    // takes and what cudnn gets on gpu. The blocked layouts (NCHW4c/8c/16c) cut the channels
+    // into blocks of 4, 8 or 16 and store one {block, width, height} plane per block and image,
+    // so a cpu kernel finds a whole vector of channels at every pixel and walks the planes
+    // contiguously. The channel count has to be a multiple of the block. Model::planLayouts
+    // picks them, only a few cpu kernels read them (see ChannelBlocked_CPU.h).
+    enum class TensorLayout : uint32_t
+    {
+        CHANNEL_LAST,
+        CHANNEL_BLOCKED_4,
+        CHANNEL_BLOCKED_8,
+        CHANNEL_BLOCKED_16
+    };
+
+    // 1 for CHANNEL_LAST
+    static inline unsigned int channelBlockSize(TensorLayout layout)
+    {
+        switch (layout)
+        {
+        case TensorLayout::CHANNEL_BLOCKED_4:
+            return 4;
+        case TensorLayout::CHANNEL_BLOCKED_8:
+            return 8;
+        case TensorLayout::CHANNEL_BLOCKED_16:
+            return 16;
+        default:
+            return 1;
+        }
+    }
+
+    // the block of one vector of float on the instruction set the cpu kernels run
+    static inline TensorLayout preferredChannelBlockedLayoutCPU()
+    {
+        switch (CPUFeatures::getSingleton().instructionSet())
+        {
+        case CPUInstructionSet::AVX512:
+            return TensorLayout::CHANNEL_BLOCKED_16;
+        case CPUInstructionSet::AVX2:
+            return TensorLayout::CHANNEL_BLOCKED_8;
+        default:
+            return TensorLayout::CHANNEL_BLOCKED_4;
+        }
+    }
+}
+
+#endif
@@ -7,3 +7,38 @@ DemoBase::DemoBase(WebsocketServer *websocketServer)
 }
 
 DemoBase::~DemoBase(){}
+
+void DemoBase::reportMetrics(FreeWill::DeviceType deviceType)
+{
+    const float megabyte = 1024.0f * 1024.0f;
+    FreeWill::TrainingMetrics metrics = FreeWill::Profiler::getSingleton().metrics(deviceType);
+
+    QVector<float> utilization;
+    QVector<float> queueDepth;
+    QVector<float> memoryInMB;
+
+    for (const FreeWill::DeviceMetrics &device : metrics.m_devices)
+    {
+        utilization.push_back(device.m_utilization);
+        queueDepth.push_back(device.m_queueDepth);
+        memoryInMB.push_back(device.m_memoryInByte / megabyte);
+    }
+
+    emit updateThroughput(metrics.m_step, metrics.m_samplesPerSecond, metrics.m_latencyP50, metrics.m_latencyP90,
+                          metrics.m_latencyP99, metrics.m_hostMemoryInByte / megabyte);
+    emit updateDevices(metrics.m_step, utilization, queueDepth, memoryInMB);
+
+    QStringList labels;
+    QVector<float> categoryMemoryInMB;
+    QVector<float> peakMemoryInMB;
+
+    for (const FreeWill::MemoryUsage &usage : metrics.m_memory)
+    {
+        labels.push_back(QString("%1, %2 %3").arg(FreeWill::BlobAllocator::categoryName(usage.m_category))
+                         .arg(usage.m_isHost ? "node" : "device").arg(usage.m_device));
+        categoryMemoryInMB.push_back(usage.m_sizeInByte / megabyte);
+        peakMemoryInMB.push_back(usage.m_peakSizeInByte / megabyte);
+    }
+
+    emit updateMemory(metrics.m_step, labels, categoryMemoryInMB, peakMemoryInMB);
+}
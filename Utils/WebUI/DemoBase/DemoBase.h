@@ -3,7 +3,9 @@
 
 #include <QObject>
 #include <QThread>
+#include <QStringList>
 #include "WebsocketServer.h"
+#include <Context/Profiler.h>
 
 class DemoBase : public QThread
 {
@@ -17,9 +19,17 @@ protected:
 
     ~DemoBase();
 
+    // sends the throughput since the last call, the state of the devices and the memory per
+    // category, see FreeWill::Profiler::metrics. The loop calls Profiler::endStep after every step.
+    void reportMetrics(FreeWill::DeviceType deviceType);
+
 signals:
         void updateCost(float cost);
         void updateProgress(float epoch, float overall);
+        void updateThroughput(unsigned int step, float samplesPerSecond, float latencyP50, float latencyP90, float latencyP99, float hostMemoryInMB);
+        void updateDevices(unsigned int step, const QVector<float> &utilization, const QVector<float> &queueDepth, const QVector<float> &memoryInMB);
+        // one entry per category and device or NUMA node, live and at its peak
+        void updateMemory(unsigned int step, const QStringList &labels, const QVector<float> &memoryInMB, const QVector<float> &peakMemoryInMB);
 };
 
 #endif
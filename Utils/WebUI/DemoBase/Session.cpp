@@ -1,92 +1,413 @@
 #include "Session.h"
 #include <QDebug>
+#include <algorithm>
+#include <cstring>
+#include <new>
 
-Session::Session()
-    :m_sessionFile("sessionfile.dat"),
-      m_writeMap(NULL),
-      m_readMap(NULL),
-      m_readFrom(0),
-      m_readSize(0),
-      m_capacity(0),
+void SessionSummary::add(quint32 step, float value)
+{
+    if (m_count == 0)
+    {
+        m_firstStep = m_minStep = m_maxStep = step;
+        m_min = m_max = value;
+        m_sum = 0.0f;
+    }
+
+    if (value < m_min)
+    {
+        m_min = value;
+        m_minStep = step;
+    }
+
+    if (value > m_max)
+    {
+        m_max = value;
+        m_maxStep = step;
+    }
+
+    m_lastStep = step;
+    m_sum += value;
+    m_count ++;
+}
+
+void SessionSummary::add(const SessionSummary &summary)
+{
+    if (summary.m_count == 0)
+    {
+        return;
+    }
+
+    if (m_count == 0)
+    {
+        *this = summary;
+        return;
+    }
+
+    if (summary.m_min < m_min)
+    {
+        m_min = summary.m_min;
+        m_minStep = summary.m_minStep;
+    }
+
+    if (summary.m_max > m_max)
+    {
+        m_max = summary.m_max;
+        m_maxStep = summary.m_maxStep;
+    }
+
+    m_lastStep = summary.m_lastStep;
+    m_sum += summary.m_sum;
+    m_count += summary.m_count;
+}
+
+SessionLog::SessionLog(unsigned int entrySize, unsigned int chunkEntryCount, unsigned int maxChunkCount)
+    :m_entrySize(entrySize),
+      m_chunkEntryCount(chunkEntryCount),
+      m_chunks(new std::atomic<uchar*>[maxChunkCount]),
+      m_maxChunkCount(maxChunkCount),
+      m_chunkCount(0),
       m_tail(0)
 {
+    reset();
+}
+
+bool SessionLog::addChunk(uchar *data)
+{
+    unsigned int chunkCount = m_chunkCount.load(std::memory_order_relaxed);
+
+    if (chunkCount == m_maxChunkCount)
+    {
+        return false;
+    }
+
+    m_chunks[chunkCount].store(data, std::memory_order_relaxed);
+    m_chunkCount.store(chunkCount + 1, std::memory_order_release);
+
+    return true;
+}
+
+uchar *SessionLog::chunk(unsigned int chunk) const
+{
+    return chunk < chunkCount() ? m_chunks[chunk].load(std::memory_order_relaxed) : nullptr;
+}
+
+uchar *SessionLog::nextEntry() const
+{
+    unsigned int tail = m_tail.load(std::memory_order_relaxed);
+    uchar *data = chunk(tail / m_chunkEntryCount);
+
+    return data ? data + (size_t) (tail % m_chunkEntryCount) * m_entrySize : nullptr;
+}
+
+void SessionLog::publish()
+{
+    m_tail.store(m_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+const uchar *SessionLog::entry(unsigned int index) const
+{
+    // the chunk was set before the tail that covers index was published
+    return m_chunks[index / m_chunkEntryCount].load(std::memory_order_relaxed) + (size_t) (index % m_chunkEntryCount) * m_entrySize;
+}
+
+unsigned int SessionLog::read(uchar *buffer, unsigned int offset, unsigned int size) const
+{
+    unsigned int tail = this->tail();
+
+    if (offset >= tail)
+    {
+        return 0;
+    }
+
+    size = std::min(size, tail - offset);
+
+    for (unsigned int copied = 0; copied < size;)
+    {
+        unsigned int index = offset + copied;
+        unsigned int count = std::min(size - copied, m_chunkEntryCount - index % m_chunkEntryCount);
+
+        memcpy(buffer + (size_t) copied * m_entrySize, entry(index), (size_t) count * m_entrySize);
+        copied += count;
+    }
+
+    return size;
+}
+
+void SessionLog::reset()
+{
+    for (unsigned int i = 0; i < m_maxChunkCount; ++i)
+    {
+        m_chunks[i].store(nullptr, std::memory_order_relaxed);
+    }
+
+    m_chunkCount.store(0, std::memory_order_release);
+    m_tail.store(0, std::memory_order_release);
+}
+
+Session::Session(const QString &fileName, unsigned int recordSize)
+    :m_sessionFile(fileName),
+      m_recordSize(recordSize),
+      m_index(nullptr),
+      m_records(recordSize, CHUNK_RECORD_COUNT, MAX_CHUNK_COUNT),
+      m_openSummaries()
+{
+    for (unsigned int level = 0; level < SUMMARY_LEVEL_COUNT; ++level)
+    {
+        // the summaries of a chunk of entries, or of several on the higher levels, fill one of theirs
+        m_summaries[level].reset(new SessionLog(sizeof(SessionSummary), CHUNK_RECORD_COUNT / SUMMARY_FANOUT, MAX_CHUNK_COUNT));
+    }
+}
+
+Session::~Session()
+{
+    for (unsigned int level = 0; level < SUMMARY_LEVEL_COUNT; ++level)
+    {
+        for (unsigned int chunk = 0; chunk < m_summaries[level]->chunkCount(); ++chunk)
+        {
+            delete [] m_summaries[level]->chunk(chunk);
+        }
+    }
+
+    for (unsigned int chunk = 0; chunk < m_records.chunkCount(); ++chunk)
+    {
+        m_sessionFile.unmap(m_records.chunk(chunk));
+    }
 
+    if (m_index)
+    {
+        m_sessionFile.unmap((uchar*) m_index);
+    }
 }
 
 void Session::open()
 {
-    m_capacity = 1024;
-    m_tail = 0;
+    if (!m_sessionFile.isOpen() && !m_sessionFile.open(QFile::ReadWrite))
+    {
+        qDebug() << "can't open" << m_sessionFile.fileName();
+        return;
+    }
 
-    if (!m_sessionFile.open(QFile::ReadWrite))
+    // a session starts over, before any reader
+    for (unsigned int level = 0; level < SUMMARY_LEVEL_COUNT; ++level)
     {
-        qDebug() << "can't open";
+        for (unsigned int chunk = 0; chunk < m_summaries[level]->chunkCount(); ++chunk)
+        {
+            delete [] m_summaries[level]->chunk(chunk);
+        }
+
+        m_summaries[level]->reset();
+        m_openSummaries[level] = SessionSummary();
+    }
+
+    for (unsigned int chunk = 0; chunk < m_records.chunkCount(); ++chunk)
+    {
+        m_sessionFile.unmap(m_records.chunk(chunk));
+    }
+
+    m_records.reset();
+
+    if (m_index)
+    {
+        m_sessionFile.unmap((uchar*) m_index);
+        m_index = nullptr;
+    }
+
+    if (!m_sessionFile.resize(0) || !m_sessionFile.resize(sizeof(Index)))
+    {
+        qDebug() << "can't resize" << m_sessionFile.fileName();
         return;
     }
 
-    if (m_sessionFile.size() == 0)
+    uchar *index = m_sessionFile.map(0, sizeof(Index));
+
+    if (!index)
     {
-        //extend file
-        m_sessionFile.seek(1024*1024*32);
-        char buf[256] = {1};
-        m_sessionFile.write(buf, 256);
-        m_sessionFile.seek(0);
+        qDebug() << "bug! can't map the index of" << m_sessionFile.fileName();
+        return;
     }
 
-    m_writeMap = m_sessionFile.map(m_tail * (sizeof(unsigned int) + sizeof(float)), m_chunkSize * (sizeof(unsigned int) + sizeof(float)));
+    m_index = new (index) Index();
+    m_index->m_magic = 0x46575353;
+    m_index->m_recordSize = m_recordSize;
+    m_index->m_chunkRecordCount = CHUNK_RECORD_COUNT;
 
-    if (!m_writeMap)
+    mapChunk(0);
+}
+
+bool Session::mapChunk(unsigned int chunk)
+{
+    if (!m_index || chunk >= MAX_CHUNK_COUNT)
+    {
+        return false;
+    }
+
+    qint64 chunkSize = (qint64) CHUNK_RECORD_COUNT * m_recordSize;
+    qint64 offset = (qint64) sizeof(Index) + chunk * chunkSize;
+
+    if (m_sessionFile.size() < offset + chunkSize && !m_sessionFile.resize(offset + chunkSize))
+    {
+        return false;
+    }
+
+    uchar *data = m_sessionFile.map(offset, chunkSize);
+
+    if (!data || !m_records.addChunk(data))
     {
-        qDebug() << "bug! can't open file";
+        return false;
     }
 
+    m_index->m_chunkCount.store(chunk + 1, std::memory_order_release);
+
+    return true;
 }
 
 void Session::write(unsigned int step, float v)
 {
-    if (m_tail == m_capacity)
+    uchar record[sizeof(unsigned int) + sizeof(float)];
+
+    memcpy(record, &step, sizeof(unsigned int));
+    memcpy(record + sizeof(unsigned int), &v, sizeof(float));
+
+    write(record);
+}
+
+void Session::write(const void *record)
+{
+    uchar *entry = m_records.nextEntry();
+    unsigned int tail = m_records.tail();
+
+    if (!entry)
+    {
+        // the chunk is full, the next one is mapped once and never moves
+        if (!mapChunk(tail / CHUNK_RECORD_COUNT))
+        {
+            qDebug() << "session" << m_sessionFile.fileName() << "is full or can't grow, dropped an entry";
+            return;
+        }
+
+        entry = m_records.nextEntry();
+    }
+
+    memcpy(entry, record, m_recordSize);
+
+    quint32 step = 0;
+    float value = 0.0f;
+    memcpy(&step, record, sizeof(quint32));
+
+    if (m_recordSize >= sizeof(quint32) + sizeof(float))
     {
-        m_capacity += m_chunkSize;
+        memcpy(&value, (const uchar*) record + sizeof(quint32), sizeof(float));
+    }
 
+    if (tail % CHUNK_RECORD_COUNT == 0)
+    {
+        m_index->m_chunkFirstStep[tail / CHUNK_RECORD_COUNT] = step;
+    }
 
-        m_sessionFile.unmap(m_writeMap);
-        m_writeMap = 0;
+    m_records.publish();
+    m_index->m_tail.store(tail + 1, std::memory_order_release);
 
-        m_writeMap = m_sessionFile.map(/*m_tail * (sizeof(unsigned int) + sizeof(float))*/ 0, m_capacity * (sizeof(unsigned int) + sizeof(float)));
+    summarize(step, value);
+}
 
-        if (!m_writeMap)
+void Session::summarize(quint32 step, float value)
+{
+    for (unsigned int level = 0; level < SUMMARY_LEVEL_COUNT; ++level)
+    {
+        SessionSummary &summary = m_openSummaries[level];
+        summary.add(step, value);
+
+        if (summary.m_count < summarySpan(level))
+        {
+            continue;
+        }
+
+        SessionLog &summaries = *m_summaries[level];
+        uchar *entry = summaries.nextEntry();
+
+        if (!entry)
         {
+            entry = new uchar[(size_t) summaries.chunkEntryCount() * sizeof(SessionSummary)];
 
-            qDebug() << "bug! can't open file";
+            if (!summaries.addChunk(entry))
+            {
+                delete [] entry;
+                summary = SessionSummary();
+                continue;
+            }
         }
-    }
 
-    memcpy(m_writeMap + (sizeof(unsigned int) + sizeof(float)) * m_tail, &step, sizeof(unsigned int));
-    memcpy(m_writeMap + (sizeof(unsigned int) + sizeof(float)) * m_tail + sizeof(unsigned int), &v, sizeof(float));
-    m_tail ++;
+        memcpy(entry, &summary, sizeof(SessionSummary));
+        summaries.publish();
+        summary = SessionSummary();
+    }
 }
 
 unsigned int Session::tail()
 {
-    return m_tail;
+    return m_records.tail();
 }
 
-void Session::read(uchar *buffer, unsigned int offset, unsigned int size)
+unsigned int Session::read(uchar *buffer, unsigned int offset, unsigned int size)
 {
-    /*if (m_readMap == NULL || (offset < m_readFrom || (offset + size) > (m_readFrom + m_readSize)))
+    return m_records.read(buffer, offset, size);
+}
+
+unsigned int Session::find(unsigned int step)
+{
+    unsigned int tail = m_records.tail();
+
+    if (!m_index || tail == 0)
+    {
+        return tail;
+    }
+
+    // the last chunk starting at or before step, from the index, then the entries in it
+    unsigned int chunkCount = (tail + CHUNK_RECORD_COUNT - 1) / CHUNK_RECORD_COUNT;
+    const quint32 *firstSteps = m_index->m_chunkFirstStep;
+    unsigned int chunk = std::upper_bound(firstSteps, firstSteps + chunkCount, (quint32) step) - firstSteps;
+    chunk = chunk ? chunk - 1 : 0;
+
+    unsigned int begin = chunk * CHUNK_RECORD_COUNT;
+    unsigned int end = std::min(tail, begin + CHUNK_RECORD_COUNT);
+
+    while (begin < end)
     {
-        if (m_readMap)
+        unsigned int middle = begin + (end - begin) / 2;
+        quint32 middleStep = 0;
+        memcpy(&middleStep, m_records.entry(middle), sizeof(quint32));
+
+        if (middleStep < step)
+        {
+            begin = middle + 1;
+        }
+        else
         {
-            m_sessionFile.unmap(m_readMap);
+            end = middle;
         }
+    }
 
-        m_readMap = m_sessionFile.map(offset * (sizeof(unsigned int) + sizeof(float)), size * (sizeof(unsigned int) + sizeof(float)));
-        m_readFrom = offset;
-        m_readSize = size;
+    return begin;
+}
 
-    }*/
+unsigned int Session::summarySpan(unsigned int level)
+{
+    unsigned int span = SUMMARY_FANOUT;
+
+    for (unsigned int l = 0; l < level; ++l)
+    {
+        span *= SUMMARY_FANOUT;
+    }
 
-    memcpy(buffer, m_writeMap + offset * (sizeof(unsigned int) + sizeof(float)), size* (sizeof(unsigned int) + sizeof(float)));
+    return span;
+}
 
+unsigned int Session::summaryTail(unsigned int level)
+{
+    return level < SUMMARY_LEVEL_COUNT ? m_summaries[level]->tail() : 0;
+}
 
+unsigned int Session::readSummaries(unsigned int level, SessionSummary *buffer, unsigned int offset, unsigned int size)
+{
+    return level < SUMMARY_LEVEL_COUNT ? m_summaries[level]->read((uchar*) buffer, offset, size) : 0;
 }
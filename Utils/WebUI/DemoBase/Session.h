@@ -5,34 +5,152 @@
 #include <QFile>
 #include <QList>
 #include <QtWebSockets/QWebSocket>
+#include <atomic>
+#include <memory>
 
+// The minimum, maximum and sum of the value of a run of consecutive entries, and the steps
+// they were at. Session keeps them for fixed runs so a long range is drawn from a few of them.
+struct SessionSummary
+{
+    quint32 m_firstStep;
+    quint32 m_lastStep;
+    quint32 m_minStep;
+    quint32 m_maxStep;
+    float m_min;
+    float m_max;
+    float m_sum;
+    quint32 m_count;
+
+    void add(quint32 step, float value);
+    void add(const SessionSummary &summary);
+};
+
+// An append-only log of fixed size entries in chunks that never move once written, so a reader
+// keeps what it was handed while the writer appends. One thread writes; it fills an entry and
+// then publishes the tail with a release store, any number of threads read up to the tail they
+// load, without locks.
+class SessionLog
+{
+    unsigned int m_entrySize;
+    unsigned int m_chunkEntryCount;
+    std::unique_ptr<std::atomic<uchar*>[]> m_chunks;
+    unsigned int m_maxChunkCount;
+    std::atomic<unsigned int> m_chunkCount;
+    std::atomic<unsigned int> m_tail;
+
+public:
+    SessionLog(unsigned int entrySize, unsigned int chunkEntryCount, unsigned int maxChunkCount);
+
+    unsigned int entrySize() const
+    {
+        return m_entrySize;
+    }
+
+    unsigned int chunkEntryCount() const
+    {
+        return m_chunkEntryCount;
+    }
+
+    unsigned int chunkCount() const
+    {
+        return m_chunkCount.load(std::memory_order_acquire);
+    }
+
+    unsigned int tail() const
+    {
+        return m_tail.load(std::memory_order_acquire);
+    }
+
+    // the next chunk by the writer, before the entries in it are published, false past the last
+    bool addChunk(uchar *data);
+    uchar *chunk(unsigned int chunk) const;
+
+    // the writer's next entry, null when its chunk isn't set
+    uchar *nextEntry() const;
+    void publish();
+
+    const uchar *entry(unsigned int index) const;
+
+    // copies the published entries of [offset, offset + size), returns how many there were
+    unsigned int read(uchar *buffer, unsigned int offset, unsigned int size) const;
+
+    // forgets the chunks and the entries, the owner of the chunks frees them
+    void reset();
+};
+
+// The log of a training session: entries of recordSize bytes starting with a quint32 step,
+// steps increasing, and the value they log as the float after it (the cost, the throughput).
+//
+// The file is an index page, then chunks of CHUNK_RECORD_COUNT entries, each mapped on its own
+// when the previous one is full; appending never remaps or moves what is written. The index
+// page has the record size, the tail and the first step of every chunk, for find() and for
+// readers of the file. Every SUMMARY_FANOUT entries, then SUMMARY_FANOUT of those and so on, are
+// summarized as they are appended, so a chart of a long range reads the summaries of the level
+// that fits its width, not the entries.
 class Session : public QObject
 {
     Q_OBJECT
 
+public:
+    static const unsigned int CHUNK_RECORD_COUNT = 16384;
+    static const unsigned int MAX_CHUNK_COUNT = 4080;
+    static const unsigned int SUMMARY_FANOUT = 16;
+    static const unsigned int SUMMARY_LEVEL_COUNT = 4;
+
 private:
+    // the first page of the file
+    struct Index
+    {
+        quint32 m_magic;
+        quint32 m_recordSize;
+        quint32 m_chunkRecordCount;
+        std::atomic<quint32> m_chunkCount;
+        std::atomic<quint32> m_tail;
+        quint32 m_reserved[11];
+        quint32 m_chunkFirstStep[MAX_CHUNK_COUNT];
+    };
 
     QFile m_sessionFile;
-    uchar *m_writeMap;
+    // the bytes of one entry, a step and a float for the cost
+    unsigned int m_recordSize;
 
-    unsigned int m_readFrom;
-    unsigned int m_readSize;
-    uchar *m_readMap;
+    Index *m_index;
+    SessionLog m_records;
 
-    const unsigned int m_chunkSize = 1024;
-    unsigned int m_capacity;
-    unsigned int m_tail;
+    // level l summarizes SUMMARY_FANOUT^(l + 1) entries, the last one of each level still open
+    std::unique_ptr<SessionLog> m_summaries[SUMMARY_LEVEL_COUNT];
+    SessionSummary m_openSummaries[SUMMARY_LEVEL_COUNT];
+
+    bool mapChunk(unsigned int chunk);
+    void summarize(quint32 step, float value);
 
 public:
-    Session();
+    Session(const QString &fileName = "sessionfile.dat", unsigned int recordSize = sizeof(unsigned int) + sizeof(float));
+    virtual ~Session();
 
     void write(unsigned int step, float v);
 
+    // appends one entry of recordSize bytes, from the one writing thread
+    void write(const void *record);
+
+    // starts the session over in a file of one index page
     void open();
 
-    void read(uchar *buffer, unsigned int offset, unsigned int size);
+    // copies the entries of [offset, offset + size) that are written, returns how many
+    unsigned int read(uchar *buffer, unsigned int offset, unsigned int size);
 
     unsigned int tail();
+
+    // the first entry at or after step, tail() when there is none
+    unsigned int find(unsigned int step);
+
+    // the entries a summary of level summarizes
+    static unsigned int summarySpan(unsigned int level);
+
+    // the closed summaries of level, summary i covers entries [i * span, (i + 1) * span)
+    unsigned int summaryTail(unsigned int level);
+
+    unsigned int readSummaries(unsigned int level, SessionSummary *buffer, unsigned int offset, unsigned int size);
 };
 
 #endif // SESSION_H
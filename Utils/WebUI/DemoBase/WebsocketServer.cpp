@@ -4,10 +4,63 @@
 #include <random>
 #include <QDataStream>
 #include <type_traits>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    // an entry of the cost log, and a point of a chart
+    struct CostEntry
+    {
+        quint32 m_step;
+        float m_value;
+    };
+
+    const unsigned int MIN_STREAM_WIDTH = 16;
+    const unsigned int MAX_STREAM_WIDTH = 8192;
+    // a consumer draws up to this many points a pixel from deltas before it gets a full view again
+    const unsigned int MAX_POINTS_PER_PIXEL = 4;
+    const int PUSH_INTERVAL_IN_MS = 100;
+
+    // the min and the max of a bucket in the order of their steps, one point when they are one
+    void appendBucket(QByteArray &ba, const SessionSummary &bucket)
+    {
+        if (bucket.m_count == 0)
+        {
+            return;
+        }
+
+        CostEntry first = {bucket.m_minStep, bucket.m_min};
+        CostEntry second = {bucket.m_maxStep, bucket.m_max};
+
+        if (second.m_step < first.m_step)
+        {
+            std::swap(first, second);
+        }
+
+        ba.append((const char*) &first, sizeof(CostEntry));
+
+        if (second.m_step != first.m_step)
+        {
+            ba.append((const char*) &second, sizeof(CostEntry));
+        }
+    }
+}
 
 WebsocketServer::WebsocketServer():
-    m_testTimer(NULL)
+    m_testTimer(NULL),
+    m_session(NULL),
+    m_metricsSession(NULL)
 {
+    // the demos emit from their own thread
+    qRegisterMetaType<QVector<float>>("QVector<float>");
+
+    m_pushTimer = new QTimer(this);
+    m_pushTimer->setSingleShot(true);
+    m_pushTimer->setInterval(PUSH_INTERVAL_IN_MS);
+    connect(m_pushTimer, &QTimer::timeout, this, &WebsocketServer::onPushTimeout);
+
     m_server = new QWebSocketServer("localhost", QWebSocketServer::NonSecureMode);
 
     if (m_server->listen(QHostAddress::Any, 5678))
@@ -19,6 +72,9 @@ WebsocketServer::WebsocketServer():
 
         m_session = new Session();
         m_session->open();
+
+        m_metricsSession = new Session("metricsfile.dat", sizeof(ThroughputRecord));
+        m_metricsSession->open();
     }
 }
 
@@ -62,6 +118,174 @@ void WebsocketServer::notifyUpdate(unsigned int _tail)
     ba.append((char*) &message, 4);
     ba.append((char *) &tail, 4);
 
+    // the subscribed consumers get the entries themselves, see onPushTimeout
+    foreach(QWebSocket *socket, m_consumerSockets)
+    {
+        if (!m_dataStreams.contains(socket))
+        {
+            socket->sendBinaryMessage(ba);
+        }
+    }
+
+    if (!m_dataStreams.isEmpty() && !m_pushTimer->isActive())
+    {
+        m_pushTimer->start();
+    }
+}
+
+QByteArray WebsocketServer::encodeDownsampled(unsigned int tail, unsigned int width)
+{
+    quint32 messageName = static_cast<uint32_t>(Message::DOWNSAMPLED_DATA);
+    quint32 pointCount = 0;
+
+    QByteArray ba;
+    ba.append((char*) &messageName, 4);
+    ba.append((char*) &tail, 4);
+    ba.append((char*) &pointCount, 4);
+
+    // the coarsest summaries no longer than a bucket, the buckets rounded up to a whole number
+    // of them so every bucket is merged from summaries and the entries are read only after the
+    // last one
+    unsigned int bucketSize = std::max(1u, (tail + width - 1) / width);
+    int level = -1;
+
+    while (level + 1 < (int) Session::SUMMARY_LEVEL_COUNT && Session::summarySpan(level + 1) <= bucketSize)
+    {
+        ++level;
+    }
+
+    if (level >= 0)
+    {
+        unsigned int span = Session::summarySpan(level);
+        bucketSize = (bucketSize + span - 1) / span * span;
+    }
+
+    SessionSummary bucket = SessionSummary();
+    unsigned int covered = 0;
+
+    // the spans nest, what a level leaves after its last summary the finer ones cover
+    for (int l = level; l >= 0; --l)
+    {
+        unsigned int span = Session::summarySpan(l);
+        unsigned int first = covered / span;
+        unsigned int last = std::min(m_session->summaryTail(l), tail / span);
+
+        if (last <= first)
+        {
+            continue;
+        }
+
+        std::vector<SessionSummary> summaries(last - first);
+        unsigned int count = m_session->readSummaries(l, summaries.data(), first, last - first);
+
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            bucket.add(summaries[i]);
+
+            if (bucket.m_count >= bucketSize)
+            {
+                appendBucket(ba, bucket);
+                bucket = SessionSummary();
+            }
+        }
+
+        covered += count * span;
+    }
+
+    std::vector<CostEntry> entries(tail - covered);
+    unsigned int count = m_session->read((uchar*) entries.data(), covered, tail - covered);
+
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        bucket.add(entries[i].m_step, entries[i].m_value);
+
+        if (bucket.m_count >= bucketSize)
+        {
+            appendBucket(ba, bucket);
+            bucket = SessionSummary();
+        }
+    }
+
+    appendBucket(ba, bucket);
+
+    pointCount = (ba.size() - 12) / sizeof(CostEntry);
+    memcpy(ba.data() + 8, &pointCount, 4);
+
+    return ba;
+}
+
+QByteArray WebsocketServer::encodeDelta(unsigned int from, unsigned int tail)
+{
+    quint32 messageName = static_cast<uint32_t>(Message::DATA_DELTA);
+    quint32 size = tail - from;
+
+    QByteArray entries(sizeof(CostEntry) * size, 0);
+    size = m_session->read((uchar*) entries.data(), from, size);
+    entries.resize(sizeof(CostEntry) * size);
+
+    QByteArray ba;
+    ba.append((char*) &messageName, 4);
+    ba.append((char*) &from, 4);
+    ba.append((char*) &size, 4);
+    ba.append(entries);
+
+    return ba;
+}
+
+void WebsocketServer::onPushTimeout()
+{
+    unsigned int tail = m_session->tail();
+
+    // consumers at the same tail, or of the same width, get the same bytes, encoded once
+    QHash<unsigned int, QByteArray> deltas;
+    QHash<unsigned int, QByteArray> views;
+
+    for (auto it = m_dataStreams.begin(); it != m_dataStreams.end(); ++it)
+    {
+        DataStream &stream = it.value();
+
+        if (stream.m_sentTail >= tail)
+        {
+            continue;
+        }
+
+        unsigned int newEntryCount = tail - stream.m_sentTail;
+
+        if (newEntryCount > stream.m_width || stream.m_pointCount + newEntryCount > MAX_POINTS_PER_PIXEL * stream.m_width)
+        {
+            if (!views.contains(stream.m_width))
+            {
+                views.insert(stream.m_width, encodeDownsampled(tail, stream.m_width));
+            }
+
+            const QByteArray &view = views[stream.m_width];
+            it.key()->sendBinaryMessage(view);
+            stream.m_pointCount = (view.size() - 12) / sizeof(CostEntry);
+        }
+        else
+        {
+            if (!deltas.contains(stream.m_sentTail))
+            {
+                deltas.insert(stream.m_sentTail, encodeDelta(stream.m_sentTail, tail));
+            }
+
+            it.key()->sendBinaryMessage(deltas[stream.m_sentTail]);
+            stream.m_pointCount += newEntryCount;
+        }
+
+        stream.m_sentTail = tail;
+    }
+}
+
+void WebsocketServer::notifyMetricsUpdate(unsigned int _tail)
+{
+    quint32 message = static_cast<uint32_t>(Message::METRICS_AVAILABLE);
+    quint32 tail = _tail;
+
+    QByteArray ba;
+    ba.append((char*) &message, 4);
+    ba.append((char *) &tail, 4);
+
     foreach(QWebSocket *socket, m_consumerSockets)
     {
         socket->sendBinaryMessage(ba);
@@ -91,7 +315,8 @@ void WebsocketServer::onBinaryMessageReceived(const QByteArray &message)
 
         unsigned char *buffer = new unsigned char[(sizeof(unsigned int) + sizeof(float)) * size];
 
-        m_session->read(buffer, from, size);
+        // only what is written, a query past the tail gets fewer
+        size = m_session->read(buffer, from, size);
 
         messageName = static_cast<uint32_t>(Message::DATA);
         QByteArray ba;
@@ -101,6 +326,51 @@ void WebsocketServer::onBinaryMessageReceived(const QByteArray &message)
 
         delete [] buffer;
 
+        socket->sendBinaryMessage(ba);
+    }
+    else if (messageName == static_cast<uint32_t>(Message::SUBSCRIBE_DATA))
+    {
+        QWebSocket *socket = (QWebSocket*) sender();
+
+        quint32 width = 0;
+
+        ds >> width;
+
+        // a new width, after a resize, starts over with a full view too
+        DataStream stream;
+        stream.m_width = std::max(MIN_STREAM_WIDTH, std::min(MAX_STREAM_WIDTH, (unsigned int) width));
+        stream.m_sentTail = m_session->tail();
+
+        QByteArray view = encodeDownsampled(stream.m_sentTail, stream.m_width);
+        stream.m_pointCount = (view.size() - 12) / sizeof(CostEntry);
+
+        m_dataStreams.insert(socket, stream);
+        socket->sendBinaryMessage(view);
+    }
+    else if (messageName == static_cast<uint32_t>(Message::QUERY_METRICS))
+    {
+        QWebSocket *socket = (QWebSocket*) sender();
+
+        quint32 from = 0;
+        quint32 size = 0;
+
+        ds >> from >> size;
+
+        if (from + size > m_metricsSession->tail())
+        {
+            return;
+        }
+
+        QByteArray records(sizeof(ThroughputRecord) * size, 0);
+
+        m_metricsSession->read((uchar*) records.data(), from, size);
+
+        messageName = static_cast<uint32_t>(Message::METRICS);
+        QByteArray ba;
+        ba.append((char*) &messageName, 4);
+        ba.append((char*) &size, 4);
+        ba.append(records);
+
         socket->sendBinaryMessage(ba);
     }
 }
@@ -120,6 +390,7 @@ void WebsocketServer::onDisconnected()
     QWebSocket *socket = (QWebSocket*) sender();
 
     m_consumerSockets.removeOne(socket);
+    m_dataStreams.remove(socket);
     socket->deleteLater();
 }
 
@@ -144,3 +415,67 @@ void WebsocketServer::onUpdateProgress(float epoch, float overall)
         socket->sendBinaryMessage(ba);
     }
 }
+
+void WebsocketServer::onUpdateThroughput(unsigned int step, float samplesPerSecond, float latencyP50, float latencyP90, float latencyP99, float hostMemoryInMB)
+{
+    ThroughputRecord record = {step, samplesPerSecond, latencyP50, latencyP90, latencyP99, hostMemoryInMB};
+
+    m_metricsSession->write(&record);
+    notifyMetricsUpdate(m_metricsSession->tail());
+}
+
+void WebsocketServer::onUpdateDevices(unsigned int step, const QVector<float> &utilization, const QVector<float> &queueDepth, const QVector<float> &memoryInMB)
+{
+    quint32 message = static_cast<uint32_t>(Message::DEVICE_METRICS);
+    quint32 deviceCount = utilization.size();
+
+    QByteArray ba;
+    ba.append((char*) &message, 4);
+    ba.append((char*) &step, 4);
+    ba.append((char*) &deviceCount, 4);
+
+    for (int d = 0; d < utilization.size(); ++d)
+    {
+        float depth = d < queueDepth.size() ? queueDepth[d] : 0.0f;
+        float memory = d < memoryInMB.size() ? memoryInMB[d] : 0.0f;
+
+        ba.append((char*) &utilization[d], 4);
+        ba.append((char*) &depth, 4);
+        ba.append((char*) &memory, 4);
+    }
+
+    foreach(QWebSocket *socket, m_consumerSockets)
+    {
+        socket->sendBinaryMessage(ba);
+    }
+}
+
+void WebsocketServer::onUpdateMemory(unsigned int step, const QStringList &labels, const QVector<float> &memoryInMB, const QVector<float> &peakMemoryInMB)
+{
+    quint32 message = static_cast<uint32_t>(Message::MEMORY_METRICS);
+    quint32 entryCount = labels.size();
+
+    QByteArray ba;
+    ba.append((char*) &message, 4);
+    ba.append((char*) &step, 4);
+    ba.append((char*) &entryCount, 4);
+
+    // the sizes, then the label in utf-8 after its length
+    for (int i = 0; i < labels.size(); ++i)
+    {
+        float memory = i < memoryInMB.size() ? memoryInMB[i] : 0.0f;
+        float peakMemory = i < peakMemoryInMB.size() ? peakMemoryInMB[i] : 0.0f;
+        QByteArray label = labels[i].toUtf8();
+        quint32 labelSize = label.size();
+
+        ba.append((char*) &memory, 4);
+        ba.append((char*) &peakMemory, 4);
+        ba.append((char*) &labelSize, 4);
+        ba.append(label);
+    }
+
+    foreach(QWebSocket *socket, m_consumerSockets)
+    {
+        socket->sendBinaryMessage(ba);
+    }
+}
@@ -4,6 +4,9 @@
 #include <QtWebSockets/QWebSocket>
 #include <QtWebSockets/QWebSocketServer>
 #include <QTimer>
+#include <QVector>
+#include <QStringList>
+#include <QHash>
 #include "Session.h"
 
 enum class Message : uint32_t
@@ -11,7 +14,42 @@ enum class Message : uint32_t
     UPDATE_AVAILABLE = 6543,
     QUERY_DATA,
     DATA,
-    UPDATE_PROGRESS
+    UPDATE_PROGRESS,
+    // the throughput log, like the cost: the tail, a query for a range and the entries
+    METRICS_AVAILABLE,
+    QUERY_METRICS,
+    METRICS,
+    // the state of every device now, not logged
+    DEVICE_METRICS,
+    // the cost streamed to a chart of a width in pixels: the client subscribes with the width,
+    // gets the whole log downsampled to it, then only the entries appended since
+    SUBSCRIBE_DATA,
+    DOWNSAMPLED_DATA,
+    DATA_DELTA,
+    // the memory per category and device now, not logged
+    MEMORY_METRICS
+};
+
+// one entry of the throughput log, the latencies are in milliseconds
+struct ThroughputRecord
+{
+    quint32 m_step;
+    float m_samplesPerSecond;
+    float m_latencyP50;
+    float m_latencyP90;
+    float m_latencyP99;
+    float m_hostMemoryInMB;
+};
+
+// what a subscribed consumer has of the cost log
+struct DataStream
+{
+    // the width of its chart in pixels
+    quint32 m_width;
+    // the entries it has, up to the tail it was sent last
+    quint32 m_sentTail;
+    // the points it draws, a full view is sent again when the deltas grow it past a few a pixel
+    quint32 m_pointCount;
 };
 
 class WebsocketServer : public QObject
@@ -21,15 +59,23 @@ class WebsocketServer : public QObject
     QWebSocketServer *m_server;
     QTimer *m_testTimer;
     Session *m_session;
+    Session *m_metricsSession;
 
     QWebSocket *m_producerSocket;
     QList<QWebSocket*> m_consumerSockets;
+    QHash<QWebSocket*, DataStream> m_dataStreams;
+    // the updates of a burst of steps are pushed together
+    QTimer *m_pushTimer;
 
+    // the points of the min and max of every bucket of entries [0, tail), about width buckets
+    QByteArray encodeDownsampled(unsigned int tail, unsigned int width);
+    QByteArray encodeDelta(unsigned int from, unsigned int tail);
 
 public:
     WebsocketServer();
     virtual ~WebsocketServer();
     void notifyUpdate(unsigned int);
+    void notifyMetricsUpdate(unsigned int);
 
 private slots:
     void onNewConnection();
@@ -39,10 +85,16 @@ private slots:
     void onDisconnected();
 
     void onTimeout();
+    void onPushTimeout();
 
 public slots:
     void onUpdateCost(float cost);
     void onUpdateProgress(float epoch, float overall);
+    void onUpdateThroughput(unsigned int step, float samplesPerSecond, float latencyP50, float latencyP90, float latencyP99, float hostMemoryInMB);
+    // one entry per device
+    void onUpdateDevices(unsigned int step, const QVector<float> &utilization, const QVector<float> &queueDepth, const QVector<float> &memoryInMB);
+    // one entry per category and device or NUMA node
+    void onUpdateMemory(unsigned int step, const QStringList &labels, const QVector<float> &memoryInMB, const QVector<float> &peakMemoryInMB);
 };
 
 #endif // WEBSOCKETSERVER_H